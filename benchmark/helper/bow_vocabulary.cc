@@ -0,0 +1,15 @@
+#include "helper/bow_vocabulary.h"
+
+#include <cstdlib>
+#include <memory>
+
+data::bow_vocabulary* get_bow_vocabulary() {
+    static const std::unique_ptr<data::bow_vocabulary> bow_vocab = []() -> std::unique_ptr<data::bow_vocabulary> {
+        const auto vocab_file_path_env = std::getenv("BOW_VOCAB");
+        if (!vocab_file_path_env) {
+            return nullptr;
+        }
+        return std::unique_ptr<data::bow_vocabulary>(data::bow_vocabulary_util::load(vocab_file_path_env));
+    }();
+    return bow_vocab.get();
+}
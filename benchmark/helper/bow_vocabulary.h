@@ -0,0 +1,15 @@
+#ifndef STELLA_VSLAM_BENCHMARK_HELPER_BOW_VOCABULARY_H
+#define STELLA_VSLAM_BENCHMARK_HELPER_BOW_VOCABULARY_H
+
+#include "stella_vslam/data/bow_vocabulary.h"
+
+using namespace stella_vslam;
+
+/**
+ * Get the vocabulary specified by the environment variable BOW_VOCAB
+ * (NOTE: the vocabulary is loaded at the first call and shared by all of the benchmarks)
+ * @return nullptr if BOW_VOCAB is not set
+ */
+data::bow_vocabulary* get_bow_vocabulary();
+
+#endif // STELLA_VSLAM_BENCHMARK_HELPER_BOW_VOCABULARY_H
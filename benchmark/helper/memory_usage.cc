@@ -0,0 +1,50 @@
+#include "helper/memory_usage.h"
+
+#include <fstream>
+#include <sstream>
+
+#include <sys/stat.h>
+
+namespace {
+
+// read the field of /proc/self/status in kB
+size_t read_proc_status_kb(const std::string& field) {
+    std::ifstream ifs("/proc/self/status");
+    std::string line;
+    while (std::getline(ifs, line)) {
+        if (line.compare(0, field.size(), field) != 0) {
+            continue;
+        }
+        std::istringstream iss(line.substr(field.size()));
+        size_t kb = 0;
+        iss >> kb;
+        return kb;
+    }
+    return 0;
+}
+
+} // namespace
+
+size_t get_current_rss_bytes() {
+    return read_proc_status_kb("VmRSS:") * 1024;
+}
+
+size_t get_peak_rss_bytes() {
+    return read_proc_status_kb("VmHWM:") * 1024;
+}
+
+void reset_peak_rss() {
+    // (see the description of /proc/[pid]/clear_refs in proc(5))
+    std::ofstream ofs("/proc/self/clear_refs");
+    if (ofs) {
+        ofs << "5";
+    }
+}
+
+size_t get_file_size(const std::string& path) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) {
+        return 0;
+    }
+    return static_cast<size_t>(st.st_size);
+}
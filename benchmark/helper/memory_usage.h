@@ -0,0 +1,32 @@
+#ifndef STELLA_VSLAM_BENCHMARK_HELPER_MEMORY_USAGE_H
+#define STELLA_VSLAM_BENCHMARK_HELPER_MEMORY_USAGE_H
+
+#include <cstddef>
+#include <string>
+
+/**
+ * Get the resident set size of the process
+ * @return [bytes] (0 if not available)
+ */
+size_t get_current_rss_bytes();
+
+/**
+ * Get the peak resident set size of the process since the last reset_peak_rss()
+ * @return [bytes] (0 if not available)
+ */
+size_t get_peak_rss_bytes();
+
+/**
+ * Reset the peak resident set size to the current one
+ * (NOTE: supported only on Linux, otherwise the peak is kept since the process started)
+ */
+void reset_peak_rss();
+
+/**
+ * Get the size of the file
+ * @param path
+ * @return [bytes] (0 if the file does not exist)
+ */
+size_t get_file_size(const std::string& path);
+
+#endif // STELLA_VSLAM_BENCHMARK_HELPER_MEMORY_USAGE_H
@@ -0,0 +1,315 @@
+#include "helper/synthetic_map.h"
+
+#include "stella_vslam/camera/perspective.h"
+#include "stella_vslam/data/common.h"
+#include "stella_vslam/data/graph_node.h"
+#include "stella_vslam/data/keyframe.h"
+#include "stella_vslam/data/landmark.h"
+#include "stella_vslam/data/map_database.h"
+#include "stella_vslam/util/converter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+#include <unordered_map>
+
+cv::Mat create_random_descriptors(const unsigned int num_descriptors, std::mt19937& mt) {
+    std::uniform_int_distribution<int> rand(0, 255);
+    cv::Mat descriptors(num_descriptors, 32, CV_8U);
+    for (unsigned int i = 0; i < num_descriptors; ++i) {
+        auto ptr = descriptors.ptr<uchar>(i);
+        for (unsigned int j = 0; j < 32; ++j) {
+            ptr[j] = static_cast<uchar>(rand(mt));
+        }
+    }
+    return descriptors;
+}
+
+cv::Mat perturb_descriptor(const cv::Mat& desc, const unsigned int num_flipped_bits, std::mt19937& mt) {
+    std::uniform_int_distribution<int> rand(0, 255);
+    cv::Mat perturbed = desc.clone();
+    auto ptr = perturbed.ptr<uchar>(0);
+    for (unsigned int i = 0; i < num_flipped_bits; ++i) {
+        const auto bit = rand(mt);
+        ptr[bit / 8] ^= static_cast<uchar>(1 << (bit % 8));
+    }
+    return perturbed;
+}
+
+synthetic_map& get_shared_synthetic_map(const unsigned int num_keyframes, const unsigned int num_landmarks) {
+    static std::mutex mtx;
+    static std::unique_ptr<synthetic_map> map = nullptr;
+    static unsigned int map_num_landmarks = 0;
+    std::lock_guard<std::mutex> lock(mtx);
+    if (!map || map->keyframes_.size() != num_keyframes || map_num_landmarks != num_landmarks) {
+        // (release the previous one first to bound the peak memory)
+        map.reset(nullptr);
+        map.reset(new synthetic_map(num_keyframes, num_landmarks, 0));
+        map_num_landmarks = num_landmarks;
+    }
+    return *map;
+}
+
+namespace {
+
+// the keyframes are placed at this interval
+constexpr double keyframe_interval = 0.5;
+// standard deviation of the keypoint noise [px]
+constexpr double keypt_noise_stddev = 0.5;
+// number of the bits flipped in the descriptor of each observation
+constexpr unsigned int num_flipped_bits = 8;
+// ratio of the distractors (keypoints which are not associated to any landmark) to the observed landmarks
+constexpr double distractor_ratio = 0.25;
+// minimum number of the shared landmarks to connect the keyframes in the covisibility graph
+constexpr unsigned int min_num_shared_lms = 15;
+// width of the cells along the x-axis to index the landmarks
+constexpr double cell_width = 1.0;
+// landmarks farther than this along the x-axis are not visible from the camera
+// (the landmarks are 30 m away at most and the field of view is less than 90 deg including the yaw)
+constexpr double max_visible_dist_x = 40.0;
+
+} // namespace
+
+synthetic_map::synthetic_map(const unsigned int num_keyframes, const unsigned int num_landmarks, const unsigned int seed)
+    : camera_(create_camera()),
+      orb_params_(create_orb_params()),
+      map_db_(new data::map_database(min_num_shared_lms)),
+      mt_(seed) {
+    // scatter the landmarks in front of the trajectory
+    const double trajectory_length = keyframe_interval * (num_keyframes - 1);
+    std::uniform_real_distribution<double> rand_x(-10.0, trajectory_length + 10.0);
+    std::uniform_real_distribution<double> rand_y(-5.0, 5.0);
+    std::uniform_real_distribution<double> rand_z(10.0, 30.0);
+    pos_ws_.resize(num_landmarks);
+    for (auto& pos_w : pos_ws_) {
+        pos_w = Vec3_t{rand_x(mt_), rand_y(mt_), rand_z(mt_)};
+    }
+    lm_descriptors_ = create_random_descriptors(num_landmarks, mt_);
+    min_x_ = -10.0;
+    index_landmarks();
+
+    // create the keyframes which observe the landmarks
+    std::vector<std::vector<int>> lm_indices_in_keyfrms(num_keyframes);
+    std::vector<unsigned int> num_observations(num_landmarks, 0);
+    for (unsigned int i = 0; i < num_keyframes; ++i) {
+        const Mat44_t pose_cw = get_pose_cw(keyframe_interval * i);
+        auto& lm_indices = lm_indices_in_keyfrms.at(i);
+        const auto frm_obs = observe(pose_cw, lm_indices);
+        for (const auto lm_idx : lm_indices) {
+            if (0 <= lm_idx) {
+                ++num_observations.at(lm_idx);
+            }
+        }
+
+        auto keyfrm = data::keyframe::make_keyframe(map_db_->next_keyframe_id_++, timestamp_, pose_cw, camera_.get(), orb_params_.get(),
+                                                    frm_obs, data::bow_vector(), data::bow_feature_vector());
+        timestamp_ += 1.0;
+        if (keyframes_.empty()) {
+            keyfrm->graph_node_->set_spanning_root(keyfrm);
+            map_db_->add_spanning_root(keyfrm);
+        }
+        else {
+            keyfrm->graph_node_->set_spanning_parent(keyframes_.back());
+            keyframes_.back()->graph_node_->add_spanning_child(keyfrm);
+            keyfrm->graph_node_->set_spanning_root(keyframes_.front());
+        }
+        map_db_->add_keyframe(keyfrm);
+        keyframes_.push_back(keyfrm);
+        poses_cw_.push_back(pose_cw);
+    }
+
+    // create the landmarks observed in two or more keyframes
+    std::vector<std::shared_ptr<data::landmark>> lms_by_index(num_landmarks, nullptr);
+    for (unsigned int i = 0; i < num_keyframes; ++i) {
+        const auto& keyfrm = keyframes_.at(i);
+        const auto& lm_indices = lm_indices_in_keyfrms.at(i);
+        for (unsigned int idx = 0; idx < lm_indices.size(); ++idx) {
+            const auto lm_idx = lm_indices.at(idx);
+            if (lm_idx < 0 || num_observations.at(lm_idx) < 2) {
+                continue;
+            }
+            auto& lm = lms_by_index.at(lm_idx);
+            if (!lm) {
+                lm = data::landmark::create(map_db_->next_landmark_id_++, pos_ws_.at(lm_idx), keyfrm);
+            }
+            lm->connect_to_keyframe(keyfrm, idx);
+        }
+    }
+
+    // keep the landmarks which are actually created
+    eigen_alloc_vector<Vec3_t> pos_ws;
+    cv::Mat lm_descriptors;
+    for (unsigned int lm_idx = 0; lm_idx < num_landmarks; ++lm_idx) {
+        auto& lm = lms_by_index.at(lm_idx);
+        if (!lm) {
+            continue;
+        }
+        lm->compute_descriptor();
+        lm->update_mean_normal_and_obs_scale_variance();
+        map_db_->add_landmark(lm);
+        landmarks_.push_back(lm);
+        pos_ws.push_back(pos_ws_.at(lm_idx));
+        lm_descriptors.push_back(lm_descriptors_.row(lm_idx));
+    }
+    pos_ws_ = pos_ws;
+    lm_descriptors_ = lm_descriptors;
+    index_landmarks();
+
+    for (const auto& keyfrm : keyframes_) {
+        keyfrm->graph_node_->update_connections(min_num_shared_lms);
+    }
+}
+
+synthetic_map::~synthetic_map() {
+    landmarks_.clear();
+    keyframes_.clear();
+    map_db_->clear();
+}
+
+camera::base* synthetic_map::create_camera() {
+    return new camera::perspective("benchmark camera", camera::setup_type_t::Monocular, camera::color_order_t::Gray,
+                                   640, 480, 30.0, 500.0, 500.0, 320.0, 240.0, 0.0, 0.0, 0.0, 0.0, 0.0);
+}
+
+feature::orb_params* synthetic_map::create_orb_params() {
+    return new feature::orb_params("ORB setting for benchmark");
+}
+
+Mat44_t synthetic_map::get_pose_cw(const double position) {
+    // move along the x-axis with a slight yaw
+    // (the yaw is bounded, so that the camera keeps looking at the landmarks along a long trajectory)
+    const Mat33_t rot_wc = util::converter::to_rot_mat(Vec3_t{0.0, 0.2 * std::sin(0.1 * position), 0.0});
+    const Vec3_t trans_wc{position, 0.0, 0.0};
+    return util::converter::inverse_pose(util::converter::to_eigen_pose(rot_wc, trans_wc));
+}
+
+data::frame_observation synthetic_map::create_observation(const Mat44_t& pose_cw, std::vector<std::shared_ptr<data::landmark>>& observed_lms) {
+    std::vector<int> lm_indices;
+    const auto frm_obs = observe(pose_cw, lm_indices);
+    observed_lms.resize(lm_indices.size());
+    for (unsigned int idx = 0; idx < lm_indices.size(); ++idx) {
+        observed_lms.at(idx) = (0 <= lm_indices.at(idx)) ? landmarks_.at(lm_indices.at(idx)) : nullptr;
+    }
+    return frm_obs;
+}
+
+data::frame synthetic_map::create_frame(const Mat44_t& pose_cw, std::vector<std::shared_ptr<data::landmark>>& observed_lms) {
+    const auto frm_obs = create_observation(pose_cw, observed_lms);
+    data::frame frm(timestamp_, camera_.get(), orb_params_.get(), frm_obs, {});
+    timestamp_ += 1.0;
+    frm.set_pose_cw(pose_cw);
+    return frm;
+}
+
+std::vector<std::pair<int, int>> synthetic_map::create_matches(const unsigned int keyfrm_idx_1, const unsigned int keyfrm_idx_2, const double outlier_ratio) {
+    const auto lms_1 = keyframes_.at(keyfrm_idx_1)->get_landmarks();
+    const auto lms_2 = keyframes_.at(keyfrm_idx_2)->get_landmarks();
+    std::unordered_map<unsigned int, int> lm_id_to_idx_2;
+    for (unsigned int idx_2 = 0; idx_2 < lms_2.size(); ++idx_2) {
+        if (lms_2.at(idx_2)) {
+            lm_id_to_idx_2[lms_2.at(idx_2)->id_] = idx_2;
+        }
+    }
+
+    std::uniform_real_distribution<double> rand_ratio(0.0, 1.0);
+    std::uniform_int_distribution<int> rand_idx_2(0, lms_2.size() - 1);
+    std::vector<std::pair<int, int>> matches;
+    for (unsigned int idx_1 = 0; idx_1 < lms_1.size(); ++idx_1) {
+        if (!lms_1.at(idx_1) || !lm_id_to_idx_2.count(lms_1.at(idx_1)->id_)) {
+            continue;
+        }
+        const auto idx_2 = (rand_ratio(mt_) < outlier_ratio) ? rand_idx_2(mt_) : lm_id_to_idx_2.at(lms_1.at(idx_1)->id_);
+        matches.emplace_back(idx_1, idx_2);
+    }
+    return matches;
+}
+
+void synthetic_map::restore() {
+    for (unsigned int i = 0; i < keyframes_.size(); ++i) {
+        keyframes_.at(i)->set_pose_cw(poses_cw_.at(i));
+    }
+    for (unsigned int i = 0; i < landmarks_.size(); ++i) {
+        landmarks_.at(i)->set_pos_in_world(pos_ws_.at(i));
+    }
+}
+
+void synthetic_map::perturb(const double rot_stddev, const double trans_stddev, const double pos_stddev) {
+    std::normal_distribution<double> rand_rot(0.0, rot_stddev);
+    std::normal_distribution<double> rand_trans(0.0, trans_stddev);
+    std::normal_distribution<double> rand_pos(0.0, pos_stddev);
+    // (the origin is not perturbed)
+    for (unsigned int i = 1; i < keyframes_.size(); ++i) {
+        const Mat33_t rot_delta = util::converter::to_rot_mat(Vec3_t{rand_rot(mt_), rand_rot(mt_), rand_rot(mt_)});
+        const Vec3_t trans_delta{rand_trans(mt_), rand_trans(mt_), rand_trans(mt_)};
+        const Mat44_t& pose_cw = poses_cw_.at(i);
+        const Mat33_t rot_cw = rot_delta * pose_cw.block<3, 3>(0, 0);
+        const Vec3_t trans_cw = pose_cw.block<3, 1>(0, 3) + trans_delta;
+        keyframes_.at(i)->set_pose_cw(util::converter::to_eigen_pose(rot_cw, trans_cw));
+    }
+    for (unsigned int i = 0; i < landmarks_.size(); ++i) {
+        landmarks_.at(i)->set_pos_in_world(pos_ws_.at(i) + Vec3_t{rand_pos(mt_), rand_pos(mt_), rand_pos(mt_)});
+    }
+}
+
+data::frame_observation synthetic_map::observe(const Mat44_t& pose_cw, std::vector<int>& lm_indices) {
+    const Mat33_t rot_cw = pose_cw.block<3, 3>(0, 0);
+    const Vec3_t trans_cw = pose_cw.block<3, 1>(0, 3);
+    std::normal_distribution<double> rand_noise(0.0, keypt_noise_stddev);
+
+    // collect the landmarks around the camera in the order of the indices
+    const double cam_x = -(rot_cw.transpose() * trans_cw)(0);
+    const auto num_cells = static_cast<int>(lm_indices_in_cells_.size());
+    const auto min_cell = std::max(0, static_cast<int>(std::floor((cam_x - max_visible_dist_x - min_x_) / cell_width)));
+    const auto max_cell = std::min(num_cells - 1, static_cast<int>(std::floor((cam_x + max_visible_dist_x - min_x_) / cell_width)));
+    std::vector<unsigned int> candidate_lm_indices;
+    for (int cell = min_cell; cell <= max_cell; ++cell) {
+        const auto& lm_indices_in_cell = lm_indices_in_cells_.at(cell);
+        candidate_lm_indices.insert(candidate_lm_indices.end(), lm_indices_in_cell.begin(), lm_indices_in_cell.end());
+    }
+    std::sort(candidate_lm_indices.begin(), candidate_lm_indices.end());
+
+    std::vector<cv::KeyPoint> undist_keypts;
+    cv::Mat descriptors;
+    lm_indices.clear();
+    for (const auto lm_idx : candidate_lm_indices) {
+        Vec2_t reproj;
+        float x_right;
+        if (!camera_->reproject_to_image(rot_cw, trans_cw, pos_ws_.at(lm_idx), reproj, x_right)) {
+            continue;
+        }
+        const cv::Point2f pt(reproj(0) + rand_noise(mt_), reproj(1) + rand_noise(mt_));
+        undist_keypts.emplace_back(pt, 31.0f, 0.0f, 0.0f, 0);
+        descriptors.push_back(perturb_descriptor(lm_descriptors_.row(lm_idx), num_flipped_bits, mt_));
+        lm_indices.push_back(lm_idx);
+    }
+
+    // add the distractors
+    const auto num_distractors = static_cast<unsigned int>(distractor_ratio * lm_indices.size());
+    std::uniform_real_distribution<float> rand_x(0.0f, camera_->cols_);
+    std::uniform_real_distribution<float> rand_y(0.0f, camera_->rows_);
+    for (unsigned int i = 0; i < num_distractors; ++i) {
+        undist_keypts.emplace_back(cv::Point2f(rand_x(mt_), rand_y(mt_)), 31.0f, 0.0f, 0.0f, 0);
+        lm_indices.push_back(-1);
+    }
+    if (0 < num_distractors) {
+        descriptors.push_back(create_random_descriptors(num_distractors, mt_));
+    }
+
+    eigen_alloc_vector<Vec3_t> bearings;
+    camera_->convert_keypoints_to_bearings(undist_keypts, bearings);
+    const auto keypt_indices_in_cells = data::assign_keypoints_to_grid(camera_.get(), undist_keypts);
+    return data::frame_observation(undist_keypts.size(), descriptors, undist_keypts, bearings, {}, {}, keypt_indices_in_cells);
+}
+
+void synthetic_map::index_landmarks() {
+    double max_x = min_x_;
+    for (const auto& pos_w : pos_ws_) {
+        max_x = std::max(max_x, pos_w(0));
+    }
+    lm_indices_in_cells_.clear();
+    lm_indices_in_cells_.resize(static_cast<unsigned int>(std::floor((max_x - min_x_) / cell_width)) + 1);
+    for (unsigned int lm_idx = 0; lm_idx < pos_ws_.size(); ++lm_idx) {
+        const auto cell = static_cast<unsigned int>(std::floor((pos_ws_.at(lm_idx)(0) - min_x_) / cell_width));
+        lm_indices_in_cells_.at(cell).push_back(lm_idx);
+    }
+}
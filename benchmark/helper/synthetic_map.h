@@ -0,0 +1,161 @@
+#ifndef STELLA_VSLAM_BENCHMARK_HELPER_SYNTHETIC_MAP_H
+#define STELLA_VSLAM_BENCHMARK_HELPER_SYNTHETIC_MAP_H
+
+#include "stella_vslam/type.h"
+#include "stella_vslam/data/frame.h"
+#include "stella_vslam/data/frame_observation.h"
+
+#include <memory>
+#include <random>
+#include <vector>
+
+#include <opencv2/core/mat.hpp>
+
+namespace stella_vslam {
+
+namespace data {
+class keyframe;
+class landmark;
+class map_database;
+} // namespace data
+
+} // namespace stella_vslam
+
+using namespace stella_vslam;
+
+/**
+ * Create random ORB descriptors
+ * @param num_descriptors
+ * @param mt
+ * @return descriptors (one per row)
+ */
+cv::Mat create_random_descriptors(const unsigned int num_descriptors, std::mt19937& mt);
+
+/**
+ * Flip the random bits of the descriptor
+ * @param desc
+ * @param num_flipped_bits
+ * @param mt
+ * @return the perturbed descriptor
+ */
+cv::Mat perturb_descriptor(const cv::Mat& desc, const unsigned int num_flipped_bits, std::mt19937& mt);
+
+/**
+ * Synthetic map for the benchmarks
+ * The keyframes are placed along the x-axis looking at the landmarks scattered in front of them,
+ * and the keypoints are the noisy reprojections of the landmarks with the perturbed descriptors.
+ * The keyframes are connected in the covisibility graph and the spanning tree as in the mapping module.
+ * (NOTE: all of the random values are drawn from the given seed, then the map is reproducible)
+ * (NOTE: the landmarks are indexed along the trajectory, then a map of 100k keyframes can be created
+ *        if the number of the landmarks is proportional to the number of the keyframes)
+ */
+class synthetic_map {
+public:
+    /**
+     * Constructor
+     * @param num_keyframes
+     * @param num_landmarks
+     * @param seed
+     */
+    synthetic_map(const unsigned int num_keyframes, const unsigned int num_landmarks, const unsigned int seed = 0);
+
+    /**
+     * Destructor
+     */
+    ~synthetic_map();
+
+    /**
+     * Create the camera of the synthetic maps (e.g. to register a copy to a camera database which owns it)
+     * @return
+     */
+    static camera::base* create_camera();
+
+    /**
+     * Create the ORB parameters of the synthetic maps (e.g. to register a copy to an ORB parameters database which owns it)
+     * @return
+     */
+    static feature::orb_params* create_orb_params();
+
+    /**
+     * Get the camera pose at the position along the trajectory
+     * @param position
+     * @return pose_cw
+     */
+    static Mat44_t get_pose_cw(const double position);
+
+    /**
+     * Create the observation of the landmarks from the camera pose
+     * @param pose_cw
+     * @param observed_lms landmarks associated to the keypoints (nullptr for the distractors)
+     * @return frame observation
+     */
+    data::frame_observation create_observation(const Mat44_t& pose_cw, std::vector<std::shared_ptr<data::landmark>>& observed_lms);
+
+    /**
+     * Create a frame at the camera pose (the landmarks are not associated to the frame)
+     * @param pose_cw
+     * @param observed_lms landmarks which are actually observed in the frame
+     * @return frame
+     */
+    data::frame create_frame(const Mat44_t& pose_cw, std::vector<std::shared_ptr<data::landmark>>& observed_lms);
+
+    /**
+     * Create the keypoint matches between the keyframes via the landmarks observed in both of them
+     * @param keyfrm_idx_1 index of the first keyframe in keyframes_
+     * @param keyfrm_idx_2 index of the second keyframe in keyframes_
+     * @param outlier_ratio ratio of the matches which are replaced with random keypoints
+     * @return matches (pairs of the keypoint indices)
+     */
+    std::vector<std::pair<int, int>> create_matches(const unsigned int keyfrm_idx_1, const unsigned int keyfrm_idx_2, const double outlier_ratio);
+
+    //! Restore the camera poses of the keyframes and the positions of the landmarks (e.g. after an optimization)
+    void restore();
+
+    //! Perturb the camera poses of the keyframes and the positions of the landmarks
+    void perturb(const double rot_stddev, const double trans_stddev, const double pos_stddev);
+
+    //! camera (perspective, without distortion)
+    std::unique_ptr<camera::base> camera_;
+    //! ORB parameters
+    std::unique_ptr<feature::orb_params> orb_params_;
+    //! map database which holds the keyframes and the landmarks
+    std::unique_ptr<data::map_database> map_db_;
+    //! keyframes in the order of the creation
+    std::vector<std::shared_ptr<data::keyframe>> keyframes_;
+    //! landmarks in the order of the creation
+    std::vector<std::shared_ptr<data::landmark>> landmarks_;
+
+private:
+    //! Observe the landmarks from the camera pose (lm_indices are the indices of the landmarks, or -1 for the distractors)
+    data::frame_observation observe(const Mat44_t& pose_cw, std::vector<int>& lm_indices);
+
+    //! Assign the landmarks to the cells along the x-axis
+    void index_landmarks();
+
+    //! random engine
+    std::mt19937 mt_;
+    //! ground truth of the landmark positions
+    eigen_alloc_vector<Vec3_t> pos_ws_;
+    //! ground truth of the keyframe poses
+    eigen_alloc_vector<Mat44_t> poses_cw_;
+    //! descriptors of the landmarks (one per row)
+    cv::Mat lm_descriptors_;
+    //! indices of the landmarks in each cell along the x-axis (the first cell starts at min_x_)
+    std::vector<std::vector<unsigned int>> lm_indices_in_cells_;
+    //! lower bound of the x-coordinates of the landmarks
+    double min_x_ = 0.0;
+    //! next timestamp of the created frames
+    double timestamp_ = 0.0;
+};
+
+/**
+ * Get the synthetic map shared by the benchmarks (thread-safe)
+ * (NOTE: only the last requested map is kept, then register the benchmarks in the order of the sizes to create each map once,
+ *        and the benchmarks which modify the map must restore it)
+ * @param num_keyframes
+ * @param num_landmarks
+ * @return
+ */
+synthetic_map& get_shared_synthetic_map(const unsigned int num_keyframes, const unsigned int num_landmarks);
+
+#endif // STELLA_VSLAM_BENCHMARK_HELPER_SYNTHETIC_MAP_H
@@ -0,0 +1,26 @@
+#include "helper/bow_vocabulary.h"
+#include "helper/synthetic_map.h"
+
+#include <benchmark/benchmark.h>
+
+using namespace stella_vslam;
+
+static void bow_vocabulary_compute_bow(benchmark::State& state) {
+    auto bow_vocab = get_bow_vocabulary();
+    if (!bow_vocab) {
+        state.SkipWithError("BOW_VOCAB is not set");
+        return;
+    }
+    const auto num_descriptors = static_cast<unsigned int>(state.range(0));
+    std::mt19937 mt(0);
+    const auto descriptors = create_random_descriptors(num_descriptors, mt);
+
+    data::bow_vector bow_vec;
+    data::bow_feature_vector bow_feat_vec;
+    for (auto _ : state) {
+        data::bow_vocabulary_util::compute_bow(bow_vocab, descriptors, bow_vec, bow_feat_vec);
+        benchmark::DoNotOptimize(bow_vec);
+    }
+    state.SetItemsProcessed(state.iterations() * num_descriptors);
+}
+BENCHMARK(bow_vocabulary_compute_bow)->Arg(1000)->Arg(2000)->Unit(benchmark::kMicrosecond);
@@ -0,0 +1,227 @@
+#include "helper/bow_vocabulary.h"
+#include "helper/synthetic_map.h"
+
+#include "stella_vslam/data/bow_database.h"
+#include "stella_vslam/data/graph_node.h"
+#include "stella_vslam/data/keyframe.h"
+#include "stella_vslam/data/landmark.h"
+#include "stella_vslam/data/map_database.h"
+
+#include <string>
+#include <unordered_map>
+
+#include <benchmark/benchmark.h>
+
+using namespace stella_vslam;
+
+namespace {
+
+// number of the landmarks per keyframe of the synthetic maps (about 100 landmarks are observed in each keyframe)
+constexpr unsigned int num_landmarks_per_keyframe = 2;
+
+synthetic_map& get_map(const benchmark::State& state) {
+    const auto num_keyframes = static_cast<unsigned int>(state.range(0));
+    return get_shared_synthetic_map(num_keyframes, num_landmarks_per_keyframe * num_keyframes);
+}
+
+// keyframe in the middle of the trajectory (the operations on it are not affected by the ends of the map)
+const std::shared_ptr<data::keyframe>& get_middle_keyframe(const synthetic_map& map) {
+    return map.keyframes_.at(map.keyframes_.size() / 2);
+}
+
+// restore the parents of the keyframes in the spanning tree after recover_spanning_connections()
+void restore_spanning_parents(const std::unordered_map<std::shared_ptr<data::keyframe>, std::shared_ptr<data::keyframe>>& parents) {
+    for (const auto& keyfrm_parent : parents) {
+        const auto& keyfrm = keyfrm_parent.first;
+        const auto current_parent = keyfrm->graph_node_->get_spanning_parent();
+        if (current_parent) {
+            current_parent->graph_node_->erase_spanning_child(keyfrm);
+        }
+        keyfrm->graph_node_->change_spanning_parent(keyfrm_parent.second);
+    }
+}
+
+// writer of the concurrent benchmarks: insert and erase a landmark
+void add_and_erase_landmark(synthetic_map& map) {
+    auto lm = data::landmark::create(map.map_db_->next_landmark_id_++, Vec3_t{0.0, 0.0, 20.0}, get_middle_keyframe(map));
+    map.map_db_->add_landmark(lm);
+    map.map_db_->erase_landmark(lm->id_);
+}
+
+} // namespace
+
+static void map_database_get_close_keyframes(benchmark::State& state) {
+    auto& map = get_map(state);
+    const Mat44_t pose_cw = get_middle_keyframe(map)->get_pose_cw();
+    size_t num_close_keyfrms = 0;
+    for (auto _ : state) {
+        const auto close_keyfrms = map.map_db_->get_close_keyframes(pose_cw, 2.0, 0.5);
+        num_close_keyfrms = close_keyfrms.size();
+        benchmark::DoNotOptimize(close_keyfrms);
+    }
+    state.counters["num_close_keyframes"] = num_close_keyfrms;
+}
+
+static void map_database_get_all_landmarks(benchmark::State& state) {
+    auto& map = get_map(state);
+    for (auto _ : state) {
+        const auto lms = map.map_db_->get_all_landmarks();
+        benchmark::DoNotOptimize(lms);
+    }
+    state.counters["num_landmarks"] = map.landmarks_.size();
+}
+
+static void map_database_add_and_erase_keyframe(benchmark::State& state) {
+    auto& map = get_map(state);
+    const auto keyfrm = get_middle_keyframe(map);
+    for (auto _ : state) {
+        map.map_db_->erase_keyframe(keyfrm);
+        map.map_db_->add_keyframe(keyfrm);
+    }
+}
+
+static void map_database_add_and_erase_landmark(benchmark::State& state) {
+    auto& map = get_map(state);
+    for (auto _ : state) {
+        add_and_erase_landmark(map);
+    }
+}
+
+static void graph_node_update_connections(benchmark::State& state) {
+    auto& map = get_map(state);
+    const auto keyfrm = get_middle_keyframe(map);
+    for (auto _ : state) {
+        keyfrm->graph_node_->update_connections(15);
+    }
+    state.counters["num_covisibilities"] = keyfrm->graph_node_->get_covisibilities().size();
+}
+
+static void graph_node_recover_spanning_connections(benchmark::State& state) {
+    auto& map = get_map(state);
+    // erase every other keyframe in the middle of the trajectory
+    const auto num_erased_keyfrms = static_cast<unsigned int>(state.range(1));
+    const auto first_idx = map.keyframes_.size() / 2;
+    std::vector<std::shared_ptr<data::keyframe>> erased_keyfrms;
+    std::unordered_map<std::shared_ptr<data::keyframe>, std::shared_ptr<data::keyframe>> parents;
+    for (unsigned int i = 0; i < num_erased_keyfrms; ++i) {
+        const auto& keyfrm = map.keyframes_.at(first_idx + 2 * i);
+        erased_keyfrms.push_back(keyfrm);
+        parents[keyfrm] = keyfrm->graph_node_->get_spanning_parent();
+        for (const auto& child : keyfrm->graph_node_->get_spanning_children()) {
+            parents[child] = keyfrm;
+        }
+    }
+
+    for (auto _ : state) {
+        if (erased_keyfrms.size() == 1) {
+            erased_keyfrms.front()->graph_node_->recover_spanning_connections();
+        }
+        else {
+            data::graph_node::recover_spanning_connections(erased_keyfrms);
+        }
+        state.PauseTiming();
+        restore_spanning_parents(parents);
+        state.ResumeTiming();
+    }
+}
+
+static void bow_database_acquire_keyframes(benchmark::State& state) {
+    auto bow_vocab = get_bow_vocabulary();
+    if (!bow_vocab) {
+        state.SkipWithError("BOW_VOCAB is not set");
+        return;
+    }
+    auto& map = get_map(state);
+    data::bow_database bow_db(bow_vocab);
+    for (const auto& keyfrm : map.keyframes_) {
+        keyfrm->compute_bow(bow_vocab);
+    }
+    bow_db.add_keyframes(map.keyframes_);
+
+    // (the query is not one of the keyframes in the database, as in the loop detection)
+    std::vector<std::shared_ptr<data::landmark>> observed_lms;
+    const auto frm_obs = map.create_observation(get_middle_keyframe(map)->get_pose_cw(), observed_lms);
+    data::bow_vector bow_vec;
+    data::bow_feature_vector bow_feat_vec;
+    data::bow_vocabulary_util::compute_bow(bow_vocab, frm_obs.descriptors_, bow_vec, bow_feat_vec);
+
+    size_t num_acquired_keyfrms = 0;
+    for (auto _ : state) {
+        const auto keyfrms = bow_db.acquire_keyframes(bow_vec, 0.0f);
+        num_acquired_keyfrms = keyfrms.size();
+        benchmark::DoNotOptimize(keyfrms);
+    }
+    state.counters["num_acquired_keyframes"] = num_acquired_keyfrms;
+    bow_db.clear();
+}
+
+// the first thread inserts and erases the landmarks while the others read the map
+static void map_database_concurrent_get_close_keyframes(benchmark::State& state) {
+    auto& map = get_map(state);
+    const Mat44_t pose_cw = get_middle_keyframe(map)->get_pose_cw();
+    const bool is_writer = state.thread_index() == 0;
+    for (auto _ : state) {
+        if (is_writer) {
+            add_and_erase_landmark(map);
+        }
+        else {
+            const auto close_keyfrms = map.map_db_->get_close_keyframes(pose_cw, 2.0, 0.5);
+            benchmark::DoNotOptimize(close_keyfrms);
+        }
+    }
+}
+
+static void map_database_concurrent_get_all_landmarks(benchmark::State& state) {
+    auto& map = get_map(state);
+    const bool is_writer = state.thread_index() == 0;
+    for (auto _ : state) {
+        if (is_writer) {
+            add_and_erase_landmark(map);
+        }
+        else {
+            const auto lms = map.map_db_->get_all_landmarks();
+            benchmark::DoNotOptimize(lms);
+        }
+    }
+}
+
+// (registered for each size in turn instead of BENCHMARK, so that each shared synthetic map is created once)
+static const bool map_database_benchmarks_are_registered = [] {
+    for (const int num_keyframes : {1000, 10000, 100000}) {
+        benchmark::RegisterBenchmark("map_database_get_close_keyframes", map_database_get_close_keyframes)
+            ->Arg(num_keyframes)
+            ->Unit(benchmark::kMicrosecond);
+        benchmark::RegisterBenchmark("map_database_get_all_landmarks", map_database_get_all_landmarks)
+            ->Arg(num_keyframes)
+            ->Unit(benchmark::kMicrosecond);
+        benchmark::RegisterBenchmark("map_database_add_and_erase_keyframe", map_database_add_and_erase_keyframe)
+            ->Arg(num_keyframes)
+            ->Unit(benchmark::kMicrosecond);
+        benchmark::RegisterBenchmark("map_database_add_and_erase_landmark", map_database_add_and_erase_landmark)
+            ->Arg(num_keyframes)
+            ->Unit(benchmark::kMicrosecond);
+        benchmark::RegisterBenchmark("graph_node_update_connections", graph_node_update_connections)
+            ->Arg(num_keyframes)
+            ->Unit(benchmark::kMicrosecond);
+        benchmark::RegisterBenchmark("graph_node_recover_spanning_connections", graph_node_recover_spanning_connections)
+            ->Args({num_keyframes, 1})
+            ->Args({num_keyframes, 16})
+            ->Unit(benchmark::kMicrosecond);
+        benchmark::RegisterBenchmark("bow_database_acquire_keyframes", bow_database_acquire_keyframes)
+            ->Arg(num_keyframes)
+            ->Unit(benchmark::kMicrosecond);
+        benchmark::RegisterBenchmark("map_database_concurrent_get_close_keyframes", map_database_concurrent_get_close_keyframes)
+            ->Arg(num_keyframes)
+            ->Threads(2)
+            ->Threads(4)
+            ->UseRealTime()
+            ->Unit(benchmark::kMicrosecond);
+        benchmark::RegisterBenchmark("map_database_concurrent_get_all_landmarks", map_database_concurrent_get_all_landmarks)
+            ->Arg(num_keyframes)
+            ->Threads(2)
+            ->Threads(4)
+            ->UseRealTime()
+            ->Unit(benchmark::kMicrosecond);
+    }
+    return true;
+}();
@@ -0,0 +1,59 @@
+#include "stella_vslam/feature/orb_extractor.h"
+#include "stella_vslam/feature/orb_params.h"
+
+#include <opencv2/core/mat.hpp>
+#include <opencv2/core/types.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <benchmark/benchmark.h>
+
+using namespace stella_vslam;
+
+namespace {
+
+// create a textured image by drawing the random rectangles and circles
+cv::Mat create_textured_image(const int cols, const int rows, const uint64_t seed) {
+    cv::RNG rng(seed);
+    cv::Mat img(rows, cols, CV_8UC1, cv::Scalar(128));
+    // keep the density of the shapes independent of the resolution
+    const int num_shapes = cols * rows / 1000;
+    for (int i = 0; i < num_shapes; ++i) {
+        const cv::Point2i pt(rng.uniform(0, cols), rng.uniform(0, rows));
+        const cv::Scalar color(rng.uniform(0, 256));
+        if (i % 2 == 0) {
+            const cv::Point2i size(rng.uniform(5, 50), rng.uniform(5, 50));
+            cv::rectangle(img, pt, pt + size, color, -1);
+        }
+        else {
+            cv::circle(img, pt, rng.uniform(3, 30), color, -1, cv::LINE_AA);
+        }
+    }
+    return img;
+}
+
+} // namespace
+
+static void orb_extractor_extract(benchmark::State& state) {
+    const auto cols = static_cast<int>(state.range(0));
+    const auto rows = static_cast<int>(state.range(1));
+    const auto max_num_keypts = static_cast<unsigned int>(state.range(2));
+
+    const auto params = feature::orb_params("ORB setting for benchmark");
+    auto extractor = feature::orb_extractor(&params, max_num_keypts);
+    const auto img = create_textured_image(cols, rows, 0);
+    const auto mask = cv::Mat();
+
+    std::vector<cv::KeyPoint> keypts;
+    cv::Mat desc;
+    for (auto _ : state) {
+        extractor.extract(img, mask, keypts, desc);
+        benchmark::DoNotOptimize(desc.data);
+    }
+    state.counters["num_keypts"] = keypts.size();
+}
+BENCHMARK(orb_extractor_extract)
+    ->Args({640, 480, 1000})
+    ->Args({1280, 720, 2000})
+    ->Args({1920, 1080, 2000})
+    ->Args({3840, 1920, 4000})
+    ->Unit(benchmark::kMillisecond);
@@ -0,0 +1,120 @@
+#include "helper/bow_vocabulary.h"
+#include "helper/memory_usage.h"
+#include "helper/synthetic_map.h"
+
+#include "stella_vslam/data/bow_database.h"
+#include "stella_vslam/data/camera_database.h"
+#include "stella_vslam/data/map_database.h"
+#include "stella_vslam/data/orb_params_database.h"
+#include "stella_vslam/io/map_database_io_factory.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+
+#include <benchmark/benchmark.h>
+
+using namespace stella_vslam;
+
+namespace {
+
+// number of the landmarks per keyframe of the synthetic maps (about 100 landmarks are observed in each keyframe)
+constexpr unsigned int num_landmarks_per_keyframe = 2;
+
+// the map files are written to MAP_IO_BENCHMARK_DIR (or /tmp if not set)
+std::string get_map_path(const std::string& map_format) {
+    const auto dir_env = std::getenv("MAP_IO_BENCHMARK_DIR");
+    const std::string dir = dir_env ? dir_env : "/tmp";
+    return dir + "/stella_vslam_map_io_benchmark." + map_format;
+}
+
+void save_synthetic_map(const std::string& map_format, const std::string& path, const synthetic_map& map) {
+    data::camera_database cam_db;
+    cam_db.add_camera(synthetic_map::create_camera());
+    data::orb_params_database orb_params_db;
+    orb_params_db.add_orb_params(synthetic_map::create_orb_params());
+    std::remove(path.c_str());
+    io::map_database_io_factory::create(map_format)->save(path, &cam_db, &orb_params_db, map.map_db_.get());
+}
+
+} // namespace
+
+static void map_database_io_save(benchmark::State& state, const std::string& map_format) {
+    const auto num_keyframes = static_cast<unsigned int>(state.range(0));
+    const auto& map = get_shared_synthetic_map(num_keyframes, num_landmarks_per_keyframe * num_keyframes);
+    const auto path = get_map_path(map_format);
+
+    reset_peak_rss();
+    const auto rss_before = get_current_rss_bytes();
+    for (auto _ : state) {
+        save_synthetic_map(map_format, path, map);
+    }
+    const auto peak_rss = get_peak_rss_bytes();
+
+    const auto file_size = get_file_size(path);
+    state.SetItemsProcessed(state.iterations() * num_keyframes);
+    state.SetBytesProcessed(state.iterations() * file_size);
+    state.counters["num_landmarks"] = map.landmarks_.size();
+    state.counters["file_size_MB"] = file_size / 1e6;
+    state.counters["peak_rss_increase_MB"] = (rss_before < peak_rss) ? (peak_rss - rss_before) / 1e6 : 0.0;
+    std::remove(path.c_str());
+}
+
+static void map_database_io_load(benchmark::State& state, const std::string& map_format) {
+    // the BoW of the keyframes is computed while loading
+    auto bow_vocab = get_bow_vocabulary();
+    if (!bow_vocab) {
+        state.SkipWithError("BOW_VOCAB is not set");
+        return;
+    }
+    const auto num_keyframes = static_cast<unsigned int>(state.range(0));
+    const auto path = get_map_path(map_format);
+    save_synthetic_map(map_format, path, get_shared_synthetic_map(num_keyframes, num_landmarks_per_keyframe * num_keyframes));
+
+    size_t peak_rss_increase = 0;
+    size_t num_landmarks = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        std::unique_ptr<data::camera_database> cam_db(new data::camera_database());
+        std::unique_ptr<data::orb_params_database> orb_params_db(new data::orb_params_database());
+        std::unique_ptr<data::map_database> map_db(new data::map_database(15));
+        std::unique_ptr<data::bow_database> bow_db(new data::bow_database(bow_vocab));
+        reset_peak_rss();
+        const auto rss_before = get_current_rss_bytes();
+        state.ResumeTiming();
+
+        io::map_database_io_factory::create(map_format)->load(path, cam_db.get(), orb_params_db.get(), map_db.get(), bow_db.get(), bow_vocab);
+
+        state.PauseTiming();
+        const auto peak_rss = get_peak_rss_bytes();
+        peak_rss_increase = std::max(peak_rss_increase, (rss_before < peak_rss) ? peak_rss - rss_before : 0);
+        num_landmarks = map_db->get_num_landmarks();
+        bow_db->clear();
+        map_db->clear();
+        state.ResumeTiming();
+    }
+
+    const auto file_size = get_file_size(path);
+    state.SetItemsProcessed(state.iterations() * num_keyframes);
+    state.SetBytesProcessed(state.iterations() * file_size);
+    state.counters["num_landmarks"] = num_landmarks;
+    state.counters["file_size_MB"] = file_size / 1e6;
+    state.counters["peak_rss_increase_MB"] = peak_rss_increase / 1e6;
+    std::remove(path.c_str());
+}
+
+// (registered for each size in turn instead of BENCHMARK_CAPTURE, so that each shared synthetic map is created once)
+static const bool map_database_io_benchmarks_are_registered = [] {
+    for (const unsigned int num_keyframes : {1000u, 10000u, 100000u}) {
+        for (const std::string map_format : {"msgpack", "sqlite3", "binary"}) {
+            benchmark::RegisterBenchmark(("map_database_io_save/" + map_format).c_str(), map_database_io_save, map_format)
+                ->Arg(num_keyframes)
+                ->Unit(benchmark::kMillisecond);
+            benchmark::RegisterBenchmark(("map_database_io_load/" + map_format).c_str(), map_database_io_load, map_format)
+                ->Arg(num_keyframes)
+                ->Unit(benchmark::kMillisecond);
+        }
+    }
+    return true;
+}();
@@ -0,0 +1,41 @@
+#include "helper/synthetic_map.h"
+
+#include "stella_vslam/match/base.h"
+
+#include <benchmark/benchmark.h>
+
+using namespace stella_vslam;
+
+static void base_compute_descriptor_distance_32(benchmark::State& state) {
+    const auto num_descriptors = static_cast<unsigned int>(state.range(0));
+    std::mt19937 mt(0);
+    const auto descs_1 = create_random_descriptors(num_descriptors, mt);
+    const auto descs_2 = create_random_descriptors(num_descriptors, mt);
+
+    for (auto _ : state) {
+        unsigned int sum = 0;
+        for (unsigned int i = 0; i < num_descriptors; ++i) {
+            sum += match::compute_descriptor_distance_32(descs_1.row(i), descs_2.row(i));
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * num_descriptors);
+}
+BENCHMARK(base_compute_descriptor_distance_32)->Arg(1000)->Arg(10000);
+
+static void base_compute_descriptor_distance_64(benchmark::State& state) {
+    const auto num_descriptors = static_cast<unsigned int>(state.range(0));
+    std::mt19937 mt(0);
+    const auto descs_1 = create_random_descriptors(num_descriptors, mt);
+    const auto descs_2 = create_random_descriptors(num_descriptors, mt);
+
+    for (auto _ : state) {
+        unsigned int sum = 0;
+        for (unsigned int i = 0; i < num_descriptors; ++i) {
+            sum += match::compute_descriptor_distance_64(descs_1.row(i), descs_2.row(i));
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * num_descriptors);
+}
+BENCHMARK(base_compute_descriptor_distance_64)->Arg(1000)->Arg(10000);
@@ -0,0 +1,61 @@
+#include "helper/bow_vocabulary.h"
+#include "helper/synthetic_map.h"
+
+#include "stella_vslam/data/frame.h"
+#include "stella_vslam/data/keyframe.h"
+#include "stella_vslam/match/bow_tree.h"
+
+#include <benchmark/benchmark.h>
+
+using namespace stella_vslam;
+
+static void bow_tree_match_frame_and_keyframe(benchmark::State& state) {
+    auto bow_vocab = get_bow_vocabulary();
+    if (!bow_vocab) {
+        state.SkipWithError("BOW_VOCAB is not set");
+        return;
+    }
+    const auto num_landmarks = static_cast<unsigned int>(state.range(0));
+    synthetic_map map(10, num_landmarks, 0);
+
+    const auto& keyfrm = map.keyframes_.at(4);
+    keyfrm->compute_bow(bow_vocab);
+    std::vector<std::shared_ptr<data::landmark>> observed_lms;
+    auto frm = map.create_frame(synthetic_map::get_pose_cw(2.25), observed_lms);
+    frm.compute_bow(bow_vocab);
+
+    const match::bow_tree bow_matcher(0.7, true);
+    std::vector<std::shared_ptr<data::landmark>> matched_lms_in_frm;
+    unsigned int num_matches = 0;
+    for (auto _ : state) {
+        num_matches = bow_matcher.match_frame_and_keyframe(keyfrm, frm, matched_lms_in_frm);
+        benchmark::DoNotOptimize(num_matches);
+    }
+    state.counters["num_matches"] = num_matches;
+}
+BENCHMARK(bow_tree_match_frame_and_keyframe)->Arg(2000)->Arg(8000)->Unit(benchmark::kMicrosecond);
+
+static void bow_tree_match_keyframes(benchmark::State& state) {
+    auto bow_vocab = get_bow_vocabulary();
+    if (!bow_vocab) {
+        state.SkipWithError("BOW_VOCAB is not set");
+        return;
+    }
+    const auto num_landmarks = static_cast<unsigned int>(state.range(0));
+    synthetic_map map(10, num_landmarks, 0);
+
+    const auto& keyfrm_1 = map.keyframes_.at(4);
+    const auto& keyfrm_2 = map.keyframes_.at(5);
+    keyfrm_1->compute_bow(bow_vocab);
+    keyfrm_2->compute_bow(bow_vocab);
+
+    const match::bow_tree bow_matcher(0.75, false);
+    std::vector<std::shared_ptr<data::landmark>> matched_lms_in_keyfrm_1;
+    unsigned int num_matches = 0;
+    for (auto _ : state) {
+        num_matches = bow_matcher.match_keyframes(keyfrm_1, keyfrm_2, matched_lms_in_keyfrm_1);
+        benchmark::DoNotOptimize(num_matches);
+    }
+    state.counters["num_matches"] = num_matches;
+}
+BENCHMARK(bow_tree_match_keyframes)->Arg(2000)->Arg(8000)->Unit(benchmark::kMicrosecond);
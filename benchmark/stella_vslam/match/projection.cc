@@ -0,0 +1,50 @@
+#include "helper/synthetic_map.h"
+
+#include "stella_vslam/data/frame.h"
+#include "stella_vslam/data/landmark.h"
+#include "stella_vslam/match/projection.h"
+
+#include <benchmark/benchmark.h>
+
+using namespace stella_vslam;
+
+static void projection_match_frame_and_landmarks(benchmark::State& state) {
+    const auto num_landmarks = static_cast<unsigned int>(state.range(0));
+    synthetic_map map(10, num_landmarks, 0);
+
+    // the current frame is placed between the keyframes
+    std::vector<std::shared_ptr<data::landmark>> observed_lms;
+    auto frm = map.create_frame(synthetic_map::get_pose_cw(2.25), observed_lms);
+
+    // reproject all of the landmarks as in tracking_module::search_local_landmarks()
+    std::vector<bool> is_observable;
+    eigen_alloc_vector<Vec2_t> reprojs;
+    std::vector<float> x_rights;
+    std::vector<unsigned int> pred_scale_levels;
+    frm.can_observe(map.landmarks_, 0.5, is_observable, reprojs, x_rights, pred_scale_levels);
+    eigen_alloc_unord_map<unsigned int, Vec2_t> lm_to_reproj;
+    std::unordered_map<unsigned int, float> lm_to_x_right;
+    std::unordered_map<unsigned int, int> lm_to_scale;
+    for (unsigned int i = 0; i < map.landmarks_.size(); ++i) {
+        if (!is_observable.at(i)) {
+            continue;
+        }
+        const auto& lm = map.landmarks_.at(i);
+        lm_to_reproj[lm->id_] = reprojs.at(i);
+        lm_to_x_right[lm->id_] = x_rights.at(i);
+        lm_to_scale[lm->id_] = pred_scale_levels.at(i);
+    }
+
+    const match::projection projection_matcher(0.8);
+    unsigned int num_matches = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        frm.erase_landmarks();
+        state.ResumeTiming();
+        num_matches = projection_matcher.match_frame_and_landmarks(frm, map.landmarks_, lm_to_reproj, lm_to_x_right, lm_to_scale, 5.0);
+        benchmark::DoNotOptimize(num_matches);
+    }
+    state.counters["num_observable"] = lm_to_reproj.size();
+    state.counters["num_matches"] = num_matches;
+}
+BENCHMARK(projection_match_frame_and_landmarks)->Arg(2000)->Arg(8000)->Unit(benchmark::kMicrosecond);
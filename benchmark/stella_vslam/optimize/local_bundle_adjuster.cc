@@ -0,0 +1,33 @@
+#include "helper/synthetic_map.h"
+
+#include "stella_vslam/optimize/local_bundle_adjuster.h"
+
+#include <yaml-cpp/yaml.h>
+
+#include <benchmark/benchmark.h>
+
+using namespace stella_vslam;
+
+static void local_bundle_adjuster_optimize(benchmark::State& state) {
+    const auto num_keyframes = static_cast<unsigned int>(state.range(0));
+    const auto num_landmarks = static_cast<unsigned int>(state.range(1));
+    synthetic_map map(num_keyframes, num_landmarks, 0);
+
+    const YAML::Node yaml_node;
+    optimize::local_bundle_adjuster local_bundle_adjuster(yaml_node);
+    bool force_stop_flag = false;
+    for (auto _ : state) {
+        // start each optimization from the same perturbed map
+        state.PauseTiming();
+        map.restore();
+        map.perturb(0.005, 0.02, 0.05);
+        state.ResumeTiming();
+        local_bundle_adjuster.optimize(map.map_db_.get(), map.keyframes_.back(), &force_stop_flag);
+    }
+    state.counters["num_keyframes"] = map.keyframes_.size();
+    state.counters["num_landmarks"] = map.landmarks_.size();
+}
+BENCHMARK(local_bundle_adjuster_optimize)
+    ->Args({10, 2000})
+    ->Args({20, 4000})
+    ->Unit(benchmark::kMillisecond);
@@ -0,0 +1,43 @@
+#include "helper/synthetic_map.h"
+
+#include "stella_vslam/data/frame.h"
+#include "stella_vslam/optimize/pose_optimizer.h"
+#include "stella_vslam/util/converter.h"
+
+#include <random>
+
+#include <g2o/types/sba/types_six_dof_expmap.h>
+
+#include <benchmark/benchmark.h>
+
+using namespace stella_vslam;
+
+static void pose_optimizer_optimize(benchmark::State& state) {
+    const auto num_landmarks = static_cast<unsigned int>(state.range(0));
+    synthetic_map map(10, num_landmarks, 0);
+
+    // the current frame is placed between the keyframes, and associated with the observed landmarks
+    const Mat44_t pose_cw = synthetic_map::get_pose_cw(2.25);
+    std::vector<std::shared_ptr<data::landmark>> observed_lms;
+    auto frm = map.create_frame(pose_cw, observed_lms);
+    frm.set_landmarks(observed_lms);
+
+    // start the optimization from the perturbed pose
+    std::mt19937 mt(0);
+    std::normal_distribution<double> rand_rot(0.0, 0.01);
+    std::normal_distribution<double> rand_trans(0.0, 0.05);
+    const Mat33_t rot_cw = util::converter::to_rot_mat(Vec3_t{rand_rot(mt), rand_rot(mt), rand_rot(mt)}) * pose_cw.block<3, 3>(0, 0);
+    const Vec3_t trans_cw = pose_cw.block<3, 1>(0, 3) + Vec3_t{rand_trans(mt), rand_trans(mt), rand_trans(mt)};
+    frm.set_pose_cw(util::converter::to_eigen_pose(rot_cw, trans_cw));
+
+    const optimize::pose_optimizer pose_optimizer;
+    unsigned int num_valid_obs = 0;
+    for (auto _ : state) {
+        g2o::SE3Quat optimized_pose;
+        std::vector<bool> outlier_flags;
+        num_valid_obs = pose_optimizer.optimize(frm, optimized_pose, outlier_flags);
+        benchmark::DoNotOptimize(optimized_pose);
+    }
+    state.counters["num_valid_obs"] = num_valid_obs;
+}
+BENCHMARK(pose_optimizer_optimize)->Arg(2000)->Arg(8000)->Unit(benchmark::kMicrosecond);
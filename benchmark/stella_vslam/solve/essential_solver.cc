@@ -0,0 +1,36 @@
+#include "helper/synthetic_map.h"
+
+#include "stella_vslam/data/keyframe.h"
+#include "stella_vslam/solve/essential_solver.h"
+
+#include <algorithm>
+
+#include <benchmark/benchmark.h>
+
+using namespace stella_vslam;
+
+static void essential_solver_find_via_ransac(benchmark::State& state) {
+    const auto num_landmarks = static_cast<unsigned int>(state.range(0));
+    const double outlier_ratio = state.range(1) / 100.0;
+    synthetic_map map(5, num_landmarks, 0);
+    const auto matches_12 = map.create_matches(0, 4, outlier_ratio);
+    const auto& bearings_1 = map.keyframes_.at(0)->frm_obs_.bearings_;
+    const auto& bearings_2 = map.keyframes_.at(4)->frm_obs_.bearings_;
+
+    unsigned int num_inliers = 0;
+    for (auto _ : state) {
+        solve::essential_solver solver(bearings_1, bearings_2, matches_12, true);
+        solver.find_via_ransac(100);
+        const auto is_inlier_match = solver.get_inlier_matches();
+        num_inliers = std::count(is_inlier_match.begin(), is_inlier_match.end(), true);
+        benchmark::DoNotOptimize(num_inliers);
+    }
+    state.counters["num_matches"] = matches_12.size();
+    state.counters["num_inliers"] = num_inliers;
+}
+BENCHMARK(essential_solver_find_via_ransac)
+    ->Args({1000, 10})
+    ->Args({1000, 50})
+    ->Args({4000, 10})
+    ->Args({4000, 50})
+    ->Unit(benchmark::kMicrosecond);
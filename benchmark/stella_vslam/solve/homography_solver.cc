@@ -0,0 +1,37 @@
+#include "helper/synthetic_map.h"
+
+#include "stella_vslam/data/keyframe.h"
+#include "stella_vslam/solve/homography_solver.h"
+
+#include <algorithm>
+
+#include <benchmark/benchmark.h>
+
+using namespace stella_vslam;
+
+static void homography_solver_find_via_ransac(benchmark::State& state) {
+    const auto num_landmarks = static_cast<unsigned int>(state.range(0));
+    const double outlier_ratio = state.range(1) / 100.0;
+    synthetic_map map(5, num_landmarks, 0);
+    // (the scene is not planar, then this measures the case where the iterations are not terminated early)
+    const auto matches_12 = map.create_matches(0, 4, outlier_ratio);
+    const auto& undist_keypts_1 = map.keyframes_.at(0)->frm_obs_.undist_keypts_;
+    const auto& undist_keypts_2 = map.keyframes_.at(4)->frm_obs_.undist_keypts_;
+
+    unsigned int num_inliers = 0;
+    for (auto _ : state) {
+        solve::homography_solver solver(undist_keypts_1, undist_keypts_2, matches_12, 1.0, true);
+        solver.find_via_ransac(100);
+        const auto is_inlier_match = solver.get_inlier_matches();
+        num_inliers = std::count(is_inlier_match.begin(), is_inlier_match.end(), true);
+        benchmark::DoNotOptimize(num_inliers);
+    }
+    state.counters["num_matches"] = matches_12.size();
+    state.counters["num_inliers"] = num_inliers;
+}
+BENCHMARK(homography_solver_find_via_ransac)
+    ->Args({1000, 10})
+    ->Args({1000, 50})
+    ->Args({4000, 10})
+    ->Args({4000, 50})
+    ->Unit(benchmark::kMicrosecond);
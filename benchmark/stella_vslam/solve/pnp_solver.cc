@@ -0,0 +1,57 @@
+#include "helper/synthetic_map.h"
+
+#include "stella_vslam/data/keyframe.h"
+#include "stella_vslam/data/landmark.h"
+#include "stella_vslam/solve/pnp_solver.h"
+
+#include <algorithm>
+
+#include <benchmark/benchmark.h>
+
+using namespace stella_vslam;
+
+static void pnp_solver_find_via_ransac(benchmark::State& state) {
+    const auto num_landmarks = static_cast<unsigned int>(state.range(0));
+    const double outlier_ratio = state.range(1) / 100.0;
+    synthetic_map map(5, num_landmarks, 0);
+
+    // 2D-3D matches of the keyframe (the landmark positions of the outliers are shuffled)
+    const auto& keyfrm = map.keyframes_.at(2);
+    const auto lms = keyfrm->get_landmarks();
+    eigen_alloc_vector<Vec3_t> valid_bearings;
+    std::vector<cv::KeyPoint> valid_keypts;
+    eigen_alloc_vector<Vec3_t> valid_landmarks;
+    for (unsigned int idx = 0; idx < lms.size(); ++idx) {
+        if (!lms.at(idx)) {
+            continue;
+        }
+        valid_bearings.push_back(keyfrm->frm_obs_.bearings_.at(idx));
+        valid_keypts.push_back(keyfrm->frm_obs_.undist_keypts_.at(idx));
+        valid_landmarks.push_back(lms.at(idx)->get_pos_in_world());
+    }
+    std::mt19937 mt(0);
+    std::uniform_real_distribution<double> rand_ratio(0.0, 1.0);
+    std::uniform_int_distribution<int> rand_idx(0, valid_landmarks.size() - 1);
+    for (auto& valid_landmark : valid_landmarks) {
+        if (rand_ratio(mt) < outlier_ratio) {
+            std::swap(valid_landmark, valid_landmarks.at(rand_idx(mt)));
+        }
+    }
+
+    unsigned int num_inliers = 0;
+    for (auto _ : state) {
+        solve::pnp_solver solver(valid_bearings, valid_keypts, valid_landmarks, map.orb_params_->scale_factors_, 10, true);
+        solver.find_via_ransac(30);
+        const auto inlier_flags = solver.get_inlier_flags();
+        num_inliers = std::count(inlier_flags.begin(), inlier_flags.end(), true);
+        benchmark::DoNotOptimize(num_inliers);
+    }
+    state.counters["num_matches"] = valid_landmarks.size();
+    state.counters["num_inliers"] = num_inliers;
+}
+BENCHMARK(pnp_solver_find_via_ransac)
+    ->Args({1000, 10})
+    ->Args({1000, 50})
+    ->Args({4000, 10})
+    ->Args({4000, 50})
+    ->Unit(benchmark::kMicrosecond);
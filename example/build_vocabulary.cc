@@ -0,0 +1,229 @@
+#include "util/image_util.h"
+
+#include "stella_vslam/data/bow_vocabulary.h"
+#include "stella_vslam/data/bow_vocabulary_builder.h"
+#include "stella_vslam/feature/orb_extractor.h"
+#include "stella_vslam/feature/orb_params.h"
+#include "stella_vslam/util/thread_pool.h"
+#include "stella_vslam/util/yaml.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <thread>
+
+#include <opencv2/core/mat.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <spdlog/spdlog.h>
+#include <popl.hpp>
+#include <yaml-cpp/yaml.h>
+
+#ifdef USE_STACK_TRACE_LOGGER
+#include <backward.hpp>
+#endif
+
+namespace {
+
+//! Extract the ORB descriptors of the images on the threads, each of which has its own extractor,
+//! and stream them into the builder (the images are not kept)
+void extract_descriptors(const std::vector<std::string>& img_paths, const stella_vslam::feature::orb_params* orb_params,
+                         const unsigned int min_size, const unsigned int num_threads,
+                         stella_vslam::data::bow_vocabulary_builder& builder) {
+    std::atomic<unsigned int> next_img_idx{0};
+    std::atomic<unsigned int> num_failures{0};
+    const auto extract = [&] {
+        stella_vslam::feature::orb_extractor extractor(orb_params, min_size);
+        std::vector<cv::KeyPoint> keypts;
+        cv::Mat descs;
+        for (unsigned int img_idx = next_img_idx++; img_idx < img_paths.size(); img_idx = next_img_idx++) {
+            const cv::Mat img = cv::imread(img_paths.at(img_idx), cv::IMREAD_GRAYSCALE);
+            if (img.empty()) {
+                spdlog::warn("cannot read the image: {}", img_paths.at(img_idx));
+                ++num_failures;
+                continue;
+            }
+            extractor.extract(img, cv::Mat(), keypts, descs);
+            if (!descs.empty()) {
+                builder.add_image_descriptors(descs.ptr<uint8_t>(), descs.step[0], descs.rows);
+            }
+            if (img_idx % 1000 == 0) {
+                spdlog::info("extract ORB: {} / {} images", img_idx, img_paths.size());
+            }
+        }
+    };
+    std::vector<std::thread> threads;
+    for (unsigned int i = 0; i < num_threads; ++i) {
+        threads.emplace_back(extract);
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    if (0 < num_failures) {
+        spdlog::warn("{} images are not read", num_failures.load());
+    }
+}
+
+//! Load the saved vocabulary, and check that it quantizes the descriptors into the same words as the builder
+bool verify_vocabulary(const std::string& path, const stella_vslam::data::bow_vocabulary_builder& builder,
+                       const unsigned int num_samples, const unsigned int seed) {
+    std::unique_ptr<stella_vslam::data::bow_vocabulary> bow_vocab(stella_vslam::data::bow_vocabulary_util::load(path));
+    std::mt19937 mt(seed);
+    std::uniform_int_distribution<int> rand_byte(0, 255);
+    unsigned int num_mismatches = 0;
+    for (unsigned int i = 0; i < num_samples; ++i) {
+        cv::Mat desc(1, stella_vslam::data::bow_vocabulary_builder::desc_size, CV_8U);
+        for (unsigned int j = 0; j < stella_vslam::data::bow_vocabulary_builder::desc_size; ++j) {
+            desc.at<uint8_t>(0, j) = static_cast<uint8_t>(rand_byte(mt));
+        }
+        stella_vslam::data::bow_vector bow_vec;
+        stella_vslam::data::bow_feature_vector bow_feat_vec;
+        stella_vslam::data::bow_vocabulary_util::compute_bow(bow_vocab.get(), desc, bow_vec, bow_feat_vec);
+        // (the word of zero weight may be dropped from the BoW vector)
+        if (!bow_vec.empty() && bow_vec.begin()->first != builder.quantize(desc.ptr<uint8_t>())) {
+            ++num_mismatches;
+        }
+    }
+    if (0 < num_mismatches) {
+        spdlog::error("the loaded vocabulary quantizes {} / {} descriptors into the different words", num_mismatches, num_samples);
+        return false;
+    }
+    spdlog::info("verify vocabulary: {} descriptors are quantized into the same words", num_samples);
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+#ifdef USE_STACK_TRACE_LOGGER
+    backward::SignalHandling sh;
+#endif
+
+    // create options
+    popl::OptionParser op("Allowed options");
+    auto help = op.add<popl::Switch>("h", "help", "produce help message");
+    auto img_dir_path = op.add<popl::Value<std::string>>("i", "img-dir", "directory path which contains the images (can be given multiple times)");
+    auto output_path = op.add<popl::Value<std::string>>("o", "output", "output path of the vocabulary");
+    auto config_file_path = op.add<popl::Value<std::string>>("c", "config", "config file path (the Feature section is used)", "");
+#ifdef USE_DBOW2
+    auto format = op.add<popl::Value<std::string>>("", "format", "format of the vocabulary (dbow2, fbow, text or image)", "dbow2");
+#else
+    auto format = op.add<popl::Value<std::string>>("", "format", "format of the vocabulary (fbow, text or image)", "fbow");
+#endif
+    auto k = op.add<popl::Value<unsigned int>>("k", "branching-factor", "branching factor of the tree", 10);
+    auto L = op.add<popl::Value<unsigned int>>("L", "depth", "depth of the tree", 6);
+    auto min_size = op.add<popl::Value<unsigned int>>("", "min-size", "size of the node occupied by a keypoint (as Preprocessing.min_size)", 800);
+    auto max_num_descs = op.add<popl::Value<unsigned int>>("", "max-descriptors", "max number of the descriptors used for the clustering (subsampled over the corpus)", 4000000);
+    auto max_num_iters = op.add<popl::Value<unsigned int>>("", "max-iterations", "max number of the iterations of the k-majority of each node", 10);
+    auto num_threads = op.add<popl::Value<unsigned int>>("", "threads", "number of the threads (0: number of the cores)", 0);
+    auto num_verification_samples = op.add<popl::Value<unsigned int>>("", "verify", "number of the descriptors to check with the saved vocabulary (0: skip)", 1000);
+    auto seed = op.add<popl::Value<unsigned int>>("", "seed", "seed of the sampling and the clustering", 0);
+    auto log_level = op.add<popl::Value<std::string>>("", "log-level", "log level", "info");
+    try {
+        op.parse(argc, argv);
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        std::cerr << std::endl;
+        std::cerr << op << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // check validness of options
+    if (help->is_set()) {
+        std::cerr << op << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (!op.unknown_options().empty()) {
+        for (const auto& unknown_option : op.unknown_options()) {
+            std::cerr << "unknown_options: " << unknown_option << std::endl;
+        }
+        std::cerr << op << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (!img_dir_path->is_set() || !output_path->is_set()) {
+        std::cerr << "invalid arguments" << std::endl;
+        std::cerr << std::endl;
+        std::cerr << op << std::endl;
+        return EXIT_FAILURE;
+    }
+    stella_vslam::data::bow_vocabulary_format_t vocab_format;
+    if (format->value() == "fbow") {
+        vocab_format = stella_vslam::data::bow_vocabulary_format_t::FBoW;
+    }
+    else if (format->value() == "dbow2") {
+        vocab_format = stella_vslam::data::bow_vocabulary_format_t::DBoW2;
+    }
+    else if (format->value() == "text") {
+        vocab_format = stella_vslam::data::bow_vocabulary_format_t::DBoW2_Text;
+    }
+    else if (format->value() == "image") {
+        vocab_format = stella_vslam::data::bow_vocabulary_format_t::Image;
+    }
+    else {
+        std::cerr << "invalid format: " << format->value() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // setup logger
+    spdlog::set_pattern("[%Y-%m-%d %H:%M:%S.%e] %^[%L] %v%$");
+    spdlog::set_level(spdlog::level::from_str(log_level->value()));
+
+    // the ORB parameters of the Feature section (the defaults if no config is given)
+    YAML::Node yaml_node;
+    if (!config_file_path->value().empty()) {
+        yaml_node = YAML::LoadFile(config_file_path->value());
+    }
+    const stella_vslam::feature::orb_params orb_params(stella_vslam::util::yaml_optional_ref(yaml_node, "Feature"));
+    const unsigned int threads = (0 < num_threads->value()) ? num_threads->value() : std::max(1u, std::thread::hardware_concurrency());
+
+    try {
+        std::vector<std::string> img_paths;
+        for (size_t i = 0; i < img_dir_path->count(); ++i) {
+            const image_sequence sequence(img_dir_path->value(i));
+            for (const auto& frame : sequence.get_frames()) {
+                img_paths.push_back(frame.img_path_);
+            }
+        }
+        if (img_paths.empty()) {
+            throw std::runtime_error("no image is found");
+        }
+
+        stella_vslam::data::bow_vocabulary_builder builder(k->value(), L->value(), max_num_descs->value(),
+                                                            max_num_iters->value(), seed->value());
+
+        const auto tp_0 = std::chrono::steady_clock::now();
+        extract_descriptors(img_paths, &orb_params, min_size->value(), threads, builder);
+        const auto tp_1 = std::chrono::steady_clock::now();
+        spdlog::info("extract ORB: {} descriptors of {} images ({} sampled, {} s)",
+                     builder.get_num_seen_descriptors(), builder.get_num_images(), builder.get_num_sampled_descriptors(),
+                     std::chrono::duration<double>(tp_1 - tp_0).count());
+
+        stella_vslam::util::thread_pool pool(threads);
+        builder.build(&pool);
+        const auto tp_2 = std::chrono::steady_clock::now();
+        spdlog::info("build vocabulary: {} s", std::chrono::duration<double>(tp_2 - tp_1).count());
+
+        builder.save(output_path->value(), vocab_format);
+
+        // the vocabulary is loaded by the system only in the format of the BoW framework
+#ifdef USE_DBOW2
+        const bool is_loadable = vocab_format == stella_vslam::data::bow_vocabulary_format_t::DBoW2;
+#else
+        const bool is_loadable = vocab_format == stella_vslam::data::bow_vocabulary_format_t::FBoW
+                                 || vocab_format == stella_vslam::data::bow_vocabulary_format_t::Image;
+#endif
+        if (0 < num_verification_samples->value() && is_loadable
+            && !verify_vocabulary(output_path->value(), builder, num_verification_samples->value(), seed->value())) {
+            return EXIT_FAILURE;
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
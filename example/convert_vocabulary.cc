@@ -0,0 +1,64 @@
+#include "stella_vslam/data/bow_vocabulary_image.h"
+
+#include <iostream>
+
+#include <spdlog/spdlog.h>
+#include <popl.hpp>
+
+#ifdef USE_STACK_TRACE_LOGGER
+#include <backward.hpp>
+#endif
+
+int main(int argc, char* argv[]) {
+#ifdef USE_STACK_TRACE_LOGGER
+    backward::SignalHandling sh;
+#endif
+
+    // create options
+    popl::OptionParser op("Allowed options");
+    auto help = op.add<popl::Switch>("h", "help", "produce help message");
+    auto input_path = op.add<popl::Value<std::string>>("i", "input", "path of the FBoW vocabulary (e.g. orb_vocab.fbow)");
+    auto output_path = op.add<popl::Value<std::string>>("o", "output", "output path of the vocabulary image");
+    auto log_level = op.add<popl::Value<std::string>>("", "log-level", "log level", "info");
+    try {
+        op.parse(argc, argv);
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        std::cerr << std::endl;
+        std::cerr << op << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // check validness of options
+    if (help->is_set()) {
+        std::cerr << op << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (!op.unknown_options().empty()) {
+        for (const auto& unknown_option : op.unknown_options()) {
+            std::cerr << "unknown_options: " << unknown_option << std::endl;
+        }
+        std::cerr << op << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (!input_path->is_set() || !output_path->is_set()) {
+        std::cerr << "invalid arguments" << std::endl;
+        std::cerr << std::endl;
+        std::cerr << op << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    spdlog::set_level(spdlog::level::from_str(log_level->value()));
+
+    // the vocabulary image is loaded by the system in place of the FBoW binary (see bow_vocabulary_util::load())
+    try {
+        stella_vslam::data::bow_vocabulary_image::convert_from_fbow(input_path->value(), output_path->value());
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
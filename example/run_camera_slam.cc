@@ -4,6 +4,10 @@
 #include "socket_publisher/publisher.h"
 #endif
 
+#ifdef USE_SHM_PUBLISHER
+#include "shm_publisher/publisher.h"
+#endif
+
 #include "stella_vslam/system.h"
 #include "stella_vslam/config.h"
 #include "stella_vslam/camera/base.h"
@@ -51,6 +55,12 @@ void mono_tracking(const std::shared_ptr<stella_vslam::system>& slam,
     socket_publisher::publisher publisher(
         stella_vslam::util::yaml_optional_ref(cfg->yaml_node_, "SocketPublisher"), slam, slam->get_frame_publisher(), slam->get_map_publisher());
 #endif
+#ifdef USE_SHM_PUBLISHER
+    // the local consumers read the poses and the map from the shared memory alongside the viewer
+    shm_publisher::publisher shm_pub(
+        stella_vslam::util::yaml_optional_ref(cfg->yaml_node_, "ShmPublisher"), slam->get_map_publisher());
+    std::thread shm_pub_thread(&shm_publisher::publisher::run, &shm_pub);
+#endif
 
     auto video = cv::VideoCapture(cam_num);
     if (!video.isOpened()) {
@@ -110,6 +120,10 @@ void mono_tracking(const std::shared_ptr<stella_vslam::system>& slam,
 #endif
 
     thread.join();
+#ifdef USE_SHM_PUBLISHER
+    shm_pub.request_terminate();
+    shm_pub_thread.join();
+#endif
 
     // shutdown the slam process
     slam->shutdown();
@@ -142,6 +156,12 @@ void stereo_tracking(const std::shared_ptr<stella_vslam::system>& slam,
     socket_publisher::publisher publisher(
         stella_vslam::util::yaml_optional_ref(cfg->yaml_node_, "SocketPublisher"), slam, slam->get_frame_publisher(), slam->get_map_publisher());
 #endif
+#ifdef USE_SHM_PUBLISHER
+    // the local consumers read the poses and the map from the shared memory alongside the viewer
+    shm_publisher::publisher shm_pub(
+        stella_vslam::util::yaml_optional_ref(cfg->yaml_node_, "ShmPublisher"), slam->get_map_publisher());
+    std::thread shm_pub_thread(&shm_publisher::publisher::run, &shm_pub);
+#endif
 
     cv::VideoCapture videos[2];
     for (int i = 0; i < 2; i++) {
@@ -153,7 +173,7 @@ void stereo_tracking(const std::shared_ptr<stella_vslam::system>& slam,
         }
     }
 
-    const stella_vslam::util::stereo_rectifier rectifier(cfg, slam->get_camera());
+    stella_vslam::util::stereo_rectifier rectifier(cfg, slam->get_camera());
 
     cv::Mat frames[2];
     cv::Mat frames_rectified[2];
@@ -178,7 +198,7 @@ void stereo_tracking(const std::shared_ptr<stella_vslam::system>& slam,
                     cv::resize(frames[i], frames[i], cv::Size(), scale, scale, cv::INTER_LINEAR);
                 }
             }
-            rectifier.rectify(frames[0], frames[1], frames_rectified[0], frames_rectified[1]);
+            rectifier.rectify_to_grayscale(frames[0], frames[1], slam->get_camera()->color_order_, frames_rectified[0], frames_rectified[1]);
 
             const auto tp_1 = std::chrono::steady_clock::now();
 
@@ -209,6 +229,10 @@ void stereo_tracking(const std::shared_ptr<stella_vslam::system>& slam,
 #endif
 
     thread.join();
+#ifdef USE_SHM_PUBLISHER
+    shm_pub.request_terminate();
+    shm_pub_thread.join();
+#endif
 
     // shutdown the slam process
     slam->shutdown();
@@ -1,3 +1,5 @@
+#include "util/benchmark_util.h"
+#include "util/image_sequence_source.h"
 #include "util/euroc_util.h"
 
 #ifdef USE_PANGOLIN_VIEWER
@@ -46,7 +48,11 @@ void mono_tracking(const std::shared_ptr<stella_vslam::system>& slam,
                    const bool auto_term,
                    const std::string& eval_log_dir,
                    const std::string& map_db_path,
-                   const bool equal_hist) {
+                   const bool equal_hist,
+                   const std::string& benchmark_report_path,
+                   const unsigned int num_decode_threads,
+                   const unsigned int read_ahead,
+                   const bool preload) {
     const euroc_sequence sequence(sequence_dir_path);
     const auto frames = sequence.get_frames();
 
@@ -63,8 +69,32 @@ void mono_tracking(const std::shared_ptr<stella_vslam::system>& slam,
     std::vector<double> track_times;
     track_times.reserve(frames.size());
 
+    // in the benchmark mode, the frames are fed as fast as possible
+    const bool benchmark_mode = !benchmark_report_path.empty();
+    std::unique_ptr<benchmark_recorder> recorder(benchmark_mode ? new benchmark_recorder(slam) : nullptr);
+
+    const auto load_images = [&frames, equal_hist](const unsigned int i) -> std::vector<cv::Mat> {
+        const auto& frame = frames.at(i);
+        cv::Mat img;
+        if (equal_hist) {
+            img = cv::imread(frame.left_img_path_, cv::IMREAD_UNCHANGED);
+            stella_vslam::util::equalize_histogram(img);
+        }
+        else {
+            img = cv::imread(frame.left_img_path_, cv::IMREAD_GRAYSCALE);
+        }
+        return {img};
+    };
+
+    // the images of the upcoming frames are decoded ahead on the decode threads
+    image_sequence_source source(frames.size(), load_images, num_decode_threads, read_ahead, preload);
+
     // run the slam in another thread
     std::thread thread([&]() {
+        if (benchmark_mode) {
+            recorder->start();
+        }
+
         for (unsigned int i = 0; i < frames.size(); ++i) {
             // wait until the loop BA is finished
             if (wait_loop_ba) {
@@ -74,20 +104,20 @@ void mono_tracking(const std::shared_ptr<stella_vslam::system>& slam,
             }
 
             const auto& frame = frames.at(i);
-            cv::Mat img;
-            if (equal_hist) {
-                img = cv::imread(frame.left_img_path_, cv::IMREAD_UNCHANGED);
-                stella_vslam::util::equalize_histogram(img);
-            }
-            else {
-                img = cv::imread(frame.left_img_path_, cv::IMREAD_GRAYSCALE);
-            }
+            const auto imgs = source.get(i);
+            const cv::Mat& img = imgs.at(0);
 
             const auto tp_1 = std::chrono::steady_clock::now();
 
             if (!img.empty() && (i % frame_skip == 0)) {
                 // input the current frame and estimate the camera pose
-                slam->feed_monocular_frame(img, frame.timestamp_);
+                if (slam->pipelined_extraction_is_enabled()) {
+                    // extraction of the next frame overlaps with tracking of this frame
+                    slam->feed_monocular_frame_async(img, frame.timestamp_);
+                }
+                else {
+                    slam->feed_monocular_frame(img, frame.timestamp_);
+                }
             }
 
             const auto tp_2 = std::chrono::steady_clock::now();
@@ -95,10 +125,13 @@ void mono_tracking(const std::shared_ptr<stella_vslam::system>& slam,
             const auto track_time = std::chrono::duration_cast<std::chrono::duration<double>>(tp_2 - tp_1).count();
             if (i % frame_skip == 0) {
                 track_times.push_back(track_time);
+                if (benchmark_mode) {
+                    recorder->add_frame(i, track_time);
+                }
             }
 
             // wait until the timestamp of the next frame
-            if (!no_sleep && i < frames.size() - 1) {
+            if (!no_sleep && !benchmark_mode && i < frames.size() - 1) {
                 const auto wait_time = frames.at(i + 1).timestamp_ - (frame.timestamp_ + track_time);
                 if (0.0 < wait_time) {
                     std::this_thread::sleep_for(std::chrono::microseconds(static_cast<unsigned int>(wait_time * 1e6)));
@@ -111,6 +144,12 @@ void mono_tracking(const std::shared_ptr<stella_vslam::system>& slam,
             }
         }
 
+        // wait until all the pipelined frames are tracked
+        slam->wait_for_pipelined_frames();
+        if (benchmark_mode) {
+            recorder->stop();
+        }
+
         // wait until the loop BA is finished
         while (slam->loop_BA_is_running()) {
             std::this_thread::sleep_for(std::chrono::microseconds(5000));
@@ -159,6 +198,11 @@ void mono_tracking(const std::shared_ptr<stella_vslam::system>& slam,
         slam->save_map_database(map_db_path);
     }
 
+    if (benchmark_mode) {
+        recorder->print_summary();
+        recorder->save_report(benchmark_report_path, sequence_dir_path);
+    }
+
     std::sort(track_times.begin(), track_times.end());
     const auto total_track_time = std::accumulate(track_times.begin(), track_times.end(), 0.0);
     std::cout << "median tracking time: " << track_times.at(track_times.size() / 2) << "[s]" << std::endl;
@@ -174,11 +218,15 @@ void stereo_tracking(const std::shared_ptr<stella_vslam::system>& slam,
                      const bool auto_term,
                      const std::string& eval_log_dir,
                      const std::string& map_db_path,
-                     const bool equal_hist) {
+                     const bool equal_hist,
+                     const std::string& benchmark_report_path,
+                     const unsigned int num_decode_threads,
+                     const unsigned int read_ahead,
+                     const bool preload) {
     const euroc_sequence sequence(sequence_dir_path);
     const auto frames = sequence.get_frames();
 
-    const stella_vslam::util::stereo_rectifier rectifier(cfg, slam->get_camera());
+    stella_vslam::util::stereo_rectifier rectifier(cfg, slam->get_camera());
 
     // create a viewer object
     // and pass the frame_publisher and the map_publisher
@@ -195,8 +243,35 @@ void stereo_tracking(const std::shared_ptr<stella_vslam::system>& slam,
 
     cv::Mat left_img_rect, right_img_rect;
 
+    // in the benchmark mode, the frames are fed as fast as possible
+    const bool benchmark_mode = !benchmark_report_path.empty();
+    std::unique_ptr<benchmark_recorder> recorder(benchmark_mode ? new benchmark_recorder(slam) : nullptr);
+
+    const auto load_images = [&frames, equal_hist](const unsigned int i) -> std::vector<cv::Mat> {
+        const auto& frame = frames.at(i);
+        std::vector<cv::Mat> imgs(2);
+        if (equal_hist) {
+            imgs.at(0) = cv::imread(frame.left_img_path_, cv::IMREAD_UNCHANGED);
+            imgs.at(1) = cv::imread(frame.right_img_path_, cv::IMREAD_UNCHANGED);
+            stella_vslam::util::equalize_histogram(imgs.at(0));
+            stella_vslam::util::equalize_histogram(imgs.at(1));
+        }
+        else {
+            imgs.at(0) = cv::imread(frame.left_img_path_, cv::IMREAD_GRAYSCALE);
+            imgs.at(1) = cv::imread(frame.right_img_path_, cv::IMREAD_GRAYSCALE);
+        }
+        return imgs;
+    };
+
+    // the images of the upcoming frames are decoded ahead on the decode threads
+    image_sequence_source source(frames.size(), load_images, num_decode_threads, read_ahead, preload);
+
     // run the slam in another thread
     std::thread thread([&]() {
+        if (benchmark_mode) {
+            recorder->start();
+        }
+
         for (unsigned int i = 0; i < frames.size(); ++i) {
             // wait until the loop BA is finished
             if (wait_loop_ba) {
@@ -206,29 +281,27 @@ void stereo_tracking(const std::shared_ptr<stella_vslam::system>& slam,
             }
 
             const auto& frame = frames.at(i);
-            cv::Mat left_img, right_img;
-            if (equal_hist) {
-                left_img = cv::imread(frame.left_img_path_, cv::IMREAD_UNCHANGED);
-                right_img = cv::imread(frame.right_img_path_, cv::IMREAD_UNCHANGED);
-                stella_vslam::util::equalize_histogram(left_img);
-                stella_vslam::util::equalize_histogram(right_img);
-            }
-            else {
-                left_img = cv::imread(frame.left_img_path_, cv::IMREAD_GRAYSCALE);
-                right_img = cv::imread(frame.right_img_path_, cv::IMREAD_GRAYSCALE);
-            }
+            const auto imgs = source.get(i);
+            const cv::Mat& left_img = imgs.at(0);
+            const cv::Mat& right_img = imgs.at(1);
 
             if (left_img.empty() || right_img.empty()) {
                 continue;
             }
 
-            rectifier.rectify(left_img, right_img, left_img_rect, right_img_rect);
+            rectifier.rectify_to_grayscale(left_img, right_img, slam->get_camera()->color_order_, left_img_rect, right_img_rect);
 
             const auto tp_1 = std::chrono::steady_clock::now();
 
             if (i % frame_skip == 0) {
                 // input the current frame and estimate the camera pose
-                slam->feed_stereo_frame(left_img_rect, right_img_rect, frame.timestamp_);
+                if (slam->pipelined_extraction_is_enabled()) {
+                    // extraction of the next frame overlaps with tracking of this frame
+                    slam->feed_stereo_frame_async(left_img_rect, right_img_rect, frame.timestamp_);
+                }
+                else {
+                    slam->feed_stereo_frame(left_img_rect, right_img_rect, frame.timestamp_);
+                }
             }
 
             const auto tp_2 = std::chrono::steady_clock::now();
@@ -236,10 +309,13 @@ void stereo_tracking(const std::shared_ptr<stella_vslam::system>& slam,
             const auto track_time = std::chrono::duration_cast<std::chrono::duration<double>>(tp_2 - tp_1).count();
             if (i % frame_skip == 0) {
                 track_times.push_back(track_time);
+                if (benchmark_mode) {
+                    recorder->add_frame(i, track_time);
+                }
             }
 
             // wait until the timestamp of the next frame
-            if (!no_sleep && i < frames.size() - 1) {
+            if (!no_sleep && !benchmark_mode && i < frames.size() - 1) {
                 const auto wait_time = frames.at(i + 1).timestamp_ - (frame.timestamp_ + track_time);
                 if (0.0 < wait_time) {
                     std::this_thread::sleep_for(std::chrono::microseconds(static_cast<unsigned int>(wait_time * 1e6)));
@@ -252,6 +328,12 @@ void stereo_tracking(const std::shared_ptr<stella_vslam::system>& slam,
             }
         }
 
+        // wait until all the pipelined frames are tracked
+        slam->wait_for_pipelined_frames();
+        if (benchmark_mode) {
+            recorder->stop();
+        }
+
         // wait until the loop BA is finished
         while (slam->loop_BA_is_running()) {
             std::this_thread::sleep_for(std::chrono::microseconds(5000));
@@ -300,6 +382,11 @@ void stereo_tracking(const std::shared_ptr<stella_vslam::system>& slam,
         slam->save_map_database(map_db_path);
     }
 
+    if (benchmark_mode) {
+        recorder->print_summary();
+        recorder->save_report(benchmark_report_path, sequence_dir_path);
+    }
+
     std::sort(track_times.begin(), track_times.end());
     const auto total_track_time = std::accumulate(track_times.begin(), track_times.end(), 0.0);
     std::cout << "median tracking time: " << track_times.at(track_times.size() / 2) << "[s]" << std::endl;
@@ -328,6 +415,10 @@ int main(int argc, char* argv[]) {
     auto disable_mapping = op.add<popl::Switch>("", "disable-mapping", "disable mapping");
 
     auto equal_hist = op.add<popl::Switch>("", "equal-hist", "apply histogram equalization");
+    auto benchmark_report_path = op.add<popl::Value<std::string>>("", "benchmark-report", "run as fast as possible, and store a benchmark report (JSON) at this path", "");
+    auto num_decode_threads = op.add<popl::Value<unsigned int>>("", "decode-threads", "number of the threads which decode the images ahead (decoded on the tracking thread if 0)", 1);
+    auto read_ahead = op.add<popl::Value<unsigned int>>("", "read-ahead", "maximum number of the frames decoded ahead", 4);
+    auto preload = op.add<popl::Switch>("", "preload", "decode all of the images into RAM before running slam");
 
     try {
         op.parse(argc, argv);
@@ -409,7 +500,11 @@ int main(int argc, char* argv[]) {
                       auto_term->is_set(),
                       eval_log_dir->value(),
                       map_db_path_out->value(),
-                      equal_hist->is_set());
+                      equal_hist->is_set(),
+                      benchmark_report_path->value(),
+                      num_decode_threads->value(),
+                      read_ahead->value(),
+                      preload->is_set());
     }
     else if (slam->get_camera()->setup_type_ == stella_vslam::camera::setup_type_t::Stereo) {
         stereo_tracking(slam,
@@ -421,7 +516,11 @@ int main(int argc, char* argv[]) {
                         auto_term->is_set(),
                         eval_log_dir->value(),
                         map_db_path_out->value(),
-                        equal_hist->is_set());
+                        equal_hist->is_set(),
+                        benchmark_report_path->value(),
+                        num_decode_threads->value(),
+                        read_ahead->value(),
+                        preload->is_set());
     }
     else {
         throw std::runtime_error("Invalid setup type: " + slam->get_camera()->get_setup_type_string());
@@ -1,3 +1,5 @@
+#include "util/benchmark_util.h"
+#include "util/image_sequence_source.h"
 #include "util/image_util.h"
 
 #ifdef USE_PANGOLIN_VIEWER
@@ -9,6 +11,8 @@
 #include "stella_vslam/system.h"
 #include "stella_vslam/config.h"
 #include "stella_vslam/camera/base.h"
+#include "stella_vslam/feature/feature_cache.h"
+#include "stella_vslam/feature/orb_extraction_budget.h"
 #include "stella_vslam/util/yaml.h"
 
 #include <iostream>
@@ -43,7 +47,12 @@ void mono_tracking(const std::shared_ptr<stella_vslam::system>& slam,
                    const bool auto_term,
                    const std::string& eval_log_dir,
                    const std::string& map_db_path,
-                   const double start_timestamp) {
+                   const double start_timestamp,
+                   const std::string& benchmark_report_path,
+                   const unsigned int num_decode_threads,
+                   const unsigned int read_ahead,
+                   const bool preload,
+                   const std::string& feature_cache_path) {
     // load the mask image
     const cv::Mat mask = mask_img_path.empty() ? cv::Mat{} : cv::imread(mask_img_path, cv::IMREAD_GRAYSCALE);
 
@@ -62,8 +71,45 @@ void mono_tracking(const std::shared_ptr<stella_vslam::system>& slam,
     track_times.reserve(frames.size());
     double timestamp = start_timestamp;
 
+    // in the benchmark mode, the frames are fed as fast as possible
+    const bool benchmark_mode = !benchmark_report_path.empty();
+    std::unique_ptr<benchmark_recorder> recorder(benchmark_mode ? new benchmark_recorder(slam) : nullptr);
+
+    // the features of the images are read from the cache, which is keyed by the paths and the sizes of the files
+    // (the mask is a part of the fingerprint, because the features depend on it)
+    std::unique_ptr<stella_vslam::feature::feature_cache> feature_cache;
+    std::vector<uint64_t> feature_keys;
+    if (!feature_cache_path.empty()) {
+        feature_cache.reset(new stella_vslam::feature::feature_cache(feature_cache_path, slam->get_feature_fingerprint() + "mask: " + mask_img_path + "\n"));
+        feature_keys.reserve(frames.size());
+        for (const auto& frame : frames) {
+            feature_keys.push_back(stella_vslam::feature::feature_cache::compute_key(frame.img_path_ + ":" + std::to_string(fs::file_size(frame.img_path_))));
+        }
+    }
+#if defined(USE_PANGOLIN_VIEWER) || defined(USE_SOCKET_PUBLISHER)
+    constexpr bool image_is_displayed = true;
+#else
+    constexpr bool image_is_displayed = false;
+#endif
+
+    const auto load_images = [&frames, &feature_cache, &feature_keys, image_is_displayed](const unsigned int i) -> std::vector<cv::Mat> {
+        // the images of the cached features are not decoded unless they are displayed
+        if (!image_is_displayed && feature_cache && feature_cache->contains(feature_keys.at(i))) {
+            return {cv::Mat{}};
+        }
+        const auto& frame = frames.at(i);
+        return {cv::imread(frame.img_path_, cv::IMREAD_UNCHANGED)};
+    };
+
+    // the images of the upcoming frames are decoded ahead on the decode threads
+    image_sequence_source source(frames.size(), load_images, num_decode_threads, read_ahead, preload);
+
     // run the slam in another thread
     std::thread thread([&]() {
+        if (benchmark_mode) {
+            recorder->start();
+        }
+
         for (unsigned int i = 0; i < frames.size(); ++i) {
             // wait until the loop BA is finished
             if (wait_loop_ba) {
@@ -72,12 +118,28 @@ void mono_tracking(const std::shared_ptr<stella_vslam::system>& slam,
                 }
             }
 
-            const auto& frame = frames.at(i);
-            const auto img = cv::imread(frame.img_path_, cv::IMREAD_UNCHANGED);
+            const auto imgs = source.get(i);
+            const cv::Mat& img = imgs.at(0);
 
             const auto tp_1 = std::chrono::steady_clock::now();
 
-            if (!img.empty() && (i % frame_skip == 0)) {
+            if (feature_cache && (i % frame_skip == 0)) {
+                // extract and store the features if they are not cached yet
+                std::vector<cv::KeyPoint> keypts;
+                cv::Mat descriptors;
+                stella_vslam::feature::orb_extraction_settings extraction_settings;
+                bool is_available = feature_cache->find(feature_keys.at(i), keypts, descriptors, extraction_settings);
+                if (!is_available && !img.empty()) {
+                    slam->extract_features(img, mask, keypts, descriptors, extraction_settings);
+                    feature_cache->store(feature_keys.at(i), keypts, descriptors, extraction_settings);
+                    is_available = true;
+                }
+                if (is_available) {
+                    // input the current frame and estimate the camera pose
+                    slam->feed_precomputed_frame(keypts, descriptors, extraction_settings, timestamp, img);
+                }
+            }
+            else if (!img.empty() && (i % frame_skip == 0)) {
                 // input the current frame and estimate the camera pose
                 slam->feed_monocular_frame(img, timestamp, mask);
             }
@@ -87,10 +149,13 @@ void mono_tracking(const std::shared_ptr<stella_vslam::system>& slam,
             const auto track_time = std::chrono::duration_cast<std::chrono::duration<double>>(tp_2 - tp_1).count();
             if (i % frame_skip == 0) {
                 track_times.push_back(track_time);
+                if (benchmark_mode) {
+                    recorder->add_frame(i, track_time);
+                }
             }
 
             // wait until the timestamp of the next frame
-            if (!no_sleep && i < frames.size() - 1) {
+            if (!no_sleep && !benchmark_mode && i < frames.size() - 1) {
                 const auto wait_time = 1.0 / slam->get_camera()->fps_ - track_time;
                 if (0.0 < wait_time) {
                     std::this_thread::sleep_for(std::chrono::microseconds(static_cast<unsigned int>(wait_time * 1e6)));
@@ -105,6 +170,10 @@ void mono_tracking(const std::shared_ptr<stella_vslam::system>& slam,
             }
         }
 
+        if (benchmark_mode) {
+            recorder->stop();
+        }
+
         // wait until the loop BA is finished
         while (slam->loop_BA_is_running()) {
             std::this_thread::sleep_for(std::chrono::microseconds(5000));
@@ -153,6 +222,11 @@ void mono_tracking(const std::shared_ptr<stella_vslam::system>& slam,
         slam->save_map_database(map_db_path);
     }
 
+    if (benchmark_mode) {
+        recorder->print_summary();
+        recorder->save_report(benchmark_report_path, image_dir_path);
+    }
+
     std::sort(track_times.begin(), track_times.end());
     const auto total_track_time = std::accumulate(track_times.begin(), track_times.end(), 0.0);
     std::cout << "median tracking time: " << track_times.at(track_times.size() / 2) << "[s]" << std::endl;
@@ -180,7 +254,12 @@ int main(int argc, char* argv[]) {
     auto map_db_path_in = op.add<popl::Value<std::string>>("i", "map-db-in", "load a map from this path", "");
     auto map_db_path_out = op.add<popl::Value<std::string>>("o", "map-db-out", "store a map database at this path after slam", "");
     auto disable_mapping = op.add<popl::Switch>("", "disable-mapping", "disable mapping");
+    auto benchmark_report_path = op.add<popl::Value<std::string>>("", "benchmark-report", "run as fast as possible, and store a benchmark report (JSON) at this path", "");
+    auto num_decode_threads = op.add<popl::Value<unsigned int>>("", "decode-threads", "number of the threads which decode the images ahead (decoded on the tracking thread if 0)", 1);
+    auto read_ahead = op.add<popl::Value<unsigned int>>("", "read-ahead", "maximum number of the frames decoded ahead", 4);
+    auto preload = op.add<popl::Switch>("", "preload", "decode all of the images into RAM before running slam");
     auto start_timestamp = op.add<popl::Value<double>>("t", "start-timestamp", "timestamp of the start of the video capture");
+    auto feature_cache_path = op.add<popl::Value<std::string>>("", "feature-cache", "read the ORB features from the cache file at this path, which is filled with the features extracted in this run", "");
     try {
         op.parse(argc, argv);
     }
@@ -278,7 +357,12 @@ int main(int argc, char* argv[]) {
                       auto_term->is_set(),
                       eval_log_dir->value(),
                       map_db_path_out->value(),
-                      timestamp);
+                      timestamp,
+                      benchmark_report_path->value(),
+                      num_decode_threads->value(),
+                      read_ahead->value(),
+                      preload->is_set(),
+                      feature_cache_path->value());
     }
     else {
         throw std::runtime_error("Invalid setup type: " + slam->get_camera()->get_setup_type_string());
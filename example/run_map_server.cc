@@ -0,0 +1,106 @@
+#include "stella_vslam/system.h"
+#include "stella_vslam/config.h"
+#include "stella_vslam/util/yaml.h"
+#include "socket_publisher/map_server.h"
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include <spdlog/spdlog.h>
+#include <popl.hpp>
+
+#ifdef USE_STACK_TRACE_LOGGER
+#include <backward.hpp>
+#endif
+
+int main(int argc, char* argv[]) {
+#ifdef USE_STACK_TRACE_LOGGER
+    backward::SignalHandling sh;
+#endif
+
+    // create options
+    popl::OptionParser op("Allowed options");
+    auto help = op.add<popl::Switch>("h", "help", "produce help message");
+    auto vocab_file_path = op.add<popl::Value<std::string>>("v", "vocab", "vocabulary file path");
+    auto config_file_path = op.add<popl::Value<std::string>>("c", "config", "config file path (the cameras of the robots and the MapServer section)");
+    auto map_db_path_in = op.add<popl::Value<std::string>>("i", "map-db-in", "load a map database at this path before the robots connect", "");
+    auto map_db_path_out = op.add<popl::Value<std::string>>("o", "map-db-out", "store the shared map database at this path after the server is stopped", "");
+    auto log_level = op.add<popl::Value<std::string>>("", "log-level", "log level", "info");
+    try {
+        op.parse(argc, argv);
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        std::cerr << std::endl;
+        std::cerr << op << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // check validness of options
+    if (help->is_set()) {
+        std::cerr << op << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (!op.unknown_options().empty()) {
+        for (const auto& unknown_option : op.unknown_options()) {
+            std::cerr << "unknown_options: " << unknown_option << std::endl;
+        }
+        std::cerr << op << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (!vocab_file_path->is_set() || !config_file_path->is_set()) {
+        std::cerr << "invalid arguments" << std::endl;
+        std::cerr << std::endl;
+        std::cerr << op << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // setup logger
+    spdlog::set_pattern("[%Y-%m-%d %H:%M:%S.%e] %^[%L] %v%$");
+    spdlog::set_level(spdlog::level::from_str(log_level->value()));
+
+    // load configuration
+    std::shared_ptr<stella_vslam::config> cfg;
+    try {
+        cfg = std::make_shared<stella_vslam::config>(config_file_path->value());
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    try {
+        // no frame is fed to the server, so the mapping module is kept disabled
+        auto slam = std::make_shared<stella_vslam::system>(cfg, vocab_file_path->value());
+        if (!map_db_path_in->value().empty()) {
+            slam->load_map_database(map_db_path_in->value());
+        }
+        slam->startup(false);
+        slam->disable_mapping_module();
+
+        socket_publisher::map_server server(stella_vslam::util::yaml_optional_ref(cfg->yaml_node_, "MapServer"), slam);
+        std::thread thread([&server]() {
+            server.run();
+        });
+
+        std::cout << "press enter to stop the map server" << std::endl;
+        std::string line;
+        std::getline(std::cin, line);
+
+        server.request_terminate();
+        thread.join();
+
+        slam->shutdown();
+        if (!map_db_path_out->value().empty()) {
+            slam->save_map_database(map_db_path_out->value());
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,189 @@
+#include "stella_vslam/system.h"
+#include "stella_vslam/config.h"
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <spdlog/spdlog.h>
+#include <popl.hpp>
+#include <yaml-cpp/yaml.h>
+
+#ifdef USE_STACK_TRACE_LOGGER
+#include <backward.hpp>
+#endif
+
+// NOTE: each session is mapped in its own process, because the map database mutex and the frame IDs are process-wide
+
+int map_session(const YAML::Node& yaml_node,
+                const std::string& config_file_path,
+                const std::string& vocab_file_path,
+                const std::string& log_dir_path,
+                const std::string& map_db_path) {
+    try {
+        // the mapping and the loop closure are driven by the replay, and the session is not recorded again
+        YAML::Node session_node = YAML::Clone(yaml_node);
+        session_node["System"]["offline_mapping"] = true;
+        session_node["System"].remove("record_dir");
+        auto cfg = std::make_shared<stella_vslam::config>(session_node, config_file_path);
+
+        auto slam = std::make_shared<stella_vslam::system>(cfg, vocab_file_path);
+        slam->startup();
+        slam->replay(log_dir_path);
+        slam->shutdown();
+        slam->save_map_database(map_db_path);
+    }
+    catch (const std::exception& e) {
+        spdlog::critical("session {}: {}", log_dir_path, e.what());
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+bool map_sessions(const std::shared_ptr<stella_vslam::config>& cfg,
+                  const std::string& vocab_file_path,
+                  const std::vector<std::string>& log_dir_paths,
+                  const std::vector<std::string>& map_db_paths,
+                  const unsigned int num_jobs) {
+    std::map<pid_t, unsigned int> running_workers;
+    bool all_succeeded = true;
+
+    auto wait_worker = [&running_workers, &all_succeeded, &log_dir_paths]() {
+        int status = 0;
+        const pid_t pid = waitpid(-1, &status, 0);
+        if (pid < 0) {
+            throw std::runtime_error("waitpid failed");
+        }
+        const auto idx = running_workers.at(pid);
+        running_workers.erase(pid);
+        if (WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS) {
+            spdlog::info("finished the session {}", log_dir_paths.at(idx));
+        }
+        else {
+            spdlog::error("failed to map the session {}", log_dir_paths.at(idx));
+            all_succeeded = false;
+        }
+    };
+
+    for (unsigned int idx = 0; idx < log_dir_paths.size(); ++idx) {
+        while (num_jobs <= running_workers.size()) {
+            wait_worker();
+        }
+        const pid_t pid = fork();
+        if (pid < 0) {
+            throw std::runtime_error("fork failed");
+        }
+        if (pid == 0) {
+            // worker process
+            _exit(map_session(cfg->yaml_node_, cfg->config_file_path_, vocab_file_path, log_dir_paths.at(idx), map_db_paths.at(idx)));
+        }
+        spdlog::info("start the session {} (pid {})", log_dir_paths.at(idx), pid);
+        running_workers[pid] = idx;
+    }
+    while (!running_workers.empty()) {
+        wait_worker();
+    }
+    return all_succeeded;
+}
+
+int main(int argc, char* argv[]) {
+#ifdef USE_STACK_TRACE_LOGGER
+    backward::SignalHandling sh;
+#endif
+
+    // create options
+    popl::OptionParser op("Allowed options");
+    auto help = op.add<popl::Switch>("h", "help", "produce help message");
+    auto vocab_file_path = op.add<popl::Value<std::string>>("v", "vocab", "vocabulary file path");
+    auto config_file_path = op.add<popl::Value<std::string>>("c", "config", "config file path (same as the recorded sessions)");
+    auto session_dir_paths = op.add<popl::Value<std::string>>("s", "session", "directory of the replay log of a session (can be repeated)");
+    auto work_dir_path = op.add<popl::Value<std::string>>("w", "work-dir", "directory to store the map of each session", ".");
+    auto map_db_path_out = op.add<popl::Value<std::string>>("o", "map-db-out", "store the merged map database at this path");
+    auto num_jobs = op.add<popl::Value<unsigned int>>("j", "jobs", "number of the sessions mapped in parallel (0: number of the cores)", 0);
+    auto skip_mapping = op.add<popl::Switch>("", "skip-mapping", "merge the maps already stored in the work directory");
+    auto log_level = op.add<popl::Value<std::string>>("", "log-level", "log level", "info");
+    try {
+        op.parse(argc, argv);
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        std::cerr << std::endl;
+        std::cerr << op << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // check validness of options
+    if (help->is_set()) {
+        std::cerr << op << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (!op.unknown_options().empty()) {
+        for (const auto& unknown_option : op.unknown_options()) {
+            std::cerr << "unknown_options: " << unknown_option << std::endl;
+        }
+        std::cerr << op << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (!vocab_file_path->is_set() || !config_file_path->is_set() || !session_dir_paths->is_set() || !map_db_path_out->is_set()) {
+        std::cerr << "invalid arguments" << std::endl;
+        std::cerr << std::endl;
+        std::cerr << op << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // setup logger
+    spdlog::set_pattern("[%Y-%m-%d %H:%M:%S.%e] [%P] %^[%L] %v%$");
+    spdlog::set_level(spdlog::level::from_str(log_level->value()));
+
+    // load configuration
+    std::shared_ptr<stella_vslam::config> cfg;
+    try {
+        cfg = std::make_shared<stella_vslam::config>(config_file_path->value());
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::vector<std::string> log_dir_paths;
+    std::vector<std::string> map_db_paths;
+    for (unsigned int idx = 0; idx < session_dir_paths->count(); ++idx) {
+        log_dir_paths.push_back(session_dir_paths->value(idx));
+        map_db_paths.push_back(work_dir_path->value() + "/session_" + std::to_string(idx) + ".msg");
+    }
+
+    try {
+        // 1. map the sessions in the worker processes
+        if (!skip_mapping->is_set()) {
+            const unsigned int jobs = num_jobs->value() ? num_jobs->value() : std::max(1u, std::thread::hardware_concurrency());
+            if (!map_sessions(cfg, vocab_file_path->value(), log_dir_paths, map_db_paths, jobs)) {
+                std::cerr << "failed to map some sessions" << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+
+        // 2. load the maps of the sessions into one map database, then merge them via the inter-map loops
+        auto slam = std::make_shared<stella_vslam::system>(cfg, vocab_file_path->value());
+        for (const auto& map_db_path : map_db_paths) {
+            slam->load_map_database(map_db_path);
+        }
+        slam->startup(false);
+        slam->disable_mapping_module();
+        slam->merge_maps();
+        slam->save_map_database(map_db_path_out->value());
+        slam->shutdown();
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
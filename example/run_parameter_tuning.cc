@@ -0,0 +1,412 @@
+#include "util/benchmark_util.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+#include <spdlog/spdlog.h>
+#include <popl.hpp>
+#include <yaml-cpp/yaml.h>
+
+#ifdef USE_STACK_TRACE_LOGGER
+#include <backward.hpp>
+#endif
+
+/**
+ * Sweep the parameters of the config with a benchmark runner, and save the Pareto-optimal config within the hardware budget
+ *
+ * The sweep file lists the values of each parameter, whose sections are separated by '.', e.g.
+ *   Feature.scale_factor: [1.2, 1.4]
+ *   Feature.num_levels: [6, 8]
+ *   Feature.ini_fast_threshold: [12, 20]
+ *   Feature.min_fast_threshold: [5, 7]
+ *   Preprocessing.min_size: [600, 800, 1200]
+ *   Mapping.num_covisibilities_for_landmark_generation: [10, 20]
+ * Each combination (and the base config) runs in a child process of the runner, like
+ *   <runner> <runner-args> -c <candidate config> --benchmark-report <candidate report>
+ * e.g. run_synthetic_benchmark, which reports the trajectory error against the ground truth in the results.
+ */
+
+namespace {
+
+//! Parameter of the sweep and its values
+struct sweep_parameter {
+    std::string key_;
+    std::vector<YAML::Node> values_;
+};
+
+//! Measured candidate
+struct candidate {
+    //! index of the value of each parameter (empty for the base config)
+    std::vector<unsigned int> value_indices_;
+    std::string config_path_;
+    std::string report_path_;
+    bool is_succeeded_ = false;
+    double latency_ms_ = 0.0;
+    double error_ = 0.0;
+    double cpu_utilization_ = 0.0;
+    double tracked_ratio_ = 1.0;
+    double throughput_fps_ = 0.0;
+    bool is_within_budget_ = false;
+    bool is_pareto_optimal_ = false;
+};
+
+//! Load the parameters of the sweep
+std::vector<sweep_parameter> load_sweep(const std::string& path) {
+    const YAML::Node yaml_node = YAML::LoadFile(path);
+    if (!yaml_node.IsMap()) {
+        throw std::runtime_error("the sweep file must be a map of the parameters: " + path);
+    }
+    std::vector<sweep_parameter> params;
+    for (const auto& key_values : yaml_node) {
+        sweep_parameter param;
+        param.key_ = key_values.first.as<std::string>();
+        if (!key_values.second.IsSequence() || key_values.second.size() == 0) {
+            throw std::runtime_error("the values of " + param.key_ + " must be a non-empty list");
+        }
+        for (const auto& value : key_values.second) {
+            param.values_.push_back(value);
+        }
+        params.push_back(param);
+    }
+    return params;
+}
+
+//! Set the value of the parameter (the sections are separated by '.')
+void set_parameter(YAML::Node& yaml_node, const std::string& key, const YAML::Node& value) {
+    std::vector<std::string> sections;
+    std::stringstream ss(key);
+    std::string section;
+    while (std::getline(ss, section, '.')) {
+        sections.push_back(section);
+    }
+    if (sections.empty()) {
+        throw std::runtime_error("invalid parameter: " + key);
+    }
+    // (reset() rebinds the node, while the assignment would overwrite the parent)
+    YAML::Node node;
+    node.reset(yaml_node);
+    for (unsigned int i = 0; i + 1 < sections.size(); ++i) {
+        YAML::Node child = node[sections.at(i)];
+        node.reset(child);
+    }
+    node[sections.back()] = YAML::Clone(value);
+}
+
+//! Create the config of the candidate from the base config
+YAML::Node create_config(const YAML::Node& base_node, const std::vector<sweep_parameter>& params, const candidate& cand) {
+    YAML::Node yaml_node = YAML::Clone(base_node);
+    for (unsigned int i = 0; i < cand.value_indices_.size(); ++i) {
+        set_parameter(yaml_node, params.at(i).key_, params.at(i).values_.at(cand.value_indices_.at(i)));
+    }
+    return yaml_node;
+}
+
+//! Description of the values of the candidate
+std::string describe(const std::vector<sweep_parameter>& params, const candidate& cand) {
+    if (cand.value_indices_.empty()) {
+        return "base config";
+    }
+    std::string desc;
+    for (unsigned int i = 0; i < cand.value_indices_.size(); ++i) {
+        desc += (i == 0 ? "" : ", ") + params.at(i).key_ + "=" + params.at(i).values_.at(cand.value_indices_.at(i)).as<std::string>();
+    }
+    return desc;
+}
+
+/**
+ * Enumerate the combinations of the values (a random subset of them if there are more than max_num_candidates)
+ * @param params
+ * @param max_num_candidates
+ * @param seed
+ * @return the base config, followed by the combinations
+ */
+std::vector<candidate> create_candidates(const std::vector<sweep_parameter>& params, const unsigned int max_num_candidates, const unsigned int seed) {
+    double num_combinations = 1.0;
+    for (const auto& param : params) {
+        num_combinations *= param.values_.size();
+    }
+
+    std::vector<uint64_t> combination_indices;
+    if (num_combinations <= max_num_candidates) {
+        for (uint64_t idx = 0; idx < static_cast<uint64_t>(num_combinations); ++idx) {
+            combination_indices.push_back(idx);
+        }
+    }
+    else {
+        spdlog::info("sample {} of the {} combinations", max_num_candidates, num_combinations);
+        std::mt19937_64 mt(seed);
+        std::uniform_real_distribution<double> dist(0.0, num_combinations);
+        std::unordered_set<uint64_t> sampled;
+        while (combination_indices.size() < max_num_candidates) {
+            const auto idx = std::min(static_cast<uint64_t>(dist(mt)), static_cast<uint64_t>(num_combinations) - 1);
+            if (sampled.insert(idx).second) {
+                combination_indices.push_back(idx);
+            }
+        }
+        std::sort(combination_indices.begin(), combination_indices.end());
+    }
+
+    std::vector<candidate> candidates(1);
+    for (auto idx : combination_indices) {
+        candidate cand;
+        // mixed radix of the numbers of the values (the first parameter varies the slowest)
+        cand.value_indices_.resize(params.size());
+        for (int i = static_cast<int>(params.size()) - 1; 0 <= i; --i) {
+            cand.value_indices_.at(i) = idx % params.at(i).values_.size();
+            idx /= params.at(i).values_.size();
+        }
+        candidates.push_back(cand);
+    }
+    return candidates;
+}
+
+//! Mark the candidates which are not dominated in both the latency and the error
+void mark_pareto_optimal(std::vector<candidate>& candidates) {
+    for (auto& cand : candidates) {
+        if (!cand.is_succeeded_) {
+            continue;
+        }
+        cand.is_pareto_optimal_ = true;
+        for (const auto& other : candidates) {
+            if (!other.is_succeeded_) {
+                continue;
+            }
+            const bool is_not_worse = other.latency_ms_ <= cand.latency_ms_ && other.error_ <= cand.error_;
+            const bool is_better = other.latency_ms_ < cand.latency_ms_ || other.error_ < cand.error_;
+            if (is_not_worse && is_better) {
+                cand.is_pareto_optimal_ = false;
+                break;
+            }
+        }
+    }
+}
+
+//! Run the runner with the config of the candidate, and load the metrics of the report
+void run_candidate(const std::string& runner_path, const std::string& runner_args,
+                   const std::string& latency_percentile, const std::string& error_metric,
+                   candidate& cand) {
+    const auto command = quote_shell_argument(runner_path) + " " + runner_args
+                         + " -c " + quote_shell_argument(cand.config_path_) + " --benchmark-report " + quote_shell_argument(cand.report_path_);
+    spdlog::info("run: {}", command);
+    if (std::system(command.c_str()) != 0) {
+        spdlog::warn("the run failed: {}", command);
+        return;
+    }
+
+    std::ifstream ifs(cand.report_path_);
+    if (!ifs.is_open()) {
+        spdlog::warn("cannot load the report at {}", cand.report_path_);
+        return;
+    }
+    nlohmann::json report;
+    ifs >> report;
+
+    const auto& results = report.at("results");
+    if (!results.count(error_metric)) {
+        spdlog::warn("the report at {} has no {} in the results", cand.report_path_, error_metric);
+        return;
+    }
+    cand.error_ = results.at(error_metric).get<double>();
+    cand.tracked_ratio_ = results.value("tracked_ratio", 1.0);
+    cand.latency_ms_ = report.at("feed_time_ms").at(latency_percentile).get<double>();
+    cand.throughput_fps_ = report.value("throughput_fps", 0.0);
+    if (report.count("cpu_utilization")) {
+        cand.cpu_utilization_ = report.at("cpu_utilization").value("process", 0.0);
+    }
+    cand.is_succeeded_ = true;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+#ifdef USE_STACK_TRACE_LOGGER
+    backward::SignalHandling sh;
+#endif
+
+    // create options
+    popl::OptionParser op("Allowed options");
+    auto help = op.add<popl::Switch>("h", "help", "produce help message");
+    auto config_file_path = op.add<popl::Value<std::string>>("c", "config", "base config file path");
+    auto sweep_file_path = op.add<popl::Value<std::string>>("s", "sweep", "sweep file path (the lists of the values of the parameters, e.g. Feature.num_levels: [6, 8])");
+    auto runner_path = op.add<popl::Value<std::string>>("r", "runner", "path of the benchmark runner (e.g. run_synthetic_benchmark)");
+    auto runner_args = op.add<popl::Value<std::string>>("a", "runner-args", "arguments of the runner except the config and the report (e.g. \"-v orb_vocab.fbow -n 600\")", "");
+    auto output_dir = op.add<popl::Value<std::string>>("o", "output-dir", "directory where the configs and the reports of the candidates are stored (must exist)", ".");
+    auto output_config_path = op.add<popl::Value<std::string>>("", "output-config", "path of the tuned config (tuned.yaml in the output directory if empty)", "");
+    auto latency_budget_ms = op.add<popl::Value<double>>("", "latency-budget-ms", "budget of the frame feeding time at the percentile [ms] (unlimited if 0)", 0.0);
+    auto latency_percentile = op.add<popl::Value<std::string>>("", "latency-percentile", "percentile of the frame feeding time (p50, p95 or p99)", "p95");
+    auto cpu_budget = op.add<popl::Value<double>>("", "cpu-budget", "budget of the CPU utilization of the process [cores] (unlimited if 0)", 0.0);
+    auto min_tracked_ratio = op.add<popl::Value<double>>("", "min-tracked-ratio", "minimum ratio of the tracked frames (if the runner reports it)", 0.9);
+    auto error_metric = op.add<popl::Value<std::string>>("", "error-metric", "name of the trajectory error in the results of the report", "ate_rmse_m");
+    auto max_num_candidates = op.add<popl::Value<unsigned int>>("", "max-candidates", "maximum number of the combinations (sampled randomly if there are more)", 64);
+    auto seed = op.add<popl::Value<unsigned int>>("", "seed", "seed of the sampling of the combinations", 0);
+    auto log_level = op.add<popl::Value<std::string>>("", "log-level", "log level", "info");
+    try {
+        op.parse(argc, argv);
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        std::cerr << std::endl;
+        std::cerr << op << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // check validness of options
+    if (help->is_set()) {
+        std::cerr << op << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (!op.unknown_options().empty()) {
+        for (const auto& unknown_option : op.unknown_options()) {
+            std::cerr << "unknown_options: " << unknown_option << std::endl;
+        }
+        std::cerr << op << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (!config_file_path->is_set() || !sweep_file_path->is_set() || !runner_path->is_set() || max_num_candidates->value() == 0
+        || (latency_percentile->value() != "p50" && latency_percentile->value() != "p95" && latency_percentile->value() != "p99")) {
+        std::cerr << "invalid arguments" << std::endl;
+        std::cerr << std::endl;
+        std::cerr << op << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // setup logger
+    spdlog::set_pattern("[%Y-%m-%d %H:%M:%S.%e] %^[%L] %v%$");
+    spdlog::set_level(spdlog::level::from_str(log_level->value()));
+
+    YAML::Node base_node;
+    std::vector<sweep_parameter> params;
+    try {
+        base_node = YAML::LoadFile(config_file_path->value());
+        params = load_sweep(sweep_file_path->value());
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // run the candidates
+    auto candidates = create_candidates(params, max_num_candidates->value(), seed->value());
+    for (unsigned int i = 0; i < candidates.size(); ++i) {
+        auto& cand = candidates.at(i);
+        cand.config_path_ = output_dir->value() + "/candidate_" + std::to_string(i) + ".yaml";
+        cand.report_path_ = output_dir->value() + "/candidate_" + std::to_string(i) + ".json";
+        std::ofstream ofs(cand.config_path_, std::ios::out);
+        if (!ofs.is_open()) {
+            std::cerr << "cannot create a file at " << cand.config_path_ << std::endl;
+            return EXIT_FAILURE;
+        }
+        ofs << YAML::Dump(create_config(base_node, params, cand)) << std::endl;
+        ofs.close();
+
+        spdlog::info("candidate {} / {}: {}", i + 1, candidates.size(), describe(params, cand));
+        run_candidate(runner_path->value(), runner_args->value(), latency_percentile->value(), error_metric->value(), cand);
+        if (cand.tracked_ratio_ < min_tracked_ratio->value()) {
+            spdlog::warn("candidate {} is rejected because the tracked ratio is {}", i, cand.tracked_ratio_);
+            cand.is_succeeded_ = false;
+        }
+        cand.is_within_budget_ = cand.is_succeeded_
+                                 && (latency_budget_ms->value() <= 0.0 || cand.latency_ms_ <= latency_budget_ms->value())
+                                 && (cpu_budget->value() <= 0.0 || cand.cpu_utilization_ <= cpu_budget->value());
+    }
+    mark_pareto_optimal(candidates);
+
+    // the most accurate of the Pareto-optimal candidates within the budget, otherwise the fastest one
+    int selected_idx = -1;
+    for (unsigned int i = 0; i < candidates.size(); ++i) {
+        const auto& cand = candidates.at(i);
+        if (cand.is_pareto_optimal_ && cand.is_within_budget_
+            && (selected_idx < 0 || cand.error_ < candidates.at(selected_idx).error_)) {
+            selected_idx = static_cast<int>(i);
+        }
+    }
+    if (selected_idx < 0) {
+        for (unsigned int i = 0; i < candidates.size(); ++i) {
+            const auto& cand = candidates.at(i);
+            if (cand.is_pareto_optimal_ && (selected_idx < 0 || cand.latency_ms_ < candidates.at(selected_idx).latency_ms_)) {
+                selected_idx = static_cast<int>(i);
+            }
+        }
+        if (selected_idx < 0) {
+            std::cerr << "all of the runs failed" << std::endl;
+            return EXIT_FAILURE;
+        }
+        spdlog::warn("no candidate is within the budget, the fastest one is selected");
+    }
+
+    // print the Pareto front
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "Pareto-optimal candidates (latency " << latency_percentile->value() << " [ms], " << error_metric->value()
+              << ", CPU utilization [cores], throughput [fps]):" << std::endl;
+    for (unsigned int i = 0; i < candidates.size(); ++i) {
+        const auto& cand = candidates.at(i);
+        if (!cand.is_pareto_optimal_) {
+            continue;
+        }
+        std::cout << (static_cast<int>(i) == selected_idx ? "* " : "  ") << i << ": " << cand.latency_ms_ << ", " << cand.error_
+                  << ", " << cand.cpu_utilization_ << ", " << cand.throughput_fps_
+                  << (cand.is_within_budget_ ? "" : " (over budget)") << " | " << describe(params, cand) << std::endl;
+    }
+
+    // save the tuned config and the report of the sweep
+    const auto& selected = candidates.at(selected_idx);
+    const auto tuned_config_path = output_config_path->value().empty() ? output_dir->value() + "/tuned.yaml" : output_config_path->value();
+    {
+        std::ofstream ofs(tuned_config_path, std::ios::out);
+        if (!ofs.is_open()) {
+            std::cerr << "cannot create a file at " << tuned_config_path << std::endl;
+            return EXIT_FAILURE;
+        }
+        ofs << "# tuned by run_parameter_tuning: " << describe(params, selected) << std::endl;
+        ofs << "# latency " << latency_percentile->value() << " " << selected.latency_ms_ << " [ms], "
+            << error_metric->value() << " " << selected.error_ << ", CPU utilization " << selected.cpu_utilization_ << " [cores]" << std::endl;
+        ofs << YAML::Dump(create_config(base_node, params, selected)) << std::endl;
+    }
+
+    nlohmann::json candidates_json = nlohmann::json::array();
+    for (const auto& cand : candidates) {
+        nlohmann::json values = nlohmann::json::object();
+        for (unsigned int i = 0; i < cand.value_indices_.size(); ++i) {
+            values[params.at(i).key_] = params.at(i).values_.at(cand.value_indices_.at(i)).as<std::string>();
+        }
+        candidates_json.push_back({{"parameters", values},
+                                   {"config", cand.config_path_},
+                                   {"report", cand.report_path_},
+                                   {"succeeded", cand.is_succeeded_},
+                                   {"latency_ms", cand.latency_ms_},
+                                   {"error", cand.error_},
+                                   {"cpu_utilization", cand.cpu_utilization_},
+                                   {"tracked_ratio", cand.tracked_ratio_},
+                                   {"throughput_fps", cand.throughput_fps_},
+                                   {"within_budget", cand.is_within_budget_},
+                                   {"pareto_optimal", cand.is_pareto_optimal_}});
+    }
+    const nlohmann::json report = {
+        {"latency_percentile", latency_percentile->value()},
+        {"latency_budget_ms", latency_budget_ms->value()},
+        {"cpu_budget", cpu_budget->value()},
+        {"error_metric", error_metric->value()},
+        {"selected", selected_idx},
+        {"tuned_config", tuned_config_path},
+        {"candidates", candidates_json}};
+    const auto report_path = output_dir->value() + "/tuning.json";
+    std::ofstream ofs(report_path, std::ios::out);
+    if (!ofs.is_open()) {
+        std::cerr << "cannot create a file at " << report_path << std::endl;
+        return EXIT_FAILURE;
+    }
+    ofs << std::setw(4) << report << std::endl;
+    spdlog::info("tuned config: {}, tuning report: {}", tuned_config_path, report_path);
+
+    return EXIT_SUCCESS;
+}
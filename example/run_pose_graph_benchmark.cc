@@ -0,0 +1,230 @@
+#include "stella_vslam/type.h"
+#include "stella_vslam/optimize/graph_optimizer.h"
+#include "stella_vslam/optimize/linear_solver_type.h"
+
+#include <iostream>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <sstream>
+#include <unordered_set>
+
+#include <spdlog/spdlog.h>
+#include <popl.hpp>
+
+#ifdef USE_STACK_TRACE_LOGGER
+#include <backward.hpp>
+#endif
+
+#ifdef USE_GOOGLE_PERFTOOLS
+#include <gperftools/profiler.h>
+#endif
+
+namespace {
+
+using stella_vslam::eigen_alloc_unord_map;
+using stella_vslam::eigen_alloc_vector;
+using stella_vslam::Mat33_t;
+using stella_vslam::Vec3_t;
+using stella_vslam::Vec7_t;
+using stella_vslam::optimize::pose_graph_constraint;
+
+//! Synthetic pose graph which imitates the essential graph of a trajectory circling the same area
+struct synthetic_pose_graph {
+    //! ground truth poses
+    eigen_alloc_unord_map<unsigned int, g2o::Sim3> true_Sim3s_cw;
+    //! drifted poses obtained by chaining the noisy odometry
+    eigen_alloc_unord_map<unsigned int, g2o::Sim3> initial_Sim3s_cw;
+    //! spanning tree, covisibility and loop constraints
+    eigen_alloc_vector<pose_graph_constraint> constraints;
+    //! the first keyframe is fixed as the spanning root
+    std::unordered_set<unsigned int> fixed_ids;
+};
+
+g2o::Sim3 perturb(const g2o::Sim3& Sim3, std::mt19937& rng, const double rot_sigma, const double trans_sigma, const double scale_sigma) {
+    std::normal_distribution<double> rot_noise(0.0, rot_sigma);
+    std::normal_distribution<double> trans_noise(0.0, trans_sigma);
+    std::normal_distribution<double> scale_noise(0.0, scale_sigma);
+    Vec7_t update;
+    update << rot_noise(rng), rot_noise(rng), rot_noise(rng),
+        trans_noise(rng), trans_noise(rng), trans_noise(rng),
+        scale_noise(rng);
+    return g2o::Sim3(update) * Sim3;
+}
+
+synthetic_pose_graph create_pose_graph(const unsigned int num_keyfrms, const unsigned int num_keyfrms_per_lap,
+                                       const unsigned int num_covisibilities, const bool fix_scale, std::mt19937& rng) {
+    synthetic_pose_graph graph;
+
+    // Keyframes are placed on a circle (radius: 10 m) and revisit the same places every lap
+    constexpr double radius = 10.0;
+    for (unsigned int id = 0; id < num_keyfrms; ++id) {
+        const double angle = 2.0 * M_PI * static_cast<double>(id % num_keyfrms_per_lap) / num_keyfrms_per_lap;
+        const double height = 0.1 * static_cast<double>(id / num_keyfrms_per_lap);
+        const Mat33_t rot_wc = Eigen::AngleAxisd(-angle, Vec3_t::UnitY()).toRotationMatrix();
+        const Vec3_t trans_wc(radius * std::cos(angle), height, radius * std::sin(angle));
+        graph.true_Sim3s_cw[id] = g2o::Sim3(rot_wc, trans_wc, 1.0).inverse();
+    }
+    graph.fixed_ids.insert(0);
+
+    const double scale_sigma = fix_scale ? 0.0 : 1e-3;
+    const auto measure = [&graph, &rng, scale_sigma](const unsigned int id1, const unsigned int id2) {
+        const g2o::Sim3 Sim3_21 = graph.true_Sim3s_cw.at(id2) * graph.true_Sim3s_cw.at(id1).inverse();
+        return perturb(Sim3_21, rng, 2e-3, 1e-2, scale_sigma);
+    };
+
+    // Spanning tree (odometry) and covisibility constraints between the neighboring keyframes
+    graph.initial_Sim3s_cw[0] = graph.true_Sim3s_cw.at(0);
+    for (unsigned int id1 = 1; id1 < num_keyfrms; ++id1) {
+        for (unsigned int offset = 1; offset <= num_covisibilities && offset <= id1; ++offset) {
+            const unsigned int id2 = id1 - offset;
+            const g2o::Sim3 Sim3_21 = measure(id1, id2);
+            graph.constraints.emplace_back(id1, id2, Sim3_21);
+            if (offset == 1) {
+                // Simulate the drift by chaining the odometry
+                graph.initial_Sim3s_cw[id1] = Sim3_21.inverse() * graph.initial_Sim3s_cw.at(id2);
+            }
+        }
+    }
+
+    // Loop constraints with the keyframes of the previous lap
+    constexpr unsigned int loop_interval = 10;
+    for (unsigned int id1 = num_keyfrms_per_lap; id1 < num_keyfrms; id1 += loop_interval) {
+        const unsigned int id2 = id1 - num_keyfrms_per_lap;
+        graph.constraints.emplace_back(id1, id2, measure(id1, id2));
+    }
+
+    return graph;
+}
+
+double compute_rmse(const eigen_alloc_unord_map<unsigned int, g2o::Sim3>& Sim3s_cw,
+                    const eigen_alloc_unord_map<unsigned int, g2o::Sim3>& true_Sim3s_cw) {
+    double sum_sq = 0.0;
+    for (const auto& id_Sim3_cw : Sim3s_cw) {
+        const Vec3_t trans_wc = id_Sim3_cw.second.inverse().translation();
+        const Vec3_t true_trans_wc = true_Sim3s_cw.at(id_Sim3_cw.first).inverse().translation();
+        sum_sq += (trans_wc - true_trans_wc).squaredNorm();
+    }
+    return Sim3s_cw.empty() ? 0.0 : std::sqrt(sum_sq / Sim3s_cw.size());
+}
+
+std::vector<std::string> split(const std::string& str) {
+    std::vector<std::string> tokens;
+    std::stringstream ss(str);
+    std::string token;
+    while (std::getline(ss, token, ',')) {
+        if (!token.empty()) {
+            tokens.push_back(token);
+        }
+    }
+    return tokens;
+}
+
+} // namespace
+
+void run(const std::vector<unsigned int>& nums_keyfrms,
+         const std::vector<stella_vslam::optimize::linear_solver_type_t>& linear_solver_types,
+         const unsigned int num_keyfrms_per_lap,
+         const unsigned int num_covisibilities,
+         const bool fix_scale,
+         const unsigned int seed) {
+    for (const auto num_keyfrms : nums_keyfrms) {
+        std::mt19937 rng(seed);
+        const auto graph = create_pose_graph(num_keyfrms, num_keyfrms_per_lap, num_covisibilities, fix_scale, rng);
+        spdlog::info("pose graph: {} keyframes, {} constraints (initial RMSE: {:.4f} m)",
+                     graph.initial_Sim3s_cw.size(), graph.constraints.size(),
+                     compute_rmse(graph.initial_Sim3s_cw, graph.true_Sim3s_cw));
+
+        for (const auto linear_solver_type : linear_solver_types) {
+            const stella_vslam::optimize::graph_optimizer optimizer(fix_scale, linear_solver_type);
+
+            eigen_alloc_unord_map<unsigned int, g2o::Sim3> corrected_Sim3s_cw;
+            const auto tp_1 = std::chrono::steady_clock::now();
+            const auto num_iter = optimizer.optimize_pose_graph(graph.initial_Sim3s_cw, graph.fixed_ids, graph.constraints, corrected_Sim3s_cw);
+            const auto tp_2 = std::chrono::steady_clock::now();
+
+            const auto elapsed_ms = std::chrono::duration_cast<std::chrono::duration<double, std::milli>>(tp_2 - tp_1).count();
+            std::cout << num_keyfrms << "\t"
+                      << stella_vslam::optimize::linear_solver_type_to_string.at(static_cast<unsigned int>(linear_solver_type)) << "\t"
+                      << num_iter << " iterations\t"
+                      << elapsed_ms << " ms\t"
+                      << "RMSE: " << compute_rmse(corrected_Sim3s_cw, graph.true_Sim3s_cw) << " m" << std::endl;
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+#ifdef USE_STACK_TRACE_LOGGER
+    backward::SignalHandling sh;
+#endif
+
+    // create options
+    popl::OptionParser op("Allowed options");
+    auto help = op.add<popl::Switch>("h", "help", "produce help message");
+    auto nums_keyfrms_str = op.add<popl::Value<std::string>>("n", "num-keyframes", "comma-separated numbers of the keyframes", "1000,10000,50000");
+    auto linear_solvers_str = op.add<popl::Value<std::string>>("s", "linear-solvers", "comma-separated linear solvers (eigen, csparse, dense, pcg, cholmod)", "eigen,csparse");
+    auto num_keyfrms_per_lap = op.add<popl::Value<unsigned int>>("", "keyframes-per-lap", "number of the keyframes per lap of the trajectory", 500);
+    auto num_covisibilities = op.add<popl::Value<unsigned int>>("", "covisibilities", "number of the covisibility constraints of each keyframe", 3);
+    auto fix_scale = op.add<popl::Switch>("", "fix-scale", "optimize SE3 instead of Sim3");
+    auto seed = op.add<popl::Value<unsigned int>>("", "seed", "seed of the noise", 0);
+    auto log_level = op.add<popl::Value<std::string>>("", "log-level", "log level", "info");
+    try {
+        op.parse(argc, argv);
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        std::cerr << std::endl;
+        std::cerr << op << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // check validness of options
+    if (help->is_set()) {
+        std::cerr << op << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (!op.unknown_options().empty()) {
+        for (const auto& unknown_option : op.unknown_options()) {
+            std::cerr << "unknown_options: " << unknown_option << std::endl;
+        }
+        std::cerr << op << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (num_keyfrms_per_lap->value() == 0) {
+        std::cerr << "invalid arguments" << std::endl;
+        std::cerr << std::endl;
+        std::cerr << op << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // setup logger
+    spdlog::set_pattern("[%Y-%m-%d %H:%M:%S.%e] %^[%L] %v%$");
+    spdlog::set_level(spdlog::level::from_str(log_level->value()));
+
+    std::vector<unsigned int> nums_keyfrms;
+    std::vector<stella_vslam::optimize::linear_solver_type_t> linear_solver_types;
+    try {
+        for (const auto& num_keyfrms_str : split(nums_keyfrms_str->value())) {
+            nums_keyfrms.push_back(static_cast<unsigned int>(std::stoul(num_keyfrms_str)));
+        }
+        for (const auto& linear_solver_str : split(linear_solvers_str->value())) {
+            linear_solver_types.push_back(stella_vslam::optimize::load_linear_solver_type(linear_solver_str));
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+#ifdef USE_GOOGLE_PERFTOOLS
+    ProfilerStart("pose_graph_benchmark.prof");
+#endif
+
+    run(nums_keyfrms, linear_solver_types, num_keyfrms_per_lap->value(), num_covisibilities->value(), fix_scale->is_set(), seed->value());
+
+#ifdef USE_GOOGLE_PERFTOOLS
+    ProfilerStop();
+#endif
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,182 @@
+#include "stella_vslam/system.h"
+#include "stella_vslam/config.h"
+#include "stella_vslam/io/replay_log.h"
+#include "stella_vslam/util/yaml.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <thread>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+#include <popl.hpp>
+
+#ifdef USE_STACK_TRACE_LOGGER
+#include <backward.hpp>
+#endif
+
+#ifdef USE_GOOGLE_PERFTOOLS
+#include <gperftools/profiler.h>
+#endif
+
+struct replayed_frame {
+    unsigned int idx_;
+    double timestamp_;
+    //! feeding time in the recorded run [ms]
+    double recorded_time_ms_;
+    //! feeding time in the replay [ms]
+    double replayed_time_ms_;
+};
+
+void replay(const std::shared_ptr<stella_vslam::system>& slam,
+            const std::string& log_dir_path,
+            const unsigned int num_slowest_frms,
+            const std::string& timing_csv_path,
+            const std::string& latency_trace_path,
+            const std::string& eval_log_dir) {
+    std::vector<replayed_frame> replayed_frms;
+    slam->replay(log_dir_path, [&replayed_frms](const stella_vslam::io::replay_frame& frm, const double feed_time_ms) {
+        replayed_frms.push_back({frm.idx_, frm.timestamp_, frm.feed_time_ms_, feed_time_ms});
+    });
+
+    // wait until the loop BA is finished
+    while (slam->loop_BA_is_running()) {
+        std::this_thread::sleep_for(std::chrono::microseconds(5000));
+    }
+
+    // shutdown the slam process
+    slam->shutdown();
+
+    if (!timing_csv_path.empty()) {
+        std::ofstream ofs(timing_csv_path, std::ios::out);
+        if (!ofs.is_open()) {
+            throw std::runtime_error("cannot create a file at " + timing_csv_path);
+        }
+        ofs << "frame,timestamp,recorded_ms,replayed_ms" << std::endl;
+        ofs << std::fixed << std::setprecision(6);
+        for (const auto& frm : replayed_frms) {
+            ofs << frm.idx_ << "," << frm.timestamp_ << "," << frm.recorded_time_ms_ << "," << frm.replayed_time_ms_ << std::endl;
+        }
+    }
+
+    // report the slowest frames of the replay
+    std::sort(replayed_frms.begin(), replayed_frms.end(), [](const replayed_frame& a, const replayed_frame& b) {
+        return a.replayed_time_ms_ > b.replayed_time_ms_;
+    });
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "replayed " << replayed_frms.size() << " frames, the slowest frames:" << std::endl;
+    for (unsigned int i = 0; i < std::min<size_t>(num_slowest_frms, replayed_frms.size()); ++i) {
+        const auto& frm = replayed_frms.at(i);
+        std::cout << "frame " << frm.idx_ << " (timestamp " << frm.timestamp_ << "): replayed " << frm.replayed_time_ms_
+                  << "[ms], recorded " << frm.recorded_time_ms_ << "[ms]" << std::endl;
+    }
+
+    if (!latency_trace_path.empty()) {
+        slam->save_latency_trace(latency_trace_path);
+    }
+
+    if (!eval_log_dir.empty()) {
+        // output the trajectories for evaluation
+        slam->save_frame_trajectory(eval_log_dir + "/frame_trajectory.txt", "TUM");
+        slam->save_keyframe_trajectory(eval_log_dir + "/keyframe_trajectory.txt", "TUM");
+    }
+}
+
+int main(int argc, char* argv[]) {
+#ifdef USE_STACK_TRACE_LOGGER
+    backward::SignalHandling sh;
+#endif
+
+    // create options
+    popl::OptionParser op("Allowed options");
+    auto help = op.add<popl::Switch>("h", "help", "produce help message");
+    auto vocab_file_path = op.add<popl::Value<std::string>>("v", "vocab", "vocabulary file path");
+    auto config_file_path = op.add<popl::Value<std::string>>("c", "config", "config file path (same as the recorded run)");
+    auto log_dir_path = op.add<popl::Value<std::string>>("l", "log-dir", "directory of the replay log (recorded with System.record_dir)");
+    auto keep_loop_detector = op.add<popl::Switch>("", "keep-loop-detector", "keep the loop detector enabled (the replay might not be repeatable)");
+    auto num_slowest_frms = op.add<popl::Value<unsigned int>>("", "slowest", "number of the slowest frames to report", 10);
+    auto timing_csv_path = op.add<popl::Value<std::string>>("", "timing-csv", "store the recorded and replayed feeding times (CSV) at this path", "");
+    auto latency_trace_path = op.add<popl::Value<std::string>>("", "latency-trace", "store the stage latencies in the Chrome trace event format at this path", "");
+    auto log_level = op.add<popl::Value<std::string>>("", "log-level", "log level", "info");
+    auto eval_log_dir = op.add<popl::Value<std::string>>("", "eval-log-dir", "store trajectory at this path (Specify the directory where it exists.)", "");
+    try {
+        op.parse(argc, argv);
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        std::cerr << std::endl;
+        std::cerr << op << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // check validness of options
+    if (help->is_set()) {
+        std::cerr << op << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (!op.unknown_options().empty()) {
+        for (const auto& unknown_option : op.unknown_options()) {
+            std::cerr << "unknown_options: " << unknown_option << std::endl;
+        }
+        std::cerr << op << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (!vocab_file_path->is_set() || !config_file_path->is_set() || !log_dir_path->is_set()) {
+        std::cerr << "invalid arguments" << std::endl;
+        std::cerr << std::endl;
+        std::cerr << op << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // setup logger
+    spdlog::set_pattern("[%Y-%m-%d %H:%M:%S.%e] %^[%L] %v%$");
+    spdlog::set_level(spdlog::level::from_str(log_level->value()));
+
+    // load configuration
+    std::shared_ptr<stella_vslam::config> cfg;
+    try {
+        cfg = std::make_shared<stella_vslam::config>(config_file_path->value());
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    // the replay must not be recorded over the log
+    if (stella_vslam::util::yaml_optional_ref(cfg->yaml_node_, "System")["record_dir"].as<std::string>("") == log_dir_path->value()) {
+        std::cerr << "System.record_dir must not be the replayed log" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+#ifdef USE_GOOGLE_PERFTOOLS
+    ProfilerStart("slam.prof");
+#endif
+
+    // build a slam system
+    auto slam = std::make_shared<stella_vslam::system>(cfg, vocab_file_path->value());
+    slam->startup();
+    if (!keep_loop_detector->is_set()) {
+        slam->disable_loop_detector();
+    }
+
+    try {
+        replay(slam,
+               log_dir_path->value(),
+               num_slowest_frms->value(),
+               timing_csv_path->value(),
+               latency_trace_path->value(),
+               eval_log_dir->value());
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+#ifdef USE_GOOGLE_PERFTOOLS
+    ProfilerStop();
+#endif
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,84 @@
+#include "stella_vslam/util/yaml.h"
+#include "pangolin_viewer/shm_viewer.h"
+#include "shm_publisher/reader.h"
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include <spdlog/spdlog.h>
+#include <popl.hpp>
+
+#ifdef USE_STACK_TRACE_LOGGER
+#include <backward.hpp>
+#endif
+
+int main(int argc, char* argv[]) {
+#ifdef USE_STACK_TRACE_LOGGER
+    backward::SignalHandling sh;
+#endif
+
+    // create options
+    popl::OptionParser op("Allowed options");
+    auto help = op.add<popl::Switch>("h", "help", "produce help message");
+    auto config_file_path = op.add<popl::Value<std::string>>("c", "config", "config file path (the PangolinViewer section)", "");
+    auto shm_name = op.add<popl::Value<std::string>>("", "shm-name", "name of the shared memory written by ShmPublisher", "/stella_vslam");
+    auto log_level = op.add<popl::Value<std::string>>("", "log-level", "log level", "info");
+    try {
+        op.parse(argc, argv);
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        std::cerr << std::endl;
+        std::cerr << op << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // check validness of options
+    if (help->is_set()) {
+        std::cerr << op << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (!op.unknown_options().empty()) {
+        for (const auto& unknown_option : op.unknown_options()) {
+            std::cerr << "unknown_options: " << unknown_option << std::endl;
+        }
+        std::cerr << op << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // setup logger
+    spdlog::set_pattern("[%Y-%m-%d %H:%M:%S.%e] %^[%L] %v%$");
+    spdlog::set_level(spdlog::level::from_str(log_level->value()));
+
+    // load configuration (the defaults of the viewer are used without it)
+    YAML::Node yaml_node;
+    if (!config_file_path->value().empty()) {
+        try {
+            yaml_node = YAML::LoadFile(config_file_path->value());
+        }
+        catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    // wait until the SLAM process creates the shared memory
+    std::shared_ptr<shm_publisher::reader> reader;
+    while (!reader) {
+        try {
+            reader = std::make_shared<shm_publisher::reader>(shm_name->value());
+        }
+        catch (const std::exception& e) {
+            spdlog::debug("waiting for the shared memory {}: {}", shm_name->value(), e.what());
+            std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        }
+    }
+
+    pangolin_viewer::shm_viewer viewer(stella_vslam::util::yaml_optional_ref(yaml_node, "PangolinViewer"), reader);
+    viewer.run();
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,388 @@
+#include "util/benchmark_util.h"
+#include "util/synthetic_scene.h"
+
+#include "stella_vslam/system.h"
+#include "stella_vslam/config.h"
+#include "stella_vslam/camera/base.h"
+#include "stella_vslam/camera/perspective.h"
+#include "stella_vslam/data/common.h"
+#include "stella_vslam/data/frame.h"
+#include "stella_vslam/feature/orb_params.h"
+#include "stella_vslam/util/yaml.h"
+
+#include <iostream>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <sstream>
+#include <thread>
+
+#include <Eigen/Geometry>
+#include <opencv2/core/mat.hpp>
+#include <nlohmann/json.hpp>
+#include <spdlog/spdlog.h>
+#include <popl.hpp>
+#include <yaml-cpp/yaml.h>
+
+#ifdef USE_STACK_TRACE_LOGGER
+#include <backward.hpp>
+#endif
+
+#ifdef USE_GOOGLE_PERFTOOLS
+#include <gperftools/profiler.h>
+#endif
+
+namespace {
+
+//! Create a frame from the keypoints synthesized in the scene (the ORB extraction is skipped)
+stella_vslam::data::frame create_synthetic_frame(synthetic_scene& scene, const stella_vslam::Mat44_t& pose_cw, const double timestamp,
+                                                 stella_vslam::camera::base* camera, stella_vslam::feature::orb_params* orb_params) {
+    stella_vslam::data::frame_observation frm_obs;
+    std::vector<float> depths;
+    scene.synthesize_keypoints(pose_cw, frm_obs.undist_keypts_, frm_obs.descriptors_, depths);
+    frm_obs.num_keypts_ = frm_obs.undist_keypts_.size();
+    frm_obs.update_keypoints_soa();
+    camera->convert_keypoints_to_bearings(frm_obs.undist_keypts_, frm_obs.bearings_);
+    if (camera->setup_type_ != stella_vslam::camera::setup_type_t::Monocular) {
+        // the depths are known as if measured with the depthmap
+        frm_obs.depths_ = depths;
+        frm_obs.stereo_x_right_.resize(frm_obs.num_keypts_);
+        for (unsigned int idx = 0; idx < frm_obs.num_keypts_; ++idx) {
+            frm_obs.stereo_x_right_.at(idx) = frm_obs.undist_keypts_.at(idx).pt.x - camera->focal_x_baseline_ / depths.at(idx);
+        }
+    }
+    stella_vslam::data::assign_keypoints_to_grid(camera, frm_obs.undist_keypts_, frm_obs.keypt_indices_in_cells_);
+    return stella_vslam::data::frame(timestamp, camera, orb_params, std::move(frm_obs),
+                                     std::unordered_map<unsigned int, stella_vslam::data::marker2d>());
+}
+
+//! Compute the RMSE of the camera centers after the alignment (with the scale if monocular)
+double compute_ate_rmse(const stella_vslam::eigen_alloc_vector<stella_vslam::Mat44_t>& est_poses_cw,
+                        const stella_vslam::eigen_alloc_vector<stella_vslam::Mat44_t>& true_poses_cw,
+                        const bool with_scaling) {
+    const auto num_poses = est_poses_cw.size();
+    if (num_poses < 3) {
+        return 0.0;
+    }
+    Eigen::Matrix<double, 3, Eigen::Dynamic> est_centers(3, num_poses), true_centers(3, num_poses);
+    for (unsigned int i = 0; i < num_poses; ++i) {
+        est_centers.col(i) = -est_poses_cw.at(i).block<3, 3>(0, 0).transpose() * est_poses_cw.at(i).block<3, 1>(0, 3);
+        true_centers.col(i) = -true_poses_cw.at(i).block<3, 3>(0, 0).transpose() * true_poses_cw.at(i).block<3, 1>(0, 3);
+    }
+    const Eigen::Matrix4d alignment = Eigen::umeyama(est_centers, true_centers, with_scaling);
+    const Eigen::Matrix<double, 3, Eigen::Dynamic> aligned_centers
+        = (alignment.block<3, 3>(0, 0) * est_centers).colwise() + alignment.block<3, 1>(0, 3);
+    return std::sqrt((aligned_centers - true_centers).colwise().squaredNorm().mean());
+}
+
+//! Parse the comma-separated numbers of the threads
+std::vector<unsigned int> parse_nums_threads(const std::string& str) {
+    std::vector<unsigned int> nums_threads;
+    std::stringstream ss(str);
+    std::string token;
+    while (std::getline(ss, token, ',')) {
+        const auto num_threads = std::stoi(token);
+        if (num_threads <= 0) {
+            throw std::runtime_error("the numbers of the threads must be positive: " + str);
+        }
+        nums_threads.push_back(static_cast<unsigned int>(num_threads));
+    }
+    if (nums_threads.empty()) {
+        throw std::runtime_error("no number of the threads is given");
+    }
+    return nums_threads;
+}
+
+/**
+ * Run the benchmark with each number of the worker threads in a child process, and save the scaling curves
+ * (the OpenMP runtime reads the number of the threads only at the process startup, so every run is a fresh process
+ *  with OMP_NUM_THREADS, which also isolates the runs from the caches, the allocator and the lock statistics of the others)
+ * @param executable_path path of this runner
+ * @param child_args arguments of the runs except the number of the threads and the report path
+ * @param nums_threads
+ * @param report_path
+ */
+void run_thread_scaling(const std::string& executable_path, const std::string& child_args,
+                        const std::vector<unsigned int>& nums_threads, const std::string& report_path) {
+    const auto extension_pos = report_path.rfind(".json");
+    const auto report_stem = (extension_pos == std::string::npos) ? report_path : report_path.substr(0, extension_pos);
+
+    nlohmann::json runs = nlohmann::json::array();
+    double base_fps = 0.0;
+    for (const auto num_threads : nums_threads) {
+        const auto run_report_path = report_stem + "_" + std::to_string(num_threads) + "threads.json";
+        const auto command = "OMP_NUM_THREADS=" + std::to_string(num_threads) + " " + quote_shell_argument(executable_path) + child_args
+                             + " --num-threads " + std::to_string(num_threads) + " --benchmark-report " + quote_shell_argument(run_report_path);
+        spdlog::info("run with {} threads: {}", num_threads, command);
+        if (std::system(command.c_str()) != 0) {
+            throw std::runtime_error("the run with " + std::to_string(num_threads) + " threads failed");
+        }
+
+        std::ifstream ifs(run_report_path);
+        if (!ifs.is_open()) {
+            throw std::runtime_error("cannot load the report at " + run_report_path);
+        }
+        nlohmann::json run_report;
+        ifs >> run_report;
+
+        const double fps = run_report.at("throughput_fps").get<double>();
+        if (base_fps == 0.0) {
+            base_fps = fps;
+        }
+        double lock_wait_ms = 0.0;
+        for (const auto& wait : run_report.at("lock_wait_ms")) {
+            lock_wait_ms += wait.get<double>();
+        }
+        const double speedup = fps / base_fps;
+        runs.push_back({{"num_threads", num_threads},
+                        {"throughput_fps", fps},
+                        // (relative to the first number of the threads)
+                        {"speedup", speedup},
+                        {"efficiency", speedup * nums_threads.front() / num_threads},
+                        {"cpu_utilization", run_report.at("cpu_utilization")},
+                        {"lock_wait_ms_total", lock_wait_ms},
+                        {"lock_wait_ms", run_report.at("lock_wait_ms")},
+                        {"tracked_ratio", run_report.at("results").value("tracked_ratio", 0.0)},
+                        {"report", run_report_path}});
+    }
+
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "threads, throughput [fps], speedup, CPU utilization [cores] of tracking / mapping / global optimization / loop BA / others, lock wait [ms]" << std::endl;
+    for (const auto& run : runs) {
+        const auto& cpu_utilization = run.at("cpu_utilization");
+        std::cout << run.at("num_threads").get<unsigned int>() << ", " << run.at("throughput_fps").get<double>() << ", " << run.at("speedup").get<double>() << ",";
+        for (const auto& name : {"tracking", "mapping", "global_optimization", "loop_BA", "others"}) {
+            std::cout << " " << cpu_utilization.value(name, 0.0);
+        }
+        std::cout << ", " << run.at("lock_wait_ms_total").get<double>() << std::endl;
+    }
+
+    const nlohmann::json report = {
+        {"environment", {{"hardware_concurrency", std::thread::hardware_concurrency()}}},
+        {"runs", runs}};
+    std::ofstream ofs(report_path, std::ios::out);
+    if (!ofs.is_open()) {
+        throw std::runtime_error("cannot create a file at " + report_path);
+    }
+    ofs << std::setw(4) << report << std::endl;
+    spdlog::info("thread scaling report: {}", report_path);
+}
+
+} // namespace
+
+void run(const std::shared_ptr<stella_vslam::system>& slam,
+         const std::shared_ptr<stella_vslam::config>& cfg,
+         const unsigned int num_frames,
+         const unsigned int num_frames_per_lap,
+         const bool synthesize_keypoints,
+         const unsigned int seed,
+         const unsigned int num_threads,
+         const std::string& benchmark_report_path) {
+    auto camera = slam->get_camera();
+    const auto perspective = dynamic_cast<stella_vslam::camera::perspective*>(camera);
+    if (!perspective || perspective->eigen_dist_params_.norm() != 0.0) {
+        throw std::runtime_error("the synthetic scene supports only the perspective camera without distortion");
+    }
+    const auto setup_type = camera->setup_type_;
+
+    spdlog::info("create the synthetic scene");
+    synthetic_scene scene(camera->cols_, camera->rows_, perspective->fx_, perspective->fy_, perspective->cx_, perspective->cy_,
+                          num_frames_per_lap, seed);
+    // (the ORB parameters of the synthesized keypoints, which outlive the keyframes in the map)
+    std::unique_ptr<stella_vslam::feature::orb_params> orb_params(
+        new stella_vslam::feature::orb_params(stella_vslam::util::yaml_optional_ref(cfg->yaml_node_, "Feature")));
+    const cv::Mat blank_img = cv::Mat::zeros(camera->rows_, camera->cols_, CV_8UC1);
+    const double baseline = camera->focal_x_baseline_ / perspective->fx_;
+
+    benchmark_recorder recorder(slam);
+    stella_vslam::eigen_alloc_vector<stella_vslam::Mat44_t> est_poses_cw;
+    stella_vslam::eigen_alloc_vector<stella_vslam::Mat44_t> true_poses_cw;
+    double render_time = 0.0;
+
+    recorder.start();
+    for (unsigned int i = 0; i < num_frames; ++i) {
+        const stella_vslam::Mat44_t pose_cw = scene.get_pose_cw(i);
+        const double timestamp = i / camera->fps_;
+
+        // the rendering is not included in the feed time
+        const auto tp_0 = std::chrono::steady_clock::now();
+        stella_vslam::data::frame frm;
+        cv::Mat img, right_img, depth;
+        if (synthesize_keypoints) {
+            frm = create_synthetic_frame(scene, pose_cw, timestamp, camera, orb_params.get());
+        }
+        else if (setup_type == stella_vslam::camera::setup_type_t::Stereo) {
+            img = scene.render(pose_cw);
+            // the right camera is shifted along the x-axis of the left one
+            stella_vslam::Mat44_t right_pose_cw = pose_cw;
+            right_pose_cw(0, 3) -= baseline;
+            right_img = scene.render(right_pose_cw);
+        }
+        else {
+            img = scene.render(pose_cw, (setup_type == stella_vslam::camera::setup_type_t::RGBD) ? &depth : nullptr);
+        }
+        const auto tp_1 = std::chrono::steady_clock::now();
+
+        std::shared_ptr<stella_vslam::Mat44_t> est_pose_cw;
+        if (synthesize_keypoints) {
+            est_pose_cw = slam->feed_frame(std::move(frm), blank_img);
+        }
+        else if (setup_type == stella_vslam::camera::setup_type_t::Monocular) {
+            est_pose_cw = slam->feed_monocular_frame(img, timestamp);
+        }
+        else if (setup_type == stella_vslam::camera::setup_type_t::Stereo) {
+            est_pose_cw = slam->feed_stereo_frame(img, right_img, timestamp);
+        }
+        else {
+            est_pose_cw = slam->feed_RGBD_frame(img, depth, timestamp);
+        }
+
+        const auto tp_2 = std::chrono::steady_clock::now();
+        render_time += std::chrono::duration<double>(tp_1 - tp_0).count();
+        recorder.add_frame(i, std::chrono::duration<double>(tp_2 - tp_1).count());
+        if (est_pose_cw) {
+            est_poses_cw.push_back(*est_pose_cw);
+            true_poses_cw.push_back(pose_cw);
+        }
+
+        if (slam->terminate_is_requested()) {
+            break;
+        }
+    }
+    recorder.stop();
+
+    // wait until the loop BA is finished
+    while (slam->loop_BA_is_running()) {
+        std::this_thread::sleep_for(std::chrono::microseconds(5000));
+    }
+
+    // (the poses are the ones estimated at the frames, which are not refined by the mapping and the loop closure)
+    const bool with_scaling = setup_type == stella_vslam::camera::setup_type_t::Monocular;
+    recorder.add_result("tracked_ratio", static_cast<double>(est_poses_cw.size()) / num_frames);
+    recorder.add_result("ate_rmse_m", compute_ate_rmse(est_poses_cw, true_poses_cw, with_scaling));
+    recorder.add_result("render_time_ms", 1000.0 * render_time / num_frames);
+    if (0 < num_threads) {
+        recorder.add_result("num_threads", num_threads);
+    }
+
+    slam->shutdown();
+    recorder.record_cpu_times();
+
+    recorder.print_summary();
+    if (!benchmark_report_path.empty()) {
+        recorder.save_report(benchmark_report_path, synthesize_keypoints ? "synthetic (keypoints)" : "synthetic (rendered)");
+    }
+}
+
+int main(int argc, char* argv[]) {
+#ifdef USE_STACK_TRACE_LOGGER
+    backward::SignalHandling sh;
+#endif
+
+    // create options
+    popl::OptionParser op("Allowed options");
+    auto help = op.add<popl::Switch>("h", "help", "produce help message");
+    auto vocab_file_path = op.add<popl::Value<std::string>>("v", "vocab", "vocabulary file path");
+    auto config_file_path = op.add<popl::Value<std::string>>("c", "config", "config file path (perspective camera without distortion, Monocular, Stereo or RGBD with depthmap_factor of 1)");
+    auto num_frames = op.add<popl::Value<unsigned int>>("n", "num-frames", "number of the frames", 600);
+    auto num_frames_per_lap = op.add<popl::Value<unsigned int>>("", "frames-per-lap", "number of the frames per lap of the trajectory (a loop is closed at every lap)", 300);
+    auto synthesize_keypoints = op.add<popl::Switch>("", "keypoints", "synthesize the keypoints and the descriptors instead of rendering the images (tracking-only, the optical flow must be disabled)");
+    auto seed = op.add<popl::Value<unsigned int>>("", "seed", "seed of the scene", 0);
+    auto log_level = op.add<popl::Value<std::string>>("", "log-level", "log level", "info");
+    auto benchmark_report_path = op.add<popl::Value<std::string>>("", "benchmark-report", "store a benchmark report (JSON) at this path", "");
+    auto num_threads = op.add<popl::Value<unsigned int>>("", "num-threads", "number of the worker threads of the shared thread pool (ThreadPool.num_threads of the config if 0)", 0);
+    auto thread_scaling = op.add<popl::Value<std::string>>("", "thread-scaling", "run with each of the comma-separated numbers of the worker threads (e.g. 1,2,4,8,16) in the child processes, which also set OMP_NUM_THREADS, and store the scaling report at the benchmark report path", "");
+    try {
+        op.parse(argc, argv);
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        std::cerr << std::endl;
+        std::cerr << op << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // check validness of options
+    if (help->is_set()) {
+        std::cerr << op << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (!op.unknown_options().empty()) {
+        for (const auto& unknown_option : op.unknown_options()) {
+            std::cerr << "unknown_options: " << unknown_option << std::endl;
+        }
+        std::cerr << op << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (!vocab_file_path->is_set() || !config_file_path->is_set() || num_frames->value() == 0 || num_frames_per_lap->value() == 0) {
+        std::cerr << "invalid arguments" << std::endl;
+        std::cerr << std::endl;
+        std::cerr << op << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // setup logger
+    spdlog::set_pattern("[%Y-%m-%d %H:%M:%S.%e] %^[%L] %v%$");
+    spdlog::set_level(spdlog::level::from_str(log_level->value()));
+
+    if (thread_scaling->is_set()) {
+        std::string child_args = " -v " + quote_shell_argument(vocab_file_path->value()) + " -c " + quote_shell_argument(config_file_path->value())
+                                 + " -n " + std::to_string(num_frames->value()) + " --frames-per-lap " + std::to_string(num_frames_per_lap->value())
+                                 + " --seed " + std::to_string(seed->value()) + " --log-level " + quote_shell_argument(log_level->value());
+        if (synthesize_keypoints->is_set()) {
+            child_args += " --keypoints";
+        }
+        try {
+            run_thread_scaling(argv[0], child_args, parse_nums_threads(thread_scaling->value()),
+                               benchmark_report_path->value().empty() ? "thread_scaling.json" : benchmark_report_path->value());
+        }
+        catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+
+    // load configuration
+    std::shared_ptr<stella_vslam::config> cfg;
+    try {
+        cfg = std::make_shared<stella_vslam::config>(config_file_path->value());
+        if (0 < num_threads->value()) {
+            // the shared thread pool runs the parallel tasks of all the modules
+            YAML::Node yaml_node = YAML::Clone(cfg->yaml_node_);
+            yaml_node["ThreadPool"]["num_threads"] = num_threads->value();
+            cfg = std::make_shared<stella_vslam::config>(yaml_node, config_file_path->value());
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+#ifdef USE_GOOGLE_PERFTOOLS
+    ProfilerStart("slam.prof");
+#endif
+
+    // build a slam system
+    auto slam = std::make_shared<stella_vslam::system>(cfg, vocab_file_path->value());
+    slam->startup();
+
+    try {
+        run(slam, cfg, num_frames->value(), num_frames_per_lap->value(), synthesize_keypoints->is_set(), seed->value(),
+            num_threads->value(), benchmark_report_path->value());
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        slam->shutdown();
+        return EXIT_FAILURE;
+    }
+
+#ifdef USE_GOOGLE_PERFTOOLS
+    ProfilerStop();
+#endif
+
+    return EXIT_SUCCESS;
+}
@@ -1,3 +1,5 @@
+#include "util/benchmark_util.h"
+#include "util/image_sequence_source.h"
 #include "util/tum_rgbd_util.h"
 
 #ifdef USE_PANGOLIN_VIEWER
@@ -43,7 +45,11 @@ void mono_tracking(const std::shared_ptr<stella_vslam::system>& slam,
                    const bool wait_loop_ba,
                    const bool auto_term,
                    const std::string& eval_log_dir,
-                   const std::string& map_db_path) {
+                   const std::string& map_db_path,
+                   const std::string& benchmark_report_path,
+                   const unsigned int num_decode_threads,
+                   const unsigned int read_ahead,
+                   const bool preload) {
     tum_rgbd_sequence sequence(sequence_dir_path);
     const auto frames = sequence.get_frames();
 
@@ -60,8 +66,24 @@ void mono_tracking(const std::shared_ptr<stella_vslam::system>& slam,
     std::vector<double> track_times;
     track_times.reserve(frames.size());
 
+    // in the benchmark mode, the frames are fed as fast as possible
+    const bool benchmark_mode = !benchmark_report_path.empty();
+    std::unique_ptr<benchmark_recorder> recorder(benchmark_mode ? new benchmark_recorder(slam) : nullptr);
+
+    const auto load_images = [&frames](const unsigned int i) -> std::vector<cv::Mat> {
+        const auto& frame = frames.at(i);
+        return {cv::imread(frame.rgb_img_path_, cv::IMREAD_UNCHANGED)};
+    };
+
+    // the images of the upcoming frames are decoded ahead on the decode threads
+    image_sequence_source source(frames.size(), load_images, num_decode_threads, read_ahead, preload);
+
     // run the slam in another thread
     std::thread thread([&]() {
+        if (benchmark_mode) {
+            recorder->start();
+        }
+
         for (unsigned int i = 0; i < frames.size(); ++i) {
             // wait until the loop BA is finished
             if (wait_loop_ba) {
@@ -71,7 +93,8 @@ void mono_tracking(const std::shared_ptr<stella_vslam::system>& slam,
             }
 
             const auto& frame = frames.at(i);
-            const auto rgb_img = cv::imread(frame.rgb_img_path_, cv::IMREAD_UNCHANGED);
+            const auto imgs = source.get(i);
+            const cv::Mat& rgb_img = imgs.at(0);
 
             const auto tp_1 = std::chrono::steady_clock::now();
 
@@ -85,10 +108,13 @@ void mono_tracking(const std::shared_ptr<stella_vslam::system>& slam,
             const auto track_time = std::chrono::duration_cast<std::chrono::duration<double>>(tp_2 - tp_1).count();
             if (i % frame_skip == 0) {
                 track_times.push_back(track_time);
+                if (benchmark_mode) {
+                    recorder->add_frame(i, track_time);
+                }
             }
 
             // wait until the timestamp of the next frame
-            if (!no_sleep && i < frames.size() - 1) {
+            if (!no_sleep && !benchmark_mode && i < frames.size() - 1) {
                 const auto wait_time = frames.at(i + 1).timestamp_ - (frame.timestamp_ + track_time);
                 if (0.0 < wait_time) {
                     std::this_thread::sleep_for(std::chrono::microseconds(static_cast<unsigned int>(wait_time * 1e6)));
@@ -101,6 +127,10 @@ void mono_tracking(const std::shared_ptr<stella_vslam::system>& slam,
             }
         }
 
+        if (benchmark_mode) {
+            recorder->stop();
+        }
+
         // wait until the loop BA is finished
         while (slam->loop_BA_is_running()) {
             std::this_thread::sleep_for(std::chrono::microseconds(5000));
@@ -149,6 +179,11 @@ void mono_tracking(const std::shared_ptr<stella_vslam::system>& slam,
         slam->save_map_database(map_db_path);
     }
 
+    if (benchmark_mode) {
+        recorder->print_summary();
+        recorder->save_report(benchmark_report_path, sequence_dir_path);
+    }
+
     std::sort(track_times.begin(), track_times.end());
     const auto total_track_time = std::accumulate(track_times.begin(), track_times.end(), 0.0);
     std::cout << "median tracking time: " << track_times.at(track_times.size() / 2) << "[s]" << std::endl;
@@ -163,7 +198,11 @@ void rgbd_tracking(const std::shared_ptr<stella_vslam::system>& slam,
                    const bool wait_loop_ba,
                    const bool auto_term,
                    const std::string& eval_log_dir,
-                   const std::string& map_db_path) {
+                   const std::string& map_db_path,
+                   const std::string& benchmark_report_path,
+                   const unsigned int num_decode_threads,
+                   const unsigned int read_ahead,
+                   const bool preload) {
     tum_rgbd_sequence sequence(sequence_dir_path);
     const auto frames = sequence.get_frames();
 
@@ -180,8 +219,25 @@ void rgbd_tracking(const std::shared_ptr<stella_vslam::system>& slam,
     std::vector<double> track_times;
     track_times.reserve(frames.size());
 
+    // in the benchmark mode, the frames are fed as fast as possible
+    const bool benchmark_mode = !benchmark_report_path.empty();
+    std::unique_ptr<benchmark_recorder> recorder(benchmark_mode ? new benchmark_recorder(slam) : nullptr);
+
+    const auto load_images = [&frames](const unsigned int i) -> std::vector<cv::Mat> {
+        const auto& frame = frames.at(i);
+        return {cv::imread(frame.rgb_img_path_, cv::IMREAD_UNCHANGED),
+                cv::imread(frame.depth_img_path_, cv::IMREAD_UNCHANGED)};
+    };
+
+    // the images of the upcoming frames are decoded ahead on the decode threads
+    image_sequence_source source(frames.size(), load_images, num_decode_threads, read_ahead, preload);
+
     // run the slam in another thread
     std::thread thread([&]() {
+        if (benchmark_mode) {
+            recorder->start();
+        }
+
         for (unsigned int i = 0; i < frames.size(); ++i) {
             // wait until the loop BA is finished
             if (wait_loop_ba) {
@@ -191,8 +247,9 @@ void rgbd_tracking(const std::shared_ptr<stella_vslam::system>& slam,
             }
 
             const auto& frame = frames.at(i);
-            const auto rgb_img = cv::imread(frame.rgb_img_path_, cv::IMREAD_UNCHANGED);
-            const auto depth_img = cv::imread(frame.depth_img_path_, cv::IMREAD_UNCHANGED);
+            const auto imgs = source.get(i);
+            const cv::Mat& rgb_img = imgs.at(0);
+            const cv::Mat& depth_img = imgs.at(1);
 
             const auto tp_1 = std::chrono::steady_clock::now();
 
@@ -206,10 +263,13 @@ void rgbd_tracking(const std::shared_ptr<stella_vslam::system>& slam,
             const auto track_time = std::chrono::duration_cast<std::chrono::duration<double>>(tp_2 - tp_1).count();
             if (i % frame_skip == 0) {
                 track_times.push_back(track_time);
+                if (benchmark_mode) {
+                    recorder->add_frame(i, track_time);
+                }
             }
 
             // wait until the timestamp of the next frame
-            if (!no_sleep && i < frames.size() - 1) {
+            if (!no_sleep && !benchmark_mode && i < frames.size() - 1) {
                 const auto wait_time = frames.at(i + 1).timestamp_ - (frame.timestamp_ + track_time);
                 if (0.0 < wait_time) {
                     std::this_thread::sleep_for(std::chrono::microseconds(static_cast<unsigned int>(wait_time * 1e6)));
@@ -222,6 +282,10 @@ void rgbd_tracking(const std::shared_ptr<stella_vslam::system>& slam,
             }
         }
 
+        if (benchmark_mode) {
+            recorder->stop();
+        }
+
         // wait until the loop BA is finished
         while (slam->loop_BA_is_running()) {
             std::this_thread::sleep_for(std::chrono::microseconds(5000));
@@ -270,6 +334,11 @@ void rgbd_tracking(const std::shared_ptr<stella_vslam::system>& slam,
         slam->save_map_database(map_db_path);
     }
 
+    if (benchmark_mode) {
+        recorder->print_summary();
+        recorder->save_report(benchmark_report_path, sequence_dir_path);
+    }
+
     std::sort(track_times.begin(), track_times.end());
     const auto total_track_time = std::accumulate(track_times.begin(), track_times.end(), 0.0);
     std::cout << "median tracking time: " << track_times.at(track_times.size() / 2) << "[s]" << std::endl;
@@ -296,6 +365,10 @@ int main(int argc, char* argv[]) {
     auto map_db_path_in = op.add<popl::Value<std::string>>("i", "map-db-in", "load a map from this path", "");
     auto map_db_path_out = op.add<popl::Value<std::string>>("o", "map-db-out", "store a map database at this path after slam", "");
     auto disable_mapping = op.add<popl::Switch>("", "disable-mapping", "disable mapping");
+    auto benchmark_report_path = op.add<popl::Value<std::string>>("", "benchmark-report", "run as fast as possible, and store a benchmark report (JSON) at this path", "");
+    auto num_decode_threads = op.add<popl::Value<unsigned int>>("", "decode-threads", "number of the threads which decode the images ahead (decoded on the tracking thread if 0)", 1);
+    auto read_ahead = op.add<popl::Value<unsigned int>>("", "read-ahead", "maximum number of the frames decoded ahead", 4);
+    auto preload = op.add<popl::Switch>("", "preload", "decode all of the images into RAM before running slam");
 
     try {
         op.parse(argc, argv);
@@ -376,7 +449,11 @@ int main(int argc, char* argv[]) {
                       wait_loop_ba->is_set(),
                       auto_term->is_set(),
                       eval_log_dir->value(),
-                      map_db_path_out->value());
+                      map_db_path_out->value(),
+                      benchmark_report_path->value(),
+                      num_decode_threads->value(),
+                      read_ahead->value(),
+                      preload->is_set());
     }
     else if (slam->get_camera()->setup_type_ == stella_vslam::camera::setup_type_t::RGBD) {
         rgbd_tracking(slam,
@@ -387,7 +464,11 @@ int main(int argc, char* argv[]) {
                       wait_loop_ba->is_set(),
                       auto_term->is_set(),
                       eval_log_dir->value(),
-                      map_db_path_out->value());
+                      map_db_path_out->value(),
+                      benchmark_report_path->value(),
+                      num_decode_threads->value(),
+                      read_ahead->value(),
+                      preload->is_set());
     }
     else {
         throw std::runtime_error("Invalid setup type: " + slam->get_camera()->get_setup_type_string());
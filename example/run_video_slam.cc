@@ -4,9 +4,12 @@
 #include "socket_publisher/publisher.h"
 #endif
 
+#include "util/video_source.h"
+
 #include "stella_vslam/system.h"
 #include "stella_vslam/config.h"
 #include "stella_vslam/camera/base.h"
+#include "stella_vslam/util/image_converter.h"
 #include "stella_vslam/util/yaml.h"
 
 #include <iostream>
@@ -17,7 +20,6 @@
 #include <opencv2/core/mat.hpp>
 #include <opencv2/core/types.hpp>
 #include <opencv2/imgcodecs.hpp>
-#include <opencv2/videoio.hpp>
 #include <spdlog/spdlog.h>
 #include <popl.hpp>
 
@@ -38,6 +40,8 @@ void mono_tracking(const std::shared_ptr<stella_vslam::system>& slam,
                    const std::string& mask_img_path,
                    const unsigned int frame_skip,
                    const unsigned int start_time,
+                   const unsigned int decode_queue_size,
+                   const bool hw_decode,
                    const bool no_sleep,
                    const bool wait_loop_ba,
                    const bool auto_term,
@@ -57,15 +61,15 @@ void mono_tracking(const std::shared_ptr<stella_vslam::system>& slam,
         stella_vslam::util::yaml_optional_ref(cfg->yaml_node_, "SocketPublisher"), slam, slam->get_frame_publisher(), slam->get_map_publisher());
 #endif
 
-    auto video = cv::VideoCapture(video_file_path, cv::CAP_FFMPEG);
-    if (!video.isOpened()) {
+    // the frames are decoded and converted to grayscale on the decode thread
+    video_source video(video_file_path, start_time, decode_queue_size, hw_decode);
+    if (!video.is_opened()) {
         std::cerr << "Unable to open the video." << std::endl;
         return;
     }
-    video.set(0, start_time);
     std::vector<double> track_times;
 
-    cv::Mat frame;
+    stella_vslam::util::image_buffer frame;
 
     unsigned int num_frame = 0;
     double timestamp = start_timestamp;
@@ -81,13 +85,29 @@ void mono_tracking(const std::shared_ptr<stella_vslam::system>& slam,
                 }
             }
 
-            is_not_end = video.read(frame);
+            is_not_end = video.get(frame);
 
             const auto tp_1 = std::chrono::steady_clock::now();
 
-            if (!frame.empty() && (num_frame % frame_skip == 0)) {
+            if (!is_not_end) {
+                // the video has ended
+            }
+            else if (num_frame % frame_skip == 0) {
                 // input the current frame and estimate the camera pose
-                slam->feed_monocular_frame(frame, timestamp, mask);
+                if (slam->pipelined_extraction_is_enabled()) {
+                    // extraction of the next frame overlaps with tracking of this frame
+                    // (the image is copied by the pipeline, so the buffer is released right after the call)
+                    const stella_vslam::util::scoped_image_buffer_release release(frame);
+                    slam->feed_monocular_frame_async(cv::Mat(frame.height_, frame.width_, CV_8UC1, const_cast<uint8_t*>(frame.data_), frame.stride_),
+                                                     timestamp, mask);
+                }
+                else {
+                    // the decoded buffer is fed without copying, and released by the SLAM system
+                    slam->feed_monocular_frame(frame, timestamp, mask);
+                }
+            }
+            else if (frame.release_) {
+                frame.release_();
             }
 
             const auto tp_2 = std::chrono::steady_clock::now();
@@ -114,6 +134,9 @@ void mono_tracking(const std::shared_ptr<stella_vslam::system>& slam,
             }
         }
 
+        // wait until all the pipelined frames are tracked
+        slam->wait_for_pipelined_frames();
+
         // wait until the loop BA is finished
         while (slam->loop_BA_is_running()) {
             std::this_thread::sleep_for(std::chrono::microseconds(5000));
@@ -182,6 +205,8 @@ int main(int argc, char* argv[]) {
     auto mask_img_path = op.add<popl::Value<std::string>>("", "mask", "mask image path", "");
     auto frame_skip = op.add<popl::Value<unsigned int>>("", "frame-skip", "interval of frame skip", 1);
     auto start_time = op.add<popl::Value<unsigned int>>("s", "start-time", "time to start playing [milli seconds]", 0);
+    auto decode_queue_size = op.add<popl::Value<unsigned int>>("", "decode-queue-size", "maximum number of the frames decoded ahead of the tracking", 4);
+    auto hw_decode = op.add<popl::Switch>("", "hw-decode", "use the hardware video decoder if available");
     auto no_sleep = op.add<popl::Switch>("", "no-sleep", "not wait for next frame in real time");
     auto wait_loop_ba = op.add<popl::Switch>("", "wait-loop-ba", "wait until the loop BA is finished");
     auto auto_term = op.add<popl::Switch>("", "auto-term", "automatically terminate the viewer");
@@ -284,6 +309,8 @@ int main(int argc, char* argv[]) {
                       mask_img_path->value(),
                       frame_skip->value(),
                       start_time->value(),
+                      decode_queue_size->value(),
+                      hw_decode->is_set(),
                       no_sleep->is_set(),
                       wait_loop_ba->is_set(),
                       auto_term->is_set(),
@@ -0,0 +1,244 @@
+#include "util/benchmark_util.h"
+
+#include "stella_vslam/system.h"
+#include "stella_vslam/publish/metrics_publisher.h"
+#include "stella_vslam/util/allocation_counter.h"
+#include "stella_vslam/util/cpu_time.h"
+#include "stella_vslam/util/latency_profiler.h"
+#include "stella_vslam/util/lock_profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <stdexcept>
+#include <thread>
+
+#include <nlohmann/json.hpp>
+
+namespace {
+
+nlohmann::json to_json(const benchmark_recorder::statistics& stats) {
+    return {{"count", stats.count_},
+            {"mean", stats.mean_},
+            {"p50", stats.p50_},
+            {"p95", stats.p95_},
+            {"p99", stats.p99_},
+            {"max", stats.max_}};
+}
+
+} // namespace
+
+benchmark_recorder::benchmark_recorder(const std::shared_ptr<stella_vslam::system>& slam)
+    : slam_(slam) {
+    slam_->set_latency_callback([this](const stella_vslam::util::frame_latency& record) {
+        std::lock_guard<std::mutex> lock(mtx_stages_);
+        for (const auto& span : record.spans_) {
+            stage_durations_[span.name_].push_back(span.duration_us_ / 1000.0);
+            stage_allocs_[span.name_].push_back(static_cast<double>(span.num_allocs_));
+        }
+    });
+}
+
+benchmark_recorder::~benchmark_recorder() {
+    slam_->set_latency_callback(nullptr);
+}
+
+void benchmark_recorder::start() {
+    stella_vslam::util::lock_profiler::reset();
+    start_process_cpu_time_ns_ = stella_vslam::util::get_process_cpu_time_ns();
+    start_time_ = std::chrono::steady_clock::now();
+}
+
+void benchmark_recorder::add_frame(const unsigned int frame_idx, const double feed_time) {
+    feed_times_.push_back(1000.0 * feed_time);
+
+    const auto metrics_publisher = slam_->get_metrics_publisher();
+    backlog_sample sample;
+    sample.elapsed_ = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time_).count();
+    sample.frame_idx_ = frame_idx;
+    sample.num_queued_keyfrms_ = static_cast<unsigned int>(metrics_publisher->get_value("mapping_queued_keyframes").value_);
+    sample.num_keyfrms_ = static_cast<unsigned int>(metrics_publisher->get_value("keyframes").value_);
+    sample.num_landmarks_ = static_cast<unsigned int>(metrics_publisher->get_value("landmarks").value_);
+    backlog_samples_.push_back(sample);
+}
+
+void benchmark_recorder::stop() {
+    stop_time_ = std::chrono::steady_clock::now();
+}
+
+void benchmark_recorder::record_cpu_times() {
+    using stella_vslam::module_thread_t;
+    session_wall_time_ = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time_).count();
+
+    cpu_times_.clear();
+    cpu_times_["tracking"] = slam_->get_module_cpu_time(module_thread_t::Tracking);
+    cpu_times_["mapping"] = slam_->get_module_cpu_time(module_thread_t::Mapping);
+    cpu_times_["global_optimization"] = slam_->get_module_cpu_time(module_thread_t::GlobalOptimization);
+    cpu_times_["loop_BA"] = slam_->get_module_cpu_time(module_thread_t::LoopBA);
+    double sum_module_cpu_times = 0.0;
+    for (const auto& name_time : cpu_times_) {
+        sum_module_cpu_times += name_time.second;
+    }
+    const double process_cpu_time = 1e-9 * (stella_vslam::util::get_process_cpu_time_ns() - start_process_cpu_time_ns_);
+    // the feature extraction, the pools, the OpenMP threads and the runner itself
+    cpu_times_["others"] = std::max(process_cpu_time - sum_module_cpu_times, 0.0);
+    cpu_times_["process"] = process_cpu_time;
+
+    lock_wait_times_.clear();
+    for (const auto& stats : stella_vslam::util::lock_profiler::get_stats()) {
+        lock_wait_times_[stats.lock_class_] += stats.wait_sum_us_ / 1000.0;
+    }
+}
+
+void benchmark_recorder::add_result(const std::string& name, const double value) {
+    results_[name] = value;
+}
+
+void benchmark_recorder::print_summary() const {
+    const auto wall_time = std::chrono::duration<double>(stop_time_ - start_time_).count();
+    const auto feed_stats = compute_statistics(feed_times_);
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "frames: " << feed_times_.size() << ", wall time: " << wall_time << "[s]"
+              << ", throughput: " << feed_times_.size() / wall_time << "[fps]" << std::endl;
+    std::cout << "feed time: p50 " << feed_stats.p50_ << ", p95 " << feed_stats.p95_
+              << ", p99 " << feed_stats.p99_ << ", max " << feed_stats.max_ << "[ms]" << std::endl;
+    for (const auto& name_value : results_) {
+        std::cout << name_value.first << ": " << name_value.second << std::endl;
+    }
+    if (0.0 < session_wall_time_) {
+        std::cout << "CPU utilization [cores]:";
+        for (const auto& name_time : cpu_times_) {
+            std::cout << " " << name_time.first << " " << name_time.second / session_wall_time_;
+        }
+        std::cout << std::endl;
+    }
+    for (const auto& name_time : lock_wait_times_) {
+        std::cout << "lock wait of " << name_time.first << ": " << name_time.second << "[ms]" << std::endl;
+    }
+
+    std::lock_guard<std::mutex> lock(mtx_stages_);
+    for (const auto& name_durations : stage_durations_) {
+        const auto stats = compute_statistics(name_durations.second);
+        std::cout << name_durations.first << ": p50 " << stats.p50_ << ", p95 " << stats.p95_
+                  << ", p99 " << stats.p99_ << ", max " << stats.max_ << "[ms]";
+        if (stella_vslam::util::allocation_counter::is_enabled()) {
+            const auto alloc_stats = compute_statistics(stage_allocs_.at(name_durations.first));
+            std::cout << ", allocations: mean " << alloc_stats.mean_ << ", max " << alloc_stats.max_;
+        }
+        std::cout << std::endl;
+    }
+}
+
+void benchmark_recorder::save_report(const std::string& path, const std::string& dataset_path) const {
+    const auto wall_time = std::chrono::duration<double>(stop_time_ - start_time_).count();
+
+    nlohmann::json stages = nlohmann::json::object();
+    nlohmann::json stage_allocs = nlohmann::json::object();
+    {
+        std::lock_guard<std::mutex> lock(mtx_stages_);
+        for (const auto& name_durations : stage_durations_) {
+            stages[name_durations.first] = to_json(compute_statistics(name_durations.second));
+        }
+        for (const auto& name_allocs : stage_allocs_) {
+            stage_allocs[name_allocs.first] = to_json(compute_statistics(name_allocs.second));
+        }
+    }
+
+    nlohmann::json backlog = nlohmann::json::array();
+    unsigned int max_num_queued_keyfrms = 0;
+    for (const auto& sample : backlog_samples_) {
+        backlog.push_back({{"elapsed", sample.elapsed_},
+                           {"frame", sample.frame_idx_},
+                           {"queued_keyframes", sample.num_queued_keyfrms_},
+                           {"keyframes", sample.num_keyfrms_},
+                           {"landmarks", sample.num_landmarks_}});
+        max_num_queued_keyfrms = std::max(max_num_queued_keyfrms, sample.num_queued_keyfrms_);
+    }
+
+    const auto metrics_publisher = slam_->get_metrics_publisher();
+    const auto local_BA = metrics_publisher->get_value("local_BA_duration_ms");
+    const auto loop_BA = metrics_publisher->get_value("loop_BA_duration_ms");
+
+#ifdef USE_LATENCY_PROFILER
+    constexpr bool latency_profiler_is_enabled = true;
+#else
+    constexpr bool latency_profiler_is_enabled = false;
+#endif
+
+    nlohmann::json cpu_utilization = nlohmann::json::object();
+    if (0.0 < session_wall_time_) {
+        for (const auto& name_time : cpu_times_) {
+            cpu_utilization[name_time.first] = name_time.second / session_wall_time_;
+        }
+    }
+
+#ifdef USE_LOCK_PROFILER
+    constexpr bool lock_profiler_is_enabled = true;
+#else
+    constexpr bool lock_profiler_is_enabled = false;
+#endif
+
+    const nlohmann::json report = {
+        {"dataset", dataset_path},
+        {"environment", {{"hardware_concurrency", std::thread::hardware_concurrency()},
+                         {"latency_profiler", latency_profiler_is_enabled},
+                         {"lock_profiler", lock_profiler_is_enabled},
+                         {"allocation_counters", stella_vslam::util::allocation_counter::is_enabled()}}},
+        {"num_frames", feed_times_.size()},
+        {"wall_time", wall_time},
+        {"throughput_fps", feed_times_.size() / wall_time},
+        {"feed_time_ms", to_json(compute_statistics(feed_times_))},
+        {"stage_latency_ms", stages},
+        {"stage_allocations", stage_allocs},
+        {"local_BA", {{"count", local_BA.count_}, {"total_ms", local_BA.value_}, {"max_ms", local_BA.max_}}},
+        {"loop_BA", {{"count", loop_BA.count_}, {"total_ms", loop_BA.value_}, {"max_ms", loop_BA.max_}}},
+        {"max_queued_keyframes", max_num_queued_keyfrms},
+        {"session_wall_time", session_wall_time_},
+        {"cpu_time_s", cpu_times_},
+        {"cpu_utilization", cpu_utilization},
+        {"lock_wait_ms", lock_wait_times_},
+        {"results", results_},
+        {"backlog", backlog}};
+
+    std::ofstream ofs(path, std::ios::out);
+    if (!ofs.is_open()) {
+        throw std::runtime_error("cannot create a file at " + path);
+    }
+    ofs << std::setw(4) << report << std::endl;
+}
+
+benchmark_recorder::statistics benchmark_recorder::compute_statistics(std::vector<double> durations) {
+    statistics stats;
+    if (durations.empty()) {
+        return stats;
+    }
+    std::sort(durations.begin(), durations.end());
+    // nearest-rank percentile
+    const auto percentile = [&durations](const double p) {
+        const auto rank = static_cast<unsigned int>(std::ceil(p / 100.0 * durations.size()));
+        return durations.at(std::max(rank, 1u) - 1);
+    };
+    stats.count_ = durations.size();
+    stats.mean_ = std::accumulate(durations.begin(), durations.end(), 0.0) / durations.size();
+    stats.p50_ = percentile(50.0);
+    stats.p95_ = percentile(95.0);
+    stats.p99_ = percentile(99.0);
+    stats.max_ = durations.back();
+    return stats;
+}
+
+std::string quote_shell_argument(const std::string& arg) {
+    std::string quoted = "'";
+    for (const auto c : arg) {
+        if (c == '\'') {
+            quoted += "'\\''";
+        }
+        else {
+            quoted += c;
+        }
+    }
+    return quoted + "'";
+}
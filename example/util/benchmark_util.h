@@ -0,0 +1,135 @@
+#ifndef EXAMPLE_UTIL_BENCHMARK_UTIL_H
+#define EXAMPLE_UTIL_BENCHMARK_UTIL_H
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace stella_vslam {
+class system;
+} // namespace stella_vslam
+
+/**
+ * Recorder of the benchmark mode of the example runners
+ * The frame feeding times, the per-stage latencies (when stella_vslam is built with USE_LATENCY_PROFILER)
+ * with their allocation counts (when also built with USE_ALLOCATION_COUNTERS)
+ * and the backlog of the mapping module are recorded during the run, and saved as a JSON report.
+ * The CPU times of the modules and the lock wait times (when built with USE_LOCK_PROFILER) are added by record_cpu_times().
+ */
+class benchmark_recorder {
+public:
+    //! Statistics of the durations [ms]
+    struct statistics {
+        unsigned int count_ = 0;
+        double mean_ = 0.0;
+        double p50_ = 0.0;
+        double p95_ = 0.0;
+        double p99_ = 0.0;
+        double max_ = 0.0;
+    };
+
+    //! Sample of the backlog of the mapping module
+    struct backlog_sample {
+        //! elapsed time since start() [s]
+        double elapsed_;
+        //! index of the fed frame
+        unsigned int frame_idx_;
+        //! number of the keyframes queued in the mapping module
+        unsigned int num_queued_keyfrms_;
+        //! number of the keyframes and the landmarks in the map
+        unsigned int num_keyfrms_;
+        unsigned int num_landmarks_;
+    };
+
+    /**
+     * Constructor (the latency callback of the system is replaced)
+     * @param slam
+     */
+    explicit benchmark_recorder(const std::shared_ptr<stella_vslam::system>& slam);
+
+    /**
+     * Destructor (the latency callback of the system is removed)
+     */
+    ~benchmark_recorder();
+
+    //! Start the measurement of the wall time
+    void start();
+
+    /**
+     * Record the time taken to feed the frame, and sample the backlog of the mapping module
+     * @param frame_idx
+     * @param feed_time [s]
+     */
+    void add_frame(const unsigned int frame_idx, const double feed_time);
+
+    //! Stop the measurement of the wall time (call after all the frames are tracked)
+    void stop();
+
+    /**
+     * Record the CPU times of the modules and the process, and the wait times of the locks since start()
+     * (call after the system is shut down, so that the threads of the modules have been accounted.
+     *  The utilizations are the CPU times divided by the wall time until this call)
+     */
+    void record_cpu_times();
+
+    /**
+     * Add a result of the run to the report (e.g. the accuracy against the ground truth)
+     * @param name
+     * @param value
+     */
+    void add_result(const std::string& name, const double value);
+
+    //! Print a summary of the results
+    void print_summary() const;
+
+    /**
+     * Save the results as a JSON report
+     * @param path
+     * @param dataset_path path of the sequence (recorded in the report)
+     */
+    void save_report(const std::string& path, const std::string& dataset_path) const;
+
+    //! Compute the statistics of the durations
+    static statistics compute_statistics(std::vector<double> durations);
+
+private:
+    //! SLAM system
+    const std::shared_ptr<stella_vslam::system> slam_;
+
+    //! begin and end time of the measurement
+    std::chrono::steady_clock::time_point start_time_;
+    std::chrono::steady_clock::time_point stop_time_;
+
+    //! frame feeding times [ms]
+    std::vector<double> feed_times_;
+    //! samples of the backlog
+    std::vector<backlog_sample> backlog_samples_;
+
+    //! mutex for the stage latencies (recorded on the tracking thread)
+    mutable std::mutex mtx_stages_;
+    //! durations of the stages [ms]
+    std::map<std::string, std::vector<double>> stage_durations_;
+    //! numbers of the allocations in the stages
+    std::map<std::string, std::vector<double>> stage_allocs_;
+
+    //! results added by add_result()
+    std::map<std::string, double> results_;
+
+    //! CPU time of the process at start() [ns]
+    int64_t start_process_cpu_time_ns_ = 0;
+    //! wall time from start() to record_cpu_times() [s] (0 if not recorded)
+    double session_wall_time_ = 0.0;
+    //! CPU times of the modules, the others and the whole process [s]
+    std::map<std::string, double> cpu_times_;
+    //! total wait times of the lock classes [ms]
+    std::map<std::string, double> lock_wait_times_;
+};
+
+//! Quote the argument of the shell command which runs a benchmark in a child process
+std::string quote_shell_argument(const std::string& arg);
+
+#endif // EXAMPLE_UTIL_BENCHMARK_UTIL_H
@@ -0,0 +1,70 @@
+#include "util/image_sequence_source.h"
+
+#include "stella_vslam/util/thread_pool.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#include <spdlog/spdlog.h>
+
+image_sequence_source::image_sequence_source(const unsigned int num_frames, const loader_t& loader,
+                                             const unsigned int num_decode_threads, const unsigned int read_ahead, const bool preload)
+    : num_frames_(num_frames), loader_(loader), read_ahead_(std::max(read_ahead, 1u)), preload_(preload),
+      pool_(new stella_vslam::util::thread_pool(num_decode_threads)) {
+    if (!preload_) {
+        fill_read_ahead_queue();
+        return;
+    }
+
+    spdlog::info("preload {} frames", num_frames_);
+    std::vector<std::future<std::vector<cv::Mat>>> futures;
+    futures.reserve(num_frames_);
+    for (unsigned int frame_idx = 0; frame_idx < num_frames_; ++frame_idx) {
+        futures.push_back(pool_->submit([this, frame_idx] { return loader_(frame_idx); }));
+    }
+    preloaded_imgs_.reserve(num_frames_);
+    for (auto& future : futures) {
+        pool_->wait(future);
+        preloaded_imgs_.push_back(future.get());
+    }
+}
+
+image_sequence_source::~image_sequence_source() = default;
+
+std::vector<cv::Mat> image_sequence_source::get(const unsigned int frame_idx) {
+    if (frame_idx < next_idx_ || num_frames_ <= frame_idx) {
+        throw std::runtime_error("frame " + std::to_string(frame_idx) + " is already taken or out of the sequence");
+    }
+
+    if (preload_) {
+        next_idx_ = frame_idx + 1;
+        return std::move(preloaded_imgs_.at(frame_idx));
+    }
+
+    // discard the skipped frames
+    while (next_idx_ < frame_idx) {
+        pool_->wait(read_ahead_queue_.front());
+        read_ahead_queue_.pop_front();
+        ++next_idx_;
+        fill_read_ahead_queue();
+    }
+
+    // if there is no decode thread, the images are decoded here
+    auto future = std::move(read_ahead_queue_.front());
+    read_ahead_queue_.pop_front();
+    ++next_idx_;
+    fill_read_ahead_queue();
+    pool_->wait(future);
+    return future.get();
+}
+
+void image_sequence_source::fill_read_ahead_queue() {
+    while (read_ahead_queue_.size() < read_ahead_) {
+        const unsigned int frame_idx = next_idx_ + read_ahead_queue_.size();
+        if (num_frames_ <= frame_idx) {
+            break;
+        }
+        read_ahead_queue_.push_back(pool_->submit([this, frame_idx] { return loader_(frame_idx); }));
+    }
+}
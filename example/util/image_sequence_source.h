@@ -0,0 +1,85 @@
+#ifndef EXAMPLE_UTIL_IMAGE_SEQUENCE_SOURCE_H
+#define EXAMPLE_UTIL_IMAGE_SEQUENCE_SOURCE_H
+
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <vector>
+
+#include <opencv2/core/mat.hpp>
+
+namespace stella_vslam {
+namespace util {
+class thread_pool;
+} // namespace util
+} // namespace stella_vslam
+
+/**
+ * Source of the decoded images of a sequence for the example runners
+ * The images of the upcoming frames are decoded on a thread pool ahead of the tracking thread,
+ * or all of the frames are decoded into RAM in advance (preload mode).
+ * The decoded images are moved out of the source without copying the pixel buffers,
+ * then they can be passed to system::feed_*_frame() as they are.
+ */
+class image_sequence_source {
+public:
+    //! Decode the images of the frame (e.g. {left, right} or {rgb, depth})
+    using loader_t = std::function<std::vector<cv::Mat>(const unsigned int frame_idx)>;
+
+    /**
+     * Constructor
+     * @param num_frames
+     * @param loader
+     * @param num_decode_threads number of the decode threads (the images are decoded on the caller thread of get() if zero)
+     * @param read_ahead maximum number of the frames decoded ahead of the current frame
+     * @param preload decode all of the frames in the constructor
+     */
+    image_sequence_source(const unsigned int num_frames, const loader_t& loader,
+                          const unsigned int num_decode_threads, const unsigned int read_ahead, const bool preload);
+
+    /**
+     * Destructor
+     */
+    ~image_sequence_source();
+
+    image_sequence_source(const image_sequence_source&) = delete;
+    image_sequence_source& operator=(const image_sequence_source&) = delete;
+
+    //! Get the number of the frames
+    unsigned int get_num_frames() const {
+        return num_frames_;
+    }
+
+    /**
+     * Take the images of the frame (the frames must be taken in the ascending order, and the skipped frames are discarded)
+     * @param frame_idx
+     * @return decoded images
+     */
+    std::vector<cv::Mat> get(const unsigned int frame_idx);
+
+private:
+    //! Submit the decoding of the upcoming frames up to the read-ahead limit
+    void fill_read_ahead_queue();
+
+    //! number of the frames
+    const unsigned int num_frames_;
+    //! loader of the images
+    const loader_t loader_;
+    //! maximum number of the frames decoded ahead
+    const unsigned int read_ahead_;
+    //! decode all of the frames in advance or not
+    const bool preload_;
+
+    //! decode threads
+    std::unique_ptr<stella_vslam::util::thread_pool> pool_;
+
+    //! index of the frame which will be taken next
+    unsigned int next_idx_ = 0;
+    //! decoding results of the frames from next_idx_ (read-ahead queue)
+    std::deque<std::future<std::vector<cv::Mat>>> read_ahead_queue_;
+    //! decoded images of all of the frames (preload mode)
+    std::vector<std::vector<cv::Mat>> preloaded_imgs_;
+};
+
+#endif // EXAMPLE_UTIL_IMAGE_SEQUENCE_SOURCE_H
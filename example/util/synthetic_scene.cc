@@ -0,0 +1,222 @@
+#include "util/synthetic_scene.h"
+
+#include "stella_vslam/util/converter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <opencv2/imgproc.hpp>
+
+namespace {
+
+// half of the size of the room [m]
+const stella_vslam::Vec3_t room_half_size{6.0, 2.5, 6.0};
+// resolution of the textures [texels/m]
+constexpr double texels_per_meter = 100.0;
+// number of the random shapes on the textures [1/m^2]
+constexpr double shape_density = 6.0;
+// number of the landmarks on the surfaces [1/m^2]
+constexpr double lm_density = 40.0;
+// radius of the trajectory [m]
+constexpr double trajectory_radius = 2.0;
+// standard deviation of the noise of the rendered images
+constexpr double img_noise_stddev = 2.0;
+// standard deviation of the noise of the synthesized keypoints [px]
+constexpr double keypt_noise_stddev = 0.5;
+// number of the bits flipped in the descriptor of each synthesized keypoint
+constexpr unsigned int num_flipped_bits = 8;
+
+// the other two axes which span the surface perpendicular to the axis (horizontal and vertical on the texture)
+void get_surface_axes(const unsigned int axis, unsigned int& axis_u, unsigned int& axis_v) {
+    if (axis == 0) {
+        axis_u = 2;
+        axis_v = 1;
+    }
+    else if (axis == 1) {
+        axis_u = 0;
+        axis_v = 2;
+    }
+    else {
+        axis_u = 0;
+        axis_v = 1;
+    }
+}
+
+float sample_bilinear(const cv::Mat& tex, const double u, const double v) {
+    const double x = std::min(std::max(u, 0.0), tex.cols - 1.001);
+    const double y = std::min(std::max(v, 0.0), tex.rows - 1.001);
+    const int x0 = static_cast<int>(x);
+    const int y0 = static_cast<int>(y);
+    const double dx = x - x0;
+    const double dy = y - y0;
+    const auto row0 = tex.ptr<uchar>(y0);
+    const auto row1 = tex.ptr<uchar>(y0 + 1);
+    return static_cast<float>((1.0 - dy) * ((1.0 - dx) * row0[x0] + dx * row0[x0 + 1])
+                              + dy * ((1.0 - dx) * row1[x0] + dx * row1[x0 + 1]));
+}
+
+} // namespace
+
+synthetic_scene::synthetic_scene(const unsigned int cols, const unsigned int rows,
+                                 const double fx, const double fy, const double cx, const double cy,
+                                 const unsigned int num_frames_per_lap, const unsigned int seed)
+    : cols_(cols), rows_(rows), fx_(fx), fy_(fy), cx_(cx), cy_(cy),
+      num_frames_per_lap_(num_frames_per_lap), mt_(seed) {
+    std::uniform_real_distribution<double> rand_unit(0.0, 1.0);
+    std::uniform_int_distribution<int> rand_byte(0, 255);
+    for (unsigned int axis = 0; axis < 3; ++axis) {
+        unsigned int axis_u, axis_v;
+        get_surface_axes(axis, axis_u, axis_v);
+        const double width = 2.0 * room_half_size(axis_u);
+        const double height = 2.0 * room_half_size(axis_v);
+        for (unsigned int side = 0; side < 2; ++side) {
+            textures_[axis][side] = create_texture(width, height);
+
+            // scatter the landmarks on the surface
+            const auto num_lms = static_cast<unsigned int>(lm_density * width * height);
+            for (unsigned int i = 0; i < num_lms; ++i) {
+                stella_vslam::Vec3_t pos_w;
+                pos_w(axis) = side ? room_half_size(axis) : -room_half_size(axis);
+                pos_w(axis_u) = (rand_unit(mt_) - 0.5) * width;
+                pos_w(axis_v) = (rand_unit(mt_) - 0.5) * height;
+                lm_positions_.push_back(pos_w);
+            }
+        }
+    }
+    lm_descriptors_ = cv::Mat(lm_positions_.size(), 32, CV_8U);
+    for (int i = 0; i < lm_descriptors_.rows; ++i) {
+        auto ptr = lm_descriptors_.ptr<uchar>(i);
+        for (unsigned int j = 0; j < 32; ++j) {
+            ptr[j] = static_cast<uchar>(rand_byte(mt_));
+        }
+    }
+}
+
+stella_vslam::Mat44_t synthetic_scene::get_pose_cw(const unsigned int frame_idx) const {
+    const double angle = 2.0 * M_PI * static_cast<double>(frame_idx) / num_frames_per_lap_;
+    // circle with a height variation, looking outward with a yaw offset and a pitch variation
+    const stella_vslam::Vec3_t trans_wc{trajectory_radius * std::cos(angle), 0.3 * std::sin(2.0 * angle), trajectory_radius * std::sin(angle)};
+    const double yaw = angle + 0.3;
+    const double pitch = 0.1 * std::sin(3.0 * angle);
+    const stella_vslam::Vec3_t z_axis{std::cos(pitch) * std::cos(yaw), std::sin(pitch), std::cos(pitch) * std::sin(yaw)};
+    // (the y-axis of the camera points downward as the y-axis of the world)
+    const stella_vslam::Vec3_t x_axis = stella_vslam::Vec3_t::UnitY().cross(z_axis).normalized();
+    const stella_vslam::Vec3_t y_axis = z_axis.cross(x_axis);
+    stella_vslam::Mat33_t rot_wc;
+    rot_wc << x_axis, y_axis, z_axis;
+    return stella_vslam::util::converter::inverse_pose(stella_vslam::util::converter::to_eigen_pose(rot_wc, trans_wc));
+}
+
+cv::Mat synthetic_scene::render(const stella_vslam::Mat44_t& pose_cw, cv::Mat* depth) {
+    const stella_vslam::Mat44_t pose_wc = stella_vslam::util::converter::inverse_pose(pose_cw);
+    const stella_vslam::Mat33_t rot_wc = pose_wc.block<3, 3>(0, 0);
+    const stella_vslam::Vec3_t cam_center = pose_wc.block<3, 1>(0, 3);
+
+    cv::Mat img(rows_, cols_, CV_8UC1);
+    if (depth) {
+        depth->create(rows_, cols_, CV_32FC1);
+    }
+    std::normal_distribution<float> rand_noise(0.0f, img_noise_stddev);
+    for (unsigned int y = 0; y < rows_; ++y) {
+        auto img_row = img.ptr<uchar>(y);
+        auto depth_row = depth ? depth->ptr<float>(y) : nullptr;
+        for (unsigned int x = 0; x < cols_; ++x) {
+            // (the z-component of the ray in the camera frame is 1, then the distance along the ray is the depth)
+            const stella_vslam::Vec3_t ray = rot_wc * stella_vslam::Vec3_t{(x - cx_) / fx_, (y - cy_) / fy_, 1.0};
+            double dist;
+            const auto intensity = cast_ray(cam_center, ray, dist) + rand_noise(mt_);
+            img_row[x] = static_cast<uchar>(std::min(std::max(intensity, 0.0f), 255.0f));
+            if (depth_row) {
+                depth_row[x] = static_cast<float>(dist);
+            }
+        }
+    }
+    return img;
+}
+
+void synthetic_scene::synthesize_keypoints(const stella_vslam::Mat44_t& pose_cw, std::vector<cv::KeyPoint>& keypts,
+                                           cv::Mat& descriptors, std::vector<float>& depths) {
+    const stella_vslam::Mat33_t rot_cw = pose_cw.block<3, 3>(0, 0);
+    const stella_vslam::Vec3_t trans_cw = pose_cw.block<3, 1>(0, 3);
+    std::normal_distribution<double> rand_noise(0.0, keypt_noise_stddev);
+    std::uniform_int_distribution<int> rand_bit(0, 255);
+
+    keypts.clear();
+    depths.clear();
+    descriptors = cv::Mat(0, 32, CV_8U);
+    for (unsigned int idx = 0; idx < lm_positions_.size(); ++idx) {
+        const stella_vslam::Vec3_t pos_c = rot_cw * lm_positions_.at(idx) + trans_cw;
+        if (pos_c(2) < 0.1) {
+            continue;
+        }
+        const double x = fx_ * pos_c(0) / pos_c(2) + cx_ + rand_noise(mt_);
+        const double y = fy_ * pos_c(1) / pos_c(2) + cy_ + rand_noise(mt_);
+        if (x < 0.0 || cols_ <= x || y < 0.0 || rows_ <= y) {
+            continue;
+        }
+        keypts.emplace_back(cv::Point2f(x, y), 31.0f, 0.0f, 0.0f, 0);
+        depths.push_back(static_cast<float>(pos_c(2)));
+        cv::Mat desc = lm_descriptors_.row(idx).clone();
+        auto ptr = desc.ptr<uchar>(0);
+        for (unsigned int i = 0; i < num_flipped_bits; ++i) {
+            const auto bit = rand_bit(mt_);
+            ptr[bit / 8] ^= static_cast<uchar>(1 << (bit % 8));
+        }
+        descriptors.push_back(desc);
+    }
+}
+
+float synthetic_scene::cast_ray(const stella_vslam::Vec3_t& cam_center, const stella_vslam::Vec3_t& ray, double& dist) const {
+    // the ray leaves the room through the nearest surface
+    dist = std::numeric_limits<double>::infinity();
+    unsigned int hit_axis = 0;
+    unsigned int hit_side = 0;
+    for (unsigned int axis = 0; axis < 3; ++axis) {
+        if (ray(axis) == 0.0) {
+            continue;
+        }
+        const unsigned int side = (0.0 < ray(axis)) ? 1 : 0;
+        const double bound = side ? room_half_size(axis) : -room_half_size(axis);
+        const double t = (bound - cam_center(axis)) / ray(axis);
+        if (t < dist) {
+            dist = t;
+            hit_axis = axis;
+            hit_side = side;
+        }
+    }
+
+    const stella_vslam::Vec3_t hit = cam_center + dist * ray;
+    unsigned int axis_u, axis_v;
+    get_surface_axes(hit_axis, axis_u, axis_v);
+    const double u = (hit(axis_u) + room_half_size(axis_u)) * texels_per_meter;
+    const double v = (hit(axis_v) + room_half_size(axis_v)) * texels_per_meter;
+    return sample_bilinear(textures_[hit_axis][hit_side], u, v);
+}
+
+cv::Mat synthetic_scene::create_texture(const double width, const double height) {
+    std::uniform_int_distribution<int> rand_intensity(0, 255);
+    std::uniform_real_distribution<double> rand_x(0.0, width * texels_per_meter);
+    std::uniform_real_distribution<double> rand_y(0.0, height * texels_per_meter);
+    // the sizes of the shapes are 5-40 cm
+    std::uniform_real_distribution<double> rand_size(0.05 * texels_per_meter, 0.4 * texels_per_meter);
+    std::uniform_int_distribution<int> rand_shape(0, 1);
+
+    cv::Mat tex(static_cast<int>(height * texels_per_meter), static_cast<int>(width * texels_per_meter), CV_8UC1,
+                cv::Scalar(rand_intensity(mt_) / 2 + 64));
+    const auto num_shapes = static_cast<unsigned int>(shape_density * width * height);
+    for (unsigned int i = 0; i < num_shapes; ++i) {
+        const cv::Point center(static_cast<int>(rand_x(mt_)), static_cast<int>(rand_y(mt_)));
+        const auto size = static_cast<int>(rand_size(mt_));
+        const cv::Scalar color(rand_intensity(mt_));
+        if (rand_shape(mt_) == 0) {
+            cv::rectangle(tex, center, center + cv::Point(size, static_cast<int>(rand_size(mt_))), color, cv::FILLED);
+        }
+        else {
+            cv::circle(tex, center, size / 2, color, cv::FILLED);
+        }
+    }
+    // (suppress the aliasing of the sharp edges)
+    cv::GaussianBlur(tex, tex, cv::Size(0, 0), 1.0);
+    return tex;
+}
@@ -0,0 +1,89 @@
+#ifndef EXAMPLE_UTIL_SYNTHETIC_SCENE_H
+#define EXAMPLE_UTIL_SYNTHETIC_SCENE_H
+
+#include "stella_vslam/type.h"
+
+#include <random>
+#include <vector>
+
+#include <opencv2/core/mat.hpp>
+#include <opencv2/core/types.hpp>
+
+/**
+ * Procedural scene for the end-to-end benchmark without datasets
+ * The scene is a box-shaped room whose walls, floor and ceiling are covered with random shapes,
+ * and the camera circles in the room looking at the walls (then a loop is closed at every lap).
+ * The frames are rendered by ray casting (the room is convex, then nothing is occluded),
+ * or the keypoints and the descriptors are synthesized from the landmarks scattered on the surfaces.
+ * (NOTE: all of the random values are drawn from the given seed, then the scene is reproducible)
+ */
+class synthetic_scene {
+public:
+    /**
+     * Constructor
+     * @param cols width of the images
+     * @param rows height of the images
+     * @param fx focal length (pinhole, without distortion)
+     * @param fy
+     * @param cx principal point
+     * @param cy
+     * @param num_frames_per_lap number of the frames per lap of the trajectory
+     * @param seed
+     */
+    synthetic_scene(const unsigned int cols, const unsigned int rows,
+                    const double fx, const double fy, const double cx, const double cy,
+                    const unsigned int num_frames_per_lap, const unsigned int seed = 0);
+
+    /**
+     * Get the ground truth of the camera pose
+     * @param frame_idx
+     * @return pose_cw
+     */
+    stella_vslam::Mat44_t get_pose_cw(const unsigned int frame_idx) const;
+
+    /**
+     * Render the grayscale image seen from the camera pose
+     * @param pose_cw
+     * @param depth if not nullptr, the depthmap (CV_32FC1, in meters) is also rendered
+     * @return image (CV_8UC1)
+     */
+    cv::Mat render(const stella_vslam::Mat44_t& pose_cw, cv::Mat* depth = nullptr);
+
+    /**
+     * Synthesize the keypoints which are the noisy projections of the landmarks with the perturbed descriptors
+     * @param pose_cw
+     * @param keypts undistorted keypoints
+     * @param descriptors (one per row)
+     * @param depths depths of the keypoints [m]
+     */
+    void synthesize_keypoints(const stella_vslam::Mat44_t& pose_cw, std::vector<cv::KeyPoint>& keypts,
+                              cv::Mat& descriptors, std::vector<float>& depths);
+
+private:
+    //! Cast the ray from the camera center (the ray is in the world frame), and return the intensity and the distance along the ray
+    float cast_ray(const stella_vslam::Vec3_t& cam_center, const stella_vslam::Vec3_t& ray, double& dist) const;
+
+    //! Create the texture of one of the surfaces
+    cv::Mat create_texture(const double width, const double height);
+
+    //! image size and intrinsics
+    const unsigned int cols_;
+    const unsigned int rows_;
+    const double fx_;
+    const double fy_;
+    const double cx_;
+    const double cy_;
+    //! number of the frames per lap
+    const unsigned int num_frames_per_lap_;
+
+    //! random engine
+    std::mt19937 mt_;
+    //! textures of the surfaces perpendicular to the x, y and z axes on the lower and upper sides
+    cv::Mat textures_[3][2];
+    //! landmarks on the surfaces (for synthesize_keypoints())
+    stella_vslam::eigen_alloc_vector<stella_vslam::Vec3_t> lm_positions_;
+    //! descriptors of the landmarks (one per row)
+    cv::Mat lm_descriptors_;
+};
+
+#endif // EXAMPLE_UTIL_SYNTHETIC_SCENE_H
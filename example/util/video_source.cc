@@ -0,0 +1,117 @@
+#include "util/video_source.h"
+
+#include <algorithm>
+
+#include <opencv2/core/version.hpp>
+#include <opencv2/imgproc.hpp>
+#include <spdlog/spdlog.h>
+
+video_source::video_source(const std::string& video_file_path, const unsigned int start_time,
+                           const unsigned int queue_size, const bool hw_decode)
+    : queue_size_(std::max(queue_size, 1u)) {
+    if (hw_decode) {
+#if CV_VERSION_MAJOR > 4 || (CV_VERSION_MAJOR == 4 && (CV_VERSION_MINOR > 5 || (CV_VERSION_MINOR == 5 && CV_VERSION_REVISION >= 2)))
+        is_opened_ = video_.open(video_file_path, cv::CAP_FFMPEG,
+                                 {cv::CAP_PROP_HW_ACCELERATION, cv::VIDEO_ACCELERATION_ANY});
+        if (is_opened_) {
+            spdlog::info("video_source: hardware acceleration of decoding: {}",
+                         static_cast<int>(video_.get(cv::CAP_PROP_HW_ACCELERATION)));
+        }
+#else
+        spdlog::warn("video_source: hardware decoding requires OpenCV 4.5.2 or later");
+#endif
+    }
+    if (!is_opened_) {
+        is_opened_ = video_.open(video_file_path, cv::CAP_FFMPEG);
+    }
+    if (!is_opened_) {
+        return;
+    }
+    video_.set(cv::CAP_PROP_POS_MSEC, start_time);
+
+    thread_ = std::thread(&video_source::run, this);
+}
+
+video_source::~video_source() {
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        terminate_is_requested_ = true;
+    }
+    cond_.notify_all();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+bool video_source::get(stella_vslam::util::image_buffer& buf) {
+    cv::Mat gray;
+    {
+        std::unique_lock<std::mutex> lock(mtx_);
+        cond_.wait(lock, [this] { return !queue_.empty() || is_end_; });
+        if (queue_.empty()) {
+            return false;
+        }
+        gray = queue_.front();
+        queue_.pop_front();
+    }
+    cond_.notify_all();
+
+    buf.data_ = gray.data;
+    buf.width_ = gray.cols;
+    buf.height_ = gray.rows;
+    buf.stride_ = gray.step;
+    buf.format_ = stella_vslam::util::pixel_format_t::Gray;
+    buf.release_ = [this, gray] { recycle(gray); };
+    return true;
+}
+
+void video_source::recycle(const cv::Mat& gray) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    pool_.push_back(gray);
+}
+
+void video_source::run() {
+    cv::Mat frame;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mtx_);
+            cond_.wait(lock, [this] { return queue_.size() < queue_size_ || terminate_is_requested_; });
+            if (terminate_is_requested_) {
+                break;
+            }
+        }
+
+        if (!video_.read(frame) || frame.empty()) {
+            break;
+        }
+
+        // take a pixel buffer which is not in use
+        cv::Mat gray;
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            if (!pool_.empty()) {
+                gray = pool_.back();
+                pool_.pop_back();
+            }
+        }
+        // (the buffer is reallocated only if the size is changed)
+        if (frame.channels() == 1) {
+            frame.copyTo(gray);
+        }
+        else {
+            cv::cvtColor(frame, gray, frame.channels() == 4 ? cv::COLOR_BGRA2GRAY : cv::COLOR_BGR2GRAY);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            queue_.push_back(gray);
+        }
+        cond_.notify_all();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        is_end_ = true;
+    }
+    cond_.notify_all();
+}
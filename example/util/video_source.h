@@ -0,0 +1,85 @@
+#ifndef EXAMPLE_UTIL_VIDEO_SOURCE_H
+#define EXAMPLE_UTIL_VIDEO_SOURCE_H
+
+#include "stella_vslam/util/image_converter.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <opencv2/core/mat.hpp>
+#include <opencv2/videoio.hpp>
+
+/**
+ * Source of the decoded frames of a video for the example runners
+ * The frames are decoded and converted to grayscale on a decode thread ahead of the tracking thread,
+ * and handed over as util::image_buffer, whose pixel buffers are recycled when the SLAM system releases them.
+ */
+class video_source {
+public:
+    /**
+     * Constructor
+     * @param video_file_path
+     * @param start_time time to start playing [milli seconds]
+     * @param queue_size maximum number of the frames decoded ahead of the tracking
+     * @param hw_decode use the hardware decoder (VAAPI, D3D11, MFX, ...) if available
+     */
+    video_source(const std::string& video_file_path, const unsigned int start_time,
+                 const unsigned int queue_size, const bool hw_decode);
+
+    /**
+     * Destructor
+     */
+    ~video_source();
+
+    video_source(const video_source&) = delete;
+    video_source& operator=(const video_source&) = delete;
+
+    //! The video is opened or not
+    bool is_opened() const {
+        return is_opened_;
+    }
+
+    /**
+     * Take the next frame (blocks until it is decoded)
+     * @param buf grayscale image of the frame (its release callback must be called after use)
+     * @return false if the video has ended
+     */
+    bool get(stella_vslam::util::image_buffer& buf);
+
+private:
+    //! Main loop of the decode thread
+    void run();
+
+    //! Return the pixel buffer to the pool
+    void recycle(const cv::Mat& gray);
+
+    //! decoder
+    cv::VideoCapture video_;
+    //! the video is opened or not
+    bool is_opened_ = false;
+    //! maximum number of the decoded frames in the queue
+    const unsigned int queue_size_;
+
+    //! mutex for the queue and the pool
+    std::mutex mtx_;
+    //! notified when a frame is queued or taken, or the decoding is terminated
+    std::condition_variable cond_;
+    //! decoded frames (grayscale)
+    std::deque<cv::Mat> queue_;
+    //! pixel buffers which are not in use
+    std::vector<cv::Mat> pool_;
+    //! the video has ended
+    bool is_end_ = false;
+    //! the decode thread is requested to terminate
+    bool terminate_is_requested_ = false;
+
+    //! decode thread
+    std::thread thread_;
+};
+
+#endif // EXAMPLE_UTIL_VIDEO_SOURCE_H
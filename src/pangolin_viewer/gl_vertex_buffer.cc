@@ -0,0 +1,52 @@
+#include "pangolin_viewer/gl_vertex_buffer.h"
+
+namespace pangolin_viewer {
+
+void gl_vertex_buffer::upload(const std::vector<float>& vertices, const std::vector<float>& colors) {
+    num_vertices_ = vertices.size() / 3;
+    has_colors_ = !colors.empty() && colors.size() == vertices.size();
+    upload(vbo_, vbo_capacity_, vertices);
+    if (has_colors_) {
+        upload(cbo_, cbo_capacity_, colors);
+    }
+}
+
+void gl_vertex_buffer::upload(pangolin::GlBuffer& buffer, unsigned int& capacity, const std::vector<float>& elements) {
+    const unsigned int num_elements = elements.size() / 3;
+    if (num_elements == 0) {
+        return;
+    }
+    if (capacity < num_elements) {
+        // expand the buffer with a margin to reduce the reallocations while the map grows
+        capacity = num_elements + num_elements / 2;
+        buffer.Reinitialise(pangolin::GlArrayBuffer, capacity, GL_FLOAT, 3, GL_DYNAMIC_DRAW);
+    }
+    buffer.Upload(elements.data(), 3 * num_elements * sizeof(float));
+}
+
+void gl_vertex_buffer::draw(const GLenum mode, const bool use_colors) const {
+    if (num_vertices_ == 0) {
+        return;
+    }
+    const bool has_colors = has_colors_ && use_colors;
+
+    vbo_.Bind();
+    glVertexPointer(3, GL_FLOAT, 0, 0);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    if (has_colors) {
+        cbo_.Bind();
+        glColorPointer(3, GL_FLOAT, 0, 0);
+        glEnableClientState(GL_COLOR_ARRAY);
+    }
+
+    glDrawArrays(mode, 0, num_vertices_);
+
+    if (has_colors) {
+        glDisableClientState(GL_COLOR_ARRAY);
+        cbo_.Unbind();
+    }
+    glDisableClientState(GL_VERTEX_ARRAY);
+    vbo_.Unbind();
+}
+
+} // namespace pangolin_viewer
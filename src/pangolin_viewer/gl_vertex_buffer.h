@@ -0,0 +1,51 @@
+#ifndef PANGOLIN_VIEWER_GL_VERTEX_BUFFER_H
+#define PANGOLIN_VIEWER_GL_VERTEX_BUFFER_H
+
+#include <vector>
+
+#include <pangolin/gl/gl.h>
+
+namespace pangolin_viewer {
+
+/**
+ * Persistent vertex buffer (and optional color buffer) on the GPU
+ * The buffers are uploaded only when the contents are changed, and drawn by a single call.
+ * (NOTE: use this only while the GL context is bound)
+ */
+class gl_vertex_buffer {
+public:
+    /**
+     * Upload the vertices
+     * @param vertices x, y and z of each vertex
+     * @param colors r, g and b of each vertex (empty to draw with the current color)
+     */
+    void upload(const std::vector<float>& vertices, const std::vector<float>& colors = std::vector<float>());
+
+    /**
+     * Draw the uploaded vertices
+     * @param mode primitive (e.g. GL_POINTS, GL_LINES)
+     * @param use_colors draw with the uploaded colors or the current color
+     */
+    void draw(const GLenum mode, const bool use_colors = true) const;
+
+    //! number of the uploaded vertices
+    unsigned int size() const { return num_vertices_; }
+
+private:
+    //! Upload the elements after expanding the buffer if needed
+    static void upload(pangolin::GlBuffer& buffer, unsigned int& capacity, const std::vector<float>& elements);
+
+    pangolin::GlBuffer vbo_;
+    pangolin::GlBuffer cbo_;
+    //! number of the vertices which the buffers can contain
+    unsigned int vbo_capacity_ = 0;
+    unsigned int cbo_capacity_ = 0;
+    //! number of the uploaded vertices
+    unsigned int num_vertices_ = 0;
+    //! the colors are uploaded or not
+    bool has_colors_ = false;
+};
+
+} // namespace pangolin_viewer
+
+#endif // PANGOLIN_VIEWER_GL_VERTEX_BUFFER_H
@@ -0,0 +1,251 @@
+#include "pangolin_viewer/shm_viewer.h"
+
+#include "shm_publisher/reader.h"
+
+#include <array>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+namespace {
+//! tracker_state_t::Tracking
+constexpr int64_t tracking_state_tracking = 1;
+
+stella_vslam::Mat44_t to_pose_wc(const double* cam_pose_cw) {
+    const stella_vslam::Mat44_t pose_cw = Eigen::Map<const Eigen::Matrix<double, 4, 4, Eigen::RowMajor>>(cam_pose_cw);
+    return pose_cw.inverse();
+}
+} // namespace
+
+namespace pangolin_viewer {
+
+shm_viewer::shm_viewer(const YAML::Node& yaml_node, const std::shared_ptr<shm_publisher::reader>& reader)
+    : reader_(reader),
+      interval_ms_(1000.0f / yaml_node["fps"].as<float>(30.0)),
+      viewpoint_x_(yaml_node["viewpoint_x"].as<float>(0.0)),
+      viewpoint_y_(yaml_node["viewpoint_y"].as<float>(-10.0)),
+      viewpoint_z_(yaml_node["viewpoint_z"].as<float>(-0.1)),
+      viewpoint_f_(yaml_node["viewpoint_f"].as<float>(2000.0)),
+      keyfrm_size_(yaml_node["keyframe_size"].as<float>(0.1)),
+      keyfrm_line_width_(yaml_node["keyframe_line_width"].as<unsigned int>(1)),
+      point_size_(yaml_node["point_size"].as<unsigned int>(2)),
+      camera_size_(yaml_node["camera_size"].as<float>(0.15)),
+      camera_line_width_(yaml_node["camera_line_width"].as<unsigned int>(2)),
+      max_num_trajectory_poses_(yaml_node["max_num_trajectory_poses"].as<unsigned int>(100000)),
+      cs_(yaml_node["color_scheme"].as<std::string>("black")) {}
+
+void shm_viewer::run() {
+    is_terminated_ = false;
+
+    pangolin::CreateWindowAndBind(map_viewer_name_, 1024, 768);
+
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    // depth testing to be enabled for 3D mouse handler
+    glEnable(GL_DEPTH_TEST);
+
+    // setup camera renderer
+    s_cam_ = std::unique_ptr<pangolin::OpenGlRenderState>(new pangolin::OpenGlRenderState(
+        pangolin::ProjectionMatrix(map_viewer_width_, map_viewer_height_, viewpoint_f_, viewpoint_f_,
+                                   map_viewer_width_ / 2, map_viewer_height_ / 2, 0.1, 1e6),
+        pangolin::ModelViewLookAt(viewpoint_x_, viewpoint_y_, viewpoint_z_, 0, 0, 0, 0.0, -1.0, 0.0)));
+
+    // create map window
+    pangolin::View& d_cam = pangolin::CreateDisplay()
+                                .SetBounds(0.0, 1.0, pangolin::Attach::Pix(175), 1.0, -map_viewer_width_ / map_viewer_height_)
+                                .SetHandler(new pangolin::Handler3D(*s_cam_));
+
+    // create menu panel
+    create_menu_panel();
+
+    while (true) {
+        // clear buffer
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        // 1. read the shared memory
+        read_poses();
+        read_map();
+
+        // 2. draw the map window
+        const pangolin::OpenGlMatrix gl_cam_pose_wc(cam_pose_wc_);
+        follow_camera(gl_cam_pose_wc);
+
+        d_cam.Activate(*s_cam_);
+        glClearColor(cs_.bg_.at(0), cs_.bg_.at(1), cs_.bg_.at(2), cs_.bg_.at(3));
+
+        draw_current_cam_pose();
+
+        if (*menu_show_keyfrms_) {
+            glLineWidth(keyfrm_line_width_);
+            glColor3fv(cs_.kf_line_.data());
+            keyfrms_buffer_.draw(GL_LINES);
+        }
+
+        if (*menu_show_lms_ && lms_buffer_.size() != 0) {
+            glPointSize(point_size_ * *menu_lm_size_);
+            glColor3fv(cs_.lm_.data());
+            lms_buffer_.draw(GL_POINTS);
+        }
+
+        pangolin::FinishFrame();
+
+        // 3. check termination flag
+        if (*menu_terminate_ || pangolin::ShouldQuit()) {
+            request_terminate();
+        }
+
+        if (terminate_is_requested()) {
+            break;
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(interval_ms_));
+    }
+
+    terminate();
+}
+
+void shm_viewer::create_menu_panel() {
+    pangolin::CreatePanel("menu").SetBounds(0.0, 1.0, 0.0, pangolin::Attach::Pix(230));
+    menu_follow_camera_ = std::unique_ptr<pangolin::Var<bool>>(new pangolin::Var<bool>("menu.Follow Camera", true, true));
+    menu_show_keyfrms_ = std::unique_ptr<pangolin::Var<bool>>(new pangolin::Var<bool>("menu.Show Keyframes", true, true));
+    menu_show_lms_ = std::unique_ptr<pangolin::Var<bool>>(new pangolin::Var<bool>("menu.Show Landmarks", true, true));
+    menu_show_trajectory_ = std::unique_ptr<pangolin::Var<bool>>(new pangolin::Var<bool>("menu.Show Trajectory", true, true));
+    menu_terminate_ = std::unique_ptr<pangolin::Var<bool>>(new pangolin::Var<bool>("menu.Terminate", false, false));
+    menu_frm_size_ = std::unique_ptr<pangolin::Var<float>>(new pangolin::Var<float>("menu.Frame Size", 1.0, 1e-1, 1e1, true));
+    menu_lm_size_ = std::unique_ptr<pangolin::Var<float>>(new pangolin::Var<float>("menu.Landmark Size", 1.0, 1e-1, 1e1, true));
+}
+
+void shm_viewer::read_poses() {
+    std::vector<shm_publisher::pose_message> poses;
+    last_pose_seq_ = reader_->get_poses_since(last_pose_seq_, poses);
+    for (const auto& pose : poses) {
+        if (pose.tracking_state_ != tracking_state_tracking) {
+            continue;
+        }
+        cam_pose_wc_ = to_pose_wc(pose.cam_pose_cw_);
+        trajectory_vertices_.push_back(cam_pose_wc_(0, 3));
+        trajectory_vertices_.push_back(cam_pose_wc_(1, 3));
+        trajectory_vertices_.push_back(cam_pose_wc_(2, 3));
+        trajectory_is_changed_ = true;
+    }
+    while (3 * max_num_trajectory_poses_ < trajectory_vertices_.size()) {
+        trajectory_vertices_.erase(trajectory_vertices_.begin(), trajectory_vertices_.begin() + 3);
+    }
+}
+
+void shm_viewer::read_map() {
+    // frustum size of keyframes
+    const float w = keyfrm_size_ * *menu_frm_size_;
+    const auto map_version = reader_->get_map_version();
+    if (map_version == uploaded_map_version_ && w == uploaded_keyfrm_size_) {
+        return;
+    }
+
+    shm_publisher::map_snapshot snapshot;
+    if (!reader_->get_map(snapshot)) {
+        return;
+    }
+
+    keyfrm_poses_wc_.clear();
+    keyfrm_poses_wc_.reserve(snapshot.keyfrms_.size());
+    for (const auto& keyfrm : snapshot.keyfrms_) {
+        keyfrm_poses_wc_.push_back(to_pose_wc(keyfrm.cam_pose_cw_));
+    }
+
+    // camera frustums transformed to the world (drawn by a single call)
+    const float h = w * 0.75f;
+    const float z = w * 0.6f;
+    const std::array<stella_vslam::Vec3_t, 16> frustum{{{0, 0, 0}, {w, h, z}, {0, 0, 0}, {w, -h, z}, {0, 0, 0}, {-w, -h, z}, {0, 0, 0}, {-w, h, z}, {w, h, z}, {w, -h, z}, {-w, h, z}, {-w, -h, z}, {-w, h, z}, {w, h, z}, {-w, -h, z}, {w, -h, z}}};
+    std::vector<float> frustum_vertices;
+    frustum_vertices.reserve(3 * frustum.size() * keyfrm_poses_wc_.size());
+    for (const auto& pose_wc : keyfrm_poses_wc_) {
+        const stella_vslam::Mat33_t rot_wc = pose_wc.block<3, 3>(0, 0);
+        const stella_vslam::Vec3_t trans_wc = pose_wc.block<3, 1>(0, 3);
+        for (const auto& vertex : frustum) {
+            const stella_vslam::Vec3_t vertex_w = rot_wc * vertex + trans_wc;
+            frustum_vertices.push_back(vertex_w(0));
+            frustum_vertices.push_back(vertex_w(1));
+            frustum_vertices.push_back(vertex_w(2));
+        }
+    }
+    keyfrms_buffer_.upload(frustum_vertices);
+
+    std::vector<float> lm_vertices;
+    lm_vertices.reserve(3 * snapshot.landmarks_.size());
+    for (const auto& lm : snapshot.landmarks_) {
+        lm_vertices.insert(lm_vertices.end(), lm.position_, lm.position_ + 3);
+    }
+    lms_buffer_.upload(lm_vertices);
+
+    uploaded_map_version_ = snapshot.version_;
+    uploaded_keyfrm_size_ = w;
+}
+
+void shm_viewer::follow_camera(const pangolin::OpenGlMatrix& gl_cam_pose_wc) {
+    if (*menu_follow_camera_ && follow_camera_) {
+        s_cam_->Follow(gl_cam_pose_wc);
+    }
+    else if (*menu_follow_camera_ && !follow_camera_) {
+        s_cam_->SetModelViewMatrix(pangolin::ModelViewLookAt(viewpoint_x_, viewpoint_y_, viewpoint_z_, 0, 0, 0, 0.0, -1.0, 0.0));
+        s_cam_->Follow(gl_cam_pose_wc);
+        follow_camera_ = true;
+    }
+    else if (!*menu_follow_camera_ && follow_camera_) {
+        follow_camera_ = false;
+    }
+}
+
+void shm_viewer::draw_current_cam_pose() {
+    if (*menu_show_trajectory_) {
+        if (trajectory_is_changed_) {
+            trajectory_buffer_.upload(std::vector<float>(trajectory_vertices_.begin(), trajectory_vertices_.end()));
+            trajectory_is_changed_ = false;
+        }
+        glLineWidth(camera_line_width_);
+        glColor4fv(cs_.graph_line_spanning_tree_.data());
+        trajectory_buffer_.draw(GL_LINE_STRIP);
+    }
+
+    glLineWidth(camera_line_width_);
+    glColor3fv(cs_.curr_cam_.data());
+    draw_camera(cam_pose_wc_, camera_size_ * *menu_frm_size_);
+}
+
+void shm_viewer::draw_camera(const stella_vslam::Mat44_t& cam_pose_wc, const float width) const {
+    const float h = width * 0.75f;
+    const float z = width * 0.6f;
+
+    glPushMatrix();
+    glMultMatrixf(cam_pose_wc.transpose().cast<float>().eval().data());
+
+    glBegin(GL_LINES);
+    const std::array<std::array<float, 3>, 16> frustum{{{0, 0, 0}, {width, h, z}, {0, 0, 0}, {width, -h, z}, {0, 0, 0}, {-width, -h, z}, {0, 0, 0}, {-width, h, z}, {width, h, z}, {width, -h, z}, {-width, h, z}, {-width, -h, z}, {-width, h, z}, {width, h, z}, {-width, -h, z}, {width, -h, z}}};
+    for (const auto& vertex : frustum) {
+        glVertex3f(vertex.at(0), vertex.at(1), vertex.at(2));
+    }
+    glEnd();
+
+    glPopMatrix();
+}
+
+void shm_viewer::request_terminate() {
+    std::lock_guard<std::mutex> lock(mtx_terminate_);
+    terminate_is_requested_ = true;
+}
+
+bool shm_viewer::is_terminated() {
+    std::lock_guard<std::mutex> lock(mtx_terminate_);
+    return is_terminated_;
+}
+
+bool shm_viewer::terminate_is_requested() {
+    std::lock_guard<std::mutex> lock(mtx_terminate_);
+    return terminate_is_requested_;
+}
+
+void shm_viewer::terminate() {
+    std::lock_guard<std::mutex> lock(mtx_terminate_);
+    is_terminated_ = true;
+}
+
+} // namespace pangolin_viewer
@@ -0,0 +1,168 @@
+#ifndef PANGOLIN_VIEWER_SHM_VIEWER_H
+#define PANGOLIN_VIEWER_SHM_VIEWER_H
+
+#include "pangolin_viewer/color_scheme.h"
+#include "pangolin_viewer/gl_vertex_buffer.h"
+
+#include "stella_vslam/type.h"
+#include "stella_vslam/util/yaml.h"
+
+#include <deque>
+#include <memory>
+#include <mutex>
+
+#include <pangolin/pangolin.h>
+
+namespace shm_publisher {
+class reader;
+} // namespace shm_publisher
+
+namespace pangolin_viewer {
+
+/**
+ * Map viewer which runs in another process than the SLAM system
+ * The camera poses and the snapshots of the map are read from the shared memory written by shm_publisher::publisher,
+ * so the rendering never locks the map nor competes with the tracking for the data.
+ * (NOTE: the frame image and the graphs of the keyframes are not shared, and the SLAM system cannot be controlled)
+ */
+class shm_viewer {
+public:
+    /**
+     * Constructor
+     * @param yaml_node
+     * @param reader
+     */
+    shm_viewer(const YAML::Node& yaml_node, const std::shared_ptr<shm_publisher::reader>& reader);
+
+    /**
+     * Main loop for window refresh
+     */
+    void run();
+
+    /**
+     * Request to terminate the viewer
+     * (NOTE: this function does not wait for terminate)
+     */
+    void request_terminate();
+
+    /**
+     * Check if the viewer is terminated or not
+     * @return whether the viewer is terminated or not
+     */
+    bool is_terminated();
+
+private:
+    /**
+     * Create menu panel
+     */
+    void create_menu_panel();
+
+    /**
+     * Read the new poses from the ring buffer, and append the tracked ones to the trajectory
+     */
+    void read_poses();
+
+    /**
+     * Upload the snapshot of the map if a new one is published
+     */
+    void read_map();
+
+    /**
+     * Follow to the specified camera pose
+     * @param gl_cam_pose_wc
+     */
+    void follow_camera(const pangolin::OpenGlMatrix& gl_cam_pose_wc);
+
+    /**
+     * Draw the current camera pose and the trajectory
+     */
+    void draw_current_cam_pose();
+
+    /**
+     * Draw the camera frustum of the specified camera pose
+     * @param cam_pose_wc
+     * @param width
+     */
+    void draw_camera(const stella_vslam::Mat44_t& cam_pose_wc, const float width) const;
+
+    //! reader of the shared memory
+    const std::shared_ptr<shm_publisher::reader> reader_;
+
+    const unsigned int interval_ms_;
+
+    const float viewpoint_x_, viewpoint_y_, viewpoint_z_, viewpoint_f_;
+
+    const float keyfrm_size_;
+    const float keyfrm_line_width_;
+    const float point_size_;
+    const float camera_size_;
+    const float camera_line_width_;
+    //! maximum number of the poses in the trajectory
+    const unsigned int max_num_trajectory_poses_;
+
+    const color_scheme cs_;
+
+    // menu panel
+    std::unique_ptr<pangolin::Var<bool>> menu_follow_camera_;
+    std::unique_ptr<pangolin::Var<bool>> menu_show_keyfrms_;
+    std::unique_ptr<pangolin::Var<bool>> menu_show_lms_;
+    std::unique_ptr<pangolin::Var<bool>> menu_show_trajectory_;
+    std::unique_ptr<pangolin::Var<bool>> menu_terminate_;
+    std::unique_ptr<pangolin::Var<float>> menu_frm_size_;
+    std::unique_ptr<pangolin::Var<float>> menu_lm_size_;
+
+    // camera renderer
+    std::unique_ptr<pangolin::OpenGlRenderState> s_cam_;
+
+    // GPU buffers, which are uploaded only when the snapshot or the trajectory is changed
+    gl_vertex_buffer keyfrms_buffer_;
+    gl_vertex_buffer lms_buffer_;
+    gl_vertex_buffer trajectory_buffer_;
+    //! version of the uploaded snapshot
+    uint64_t uploaded_map_version_ = 0;
+    float uploaded_keyfrm_size_ = 0.0;
+    //! poses of the keyframes in the uploaded snapshot
+    stella_vslam::eigen_alloc_vector<stella_vslam::Mat44_t> keyfrm_poses_wc_;
+
+    //! sequence number of the last read pose
+    uint64_t last_pose_seq_ = 0;
+    //! latest camera pose
+    stella_vslam::Mat44_t cam_pose_wc_ = stella_vslam::Mat44_t::Identity();
+    //! camera centers of the tracked poses (oldest first)
+    std::deque<float> trajectory_vertices_;
+    bool trajectory_is_changed_ = false;
+
+    // current state
+    bool follow_camera_ = true;
+
+    // viewer appearance
+    const std::string map_viewer_name_{"PangolinViewer: Map Viewer (shared memory)"};
+    static constexpr float map_viewer_width_ = 1024;
+    static constexpr float map_viewer_height_ = 768;
+
+    //-----------------------------------------
+    // management for terminate process
+
+    //! mutex for access to terminate procedure
+    mutable std::mutex mtx_terminate_;
+
+    /**
+     * Check if termination is requested or not
+     * @return
+     */
+    bool terminate_is_requested();
+
+    /**
+     * Raise the flag which indicates the main loop has been already terminated
+     */
+    void terminate();
+
+    //! flag which indicates termination is requested or not
+    bool terminate_is_requested_ = false;
+    //! flag which indicates whether the main loop is terminated or not
+    bool is_terminated_ = true;
+};
+
+} // namespace pangolin_viewer
+
+#endif // PANGOLIN_VIEWER_SHM_VIEWER_H
@@ -11,6 +11,8 @@
 #include <opencv2/highgui.hpp>
 #include <tinycolormap.hpp>
 
+#include <array>
+
 namespace {
 int parse_int(const std::string& msg) {
     int ret = -1;
@@ -221,101 +223,134 @@ void viewer::draw_keyframes() {
     // frustum size of keyframes
     const float w = keyfrm_size_ * *menu_frm_size_;
 
-    std::vector<std::shared_ptr<stella_vslam::data::keyframe>> keyfrms;
-    map_publisher_->get_keyframes(keyfrms);
-    int keyframe_id = parse_int(*menu_kf_id_);
+    // the buffers are uploaded again only if the map or the appearance is changed
+    const auto map_change_version = map_publisher_->get_map_change_version();
+    if (!keyfrms_are_uploaded_ || map_change_version != uploaded_map_change_version_
+        || w != uploaded_keyfrm_size_ || *menu_min_shared_lms_ != uploaded_min_shared_lms_) {
+        upload_keyframes(w, *menu_min_shared_lms_);
+        keyfrms_are_uploaded_ = true;
+        uploaded_map_change_version_ = map_change_version;
+        uploaded_keyfrm_size_ = w;
+        uploaded_min_shared_lms_ = *menu_min_shared_lms_;
+    }
+
     if (*menu_show_keyfrms_) {
         glLineWidth(keyfrm_line_width_);
-        for (const auto keyfrm : keyfrms) {
-            if (!keyfrm || keyfrm->will_be_erased()) {
-                continue;
-            }
-            if (keyframe_id != -1 && keyfrm->id_ == static_cast<unsigned int>(keyframe_id)) {
-                glColor3fv(cs_.kf_line_selected_.data());
-            }
-            else {
-                glColor3fv(cs_.kf_line_.data());
-            }
-            draw_camera(keyfrm->get_pose_wc(), w);
+        glColor3fv(cs_.kf_line_.data());
+        keyfrms_buffer_.draw(GL_LINES);
+
+        // overdraw the selected keyframe
+        const int keyframe_id = parse_int(*menu_kf_id_);
+        const auto iter = (keyframe_id != -1) ? keyfrm_poses_wc_.find(keyframe_id) : keyfrm_poses_wc_.end();
+        if (iter != keyfrm_poses_wc_.end()) {
+            glDepthFunc(GL_LEQUAL);
+            glColor3fv(cs_.kf_line_selected_.data());
+            draw_camera(iter->second, w);
+            glDepthFunc(GL_LESS);
         }
     }
 
     glLineWidth(graph_line_width_);
 
-    const auto draw_edge = [](const stella_vslam::Vec3_t& cam_center_1, const stella_vslam::Vec3_t& cam_center_2) {
-        glVertex3fv(cam_center_1.cast<float>().eval().data());
-        glVertex3fv(cam_center_2.cast<float>().eval().data());
-    };
-
     if (*menu_show_graph_) {
         glColor4fv(cs_.graph_line_.data());
-        glBegin(GL_LINES);
-        for (const auto keyfrm : keyfrms) {
-            if (!keyfrm || keyfrm->will_be_erased()) {
-                continue;
-            }
-
-            const stella_vslam::Vec3_t cam_center_1 = keyfrm->get_trans_wc();
-
-            // covisibility graph
-            const auto covisibilities = keyfrm->graph_node_->get_covisibilities_over_min_num_shared_lms(*menu_min_shared_lms_);
-            if (!covisibilities.empty()) {
-                for (const auto covisibility : covisibilities) {
-                    if (!covisibility || covisibility->will_be_erased()) {
-                        continue;
-                    }
-                    if (covisibility->id_ < keyfrm->id_) {
-                        continue;
-                    }
-                    const stella_vslam::Vec3_t cam_center_2 = covisibility->get_trans_wc();
-                    draw_edge(cam_center_1, cam_center_2);
-                }
-            }
-        }
-        glEnd();
+        covisibility_graph_buffer_.draw(GL_LINES);
     }
 
     glColor4fv(cs_.graph_line_spanning_tree_.data());
-    glBegin(GL_LINES);
-    for (const auto keyfrm : keyfrms) {
+    spanning_tree_buffer_.draw(GL_LINES);
+
+    glColor4fv(cs_.graph_line_loop_edge_.data());
+    loop_edges_buffer_.draw(GL_LINES);
+}
+
+void viewer::upload_keyframes(const float w, const int min_shared_lms) {
+    std::vector<std::shared_ptr<stella_vslam::data::keyframe>> keyfrms;
+    map_publisher_->get_keyframes(keyfrms);
+
+    // the poses are read once for each upload, not for each rendering
+    keyfrm_poses_wc_.clear();
+    for (const auto& keyfrm : keyfrms) {
         if (!keyfrm || keyfrm->will_be_erased()) {
             continue;
         }
+        keyfrm_poses_wc_[keyfrm->id_] = keyfrm->get_pose_wc();
+    }
 
-        const stella_vslam::Vec3_t cam_center_1 = keyfrm->get_trans_wc();
+    const auto get_cam_center = [this](const std::shared_ptr<stella_vslam::data::keyframe>& keyfrm) -> stella_vslam::Vec3_t {
+        const auto iter = keyfrm_poses_wc_.find(keyfrm->id_);
+        if (iter != keyfrm_poses_wc_.end()) {
+            return iter->second.block<3, 1>(0, 3);
+        }
+        return keyfrm->get_trans_wc();
+    };
+    const auto push_vertex = [](std::vector<float>& vertices, const stella_vslam::Vec3_t& vertex) {
+        vertices.push_back(vertex(0));
+        vertices.push_back(vertex(1));
+        vertices.push_back(vertex(2));
+    };
 
-        // spanning tree
-        auto spanning_parent = keyfrm->graph_node_->get_spanning_parent();
-        if (spanning_parent) {
-            const stella_vslam::Vec3_t cam_center_2 = spanning_parent->get_trans_wc();
-            draw_edge(cam_center_1, cam_center_2);
+    // camera frustums transformed to the world (drawn by a single call)
+    const float h = w * 0.75f;
+    const float z = w * 0.6f;
+    const std::array<stella_vslam::Vec3_t, 16> frustum{{{0, 0, 0}, {w, h, z}, {0, 0, 0}, {w, -h, z}, {0, 0, 0}, {-w, -h, z}, {0, 0, 0}, {-w, h, z}, {w, h, z}, {w, -h, z}, {-w, h, z}, {-w, -h, z}, {-w, h, z}, {w, h, z}, {-w, -h, z}, {w, -h, z}}};
+    std::vector<float> frustum_vertices;
+    frustum_vertices.reserve(3 * frustum.size() * keyfrm_poses_wc_.size());
+    for (const auto& id_pose : keyfrm_poses_wc_) {
+        const stella_vslam::Mat33_t rot_wc = id_pose.second.block<3, 3>(0, 0);
+        const stella_vslam::Vec3_t trans_wc = id_pose.second.block<3, 1>(0, 3);
+        for (const auto& vertex : frustum) {
+            push_vertex(frustum_vertices, rot_wc * vertex + trans_wc);
         }
     }
-    glEnd();
+    keyfrms_buffer_.upload(frustum_vertices);
 
-    glColor4fv(cs_.graph_line_loop_edge_.data());
-    glBegin(GL_LINES);
-    for (const auto keyfrm : keyfrms) {
+    std::vector<float> covisibility_vertices;
+    std::vector<float> spanning_tree_vertices;
+    std::vector<float> loop_edge_vertices;
+    for (const auto& keyfrm : keyfrms) {
         if (!keyfrm || keyfrm->will_be_erased()) {
             continue;
         }
 
-        const stella_vslam::Vec3_t cam_center_1 = keyfrm->get_trans_wc();
+        const stella_vslam::Vec3_t cam_center_1 = get_cam_center(keyfrm);
+
+        // covisibility graph
+        const auto covisibilities = keyfrm->graph_node_->get_covisibilities_over_min_num_shared_lms(min_shared_lms);
+        for (const auto& covisibility : covisibilities) {
+            if (!covisibility || covisibility->will_be_erased()) {
+                continue;
+            }
+            if (covisibility->id_ < keyfrm->id_) {
+                continue;
+            }
+            push_vertex(covisibility_vertices, cam_center_1);
+            push_vertex(covisibility_vertices, get_cam_center(covisibility));
+        }
+
+        // spanning tree
+        const auto spanning_parent = keyfrm->graph_node_->get_spanning_parent();
+        if (spanning_parent) {
+            push_vertex(spanning_tree_vertices, cam_center_1);
+            push_vertex(spanning_tree_vertices, get_cam_center(spanning_parent));
+        }
 
         // loop edges
         const auto loop_edges = keyfrm->graph_node_->get_loop_edges();
-        for (const auto loop_edge : loop_edges) {
+        for (const auto& loop_edge : loop_edges) {
             if (!loop_edge) {
                 continue;
             }
             if (loop_edge->id_ < keyfrm->id_) {
                 continue;
             }
-            const stella_vslam::Vec3_t cam_center_2 = loop_edge->get_trans_wc();
-            draw_edge(cam_center_1, cam_center_2);
+            push_vertex(loop_edge_vertices, cam_center_1);
+            push_vertex(loop_edge_vertices, get_cam_center(loop_edge));
         }
     }
-    glEnd();
+    covisibility_graph_buffer_.upload(covisibility_vertices);
+    spanning_tree_buffer_.upload(spanning_tree_vertices);
+    loop_edges_buffer_.upload(loop_edge_vertices);
 }
 
 void viewer::draw_landmarks() {
@@ -323,57 +358,54 @@ void viewer::draw_landmarks() {
         return;
     }
 
-    std::vector<std::shared_ptr<stella_vslam::data::landmark>> landmarks;
-    std::set<std::shared_ptr<stella_vslam::data::landmark>> local_landmarks;
-
-    map_publisher_->get_landmarks(landmarks, local_landmarks);
-
-    if (landmarks.empty()) {
-        return;
-    }
-
-    glPointSize(point_size_ * *menu_lm_size_);
-    glColor3fv(cs_.lm_.data());
-
-    glBegin(GL_POINTS);
+    const auto snapshot = map_publisher_->get_landmarks_snapshot();
 
-    for (const auto& lm : landmarks) {
-        if (!lm || lm->will_be_erased()) {
-            continue;
-        }
-        if (*menu_show_local_map_ && local_landmarks.count(lm)) {
-            continue;
-        }
-        const stella_vslam::Vec3_t pos_w = lm->get_pos_in_world();
-        if (!*menu_show_local_map_) {
-            const double score = lm->get_observed_ratio();
+    // the points are uploaded again only if the tracker publishes the new ones
+    if (snapshot->points_ != uploaded_lm_points_) {
+        std::vector<float> colors;
+        colors.reserve(3 * snapshot->size());
+        for (const auto score : snapshot->points_->observed_ratios_) {
             const tinycolormap::Color score_color = tinycolormap::GetColor(score, tinycolormap::ColormapType::Turbo);
-            std::array<float, 3> lm_color{static_cast<float>(score_color.r()), static_cast<float>(score_color.g()), static_cast<float>(score_color.b())};
-            glColor3fv(lm_color.data());
+            colors.push_back(score_color.r());
+            colors.push_back(score_color.g());
+            colors.push_back(score_color.b());
         }
-        glVertex3fv(pos_w.cast<float>().eval().data());
+        lms_buffer_.upload(snapshot->points_->positions_, colors);
+        uploaded_lm_points_ = snapshot->points_;
     }
 
-    glEnd();
-
-    if (!*menu_show_local_map_) {
+    if (lms_buffer_.size() == 0) {
         return;
     }
 
     glPointSize(point_size_ * *menu_lm_size_);
-    glColor3fv(cs_.local_lm_.data());
+    if (!*menu_show_local_map_) {
+        lms_buffer_.draw(GL_POINTS);
+        return;
+    }
 
-    glBegin(GL_POINTS);
+    glColor3fv(cs_.lm_.data());
+    lms_buffer_.draw(GL_POINTS, false);
 
-    for (const auto& local_lm : local_landmarks) {
-        if (local_lm->will_be_erased()) {
-            continue;
+    // the local landmarks are changed by every frame, but they are a few
+    if (snapshot->version_ != uploaded_lms_snapshot_version_) {
+        std::vector<float> local_lm_vertices;
+        for (unsigned int idx = 0; idx < snapshot->size(); ++idx) {
+            if (!snapshot->is_local(idx)) {
+                continue;
+            }
+            const float* pos_w = snapshot->get_position(idx);
+            local_lm_vertices.insert(local_lm_vertices.end(), pos_w, pos_w + 3);
         }
-        const stella_vslam::Vec3_t pos_w = local_lm->get_pos_in_world();
-        glVertex3fv(pos_w.cast<float>().eval().data());
+        local_lms_buffer_.upload(local_lm_vertices);
+        uploaded_lms_snapshot_version_ = snapshot->version_;
     }
 
-    glEnd();
+    // overdraw the local landmarks at the same depth
+    glDepthFunc(GL_LEQUAL);
+    glColor3fv(cs_.local_lm_.data());
+    local_lms_buffer_.draw(GL_POINTS);
+    glDepthFunc(GL_LESS);
 }
 
 void viewer::draw_camera(const pangolin::OpenGlMatrix& gl_cam_pose_wc, const float width) const {
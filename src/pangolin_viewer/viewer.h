@@ -2,6 +2,7 @@
 #define PANGOLIN_VIEWER_VIEWER_H
 
 #include "pangolin_viewer/color_scheme.h"
+#include "pangolin_viewer/gl_vertex_buffer.h"
 
 #include "stella_vslam/type.h"
 #include "stella_vslam/util/yaml.h"
@@ -19,6 +20,7 @@ class system;
 namespace publish {
 class frame_publisher;
 class map_publisher;
+struct landmark_points;
 } // namespace publish
 
 } // namespace stella_vslam
@@ -90,6 +92,13 @@ private:
      */
     void draw_keyframes();
 
+    /**
+     * Upload the camera frustums of the keyframes and the graph edges to the GPU
+     * @param w frustum size
+     * @param min_shared_lms minimum number of the shared landmarks of the covisibility edges
+     */
+    void upload_keyframes(const float w, const int min_shared_lms);
+
     /**
      * Get and draw landmarks via the map publisher
      */
@@ -172,6 +181,23 @@ private:
     // camera renderer
     std::unique_ptr<pangolin::OpenGlRenderState> s_cam_;
 
+    // GPU buffers of the map, which are uploaded only when the map is changed
+    gl_vertex_buffer keyfrms_buffer_;
+    gl_vertex_buffer covisibility_graph_buffer_;
+    gl_vertex_buffer spanning_tree_buffer_;
+    gl_vertex_buffer loop_edges_buffer_;
+    gl_vertex_buffer lms_buffer_;
+    gl_vertex_buffer local_lms_buffer_;
+    //! poses of the uploaded keyframes (to draw the selected one)
+    stella_vslam::eigen_alloc_map<unsigned int, stella_vslam::Mat44_t> keyfrm_poses_wc_;
+    bool keyfrms_are_uploaded_ = false;
+    uint64_t uploaded_map_change_version_ = 0;
+    float uploaded_keyfrm_size_ = 0.0;
+    int uploaded_min_shared_lms_ = 0;
+    //! landmarks in the landmark buffer
+    std::shared_ptr<const stella_vslam::publish::landmark_points> uploaded_lm_points_;
+    uint64_t uploaded_lms_snapshot_version_ = 0;
+
     // current state
     bool follow_camera_ = true;
     bool mapping_mode_ = true;
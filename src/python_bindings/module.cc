@@ -0,0 +1,301 @@
+#include "stella_vslam/system.h"
+#include "stella_vslam/config.h"
+#include "stella_vslam/tracking_module.h"
+#include "stella_vslam/data/keyframe.h"
+#include "stella_vslam/publish/map_publisher.h"
+
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <opencv2/core/mat.hpp>
+#include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
+#include <pybind11/stl.h>
+
+namespace py = pybind11;
+using namespace pybind11::literals;
+
+namespace {
+
+/**
+ * Wrap the NumPy image as cv::Mat without copying
+ * (uint8, uint16 or float32 of (rows, cols) or (rows, cols, channels). The rows can be padded, but the pixels in a row must be contiguous)
+ * @param arr
+ * @param name name of the argument (for the error messages)
+ * @return cv::Mat which refers to the buffer of arr
+ */
+cv::Mat to_mat_view(const py::array& arr, const std::string& name) {
+    const auto ndim = arr.ndim();
+    if (ndim != 2 && ndim != 3) {
+        throw std::runtime_error(name + " must be an array of (rows, cols) or (rows, cols, channels)");
+    }
+    const auto channels = (ndim == 3) ? arr.shape(2) : 1;
+    if (channels < 1 || 4 < channels) {
+        throw std::runtime_error(name + " must have 1 to 4 channels");
+    }
+
+    int depth = 0;
+    if (arr.dtype().is(py::dtype::of<uint8_t>())) {
+        depth = CV_8U;
+    }
+    else if (arr.dtype().is(py::dtype::of<uint16_t>())) {
+        depth = CV_16U;
+    }
+    else if (arr.dtype().is(py::dtype::of<float>())) {
+        depth = CV_32F;
+    }
+    else {
+        throw std::runtime_error(name + " must be an array of uint8, uint16 or float32");
+    }
+
+    const auto item_size = arr.itemsize();
+    const bool pixels_are_contiguous = (ndim == 2) ? arr.strides(1) == item_size
+                                                   : arr.strides(2) == item_size && arr.strides(1) == item_size * channels;
+    if (!pixels_are_contiguous || arr.strides(0) < arr.shape(1) * channels * item_size) {
+        throw std::runtime_error(name + " must be contiguous in each row (e.g. use numpy.ascontiguousarray())");
+    }
+
+    return cv::Mat(static_cast<int>(arr.shape(0)), static_cast<int>(arr.shape(1)), CV_MAKETYPE(depth, static_cast<int>(channels)),
+                   const_cast<void*>(arr.data()), static_cast<size_t>(arr.strides(0)));
+}
+
+//! Wrap the optional NumPy image (an empty cv::Mat for None)
+cv::Mat to_mat_view(const py::object& obj, const std::string& name) {
+    if (obj.is_none()) {
+        return cv::Mat();
+    }
+    return to_mat_view(obj.cast<py::array>(), name);
+}
+
+//! Copy the pose into a (4, 4) array
+py::array_t<double> to_array(const stella_vslam::Mat44_t& pose) {
+    py::array_t<double> arr({4, 4});
+    auto elems = arr.mutable_unchecked<2>();
+    for (py::ssize_t row = 0; row < 4; ++row) {
+        for (py::ssize_t col = 0; col < 4; ++col) {
+            elems(row, col) = pose(row, col);
+        }
+    }
+    return arr;
+}
+
+//! Copy the pose into a (4, 4) array, or None if the pose is not estimated
+py::object to_array(const std::shared_ptr<stella_vslam::Mat44_t>& pose) {
+    if (!pose) {
+        return py::none();
+    }
+    return to_array(*pose);
+}
+
+std::string to_string(const stella_vslam::tracker_state_t tracking_state) {
+    switch (tracking_state) {
+        case stella_vslam::tracker_state_t::Initializing:
+            return "Initializing";
+        case stella_vslam::tracker_state_t::Tracking:
+            return "Tracking";
+        case stella_vslam::tracker_state_t::Lost:
+            return "Lost";
+    }
+    return "";
+}
+
+//! Make the array read-only (for the arrays which refer to the shared buffers)
+template<typename T>
+py::array_t<T> set_read_only(py::array_t<T> arr) {
+    arr.attr("setflags")("write"_a = false);
+    return arr;
+}
+
+/**
+ * Get the landmarks of the latest snapshot of the map publisher
+ * (the IDs, the positions and the observed ratios refer to the flat arrays of the snapshot without copying.
+ *  The arrays are read-only, and they keep the snapshot alive)
+ */
+py::dict get_landmarks(const stella_vslam::system& slam) {
+    const auto snapshot = slam.get_map_publisher()->get_landmarks_snapshot();
+    const auto& points = *snapshot->points_;
+    const auto num_lms = static_cast<py::ssize_t>(snapshot->size());
+
+    // the capsule owns a reference to the snapshot while the arrays are alive
+    const py::capsule owner(new std::shared_ptr<const stella_vslam::publish::landmarks_snapshot>(snapshot), [](void* ptr) {
+        delete static_cast<std::shared_ptr<const stella_vslam::publish::landmarks_snapshot>*>(ptr);
+    });
+    auto ids = set_read_only(py::array_t<unsigned int>({num_lms}, {static_cast<py::ssize_t>(sizeof(unsigned int))},
+                                                       points.ids_.data(), owner));
+    auto positions = set_read_only(py::array_t<float>({num_lms, static_cast<py::ssize_t>(3)},
+                                                      {static_cast<py::ssize_t>(3 * sizeof(float)), static_cast<py::ssize_t>(sizeof(float))},
+                                                      points.positions_.data(), owner));
+    auto observed_ratios = set_read_only(py::array_t<float>({num_lms}, {static_cast<py::ssize_t>(sizeof(float))},
+                                                            points.observed_ratios_.data(), owner));
+
+    // (the bitmap is unpacked)
+    py::array_t<bool> is_local(num_lms);
+    auto is_local_elems = is_local.mutable_unchecked<1>();
+    for (py::ssize_t idx = 0; idx < num_lms; ++idx) {
+        is_local_elems(idx) = snapshot->is_local(idx);
+    }
+
+    return py::dict("version"_a = snapshot->version_,
+                    "ids"_a = ids,
+                    "positions"_a = positions,
+                    "observed_ratios"_a = observed_ratios,
+                    "is_local"_a = is_local);
+}
+
+//! Get the IDs, the timestamps and the camera poses of the keyframes in the ascending order of the IDs
+py::dict get_keyframes(const stella_vslam::system& slam) {
+    std::vector<unsigned int> ids;
+    std::vector<double> timestamps;
+    stella_vslam::eigen_alloc_vector<stella_vslam::Mat44_t> poses_cw;
+    {
+        py::gil_scoped_release release;
+        std::vector<std::shared_ptr<stella_vslam::data::keyframe>> keyfrms;
+        slam.get_map_publisher()->get_keyframes(keyfrms);
+        std::sort(keyfrms.begin(), keyfrms.end(), [](const std::shared_ptr<stella_vslam::data::keyframe>& a,
+                                                     const std::shared_ptr<stella_vslam::data::keyframe>& b) {
+            return a->id_ < b->id_;
+        });
+        ids.reserve(keyfrms.size());
+        timestamps.reserve(keyfrms.size());
+        poses_cw.reserve(keyfrms.size());
+        for (const auto& keyfrm : keyfrms) {
+            ids.push_back(keyfrm->id_);
+            timestamps.push_back(keyfrm->timestamp_);
+            // (the pose is read without locking the keyframe)
+            poses_cw.push_back(keyfrm->get_pose_cw());
+        }
+    }
+
+    const auto num_keyfrms = static_cast<py::ssize_t>(ids.size());
+    py::array_t<unsigned int> ids_arr(num_keyfrms);
+    py::array_t<double> timestamps_arr(num_keyfrms);
+    py::array_t<double> poses_cw_arr({num_keyfrms, static_cast<py::ssize_t>(4), static_cast<py::ssize_t>(4)});
+    auto ids_elems = ids_arr.mutable_unchecked<1>();
+    auto timestamps_elems = timestamps_arr.mutable_unchecked<1>();
+    auto poses_cw_elems = poses_cw_arr.mutable_unchecked<3>();
+    for (py::ssize_t idx = 0; idx < num_keyfrms; ++idx) {
+        ids_elems(idx) = ids.at(idx);
+        timestamps_elems(idx) = timestamps.at(idx);
+        const auto& pose_cw = poses_cw.at(idx);
+        for (py::ssize_t row = 0; row < 4; ++row) {
+            for (py::ssize_t col = 0; col < 4; ++col) {
+                poses_cw_elems(idx, row, col) = pose_cw(row, col);
+            }
+        }
+    }
+
+    return py::dict("ids"_a = ids_arr,
+                    "timestamps"_a = timestamps_arr,
+                    "poses_cw"_a = poses_cw_arr);
+}
+
+} // namespace
+
+PYBIND11_MODULE(stella_vslam_py, m) {
+    m.doc() = "Python bindings of stella_vslam::system\n"
+              "The images are NumPy arrays of uint8 (or uint16 and float32 for the depthmaps), which are passed to the system without copying.\n"
+              "The poses are (4, 4) float64 arrays, and the frames are tracked without holding the GIL.";
+
+    py::class_<stella_vslam::system, std::shared_ptr<stella_vslam::system>>(m, "System")
+        .def(py::init([](const std::string& config_file_path, const std::string& vocab_file_path) {
+                 const auto cfg = std::make_shared<stella_vslam::config>(config_file_path);
+                 return std::make_shared<stella_vslam::system>(cfg, vocab_file_path);
+             }),
+             "config_file_path"_a, "vocab_file_path"_a)
+        .def(
+            "startup", [](stella_vslam::system& slam, const bool need_initialize) {
+                py::gil_scoped_release release;
+                slam.startup(need_initialize);
+            },
+            "need_initialize"_a = true, "Startup the SLAM system")
+        .def(
+            "shutdown", [](stella_vslam::system& slam) {
+                py::gil_scoped_release release;
+                slam.shutdown();
+            },
+            "Shutdown the SLAM system")
+        .def(
+            "feed_monocular_frame", [](stella_vslam::system& slam, const py::array& img, const double timestamp, const py::object& mask) {
+                const auto img_mat = to_mat_view(img, "img");
+                const auto mask_mat = to_mat_view(mask, "mask");
+                std::shared_ptr<stella_vslam::Mat44_t> cam_pose_wc;
+                {
+                    py::gil_scoped_release release;
+                    cam_pose_wc = slam.feed_monocular_frame(img_mat, timestamp, mask_mat);
+                }
+                return to_array(cam_pose_wc);
+            },
+            "img"_a, "timestamp"_a, "mask"_a = py::none(),
+            "Feed a monocular frame and get the camera pose (camera to world), or None if not tracked")
+        .def(
+            "feed_stereo_frame", [](stella_vslam::system& slam, const py::array& left_img, const py::array& right_img, const double timestamp, const py::object& mask) {
+                const auto left_img_mat = to_mat_view(left_img, "left_img");
+                const auto right_img_mat = to_mat_view(right_img, "right_img");
+                const auto mask_mat = to_mat_view(mask, "mask");
+                std::shared_ptr<stella_vslam::Mat44_t> cam_pose_wc;
+                {
+                    py::gil_scoped_release release;
+                    cam_pose_wc = slam.feed_stereo_frame(left_img_mat, right_img_mat, timestamp, mask_mat);
+                }
+                return to_array(cam_pose_wc);
+            },
+            "left_img"_a, "right_img"_a, "timestamp"_a, "mask"_a = py::none(),
+            "Feed a stereo-rectified frame and get the camera pose (camera to world), or None if not tracked")
+        .def(
+            "feed_RGBD_frame", [](stella_vslam::system& slam, const py::array& rgb_img, const py::array& depthmap, const double timestamp, const py::object& mask) {
+                const auto rgb_img_mat = to_mat_view(rgb_img, "rgb_img");
+                const auto depthmap_mat = to_mat_view(depthmap, "depthmap");
+                const auto mask_mat = to_mat_view(mask, "mask");
+                std::shared_ptr<stella_vslam::Mat44_t> cam_pose_wc;
+                {
+                    py::gil_scoped_release release;
+                    cam_pose_wc = slam.feed_RGBD_frame(rgb_img_mat, depthmap_mat, timestamp, mask_mat);
+                }
+                return to_array(cam_pose_wc);
+            },
+            "rgb_img"_a, "depthmap"_a, "timestamp"_a, "mask"_a = py::none(),
+            "Feed an RGBD frame (the depthmap is scaled by Camera.depthmap_factor) and get the camera pose (camera to world), or None if not tracked")
+        .def(
+            "get_current_cam_pose", [](const stella_vslam::system& slam) {
+                const auto cam_pose = slam.get_map_publisher()->get_current_cam_pose_with_state();
+                return py::dict("pose_cw"_a = to_array(cam_pose.cam_pose_cw_),
+                                "timestamp"_a = cam_pose.timestamp_,
+                                "tracking_state"_a = to_string(cam_pose.tracking_state_));
+            },
+            "Get the camera pose (world to camera) of the last tracked frame with its timestamp and the tracking state (lock-free)")
+        .def("get_landmarks", &get_landmarks,
+             "Get the landmarks of the latest map snapshot as a dict of the arrays: version, ids (N,), positions (N, 3), observed_ratios (N,) and is_local (N,)\n"
+             "(ids, positions and observed_ratios are read-only views of the snapshot)")
+        .def("get_keyframes", &get_keyframes,
+             "Get the keyframes as a dict of the arrays: ids (N,), timestamps (N,) and poses_cw (N, 4, 4), sorted by the IDs")
+        .def(
+            "save_frame_trajectory", [](const stella_vslam::system& slam, const std::string& path, const std::string& format) {
+                py::gil_scoped_release release;
+                slam.save_frame_trajectory(path, format);
+            },
+            "path"_a, "format"_a = "TUM", "Save the frame trajectory in the format (TUM or KITTI)")
+        .def(
+            "save_keyframe_trajectory", [](const stella_vslam::system& slam, const std::string& path, const std::string& format) {
+                py::gil_scoped_release release;
+                slam.save_keyframe_trajectory(path, format);
+            },
+            "path"_a, "format"_a = "TUM", "Save the keyframe trajectory in the format (TUM or KITTI)")
+        .def(
+            "load_map_database", [](const stella_vslam::system& slam, const std::string& path) {
+                py::gil_scoped_release release;
+                slam.load_map_database(path);
+            },
+            "path"_a, "Load the map database from the file (call before startup(False))")
+        .def(
+            "save_map_database", [](const stella_vslam::system& slam, const std::string& path) {
+                py::gil_scoped_release release;
+                slam.save_map_database(path);
+            },
+            "path"_a, "Save the map database to the file")
+        .def("request_reset", &stella_vslam::system::request_reset, "Request to reset the system")
+        .def("terminate_is_requested", &stella_vslam::system::terminate_is_requested, "Termination is requested or not")
+        .def("loop_BA_is_running", &stella_vslam::system::loop_BA_is_running, "Loop BA is running or not");
+}
@@ -0,0 +1,185 @@
+#include "shm_publisher/publisher.h"
+#include "shm_publisher/shm_layout.h"
+
+#include "stella_vslam/data/keyframe.h"
+#include "stella_vslam/publish/map_publisher.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+#include <yaml-cpp/yaml.h>
+
+namespace shm_publisher {
+
+namespace {
+shared_memory create_region(const YAML::Node& yaml_node) {
+    const auto name = yaml_node["name"].as<std::string>("/stella_vslam");
+    const auto num_pose_slots = yaml_node["num_pose_slots"].as<uint32_t>(256);
+    const auto max_num_keyfrms = yaml_node["max_num_keyframes"].as<uint32_t>(10000);
+    const auto max_num_landmarks = yaml_node["max_num_landmarks"].as<uint32_t>(500000);
+    if (num_pose_slots == 0) {
+        throw std::runtime_error("ShmPublisher.num_pose_slots must be positive");
+    }
+
+    auto shm = shared_memory::create(name, get_region_size(num_pose_slots, max_num_keyfrms, max_num_landmarks));
+    auto header = static_cast<region_header*>(shm.data());
+    header->layout_version_ = layout_version;
+    header->num_pose_slots_ = num_pose_slots;
+    header->max_num_keyfrms_ = max_num_keyfrms;
+    header->max_num_landmarks_ = max_num_landmarks;
+    // the readers wait for the magic
+    header->magic_.store(layout_magic, std::memory_order_release);
+    spdlog::info("shm_publisher: created the shared memory {} ({} bytes)", name, shm.size());
+    return shm;
+}
+
+void write_row_major(const stella_vslam::Mat44_t& mat, double* dst) {
+    for (unsigned int row = 0; row < 4; ++row) {
+        for (unsigned int col = 0; col < 4; ++col) {
+            dst[4 * row + col] = mat(row, col);
+        }
+    }
+}
+} // namespace
+
+publisher::publisher(const YAML::Node& yaml_node,
+                     const std::shared_ptr<stella_vslam::publish::map_publisher>& map_publisher)
+    : map_publisher_(map_publisher),
+      pose_interval_(yaml_node["pose_interval"].as<unsigned int>(200)),
+      map_interval_(yaml_node["map_interval"].as<unsigned int>(100000)),
+      shm_(create_region(yaml_node)),
+      header_(static_cast<region_header*>(shm_.data())) {}
+
+void publisher::run() {
+    is_terminated_ = false;
+
+    auto last_map_time = std::chrono::steady_clock::now();
+    while (!terminate_is_requested()) {
+        publish_pose();
+
+        const auto now = std::chrono::steady_clock::now();
+        if (map_interval_ <= std::chrono::duration_cast<std::chrono::microseconds>(now - last_map_time).count()) {
+            publish_map();
+            last_map_time = now;
+        }
+
+        std::this_thread::sleep_for(std::chrono::microseconds(pose_interval_));
+    }
+
+    terminate();
+}
+
+void publisher::publish_pose() {
+    const auto pose = map_publisher_->get_current_cam_pose_with_state();
+    if (pose.seq_ == last_pose_seq_) {
+        return;
+    }
+    last_pose_seq_ = pose.seq_;
+
+    pose_message message;
+    message.seq_ = header_->num_poses_.load(std::memory_order_relaxed) + 1;
+    message.timestamp_ = pose.timestamp_;
+    message.tracking_state_ = static_cast<int64_t>(pose.tracking_state_);
+    write_row_major(pose.cam_pose_cw_, message.cam_pose_cw_);
+
+    auto slots = reinterpret_cast<pose_slot*>(header_ + 1);
+    auto& slot = slots[(message.seq_ - 1) % header_->num_pose_slots_];
+    // the odd sequence indicates that the slot is being written
+    slot.seq_.store(2 * message.seq_ - 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    store_words(slot.words_, &message, num_pose_words);
+    slot.seq_.store(2 * message.seq_, std::memory_order_release);
+    header_->num_poses_.store(message.seq_, std::memory_order_release);
+}
+
+void publisher::publish_map() {
+    const auto map_change_version = map_publisher_->get_map_change_version();
+    const auto lms_snapshot = map_publisher_->get_landmarks_snapshot();
+    if (map_is_published_ && map_change_version == last_map_change_version_ && lms_snapshot->version_ == last_lms_snapshot_version_) {
+        return;
+    }
+    map_is_published_ = true;
+    last_map_change_version_ = map_change_version;
+    last_lms_snapshot_version_ = lms_snapshot->version_;
+
+    std::vector<std::shared_ptr<stella_vslam::data::keyframe>> keyfrms;
+    map_publisher_->get_keyframes(keyfrms);
+
+    // the readers keep reading the active buffer while the other one is written
+    const auto buffer_idx = 1 - header_->active_map_buffer_.load(std::memory_order_relaxed);
+    auto buffer = reinterpret_cast<uint8_t*>(header_)
+                  + get_map_buffer_offset(header_->num_pose_slots_, header_->max_num_keyfrms_, header_->max_num_landmarks_, buffer_idx);
+    auto buffer_header = reinterpret_cast<map_buffer_header*>(buffer);
+    // (the keyframe poses and the landmark positions are written as the atomic words)
+    auto keyfrm_pose_words = reinterpret_cast<std::atomic<uint64_t>*>(buffer_header + 1);
+    auto lm_position_words = keyfrm_pose_words + header_->max_num_keyfrms_ * num_keyframe_pose_words;
+
+    const auto seq = buffer_header->seq_.load(std::memory_order_relaxed);
+    buffer_header->seq_.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    // (NOTE: a reader may still be copying this buffer if it has been preempted for two snapshots,
+    //  then it detects the change of the sequence and reads again)
+    uint32_t num_keyfrms = 0;
+    bool is_truncated = false;
+    for (const auto& keyfrm : keyfrms) {
+        if (header_->max_num_keyfrms_ <= num_keyfrms) {
+            is_truncated = true;
+            break;
+        }
+        if (!keyfrm || keyfrm->will_be_erased()) {
+            continue;
+        }
+        keyframe_pose keyfrm_pose;
+        keyfrm_pose.id_ = keyfrm->id_;
+        keyfrm_pose.padding_ = 0;
+        write_row_major(keyfrm->get_pose_cw(), keyfrm_pose.cam_pose_cw_);
+        store_words(keyfrm_pose_words + num_keyfrms * num_keyframe_pose_words, &keyfrm_pose, num_keyframe_pose_words);
+        ++num_keyfrms;
+    }
+
+    const auto num_landmarks = static_cast<uint32_t>(std::min<size_t>(lms_snapshot->size(), header_->max_num_landmarks_));
+    for (uint32_t idx = 0; idx < num_landmarks; ++idx) {
+        landmark_position lm_position;
+        lm_position.id_ = lms_snapshot->points_->ids_.at(idx);
+        std::memcpy(lm_position.position_, lms_snapshot->get_position(idx), 3 * sizeof(float));
+        store_words(lm_position_words + idx * num_landmark_position_words, &lm_position, num_landmark_position_words);
+    }
+
+    const auto map_version = header_->map_version_.load(std::memory_order_relaxed) + 1;
+    buffer_header->version_.store(map_version, std::memory_order_relaxed);
+    buffer_header->num_keyfrms_.store(num_keyfrms, std::memory_order_relaxed);
+    buffer_header->num_landmarks_.store(num_landmarks, std::memory_order_relaxed);
+    buffer_header->is_truncated_.store(is_truncated || num_landmarks < lms_snapshot->size(), std::memory_order_relaxed);
+    buffer_header->seq_.store(seq + 2, std::memory_order_release);
+
+    header_->active_map_buffer_.store(buffer_idx, std::memory_order_release);
+    header_->map_version_.store(map_version, std::memory_order_release);
+}
+
+void publisher::request_terminate() {
+    std::lock_guard<std::mutex> lock(mtx_terminate_);
+    terminate_is_requested_ = true;
+}
+
+bool publisher::is_terminated() {
+    std::lock_guard<std::mutex> lock(mtx_terminate_);
+    return is_terminated_;
+}
+
+bool publisher::terminate_is_requested() {
+    std::lock_guard<std::mutex> lock(mtx_terminate_);
+    return terminate_is_requested_;
+}
+
+void publisher::terminate() {
+    std::lock_guard<std::mutex> lock(mtx_terminate_);
+    is_terminated_ = true;
+}
+
+} // namespace shm_publisher
@@ -0,0 +1,78 @@
+#ifndef SHM_PUBLISHER_PUBLISHER_H
+#define SHM_PUBLISHER_PUBLISHER_H
+
+#include "shm_publisher/shared_memory.h"
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace YAML {
+class Node;
+} // namespace YAML
+
+namespace stella_vslam {
+namespace publish {
+class map_publisher;
+} // namespace publish
+} // namespace stella_vslam
+
+namespace shm_publisher {
+
+struct region_header;
+
+/**
+ * Publisher of the camera poses and the map to the local consumers via the shared memory (see shm_layout.h)
+ * The poses are written to the ring buffer as soon as the tracker updates them,
+ * and the snapshot of the keyframe poses and the landmark positions is written to the inactive map buffer, which is swapped afterwards.
+ * The consumers read them with shm_publisher::reader without any serialization.
+ */
+class publisher {
+public:
+    publisher(const YAML::Node& yaml_node,
+              const std::shared_ptr<stella_vslam::publish::map_publisher>& map_publisher);
+
+    //! Main loop (returns after request_terminate())
+    void run();
+
+    /* thread controls */
+    void request_terminate();
+    bool is_terminated();
+
+    //! Write the latest pose if it is updated
+    void publish_pose();
+
+    //! Write the snapshot of the map if the map is updated
+    void publish_map();
+
+private:
+    const std::shared_ptr<stella_vslam::publish::map_publisher> map_publisher_;
+    //! polling interval of the poses [us]
+    const unsigned int pose_interval_;
+    //! minimum interval of the map snapshots [us]
+    const unsigned int map_interval_;
+
+    //! shared memory region and its header
+    shared_memory shm_;
+    region_header* const header_;
+
+    //! sequence number of the last published pose (0: not yet)
+    uint64_t last_pose_seq_ = 0;
+    //! versions of the map publisher when the last snapshot was written
+    uint64_t last_map_change_version_ = 0;
+    uint64_t last_lms_snapshot_version_ = 0;
+    //! the first snapshot is written or not
+    bool map_is_published_ = false;
+
+    bool terminate_is_requested();
+    void terminate();
+
+    std::mutex mtx_terminate_;
+    bool terminate_is_requested_ = false;
+    bool is_terminated_ = true;
+};
+
+} // namespace shm_publisher
+
+#endif // SHM_PUBLISHER_PUBLISHER_H
@@ -0,0 +1,120 @@
+#include "shm_publisher/reader.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+
+namespace shm_publisher {
+
+namespace {
+const region_header* validate_region(const shared_memory& shm) {
+    if (shm.size() < sizeof(region_header)) {
+        throw std::runtime_error("the shared memory is too small");
+    }
+    const auto header = static_cast<const region_header*>(shm.data());
+    if (header->magic_.load(std::memory_order_acquire) != layout_magic) {
+        throw std::runtime_error("the shared memory is not ready");
+    }
+    if (header->layout_version_ != layout_version) {
+        throw std::runtime_error("the layout version of the shared memory does not match");
+    }
+    if (shm.size() < get_region_size(header->num_pose_slots_, header->max_num_keyfrms_, header->max_num_landmarks_)) {
+        throw std::runtime_error("the shared memory is smaller than its layout");
+    }
+    return header;
+}
+} // namespace
+
+reader::reader(const std::string& name)
+    : shm_(shared_memory::open_read_only(name)),
+      header_(validate_region(shm_)),
+      slots_(reinterpret_cast<const pose_slot*>(header_ + 1)) {}
+
+bool reader::try_read_pose(const uint64_t seq, pose_message& pose) const {
+    const auto& slot = slots_[(seq - 1) % header_->num_pose_slots_];
+    if (slot.seq_.load(std::memory_order_acquire) != 2 * seq) {
+        return false;
+    }
+    pose_message copied_pose;
+    load_words(&copied_pose, slot.words_, num_pose_words);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.seq_.load(std::memory_order_relaxed) != 2 * seq) {
+        return false;
+    }
+    pose = copied_pose;
+    return true;
+}
+
+bool reader::get_latest_pose(pose_message& pose) const {
+    while (true) {
+        const auto seq = header_->num_poses_.load(std::memory_order_acquire);
+        if (seq == 0) {
+            return false;
+        }
+        // (fails only if the writer has gone around the ring buffer meanwhile)
+        if (try_read_pose(seq, pose)) {
+            return true;
+        }
+    }
+}
+
+uint64_t reader::get_poses_since(const uint64_t seq, std::vector<pose_message>& poses) const {
+    poses.clear();
+    const auto latest_seq = header_->num_poses_.load(std::memory_order_acquire);
+    const uint64_t num_slots = header_->num_pose_slots_;
+    const auto begin_seq = std::max(seq + 1, latest_seq < num_slots ? 1 : latest_seq - num_slots + 1);
+    pose_message pose;
+    for (auto s = begin_seq; s <= latest_seq; ++s) {
+        if (try_read_pose(s, pose)) {
+            poses.push_back(pose);
+        }
+    }
+    return latest_seq;
+}
+
+uint64_t reader::get_map_version() const {
+    return header_->map_version_.load(std::memory_order_acquire);
+}
+
+bool reader::get_map(map_snapshot& snapshot) const {
+    unsigned int num_retries = 0;
+    while (true) {
+        if (header_->map_version_.load(std::memory_order_acquire) == 0) {
+            return false;
+        }
+        const auto buffer_idx = header_->active_map_buffer_.load(std::memory_order_acquire);
+        const auto buffer = static_cast<const uint8_t*>(shm_.data())
+                            + get_map_buffer_offset(header_->num_pose_slots_, header_->max_num_keyfrms_, header_->max_num_landmarks_, buffer_idx);
+        const auto buffer_header = reinterpret_cast<const map_buffer_header*>(buffer);
+        const auto keyfrm_pose_words = reinterpret_cast<const std::atomic<uint64_t>*>(buffer_header + 1);
+        const auto lm_position_words = keyfrm_pose_words + header_->max_num_keyfrms_ * num_keyframe_pose_words;
+
+        const auto seq = buffer_header->seq_.load(std::memory_order_acquire);
+        if (!(seq & 1)) {
+            // (the copy may be torn by the writer, then it is discarded by checking the sequence)
+            const auto num_keyfrms = std::min(buffer_header->num_keyfrms_.load(std::memory_order_relaxed), header_->max_num_keyfrms_);
+            const auto num_landmarks = std::min(buffer_header->num_landmarks_.load(std::memory_order_relaxed), header_->max_num_landmarks_);
+            snapshot.version_ = buffer_header->version_.load(std::memory_order_relaxed);
+            snapshot.is_truncated_ = buffer_header->is_truncated_.load(std::memory_order_relaxed) != 0;
+            snapshot.keyfrms_.resize(num_keyfrms);
+            for (uint32_t idx = 0; idx < num_keyfrms; ++idx) {
+                load_words(&snapshot.keyfrms_.at(idx), keyfrm_pose_words + idx * num_keyframe_pose_words, num_keyframe_pose_words);
+            }
+            snapshot.landmarks_.resize(num_landmarks);
+            for (uint32_t idx = 0; idx < num_landmarks; ++idx) {
+                load_words(&snapshot.landmarks_.at(idx), lm_position_words + idx * num_landmark_position_words, num_landmark_position_words);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (buffer_header->seq_.load(std::memory_order_relaxed) == seq) {
+                return true;
+            }
+        }
+        // the buffer is being overwritten, then read the newer one
+        if (++num_retries % 64 == 0) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+} // namespace shm_publisher
@@ -0,0 +1,61 @@
+#ifndef SHM_PUBLISHER_READER_H
+#define SHM_PUBLISHER_READER_H
+
+#include "shm_publisher/shared_memory.h"
+#include "shm_publisher/shm_layout.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace shm_publisher {
+
+//! Copy of the snapshot of the map
+struct map_snapshot {
+    //! version of the snapshot (incremented at each snapshot)
+    uint64_t version_ = 0;
+    //! the keyframes or the landmarks exceeded the capacities of the region and were truncated
+    bool is_truncated_ = false;
+    std::vector<keyframe_pose> keyfrms_;
+    std::vector<landmark_position> landmarks_;
+};
+
+/**
+ * Reader of the region written by shm_publisher::publisher, for the consumers in the other processes
+ * The reads never block the writer and do not take any lock (they retry only if the data is overwritten while being copied).
+ * (NOTE: a reader is not thread-safe, create one per thread)
+ */
+class reader {
+public:
+    //! Open the region (throw std::runtime_error if it does not exist or is not ready)
+    explicit reader(const std::string& name = "/stella_vslam");
+
+    //! Get the latest pose (false if no pose is published yet)
+    bool get_latest_pose(pose_message& pose) const;
+
+    /**
+     * Get the poses newer than the sequence number (the ones overwritten in the ring buffer are skipped)
+     * @param seq sequence number of the last pose which the caller read (0 for all of the buffered poses)
+     * @param poses (oldest first)
+     * @return sequence number of the latest pose
+     */
+    uint64_t get_poses_since(const uint64_t seq, std::vector<pose_message>& poses) const;
+
+    //! Get the version of the latest snapshot of the map (0 if no snapshot is published yet)
+    uint64_t get_map_version() const;
+
+    //! Get the latest snapshot of the map (false if no snapshot is published yet)
+    bool get_map(map_snapshot& snapshot) const;
+
+private:
+    //! Copy the message from the slot if it is consistent and still holds the sequence number
+    bool try_read_pose(const uint64_t seq, pose_message& pose) const;
+
+    shared_memory shm_;
+    const region_header* const header_;
+    const pose_slot* const slots_;
+};
+
+} // namespace shm_publisher
+
+#endif // SHM_PUBLISHER_READER_H
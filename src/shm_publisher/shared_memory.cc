@@ -0,0 +1,73 @@
+#include "shm_publisher/shared_memory.h"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace shm_publisher {
+
+shared_memory shared_memory::create(const std::string& name, const size_t size) {
+    // (a stale object of a crashed writer is replaced)
+    ::shm_unlink(name.c_str());
+    const int fd = ::shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("cannot create the shared memory " + name + ": " + std::strerror(errno));
+    }
+    if (::ftruncate(fd, static_cast<off_t>(size)) != 0) {
+        const std::string error = std::strerror(errno);
+        ::close(fd);
+        ::shm_unlink(name.c_str());
+        throw std::runtime_error("cannot resize the shared memory " + name + ": " + error);
+    }
+    void* addr = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    // the mapping remains valid after closing the descriptor
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+        ::shm_unlink(name.c_str());
+        throw std::runtime_error("cannot map the shared memory " + name);
+    }
+    // (ftruncate fills the object with zeros)
+    return shared_memory(name, addr, size, true);
+}
+
+shared_memory shared_memory::open_read_only(const std::string& name) {
+    const int fd = ::shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+        throw std::runtime_error("cannot open the shared memory " + name + ": " + std::strerror(errno));
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || st.st_size <= 0) {
+        ::close(fd);
+        throw std::runtime_error("cannot stat the shared memory " + name);
+    }
+    const auto size = static_cast<size_t>(st.st_size);
+    void* addr = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+        throw std::runtime_error("cannot map the shared memory " + name);
+    }
+    return shared_memory(name, addr, size, false);
+}
+
+shared_memory::shared_memory(shared_memory&& other) noexcept
+    : name_(std::move(other.name_)), data_(other.data_), size_(other.size_), is_owner_(other.is_owner_) {
+    other.data_ = nullptr;
+    other.size_ = 0;
+    other.is_owner_ = false;
+}
+
+shared_memory::~shared_memory() {
+    if (data_) {
+        ::munmap(data_, size_);
+    }
+    if (is_owner_) {
+        ::shm_unlink(name_.c_str());
+    }
+}
+
+} // namespace shm_publisher
@@ -0,0 +1,53 @@
+#ifndef SHM_PUBLISHER_SHARED_MEMORY_H
+#define SHM_PUBLISHER_SHARED_MEMORY_H
+
+#include <cstddef>
+#include <string>
+
+namespace shm_publisher {
+
+/**
+ * POSIX shared memory object mapped into the process
+ * (throw std::runtime_error if it cannot be created or opened)
+ */
+class shared_memory {
+public:
+    //! Create the object with the size (an existing one with the same name is replaced)
+    static shared_memory create(const std::string& name, const size_t size);
+
+    //! Open the existing object read-only
+    static shared_memory open_read_only(const std::string& name);
+
+    shared_memory(shared_memory&& other) noexcept;
+
+    //! Destructor (unmap the object, and unlink it if this process created it)
+    ~shared_memory();
+
+    shared_memory(const shared_memory&) = delete;
+    shared_memory& operator=(const shared_memory&) = delete;
+    shared_memory& operator=(shared_memory&&) = delete;
+
+    //! Pointer to the first byte
+    void* data() const {
+        return data_;
+    }
+
+    //! Size of the object in bytes
+    size_t size() const {
+        return size_;
+    }
+
+private:
+    shared_memory(const std::string& name, void* data, const size_t size, const bool is_owner)
+        : name_(name), data_(data), size_(size), is_owner_(is_owner) {}
+
+    std::string name_;
+    void* data_ = nullptr;
+    size_t size_ = 0;
+    //! the object is unlinked on the destruction or not
+    bool is_owner_ = false;
+};
+
+} // namespace shm_publisher
+
+#endif // SHM_PUBLISHER_SHARED_MEMORY_H
@@ -0,0 +1,146 @@
+#ifndef SHM_PUBLISHER_SHM_LAYOUT_H
+#define SHM_PUBLISHER_SHM_LAYOUT_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace shm_publisher {
+
+/**
+ * Layout of the shared memory region
+ *
+ *   region_header
+ *   pose_slot x num_pose_slots_          (ring buffer of the camera poses)
+ *   map_buffer x 2                       (double-buffered snapshot of the map)
+ *     map_buffer_header
+ *     keyframe_pose x max_num_keyfrms_
+ *     landmark_position x max_num_landmarks_
+ *
+ * There is a single writer, and the readers never write to the region.
+ * The slots and the map buffers are protected by the sequence numbers in the manner of util::seqlock:
+ * the sequence is odd while the writer is writing, and the readers discard the copies whose sequence has changed.
+ * (the contents are accessed as the atomic 8-byte words with store_words() and load_words(),
+ *  so that the reads racing with the writer are well-defined)
+ */
+
+//! "SVSM"
+constexpr uint32_t layout_magic = 0x4d535653;
+//! incremented when the layout is changed
+constexpr uint32_t layout_version = 1;
+
+//! Camera pose of a tracked frame (row-major 4x4 matrix of the world-to-camera transform)
+struct pose_message {
+    //! sequence number of the message (incremented at each message from 1)
+    uint64_t seq_;
+    //! timestamp of the frame
+    double timestamp_;
+    //! stella_vslam::tracker_state_t
+    int64_t tracking_state_;
+    double cam_pose_cw_[16];
+};
+
+//! Number of the 8-byte words of pose_message
+constexpr unsigned int num_pose_words = sizeof(pose_message) / sizeof(uint64_t);
+static_assert(sizeof(pose_message) == num_pose_words * sizeof(uint64_t), "pose_message must consist of 8-byte words");
+
+//! Slot of the ring buffer of the poses
+struct pose_slot {
+    //! 2 * seq_ of the message after it is written, and odd while it is written
+    std::atomic<uint64_t> seq_;
+    //! words of pose_message (atomic so that the torn reads are well-defined)
+    std::atomic<uint64_t> words_[num_pose_words];
+};
+
+//! Pose of a keyframe
+struct keyframe_pose {
+    uint32_t id_;
+    uint32_t padding_;
+    //! row-major 4x4 matrix of the world-to-camera transform
+    double cam_pose_cw_[16];
+};
+
+//! Position of a landmark
+struct landmark_position {
+    uint32_t id_;
+    //! x, y and z in the world coordinates
+    float position_[3];
+};
+
+//! Number of the 8-byte words of keyframe_pose and landmark_position
+constexpr unsigned int num_keyframe_pose_words = sizeof(keyframe_pose) / sizeof(uint64_t);
+constexpr unsigned int num_landmark_position_words = sizeof(landmark_position) / sizeof(uint64_t);
+static_assert(sizeof(keyframe_pose) == num_keyframe_pose_words * sizeof(uint64_t), "keyframe_pose must consist of 8-byte words");
+static_assert(sizeof(landmark_position) == num_landmark_position_words * sizeof(uint64_t), "landmark_position must consist of 8-byte words");
+
+//! Header of a map buffer
+struct map_buffer_header {
+    //! even when the buffer is consistent, and odd while it is written
+    std::atomic<uint64_t> seq_;
+    //! version of the snapshot in the buffer
+    std::atomic<uint64_t> version_;
+    std::atomic<uint32_t> num_keyfrms_;
+    std::atomic<uint32_t> num_landmarks_;
+    //! the keyframes or the landmarks exceeded the capacities and were truncated
+    std::atomic<uint32_t> is_truncated_;
+    uint32_t padding_;
+};
+
+//! Store the words of the object to the atomic words of the region (relaxed, the sequence orders them)
+inline void store_words(std::atomic<uint64_t>* dst, const void* src, const unsigned int num_words) {
+    for (unsigned int i = 0; i < num_words; ++i) {
+        uint64_t word;
+        std::memcpy(&word, static_cast<const uint8_t*>(src) + i * sizeof(uint64_t), sizeof(uint64_t));
+        dst[i].store(word, std::memory_order_relaxed);
+    }
+}
+
+//! Load the atomic words of the region to the object (relaxed, the sequence orders them)
+inline void load_words(void* dst, const std::atomic<uint64_t>* src, const unsigned int num_words) {
+    for (unsigned int i = 0; i < num_words; ++i) {
+        const uint64_t word = src[i].load(std::memory_order_relaxed);
+        std::memcpy(static_cast<uint8_t*>(dst) + i * sizeof(uint64_t), &word, sizeof(uint64_t));
+    }
+}
+
+//! Header of the region
+struct region_header {
+    //! written last by the writer, so the region is ready once it matches layout_magic
+    std::atomic<uint32_t> magic_;
+    uint32_t layout_version_;
+    uint32_t num_pose_slots_;
+    uint32_t max_num_keyfrms_;
+    uint32_t max_num_landmarks_;
+    uint32_t padding_;
+    //! number of the written poses (the seq_ of the latest message)
+    std::atomic<uint64_t> num_poses_;
+    //! index of the map buffer which contains the latest snapshot
+    std::atomic<uint32_t> active_map_buffer_;
+    uint32_t padding2_;
+    //! version of the latest snapshot (0 until the first snapshot)
+    std::atomic<uint64_t> map_version_;
+};
+
+// (the atomics must be address-free to be shared between the processes)
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2, "the atomics of the region must be lock-free");
+
+//! Bytes of a map buffer
+inline size_t get_map_buffer_size(const uint32_t max_num_keyfrms, const uint32_t max_num_landmarks) {
+    return sizeof(map_buffer_header) + max_num_keyfrms * sizeof(keyframe_pose) + max_num_landmarks * sizeof(landmark_position);
+}
+
+//! Offset of the map buffer from the beginning of the region
+inline size_t get_map_buffer_offset(const uint32_t num_pose_slots, const uint32_t max_num_keyfrms, const uint32_t max_num_landmarks,
+                                    const unsigned int buffer_idx) {
+    return sizeof(region_header) + num_pose_slots * sizeof(pose_slot) + buffer_idx * get_map_buffer_size(max_num_keyfrms, max_num_landmarks);
+}
+
+//! Bytes of the whole region
+inline size_t get_region_size(const uint32_t num_pose_slots, const uint32_t max_num_keyfrms, const uint32_t max_num_landmarks) {
+    return get_map_buffer_offset(num_pose_slots, max_num_keyfrms, max_num_landmarks, 2);
+}
+
+} // namespace shm_publisher
+
+#endif // SHM_PUBLISHER_SHM_LAYOUT_H
@@ -1,11 +1,14 @@
 #include "socket_publisher/data_serializer.h"
+#include "socket_publisher/map_segment_encoder.h"
+#include "socket_publisher/point_cloud_lod.h"
 
 #include "stella_vslam/data/keyframe.h"
 #include "stella_vslam/data/landmark.h"
+#include "stella_vslam/data/map_change_journal.h"
 #include "stella_vslam/publish/frame_publisher.h"
 #include "stella_vslam/publish/map_publisher.h"
 
-#include <forward_list>
+#include <unordered_set>
 
 #include <opencv2/imgcodecs.hpp>
 
@@ -18,8 +21,10 @@ std::string data_serializer::serialized_reset_signal_{};
 
 data_serializer::data_serializer(const std::shared_ptr<stella_vslam::publish::frame_publisher>& frame_publisher,
                                  const std::shared_ptr<stella_vslam::publish::map_publisher>& map_publisher,
-                                 bool publish_points)
-    : frame_publisher_(frame_publisher), map_publisher_(map_publisher), publish_points_(publish_points),
+                                 bool publish_points,
+                                 const std::shared_ptr<point_cloud_lod>& lod,
+                                 const std::shared_ptr<map_segment_encoder>& encoder)
+    : frame_publisher_(frame_publisher), map_publisher_(map_publisher), publish_points_(publish_points), lod_(lod), encoder_(encoder),
       keyframe_hash_map_(new std::unordered_map<unsigned int, double>), point_hash_map_(new std::unordered_map<unsigned int, double>) {
     const auto tags = std::vector<std::string>{"RESET_ALL"};
     const auto messages = std::vector<std::string>{"reset all data"};
@@ -45,48 +50,128 @@ std::string data_serializer::serialize_messages(const std::vector<std::string>&
 }
 
 std::string data_serializer::serialize_map_diff() {
-    std::vector<std::shared_ptr<stella_vslam::data::keyframe>> keyframes;
-    map_publisher_->get_keyframes(keyframes);
-
-    std::vector<std::shared_ptr<stella_vslam::data::landmark>> all_landmarks;
-    std::set<std::shared_ptr<stella_vslam::data::landmark>> local_landmarks;
-    if (publish_points_) {
-        map_publisher_->get_landmarks(all_landmarks, local_landmarks);
-    }
-
     const auto current_camera_pose = map_publisher_->get_current_cam_pose();
 
+    // the landmarks waiting for the progressive refinement are sent even if the camera stops
+    const bool lod_is_enabled = publish_points_ && lod_ && lod_->is_enabled();
+    const bool refinement_is_pending = lod_is_enabled && lod_->refinement_is_pending();
+
     const double pose_hash = get_mat_hash(current_camera_pose);
-    if (pose_hash == current_pose_hash_) {
+    if (pose_hash == current_pose_hash_ && !refinement_is_pending) {
         current_pose_hash_ = pose_hash;
         return "";
     }
     current_pose_hash_ = pose_hash;
 
-    return serialize_as_protobuf(keyframes, all_landmarks, local_landmarks, current_camera_pose);
+    // the changes made while the whole map is collected are sent again next time, which is harmless
+    std::vector<stella_vslam::data::map_change> changes;
+    uint64_t latest_version = 0;
+    const bool changes_are_available = map_publisher_->get_map_changes_since(journal_version_, changes, latest_version);
+    journal_version_ = latest_version;
+    if (journal_is_synced_ && changes_are_available && !refinement_is_pending) {
+        return serialize_changes_as_protobuf(changes, current_camera_pose);
+    }
+    journal_is_synced_ = true;
+
+    std::vector<std::shared_ptr<stella_vslam::data::keyframe>> keyframes;
+    map_publisher_->get_keyframes(keyframes);
+
+    // (NOTE: the landmarks are read from the snapshot published by the tracker without locking the map)
+    const auto lms_snapshot = publish_points_ ? map_publisher_->get_landmarks_snapshot()
+                                              : std::make_shared<const stella_vslam::publish::landmarks_snapshot>();
+
+    return serialize_as_protobuf(keyframes, lms_snapshot, current_camera_pose);
+}
+
+std::string data_serializer::serialize_snapshot() {
+    const auto current_camera_pose = map_publisher_->get_current_cam_pose();
+
+    map_segment::map map;
+    auto message = map.add_messages();
+    message->set_tag("0");
+    message->set_txt("only map data");
+
+    // 1. keyframe registration (the current poses, which are not older than the sent ones)
+    std::vector<std::shared_ptr<stella_vslam::data::keyframe>> keyfrms;
+    map_publisher_->get_keyframes(keyfrms);
+    for (const auto& keyfrm : keyfrms) {
+        if (!keyfrm || keyfrm->will_be_erased() || !keyframe_hash_map_->count(keyfrm->id_)) {
+            continue;
+        }
+        const auto pose = keyfrm->get_pose_cw();
+        auto keyfrm_obj = map.add_keyframes();
+        keyfrm_obj->set_id(keyfrm->id_);
+        auto pose_obj = keyfrm_obj->mutable_pose();
+        for (int i = 0; i < 16; i++) {
+            int ir = i / 4;
+            int il = i % 4;
+            pose_obj->add_pose(pose(ir, il));
+        }
+    }
+
+    // 2. graph registration
+    serialize_graph(map, keyfrms);
+
+    // 3. landmark registration (the landmarks waiting for the level of detail are sent by the stream later)
+    const auto lms_snapshot = publish_points_ ? map_publisher_->get_landmarks_snapshot()
+                                              : std::make_shared<const stella_vslam::publish::landmarks_snapshot>();
+    for (unsigned int idx = 0; idx < lms_snapshot->size(); ++idx) {
+        const auto id = lms_snapshot->points_->ids_.at(idx);
+        if (!point_hash_map_->count(id)) {
+            continue;
+        }
+        const stella_vslam::Vec3_t pos = Eigen::Map<const Eigen::Vector3f>(lms_snapshot->get_position(idx)).cast<double>();
+        add_landmark(map, id, pos);
+    }
+
+    return serialize_map(map, lms_snapshot, current_camera_pose, true);
+}
+
+void data_serializer::reset() {
+    keyframe_hash_map_->clear();
+    point_hash_map_->clear();
+    journal_is_synced_ = false;
+    current_pose_hash_ = 0;
+    if (lod_) {
+        lod_->reset();
+    }
+    if (encoder_) {
+        encoder_->reset();
+    }
 }
 
 std::string data_serializer::serialize_latest_frame(const unsigned int image_quality) {
-    const auto image = frame_publisher_->draw_frame();
     std::vector<uchar> buf;
-    const std::vector<int> params{static_cast<int>(cv::IMWRITE_JPEG_QUALITY), static_cast<int>(image_quality)};
-    cv::imencode(".jpg", image, buf, params);
+    if (!encode_latest_frame(image_quality, buf)) {
+        return "";
+    }
     const auto char_buf = reinterpret_cast<const unsigned char*>(buf.data());
     const std::string base64_serial = base64_encode(char_buf, buf.size());
     return base64_serial;
 }
 
+bool data_serializer::encode_latest_frame(const unsigned int image_quality, std::vector<unsigned char>& buf) {
+    // skip drawing and encoding the same frame again
+    // (NOTE: the frame can be updated before drawing, then it is encoded once more next time, which is harmless)
+    const auto num_updates = frame_publisher_->get_num_updates();
+    if (num_updates == num_encoded_frame_updates_) {
+        return false;
+    }
+    num_encoded_frame_updates_ = num_updates;
+
+    const auto image = frame_publisher_->draw_frame();
+    const std::vector<int> params{static_cast<int>(cv::IMWRITE_JPEG_QUALITY), static_cast<int>(image_quality)};
+    return cv::imencode(".jpg", image, buf, params);
+}
+
 std::string data_serializer::serialize_as_protobuf(const std::vector<std::shared_ptr<stella_vslam::data::keyframe>>& keyfrms,
-                                                   const std::vector<std::shared_ptr<stella_vslam::data::landmark>>& all_landmarks,
-                                                   const std::set<std::shared_ptr<stella_vslam::data::landmark>>& local_landmarks,
+                                                   const std::shared_ptr<const stella_vslam::publish::landmarks_snapshot>& lms_snapshot,
                                                    const stella_vslam::Mat44_t& current_camera_pose) {
     map_segment::map map;
     auto message = map.add_messages();
     message->set_tag("0");
     message->set_txt("only map data");
 
-    std::forward_list<map_segment::map_keyframe*> allocated_keyframes;
-
     // 1. keyframe registration
 
     std::unordered_map<unsigned int, double> next_keyframe_hash_map;
@@ -113,14 +198,12 @@ std::string data_serializer::serialize_as_protobuf(const std::vector<std::shared
 
         auto keyfrm_obj = map.add_keyframes();
         keyfrm_obj->set_id(keyfrm->id_);
-        map_segment::map_Mat44* pose_obj = new map_segment::map_Mat44();
+        auto pose_obj = keyfrm_obj->mutable_pose();
         for (int i = 0; i < 16; i++) {
             int ir = i / 4;
             int il = i % 4;
             pose_obj->add_pose(pose(ir, il));
         }
-        keyfrm_obj->set_allocated_pose(pose_obj);
-        allocated_keyframes.push_front(keyfrm_obj);
     }
     // add removed keyframes.
     for (const auto& itr : *keyframe_hash_map_) {
@@ -133,6 +216,161 @@ std::string data_serializer::serialize_as_protobuf(const std::vector<std::shared
     *keyframe_hash_map_ = next_keyframe_hash_map;
 
     // 2. graph registration
+    serialize_graph(map, keyfrms);
+
+    // 3. landmark registration
+
+    const bool lod_is_enabled = lod_ && lod_->is_enabled();
+    std::vector<point_cloud_lod::point> unsent_points;
+
+    std::unordered_map<unsigned int, double> next_point_hash_map;
+    for (unsigned int idx = 0; idx < lms_snapshot->size(); ++idx) {
+        const auto id = lms_snapshot->points_->ids_.at(idx);
+        const stella_vslam::Vec3_t pos = Eigen::Map<const Eigen::Vector3f>(lms_snapshot->get_position(idx)).cast<double>();
+        const auto zip = get_vec_hash(pos);
+
+        // remove point from point_zip.
+        if (point_hash_map_->count(id) != 0) {
+            // point exists on next_point_zip.
+            next_point_hash_map[id] = zip;
+            if (point_hash_map_->at(id) == zip) {
+                point_hash_map_->erase(id);
+                continue;
+            }
+            point_hash_map_->erase(id);
+        }
+        else if (lod_is_enabled) {
+            // the new points are selected below
+            unsent_points.push_back(point_cloud_lod::point{id, pos});
+            continue;
+        }
+        else {
+            next_point_hash_map[id] = zip;
+        }
+
+        // add to protocol buffers
+        add_landmark(map, id, pos);
+    }
+    if (lod_is_enabled) {
+        if (next_point_hash_map.empty()) {
+            // the web viewer has no landmarks
+            lod_->reset();
+        }
+        for (const auto idx : lod_->select(unsent_points, true)) {
+            const auto& unsent_point = unsent_points.at(idx);
+            next_point_hash_map[unsent_point.id_] = get_vec_hash(unsent_point.pos_w_);
+            add_landmark(map, unsent_point.id_, unsent_point.pos_w_);
+        }
+    }
+    // removed points are remaining in "point_zips".
+    for (const auto& itr : *point_hash_map_) {
+        const auto id = itr.first;
+
+        auto landmark_obj = map.add_landmarks();
+        landmark_obj->set_id(id);
+    }
+    *point_hash_map_ = next_point_hash_map;
+
+    return serialize_map(map, lms_snapshot, current_camera_pose);
+}
+
+std::string data_serializer::serialize_changes_as_protobuf(const std::vector<stella_vslam::data::map_change>& changes,
+                                                           const stella_vslam::Mat44_t& current_camera_pose) {
+    map_segment::map map;
+    auto message = map.add_messages();
+    message->set_tag("0");
+    message->set_txt("only map data");
+
+    // the current states are sent, so only the IDs are needed
+    std::unordered_set<unsigned int> changed_keyfrm_ids;
+    std::unordered_set<unsigned int> changed_lm_ids;
+    for (const auto& change : changes) {
+        if (change.object_type_ == stella_vslam::data::map_object_type_t::Keyframe) {
+            changed_keyfrm_ids.insert(change.id_);
+        }
+        else if (publish_points_) {
+            changed_lm_ids.insert(change.id_);
+        }
+    }
+
+    // 1. keyframe registration
+    for (const auto id : changed_keyfrm_ids) {
+        const auto keyfrm = map_publisher_->get_keyframe(id);
+        if (!keyfrm || keyfrm->will_be_erased()) {
+            // send the removal only if the keyframe has been sent
+            if (keyframe_hash_map_->erase(id)) {
+                auto keyfrm_obj = map.add_keyframes();
+                keyfrm_obj->set_id(id);
+            }
+            continue;
+        }
+
+        const auto pose = keyfrm->get_pose_cw();
+        const auto pose_hash = get_mat_hash(pose);
+        const auto iter = keyframe_hash_map_->find(id);
+        if (iter != keyframe_hash_map_->end() && iter->second == pose_hash) {
+            continue;
+        }
+        (*keyframe_hash_map_)[id] = pose_hash;
+
+        auto keyfrm_obj = map.add_keyframes();
+        keyfrm_obj->set_id(id);
+        auto pose_obj = keyfrm_obj->mutable_pose();
+        for (int i = 0; i < 16; i++) {
+            int ir = i / 4;
+            int il = i % 4;
+            pose_obj->add_pose(pose(ir, il));
+        }
+    }
+
+    // 2. graph registration
+    std::vector<std::shared_ptr<stella_vslam::data::keyframe>> keyfrms;
+    map_publisher_->get_keyframes(keyfrms);
+    serialize_graph(map, keyfrms);
+
+    // 3. landmark registration
+    const bool lod_is_enabled = lod_ && lod_->is_enabled();
+    std::vector<point_cloud_lod::point> unsent_points;
+    for (const auto id : changed_lm_ids) {
+        const auto landmark = map_publisher_->get_landmark(id);
+        if (!landmark || landmark->will_be_erased()) {
+            if (point_hash_map_->erase(id)) {
+                auto landmark_obj = map.add_landmarks();
+                landmark_obj->set_id(id);
+            }
+            continue;
+        }
+
+        const auto pos = landmark->get_pos_in_world();
+        const auto zip = get_vec_hash(pos);
+        const auto iter = point_hash_map_->find(id);
+        if (iter != point_hash_map_->end() && iter->second == zip) {
+            continue;
+        }
+        if (iter == point_hash_map_->end() && lod_is_enabled) {
+            unsent_points.push_back(point_cloud_lod::point{id, pos});
+            continue;
+        }
+        (*point_hash_map_)[id] = zip;
+
+        add_landmark(map, id, pos);
+    }
+    if (lod_is_enabled) {
+        // the points which are not selected here are sent by the refinement
+        for (const auto idx : lod_->select(unsent_points, false)) {
+            const auto& unsent_point = unsent_points.at(idx);
+            (*point_hash_map_)[unsent_point.id_] = get_vec_hash(unsent_point.pos_w_);
+            add_landmark(map, unsent_point.id_, unsent_point.pos_w_);
+        }
+    }
+
+    const auto lms_snapshot = publish_points_ ? map_publisher_->get_landmarks_snapshot()
+                                              : std::make_shared<const stella_vslam::publish::landmarks_snapshot>();
+
+    return serialize_map(map, lms_snapshot, current_camera_pose);
+}
+
+void data_serializer::serialize_graph(map_segment::map& map, const std::vector<std::shared_ptr<stella_vslam::data::keyframe>>& keyfrms) {
     for (const auto& keyfrm : keyfrms) {
         if (!keyfrm || keyfrm->will_be_erased()) {
             continue;
@@ -178,73 +416,65 @@ std::string data_serializer::serialize_as_protobuf(const std::vector<std::shared
             edge_obj->set_id1(loop_edge->id_);
         }
     }
+}
 
-    // 3. landmark registration
-
-    std::unordered_map<unsigned int, double> next_point_hash_map;
-    for (const auto& landmark : all_landmarks) {
-        if (!landmark || landmark->will_be_erased()) {
-            continue;
-        }
+void data_serializer::add_landmark(map_segment::map& map, const unsigned int id, const stella_vslam::Vec3_t& pos) {
+    const unsigned int rgb[] = {0, 0, 0};
 
-        const auto id = landmark->id_;
-        const auto pos = landmark->get_pos_in_world();
-        const auto zip = get_vec_hash(pos);
+    auto landmark_obj = map.add_landmarks();
+    landmark_obj->set_id(id);
+    for (int i = 0; i < 3; i++) {
+        landmark_obj->add_coords(pos[i]);
+    }
+    for (int i = 0; i < 3; i++) {
+        landmark_obj->add_color(rgb[i]);
+    }
+}
 
-        // point exists on next_point_zip.
-        next_point_hash_map[id] = zip;
+std::string data_serializer::serialize_map(map_segment::map& map,
+                                           const std::shared_ptr<const stella_vslam::publish::landmarks_snapshot>& lms_snapshot,
+                                           const stella_vslam::Mat44_t& current_camera_pose,
+                                           const bool is_snapshot) {
+    // 4. local landmark registration
 
-        // remove point from point_zip.
-        if (point_hash_map_->count(id) != 0) {
-            if (point_hash_map_->at(id) == zip) {
-                point_hash_map_->erase(id);
-                continue;
-            }
-            point_hash_map_->erase(id);
+    for (unsigned int idx = 0; idx < lms_snapshot->size(); ++idx) {
+        if (lms_snapshot->is_local(idx)) {
+            map.add_local_landmarks(lms_snapshot->points_->ids_.at(idx));
         }
-        const unsigned int rgb[] = {0, 0, 0};
+    }
 
-        // add to protocol buffers
-        auto landmark_obj = map.add_landmarks();
-        landmark_obj->set_id(id);
-        for (int i = 0; i < 3; i++) {
-            landmark_obj->add_coords(pos[i]);
+    std::string buffer;
+    if (encoder_ && encoder_->is_enabled()) {
+        // 5. the current camera pose is registered with the compact encoding of the others
+        if (is_snapshot) {
+            encoder_->encode_snapshot(map, current_camera_pose);
         }
-        for (int i = 0; i < 3; i++) {
-            landmark_obj->add_color(rgb[i]);
+        else {
+            encoder_->encode(map, current_camera_pose);
         }
+        map.SerializeToString(&buffer);
     }
-    // removed points are remaining in "point_zips".
-    for (const auto& itr : *point_hash_map_) {
-        const auto id = itr.first;
-
-        auto landmark_obj = map.add_landmarks();
-        landmark_obj->set_id(id);
-    }
-    *point_hash_map_ = next_point_hash_map;
-
-    // 4. local landmark registration
+    else {
+        // 5. current camera pose registration
+        map_segment::map_Mat44 pose_obj{};
+        for (int i = 0; i < 16; i++) {
+            int ir = i / 4;
+            int il = i % 4;
+            pose_obj.add_pose(current_camera_pose(ir, il));
+        }
+        map.set_allocated_current_frame(&pose_obj);
 
-    for (const auto& landmark : local_landmarks) {
-        map.add_local_landmarks(landmark->id_);
-    }
+        map.SerializeToString(&buffer);
 
-    // 5. current camera pose registration
-    map_segment::map_Mat44 pose_obj{};
-    for (int i = 0; i < 16; i++) {
-        int ir = i / 4;
-        int il = i % 4;
-        pose_obj.add_pose(current_camera_pose(ir, il));
+        map.release_current_frame();
     }
-    map.set_allocated_current_frame(&pose_obj);
-
-    std::string buffer;
-    map.SerializeToString(&buffer);
 
-    for (const auto keyfrm_obj : allocated_keyframes) {
-        keyfrm_obj->clear_pose();
+    // the compressed segment is prefixed so that the viewer server can tell it
+    std::string compressed;
+    if (encoder_ && encoder_->compress(buffer, compressed)) {
+        const auto* cstr = reinterpret_cast<const unsigned char*>(compressed.c_str());
+        return "zstd:" + base64_encode(cstr, compressed.length());
     }
-    map.release_current_frame();
 
     const auto* cstr = reinterpret_cast<const unsigned char*>(buffer.c_str());
     return base64_encode(cstr, buffer.length());
@@ -3,6 +3,7 @@
 
 #include "stella_vslam/type.h"
 
+#include <cstdint>
 #include <memory>
 
 #include <Eigen/Core>
@@ -15,40 +16,81 @@ class config;
 namespace data {
 class keyframe;
 class landmark;
+struct map_change;
 } // namespace data
 
 namespace publish {
 class frame_publisher;
 class map_publisher;
+struct landmarks_snapshot;
 } // namespace publish
 
 } // namespace stella_vslam
 
+namespace map_segment {
+class map;
+} // namespace map_segment
+
 namespace socket_publisher {
 
+class map_segment_encoder;
+class point_cloud_lod;
+
 class data_serializer {
 public:
     data_serializer(const std::shared_ptr<stella_vslam::publish::frame_publisher>& frame_publisher,
                     const std::shared_ptr<stella_vslam::publish::map_publisher>& map_publisher,
-                    bool publish_points);
+                    bool publish_points,
+                    const std::shared_ptr<point_cloud_lod>& lod = nullptr,
+                    const std::shared_ptr<map_segment_encoder>& encoder = nullptr);
 
     std::string serialize_messages(const std::vector<std::string>& tags, const std::vector<std::string>& messages);
 
     std::string serialize_map_diff();
 
+    /**
+     * Serialize the keyframes and the landmarks which have been sent so far as a whole, for the late joiners of the stream
+     * (NOTE: this does not change the state of the stream, then the following diffs are valid for them as well)
+     */
+    std::string serialize_snapshot();
+
+    //! Forget the sent keyframes and landmarks so that the whole map is serialized next time (e.g. after reconnection)
+    void reset();
+
+    //! Serialize the latest frame as a base64 JPEG (empty if the frame is not updated since the last call)
     std::string serialize_latest_frame(const unsigned int image_quality_);
 
+    /**
+     * Encode the latest frame as JPEG if it is updated since the last call
+     * (NOTE: this can be called from another thread than serialize_map_diff())
+     * @param image_quality
+     * @param buf
+     * @return false if the frame is not updated
+     */
+    bool encode_latest_frame(const unsigned int image_quality, std::vector<unsigned char>& buf);
+
     static std::string serialized_reset_signal_;
 
 private:
     const std::shared_ptr<stella_vslam::publish::frame_publisher> frame_publisher_;
     const std::shared_ptr<stella_vslam::publish::map_publisher> map_publisher_;
     bool publish_points_ = true;
+    //! level of detail of the landmarks (nullptr to send all of them)
+    const std::shared_ptr<point_cloud_lod> lod_;
+    //! compact encoding and compression of the map segments (nullptr to send them as they are)
+    const std::shared_ptr<map_segment_encoder> encoder_;
     std::unique_ptr<std::unordered_map<unsigned int, double>> keyframe_hash_map_;
     std::unique_ptr<std::unordered_map<unsigned int, double>> point_hash_map_;
 
+    //! version of the map change journal which the last serialized map reflects
+    uint64_t journal_version_ = 0;
+    //! false until the whole map is serialized (the journal is consumed after that)
+    bool journal_is_synced_ = false;
+
     double current_pose_hash_ = 0;
     int frame_hash_ = 0;
+    //! number of the updates of the frame publisher when the frame was encoded last time
+    uint64_t num_encoded_frame_updates_ = 0;
 
     inline double get_vec_hash(const stella_vslam::Vec3_t& point) {
         return point[0] + point[1] + point[2];
@@ -59,10 +101,25 @@ private:
     }
 
     std::string serialize_as_protobuf(const std::vector<std::shared_ptr<stella_vslam::data::keyframe>>& keyfrms,
-                                      const std::vector<std::shared_ptr<stella_vslam::data::landmark>>& all_landmarks,
-                                      const std::set<std::shared_ptr<stella_vslam::data::landmark>>& local_landmarks,
+                                      const std::shared_ptr<const stella_vslam::publish::landmarks_snapshot>& lms_snapshot,
                                       const stella_vslam::Mat44_t& current_camera_pose);
 
+    /**
+     * Serialize only the keyframes and the landmarks which are changed since the last message
+     * (the graph is serialized as a whole, because the covisibilities are changed without the journal)
+     */
+    std::string serialize_changes_as_protobuf(const std::vector<stella_vslam::data::map_change>& changes,
+                                              const stella_vslam::Mat44_t& current_camera_pose);
+
+    void serialize_graph(map_segment::map& map, const std::vector<std::shared_ptr<stella_vslam::data::keyframe>>& keyfrms);
+
+    static void add_landmark(map_segment::map& map, const unsigned int id, const stella_vslam::Vec3_t& pos);
+
+    std::string serialize_map(map_segment::map& map,
+                              const std::shared_ptr<const stella_vslam::publish::landmarks_snapshot>& lms_snapshot,
+                              const stella_vslam::Mat44_t& current_camera_pose,
+                              const bool is_snapshot = false);
+
     std::string base64_encode(unsigned char const* bytes_to_encode, unsigned int in_len);
 };
 
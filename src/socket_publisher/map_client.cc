@@ -0,0 +1,137 @@
+#include "socket_publisher/map_client.h"
+#include "socket_publisher/remote_map_serializer.h"
+
+#include "stella_vslam/data/keyframe.h"
+#include "stella_vslam/publish/map_publisher.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#include <spdlog/spdlog.h>
+
+namespace socket_publisher {
+
+map_client::map_client(const YAML::Node& yaml_node,
+                       const std::shared_ptr<stella_vslam::publish::map_publisher>& map_publisher)
+    : map_publisher_(map_publisher),
+      robot_id_(yaml_node["robot_id"].as<unsigned int>(0)),
+      keyframe_delay_(yaml_node["keyframe_delay"].as<unsigned int>(10)),
+      max_num_keyframes_per_segment_(std::max(1u, yaml_node["max_num_keyframes_per_segment"].as<unsigned int>(20))),
+      streaming_interval_ms_(yaml_node["streaming_interval_ms"].as<unsigned int>(1000)),
+      client_(new socket_client(yaml_node["server_uri"].as<std::string>("http://127.0.0.1:3000"),
+                                yaml_node["max_num_in_flight"].as<unsigned int>(2),
+                                yaml_node["ack_timeout_ms"].as<unsigned int>(5000))) {
+    // the segments must not be dropped, since the keyframes are streamed only once
+    client_->add_channel("keyframe_segment", yaml_node["max_queue_size"].as<unsigned int>(100), false);
+    client_->set_binary_callback("map_correction", std::bind(&map_client::on_correction, this, std::placeholders::_1));
+    spdlog::info("map client: robot {}", robot_id_);
+}
+
+void map_client::run() {
+    {
+        std::lock_guard<std::mutex> lock(mtx_terminate_);
+        is_terminated_ = false;
+    }
+
+    while (true) {
+        const auto t0 = std::chrono::steady_clock::now();
+
+        stream_settled_keyframes();
+
+        const auto elapse = std::chrono::steady_clock::now() - t0;
+        const auto interval = std::chrono::milliseconds(streaming_interval_ms_);
+        if (elapse < interval) {
+            std::this_thread::sleep_for(interval - elapse);
+        }
+
+        std::lock_guard<std::mutex> lock(mtx_terminate_);
+        if (terminate_is_requested_) {
+            is_terminated_ = true;
+            break;
+        }
+    }
+}
+
+void map_client::stream_settled_keyframes() {
+    // (the keyframes are not regarded as streamed while the channel is congested or disconnected)
+    if (!client_->is_writable("keyframe_segment")) {
+        return;
+    }
+
+    std::vector<std::shared_ptr<stella_vslam::data::keyframe>> keyfrms;
+    map_publisher_->get_keyframes(keyfrms);
+    if (keyfrms.size() <= keyframe_delay_) {
+        return;
+    }
+    std::sort(keyfrms.begin(), keyfrms.end(),
+              [](const std::shared_ptr<stella_vslam::data::keyframe>& a, const std::shared_ptr<stella_vslam::data::keyframe>& b) {
+                  return a->id_ < b->id_;
+              });
+    keyfrms.resize(keyfrms.size() - keyframe_delay_);
+
+    std::vector<std::shared_ptr<stella_vslam::data::keyframe>> keyfrms_to_stream;
+    for (const auto& keyfrm : keyfrms) {
+        if (keyfrm->will_be_erased() || streamed_keyfrm_ids_.count(keyfrm->id_)) {
+            continue;
+        }
+        keyfrms_to_stream.push_back(keyfrm);
+        // (the rest is streamed next time)
+        if (keyfrms_to_stream.size() == max_num_keyframes_per_segment_) {
+            break;
+        }
+    }
+    if (keyfrms_to_stream.empty()) {
+        return;
+    }
+
+    const auto buffer = std::make_shared<const std::string>(remote_map_serializer::serialize_segment(robot_id_, keyfrms_to_stream));
+    client_->post("keyframe_segment", buffer, true);
+    for (const auto& keyfrm : keyfrms_to_stream) {
+        streamed_keyfrm_ids_.insert(keyfrm->id_);
+    }
+    spdlog::debug("map client: {} keyframes are streamed", keyfrms_to_stream.size());
+}
+
+void map_client::on_correction(const std::string& buffer) {
+    auto correction = remote_map_serializer::deserialize_correction(buffer);
+    // (the corrections of the other robots are broadcast as well)
+    if (correction.robot_id_ != robot_id_) {
+        return;
+    }
+    spdlog::info("map client: {} keyframes and {} landmarks are corrected by the map server",
+                 correction.keyfrm_poses_.size(), correction.lms_.size());
+
+    std::lock_guard<std::mutex> lock(mtx_correction_);
+    if (correction_callback_) {
+        correction_callback_(correction);
+    }
+    latest_correction_ = std::move(correction);
+    correction_is_received_ = true;
+}
+
+void map_client::set_correction_callback(std::function<void(const stella_vslam::module::remote_correction&)> callback) {
+    std::lock_guard<std::mutex> lock(mtx_correction_);
+    correction_callback_ = callback;
+}
+
+bool map_client::get_latest_correction(stella_vslam::module::remote_correction& correction) const {
+    std::lock_guard<std::mutex> lock(mtx_correction_);
+    if (!correction_is_received_) {
+        return false;
+    }
+    correction = latest_correction_;
+    return true;
+}
+
+void map_client::request_terminate() {
+    std::lock_guard<std::mutex> lock(mtx_terminate_);
+    terminate_is_requested_ = true;
+}
+
+bool map_client::is_terminated() {
+    std::lock_guard<std::mutex> lock(mtx_terminate_);
+    return is_terminated_;
+}
+
+} // namespace socket_publisher
@@ -0,0 +1,86 @@
+#ifndef SOCKET_PUBLISHER_MAP_CLIENT_H
+#define SOCKET_PUBLISHER_MAP_CLIENT_H
+
+#include "socket_publisher/socket_client.h"
+
+#include "stella_vslam/module/remote_map_integrator.h"
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_set>
+
+#include <yaml-cpp/yaml.h>
+
+namespace stella_vslam {
+namespace publish {
+class map_publisher;
+} // namespace publish
+} // namespace stella_vslam
+
+namespace socket_publisher {
+
+/**
+ * Client of the map server on a robot, which runs the tracking and the local mapping by itself
+ * The keyframes are streamed to the server once they leave the newest keyframe_delay keyframes,
+ * which are still refined by the local BA, together with the current positions of their landmarks.
+ * The corrections of the local map are pushed back by the server after the shared map is merged or optimized.
+ * (NOTE: the keyframes erased after they are streamed are kept in the shared map)
+ */
+class map_client {
+public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    /**
+     * Constructor
+     * @param yaml_node (the MapClient section)
+     * @param map_publisher
+     */
+    map_client(const YAML::Node& yaml_node,
+               const std::shared_ptr<stella_vslam::publish::map_publisher>& map_publisher);
+
+    void run();
+
+    //! Set the callback of the corrections of the local map (called on the socket.io thread)
+    void set_correction_callback(std::function<void(const stella_vslam::module::remote_correction&)> callback);
+
+    //! Get the correction received last (false if no correction has been received)
+    bool get_latest_correction(stella_vslam::module::remote_correction& correction) const;
+
+    /* thread controls */
+    void request_terminate();
+    bool is_terminated();
+
+private:
+    //! Serialize and post the keyframes which are not refined by the local BA any more
+    void stream_settled_keyframes();
+
+    void on_correction(const std::string& buffer);
+
+    const std::shared_ptr<stella_vslam::publish::map_publisher> map_publisher_;
+    const unsigned int robot_id_;
+    //! number of the newest keyframes which are not streamed yet
+    const unsigned int keyframe_delay_;
+    //! maximum number of the keyframes in a segment
+    const unsigned int max_num_keyframes_per_segment_;
+    //! interval of the streaming [ms]
+    const unsigned int streaming_interval_ms_;
+
+    std::unique_ptr<socket_client> client_;
+
+    //! IDs of the keyframes which have been streamed
+    std::unordered_set<unsigned int> streamed_keyfrm_ids_;
+
+    mutable std::mutex mtx_correction_;
+    std::function<void(const stella_vslam::module::remote_correction&)> correction_callback_;
+    bool correction_is_received_ = false;
+    stella_vslam::module::remote_correction latest_correction_;
+
+    std::mutex mtx_terminate_;
+    bool terminate_is_requested_ = false;
+    bool is_terminated_ = true;
+};
+
+} // namespace socket_publisher
+
+#endif // SOCKET_PUBLISHER_MAP_CLIENT_H
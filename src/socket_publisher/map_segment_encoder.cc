@@ -0,0 +1,303 @@
+#include "socket_publisher/map_segment_encoder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+#ifdef USE_ZSTD
+#include <zstd.h>
+#endif
+
+// map_segment.pb.h will be generated into build/src/socket_publisher/ when make
+#include "map_segment.pb.h"
+
+namespace socket_publisher {
+
+constexpr unsigned int map_segment_encoder::num_pose_values;
+constexpr double map_segment_encoder::rotation_scale;
+
+map_segment_encoder::map_segment_encoder(const bool compact_encoding, const double position_step, const double tile_size,
+                                         const int compression_level)
+    : compact_encoding_(compact_encoding), position_step_(position_step),
+      tile_size_(static_cast<int64_t>(std::llround(tile_size / position_step))), compression_level_(compression_level) {
+    if (position_step_ <= 0.0) {
+        throw std::runtime_error("position step of the compact encoding must be greater than 0");
+    }
+    if (tile_size_ <= 0) {
+        throw std::runtime_error("tile size of the compact encoding must be greater than the position step");
+    }
+#ifndef USE_ZSTD
+    if (compression_level_ != 0) {
+        spdlog::warn("the map segments are not compressed because socket_publisher is built without zstd");
+    }
+#endif
+}
+
+map_segment_encoder::map_segment_encoder(const YAML::Node& yaml_node)
+    : map_segment_encoder(yaml_node["compact_encoding"].as<bool>(false),
+                          yaml_node["position_step"].as<double>(0.001),
+                          yaml_node["tile_size"].as<double>(100.0),
+                          yaml_node["compression_level"].as<int>(0)) {}
+
+namespace {
+
+//! Write the IDs of the sorted entries as the differences from the previous ones
+template<typename T, typename Func>
+void add_sorted_ids(const std::vector<std::pair<unsigned int, T>>& entries, Func add_id) {
+    unsigned int prev_id = 0;
+    for (const auto& entry : entries) {
+        add_id(entry.first - prev_id);
+        prev_id = entry.first;
+    }
+}
+
+template<typename T>
+void sort_by_id(std::vector<std::pair<unsigned int, T>>& entries) {
+    std::sort(entries.begin(), entries.end(),
+              [](const std::pair<unsigned int, T>& a, const std::pair<unsigned int, T>& b) {
+                  return a.first < b.first;
+              });
+}
+
+} // namespace
+
+void map_segment_encoder::encode(map_segment::map& map, const stella_vslam::Mat44_t& current_camera_pose) {
+    auto& compact = *map.mutable_compact_segment();
+    const auto tile_origin = encode_common(map, compact, current_camera_pose);
+
+    // 1. keyframes
+    std::vector<std::pair<unsigned int, pose_values_t>> added_keyfrms;
+    std::vector<std::pair<unsigned int, pose_values_t>> updated_keyfrms;
+    std::vector<std::pair<unsigned int, bool>> removed_keyfrms;
+    for (const auto& keyfrm_obj : map.keyframes()) {
+        const auto id = keyfrm_obj.id();
+        const auto iter = sent_keyfrms_.find(id);
+        if (!keyfrm_obj.has_pose()) {
+            if (iter != sent_keyfrms_.end()) {
+                sent_keyfrms_.erase(iter);
+                removed_keyfrms.emplace_back(id, true);
+            }
+            continue;
+        }
+
+        stella_vslam::Mat44_t pose_cw;
+        for (int i = 0; i < 16; i++) {
+            pose_cw(i / 4, i % 4) = keyfrm_obj.pose().pose(i);
+        }
+        const auto values = quantize_pose(pose_cw);
+        if (iter == sent_keyfrms_.end()) {
+            auto relative_values = values;
+            for (unsigned int i = 0; i < 3; ++i) {
+                relative_values.at(4 + i) -= tile_origin.at(i);
+            }
+            added_keyfrms.emplace_back(id, relative_values);
+            sent_keyfrms_.emplace(id, values);
+            continue;
+        }
+        // skip the keyframes whose quantized poses are not changed
+        if (iter->second == values) {
+            continue;
+        }
+        pose_values_t diffs;
+        for (unsigned int i = 0; i < num_pose_values; ++i) {
+            diffs.at(i) = values.at(i) - iter->second.at(i);
+        }
+        updated_keyfrms.emplace_back(id, diffs);
+        iter->second = values;
+    }
+    map.clear_keyframes();
+
+    sort_by_id(added_keyfrms);
+    add_sorted_ids(added_keyfrms, [&compact](const unsigned int id) { compact.add_added_keyframe_ids(id); });
+    for (const auto& entry : added_keyfrms) {
+        for (const auto value : entry.second) {
+            compact.add_added_keyframe_poses(value);
+        }
+    }
+    sort_by_id(updated_keyfrms);
+    add_sorted_ids(updated_keyfrms, [&compact](const unsigned int id) { compact.add_updated_keyframe_ids(id); });
+    for (const auto& entry : updated_keyfrms) {
+        for (const auto value : entry.second) {
+            compact.add_updated_keyframe_poses(value);
+        }
+    }
+    sort_by_id(removed_keyfrms);
+    add_sorted_ids(removed_keyfrms, [&compact](const unsigned int id) { compact.add_removed_keyframe_ids(id); });
+
+    // 2. landmarks
+    std::vector<std::pair<unsigned int, position_values_t>> added_lms;
+    std::vector<std::pair<unsigned int, position_values_t>> updated_lms;
+    std::vector<std::pair<unsigned int, bool>> removed_lms;
+    for (const auto& landmark_obj : map.landmarks()) {
+        const auto id = landmark_obj.id();
+        const auto iter = sent_lms_.find(id);
+        if (landmark_obj.coords_size() != 3) {
+            if (iter != sent_lms_.end()) {
+                sent_lms_.erase(iter);
+                removed_lms.emplace_back(id, true);
+            }
+            continue;
+        }
+
+        const auto values = quantize_position(stella_vslam::Vec3_t{landmark_obj.coords(0), landmark_obj.coords(1), landmark_obj.coords(2)});
+        if (iter == sent_lms_.end()) {
+            position_values_t relative_values;
+            for (unsigned int i = 0; i < 3; ++i) {
+                relative_values.at(i) = values.at(i) - tile_origin.at(i);
+            }
+            added_lms.emplace_back(id, relative_values);
+            sent_lms_.emplace(id, values);
+            continue;
+        }
+        if (iter->second == values) {
+            continue;
+        }
+        position_values_t diffs;
+        for (unsigned int i = 0; i < 3; ++i) {
+            diffs.at(i) = values.at(i) - iter->second.at(i);
+        }
+        updated_lms.emplace_back(id, diffs);
+        iter->second = values;
+    }
+    map.clear_landmarks();
+
+    sort_by_id(added_lms);
+    add_sorted_ids(added_lms, [&compact](const unsigned int id) { compact.add_added_landmark_ids(id); });
+    for (const auto& entry : added_lms) {
+        for (const auto value : entry.second) {
+            compact.add_added_landmark_positions(value);
+        }
+    }
+    sort_by_id(updated_lms);
+    add_sorted_ids(updated_lms, [&compact](const unsigned int id) { compact.add_updated_landmark_ids(id); });
+    for (const auto& entry : updated_lms) {
+        for (const auto value : entry.second) {
+            compact.add_updated_landmark_positions(value);
+        }
+    }
+    sort_by_id(removed_lms);
+    add_sorted_ids(removed_lms, [&compact](const unsigned int id) { compact.add_removed_landmark_ids(id); });
+}
+
+void map_segment_encoder::encode_snapshot(map_segment::map& map, const stella_vslam::Mat44_t& current_camera_pose) {
+    auto& compact = *map.mutable_compact_segment();
+    const auto tile_origin = encode_common(map, compact, current_camera_pose);
+    map.clear_keyframes();
+    map.clear_landmarks();
+
+    // the viewer receives the same values as the other viewers, then the following differences are valid for it
+    std::vector<std::pair<unsigned int, pose_values_t>> keyfrms(sent_keyfrms_.begin(), sent_keyfrms_.end());
+    sort_by_id(keyfrms);
+    add_sorted_ids(keyfrms, [&compact](const unsigned int id) { compact.add_added_keyframe_ids(id); });
+    for (const auto& entry : keyfrms) {
+        for (unsigned int i = 0; i < num_pose_values; ++i) {
+            compact.add_added_keyframe_poses(entry.second.at(i) - (4 <= i ? tile_origin.at(i - 4) : 0));
+        }
+    }
+
+    std::vector<std::pair<unsigned int, position_values_t>> lms(sent_lms_.begin(), sent_lms_.end());
+    sort_by_id(lms);
+    add_sorted_ids(lms, [&compact](const unsigned int id) { compact.add_added_landmark_ids(id); });
+    for (const auto& entry : lms) {
+        for (unsigned int i = 0; i < 3; ++i) {
+            compact.add_added_landmark_positions(entry.second.at(i) - tile_origin.at(i));
+        }
+    }
+}
+
+void map_segment_encoder::reset() {
+    sent_keyfrms_.clear();
+    sent_lms_.clear();
+}
+
+bool map_segment_encoder::compress(const std::string& buffer, std::string& compressed) const {
+#ifdef USE_ZSTD
+    if (compression_level_ == 0) {
+        return false;
+    }
+    compressed.resize(ZSTD_compressBound(buffer.size()));
+    const auto size = ZSTD_compress(&compressed[0], compressed.size(), buffer.data(), buffer.size(), compression_level_);
+    if (ZSTD_isError(size)) {
+        spdlog::warn("cannot compress the map segment: {}", ZSTD_getErrorName(size));
+        return false;
+    }
+    compressed.resize(size);
+    return true;
+#else
+    (void)buffer;
+    (void)compressed;
+    return false;
+#endif
+}
+
+map_segment_encoder::pose_values_t map_segment_encoder::quantize_pose(const stella_vslam::Mat44_t& pose_cw) const {
+    const stella_vslam::Mat33_t rot_cw = pose_cw.block<3, 3>(0, 0);
+    const stella_vslam::Vec3_t trans_cw = pose_cw.block<3, 1>(0, 3);
+    const stella_vslam::Vec3_t cam_center = -rot_cw.transpose() * trans_cw;
+
+    // (the sign is fixed so that the consecutive quaternions are close)
+    Eigen::Quaterniond quat(rot_cw);
+    if (quat.w() < 0.0) {
+        quat.coeffs() *= -1.0;
+    }
+    const auto center_values = quantize_position(cam_center);
+    return pose_values_t{{std::llround(quat.w() * rotation_scale), std::llround(quat.x() * rotation_scale),
+                          std::llround(quat.y() * rotation_scale), std::llround(quat.z() * rotation_scale),
+                          center_values.at(0), center_values.at(1), center_values.at(2)}};
+}
+
+map_segment_encoder::position_values_t map_segment_encoder::quantize_position(const stella_vslam::Vec3_t& pos_w) const {
+    return position_values_t{{std::llround(pos_w(0) / position_step_), std::llround(pos_w(1) / position_step_),
+                              std::llround(pos_w(2) / position_step_)}};
+}
+
+map_segment_encoder::position_values_t map_segment_encoder::encode_common(map_segment::map& map, map_segment::map_compact& compact,
+                                                                          const stella_vslam::Mat44_t& current_camera_pose) const {
+    compact.set_position_step(position_step_);
+    compact.set_rotation_scale(rotation_scale);
+
+    // the tile which contains the current camera
+    const auto current_values = quantize_pose(current_camera_pose);
+    position_values_t tile_origin;
+    for (unsigned int i = 0; i < 3; ++i) {
+        const auto value = current_values.at(4 + i);
+        tile_origin.at(i) = (value < 0 ? -((-value + tile_size_ - 1) / tile_size_) : value / tile_size_) * tile_size_;
+        compact.add_tile_origin(tile_origin.at(i));
+    }
+    for (unsigned int i = 0; i < num_pose_values; ++i) {
+        compact.add_current_frame(current_values.at(i) - (4 <= i ? tile_origin.at(i - 4) : 0));
+    }
+
+    // graph (sorted by id0)
+    std::vector<std::pair<unsigned int, unsigned int>> edges;
+    edges.reserve(map.edges_size());
+    for (const auto& edge_obj : map.edges()) {
+        edges.emplace_back(edge_obj.id0(), edge_obj.id1());
+    }
+    std::sort(edges.begin(), edges.end());
+    int64_t prev_id0 = 0;
+    for (const auto& edge : edges) {
+        compact.add_edges(static_cast<int64_t>(edge.first) - prev_id0);
+        compact.add_edges(static_cast<int64_t>(edge.second) - static_cast<int64_t>(edge.first));
+        prev_id0 = edge.first;
+    }
+    map.clear_edges();
+
+    // local landmarks (the IDs are sent as the differences like the other lists)
+    std::vector<unsigned int> local_lm_ids(map.local_landmarks().begin(), map.local_landmarks().end());
+    std::sort(local_lm_ids.begin(), local_lm_ids.end());
+    unsigned int prev_id = 0;
+    for (const auto id : local_lm_ids) {
+        compact.add_local_landmark_ids(id - prev_id);
+        prev_id = id;
+    }
+    map.clear_local_landmarks();
+
+    return tile_origin;
+}
+
+} // namespace socket_publisher
@@ -0,0 +1,108 @@
+#ifndef SOCKET_PUBLISHER_MAP_SEGMENT_ENCODER_H
+#define SOCKET_PUBLISHER_MAP_SEGMENT_ENCODER_H
+
+#include "stella_vslam/type.h"
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+#include <yaml-cpp/yaml.h>
+
+namespace map_segment {
+class map;
+class map_compact;
+} // namespace map_segment
+
+namespace socket_publisher {
+
+/**
+ * Compact wire encoding of the map segments for the web viewer (see map_segment.map.compact)
+ * The poses and the positions are quantized, the new ones are sent relative to the tile around the current camera
+ * and the changed ones as the differences from the values which were sent last time, so most of them fit in a few bytes.
+ * The sent values are kept in the encoder, and the viewer keeps the same values to decode the differences.
+ * The whole segment can be compressed with zstd additionally (without USE_ZSTD, the compression is disabled).
+ */
+class map_segment_encoder {
+public:
+    //! Number of the values of a pose (qw, qx, qy, qz, x, y, z)
+    static constexpr unsigned int num_pose_values = 7;
+    //! Quantization scale of the quaternions
+    static constexpr double rotation_scale = 16384.0;
+
+    /**
+     * Constructor
+     * @param compact_encoding use the compact encoding or not
+     * @param position_step quantization step of the positions [m]
+     * @param tile_size edge length of the tiles [m]
+     * @param compression_level zstd compression level of the whole segment (0 disables the compression)
+     */
+    map_segment_encoder(const bool compact_encoding, const double position_step, const double tile_size,
+                        const int compression_level);
+
+    explicit map_segment_encoder(const YAML::Node& yaml_node);
+
+    //! the compact encoding is used or not
+    bool is_enabled() const { return compact_encoding_; }
+
+    /**
+     * Move the keyframes, the edges, the landmarks and the local landmarks of the map into the compact segment,
+     * and remember the sent values
+     * @param map
+     * @param current_camera_pose pose of the current camera (cw)
+     */
+    void encode(map_segment::map& map, const stella_vslam::Mat44_t& current_camera_pose);
+
+    /**
+     * Write all of the sent keyframes and landmarks as new ones, for the late joiners of the stream
+     * (NOTE: the keyframes and the landmarks of the map are discarded, and the sent values are not changed)
+     * @param map
+     * @param current_camera_pose pose of the current camera (cw)
+     */
+    void encode_snapshot(map_segment::map& map, const stella_vslam::Mat44_t& current_camera_pose);
+
+    //! Forget the sent values (e.g. after the viewer is reset)
+    void reset();
+
+    /**
+     * Compress the serialized segment with zstd
+     * @param buffer serialized segment
+     * @param compressed
+     * @return false if the compression is disabled or failed
+     */
+    bool compress(const std::string& buffer, std::string& compressed) const;
+
+private:
+    using pose_values_t = std::array<int64_t, num_pose_values>;
+    using position_values_t = std::array<int64_t, 3>;
+
+    //! Quantize the pose (cw) to the rotation and the camera center (wc)
+    pose_values_t quantize_pose(const stella_vslam::Mat44_t& pose_cw) const;
+
+    //! Quantize the position
+    position_values_t quantize_position(const stella_vslam::Vec3_t& pos_w) const;
+
+    //! Write the tile origin and the current camera, and move the graph and the local landmarks
+    //! (returns the tile origin)
+    position_values_t encode_common(map_segment::map& map, map_segment::map_compact& compact,
+                                    const stella_vslam::Mat44_t& current_camera_pose) const;
+
+    //! use the compact encoding or not
+    const bool compact_encoding_;
+    //! quantization step of the positions [m]
+    const double position_step_;
+    //! edge length of the tiles [position_step]
+    const int64_t tile_size_;
+    //! zstd compression level (0: disabled)
+    const int compression_level_;
+
+    //! values of the keyframes sent last time
+    std::unordered_map<unsigned int, pose_values_t> sent_keyfrms_;
+    //! values of the landmarks sent last time
+    std::unordered_map<unsigned int, position_values_t> sent_lms_;
+};
+
+} // namespace socket_publisher
+
+#endif // SOCKET_PUBLISHER_MAP_SEGMENT_ENCODER_H
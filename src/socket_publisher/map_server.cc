@@ -0,0 +1,108 @@
+#include "socket_publisher/map_server.h"
+#include "socket_publisher/remote_map_serializer.h"
+
+#include "stella_vslam/system.h"
+#include "stella_vslam/module/remote_map_integrator.h"
+
+#include <chrono>
+
+#include <spdlog/spdlog.h>
+
+namespace socket_publisher {
+
+map_server::map_server(const YAML::Node& yaml_node, const std::shared_ptr<stella_vslam::system>& system)
+    : system_(system),
+      merge_interval_ms_(yaml_node["merge_interval_ms"].as<unsigned int>(10000)),
+      min_num_new_keyfrms_to_merge_(yaml_node["min_num_new_keyframes_to_merge"].as<unsigned int>(1)),
+      client_(new socket_client(yaml_node["server_uri"].as<std::string>("http://127.0.0.1:3000"),
+                                yaml_node["max_num_in_flight"].as<unsigned int>(2),
+                                yaml_node["ack_timeout_ms"].as<unsigned int>(5000))) {
+    // the corrections of all the robots follow each merge
+    client_->add_channel("map_correction", yaml_node["max_queue_size"].as<unsigned int>(100), false);
+    client_->set_binary_callback("keyframe_segment", std::bind(&map_server::on_segment, this, std::placeholders::_1));
+}
+
+void map_server::run() {
+    {
+        std::lock_guard<std::mutex> lock(mtx_terminate_);
+        is_terminated_ = false;
+    }
+
+    unsigned int num_new_keyfrms = 0;
+    auto last_merge = std::chrono::steady_clock::now();
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mtx_segments_);
+            cv_segments_.wait_for(lock, std::chrono::milliseconds(100), [this] { return !queued_segments_.empty(); });
+        }
+        num_new_keyfrms += integrate_queued_segments();
+
+        const auto now = std::chrono::steady_clock::now();
+        if (min_num_new_keyfrms_to_merge_ <= num_new_keyfrms
+            && std::chrono::milliseconds(merge_interval_ms_) <= now - last_merge) {
+            merge_and_publish_corrections();
+            num_new_keyfrms = 0;
+            last_merge = std::chrono::steady_clock::now();
+        }
+
+        std::lock_guard<std::mutex> lock(mtx_terminate_);
+        if (terminate_is_requested_) {
+            is_terminated_ = true;
+            break;
+        }
+    }
+}
+
+void map_server::on_segment(const std::string& buffer) {
+    {
+        std::lock_guard<std::mutex> lock(mtx_segments_);
+        queued_segments_.push_back(buffer);
+    }
+    cv_segments_.notify_one();
+}
+
+unsigned int map_server::integrate_queued_segments() {
+    std::deque<std::string> segments;
+    {
+        std::lock_guard<std::mutex> lock(mtx_segments_);
+        segments.swap(queued_segments_);
+    }
+
+    unsigned int num_new_keyfrms = 0;
+    for (const auto& buffer : segments) {
+        try {
+            num_new_keyfrms += system_->integrate_remote_segment(remote_map_serializer::deserialize_segment(buffer));
+        }
+        catch (const std::runtime_error& e) {
+            spdlog::error("map server: {}", e.what());
+        }
+    }
+    return num_new_keyfrms;
+}
+
+void map_server::merge_and_publish_corrections() {
+    const auto num_merges = system_->merge_maps();
+    if (num_merges == 0) {
+        return;
+    }
+    spdlog::info("map server: {} maps are merged", num_merges);
+
+    for (const auto& correction : system_->compute_remote_corrections()) {
+        client_->post("map_correction", std::make_shared<const std::string>(remote_map_serializer::serialize_correction(correction)), true);
+    }
+}
+
+void map_server::request_terminate() {
+    {
+        std::lock_guard<std::mutex> lock(mtx_terminate_);
+        terminate_is_requested_ = true;
+    }
+    cv_segments_.notify_one();
+}
+
+bool map_server::is_terminated() {
+    std::lock_guard<std::mutex> lock(mtx_terminate_);
+    return is_terminated_;
+}
+
+} // namespace socket_publisher
@@ -0,0 +1,73 @@
+#ifndef SOCKET_PUBLISHER_MAP_SERVER_H
+#define SOCKET_PUBLISHER_MAP_SERVER_H
+
+#include "socket_publisher/socket_client.h"
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include <yaml-cpp/yaml.h>
+
+namespace stella_vslam {
+class system;
+} // namespace stella_vslam
+
+namespace socket_publisher {
+
+/**
+ * Map server which hosts the shared map of the robots (see map_client)
+ * The segments streamed from the robots are integrated into the map of the system,
+ * then the maps of the robots are merged via the inter-map loops and optimized by the global BA periodically.
+ * The corrections of the local maps are pushed back to the robots after each merge.
+ * The messages are relayed by the socket viewer server, to which both the robots and the map server connect.
+ * (NOTE: the system must be started up without the initialization and with the mapping module disabled, since no frame is fed)
+ */
+class map_server {
+public:
+    /**
+     * Constructor
+     * @param yaml_node (the MapServer section)
+     * @param system
+     */
+    map_server(const YAML::Node& yaml_node, const std::shared_ptr<stella_vslam::system>& system);
+
+    void run();
+
+    /* thread controls */
+    void request_terminate();
+    bool is_terminated();
+
+private:
+    //! Queue the segment received on the socket.io thread
+    void on_segment(const std::string& buffer);
+
+    //! Integrate the queued segments (return the number of the new keyframes)
+    unsigned int integrate_queued_segments();
+
+    //! Merge the maps of the robots and push back the corrections
+    void merge_and_publish_corrections();
+
+    const std::shared_ptr<stella_vslam::system> system_;
+    //! interval of the merges [ms]
+    const unsigned int merge_interval_ms_;
+    //! minimum number of the new keyframes to attempt a merge
+    const unsigned int min_num_new_keyfrms_to_merge_;
+
+    std::unique_ptr<socket_client> client_;
+
+    //! segments waiting for the integration
+    std::mutex mtx_segments_;
+    std::condition_variable cv_segments_;
+    std::deque<std::string> queued_segments_;
+
+    std::mutex mtx_terminate_;
+    bool terminate_is_requested_ = false;
+    bool is_terminated_ = true;
+};
+
+} // namespace socket_publisher
+
+#endif // SOCKET_PUBLISHER_MAP_SERVER_H
@@ -0,0 +1,165 @@
+#include "socket_publisher/point_cloud_lod.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+namespace socket_publisher {
+
+point_cloud_lod::point_cloud_lod(const std::vector<double>& voxel_sizes, const unsigned int max_num_points_per_message,
+                                 const bool view_culling)
+    : voxel_sizes_(voxel_sizes), max_num_points_per_message_(max_num_points_per_message), view_culling_(view_culling),
+      occupied_voxels_(voxel_sizes.size()) {
+    for (unsigned int level = 0; level < voxel_sizes_.size(); ++level) {
+        if (voxel_sizes_.at(level) <= 0.0) {
+            throw std::runtime_error("voxel sizes of the point cloud LOD must be greater than 0");
+        }
+        if (0 < level && voxel_sizes_.at(level - 1) < voxel_sizes_.at(level)) {
+            throw std::runtime_error("voxel sizes of the point cloud LOD must be ordered from coarse to fine");
+        }
+    }
+}
+
+point_cloud_lod::point_cloud_lod(const YAML::Node& yaml_node)
+    : point_cloud_lod(yaml_node["lod_voxel_sizes"].as<std::vector<double>>(std::vector<double>()),
+                      yaml_node["max_num_points_per_message"].as<unsigned int>(0),
+                      yaml_node["view_culling"].as<bool>(false)) {}
+
+bool point_cloud_lod::is_enabled() const {
+    std::lock_guard<std::mutex> lock(mtx_view_);
+    return !voxel_sizes_.empty() || 0 < max_num_points_per_message_ || view_is_set_;
+}
+
+void point_cloud_lod::set_view(const stella_vslam::Vec3_t& position, const stella_vslam::Vec3_t& direction, const double fov, const double far) {
+    std::lock_guard<std::mutex> lock(mtx_view_);
+    view_is_set_ = true;
+    view_position_ = position;
+    view_direction_ = direction.normalized();
+    // the full angle over 2pi disables the cone
+    view_cos_half_fov_ = (fov < 2.0 * M_PI) ? std::cos(0.5 * fov) : -1.0;
+    view_far_ = far;
+    view_is_changed_ = true;
+}
+
+bool point_cloud_lod::set_view_from_message(const std::string& message) {
+    std::istringstream iss(message);
+    std::string tag;
+    iss >> tag;
+    if (tag != "viewer_camera") {
+        return false;
+    }
+    stella_vslam::Vec3_t position, direction;
+    double fov_deg, far;
+    iss >> position(0) >> position(1) >> position(2) >> direction(0) >> direction(1) >> direction(2) >> fov_deg >> far;
+    if (!view_culling_ || iss.fail() || direction.norm() == 0.0 || far <= 0.0) {
+        // (NOTE: the ignored or malformed view is a view message nonetheless)
+        return true;
+    }
+    set_view(position, direction, fov_deg * M_PI / 180.0, far);
+    return true;
+}
+
+std::vector<unsigned int> point_cloud_lod::select(const std::vector<point>& candidates, const bool covers_all_unsent_points) {
+    bool view_is_set;
+    stella_vslam::Vec3_t view_position, view_direction;
+    double view_cos_half_fov, view_far;
+    {
+        std::lock_guard<std::mutex> lock(mtx_view_);
+        view_is_set = view_is_set_;
+        view_position = view_position_;
+        view_direction = view_direction_;
+        view_cos_half_fov = view_cos_half_fov_;
+        view_far = view_far_;
+        // the scan of all of the unsent landmarks reflects the new view
+        if (covers_all_unsent_points) {
+            view_is_changed_ = false;
+        }
+    }
+
+    // view frustum culling (approximated by the cone), nearer landmarks first
+    std::vector<std::pair<double, unsigned int>> visible_candidates;
+    visible_candidates.reserve(candidates.size());
+    for (unsigned int idx = 0; idx < candidates.size(); ++idx) {
+        if (!view_is_set) {
+            visible_candidates.emplace_back(0.0, idx);
+            continue;
+        }
+        const stella_vslam::Vec3_t rel = candidates.at(idx).pos_w_ - view_position;
+        const double dist = rel.norm();
+        if (view_far < dist) {
+            continue;
+        }
+        if (0.0 < dist && dist * view_cos_half_fov > rel.dot(view_direction)) {
+            continue;
+        }
+        visible_candidates.emplace_back(dist, idx);
+    }
+
+    const unsigned int budget = (0 < max_num_points_per_message_) ? max_num_points_per_message_ : std::numeric_limits<unsigned int>::max();
+    if (view_is_set && budget < visible_candidates.size()) {
+        std::sort(visible_candidates.begin(), visible_candidates.end());
+    }
+
+    std::vector<unsigned int> selected_indices;
+    selected_indices.reserve(std::min<size_t>(budget, visible_candidates.size()));
+    std::vector<bool> is_selected(visible_candidates.size(), false);
+
+    // the coarse levels first, then the remaining landmarks in the full resolution
+    for (unsigned int level = 0; level <= voxel_sizes_.size(); ++level) {
+        for (unsigned int i = 0; i < visible_candidates.size(); ++i) {
+            if (budget <= selected_indices.size()) {
+                break;
+            }
+            if (is_selected.at(i)) {
+                continue;
+            }
+            const auto& pos_w = candidates.at(visible_candidates.at(i).second).pos_w_;
+            if (level < voxel_sizes_.size()
+                && occupied_voxels_.at(level).count(to_voxel_key(pos_w, voxel_sizes_.at(level)))) {
+                continue;
+            }
+            is_selected.at(i) = true;
+            selected_indices.push_back(visible_candidates.at(i).second);
+            occupy(pos_w);
+        }
+    }
+
+    const bool all_visible_candidates_are_selected = selected_indices.size() == visible_candidates.size();
+    if (covers_all_unsent_points) {
+        refinement_is_pending_ = !all_visible_candidates_are_selected;
+    }
+    else if (!all_visible_candidates_are_selected) {
+        refinement_is_pending_ = true;
+    }
+    return selected_indices;
+}
+
+bool point_cloud_lod::refinement_is_pending() const {
+    std::lock_guard<std::mutex> lock(mtx_view_);
+    return refinement_is_pending_ || view_is_changed_;
+}
+
+void point_cloud_lod::reset() {
+    for (auto& voxels : occupied_voxels_) {
+        voxels.clear();
+    }
+}
+
+point_cloud_lod::voxel_key_t point_cloud_lod::to_voxel_key(const stella_vslam::Vec3_t& pos, const double voxel_size) {
+    // pack the 21-bit integer coordinates
+    constexpr std::int64_t mask = (std::int64_t(1) << 21) - 1;
+    const auto x = static_cast<std::int64_t>(std::floor(pos(0) / voxel_size)) & mask;
+    const auto y = static_cast<std::int64_t>(std::floor(pos(1) / voxel_size)) & mask;
+    const auto z = static_cast<std::int64_t>(std::floor(pos(2) / voxel_size)) & mask;
+    return (static_cast<voxel_key_t>(x) << 42) | (static_cast<voxel_key_t>(y) << 21) | static_cast<voxel_key_t>(z);
+}
+
+void point_cloud_lod::occupy(const stella_vslam::Vec3_t& pos) {
+    for (unsigned int level = 0; level < voxel_sizes_.size(); ++level) {
+        occupied_voxels_.at(level).insert(to_voxel_key(pos, voxel_sizes_.at(level)));
+    }
+}
+
+} // namespace socket_publisher
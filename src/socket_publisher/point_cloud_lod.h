@@ -0,0 +1,108 @@
+#ifndef SOCKET_PUBLISHER_POINT_CLOUD_LOD_H
+#define SOCKET_PUBLISHER_POINT_CLOUD_LOD_H
+
+#include "stella_vslam/type.h"
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <unordered_set>
+
+#include <yaml-cpp/yaml.h>
+
+namespace socket_publisher {
+
+/**
+ * Server-side level of detail of the landmarks streamed to the web viewer
+ * The landmarks which have not been sent yet are sent from the coarse voxel grids to the fine ones
+ * under the budget per message, and the ones outside the view of the web viewer are culled.
+ * The remaining landmarks are sent progressively in the following messages.
+ */
+class point_cloud_lod {
+public:
+    struct point {
+        unsigned int id_;
+        stella_vslam::Vec3_t pos_w_;
+    };
+
+    /**
+     * Constructor
+     * @param voxel_sizes edge lengths of the voxel grids of the levels (coarse to fine)
+     * @param max_num_points_per_message maximum number of the new landmarks sent in a message (0 means unlimited)
+     * @param view_culling cull the landmarks outside the view sent from the web viewer or not
+     */
+    point_cloud_lod(const std::vector<double>& voxel_sizes, const unsigned int max_num_points_per_message,
+                    const bool view_culling);
+
+    explicit point_cloud_lod(const YAML::Node& yaml_node);
+
+    //! the landmarks are selected or all of them are sent at once
+    bool is_enabled() const;
+
+    /**
+     * Set the view of the web viewer in the world coordinates
+     * @param position camera position
+     * @param direction unit vector of the viewing direction
+     * @param fov full angle of the view cone [rad]
+     * @param far far limit of the view
+     */
+    void set_view(const stella_vslam::Vec3_t& position, const stella_vslam::Vec3_t& direction, const double fov, const double far);
+
+    /**
+     * Set the view from the signal of the web viewer ("viewer_camera px py pz dx dy dz fov_deg far")
+     * @param message
+     * @return false if the message is not a view
+     * (NOTE: the view is ignored if the view culling is disabled)
+     */
+    bool set_view_from_message(const std::string& message);
+
+    /**
+     * Select the landmarks to send
+     * @param candidates landmarks which have not been sent yet
+     * @param covers_all_unsent_points the candidates are all of the unsent landmarks or not
+     * @return indices of the selected candidates
+     */
+    std::vector<unsigned int> select(const std::vector<point>& candidates, const bool covers_all_unsent_points);
+
+    //! some of the visible landmarks are waiting to be sent (then scan the whole map again)
+    bool refinement_is_pending() const;
+
+    //! Forget the occupied voxels (call this when the web viewer has no landmarks)
+    void reset();
+
+private:
+    using voxel_key_t = std::uint64_t;
+
+    //! Hash key of the voxel which contains the point
+    static voxel_key_t to_voxel_key(const stella_vslam::Vec3_t& pos, const double voxel_size);
+
+    //! Mark the voxels of the point in all of the levels
+    void occupy(const stella_vslam::Vec3_t& pos);
+
+    //! edge lengths of the voxel grids (coarse to fine)
+    const std::vector<double> voxel_sizes_;
+    //! maximum number of the new landmarks sent in a message
+    const unsigned int max_num_points_per_message_;
+    //! cull the landmarks outside the view or not
+    const bool view_culling_;
+
+    //! voxels which contain the sent landmarks in each level
+    std::vector<std::unordered_set<voxel_key_t>> occupied_voxels_;
+    //! some of the visible landmarks are waiting to be sent
+    bool refinement_is_pending_ = false;
+
+    //! mutex to access the view (set from the socket thread)
+    mutable std::mutex mtx_view_;
+    bool view_is_set_ = false;
+    stella_vslam::Vec3_t view_position_ = stella_vslam::Vec3_t::Zero();
+    stella_vslam::Vec3_t view_direction_ = stella_vslam::Vec3_t::UnitZ();
+    double view_cos_half_fov_ = -1.0;
+    double view_far_ = 0.0;
+    //! the view is changed after the last selection
+    bool view_is_changed_ = false;
+};
+
+} // namespace socket_publisher
+
+#endif // SOCKET_PUBLISHER_POINT_CLOUD_LOD_H
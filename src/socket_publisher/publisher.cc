@@ -1,9 +1,13 @@
 #include "socket_publisher/publisher.h"
+#include "socket_publisher/map_segment_encoder.h"
+#include "socket_publisher/point_cloud_lod.h"
 
 #include "stella_vslam/system.h"
 #include "stella_vslam/publish/frame_publisher.h"
 #include "stella_vslam/util/yaml.h"
 
+#include <algorithm>
+
 namespace socket_publisher {
 
 publisher::publisher(const YAML::Node& yaml_node,
@@ -12,11 +16,25 @@ publisher::publisher(const YAML::Node& yaml_node,
                      const std::shared_ptr<stella_vslam::publish::map_publisher>& map_publisher)
     : system_(system),
       emitting_interval_(yaml_node["emitting_interval"].as<unsigned int>(15000)),
+      max_emitting_interval_(yaml_node["max_emitting_interval"].as<unsigned int>(8 * emitting_interval_)),
       image_quality_(yaml_node["image_quality"].as<unsigned int>(20)),
-      client_(new socket_client(yaml_node["server_uri"].as<std::string>("http://127.0.0.1:3000"))) {
+      async_frame_encoding_(yaml_node["async_frame_encoding"].as<bool>(true)),
+      binary_frames_(yaml_node["binary_frames"].as<bool>(false)),
+      client_(new socket_client(yaml_node["server_uri"].as<std::string>("http://127.0.0.1:3000"),
+                                yaml_node["max_num_in_flight"].as<unsigned int>(2),
+                                yaml_node["ack_timeout_ms"].as<unsigned int>(5000))),
+      point_cloud_lod_(std::make_shared<point_cloud_lod>(yaml_node)),
+      map_segment_encoder_(std::make_shared<map_segment_encoder>(yaml_node)) {
     data_serializer_ = std::unique_ptr<data_serializer>(new data_serializer(
         frame_publisher, map_publisher,
-        yaml_node["publish_points"].as<bool>(true)));
+        yaml_node["publish_points"].as<bool>(true),
+        point_cloud_lod_, map_segment_encoder_));
+
+    // the map diffs are never dropped (the serialization waits for the channel instead),
+    // and only the latest frame is worth sending
+    client_->add_channel("map_publish", 1, false);
+    client_->add_channel("frame_publish", 1, true);
+    client_->add_channel("map_snapshot", 4, false);
 
     client_->set_signal_callback(std::bind(&publisher::callback, this, std::placeholders::_1));
 }
@@ -25,27 +43,45 @@ void publisher::run() {
     is_terminated_ = false;
     is_paused_ = false;
 
-    const auto serialized_reset_signal = data_serializer::serialized_reset_signal_;
-    client_->emit("map_publish", serialized_reset_signal);
+    std::thread frame_encoding_thread;
+    if (async_frame_encoding_) {
+        frame_encoding_thread = std::thread(&publisher::run_frame_encoding, this);
+    }
 
+    unsigned int emitting_interval = emitting_interval_;
     while (true) {
         const auto t0 = std::chrono::system_clock::now();
 
-        const auto serialized_map_data = data_serializer_->serialize_map_diff();
-        if (!serialized_map_data.empty()) {
-            client_->emit("map_publish", serialized_map_data);
+        // the viewer server might have lost the map while disconnected, then send the whole map again
+        if (client_->connection_is_opened()) {
+            data_serializer_->reset();
+            client_->post("map_publish", std::make_shared<const std::string>(data_serializer::serialized_reset_signal_));
+        }
+
+        // the changes are accumulated in the journal until the channel is writable
+        if (client_->is_writable("map_publish")) {
+            const auto serialized_map_data = data_serializer_->serialize_map_diff();
+            if (!serialized_map_data.empty()) {
+                client_->post("map_publish", std::make_shared<const std::string>(serialized_map_data));
+            }
+            // (NOTE: the snapshot follows the diff, then it contains everything sent to the others)
+            publish_map_snapshot();
+            emitting_interval = emitting_interval_;
+        }
+        else {
+            // back off while the channel is congested
+            emitting_interval = std::min(2 * emitting_interval, max_emitting_interval_);
         }
 
-        const auto serialized_frame_data = data_serializer_->serialize_latest_frame(image_quality_);
-        if (!serialized_frame_data.empty()) {
-            client_->emit("frame_publish", serialized_frame_data);
+        if (!async_frame_encoding_) {
+            publish_latest_frame();
         }
 
         // sleep until emitting interval time is past
         const auto t1 = std::chrono::system_clock::now();
         const auto elapse_us = std::chrono::duration_cast<std::chrono::microseconds>(t1 - t0).count();
-        if (elapse_us < emitting_interval_) {
-            const auto sleep_us = emitting_interval_ - elapse_us;
+        if (elapse_us < emitting_interval) {
+            const auto sleep_us = emitting_interval - elapse_us;
             std::this_thread::sleep_for(std::chrono::microseconds(sleep_us));
         }
 
@@ -60,10 +96,70 @@ void publisher::run() {
         }
     }
 
+    if (frame_encoding_thread.joinable()) {
+        frame_encoding_thread.join();
+    }
+
     system_->request_terminate();
     terminate();
 }
 
+void publisher::publish_latest_frame() {
+    // skip encoding the frame which cannot be sent now (the newer one is sent later)
+    if (!client_->is_writable("frame_publish")) {
+        return;
+    }
+
+    if (binary_frames_) {
+        std::vector<unsigned char> buf;
+        if (data_serializer_->encode_latest_frame(image_quality_, buf)) {
+            client_->post("frame_publish", std::make_shared<const std::string>(buf.begin(), buf.end()), true);
+        }
+        return;
+    }
+
+    const auto serialized_frame_data = data_serializer_->serialize_latest_frame(image_quality_);
+    if (!serialized_frame_data.empty()) {
+        client_->post("frame_publish", std::make_shared<const std::string>(serialized_frame_data));
+    }
+}
+
+void publisher::publish_map_snapshot() {
+    std::vector<std::string> socket_ids;
+    {
+        std::lock_guard<std::mutex> lock(mtx_snapshot_requests_);
+        socket_ids.swap(snapshot_requests_);
+    }
+    if (socket_ids.empty()) {
+        return;
+    }
+
+    // serialize once for all of the viewers, which are addressed by the server ("id0,id1,... snapshot")
+    std::string message;
+    for (const auto& socket_id : socket_ids) {
+        message += (message.empty() ? "" : ",") + socket_id;
+    }
+    message += " " + data_serializer_->serialize_snapshot();
+    client_->post("map_snapshot", std::make_shared<const std::string>(message));
+}
+
+void publisher::run_frame_encoding() {
+    // (NOTE: the frames are not encoded while the publisher is paused)
+    while (!terminate_is_requested()) {
+        const auto t0 = std::chrono::system_clock::now();
+
+        if (!is_paused()) {
+            publish_latest_frame();
+        }
+
+        const auto t1 = std::chrono::system_clock::now();
+        const auto elapse_us = std::chrono::duration_cast<std::chrono::microseconds>(t1 - t0).count();
+        if (elapse_us < emitting_interval_) {
+            std::this_thread::sleep_for(std::chrono::microseconds(emitting_interval_ - elapse_us));
+        }
+    }
+}
+
 void publisher::callback(const std::string& message) {
     if (message == "disable_mapping_mode") {
         system_->disable_mapping_module();
@@ -77,6 +173,14 @@ void publisher::callback(const std::string& message) {
     else if (message == "terminate") {
         request_terminate();
     }
+    else if (message.compare(0, 21, "request_map_snapshot ") == 0) {
+        // a viewer has joined the stream (the server appends the socket ID)
+        std::lock_guard<std::mutex> lock(mtx_snapshot_requests_);
+        snapshot_requests_.push_back(message.substr(21));
+    }
+    else if (point_cloud_lod_->set_view_from_message(message)) {
+        // the culling view of the landmarks is updated
+    }
 }
 
 void publisher::request_pause() {
@@ -6,6 +6,8 @@
 
 #include <mutex>
 #include <memory>
+#include <thread>
+#include <vector>
 
 namespace stella_vslam {
 
@@ -21,6 +23,9 @@ class map_publisher;
 
 namespace socket_publisher {
 
+class map_segment_encoder;
+class point_cloud_lod;
+
 class publisher {
 public:
     publisher(const YAML::Node& yaml_node,
@@ -40,19 +45,42 @@ public:
 private:
     const std::shared_ptr<stella_vslam::system> system_;
     const unsigned int emitting_interval_;
+    //! the emitting interval is extended up to this while the map channel is congested
+    const unsigned int max_emitting_interval_;
     const unsigned int image_quality_;
+    //! encode the frames on a dedicated thread so that the map publishing is not delayed
+    const bool async_frame_encoding_;
+    //! send the JPEG bytes as a binary attachment instead of a base64 string (the viewer server must accept it)
+    const bool binary_frames_;
 
     std::unique_ptr<socket_client> client_;
+    //! level of detail of the streamed landmarks (the view is sent from the web viewer)
+    std::shared_ptr<point_cloud_lod> point_cloud_lod_;
+    std::shared_ptr<map_segment_encoder> map_segment_encoder_;
     std::unique_ptr<data_serializer> data_serializer_;
 
     void callback(const std::string& message);
 
+    //! Encode and emit the latest frame if it is updated
+    void publish_latest_frame();
+
+    //! Main loop of the frame encoding thread
+    void run_frame_encoding();
+
     /* thread controls */
     bool pause_if_requested();
 
     bool terminate_is_requested();
     void terminate();
 
+    //! Send the snapshot of the map to the viewers which have requested it
+    void publish_map_snapshot();
+
+    //! mutex to access the viewers below (accessed from the socket thread)
+    std::mutex mtx_snapshot_requests_;
+    //! socket IDs of the viewers waiting for the snapshot
+    std::vector<std::string> snapshot_requests_;
+
     std::mutex mtx_terminate_;
     bool terminate_is_requested_ = false;
     bool is_terminated_ = true;
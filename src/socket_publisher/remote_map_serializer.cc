@@ -0,0 +1,180 @@
+#include "socket_publisher/remote_map_serializer.h"
+
+#include "stella_vslam/camera/base.h"
+#include "stella_vslam/data/common.h"
+#include "stella_vslam/data/keyframe.h"
+#include "stella_vslam/data/landmark.h"
+#include "stella_vslam/feature/orb_params.h"
+
+#include <stdexcept>
+#include <unordered_set>
+
+#include <nlohmann/json.hpp>
+
+// keyframe_segment.pb.h will be generated into build/src/socket_publisher/ when make
+#include "keyframe_segment.pb.h"
+
+namespace socket_publisher {
+
+namespace {
+
+template<typename T>
+void set_matrix(const stella_vslam::Mat44_t& mat, T* field) {
+    field->Reserve(16);
+    for (unsigned int i = 0; i < 16; ++i) {
+        field->Add(mat.data()[i]);
+    }
+}
+
+template<typename T>
+stella_vslam::Mat44_t get_matrix(const T& field) {
+    if (field.size() != 16) {
+        throw std::runtime_error("corrupted 4x4 matrix of the remote map message");
+    }
+    return Eigen::Map<const stella_vslam::Mat44_t>(field.data());
+}
+
+template<typename T>
+void set_vector(const stella_vslam::Vec3_t& vec, T* field) {
+    field->Reserve(3);
+    for (unsigned int i = 0; i < 3; ++i) {
+        field->Add(vec(i));
+    }
+}
+
+template<typename T>
+stella_vslam::Vec3_t get_vector(const T& field) {
+    if (field.size() != 3) {
+        throw std::runtime_error("corrupted 3D vector of the remote map message");
+    }
+    return stella_vslam::Vec3_t(field.Get(0), field.Get(1), field.Get(2));
+}
+
+} // namespace
+
+std::string remote_map_serializer::serialize_segment(const unsigned int robot_id,
+                                                     const std::vector<std::shared_ptr<stella_vslam::data::keyframe>>& keyfrms) {
+    const auto encoding = stella_vslam::data::observation_encoding_t::Compact;
+
+    keyframe_segment::segment segment;
+    segment.set_robot_id(robot_id);
+
+    std::unordered_set<std::shared_ptr<stella_vslam::data::landmark>> observed_lms;
+    for (const auto& keyfrm : keyfrms) {
+        auto keyfrm_msg = segment.add_keyframes();
+        keyfrm_msg->set_id(keyfrm->id_);
+        keyfrm_msg->set_timestamp(keyfrm->timestamp_);
+        set_matrix(keyfrm->get_pose_cw(), keyfrm_msg->mutable_pose_cw());
+        keyfrm_msg->set_camera(keyfrm->camera_->name_);
+        keyfrm_msg->set_orb_params(keyfrm->orb_params_->name_);
+        keyfrm_msg->set_undist_keypts(stella_vslam::data::convert_keypoints_to_json(keyfrm->frm_obs_->undist_keypts_, encoding).get<std::string>());
+        keyfrm_msg->set_x_rights(stella_vslam::data::convert_floats_to_json(keyfrm->frm_obs_->stereo_x_right_, encoding).get<std::string>());
+        keyfrm_msg->set_depths(stella_vslam::data::convert_floats_to_json(keyfrm->frm_obs_->depths_, encoding).get<std::string>());
+        keyfrm_msg->set_descriptors(stella_vslam::data::convert_descriptors_to_json(keyfrm->get_descriptors(), encoding).get<std::string>());
+
+        const auto lms = keyfrm->get_landmarks();
+        keyfrm_msg->mutable_landmark_ids()->Reserve(lms.size());
+        for (const auto& lm : lms) {
+            if (!lm || lm->will_be_erased()) {
+                keyfrm_msg->add_landmark_ids(-1);
+                continue;
+            }
+            keyfrm_msg->add_landmark_ids(static_cast<int>(lm->id_));
+            observed_lms.insert(lm);
+        }
+    }
+
+    for (const auto& lm : observed_lms) {
+        auto lm_msg = segment.add_landmarks();
+        lm_msg->set_id(lm->id_);
+        const auto ref_keyfrm = lm->get_ref_keyframe();
+        lm_msg->set_ref_keyfrm_id(ref_keyfrm ? ref_keyfrm->id_ : lm->first_keyfrm_id_);
+        set_vector(lm->get_pos_in_world(), lm_msg->mutable_pos_w());
+    }
+
+    std::string buffer;
+    segment.SerializeToString(&buffer);
+    return buffer;
+}
+
+stella_vslam::module::remote_segment remote_map_serializer::deserialize_segment(const std::string& buffer) {
+    keyframe_segment::segment segment_msg;
+    if (!segment_msg.ParseFromString(buffer)) {
+        throw std::runtime_error("cannot parse the keyframe segment");
+    }
+
+    stella_vslam::module::remote_segment segment;
+    segment.robot_id_ = segment_msg.robot_id();
+    segment.keyfrms_.resize(segment_msg.keyframes_size());
+    for (int i = 0; i < segment_msg.keyframes_size(); ++i) {
+        const auto& keyfrm_msg = segment_msg.keyframes(i);
+        auto& keyfrm = segment.keyfrms_.at(i);
+        keyfrm.id_ = keyfrm_msg.id();
+        keyfrm.timestamp_ = keyfrm_msg.timestamp();
+        keyfrm.pose_cw_ = get_matrix(keyfrm_msg.pose_cw());
+        keyfrm.camera_name_ = keyfrm_msg.camera();
+        keyfrm.orb_params_name_ = keyfrm_msg.orb_params();
+        keyfrm.undist_keypts_ = stella_vslam::data::convert_json_to_keypoints(nlohmann::json(keyfrm_msg.undist_keypts()));
+        keyfrm.stereo_x_right_ = stella_vslam::data::convert_json_to_floats(nlohmann::json(keyfrm_msg.x_rights()));
+        keyfrm.depths_ = stella_vslam::data::convert_json_to_floats(nlohmann::json(keyfrm_msg.depths()));
+        keyfrm.descriptors_ = stella_vslam::data::convert_json_to_descriptors(nlohmann::json(keyfrm_msg.descriptors()));
+        keyfrm.landmark_ids_.assign(keyfrm_msg.landmark_ids().begin(), keyfrm_msg.landmark_ids().end());
+    }
+
+    segment.lms_.resize(segment_msg.landmarks_size());
+    for (int i = 0; i < segment_msg.landmarks_size(); ++i) {
+        const auto& lm_msg = segment_msg.landmarks(i);
+        auto& lm = segment.lms_.at(i);
+        lm.id_ = lm_msg.id();
+        lm.ref_keyfrm_id_ = lm_msg.ref_keyfrm_id();
+        lm.pos_w_ = get_vector(lm_msg.pos_w());
+    }
+    return segment;
+}
+
+std::string remote_map_serializer::serialize_correction(const stella_vslam::module::remote_correction& correction) {
+    keyframe_segment::correction correction_msg;
+    correction_msg.set_robot_id(correction.robot_id_);
+    set_matrix(correction.global_from_local_, correction_msg.mutable_global_from_local());
+    for (const auto& keyfrm_pose : correction.keyfrm_poses_) {
+        auto keyfrm_msg = correction_msg.add_keyframes();
+        keyfrm_msg->set_id(keyfrm_pose.id_);
+        set_matrix(keyfrm_pose.pose_cw_, keyfrm_msg->mutable_pose_cw());
+    }
+    for (const auto& lm : correction.lms_) {
+        auto lm_msg = correction_msg.add_landmarks();
+        lm_msg->set_id(lm.id_);
+        lm_msg->set_ref_keyfrm_id(lm.ref_keyfrm_id_);
+        set_vector(lm.pos_w_, lm_msg->mutable_pos_w());
+    }
+
+    std::string buffer;
+    correction_msg.SerializeToString(&buffer);
+    return buffer;
+}
+
+stella_vslam::module::remote_correction remote_map_serializer::deserialize_correction(const std::string& buffer) {
+    keyframe_segment::correction correction_msg;
+    if (!correction_msg.ParseFromString(buffer)) {
+        throw std::runtime_error("cannot parse the map correction");
+    }
+
+    stella_vslam::module::remote_correction correction;
+    correction.robot_id_ = correction_msg.robot_id();
+    correction.global_from_local_ = get_matrix(correction_msg.global_from_local());
+    correction.keyfrm_poses_.resize(correction_msg.keyframes_size());
+    for (int i = 0; i < correction_msg.keyframes_size(); ++i) {
+        correction.keyfrm_poses_.at(i).id_ = correction_msg.keyframes(i).id();
+        correction.keyfrm_poses_.at(i).pose_cw_ = get_matrix(correction_msg.keyframes(i).pose_cw());
+    }
+    correction.lms_.resize(correction_msg.landmarks_size());
+    for (int i = 0; i < correction_msg.landmarks_size(); ++i) {
+        const auto& lm_msg = correction_msg.landmarks(i);
+        correction.lms_.at(i).id_ = lm_msg.id();
+        correction.lms_.at(i).ref_keyfrm_id_ = lm_msg.ref_keyfrm_id();
+        correction.lms_.at(i).pos_w_ = get_vector(lm_msg.pos_w());
+    }
+    return correction;
+}
+
+} // namespace socket_publisher
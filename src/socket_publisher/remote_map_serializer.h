@@ -0,0 +1,39 @@
+#ifndef SOCKET_PUBLISHER_REMOTE_MAP_SERIALIZER_H
+#define SOCKET_PUBLISHER_REMOTE_MAP_SERIALIZER_H
+
+#include "stella_vslam/type.h"
+#include "stella_vslam/module/remote_map_integrator.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace stella_vslam {
+namespace data {
+class keyframe;
+} // namespace data
+} // namespace stella_vslam
+
+namespace socket_publisher {
+
+/**
+ * Serializer of the messages between the robots and the map server (see keyframe_segment.proto)
+ * The observations of the keyframes are packed with the compact encoding of the MessagePack map.
+ * (NOTE: the deserializers throw std::runtime_error if the message is corrupted)
+ */
+class remote_map_serializer {
+public:
+    //! Serialize the keyframes of the local map and the landmarks observed by them
+    static std::string serialize_segment(const unsigned int robot_id,
+                                         const std::vector<std::shared_ptr<stella_vslam::data::keyframe>>& keyfrms);
+
+    static stella_vslam::module::remote_segment deserialize_segment(const std::string& buffer);
+
+    static std::string serialize_correction(const stella_vslam::module::remote_correction& correction);
+
+    static stella_vslam::module::remote_correction deserialize_correction(const std::string& buffer);
+};
+
+} // namespace socket_publisher
+
+#endif // SOCKET_PUBLISHER_REMOTE_MAP_SERIALIZER_H
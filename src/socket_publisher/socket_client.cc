@@ -1,11 +1,15 @@
 #include "socket_publisher/socket_client.h"
 
+#include <algorithm>
+#include <stdexcept>
+
 #include <spdlog/spdlog.h>
 
 namespace socket_publisher {
 
-socket_client::socket_client(const std::string& server_uri)
-    : client_(), callback_() {
+socket_client::socket_client(const std::string& server_uri, const unsigned int max_num_in_flight,
+                             const unsigned int ack_timeout_ms)
+    : max_num_in_flight_(max_num_in_flight), ack_timeout_(ack_timeout_ms), client_(), callback_() {
     // register socket callbacks
     client_.set_open_listener(std::bind(&socket_client::on_open, this));
     client_.set_close_listener(std::bind(&socket_client::on_close, this));
@@ -19,16 +23,137 @@ socket_client::socket_client(const std::string& server_uri)
     socket_->on("signal", std::bind(&socket_client::on_receive, this, std::placeholders::_1));
 }
 
+void socket_client::add_channel(const std::string& tag, const unsigned int max_queue_size, const bool latest_value_wins) {
+    std::lock_guard<std::mutex> lock(mtx_channels_);
+    channel ch;
+    ch.max_queue_size_ = std::max(max_queue_size, 1u);
+    ch.latest_value_wins_ = latest_value_wins;
+    channels_[tag] = ch;
+}
+
+bool socket_client::post(const std::string& tag, const std::shared_ptr<const std::string>& buffer, const bool is_binary) {
+    std::lock_guard<std::mutex> lock(mtx_channels_);
+    const auto iter = channels_.find(tag);
+    if (iter == channels_.end()) {
+        throw std::runtime_error("socket channel is not registered: " + tag);
+    }
+    auto& ch = iter->second;
+
+    bool is_dropped = false;
+    if (ch.max_queue_size_ <= ch.queue_.size()) {
+        // the latest value wins, otherwise the oldest message is dropped
+        if (ch.latest_value_wins_) {
+            ch.queue_.pop_back();
+        }
+        else {
+            ch.queue_.pop_front();
+        }
+        is_dropped = true;
+        if (ch.num_dropped_++ % 100 == 0) {
+            spdlog::warn("socket channel \"{}\" is congested, {} messages have been dropped", tag, ch.num_dropped_);
+        }
+    }
+    ch.queue_.push_back(message{buffer, is_binary});
+
+    flush(tag, ch);
+    return !is_dropped;
+}
+
+bool socket_client::is_writable(const std::string& tag) {
+    std::lock_guard<std::mutex> lock(mtx_channels_);
+    const auto iter = channels_.find(tag);
+    if (iter == channels_.end()) {
+        return true;
+    }
+    auto& ch = iter->second;
+    expire_in_flight(ch);
+    flush(tag, ch);
+    return is_connected_ && ch.queue_.empty()
+           && (max_num_in_flight_ == 0 || ch.num_in_flight_ < max_num_in_flight_);
+}
+
+bool socket_client::connection_is_opened() {
+    std::lock_guard<std::mutex> lock(mtx_channels_);
+    const bool connection_is_opened = connection_is_opened_;
+    connection_is_opened_ = false;
+    return connection_is_opened;
+}
+
+void socket_client::flush(const std::string& tag, channel& ch) {
+    // (NOTE: socket.io keeps the messages emitted while disconnected without any limit)
+    if (!is_connected_) {
+        return;
+    }
+    while (!ch.queue_.empty() && (max_num_in_flight_ == 0 || ch.num_in_flight_ < max_num_in_flight_)) {
+        const auto msg = ch.queue_.front();
+        ch.queue_.pop_front();
+
+        const auto msg_list = msg.is_binary_ ? sio::message::list(msg.buffer_) : sio::message::list(*msg.buffer_);
+        if (max_num_in_flight_ == 0) {
+            socket_->emit(tag, msg_list);
+            continue;
+        }
+        ++ch.num_in_flight_;
+        ch.last_sent_ = std::chrono::steady_clock::now();
+        socket_->emit(tag, msg_list, std::bind(&socket_client::on_ack, this, tag));
+    }
+}
+
+void socket_client::expire_in_flight(channel& ch) {
+    if (ch.num_in_flight_ == 0 || std::chrono::steady_clock::now() - ch.last_sent_ < ack_timeout_) {
+        return;
+    }
+    spdlog::warn("no acknowledgement from the server for {} ms (set max_num_in_flight to 0 if the server does not acknowledge the messages)",
+                 ack_timeout_.count());
+    ch.num_in_flight_ = 0;
+}
+
+void socket_client::on_ack(const std::string& tag) {
+    std::lock_guard<std::mutex> lock(mtx_channels_);
+    const auto iter = channels_.find(tag);
+    if (iter == channels_.end()) {
+        return;
+    }
+    auto& ch = iter->second;
+    if (0 < ch.num_in_flight_) {
+        --ch.num_in_flight_;
+    }
+    flush(tag, ch);
+}
+
 void socket_client::on_close() {
     spdlog::info("connection closed correctly");
+    std::lock_guard<std::mutex> lock(mtx_channels_);
+    is_connected_ = false;
+    // the acknowledgements never arrive after the connection is closed
+    for (auto& tag_channel : channels_) {
+        tag_channel.second.num_in_flight_ = 0;
+    }
 }
 
 void socket_client::on_fail() {
     spdlog::info("connection closed incorrectly");
+    std::lock_guard<std::mutex> lock(mtx_channels_);
+    is_connected_ = false;
+    for (auto& tag_channel : channels_) {
+        tag_channel.second.num_in_flight_ = 0;
+    }
 }
 
 void socket_client::on_open() {
     spdlog::info("connected to server");
+    std::lock_guard<std::mutex> lock(mtx_channels_);
+    is_connected_ = true;
+    connection_is_opened_ = true;
+    for (auto& tag_channel : channels_) {
+        flush(tag_channel.first, tag_channel.second);
+    }
+}
+
+void socket_client::set_binary_callback(const std::string& tag, std::function<void(const std::string&)> callback) {
+    socket_->on(tag, [this, callback](const sio::event& event) {
+        on_receive_binary(callback, event);
+    });
 }
 
 void socket_client::on_receive(const sio::event& event) {
@@ -43,4 +168,18 @@ void socket_client::on_receive(const sio::event& event) {
     }
 }
 
+void socket_client::on_receive_binary(const std::function<void(const std::string&)>& callback, const sio::event& event) {
+    try {
+        const auto& message = event.get_message();
+        if (message->get_flag() != sio::message::flag_binary) {
+            spdlog::warn("socket event \"{}\" is not a binary message", event.get_name());
+            return;
+        }
+        callback(*message->get_binary());
+    }
+    catch (std::exception& ex) {
+        spdlog::error(ex.what());
+    }
+}
+
 } // namespace socket_publisher
@@ -3,6 +3,13 @@
 
 #include "stella_vslam/config.h"
 
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+
 #include <sioclient/sio_client.h>
 
 namespace stella_vslam {
@@ -13,21 +20,100 @@ namespace socket_publisher {
 
 class socket_client {
 public:
-    socket_client(const std::string& server_uri);
+    /**
+     * Constructor
+     * @param server_uri
+     * @param max_num_in_flight maximum number of the unacknowledged messages of each channel (0 disables the acknowledgements)
+     * @param ack_timeout_ms the unacknowledged messages are regarded as lost after this time
+     */
+    socket_client(const std::string& server_uri, const unsigned int max_num_in_flight = 0,
+                  const unsigned int ack_timeout_ms = 5000);
 
     void emit(const std::string tag, const std::string buffer) {
         socket_->emit(tag, buffer);
     }
 
+    //! Emit the buffer as a binary attachment (without base64)
+    void emit_binary(const std::string tag, const std::shared_ptr<const std::string>& buffer) {
+        socket_->emit(tag, sio::message::list(buffer));
+    }
+
+    /**
+     * Register a channel whose messages are queued with the bounded size
+     * (NOTE: the messages are not handed to socket.io while the connection is closed,
+     *  nor while the server has not acknowledged the previous ones)
+     * @param tag
+     * @param max_queue_size maximum number of the queued messages
+     * @param latest_value_wins the queued message is replaced with the new one (for the frames and the poses)
+     */
+    void add_channel(const std::string& tag, const unsigned int max_queue_size, const bool latest_value_wins);
+
+    /**
+     * Queue the message of the channel and send it as soon as the channel is not congested
+     * @param tag
+     * @param buffer
+     * @param is_binary send the buffer as a binary attachment or a string
+     * @return false if a queued message is dropped or replaced
+     */
+    bool post(const std::string& tag, const std::shared_ptr<const std::string>& buffer, const bool is_binary = false);
+
+    //! the channel can send a new message immediately (check this before serializing the message)
+    bool is_writable(const std::string& tag);
+
+    //! Get and clear the flag which indicates the connection has been opened since the last call
+    bool connection_is_opened();
+
     void set_signal_callback(std::function<void(std::string)> callback) {
         callback_ = callback;
     }
 
+    /**
+     * Register the callback of the binary messages of the event, which is called on the socket.io thread
+     * (NOTE: register the callbacks before the messages arrive, since they are not guarded)
+     */
+    void set_binary_callback(const std::string& tag, std::function<void(const std::string&)> callback);
+
 private:
+    struct message {
+        std::shared_ptr<const std::string> buffer_;
+        bool is_binary_;
+    };
+
+    struct channel {
+        unsigned int max_queue_size_;
+        bool latest_value_wins_;
+        std::deque<message> queue_;
+        //! number of the unacknowledged messages
+        unsigned int num_in_flight_ = 0;
+        //! time when the last message was sent
+        std::chrono::steady_clock::time_point last_sent_;
+        //! number of the dropped messages (for the log)
+        uint64_t num_dropped_ = 0;
+    };
+
+    //! Send the queued messages as many as the channel allows (mtx_channels_ must be locked)
+    void flush(const std::string& tag, channel& ch);
+
+    //! Regard the unacknowledged messages as lost if the server does not respond (mtx_channels_ must be locked)
+    void expire_in_flight(channel& ch);
+
+    void on_ack(const std::string& tag);
+
     void on_close();
     void on_fail();
     void on_open();
     void on_receive(const sio::event& event);
+    void on_receive_binary(const std::function<void(const std::string&)>& callback, const sio::event& event);
+
+    const unsigned int max_num_in_flight_;
+    const std::chrono::milliseconds ack_timeout_;
+
+    //! mutex to access the channels (accessed from the socket.io thread as well)
+    // (NOTE: declared before the client so that the callbacks never access the destroyed channels)
+    std::mutex mtx_channels_;
+    std::map<std::string, channel> channels_;
+    bool is_connected_ = false;
+    bool connection_is_opened_ = false;
 
     sio::client client_;
     sio::socket::ptr socket_;
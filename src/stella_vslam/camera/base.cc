@@ -1,4 +1,5 @@
 #include "stella_vslam/camera/base.h"
+#include "stella_vslam/camera/undistortion_map.h"
 
 #include <iostream>
 #include <opencv2/core/mat.hpp>
@@ -123,6 +124,12 @@ std::ostream& operator<<(std::ostream& os, const base& params) {
     return os;
 }
 
+void base::build_undistortion_map(const unsigned int grid_size) {
+    // the iterative undistortion is used while building the map
+    undist_map_.reset();
+    undist_map_ = std::unique_ptr<undistortion_map>(new undistortion_map(*this, grid_size));
+}
+
 cv::KeyPoint base::undistort_keypoint(const cv::KeyPoint& dist_keypt) const {
     cv::KeyPoint undist_keypt;
     undist_keypt.pt = undistort_point(dist_keypt.pt);
@@ -168,5 +175,44 @@ void base::convert_bearings_to_points(const eigen_alloc_vector<Vec3_t>& bearings
                    [this](const Vec3_t& bearing) { return convert_bearing_to_point(bearing); });
 }
 
+void base::reproject_points_to_image(const Mat33_t& rot_cw, const Vec3_t& trans_cw, const MatX3_t& pos_ws,
+                                     MatX2_t& reprojs, VecX_t& x_rights, VecXb_t& is_visible) const {
+    const auto num_points = pos_ws.rows();
+    reprojs.resize(num_points, 2);
+    x_rights.resize(num_points);
+    is_visible.resize(num_points);
+    Vec2_t reproj;
+    float x_right;
+    for (Eigen::Index i = 0; i < num_points; ++i) {
+        is_visible(i) = reproject_to_image(rot_cw, trans_cw, pos_ws.row(i).transpose(), reproj, x_right);
+        reprojs.row(i) = reproj.transpose();
+        x_rights(i) = x_right;
+    }
+}
+
+#ifdef USE_SINGLE_PRECISION_TRACKING
+void base::reproject_points_to_image(const TrkMat33_t& rot_cw, const TrkVec3_t& trans_cw, const TrkMatX3_t& pos_ws,
+                                     TrkMatX2_t& reprojs, TrkVecX_t& x_rights, VecXb_t& is_visible) const {
+    MatX2_t reprojs_d;
+    VecX_t x_rights_d;
+    reproject_points_to_image(rot_cw.cast<double>(), trans_cw.cast<double>(), pos_ws.cast<double>(),
+                              reprojs_d, x_rights_d, is_visible);
+    reprojs = reprojs_d.cast<tracking_real_t>();
+    x_rights = x_rights_d.cast<tracking_real_t>();
+}
+#endif
+
+void base::reproject_points_to_bearing(const Mat33_t& rot_cw, const Vec3_t& trans_cw, const MatX3_t& pos_ws,
+                                       MatX3_t& bearings, VecXb_t& is_visible) const {
+    const auto num_points = pos_ws.rows();
+    bearings.resize(num_points, 3);
+    is_visible.resize(num_points);
+    Vec3_t bearing;
+    for (Eigen::Index i = 0; i < num_points; ++i) {
+        is_visible(i) = reproject_to_bearing(rot_cw, trans_cw, pos_ws.row(i).transpose(), bearing);
+        bearings.row(i) = bearing.transpose();
+    }
+}
+
 } // namespace camera
 } // namespace stella_vslam
@@ -5,6 +5,7 @@
 
 #include <string>
 #include <limits>
+#include <memory>
 
 #include <opencv2/core/types.hpp>
 #include <yaml-cpp/yaml.h>
@@ -13,6 +14,8 @@
 namespace stella_vslam {
 namespace camera {
 
+class undistortion_map;
+
 enum class setup_type_t {
     Monocular = 0,
     Stereo = 1,
@@ -136,6 +139,13 @@ public:
     //! cell height of grid pattern
     double inv_cell_height_ = std::numeric_limits<double>::quiet_NaN();
 
+    //! Build the undistortion map used instead of the iterative undistortion by the models which need it
+    //! (call it after the camera parameters are set, and before the camera is shared among threads)
+    void build_undistortion_map(const unsigned int grid_size);
+
+    //! Get the undistortion map (nullptr if it is not built)
+    const undistortion_map* get_undistortion_map() const { return undist_map_.get(); }
+
     //-------------------------
     // To be implemented in derived classes
 
@@ -185,6 +195,27 @@ public:
 
     //! Convert bearing vectors to undistorted points
     virtual void convert_bearings_to_points(const eigen_alloc_vector<Vec3_t>& bearings, std::vector<cv::Point2f>& undist_pts) const;
+
+    //! Reproject the 3D points (one point per row) to image using camera pose and projection model
+    //! (is_visible(i) is set to true if the i-th point was reprojected to inside of image)
+    virtual void reproject_points_to_image(const Mat33_t& rot_cw, const Vec3_t& trans_cw, const MatX3_t& pos_ws,
+                                           MatX2_t& reprojs, VecX_t& x_rights, VecXb_t& is_visible) const;
+
+    //! Reproject the 3D points (one point per row) to bearing vectors using camera pose
+    //! (is_visible(i) is set to true if the i-th point was reprojected to inside of image)
+    virtual void reproject_points_to_bearing(const Mat33_t& rot_cw, const Vec3_t& trans_cw, const MatX3_t& pos_ws,
+                                             MatX3_t& bearings, VecXb_t& is_visible) const;
+
+#ifdef USE_SINGLE_PRECISION_TRACKING
+    //! Reproject the 3D points (one point per row) to image in the precision of the tracking
+    //! (the default implementation converts them to double and calls the above one)
+    virtual void reproject_points_to_image(const TrkMat33_t& rot_cw, const TrkVec3_t& trans_cw, const TrkMatX3_t& pos_ws,
+                                           TrkMatX2_t& reprojs, TrkVecX_t& x_rights, VecXb_t& is_visible) const;
+#endif
+
+protected:
+    //! undistortion map (nullptr if it is not built)
+    std::unique_ptr<undistortion_map> undist_map_;
 };
 
 std::ostream& operator<<(std::ostream& os, const base& params);
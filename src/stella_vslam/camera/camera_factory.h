@@ -38,6 +38,12 @@ public:
                     break;
                 }
             }
+
+            // use the precomputed undistortion instead of the iterative one if requested
+            const auto undist_map_grid_size = node["undistortion_map_grid_size"].as<unsigned int>(0);
+            if (0 < undist_map_grid_size) {
+                camera->build_undistortion_map(undist_map_grid_size);
+            }
         }
         catch (const std::exception& e) {
             spdlog::debug("failed in loading camera model parameters: {}", e.what());
@@ -1,4 +1,8 @@
 #include "stella_vslam/camera/equirectangular.h"
+#include "stella_vslam/util/trigonometric.h"
+
+#include <cassert>
+#include <cmath>
 
 #include <spdlog/spdlog.h>
 #include <nlohmann/json.hpp>
@@ -15,6 +19,22 @@ equirectangular::equirectangular(const std::string& name, const color_order_t& c
 
     inv_cell_width_ = static_cast<double>(num_grid_cols_) / (img_bounds_.max_x_ - img_bounds_.min_x_);
     inv_cell_height_ = static_cast<double>(num_grid_rows_) / (img_bounds_.max_y_ - img_bounds_.min_y_);
+
+    // tabulate the trigonometric functions of the longitudes and latitudes at the integer pixel coordinates
+    sin_lons_.resize(cols_ + 1);
+    cos_lons_.resize(cols_ + 1);
+    for (unsigned int col = 0; col <= cols_; ++col) {
+        const double lon = (static_cast<double>(col) / cols_ - 0.5) * (2.0 * M_PI);
+        sin_lons_.at(col) = std::sin(lon);
+        cos_lons_.at(col) = std::cos(lon);
+    }
+    sin_lats_.resize(rows_ + 1);
+    cos_lats_.resize(rows_ + 1);
+    for (unsigned int row = 0; row <= rows_; ++row) {
+        const double lat = -(static_cast<double>(row) / rows_ - 0.5) * M_PI;
+        sin_lats_.at(row) = std::sin(lat);
+        cos_lats_.at(row) = std::cos(lat);
+    }
 }
 
 equirectangular::equirectangular(const YAML::Node& yaml_node)
@@ -42,19 +62,45 @@ cv::Point2f equirectangular::undistort_point(const cv::Point2f& dist_pt) const {
     return dist_pt;
 }
 
+namespace {
+//! Get sin and cos of the angle at the coordinate from the tables of the integer coordinates
+//! via the angle addition formulas with the sub-pixel offset (delta: angle per pixel)
+inline void lookup_sin_cos(const std::vector<double>& sins, const std::vector<double>& coss, const double coord, const double delta,
+                           double& sin_val, double& cos_val) {
+    const auto idx = static_cast<long>(std::floor(coord));
+    if (idx < 0 || static_cast<long>(sins.size()) <= idx) {
+        // outside of the image
+        const double angle = (coord - (sins.size() - 1) * 0.5) * delta;
+        sin_val = std::sin(angle);
+        cos_val = std::cos(angle);
+        return;
+    }
+    // the offset is less than one pixel, so the Taylor series converge quickly
+    const double d = (coord - idx) * delta;
+    const double d2 = d * d;
+    const double sin_d = d * (1.0 - d2 / 6.0 * (1.0 - d2 / 20.0));
+    const double cos_d = 1.0 - d2 / 2.0 * (1.0 - d2 / 12.0 * (1.0 - d2 / 30.0));
+    sin_val = sins[idx] * cos_d + coss[idx] * sin_d;
+    cos_val = coss[idx] * cos_d - sins[idx] * sin_d;
+}
+} // namespace
+
 Vec3_t equirectangular::convert_point_to_bearing(const cv::Point2f& undist_pt) const {
     // "From Google Street View to 3D City Models (ICCVW 2009)"
     // convert to unit polar coordinates
-    const double lon = (undist_pt.x / cols_ - 0.5) * (2.0 * M_PI);
-    const double lat = -(undist_pt.y / rows_ - 0.5) * M_PI;
+    // (lon = (x / cols - 0.5) * 2pi, lat = -(y / rows - 0.5) * pi, which are looked up from the tables)
+    double sin_lon, cos_lon, sin_lat, cos_lat;
+    lookup_sin_cos(sin_lons_, cos_lons_, undist_pt.x, 2.0 * M_PI / cols_, sin_lon, cos_lon);
+    lookup_sin_cos(sin_lats_, cos_lats_, undist_pt.y, -M_PI / rows_, sin_lat, cos_lat);
     // convert to equirectangular coordinates
-    return Vec3_t{std::cos(lat) * std::sin(lon), -std::sin(lat), std::cos(lat) * std::cos(lon)};
+    return Vec3_t{cos_lat * sin_lon, -sin_lat, cos_lat * cos_lon};
 }
 
 cv::Point2f equirectangular::convert_bearing_to_point(const Vec3_t& bearing) const {
     // convert to unit polar coordinates
-    const double lat = -std::asin(bearing[1]);
-    const double lon = std::atan2(bearing[0], bearing[2]);
+    // (asin(y) = atan2(y, sqrt(x^2 + z^2)) for the unit vector)
+    const double lat = -util::atan2(bearing[1], std::sqrt(bearing[0] * bearing[0] + bearing[2] * bearing[2]));
+    const double lon = util::atan2(bearing[0], bearing[2]);
     // convert to pixel image coordinated
     return cv::Point2f(cols_ * (0.5 + lon / (2.0 * M_PI)), rows_ * (0.5 - lat / M_PI));
 }
@@ -64,8 +110,8 @@ bool equirectangular::reproject_to_image(const Mat33_t& rot_cw, const Vec3_t& tr
     const Vec3_t bearing = (rot_cw * pos_w + trans_cw).normalized();
 
     // convert to unit polar coordinates
-    const auto latitude = -std::asin(bearing(1));
-    const auto longitude = std::atan2(bearing(0), bearing(2));
+    const auto latitude = -util::atan2(bearing(1), std::sqrt(bearing(0) * bearing(0) + bearing(2) * bearing(2)));
+    const auto longitude = util::atan2(bearing(0), bearing(2));
 
     // convert to pixel image coordinated
     reproj(0) = cols_ * (0.5 + longitude / (2.0 * M_PI));
@@ -82,6 +128,32 @@ bool equirectangular::reproject_to_bearing(const Mat33_t& rot_cw, const Vec3_t&
     return true;
 }
 
+void equirectangular::reproject_points_to_image(const Mat33_t& rot_cw, const Vec3_t& trans_cw, const MatX3_t& pos_ws,
+                                                MatX2_t& reprojs, VecX_t& x_rights, VecXb_t& is_visible) const {
+    MatX3_t bearings;
+    reproject_points_to_bearing(rot_cw, trans_cw, pos_ws, bearings, is_visible);
+
+    // convert to unit polar coordinates
+    const Eigen::ArrayXd latitudes = -util::atan2(bearings.col(1).array(), (bearings.col(0).array().square() + bearings.col(2).array().square()).sqrt());
+    const Eigen::ArrayXd longitudes = util::atan2(bearings.col(0).array(), bearings.col(2).array());
+
+    // convert to pixel image coordinated
+    reprojs.resize(pos_ws.rows(), 2);
+    reprojs.col(0) = (cols_ * (0.5 + longitudes / (2.0 * M_PI))).matrix();
+    reprojs.col(1) = (rows_ * (0.5 - latitudes / M_PI)).matrix();
+    x_rights.setZero(pos_ws.rows());
+}
+
+void equirectangular::reproject_points_to_bearing(const Mat33_t& rot_cw, const Vec3_t& trans_cw, const MatX3_t& pos_ws,
+                                                  MatX3_t& bearings, VecXb_t& is_visible) const {
+    // convert to camera-coordinates (each column is processed as a contiguous array)
+    bearings = (pos_ws * rot_cw.transpose()).rowwise() + trans_cw.transpose();
+    const Eigen::ArrayXd norm_invs = bearings.rowwise().norm().array().inverse();
+    bearings.array().colwise() *= norm_invs;
+
+    is_visible.setConstant(pos_ws.rows(), true);
+}
+
 nlohmann::json equirectangular::to_json() const {
     return {{"model_type", get_model_type_string()},
             {"setup_type", get_setup_type_string()},
@@ -118,5 +190,28 @@ void equirectangular::undistort_keypoints(const std::vector<cv::KeyPoint>& dist_
     undist_keypts = dist_keypts;
 }
 
+void equirectangular::convert_points_to_bearings(const std::vector<cv::Point2f>& undist_pts, eigen_alloc_vector<Vec3_t>& bearings) const {
+    assert(bearings.size() == 0);
+    bearings.reserve(undist_pts.size());
+    for (const auto& undist_pt : undist_pts) {
+        bearings.push_back(equirectangular::convert_point_to_bearing(undist_pt));
+    }
+}
+
+void equirectangular::convert_keypoints_to_bearings(const std::vector<cv::KeyPoint>& undist_keypts, eigen_alloc_vector<Vec3_t>& bearings) const {
+    assert(bearings.size() == 0);
+    bearings.reserve(undist_keypts.size());
+    for (const auto& undist_keypt : undist_keypts) {
+        bearings.push_back(equirectangular::convert_point_to_bearing(undist_keypt.pt));
+    }
+}
+
+void equirectangular::convert_bearings_to_points(const eigen_alloc_vector<Vec3_t>& bearings, std::vector<cv::Point2f>& undist_pts) const {
+    undist_pts.reserve(undist_pts.size() + bearings.size());
+    for (const auto& bearing : bearings) {
+        undist_pts.push_back(equirectangular::convert_bearing_to_point(bearing));
+    }
+}
+
 } // namespace camera
 } // namespace stella_vslam
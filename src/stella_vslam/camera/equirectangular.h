@@ -34,6 +34,25 @@ public:
     //! Override for optimization
     void undistort_points(const std::vector<cv::Point2f>& dist_pts, std::vector<cv::Point2f>& undist_pts) const override final;
     void undistort_keypoints(const std::vector<cv::KeyPoint>& dist_keypts, std::vector<cv::KeyPoint>& undist_keypts) const override final;
+
+    void convert_points_to_bearings(const std::vector<cv::Point2f>& undist_pts, eigen_alloc_vector<Vec3_t>& bearings) const override final;
+    void convert_keypoints_to_bearings(const std::vector<cv::KeyPoint>& undist_keypts, eigen_alloc_vector<Vec3_t>& bearings) const override final;
+    void convert_bearings_to_points(const eigen_alloc_vector<Vec3_t>& bearings, std::vector<cv::Point2f>& undist_pts) const override final;
+
+    //! Override for vectorization
+    using base::reproject_points_to_image;
+    void reproject_points_to_image(const Mat33_t& rot_cw, const Vec3_t& trans_cw, const MatX3_t& pos_ws,
+                                   MatX2_t& reprojs, VecX_t& x_rights, VecXb_t& is_visible) const override final;
+    void reproject_points_to_bearing(const Mat33_t& rot_cw, const Vec3_t& trans_cw, const MatX3_t& pos_ws,
+                                     MatX3_t& bearings, VecXb_t& is_visible) const override final;
+
+private:
+    //! sin and cos of the longitudes at the pixel columns (cols_ + 1 elements)
+    std::vector<double> sin_lons_;
+    std::vector<double> cos_lons_;
+    //! sin and cos of the latitudes at the pixel rows (rows_ + 1 elements)
+    std::vector<double> sin_lats_;
+    std::vector<double> cos_lats_;
 };
 
 std::ostream& operator<<(std::ostream& os, const equirectangular& params);
@@ -135,6 +135,40 @@ bool radial_division::reproject_to_image(const Mat33_t& rot_cw, const Vec3_t& tr
     return true;
 }
 
+template<typename T>
+void radial_division::reproject_points_to_image_impl(const Eigen::Matrix<T, 3, 3>& rot_cw, const Eigen::Matrix<T, 3, 1>& trans_cw,
+                                                     const Eigen::Matrix<T, Eigen::Dynamic, 3>& pos_ws,
+                                                     Eigen::Matrix<T, Eigen::Dynamic, 2>& reprojs, Eigen::Matrix<T, Eigen::Dynamic, 1>& x_rights,
+                                                     VecXb_t& is_visible) const {
+    // convert to camera-coordinates (each column is processed as a contiguous array)
+    const Eigen::Matrix<T, Eigen::Dynamic, 3> pos_cs = (pos_ws * rot_cw.transpose()).rowwise() + trans_cw.transpose();
+
+    // reproject onto the image
+    // (the points behind the camera are rejected below regardless of the reprojections)
+    const Eigen::Array<T, Eigen::Dynamic, 1> z_invs = pos_cs.col(2).array().inverse();
+    reprojs.resize(pos_ws.rows(), 2);
+    reprojs.col(0) = (static_cast<T>(fx_) * pos_cs.col(0).array() * z_invs + static_cast<T>(cx_)).matrix();
+    reprojs.col(1) = (static_cast<T>(fy_) * pos_cs.col(1).array() * z_invs + static_cast<T>(cy_)).matrix();
+    x_rights = (reprojs.col(0).array() - static_cast<T>(focal_x_baseline_) * z_invs).matrix();
+
+    // check if the points are visible
+    is_visible = (T(0) < pos_cs.col(2).array())
+                 && (static_cast<T>(img_bounds_.min_x_) <= reprojs.col(0).array()) && (reprojs.col(0).array() <= static_cast<T>(img_bounds_.max_x_))
+                 && (static_cast<T>(img_bounds_.min_y_) <= reprojs.col(1).array()) && (reprojs.col(1).array() <= static_cast<T>(img_bounds_.max_y_));
+}
+
+void radial_division::reproject_points_to_image(const Mat33_t& rot_cw, const Vec3_t& trans_cw, const MatX3_t& pos_ws,
+                                                MatX2_t& reprojs, VecX_t& x_rights, VecXb_t& is_visible) const {
+    reproject_points_to_image_impl(rot_cw, trans_cw, pos_ws, reprojs, x_rights, is_visible);
+}
+
+#ifdef USE_SINGLE_PRECISION_TRACKING
+void radial_division::reproject_points_to_image(const TrkMat33_t& rot_cw, const TrkVec3_t& trans_cw, const TrkMatX3_t& pos_ws,
+                                                TrkMatX2_t& reprojs, TrkVecX_t& x_rights, VecXb_t& is_visible) const {
+    reproject_points_to_image_impl(rot_cw, trans_cw, pos_ws, reprojs, x_rights, is_visible);
+}
+#endif
+
 bool radial_division::reproject_to_bearing(const Mat33_t& rot_cw, const Vec3_t& trans_cw, const Vec3_t& pos_w, Vec3_t& reproj) const {
     reproj = rot_cw * pos_w + trans_cw;
 
@@ -158,6 +192,29 @@ bool radial_division::reproject_to_bearing(const Mat33_t& rot_cw, const Vec3_t&
     return true;
 }
 
+void radial_division::reproject_points_to_bearing(const Mat33_t& rot_cw, const Vec3_t& trans_cw, const MatX3_t& pos_ws,
+                                                 MatX3_t& bearings, VecXb_t& is_visible) const {
+    // convert to camera-coordinates (each column is processed as a contiguous array)
+    const MatX3_t pos_cs = (pos_ws * rot_cw.transpose()).rowwise() + trans_cw.transpose();
+
+    // reproject onto the image
+    const Eigen::ArrayXd z_invs = pos_cs.col(2).array().inverse();
+    const Eigen::ArrayXd xs = fx_ * pos_cs.col(0).array() * z_invs + cx_;
+    const Eigen::ArrayXd ys = fy_ * pos_cs.col(1).array() * z_invs + cy_;
+
+    // convert to bearings
+    const Eigen::ArrayXd norm_invs = pos_cs.rowwise().norm().array().inverse();
+    bearings.resize(pos_ws.rows(), 3);
+    for (unsigned int k = 0; k < 3; ++k) {
+        bearings.col(k) = (pos_cs.col(k).array() * norm_invs).matrix();
+    }
+
+    // check if the points are visible
+    is_visible = (0.0 < pos_cs.col(2).array())
+                 && (img_bounds_.min_x_ <= xs) && (xs <= img_bounds_.max_x_)
+                 && (img_bounds_.min_y_ <= ys) && (ys <= img_bounds_.max_y_);
+}
+
 nlohmann::json radial_division::to_json() const {
     return {
         {"model_type", get_model_type_string()},
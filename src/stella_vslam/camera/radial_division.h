@@ -41,8 +41,27 @@ public:
 
     bool reproject_to_bearing(const Mat33_t& rot_cw, const Vec3_t& trans_cw, const Vec3_t& pos_w, Vec3_t& reproj) const override final;
 
+    //! Override for vectorization
+    void reproject_points_to_image(const Mat33_t& rot_cw, const Vec3_t& trans_cw, const MatX3_t& pos_ws,
+                                   MatX2_t& reprojs, VecX_t& x_rights, VecXb_t& is_visible) const override final;
+    void reproject_points_to_bearing(const Mat33_t& rot_cw, const Vec3_t& trans_cw, const MatX3_t& pos_ws,
+                                     MatX3_t& bearings, VecXb_t& is_visible) const override final;
+#ifdef USE_SINGLE_PRECISION_TRACKING
+    void reproject_points_to_image(const TrkMat33_t& rot_cw, const TrkVec3_t& trans_cw, const TrkMatX3_t& pos_ws,
+                                   TrkMatX2_t& reprojs, TrkVecX_t& x_rights, VecXb_t& is_visible) const override final;
+#endif
+
     nlohmann::json to_json() const override final;
 
+private:
+    //! Vectorized reprojection in the precision of T
+    template<typename T>
+    void reproject_points_to_image_impl(const Eigen::Matrix<T, 3, 3>& rot_cw, const Eigen::Matrix<T, 3, 1>& trans_cw,
+                                        const Eigen::Matrix<T, Eigen::Dynamic, 3>& pos_ws,
+                                        Eigen::Matrix<T, Eigen::Dynamic, 2>& reprojs, Eigen::Matrix<T, Eigen::Dynamic, 1>& x_rights,
+                                        VecXb_t& is_visible) const;
+
+public:
     //-------------------------
     // Parameters specific to this model
 
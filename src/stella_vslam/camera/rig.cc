@@ -0,0 +1,46 @@
+#include "stella_vslam/camera/camera_factory.h"
+#include "stella_vslam/camera/rig.h"
+
+#include <stdexcept>
+
+#include <spdlog/spdlog.h>
+
+namespace stella_vslam {
+namespace camera {
+
+rig::rig(const YAML::Node& yaml_node) {
+    spdlog::debug("CONSTRUCT: camera::rig");
+    for (const auto& camera_node : yaml_node["cameras"]) {
+        const auto extrinsics = camera_node["extrinsics"].as<std::vector<double>>();
+        if (extrinsics.size() != 16) {
+            throw std::runtime_error("the extrinsics of the rig camera must have 16 values");
+        }
+        Mat44_t pose_cb;
+        for (unsigned int i = 0; i < 16; ++i) {
+            pose_cb(i / 4, i % 4) = extrinsics.at(i);
+        }
+
+        auto camera = camera_factory::create(camera_node);
+        if (camera->setup_type_ != setup_type_t::Monocular || camera->model_type_ == model_type_t::Equirectangular) {
+            const auto name = camera->name_;
+            delete camera;
+            for (auto added_camera : cameras_) {
+                delete added_camera;
+            }
+            throw std::runtime_error("the rig camera must be a monocular camera of a perspective-like model: " + name);
+        }
+        poses_cb_.push_back(pose_cb);
+        cameras_.push_back(camera);
+        spdlog::info("add the rig camera \"{}\"", camera->name_);
+    }
+}
+
+rig::~rig() {
+    for (auto camera : cameras_) {
+        delete camera;
+    }
+    spdlog::debug("DESTRUCT: camera::rig");
+}
+
+} // namespace camera
+} // namespace stella_vslam
@@ -0,0 +1,48 @@
+#ifndef STELLA_VSLAM_CAMERA_RIG_H
+#define STELLA_VSLAM_CAMERA_RIG_H
+
+#include "stella_vslam/type.h"
+
+#include <vector>
+
+#include <yaml-cpp/yaml.h>
+
+namespace stella_vslam {
+namespace camera {
+
+class base;
+
+/**
+ * Auxiliary cameras of a multi-camera rig, which are rigidly mounted with the primary camera (the "Camera" section)
+ * Each entry of the "Rig.cameras" list has the parameters of a monocular camera and the extrinsics,
+ * which is the 4x4 transformation from the primary camera to the auxiliary camera (16 values in row-major order).
+ * (NOTE: the auxiliary cameras are used for the tracking, and the equirectangular model is not supported)
+ */
+class rig {
+public:
+    /**
+     * Constructor
+     * @param yaml_node (the "Rig" section)
+     */
+    explicit rig(const YAML::Node& yaml_node);
+
+    /**
+     * Destructor
+     */
+    ~rig();
+
+    //! Get the number of the auxiliary cameras
+    unsigned int get_num_cameras() const {
+        return cameras_.size();
+    }
+
+    //! auxiliary cameras
+    std::vector<base*> cameras_;
+    //! poses of the auxiliary cameras: primary camera -> auxiliary camera
+    eigen_alloc_vector<Mat44_t> poses_cb_;
+};
+
+} // namespace camera
+} // namespace stella_vslam
+
+#endif // STELLA_VSLAM_CAMERA_RIG_H
@@ -0,0 +1,71 @@
+#include "stella_vslam/camera/base.h"
+#include "stella_vslam/camera/undistortion_map.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include <spdlog/spdlog.h>
+
+namespace stella_vslam {
+namespace camera {
+
+undistortion_map::undistortion_map(const base& camera, const unsigned int grid_size)
+    : grid_size_(grid_size), inv_grid_size_(1.0f / grid_size) {
+    if (grid_size == 0) {
+        throw std::runtime_error("Invalid grid size of the undistortion map: 0");
+    }
+
+    // the grid covers the whole image including the right and bottom edges
+    num_grid_cols_ = (camera.cols_ + grid_size - 1) / grid_size + 1;
+    num_grid_rows_ = (camera.rows_ + grid_size - 1) / grid_size + 1;
+
+    std::vector<cv::Point2f> dist_grid_pts;
+    dist_grid_pts.reserve(num_grid_cols_ * num_grid_rows_);
+    for (unsigned int row = 0; row < num_grid_rows_; ++row) {
+        for (unsigned int col = 0; col < num_grid_cols_; ++col) {
+            dist_grid_pts.emplace_back(col * grid_size, row * grid_size);
+        }
+    }
+    camera.undistort_points(dist_grid_pts, undist_grid_pts_);
+
+    spdlog::debug("camera::undistortion_map: {}x{} grid points", num_grid_cols_, num_grid_rows_);
+}
+
+cv::Point2f undistortion_map::undistort_point(const cv::Point2f& dist_pt) const {
+    // find the cell which contains the point
+    // (the points outside of the image are extrapolated from the nearest cell)
+    const float grid_x = dist_pt.x * inv_grid_size_;
+    const float grid_y = dist_pt.y * inv_grid_size_;
+    const int col = std::min(std::max(static_cast<int>(std::floor(grid_x)), 0), static_cast<int>(num_grid_cols_) - 2);
+    const int row = std::min(std::max(static_cast<int>(std::floor(grid_y)), 0), static_cast<int>(num_grid_rows_) - 2);
+    const float tx = grid_x - col;
+    const float ty = grid_y - row;
+
+    // bilinear interpolation
+    const auto& pt_00 = undist_grid_pts_[row * num_grid_cols_ + col];
+    const auto& pt_01 = undist_grid_pts_[row * num_grid_cols_ + col + 1];
+    const auto& pt_10 = undist_grid_pts_[(row + 1) * num_grid_cols_ + col];
+    const auto& pt_11 = undist_grid_pts_[(row + 1) * num_grid_cols_ + col + 1];
+    return (1.0f - ty) * ((1.0f - tx) * pt_00 + tx * pt_01) + ty * ((1.0f - tx) * pt_10 + tx * pt_11);
+}
+
+void undistortion_map::undistort_points(const std::vector<cv::Point2f>& dist_pts, std::vector<cv::Point2f>& undist_pts) const {
+    undist_pts.resize(dist_pts.size());
+    for (unsigned long idx = 0; idx < dist_pts.size(); ++idx) {
+        undist_pts.at(idx) = undistort_point(dist_pts.at(idx));
+    }
+}
+
+void undistortion_map::undistort_keypoints(const std::vector<cv::KeyPoint>& dist_keypts, std::vector<cv::KeyPoint>& undist_keypts) const {
+    undist_keypts.resize(dist_keypts.size());
+    for (unsigned long idx = 0; idx < dist_keypts.size(); ++idx) {
+        undist_keypts.at(idx).pt = undistort_point(dist_keypts.at(idx).pt);
+        undist_keypts.at(idx).angle = dist_keypts.at(idx).angle;
+        undist_keypts.at(idx).size = dist_keypts.at(idx).size;
+        undist_keypts.at(idx).octave = dist_keypts.at(idx).octave;
+    }
+}
+
+} // namespace camera
+} // namespace stella_vslam
@@ -0,0 +1,55 @@
+#ifndef STELLA_VSLAM_CAMERA_UNDISTORTION_MAP_H
+#define STELLA_VSLAM_CAMERA_UNDISTORTION_MAP_H
+
+#include <vector>
+
+#include <opencv2/core/types.hpp>
+
+namespace stella_vslam {
+namespace camera {
+
+class base;
+
+/**
+ * Grid of the undistorted coordinates sampled over the distorted image
+ * The points are undistorted by the bilinear interpolation of the four surrounding grid points
+ * instead of the iterative undistortion of the camera model.
+ */
+class undistortion_map {
+public:
+    /**
+     * Constructor
+     * @param camera camera model used to undistort the grid points
+     * @param grid_size interval of the grid points in pixels
+     */
+    undistortion_map(const base& camera, const unsigned int grid_size);
+
+    //! Get the interval of the grid points in pixels
+    unsigned int get_grid_size() const { return grid_size_; }
+
+    //! Undistort the point
+    cv::Point2f undistort_point(const cv::Point2f& dist_pt) const;
+
+    //! Undistort the points
+    void undistort_points(const std::vector<cv::Point2f>& dist_pts, std::vector<cv::Point2f>& undist_pts) const;
+
+    //! Undistort the keypoints
+    void undistort_keypoints(const std::vector<cv::KeyPoint>& dist_keypts, std::vector<cv::KeyPoint>& undist_keypts) const;
+
+private:
+    //! interval of the grid points in pixels
+    const unsigned int grid_size_;
+    //! inverse of the interval
+    const float inv_grid_size_;
+    //! number of the grid points along x axis
+    unsigned int num_grid_cols_;
+    //! number of the grid points along y axis
+    unsigned int num_grid_rows_;
+    //! undistorted coordinates of the grid points (row-major)
+    std::vector<cv::Point2f> undist_grid_pts_;
+};
+
+} // namespace camera
+} // namespace stella_vslam
+
+#endif // STELLA_VSLAM_CAMERA_UNDISTORTION_MAP_H
@@ -2,6 +2,11 @@
 #include "stella_vslam/data/keyframe.h"
 #include "stella_vslam/data/bow_database.h"
 #include "stella_vslam/data/bow_vocabulary.h"
+#include "stella_vslam/data/memory_usage.h"
+#include "stella_vslam/util/async_reclaimer.h"
+
+#include <algorithm>
+#include <unordered_set>
 
 #include <spdlog/spdlog.h>
 
@@ -19,40 +24,166 @@ bow_database::~bow_database() {
 }
 
 void bow_database::add_keyframe(const std::shared_ptr<keyframe>& keyfrm) {
-    std::lock_guard<std::mutex> lock(mtx_);
+    std::lock_guard<util::profiled_mutex> lock(mtx_);
+
+    const auto id = keyfrm->id_;
+    if (keyfrms_.size() <= id) {
+        keyfrms_.resize(id + 1, nullptr);
+    }
+    if (keyfrms_.at(id)) {
+        // Already registered
+        return;
+    }
+    if (0 < num_tombstones_) {
+        // Remove the tombstones first because they might have the same ID
+        compact();
+    }
+    keyfrms_.at(id) = keyfrm;
 
-    // Append keyframe to the corresponding index in keyframes_in_node_ list
+    // Append keyframe ID to the corresponding posting lists
     for (const auto& node_id_and_weight : keyfrm->bow_vec_) {
-        keyfrms_in_node_[node_id_and_weight.first].push_back(keyfrm);
+        keyfrm_ids_in_node_[node_id_and_weight.first].push_back(id);
     }
+    num_entries_ += keyfrm->bow_vec_.size();
+    global_desc_index_.add(id, global_descriptor_index::compute_descriptor(keyfrm->bow_vec_));
 }
 
-void bow_database::erase_keyframe(const std::shared_ptr<keyframe>& keyfrm) {
-    std::lock_guard<std::mutex> lock(mtx_);
+void bow_database::add_keyframes(const std::vector<std::shared_ptr<keyframe>>& keyfrms) {
+    std::lock_guard<util::profiled_mutex> lock(mtx_);
 
-    // Delete keyframe from the coresponding index in keyframes_in_node_ list
-    for (const auto& node_id_and_weight : keyfrm->bow_vec_) {
-        // first: node ID, second: weight
-        if (!static_cast<bool>(keyfrms_in_node_.count(node_id_and_weight.first))) {
+    if (0 < num_tombstones_) {
+        // Remove the tombstones first because they might have the same ID
+        compact();
+    }
+
+    std::vector<std::shared_ptr<keyframe>> sorted_keyfrms;
+    sorted_keyfrms.reserve(keyfrms.size());
+    unsigned int max_id = 0;
+    for (const auto& keyfrm : keyfrms) {
+        if (keyfrm->id_ < keyfrms_.size() && keyfrms_.at(keyfrm->id_)) {
+            // Already registered
             continue;
         }
-        // Obtain keyframe which shares word
-        auto& keyfrms_in_node = keyfrms_in_node_.at(node_id_and_weight.first);
+        if (keyfrm->will_be_erased()) {
+            // (the keyframes can be erased before they are added in the background, see system::load_map_database())
+            continue;
+        }
+        sorted_keyfrms.push_back(keyfrm);
+        max_id = std::max(max_id, keyfrm->id_);
+    }
+    if (sorted_keyfrms.empty()) {
+        return;
+    }
+    std::sort(sorted_keyfrms.begin(), sorted_keyfrms.end(),
+              [](const std::shared_ptr<keyframe>& a, const std::shared_ptr<keyframe>& b) {
+                  return a->id_ < b->id_;
+              });
+    if (keyfrms_.size() <= max_id) {
+        keyfrms_.resize(max_id + 1, nullptr);
+    }
 
-        // std::list::erase only accepts iterator
-        for (auto itr = keyfrms_in_node.begin(), lend = keyfrms_in_node.end(); itr != lend; itr++) {
-            if (keyfrm->id_ == (*itr)->id_) {
-                keyfrms_in_node.erase(itr);
-                break;
-            }
+    // Count the new entries of each node to allocate the posting lists at once
+    std::unordered_map<unsigned int, unsigned int> num_new_entries_in_node;
+    for (const auto& keyfrm : sorted_keyfrms) {
+        for (const auto& node_id_and_weight : keyfrm->bow_vec_) {
+            ++num_new_entries_in_node[node_id_and_weight.first];
         }
     }
+    for (const auto& node_id_and_num_entries : num_new_entries_in_node) {
+        auto& keyfrm_ids = keyfrm_ids_in_node_[node_id_and_num_entries.first];
+        keyfrm_ids.reserve(keyfrm_ids.size() + node_id_and_num_entries.second);
+    }
+
+    // Append keyframe IDs to the corresponding posting lists
+    for (const auto& keyfrm : sorted_keyfrms) {
+        const auto id = keyfrm->id_;
+        if (keyfrms_.at(id)) {
+            // duplicated in the input
+            continue;
+        }
+        keyfrms_.at(id) = keyfrm;
+        for (const auto& node_id_and_weight : keyfrm->bow_vec_) {
+            keyfrm_ids_in_node_[node_id_and_weight.first].push_back(id);
+        }
+        num_entries_ += keyfrm->bow_vec_.size();
+        global_desc_index_.add(id, global_descriptor_index::compute_descriptor(keyfrm->bow_vec_));
+    }
+}
+
+void bow_database::erase_keyframe(const std::shared_ptr<keyframe>& keyfrm) {
+    std::lock_guard<util::profiled_mutex> lock(mtx_);
+
+    const auto id = keyfrm->id_;
+    if (keyfrms_.size() <= id || !keyfrms_.at(id)) {
+        return;
+    }
+
+    // Leave the entries in the posting lists as tombstones,
+    // and remove them at once when they occupy the majority of the inverted index
+    keyfrms_.at(id) = nullptr;
+    global_desc_index_.erase(id);
+    num_tombstones_ += keyfrm->bow_vec_.size();
+    if (num_entries_ < 2 * num_tombstones_) {
+        compact();
+    }
+}
+
+size_t bow_database::get_memory_bytes() const {
+    std::lock_guard<util::profiled_mutex> lock(mtx_);
+    // (the entries include the tombstones, which are stored until the cleanup)
+    return keyfrm_ids_in_node_.bucket_count() * sizeof(void*)
+           + keyfrm_ids_in_node_.size() * get_node_bytes<std::pair<const unsigned int, std::vector<unsigned int>>>()
+           + num_entries_ * sizeof(unsigned int)
+           + keyfrms_.capacity() * sizeof(std::shared_ptr<keyframe>)
+           + num_common_words_buf_.capacity() * sizeof(unsigned int) + is_rejected_buf_.capacity()
+           + touched_ids_buf_.capacity() * sizeof(unsigned int)
+           + global_desc_index_.get_memory_bytes();
 }
 
 void bow_database::clear() {
-    std::lock_guard<std::mutex> lock(mtx_);
+    std::lock_guard<util::profiled_mutex> lock(mtx_);
     spdlog::info("clear BoW database");
-    keyfrms_in_node_.clear();
+    if (reclaimer_) {
+        // the posting lists and the references to the keyframes are destroyed on the reclaimer
+        auto keyfrm_ids_in_node = std::make_shared<std::unordered_map<unsigned int, std::vector<unsigned int>>>();
+        auto keyfrms = std::make_shared<std::vector<std::shared_ptr<keyframe>>>();
+        keyfrm_ids_in_node->swap(keyfrm_ids_in_node_);
+        keyfrms->swap(keyfrms_);
+        reclaimer_->push([keyfrm_ids_in_node, keyfrms] {});
+    }
+    else {
+        keyfrm_ids_in_node_.clear();
+        keyfrms_.clear();
+    }
+    num_entries_ = 0;
+    num_tombstones_ = 0;
+    num_common_words_buf_.clear();
+    is_rejected_buf_.clear();
+    touched_ids_buf_.clear();
+    global_desc_index_.clear();
+}
+
+void bow_database::set_reclaimer(const std::shared_ptr<util::async_reclaimer>& reclaimer) {
+    std::lock_guard<util::profiled_mutex> lock(mtx_);
+    reclaimer_ = reclaimer;
+}
+
+void bow_database::compact() {
+    num_entries_ = 0;
+    for (auto itr = keyfrm_ids_in_node_.begin(); itr != keyfrm_ids_in_node_.end();) {
+        auto& keyfrm_ids = itr->second;
+        keyfrm_ids.erase(std::remove_if(keyfrm_ids.begin(), keyfrm_ids.end(),
+                                        [this](const unsigned int id) { return !keyfrms_.at(id); }),
+                         keyfrm_ids.end());
+        num_entries_ += keyfrm_ids.size();
+        if (keyfrm_ids.empty()) {
+            itr = keyfrm_ids_in_node_.erase(itr);
+        }
+        else {
+            ++itr;
+        }
+    }
+    num_tombstones_ = 0;
 }
 
 std::vector<std::shared_ptr<keyframe>> bow_database::acquire_keyframes(const bow_vector& bow_vec, const float min_score,
@@ -60,7 +191,11 @@ std::vector<std::shared_ptr<keyframe>> bow_database::acquire_keyframes(const bow
     // Step 1.
     // Count up the number of nodes, words which are shared with query_keyframe, for all the keyframes in DoW database
 
-    const auto num_common_words = compute_num_common_words(bow_vec, keyfrms_to_reject);
+    std::vector<std::pair<std::shared_ptr<keyframe>, unsigned int>> num_common_words;
+    {
+        std::lock_guard<util::profiled_mutex> lock(mtx_);
+        num_common_words = compute_num_common_words(bow_vec, keyfrms_to_reject);
+    }
     if (num_common_words.empty()) {
         return std::vector<std::shared_ptr<keyframe>>();
     }
@@ -82,76 +217,162 @@ std::vector<std::shared_ptr<keyframe>> bow_database::acquire_keyframes(const bow
 
     float best_score = min_score;
     const auto scores = compute_scores(num_common_words, bow_vec, min_num_common_words_thr, min_score, best_score);
-    if (scores.empty()) {
-        return std::vector<std::shared_ptr<keyframe>>();
-    }
 
-    std::unordered_set<std::shared_ptr<keyframe>> final_candidates;
+    std::vector<std::shared_ptr<keyframe>> final_candidates;
+    final_candidates.reserve(scores.size());
     for (const auto& keyfrm_score : scores) {
-        const auto keyfrm = keyfrm_score.first;
-        final_candidates.insert(keyfrm);
+        final_candidates.push_back(keyfrm_score.first);
     }
-    return std::vector<std::shared_ptr<keyframe>>(final_candidates.begin(), final_candidates.end());
+    return final_candidates;
 }
 
-std::unordered_map<std::shared_ptr<keyframe>, unsigned int>
+std::vector<std::shared_ptr<keyframe>> bow_database::acquire_keyframes_by_global_descriptor(const bow_vector& bow_vec, const unsigned int num_neighbors,
+                                                                                            const float min_score,
+                                                                                            const std::set<std::shared_ptr<keyframe>>& keyfrms_to_reject) {
+    const auto desc = global_descriptor_index::compute_descriptor(bow_vec);
+
+    // Step 1.
+    // Retrieve the nearest neighbors of the global descriptor
+
+    std::vector<std::shared_ptr<keyframe>> neighbors;
+    {
+        std::lock_guard<util::profiled_mutex> lock(mtx_);
+        std::unordered_set<unsigned int> rejected_ids;
+        for (const auto& keyfrm : keyfrms_to_reject) {
+            if (keyfrm) {
+                rejected_ids.insert(keyfrm->id_);
+            }
+        }
+        const auto nearest_keyfrms = global_desc_index_.get_nearest_keyframes(desc, num_neighbors, [&rejected_ids](const unsigned int id) {
+            return static_cast<bool>(rejected_ids.count(id));
+        });
+        neighbors.reserve(nearest_keyfrms.size());
+        for (const auto& id_and_dist : nearest_keyfrms) {
+            if (keyfrms_.at(id_and_dist.first)) {
+                neighbors.push_back(keyfrms_.at(id_and_dist.first));
+            }
+        }
+    }
+    std::sort(neighbors.begin(), neighbors.end(),
+              [](const std::shared_ptr<keyframe>& a, const std::shared_ptr<keyframe>& b) {
+                  return a->id_ < b->id_;
+              });
+
+    // Step 2.
+    // Verify the neighbors with the BoW similarity scores
+
+    std::vector<float> scores(neighbors.size(), 0.0f);
+#ifdef USE_OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (int64_t idx = 0; idx < static_cast<int64_t>(neighbors.size()); ++idx) {
+        scores.at(idx) = data::bow_vocabulary_util::score(bow_vocab_, bow_vec, neighbors.at(idx)->bow_vec_);
+    }
+
+    std::vector<std::shared_ptr<keyframe>> final_candidates;
+    final_candidates.reserve(neighbors.size());
+    for (unsigned int idx = 0; idx < neighbors.size(); ++idx) {
+        if (min_score <= scores.at(idx)) {
+            final_candidates.push_back(neighbors.at(idx));
+        }
+    }
+    return final_candidates;
+}
+
+std::vector<std::pair<std::shared_ptr<keyframe>, unsigned int>>
 bow_database::compute_num_common_words(const bow_vector& bow_vec,
-                                       const std::set<std::shared_ptr<keyframe>>& keyfrms_to_reject) const {
-    std::unordered_map<std::shared_ptr<keyframe>, unsigned int> num_common_words;
+                                       const std::set<std::shared_ptr<keyframe>>& keyfrms_to_reject) {
+    const auto num_slots = keyfrms_.size();
+    if (num_common_words_buf_.size() < num_slots) {
+        num_common_words_buf_.resize(num_slots, 0);
+        is_rejected_buf_.resize(num_slots, 0);
+    }
 
-    std::lock_guard<std::mutex> lock(mtx_);
+    // Mark the keyframes to reject
+    for (const auto& keyfrm : keyfrms_to_reject) {
+        if (keyfrm && keyfrm->id_ < num_slots) {
+            is_rejected_buf_.at(keyfrm->id_) = 1;
+        }
+    }
 
     // Count the number of shared words for keyframes which share the word with the query keyframe
+    touched_ids_buf_.clear();
     for (const auto& node_id_and_weight : bow_vec) {
         // first: node ID, second: weight
         // If not in the BoW database, continue
-        if (!static_cast<bool>(keyfrms_in_node_.count(node_id_and_weight.first))) {
+        const auto itr = keyfrm_ids_in_node_.find(node_id_and_weight.first);
+        if (itr == keyfrm_ids_in_node_.end()) {
             continue;
         }
-        // Get a keyframe which shares the word (node ID) with the query
-        const auto& keyfrms_in_node = keyfrms_in_node_.at(node_id_and_weight.first);
-        // For each keyframe, increase shared word number one by one
-        for (const auto& keyfrm_in_node : keyfrms_in_node) {
-            // If far enough from the query keyframe, store it as the initial loop candidates
-            if (!static_cast<bool>(keyfrms_to_reject.count(keyfrm_in_node))) {
-                // Initialize if not in num_common_words
-                if (!static_cast<bool>(num_common_words.count(keyfrm_in_node))) {
-                    num_common_words[keyfrm_in_node] = 0;
-                }
-                // Count up the number of words
-                ++num_common_words.at(keyfrm_in_node);
+        // For each keyframe which shares the word (node ID) with the query, increase shared word number one by one
+        for (const auto id : itr->second) {
+            // Skip the tombstones and keyframes near the query
+            if (!keyfrms_[id] || is_rejected_buf_[id]) {
+                continue;
+            }
+            if (num_common_words_buf_[id] == 0) {
+                touched_ids_buf_.push_back(id);
             }
+            ++num_common_words_buf_[id];
+        }
+    }
+
+    // Collect the results in the order of keyframe ID, and reset the buffers for the next query
+    std::sort(touched_ids_buf_.begin(), touched_ids_buf_.end());
+    std::vector<std::pair<std::shared_ptr<keyframe>, unsigned int>> num_common_words;
+    num_common_words.reserve(touched_ids_buf_.size());
+    for (const auto id : touched_ids_buf_) {
+        num_common_words.emplace_back(keyfrms_[id], num_common_words_buf_[id]);
+        num_common_words_buf_[id] = 0;
+    }
+    for (const auto& keyfrm : keyfrms_to_reject) {
+        if (keyfrm && keyfrm->id_ < num_slots) {
+            is_rejected_buf_.at(keyfrm->id_) = 0;
         }
     }
 
     return num_common_words;
 }
 
-std::unordered_map<std::shared_ptr<keyframe>, float>
-bow_database::compute_scores(const std::unordered_map<std::shared_ptr<keyframe>, unsigned int>& num_common_words,
+std::vector<std::pair<std::shared_ptr<keyframe>, float>>
+bow_database::compute_scores(const std::vector<std::pair<std::shared_ptr<keyframe>, unsigned int>>& num_common_words,
                              const bow_vector& bow_vec,
                              const unsigned int min_num_common_words_thr,
                              const float min_score,
                              float& best_score) const {
-    std::unordered_map<std::shared_ptr<keyframe>, float> scores;
+    // Calculate similarity scores with query keyframe
+    // for the keyframes which have more shared words than minimum common words
+    // (NOTE: the scoring is done without locking mtx_, so it does not block add_keyframe() and the other queries)
+    std::vector<float> all_scores(num_common_words.size(), 0.0f);
+    std::vector<unsigned char> is_scored(num_common_words.size(), 0);
+#ifdef USE_OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (int64_t idx = 0; idx < static_cast<int64_t>(num_common_words.size()); ++idx) {
+        const auto& keyfrm_num_common_words_pair = num_common_words.at(idx);
+        if (min_num_common_words_thr < keyfrm_num_common_words_pair.second) {
+            all_scores.at(idx) = data::bow_vocabulary_util::score(bow_vocab_, bow_vec, keyfrm_num_common_words_pair.first->bow_vec_);
+            is_scored.at(idx) = 1;
+        }
+    }
+
+    std::vector<std::pair<std::shared_ptr<keyframe>, float>> scores;
 
     best_score = min_score;
 
-    for (const auto& keyfrm_num_common_words_pair : num_common_words) {
-        const auto& keyfrm = keyfrm_num_common_words_pair.first;
-        if (min_num_common_words_thr < keyfrm_num_common_words_pair.second) {
-            // Calculate similarity score with query keyframe
-            // for the keyframes which have more shared words than minimum common words
-            const auto score = data::bow_vocabulary_util::score(bow_vocab_, bow_vec, keyfrm->bow_vec_);
-            if (min_score > score) {
-                continue;
-            }
-            if (best_score < score) {
-                best_score = score;
-            }
-            // Store score
-            scores[keyfrm] = score;
+    for (unsigned int idx = 0; idx < num_common_words.size(); ++idx) {
+        if (!is_scored.at(idx)) {
+            continue;
+        }
+        const auto score = all_scores.at(idx);
+        if (min_score > score) {
+            continue;
+        }
+        if (best_score < score) {
+            best_score = score;
         }
+        // Store score
+        scores.emplace_back(num_common_words.at(idx).first, score);
     }
 
     return scores;
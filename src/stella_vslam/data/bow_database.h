@@ -2,16 +2,21 @@
 #define STELLA_VSLAM_DATA_BOW_DATABASE_H
 
 #include "stella_vslam/data/bow_vocabulary.h"
+#include "stella_vslam/data/global_descriptor_index.h"
+#include "stella_vslam/util/lock_profiler.h"
 
 #include <mutex>
-#include <list>
 #include <vector>
 #include <set>
 #include <unordered_map>
-#include <unordered_set>
 #include <memory>
 
 namespace stella_vslam {
+
+namespace util {
+class async_reclaimer;
+} // namespace util
+
 namespace data {
 
 class frame;
@@ -36,6 +41,13 @@ public:
      */
     void add_keyframe(const std::shared_ptr<keyframe>& keyfrm);
 
+    /**
+     * Add the keyframes to the database at once (e.g. after loading a map)
+     * (NOTE: the posting lists are allocated once, and the IDs are appended in the order of keyframe ID)
+     * @param keyfrms
+     */
+    void add_keyframes(const std::vector<std::shared_ptr<keyframe>>& keyfrms);
+
     /**
      * Erase the keyframe from the database
      * @param keyfrm
@@ -44,40 +56,68 @@ public:
 
     /**
      * Clear the database
+     * (NOTE: the inverted index and the keyframe table are destroyed on the reclaimer if set)
      */
     void clear();
 
+    /**
+     * Set the reclaimer which destroys the cleared inverted index in the background (destroyed in clear() if nullptr)
+     * @param reclaimer
+     */
+    void set_reclaimer(const std::shared_ptr<util::async_reclaimer>& reclaimer);
+
+    /**
+     * Estimated bytes of the inverted index, the keyframe table and the global descriptor index
+     */
+    size_t get_memory_bytes() const;
+
     /**
      * Acquire keyframes over score
      */
     std::vector<std::shared_ptr<keyframe>> acquire_keyframes(const bow_vector& bow_vec, const float min_score = 0.0f,
                                                              const std::set<std::shared_ptr<keyframe>>& keyfrms_to_reject = {});
 
+    /**
+     * Acquire keyframes over score among the nearest neighbors of the global descriptor of the query
+     * (NOTE: the BoW scores are computed only for the retrieved keyframes instead of all the keyframes which share words with the query,
+     *  and the results are in the order of keyframe ID as acquire_keyframes())
+     * @param bow_vec
+     * @param num_neighbors number of the keyframes retrieved by the global descriptor
+     * @param min_score
+     * @param keyfrms_to_reject
+     */
+    std::vector<std::shared_ptr<keyframe>> acquire_keyframes_by_global_descriptor(const bow_vector& bow_vec, const unsigned int num_neighbors,
+                                                                                  const float min_score = 0.0f,
+                                                                                  const std::set<std::shared_ptr<keyframe>>& keyfrms_to_reject = {});
+
 protected:
     /**
-     * Initialize temporary variables
+     * Remove the entries of the erased keyframes from the inverted index
+     * (NOTE: mtx_ must be locked by the caller)
      */
-    void initialize();
+    void compact();
 
     /**
      * Compute the number of shared words
+     * (NOTE: mtx_ must be locked by the caller)
      * @param bow_vec
      * @param keyfrms_to_reject
-     * @return number of shared words between the query and the each of keyframes contained in the database (key: keyframes that share word with query keyframe, value: number of shared words)
+     * @return keyframes which share words with the query and the number of the shared words (in the order of keyframe ID)
      */
-    std::unordered_map<std::shared_ptr<keyframe>, unsigned int>
+    std::vector<std::pair<std::shared_ptr<keyframe>, unsigned int>>
     compute_num_common_words(const bow_vector& bow_vec,
-                             const std::set<std::shared_ptr<keyframe>>& keyfrms_to_reject = {}) const;
+                             const std::set<std::shared_ptr<keyframe>>& keyfrms_to_reject = {});
 
     /**
-     * Compute scores (scores_) between the query and the each of keyframes contained in the database
+     * Compute scores between the query and the each of keyframes which share words with it
+     * (NOTE: mtx_ must NOT be locked, and the scores are computed in parallel when built with USE_OPENMP)
      * @param num_common_words
      * @param bow_vec
      * @param min_num_common_words_thr
-     * @return similarity scores between the query and the each of keyframes contained in the database (key: keyframes that share word with query keyframe, value: score)
+     * @return keyframes over the minimum score and the similarity scores (in the order of num_common_words)
      */
-    std::unordered_map<std::shared_ptr<keyframe>, float>
-    compute_scores(const std::unordered_map<std::shared_ptr<keyframe>, unsigned int>& num_common_words,
+    std::vector<std::pair<std::shared_ptr<keyframe>, float>>
+    compute_scores(const std::vector<std::pair<std::shared_ptr<keyframe>, unsigned int>>& num_common_words,
                    const bow_vector& bow_vec,
                    const unsigned int min_num_common_words_thr,
                    const float min_score,
@@ -87,15 +127,36 @@ protected:
     // BoW feature vectors
 
     //! mutex to access BoW database
-    mutable std::mutex mtx_;
-    //! BoW database
-    std::unordered_map<unsigned int, std::list<std::shared_ptr<keyframe>>> keyfrms_in_node_;
+    mutable util::profiled_mutex mtx_{"bow_database::mtx_"};
+    //! Inverted index (key: node ID, value: IDs of the keyframes which have the word)
+    //! (NOTE: the IDs of the erased keyframes are left as tombstones until compact() is called)
+    std::unordered_map<unsigned int, std::vector<unsigned int>> keyfrm_ids_in_node_;
+    //! Registered keyframes indexed by keyframe ID (nullptr if not registered or erased)
+    std::vector<std::shared_ptr<keyframe>> keyfrms_;
+    //! Number of the entries in the inverted index
+    size_t num_entries_ = 0;
+    //! Number of the tombstones in the inverted index
+    size_t num_tombstones_ = 0;
+
+    //! Buffers reused across queries (indexed by keyframe ID, guarded by mtx_)
+    //! Number of the words shared with the query
+    std::vector<unsigned int> num_common_words_buf_;
+    //! The keyframe is rejected by the query or not
+    std::vector<unsigned char> is_rejected_buf_;
+    //! IDs of the keyframes whose counter was incremented by the query
+    std::vector<unsigned int> touched_ids_buf_;
+
+    //! Approximate nearest neighbor index of the global descriptors (guarded by mtx_)
+    global_descriptor_index global_desc_index_;
 
     //-----------------------------------------
     // BoW vocabulary
 
     //! BoW vocabulary
     bow_vocabulary* bow_vocab_;
+
+    //! reclaimer of the cleared inverted index (guarded by mtx_, nullptr if destroyed in clear())
+    std::shared_ptr<util::async_reclaimer> reclaimer_ = nullptr;
 };
 
 } // namespace data
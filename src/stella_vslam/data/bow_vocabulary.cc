@@ -1,5 +1,8 @@
 #include "stella_vslam/data/bow_vocabulary.h"
 #include "stella_vslam/util/converter.h"
+
+#include <chrono>
+
 #include <spdlog/spdlog.h>
 
 namespace stella_vslam {
@@ -19,34 +22,62 @@ void compute_bow(bow_vocabulary* bow_vocab, const cv::Mat& descriptors, bow_vect
 #ifdef USE_DBOW2
     bow_vocab->transform(util::converter::to_desc_vec(descriptors), bow_vec, bow_feat_vec, 4);
 #else
+    if (bow_vocab->image_) {
+        bow_vocab->image_->transform(descriptors, 4, bow_vec, bow_feat_vec);
+        return;
+    }
     bow_vocab->transform(descriptors, 4, bow_vec, bow_feat_vec);
 #endif
 }
 
-bow_vocabulary* load(std::string path) {
-    bow_vocabulary* bow_vocab = new bow_vocabulary();
+void load(bow_vocabulary* bow_vocab, const std::string& path) {
+    const auto tp_start = std::chrono::steady_clock::now();
+    if (bow_vocabulary_image::is_image(path)) {
 #ifdef USE_DBOW2
-    try {
-        bow_vocab->loadFromBinaryFile(path);
-    }
-    catch (const std::exception&) {
-        spdlog::critical("wrong path to vocabulary");
-        delete bow_vocab;
-        bow_vocab = nullptr;
+        spdlog::critical("the vocabulary image is available only when built with FBoW: {}", path);
         exit(EXIT_FAILURE);
-    }
 #else
-    bow_vocab->readFromFile(path);
-    if (!bow_vocab->isValid()) {
-        spdlog::critical("wrong path to vocabulary");
-        delete bow_vocab;
-        bow_vocab = nullptr;
-        exit(EXIT_FAILURE);
+        try {
+            bow_vocab->image_.reset(new bow_vocabulary_image(path));
+        }
+        catch (const std::exception& e) {
+            spdlog::critical("cannot load the vocabulary image: {}", e.what());
+            exit(EXIT_FAILURE);
+        }
+#endif
     }
+    else {
+#ifdef USE_DBOW2
+        try {
+            bow_vocab->loadFromBinaryFile(path);
+        }
+        catch (const std::exception&) {
+            spdlog::critical("wrong path to vocabulary");
+            exit(EXIT_FAILURE);
+        }
+#else
+        bow_vocab->readFromFile(path);
+        if (!bow_vocab->isValid()) {
+            spdlog::critical("wrong path to vocabulary");
+            exit(EXIT_FAILURE);
+        }
 #endif
+    }
+    const auto tp_end = std::chrono::steady_clock::now();
+    spdlog::info("load vocabulary: {} ({} ms)", path,
+                 std::chrono::duration_cast<std::chrono::milliseconds>(tp_end - tp_start).count());
+}
+
+bow_vocabulary* load(std::string path) {
+    bow_vocabulary* bow_vocab = new bow_vocabulary();
+    load(bow_vocab, path);
     return bow_vocab;
 }
 
+std::shared_ptr<bow_vocabulary> load_shared(const std::string& path) {
+    return std::shared_ptr<bow_vocabulary>(load(path));
+}
+
 }; // namespace bow_vocabulary_util
 }; // namespace data
 }; // namespace stella_vslam
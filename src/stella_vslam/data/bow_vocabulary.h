@@ -2,6 +2,7 @@
 #define STELLA_VSLAM_DATA_BOW_VOCABULARY_H
 
 #include "stella_vslam/data/bow_vocabulary_fwd.h"
+#include "stella_vslam/data/bow_vocabulary_image.h"
 
 #ifdef USE_DBOW2
 #include <DBoW2/FORB.h>
@@ -10,13 +11,34 @@
 #include <fbow/vocabulary.h>
 #endif // USE_DBOW2
 
+#include <memory>
+#include <string>
+
 namespace stella_vslam {
 namespace data {
+
+#ifndef USE_DBOW2
+//! Vocabulary of FBoW, or the vocabulary image if it is loaded from the file of bow_vocabulary_image
+class bow_vocabulary : public fbow::Vocabulary {
+public:
+    //! memory-mapped vocabulary image (nullptr if the FBoW binary is loaded)
+    std::unique_ptr<bow_vocabulary_image> image_;
+};
+#endif // USE_DBOW2
+
 namespace bow_vocabulary_util {
 
 float score(bow_vocabulary* bow_vocab, const bow_vector& bow_vec1, const bow_vector& bow_vec2);
 void compute_bow(bow_vocabulary* bow_vocab, const cv::Mat& descriptors, bow_vector& bow_vec, bow_feature_vector& bow_feat_vec);
+//! Load the vocabulary from the file and report the elapsed time
+//! (NOTE: the vocabulary image (see bow_vocabulary_image) is memory-mapped without parsing nor copying,
+//!  then its pages are shared among the processes. The FBoW binary is read into the buffer owned by the vocabulary.)
 bow_vocabulary* load(std::string path);
+//! Load the vocabulary from the file into the constructed one
+//! (e.g. in parallel with the construction of the modules which refer to it)
+void load(bow_vocabulary* bow_vocab, const std::string& path);
+//! Load the vocabulary which is shared among the system instances in a process (see system::system())
+std::shared_ptr<bow_vocabulary> load_shared(const std::string& path);
 
 }; // namespace bow_vocabulary_util
 }; // namespace data
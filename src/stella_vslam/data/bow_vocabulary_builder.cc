@@ -0,0 +1,534 @@
+#include "stella_vslam/data/bow_vocabulary_builder.h"
+#include "stella_vslam/match/hamming.h"
+#include "stella_vslam/util/thread_pool.h"
+
+#ifdef USE_DBOW2
+#include "stella_vslam/data/bow_vocabulary.h"
+#endif
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <limits>
+#include <stdexcept>
+
+#include <spdlog/spdlog.h>
+
+namespace {
+
+using center_t = std::array<uint8_t, stella_vslam::data::bow_vocabulary_builder::desc_size>;
+
+// number of the descriptors assigned at once (the descriptors and their distances to the centers stay in the L2 cache)
+constexpr size_t assignment_block_size = 2048;
+// min number of the descriptors of a node whose assignment is split into the parallel tasks
+constexpr size_t min_num_descs_for_parallel_assignment = 4 * assignment_block_size;
+
+#ifdef USE_DBOW2
+// DBoW2 writes its own binary, then the tree is passed through the nodes of the vocabulary
+class dbow2_vocabulary_writer : public stella_vslam::data::bow_vocabulary {
+public:
+    dbow2_vocabulary_writer(const unsigned int k, const unsigned int L)
+        : stella_vslam::data::bow_vocabulary(k, L, DBoW2::TF_IDF, DBoW2::L1_NORM) {}
+
+    void set_nodes(const std::vector<stella_vslam::data::bow_vocabulary_builder::node>& nodes) {
+        m_nodes.resize(nodes.size());
+        for (unsigned int idx = 0; idx < nodes.size(); ++idx) {
+            m_nodes[idx].id = idx;
+            m_nodes[idx].parent = nodes.at(idx).parent_;
+            m_nodes[idx].children.assign(nodes.at(idx).children_.begin(), nodes.at(idx).children_.end());
+            m_nodes[idx].weight = nodes.at(idx).weight_;
+            if (idx != 0) {
+                m_nodes[idx].descriptor = cv::Mat(1, stella_vslam::data::bow_vocabulary_builder::desc_size, CV_8U,
+                                                  const_cast<uint8_t*>(nodes.at(idx).descriptor_.data()))
+                                              .clone();
+            }
+        }
+        // (the word IDs are assigned in the order of the nodes as the builder does)
+        createWords();
+    }
+};
+#endif
+
+} // namespace
+
+namespace stella_vslam {
+namespace data {
+
+constexpr unsigned int bow_vocabulary_builder::desc_size;
+
+bow_vocabulary_builder::bow_vocabulary_builder(const unsigned int k, const unsigned int L,
+                                               const size_t max_num_descs, const unsigned int max_num_iters,
+                                               const unsigned int seed)
+    : k_(k), L_(L), max_num_descs_(max_num_descs), max_num_iters_(max_num_iters), seed_(seed), sampling_rng_(seed) {
+    if (k_ < 2 || 255 < k_) {
+        throw std::runtime_error("the branching factor of the vocabulary must be in 2-255");
+    }
+    if (L_ < 1) {
+        throw std::runtime_error("the depth of the vocabulary must be greater than 0");
+    }
+    if (max_num_descs_ == 0) {
+        throw std::runtime_error("the capacity of the descriptors must be greater than 0");
+    }
+}
+
+void bow_vocabulary_builder::add_image_descriptors(const uint8_t* descs, const size_t stride, const unsigned int num_descs) {
+    std::lock_guard<std::mutex> lock(mtx_samples_);
+    const auto img_idx = num_images_++;
+    for (unsigned int i = 0; i < num_descs; ++i) {
+        const uint8_t* desc = descs + i * stride;
+        ++num_seen_descs_;
+        if (img_indices_.size() < max_num_descs_) {
+            descs_.insert(descs_.end(), desc, desc + desc_size);
+            img_indices_.push_back(img_idx);
+            continue;
+        }
+        // reservoir sampling: the descriptor replaces one of the samples with the probability of capacity / seen
+        const auto sample_idx = std::uniform_int_distribution<size_t>(0, num_seen_descs_ - 1)(sampling_rng_);
+        if (sample_idx < max_num_descs_) {
+            std::memcpy(descs_.data() + sample_idx * desc_size, desc, desc_size);
+            img_indices_.at(sample_idx) = img_idx;
+        }
+    }
+}
+
+unsigned int bow_vocabulary_builder::get_num_images() const {
+    std::lock_guard<std::mutex> lock(mtx_samples_);
+    return num_images_;
+}
+
+size_t bow_vocabulary_builder::get_num_seen_descriptors() const {
+    std::lock_guard<std::mutex> lock(mtx_samples_);
+    return num_seen_descs_;
+}
+
+size_t bow_vocabulary_builder::get_num_sampled_descriptors() const {
+    std::lock_guard<std::mutex> lock(mtx_samples_);
+    return img_indices_.size();
+}
+
+void bow_vocabulary_builder::build(util::thread_pool* pool) {
+    std::lock_guard<std::mutex> lock(mtx_samples_);
+    if (img_indices_.empty()) {
+        throw std::runtime_error("no descriptor is added to the vocabulary builder");
+    }
+
+    nodes_.clear();
+    nodes_.emplace_back();
+
+    // range of the descriptors of a node which is to be clustered
+    struct pending_node {
+        unsigned int node_idx_;
+        size_t begin_;
+        size_t end_;
+    };
+    std::vector<pending_node> pending_nodes{{0, 0, img_indices_.size()}};
+
+    // the tree is grown level by level, and the nodes of a level are clustered in parallel
+    for (unsigned int level = 1; level <= L_ && !pending_nodes.empty(); ++level) {
+        std::vector<std::vector<center_t>> centers(pending_nodes.size());
+        std::vector<std::vector<size_t>> cluster_ends(pending_nodes.size());
+        const auto cluster_node = [this, pool, &pending_nodes, &centers, &cluster_ends](const unsigned int i) {
+            const auto& pending = pending_nodes.at(i);
+            cluster(pending.begin_, pending.end_, seed_ + pending.node_idx_ * 2654435761u, pool, centers.at(i), cluster_ends.at(i));
+        };
+        if (pool) {
+            std::vector<std::future<void>> futures;
+            futures.reserve(pending_nodes.size());
+            for (unsigned int i = 0; i < pending_nodes.size(); ++i) {
+                futures.push_back(pool->submit([&cluster_node, i] { cluster_node(i); }));
+            }
+            for (auto& future : futures) {
+                pool->wait(future);
+                future.get();
+            }
+        }
+        else {
+            for (unsigned int i = 0; i < pending_nodes.size(); ++i) {
+                cluster_node(i);
+            }
+        }
+
+        // the children are appended in the order of the parents, then a parent always precedes its children
+        std::vector<pending_node> next_pending_nodes;
+        for (unsigned int i = 0; i < pending_nodes.size(); ++i) {
+            const auto parent_idx = pending_nodes.at(i).node_idx_;
+            auto begin = pending_nodes.at(i).begin_;
+            for (unsigned int c = 0; c < centers.at(i).size(); ++c) {
+                const unsigned int child_idx = nodes_.size();
+                nodes_.emplace_back();
+                nodes_.back().parent_ = parent_idx;
+                nodes_.back().descriptor_ = centers.at(i).at(c);
+                nodes_.at(parent_idx).children_.push_back(child_idx);
+
+                const auto end = cluster_ends.at(i).at(c);
+                if (level < L_ && 1 < end - begin) {
+                    next_pending_nodes.push_back({child_idx, begin, end});
+                }
+                begin = end;
+            }
+        }
+        pending_nodes.swap(next_pending_nodes);
+    }
+
+    num_words_ = 0;
+    for (unsigned int idx = 1; idx < nodes_.size(); ++idx) {
+        if (nodes_.at(idx).children_.empty()) {
+            nodes_.at(idx).word_id_ = num_words_++;
+        }
+    }
+
+    compute_weights(pool);
+
+    spdlog::info("build vocabulary: {} nodes, {} words from {} descriptors of {} images",
+                 nodes_.size(), num_words_, img_indices_.size(), num_images_);
+}
+
+unsigned int bow_vocabulary_builder::quantize(const uint8_t* desc) const {
+    assert(!nodes_.empty());
+    unsigned int node_idx = 0;
+    while (!nodes_.at(node_idx).children_.empty()) {
+        unsigned int best_dist = std::numeric_limits<unsigned int>::max();
+        unsigned int best_child_idx = 0;
+        for (const auto child_idx : nodes_.at(node_idx).children_) {
+            const auto dist = match::compute_hamming_distance_256(desc, nodes_.at(child_idx).descriptor_.data());
+            if (dist < best_dist) {
+                best_dist = dist;
+                best_child_idx = child_idx;
+            }
+        }
+        node_idx = best_child_idx;
+    }
+    return nodes_.at(node_idx).word_id_;
+}
+
+void bow_vocabulary_builder::cluster(const size_t begin, const size_t end, const unsigned int seed, util::thread_pool* pool,
+                                     std::vector<center_t>& centers, std::vector<size_t>& cluster_ends) {
+    const size_t num_descs = end - begin;
+    const uint8_t* descs = descs_.data() + begin * desc_size;
+    centers.clear();
+    cluster_ends.clear();
+
+    // each descriptor is a cluster if they are not more than the clusters
+    if (num_descs <= k_) {
+        for (size_t i = 0; i < num_descs; ++i) {
+            center_t center;
+            std::memcpy(center.data(), descs + i * desc_size, desc_size);
+            centers.push_back(center);
+            cluster_ends.push_back(begin + i + 1);
+        }
+        return;
+    }
+
+    // k-means++ seeding: each center is drawn with the probability proportional to the squared distance to the nearest center
+    std::mt19937 rng(seed);
+    std::vector<unsigned int> min_dists(num_descs);
+    std::vector<unsigned int> dists(num_descs);
+    const auto add_center = [&](const size_t idx) {
+        center_t center;
+        std::memcpy(center.data(), descs + idx * desc_size, desc_size);
+        centers.push_back(center);
+        match::compute_hamming_distances_256(center.data(), descs, desc_size, num_descs, dists.data());
+        if (centers.size() == 1) {
+            min_dists.swap(dists);
+            return;
+        }
+        for (size_t i = 0; i < num_descs; ++i) {
+            min_dists.at(i) = std::min(min_dists.at(i), dists.at(i));
+        }
+    };
+    add_center(std::uniform_int_distribution<size_t>(0, num_descs - 1)(rng));
+    while (centers.size() < k_) {
+        double sum = 0.0;
+        for (const auto dist : min_dists) {
+            sum += static_cast<double>(dist) * dist;
+        }
+        // all of the descriptors coincide with the centers
+        if (sum == 0.0) {
+            break;
+        }
+        double threshold = std::uniform_real_distribution<double>(0.0, sum)(rng);
+        size_t idx = 0;
+        for (; idx < num_descs - 1; ++idx) {
+            threshold -= static_cast<double>(min_dists.at(idx)) * min_dists.at(idx);
+            if (threshold <= 0.0) {
+                break;
+            }
+        }
+        add_center(idx);
+    }
+    std::vector<unsigned int>().swap(min_dists);
+    std::vector<unsigned int>().swap(dists);
+
+    // k-majority: the assignments and the bitwise majorities are alternated,
+    // and the loop ends after an assignment step so that the clusters are consistent with the centers
+    const unsigned int num_clusters = centers.size();
+    std::vector<uint8_t> assignments(num_descs, 0);
+    std::vector<size_t> cluster_sizes(num_clusters);
+    const bool assigns_in_parallel = pool && min_num_descs_for_parallel_assignment <= num_descs;
+    const size_t num_tasks = assigns_in_parallel
+                                 ? std::min((num_descs + assignment_block_size - 1) / assignment_block_size,
+                                            static_cast<size_t>(4 * std::max(1u, pool->get_num_threads())))
+                                 : 1;
+    std::vector<std::vector<uint32_t>> task_bit_counts(num_tasks, std::vector<uint32_t>(num_clusters * desc_size * 8));
+    std::vector<std::vector<size_t>> task_cluster_sizes(num_tasks, std::vector<size_t>(num_clusters));
+    for (unsigned int iter = 0;; ++iter) {
+        size_t num_changed = 0;
+        if (assigns_in_parallel) {
+            // the tasks take the contiguous ranges of the blocks
+            const size_t num_blocks = (num_descs + assignment_block_size - 1) / assignment_block_size;
+            std::vector<std::future<size_t>> futures;
+            futures.reserve(num_tasks);
+            for (size_t t = 0; t < num_tasks; ++t) {
+                const size_t task_begin = std::min(num_descs, (num_blocks * t / num_tasks) * assignment_block_size);
+                const size_t task_end = std::min(num_descs, (num_blocks * (t + 1) / num_tasks) * assignment_block_size);
+                futures.push_back(pool->submit([this, begin, task_begin, task_end, t, &centers, &assignments, &task_bit_counts, &task_cluster_sizes] {
+                    return assign(begin + task_begin, begin + task_end, centers, assignments.data() + task_begin,
+                                  task_bit_counts.at(t), task_cluster_sizes.at(t));
+                }));
+            }
+            for (auto& future : futures) {
+                pool->wait(future);
+                num_changed += future.get();
+            }
+        }
+        else {
+            num_changed = assign(begin, end, centers, assignments.data(), task_bit_counts.at(0), task_cluster_sizes.at(0));
+        }
+
+        // the bit counts are integers, then the reduction does not depend on the partition
+        std::fill(cluster_sizes.begin(), cluster_sizes.end(), 0);
+        for (size_t t = 0; t < num_tasks; ++t) {
+            for (unsigned int c = 0; c < num_clusters; ++c) {
+                cluster_sizes.at(c) += task_cluster_sizes.at(t).at(c);
+            }
+        }
+        if ((0 < iter && num_changed == 0) || max_num_iters_ <= iter) {
+            break;
+        }
+
+        for (unsigned int c = 0; c < num_clusters; ++c) {
+            // the empty cluster keeps its center, and is removed after the iterations
+            if (cluster_sizes.at(c) == 0) {
+                continue;
+            }
+            center_t center{};
+            for (unsigned int bit = 0; bit < desc_size * 8; ++bit) {
+                uint32_t count = 0;
+                for (size_t t = 0; t < num_tasks; ++t) {
+                    count += task_bit_counts.at(t).at(c * desc_size * 8 + bit);
+                }
+                if (cluster_sizes.at(c) < 2 * count) {
+                    center.at(bit / 8) |= static_cast<uint8_t>(1 << (bit % 8));
+                }
+            }
+            centers.at(c) = center;
+        }
+    }
+
+    // reorder the descriptors so that each cluster is contiguous (the empty clusters are removed)
+    std::vector<size_t> offsets(num_clusters + 1, 0);
+    for (unsigned int c = 0; c < num_clusters; ++c) {
+        offsets.at(c + 1) = offsets.at(c) + cluster_sizes.at(c);
+    }
+    std::vector<uint8_t> sorted_descs(num_descs * desc_size);
+    std::vector<uint32_t> sorted_img_indices(num_descs);
+    {
+        auto next_offsets = offsets;
+        for (size_t i = 0; i < num_descs; ++i) {
+            const auto dst = next_offsets.at(assignments.at(i))++;
+            std::memcpy(sorted_descs.data() + dst * desc_size, descs + i * desc_size, desc_size);
+            sorted_img_indices.at(dst) = img_indices_.at(begin + i);
+        }
+    }
+    std::memcpy(descs_.data() + begin * desc_size, sorted_descs.data(), sorted_descs.size());
+    std::copy(sorted_img_indices.begin(), sorted_img_indices.end(), img_indices_.begin() + begin);
+
+    std::vector<center_t> nonempty_centers;
+    for (unsigned int c = 0; c < num_clusters; ++c) {
+        if (cluster_sizes.at(c) == 0) {
+            continue;
+        }
+        nonempty_centers.push_back(centers.at(c));
+        cluster_ends.push_back(begin + offsets.at(c + 1));
+    }
+    centers.swap(nonempty_centers);
+}
+
+size_t bow_vocabulary_builder::assign(const size_t begin, const size_t end, const std::vector<center_t>& centers,
+                                      uint8_t* assignments, std::vector<uint32_t>& bit_counts, std::vector<size_t>& cluster_sizes) const {
+    const unsigned int num_clusters = centers.size();
+    std::fill(bit_counts.begin(), bit_counts.end(), 0);
+    std::fill(cluster_sizes.begin(), cluster_sizes.end(), 0);
+
+    // distances from the centers to the descriptors of a block (row-major by the centers)
+    std::vector<unsigned int> dists(num_clusters * assignment_block_size);
+    size_t num_changed = 0;
+    for (size_t block_begin = begin; block_begin < end; block_begin += assignment_block_size) {
+        const size_t block_size = std::min(assignment_block_size, end - block_begin);
+        const uint8_t* block_descs = descs_.data() + block_begin * desc_size;
+        // the block is scanned once per center while it stays in the cache
+        for (unsigned int c = 0; c < num_clusters; ++c) {
+            match::compute_hamming_distances_256(centers.at(c).data(), block_descs, desc_size, block_size,
+                                                 dists.data() + c * assignment_block_size);
+        }
+        for (size_t i = 0; i < block_size; ++i) {
+            unsigned int best_cluster = 0;
+            unsigned int best_dist = dists.at(i);
+            for (unsigned int c = 1; c < num_clusters; ++c) {
+                if (dists.at(c * assignment_block_size + i) < best_dist) {
+                    best_dist = dists.at(c * assignment_block_size + i);
+                    best_cluster = c;
+                }
+            }
+            uint8_t& assignment = assignments[block_begin - begin + i];
+            if (assignment != best_cluster) {
+                assignment = static_cast<uint8_t>(best_cluster);
+                ++num_changed;
+            }
+            ++cluster_sizes.at(best_cluster);
+            const uint8_t* desc = block_descs + i * desc_size;
+            uint32_t* counts = bit_counts.data() + best_cluster * desc_size * 8;
+            for (unsigned int byte = 0; byte < desc_size; ++byte) {
+                for (unsigned int bit = 0; bit < 8; ++bit) {
+                    counts[byte * 8 + bit] += (desc[byte] >> bit) & 1;
+                }
+            }
+        }
+    }
+    return num_changed;
+}
+
+void bow_vocabulary_builder::compute_weights(util::thread_pool* pool) {
+    // quantize the samples in the same way as the vocabulary does
+    const size_t num_descs = img_indices_.size();
+    std::vector<uint64_t> word_img_pairs(num_descs);
+    const auto quantize_range = [this, &word_img_pairs](const size_t range_begin, const size_t range_end) {
+        for (size_t i = range_begin; i < range_end; ++i) {
+            const uint64_t word_id = quantize(descs_.data() + i * desc_size);
+            word_img_pairs.at(i) = (word_id << 32) | img_indices_.at(i);
+        }
+    };
+    if (pool && 0 < pool->get_num_threads()) {
+        const size_t num_tasks = 4 * pool->get_num_threads();
+        std::vector<std::future<void>> futures;
+        for (size_t t = 0; t < num_tasks; ++t) {
+            futures.push_back(pool->submit([&quantize_range, num_descs, num_tasks, t] {
+                quantize_range(num_descs * t / num_tasks, num_descs * (t + 1) / num_tasks);
+            }));
+        }
+        for (auto& future : futures) {
+            pool->wait(future);
+            future.get();
+        }
+    }
+    else {
+        quantize_range(0, num_descs);
+    }
+
+    // IDF: log(number of the images / number of the images in which the word appears)
+    std::sort(word_img_pairs.begin(), word_img_pairs.end());
+    word_img_pairs.erase(std::unique(word_img_pairs.begin(), word_img_pairs.end()), word_img_pairs.end());
+    std::vector<unsigned int> num_imgs_of_words(num_words_, 0);
+    for (const auto pair : word_img_pairs) {
+        ++num_imgs_of_words.at(pair >> 32);
+    }
+    for (auto& node : nodes_) {
+        if (node.word_id_ < 0) {
+            continue;
+        }
+        const auto num_imgs = num_imgs_of_words.at(node.word_id_);
+        node.weight_ = (0 < num_imgs) ? static_cast<float>(std::log(static_cast<double>(num_images_) / num_imgs)) : 0.0f;
+    }
+}
+
+void bow_vocabulary_builder::save(const std::string& path, const bow_vocabulary_format_t format) const {
+    if (nodes_.empty()) {
+        throw std::runtime_error("the vocabulary is not built");
+    }
+    switch (format) {
+        case bow_vocabulary_format_t::FBoW:
+            bow_vocabulary_image::save_fbow(path, k_, make_blocks());
+            break;
+        case bow_vocabulary_format_t::Image:
+            bow_vocabulary_image::save(path, k_, make_blocks());
+            break;
+        case bow_vocabulary_format_t::DBoW2:
+            save_dbow2(path);
+            break;
+        case bow_vocabulary_format_t::DBoW2_Text:
+            save_dbow2_text(path);
+            break;
+    }
+    spdlog::info("save vocabulary: {}", path);
+}
+
+std::vector<bow_vocabulary_image::block> bow_vocabulary_builder::make_blocks() const {
+    // each non-word node has a block of its children, whose node ID is the index of the node
+    std::vector<uint32_t> block_ids(nodes_.size(), 0);
+    uint32_t num_blocks = 0;
+    for (unsigned int idx = 0; idx < nodes_.size(); ++idx) {
+        if (!nodes_.at(idx).children_.empty()) {
+            block_ids.at(idx) = num_blocks++;
+        }
+    }
+
+    std::vector<bow_vocabulary_image::block> blocks(num_blocks);
+    for (unsigned int idx = 0; idx < nodes_.size(); ++idx) {
+        const auto& node = nodes_.at(idx);
+        if (node.children_.empty()) {
+            continue;
+        }
+        auto& blk = blocks.at(block_ids.at(idx));
+        blk.node_id_ = idx;
+        for (const auto child_idx : node.children_) {
+            const auto& child = nodes_.at(child_idx);
+            blk.descriptors_.insert(blk.descriptors_.end(), child.descriptor_.begin(), child.descriptor_.end());
+            if (child.children_.empty()) {
+                blk.children_.push_back(static_cast<uint32_t>(child.word_id_) | bow_vocabulary_image::word_flag);
+                blk.weights_.push_back(child.weight_);
+            }
+            else {
+                blk.children_.push_back(block_ids.at(child_idx));
+                blk.weights_.push_back(0.0f);
+            }
+        }
+    }
+    return blocks;
+}
+
+void bow_vocabulary_builder::save_dbow2(const std::string& path) const {
+#ifdef USE_DBOW2
+    dbow2_vocabulary_writer writer(k_, L_);
+    writer.set_nodes(nodes_);
+    writer.saveToBinaryFile(path);
+#else
+    (void)path;
+    throw std::runtime_error("the binary of DBoW2 is available only when built with DBoW2");
+#endif
+}
+
+void bow_vocabulary_builder::save_dbow2_text(const std::string& path) const {
+    std::ofstream ofs(path, std::ios::out);
+    if (!ofs.is_open()) {
+        throw std::runtime_error("cannot create a file at " + path);
+    }
+    // k, L, scoring (L1 norm) and weighting (TF-IDF), then "parent is_word descriptor weight" of each node except the root
+    ofs << k_ << " " << L_ << " " << 0 << " " << 0 << std::endl;
+    for (unsigned int idx = 1; idx < nodes_.size(); ++idx) {
+        const auto& node = nodes_.at(idx);
+        ofs << node.parent_ << " " << (node.children_.empty() ? 1 : 0) << " ";
+        for (const auto byte : node.descriptor_) {
+            ofs << static_cast<unsigned int>(byte) << " ";
+        }
+        ofs << node.weight_ << std::endl;
+    }
+    if (!ofs) {
+        throw std::runtime_error("cannot write the vocabulary to " + path);
+    }
+}
+
+} // namespace data
+} // namespace stella_vslam
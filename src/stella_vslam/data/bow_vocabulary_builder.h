@@ -0,0 +1,171 @@
+#ifndef STELLA_VSLAM_DATA_BOW_VOCABULARY_BUILDER_H
+#define STELLA_VSLAM_DATA_BOW_VOCABULARY_BUILDER_H
+
+#include "stella_vslam/data/bow_vocabulary_image.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace stella_vslam {
+
+namespace util {
+class thread_pool;
+} // namespace util
+
+namespace data {
+
+//! File formats of the vocabulary
+enum class bow_vocabulary_format_t {
+    //! binary of FBoW (the memory image of the node blocks)
+    FBoW,
+    //! binary of DBoW2 (written by DBoW2, then available only when built with USE_DBOW2)
+    DBoW2,
+    //! text of DBoW2 (the format of ORBvoc.txt)
+    DBoW2_Text,
+    //! vocabulary image which is memory-mapped on load (see bow_vocabulary_image)
+    Image
+};
+
+/**
+ * Builder of the BoW vocabulary of the ORB descriptors (hierarchical k-majority tree)
+ * The descriptors are added image by image, and subsampled by the reservoir sampling over the whole corpus
+ * if they exceed the capacity, then any size of the corpus can be streamed through a bounded memory.
+ * Each node is clustered by the k-majority (the k-means on the Hamming space whose centers are the bitwise majorities)
+ * with the k-means++ seeding, and the descriptors are reordered so that those of each child are contiguous.
+ * The assignment step scans the contiguous descriptors in blocks which fit in the cache,
+ * and accumulates the bit counts of the centers per block, which are reduced after all the blocks are scanned.
+ * The blocks of a large node are scanned in parallel, and the nodes of a level are clustered in parallel with each other.
+ * (NOTE: the tree built from the same samples with the same seed does not depend on the number of the threads)
+ */
+class bow_vocabulary_builder {
+public:
+    //! size of an ORB descriptor [bytes]
+    static constexpr unsigned int desc_size = 32;
+
+    //! Node of the tree (the root is nodes_.at(0))
+    struct node {
+        //! index of the parent node
+        unsigned int parent_ = 0;
+        //! indices of the child nodes (empty if the node is a word)
+        std::vector<unsigned int> children_;
+        //! center of the cluster
+        std::array<uint8_t, desc_size> descriptor_{};
+        //! IDF weight (of a word)
+        float weight_ = 0.0f;
+        //! ID of the word (-1 if not a word)
+        int word_id_ = -1;
+    };
+
+    /**
+     * Constructor
+     * @param k branching factor (2-255)
+     * @param L depth of the tree
+     * @param max_num_descs capacity of the descriptors used for the clustering
+     * @param max_num_iters max number of the iterations of the k-majority of each node
+     * @param seed
+     */
+    bow_vocabulary_builder(const unsigned int k = 10, const unsigned int L = 6,
+                           const size_t max_num_descs = 4000000, const unsigned int max_num_iters = 10,
+                           const unsigned int seed = 0);
+
+    /**
+     * Add the descriptors of an image (thread-safe)
+     * @param descs pointer to the first descriptor
+     * @param stride byte offset between consecutive descriptors
+     * @param num_descs
+     */
+    void add_image_descriptors(const uint8_t* descs, const size_t stride, const unsigned int num_descs);
+
+    //! Get the number of the added images
+    unsigned int get_num_images() const;
+
+    //! Get the number of the descriptors added so far (including those dropped by the sampling)
+    size_t get_num_seen_descriptors() const;
+
+    //! Get the number of the descriptors used for the clustering
+    size_t get_num_sampled_descriptors() const;
+
+    /**
+     * Build the tree from the sampled descriptors, and compute the IDF weights of the words
+     * @param pool the nodes are clustered on this thread only if nullptr
+     */
+    void build(util::thread_pool* pool = nullptr);
+
+    //! Get the nodes of the built tree
+    const std::vector<node>& get_nodes() const {
+        return nodes_;
+    }
+
+    //! Get the number of the words of the built tree
+    unsigned int get_num_words() const {
+        return num_words_;
+    }
+
+    //! Get the ID of the word into which the descriptor is quantized (in the same way as the transform of FBoW and DBoW2)
+    unsigned int quantize(const uint8_t* desc) const;
+
+    /**
+     * Save the built tree
+     * @param path
+     * @param format
+     */
+    void save(const std::string& path, const bow_vocabulary_format_t format) const;
+
+private:
+    //! Cluster the sampled descriptors in [begin, end) into at most k_ clusters,
+    //! then reorder them so that each cluster is contiguous, and return the centers and the ranges of the clusters
+    void cluster(const size_t begin, const size_t end, const unsigned int seed, util::thread_pool* pool,
+                 std::vector<std::array<uint8_t, desc_size>>& centers, std::vector<size_t>& cluster_ends);
+
+    //! Assign the descriptors in [begin, end) to the nearest centers block by block, and accumulate the bit counts of the centers
+    //! (assignments points to that of the descriptor at begin, and the number of the changed assignments is returned)
+    size_t assign(const size_t begin, const size_t end, const std::vector<std::array<uint8_t, desc_size>>& centers,
+                  uint8_t* assignments, std::vector<uint32_t>& bit_counts, std::vector<size_t>& cluster_sizes) const;
+
+    //! Compute the IDF weights of the words from the images of the sampled descriptors
+    void compute_weights(util::thread_pool* pool);
+
+    //! Convert the nodes into the blocks of the FBoW binary and the vocabulary image
+    std::vector<bow_vocabulary_image::block> make_blocks() const;
+
+    void save_dbow2(const std::string& path) const;
+    void save_dbow2_text(const std::string& path) const;
+
+    //! branching factor
+    const unsigned int k_;
+    //! depth of the tree
+    const unsigned int L_;
+    //! capacity of the descriptors
+    const size_t max_num_descs_;
+    //! max number of the iterations of the k-majority
+    const unsigned int max_num_iters_;
+    //! seed of the sampling and the clustering
+    const unsigned int seed_;
+
+    mutable std::mutex mtx_samples_;
+    //! random engine of the reservoir sampling
+    std::mt19937_64 sampling_rng_;
+    //! sampled descriptors (contiguous)
+    std::vector<uint8_t> descs_;
+    //! indices of the images of the sampled descriptors
+    std::vector<uint32_t> img_indices_;
+    //! number of the added images
+    unsigned int num_images_ = 0;
+    //! number of the added descriptors
+    size_t num_seen_descs_ = 0;
+
+    //! nodes of the tree
+    std::vector<node> nodes_;
+    //! number of the words (the leaves of the tree)
+    unsigned int num_words_ = 0;
+};
+
+} // namespace data
+} // namespace stella_vslam
+
+#endif // STELLA_VSLAM_DATA_BOW_VOCABULARY_BUILDER_H
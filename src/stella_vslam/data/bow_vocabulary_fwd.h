@@ -32,7 +32,8 @@ typedef DBoW2::FeatureVector bow_feature_vector;
 
 #else
 
-typedef fbow::Vocabulary bow_vocabulary;
+// derived from fbow::Vocabulary to hold the vocabulary image if loaded (see bow_vocabulary.h)
+class bow_vocabulary;
 typedef fbow::BoWVector bow_vector;
 typedef fbow::BoWFeatVector bow_feature_vector;
 
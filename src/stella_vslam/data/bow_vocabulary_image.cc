@@ -0,0 +1,356 @@
+#include "stella_vslam/data/bow_vocabulary_image.h"
+#include "stella_vslam/match/hamming.h"
+#include "stella_vslam/util/mapped_file.h"
+
+#ifdef USE_DBOW2
+#include <DBoW2/BowVector.h>
+#include <DBoW2/FeatureVector.h>
+#else
+#include <fbow/vocabulary.h>
+#endif // USE_DBOW2
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include <opencv2/core/mat.hpp>
+#include <spdlog/spdlog.h>
+
+namespace stella_vslam {
+namespace data {
+
+namespace {
+
+//! identifier at the beginning of the file
+constexpr char image_magic[8] = {'S', 'V', 'B', 'O', 'W', 'I', 'M', '\0'};
+//! version of the layout
+constexpr uint32_t image_version = 1;
+//! written in the native byte order to detect a mismatch on load
+constexpr uint32_t byte_order_mark = 0x01020304;
+//! alignment of each block
+constexpr uint64_t block_alignment = 64;
+
+struct image_header {
+    char magic_[8];
+    uint32_t version_;
+    uint32_t byte_order_mark_;
+    uint32_t desc_size_;
+    uint32_t k_;
+    uint32_t num_blocks_;
+    uint32_t num_words_;
+    uint64_t block_stride_;
+    uint8_t reserved_[24];
+};
+
+static_assert(sizeof(image_header) == block_alignment, "image_header must not have implicit padding");
+
+//! header of the FBoW binary which follows the signature (see fbow::Vocabulary::toStream())
+struct fbow_params {
+    char desc_name_[50];
+    uint32_t aligment_, nblocks_;
+    uint64_t desc_size_bytes_wp_, block_size_bytes_wp_, feature_off_start_, child_off_start_, total_size_;
+    int32_t desc_type_, desc_size_;
+    uint32_t m_k_;
+};
+
+//! signature at the beginning of the FBoW binary
+constexpr uint64_t fbow_signature = 55824124;
+//! (fbow identifies the 8-bit descriptors by CV_8UC1, which is 0)
+constexpr int32_t fbow_desc_type_8u = 0;
+constexpr uint32_t fbow_aligment = 8;
+
+// number of the children (uint32), ID of the node (uint32), then the descriptors, the children (uint32) and the weights (float)
+uint64_t get_block_stride(const uint64_t k) {
+    const uint64_t size = 2 * sizeof(uint32_t) + k * (bow_vocabulary_image::desc_size + sizeof(uint32_t) + sizeof(float));
+    return (size + block_alignment - 1) / block_alignment * block_alignment;
+}
+
+} // namespace
+
+constexpr unsigned int bow_vocabulary_image::desc_size;
+constexpr uint32_t bow_vocabulary_image::word_flag;
+
+bool bow_vocabulary_image::is_image(const std::string& path) {
+    std::ifstream ifs(path, std::ios::in | std::ios::binary);
+    char magic[sizeof(image_magic)];
+    if (!ifs.read(magic, sizeof(magic))) {
+        return false;
+    }
+    return std::memcmp(magic, image_magic, sizeof(image_magic)) == 0;
+}
+
+void bow_vocabulary_image::save(const std::string& path, const unsigned int k, const std::vector<block>& blocks) {
+    if (blocks.empty()) {
+        throw std::runtime_error("the vocabulary image must have the root block");
+    }
+    image_header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic_, image_magic, sizeof(image_magic));
+    header.version_ = image_version;
+    header.byte_order_mark_ = byte_order_mark;
+    header.desc_size_ = desc_size;
+    header.k_ = k;
+    header.num_blocks_ = blocks.size();
+    header.block_stride_ = get_block_stride(k);
+
+    const size_t children_offset = 2 * sizeof(uint32_t) + k * desc_size;
+    const size_t weights_offset = children_offset + k * sizeof(uint32_t);
+    std::vector<uint8_t> data(header.block_stride_ * blocks.size(), 0);
+    for (unsigned int idx = 0; idx < blocks.size(); ++idx) {
+        const auto& blk = blocks.at(idx);
+        const uint32_t num_children = blk.children_.size();
+        if (num_children == 0 || k < num_children
+            || blk.descriptors_.size() != num_children * desc_size || blk.weights_.size() != num_children) {
+            throw std::runtime_error("invalid block of the vocabulary image: " + std::to_string(idx));
+        }
+        for (const auto child : blk.children_) {
+            if (child & word_flag) {
+                header.num_words_ = std::max(header.num_words_, (child & ~word_flag) + 1);
+            }
+            else if (blocks.size() <= child) {
+                throw std::runtime_error("invalid block of the vocabulary image: " + std::to_string(idx));
+            }
+        }
+        uint8_t* dst = data.data() + idx * header.block_stride_;
+        std::memcpy(dst, &num_children, sizeof(uint32_t));
+        std::memcpy(dst + sizeof(uint32_t), &blk.node_id_, sizeof(uint32_t));
+        std::memcpy(dst + 2 * sizeof(uint32_t), blk.descriptors_.data(), blk.descriptors_.size());
+        std::memcpy(dst + children_offset, blk.children_.data(), num_children * sizeof(uint32_t));
+        std::memcpy(dst + weights_offset, blk.weights_.data(), num_children * sizeof(float));
+    }
+
+    std::ofstream ofs(path, std::ios::out | std::ios::binary);
+    if (!ofs.is_open()) {
+        throw std::runtime_error("cannot create a file at " + path);
+    }
+    ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    ofs.write(reinterpret_cast<const char*>(data.data()), data.size());
+    if (!ofs) {
+        throw std::runtime_error("cannot write the vocabulary image to " + path);
+    }
+}
+
+void bow_vocabulary_image::save_fbow(const std::string& path, const unsigned int k, const std::vector<block>& blocks) {
+    fbow_params params;
+    std::memset(&params, 0, sizeof(params));
+    std::strcpy(params.desc_name_, "orb");
+    params.aligment_ = fbow_aligment;
+    params.nblocks_ = blocks.size();
+    params.desc_size_bytes_wp_ = desc_size;
+    // block: number of the children (uint16), all children are words or not (uint16), ID of the node (uint32),
+    // the descriptors of the children, then the IDs of the words or the blocks of the children with the weights
+    params.feature_off_start_ = 2 * sizeof(uint16_t) + sizeof(uint32_t);
+    params.child_off_start_ = params.feature_off_start_ + k * params.desc_size_bytes_wp_;
+    params.block_size_bytes_wp_ = params.child_off_start_ + k * (sizeof(uint32_t) + sizeof(float));
+    params.total_size_ = params.block_size_bytes_wp_ * blocks.size();
+    params.desc_type_ = fbow_desc_type_8u;
+    params.desc_size_ = desc_size;
+    params.m_k_ = k;
+
+    std::vector<char> data(params.total_size_, 0);
+    for (unsigned int idx = 0; idx < blocks.size(); ++idx) {
+        const auto& blk = blocks.at(idx);
+        const uint16_t num_children = blk.children_.size();
+        if (num_children == 0 || k < num_children
+            || blk.descriptors_.size() != num_children * desc_size || blk.weights_.size() != num_children) {
+            throw std::runtime_error("invalid block of the vocabulary: " + std::to_string(idx));
+        }
+        char* dst = data.data() + idx * params.block_size_bytes_wp_;
+        uint16_t all_children_are_words = 1;
+        for (unsigned int c = 0; c < num_children; ++c) {
+            std::memcpy(dst + params.feature_off_start_ + c * params.desc_size_bytes_wp_, blk.descriptors_.data() + c * desc_size, desc_size);
+            if (!(blk.children_.at(c) & word_flag)) {
+                all_children_are_words = 0;
+            }
+            char* info = dst + params.child_off_start_ + c * (sizeof(uint32_t) + sizeof(float));
+            std::memcpy(info, &blk.children_.at(c), sizeof(uint32_t));
+            std::memcpy(info + sizeof(uint32_t), &blk.weights_.at(c), sizeof(float));
+        }
+        std::memcpy(dst, &num_children, sizeof(uint16_t));
+        std::memcpy(dst + sizeof(uint16_t), &all_children_are_words, sizeof(uint16_t));
+        std::memcpy(dst + 2 * sizeof(uint16_t), &blk.node_id_, sizeof(uint32_t));
+    }
+
+    std::ofstream ofs(path, std::ios::out | std::ios::binary);
+    if (!ofs.is_open()) {
+        throw std::runtime_error("cannot create a file at " + path);
+    }
+    ofs.write(reinterpret_cast<const char*>(&fbow_signature), sizeof(fbow_signature));
+    ofs.write(reinterpret_cast<const char*>(&params), sizeof(params));
+    ofs.write(data.data(), data.size());
+    if (!ofs) {
+        throw std::runtime_error("cannot write the vocabulary to " + path);
+    }
+}
+
+void bow_vocabulary_image::convert_from_fbow(const std::string& fbow_path, const std::string& image_path) {
+    const util::mapped_file file(fbow_path);
+    uint64_t signature = 0;
+    fbow_params params;
+    if (file.size() < sizeof(signature) + sizeof(params)) {
+        throw std::runtime_error("corrupted FBoW vocabulary: too small " + fbow_path);
+    }
+    std::memcpy(&signature, file.data(), sizeof(signature));
+    std::memcpy(&params, file.data() + sizeof(signature), sizeof(params));
+    if (signature != fbow_signature) {
+        throw std::runtime_error("not a FBoW vocabulary: " + fbow_path);
+    }
+    if (params.desc_type_ != fbow_desc_type_8u || params.desc_size_ != static_cast<int32_t>(desc_size)) {
+        throw std::runtime_error("the FBoW vocabulary is not of the ORB descriptors: " + fbow_path);
+    }
+    const uint64_t header_size = sizeof(signature) + sizeof(params);
+    if (params.total_size_ != params.block_size_bytes_wp_ * params.nblocks_
+        || file.size() - header_size < params.total_size_
+        || params.desc_size_bytes_wp_ < desc_size
+        || params.block_size_bytes_wp_ < params.child_off_start_ + params.m_k_ * (sizeof(uint32_t) + sizeof(float))
+        || params.child_off_start_ < params.feature_off_start_ + params.m_k_ * params.desc_size_bytes_wp_) {
+        throw std::runtime_error("corrupted FBoW vocabulary: " + fbow_path);
+    }
+
+    std::vector<block> blocks(params.nblocks_);
+    for (unsigned int idx = 0; idx < params.nblocks_; ++idx) {
+        const uint8_t* src = file.data() + header_size + idx * params.block_size_bytes_wp_;
+        uint16_t num_children = 0;
+        std::memcpy(&num_children, src, sizeof(uint16_t));
+        if (num_children == 0 || params.m_k_ < num_children) {
+            throw std::runtime_error("corrupted FBoW vocabulary: " + fbow_path);
+        }
+        auto& blk = blocks.at(idx);
+        std::memcpy(&blk.node_id_, src + 2 * sizeof(uint16_t), sizeof(uint32_t));
+        blk.descriptors_.resize(num_children * desc_size);
+        blk.children_.resize(num_children);
+        blk.weights_.resize(num_children);
+        for (unsigned int c = 0; c < num_children; ++c) {
+            std::memcpy(blk.descriptors_.data() + c * desc_size,
+                        src + params.feature_off_start_ + c * params.desc_size_bytes_wp_, desc_size);
+            const uint8_t* info = src + params.child_off_start_ + c * (sizeof(uint32_t) + sizeof(float));
+            uint32_t id_or_child_block = 0;
+            std::memcpy(&id_or_child_block, info, sizeof(uint32_t));
+            std::memcpy(&blk.weights_.at(c), info + sizeof(uint32_t), sizeof(float));
+            blk.children_.at(c) = id_or_child_block;
+            if (!(id_or_child_block & word_flag)) {
+                blk.weights_.at(c) = 0.0f;
+            }
+        }
+    }
+    save(image_path, params.m_k_, blocks);
+    spdlog::info("convert vocabulary: {} -> {} ({} blocks)", fbow_path, image_path, blocks.size());
+}
+
+bow_vocabulary_image::bow_vocabulary_image(const std::string& path)
+    : file_(new util::mapped_file(path)) {
+    if (!file_->is_mapped()) {
+        spdlog::warn("the vocabulary image is copied since it cannot be memory-mapped");
+    }
+
+    image_header header;
+    if (file_->size() < sizeof(header)) {
+        throw std::runtime_error("corrupted vocabulary image: too small " + path);
+    }
+    std::memcpy(&header, file_->data(), sizeof(header));
+    if (std::memcmp(header.magic_, image_magic, sizeof(image_magic)) != 0) {
+        throw std::runtime_error("not a vocabulary image: " + path);
+    }
+    if (header.version_ != image_version) {
+        throw std::runtime_error("unsupported version of the vocabulary image: " + std::to_string(header.version_));
+    }
+    if (header.byte_order_mark_ != byte_order_mark) {
+        throw std::runtime_error("the vocabulary image was written with a different byte order");
+    }
+    if (header.desc_size_ != desc_size) {
+        throw std::runtime_error("the vocabulary image is not of the ORB descriptors: " + path);
+    }
+    if (header.k_ == 0 || header.num_blocks_ == 0 || header.block_stride_ != get_block_stride(header.k_)
+        || (file_->size() - sizeof(header)) / header.block_stride_ < header.num_blocks_) {
+        throw std::runtime_error("corrupted vocabulary image: " + path);
+    }
+
+    k_ = header.k_;
+    num_blocks_ = header.num_blocks_;
+    num_words_ = header.num_words_;
+    block_stride_ = header.block_stride_;
+    children_offset_ = 2 * sizeof(uint32_t) + k_ * desc_size;
+    weights_offset_ = children_offset_ + k_ * sizeof(uint32_t);
+}
+
+bow_vocabulary_image::~bow_vocabulary_image() = default;
+
+const uint8_t* bow_vocabulary_image::get_block(const uint32_t block_idx) const {
+    return file_->data() + sizeof(image_header) + block_idx * block_stride_;
+}
+
+void bow_vocabulary_image::transform(const uint8_t* descs, const size_t stride, const unsigned int num_descs, const unsigned int level,
+                                     bow_vector& bow_vec, bow_feature_vector& bow_feat_vec) const {
+    bow_vec.clear();
+    bow_feat_vec.clear();
+    std::vector<unsigned int> dists(k_);
+    for (unsigned int idx = 0; idx < num_descs; ++idx) {
+        const uint8_t* desc = descs + idx * stride;
+        uint32_t block_idx = 0;
+        unsigned int cur_level = 0;
+        bool is_feat_added = false;
+        while (true) {
+            const uint8_t* blk = get_block(block_idx);
+            uint32_t num_children = 0;
+            uint32_t node_id = 0;
+            std::memcpy(&num_children, blk, sizeof(uint32_t));
+            std::memcpy(&node_id, blk + sizeof(uint32_t), sizeof(uint32_t));
+            if (num_children == 0 || k_ < num_children) {
+                throw std::runtime_error("corrupted vocabulary image: block " + std::to_string(block_idx));
+            }
+
+            // the nearest child (the first one if tied, in the same way as FBoW)
+            match::compute_hamming_distances_256(desc, blk + 2 * sizeof(uint32_t), desc_size, num_children, dists.data());
+            unsigned int best_c = 0;
+            for (unsigned int c = 1; c < num_children; ++c) {
+                if (dists.at(c) < dists.at(best_c)) {
+                    best_c = c;
+                }
+            }
+
+            if (cur_level == level) {
+                bow_feat_vec[node_id].push_back(idx);
+                is_feat_added = true;
+            }
+
+            uint32_t child = 0;
+            std::memcpy(&child, blk + children_offset_ + best_c * sizeof(uint32_t), sizeof(uint32_t));
+            if (child & word_flag) {
+                float weight = 0.0f;
+                std::memcpy(&weight, blk + weights_offset_ + best_c * sizeof(float), sizeof(float));
+                bow_vec[child & ~word_flag] += weight;
+                if (!is_feat_added) {
+                    bow_feat_vec[node_id].push_back(idx);
+                }
+                break;
+            }
+            // (the depth is bounded by the number of the blocks unless the image is corrupted)
+            if (num_blocks_ <= child || num_blocks_ <= ++cur_level) {
+                throw std::runtime_error("corrupted vocabulary image: block " + std::to_string(block_idx));
+            }
+            block_idx = child;
+        }
+    }
+
+    // L1 normalization
+    double sum = 0.0;
+    for (const auto& word_weight : bow_vec) {
+        sum += word_weight.second;
+    }
+    if (0.0 < sum) {
+        for (auto& word_weight : bow_vec) {
+            word_weight.second /= sum;
+        }
+    }
+}
+
+void bow_vocabulary_image::transform(const cv::Mat& descs, const unsigned int level, bow_vector& bow_vec, bow_feature_vector& bow_feat_vec) const {
+    if (!descs.empty() && descs.cols != static_cast<int>(desc_size)) {
+        throw std::runtime_error("the descriptors are not of ORB: " + std::to_string(descs.cols) + " bytes");
+    }
+    transform(descs.ptr<uint8_t>(), descs.step[0], descs.rows, level, bow_vec, bow_feat_vec);
+}
+
+} // namespace data
+} // namespace stella_vslam
@@ -0,0 +1,120 @@
+#ifndef STELLA_VSLAM_DATA_BOW_VOCABULARY_IMAGE_H
+#define STELLA_VSLAM_DATA_BOW_VOCABULARY_IMAGE_H
+
+#include "stella_vslam/data/bow_vocabulary_fwd.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace cv {
+class Mat;
+} // namespace cv
+
+namespace stella_vslam {
+
+namespace util {
+class mapped_file;
+} // namespace util
+
+namespace data {
+
+/**
+ * Read-only vocabulary of the ORB descriptors which is used in place of the file image (e.g. memory-mapped)
+ * The file consists of a 64-byte header and the blocks of the non-word nodes (the root is the first block).
+ * Each block is 64-byte aligned, and consists of the number of the children and the ID of the node (uint32 each),
+ * the descriptors of the children, the IDs of the words (with word_flag) or the indices of the blocks of the children (uint32 each),
+ * and the weights of the children (float each).
+ * The image is not parsed nor copied on load, then the pages are shared among the processes which map the same file.
+ * (NOTE: the IDs of the nodes and the words are kept from the FBoW binary which the image is converted from,
+ *  then the BoW (feature) vectors are compatible with those computed by FBoW, e.g. stored in the maps)
+ */
+class bow_vocabulary_image {
+public:
+    //! size of an ORB descriptor [bytes]
+    static constexpr unsigned int desc_size = 32;
+    //! flag of the child which is a word (the same as FBoW)
+    static constexpr uint32_t word_flag = 0x80000000;
+
+    //! Block of a non-word node (to save the image)
+    struct block {
+        //! ID of the node
+        uint32_t node_id_ = 0;
+        //! descriptors of the children (desc_size x the number of the children)
+        std::vector<uint8_t> descriptors_;
+        //! IDs of the words (with word_flag) or the indices of the blocks of the children
+        std::vector<uint32_t> children_;
+        //! weights of the children (0 if not a word)
+        std::vector<float> weights_;
+    };
+
+    //! Check whether the file is a vocabulary image or not
+    static bool is_image(const std::string& path);
+
+    //! Save the blocks as a vocabulary image with the branching factor k (the root is blocks.at(0))
+    static void save(const std::string& path, const unsigned int k, const std::vector<block>& blocks);
+
+    //! Save the blocks as a FBoW binary with the branching factor k (the root is blocks.at(0))
+    static void save_fbow(const std::string& path, const unsigned int k, const std::vector<block>& blocks);
+
+    //! Convert the FBoW binary of the ORB descriptors into a vocabulary image
+    static void convert_from_fbow(const std::string& fbow_path, const std::string& image_path);
+
+    //! Map the vocabulary image (throw std::runtime_error if it is not valid)
+    explicit bow_vocabulary_image(const std::string& path);
+
+    //! Destructor (unmap the image)
+    ~bow_vocabulary_image();
+
+    bow_vocabulary_image(const bow_vocabulary_image&) = delete;
+    bow_vocabulary_image& operator=(const bow_vocabulary_image&) = delete;
+
+    //! Get the branching factor
+    unsigned int get_branching_factor() const {
+        return k_;
+    }
+
+    //! Get the number of the words
+    unsigned int get_num_words() const {
+        return num_words_;
+    }
+
+    /**
+     * Compute the BoW vector (L1-normalized) and the BoW feature vector of the descriptors in the same way as FBoW
+     * @param descs pointer to the first descriptor
+     * @param stride byte offset between consecutive descriptors
+     * @param num_descs
+     * @param level depth of the nodes of the BoW feature vector from the root (or the nodes whose children are words if shallower)
+     * @param bow_vec
+     * @param bow_feat_vec
+     */
+    void transform(const uint8_t* descs, const size_t stride, const unsigned int num_descs, const unsigned int level,
+                   bow_vector& bow_vec, bow_feature_vector& bow_feat_vec) const;
+
+    //! Compute the BoW vector and the BoW feature vector of the descriptors (a row per descriptor)
+    void transform(const cv::Mat& descs, const unsigned int level, bow_vector& bow_vec, bow_feature_vector& bow_feat_vec) const;
+
+private:
+    //! Get the pointer to the block
+    const uint8_t* get_block(const uint32_t block_idx) const;
+
+    std::unique_ptr<util::mapped_file> file_;
+    //! branching factor
+    unsigned int k_ = 0;
+    //! number of the blocks
+    unsigned int num_blocks_ = 0;
+    //! number of the words
+    unsigned int num_words_ = 0;
+    //! byte offset between consecutive blocks
+    size_t block_stride_ = 0;
+    //! offsets of the children and the weights in a block
+    size_t children_offset_ = 0;
+    size_t weights_offset_ = 0;
+};
+
+} // namespace data
+} // namespace stella_vslam
+
+#endif // STELLA_VSLAM_DATA_BOW_VOCABULARY_IMAGE_H
@@ -261,9 +261,6 @@ bool camera_database::to_db(sqlite3* db) const {
         stmt_str += ");";
         ret = sqlite3_exec(db, stmt_str.c_str(), nullptr, nullptr, nullptr);
     }
-    if (ret == SQLITE_OK) {
-        ret = sqlite3_exec(db, "BEGIN;", nullptr, nullptr, nullptr);
-    }
     sqlite3_stmt* stmt = nullptr;
     if (ret == SQLITE_OK) {
         std::string stmt_str = "INSERT INTO cameras(id";
@@ -421,14 +418,7 @@ bool camera_database::to_db(sqlite3* db) const {
         }
     }
     sqlite3_finalize(stmt);
-    ret = sqlite3_exec(db, "COMMIT;", nullptr, nullptr, nullptr);
-    if (ret != SQLITE_OK) {
-        spdlog::error("SQLite error (commit): {}", sqlite3_errmsg(db));
-        return false;
-    }
-    else {
-        return true;
-    }
+    return true;
 }
 
 } // namespace data
@@ -32,6 +32,7 @@ public:
 
     bool from_db(sqlite3* db);
 
+    //! (NOTE: the caller must begin and commit the transaction)
     bool to_db(sqlite3* db) const;
 
 private:
@@ -4,6 +4,11 @@
 #include "stella_vslam/camera/fisheye.h"
 #include "stella_vslam/camera/equirectangular.h"
 #include "stella_vslam/camera/radial_division.h"
+#include "stella_vslam/util/blob_codec.h"
+
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
 
 #include <nlohmann/json.hpp>
 
@@ -29,7 +34,45 @@ Vec3_t convert_json_to_translation(const nlohmann::json& json_trans_cw) {
     return trans_cw;
 }
 
-nlohmann::json convert_keypoints_to_json(const std::vector<cv::KeyPoint>& keypts) {
+namespace {
+//! Quantization step of the keypoint positions in the blob
+constexpr float keypt_pos_scale = 32.0;
+//! Quantization step of the keypoint angles in the blob (0xffff means the angle is not computed)
+constexpr float keypt_angle_scale = 65535.0 / 360.0;
+constexpr uint16_t keypt_no_angle = 0xffff;
+//! Size of each keypoint in the blob (x, y, angle and octave)
+constexpr size_t keypt_blob_size = sizeof(int32_t) * 2 + sizeof(uint16_t) + sizeof(uint8_t);
+
+nlohmann::json convert_bytes_to_json(const void* data, const size_t size, const observation_encoding_t encoding) {
+    return util::blob_codec::encode(data, size, encoding == observation_encoding_t::Compressed);
+}
+} // namespace
+
+nlohmann::json convert_keypoints_to_json(const std::vector<cv::KeyPoint>& keypts, const observation_encoding_t encoding) {
+    if (encoding != observation_encoding_t::Json) {
+        // the fields are stored separately (structure of arrays) to make them compressible
+        const auto num_keypts = keypts.size();
+        std::vector<uint8_t> bytes(num_keypts * keypt_blob_size);
+        auto* xs = bytes.data();
+        auto* ys = xs + num_keypts * sizeof(int32_t);
+        auto* angles = ys + num_keypts * sizeof(int32_t);
+        auto* octaves = angles + num_keypts * sizeof(uint16_t);
+        for (unsigned int idx = 0; idx < num_keypts; ++idx) {
+            const auto& keypt = keypts.at(idx);
+            const auto x = static_cast<int32_t>(std::lround(keypt.pt.x * keypt_pos_scale));
+            const auto y = static_cast<int32_t>(std::lround(keypt.pt.y * keypt_pos_scale));
+            const auto angle = keypt.angle < 0
+                                   ? keypt_no_angle
+                                   : static_cast<uint16_t>(std::lround(keypt.angle * keypt_angle_scale) % keypt_no_angle);
+            const auto octave = static_cast<uint8_t>(keypt.octave);
+            std::memcpy(xs + idx * sizeof(int32_t), &x, sizeof(int32_t));
+            std::memcpy(ys + idx * sizeof(int32_t), &y, sizeof(int32_t));
+            std::memcpy(angles + idx * sizeof(uint16_t), &angle, sizeof(uint16_t));
+            octaves[idx] = octave;
+        }
+        return convert_bytes_to_json(bytes.data(), bytes.size(), encoding);
+    }
+
     std::vector<nlohmann::json> json_keypts(keypts.size());
     for (unsigned int idx = 0; idx < keypts.size(); ++idx) {
         json_keypts.at(idx) = {{"pt", {keypts.at(idx).pt.x, keypts.at(idx).pt.y}},
@@ -40,6 +83,34 @@ nlohmann::json convert_keypoints_to_json(const std::vector<cv::KeyPoint>& keypts
 }
 
 std::vector<cv::KeyPoint> convert_json_to_keypoints(const nlohmann::json& json_keypts) {
+    if (json_keypts.is_string()) {
+        const auto bytes = util::blob_codec::decode(json_keypts.get_ref<const std::string&>());
+        if (bytes.size() % keypt_blob_size != 0) {
+            throw std::runtime_error("corrupted keypoints blob");
+        }
+        const auto num_keypts = bytes.size() / keypt_blob_size;
+        const auto* xs = bytes.data();
+        const auto* ys = xs + num_keypts * sizeof(int32_t);
+        const auto* angles = ys + num_keypts * sizeof(int32_t);
+        const auto* octaves = angles + num_keypts * sizeof(uint16_t);
+        std::vector<cv::KeyPoint> keypts(num_keypts);
+        for (unsigned int idx = 0; idx < num_keypts; ++idx) {
+            int32_t x, y;
+            uint16_t angle;
+            std::memcpy(&x, xs + idx * sizeof(int32_t), sizeof(int32_t));
+            std::memcpy(&y, ys + idx * sizeof(int32_t), sizeof(int32_t));
+            std::memcpy(&angle, angles + idx * sizeof(uint16_t), sizeof(uint16_t));
+            keypts.at(idx) = cv::KeyPoint(x / keypt_pos_scale,
+                                          y / keypt_pos_scale,
+                                          0,
+                                          angle == keypt_no_angle ? -1.0f : angle / keypt_angle_scale,
+                                          0,
+                                          octaves[idx],
+                                          -1);
+        }
+        return keypts;
+    }
+
     std::vector<cv::KeyPoint> keypts(json_keypts.size());
     for (unsigned int idx = 0; idx < json_keypts.size(); ++idx) {
         const auto& json_keypt = json_keypts.at(idx);
@@ -54,7 +125,16 @@ std::vector<cv::KeyPoint> convert_json_to_keypoints(const nlohmann::json& json_k
     return keypts;
 }
 
-nlohmann::json convert_descriptors_to_json(const cv::Mat& descriptors) {
+nlohmann::json convert_descriptors_to_json(const cv::Mat& descriptors, const observation_encoding_t encoding) {
+    if (encoding != observation_encoding_t::Json) {
+        assert(descriptors.empty() || (descriptors.cols == 32 && descriptors.type() == CV_8U));
+        if (descriptors.isContinuous()) {
+            return convert_bytes_to_json(descriptors.data, descriptors.total(), encoding);
+        }
+        const cv::Mat continuous_descriptors = descriptors.clone();
+        return convert_bytes_to_json(continuous_descriptors.data, continuous_descriptors.total(), encoding);
+    }
+
     std::vector<nlohmann::json> json_descriptors(descriptors.rows);
     for (int idx = 0; idx < descriptors.rows; ++idx) {
         const cv::Mat& desc = descriptors.row(idx);
@@ -69,6 +149,18 @@ nlohmann::json convert_descriptors_to_json(const cv::Mat& descriptors) {
 }
 
 cv::Mat convert_json_to_descriptors(const nlohmann::json& json_descriptors) {
+    if (json_descriptors.is_string()) {
+        const auto bytes = util::blob_codec::decode(json_descriptors.get_ref<const std::string&>());
+        if (bytes.size() % 32 != 0) {
+            throw std::runtime_error("corrupted descriptors blob");
+        }
+        cv::Mat descriptors(bytes.size() / 32, 32, CV_8U);
+        if (!bytes.empty()) {
+            std::memcpy(descriptors.data, bytes.data(), bytes.size());
+        }
+        return descriptors;
+    }
+
     cv::Mat descriptors(json_descriptors.size(), 32, CV_8U);
     for (unsigned int idx = 0; idx < json_descriptors.size(); ++idx) {
         const auto& json_descriptor = json_descriptors.at(idx);
@@ -80,92 +172,109 @@ cv::Mat convert_json_to_descriptors(const nlohmann::json& json_descriptors) {
     return descriptors;
 }
 
-void assign_keypoints_to_grid(const camera::base* camera, const std::vector<cv::KeyPoint>& undist_keypts,
-                              std::vector<std::vector<std::vector<unsigned int>>>& keypt_indices_in_cells) {
-    // Pre-allocate memory
-    const unsigned int num_keypts = undist_keypts.size();
-    const unsigned int num_to_reserve = 0.5 * num_keypts / (camera->num_grid_cols_ * camera->num_grid_rows_);
-    keypt_indices_in_cells.resize(camera->num_grid_cols_);
-    for (auto& keypt_indices_in_row : keypt_indices_in_cells) {
-        keypt_indices_in_row.resize(camera->num_grid_rows_);
-        for (auto& keypt_indices_in_cell : keypt_indices_in_row) {
-            keypt_indices_in_cell.reserve(num_to_reserve);
+nlohmann::json convert_floats_to_json(const std::vector<float>& values, const observation_encoding_t encoding) {
+    if (encoding != observation_encoding_t::Json) {
+        return convert_bytes_to_json(values.data(), values.size() * sizeof(float), encoding);
+    }
+    return values;
+}
+
+std::vector<float> convert_json_to_floats(const nlohmann::json& json_values) {
+    if (json_values.is_string()) {
+        const auto bytes = util::blob_codec::decode(json_values.get_ref<const std::string&>());
+        if (bytes.size() % sizeof(float) != 0) {
+            throw std::runtime_error("corrupted floats blob");
         }
+        std::vector<float> values(bytes.size() / sizeof(float));
+        if (!bytes.empty()) {
+            std::memcpy(values.data(), bytes.data(), bytes.size());
+        }
+        return values;
     }
+    return json_values.get<std::vector<float>>();
+}
 
-    // Calculate cell position and store
+void assign_keypoints_to_grid(const camera::base* camera, const std::vector<cv::KeyPoint>& undist_keypts,
+                              keypoint_grid& keypt_indices_in_cells) {
+    // Calculate cell position of each keypoint
+    const unsigned int num_keypts = undist_keypts.size();
+    std::vector<int> cell_indices(num_keypts, -1);
     for (unsigned int idx = 0; idx < num_keypts; ++idx) {
         const auto& keypt = undist_keypts.at(idx);
         int cell_idx_x, cell_idx_y;
         if (get_cell_indices(camera, keypt, cell_idx_x, cell_idx_y)) {
-            keypt_indices_in_cells.at(cell_idx_x).at(cell_idx_y).push_back(idx);
+            cell_indices.at(idx) = cell_idx_x * camera->num_grid_rows_ + cell_idx_y;
         }
     }
+
+    // Store them in CSR format
+    keypt_indices_in_cells.assign(camera->num_grid_cols_, camera->num_grid_rows_, cell_indices);
 }
 
 auto assign_keypoints_to_grid(const camera::base* camera, const std::vector<cv::KeyPoint>& undist_keypts)
-    -> std::vector<std::vector<std::vector<unsigned int>>> {
-    std::vector<std::vector<std::vector<unsigned int>>> keypt_indices_in_cells;
+    -> keypoint_grid {
+    keypoint_grid keypt_indices_in_cells;
     assign_keypoints_to_grid(camera, undist_keypts, keypt_indices_in_cells);
     return keypt_indices_in_cells;
 }
 
-std::vector<unsigned int> get_keypoints_in_cell(const camera::base* camera, const data::frame_observation& frm_obs,
-                                                const float ref_x, const float ref_y, const float margin,
-                                                const int min_level, const int max_level) {
-    return get_keypoints_in_cell(camera, frm_obs.undist_keypts_, frm_obs.keypt_indices_in_cells_, ref_x, ref_y, margin, min_level, max_level);
-}
+namespace {
 
-std::vector<unsigned int> get_keypoints_in_cell(const camera::base* camera, const std::vector<cv::KeyPoint>& undist_keypts,
-                                                const std::vector<std::vector<std::vector<unsigned int>>>& keypt_indices_in_cells,
-                                                const float ref_x, const float ref_y, const float margin,
-                                                const int min_level, const int max_level) {
-    std::vector<unsigned int> indices;
-    indices.reserve(undist_keypts.size());
+//! Collect the keypoint indices around the reference point
+//! (Keypoints is cv::KeyPoint vector or keypoints_soa, accessed via get_x/get_y/get_octave)
+template<typename Keypoints, typename GetX, typename GetY, typename GetOctave>
+void get_keypoints_in_cell_impl(const camera::base* camera, const Keypoints& undist_keypts,
+                                const keypoint_grid& keypt_indices_in_cells,
+                                const float ref_x, const float ref_y, const float margin,
+                                const int min_level, const int max_level,
+                                GetX get_x, GetY get_y, GetOctave get_octave,
+                                std::vector<unsigned int>& indices) {
+    indices.clear();
 
     const int min_cell_idx_x = std::max(0, cvFloor((ref_x - camera->img_bounds_.min_x_ - margin) * camera->inv_cell_width_));
     if (static_cast<int>(camera->num_grid_cols_) <= min_cell_idx_x) {
-        return indices;
+        return;
     }
 
     const int max_cell_idx_x = std::min(static_cast<int>(camera->num_grid_cols_ - 1), cvCeil((ref_x - camera->img_bounds_.min_x_ + margin) * camera->inv_cell_width_));
     if (max_cell_idx_x < 0) {
-        return indices;
+        return;
     }
 
     const int min_cell_idx_y = std::max(0, cvFloor((ref_y - camera->img_bounds_.min_y_ - margin) * camera->inv_cell_height_));
     if (static_cast<int>(camera->num_grid_rows_) <= min_cell_idx_y) {
-        return indices;
+        return;
     }
 
     const int max_cell_idx_y = std::min(static_cast<int>(camera->num_grid_rows_ - 1), cvCeil((ref_y - camera->img_bounds_.min_y_ + margin) * camera->inv_cell_height_));
     if (max_cell_idx_y < 0) {
-        return indices;
+        return;
     }
 
     const bool check_level = (0 < min_level) || (0 <= max_level);
 
     for (int cell_idx_x = min_cell_idx_x; cell_idx_x <= max_cell_idx_x; ++cell_idx_x) {
         for (int cell_idx_y = min_cell_idx_y; cell_idx_y <= max_cell_idx_y; ++cell_idx_y) {
-            const auto& keypt_indices_in_cell = keypt_indices_in_cells.at(cell_idx_x).at(cell_idx_y);
+            const auto keypt_indices_in_cell = keypt_indices_in_cells.cell(cell_idx_x, cell_idx_y);
             if (keypt_indices_in_cell.empty()) {
                 continue;
             }
 
             for (unsigned int idx : keypt_indices_in_cell) {
-                const auto& undist_keypt = undist_keypts.at(idx);
+                assert(idx < undist_keypts.size());
 
                 if (check_level) {
-                    if (undist_keypt.octave < min_level) {
+                    const int octave = get_octave(undist_keypts, idx);
+                    if (octave < min_level) {
                         continue;
                     }
-                    if (0 <= max_level && max_level < undist_keypt.octave) {
+                    if (0 <= max_level && max_level < octave) {
                         continue;
                     }
                 }
 
-                const float dist_x = undist_keypt.pt.x - ref_x;
-                const float dist_y = undist_keypt.pt.y - ref_y;
+                const float dist_x = get_x(undist_keypts, idx) - ref_x;
+                const float dist_y = get_y(undist_keypts, idx) - ref_y;
 
                 if (std::abs(dist_x) < margin && std::abs(dist_y) < margin) {
                     indices.push_back(idx);
@@ -173,10 +282,70 @@ std::vector<unsigned int> get_keypoints_in_cell(const camera::base* camera, cons
             }
         }
     }
+}
+
+} // namespace
+
+std::vector<unsigned int> get_keypoints_in_cell(const camera::base* camera, const data::frame_observation& frm_obs,
+                                                const float ref_x, const float ref_y, const float margin,
+                                                const int min_level, const int max_level) {
+    if (frm_obs.undist_keypts_soa_.size() != frm_obs.undist_keypts_.size()) {
+        // the SoA copy has not been built (e.g. an observation under construction)
+        return get_keypoints_in_cell(camera, frm_obs.undist_keypts_, frm_obs.keypt_indices_in_cells_, ref_x, ref_y, margin, min_level, max_level);
+    }
+    return get_keypoints_in_cell(camera, frm_obs.undist_keypts_soa_, frm_obs.keypt_indices_in_cells_, ref_x, ref_y, margin, min_level, max_level);
+}
+
+void get_keypoints_in_cell(const camera::base* camera, const data::frame_observation& frm_obs,
+                           const float ref_x, const float ref_y, const float margin,
+                           const int min_level, const int max_level,
+                           std::vector<unsigned int>& indices) {
+    if (frm_obs.undist_keypts_soa_.size() != frm_obs.undist_keypts_.size()) {
+        // the SoA copy has not been built (e.g. an observation under construction)
+        indices = get_keypoints_in_cell(camera, frm_obs.undist_keypts_, frm_obs.keypt_indices_in_cells_, ref_x, ref_y, margin, min_level, max_level);
+        return;
+    }
+    get_keypoints_in_cell(camera, frm_obs.undist_keypts_soa_, frm_obs.keypt_indices_in_cells_, ref_x, ref_y, margin, min_level, max_level, indices);
+}
 
+std::vector<unsigned int> get_keypoints_in_cell(const camera::base* camera, const std::vector<cv::KeyPoint>& undist_keypts,
+                                                const keypoint_grid& keypt_indices_in_cells,
+                                                const float ref_x, const float ref_y, const float margin,
+                                                const int min_level, const int max_level) {
+    std::vector<unsigned int> indices;
+    indices.reserve(undist_keypts.size());
+    get_keypoints_in_cell_impl(
+        camera, undist_keypts, keypt_indices_in_cells, ref_x, ref_y, margin, min_level, max_level,
+        [](const std::vector<cv::KeyPoint>& keypts, const unsigned int idx) { return keypts[idx].pt.x; },
+        [](const std::vector<cv::KeyPoint>& keypts, const unsigned int idx) { return keypts[idx].pt.y; },
+        [](const std::vector<cv::KeyPoint>& keypts, const unsigned int idx) { return keypts[idx].octave; },
+        indices);
     return indices;
 }
 
+std::vector<unsigned int> get_keypoints_in_cell(const camera::base* camera, const keypoints_soa& undist_keypts,
+                                                const keypoint_grid& keypt_indices_in_cells,
+                                                const float ref_x, const float ref_y, const float margin,
+                                                const int min_level, const int max_level) {
+    std::vector<unsigned int> indices;
+    indices.reserve(undist_keypts.size());
+    get_keypoints_in_cell(camera, undist_keypts, keypt_indices_in_cells, ref_x, ref_y, margin, min_level, max_level, indices);
+    return indices;
+}
+
+void get_keypoints_in_cell(const camera::base* camera, const keypoints_soa& undist_keypts,
+                           const keypoint_grid& keypt_indices_in_cells,
+                           const float ref_x, const float ref_y, const float margin,
+                           const int min_level, const int max_level,
+                           std::vector<unsigned int>& indices) {
+    get_keypoints_in_cell_impl(
+        camera, undist_keypts, keypt_indices_in_cells, ref_x, ref_y, margin, min_level, max_level,
+        [](const keypoints_soa& keypts, const unsigned int idx) { return keypts.x_[idx]; },
+        [](const keypoints_soa& keypts, const unsigned int idx) { return keypts.y_[idx]; },
+        [](const keypoints_soa& keypts, const unsigned int idx) { return keypts.octave_[idx]; },
+        indices);
+}
+
 Vec3_t triangulate_stereo(const camera::base* camera,
                           const Mat33_t& rot_wc,
                           const Vec3_t& trans_wc,
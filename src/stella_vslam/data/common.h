@@ -3,6 +3,8 @@
 
 #include "stella_vslam/type.h"
 #include "stella_vslam/camera/base.h"
+#include "stella_vslam/data/keypoint_grid.h"
+#include "stella_vslam/data/observation_encoding.h"
 
 #include <opencv2/core/mat.hpp>
 #include <opencv2/core/types.hpp>
@@ -12,6 +14,7 @@ namespace stella_vslam {
 namespace data {
 
 struct frame_observation;
+struct keypoints_soa;
 
 nlohmann::json convert_rotation_to_json(const Mat33_t& rot_cw);
 
@@ -21,14 +24,38 @@ nlohmann::json convert_translation_to_json(const Vec3_t& trans_cw);
 
 Vec3_t convert_json_to_translation(const nlohmann::json& json_trans_cw);
 
-nlohmann::json convert_keypoints_to_json(const std::vector<cv::KeyPoint>& keypts);
+/**
+ * Encode the keypoints (position, angle and octave)
+ * With the packed encodings, the keypoints are stored as a blob in a JSON string,
+ * whose positions are quantized to 1/32 pixel and angles to 360/65535 degree.
+ * (NOTE: the bundled nlohmann::json has no binary type, so the blob string is valid only in MessagePack)
+ */
+nlohmann::json convert_keypoints_to_json(const std::vector<cv::KeyPoint>& keypts,
+                                         const observation_encoding_t encoding = observation_encoding_t::Json);
 
+//! Decode the keypoints encoded as the element-wise JSON array or as the blob
 std::vector<cv::KeyPoint> convert_json_to_keypoints(const nlohmann::json& json_keypts);
 
-nlohmann::json convert_descriptors_to_json(const cv::Mat& descriptors);
+/**
+ * Encode the descriptors
+ * With the packed encodings, the descriptors are stored as a blob of the raw 32 bytes per descriptor in a JSON string.
+ */
+nlohmann::json convert_descriptors_to_json(const cv::Mat& descriptors,
+                                           const observation_encoding_t encoding = observation_encoding_t::Json);
 
+//! Decode the descriptors encoded as the element-wise JSON array or as the blob
 cv::Mat convert_json_to_descriptors(const nlohmann::json& json_descriptors);
 
+/**
+ * Encode the float values (e.g. x_rights and depths)
+ * With the packed encodings, the values are stored as a blob of the raw floats in a JSON string.
+ */
+nlohmann::json convert_floats_to_json(const std::vector<float>& values,
+                                      const observation_encoding_t encoding = observation_encoding_t::Json);
+
+//! Decode the float values encoded as the JSON array or as the blob
+std::vector<float> convert_json_to_floats(const nlohmann::json& json_values);
+
 /**
  * Assign all keypoints to cells to accelerate projection matching
  * @param camera
@@ -36,7 +63,7 @@ cv::Mat convert_json_to_descriptors(const nlohmann::json& json_descriptors);
  * @param keypt_indices_in_cells
  */
 void assign_keypoints_to_grid(const camera::base* camera, const std::vector<cv::KeyPoint>& undist_keypts,
-                              std::vector<std::vector<std::vector<unsigned int>>>& keypt_indices_in_cells);
+                              keypoint_grid& keypt_indices_in_cells);
 
 /**
  * Assign all keypoints to cells to accelerate projection matching
@@ -45,7 +72,7 @@ void assign_keypoints_to_grid(const camera::base* camera, const std::vector<cv::
  * @return
  */
 auto assign_keypoints_to_grid(const camera::base* camera, const std::vector<cv::KeyPoint>& undist_keypts)
-    -> std::vector<std::vector<std::vector<unsigned int>>>;
+    -> keypoint_grid;
 
 /**
  * Get x-y index of the cell in which the specified keypoint is assigned
@@ -75,13 +102,31 @@ inline bool get_cell_indices(const camera::base* camera, const cv::KeyPoint& key
  * @return
  */
 std::vector<unsigned int> get_keypoints_in_cell(const camera::base* camera, const std::vector<cv::KeyPoint>& undist_keypts,
-                                                const std::vector<std::vector<std::vector<unsigned int>>>& keypt_indices_in_cells,
+                                                const keypoint_grid& keypt_indices_in_cells,
+                                                const float ref_x, const float ref_y, const float margin,
+                                                const int min_level = -1, const int max_level = -1);
+std::vector<unsigned int> get_keypoints_in_cell(const camera::base* camera, const keypoints_soa& undist_keypts,
+                                                const keypoint_grid& keypt_indices_in_cells,
                                                 const float ref_x, const float ref_y, const float margin,
                                                 const int min_level = -1, const int max_level = -1);
 std::vector<unsigned int> get_keypoints_in_cell(const camera::base* camera, const frame_observation& frm_obs,
                                                 const float ref_x, const float ref_y, const float margin,
                                                 const int min_level = -1, const int max_level = -1);
 
+/**
+ * Get keypoint indices in cell(s) in which the specified point is located into the buffer
+ * (the buffer is cleared first and its capacity is reused, e.g. with util::scratch_vector)
+ */
+void get_keypoints_in_cell(const camera::base* camera, const keypoints_soa& undist_keypts,
+                           const keypoint_grid& keypt_indices_in_cells,
+                           const float ref_x, const float ref_y, const float margin,
+                           const int min_level, const int max_level,
+                           std::vector<unsigned int>& indices);
+void get_keypoints_in_cell(const camera::base* camera, const frame_observation& frm_obs,
+                           const float ref_x, const float ref_y, const float margin,
+                           const int min_level, const int max_level,
+                           std::vector<unsigned int>& indices);
+
 /**
  * Triangulate the keypoint using the disparity
  */
@@ -2,6 +2,7 @@
 #include "stella_vslam/data/frame.h"
 #include "stella_vslam/data/keyframe.h"
 #include "stella_vslam/data/landmark.h"
+#include "stella_vslam/data/local_map_snapshot.h"
 #include "stella_vslam/feature/orb_extractor.h"
 #include "stella_vslam/match/stereo.h"
 
@@ -14,12 +15,28 @@ namespace data {
 
 std::atomic<unsigned int> frame::next_id_{0};
 
+namespace {
+const std::shared_ptr<const frame_observation>& get_empty_frame_observation() {
+    static const auto empty_frm_obs = make_frame_observation(frame_observation());
+    return empty_frm_obs;
+}
+} // namespace
+
+frame::frame()
+    : frm_obs_(get_empty_frame_observation()) {}
+
 frame::frame(const double timestamp, camera::base* camera, feature::orb_params* orb_params,
-             const frame_observation frm_obs, const std::unordered_map<unsigned int, marker2d>& markers_2d)
-    : id_(next_id_++), timestamp_(timestamp), camera_(camera), orb_params_(orb_params), frm_obs_(frm_obs),
-      markers_2d_(markers_2d),
+             frame_observation frm_obs, std::unordered_map<unsigned int, marker2d> markers_2d)
+    : id_(next_id_++), timestamp_(timestamp), camera_(camera), orb_params_(orb_params),
+      frm_obs_(make_frame_observation(std::move(frm_obs))), markers_2d_(std::move(markers_2d)),
       // Initialize association with 3D points
-      landmarks_(std::vector<std::shared_ptr<landmark>>(frm_obs_.num_keypts_, nullptr)) {}
+      landmarks_(std::vector<std::shared_ptr<landmark>>(frm_obs_->num_keypts_, nullptr)) {}
+
+frame::frame(const unsigned int id, const double timestamp, camera::base* camera, feature::orb_params* orb_params,
+             frame_observation frm_obs)
+    : id_(id), timestamp_(timestamp), camera_(camera), orb_params_(orb_params),
+      frm_obs_(make_frame_observation(std::move(frm_obs))),
+      landmarks_(std::vector<std::shared_ptr<landmark>>(frm_obs_->num_keypts_, nullptr)) {}
 
 void frame::set_pose_cw(const Mat44_t& pose_cw) {
     pose_is_valid_ = true;
@@ -29,6 +46,13 @@ void frame::set_pose_cw(const Mat44_t& pose_cw) {
     rot_wc_ = rot_cw_.transpose();
     trans_cw_ = pose_cw_.block<3, 1>(0, 3);
     trans_wc_ = -rot_cw_.transpose() * trans_cw_;
+    pose_wc_ = Mat44_t::Identity();
+    pose_wc_.block<3, 3>(0, 0) = rot_wc_;
+    pose_wc_.block<3, 1>(0, 3) = trans_wc_;
+
+    for (const auto& rig_frm : rig_frms_) {
+        rig_frm->frm_.set_pose_cw(rig_frm->pose_cb_ * pose_cw);
+    }
 }
 
 void frame::set_pose_cw(const g2o::SE3Quat& pose_cw) {
@@ -40,10 +64,7 @@ Mat44_t frame::get_pose_cw() const {
 }
 
 Mat44_t frame::get_pose_wc() const {
-    Mat44_t pose_wc = Mat44_t::Identity();
-    pose_wc.block<3, 3>(0, 0) = rot_wc_;
-    pose_wc.block<3, 1>(0, 3) = trans_wc_;
-    return pose_wc;
+    return pose_wc_;
 }
 
 Vec3_t frame::get_trans_wc() const {
@@ -59,7 +80,11 @@ bool frame::bow_is_available() const {
 }
 
 void frame::compute_bow(bow_vocabulary* bow_vocab) {
-    bow_vocabulary_util::compute_bow(bow_vocab, frm_obs_.descriptors_, bow_vec_, bow_feat_vec_);
+    if (bow_is_available()) {
+        // the BoW representation is computed only once
+        return;
+    }
+    bow_vocabulary_util::compute_bow(bow_vocab, frm_obs_->descriptors_, bow_vec_, bow_feat_vec_);
 }
 
 bool frame::can_observe(const std::shared_ptr<landmark>& lm, const float ray_cos_thr,
@@ -89,6 +114,88 @@ bool frame::can_observe(const std::shared_ptr<landmark>& lm, const float ray_cos
     return true;
 }
 
+void frame::can_observe(const std::vector<std::shared_ptr<landmark>>& lms, const float ray_cos_thr,
+                        std::vector<bool>& is_observable, eigen_alloc_vector<Vec2_t>& reprojs,
+                        std::vector<float>& x_rights, std::vector<unsigned int>& pred_scale_levels) const {
+    const auto num_lms = static_cast<Eigen::Index>(lms.size());
+
+    // snapshot the landmarks in SoA layout
+    TrkMatX3_t pos_ws(num_lms, 3);
+    TrkMatX3_t mean_normals(num_lms, 3);
+    TrkArrayX_t min_valid_dists(num_lms);
+    TrkArrayX_t max_valid_dists(num_lms);
+    Vec3_t pos_w;
+    Vec3_t mean_normal;
+    float min_valid_dist;
+    float max_valid_dist;
+    for (Eigen::Index i = 0; i < num_lms; ++i) {
+        lms.at(i)->get_pos_in_world_and_prediction_parameters(pos_w, mean_normal, min_valid_dist, max_valid_dist);
+        pos_ws.row(i) = pos_w.transpose().cast<tracking_real_t>();
+        mean_normals.row(i) = mean_normal.transpose().cast<tracking_real_t>();
+        min_valid_dists(i) = min_valid_dist;
+        max_valid_dists(i) = max_valid_dist;
+    }
+
+    can_observe(pos_ws, mean_normals, min_valid_dists, max_valid_dists, ray_cos_thr,
+                is_observable, reprojs, x_rights, pred_scale_levels);
+}
+
+void frame::can_observe(const local_map_snapshot& local_map, const float ray_cos_thr,
+                        std::vector<bool>& is_observable, eigen_alloc_vector<Vec2_t>& reprojs,
+                        std::vector<float>& x_rights, std::vector<unsigned int>& pred_scale_levels) const {
+    can_observe(local_map.pos_ws_, local_map.mean_normals_, local_map.min_valid_dists_, local_map.max_valid_dists_, ray_cos_thr,
+                is_observable, reprojs, x_rights, pred_scale_levels);
+}
+
+void frame::can_observe(const TrkMatX3_t& pos_ws, const TrkMatX3_t& mean_normals,
+                        const TrkArrayX_t& min_valid_dists, const TrkArrayX_t& max_valid_dists, const float ray_cos_thr,
+                        std::vector<bool>& is_observable, eigen_alloc_vector<Vec2_t>& reprojs,
+                        std::vector<float>& x_rights, std::vector<unsigned int>& pred_scale_levels) const {
+    const auto num_lms = pos_ws.rows();
+
+    TrkMatX2_t reprojs_mat;
+    TrkVecX_t x_rights_vec;
+    VecXb_t in_image;
+    camera_->reproject_points_to_image(rot_cw_.cast<tracking_real_t>(), trans_cw_.cast<tracking_real_t>(), pos_ws,
+                                       reprojs_mat, x_rights_vec, in_image);
+
+    // check the scale-invariance range and the viewing angle
+    const TrkArrayX_t cam_to_lm_x = pos_ws.col(0).array() - static_cast<tracking_real_t>(trans_wc_(0));
+    const TrkArrayX_t cam_to_lm_y = pos_ws.col(1).array() - static_cast<tracking_real_t>(trans_wc_(1));
+    const TrkArrayX_t cam_to_lm_z = pos_ws.col(2).array() - static_cast<tracking_real_t>(trans_wc_(2));
+    const TrkArrayX_t cam_to_lm_dists = (cam_to_lm_x.square() + cam_to_lm_y.square() + cam_to_lm_z.square()).sqrt();
+    const TrkArrayX_t ray_coss = (cam_to_lm_x * mean_normals.col(0).array()
+                                  + cam_to_lm_y * mean_normals.col(1).array()
+                                  + cam_to_lm_z * mean_normals.col(2).array())
+                                 / cam_to_lm_dists;
+    const tracking_real_t margin_far = 1.3;
+    const tracking_real_t margin_near = 1.0 / margin_far;
+    const VecXb_t observable = in_image
+                               && (margin_near * min_valid_dists <= cam_to_lm_dists)
+                               && (cam_to_lm_dists <= margin_far * max_valid_dists)
+                               && (static_cast<tracking_real_t>(ray_cos_thr) <= ray_coss);
+
+    // predict the scale levels (same as landmark::predict_scale_level())
+    const TrkArrayX_t pred_scale_levels_arr = ((max_valid_dists / cam_to_lm_dists).log() / static_cast<tracking_real_t>(orb_params_->log_scale_factor_))
+                                                  .ceil()
+                                                  .max(tracking_real_t(0))
+                                                  .min(static_cast<tracking_real_t>(orb_params_->num_levels_) - 1);
+
+    is_observable.resize(num_lms);
+    reprojs.resize(num_lms);
+    x_rights.resize(num_lms);
+    pred_scale_levels.resize(num_lms);
+    for (Eigen::Index i = 0; i < num_lms; ++i) {
+        is_observable.at(i) = observable(i);
+        if (!observable(i)) {
+            continue;
+        }
+        reprojs.at(i) = reprojs_mat.row(i).transpose().cast<double>();
+        x_rights.at(i) = x_rights_vec(i);
+        pred_scale_levels.at(i) = static_cast<unsigned int>(pred_scale_levels_arr(i));
+    }
+}
+
 bool frame::has_landmark(const std::shared_ptr<landmark>& lm) const {
     return static_cast<bool>(landmarks_idx_map_.count(lm));
 }
@@ -136,12 +243,24 @@ void frame::set_landmarks(const std::vector<std::shared_ptr<landmark>>& landmark
     }
 }
 
+std::unordered_map<unsigned int, marker2d> frame::get_markers_2d() const {
+    if (pending_markers_2d_.valid()) {
+        return pending_markers_2d_.get();
+    }
+    return markers_2d_;
+}
+
 std::vector<unsigned int> frame::get_keypoints_in_cell(const float ref_x, const float ref_y, const float margin, const int min_level, const int max_level) const {
-    return data::get_keypoints_in_cell(camera_, frm_obs_, ref_x, ref_y, margin, min_level, max_level);
+    return data::get_keypoints_in_cell(camera_, *frm_obs_, ref_x, ref_y, margin, min_level, max_level);
+}
+
+void frame::get_keypoints_in_cell(const float ref_x, const float ref_y, const float margin, const int min_level, const int max_level,
+                                  std::vector<unsigned int>& indices) const {
+    data::get_keypoints_in_cell(camera_, *frm_obs_, ref_x, ref_y, margin, min_level, max_level, indices);
 }
 
 Vec3_t frame::triangulate_stereo(const unsigned int idx) const {
-    return data::triangulate_stereo(camera_, rot_wc_, trans_wc_, frm_obs_, idx);
+    return data::triangulate_stereo(camera_, rot_wc_, trans_wc_, *frm_obs_, idx);
 }
 
 } // namespace data
@@ -12,6 +12,7 @@
 
 #include <vector>
 #include <atomic>
+#include <future>
 #include <memory>
 #include <unordered_set>
 
@@ -32,12 +33,15 @@ namespace data {
 
 class keyframe;
 class landmark;
+struct local_map_snapshot;
+struct rig_frame;
 
 class frame {
 public:
     EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 
-    frame() = default;
+    //! Default constructor (with the empty observations)
+    frame();
 
     bool operator==(const frame& frm) { return this->id_ == frm.id_; }
     bool operator!=(const frame& frm) { return !(*this == frm); }
@@ -51,10 +55,23 @@ public:
      * @param markers_2d
      */
     frame(const double timestamp, camera::base* camera, feature::orb_params* orb_params,
-          const frame_observation frm_obs, const std::unordered_map<unsigned int, marker2d>& markers_2d);
+          frame_observation frm_obs, std::unordered_map<unsigned int, marker2d> markers_2d);
+
+    /**
+     * Constructor for the frame of an auxiliary camera of the multi-camera rig
+     * (the ID is shared with the frame of the primary camera)
+     * @param id
+     * @param timestamp
+     * @param camera
+     * @param orb_params
+     * @param frm_obs
+     */
+    frame(const unsigned int id, const double timestamp, camera::base* camera, feature::orb_params* orb_params,
+          frame_observation frm_obs);
 
     /**
      * Set camera pose and refresh rotation and translation
+     * (the poses of the frames of the rig cameras are also updated)
      * @param pose_cw
      */
     void set_pose_cw(const Mat44_t& pose_cw);
@@ -122,6 +139,7 @@ public:
 
     /**
      * Compute BoW representation
+     * (NOTE: nothing is done if it has been already computed)
      */
     void compute_bow(bow_vocabulary* bow_vocab);
 
@@ -131,6 +149,22 @@ public:
     bool can_observe(const std::shared_ptr<landmark>& lm, const float ray_cos_thr,
                      Vec2_t& reproj, float& x_right, unsigned int& pred_scale_level) const;
 
+    /**
+     * Check observability of the landmarks at once
+     * (the results of lms.at(i) are stored in the i-th elements, and are valid only if is_observable.at(i) is true)
+     */
+    void can_observe(const std::vector<std::shared_ptr<landmark>>& lms, const float ray_cos_thr,
+                     std::vector<bool>& is_observable, eigen_alloc_vector<Vec2_t>& reprojs,
+                     std::vector<float>& x_rights, std::vector<unsigned int>& pred_scale_levels) const;
+
+    /**
+     * Check observability of the landmarks in the packed local map at once (without locking the landmarks)
+     * (the results are indexed as the snapshot)
+     */
+    void can_observe(const local_map_snapshot& local_map, const float ray_cos_thr,
+                     std::vector<bool>& is_observable, eigen_alloc_vector<Vec2_t>& reprojs,
+                     std::vector<float>& x_rights, std::vector<unsigned int>& pred_scale_levels) const;
+
     bool has_landmark(const std::shared_ptr<landmark>& lm) const;
 
     void add_landmark(const std::shared_ptr<landmark>&, const unsigned int idx);
@@ -147,6 +181,13 @@ public:
 
     void set_landmarks(const std::vector<std::shared_ptr<landmark>>& landmarks);
 
+    /**
+     * Get the detected markers
+     * (NOTE: wait for the result if the markers are detected asynchronously)
+     * @return
+     */
+    std::unordered_map<unsigned int, marker2d> get_markers_2d() const;
+
     /**
      * Get keypoint indices in the cell which reference point is located
      * @param ref_x
@@ -158,6 +199,11 @@ public:
      */
     std::vector<unsigned int> get_keypoints_in_cell(const float ref_x, const float ref_y, const float margin, const int min_level = -1, const int max_level = -1) const;
 
+    //! Get keypoint indices in the cell which reference point is located into the buffer
+    //! (the buffer is cleared first and its capacity is reused)
+    void get_keypoints_in_cell(const float ref_x, const float ref_y, const float margin, const int min_level, const int max_level,
+                               std::vector<unsigned int>& indices) const;
+
     /**
      * Perform stereo triangulation of the keypoint
      * @param idx
@@ -181,10 +227,13 @@ public:
     const feature::orb_params* orb_params_ = nullptr;
 
     //! constant observations
-    frame_observation frm_obs_;
+    //! (NOTE: shared among the copies of the frame and the keyframe created from it, and not modified after the construction)
+    std::shared_ptr<const frame_observation> frm_obs_;
 
     //! markers 2D (ID to marker2d map)
     std::unordered_map<unsigned int, marker2d> markers_2d_;
+    //! markers 2D which are being detected asynchronously (used instead of markers_2d_ if valid)
+    std::shared_future<std::unordered_map<unsigned int, marker2d>> pending_markers_2d_;
 
     //! BoW features (DBoW2 or FBoW)
     bow_vector bow_vec_;
@@ -193,7 +242,21 @@ public:
     //! reference keyframe for tracking
     std::shared_ptr<keyframe> ref_keyfrm_ = nullptr;
 
+    //! covariance of the left perturbation [rotation, translation] of the camera pose, which is estimated by the pose optimization
+    //! (zero if it is not estimated)
+    Mat66_t pose_cov_ = Mat66_t::Zero();
+
+    //! frames of the auxiliary cameras of the multi-camera rig (empty if the rig is not used)
+    //! (NOTE: shared among the copies of the frame)
+    std::vector<std::shared_ptr<rig_frame>> rig_frms_;
+
 private:
+    //! Check observability of the landmarks given in SoA layout
+    void can_observe(const TrkMatX3_t& pos_ws, const TrkMatX3_t& mean_normals,
+                     const TrkArrayX_t& min_valid_dists, const TrkArrayX_t& max_valid_dists, const float ray_cos_thr,
+                     std::vector<bool>& is_observable, eigen_alloc_vector<Vec2_t>& reprojs,
+                     std::vector<float>& x_rights, std::vector<unsigned int>& pred_scale_levels) const;
+
     //! landmarks, whose nullptr indicates no-association
     std::vector<std::shared_ptr<landmark>> landmarks_;
     std::unordered_map<std::shared_ptr<landmark>, unsigned int> landmarks_idx_map_;
@@ -211,6 +274,23 @@ private:
     Mat33_t rot_wc_;
     //! translation: camera -> world
     Vec3_t trans_wc_;
+    //! camera pose: camera -> world
+    Mat44_t pose_wc_;
+};
+
+/**
+ * Frame of an auxiliary camera of the multi-camera rig, whose pose follows the frame of the primary camera
+ */
+struct rig_frame {
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    rig_frame(const Mat44_t& pose_cb, const frame& frm)
+        : pose_cb_(pose_cb), frm_(frm) {}
+
+    //! pose of the auxiliary camera: primary camera -> auxiliary camera
+    Mat44_t pose_cb_;
+    //! frame of the auxiliary camera
+    frame frm_;
 };
 
 } // namespace data
@@ -2,7 +2,13 @@
 #define STELLA_VSLAM_DATA_FRAME_OBSERVATION_H
 
 #include "stella_vslam/type.h"
+#include "stella_vslam/data/keypoint_grid.h"
+#include "stella_vslam/data/keypoints_soa.h"
+#include "stella_vslam/feature/orb_extraction_budget.h"
 
+#include <memory>
+
+#include <Eigen/Core>
 #include <opencv2/core/mat.hpp>
 #include <opencv2/core/types.hpp>
 
@@ -16,9 +22,14 @@ struct frame_observation {
     frame_observation(unsigned int num_keypts, const cv::Mat& descriptors,
                       const std::vector<cv::KeyPoint>& undist_keypts, const eigen_alloc_vector<Vec3_t>& bearings,
                       const std::vector<float>& stereo_x_right, const std::vector<float>& depths,
-                      const std::vector<std::vector<std::vector<unsigned int>>>& keypt_indices_in_cells)
-        : num_keypts_(num_keypts), descriptors_(descriptors), undist_keypts_(undist_keypts), bearings_(bearings),
-          stereo_x_right_(stereo_x_right), depths_(depths), keypt_indices_in_cells_(keypt_indices_in_cells) {}
+                      const keypoint_grid& keypt_indices_in_cells)
+        : num_keypts_(num_keypts), descriptors_(descriptors), undist_keypts_(undist_keypts), undist_keypts_soa_(undist_keypts),
+          bearings_(bearings), stereo_x_right_(stereo_x_right), depths_(depths), keypt_indices_in_cells_(keypt_indices_in_cells) {}
+
+    //! Rebuild undist_keypts_soa_ from undist_keypts_
+    void update_keypoints_soa() {
+        undist_keypts_soa_.assign(undist_keypts_);
+    }
 
     //! number of keypoints
     unsigned int num_keypts_ = 0;
@@ -26,16 +37,33 @@ struct frame_observation {
     cv::Mat descriptors_;
     //! undistorted keypoints of monocular or stereo left image
     std::vector<cv::KeyPoint> undist_keypts_;
+    //! undistorted keypoints in structure-of-arrays layout (for the hot loops)
+    keypoints_soa undist_keypts_soa_;
     //! bearing vectors
     eigen_alloc_vector<Vec3_t> bearings_;
     //! disparities
     std::vector<float> stereo_x_right_;
     //! depths
     std::vector<float> depths_;
-    //! keypoint indices in each of the cells
-    std::vector<std::vector<std::vector<unsigned int>>> keypt_indices_in_cells_;
+    //! keypoint indices in each of the cells (CSR format)
+    keypoint_grid keypt_indices_in_cells_;
+    //! settings used for the ORB extraction (of monocular or stereo left image)
+    feature::orb_extraction_settings extraction_settings_;
+    //! the keypoints are followed from the last frame by the optical flow instead of the ORB extraction
+    bool is_tracked_by_optical_flow_ = false;
 };
 
+/**
+ * Make the observations which are shared by the frames and the keyframes, and not modified anymore
+ * (the keypoints in structure-of-arrays layout are built if they are not)
+ */
+inline std::shared_ptr<const frame_observation> make_frame_observation(frame_observation&& frm_obs) {
+    if (frm_obs.undist_keypts_soa_.size() != frm_obs.undist_keypts_.size()) {
+        frm_obs.update_keypoints_soa();
+    }
+    return std::allocate_shared<frame_observation>(Eigen::aligned_allocator<frame_observation>(), std::move(frm_obs));
+}
+
 } // namespace data
 } // namespace stella_vslam
 
@@ -1,37 +1,71 @@
 #include "stella_vslam/data/frame.h"
 #include "stella_vslam/data/keyframe.h"
 #include "stella_vslam/data/frame_statistics.h"
+#include "stella_vslam/data/memory_usage.h"
+
+#include <algorithm>
 
 namespace stella_vslam {
 namespace data {
 
+namespace {
+Vec7_t to_compact_pose(const Mat44_t& pose) {
+    const Quat_t quat(Mat33_t(pose.block<3, 3>(0, 0)));
+    Vec7_t compact_pose;
+    compact_pose << pose.block<3, 1>(0, 3), quat.coeffs();
+    return compact_pose;
+}
+
+Mat44_t from_compact_pose(const Vec7_t& compact_pose) {
+    Mat44_t pose = Mat44_t::Identity();
+    pose.block<3, 3>(0, 0) = Quat_t(compact_pose.tail<4>()).toRotationMatrix();
+    pose.block<3, 1>(0, 3) = compact_pose.head<3>();
+    return pose;
+}
+
+template<typename Column>
+void erase_front(Column& column, const unsigned int num_rows) {
+    column.erase(column.begin(), column.begin() + num_rows);
+}
+} // namespace
+
+frame_statistics::frame_statistics(const unsigned int max_num_frames, const unsigned int decimation)
+    : max_num_frames_(max_num_frames), decimation_(std::max(1u, decimation)) {}
+
 void frame_statistics::update_frame_statistics(const data::frame& frm, const bool is_lost) {
-    if (frm.pose_is_valid()) {
+    if (num_seen_frms_++ % decimation_ != 0) {
+        return;
+    }
+    assert(frm_ids_.empty() || frm_ids_.back() < frm.id_);
+
+    const bool pose_is_valid = frm.pose_is_valid();
+    frm_ids_.push_back(frm.id_);
+    pose_is_valid_.push_back(pose_is_valid);
+    is_lost_frms_.push_back(is_lost);
+    timestamps_.push_back(frm.timestamp_);
+    extraction_settings_.push_back(frm.frm_obs_->extraction_settings_);
+    if (pose_is_valid) {
         const Mat44_t rel_cam_pose_from_ref_keyfrm = frm.get_pose_cw() * frm.ref_keyfrm_->get_pose_wc();
 
         frm_ids_of_ref_keyfrms_[frm.ref_keyfrm_].push_back(frm.id_);
 
         ++num_valid_frms_;
-        assert(!ref_keyfrms_.count(frm.id_));
-        ref_keyfrms_[frm.id_] = frm.ref_keyfrm_;
-        assert(!rel_cam_poses_from_ref_keyfrms_.count(frm.id_));
-        rel_cam_poses_from_ref_keyfrms_[frm.id_] = rel_cam_pose_from_ref_keyfrm;
-        assert(!timestamps_.count(frm.id_));
-        timestamps_[frm.id_] = frm.timestamp_;
+        ref_keyfrms_.push_back(frm.ref_keyfrm_);
+        rel_cam_poses_from_ref_keyfrms_.push_back(to_compact_pose(rel_cam_pose_from_ref_keyfrm));
+    }
+    else {
+        ref_keyfrms_.push_back(nullptr);
+        rel_cam_poses_from_ref_keyfrms_.push_back(Vec7_t::Zero());
     }
 
-    assert(!is_lost_frms_.count(frm.id_));
-    is_lost_frms_[frm.id_] = is_lost;
+    if (0 < max_num_frames_ && max_num_frames_ < frm_ids_.size() - first_row_) {
+        discard_oldest_frames();
+    }
 }
 
 void frame_statistics::replace_reference_keyframe(const std::shared_ptr<data::keyframe>& old_keyfrm, const std::shared_ptr<data::keyframe>& new_keyfrm) {
     // Delete keyframes and update associations.
 
-    assert(num_valid_frms_ == rel_cam_poses_from_ref_keyfrms_.size());
-    assert(num_valid_frms_ == ref_keyfrms_.size());
-    assert(num_valid_frms_ == timestamps_.size());
-    assert(num_valid_frms_ <= is_lost_frms_.size());
-
     // Finish if no need to replace keyframes
     if (!frm_ids_of_ref_keyfrms_.count(old_keyfrm)) {
         return;
@@ -40,20 +74,27 @@ void frame_statistics::replace_reference_keyframe(const std::shared_ptr<data::ke
     // Search frames referencing old_keyfrm which is to be deleted.
     const auto frm_ids = frm_ids_of_ref_keyfrms_.at(old_keyfrm);
 
+    // Get pose of the old and the new keyframes
+    const Mat44_t old_ref_cam_pose_cw = old_keyfrm->get_pose_cw();
+    const Mat44_t new_ref_cam_pose_wc = new_keyfrm->get_pose_wc();
+
     for (const auto frm_id : frm_ids) {
-        assert(*ref_keyfrms_.at(frm_id) == *old_keyfrm);
+        const auto row = get_row(frm_id);
+        if (row < 0) {
+            // already discarded
+            continue;
+        }
+        assert(*ref_keyfrms_.at(row) == *old_keyfrm);
 
-        // Get pose and relative pose of the old keyframe
-        const Mat44_t old_ref_cam_pose_cw = old_keyfrm->get_pose_cw();
-        const Mat44_t old_rel_cam_pose_cr = rel_cam_poses_from_ref_keyfrms_.at(frm_id);
+        // Get relative pose of the old keyframe
+        const Mat44_t old_rel_cam_pose_cr = from_compact_pose(rel_cam_poses_from_ref_keyfrms_.at(row));
 
         // Replace pointer of the keyframe to new_keyfrm
-        ref_keyfrms_.at(frm_id) = new_keyfrm;
+        ref_keyfrms_.at(row) = new_keyfrm;
 
         // Update relative pose
-        const Mat44_t new_ref_cam_pose_cw = new_keyfrm->get_pose_cw();
-        const Mat44_t new_rel_cam_pose_cr = old_rel_cam_pose_cr * old_ref_cam_pose_cw * new_ref_cam_pose_cw.inverse();
-        rel_cam_poses_from_ref_keyfrms_.at(frm_id) = new_rel_cam_pose_cr;
+        const Mat44_t new_rel_cam_pose_cr = old_rel_cam_pose_cr * old_ref_cam_pose_cw * new_ref_cam_pose_wc;
+        rel_cam_poses_from_ref_keyfrms_.at(row) = to_compact_pose(new_rel_cam_pose_cr);
     }
 
     // Update frames referencing new_keyfrm
@@ -72,28 +113,125 @@ unsigned int frame_statistics::get_num_valid_frames() const {
 }
 
 std::map<unsigned int, std::shared_ptr<data::keyframe>> frame_statistics::get_reference_keyframes() const {
-    return {ref_keyfrms_.begin(), ref_keyfrms_.end()};
+    std::map<unsigned int, std::shared_ptr<data::keyframe>> ref_keyfrms;
+    for (unsigned int row = first_row_; row < frm_ids_.size(); ++row) {
+        if (pose_is_valid_.at(row)) {
+            ref_keyfrms.emplace_hint(ref_keyfrms.end(), frm_ids_.at(row), ref_keyfrms_.at(row));
+        }
+    }
+    return ref_keyfrms;
 }
 
 eigen_alloc_map<unsigned int, Mat44_t> frame_statistics::get_relative_cam_poses() const {
-    return {rel_cam_poses_from_ref_keyfrms_.begin(), rel_cam_poses_from_ref_keyfrms_.end()};
+    eigen_alloc_map<unsigned int, Mat44_t> rel_cam_poses;
+    for (unsigned int row = first_row_; row < frm_ids_.size(); ++row) {
+        if (pose_is_valid_.at(row)) {
+            rel_cam_poses.emplace_hint(rel_cam_poses.end(), frm_ids_.at(row), from_compact_pose(rel_cam_poses_from_ref_keyfrms_.at(row)));
+        }
+    }
+    return rel_cam_poses;
 }
 
 std::map<unsigned int, double> frame_statistics::get_timestamps() const {
-    return {timestamps_.begin(), timestamps_.end()};
+    std::map<unsigned int, double> timestamps;
+    for (unsigned int row = first_row_; row < frm_ids_.size(); ++row) {
+        if (pose_is_valid_.at(row)) {
+            timestamps.emplace_hint(timestamps.end(), frm_ids_.at(row), timestamps_.at(row));
+        }
+    }
+    return timestamps;
 }
 
 std::map<unsigned int, bool> frame_statistics::get_lost_frames() const {
-    return {is_lost_frms_.begin(), is_lost_frms_.end()};
+    std::map<unsigned int, bool> is_lost_frms;
+    for (unsigned int row = first_row_; row < frm_ids_.size(); ++row) {
+        is_lost_frms.emplace_hint(is_lost_frms.end(), frm_ids_.at(row), is_lost_frms_.at(row));
+    }
+    return is_lost_frms;
+}
+
+std::map<unsigned int, feature::orb_extraction_settings> frame_statistics::get_extraction_settings() const {
+    std::map<unsigned int, feature::orb_extraction_settings> extraction_settings;
+    for (unsigned int row = first_row_; row < frm_ids_.size(); ++row) {
+        extraction_settings.emplace_hint(extraction_settings.end(), frm_ids_.at(row), extraction_settings_.at(row));
+    }
+    return extraction_settings;
+}
+
+size_t frame_statistics::get_memory_bytes() const {
+    // (the lists of the reference keyframes contain each frame once)
+    const size_t ref_keyfrm_bytes = frm_ids_of_ref_keyfrms_.bucket_count() * sizeof(void*)
+                                    + frm_ids_of_ref_keyfrms_.size() * get_node_bytes<std::pair<const std::shared_ptr<data::keyframe>, std::vector<unsigned int>>>()
+                                    + frm_ids_.size() * sizeof(unsigned int);
+    return ref_keyfrm_bytes
+           + frm_ids_.capacity() * sizeof(unsigned int)
+           + (pose_is_valid_.capacity() + is_lost_frms_.capacity()) / 8
+           + timestamps_.capacity() * sizeof(double)
+           + ref_keyfrms_.capacity() * sizeof(std::shared_ptr<data::keyframe>)
+           + rel_cam_poses_from_ref_keyfrms_.capacity() * sizeof(Vec7_t)
+           + extraction_settings_.capacity() * sizeof(feature::orb_extraction_settings);
 }
 
 void frame_statistics::clear() {
+    num_seen_frms_ = 0;
     num_valid_frms_ = 0;
     frm_ids_of_ref_keyfrms_.clear();
+    first_row_ = 0;
+    frm_ids_.clear();
+    pose_is_valid_.clear();
+    is_lost_frms_.clear();
+    timestamps_.clear();
     ref_keyfrms_.clear();
     rel_cam_poses_from_ref_keyfrms_.clear();
-    timestamps_.clear();
-    is_lost_frms_.clear();
+    extraction_settings_.clear();
+}
+
+int frame_statistics::get_row(const unsigned int frm_id) const {
+    const auto itr = std::lower_bound(frm_ids_.begin() + first_row_, frm_ids_.end(), frm_id);
+    if (itr == frm_ids_.end() || *itr != frm_id) {
+        return -1;
+    }
+    return std::distance(frm_ids_.begin(), itr);
+}
+
+void frame_statistics::discard_oldest_frames() {
+    // discard the rows, which are kept until the compaction
+    const unsigned int num_discarded = frm_ids_.size() - first_row_ - max_num_frames_;
+    for (unsigned int row = first_row_; row < first_row_ + num_discarded; ++row) {
+        if (pose_is_valid_.at(row)) {
+            --num_valid_frms_;
+            ref_keyfrms_.at(row) = nullptr;
+        }
+    }
+    first_row_ += num_discarded;
+    if (first_row_ < max_num_frames_) {
+        return;
+    }
+
+    // compact the columns once the discarded rows exceed the recorded ones (amortized O(1) per frame)
+    const unsigned int oldest_frm_id = frm_ids_.at(first_row_);
+    erase_front(frm_ids_, first_row_);
+    erase_front(pose_is_valid_, first_row_);
+    erase_front(is_lost_frms_, first_row_);
+    erase_front(timestamps_, first_row_);
+    erase_front(ref_keyfrms_, first_row_);
+    erase_front(rel_cam_poses_from_ref_keyfrms_, first_row_);
+    erase_front(extraction_settings_, first_row_);
+    first_row_ = 0;
+
+    for (auto itr = frm_ids_of_ref_keyfrms_.begin(); itr != frm_ids_of_ref_keyfrms_.end();) {
+        // (NOTE: the frame IDs are not sorted if the reference keyframe has been replaced)
+        auto& frm_ids = itr->second;
+        frm_ids.erase(std::remove_if(frm_ids.begin(), frm_ids.end(),
+                                     [oldest_frm_id](const unsigned int frm_id) { return frm_id < oldest_frm_id; }),
+                      frm_ids.end());
+        if (frm_ids.empty()) {
+            itr = frm_ids_of_ref_keyfrms_.erase(itr);
+        }
+        else {
+            ++itr;
+        }
+    }
 }
 
 } // namespace data
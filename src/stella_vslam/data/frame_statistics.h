@@ -2,6 +2,7 @@
 #define STELLA_VSLAM_DATA_FRAME_STATISTICS_H
 
 #include "stella_vslam/type.h"
+#include "stella_vslam/feature/orb_extraction_budget.h"
 
 #include <vector>
 #include <unordered_map>
@@ -13,12 +14,38 @@ namespace data {
 class frame;
 class keyframe;
 
+/**
+ * Observer of the frame statistics, which is notified of each update (e.g. io::trajectory_writer)
+ * (NOTE: the methods are called under the lock of the frame statistics in map_database)
+ */
+class frame_statistics_observer {
+public:
+    virtual ~frame_statistics_observer() = default;
+
+    //! Called when the frame is tracked (or lost)
+    virtual void on_frame_tracked(const data::frame& frm, const bool is_lost) = 0;
+
+    //! Called when the reference keyframe is replaced because it will be erased
+    virtual void on_reference_keyframe_replaced(const std::shared_ptr<data::keyframe>& old_keyfrm, const std::shared_ptr<data::keyframe>& new_keyfrm) = 0;
+
+    //! Called when the frame statistics are cleared
+    virtual void on_cleared() = 0;
+};
+
+/**
+ * Statistics of the tracked frames for the odometry evaluation
+ * The frames are stored in the columns of contiguous arrays in the order of the frame IDs.
+ * The number of the recorded frames can be bounded by keeping only every decimation-th frame
+ * and by discarding the oldest ones beyond max_num_frames.
+ */
 class frame_statistics {
 public:
     /**
      * Constructor
+     * @param max_num_frames maximum number of the recorded frames (0 means unlimited)
+     * @param decimation every decimation-th frame is recorded (1 means all the frames)
      */
-    frame_statistics() = default;
+    explicit frame_statistics(const unsigned int max_num_frames = 0, const unsigned int decimation = 1);
 
     /**
      * Destructor
@@ -75,27 +102,68 @@ public:
      */
     std::map<unsigned int, bool> get_lost_frames() const;
 
+    /**
+     * Get settings used for the ORB extraction of each of the frames
+     * @return
+     */
+    std::map<unsigned int, feature::orb_extraction_settings> get_extraction_settings() const;
+
+    /**
+     * Get the decimation of the recorded frames
+     * @return
+     */
+    unsigned int get_decimation() const {
+        return decimation_;
+    }
+
     /**
      * Clear frame statistics
      */
     void clear();
 
+    /**
+     * Estimated bytes of the recorded frames
+     * @return
+     */
+    size_t get_memory_bytes() const;
+
 private:
+    //! Get the row of the frame ID (-1 if not recorded)
+    int get_row(const unsigned int frm_id) const;
+
+    //! Discard the oldest frames beyond max_num_frames_
+    void discard_oldest_frames();
+
+    //! Maximum number of the recorded frames (0 means unlimited)
+    unsigned int max_num_frames_;
+    //! Every decimation_-th frame is recorded
+    unsigned int decimation_;
+    //! Number of the frames passed to update_frame_statistics() (for the decimation)
+    unsigned int num_seen_frms_ = 0;
+
     //! Reference keyframe, frame ID associated with the keyframe
     std::unordered_map<std::shared_ptr<data::keyframe>, std::vector<unsigned int>> frm_ids_of_ref_keyfrms_;
 
     //! Number of valid frames
     unsigned int num_valid_frms_ = 0;
 
-    // Size of all the following variables is the number of frames
-    //! Reference keyframes for each frame
-    std::unordered_map<unsigned int, std::shared_ptr<data::keyframe>> ref_keyfrms_;
-    //! Relative pose against reference keyframe for each frame
-    eigen_alloc_unord_map<unsigned int, Mat44_t> rel_cam_poses_from_ref_keyfrms_;
-    //! Timestamp for each frame
-    std::unordered_map<unsigned int, double> timestamps_;
+    // Columns of the recorded frames (the rows before first_row_ are discarded, and compacted lazily)
+    //! First row which is not discarded
+    unsigned int first_row_ = 0;
+    //! Frame ID (ascending)
+    std::vector<unsigned int> frm_ids_;
+    //! Whether the pose of the frame is valid or not
+    std::vector<bool> pose_is_valid_;
     //! Flag whether each frame is lost or not
-    std::unordered_map<unsigned int, bool> is_lost_frms_;
+    std::vector<bool> is_lost_frms_;
+    //! Timestamp for each frame
+    std::vector<double> timestamps_;
+    //! Reference keyframes for each frame (nullptr if the pose is not valid)
+    std::vector<std::shared_ptr<data::keyframe>> ref_keyfrms_;
+    //! Relative pose against reference keyframe for each frame (translation and quaternion (x, y, z, w))
+    std::vector<Vec7_t> rel_cam_poses_from_ref_keyfrms_;
+    //! Settings used for the ORB extraction of each frame
+    std::vector<feature::orb_extraction_settings> extraction_settings_;
 };
 
 } // namespace data
@@ -0,0 +1,154 @@
+#include "stella_vslam/data/bow_vocabulary.h"
+#include "stella_vslam/data/global_descriptor_index.h"
+#include "stella_vslam/data/memory_usage.h"
+#include "stella_vslam/match/base.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace stella_vslam {
+namespace data {
+
+namespace {
+//! Pseudo-random 64-bit value of the key (SplitMix64)
+uint64_t hash_64(uint64_t key) {
+    key += 0x9e3779b97f4a7c15ULL;
+    key = (key ^ (key >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    key = (key ^ (key >> 27)) * 0x94d049bb133111ebULL;
+    return key ^ (key >> 31);
+}
+} // namespace
+
+global_descriptor_index::global_descriptor_index(const unsigned int num_probed_cells, const unsigned int min_cell_size)
+    : num_probed_cells_(std::max(1u, num_probed_cells)), min_cell_size_(std::max(1u, min_cell_size)) {}
+
+global_descriptor_index::descriptor_t global_descriptor_index::compute_descriptor(const bow_vector& bow_vec) {
+    // Project the BoW vector onto the 256 random hyperplanes, whose coefficients are +1 or -1 generated from the word IDs
+    std::array<float, 256> projections;
+    projections.fill(0.0f);
+    for (const auto& node_id_and_weight : bow_vec) {
+        const uint64_t word_id = node_id_and_weight.first;
+        const auto weight = static_cast<float>(node_id_and_weight.second);
+        for (unsigned int k = 0; k < 4; ++k) {
+            const auto signs = hash_64(4 * word_id + k);
+            for (unsigned int bit = 0; bit < 64; ++bit) {
+                projections[64 * k + bit] += ((signs >> bit) & 1) ? weight : -weight;
+            }
+        }
+    }
+
+    descriptor_t desc;
+    desc.fill(0);
+    for (unsigned int i = 0; i < 256; ++i) {
+        if (0.0f < projections[i]) {
+            desc[i / 8] |= static_cast<uint8_t>(1 << (i % 8));
+        }
+    }
+    return desc;
+}
+
+void global_descriptor_index::add(const unsigned int id, const descriptor_t& desc) {
+    if (descriptors_.count(id)) {
+        return;
+    }
+
+    // Keep the capacity of a cell around the square root of the number of the keyframes
+    const auto cell_size = std::max(min_cell_size_, static_cast<unsigned int>(std::sqrt(static_cast<double>(descriptors_.size() + 1))));
+    auto cell_idx = pivots_.empty() ? 0 : find_nearest_cell(desc);
+    if (pivots_.empty() || cell_size <= keyfrm_ids_in_cell_.at(cell_idx).size()) {
+        // The descriptor becomes the pivot of a new cell
+        cell_idx = static_cast<unsigned int>(pivots_.size());
+        pivots_.push_back(desc);
+        keyfrm_ids_in_cell_.emplace_back();
+    }
+    keyfrm_ids_in_cell_.at(cell_idx).push_back(id);
+    descriptors_.emplace(id, std::make_pair(desc, cell_idx));
+}
+
+void global_descriptor_index::erase(const unsigned int id) {
+    const auto iter = descriptors_.find(id);
+    if (iter == descriptors_.end()) {
+        return;
+    }
+    // (NOTE: the pivot is kept even if the cell becomes empty)
+    auto& ids = keyfrm_ids_in_cell_.at(iter->second.second);
+    const auto id_iter = std::find(ids.begin(), ids.end(), id);
+    if (id_iter != ids.end()) {
+        *id_iter = ids.back();
+        ids.pop_back();
+    }
+    descriptors_.erase(iter);
+}
+
+void global_descriptor_index::clear() {
+    pivots_.clear();
+    keyfrm_ids_in_cell_.clear();
+    descriptors_.clear();
+}
+
+size_t global_descriptor_index::get_memory_bytes() const {
+    size_t bytes = pivots_.capacity() * sizeof(descriptor_t) + keyfrm_ids_in_cell_.capacity() * sizeof(std::vector<unsigned int>)
+                   + descriptors_.bucket_count() * sizeof(void*)
+                   + descriptors_.size() * get_node_bytes<std::pair<const unsigned int, std::pair<descriptor_t, unsigned int>>>();
+    for (const auto& keyfrm_ids : keyfrm_ids_in_cell_) {
+        bytes += keyfrm_ids.capacity() * sizeof(unsigned int);
+    }
+    return bytes;
+}
+
+unsigned int global_descriptor_index::find_nearest_cell(const descriptor_t& desc) const {
+    unsigned int best_dist = match::MAX_HAMMING_DIST + 1;
+    unsigned int best_idx = 0;
+    for (unsigned int i = 0; i < pivots_.size(); ++i) {
+        const auto dist = match::compute_hamming_distance_256(desc.data(), pivots_.at(i).data());
+        if (dist < best_dist) {
+            best_dist = dist;
+            best_idx = i;
+        }
+    }
+    return best_idx;
+}
+
+std::vector<std::pair<unsigned int, unsigned int>> global_descriptor_index::get_nearest_keyframes(const descriptor_t& desc, const unsigned int num_neighbors,
+                                                                                                 const std::function<bool(unsigned int)>& is_rejected) const {
+    if (pivots_.empty()) {
+        return std::vector<std::pair<unsigned int, unsigned int>>();
+    }
+
+    // Find the cells of the nearest pivots
+    const auto num_cells = static_cast<unsigned int>(pivots_.size());
+    std::vector<unsigned int> pivot_dists(num_cells);
+    match::compute_hamming_distances_256(desc.data(), pivots_.front().data(), sizeof(descriptor_t), num_cells, pivot_dists.data());
+    std::vector<unsigned int> cell_idxs(num_cells);
+    for (unsigned int i = 0; i < num_cells; ++i) {
+        cell_idxs.at(i) = i;
+    }
+    const auto num_probed_cells = std::min(num_probed_cells_, num_cells);
+    std::partial_sort(cell_idxs.begin(), cell_idxs.begin() + num_probed_cells, cell_idxs.end(),
+                      [&pivot_dists](const unsigned int a, const unsigned int b) {
+                          return pivot_dists.at(a) < pivot_dists.at(b) || (pivot_dists.at(a) == pivot_dists.at(b) && a < b);
+                      });
+
+    // Scan the keyframes in the cells
+    std::vector<std::pair<unsigned int, unsigned int>> nearest_keyfrms;
+    for (unsigned int i = 0; i < num_probed_cells; ++i) {
+        for (const auto id : keyfrm_ids_in_cell_.at(cell_idxs.at(i))) {
+            if (is_rejected && is_rejected(id)) {
+                continue;
+            }
+            const auto& registered_desc = descriptors_.at(id).first;
+            nearest_keyfrms.emplace_back(id, match::compute_hamming_distance_256(desc.data(), registered_desc.data()));
+        }
+    }
+
+    const auto num_keyfrms = std::min<size_t>(num_neighbors, nearest_keyfrms.size());
+    std::partial_sort(nearest_keyfrms.begin(), nearest_keyfrms.begin() + num_keyfrms, nearest_keyfrms.end(),
+                      [](const std::pair<unsigned int, unsigned int>& a, const std::pair<unsigned int, unsigned int>& b) {
+                          return a.second < b.second || (a.second == b.second && a.first < b.first);
+                      });
+    nearest_keyfrms.resize(num_keyfrms);
+    return nearest_keyfrms;
+}
+
+} // namespace data
+} // namespace stella_vslam
@@ -0,0 +1,101 @@
+#ifndef STELLA_VSLAM_DATA_GLOBAL_DESCRIPTOR_INDEX_H
+#define STELLA_VSLAM_DATA_GLOBAL_DESCRIPTOR_INDEX_H
+
+#include "stella_vslam/data/bow_vocabulary_fwd.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+#include <unordered_map>
+
+namespace stella_vslam {
+namespace data {
+
+/**
+ * Approximate nearest neighbor index of the global descriptors of the keyframes
+ * The global descriptor is the 256-bit random-hyperplane hash (SimHash) of the weighted BoW vector,
+ * so the Hamming distance between them approximates the angle between the BoW vectors.
+ * The descriptors are grouped into the cells of the pivots (the first descriptor of each cell),
+ * and a query scans only the cells of the nearest pivots.
+ * A new cell is created when the nearest cell is full, so both the number of the cells and their sizes grow with the square root of the number of the keyframes.
+ * (NOTE: not thread-safe, the owner must guard it)
+ */
+class global_descriptor_index {
+public:
+    using descriptor_t = std::array<uint8_t, 32>;
+
+    /**
+     * Constructor
+     * @param num_probed_cells number of the cells scanned by a query
+     * @param min_cell_size minimum capacity of a cell
+     */
+    explicit global_descriptor_index(const unsigned int num_probed_cells = 8, const unsigned int min_cell_size = 32);
+
+    /**
+     * Destructor
+     */
+    virtual ~global_descriptor_index() = default;
+
+    /**
+     * Compute the global descriptor of the BoW vector
+     */
+    static descriptor_t compute_descriptor(const bow_vector& bow_vec);
+
+    /**
+     * Insert the keyframe (nothing is done if it is already registered)
+     * @param id keyframe ID
+     * @param desc
+     */
+    void add(const unsigned int id, const descriptor_t& desc);
+
+    /**
+     * Erase the keyframe
+     * @param id keyframe ID
+     */
+    void erase(const unsigned int id);
+
+    /**
+     * Clear the index
+     */
+    void clear();
+
+    /**
+     * Get the keyframes whose descriptors are near to the query
+     * @param desc query descriptor
+     * @param num_neighbors maximum number of the returned keyframes
+     * @param is_rejected the keyframe is skipped if this returns true for its ID
+     * @return pairs of the keyframe ID and the Hamming distance in ascending order of the distance
+     */
+    std::vector<std::pair<unsigned int, unsigned int>> get_nearest_keyframes(const descriptor_t& desc, const unsigned int num_neighbors,
+                                                                            const std::function<bool(unsigned int)>& is_rejected) const;
+
+    //! number of the registered keyframes
+    size_t size() const { return descriptors_.size(); }
+
+    //! Estimated bytes of the cells and the descriptors
+    size_t get_memory_bytes() const;
+
+private:
+    //! Find the cell whose pivot is the nearest to the descriptor
+    unsigned int find_nearest_cell(const descriptor_t& desc) const;
+
+    //! number of the cells scanned by a query
+    const unsigned int num_probed_cells_;
+    //! minimum capacity of a cell
+    const unsigned int min_cell_size_;
+
+    //! pivot of each cell
+    std::vector<descriptor_t> pivots_;
+    //! keyframe IDs in each cell
+    std::vector<std::vector<unsigned int>> keyfrm_ids_in_cell_;
+    //! registered descriptor and cell of each keyframe
+    std::unordered_map<unsigned int, std::pair<descriptor_t, unsigned int>> descriptors_;
+};
+
+} // namespace data
+} // namespace stella_vslam
+
+#endif // STELLA_VSLAM_DATA_GLOBAL_DESCRIPTOR_INDEX_H
@@ -2,6 +2,10 @@
 #include "stella_vslam/data/graph_node.h"
 #include "stella_vslam/data/landmark.h"
 
+#include <queue>
+#include <unordered_map>
+#include <unordered_set>
+
 namespace {
 struct {
     bool operator()(const std::pair<unsigned int, std::shared_ptr<stella_vslam::data::keyframe>>& a, const std::pair<unsigned int, std::shared_ptr<stella_vslam::data::keyframe>>& b) {
@@ -14,10 +18,10 @@ namespace stella_vslam {
 namespace data {
 
 graph_node::graph_node(std::shared_ptr<keyframe>& keyfrm)
-    : owner_keyfrm_(keyfrm) {}
+    : owner_keyfrm_(keyfrm), covisibility_snapshot_(std::make_shared<covisibility_snapshot>()) {}
 
 void graph_node::add_connection(const std::shared_ptr<keyframe>& keyfrm, const unsigned int num_shared_lms) {
-    std::lock_guard<std::mutex> lock(mtx_);
+    std::lock_guard<util::profiled_mutex> lock(mtx_);
     bool need_update = false;
     if (!connected_keyfrms_and_num_shared_lms_.count(keyfrm)) {
         // if `keyfrm` not exists
@@ -31,12 +35,12 @@ void graph_node::add_connection(const std::shared_ptr<keyframe>& keyfrm, const u
     }
 
     if (need_update) {
-        update_covisibility_orders_impl();
+        covisibility_orders_are_outdated_ = true;
     }
 }
 
 void graph_node::erase_connection(const std::shared_ptr<keyframe>& keyfrm) {
-    std::lock_guard<std::mutex> lock(mtx_);
+    std::lock_guard<util::profiled_mutex> lock(mtx_);
     bool need_update = false;
     if (connected_keyfrms_and_num_shared_lms_.count(keyfrm)) {
         connected_keyfrms_and_num_shared_lms_.erase(keyfrm);
@@ -44,7 +48,7 @@ void graph_node::erase_connection(const std::shared_ptr<keyframe>& keyfrm) {
     }
 
     if (need_update) {
-        update_covisibility_orders_impl();
+        covisibility_orders_are_outdated_ = true;
     }
 }
 
@@ -58,39 +62,49 @@ void graph_node::erase_all_connections() {
     }
     // remove the buffers
     connected_keyfrms_and_num_shared_lms_.clear();
-    ordered_covisibilities_.clear();
-    ordered_num_shared_lms_.clear();
+    publish_covisibility_snapshot(std::vector<std::weak_ptr<keyframe>>(), std::vector<unsigned int>());
+    covisibility_orders_are_outdated_ = false;
+}
+
+void graph_node::add_shared_landmark(const std::shared_ptr<keyframe>& keyfrm) {
+    std::lock_guard<util::profiled_mutex> lock(mtx_);
+    ++num_shared_lms_[keyfrm];
+}
+
+void graph_node::erase_shared_landmark(const std::shared_ptr<keyframe>& keyfrm) {
+    std::lock_guard<util::profiled_mutex> lock(mtx_);
+    if (!num_shared_lms_.count(keyfrm)) {
+        return;
+    }
+    auto& num_shared_lms = num_shared_lms_[keyfrm];
+    if (--num_shared_lms == 0) {
+        num_shared_lms_.erase(keyfrm);
+    }
 }
 
 void graph_node::update_connections(unsigned int min_num_shared_lms) {
     const auto owner_keyfrm = owner_keyfrm_.lock();
-    const auto landmarks = owner_keyfrm->get_landmarks();
+
+    decltype(num_shared_lms_) all_num_shared_lms;
+    {
+        std::lock_guard<util::profiled_mutex> lock(mtx_);
+        all_num_shared_lms = num_shared_lms_;
+    }
 
     id_ordered_map<std::weak_ptr<keyframe>, unsigned int> keyfrm_to_num_shared_lms;
 
-    for (const auto& lm : landmarks) {
-        if (!lm) {
+    for (const auto& keyfrm_and_num_shared_lms : all_num_shared_lms) {
+        auto locked_keyfrm = keyfrm_and_num_shared_lms.first.lock();
+        if (!locked_keyfrm) {
             continue;
         }
-        if (lm->will_be_erased()) {
+        if (locked_keyfrm->graph_node_->spanning_parent_.expired() && !locked_keyfrm->graph_node_->is_spanning_root()) {
             continue;
         }
-
-        const auto observations = lm->get_observations();
-
-        for (const auto& obs : observations) {
-            auto keyfrm = obs.first;
-            auto locked_keyfrm = keyfrm.lock();
-
-            if (locked_keyfrm->graph_node_->spanning_parent_.expired() && !locked_keyfrm->graph_node_->is_spanning_root()) {
-                continue;
-            }
-            if (locked_keyfrm->id_ == owner_keyfrm->id_) {
-                continue;
-            }
-            // count up number of shared landmarks of `keyfrm`
-            keyfrm_to_num_shared_lms[keyfrm]++;
+        if (locked_keyfrm->id_ == owner_keyfrm->id_) {
+            continue;
         }
+        keyfrm_to_num_shared_lms.emplace_hint(keyfrm_to_num_shared_lms.end(), locked_keyfrm, keyfrm_and_num_shared_lms.second);
     }
 
     if (keyfrm_to_num_shared_lms.empty()) {
@@ -133,9 +147,9 @@ void graph_node::update_connections(unsigned int min_num_shared_lms) {
     // to match selection of nearest_covisibility.
     std::sort(num_shared_lms_and_covisibility_pairs.rbegin(), num_shared_lms_and_covisibility_pairs.rend(), cmp_num_shared_lms_and_keyfrm_pairs);
 
-    decltype(ordered_covisibilities_) ordered_covisibilities;
+    std::vector<std::weak_ptr<keyframe>> ordered_covisibilities;
     ordered_covisibilities.reserve(num_shared_lms_and_covisibility_pairs.size());
-    decltype(ordered_num_shared_lms_) ordered_num_shared_lms;
+    std::vector<unsigned int> ordered_num_shared_lms;
     ordered_num_shared_lms.reserve(num_shared_lms_and_covisibility_pairs.size());
     for (const auto& num_shared_lms_and_keyfrm_pair : num_shared_lms_and_covisibility_pairs) {
         ordered_covisibilities.push_back(num_shared_lms_and_keyfrm_pair.second);
@@ -143,16 +157,16 @@ void graph_node::update_connections(unsigned int min_num_shared_lms) {
     }
 
     {
-        std::lock_guard<std::mutex> lock(mtx_);
+        std::lock_guard<util::profiled_mutex> lock(mtx_);
 
         connected_keyfrms_and_num_shared_lms_ = decltype(connected_keyfrms_and_num_shared_lms_)(keyfrm_to_num_shared_lms.begin(), keyfrm_to_num_shared_lms.end());
 
-        ordered_covisibilities_ = ordered_covisibilities;
-        ordered_num_shared_lms_ = ordered_num_shared_lms;
+        assert(nearest_covisibility->id_ == num_shared_lms_and_covisibility_pairs.front().second->id_);
+        publish_covisibility_snapshot(std::move(ordered_covisibilities), std::move(ordered_num_shared_lms));
+        covisibility_orders_are_outdated_ = false;
 
         if (spanning_parent_.expired() && !is_spanning_root_impl()) {
             // set the parent of spanning tree
-            assert(nearest_covisibility->id_ == ordered_covisibilities.front().lock()->id_);
             spanning_parent_ = nearest_covisibility;
             spanning_root_ = spanning_parent_.lock()->graph_node_->get_spanning_root_impl();
             nearest_covisibility->graph_node_->add_spanning_child(owner_keyfrm);
@@ -161,11 +175,17 @@ void graph_node::update_connections(unsigned int min_num_shared_lms) {
 }
 
 void graph_node::update_covisibility_orders() {
-    std::lock_guard<std::mutex> lock(mtx_);
+    std::lock_guard<util::profiled_mutex> lock(mtx_);
     update_covisibility_orders_impl();
 }
 
-void graph_node::update_covisibility_orders_impl() {
+void graph_node::sort_covisibilities_if_needed() const {
+    if (covisibility_orders_are_outdated_) {
+        update_covisibility_orders_impl();
+    }
+}
+
+void graph_node::update_covisibility_orders_impl() const {
     std::vector<std::pair<unsigned int, std::shared_ptr<keyframe>>> num_shared_lms_and_keyfrm_pairs;
     num_shared_lms_and_keyfrm_pairs.reserve(connected_keyfrms_and_num_shared_lms_.size());
 
@@ -176,18 +196,36 @@ void graph_node::update_covisibility_orders_impl() {
     // sort with number of shared landmarks and keyframe IDs for consistency
     std::sort(num_shared_lms_and_keyfrm_pairs.rbegin(), num_shared_lms_and_keyfrm_pairs.rend(), cmp_num_shared_lms_and_keyfrm_pairs);
 
-    ordered_covisibilities_.clear();
-    ordered_covisibilities_.reserve(num_shared_lms_and_keyfrm_pairs.size());
-    ordered_num_shared_lms_.clear();
-    ordered_num_shared_lms_.reserve(num_shared_lms_and_keyfrm_pairs.size());
+    std::vector<std::weak_ptr<keyframe>> ordered_covisibilities;
+    ordered_covisibilities.reserve(num_shared_lms_and_keyfrm_pairs.size());
+    std::vector<unsigned int> ordered_num_shared_lms;
+    ordered_num_shared_lms.reserve(num_shared_lms_and_keyfrm_pairs.size());
     for (const auto& num_shared_lms_and_keyfrm_pair : num_shared_lms_and_keyfrm_pairs) {
-        ordered_covisibilities_.push_back(num_shared_lms_and_keyfrm_pair.second);
-        ordered_num_shared_lms_.push_back(num_shared_lms_and_keyfrm_pair.first);
+        ordered_covisibilities.push_back(num_shared_lms_and_keyfrm_pair.second);
+        ordered_num_shared_lms.push_back(num_shared_lms_and_keyfrm_pair.first);
+    }
+    publish_covisibility_snapshot(std::move(ordered_covisibilities), std::move(ordered_num_shared_lms));
+    covisibility_orders_are_outdated_ = false;
+}
+
+void graph_node::publish_covisibility_snapshot(std::vector<std::weak_ptr<keyframe>>&& keyfrms, std::vector<unsigned int>&& num_shared_lms) const {
+    auto snapshot = std::make_shared<covisibility_snapshot>();
+    snapshot->version_ = std::atomic_load(&covisibility_snapshot_)->version_ + 1;
+    snapshot->keyfrms_ = std::move(keyfrms);
+    snapshot->num_shared_lms_ = std::move(num_shared_lms);
+    std::atomic_store(&covisibility_snapshot_, std::shared_ptr<const covisibility_snapshot>(std::move(snapshot)));
+}
+
+std::shared_ptr<const covisibility_snapshot> graph_node::get_covisibility_snapshot() const {
+    if (covisibility_orders_are_outdated_) {
+        std::lock_guard<util::profiled_mutex> lock(mtx_);
+        sort_covisibilities_if_needed();
     }
+    return std::atomic_load(&covisibility_snapshot_);
 }
 
 std::set<std::shared_ptr<keyframe>> graph_node::get_connected_keyframes() const {
-    std::lock_guard<std::mutex> lock(mtx_);
+    std::lock_guard<util::profiled_mutex> lock(mtx_);
     std::set<std::shared_ptr<keyframe>> keyfrms;
 
     for (const auto& keyfrm_and_num_shared_lms : connected_keyfrms_and_num_shared_lms_) {
@@ -197,74 +235,73 @@ std::set<std::shared_ptr<keyframe>> graph_node::get_connected_keyframes() const
     return keyfrms;
 }
 
+std::vector<unsigned int> graph_node::get_connected_keyframe_ids() const {
+    std::lock_guard<util::profiled_mutex> lock(mtx_);
+    std::vector<unsigned int> keyfrm_ids;
+    keyfrm_ids.reserve(connected_keyfrms_and_num_shared_lms_.size());
+
+    // (the map is ordered by ID)
+    for (const auto& keyfrm_and_num_shared_lms : connected_keyfrms_and_num_shared_lms_) {
+        const auto keyfrm = keyfrm_and_num_shared_lms.first.lock();
+        if (keyfrm) {
+            keyfrm_ids.push_back(keyfrm->id_);
+        }
+    }
+
+    return keyfrm_ids;
+}
+
 std::vector<std::shared_ptr<keyframe>> graph_node::get_covisibilities() const {
-    std::lock_guard<std::mutex> lock(mtx_);
+    const auto snapshot = get_covisibility_snapshot();
     std::vector<std::shared_ptr<keyframe>> covisibilities;
-
-    for (const auto& covisibility : ordered_covisibilities_) {
-        if (covisibility.expired()) {
+    covisibilities.reserve(snapshot->keyfrms_.size());
+    for (const auto& covisibility : snapshot->keyfrms_) {
+        auto locked_covisibility = covisibility.lock();
+        if (!locked_covisibility) {
             continue;
         }
-        covisibilities.push_back(covisibility.lock());
+        covisibilities.push_back(std::move(locked_covisibility));
     }
     return covisibilities;
 }
 
 std::vector<std::shared_ptr<keyframe>> graph_node::get_top_n_covisibilities(const unsigned int num_covisibilities) const {
-    std::lock_guard<std::mutex> lock(mtx_);
+    const auto snapshot = get_covisibility_snapshot();
     std::vector<std::shared_ptr<keyframe>> covisibilities;
-    unsigned int i = 0;
-    for (const auto& covisibility : ordered_covisibilities_) {
-        if (i == num_covisibilities) {
+    covisibilities.reserve(std::min<size_t>(num_covisibilities, snapshot->keyfrms_.size()));
+    for (const auto& covisibility : snapshot->keyfrms_) {
+        if (covisibilities.size() == num_covisibilities) {
             break;
         }
-        if (covisibility.expired()) {
+        auto locked_covisibility = covisibility.lock();
+        if (!locked_covisibility) {
             continue;
         }
-        covisibilities.push_back(covisibility.lock());
-        i++;
+        covisibilities.push_back(std::move(locked_covisibility));
     }
     return covisibilities;
 }
 
 std::vector<std::shared_ptr<keyframe>> graph_node::get_covisibilities_over_min_num_shared_lms(const unsigned int min_num_shared_lms) const {
-    std::lock_guard<std::mutex> lock(mtx_);
-
-    if (ordered_covisibilities_.empty()) {
-        return std::vector<std::shared_ptr<keyframe>>();
-    }
+    const auto snapshot = get_covisibility_snapshot();
+    const auto& num_shared_lms = snapshot->num_shared_lms_;
+    const auto itr = std::upper_bound(num_shared_lms.begin(), num_shared_lms.end(), min_num_shared_lms, std::greater<unsigned int>());
+    const auto upper_bound_idx = static_cast<size_t>(itr - num_shared_lms.begin());
 
-    auto itr = std::upper_bound(ordered_num_shared_lms_.begin(), ordered_num_shared_lms_.end(), min_num_shared_lms, std::greater<unsigned int>());
-    if (itr == ordered_num_shared_lms_.end()) {
-        std::vector<std::shared_ptr<keyframe>> covisibilities;
-        for (const auto& covisibility : ordered_covisibilities_) {
-            if (covisibility.expired()) {
-                continue;
-            }
-            covisibilities.push_back(covisibility.lock());
-        }
-        return covisibilities;
-    }
-    else {
-        const auto upper_bound_idx = static_cast<unsigned int>(itr - ordered_num_shared_lms_.begin());
-        std::vector<std::shared_ptr<keyframe>> covisibilities;
-        unsigned int idx = 0;
-        for (const auto& covisibility : ordered_covisibilities_) {
-            if (idx == upper_bound_idx) {
-                break;
-            }
-            idx++;
-            if (covisibility.expired()) {
-                continue;
-            }
-            covisibilities.push_back(covisibility.lock());
+    std::vector<std::shared_ptr<keyframe>> covisibilities;
+    covisibilities.reserve(upper_bound_idx);
+    for (size_t idx = 0; idx < upper_bound_idx; ++idx) {
+        auto locked_covisibility = snapshot->keyfrms_.at(idx).lock();
+        if (!locked_covisibility) {
+            continue;
         }
-        return covisibilities;
+        covisibilities.push_back(std::move(locked_covisibility));
     }
+    return covisibilities;
 }
 
 unsigned int graph_node::get_num_shared_landmarks(const std::shared_ptr<keyframe>& keyfrm) const {
-    std::lock_guard<std::mutex> lock(mtx_);
+    std::lock_guard<util::profiled_mutex> lock(mtx_);
     if (connected_keyfrms_and_num_shared_lms_.count(keyfrm)) {
         return connected_keyfrms_and_num_shared_lms_.at(keyfrm);
     }
@@ -275,97 +312,227 @@ unsigned int graph_node::get_num_shared_landmarks(const std::shared_ptr<keyframe
 
 void graph_node::set_spanning_parent(const std::shared_ptr<keyframe>& keyfrm) {
     // NOTE: keyfrm can be nullptr
-    std::lock_guard<std::mutex> lock(mtx_);
+    std::lock_guard<util::profiled_mutex> lock(mtx_);
     assert(spanning_parent_.expired());
     spanning_parent_ = keyfrm;
+    set_owner_modified();
 }
 
 std::shared_ptr<keyframe> graph_node::get_spanning_parent() const {
-    std::lock_guard<std::mutex> lock(mtx_);
+    std::lock_guard<util::profiled_mutex> lock(mtx_);
     return spanning_parent_.lock();
 }
 
 void graph_node::change_spanning_parent(const std::shared_ptr<keyframe>& keyfrm) {
-    std::lock_guard<std::mutex> lock(mtx_);
+    std::lock_guard<util::profiled_mutex> lock(mtx_);
     spanning_parent_ = keyfrm;
     keyfrm->graph_node_->add_spanning_child(owner_keyfrm_.lock());
+    set_owner_modified();
 }
 
 void graph_node::add_spanning_child(const std::shared_ptr<keyframe>& keyfrm) {
-    std::lock_guard<std::mutex> lock(mtx_);
+    std::lock_guard<util::profiled_mutex> lock(mtx_);
     spanning_children_.insert(keyfrm);
+    set_owner_modified();
 }
 
 void graph_node::erase_spanning_child(const std::shared_ptr<keyframe>& keyfrm) {
-    std::lock_guard<std::mutex> lock(mtx_);
+    std::lock_guard<util::profiled_mutex> lock(mtx_);
     spanning_children_.erase(keyfrm);
+    set_owner_modified();
+}
+
+void graph_node::set_owner_modified() const {
+    if (auto owner_keyfrm = owner_keyfrm_.lock()) {
+        owner_keyfrm->set_modified();
+    }
 }
 
 void graph_node::recover_spanning_connections() {
-    std::lock_guard<std::mutex> lock(mtx_);
+    recover_spanning_connections({owner_keyfrm_.lock()});
+}
 
-    // 1. find new parents for my children
+void graph_node::recover_spanning_connections(const std::vector<std::shared_ptr<keyframe>>& erased_keyfrms) {
+    std::unordered_set<unsigned int> erased_keyfrm_ids;
+    for (const auto& keyfrm : erased_keyfrms) {
+        erased_keyfrm_ids.insert(keyfrm->id_);
+    }
 
-    std::set<std::shared_ptr<keyframe>> new_parent_candidates;
-    new_parent_candidates.insert(spanning_parent_.lock());
+    // 1. find the nearest ancestor which is not erased for each of the erased keyframes
 
-    while (!spanning_children_.empty()) {
-        bool max_is_found = false;
+    std::vector<std::shared_ptr<keyframe>> ancestors;
+    ancestors.reserve(erased_keyfrms.size());
+    for (const auto& keyfrm : erased_keyfrms) {
+        auto ancestor = keyfrm->graph_node_->get_spanning_parent();
+        while (ancestor && erased_keyfrm_ids.count(ancestor->id_)) {
+            ancestor = ancestor->graph_node_->get_spanning_parent();
+        }
+        ancestors.push_back(ancestor);
+    }
 
-        unsigned int max_num_shared_lms = 0;
-        std::shared_ptr<keyframe> max_num_shared_lms_parent = nullptr;
-        std::shared_ptr<keyframe> max_num_shared_lms_child = nullptr;
+    // 2. collect the children which lose their parents (in the order of the keyframe IDs)
 
-        for (const auto& spanning_child : spanning_children_) {
-            auto locked_spanning_child = spanning_child.lock();
-            if (locked_spanning_child->will_be_erased()) {
+    struct orphan {
+        std::shared_ptr<keyframe> keyfrm_;
+        //! used as the parent if no other candidate is found
+        std::shared_ptr<keyframe> ancestor_;
+        bool is_attached_;
+    };
+    std::map<unsigned int, orphan> orphans;
+    for (unsigned int i = 0; i < erased_keyfrms.size(); ++i) {
+        if (!ancestors.at(i)) {
+            continue;
+        }
+        for (const auto& child : erased_keyfrms.at(i)->graph_node_->get_spanning_children()) {
+            if (!child || erased_keyfrm_ids.count(child->id_)) {
                 continue;
             }
+            orphans.emplace(child->id_, orphan{child, ancestors.at(i), false});
+        }
+    }
 
-            // get intersection between the parent candidates and the spanning-child's covisibilities
-            const auto child_covisibilities = locked_spanning_child->graph_node_->get_covisibilities();
-            const auto intersection = extract_intersection(new_parent_candidates, child_covisibilities);
-
-            // find the new parent (which has the maximum number of shared landmarks with the spanning child) from the intersection
-            for (const auto& parent_candidate : intersection) {
-                const auto num_shared_lms = locked_spanning_child->graph_node_->get_num_shared_landmarks(parent_candidate);
-                if (max_num_shared_lms < num_shared_lms) {
-                    max_num_shared_lms = num_shared_lms;
-                    max_num_shared_lms_parent = parent_candidate;
-                    max_num_shared_lms_child = locked_spanning_child;
-                    max_is_found = true;
-                }
+    // 3. the ancestor can be a new parent only if it is connected to the root
+    //    (if erasing several keyframes, it may be a descendant of another orphan, which must be attached first)
+
+    std::vector<std::shared_ptr<keyframe>> connected_ancestors;
+    std::unordered_map<unsigned int, std::vector<std::shared_ptr<keyframe>>> orphan_id_to_ancestors;
+    std::unordered_set<unsigned int> checked_ancestor_ids;
+    for (const auto& ancestor : ancestors) {
+        if (!ancestor || !checked_ancestor_ids.insert(ancestor->id_).second) {
+            continue;
+        }
+        if (erased_keyfrms.size() == 1) {
+            connected_ancestors.push_back(ancestor);
+            continue;
+        }
+        auto node = ancestor;
+        std::shared_ptr<keyframe> orphan_above = nullptr;
+        while (true) {
+            const auto parent = node->graph_node_->get_spanning_parent();
+            if (!parent) {
+                break;
+            }
+            if (erased_keyfrm_ids.count(parent->id_)) {
+                orphan_above = node;
+                break;
             }
+            node = parent;
         }
-
-        if (max_is_found) {
-            // update spanning tree
-            max_num_shared_lms_child->graph_node_->change_spanning_parent(max_num_shared_lms_parent);
-            spanning_children_.erase(max_num_shared_lms_child);
-            new_parent_candidates.insert(max_num_shared_lms_child);
+        if (orphan_above && orphans.count(orphan_above->id_)) {
+            orphan_id_to_ancestors[orphan_above->id_].push_back(ancestor);
         }
         else {
-            // cannot update anymore
-            break;
+            connected_ancestors.push_back(ancestor);
         }
     }
 
-    // set my parent as the new parent
-    for (const auto& spanning_child : spanning_children_) {
-        const auto child = spanning_child.lock();
-        const auto parent = spanning_parent_.lock();
-        child->graph_node_->change_spanning_parent(parent);
+    // 4. index the edges from the parent candidates to the orphans by the IDs of the candidates
+
+    struct edge {
+        unsigned int num_shared_lms_;
+        unsigned int child_id_;
+        std::shared_ptr<keyframe> parent_;
+    };
+    std::unordered_map<unsigned int, std::vector<std::pair<unsigned int, unsigned int>>> candidate_id_to_edges;
+    for (const auto& id_orphan : orphans) {
+        const auto& child = id_orphan.second.keyfrm_;
+        // the ancestor is added with the lowest priority
+        candidate_id_to_edges[id_orphan.second.ancestor_->id_].emplace_back(0, id_orphan.first);
+        if (child->will_be_erased()) {
+            continue;
+        }
+        const auto snapshot = child->graph_node_->get_covisibility_snapshot();
+        for (unsigned int i = 0; i < snapshot->keyfrms_.size(); ++i) {
+            const auto covisibility = snapshot->keyfrms_.at(i).lock();
+            if (!covisibility || erased_keyfrm_ids.count(covisibility->id_) || covisibility->will_be_erased()) {
+                continue;
+            }
+            candidate_id_to_edges[covisibility->id_].emplace_back(snapshot->num_shared_lms_.at(i), id_orphan.first);
+        }
     }
 
-    spanning_children_.clear();
+    // 5. re-attach the orphans with the maximum spanning edges from the connected nodes (Prim's algorithm)
+
+    // the edge which has the most shared landmarks comes first, and the smaller IDs are preferred for consistency
+    auto cmp_edges = [](const edge& a, const edge& b) {
+        if (a.num_shared_lms_ != b.num_shared_lms_) {
+            return a.num_shared_lms_ < b.num_shared_lms_;
+        }
+        if (a.child_id_ != b.child_id_) {
+            return b.child_id_ < a.child_id_;
+        }
+        return b.parent_->id_ < a.parent_->id_;
+    };
+    std::priority_queue<edge, std::vector<edge>, decltype(cmp_edges)> edges(cmp_edges);
+    std::unordered_set<unsigned int> candidate_ids;
+    auto add_candidate = [&](const std::shared_ptr<keyframe>& candidate) {
+        if (!candidate_ids.insert(candidate->id_).second) {
+            return;
+        }
+        const auto itr = candidate_id_to_edges.find(candidate->id_);
+        if (itr == candidate_id_to_edges.end()) {
+            return;
+        }
+        for (const auto& num_shared_lms_and_child_id : itr->second) {
+            if (!orphans.at(num_shared_lms_and_child_id.second).is_attached_) {
+                edges.push(edge{num_shared_lms_and_child_id.first, num_shared_lms_and_child_id.second, candidate});
+            }
+        }
+    };
+
+    for (const auto& ancestor : connected_ancestors) {
+        add_candidate(ancestor);
+    }
+    while (!edges.empty()) {
+        const auto max_edge = edges.top();
+        edges.pop();
+        auto& child = orphans.at(max_edge.child_id_);
+        if (child.is_attached_) {
+            continue;
+        }
+
+        // update spanning tree
+        child.keyfrm_->graph_node_->change_spanning_parent(max_edge.parent_);
+        child.is_attached_ = true;
+
+        // the attached child and the ancestors in its subtree become candidates
+        add_candidate(child.keyfrm_);
+        const auto itr = orphan_id_to_ancestors.find(max_edge.child_id_);
+        if (itr != orphan_id_to_ancestors.end()) {
+            for (const auto& ancestor : itr->second) {
+                add_candidate(ancestor);
+            }
+        }
+    }
 
-    // 2. remove myself from my parent's children list
+    // set the ancestor as the new parent if the orphan cannot be reached (not expected)
+    for (auto& id_orphan : orphans) {
+        if (!id_orphan.second.is_attached_) {
+            id_orphan.second.keyfrm_->graph_node_->change_spanning_parent(id_orphan.second.ancestor_);
+            id_orphan.second.is_attached_ = true;
+        }
+    }
+
+    // 6. remove the erased keyframes from the spanning tree
+
+    for (unsigned int i = 0; i < erased_keyfrms.size(); ++i) {
+        if (!ancestors.at(i)) {
+            continue;
+        }
+        ancestors.at(i)->graph_node_->erase_spanning_child(erased_keyfrms.at(i));
+        erased_keyfrms.at(i)->graph_node_->detach_from_spanning_tree(ancestors.at(i));
+    }
+}
 
-    spanning_parent_.lock()->graph_node_->erase_spanning_child(owner_keyfrm_.lock());
+void graph_node::detach_from_spanning_tree(const std::shared_ptr<keyframe>& ancestor) {
+    std::lock_guard<util::profiled_mutex> lock(mtx_);
+    spanning_children_.clear();
+    spanning_parent_ = ancestor;
+    set_owner_modified();
 }
 
 std::set<std::shared_ptr<keyframe>> graph_node::get_spanning_children() const {
-    std::lock_guard<std::mutex> lock(mtx_);
+    std::lock_guard<util::profiled_mutex> lock(mtx_);
     std::set<std::shared_ptr<keyframe>> locked_spanning_children;
     for (const auto& keyfrm : spanning_children_) {
         locked_spanning_children.insert(keyfrm.lock());
@@ -374,19 +541,20 @@ std::set<std::shared_ptr<keyframe>> graph_node::get_spanning_children() const {
 }
 
 bool graph_node::has_spanning_child(const std::shared_ptr<keyframe>& keyfrm) const {
-    std::lock_guard<std::mutex> lock(mtx_);
+    std::lock_guard<util::profiled_mutex> lock(mtx_);
     return static_cast<bool>(spanning_children_.count(keyfrm));
 }
 
 void graph_node::add_loop_edge(const std::shared_ptr<keyframe>& keyfrm) {
-    std::lock_guard<std::mutex> lock(mtx_);
+    std::lock_guard<util::profiled_mutex> lock(mtx_);
     loop_edges_.insert(keyfrm);
     // cannot erase loop edges
     owner_keyfrm_.lock()->set_not_to_be_erased();
+    set_owner_modified();
 }
 
 std::set<std::shared_ptr<keyframe>> graph_node::get_loop_edges() const {
-    std::lock_guard<std::mutex> lock(mtx_);
+    std::lock_guard<util::profiled_mutex> lock(mtx_);
     std::set<std::shared_ptr<keyframe>> locked_loop_edges;
     for (const auto& keyfrm : loop_edges_) {
         locked_loop_edges.insert(keyfrm.lock());
@@ -395,12 +563,12 @@ std::set<std::shared_ptr<keyframe>> graph_node::get_loop_edges() const {
 }
 
 bool graph_node::has_loop_edge() const {
-    std::lock_guard<std::mutex> lock(mtx_);
+    std::lock_guard<util::profiled_mutex> lock(mtx_);
     return !loop_edges_.empty();
 }
 
 std::shared_ptr<keyframe> graph_node::get_spanning_root() {
-    std::lock_guard<std::mutex> lock(mtx_);
+    std::lock_guard<util::profiled_mutex> lock(mtx_);
     return get_spanning_root_impl();
 }
 
@@ -422,7 +590,7 @@ std::shared_ptr<keyframe> graph_node::get_spanning_root_impl() {
 }
 
 bool graph_node::is_spanning_root() const {
-    std::lock_guard<std::mutex> lock(mtx_);
+    std::lock_guard<util::profiled_mutex> lock(mtx_);
     return is_spanning_root_impl();
 }
 
@@ -434,7 +602,7 @@ bool graph_node::is_spanning_root_impl() const {
 }
 
 void graph_node::set_spanning_root(std::shared_ptr<keyframe>& keyfrm) {
-    std::lock_guard<std::mutex> lock(mtx_);
+    std::lock_guard<util::profiled_mutex> lock(mtx_);
     spanning_root_ = keyfrm;
 }
 
@@ -454,19 +622,5 @@ std::vector<std::shared_ptr<keyframe>> graph_node::get_keyframes_from_root() {
     return keyfrms;
 }
 
-template<typename T, typename U>
-std::vector<std::shared_ptr<keyframe>> graph_node::extract_intersection(const T& keyfrms_1, const U& keyfrms_2) {
-    std::vector<std::shared_ptr<keyframe>> intersection;
-    intersection.reserve(std::min(keyfrms_1.size(), keyfrms_2.size()));
-    for (const auto keyfrm_1 : keyfrms_1) {
-        for (const auto keyfrm_2 : keyfrms_2) {
-            if (*keyfrm_1 == *keyfrm_2) {
-                intersection.push_back(keyfrm_1);
-            }
-        }
-    }
-    return intersection;
-}
-
 } // namespace data
 } // namespace stella_vslam
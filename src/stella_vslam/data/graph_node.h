@@ -1,7 +1,11 @@
 #ifndef STELLA_VSLAM_DATA_GRAPH_NODE_H
 #define STELLA_VSLAM_DATA_GRAPH_NODE_H
 
+#include "stella_vslam/util/id_ordered_flat_map.h"
+#include "stella_vslam/util/lock_profiler.h"
+
 #include <atomic>
+#include <cstdint>
 #include <mutex>
 #include <vector>
 #include <map>
@@ -13,6 +17,19 @@ namespace data {
 
 class keyframe;
 
+/**
+ * Immutable list of the covisibilities in descending order of the number of shared landmarks
+ * (a new one is published whenever the order is updated, so the readers can keep it without locking graph_node)
+ */
+struct covisibility_snapshot {
+    //! incremented whenever a new snapshot is published by the owner node
+    uint64_t version_ = 0;
+    //! covisibility keyframes in descending order of the number of shared landmarks
+    std::vector<std::weak_ptr<keyframe>> keyfrms_;
+    //! number of shared landmarks in descending order
+    std::vector<unsigned int> num_shared_lms_;
+};
+
 class graph_node {
 public:
     /**
@@ -44,7 +61,20 @@ public:
     void erase_all_connections();
 
     /**
-     * Update the connections and the covisibilities by referring landmark observations
+     * Count up the number of landmarks shared with the specified keyframe
+     * (NOTE: called by landmark whenever the keyframes are added to its observations)
+     */
+    void add_shared_landmark(const std::shared_ptr<keyframe>& keyfrm);
+
+    /**
+     * Count down the number of landmarks shared with the specified keyframe
+     * (NOTE: called by landmark whenever the keyframes are erased from its observations)
+     */
+    void erase_shared_landmark(const std::shared_ptr<keyframe>& keyfrm);
+
+    /**
+     * Update the connections and the covisibilities by referring the numbers of shared landmarks,
+     * which are maintained incrementally by add_shared_landmark() and erase_shared_landmark()
      */
     void update_connections(unsigned int min_num_shared_lms);
 
@@ -59,6 +89,17 @@ public:
      */
     std::set<std::shared_ptr<keyframe>> get_connected_keyframes() const;
 
+    /**
+     * Get the IDs of the connected keyframes in ascending order
+     */
+    std::vector<unsigned int> get_connected_keyframe_ids() const;
+
+    /**
+     * Get the latest snapshot of the ordered covisibilities (never nullptr)
+     * (NOTE: the mutex is locked only if the order has to be updated)
+     */
+    std::shared_ptr<const covisibility_snapshot> get_covisibility_snapshot() const;
+
     /**
      * Get the covisibility keyframes
      */
@@ -113,6 +154,13 @@ public:
      */
     void recover_spanning_connections();
 
+    /**
+     * Recover the spanning tree after erasing the keyframes with a single pass
+     * (the orphaned children are re-attached in descending order of the number of shared landmarks,
+     *  and the parent of each erased keyframe is set to its nearest ancestor which is not erased)
+     */
+    static void recover_spanning_connections(const std::vector<std::shared_ptr<keyframe>>& erased_keyfrms);
+
     /**
      * Get the children of spanning tree
      */
@@ -157,13 +205,17 @@ private:
      * Update the order of the covisibilities (without mutex)
      * (NOTE: the new keyframe won't inserted)
      */
-    void update_covisibility_orders_impl();
+    void update_covisibility_orders_impl() const;
 
     /**
-     * Extract intersection from the two lists of keyframes
+     * Sort the covisibilities if the connections have been modified after the last sort (without mutex)
      */
-    template<typename T, typename U>
-    static std::vector<std::shared_ptr<keyframe>> extract_intersection(const T& keyfrms_1, const U& keyfrms_2);
+    void sort_covisibilities_if_needed() const;
+
+    /**
+     * Publish the ordered covisibilities as the new snapshot (without mutex)
+     */
+    void publish_covisibility_snapshot(std::vector<std::weak_ptr<keyframe>>&& keyfrms, std::vector<unsigned int>&& num_shared_lms) const;
 
     //-----------------------------------------
     // implementation
@@ -172,16 +224,26 @@ private:
 
     bool is_spanning_root_impl() const;
 
+    //! Record the modification of the spanning tree or the loop edges in the owner keyframe
+    void set_owner_modified() const;
+
+    //! Detach the erased node from the spanning tree and leave the ancestor as the parent
+    void detach_from_spanning_tree(const std::shared_ptr<keyframe>& ancestor);
+
     //! keyframe of this node
     std::weak_ptr<keyframe> const owner_keyfrm_;
 
     //! all connected keyframes and the number of shared landmarks between the keyframes
     id_ordered_map<std::weak_ptr<keyframe>, unsigned int> connected_keyfrms_and_num_shared_lms_;
 
-    //! covisibility keyframe in descending order of the number of shared landmarks
-    std::vector<std::weak_ptr<keyframe>> ordered_covisibilities_;
-    //! number of shared landmarks in descending order
-    std::vector<unsigned int> ordered_num_shared_lms_;
+    //! number of landmarks shared with each keyframe (including the keyframes which are not connected yet)
+    util::id_ordered_flat_map<keyframe, unsigned int> num_shared_lms_;
+
+    //! ordered covisibilities, which are accessed with std::atomic_load and std::atomic_store
+    //! (sorted lazily when they are read after the connections are modified)
+    mutable std::shared_ptr<const covisibility_snapshot> covisibility_snapshot_;
+    //! the connections have been modified after the last sort or not
+    mutable std::atomic<bool> covisibility_orders_are_outdated_{false};
 
     //! parent of spanning tree
     std::weak_ptr<keyframe> spanning_parent_;
@@ -194,7 +256,7 @@ private:
     id_ordered_set<std::weak_ptr<keyframe>> loop_edges_;
 
     //! need mutex for access to connections
-    mutable std::mutex mtx_;
+    mutable util::profiled_mutex mtx_{"graph_node::mtx_"};
 };
 
 } // namespace data
@@ -0,0 +1,27 @@
+#ifndef STELLA_VSLAM_DATA_IMU_MEASUREMENT_H
+#define STELLA_VSLAM_DATA_IMU_MEASUREMENT_H
+
+#include "stella_vslam/type.h"
+
+namespace stella_vslam {
+namespace data {
+
+struct imu_measurement {
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    imu_measurement() = default;
+    imu_measurement(const double timestamp, const Vec3_t& acc, const Vec3_t& gyr)
+        : timestamp_(timestamp), acc_(acc), gyr_(gyr) {}
+
+    //! timestamp [s] (on the same clock as the frames)
+    double timestamp_ = 0.0;
+    //! linear acceleration [m/s^2] in the IMU frame
+    Vec3_t acc_ = Vec3_t::Zero();
+    //! angular velocity [rad/s] in the IMU frame
+    Vec3_t gyr_ = Vec3_t::Zero();
+};
+
+} // namespace data
+} // namespace stella_vslam
+
+#endif // STELLA_VSLAM_DATA_IMU_MEASUREMENT_H
@@ -1,9 +1,11 @@
 #include "stella_vslam/data/common.h"
 #include "stella_vslam/data/frame.h"
 #include "stella_vslam/data/keyframe.h"
+#include "stella_vslam/data/keyframe_spatial_index.h"
 #include "stella_vslam/data/landmark.h"
 #include "stella_vslam/data/marker.h"
 #include "stella_vslam/data/map_database.h"
+#include "stella_vslam/data/map_change_journal.h"
 #include "stella_vslam/data/bow_database.h"
 #include "stella_vslam/data/camera_database.h"
 #include "stella_vslam/data/orb_params_database.h"
@@ -11,34 +13,58 @@
 #include "stella_vslam/feature/orb_params.h"
 #include "stella_vslam/util/converter.h"
 
+#include <unordered_set>
+
 #include <nlohmann/json.hpp>
 #include <spdlog/spdlog.h>
 
 namespace stella_vslam {
 namespace data {
 
+namespace {
+//! Share the observations without the descriptors, which are held by the keyframe to be compacted
+std::shared_ptr<const frame_observation> share_without_descriptors(const std::shared_ptr<const frame_observation>& frm_obs) {
+    if (frm_obs->descriptors_.empty()) {
+        return frm_obs;
+    }
+    frame_observation frm_obs_without_descs(*frm_obs);
+    frm_obs_without_descs.descriptors_.release();
+    return make_frame_observation(std::move(frm_obs_without_descs));
+}
+} // namespace
+
 keyframe::keyframe(unsigned int id, const frame& frm)
     : id_(id), timestamp_(frm.timestamp_),
       camera_(frm.camera_), orb_params_(frm.orb_params_),
-      frm_obs_(frm.frm_obs_), markers_2d_(frm.markers_2d_),
+      frm_obs_(share_without_descriptors(frm.frm_obs_)), markers_2d_(frm.get_markers_2d()),
       bow_vec_(frm.bow_vec_), bow_feat_vec_(frm.bow_feat_vec_),
-      landmarks_(frm.get_landmarks()) {
+      landmarks_(frm.get_landmarks()), descriptors_(frm.frm_obs_->descriptors_) {
     // set pose parameters (pose_wc_, trans_wc_) using frm.pose_cw_
     set_pose_cw(frm.get_pose_cw());
+
+    std::lock_guard<util::profiled_mutex> lock(mtx_observations_);
+    account_memory();
 }
 
 keyframe::keyframe(const unsigned int id, const double timestamp,
                    const Mat44_t& pose_cw, camera::base* camera,
-                   const feature::orb_params* orb_params, const frame_observation& frm_obs,
-                   const bow_vector& bow_vec, const bow_feature_vector& bow_feat_vec)
+                   const feature::orb_params* orb_params, std::shared_ptr<const frame_observation> frm_obs,
+                   const bow_vector& bow_vec, const bow_feature_vector& bow_feat_vec,
+                   const cv::Mat& descriptors)
     : id_(id),
       timestamp_(timestamp), camera_(camera),
-      orb_params_(orb_params), frm_obs_(frm_obs),
+      orb_params_(orb_params), frm_obs_(share_without_descriptors(frm_obs)),
       bow_vec_(bow_vec), bow_feat_vec_(bow_feat_vec),
-      landmarks_(std::vector<std::shared_ptr<landmark>>(frm_obs_.num_keypts_, nullptr)) {
+      landmarks_(std::vector<std::shared_ptr<landmark>>(frm_obs_->num_keypts_, nullptr)),
+      descriptors_(frm_obs->descriptors_.empty() ? descriptors : frm_obs->descriptors_) {
     // set pose parameters (pose_wc_, trans_wc_) using pose_cw_
     set_pose_cw(pose_cw);
 
+    {
+        std::lock_guard<util::profiled_mutex> lock(mtx_observations_);
+        account_memory();
+    }
+
     // The following process needs to take place:
     //   should set the pointers of landmarks_ using add_landmark()
     //   should set connections using graph_node->update_connections()
@@ -61,13 +87,14 @@ std::shared_ptr<keyframe> keyframe::make_keyframe(unsigned int id, const frame&
 std::shared_ptr<keyframe> keyframe::make_keyframe(
     const unsigned int id, const double timestamp,
     const Mat44_t& pose_cw, camera::base* camera,
-    const feature::orb_params* orb_params, const frame_observation& frm_obs,
-    const bow_vector& bow_vec, const bow_feature_vector& bow_feat_vec) {
+    const feature::orb_params* orb_params, std::shared_ptr<const frame_observation> frm_obs,
+    const bow_vector& bow_vec, const bow_feature_vector& bow_feat_vec,
+    const cv::Mat& descriptors) {
     auto ptr = std::allocate_shared<keyframe>(
         Eigen::aligned_allocator<keyframe>(),
         id, timestamp,
         pose_cw, camera, orb_params,
-        frm_obs, bow_vec, bow_feat_vec);
+        std::move(frm_obs), bow_vec, bow_feat_vec, descriptors);
     // covisibility graph node (connections is not assigned yet)
     ptr->graph_node_ = stella_vslam::make_unique<graph_node>(ptr);
     return ptr;
@@ -134,19 +161,22 @@ std::shared_ptr<keyframe> keyframe::from_stmt(sqlite3_stmt* stmt,
     data::bow_vector bow_vec;
     data::bow_feature_vector bow_feat_vec;
     // Assign all the keypoints into grid
-    std::vector<std::vector<std::vector<unsigned int>>> keypt_indices_in_cells;
+    keypoint_grid keypt_indices_in_cells;
     data::assign_keypoints_to_grid(camera, undist_keypts, keypt_indices_in_cells);
     // Construct frame_observation
-    frame_observation frm_obs{num_keypts, descriptors, undist_keypts, bearings, stereo_x_right, depths, keypt_indices_in_cells};
-    // Compute BoW
-    data::bow_vocabulary_util::compute_bow(bow_vocab, descriptors, bow_vec, bow_feat_vec);
+    // (the descriptors are held by the keyframe apart from the observations)
+    frame_observation frm_obs{num_keypts, cv::Mat(), undist_keypts, bearings, stereo_x_right, depths, keypt_indices_in_cells};
+    // Compute BoW (deferred to the caller if bow_vocab is nullptr)
+    if (bow_vocab) {
+        data::bow_vocabulary_util::compute_bow(bow_vocab, descriptors, bow_vec, bow_feat_vec);
+    }
     auto keyfrm = data::keyframe::make_keyframe(
         id + next_keyframe_id, timestamp, pose_cw, camera, orb_params,
-        frm_obs, bow_vec, bow_feat_vec);
+        make_frame_observation(std::move(frm_obs)), bow_vec, bow_feat_vec, descriptors);
     return keyfrm;
 }
 
-nlohmann::json keyframe::to_json() const {
+nlohmann::json keyframe::to_json(const observation_encoding_t encoding) const {
     // extract landmark IDs
     std::vector<int> landmark_ids(landmarks_.size(), -1);
     for (unsigned int i = 0; i < landmark_ids.size(); ++i) {
@@ -173,18 +203,19 @@ nlohmann::json keyframe::to_json() const {
         loop_edge_ids.push_back(loop_edge->id_);
     }
 
+    const Mat44_t pose_cw = get_pose_cw();
     return {{"ts", timestamp_},
             {"cam", camera_->name_},
             {"orb_params", orb_params_->name_},
             // camera pose
-            {"rot_cw", convert_rotation_to_json(pose_cw_.block<3, 3>(0, 0))},
-            {"trans_cw", convert_translation_to_json(pose_cw_.block<3, 1>(0, 3))},
+            {"rot_cw", convert_rotation_to_json(pose_cw.block<3, 3>(0, 0))},
+            {"trans_cw", convert_translation_to_json(pose_cw.block<3, 1>(0, 3))},
             // features and observations
-            {"n_keypts", frm_obs_.num_keypts_},
-            {"undist_keypts", convert_keypoints_to_json(frm_obs_.undist_keypts_)},
-            {"x_rights", frm_obs_.stereo_x_right_},
-            {"depths", frm_obs_.depths_},
-            {"descs", convert_descriptors_to_json(frm_obs_.descriptors_)},
+            {"n_keypts", frm_obs_->num_keypts_},
+            {"undist_keypts", convert_keypoints_to_json(frm_obs_->undist_keypts_, encoding)},
+            {"x_rights", convert_floats_to_json(frm_obs_->stereo_x_right_, encoding)},
+            {"depths", convert_floats_to_json(frm_obs_->depths_, encoding)},
+            {"descs", convert_descriptors_to_json(get_descriptors(), encoding)},
             {"lm_ids", landmark_ids},
             // graph information
             {"span_parent", spanning_parent ? spanning_parent->id_ : -1},
@@ -193,6 +224,7 @@ nlohmann::json keyframe::to_json() const {
 }
 
 bool keyframe::bind_to_stmt(sqlite3* db, sqlite3_stmt* stmt) const {
+    // NOTE: the names and the observations (except for the descriptors) are immutable while the keyframe is alive, so they are bound without copying (SQLITE_STATIC)
     int ret = SQLITE_ERROR;
     int column_id = 1;
     ret = sqlite3_bind_int64(stmt, column_id++, id_);
@@ -203,11 +235,11 @@ bool keyframe::bind_to_stmt(sqlite3* db, sqlite3_stmt* stmt) const {
     }
     if (ret == SQLITE_OK) {
         const auto& camera_name = camera_->name_;
-        ret = sqlite3_bind_blob(stmt, column_id++, camera_name.c_str(), camera_name.size(), SQLITE_TRANSIENT);
+        ret = sqlite3_bind_blob(stmt, column_id++, camera_name.c_str(), camera_name.size(), SQLITE_STATIC);
     }
     if (ret == SQLITE_OK) {
         const auto& orb_params_name = orb_params_->name_;
-        ret = sqlite3_bind_blob(stmt, column_id++, orb_params_name.c_str(), orb_params_name.size(), SQLITE_TRANSIENT);
+        ret = sqlite3_bind_blob(stmt, column_id++, orb_params_name.c_str(), orb_params_name.size(), SQLITE_STATIC);
     }
     if (ret == SQLITE_OK) {
         const Mat44_t pose_cw = get_pose_cw();
@@ -215,24 +247,25 @@ bool keyframe::bind_to_stmt(sqlite3* db, sqlite3_stmt* stmt) const {
     }
     size_t num_keypts = 0;
     if (ret == SQLITE_OK) {
-        num_keypts = frm_obs_.undist_keypts_.size();
+        num_keypts = frm_obs_->undist_keypts_.size();
         ret = sqlite3_bind_int64(stmt, column_id++, num_keypts);
     }
     if (ret == SQLITE_OK) {
-        const auto& undist_keypts = frm_obs_.undist_keypts_;
+        const auto& undist_keypts = frm_obs_->undist_keypts_;
         assert(undist_keypts.size() == num_keypts);
-        ret = sqlite3_bind_blob(stmt, column_id++, undist_keypts.data(), undist_keypts.size() * sizeof(std::remove_reference<decltype(undist_keypts)>::type::value_type), SQLITE_TRANSIENT);
+        ret = sqlite3_bind_blob(stmt, column_id++, undist_keypts.data(), undist_keypts.size() * sizeof(std::remove_reference<decltype(undist_keypts)>::type::value_type), SQLITE_STATIC);
     }
     if (ret == SQLITE_OK) {
-        const auto& stereo_x_right = frm_obs_.stereo_x_right_;
-        ret = sqlite3_bind_blob(stmt, column_id++, stereo_x_right.data(), stereo_x_right.size() * sizeof(std::remove_reference<decltype(stereo_x_right)>::type::value_type), SQLITE_TRANSIENT);
+        const auto& stereo_x_right = frm_obs_->stereo_x_right_;
+        ret = sqlite3_bind_blob(stmt, column_id++, stereo_x_right.data(), stereo_x_right.size() * sizeof(std::remove_reference<decltype(stereo_x_right)>::type::value_type), SQLITE_STATIC);
     }
     if (ret == SQLITE_OK) {
-        const auto& depths = frm_obs_.depths_;
-        ret = sqlite3_bind_blob(stmt, column_id++, depths.data(), depths.size() * sizeof(std::remove_reference<decltype(depths)>::type::value_type), SQLITE_TRANSIENT);
+        const auto& depths = frm_obs_->depths_;
+        ret = sqlite3_bind_blob(stmt, column_id++, depths.data(), depths.size() * sizeof(std::remove_reference<decltype(depths)>::type::value_type), SQLITE_STATIC);
     }
     if (ret == SQLITE_OK) {
-        const auto& descriptors = frm_obs_.descriptors_;
+        // (the descriptors can be compacted after binding, so they are copied)
+        const auto descriptors = get_descriptors();
         assert(descriptors.dims == 2);
         assert(descriptors.channels() == 1);
         assert(descriptors.cols == 32);
@@ -247,46 +280,75 @@ bool keyframe::bind_to_stmt(sqlite3* db, sqlite3_stmt* stmt) const {
 }
 
 void keyframe::set_pose_cw(const Mat44_t& pose_cw) {
-    std::lock_guard<std::mutex> lock(mtx_pose_);
-    pose_cw_ = pose_cw;
-
-    const Mat33_t rot_cw = pose_cw_.block<3, 3>(0, 0);
-    const Vec3_t trans_cw = pose_cw_.block<3, 1>(0, 3);
-    const Mat33_t rot_wc = rot_cw.transpose();
-    trans_wc_ = -rot_wc * trans_cw;
+    std::lock_guard<util::profiled_mutex> lock(mtx_pose_);
+
+    // the inverse is computed once here instead of at each read
+    const Mat33_t rot_wc = pose_cw.block<3, 3>(0, 0).transpose();
+    const Vec3_t trans_wc = -rot_wc * pose_cw.block<3, 1>(0, 3);
+
+    pose_record record;
+    Eigen::Map<Mat44_t> record_pose_cw(record.pose_cw_);
+    Eigen::Map<Mat44_t> record_pose_wc(record.pose_wc_);
+    record_pose_cw = pose_cw;
+    record_pose_wc.block<3, 3>(0, 0) = rot_wc;
+    record_pose_wc.block<3, 1>(0, 3) = trans_wc;
+    pose_.store(record);
+
+    // keep the spatial index consistent with the pose (updated while locking mtx_pose_ to keep the order of the updates)
+    if (auto spatial_index = spatial_index_.lock()) {
+        spatial_index->update(id_, trans_wc);
+    }
+    if (auto change_journal = change_journal_.lock()) {
+        change_journal->record(map_object_type_t::Keyframe, id_, map_change_type_t::Updated);
+    }
 
-    pose_wc_ = Mat44_t::Identity();
-    pose_wc_.block<3, 3>(0, 0) = rot_wc;
-    pose_wc_.block<3, 1>(0, 3) = trans_wc_;
+    // NOTE: the constructors also record the creation here
+    set_modified();
 }
 
 void keyframe::set_pose_cw(const g2o::SE3Quat& pose_cw) {
     set_pose_cw(util::converter::to_eigen_mat(pose_cw));
 }
 
+void keyframe::set_spatial_index(const std::shared_ptr<keyframe_spatial_index>& spatial_index) {
+    std::lock_guard<util::profiled_mutex> lock(mtx_pose_);
+    if (auto prev_spatial_index = spatial_index_.lock()) {
+        prev_spatial_index->erase(id_);
+    }
+    spatial_index_ = spatial_index;
+    if (spatial_index) {
+        spatial_index->update(id_, get_trans_wc());
+    }
+}
+
+void keyframe::set_change_journal(const std::shared_ptr<map_change_journal>& change_journal) {
+    std::lock_guard<util::profiled_mutex> lock(mtx_pose_);
+    change_journal_ = change_journal;
+}
+
 Mat44_t keyframe::get_pose_cw() const {
-    std::lock_guard<std::mutex> lock(mtx_pose_);
-    return pose_cw_;
+    const auto record = pose_.load();
+    return Eigen::Map<const Mat44_t>(record.pose_cw_);
 }
 
 Mat44_t keyframe::get_pose_wc() const {
-    std::lock_guard<std::mutex> lock(mtx_pose_);
-    return pose_wc_;
+    const auto record = pose_.load();
+    return Eigen::Map<const Mat44_t>(record.pose_wc_);
 }
 
 Vec3_t keyframe::get_trans_wc() const {
-    std::lock_guard<std::mutex> lock(mtx_pose_);
-    return trans_wc_;
+    const auto record = pose_.load();
+    return Eigen::Map<const Mat44_t>(record.pose_wc_).block<3, 1>(0, 3);
 }
 
 Mat33_t keyframe::get_rot_cw() const {
-    std::lock_guard<std::mutex> lock(mtx_pose_);
-    return pose_cw_.block<3, 3>(0, 0);
+    const auto record = pose_.load();
+    return Eigen::Map<const Mat44_t>(record.pose_cw_).block<3, 3>(0, 0);
 }
 
 Vec3_t keyframe::get_trans_cw() const {
-    std::lock_guard<std::mutex> lock(mtx_pose_);
-    return pose_cw_.block<3, 1>(0, 3);
+    const auto record = pose_.load();
+    return Eigen::Map<const Mat44_t>(record.pose_cw_).block<3, 1>(0, 3);
 }
 
 bool keyframe::bow_is_available() const {
@@ -294,31 +356,165 @@ bool keyframe::bow_is_available() const {
 }
 
 void keyframe::compute_bow(bow_vocabulary* bow_vocab) {
-    bow_vocabulary_util::compute_bow(bow_vocab, frm_obs_.descriptors_, bow_vec_, bow_feat_vec_);
+    if (bow_is_available()) {
+        // the BoW representation is computed only once
+        return;
+    }
+    bow_vocabulary_util::compute_bow(bow_vocab, get_descriptors(), bow_vec_, bow_feat_vec_);
+
+    std::lock_guard<util::profiled_mutex> lock(mtx_observations_);
+    account_memory();
+}
+
+cv::Mat keyframe::get_descriptors() const {
+    std::lock_guard<util::profiled_mutex> lock(mtx_observations_);
+    if (compact_rows_.empty()) {
+        return descriptors_;
+    }
+    return hydrate_descriptors_impl();
+}
+
+cv::Mat keyframe::get_descriptor(const unsigned int idx) const {
+    std::lock_guard<util::profiled_mutex> lock(mtx_observations_);
+    if (compact_rows_.empty()) {
+        return descriptors_.row(idx);
+    }
+    const auto row = compact_rows_.at(idx);
+    return 0 <= row ? compact_descriptors_.row(row) : landmarks_.at(idx)->get_latest_descriptor();
+}
+
+bool keyframe::compact_descriptors() {
+    std::lock_guard<util::profiled_mutex> lock(mtx_observations_);
+    // the paged descriptors are released by the OS instead (see io::map_tile_streamer)
+    if (!compact_rows_.empty() || descriptors_.empty() || !descriptors_.u) {
+        return false;
+    }
+
+    std::vector<int> compact_rows(landmarks_.size(), -1);
+    unsigned int num_kept = 0;
+    for (unsigned int idx = 0; idx < landmarks_.size(); ++idx) {
+        const auto& lm = landmarks_.at(idx);
+        if (lm && !lm->will_be_erased() && lm->has_representative_descriptor()) {
+            continue;
+        }
+        compact_rows.at(idx) = num_kept++;
+    }
+    // nothing is saved if few keypoints are associated with the landmarks
+    // (the row indices take 4 bytes for each keypoint)
+    if (static_cast<size_t>(descriptors_.cols) * (landmarks_.size() - num_kept) <= sizeof(int) * landmarks_.size()) {
+        return false;
+    }
+
+    compact_descriptors_.create(num_kept, descriptors_.cols, descriptors_.type());
+    for (unsigned int idx = 0; idx < landmarks_.size(); ++idx) {
+        if (0 <= compact_rows.at(idx)) {
+            descriptors_.row(idx).copyTo(compact_descriptors_.row(compact_rows.at(idx)));
+        }
+    }
+    compact_rows_ = std::move(compact_rows);
+    descriptors_.release();
+    account_descriptor_memory();
+    return true;
+}
+
+void keyframe::hydrate_descriptors() {
+    std::lock_guard<util::profiled_mutex> lock(mtx_observations_);
+    if (compact_rows_.empty()) {
+        return;
+    }
+    descriptors_ = hydrate_descriptors_impl();
+    compact_rows_.clear();
+    compact_rows_.shrink_to_fit();
+    compact_descriptors_.release();
+    account_descriptor_memory();
+}
+
+bool keyframe::descriptors_are_compacted() const {
+    std::lock_guard<util::profiled_mutex> lock(mtx_observations_);
+    return !compact_rows_.empty();
+}
+
+cv::Mat keyframe::hydrate_descriptors_impl() const {
+    cv::Mat descriptors(compact_rows_.size(), compact_descriptors_.cols, compact_descriptors_.type());
+    for (unsigned int idx = 0; idx < compact_rows_.size(); ++idx) {
+        const auto row = compact_rows_.at(idx);
+        if (0 <= row) {
+            compact_descriptors_.row(row).copyTo(descriptors.row(idx));
+        }
+        else {
+            landmarks_.at(idx)->get_latest_descriptor().copyTo(descriptors.row(idx));
+        }
+    }
+    return descriptors;
+}
+
+void keyframe::keep_compacted_descriptor(const unsigned int idx) {
+    if (compact_rows_.empty() || 0 <= compact_rows_.at(idx)) {
+        return;
+    }
+    compact_descriptors_.push_back(landmarks_.at(idx)->get_latest_descriptor());
+    compact_rows_.at(idx) = compact_descriptors_.rows - 1;
+    account_descriptor_memory();
+}
+
+void keyframe::account_memory() {
+    account_descriptor_memory();
+
+    memory_account_.set(memory_category_t::KeyframeKeypoints,
+                        frm_obs_->undist_keypts_.capacity() * sizeof(cv::KeyPoint)
+                            + frm_obs_->undist_keypts_soa_.get_memory_bytes()
+                            + frm_obs_->bearings_.capacity() * sizeof(Vec3_t)
+                            + (frm_obs_->stereo_x_right_.capacity() + frm_obs_->depths_.capacity()) * sizeof(float));
+    memory_account_.set(memory_category_t::KeyframeGrids, frm_obs_->keypt_indices_in_cells_.get_memory_bytes());
+
+    size_t bow_bytes = bow_vec_.size() * get_node_bytes<bow_vector::value_type>()
+                       + bow_feat_vec_.size() * get_node_bytes<bow_feature_vector::value_type>();
+    for (const auto& node_indices : bow_feat_vec_) {
+        bow_bytes += node_indices.second.capacity() * sizeof(node_indices.second[0]);
+    }
+    memory_account_.set(memory_category_t::KeyframeBoW, bow_bytes);
+
+    memory_account_.set(memory_category_t::KeyframeObjects,
+                        sizeof(keyframe) + sizeof(graph_node) + sizeof(frame_observation)
+                            + landmarks_.capacity() * sizeof(std::shared_ptr<landmark>));
+}
+
+void keyframe::account_descriptor_memory() {
+    // (the paged descriptors are not counted, because they are reclaimed by the OS)
+    size_t bytes = descriptors_.u ? descriptors_.total() * descriptors_.elemSize() : 0;
+    bytes += compact_descriptors_.total() * compact_descriptors_.elemSize() + compact_rows_.capacity() * sizeof(int);
+    memory_account_.set(memory_category_t::KeyframeDescriptors, bytes);
 }
 
 void keyframe::add_landmark(std::shared_ptr<landmark> lm, const unsigned int idx) {
-    std::lock_guard<std::mutex> lock(mtx_observations_);
+    std::lock_guard<util::profiled_mutex> lock(mtx_observations_);
+    keep_compacted_descriptor(idx);
     landmarks_.at(idx) = lm;
+    set_modified();
 }
 
 void keyframe::erase_landmark_with_index(const unsigned int idx) {
-    std::lock_guard<std::mutex> lock(mtx_observations_);
+    std::lock_guard<util::profiled_mutex> lock(mtx_observations_);
+    keep_compacted_descriptor(idx);
     landmarks_.at(idx) = nullptr;
+    set_modified();
 }
 
 void keyframe::erase_landmark(const std::shared_ptr<landmark>& lm) {
-    std::lock_guard<std::mutex> lock(mtx_observations_);
+    std::lock_guard<util::profiled_mutex> lock(mtx_observations_);
     int idx = lm->get_index_in_keyframe(shared_from_this());
     if (0 <= idx) {
+        keep_compacted_descriptor(static_cast<unsigned int>(idx));
         landmarks_.at(static_cast<unsigned int>(idx)) = nullptr;
+        set_modified();
     }
 }
 
 void keyframe::update_landmarks() {
-    std::lock_guard<std::mutex> lock(mtx_observations_);
-    for (unsigned int idx = 0; idx < landmarks_.size(); ++idx) {
-        auto lm = landmarks_.at(idx);
+    // (the landmarks are updated without locking the observations, because the descriptors of this keyframe are read in compute_descriptor())
+    const auto landmarks = get_landmarks();
+    for (unsigned int idx = 0; idx < landmarks.size(); ++idx) {
+        const auto& lm = landmarks.at(idx);
         if (!lm) {
             continue;
         }
@@ -335,12 +531,12 @@ void keyframe::update_landmarks() {
 }
 
 std::vector<std::shared_ptr<landmark>> keyframe::get_landmarks() const {
-    std::lock_guard<std::mutex> lock(mtx_observations_);
+    std::lock_guard<util::profiled_mutex> lock(mtx_observations_);
     return landmarks_;
 }
 
 std::set<std::shared_ptr<landmark>> keyframe::get_valid_landmarks() const {
-    std::lock_guard<std::mutex> lock(mtx_observations_);
+    std::lock_guard<util::profiled_mutex> lock(mtx_observations_);
     std::set<std::shared_ptr<landmark>> valid_landmarks;
 
     for (const auto& lm : landmarks_) {
@@ -358,7 +554,7 @@ std::set<std::shared_ptr<landmark>> keyframe::get_valid_landmarks() const {
 }
 
 unsigned int keyframe::get_num_tracked_landmarks(const unsigned int min_num_obs_thr) const {
-    std::lock_guard<std::mutex> lock(mtx_observations_);
+    std::lock_guard<util::profiled_mutex> lock(mtx_observations_);
     unsigned int num_tracked_lms = 0;
 
     if (0 < min_num_obs_thr) {
@@ -392,36 +588,36 @@ unsigned int keyframe::get_num_tracked_landmarks(const unsigned int min_num_obs_
 }
 
 std::shared_ptr<landmark>& keyframe::get_landmark(const unsigned int idx) {
-    std::lock_guard<std::mutex> lock(mtx_observations_);
+    std::lock_guard<util::profiled_mutex> lock(mtx_observations_);
     return landmarks_.at(idx);
 }
 
 std::vector<unsigned int> keyframe::get_keypoints_in_cell(const float ref_x, const float ref_y, const float margin,
                                                           const int min_level, const int max_level) const {
-    return data::get_keypoints_in_cell(camera_, frm_obs_, ref_x, ref_y, margin, min_level, max_level);
+    return data::get_keypoints_in_cell(camera_, *frm_obs_, ref_x, ref_y, margin, min_level, max_level);
+}
+
+void keyframe::get_keypoints_in_cell(const float ref_x, const float ref_y, const float margin,
+                                     const int min_level, const int max_level,
+                                     std::vector<unsigned int>& indices) const {
+    data::get_keypoints_in_cell(camera_, *frm_obs_, ref_x, ref_y, margin, min_level, max_level, indices);
 }
 
 Vec3_t keyframe::triangulate_stereo(const unsigned int idx) const {
-    Mat44_t pose_wc;
-    {
-        std::lock_guard<std::mutex> lock(mtx_pose_);
-        pose_wc = pose_wc_;
-    }
-    return data::triangulate_stereo(camera_, pose_wc.block<3, 3>(0, 0), pose_wc.block<3, 1>(0, 3), frm_obs_, idx);
+    const Mat44_t pose_wc = get_pose_wc();
+    return data::triangulate_stereo(camera_, pose_wc.block<3, 3>(0, 0), pose_wc.block<3, 1>(0, 3), *frm_obs_, idx);
 }
 
 float keyframe::compute_median_depth(const bool abs) const {
     std::vector<std::shared_ptr<landmark>> landmarks;
-    Mat44_t pose_cw;
     {
-        std::lock_guard<std::mutex> lock1(mtx_observations_);
-        std::lock_guard<std::mutex> lock2(mtx_pose_);
+        std::lock_guard<util::profiled_mutex> lock(mtx_observations_);
         landmarks = landmarks_;
-        pose_cw = pose_cw_;
     }
+    const Mat44_t pose_cw = get_pose_cw();
 
     std::vector<float> depths;
-    depths.reserve(frm_obs_.num_keypts_);
+    depths.reserve(frm_obs_->num_keypts_);
     const Vec3_t rot_cw_z_row = pose_cw.block<1, 3>(2, 0);
     const float trans_cw_z = pose_cw(2, 3);
 
@@ -444,12 +640,12 @@ bool keyframe::depth_is_available() const {
 }
 
 void keyframe::add_marker(const std::shared_ptr<marker>& mkr) {
-    std::lock_guard<std::mutex> lock(mtx_observations_);
+    std::lock_guard<util::profiled_mutex> lock(mtx_observations_);
     markers_[mkr->id_] = mkr;
 }
 
 std::vector<std::shared_ptr<marker>> keyframe::get_markers() const {
-    std::lock_guard<std::mutex> lock(mtx_observations_);
+    std::lock_guard<util::profiled_mutex> lock(mtx_observations_);
     std::vector<std::shared_ptr<marker>> markers;
     markers.reserve(markers_.size());
     for (const auto& id_marker : markers_) {
@@ -469,55 +665,99 @@ void keyframe::set_to_be_erased() {
 }
 
 void keyframe::prepare_for_erasing(map_database* map_db, bow_database* bow_db) {
-    if (graph_node_->is_spanning_root()) {
-        spdlog::warn("cannot erase the root node: {}", id_);
-        return;
-    }
-
-    // cannot erase if the frag is raised
-    if (cannot_be_erased_) {
-        return;
-    }
+    prepare_for_erasing(std::vector<std::shared_ptr<keyframe>>{shared_from_this()}, map_db, bow_db);
+}
 
+unsigned int keyframe::prepare_for_erasing(const std::vector<std::shared_ptr<keyframe>>& keyfrms,
+                                           map_database* map_db, bow_database* bow_db) {
     // 1. raise the flag which indicates it has been erased
 
-    SPDLOG_TRACE("keyframe::prepare_for_erasing {}", id_);
-    will_be_erased_ = true;
+    std::vector<std::shared_ptr<keyframe>> erased_keyfrms;
+    erased_keyfrms.reserve(keyfrms.size());
+    for (const auto& keyfrm : keyfrms) {
+        if (keyfrm->will_be_erased()) {
+            continue;
+        }
+        if (keyfrm->graph_node_->is_spanning_root()) {
+            spdlog::warn("cannot erase the root node: {}", keyfrm->id_);
+            continue;
+        }
+        // cannot erase if the frag is raised
+        if (keyfrm->cannot_be_erased_) {
+            continue;
+        }
+
+        SPDLOG_TRACE("keyframe::prepare_for_erasing {}", keyfrm->id_);
+        keyfrm->will_be_erased_ = true;
+        erased_keyfrms.push_back(keyfrm);
+    }
+    if (erased_keyfrms.empty()) {
+        return 0;
+    }
 
     // 2. remove associations between keypoints and landmarks
 
-    {
-        std::lock_guard<std::mutex> lock(mtx_observations_);
-        for (const auto& lm : landmarks_) {
+    std::vector<std::shared_ptr<landmark>> observed_lms;
+    for (const auto& keyfrm : erased_keyfrms) {
+        std::lock_guard<util::profiled_mutex> lock(keyfrm->mtx_observations_);
+        for (const auto& lm : keyfrm->landmarks_) {
             if (!lm) {
                 continue;
             }
             if (lm->will_be_erased()) {
                 continue;
             }
-            lm->erase_observation(map_db, shared_from_this());
-            if (!lm->will_be_erased()) {
-                lm->compute_descriptor();
-                lm->update_mean_normal_and_obs_scale_variance();
-            }
+            lm->erase_observation(map_db, keyfrm);
+            observed_lms.push_back(lm);
         }
     }
+    // the landmarks shared by the erased keyframes are updated only once
+    std::unordered_set<unsigned int> updated_lm_ids;
+    for (const auto& lm : observed_lms) {
+        if (lm->will_be_erased() || !updated_lm_ids.insert(lm->id_).second) {
+            continue;
+        }
+        lm->compute_descriptor();
+        lm->update_mean_normal_and_obs_scale_variance();
+    }
 
     // 3. recover covisibility graph and spanning tree
 
     // remove covisibility information
-    graph_node_->erase_all_connections();
+    for (const auto& keyfrm : erased_keyfrms) {
+        keyfrm->graph_node_->erase_all_connections();
+    }
     // recover spanning tree
-    graph_node_->recover_spanning_connections();
+    graph_node::recover_spanning_connections(erased_keyfrms);
+
+    for (const auto& keyfrm : erased_keyfrms) {
+        // 4. update frame statistics
+
+        map_db->replace_reference_keyframe(keyfrm, keyfrm->graph_node_->get_spanning_parent());
+
+        // 5. remove myself from the databased
+
+        map_db->erase_keyframe(keyfrm);
+        bow_db->erase_keyframe(keyfrm);
+    }
+
+    return static_cast<unsigned int>(erased_keyfrms.size());
+}
 
-    // 3. update frame statistics
+void keyframe::set_modified() {
+    modified_epoch_.store(map_database::save_epoch_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
 
-    map_db->replace_reference_keyframe(shared_from_this(), graph_node_->get_spanning_parent());
+bool keyframe::is_modified_since(const unsigned int epoch) const {
+    return epoch <= modified_epoch_.load(std::memory_order_relaxed);
+}
 
-    // 4. remove myself from the databased
+unsigned int keyframe::get_modified_epoch() const {
+    return modified_epoch_.load(std::memory_order_relaxed);
+}
 
-    map_db->erase_keyframe(shared_from_this());
-    bow_db->erase_keyframe(shared_from_this());
+void keyframe::set_modified_epoch(const unsigned int epoch) {
+    modified_epoch_.store(epoch, std::memory_order_relaxed);
 }
 
 bool keyframe::will_be_erased() {
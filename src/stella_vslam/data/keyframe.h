@@ -8,7 +8,12 @@
 #include "stella_vslam/data/bow_vocabulary.h"
 #include "stella_vslam/data/frame_observation.h"
 #include "stella_vslam/data/marker2d.h"
+#include "stella_vslam/data/memory_usage.h"
+#include "stella_vslam/data/observation_encoding.h"
+#include "stella_vslam/data/slot_table.h"
 #include "stella_vslam/data/bow_vocabulary_fwd.h"
+#include "stella_vslam/util/lock_profiler.h"
+#include "stella_vslam/util/seqlock.h"
 
 #include <set>
 #include <mutex>
@@ -35,6 +40,8 @@ class map_database;
 class bow_database;
 class camera_database;
 class orb_params_database;
+class keyframe_spatial_index;
+class map_change_journal;
 
 class keyframe : public std::enable_shared_from_this<keyframe> {
 public:
@@ -48,11 +55,14 @@ public:
     /**
      * Constructor for map loading
      * (NOTE: some variables must be recomputed after the construction. See the definition.)
+     * (NOTE: frm_obs is shared without a copy if it has no descriptors. Use make_frame_observation() to wrap a block)
+     * @param descriptors descriptors of the keypoints (used if frm_obs has no descriptors)
      */
     keyframe(const unsigned int id,
              const double timestamp, const Mat44_t& pose_cw, camera::base* camera,
-             const feature::orb_params* orb_params, const frame_observation& frm_obs,
-             const bow_vector& bow_vec, const bow_feature_vector& bow_feat_vec);
+             const feature::orb_params* orb_params, std::shared_ptr<const frame_observation> frm_obs,
+             const bow_vector& bow_vec, const bow_feature_vector& bow_feat_vec,
+             const cv::Mat& descriptors = cv::Mat());
     virtual ~keyframe();
 
     // Factory method for create keyframe
@@ -60,8 +70,10 @@ public:
     static std::shared_ptr<keyframe> make_keyframe(
         const unsigned int id,
         const double timestamp, const Mat44_t& pose_cw, camera::base* camera,
-        const feature::orb_params* orb_params, const frame_observation& frm_obs,
-        const bow_vector& bow_vec, const bow_feature_vector& bow_feat_vec);
+        const feature::orb_params* orb_params, std::shared_ptr<const frame_observation> frm_obs,
+        const bow_vector& bow_vec, const bow_feature_vector& bow_feat_vec,
+        const cv::Mat& descriptors = cv::Mat());
+    //! Decode a row of the keyframe table (the BoW is not computed if bow_vocab is nullptr)
     static std::shared_ptr<keyframe> from_stmt(sqlite3_stmt* stmt,
                                                camera_database* cam_db,
                                                orb_params_database* orb_params_db,
@@ -78,8 +90,9 @@ public:
 
     /**
      * Encode this keyframe information as JSON
+     * @param encoding encoding of the keypoints, the descriptors and the stereo observations
      */
-    nlohmann::json to_json() const;
+    nlohmann::json to_json(const observation_encoding_t encoding = observation_encoding_t::Json) const;
 
     /**
      * Save this keyframe information to db
@@ -112,8 +125,21 @@ public:
      */
     void set_pose_cw(const g2o::SE3Quat& pose_cw);
 
+    /**
+     * Register the camera center to the spatial index, which is updated whenever the pose is set
+     * (nullptr to unregister)
+     */
+    void set_spatial_index(const std::shared_ptr<keyframe_spatial_index>& spatial_index);
+
+    /**
+     * Register the keyframe to the change journal, which records the update whenever the pose is set
+     * (nullptr to unregister)
+     */
+    void set_change_journal(const std::shared_ptr<map_change_journal>& change_journal);
+
     /**
      * Get the camera pose
+     * (the readers of the pose do not lock any mutex)
      */
     Mat44_t get_pose_cw() const;
 
@@ -147,9 +173,40 @@ public:
 
     /**
      * Compute BoW representation
+     * (NOTE: nothing is done if it has been already computed)
      */
     void compute_bow(bow_vocabulary* bow_vocab);
 
+    /**
+     * Get the descriptors of the keypoints
+     * (NOTE: a shallow copy, or a new matrix hydrated from the compact representation if the descriptors are compacted)
+     */
+    cv::Mat get_descriptors() const;
+
+    /**
+     * Get the descriptor of the keypoint idx (see get_descriptors())
+     */
+    cv::Mat get_descriptor(const unsigned int idx) const;
+
+    /**
+     * Compact the descriptors of this keyframe
+     * The descriptors of the keypoints associated with the landmarks are dropped in favor of the representative ones of the landmarks,
+     * and only the others (and the BoW) are kept. The descriptors are hydrated on demand by get_descriptors().
+     * (NOTE: the paged descriptors, which refer to the mapped file, are not compacted)
+     * @return true if the descriptors are compacted by this call
+     */
+    bool compact_descriptors();
+
+    /**
+     * Restore the full descriptors from the compact representation
+     */
+    void hydrate_descriptors();
+
+    /**
+     * Whether the descriptors are compacted or not
+     */
+    bool descriptors_are_compacted() const;
+
     /**
      * Add a landmark observed by myself at keypoint idx
      */
@@ -176,6 +233,19 @@ public:
      */
     std::vector<std::shared_ptr<landmark>> get_landmarks() const;
 
+    /**
+     * Visit all of the landmarks without copying them
+     * (NOTE: func(lm, idx) is called including nullptr, while locking the observations of this keyframe,
+     *        so DO NOT call the methods of this keyframe in func)
+     */
+    template<typename Func>
+    void for_each_landmark(Func&& func) const {
+        std::lock_guard<util::profiled_mutex> lock(mtx_observations_);
+        for (unsigned int idx = 0; idx < landmarks_.size(); ++idx) {
+            func(landmarks_[idx], idx);
+        }
+    }
+
     /**
      * Get the valid landmarks
      */
@@ -197,6 +267,14 @@ public:
     std::vector<unsigned int> get_keypoints_in_cell(const float ref_x, const float ref_y, const float margin,
                                                     const int min_level = -1, const int max_level = -1) const;
 
+    /**
+     * Get the keypoint indices in the cell which reference point is located into the buffer
+     * (the buffer is cleared first and its capacity is reused)
+     */
+    void get_keypoints_in_cell(const float ref_x, const float ref_y, const float margin,
+                               const int min_level, const int max_level,
+                               std::vector<unsigned int>& indices) const;
+
     /**
      * Triangulate the keypoint using the disparity
      */
@@ -241,16 +319,42 @@ public:
      */
     void prepare_for_erasing(map_database* map_db, bow_database* bow_db);
 
+    /**
+     * Erase the keyframes with a single repair pass of the spanning tree
+     * (the root node and the keyframes which cannot be erased are skipped)
+     * @return the number of the erased keyframes
+     */
+    static unsigned int prepare_for_erasing(const std::vector<std::shared_ptr<keyframe>>& keyfrms,
+                                            map_database* map_db, bow_database* bow_db);
+
     /**
      * Whether this keyframe will be erased shortly or not
      */
     bool will_be_erased();
 
+    /**
+     * Record the modification (pose, landmarks or spanning tree) for the incremental map saving
+     */
+    void set_modified();
+
+    /**
+     * Whether this keyframe is modified at or after the specified save epoch (see map_database::save_epoch_)
+     */
+    bool is_modified_since(const unsigned int epoch) const;
+
+    /**
+     * Get/set the save epoch of the last modification (used to copy it to a snapshot)
+     */
+    unsigned int get_modified_epoch() const;
+    void set_modified_epoch(const unsigned int epoch);
+
     //-----------------------------------------
     // meta information
 
     //! keyframe ID
     unsigned int id_;
+    //! handle in the slot table of the map database (set when the keyframe is added)
+    slot_handle handle_;
 
     //! timestamp in seconds
     const double timestamp_;
@@ -270,7 +374,8 @@ public:
     //-----------------------------------------
     // constant observations
 
-    const frame_observation frm_obs_;
+    //! (NOTE: shared with the frame which the keyframe is created from, except for the descriptors which are held by the keyframe. See get_descriptors())
+    const std::shared_ptr<const frame_observation> frm_obs_;
 
     //! observed markers 2D (ID to marker2d map)
     std::unordered_map<unsigned int, marker2d> markers_2d_;
@@ -289,23 +394,57 @@ private:
     //-----------------------------------------
     // camera pose
 
-    //! need mutex for access to poses
-    mutable std::mutex mtx_pose_;
-    //! camera pose from the world to the current
-    Mat44_t pose_cw_;
-    //! camera pose from the current to the world
-    Mat44_t pose_wc_;
-    //! camera center
-    Vec3_t trans_wc_;
+    //! trivially copyable record of the camera pose and its derived quantities for the seqlock
+    struct pose_record {
+        //! column-major camera pose from the world to the current
+        double pose_cw_[16] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+        //! column-major camera pose from the current to the world (the camera center is the last column)
+        double pose_wc_[16] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+    };
+
+    //! need mutex for the writers of the pose, the spatial index and the change journal
+    //! (the readers of the pose read pose_ without locking it)
+    util::profiled_mutex mtx_pose_{"keyframe::mtx_pose_"};
+    //! camera pose and its inverse
+    util::seqlock<pose_record> pose_;
+    //! spatial index which the camera center is registered to
+    std::weak_ptr<keyframe_spatial_index> spatial_index_;
+    //! change journal which the pose updates are recorded to
+    std::weak_ptr<map_change_journal> change_journal_;
 
     //-----------------------------------------
     // observations
 
     //! need mutex for access to landmark observations
-    mutable std::mutex mtx_observations_;
+    mutable util::profiled_mutex mtx_observations_{"keyframe::mtx_observations_"};
     //! observed landmarks
     std::vector<std::shared_ptr<landmark>> landmarks_;
 
+    //! Keep the descriptor of the keypoint idx before its landmark is changed (NOTE: mtx_observations_ must be locked)
+    void keep_compacted_descriptor(const unsigned int idx);
+
+    //! Build the full descriptors from the compact representation (NOTE: mtx_observations_ must be locked)
+    cv::Mat hydrate_descriptors_impl() const;
+
+    //! descriptors of the keypoints (empty while they are compacted, guarded by mtx_observations_)
+    cv::Mat descriptors_;
+    //! row of each keypoint in compact_descriptors_, or -1 if the representative descriptor of the landmark is used (empty unless compacted)
+    std::vector<int> compact_rows_;
+    //! descriptors which are kept in the compact representation
+    cv::Mat compact_descriptors_;
+
+    //-----------------------------------------
+    // memory accounting
+
+    //! Account the bytes of all of the structures to memory_counter (NOTE: mtx_observations_ must be locked)
+    void account_memory();
+
+    //! Account the bytes of the descriptors to memory_counter (NOTE: mtx_observations_ must be locked)
+    void account_descriptor_memory();
+
+    //! bytes accounted to memory_counter (guarded by mtx_observations_)
+    memory_account memory_account_;
+
     //-----------------------------------------
     // marker observations
 
@@ -320,6 +459,9 @@ private:
 
     //! flag which indicates this keyframe will be erased
     std::atomic<bool> will_be_erased_{false};
+
+    //! save epoch of the last modification
+    std::atomic<unsigned int> modified_epoch_{0};
 };
 
 } // namespace data
@@ -0,0 +1,176 @@
+#include "stella_vslam/data/keyframe_spatial_index.h"
+#include "stella_vslam/data/memory_usage.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace stella_vslam {
+namespace data {
+
+keyframe_spatial_index::keyframe_spatial_index(const double cell_size)
+    : cell_size_(cell_size) {
+    if (cell_size_ <= 0.0) {
+        throw std::runtime_error("cell size of the keyframe spatial index must be greater than 0");
+    }
+}
+
+void keyframe_spatial_index::update(const unsigned int id, const Vec3_t& cam_center) {
+    const auto cell_coords = to_cell_coords(cam_center);
+
+    std::lock_guard<std::mutex> lock(mtx_);
+
+    const auto iter = cell_coords_of_keyfrm_.find(id);
+    if (iter != cell_coords_of_keyfrm_.end()) {
+        if (iter->second == cell_coords) {
+            // the keyframe stays in the same voxel
+            return;
+        }
+        // remove the keyframe from the previous voxel
+        auto& prev_keyfrm_ids = keyfrm_ids_in_cell_.at(to_cell_key(iter->second));
+        prev_keyfrm_ids.erase(std::find(prev_keyfrm_ids.begin(), prev_keyfrm_ids.end(), id));
+        if (prev_keyfrm_ids.empty()) {
+            keyfrm_ids_in_cell_.erase(to_cell_key(iter->second));
+        }
+        iter->second = cell_coords;
+    }
+    else {
+        cell_coords_of_keyfrm_.emplace(id, cell_coords);
+    }
+    keyfrm_ids_in_cell_[to_cell_key(cell_coords)].push_back(id);
+}
+
+void keyframe_spatial_index::erase(const unsigned int id) {
+    std::lock_guard<std::mutex> lock(mtx_);
+
+    const auto iter = cell_coords_of_keyfrm_.find(id);
+    if (iter == cell_coords_of_keyfrm_.end()) {
+        return;
+    }
+    const auto cell_key = to_cell_key(iter->second);
+    auto& keyfrm_ids = keyfrm_ids_in_cell_.at(cell_key);
+    keyfrm_ids.erase(std::find(keyfrm_ids.begin(), keyfrm_ids.end(), id));
+    if (keyfrm_ids.empty()) {
+        keyfrm_ids_in_cell_.erase(cell_key);
+    }
+    cell_coords_of_keyfrm_.erase(iter);
+}
+
+void keyframe_spatial_index::clear() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    keyfrm_ids_in_cell_.clear();
+    cell_coords_of_keyfrm_.clear();
+}
+
+std::vector<unsigned int> keyframe_spatial_index::get_keyframes_in_sphere(const Vec3_t& center, const double radius) const {
+    std::vector<unsigned int> keyfrm_ids;
+    if (radius < 0.0) {
+        return keyfrm_ids;
+    }
+
+    const auto min_coords = to_cell_coords(center - Vec3_t::Constant(radius));
+    const auto max_coords = to_cell_coords(center + Vec3_t::Constant(radius));
+    // a voxel intersects the sphere only if its center is within this distance
+    const double max_dist = radius + 0.5 * std::sqrt(3.0) * cell_size_;
+
+    std::lock_guard<std::mutex> lock(mtx_);
+
+    double num_cells_in_box = 1.0;
+    for (unsigned int i = 0; i < 3; ++i) {
+        num_cells_in_box *= static_cast<double>(max_coords[i] - min_coords[i] + 1);
+    }
+
+    if (static_cast<double>(keyfrm_ids_in_cell_.size()) < num_cells_in_box) {
+        // fewer occupied voxels than the voxels in the bounding box
+        for (const auto& cell_coords_of_keyfrm : cell_coords_of_keyfrm_) {
+            if ((get_cell_center(cell_coords_of_keyfrm.second) - center).norm() <= max_dist) {
+                keyfrm_ids.push_back(cell_coords_of_keyfrm.first);
+            }
+        }
+        return keyfrm_ids;
+    }
+
+    cell_coords_t cell_coords;
+    for (cell_coords[0] = min_coords[0]; cell_coords[0] <= max_coords[0]; ++cell_coords[0]) {
+        for (cell_coords[1] = min_coords[1]; cell_coords[1] <= max_coords[1]; ++cell_coords[1]) {
+            for (cell_coords[2] = min_coords[2]; cell_coords[2] <= max_coords[2]; ++cell_coords[2]) {
+                if (max_dist < (get_cell_center(cell_coords) - center).norm()) {
+                    continue;
+                }
+                const auto iter = keyfrm_ids_in_cell_.find(to_cell_key(cell_coords));
+                if (iter == keyfrm_ids_in_cell_.end()) {
+                    continue;
+                }
+                for (const auto id : iter->second) {
+                    // skip the keyframes in the other voxels which share the hash key
+                    if (cell_coords_of_keyfrm_.at(id) == cell_coords) {
+                        keyfrm_ids.push_back(id);
+                    }
+                }
+            }
+        }
+    }
+    return keyfrm_ids;
+}
+
+std::vector<unsigned int> keyframe_spatial_index::get_keyframes_in_cylinder(const Vec3_t& point, const Vec3_t& axis, const double radius) const {
+    std::vector<unsigned int> keyfrm_ids;
+    if (radius < 0.0) {
+        return keyfrm_ids;
+    }
+
+    // a voxel intersects the cylinder only if its center is within this distance from the axis
+    const double max_dist = radius + 0.5 * std::sqrt(3.0) * cell_size_;
+
+    std::lock_guard<std::mutex> lock(mtx_);
+
+    // the cylinder is unbounded, so check each occupied voxel
+    for (const auto& keyfrm_ids_in_cell : keyfrm_ids_in_cell_) {
+        const auto& ids = keyfrm_ids_in_cell.second;
+        for (const auto id : ids) {
+            const Vec3_t vec = get_cell_center(cell_coords_of_keyfrm_.at(id)) - point;
+            if ((vec - vec.dot(axis) * axis).norm() <= max_dist) {
+                keyfrm_ids.push_back(id);
+            }
+        }
+    }
+    return keyfrm_ids;
+}
+
+size_t keyframe_spatial_index::size() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return cell_coords_of_keyfrm_.size();
+}
+
+size_t keyframe_spatial_index::get_memory_bytes() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    // (each keyframe is listed in a voxel)
+    return keyfrm_ids_in_cell_.bucket_count() * sizeof(void*)
+           + keyfrm_ids_in_cell_.size() * get_node_bytes<std::pair<const cell_key_t, std::vector<unsigned int>>>()
+           + cell_coords_of_keyfrm_.bucket_count() * sizeof(void*)
+           + cell_coords_of_keyfrm_.size() * (get_node_bytes<std::pair<const unsigned int, cell_coords_t>>() + sizeof(unsigned int));
+}
+
+keyframe_spatial_index::cell_coords_t keyframe_spatial_index::to_cell_coords(const Vec3_t& pos) const {
+    return cell_coords_t{{static_cast<std::int64_t>(std::floor(pos(0) / cell_size_)),
+                          static_cast<std::int64_t>(std::floor(pos(1) / cell_size_)),
+                          static_cast<std::int64_t>(std::floor(pos(2) / cell_size_))}};
+}
+
+keyframe_spatial_index::cell_key_t keyframe_spatial_index::to_cell_key(const cell_coords_t& cell_coords) {
+    // pack the lower 21 bits of each coordinate
+    // (distant voxels might share the key, which is resolved by comparing the coordinates)
+    constexpr cell_key_t mask = (static_cast<cell_key_t>(1) << 21) - 1;
+    return ((static_cast<cell_key_t>(cell_coords[0]) & mask) << 42)
+           | ((static_cast<cell_key_t>(cell_coords[1]) & mask) << 21)
+           | (static_cast<cell_key_t>(cell_coords[2]) & mask);
+}
+
+Vec3_t keyframe_spatial_index::get_cell_center(const cell_coords_t& cell_coords) const {
+    return Vec3_t((static_cast<double>(cell_coords[0]) + 0.5) * cell_size_,
+                  (static_cast<double>(cell_coords[1]) + 0.5) * cell_size_,
+                  (static_cast<double>(cell_coords[2]) + 0.5) * cell_size_);
+}
+
+} // namespace data
+} // namespace stella_vslam
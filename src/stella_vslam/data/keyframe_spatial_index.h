@@ -0,0 +1,101 @@
+#ifndef STELLA_VSLAM_DATA_KEYFRAME_SPATIAL_INDEX_H
+#define STELLA_VSLAM_DATA_KEYFRAME_SPATIAL_INDEX_H
+
+#include "stella_vslam/type.h"
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+#include <unordered_map>
+
+namespace stella_vslam {
+namespace data {
+
+/**
+ * Voxel hash of the camera centers of the keyframes
+ * (NOTE: the keyframes registered by map_database update their entries whenever their poses are set)
+ */
+class keyframe_spatial_index {
+public:
+    /**
+     * Constructor
+     * @param cell_size edge length of a voxel
+     */
+    explicit keyframe_spatial_index(const double cell_size = 1.0);
+
+    /**
+     * Destructor
+     */
+    virtual ~keyframe_spatial_index() = default;
+
+    /**
+     * Insert the keyframe, or move it to the voxel of the new camera center
+     * @param id keyframe ID
+     * @param cam_center camera center in the world coordinates
+     */
+    void update(const unsigned int id, const Vec3_t& cam_center);
+
+    /**
+     * Erase the keyframe
+     * @param id keyframe ID
+     */
+    void erase(const unsigned int id);
+
+    /**
+     * Clear the index
+     */
+    void clear();
+
+    /**
+     * Get the keyframes which may be within the sphere
+     * (NOTE: the result is a superset of the exact answer, so verify the candidates with their current poses)
+     * @param center
+     * @param radius
+     * @return keyframe IDs
+     */
+    std::vector<unsigned int> get_keyframes_in_sphere(const Vec3_t& center, const double radius) const;
+
+    /**
+     * Get the keyframes which may be within the infinite cylinder
+     * (NOTE: the result is a superset of the exact answer, so verify the candidates with their current poses)
+     * @param point point on the axis
+     * @param axis unit vector of the axis
+     * @param radius
+     * @return keyframe IDs
+     */
+    std::vector<unsigned int> get_keyframes_in_cylinder(const Vec3_t& point, const Vec3_t& axis, const double radius) const;
+
+    //! number of the registered keyframes
+    size_t size() const;
+
+    //! Estimated bytes of the voxels
+    size_t get_memory_bytes() const;
+
+private:
+    using cell_coords_t = std::array<std::int64_t, 3>;
+    using cell_key_t = std::uint64_t;
+
+    //! Integer coordinates of the voxel which contains the point
+    cell_coords_t to_cell_coords(const Vec3_t& pos) const;
+
+    //! Hash key of the voxel
+    static cell_key_t to_cell_key(const cell_coords_t& cell_coords);
+
+    //! Center of the voxel
+    Vec3_t get_cell_center(const cell_coords_t& cell_coords) const;
+
+    //! edge length of a voxel
+    const double cell_size_;
+
+    mutable std::mutex mtx_;
+    //! keyframe IDs in each voxel
+    std::unordered_map<cell_key_t, std::vector<unsigned int>> keyfrm_ids_in_cell_;
+    //! voxel coordinates of each keyframe
+    std::unordered_map<unsigned int, cell_coords_t> cell_coords_of_keyfrm_;
+};
+
+} // namespace data
+} // namespace stella_vslam
+
+#endif // STELLA_VSLAM_DATA_KEYFRAME_SPATIAL_INDEX_H
@@ -0,0 +1,105 @@
+#ifndef STELLA_VSLAM_DATA_KEYPOINT_GRID_H
+#define STELLA_VSLAM_DATA_KEYPOINT_GRID_H
+
+#include <cassert>
+#include <cstddef>
+#include <vector>
+
+namespace stella_vslam {
+namespace data {
+
+/**
+ * Keypoint indices assigned to the grid cells, stored in compressed sparse row format
+ * (one offset array and one index array, so that copying the grid is a pair of memcpys)
+ */
+class keypoint_grid {
+public:
+    //! Range of the keypoint indices in a cell
+    class cell_range {
+    public:
+        cell_range(const unsigned int* begin, const unsigned int* end)
+            : begin_(begin), end_(end) {}
+
+        const unsigned int* begin() const { return begin_; }
+        const unsigned int* end() const { return end_; }
+        size_t size() const { return end_ - begin_; }
+        bool empty() const { return begin_ == end_; }
+
+    private:
+        const unsigned int* begin_;
+        const unsigned int* end_;
+    };
+
+    keypoint_grid() = default;
+
+    /**
+     * Build the grid from the cell index of each keypoint
+     * (NOTE: the indices in each cell are kept in ascending order)
+     * @param num_cols number of the grid columns
+     * @param num_rows number of the grid rows
+     * @param cell_indices cell index (cell_idx_x * num_rows + cell_idx_y) of each keypoint, or -1 if outside the grid
+     */
+    void assign(const unsigned int num_cols, const unsigned int num_rows, const std::vector<int>& cell_indices) {
+        num_cols_ = num_cols;
+        num_rows_ = num_rows;
+        const unsigned int num_cells = num_cols_ * num_rows_;
+
+        // Count the keypoints in each cell, then convert the counts to the offsets
+        offsets_.assign(num_cells + 1, 0);
+        for (const auto cell_idx : cell_indices) {
+            if (0 <= cell_idx) {
+                ++offsets_[cell_idx + 1];
+            }
+        }
+        for (unsigned int i = 0; i < num_cells; ++i) {
+            offsets_[i + 1] += offsets_[i];
+        }
+
+        // Fill the indices
+        indices_.resize(offsets_[num_cells]);
+        std::vector<unsigned int> cursors(offsets_.begin(), offsets_.end() - 1);
+        for (unsigned int idx = 0; idx < cell_indices.size(); ++idx) {
+            const auto cell_idx = cell_indices[idx];
+            if (0 <= cell_idx) {
+                indices_[cursors[cell_idx]++] = idx;
+            }
+        }
+    }
+
+    //! Get the keypoint indices in the specified cell (an empty range if the grid has not been assigned)
+    cell_range cell(const unsigned int cell_idx_x, const unsigned int cell_idx_y) const {
+        if (offsets_.empty()) {
+            return cell_range(nullptr, nullptr);
+        }
+        assert(cell_idx_x < num_cols_ && cell_idx_y < num_rows_);
+        const unsigned int cell_idx = cell_idx_x * num_rows_ + cell_idx_y;
+        return cell_range(indices_.data() + offsets_[cell_idx], indices_.data() + offsets_[cell_idx + 1]);
+    }
+
+    unsigned int num_cols() const { return num_cols_; }
+
+    unsigned int num_rows() const { return num_rows_; }
+
+    //! Total number of the assigned keypoints
+    size_t num_assigned() const { return indices_.size(); }
+
+    bool empty() const { return offsets_.empty(); }
+
+    //! Bytes of the offsets and the indices
+    size_t get_memory_bytes() const {
+        return (offsets_.capacity() + indices_.capacity()) * sizeof(unsigned int);
+    }
+
+private:
+    unsigned int num_cols_ = 0;
+    unsigned int num_rows_ = 0;
+    //! offsets_[i]..offsets_[i + 1] is the range of the i-th cell in indices_
+    std::vector<unsigned int> offsets_;
+    //! keypoint indices sorted by the cell
+    std::vector<unsigned int> indices_;
+};
+
+} // namespace data
+} // namespace stella_vslam
+
+#endif // STELLA_VSLAM_DATA_KEYPOINT_GRID_H
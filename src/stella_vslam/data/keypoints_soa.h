@@ -0,0 +1,88 @@
+#ifndef STELLA_VSLAM_DATA_KEYPOINTS_SOA_H
+#define STELLA_VSLAM_DATA_KEYPOINTS_SOA_H
+
+#include <cassert>
+#include <vector>
+
+#include <opencv2/core/types.hpp>
+
+namespace stella_vslam {
+namespace data {
+
+/**
+ * Structure-of-arrays copy of the keypoint fields which are read in the matching and optimization loops
+ * (NOTE: cv::KeyPoint::size and class_id are not kept)
+ */
+struct keypoints_soa {
+    keypoints_soa() = default;
+
+    explicit keypoints_soa(const std::vector<cv::KeyPoint>& keypts) {
+        assign(keypts);
+    }
+
+    //! Fill the arrays from the keypoints
+    void assign(const std::vector<cv::KeyPoint>& keypts) {
+        const auto num_keypts = keypts.size();
+        x_.resize(num_keypts);
+        y_.resize(num_keypts);
+        octave_.resize(num_keypts);
+        angle_.resize(num_keypts);
+        response_.resize(num_keypts);
+        for (unsigned int idx = 0; idx < num_keypts; ++idx) {
+            const auto& keypt = keypts.at(idx);
+            x_[idx] = keypt.pt.x;
+            y_[idx] = keypt.pt.y;
+            octave_[idx] = keypt.octave;
+            angle_[idx] = keypt.angle;
+            response_[idx] = keypt.response;
+        }
+    }
+
+    //! Convert the idx-th element to cv::KeyPoint (for the existing consumers)
+    cv::KeyPoint to_keypoint(const unsigned int idx) const {
+        assert(idx < size());
+        cv::KeyPoint keypt;
+        keypt.pt.x = x_[idx];
+        keypt.pt.y = y_[idx];
+        keypt.octave = octave_[idx];
+        keypt.angle = angle_[idx];
+        keypt.response = response_[idx];
+        return keypt;
+    }
+
+    //! Convert all elements to cv::KeyPoint (for the existing consumers)
+    std::vector<cv::KeyPoint> to_keypoints() const {
+        std::vector<cv::KeyPoint> keypts;
+        keypts.reserve(size());
+        for (unsigned int idx = 0; idx < size(); ++idx) {
+            keypts.push_back(to_keypoint(idx));
+        }
+        return keypts;
+    }
+
+    size_t size() const { return x_.size(); }
+
+    bool empty() const { return x_.empty(); }
+
+    //! Bytes of the arrays
+    size_t get_memory_bytes() const {
+        return (x_.capacity() + y_.capacity() + angle_.capacity() + response_.capacity()) * sizeof(float)
+               + octave_.capacity() * sizeof(int);
+    }
+
+    //! x coordinates
+    std::vector<float> x_;
+    //! y coordinates
+    std::vector<float> y_;
+    //! scale levels
+    std::vector<int> octave_;
+    //! orientations [deg]
+    std::vector<float> angle_;
+    //! FAST responses
+    std::vector<float> response_;
+};
+
+} // namespace data
+} // namespace stella_vslam
+
+#endif // STELLA_VSLAM_DATA_KEYPOINTS_SOA_H
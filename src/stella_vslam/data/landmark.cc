@@ -1,8 +1,16 @@
 #include "stella_vslam/data/frame.h"
 #include "stella_vslam/data/keyframe.h"
 #include "stella_vslam/data/landmark.h"
+#include "stella_vslam/data/landmark_descriptor_index.h"
 #include "stella_vslam/data/map_database.h"
+#include "stella_vslam/data/map_change_journal.h"
+#include "stella_vslam/data/memory_usage.h"
 #include "stella_vslam/match/base.h"
+#include "stella_vslam/util/parallel_for.h"
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
 
 #include <nlohmann/json.hpp>
 
@@ -13,16 +21,38 @@ namespace data {
 
 landmark::landmark(unsigned int id, const Vec3_t& pos_w, const std::shared_ptr<keyframe>& ref_keyfrm)
     : id_(id), first_keyfrm_id_(ref_keyfrm->id_), pos_w_(pos_w),
-      ref_keyfrm_(ref_keyfrm) {}
+      ref_keyfrm_(ref_keyfrm) {
+    set_modified();
+    account_memory();
+}
 
 landmark::landmark(const unsigned int id, const unsigned int first_keyfrm_id,
                    const Vec3_t& pos_w, const std::shared_ptr<keyframe>& ref_keyfrm,
                    const unsigned int num_visible, const unsigned int num_found)
     : id_(id), first_keyfrm_id_(first_keyfrm_id), pos_w_(pos_w), ref_keyfrm_(ref_keyfrm),
-      num_observable_(num_visible), num_observed_(num_found) {}
+      num_observable_(num_visible), num_observed_(num_found) {
+    set_modified();
+    account_memory();
+}
 
 landmark::~landmark() {
     SPDLOG_TRACE("landmark::~landmark: {}", id_);
+    memory_counter::add(memory_category_t::LandmarkObjects, -static_cast<int64_t>(accounted_lm_bytes_));
+    memory_counter::add(memory_category_t::LandmarkObservations, -static_cast<int64_t>(accounted_obs_bytes_));
+}
+
+void landmark::account_memory() {
+    size_t lm_bytes = sizeof(landmark) + descriptor_.total() * descriptor_.elemSize()
+                      + num_observations_by_scale_level_.capacity() * sizeof(unsigned int);
+    if (desc_dists_) {
+        lm_bytes += sizeof(descriptor_distances) + desc_dists_->keys_.capacity() * sizeof(desc_dists_->keys_[0])
+                    + desc_dists_->dists_.capacity() * sizeof(uint16_t);
+    }
+    const size_t obs_bytes = observations_.get_memory_bytes();
+    memory_counter::add(memory_category_t::LandmarkObjects, static_cast<int64_t>(lm_bytes) - accounted_lm_bytes_);
+    memory_counter::add(memory_category_t::LandmarkObservations, static_cast<int64_t>(obs_bytes) - accounted_obs_bytes_);
+    accounted_lm_bytes_ = static_cast<uint32_t>(lm_bytes);
+    accounted_obs_bytes_ = static_cast<uint32_t>(obs_bytes);
 }
 
 std::shared_ptr<landmark> landmark::from_stmt(sqlite3_stmt* stmt,
@@ -48,18 +78,15 @@ std::shared_ptr<landmark> landmark::from_stmt(sqlite3_stmt* stmt,
 
     auto ref_keyfrm = keyframes.at(ref_keyfrm_id + next_keyframe_id);
 
-    auto lm = std::make_shared<data::landmark>(
+    auto lm = data::landmark::create(
         id + next_landmark_id, first_keyfrm_id + next_keyframe_id, pos_w, ref_keyfrm,
         num_visible, num_found);
     return lm;
 }
 
 bool landmark::bind_to_stmt(sqlite3* db, sqlite3_stmt* stmt) const {
-    int ret = SQLITE_ERROR;
     int column_id = 1;
-    if (ret == SQLITE_OK || ret == SQLITE_DONE) {
-        ret = sqlite3_bind_int64(stmt, column_id++, id_);
-    }
+    int ret = sqlite3_bind_int64(stmt, column_id++, id_);
     if (ret == SQLITE_OK) {
         ret = sqlite3_bind_int64(stmt, column_id++, first_keyfrm_id_);
     }
@@ -83,97 +110,186 @@ bool landmark::bind_to_stmt(sqlite3* db, sqlite3_stmt* stmt) const {
 }
 
 void landmark::set_pos_in_world(const Vec3_t& pos_w) {
-    std::lock_guard<std::mutex> lock(mtx_position_);
-    SPDLOG_TRACE("landmark::set_pos_in_world {}", id_);
-    pos_w_ = pos_w;
-    has_valid_prediction_parameters_ = false;
+    std::shared_ptr<map_change_journal> change_journal;
+    {
+        std::lock_guard<util::profiled_spinlock> lock(mtx_position_);
+        SPDLOG_TRACE("landmark::set_pos_in_world {}", id_);
+        pos_w_ = pos_w;
+        invalidate_prediction_parameters();
+        change_journal = change_journal_.lock();
+        set_modified();
+    }
+    // (NOTE: the journal is not locked while the spinlock is held)
+    if (change_journal) {
+        change_journal->record(map_object_type_t::Landmark, id_, map_change_type_t::Updated);
+    }
+}
+
+void landmark::set_change_journal(const std::shared_ptr<map_change_journal>& change_journal) {
+    std::lock_guard<util::profiled_spinlock> lock(mtx_position_);
+    change_journal_ = change_journal;
+}
+
+void landmark::set_descriptor_index(const std::shared_ptr<landmark_descriptor_index>& descriptor_index) {
+    std::shared_ptr<landmark_descriptor_index> prev_descriptor_index;
+    cv::Mat descriptor;
+    {
+        std::lock_guard<util::profiled_spinlock> lock(mtx_observations_);
+        prev_descriptor_index = descriptor_index_.lock();
+        descriptor_index_ = descriptor_index;
+        if (has_representative_descriptor_) {
+            descriptor = descriptor_;
+        }
+    }
+    // (NOTE: the index is not locked while the spinlock is held)
+    if (prev_descriptor_index && prev_descriptor_index != descriptor_index) {
+        prev_descriptor_index->erase(id_);
+    }
+    if (descriptor_index && !descriptor.empty()) {
+        descriptor_index->update(id_, descriptor.ptr<uint8_t>());
+    }
 }
 
 Vec3_t landmark::get_pos_in_world() const {
-    std::lock_guard<std::mutex> lock(mtx_position_);
+    std::lock_guard<util::profiled_spinlock> lock(mtx_position_);
     return pos_w_;
 }
 
 Vec3_t landmark::get_obs_mean_normal() const {
-    std::lock_guard<std::mutex> lock(mtx_position_);
-    assert(has_valid_prediction_parameters_);
-    return mean_normal_;
+    Vec3_t pos_w;
+    Vec3_t mean_normal;
+    float min_valid_dist;
+    float max_valid_dist;
+    get_prediction_parameters(pos_w, mean_normal, min_valid_dist, max_valid_dist);
+    return mean_normal;
 }
 
 std::shared_ptr<keyframe> landmark::get_ref_keyframe() const {
-    std::lock_guard<std::mutex> lock(mtx_observations_);
+    std::lock_guard<util::profiled_spinlock> lock(mtx_observations_);
     return ref_keyfrm_.lock();
 }
 
+namespace {
+std::vector<std::shared_ptr<keyframe>> get_observers(const landmark::observations_t& observations) {
+    std::vector<std::shared_ptr<keyframe>> observers;
+    observers.reserve(observations.size());
+    for (const auto& obs : observations) {
+        auto keyfrm = obs.first.lock();
+        if (keyfrm) {
+            observers.push_back(keyfrm);
+        }
+    }
+    return observers;
+}
+} // namespace
+
 void landmark::add_observation(const std::shared_ptr<keyframe>& keyfrm, unsigned int idx) {
-    std::lock_guard<std::mutex> lock(mtx_observations_);
-    SPDLOG_TRACE("landmark::add_observation {} {} {}", id_, keyfrm->id_, idx);
-    assert(!static_cast<bool>(observations_.count(keyfrm)));
-    observations_[keyfrm] = idx;
-    assert(static_cast<bool>(observations_.count(keyfrm)));
+    // keyframes which have already observed this landmark
+    std::vector<std::shared_ptr<keyframe>> other_observers;
+    {
+        std::lock_guard<util::profiled_spinlock> lock(mtx_observations_);
+        SPDLOG_TRACE("landmark::add_observation {} {} {}", id_, keyfrm->id_, idx);
+        assert(!static_cast<bool>(observations_.count(keyfrm)));
+        other_observers = get_observers(observations_);
+        observations_[keyfrm] = idx;
+        assert(static_cast<bool>(observations_.count(keyfrm)));
+
+        const unsigned int scale_level = keyfrm->frm_obs_->undist_keypts_.at(idx).octave;
+        if (num_observations_by_scale_level_.size() <= scale_level) {
+            num_observations_by_scale_level_.resize(scale_level + 1, 0);
+        }
+        ++num_observations_by_scale_level_.at(scale_level);
 
-    has_valid_prediction_parameters_ = false;
-    has_representative_descriptor_ = false;
+        invalidate_prediction_parameters();
+        has_representative_descriptor_ = false;
 
-    if (!keyfrm->frm_obs_.stereo_x_right_.empty() && 0 <= keyfrm->frm_obs_.stereo_x_right_.at(idx)) {
-        num_observations_ += 2;
+        if (!keyfrm->frm_obs_->stereo_x_right_.empty() && 0 <= keyfrm->frm_obs_->stereo_x_right_.at(idx)) {
+            num_observations_ += 2;
+        }
+        else {
+            num_observations_ += 1;
+        }
+        account_memory();
     }
-    else {
-        num_observations_ += 1;
+
+    // update the numbers of shared landmarks of the covisibility graph
+    for (const auto& other_observer : other_observers) {
+        other_observer->graph_node_->add_shared_landmark(keyfrm);
+        keyfrm->graph_node_->add_shared_landmark(other_observer);
     }
 }
 
 void landmark::erase_observation(map_database* map_db, const std::shared_ptr<keyframe>& keyfrm) {
     bool discard = false;
+    // keyframes which still observe this landmark
+    std::vector<std::shared_ptr<keyframe>> other_observers;
     {
-        std::lock_guard<std::mutex> lock(mtx_observations_);
+        std::lock_guard<util::profiled_spinlock> lock(mtx_observations_);
         SPDLOG_TRACE("landmark::erase_observation {} {}", id_, keyfrm->id_);
 
         assert(observations_.count(keyfrm));
         int idx = observations_.at(keyfrm);
-        if (!keyfrm->frm_obs_.stereo_x_right_.empty() && 0 <= keyfrm->frm_obs_.stereo_x_right_.at(idx)) {
+        if (!keyfrm->frm_obs_->stereo_x_right_.empty() && 0 <= keyfrm->frm_obs_->stereo_x_right_.at(idx)) {
             num_observations_ -= 2;
         }
         else {
             num_observations_ -= 1;
         }
+        const unsigned int scale_level = keyfrm->frm_obs_->undist_keypts_.at(idx).octave;
+        assert(0 < num_observations_by_scale_level_.at(scale_level));
+        --num_observations_by_scale_level_.at(scale_level);
 
         observations_.erase(keyfrm);
+        other_observers = get_observers(observations_);
 
-        has_valid_prediction_parameters_ = false;
+        invalidate_prediction_parameters();
         has_representative_descriptor_ = false;
+        account_memory();
 
         if (observations_.empty()) {
             discard = true;
         }
         else if (ref_keyfrm_.lock()->id_ == keyfrm->id_) {
             ref_keyfrm_ = observations_.begin()->first.lock();
+            set_modified();
         }
         assert(discard || observations_.count(ref_keyfrm_));
     }
 
+    // update the numbers of shared landmarks of the covisibility graph
+    for (const auto& other_observer : other_observers) {
+        other_observer->graph_node_->erase_shared_landmark(keyfrm);
+        keyfrm->graph_node_->erase_shared_landmark(other_observer);
+    }
+
     if (discard) {
         prepare_for_erasing(map_db);
     }
 }
 
 landmark::observations_t landmark::get_observations() const {
-    std::lock_guard<std::mutex> lock(mtx_observations_);
+    std::lock_guard<util::profiled_spinlock> lock(mtx_observations_);
     return observations_;
 }
 
 unsigned int landmark::num_observations() const {
-    std::lock_guard<std::mutex> lock(mtx_observations_);
+    std::lock_guard<util::profiled_spinlock> lock(mtx_observations_);
     return num_observations_;
 }
 
+unsigned int landmark::num_observations_up_to_scale_level(const unsigned int scale_level) const {
+    std::lock_guard<util::profiled_spinlock> lock(mtx_observations_);
+    const auto num_scale_levels = std::min(static_cast<size_t>(scale_level) + 1, num_observations_by_scale_level_.size());
+    return std::accumulate(num_observations_by_scale_level_.begin(), num_observations_by_scale_level_.begin() + num_scale_levels, 0u);
+}
+
 bool landmark::has_observation() const {
-    std::lock_guard<std::mutex> lock(mtx_observations_);
+    std::lock_guard<util::profiled_spinlock> lock(mtx_observations_);
     return 0 < num_observations_;
 }
 
 int landmark::get_index_in_keyframe(const std::shared_ptr<keyframe>& keyfrm) const {
-    std::lock_guard<std::mutex> lock(mtx_observations_);
+    std::lock_guard<util::profiled_spinlock> lock(mtx_observations_);
     if (observations_.count(keyfrm)) {
         return observations_.at(keyfrm);
     }
@@ -183,64 +299,91 @@ int landmark::get_index_in_keyframe(const std::shared_ptr<keyframe>& keyfrm) con
 }
 
 bool landmark::is_observed_in_keyframe(const std::shared_ptr<keyframe>& keyfrm) const {
-    std::lock_guard<std::mutex> lock(mtx_observations_);
+    std::lock_guard<util::profiled_spinlock> lock(mtx_observations_);
     return static_cast<bool>(observations_.count(keyfrm));
 }
 
 bool landmark::has_representative_descriptor() const {
-    std::lock_guard<std::mutex> lock(mtx_observations_);
+    std::lock_guard<util::profiled_spinlock> lock(mtx_observations_);
     return has_representative_descriptor_;
 }
 
 cv::Mat landmark::get_descriptor() const {
-    std::lock_guard<std::mutex> lock(mtx_observations_);
+    std::lock_guard<util::profiled_spinlock> lock(mtx_observations_);
     assert(has_representative_descriptor_);
     return descriptor_.clone();
 }
 
+cv::Mat landmark::get_latest_descriptor() const {
+    std::lock_guard<util::profiled_spinlock> lock(mtx_observations_);
+    return descriptor_.clone();
+}
+
 void landmark::compute_descriptor() {
     observations_t observations;
+    std::unique_ptr<descriptor_distances> cached_dists;
     {
-        std::lock_guard<std::mutex> lock1(mtx_observations_);
+        std::lock_guard<util::profiled_spinlock> lock1(mtx_observations_);
         assert(!has_representative_descriptor_);
         assert(!will_be_erased_);
         assert(!observations_.empty());
         observations = observations_;
+        cached_dists = std::move(desc_dists_);
     }
     SPDLOG_TRACE("landmark::compute_descriptor {}", id_);
 
     // Append features of corresponding points
     std::vector<cv::Mat> descriptors;
+    std::vector<std::pair<unsigned int, unsigned int>> keys;
     descriptors.reserve(observations.size());
+    keys.reserve(observations.size());
     for (const auto& observation : observations) {
         auto keyfrm = observation.first.lock();
         const auto idx = observation.second;
 
         if (!keyfrm->will_be_erased()) {
-            descriptors.push_back(keyfrm->frm_obs_.descriptors_.row(idx));
+            descriptors.push_back(keyfrm->get_descriptor(idx));
+            keys.emplace_back(keyfrm->id_, idx);
         }
     }
 
-    // Get median of Hamming distance
-    // Calculate all the Hamming distances between every pair of the features
+    // Find the descriptors whose distances were computed in the previous call
+    // (both of the keys are in order of the keyframe IDs, so they are merged in linear time)
     const auto num_descs = descriptors.size();
-    std::vector<std::vector<unsigned int>> hamm_dists(num_descs, std::vector<unsigned int>(num_descs));
+    std::vector<int> cached_idxs(num_descs, -1);
+    const unsigned int num_cached_descs = cached_dists ? cached_dists->keys_.size() : 0;
+    for (unsigned int i = 0, j = 0; i < num_descs && j < num_cached_descs; ++i) {
+        while (j < num_cached_descs && cached_dists->keys_.at(j) < keys.at(i)) {
+            ++j;
+        }
+        if (j < num_cached_descs && cached_dists->keys_.at(j) == keys.at(i)) {
+            cached_idxs.at(i) = j;
+        }
+    }
+
+    // Get median of Hamming distance
+    // Calculate the Hamming distances between every pair of the features (except for the cached ones)
+    std::vector<uint16_t> hamm_dists(num_descs * num_descs);
     for (unsigned int i = 0; i < num_descs; ++i) {
-        hamm_dists.at(i).at(i) = 0;
+        hamm_dists.at(i * num_descs + i) = 0;
         for (unsigned int j = i + 1; j < num_descs; ++j) {
-            const auto dist = match::compute_descriptor_distance_32(descriptors.at(i), descriptors.at(j));
-            hamm_dists.at(i).at(j) = dist;
-            hamm_dists.at(j).at(i) = dist;
+            const auto dist = (0 <= cached_idxs.at(i) && 0 <= cached_idxs.at(j))
+                                  ? cached_dists->dists_.at(cached_idxs.at(i) * num_cached_descs + cached_idxs.at(j))
+                                  : match::compute_descriptor_distance_32(descriptors.at(i), descriptors.at(j));
+            hamm_dists.at(i * num_descs + j) = dist;
+            hamm_dists.at(j * num_descs + i) = dist;
         }
     }
 
     // Get the nearest value to median
     unsigned int best_median_dist = match::MAX_HAMMING_DIST;
     unsigned int best_idx = 0;
+    const auto median_idx = static_cast<unsigned int>(0.5 * (num_descs - 1));
+    std::vector<uint16_t> partial_hamm_dists(num_descs);
     for (unsigned idx = 0; idx < num_descs; ++idx) {
-        std::vector<unsigned int> partial_hamm_dists(hamm_dists.at(idx).begin(), hamm_dists.at(idx).begin() + num_descs);
-        std::sort(partial_hamm_dists.begin(), partial_hamm_dists.end());
-        const auto median_dist = partial_hamm_dists.at(static_cast<unsigned int>(0.5 * (num_descs - 1)));
+        std::copy(hamm_dists.begin() + idx * num_descs, hamm_dists.begin() + (idx + 1) * num_descs, partial_hamm_dists.begin());
+        std::nth_element(partial_hamm_dists.begin(), partial_hamm_dists.begin() + median_idx, partial_hamm_dists.end());
+        const unsigned int median_dist = partial_hamm_dists.at(median_idx);
 
         if (median_dist < best_median_dist) {
             best_median_dist = median_dist;
@@ -248,20 +391,49 @@ void landmark::compute_descriptor() {
         }
     }
 
+    // Keep the distances for the next call
+    if (min_num_descs_to_cache_distances_ <= num_descs) {
+        if (!cached_dists) {
+            cached_dists = std::unique_ptr<descriptor_distances>(new descriptor_distances);
+        }
+        cached_dists->keys_ = std::move(keys);
+        cached_dists->dists_ = std::move(hamm_dists);
+    }
+    else {
+        cached_dists = nullptr;
+    }
+
+    const cv::Mat descriptor = descriptors.at(best_idx).clone();
+    std::shared_ptr<landmark_descriptor_index> descriptor_index;
     {
-        std::lock_guard<std::mutex> lock(mtx_observations_);
-        descriptor_ = descriptors.at(best_idx).clone();
+        std::lock_guard<util::profiled_spinlock> lock(mtx_observations_);
+        descriptor_ = descriptor;
         has_representative_descriptor_ = true;
+        desc_dists_ = std::move(cached_dists);
+        descriptor_index = descriptor_index_.lock();
+        account_memory();
+    }
+    // (NOTE: the index is not locked while the spinlock is held)
+    if (descriptor_index) {
+        descriptor_index->update(id_, descriptor.ptr<uint8_t>());
     }
 }
 
+namespace {
+Vec3_t get_cam_center(const std::shared_ptr<keyframe>& keyfrm, const eigen_alloc_unord_map<unsigned int, Vec3_t>& cam_centers) {
+    const auto iter = cam_centers.find(keyfrm->id_);
+    return (iter != cam_centers.end()) ? iter->second : keyfrm->get_trans_wc();
+}
+} // namespace
+
 void landmark::compute_mean_normal(const observations_t& observations,
                                    const Vec3_t& pos_w,
+                                   const eigen_alloc_unord_map<unsigned int, Vec3_t>& cam_centers,
                                    Vec3_t& mean_normal) const {
     mean_normal = Vec3_t::Zero();
     for (const auto& observation : observations) {
         auto keyfrm = observation.first.lock();
-        const Vec3_t normal = pos_w - keyfrm->get_trans_wc();
+        const Vec3_t normal = pos_w - get_cam_center(keyfrm, cam_centers);
         mean_normal = mean_normal + normal.normalized();
     }
     mean_normal = mean_normal.normalized();
@@ -270,13 +442,14 @@ void landmark::compute_mean_normal(const observations_t& observations,
 void landmark::compute_orb_scale_variance(const observations_t& observations,
                                           const std::shared_ptr<keyframe>& ref_keyfrm,
                                           const Vec3_t& pos_w,
+                                          const eigen_alloc_unord_map<unsigned int, Vec3_t>& cam_centers,
                                           float& max_valid_dist,
                                           float& min_valid_dist) const {
-    const Vec3_t vec_ref_keyfrm_to_lm = pos_w - ref_keyfrm->get_trans_wc();
+    const Vec3_t vec_ref_keyfrm_to_lm = pos_w - get_cam_center(ref_keyfrm, cam_centers);
     const auto dist_ref_keyfrm_to_lm = vec_ref_keyfrm_to_lm.norm();
     assert(!observations.empty());
     const auto idx = observations.at(ref_keyfrm);
-    const auto scale_level = ref_keyfrm->frm_obs_.undist_keypts_.at(idx).octave;
+    const auto scale_level = ref_keyfrm->frm_obs_->undist_keypts_.at(idx).octave;
     const auto scale_factor = ref_keyfrm->orb_params_->scale_factors_.at(scale_level);
     const auto num_scale_levels = ref_keyfrm->orb_params_->num_levels_;
 
@@ -286,61 +459,174 @@ void landmark::compute_orb_scale_variance(const observations_t& observations,
 
 void landmark::update_mean_normal_and_obs_scale_variance() {
     SPDLOG_TRACE("landmark::update_mean_normal_and_obs_scale_variance {}", id_);
+    Vec3_t pos_w;
+    Vec3_t mean_normal;
+    float min_valid_dist;
+    float max_valid_dist;
+    compute_and_cache_prediction_parameters(pos_w, mean_normal, min_valid_dist, max_valid_dist);
+}
+
+bool landmark::compute_and_cache_prediction_parameters(Vec3_t& pos_w, Vec3_t& mean_normal,
+                                                       float& min_valid_dist, float& max_valid_dist) const {
+    // the parameters computed from the snapshot are discarded if they are invalidated in the meantime
+    const unsigned int epoch = prediction_parameters_epoch_;
     observations_t observations;
     std::shared_ptr<keyframe> ref_keyfrm = nullptr;
     {
-        std::lock_guard<std::mutex> lock1(mtx_observations_);
-        assert(!has_valid_prediction_parameters_);
-        assert(!observations_.empty());
+        std::lock_guard<util::profiled_spinlock> lock1(mtx_observations_);
+        // (the landmark is being erased if it has no observations)
+        if (observations_.empty()) {
+            return false;
+        }
         assert(observations_.count(ref_keyfrm_));
         observations = observations_;
         ref_keyfrm = ref_keyfrm_.lock();
     }
-    Vec3_t pos_w;
     {
-        std::lock_guard<std::mutex> lock2(mtx_position_);
+        std::lock_guard<util::profiled_spinlock> lock2(mtx_position_);
         pos_w = pos_w_;
     }
 
-    Vec3_t mean_normal;
-    compute_mean_normal(observations, pos_w, mean_normal);
+    compute_mean_normal(observations, pos_w, {}, mean_normal);
+    compute_orb_scale_variance(observations, ref_keyfrm, pos_w, {}, max_valid_dist, min_valid_dist);
 
-    float max_valid_dist;
-    float min_valid_dist;
-    compute_orb_scale_variance(observations, ref_keyfrm, pos_w, max_valid_dist, min_valid_dist);
+    // (the parameters are valid for the snapshot even if they are not cached)
+    {
+        std::lock_guard<util::profiled_spinlock> lock3(mtx_position_);
+        if (epoch != prediction_parameters_epoch_) {
+            return true;
+        }
+        max_valid_dist_ = max_valid_dist;
+        min_valid_dist_ = min_valid_dist;
+        mean_normal_ = mean_normal;
+        has_valid_prediction_parameters_ = true;
+        // (the invalidation under mtx_observations_ might have been made after the check above)
+        if (epoch != prediction_parameters_epoch_) {
+            has_valid_prediction_parameters_ = false;
+        }
+    }
+    return true;
+}
+
+void landmark::invalidate_prediction_parameters() {
+    // (the epoch is advanced before the flag is cleared, see compute_and_cache_prediction_parameters())
+    ++prediction_parameters_epoch_;
+    has_valid_prediction_parameters_ = false;
+}
 
+void landmark::update_prediction_parameters(const std::vector<std::shared_ptr<landmark>>& lms,
+                                            util::thread_pool* thread_pool) {
+    util::parallel_for(thread_pool, 0, static_cast<int64_t>(lms.size()), [&lms](const int64_t idx) {
+        const auto& lm = lms.at(idx);
+        if (lm->will_be_erased() || lm->has_valid_prediction_parameters_) {
+            return;
+        }
+        lm->update_mean_normal_and_obs_scale_variance();
+    });
+}
+
+bool landmark::get_prediction_parameters(Vec3_t& pos_w, Vec3_t& mean_normal,
+                                         float& min_valid_dist, float& max_valid_dist) const {
     {
-        std::lock_guard<std::mutex> lock3(mtx_position_);
+        std::lock_guard<util::profiled_spinlock> lock(mtx_position_);
+        if (has_valid_prediction_parameters_) {
+            pos_w = pos_w_;
+            mean_normal = mean_normal_;
+            min_valid_dist = min_valid_dist_;
+            max_valid_dist = max_valid_dist_;
+            return true;
+        }
+    }
+    if (compute_and_cache_prediction_parameters(pos_w, mean_normal, min_valid_dist, max_valid_dist)) {
+        return true;
+    }
+    // the landmark is observed at no distance nor direction if the parameters cannot be computed
+    {
+        std::lock_guard<util::profiled_spinlock> lock(mtx_position_);
+        pos_w = pos_w_;
+    }
+    mean_normal = Vec3_t::Zero();
+    min_valid_dist = std::numeric_limits<float>::infinity();
+    max_valid_dist = 0.0f;
+    return false;
+}
+
+void landmark::compute_prediction_parameters(const Vec3_t& pos_w, const eigen_alloc_unord_map<unsigned int, Vec3_t>& cam_centers,
+                                             Vec3_t& mean_normal, float& min_valid_dist, float& max_valid_dist) const {
+    observations_t observations;
+    std::shared_ptr<keyframe> ref_keyfrm = nullptr;
+    {
+        std::lock_guard<util::profiled_spinlock> lock(mtx_observations_);
+        assert(!observations_.empty());
+        assert(observations_.count(ref_keyfrm_));
+        observations = observations_;
+        ref_keyfrm = ref_keyfrm_.lock();
+    }
+
+    compute_mean_normal(observations, pos_w, cam_centers, mean_normal);
+    compute_orb_scale_variance(observations, ref_keyfrm, pos_w, cam_centers, max_valid_dist, min_valid_dist);
+}
+
+void landmark::set_pos_in_world_and_prediction_parameters(const Vec3_t& pos_w, const Vec3_t& mean_normal,
+                                                          const float min_valid_dist, const float max_valid_dist) {
+    std::shared_ptr<map_change_journal> change_journal;
+    {
+        std::lock_guard<util::profiled_spinlock> lock(mtx_position_);
+        SPDLOG_TRACE("landmark::set_pos_in_world_and_prediction_parameters {}", id_);
+        // (the parameters being computed from the previous position are discarded)
+        ++prediction_parameters_epoch_;
+        pos_w_ = pos_w;
         max_valid_dist_ = max_valid_dist;
         min_valid_dist_ = min_valid_dist;
         mean_normal_ = mean_normal;
         has_valid_prediction_parameters_ = true;
+        change_journal = change_journal_.lock();
+        set_modified();
+    }
+    if (change_journal) {
+        change_journal->record(map_object_type_t::Landmark, id_, map_change_type_t::Updated);
     }
 }
 
+void landmark::get_pos_in_world_and_prediction_parameters(Vec3_t& pos_w, Vec3_t& mean_normal,
+                                                          float& min_valid_dist, float& max_valid_dist) const {
+    get_prediction_parameters(pos_w, mean_normal, min_valid_dist, max_valid_dist);
+}
+
 bool landmark::has_valid_prediction_parameters() const {
-    std::lock_guard<std::mutex> lock(mtx_position_);
+    std::lock_guard<util::profiled_spinlock> lock(mtx_position_);
     return has_valid_prediction_parameters_;
 }
 
 float landmark::get_min_valid_distance() const {
-    std::lock_guard<std::mutex> lock(mtx_position_);
-    assert(has_valid_prediction_parameters_);
-    return min_valid_dist_;
+    Vec3_t pos_w;
+    Vec3_t mean_normal;
+    float min_valid_dist;
+    float max_valid_dist;
+    get_prediction_parameters(pos_w, mean_normal, min_valid_dist, max_valid_dist);
+    return min_valid_dist;
 }
 
 float landmark::get_max_valid_distance() const {
-    std::lock_guard<std::mutex> lock(mtx_position_);
-    assert(has_valid_prediction_parameters_);
-    return max_valid_dist_;
+    Vec3_t pos_w;
+    Vec3_t mean_normal;
+    float min_valid_dist;
+    float max_valid_dist;
+    get_prediction_parameters(pos_w, mean_normal, min_valid_dist, max_valid_dist);
+    return max_valid_dist;
 }
 
 unsigned int landmark::predict_scale_level(const float cam_to_lm_dist, float num_scale_levels, float log_scale_factor) const {
-    float ratio;
-    {
-        std::lock_guard<std::mutex> lock(mtx_position_);
-        ratio = max_valid_dist_ / cam_to_lm_dist;
+    Vec3_t pos_w;
+    Vec3_t mean_normal;
+    float min_valid_dist;
+    float max_valid_dist;
+    // (the log of the ratio is not finite without the parameters)
+    if (!get_prediction_parameters(pos_w, mean_normal, min_valid_dist, max_valid_dist)
+        || !(0.0f < max_valid_dist && 0.0f < cam_to_lm_dist)) {
+        return 0;
     }
+    const float ratio = max_valid_dist / cam_to_lm_dist;
 
     const auto pred_scale_level = static_cast<int>(std::ceil(std::log(ratio) / log_scale_factor));
     if (pred_scale_level < 0) {
@@ -355,26 +641,56 @@ unsigned int landmark::predict_scale_level(const float cam_to_lm_dist, float num
 }
 
 void landmark::prepare_for_erasing(map_database* map_db) {
+    prepare_for_erasing();
+    map_db->erase_landmark(id_);
+}
+
+void landmark::prepare_for_erasing() {
     SPDLOG_TRACE("landmark::prepare_for_erasing {}", id_);
     observations_t observations;
     {
-        std::lock_guard<std::mutex> lock1(mtx_observations_);
+        std::lock_guard<util::profiled_spinlock> lock1(mtx_observations_);
         observations = observations_;
         observations_.clear();
+        num_observations_by_scale_level_.clear();
         will_be_erased_ = true;
+        account_memory();
     }
 
     for (const auto& keyfrm_and_idx : observations) {
         keyfrm_and_idx.first.lock()->erase_landmark_with_index(keyfrm_and_idx.second);
     }
 
-    map_db->erase_landmark(id_);
+    // update the numbers of shared landmarks of the covisibility graph
+    const auto observers = get_observers(observations);
+    for (unsigned int i = 0; i < observers.size(); ++i) {
+        for (unsigned int j = i + 1; j < observers.size(); ++j) {
+            observers.at(i)->graph_node_->erase_shared_landmark(observers.at(j));
+            observers.at(j)->graph_node_->erase_shared_landmark(observers.at(i));
+        }
+    }
 }
 
 bool landmark::will_be_erased() {
     return will_be_erased_;
 }
 
+void landmark::set_modified() {
+    modified_epoch_.store(map_database::save_epoch_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+bool landmark::is_modified_since(const unsigned int epoch) const {
+    return epoch <= modified_epoch_.load(std::memory_order_relaxed);
+}
+
+unsigned int landmark::get_modified_epoch() const {
+    return modified_epoch_.load(std::memory_order_relaxed);
+}
+
+void landmark::set_modified_epoch(const unsigned int epoch) {
+    modified_epoch_.store(epoch, std::memory_order_relaxed);
+}
+
 void landmark::connect_to_keyframe(const std::shared_ptr<keyframe>& keyfrm, unsigned int idx) {
     assert(!observations_.count(keyfrm));
     keyfrm->add_landmark(shared_from_this(), idx);
@@ -390,7 +706,7 @@ void landmark::replace(std::shared_ptr<landmark> lm, data::map_database* map_db)
     // 1. Erase this
     observations_t observations;
     {
-        std::lock_guard<std::mutex> lock1(mtx_observations_);
+        std::lock_guard<util::profiled_spinlock> lock1(mtx_observations_);
         observations = observations_;
     }
 
@@ -399,7 +715,7 @@ void landmark::replace(std::shared_ptr<landmark> lm, data::map_database* map_db)
     // 2. Merge lm with this
     unsigned int num_observable, num_observed;
     {
-        std::lock_guard<std::mutex> lock1(mtx_observations_);
+        std::lock_guard<util::profiled_spinlock> lock1(mtx_observations_);
         num_observable = num_observable_;
         num_observed = num_observed_;
     }
@@ -416,27 +732,29 @@ void landmark::replace(std::shared_ptr<landmark> lm, data::map_database* map_db)
 }
 
 void landmark::increase_num_observable(unsigned int num_observable) {
-    std::lock_guard<std::mutex> lock(mtx_observations_);
+    std::lock_guard<util::profiled_spinlock> lock(mtx_observations_);
     num_observable_ += num_observable;
+    set_modified();
 }
 
 void landmark::increase_num_observed(unsigned int num_observed) {
-    std::lock_guard<std::mutex> lock(mtx_observations_);
+    std::lock_guard<util::profiled_spinlock> lock(mtx_observations_);
     num_observed_ += num_observed;
+    set_modified();
 }
 
 float landmark::get_observed_ratio() const {
-    std::lock_guard<std::mutex> lock(mtx_observations_);
+    std::lock_guard<util::profiled_spinlock> lock(mtx_observations_);
     return static_cast<float>(num_observed_) / num_observable_;
 }
 
 unsigned int landmark::get_num_observed() const {
-    std::lock_guard<std::mutex> lock(mtx_observations_);
+    std::lock_guard<util::profiled_spinlock> lock(mtx_observations_);
     return num_observed_;
 }
 
 unsigned int landmark::get_num_observable() const {
-    std::lock_guard<std::mutex> lock(mtx_observations_);
+    std::lock_guard<util::profiled_spinlock> lock(mtx_observations_);
     return num_observable_;
 }
 
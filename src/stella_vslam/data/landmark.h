@@ -2,17 +2,28 @@
 #define STELLA_VSLAM_DATA_LANDMARK_H
 
 #include "stella_vslam/type.h"
+#include "stella_vslam/data/slot_table.h"
+#include "stella_vslam/util/id_ordered_flat_map.h"
+#include "stella_vslam/util/lock_profiler.h"
+#include "stella_vslam/util/pool_allocator.h"
+#include "stella_vslam/util/spinlock.h"
 
 #include <map>
 #include <mutex>
 #include <atomic>
 #include <memory>
+#include <vector>
 
 #include <opencv2/core/mat.hpp>
 #include <nlohmann/json_fwd.hpp>
 #include <sqlite3.h>
 
 namespace stella_vslam {
+
+namespace util {
+class thread_pool;
+} // namespace util
+
 namespace data {
 
 class frame;
@@ -21,12 +32,17 @@ class keyframe;
 
 class map_database;
 
+class map_change_journal;
+
+class landmark_descriptor_index;
+
 class landmark : public std::enable_shared_from_this<landmark> {
 public:
     EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 
     //! Data structure for sorting keyframes by ID for consistent results in local map cleaning/BA
-    using observations_t = std::map<std::weak_ptr<keyframe>, unsigned int, id_less<std::weak_ptr<keyframe>>>;
+    //! (flat arrays instead of std::map, because most of the landmarks are observed by a few keyframes)
+    using observations_t = util::id_ordered_flat_map<keyframe, unsigned int>;
 
     //! constructor
     landmark(unsigned int id, const Vec3_t& pos_w, const std::shared_ptr<keyframe>& ref_keyfrm);
@@ -38,6 +54,12 @@ public:
 
     virtual ~landmark();
 
+    //! Create a landmark in the landmark pool (use this instead of std::make_shared to reduce the allocation overhead)
+    template<typename... Args>
+    static std::shared_ptr<landmark> create(Args&&... args) {
+        return std::allocate_shared<landmark>(util::pool_allocator<landmark>(), std::forward<Args>(args)...);
+    }
+
     // Factory method for create landmark
     static std::shared_ptr<landmark> from_stmt(sqlite3_stmt* stmt,
                                                std::unordered_map<unsigned int, std::shared_ptr<stella_vslam::data::keyframe>>& keyframes,
@@ -61,6 +83,10 @@ public:
     void set_pos_in_world(const Vec3_t& pos_w);
     //! get world coordinates of this landmark
     Vec3_t get_pos_in_world() const;
+    //! register this landmark to the change journal, which records the update whenever the position is set (nullptr to unregister)
+    void set_change_journal(const std::shared_ptr<map_change_journal>& change_journal);
+    //! register this landmark to the descriptor index, which is updated whenever the descriptor is computed (nullptr to unregister)
+    void set_descriptor_index(const std::shared_ptr<landmark_descriptor_index>& descriptor_index);
 
     //! get mean normalized vector of keyframe->lm vectors, for keyframes such that observe the 3D point.
     Vec3_t get_obs_mean_normal() const;
@@ -76,6 +102,8 @@ public:
     observations_t get_observations() const;
     //! get number of observations
     unsigned int num_observations() const;
+    //! get number of the keyframes which observe this landmark with the scale level equal to or lower than the specified one
+    unsigned int num_observations_up_to_scale_level(const unsigned int scale_level) const;
     //! whether this landmark is observed from more than zero keyframes
     bool has_observation() const;
 
@@ -97,12 +125,32 @@ public:
     //! get representative descriptor
     cv::Mat get_descriptor() const;
 
+    //! get the last computed representative descriptor, even if it is outdated by the new observations (empty if it has never been computed)
+    cv::Mat get_latest_descriptor() const;
+
     //! compute representative descriptor
     void compute_descriptor();
 
     //! update observation mean normal and ORB scale variance
     void update_mean_normal_and_obs_scale_variance();
 
+    //! update the prediction parameters of the landmarks which are invalidated, in parallel
+    //! (the getters compute them on demand otherwise, see get_prediction_parameters())
+    //! (the loop runs on the thread pool if it is given, and on the OpenMP threads otherwise)
+    static void update_prediction_parameters(const std::vector<std::shared_ptr<landmark>>& lms,
+                                             util::thread_pool* thread_pool = nullptr);
+
+    //! compute observation mean normal and ORB scale variance at the specified position without modifying this landmark
+    //! (cam_centers: keyframe ID -> camera center to be used instead of the current one of the keyframe)
+    void compute_prediction_parameters(const Vec3_t& pos_w, const eigen_alloc_unord_map<unsigned int, Vec3_t>& cam_centers,
+                                       Vec3_t& mean_normal, float& min_valid_dist, float& max_valid_dist) const;
+    //! set the position and the prediction parameters computed by compute_prediction_parameters() at once
+    void set_pos_in_world_and_prediction_parameters(const Vec3_t& pos_w, const Vec3_t& mean_normal,
+                                                    const float min_valid_dist, const float max_valid_dist);
+    //! get the position and the prediction parameters at once
+    void get_pos_in_world_and_prediction_parameters(Vec3_t& pos_w, Vec3_t& mean_normal,
+                                                    float& min_valid_dist, float& max_valid_dist) const;
+
     //! true if the landmark has valid prediction parameters
     bool has_valid_prediction_parameters() const;
     //! get max valid distance between landmark and camera
@@ -115,9 +163,20 @@ public:
 
     //! erase this landmark from database
     void prepare_for_erasing(map_database* map_db);
+    //! erase this landmark from the keyframes, but keep it in the database
+    //! (the caller should erase it from the database later, e.g. with map_database::erase_landmarks)
+    void prepare_for_erasing();
     //! whether this landmark will be erased shortly or not
     bool will_be_erased();
 
+    //! Record the modification for the incremental map saving
+    void set_modified();
+    //! whether this landmark is modified at or after the specified save epoch (see map_database::save_epoch_)
+    bool is_modified_since(const unsigned int epoch) const;
+    //! get/set the save epoch of the last modification (used to copy it to a snapshot)
+    unsigned int get_modified_epoch() const;
+    void set_modified_epoch(const unsigned int epoch);
+
     //! Make an interconnection by landmark::add_observation and keyframe::add_landmark
     void connect_to_keyframe(const std::shared_ptr<keyframe>& keyfrm, unsigned int idx);
 
@@ -135,30 +194,69 @@ public:
 
 public:
     unsigned int id_;
+    //! handle in the slot table of the map database (set when the landmark is added)
+    slot_handle handle_;
     unsigned int first_keyfrm_id_ = 0;
     unsigned int num_observations_ = 0;
 
 protected:
     void compute_mean_normal(const observations_t& observations,
                              const Vec3_t& pos_w,
+                             const eigen_alloc_unord_map<unsigned int, Vec3_t>& cam_centers,
                              Vec3_t& mean_normal) const;
     void compute_orb_scale_variance(const observations_t& observations,
                                     const std::shared_ptr<keyframe>& ref_keyfrm,
                                     const Vec3_t& pos_w,
+                                    const eigen_alloc_unord_map<unsigned int, Vec3_t>& cam_centers,
                                     float& max_valid_dist,
                                     float& min_valid_dist) const;
 
 private:
+    //! Get the position and the prediction parameters computed from it,
+    //! which are computed if they have been invalidated by the changes of the position or the observations
+    //! (return false if they cannot be computed since the landmark is being erased,
+    //!  then the parameters are those of the landmark observable from nowhere)
+    bool get_prediction_parameters(Vec3_t& pos_w, Vec3_t& mean_normal,
+                                   float& min_valid_dist, float& max_valid_dist) const;
+
+    //! Compute the prediction parameters from the current position and observations, and cache them
+    //! unless they are invalidated during the computation (the computations on the threads can overlap)
+    //! (the computed parameters and the position they are computed from are returned even if they are not cached,
+    //!  and false is returned if the landmark has no observations)
+    bool compute_and_cache_prediction_parameters(Vec3_t& pos_w, Vec3_t& mean_normal,
+                                                 float& min_valid_dist, float& max_valid_dist) const;
+
+    //! Invalidate the cached prediction parameters
+    void invalidate_prediction_parameters();
+
     //! world coordinates of this landmark
     Vec3_t pos_w_;
+    //! change journal which the position updates are recorded to
+    std::weak_ptr<map_change_journal> change_journal_;
 
     //! observations (keyframe and keypoint index)
     observations_t observations_;
+    //! number of the observing keyframes for each scale level (updated together with observations_)
+    std::vector<unsigned int> num_observations_by_scale_level_;
 
     //! true if the landmark has representative descriptor
     std::atomic<bool> has_representative_descriptor_{false};
     //! representative descriptor
     cv::Mat descriptor_;
+    //! descriptor index which the representative descriptor is registered to
+    std::weak_ptr<landmark_descriptor_index> descriptor_index_;
+
+    //! Hamming distances between the descriptors of the observations, which are reused by the next compute_descriptor()
+    struct descriptor_distances {
+        //! (keyframe ID, keypoint index) of each of the descriptors (in order of the keyframe IDs)
+        std::vector<std::pair<unsigned int, unsigned int>> keys_;
+        //! distances between each pair of the descriptors (row-major)
+        std::vector<uint16_t> dists_;
+    };
+    //! (the distances are cached only for the landmarks with many observations to reduce the footprint)
+    static constexpr unsigned int min_num_descs_to_cache_distances_ = 8;
+    //! cached distances (nullptr if not cached)
+    std::unique_ptr<descriptor_distances> desc_dists_;
 
     //! reference keyframe
     std::weak_ptr<keyframe> ref_keyfrm_;
@@ -169,19 +267,33 @@ private:
 
     //! this landmark will be erased shortly or not
     std::atomic<bool> will_be_erased_{false};
+    //! save epoch of the last modification
+    std::atomic<unsigned int> modified_epoch_{0};
 
     // parameters for prediction
+    //! (the parameters are cached by the const getters, guarded by mtx_position_)
     //! true if the landmark has valid prediction parameters
-    std::atomic<bool> has_valid_prediction_parameters_{false};
+    mutable std::atomic<bool> has_valid_prediction_parameters_{false};
+    //! advanced whenever the prediction parameters are invalidated or set
+    std::atomic<unsigned int> prediction_parameters_epoch_{0};
     //! Normalized average vector (unit vector) of keyframe->lm, for keyframes such that observe the 3D point.
-    Vec3_t mean_normal_ = Vec3_t::Zero();
+    mutable Vec3_t mean_normal_ = Vec3_t::Zero();
     //! max valid distance between landmark and camera
-    float min_valid_dist_ = 0;
+    mutable float min_valid_dist_ = 0;
     //! min valid distance between landmark and camera
-    float max_valid_dist_ = 0;
+    mutable float max_valid_dist_ = 0;
+
+    //! (spinlocks instead of std::mutex to reduce the footprint of each landmark)
+    mutable util::profiled_spinlock mtx_position_{"landmark::mtx_position_"};
+    mutable util::profiled_spinlock mtx_observations_{"landmark::mtx_observations_"};
+
+    //! Account the bytes of the landmark and its observations to memory_counter (NOTE: mtx_observations_ must be locked)
+    void account_memory();
 
-    mutable std::mutex mtx_position_;
-    mutable std::mutex mtx_observations_;
+    //! bytes accounted to memory_counter (guarded by mtx_observations_)
+    //! (two counters instead of memory_account to reduce the footprint of each landmark)
+    uint32_t accounted_lm_bytes_ = 0;
+    uint32_t accounted_obs_bytes_ = 0;
 };
 
 } // namespace data
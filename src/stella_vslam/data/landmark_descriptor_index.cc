@@ -0,0 +1,123 @@
+#include "stella_vslam/data/landmark_descriptor_index.h"
+#include "stella_vslam/data/memory_usage.h"
+#include "stella_vslam/match/hamming.h"
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+
+namespace stella_vslam {
+namespace data {
+
+void landmark_descriptor_index::update(const unsigned int id, const uint8_t* desc) {
+    std::lock_guard<util::shared_mutex> lock(mtx_);
+    auto iter = descriptors_.find(id);
+    if (iter != descriptors_.end()) {
+        if (std::memcmp(iter->second.data(), desc, iter->second.size()) == 0) {
+            return;
+        }
+        erase_substrings(id, iter->second);
+    }
+    else {
+        iter = descriptors_.emplace(id, descriptor_t()).first;
+    }
+
+    std::memcpy(iter->second.data(), desc, iter->second.size());
+    for (unsigned int k = 0; k < num_substrings_; ++k) {
+        tables_.at(k)[get_substring(desc, k)].push_back(id);
+    }
+}
+
+void landmark_descriptor_index::erase(const unsigned int id) {
+    std::lock_guard<util::shared_mutex> lock(mtx_);
+    const auto iter = descriptors_.find(id);
+    if (iter == descriptors_.end()) {
+        return;
+    }
+    erase_substrings(id, iter->second);
+    descriptors_.erase(iter);
+}
+
+void landmark_descriptor_index::erase_substrings(const unsigned int id, const descriptor_t& desc) {
+    for (unsigned int k = 0; k < num_substrings_; ++k) {
+        auto& table = tables_.at(k);
+        const auto bucket_iter = table.find(get_substring(desc.data(), k));
+        if (bucket_iter == table.end()) {
+            continue;
+        }
+        auto& ids = bucket_iter->second;
+        const auto id_iter = std::find(ids.begin(), ids.end(), id);
+        if (id_iter != ids.end()) {
+            *id_iter = ids.back();
+            ids.pop_back();
+        }
+        if (ids.empty()) {
+            table.erase(bucket_iter);
+        }
+    }
+}
+
+void landmark_descriptor_index::clear() {
+    std::lock_guard<util::shared_mutex> lock(mtx_);
+    for (auto& table : tables_) {
+        table.clear();
+    }
+    descriptors_.clear();
+}
+
+std::vector<std::pair<unsigned int, unsigned int>> landmark_descriptor_index::get_nearest_landmarks(const uint8_t* desc,
+                                                                                                   const unsigned int max_hamming_dist,
+                                                                                                   const unsigned int max_num_landmarks) const {
+    std::vector<unsigned int> candidate_ids;
+    std::vector<std::pair<unsigned int, unsigned int>> nearest_lms;
+    {
+        util::shared_lock_guard lock(mtx_);
+        for (unsigned int k = 0; k < num_substrings_; ++k) {
+            const auto& table = tables_.at(k);
+            const auto bucket_iter = table.find(get_substring(desc, k));
+            if (bucket_iter == table.end()) {
+                continue;
+            }
+            candidate_ids.insert(candidate_ids.end(), bucket_iter->second.begin(), bucket_iter->second.end());
+        }
+
+        // the landmark which shares several substrings with the query is examined once
+        std::sort(candidate_ids.begin(), candidate_ids.end());
+        candidate_ids.erase(std::unique(candidate_ids.begin(), candidate_ids.end()), candidate_ids.end());
+
+        nearest_lms.reserve(candidate_ids.size());
+        for (const auto id : candidate_ids) {
+            const auto dist = match::compute_hamming_distance_256(desc, descriptors_.at(id).data());
+            if (dist <= max_hamming_dist) {
+                nearest_lms.emplace_back(id, dist);
+            }
+        }
+    }
+
+    const auto num_landmarks = std::min<size_t>(max_num_landmarks, nearest_lms.size());
+    std::partial_sort(nearest_lms.begin(), nearest_lms.begin() + num_landmarks, nearest_lms.end(),
+                      [](const std::pair<unsigned int, unsigned int>& a, const std::pair<unsigned int, unsigned int>& b) {
+                          return a.second < b.second || (a.second == b.second && a.first < b.first);
+                      });
+    nearest_lms.resize(num_landmarks);
+    return nearest_lms;
+}
+
+size_t landmark_descriptor_index::size() const {
+    util::shared_lock_guard lock(mtx_);
+    return descriptors_.size();
+}
+
+size_t landmark_descriptor_index::get_memory_bytes() const {
+    util::shared_lock_guard lock(mtx_);
+    // (each landmark is listed once in each table)
+    size_t bytes = descriptors_.bucket_count() * sizeof(void*)
+                   + descriptors_.size() * (get_node_bytes<std::pair<const unsigned int, descriptor_t>>() + num_substrings_ * sizeof(unsigned int));
+    for (const auto& table : tables_) {
+        bytes += table.bucket_count() * sizeof(void*) + table.size() * get_node_bytes<std::pair<const uint16_t, std::vector<unsigned int>>>();
+    }
+    return bytes;
+}
+
+} // namespace data
+} // namespace stella_vslam
@@ -0,0 +1,94 @@
+#ifndef STELLA_VSLAM_DATA_LANDMARK_DESCRIPTOR_INDEX_H
+#define STELLA_VSLAM_DATA_LANDMARK_DESCRIPTOR_INDEX_H
+
+#include "stella_vslam/util/shared_mutex.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include <unordered_map>
+
+namespace stella_vslam {
+namespace data {
+
+/**
+ * Multi-index hash of the representative descriptors of the landmarks
+ * The 256-bit descriptors are split into 16-bit substrings, and each of them has a hash table.
+ * A landmark is examined if it shares at least one substring with the query,
+ * so the neighbors within the Hamming distance of 15 are always found and the farther ones approximately.
+ * (NOTE: the landmarks registered by map_database update their entries whenever their descriptors are computed)
+ */
+class landmark_descriptor_index {
+public:
+    /**
+     * Constructor
+     */
+    landmark_descriptor_index() = default;
+
+    /**
+     * Destructor
+     */
+    virtual ~landmark_descriptor_index() = default;
+
+    /**
+     * Insert the landmark, or replace its descriptor
+     * @param id landmark ID
+     * @param desc 32-byte ORB descriptor
+     */
+    void update(const unsigned int id, const uint8_t* desc);
+
+    /**
+     * Erase the landmark
+     * @param id landmark ID
+     */
+    void erase(const unsigned int id);
+
+    /**
+     * Clear the index
+     */
+    void clear();
+
+    /**
+     * Get the landmarks which are near to the query descriptor
+     * (NOTE: the distances are computed with the registered descriptors)
+     * @param desc 32-byte ORB query descriptor
+     * @param max_hamming_dist the landmarks farther than this are discarded
+     * @param max_num_landmarks maximum number of the returned landmarks
+     * @return pairs of the landmark ID and the Hamming distance in ascending order of the distance
+     */
+    std::vector<std::pair<unsigned int, unsigned int>> get_nearest_landmarks(const uint8_t* desc,
+                                                                            const unsigned int max_hamming_dist,
+                                                                            const unsigned int max_num_landmarks) const;
+
+    //! number of the registered landmarks
+    size_t size() const;
+
+    //! Estimated bytes of the tables and the descriptors
+    size_t get_memory_bytes() const;
+
+private:
+    static constexpr unsigned int num_substrings_ = 16;
+
+    using descriptor_t = std::array<uint8_t, 32>;
+
+    //! Get the k-th 16-bit substring of the descriptor
+    static uint16_t get_substring(const uint8_t* desc, const unsigned int k) {
+        return static_cast<uint16_t>(desc[2 * k] | (desc[2 * k + 1] << 8));
+    }
+
+    //! Erase the entries of the substrings (without mutex)
+    void erase_substrings(const unsigned int id, const descriptor_t& desc);
+
+    mutable util::shared_mutex mtx_;
+    //! landmark IDs in each bucket of the tables of the substrings
+    std::array<std::unordered_map<uint16_t, std::vector<unsigned int>>, num_substrings_> tables_;
+    //! registered descriptor of each landmark
+    std::unordered_map<unsigned int, descriptor_t> descriptors_;
+};
+
+} // namespace data
+} // namespace stella_vslam
+
+#endif // STELLA_VSLAM_DATA_LANDMARK_DESCRIPTOR_INDEX_H
@@ -0,0 +1,98 @@
+#include "stella_vslam/data/landmark_spatial_hash.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <unordered_set>
+
+namespace stella_vslam {
+namespace data {
+
+landmark_spatial_hash::landmark_spatial_hash(const double cell_size)
+    : cell_size_(cell_size) {
+    if (cell_size_ <= 0.0) {
+        throw std::runtime_error("cell size of the landmark spatial hash must be greater than 0");
+    }
+}
+
+void landmark_spatial_hash::build(const eigen_alloc_vector<Vec3_t>& positions) {
+    sorted_indices_.clear();
+    cells_.clear();
+
+    std::vector<cell_coords_t> cell_coords_of_lms;
+    cell_coords_of_lms.reserve(positions.size());
+    for (const auto& pos : positions) {
+        cell_coords_of_lms.push_back(to_cell_coords(pos));
+    }
+
+    // group the landmarks by the voxels, keeping the ascending order of the indices in each voxel
+    sorted_indices_.resize(positions.size());
+    for (unsigned int idx = 0; idx < positions.size(); ++idx) {
+        sorted_indices_.at(idx) = idx;
+    }
+    std::stable_sort(sorted_indices_.begin(), sorted_indices_.end(), [&cell_coords_of_lms](const unsigned int a, const unsigned int b) {
+        return cell_coords_of_lms.at(a) < cell_coords_of_lms.at(b);
+    });
+
+    for (unsigned int begin = 0; begin < sorted_indices_.size();) {
+        const auto& cell_coords = cell_coords_of_lms.at(sorted_indices_.at(begin));
+        unsigned int end = begin + 1;
+        while (end < sorted_indices_.size() && cell_coords_of_lms.at(sorted_indices_.at(end)) == cell_coords) {
+            ++end;
+        }
+        cells_[to_cell_key(cell_coords)].push_back(cell_range{cell_coords, begin, end});
+        begin = end;
+    }
+}
+
+std::vector<unsigned int> landmark_spatial_hash::get_landmarks_near(const eigen_alloc_vector<Vec3_t>& points, const double radius) const {
+    std::vector<unsigned int> indices;
+    if (radius < 0.0 || cells_.empty()) {
+        return indices;
+    }
+
+    // visit each occupied voxel once
+    std::unordered_set<const cell_range*> visited_cells;
+    for (const auto& point : points) {
+        const auto min_coords = to_cell_coords(point - Vec3_t::Constant(radius));
+        const auto max_coords = to_cell_coords(point + Vec3_t::Constant(radius));
+        cell_coords_t cell_coords;
+        for (cell_coords[0] = min_coords[0]; cell_coords[0] <= max_coords[0]; ++cell_coords[0]) {
+            for (cell_coords[1] = min_coords[1]; cell_coords[1] <= max_coords[1]; ++cell_coords[1]) {
+                for (cell_coords[2] = min_coords[2]; cell_coords[2] <= max_coords[2]; ++cell_coords[2]) {
+                    const auto iter = cells_.find(to_cell_key(cell_coords));
+                    if (iter == cells_.end()) {
+                        continue;
+                    }
+                    for (const auto& cell : iter->second) {
+                        // skip the other voxels which share the hash key
+                        if (cell.cell_coords_ != cell_coords || !visited_cells.insert(&cell).second) {
+                            continue;
+                        }
+                        indices.insert(indices.end(), sorted_indices_.begin() + cell.begin_, sorted_indices_.begin() + cell.end_);
+                    }
+                }
+            }
+        }
+    }
+
+    std::sort(indices.begin(), indices.end());
+    return indices;
+}
+
+landmark_spatial_hash::cell_coords_t landmark_spatial_hash::to_cell_coords(const Vec3_t& pos) const {
+    return cell_coords_t{{static_cast<std::int64_t>(std::floor(pos(0) / cell_size_)),
+                          static_cast<std::int64_t>(std::floor(pos(1) / cell_size_)),
+                          static_cast<std::int64_t>(std::floor(pos(2) / cell_size_))}};
+}
+
+landmark_spatial_hash::cell_key_t landmark_spatial_hash::to_cell_key(const cell_coords_t& cell_coords) {
+    // pack the lower 21 bits of each coordinate (as keyframe_spatial_index)
+    constexpr cell_key_t mask = (static_cast<cell_key_t>(1) << 21) - 1;
+    return ((static_cast<cell_key_t>(cell_coords[0]) & mask) << 42)
+           | ((static_cast<cell_key_t>(cell_coords[1]) & mask) << 21)
+           | (static_cast<cell_key_t>(cell_coords[2]) & mask);
+}
+
+} // namespace data
+} // namespace stella_vslam
@@ -0,0 +1,77 @@
+#ifndef STELLA_VSLAM_DATA_LANDMARK_SPATIAL_HASH_H
+#define STELLA_VSLAM_DATA_LANDMARK_SPATIAL_HASH_H
+
+#include "stella_vslam/type.h"
+
+#include <array>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace stella_vslam {
+namespace data {
+
+/**
+ * Voxel hash of the landmark positions, which is built at once and then queried
+ * (e.g. to shortlist the candidates of the duplication before the descriptors are compared)
+ * The hash is not updated when the landmarks move, so rebuild it after the positions are corrected.
+ * (NOTE: the queries are thread-safe while the hash is not rebuilt)
+ */
+class landmark_spatial_hash {
+public:
+    /**
+     * Constructor
+     * @param cell_size edge length of a voxel
+     */
+    explicit landmark_spatial_hash(const double cell_size);
+
+    /**
+     * Build the hash of the positions (the previous ones are discarded)
+     * @param positions positions of the landmarks in the world coordinates
+     */
+    void build(const eigen_alloc_vector<Vec3_t>& positions);
+
+    /**
+     * Get the landmarks which may be within the radius of any of the points
+     * (NOTE: the result is a superset of the exact answer, the landmarks in the voxels intersecting the cubes around the points)
+     * @param points
+     * @param radius
+     * @return indices of the positions given to build(), in ascending order
+     */
+    std::vector<unsigned int> get_landmarks_near(const eigen_alloc_vector<Vec3_t>& points, const double radius) const;
+
+    //! number of the landmarks
+    size_t size() const {
+        return sorted_indices_.size();
+    }
+
+private:
+    using cell_coords_t = std::array<std::int64_t, 3>;
+    using cell_key_t = std::uint64_t;
+
+    //! Integer coordinates of the voxel which contains the point
+    cell_coords_t to_cell_coords(const Vec3_t& pos) const;
+
+    //! Hash key of the voxel
+    static cell_key_t to_cell_key(const cell_coords_t& cell_coords);
+
+    //! Range of the landmarks of a voxel in sorted_indices_
+    struct cell_range {
+        cell_coords_t cell_coords_;
+        unsigned int begin_;
+        unsigned int end_;
+    };
+
+    //! edge length of a voxel
+    const double cell_size_;
+
+    //! indices of the landmarks sorted by the voxels
+    std::vector<unsigned int> sorted_indices_;
+    //! voxels which share each hash key (usually one)
+    std::unordered_map<cell_key_t, std::vector<cell_range>> cells_;
+};
+
+} // namespace data
+} // namespace stella_vslam
+
+#endif // STELLA_VSLAM_DATA_LANDMARK_SPATIAL_HASH_H
@@ -0,0 +1,106 @@
+#include "stella_vslam/data/landmark.h"
+#include "stella_vslam/data/local_map_snapshot.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+namespace stella_vslam {
+namespace data {
+
+namespace {
+//! Spread the lower 10 bits to every third bit
+uint32_t spread_bits(uint32_t v) {
+    v &= 0x000003ff;
+    v = (v | (v << 16)) & 0x030000ff;
+    v = (v | (v << 8)) & 0x0300f00f;
+    v = (v | (v << 4)) & 0x030c30c3;
+    v = (v | (v << 2)) & 0x09249249;
+    return v;
+}
+} // namespace
+
+constexpr unsigned int local_map_snapshot::descriptor_size;
+
+void local_map_snapshot::build(const std::vector<std::shared_ptr<landmark>>& lms) {
+    // read the landmarks via their own locks in the given order
+    std::vector<std::shared_ptr<landmark>> valid_lms;
+    valid_lms.reserve(lms.size());
+    eigen_alloc_vector<Vec3_t> pos_ws;
+    pos_ws.reserve(lms.size());
+    eigen_alloc_vector<Vec3_t> mean_normals;
+    mean_normals.reserve(lms.size());
+    std::vector<std::pair<float, float>> valid_dists;
+    valid_dists.reserve(lms.size());
+    Vec3_t pos_w;
+    Vec3_t mean_normal;
+    float min_valid_dist;
+    float max_valid_dist;
+    for (const auto& lm : lms) {
+        if (lm->will_be_erased()) {
+            continue;
+        }
+        lm->get_pos_in_world_and_prediction_parameters(pos_w, mean_normal, min_valid_dist, max_valid_dist);
+        valid_lms.push_back(lm);
+        pos_ws.push_back(pos_w);
+        mean_normals.push_back(mean_normal);
+        valid_dists.emplace_back(min_valid_dist, max_valid_dist);
+    }
+    const auto num_lms = valid_lms.size();
+
+    // sort the landmarks by the Morton codes of the positions quantized in the bounding box
+    std::vector<std::pair<uint32_t, unsigned int>> codes(num_lms);
+    if (0 < num_lms) {
+        Vec3_t min_pos = pos_ws.front();
+        Vec3_t max_pos = pos_ws.front();
+        for (const auto& pos : pos_ws) {
+            min_pos = min_pos.cwiseMin(pos);
+            max_pos = max_pos.cwiseMax(pos);
+        }
+        const Vec3_t inv_extent = (max_pos - min_pos).cwiseMax(Vec3_t::Constant(1e-6)).cwiseInverse() * 1023.0;
+        for (unsigned int i = 0; i < num_lms; ++i) {
+            const Vec3_t quantized = (pos_ws.at(i) - min_pos).cwiseProduct(inv_extent);
+            codes.at(i).first = spread_bits(static_cast<uint32_t>(quantized(0)))
+                                | (spread_bits(static_cast<uint32_t>(quantized(1))) << 1)
+                                | (spread_bits(static_cast<uint32_t>(quantized(2))) << 2);
+            codes.at(i).second = i;
+        }
+        std::sort(codes.begin(), codes.end());
+    }
+
+    landmarks_.resize(num_lms);
+    ids_.resize(num_lms);
+    pos_ws_.resize(num_lms, 3);
+    mean_normals_.resize(num_lms, 3);
+    min_valid_dists_.resize(num_lms);
+    max_valid_dists_.resize(num_lms);
+    num_observations_.resize(num_lms);
+    descriptors_.resize(num_lms * descriptor_size);
+    for (unsigned int idx = 0; idx < num_lms; ++idx) {
+        const auto i = codes.at(idx).second;
+        const auto& lm = valid_lms.at(i);
+        landmarks_.at(idx) = lm;
+        ids_.at(idx) = lm->id_;
+        pos_ws_.row(idx) = pos_ws.at(i).transpose().cast<tracking_real_t>();
+        mean_normals_.row(idx) = mean_normals.at(i).transpose().cast<tracking_real_t>();
+        min_valid_dists_(idx) = valid_dists.at(i).first;
+        max_valid_dists_(idx) = valid_dists.at(i).second;
+        num_observations_.at(idx) = lm->num_observations();
+        const cv::Mat desc = lm->get_descriptor();
+        std::memcpy(descriptors_.data() + descriptor_size * idx, desc.ptr<uint8_t>(), descriptor_size);
+    }
+}
+
+void local_map_snapshot::clear() {
+    landmarks_.clear();
+    ids_.clear();
+    pos_ws_.resize(0, 3);
+    mean_normals_.resize(0, 3);
+    min_valid_dists_.resize(0);
+    max_valid_dists_.resize(0);
+    num_observations_.clear();
+    descriptors_.clear();
+}
+
+} // namespace data
+} // namespace stella_vslam
@@ -0,0 +1,67 @@
+#ifndef STELLA_VSLAM_DATA_LOCAL_MAP_SNAPSHOT_H
+#define STELLA_VSLAM_DATA_LOCAL_MAP_SNAPSHOT_H
+
+#include "stella_vslam/type.h"
+
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace stella_vslam {
+namespace data {
+
+class landmark;
+
+/**
+ * Packed copy of the local landmarks which are read in the projection matching of the tracking
+ * The fields are stored in contiguous arrays in the order of the Morton codes of the positions,
+ * so the landmarks which are close in the world are also close in memory,
+ * and the ones reprojected one after another visit the neighboring cells of the keypoint grid.
+ * (NOTE: the snapshot is not updated when the landmarks are modified, so rebuild it when the local map is updated)
+ */
+struct local_map_snapshot {
+    /**
+     * Fill the arrays from the landmarks (the previous ones are discarded)
+     * (NOTE: the landmarks which will be erased are skipped)
+     * @param lms
+     */
+    void build(const std::vector<std::shared_ptr<landmark>>& lms);
+
+    //! Discard the landmarks
+    void clear();
+
+    size_t size() const { return ids_.size(); }
+
+    bool empty() const { return ids_.empty(); }
+
+    //! Descriptor of the idx-th landmark (32 bytes)
+    const uint8_t* get_descriptor(const unsigned int idx) const {
+        assert(idx < size());
+        return descriptors_.data() + descriptor_size * idx;
+    }
+
+    static constexpr unsigned int descriptor_size = 32;
+
+    //! landmarks
+    std::vector<std::shared_ptr<landmark>> landmarks_;
+    //! IDs of the landmarks
+    std::vector<unsigned int> ids_;
+    //! positions in the world (one row per landmark)
+    TrkMatX3_t pos_ws_;
+    //! mean normals of the observations
+    TrkMatX3_t mean_normals_;
+    //! minimum distances in which the landmarks are observable
+    TrkArrayX_t min_valid_dists_;
+    //! maximum distances in which the landmarks are observable (the scale levels are predicted from them)
+    TrkArrayX_t max_valid_dists_;
+    //! numbers of the observations
+    std::vector<unsigned int> num_observations_;
+    //! representative descriptors
+    std::vector<uint8_t> descriptors_;
+};
+
+} // namespace data
+} // namespace stella_vslam
+
+#endif // STELLA_VSLAM_DATA_LOCAL_MAP_SNAPSHOT_H
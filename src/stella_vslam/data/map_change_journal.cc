@@ -0,0 +1,57 @@
+#include "stella_vslam/data/map_change_journal.h"
+
+#include <stdexcept>
+
+namespace stella_vslam {
+namespace data {
+
+map_change_journal::map_change_journal(const unsigned int max_num_changes)
+    : max_num_changes_(max_num_changes) {
+    if (max_num_changes_ == 0) {
+        throw std::runtime_error("capacity of the map change journal must be greater than 0");
+    }
+}
+
+void map_change_journal::record(const map_object_type_t object_type, const unsigned int id, const map_change_type_t change_type) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    ++version_;
+    changes_.push_back(map_change{version_, id, object_type, change_type});
+    if (max_num_changes_ < changes_.size()) {
+        base_version_ = changes_.front().version_;
+        changes_.pop_front();
+    }
+}
+
+void map_change_journal::reset() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    ++version_;
+    changes_.clear();
+    base_version_ = version_;
+}
+
+bool map_change_journal::get_changes_since(const uint64_t version, std::vector<map_change>& changes, uint64_t& latest_version) const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    changes.clear();
+    latest_version = version_;
+    if (version < base_version_ || version_ < version) {
+        return false;
+    }
+
+    // the versions of the retained changes are consecutive
+    const auto first = changes_.begin() + (version - base_version_);
+    changes.assign(first, changes_.end());
+    return true;
+}
+
+uint64_t map_change_journal::get_version() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return version_;
+}
+
+size_t map_change_journal::size() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return changes_.size();
+}
+
+} // namespace data
+} // namespace stella_vslam
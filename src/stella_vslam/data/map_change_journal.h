@@ -0,0 +1,96 @@
+#ifndef STELLA_VSLAM_DATA_MAP_CHANGE_JOURNAL_H
+#define STELLA_VSLAM_DATA_MAP_CHANGE_JOURNAL_H
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+namespace stella_vslam {
+namespace data {
+
+enum class map_object_type_t : uint8_t {
+    Keyframe,
+    Landmark
+};
+
+enum class map_change_type_t : uint8_t {
+    Added,
+    Updated,
+    Erased
+};
+
+struct map_change {
+    //! version of the journal just after the change
+    uint64_t version_;
+    //! ID of the keyframe or the landmark
+    unsigned int id_;
+    map_object_type_t object_type_;
+    map_change_type_t change_type_;
+};
+
+/**
+ * Bounded append-only log of the additions, the updates and the erasures of the keyframes and the landmarks
+ * (NOTE: the keyframes and the landmarks registered by map_database record their updates whenever their poses or positions are set)
+ * The consumers keep the last version they read and receive only the changes after it.
+ * The oldest changes are discarded once the capacity is exceeded, then the consumers which fall behind have to scan the whole map again.
+ */
+class map_change_journal {
+public:
+    /**
+     * Constructor
+     * @param max_num_changes maximum number of the retained changes
+     */
+    explicit map_change_journal(const unsigned int max_num_changes = 1 << 20);
+
+    /**
+     * Destructor
+     */
+    virtual ~map_change_journal() = default;
+
+    /**
+     * Append a change
+     * @param object_type
+     * @param id
+     * @param change_type
+     */
+    void record(const map_object_type_t object_type, const unsigned int id, const map_change_type_t change_type);
+
+    /**
+     * Discard all of the changes and advance the version
+     * (NOTE: call this when the map is modified in bulk, e.g. cleared or loaded, so that the consumers scan the whole map again)
+     */
+    void reset();
+
+    /**
+     * Get the changes after the specified version
+     * @param version last version which the consumer read
+     * @param changes changes after the version in the recorded order
+     * @param latest_version version of the last change, which the consumer reads next time
+     * @return false if some of the changes after the version have been discarded (the consumer has to scan the whole map)
+     */
+    bool get_changes_since(const uint64_t version, std::vector<map_change>& changes, uint64_t& latest_version) const;
+
+    //! version of the last change
+    uint64_t get_version() const;
+
+    //! number of the retained changes
+    size_t size() const;
+
+private:
+    //! maximum number of the retained changes
+    const unsigned int max_num_changes_;
+
+    mutable std::mutex mtx_;
+    //! retained changes, ordered by the version
+    std::deque<map_change> changes_;
+    //! version of the last change
+    uint64_t version_ = 0;
+    //! the changes after this version are retained
+    uint64_t base_version_ = 0;
+};
+
+} // namespace data
+} // namespace stella_vslam
+
+#endif // STELLA_VSLAM_DATA_MAP_CHANGE_JOURNAL_H
@@ -0,0 +1,78 @@
+#include "stella_vslam/data/keyframe.h"
+#include "stella_vslam/data/landmark.h"
+#include "stella_vslam/data/map_correction.h"
+#include "stella_vslam/util/parallel_for.h"
+
+#include <spdlog/spdlog.h>
+
+namespace stella_vslam {
+namespace data {
+
+void map_correction::set_keyframe_pose(const std::shared_ptr<keyframe>& keyfrm, const Mat44_t& cam_pose_cw) {
+    keyfrms_.push_back(keyfrm);
+    cam_poses_cw_.push_back(cam_pose_cw);
+    const Mat33_t rot_cw = cam_pose_cw.block<3, 3>(0, 0);
+    const Vec3_t trans_cw = cam_pose_cw.block<3, 1>(0, 3);
+    cam_centers_[keyfrm->id_] = -rot_cw.transpose() * trans_cw;
+    prediction_parameters_are_computed_ = false;
+}
+
+void map_correction::set_landmark_position(const std::shared_ptr<landmark>& lm, const Vec3_t& pos_w) {
+    lms_.push_back(lm);
+    positions_w_.push_back(pos_w);
+    prediction_parameters_are_computed_ = false;
+}
+
+void map_correction::compute_prediction_parameters(util::thread_pool* thread_pool) {
+    mean_normals_.resize(lms_.size());
+    min_valid_dists_.resize(lms_.size());
+    max_valid_dists_.resize(lms_.size());
+
+    util::parallel_for(thread_pool, 0, static_cast<int64_t>(lms_.size()), [this](const int64_t idx) {
+        const auto& lm = lms_.at(idx);
+        if (lm->will_be_erased()) {
+            return;
+        }
+        lm->compute_prediction_parameters(positions_w_.at(idx), cam_centers_,
+                                          mean_normals_.at(idx), min_valid_dists_.at(idx), max_valid_dists_.at(idx));
+    });
+
+    prediction_parameters_are_computed_ = true;
+}
+
+void map_correction::publish() {
+    SPDLOG_TRACE("map_correction: publish {} keyframes and {} landmarks", keyfrms_.size(), lms_.size());
+
+    for (unsigned int idx = 0; idx < keyfrms_.size(); ++idx) {
+        keyfrms_.at(idx)->set_pose_cw(cam_poses_cw_.at(idx));
+    }
+
+    for (unsigned int idx = 0; idx < lms_.size(); ++idx) {
+        const auto& lm = lms_.at(idx);
+        if (lm->will_be_erased()) {
+            continue;
+        }
+        if (prediction_parameters_are_computed_) {
+            lm->set_pos_in_world_and_prediction_parameters(positions_w_.at(idx), mean_normals_.at(idx),
+                                                           min_valid_dists_.at(idx), max_valid_dists_.at(idx));
+        }
+        else {
+            // fall back to the computation with the already published camera poses
+            lm->set_pos_in_world(positions_w_.at(idx));
+            lm->update_mean_normal_and_obs_scale_variance();
+        }
+    }
+
+    keyfrms_.clear();
+    cam_poses_cw_.clear();
+    cam_centers_.clear();
+    lms_.clear();
+    positions_w_.clear();
+    mean_normals_.clear();
+    min_valid_dists_.clear();
+    max_valid_dists_.clear();
+    prediction_parameters_are_computed_ = false;
+}
+
+} // namespace data
+} // namespace stella_vslam
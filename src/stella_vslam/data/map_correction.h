@@ -0,0 +1,93 @@
+#ifndef STELLA_VSLAM_DATA_MAP_CORRECTION_H
+#define STELLA_VSLAM_DATA_MAP_CORRECTION_H
+
+#include "stella_vslam/type.h"
+
+#include <vector>
+#include <unordered_map>
+#include <memory>
+
+namespace stella_vslam {
+
+namespace util {
+class thread_pool;
+} // namespace util
+
+namespace data {
+
+class keyframe;
+class landmark;
+
+/**
+ * Side buffer of the corrected camera poses of keyframes and positions of landmarks
+ * All the corrections are computed without locking the map database, then published at once,
+ * so that the tracking module sees either the map before the correction or the one after it
+ */
+class map_correction {
+public:
+    /**
+     * Constructor
+     */
+    map_correction() = default;
+
+    /**
+     * Destructor
+     */
+    virtual ~map_correction() = default;
+
+    /**
+     * Set the corrected camera pose of the keyframe
+     * @param keyfrm
+     * @param cam_pose_cw
+     */
+    void set_keyframe_pose(const std::shared_ptr<keyframe>& keyfrm, const Mat44_t& cam_pose_cw);
+
+    /**
+     * Set the corrected position of the landmark
+     * @param lm
+     * @param pos_w
+     */
+    void set_landmark_position(const std::shared_ptr<landmark>& lm, const Vec3_t& pos_w);
+
+    /**
+     * Compute the prediction parameters of the corrected landmarks with the corrected camera poses
+     * (NOTE: call this before publish() WITHOUT locking the map database)
+     * @param thread_pool the pool to run the loop on (the OpenMP threads are used if nullptr)
+     */
+    void compute_prediction_parameters(util::thread_pool* thread_pool = nullptr);
+
+    /**
+     * Apply all the corrections to the keyframes and the landmarks, then clear the buffer
+     * (NOTE: call this while locking the map database)
+     */
+    void publish();
+
+    //! number of the corrected keyframes
+    size_t get_num_keyframes() const { return keyfrms_.size(); }
+
+    //! number of the corrected landmarks
+    size_t get_num_landmarks() const { return lms_.size(); }
+
+private:
+    //! corrected keyframes
+    std::vector<std::shared_ptr<keyframe>> keyfrms_;
+    //! corrected camera poses (same order as keyfrms_)
+    eigen_alloc_vector<Mat44_t> cam_poses_cw_;
+    //! corrected camera centers (key: keyframe ID)
+    eigen_alloc_unord_map<unsigned int, Vec3_t> cam_centers_;
+
+    //! corrected landmarks
+    std::vector<std::shared_ptr<landmark>> lms_;
+    //! corrected positions and their prediction parameters (same order as lms_)
+    eigen_alloc_vector<Vec3_t> positions_w_;
+    eigen_alloc_vector<Vec3_t> mean_normals_;
+    std::vector<float> min_valid_dists_;
+    std::vector<float> max_valid_dists_;
+    //! the prediction parameters have been computed or not
+    bool prediction_parameters_are_computed_ = false;
+};
+
+} // namespace data
+} // namespace stella_vslam
+
+#endif // STELLA_VSLAM_DATA_MAP_CORRECTION_H
@@ -2,12 +2,16 @@
 #include "stella_vslam/data/common.h"
 #include "stella_vslam/data/frame.h"
 #include "stella_vslam/data/keyframe.h"
+#include "stella_vslam/data/keyframe_spatial_index.h"
+#include "stella_vslam/data/landmark_descriptor_index.h"
 #include "stella_vslam/data/landmark.h"
+#include "stella_vslam/data/map_change_journal.h"
 #include "stella_vslam/data/marker.h"
 #include "stella_vslam/data/camera_database.h"
 #include "stella_vslam/data/orb_params_database.h"
 #include "stella_vslam/data/map_database.h"
 #include "stella_vslam/data/bow_vocabulary.h"
+#include "stella_vslam/util/async_reclaimer.h"
 #include "stella_vslam/util/converter.h"
 #include "stella_vslam/util/sqlite3.h"
 
@@ -15,13 +19,22 @@
 #include <nlohmann/json.hpp>
 #include <sqlite3.h>
 
+#include <algorithm>
+#include <exception>
+
 namespace stella_vslam {
 namespace data {
 
-std::mutex map_database::mtx_database_;
+util::profiled_mutex map_database::mtx_database_("map_database::mtx_database_");
+
+std::atomic<unsigned int> map_database::save_epoch_{0};
 
 map_database::map_database(unsigned int min_num_shared_lms)
-    : min_num_shared_lms_(min_num_shared_lms) {
+    : keyfrm_spatial_index_(std::make_shared<keyframe_spatial_index>()),
+      change_journal_(std::make_shared<map_change_journal>()),
+      lm_descriptor_index_(std::make_shared<landmark_descriptor_index>()),
+      local_landmarks_(std::make_shared<const std::vector<std::shared_ptr<landmark>>>()),
+      min_num_shared_lms_(min_num_shared_lms) {
     spdlog::debug("CONSTRUCT: data::map_database");
 }
 
@@ -31,18 +44,30 @@ map_database::~map_database() {
 }
 
 void map_database::add_keyframe(const std::shared_ptr<keyframe>& keyfrm) {
-    std::lock_guard<std::mutex> lock(mtx_map_access_);
+    std::lock_guard<util::profiled_shared_mutex> lock(mtx_map_access_);
+    ++version_;
+    if (!keyframes_.count(keyfrm->id_)) {
+        keyfrm->handle_ = keyfrm_slots_.insert(keyfrm.get());
+    }
     keyframes_[keyfrm->id_] = keyfrm;
+    keyfrm->set_spatial_index(keyfrm_spatial_index_);
+    keyfrm->set_change_journal(change_journal_);
+    change_journal_->record(map_object_type_t::Keyframe, keyfrm->id_, map_change_type_t::Added);
     last_inserted_keyfrm_ = keyfrm;
 }
 
 void map_database::erase_keyframe(const std::shared_ptr<keyframe>& keyfrm) {
-    std::lock_guard<std::mutex> lock(mtx_map_access_);
+    std::lock_guard<util::profiled_shared_mutex> lock(mtx_map_access_);
+    ++version_;
     keyframes_.erase(keyfrm->id_);
+    keyfrm_slots_.erase(keyfrm->handle_);
+    keyfrm->set_spatial_index(nullptr);
+    keyfrm->set_change_journal(nullptr);
+    change_journal_->record(map_object_type_t::Keyframe, keyfrm->id_, map_change_type_t::Erased);
 }
 
 std::shared_ptr<keyframe> map_database::get_keyframe(unsigned int id) const {
-    std::lock_guard<std::mutex> lock(mtx_map_access_);
+    util::shared_lock_guard lock(mtx_map_access_);
     if (!keyframes_.count(id)) {
         return nullptr;
     }
@@ -50,17 +75,62 @@ std::shared_ptr<keyframe> map_database::get_keyframe(unsigned int id) const {
 }
 
 void map_database::add_landmark(std::shared_ptr<landmark>& lm) {
-    std::lock_guard<std::mutex> lock(mtx_map_access_);
+    std::lock_guard<util::profiled_shared_mutex> lock(mtx_map_access_);
+    ++version_;
+    if (!landmarks_.count(lm->id_)) {
+        lm->handle_ = lm_slots_.insert(lm.get());
+    }
     landmarks_[lm->id_] = lm;
+    lm->set_change_journal(change_journal_);
+    lm->set_descriptor_index(lm_descriptor_index_);
+    change_journal_->record(map_object_type_t::Landmark, lm->id_, map_change_type_t::Added);
 }
 
 void map_database::erase_landmark(unsigned int id) {
-    std::lock_guard<std::mutex> lock(mtx_map_access_);
-    landmarks_.erase(id);
+    std::lock_guard<util::profiled_shared_mutex> lock(mtx_map_access_);
+    ++version_;
+    const auto iter = landmarks_.find(id);
+    if (iter == landmarks_.end()) {
+        return;
+    }
+    iter->second->set_change_journal(nullptr);
+    iter->second->set_descriptor_index(nullptr);
+    lm_slots_.erase(iter->second->handle_);
+    landmarks_.erase(iter);
+    change_journal_->record(map_object_type_t::Landmark, id, map_change_type_t::Erased);
+}
+
+void map_database::erase_landmarks(const std::vector<unsigned int>& ids) {
+    if (ids.empty()) {
+        return;
+    }
+    std::lock_guard<util::profiled_shared_mutex> lock(mtx_map_access_);
+    ++version_;
+    for (const auto id : ids) {
+        const auto iter = landmarks_.find(id);
+        if (iter == landmarks_.end()) {
+            continue;
+        }
+        iter->second->set_change_journal(nullptr);
+        iter->second->set_descriptor_index(nullptr);
+        lm_slots_.erase(iter->second->handle_);
+        landmarks_.erase(iter);
+        change_journal_->record(map_object_type_t::Landmark, id, map_change_type_t::Erased);
+    }
+}
+
+keyframe* map_database::get_keyframe(const slot_handle handle) const {
+    util::shared_lock_guard lock(mtx_map_access_);
+    return keyfrm_slots_.get(handle);
+}
+
+landmark* map_database::get_landmark(const slot_handle handle) const {
+    util::shared_lock_guard lock(mtx_map_access_);
+    return lm_slots_.get(handle);
 }
 
 std::shared_ptr<landmark> map_database::get_landmark(unsigned int id) const {
-    std::lock_guard<std::mutex> lock(mtx_map_access_);
+    util::shared_lock_guard lock(mtx_map_access_);
     if (!landmarks_.count(id)) {
         return nullptr;
     }
@@ -68,17 +138,19 @@ std::shared_ptr<landmark> map_database::get_landmark(unsigned int id) const {
 }
 
 void map_database::add_marker(const std::shared_ptr<marker>& mkr) {
-    std::lock_guard<std::mutex> lock(mtx_map_access_);
+    std::lock_guard<util::profiled_shared_mutex> lock(mtx_map_access_);
+    ++version_;
     markers_[mkr->id_] = mkr;
 }
 
 void map_database::erase_marker(const std::shared_ptr<marker>& mkr) {
-    std::lock_guard<std::mutex> lock(mtx_map_access_);
+    std::lock_guard<util::profiled_shared_mutex> lock(mtx_map_access_);
+    ++version_;
     markers_.erase(mkr->id_);
 }
 
 std::shared_ptr<marker> map_database::get_marker(unsigned int id) const {
-    std::lock_guard<std::mutex> lock(mtx_map_access_);
+    util::shared_lock_guard lock(mtx_map_access_);
     std::shared_ptr<marker> mkr;
     if (markers_.count(id) == 0) {
         mkr = nullptr;
@@ -90,27 +162,87 @@ std::shared_ptr<marker> map_database::get_marker(unsigned int id) const {
 }
 
 void map_database::add_spanning_root(std::shared_ptr<keyframe>& keyframe) {
-    std::lock_guard<std::mutex> lock(mtx_map_access_);
+    std::lock_guard<util::profiled_shared_mutex> lock(mtx_map_access_);
+    ++version_;
     spanning_roots_.push_back(keyframe);
+    // the current map is switched, so the consumers of the journal collect it again
+    change_journal_->reset();
 }
 
 std::vector<std::shared_ptr<keyframe>> map_database::get_spanning_roots() {
-    std::lock_guard<std::mutex> lock(mtx_map_access_);
+    util::shared_lock_guard lock(mtx_map_access_);
     return spanning_roots_;
 }
 
+void map_database::erase_spanning_root(const std::shared_ptr<keyframe>& keyframe) {
+    std::lock_guard<util::profiled_shared_mutex> lock(mtx_map_access_);
+    ++version_;
+    spanning_roots_.erase(std::remove(spanning_roots_.begin(), spanning_roots_.end(), keyframe), spanning_roots_.end());
+    change_journal_->reset();
+}
+
 void map_database::set_local_landmarks(const std::vector<std::shared_ptr<landmark>>& local_lms) {
-    std::lock_guard<std::mutex> lock(mtx_map_access_);
-    local_landmarks_ = local_lms;
+    // build the new snapshot outside the lock
+    auto local_lms_snapshot = std::make_shared<const std::vector<std::shared_ptr<landmark>>>(local_lms);
+    std::lock_guard<std::mutex> lock(mtx_local_lms_);
+    local_landmarks_ = std::move(local_lms_snapshot);
 }
 
 std::vector<std::shared_ptr<landmark>> map_database::get_local_landmarks() const {
-    std::lock_guard<std::mutex> lock(mtx_map_access_);
+    return *get_local_landmarks_snapshot();
+}
+
+std::shared_ptr<const std::vector<std::shared_ptr<landmark>>> map_database::get_local_landmarks_snapshot() const {
+    std::lock_guard<std::mutex> lock(mtx_local_lms_);
     return local_landmarks_;
 }
 
+void map_database::for_each_keyframe(const std::function<void(const std::shared_ptr<keyframe>&)>& func) const {
+    util::shared_lock_guard lock(mtx_map_access_);
+    for (const auto& id_keyframe : keyframes_) {
+        func(id_keyframe.second);
+    }
+}
+
+void map_database::for_each_landmark(const std::function<void(const std::shared_ptr<landmark>&)>& func) const {
+    util::shared_lock_guard lock(mtx_map_access_);
+    for (const auto& id_landmark : landmarks_) {
+        func(id_landmark.second);
+    }
+}
+
+std::shared_ptr<const std::vector<std::shared_ptr<keyframe>>> map_database::get_all_keyframes_snapshot() const {
+    util::shared_lock_guard lock(mtx_map_access_);
+    std::lock_guard<std::mutex> lock_snapshots(mtx_snapshots_);
+    if (!keyfrms_snapshot_ || keyfrms_snapshot_version_ != version_) {
+        auto keyfrms = std::make_shared<std::vector<std::shared_ptr<keyframe>>>();
+        keyfrms->reserve(keyframes_.size());
+        for (const auto& id_keyframe : keyframes_) {
+            keyfrms->push_back(id_keyframe.second);
+        }
+        keyfrms_snapshot_ = std::move(keyfrms);
+        keyfrms_snapshot_version_ = version_;
+    }
+    return keyfrms_snapshot_;
+}
+
+std::shared_ptr<const std::vector<std::shared_ptr<landmark>>> map_database::get_all_landmarks_snapshot() const {
+    util::shared_lock_guard lock(mtx_map_access_);
+    std::lock_guard<std::mutex> lock_snapshots(mtx_snapshots_);
+    if (!lms_snapshot_ || lms_snapshot_version_ != version_) {
+        auto lms = std::make_shared<std::vector<std::shared_ptr<landmark>>>();
+        lms->reserve(landmarks_.size());
+        for (const auto& id_landmark : landmarks_) {
+            lms->push_back(id_landmark.second);
+        }
+        lms_snapshot_ = std::move(lms);
+        lms_snapshot_version_ = version_;
+    }
+    return lms_snapshot_;
+}
+
 std::vector<std::shared_ptr<keyframe>> map_database::get_all_keyframes() const {
-    std::lock_guard<std::mutex> lock(mtx_map_access_);
+    util::shared_lock_guard lock(mtx_map_access_);
     std::vector<std::shared_ptr<keyframe>> keyframes;
     keyframes.reserve(keyframes_.size());
     for (const auto& id_keyframe : keyframes_) {
@@ -119,32 +251,47 @@ std::vector<std::shared_ptr<keyframe>> map_database::get_all_keyframes() const {
     return keyframes;
 }
 
+std::vector<std::shared_ptr<keyframe>> map_database::get_keyframes_by_ids(const std::vector<unsigned int>& keyfrm_ids) const {
+    util::shared_lock_guard lock(mtx_map_access_);
+    std::vector<std::shared_ptr<keyframe>> keyframes;
+    keyframes.reserve(keyfrm_ids.size());
+    for (const auto id : keyfrm_ids) {
+        const auto iter = keyframes_.find(id);
+        if (iter != keyframes_.end()) {
+            keyframes.push_back(iter->second);
+        }
+    }
+    return keyframes;
+}
+
 std::vector<std::shared_ptr<keyframe>> map_database::get_close_keyframes_2d(const Mat44_t& pose_cw,
                                                                             const Vec3_t& normal_vector,
                                                                             const double distance_threshold,
                                                                             const double angle_threshold) const {
-    std::lock_guard<std::mutex> lock(mtx_map_access_);
-
     // Close (within given thresholds) keyframes
     std::vector<std::shared_ptr<keyframe>> filtered_keyframes;
 
     const double cos_angle_threshold = std::cos(angle_threshold);
     Mat44_t pose_wc = util::converter::inverse_pose(pose_cw);
 
-    // Calculate angles and distances between given pose and all keyframes
+    // Calculate angles and distances between given pose and the keyframes near it
     Mat33_t M = pose_wc.block<3, 3>(0, 0);
     Vec3_t Mt = pose_wc.block<3, 1>(0, 3);
-    for (const auto& id_keyframe : keyframes_) {
-        Mat33_t N = id_keyframe.second->get_pose_wc().block<3, 3>(0, 0);
-        Vec3_t Nt = id_keyframe.second->get_pose_wc().block<3, 1>(0, 3);
+    // (the index query and the distance below project onto the same plane)
+    const Vec3_t unit_normal = normal_vector.normalized();
+    const auto candidates = get_keyframes_by_ids(keyfrm_spatial_index_->get_keyframes_in_cylinder(Mt, unit_normal, distance_threshold));
+    for (const auto& candidate : candidates) {
+        const Mat44_t candidate_pose_wc = candidate->get_pose_wc();
+        Mat33_t N = candidate_pose_wc.block<3, 3>(0, 0);
+        Vec3_t Nt = candidate_pose_wc.block<3, 1>(0, 3);
         // Angle between two cameras related to given pose and selected keyframe
         const double cos_angle = ((M * N.transpose()).trace() - 1) / 2;
         // Distance between given pose and selected keyframe
-        const double dist = ((Nt - Nt.dot(normal_vector) * normal_vector)
-                             - (Mt - Mt.dot(normal_vector) * normal_vector))
+        const double dist = ((Nt - Nt.dot(unit_normal) * unit_normal)
+                             - (Mt - Mt.dot(unit_normal) * unit_normal))
                                 .norm();
         if (dist < distance_threshold && cos_angle > cos_angle_threshold) {
-            filtered_keyframes.push_back(id_keyframe.second);
+            filtered_keyframes.push_back(candidate);
         }
     }
 
@@ -154,26 +301,26 @@ std::vector<std::shared_ptr<keyframe>> map_database::get_close_keyframes_2d(cons
 std::vector<std::shared_ptr<keyframe>> map_database::get_close_keyframes(const Mat44_t& pose_cw,
                                                                          const double distance_threshold,
                                                                          const double angle_threshold) const {
-    std::lock_guard<std::mutex> lock(mtx_map_access_);
-
     // Close (within given thresholds) keyframes
     std::vector<std::shared_ptr<keyframe>> filtered_keyframes;
 
     const double cos_angle_threshold = std::cos(angle_threshold);
     Mat44_t pose_wc = util::converter::inverse_pose(pose_cw);
 
-    // Calculate angles and distances between given pose and all keyframes
+    // Calculate angles and distances between given pose and the keyframes near it
     Mat33_t M = pose_wc.block<3, 3>(0, 0);
     Vec3_t Mt = pose_wc.block<3, 1>(0, 3);
-    for (const auto& id_keyframe : keyframes_) {
-        Mat33_t N = id_keyframe.second->get_pose_wc().block<3, 3>(0, 0);
-        Vec3_t Nt = id_keyframe.second->get_pose_wc().block<3, 1>(0, 3);
+    const auto candidates = get_keyframes_by_ids(keyfrm_spatial_index_->get_keyframes_in_sphere(Mt, distance_threshold));
+    for (const auto& candidate : candidates) {
+        const Mat44_t candidate_pose_wc = candidate->get_pose_wc();
+        Mat33_t N = candidate_pose_wc.block<3, 3>(0, 0);
+        Vec3_t Nt = candidate_pose_wc.block<3, 1>(0, 3);
         // Angle between two cameras related to given pose and selected keyframe
         const double cos_angle = ((M * N.transpose()).trace() - 1) / 2;
         // Distance between given pose and selected keyframe
         const double dist = (Nt - Mt).norm();
         if (dist < distance_threshold && cos_angle > cos_angle_threshold) {
-            filtered_keyframes.push_back(id_keyframe.second);
+            filtered_keyframes.push_back(candidate);
         }
     }
 
@@ -181,12 +328,12 @@ std::vector<std::shared_ptr<keyframe>> map_database::get_close_keyframes(const M
 }
 
 unsigned int map_database::get_num_keyframes() const {
-    std::lock_guard<std::mutex> lock(mtx_map_access_);
+    util::shared_lock_guard lock(mtx_map_access_);
     return keyframes_.size();
 }
 
 std::vector<std::shared_ptr<landmark>> map_database::get_all_landmarks() const {
-    std::lock_guard<std::mutex> lock(mtx_map_access_);
+    util::shared_lock_guard lock(mtx_map_access_);
     std::vector<std::shared_ptr<landmark>> landmarks;
     landmarks.reserve(landmarks_.size());
     for (const auto& id_landmark : landmarks_) {
@@ -196,12 +343,12 @@ std::vector<std::shared_ptr<landmark>> map_database::get_all_landmarks() const {
 }
 
 std::shared_ptr<keyframe> map_database::get_last_inserted_keyframe() const {
-    std::lock_guard<std::mutex> lock(mtx_map_access_);
+    util::shared_lock_guard lock(mtx_map_access_);
     return last_inserted_keyfrm_;
 }
 
 std::vector<std::shared_ptr<marker>> map_database::get_all_markers() const {
-    std::lock_guard<std::mutex> lock(mtx_map_access_);
+    util::shared_lock_guard lock(mtx_map_access_);
     std::vector<std::shared_ptr<marker>> markers;
     markers.reserve(markers_.size());
     for (const auto& id_marker : markers_) {
@@ -211,29 +358,110 @@ std::vector<std::shared_ptr<marker>> map_database::get_all_markers() const {
 }
 
 unsigned int map_database::get_num_markers() const {
-    std::lock_guard<std::mutex> lock(mtx_map_access_);
+    util::shared_lock_guard lock(mtx_map_access_);
     return markers_.size();
 }
 
 unsigned int map_database::get_num_landmarks() const {
-    std::lock_guard<std::mutex> lock(mtx_map_access_);
+    util::shared_lock_guard lock(mtx_map_access_);
     return landmarks_.size();
 }
 
+memory_usage map_database::get_memory_usage() const {
+    memory_usage usage;
+    usage.keyfrm_descriptors_ = memory_counter::get(memory_category_t::KeyframeDescriptors);
+    usage.keyfrm_keypoints_ = memory_counter::get(memory_category_t::KeyframeKeypoints);
+    usage.keyfrm_grids_ = memory_counter::get(memory_category_t::KeyframeGrids);
+    usage.keyfrm_bow_vectors_ = memory_counter::get(memory_category_t::KeyframeBoW);
+    usage.keyfrm_objects_ = memory_counter::get(memory_category_t::KeyframeObjects);
+    usage.lm_objects_ = memory_counter::get(memory_category_t::LandmarkObjects);
+    usage.lm_observations_ = memory_counter::get(memory_category_t::LandmarkObservations);
+
+    {
+        util::shared_lock_guard lock(mtx_map_access_);
+        usage.map_database_ = keyframes_.bucket_count() * sizeof(void*)
+                              + keyframes_.size() * get_node_bytes<std::pair<const unsigned int, std::shared_ptr<keyframe>>>()
+                              + landmarks_.bucket_count() * sizeof(void*)
+                              + landmarks_.size() * get_node_bytes<std::pair<const unsigned int, std::shared_ptr<landmark>>>()
+                              + markers_.bucket_count() * sizeof(void*)
+                              + markers_.size() * get_node_bytes<std::pair<const unsigned int, std::shared_ptr<marker>>>()
+                              + keyfrm_slots_.get_memory_bytes() + lm_slots_.get_memory_bytes()
+                              + spanning_roots_.capacity() * sizeof(std::shared_ptr<keyframe>);
+        if (keyfrm_spatial_index_) {
+            usage.map_database_ += keyfrm_spatial_index_->get_memory_bytes();
+        }
+        if (lm_descriptor_index_) {
+            usage.map_database_ += lm_descriptor_index_->get_memory_bytes();
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mtx_frm_stats_);
+        usage.frame_statistics_ = frm_stats_.get_memory_bytes();
+    }
+    return usage;
+}
+
 unsigned int map_database::get_min_num_shared_lms() const {
     return min_num_shared_lms_;
 }
 
 void map_database::clear() {
-    std::lock_guard<std::mutex> lock(mtx_map_access_);
+    std::lock_guard<util::profiled_shared_mutex> lock(mtx_map_access_);
+    ++version_;
 
-    landmarks_.clear();
-    keyframes_.clear();
-    last_inserted_keyfrm_ = nullptr;
-    local_landmarks_.clear();
-    spanning_roots_.clear();
+    // the objects which are still referred from the outside must not update the indices of the new map
+    for (const auto& id_landmark : landmarks_) {
+        id_landmark.second->set_change_journal(nullptr);
+        id_landmark.second->set_descriptor_index(nullptr);
+    }
+    for (const auto& id_keyframe : keyframes_) {
+        id_keyframe.second->set_spatial_index(nullptr);
+        id_keyframe.second->set_change_journal(nullptr);
+    }
+
+    // swap out the containers, whose objects are destroyed at once or on the reclaimer
+    auto cleared_map = std::make_shared<cleared_objects>();
+    cleared_map->keyframes_.swap(keyframes_);
+    cleared_map->landmarks_.swap(landmarks_);
+    cleared_map->markers_.swap(markers_);
+    cleared_map->spanning_roots_.swap(spanning_roots_);
+    cleared_map->last_inserted_keyfrm_.swap(last_inserted_keyfrm_);
+    lm_slots_.clear();
+    keyfrm_slots_.clear();
+    keyfrm_spatial_index_->clear();
+    lm_descriptor_index_->clear();
+    change_journal_->reset();
+    {
+        std::lock_guard<std::mutex> lock_snapshots(mtx_snapshots_);
+        cleared_map->keyfrms_snapshot_.swap(keyfrms_snapshot_);
+        cleared_map->lms_snapshot_.swap(lms_snapshot_);
+    }
+    {
+        std::lock_guard<std::mutex> lock_local_lms(mtx_local_lms_);
+        cleared_map->local_landmarks_ = local_landmarks_;
+        local_landmarks_ = std::make_shared<const std::vector<std::shared_ptr<landmark>>>();
+    }
+    // the markers and the keyframes which observe them refer to each other
+    std::function<void()> reclaim = [cleared_map] {
+        for (const auto& id_marker : cleared_map->markers_) {
+            id_marker.second->observations_.clear();
+        }
+    };
+    if (reclaimer_) {
+        reclaimer_->push(std::move(reclaim));
+    }
+    else {
+        reclaim();
+    }
 
-    frm_stats_.clear();
+    {
+        std::lock_guard<std::mutex> lock_frm_stats(mtx_frm_stats_);
+        frm_stats_.clear();
+        if (frm_stats_observer_) {
+            frm_stats_observer_->on_cleared();
+        }
+    }
 
     next_keyframe_id_ = 0;
     next_landmark_id_ = 0;
@@ -241,109 +469,95 @@ void map_database::clear() {
     spdlog::info("clear map database");
 }
 
+void map_database::set_reclaimer(const std::shared_ptr<util::async_reclaimer>& reclaimer) {
+    std::lock_guard<util::profiled_shared_mutex> lock(mtx_map_access_);
+    reclaimer_ = reclaimer;
+}
+
 void map_database::from_json(camera_database* cam_db, orb_params_database* orb_params_db, bow_vocabulary* bow_vocab,
                              const nlohmann::json& json_keyfrms, const nlohmann::json& json_landmarks) {
-    std::lock_guard<std::mutex> lock(mtx_map_access_);
+    std::lock_guard<util::profiled_shared_mutex> lock(mtx_map_access_);
+    ++version_;
 
     // When loading the map, leave last_inserted_keyfrm_ as nullptr.
     last_inserted_keyfrm_ = nullptr;
-    local_landmarks_.clear();
+    {
+        std::lock_guard<std::mutex> lock_local_lms(mtx_local_lms_);
+        local_landmarks_ = std::make_shared<const std::vector<std::shared_ptr<landmark>>>();
+    }
 
-    // Step 2. Register keyframes
-    // If the object does not exist at this step, the corresponding pointer is set as nullptr.
-    spdlog::info("decoding {} keyframes to load", json_keyfrms.size());
+    // Step 1. Resolve the IDs (the JSON objects are referred to, not copied)
+    std::vector<std::pair<unsigned int, const nlohmann::json*>> id_json_keyfrms;
+    id_json_keyfrms.reserve(json_keyfrms.size());
     for (const auto& json_id_keyfrm : json_keyfrms.items()) {
         const auto keyfrm_id_in_storage = std::stoi(json_id_keyfrm.key());
         assert(0 <= keyfrm_id_in_storage);
-        const auto keyfrm_id = keyfrm_id_in_storage + next_keyframe_id_;
-        const auto json_keyfrm = json_id_keyfrm.value();
+        id_json_keyfrms.emplace_back(keyfrm_id_in_storage + next_keyframe_id_, &json_id_keyfrm.value());
+    }
 
-        register_keyframe(cam_db, orb_params_db, bow_vocab, keyfrm_id, json_keyfrm);
+    // Step 2. Register keyframes
+    // The keyframes are decoded in parallel (including the grid assignment and the BoW computation),
+    // then appended to the database.
+    // If the object does not exist at this step, the corresponding pointer is set as nullptr.
+    spdlog::info("decoding {} keyframes to load", id_json_keyfrms.size());
+    std::vector<std::shared_ptr<keyframe>> keyfrms(id_json_keyfrms.size());
+    std::exception_ptr decoding_error = nullptr;
+#ifdef USE_OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (int64_t i = 0; i < static_cast<int64_t>(id_json_keyfrms.size()); ++i) {
+        try {
+            keyfrms.at(i) = decode_keyframe(cam_db, orb_params_db, bow_vocab, id_json_keyfrms.at(i).first, *id_json_keyfrms.at(i).second);
+        }
+        catch (...) {
+            // exceptions must not escape from the parallel region
+#ifdef USE_OPENMP
+#pragma omp critical
+#endif
+            decoding_error = std::current_exception();
+        }
+    }
+    if (decoding_error) {
+        std::rethrow_exception(decoding_error);
+    }
+    for (const auto& keyfrm : keyfrms) {
+        assert(!keyframes_.count(keyfrm->id_));
+        keyframes_[keyfrm->id_] = keyfrm;
+        keyfrm->handle_ = keyfrm_slots_.insert(keyfrm.get());
+        keyfrm->set_spatial_index(keyfrm_spatial_index_);
     }
 
     // Step 3. Register 3D landmark point
     // If the object does not exist at this step, the corresponding pointer is set as nullptr.
     spdlog::info("decoding {} landmarks to load", json_landmarks.size());
+    std::vector<std::shared_ptr<landmark>> lms;
+    lms.reserve(json_landmarks.size());
     for (const auto& json_id_landmark : json_landmarks.items()) {
         const auto landmark_id_in_storage = std::stoi(json_id_landmark.key());
         assert(0 <= landmark_id_in_storage);
         const auto landmark_id = landmark_id_in_storage + next_landmark_id_;
-        const auto json_landmark = json_id_landmark.value();
 
-        register_landmark(landmark_id, json_landmark);
+        lms.push_back(register_landmark(landmark_id, json_id_landmark.value()));
     }
 
     // Step 4. Register graph information
     spdlog::info("registering essential graph");
-    for (const auto& json_id_keyfrm : json_keyfrms.items()) {
-        const auto keyfrm_id_in_storage = std::stoi(json_id_keyfrm.key());
-        assert(0 <= keyfrm_id_in_storage);
-        const auto keyfrm_id = keyfrm_id_in_storage + next_keyframe_id_;
-        const auto json_keyfrm = json_id_keyfrm.value();
-
-        register_graph(keyfrm_id, json_keyfrm);
+    for (const auto& id_json_keyfrm : id_json_keyfrms) {
+        register_graph(id_json_keyfrm.first, *id_json_keyfrm.second);
     }
 
     // Step 5. Register association between keyframs and 3D points
     spdlog::info("registering keyframe-landmark association");
-    for (const auto& json_id_keyfrm : json_keyfrms.items()) {
-        const auto keyfrm_id_in_storage = std::stoi(json_id_keyfrm.key());
-        assert(0 <= keyfrm_id_in_storage);
-        const auto keyfrm_id = keyfrm_id_in_storage + next_keyframe_id_;
-        const auto json_keyfrm = json_id_keyfrm.value();
-
-        register_association(keyfrm_id, json_keyfrm);
-    }
-
-    // find root node
-    std::unordered_set<unsigned int> already_found_root_ids;
-    for (const auto& json_id_keyfrm : json_keyfrms.items()) {
-        const auto id = std::stoi(json_id_keyfrm.key()) + next_keyframe_id_;
-        auto keyfrm = keyframes_.at(id);
-        auto root = keyfrm->graph_node_->get_spanning_root();
-        if (already_found_root_ids.count(root->id_)) {
-            continue;
-        }
-        already_found_root_ids.insert(root->id_);
-        spdlog::debug("found root node {}", root->id_);
-        spanning_roots_.push_back(root);
-    }
-
-    // Step 6. Update graph
-    spdlog::info("updating covisibility graph");
-    for (const auto& json_id_keyfrm : json_keyfrms.items()) {
-        const auto keyfrm_id_in_storage = std::stoi(json_id_keyfrm.key());
-        assert(0 <= keyfrm_id_in_storage);
-        const auto keyfrm_id = keyfrm_id_in_storage + next_keyframe_id_;
-
-        assert(keyframes_.count(keyfrm_id));
-        auto keyfrm = keyframes_.at(keyfrm_id);
-
-        keyfrm->graph_node_->update_connections(min_num_shared_lms_);
-        keyfrm->graph_node_->update_covisibility_orders();
+    for (const auto& id_json_keyfrm : id_json_keyfrms) {
+        register_association(id_json_keyfrm.first, *id_json_keyfrm.second);
     }
 
-    // Step 7. Update geometry
-    spdlog::info("updating landmark geometry");
-    for (const auto& json_id_landmark : json_landmarks.items()) {
-        const auto landmark_id_in_storage = std::stoi(json_id_landmark.key());
-        assert(0 <= landmark_id_in_storage);
-        const auto landmark_id = landmark_id_in_storage + next_landmark_id_;
-
-        assert(landmarks_.count(landmark_id));
-        const auto& lm = landmarks_.at(landmark_id);
-
-        if (!lm->has_valid_prediction_parameters()) {
-            lm->update_mean_normal_and_obs_scale_variance();
-        }
-        if (!lm->has_representative_descriptor()) {
-            lm->compute_descriptor();
-        }
-    }
+    // Step 6, 7. Find the root nodes, and update the covisibility graph and the landmark geometry
+    update_loaded_map(keyfrms, lms);
 }
 
-void map_database::register_keyframe(camera_database* cam_db, orb_params_database* orb_params_db, bow_vocabulary* bow_vocab,
-                                     const unsigned int id, const nlohmann::json& json_keyfrm) {
+std::shared_ptr<keyframe> map_database::decode_keyframe(camera_database* cam_db, orb_params_database* orb_params_db, bow_vocabulary* bow_vocab,
+                                                        const unsigned int id, const nlohmann::json& json_keyfrm) const {
     // Metadata
     const auto timestamp = json_keyfrm.at("ts").get<double>();
     const auto camera_name = json_keyfrm.at("cam").get<std::string>();
@@ -361,7 +575,7 @@ void map_database::register_keyframe(camera_database* cam_db, orb_params_databas
     // Keypoints information
     const auto num_keypts = json_keyfrm.at("n_keypts").get<unsigned int>();
     // undist_keypts
-    const auto json_undist_keypts = json_keyfrm.at("undist_keypts");
+    const auto& json_undist_keypts = json_keyfrm.at("undist_keypts");
     const auto undist_keypts = convert_json_to_keypoints(json_undist_keypts);
     assert(undist_keypts.size() == num_keypts);
     // bearings
@@ -369,11 +583,11 @@ void map_database::register_keyframe(camera_database* cam_db, orb_params_databas
     camera->convert_keypoints_to_bearings(undist_keypts, bearings);
     assert(bearings.size() == num_keypts);
     // stereo_x_right
-    const auto stereo_x_right = json_keyfrm.at("x_rights").get<std::vector<float>>();
+    const auto stereo_x_right = convert_json_to_floats(json_keyfrm.at("x_rights"));
     // depths
-    const auto depths = json_keyfrm.at("depths").get<std::vector<float>>();
+    const auto depths = convert_json_to_floats(json_keyfrm.at("depths"));
     // descriptors
-    const auto json_descriptors = json_keyfrm.at("descs");
+    const auto& json_descriptors = json_keyfrm.at("descs");
     const auto descriptors = convert_json_to_descriptors(json_descriptors);
     assert(descriptors.rows == static_cast<int>(num_keypts));
 
@@ -381,22 +595,19 @@ void map_database::register_keyframe(camera_database* cam_db, orb_params_databas
     data::bow_vector bow_vec;
     data::bow_feature_vector bow_feat_vec;
     // Assign all the keypoints into grid
-    std::vector<std::vector<std::vector<unsigned int>>> keypt_indices_in_cells;
+    keypoint_grid keypt_indices_in_cells;
     data::assign_keypoints_to_grid(camera, undist_keypts, keypt_indices_in_cells);
     // Construct frame_observation
-    frame_observation frm_obs{num_keypts, descriptors, undist_keypts, bearings, stereo_x_right, depths, keypt_indices_in_cells};
+    // (the descriptors are held by the keyframe apart from the observations)
+    frame_observation frm_obs{num_keypts, cv::Mat(), undist_keypts, bearings, stereo_x_right, depths, keypt_indices_in_cells};
     // Compute BoW
     data::bow_vocabulary_util::compute_bow(bow_vocab, descriptors, bow_vec, bow_feat_vec);
-    auto keyfrm = data::keyframe::make_keyframe(
+    return data::keyframe::make_keyframe(
         id, timestamp, pose_cw, camera, orb_params,
-        frm_obs, bow_vec, bow_feat_vec);
-
-    // Append to map database
-    assert(!keyframes_.count(id));
-    keyframes_[keyfrm->id_] = keyfrm;
+        make_frame_observation(std::move(frm_obs)), bow_vec, bow_feat_vec, descriptors);
 }
 
-void map_database::register_landmark(const unsigned int id, const nlohmann::json& json_landmark) {
+std::shared_ptr<landmark> map_database::register_landmark(const unsigned int id, const nlohmann::json& json_landmark) {
     const auto first_keyfrm_id = json_landmark.at("1st_keyfrm").get<int>() + next_keyframe_id_;
     const auto pos_w = Vec3_t(json_landmark.at("pos_w").get<std::vector<Vec3_t::value_type>>().data());
     const auto ref_keyfrm_id = json_landmark.at("ref_keyfrm").get<int>() + next_keyframe_id_;
@@ -404,11 +615,13 @@ void map_database::register_landmark(const unsigned int id, const nlohmann::json
     const auto num_visible = json_landmark.at("n_vis").get<unsigned int>();
     const auto num_found = json_landmark.at("n_fnd").get<unsigned int>();
 
-    auto lm = std::make_shared<data::landmark>(
+    auto lm = data::landmark::create(
         id, first_keyfrm_id, pos_w, ref_keyfrm,
         num_visible, num_found);
     assert(!landmarks_.count(id));
     landmarks_[lm->id_] = lm;
+    lm->handle_ = lm_slots_.insert(lm.get());
+    return lm;
 }
 
 void map_database::register_graph(const unsigned int id, const nlohmann::json& json_keyfrm) {
@@ -453,21 +666,37 @@ void map_database::register_association(const unsigned int keyfrm_id, const nloh
     }
 }
 
-void map_database::to_json(nlohmann::json& json_keyfrms, nlohmann::json& json_landmarks) const {
-    std::lock_guard<std::mutex> lock(mtx_map_access_);
+void map_database::to_json(nlohmann::json& json_keyfrms, nlohmann::json& json_landmarks,
+                           const observation_encoding_t encoding) const {
+    util::shared_lock_guard lock(mtx_map_access_);
 
     // Save each keyframe as json
     spdlog::info("encoding {} keyframes to store", keyframes_.size());
-    std::map<std::string, nlohmann::json> keyfrms;
+    std::vector<std::shared_ptr<keyframe>> keyfrms_to_encode;
+    keyfrms_to_encode.reserve(keyframes_.size());
     for (const auto& id_keyfrm : keyframes_) {
         const auto id = id_keyfrm.first;
         const auto keyfrm = id_keyfrm.second;
         assert(keyfrm);
         assert(id == keyfrm->id_);
         assert(!keyfrm->will_be_erased());
+        // (NOTE: the connections are updated before encoding, because the covisibilities of the others are modified)
         keyfrm->graph_node_->update_connections(min_num_shared_lms_);
+        keyfrms_to_encode.push_back(keyfrm);
+    }
+    // The keyframes are encoded (and compressed) in parallel
+    std::vector<nlohmann::json> encoded_keyfrms(keyfrms_to_encode.size());
+#ifdef USE_OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (int64_t i = 0; i < static_cast<int64_t>(keyfrms_to_encode.size()); ++i) {
+        encoded_keyfrms.at(i) = keyfrms_to_encode.at(i)->to_json(encoding);
+    }
+    std::map<std::string, nlohmann::json> keyfrms;
+    for (unsigned int i = 0; i < keyfrms_to_encode.size(); ++i) {
+        const auto id = keyfrms_to_encode.at(i)->id_;
         assert(!keyfrms.count(std::to_string(id)));
-        keyfrms[std::to_string(id)] = keyfrm->to_json();
+        keyfrms[std::to_string(id)] = std::move(encoded_keyfrms.at(i));
     }
     json_keyfrms = keyfrms;
 
@@ -490,18 +719,24 @@ bool map_database::from_db(sqlite3* db,
                            camera_database* cam_db,
                            orb_params_database* orb_params_db,
                            bow_vocabulary* bow_vocab) {
-    std::lock_guard<std::mutex> lock(mtx_map_access_);
+    std::lock_guard<util::profiled_shared_mutex> lock(mtx_map_access_);
+    ++version_;
 
     // When loading the map, leave last_inserted_keyfrm_ as nullptr.
     last_inserted_keyfrm_ = nullptr;
-    local_landmarks_.clear();
+    {
+        std::lock_guard<std::mutex> lock_local_lms(mtx_local_lms_);
+        local_landmarks_ = std::make_shared<const std::vector<std::shared_ptr<landmark>>>();
+    }
 
     // Step 2. load data from database
-    bool ok = load_keyframes_from_db(db, "keyframes", cam_db, orb_params_db, bow_vocab);
+    std::vector<std::shared_ptr<keyframe>> keyfrms;
+    bool ok = load_keyframes_from_db(db, "keyframes", cam_db, orb_params_db, bow_vocab, keyfrms);
     if (!ok) {
         return false;
     }
-    ok = load_landmarks_from_db(db, "landmarks");
+    std::vector<std::shared_ptr<landmark>> lms;
+    ok = load_landmarks_from_db(db, "landmarks", lms);
     if (!ok) {
         return false;
     }
@@ -510,13 +745,55 @@ bool map_database::from_db(sqlite3* db,
         return false;
     }
 
+    update_loaded_map(keyfrms, lms);
+    return ok;
+}
+
+void map_database::register_loaded_map(const std::vector<std::shared_ptr<keyframe>>& keyfrms,
+                                       const std::vector<std::shared_ptr<landmark>>& lms) {
+    std::lock_guard<util::profiled_shared_mutex> lock(mtx_map_access_);
+    ++version_;
+
+    // When loading the map, leave last_inserted_keyfrm_ as nullptr.
+    last_inserted_keyfrm_ = nullptr;
+    {
+        std::lock_guard<std::mutex> lock_local_lms(mtx_local_lms_);
+        local_landmarks_ = std::make_shared<const std::vector<std::shared_ptr<landmark>>>();
+    }
+
+    for (const auto& keyfrm : keyfrms) {
+        assert(!keyframes_.count(keyfrm->id_));
+        keyframes_[keyfrm->id_] = keyfrm;
+        keyfrm->handle_ = keyfrm_slots_.insert(keyfrm.get());
+        keyfrm->set_spatial_index(keyfrm_spatial_index_);
+    }
+    for (const auto& lm : lms) {
+        assert(!landmarks_.count(lm->id_));
+        landmarks_[lm->id_] = lm;
+        lm->handle_ = lm_slots_.insert(lm.get());
+    }
+
+    update_loaded_map(keyfrms, lms);
+}
+
+void map_database::update_loaded_map(const std::vector<std::shared_ptr<keyframe>>& keyfrms,
+                                     const std::vector<std::shared_ptr<landmark>>& lms) {
+    // the loaded objects are not recorded one by one, the consumers of the journal collect the whole map again
+    for (const auto& keyfrm : keyfrms) {
+        keyfrm->set_change_journal(change_journal_);
+    }
+    for (const auto& lm : lms) {
+        lm->set_change_journal(change_journal_);
+        lm->set_descriptor_index(lm_descriptor_index_);
+    }
+    change_journal_->reset();
+
     // find root node
     std::unordered_set<unsigned int> already_found_root_ids;
     for (const auto& root : spanning_roots_) {
         already_found_root_ids.insert(root->id_);
     }
-    for (const auto& id_keyfrm : keyframes_) {
-        const auto keyfrm = id_keyfrm.second;
+    for (const auto& keyfrm : keyfrms) {
         auto root = keyfrm->graph_node_->get_spanning_root();
         if (already_found_root_ids.count(root->id_)) {
             continue;
@@ -526,17 +803,22 @@ bool map_database::from_db(sqlite3* db,
         spanning_roots_.push_back(root);
     }
 
+    // (NOTE: update_connections() also modifies the connections of the covisibilities, so it runs sequentially)
     spdlog::info("updating covisibility graph");
-    for (const auto& id_keyfrm : keyframes_) {
-        const auto keyfrm = id_keyfrm.second;
-
+    for (const auto& keyfrm : keyfrms) {
         keyfrm->graph_node_->update_connections(min_num_shared_lms_);
+    }
+    for (const auto& keyfrm : keyfrms) {
         keyfrm->graph_node_->update_covisibility_orders();
     }
 
+    // each landmark only reads the observing keyframes
     spdlog::info("updating landmark geometry");
-    for (const auto& id_landmark : landmarks_) {
-        const auto lm = id_landmark.second;
+#ifdef USE_OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (int64_t i = 0; i < static_cast<int64_t>(lms.size()); ++i) {
+        const auto& lm = lms.at(i);
 
         if (!lm->has_valid_prediction_parameters()) {
             lm->update_mean_normal_and_obs_scale_variance();
@@ -545,32 +827,44 @@ bool map_database::from_db(sqlite3* db,
             lm->compute_descriptor();
         }
     }
-    return ok;
 }
 
 bool map_database::load_keyframes_from_db(sqlite3* db,
                                           const std::string& table_name,
                                           camera_database* cam_db,
                                           orb_params_database* orb_params_db,
-                                          bow_vocabulary* bow_vocab) {
+                                          bow_vocabulary* bow_vocab,
+                                          std::vector<std::shared_ptr<keyframe>>& keyfrms) {
     sqlite3_stmt* stmt = util::sqlite3_util::create_select_stmt(db, table_name);
     if (!stmt) {
         return false;
     }
 
+    // (NOTE: the rows are read sequentially, and the BoW is computed in parallel afterwards)
     int ret = SQLITE_ERROR;
     while ((ret = sqlite3_step(stmt)) == SQLITE_ROW) {
-        auto keyfrm = data::keyframe::from_stmt(stmt, cam_db, orb_params_db, bow_vocab, next_keyframe_id_);
+        auto keyfrm = data::keyframe::from_stmt(stmt, cam_db, orb_params_db, nullptr, next_keyframe_id_);
         // Append to map database
         assert(!keyframes_.count(keyfrm->id_));
         keyframes_[keyfrm->id_] = keyfrm;
+        keyfrm->handle_ = keyfrm_slots_.insert(keyfrm.get());
+        keyfrm->set_spatial_index(keyfrm_spatial_index_);
+        keyfrms.push_back(keyfrm);
     }
-
     sqlite3_finalize(stmt);
+
+#ifdef USE_OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (int64_t i = 0; i < static_cast<int64_t>(keyfrms.size()); ++i) {
+        keyfrms.at(i)->compute_bow(bow_vocab);
+    }
+
     return ret == SQLITE_DONE;
 }
 
-bool map_database::load_landmarks_from_db(sqlite3* db, const std::string& table_name) {
+bool map_database::load_landmarks_from_db(sqlite3* db, const std::string& table_name,
+                                          std::vector<std::shared_ptr<landmark>>& lms) {
     sqlite3_stmt* stmt = util::sqlite3_util::create_select_stmt(db, table_name);
     if (!stmt) {
         return false;
@@ -581,6 +875,8 @@ bool map_database::load_landmarks_from_db(sqlite3* db, const std::string& table_
         auto lm = data::landmark::from_stmt(stmt, keyframes_, next_landmark_id_, next_keyframe_id_);
         assert(!landmarks_.count(lm->id_));
         landmarks_[lm->id_] = lm;
+        lm->handle_ = lm_slots_.insert(lm.get());
+        lms.push_back(lm);
     }
     sqlite3_finalize(stmt);
     return ret == SQLITE_DONE;
@@ -592,7 +888,7 @@ void map_database::load_association_from_stmt(sqlite3_stmt* stmt) {
     auto keyfrm_id = sqlite3_column_int64(stmt, column_id);
     assert(keyframes_.count(keyfrm_id));
     column_id++;
-    std::vector<int> lm_ids(keyframes_.at(keyfrm_id)->frm_obs_.num_keypts_, -1);
+    std::vector<int> lm_ids(keyframes_.at(keyfrm_id)->frm_obs_->num_keypts_, -1);
     p = reinterpret_cast<const char*>(sqlite3_column_blob(stmt, column_id));
     std::memcpy(lm_ids.data(), p, sqlite3_column_bytes(stmt, column_id));
     column_id++;
@@ -653,8 +949,93 @@ bool map_database::load_associations_from_db(sqlite3* db, const std::string& tab
     return ret == SQLITE_DONE;
 }
 
-bool map_database::to_db(sqlite3* db) const {
-    std::lock_guard<std::mutex> lock(mtx_map_access_);
+std::shared_ptr<map_database> map_database::create_snapshot() const {
+    util::shared_lock_guard lock(mtx_map_access_);
+    auto snapshot = std::make_shared<map_database>(min_num_shared_lms_);
+    snapshot->snapshot_epoch_ = save_epoch_++;
+    snapshot->next_keyframe_id_ = static_cast<unsigned int>(next_keyframe_id_);
+    snapshot->next_landmark_id_ = static_cast<unsigned int>(next_landmark_id_);
+
+    // copy the keyframes (without the BoW, which is not saved)
+    // (the immutable observations are shared with the keyframes of the map, and the descriptors are hydrated if they are compacted)
+    for (const auto& id_keyfrm : keyframes_) {
+        const auto& keyfrm = id_keyfrm.second;
+        auto copied_keyfrm = keyframe::make_keyframe(
+            keyfrm->id_, keyfrm->timestamp_, keyfrm->get_pose_cw(), keyfrm->camera_, keyfrm->orb_params_,
+            keyfrm->frm_obs_, bow_vector(), bow_feature_vector(), keyfrm->get_descriptors());
+        copied_keyfrm->handle_ = snapshot->keyfrm_slots_.insert(copied_keyfrm.get());
+        snapshot->keyframes_[id_keyfrm.first] = copied_keyfrm;
+    }
+
+    // copy the landmarks
+    for (const auto& id_lm : landmarks_) {
+        const auto& lm = id_lm.second;
+        const auto ref_keyfrm = lm->get_ref_keyframe();
+        if (!ref_keyfrm || !snapshot->keyframes_.count(ref_keyfrm->id_)) {
+            continue;
+        }
+        auto copied_lm = landmark::create(
+            lm->id_, lm->first_keyfrm_id_, lm->get_pos_in_world(), snapshot->keyframes_.at(ref_keyfrm->id_),
+            lm->get_num_observable(), lm->get_num_observed());
+        copied_lm->handle_ = snapshot->lm_slots_.insert(copied_lm.get());
+        snapshot->landmarks_[id_lm.first] = copied_lm;
+    }
+
+    // copy the associations and the spanning tree
+    for (const auto& id_keyfrm : keyframes_) {
+        const auto& keyfrm = id_keyfrm.second;
+        const auto& copied_keyfrm = snapshot->keyframes_.at(id_keyfrm.first);
+        const auto lms = keyfrm->get_landmarks();
+        for (unsigned int idx = 0; idx < lms.size(); ++idx) {
+            const auto& lm = lms.at(idx);
+            if (!lm || lm->will_be_erased() || !snapshot->landmarks_.count(lm->id_)) {
+                continue;
+            }
+            copied_keyfrm->add_landmark(snapshot->landmarks_.at(lm->id_), idx);
+        }
+
+        const auto spanning_parent = keyfrm->graph_node_->get_spanning_parent();
+        if (spanning_parent && snapshot->keyframes_.count(spanning_parent->id_)) {
+            copied_keyfrm->graph_node_->set_spanning_parent(snapshot->keyframes_.at(spanning_parent->id_));
+        }
+        for (const auto& spanning_child : keyfrm->graph_node_->get_spanning_children()) {
+            if (snapshot->keyframes_.count(spanning_child->id_)) {
+                copied_keyfrm->graph_node_->add_spanning_child(snapshot->keyframes_.at(spanning_child->id_));
+            }
+        }
+        for (const auto& loop_edge : keyfrm->graph_node_->get_loop_edges()) {
+            if (snapshot->keyframes_.count(loop_edge->id_)) {
+                copied_keyfrm->graph_node_->add_loop_edge(snapshot->keyframes_.at(loop_edge->id_));
+            }
+        }
+    }
+    for (const auto& root : spanning_roots_) {
+        if (snapshot->keyframes_.count(root->id_)) {
+            snapshot->spanning_roots_.push_back(snapshot->keyframes_.at(root->id_));
+        }
+    }
+
+    // keep the modification records for the incremental saving
+    for (const auto& id_keyfrm : keyframes_) {
+        snapshot->keyframes_.at(id_keyfrm.first)->set_modified_epoch(id_keyfrm.second->get_modified_epoch());
+    }
+    for (const auto& id_lm : snapshot->landmarks_) {
+        id_lm.second->set_modified_epoch(landmarks_.at(id_lm.first)->get_modified_epoch());
+    }
+
+    spdlog::debug("create a snapshot of {} keyframes and {} landmarks", snapshot->keyframes_.size(), snapshot->landmarks_.size());
+    return snapshot;
+}
+
+unsigned int map_database::advance_save_epoch() const {
+    if (0 <= snapshot_epoch_) {
+        return static_cast<unsigned int>(snapshot_epoch_);
+    }
+    return save_epoch_++;
+}
+
+bool map_database::to_db(sqlite3* db, const bool incremental, const unsigned int modified_since_epoch) const {
+    util::shared_lock_guard lock(mtx_map_access_);
     for (const auto& id_keyfrm : keyframes_) {
         const auto keyfrm = id_keyfrm.second;
         assert(keyfrm);
@@ -662,143 +1043,200 @@ bool map_database::to_db(sqlite3* db) const {
         keyfrm->graph_node_->update_connections(min_num_shared_lms_);
     }
 
-    bool ok = util::sqlite3_util::drop_table(db, "keyframes");
-    ok = ok && util::sqlite3_util::drop_table(db, "landmarks");
-    ok = ok && util::sqlite3_util::drop_table(db, "associations");
-    ok = ok && save_keyframes_to_db(db, "keyframes");
-    ok = ok && save_landmarks_to_db(db, "landmarks");
-    ok = ok && save_associations_to_db(db, "associations");
+    std::vector<std::shared_ptr<keyframe>> keyfrms;
+    keyfrms.reserve(keyframes_.size());
+    for (const auto& id_keyfrm : keyframes_) {
+        if (!incremental || id_keyfrm.second->is_modified_since(modified_since_epoch)) {
+            keyfrms.push_back(id_keyfrm.second);
+        }
+    }
+    std::vector<std::shared_ptr<landmark>> lms;
+    lms.reserve(landmarks_.size());
+    for (const auto& id_lm : landmarks_) {
+        if (!incremental || id_lm.second->is_modified_since(modified_since_epoch)) {
+            lms.push_back(id_lm.second);
+        }
+    }
+
+    bool ok = true;
+    if (incremental) {
+        std::unordered_set<unsigned int> keyfrm_ids;
+        keyfrm_ids.reserve(keyframes_.size());
+        for (const auto& id_keyfrm : keyframes_) {
+            keyfrm_ids.insert(id_keyfrm.first);
+        }
+        std::unordered_set<unsigned int> lm_ids;
+        lm_ids.reserve(landmarks_.size());
+        for (const auto& id_lm : landmarks_) {
+            lm_ids.insert(id_lm.first);
+        }
+        ok = ok && delete_erased_rows_from_db(db, "keyframes", keyfrm_ids);
+        ok = ok && delete_erased_rows_from_db(db, "landmarks", lm_ids);
+        ok = ok && delete_erased_rows_from_db(db, "associations", keyfrm_ids);
+        spdlog::debug("write {} keyframes and {} landmarks modified since the last save", keyfrms.size(), lms.size());
+    }
+    else {
+        ok = ok && util::sqlite3_util::drop_table(db, "keyframes");
+        ok = ok && util::sqlite3_util::drop_table(db, "landmarks");
+        ok = ok && util::sqlite3_util::drop_table(db, "associations");
+        ok = ok && util::sqlite3_util::create_table(db, "keyframes", data::keyframe::columns());
+        ok = ok && util::sqlite3_util::create_table(db, "landmarks", data::landmark::columns());
+        ok = ok && util::sqlite3_util::create_table(db, "associations", association_columns());
+    }
+    ok = ok && save_keyframes_to_db(db, "keyframes", keyfrms);
+    ok = ok && save_landmarks_to_db(db, "landmarks", lms);
+    ok = ok && save_associations_to_db(db, "associations", keyfrms);
     return ok;
 }
 
-bool map_database::save_keyframes_to_db(sqlite3* db, const std::string& table_name) const {
-    const auto columns = data::keyframe::columns();
-    bool ok = util::sqlite3_util::create_table(db, table_name, columns);
-    ok = ok && util::sqlite3_util::begin(db);
-    if (!ok) {
+bool map_database::delete_erased_rows_from_db(sqlite3* db, const std::string& table_name,
+                                              const std::unordered_set<unsigned int>& ids_to_keep) const {
+    std::unordered_set<unsigned int> ids_in_db;
+    if (!util::sqlite3_util::select_ids(db, table_name, ids_in_db)) {
         return false;
     }
-    sqlite3_stmt* stmt = util::sqlite3_util::create_insert_stmt(db, table_name, columns);
+    sqlite3_stmt* stmt = util::sqlite3_util::create_delete_stmt(db, table_name);
     if (!stmt) {
         return false;
     }
-    for (const auto& id_keyfrm : keyframes_) {
-        const auto keyfrm = id_keyfrm.second;
+    bool ok = true;
+    for (const auto id : ids_in_db) {
+        if (ids_to_keep.count(id)) {
+            continue;
+        }
+        ok = sqlite3_bind_int64(stmt, 1, id) == SQLITE_OK;
+        ok = ok && util::sqlite3_util::next(db, stmt);
+        if (!ok) {
+            break;
+        }
+    }
+    sqlite3_finalize(stmt);
+    return ok;
+}
+
+bool map_database::save_keyframes_to_db(sqlite3* db, const std::string& table_name,
+                                        const std::vector<std::shared_ptr<keyframe>>& keyfrms) const {
+    sqlite3_stmt* stmt = util::sqlite3_util::create_insert_stmt(db, table_name, data::keyframe::columns(), true);
+    if (!stmt) {
+        return false;
+    }
+    bool ok = true;
+    for (const auto& keyfrm : keyfrms) {
         assert(keyfrm);
         assert(!keyfrm->will_be_erased());
         ok = keyfrm->bind_to_stmt(db, stmt);
         ok = ok && util::sqlite3_util::next(db, stmt);
         if (!ok) {
-            return false;
+            break;
         }
     }
     sqlite3_finalize(stmt);
-    return util::sqlite3_util::commit(db);
+    return ok;
 }
 
-bool map_database::save_landmarks_to_db(sqlite3* db, const std::string& table_name) const {
-    const auto columns = data::landmark::columns();
-    bool ok = util::sqlite3_util::create_table(db, table_name, columns);
-    ok = ok && util::sqlite3_util::begin(db);
-    if (!ok) {
-        return false;
-    }
-    sqlite3_stmt* stmt = util::sqlite3_util::create_insert_stmt(db, table_name, columns);
+bool map_database::save_landmarks_to_db(sqlite3* db, const std::string& table_name,
+                                        const std::vector<std::shared_ptr<landmark>>& lms) const {
+    sqlite3_stmt* stmt = util::sqlite3_util::create_insert_stmt(db, table_name, data::landmark::columns(), true);
     if (!stmt) {
         return false;
     }
-    for (const auto& id_landmark : landmarks_) {
-        const auto lm = id_landmark.second;
+    bool ok = true;
+    for (const auto& lm : lms) {
         assert(lm);
         assert(!lm->will_be_erased());
-        bool ok = lm->bind_to_stmt(db, stmt);
+        ok = lm->bind_to_stmt(db, stmt);
         ok = ok && util::sqlite3_util::next(db, stmt);
         if (!ok) {
-            return false;
+            break;
         }
     }
     sqlite3_finalize(stmt);
-    return util::sqlite3_util::commit(db);
+    return ok;
 }
 
-bool map_database::bind_association_to_stmt(sqlite3_stmt* stmt,
-                                            const std::shared_ptr<keyframe>& keyfrm) const {
-    int ret = SQLITE_ERROR;
-    int column_id = 1;
-    if (ret == SQLITE_OK || ret == SQLITE_DONE) {
-        ret = sqlite3_bind_int64(stmt, column_id++, keyfrm->id_);
+map_database::association map_database::encode_association(const std::shared_ptr<keyframe>& keyfrm) {
+    association assoc;
+    assoc.keyfrm_id_ = keyfrm->id_;
+
+    // extract landmark IDs
+    const auto lms = keyfrm->get_landmarks();
+    assoc.lm_ids_.resize(lms.size(), -1);
+    for (unsigned int i = 0; i < lms.size(); ++i) {
+        if (lms.at(i) && !lms.at(i)->will_be_erased()) {
+            assoc.lm_ids_.at(i) = lms.at(i)->id_;
+        }
+    }
+
+    const auto spanning_parent = keyfrm->graph_node_->get_spanning_parent();
+    assoc.spanning_parent_id_ = spanning_parent ? static_cast<int64_t>(spanning_parent->id_) : -1LL;
+
+    // extract spanning tree children
+    const auto spanning_children = keyfrm->graph_node_->get_spanning_children();
+    assoc.spanning_child_ids_.reserve(spanning_children.size());
+    for (const auto& spanning_child : spanning_children) {
+        assoc.spanning_child_ids_.push_back(spanning_child->id_);
+    }
+
+    // extract loop edges
+    const auto loop_edges = keyfrm->graph_node_->get_loop_edges();
+    assoc.loop_edge_ids_.reserve(loop_edges.size());
+    for (const auto& loop_edge : loop_edges) {
+        assoc.loop_edge_ids_.push_back(loop_edge->id_);
     }
+    return assoc;
+}
+
+bool map_database::bind_association_to_stmt(sqlite3_stmt* stmt, const association& assoc) const {
+    // NOTE: assoc outlives the step of the statement, so that the blobs are not copied
+    int column_id = 1;
+    int ret = sqlite3_bind_int64(stmt, column_id++, assoc.keyfrm_id_);
     if (ret == SQLITE_OK) {
-        // extract landmark IDs
-        auto lms = keyfrm->get_landmarks();
-        std::vector<int> lm_ids(lms.size(), -1);
-        for (unsigned int i = 0; i < lms.size(); ++i) {
-            if (lms.at(i) && !lms.at(i)->will_be_erased()) {
-                lm_ids.at(i) = lms.at(i)->id_;
-            }
-        }
-        ret = sqlite3_bind_blob(stmt, column_id++, lm_ids.data(), lm_ids.size() * sizeof(decltype(lm_ids)::value_type), SQLITE_TRANSIENT);
+        ret = sqlite3_bind_blob(stmt, column_id++, assoc.lm_ids_.data(), assoc.lm_ids_.size() * sizeof(int), SQLITE_STATIC);
     }
     if (ret == SQLITE_OK) {
-        const auto& spanning_parent = keyfrm->graph_node_->get_spanning_parent();
-        ret = sqlite3_bind_int64(stmt, column_id++,
-                                 spanning_parent ? static_cast<int64_t>(spanning_parent->id_) : -1LL);
+        ret = sqlite3_bind_int64(stmt, column_id++, assoc.spanning_parent_id_);
     }
     if (ret == SQLITE_OK) {
-        const auto spanning_children = keyfrm->graph_node_->get_spanning_children();
-        ret = sqlite3_bind_int64(stmt, column_id++, spanning_children.size());
+        ret = sqlite3_bind_int64(stmt, column_id++, assoc.spanning_child_ids_.size());
     }
     if (ret == SQLITE_OK) {
-        // extract spanning tree children
-        const auto spanning_children = keyfrm->graph_node_->get_spanning_children();
-        std::vector<int> spanning_child_ids;
-        spanning_child_ids.reserve(spanning_children.size());
-        for (const auto& spanning_child : spanning_children) {
-            spanning_child_ids.push_back(spanning_child->id_);
-        }
-
-        ret = sqlite3_bind_blob(stmt, column_id++, spanning_child_ids.data(), spanning_child_ids.size() * sizeof(decltype(spanning_child_ids)::value_type), SQLITE_TRANSIENT);
+        ret = sqlite3_bind_blob(stmt, column_id++, assoc.spanning_child_ids_.data(), assoc.spanning_child_ids_.size() * sizeof(int), SQLITE_STATIC);
     }
     if (ret == SQLITE_OK) {
-        const auto loop_edges = keyfrm->graph_node_->get_loop_edges();
-        ret = sqlite3_bind_int64(stmt, column_id++, loop_edges.size());
+        ret = sqlite3_bind_int64(stmt, column_id++, assoc.loop_edge_ids_.size());
     }
     if (ret == SQLITE_OK) {
-        // extract loop edges
-        const auto loop_edges = keyfrm->graph_node_->get_loop_edges();
-        std::vector<int> loop_edge_ids;
-        for (const auto& loop_edge : loop_edges) {
-            loop_edge_ids.push_back(loop_edge->id_);
-        }
-
-        ret = sqlite3_bind_blob(stmt, column_id++, loop_edge_ids.data(), loop_edge_ids.size() * sizeof(decltype(loop_edge_ids)::value_type), SQLITE_TRANSIENT);
+        ret = sqlite3_bind_blob(stmt, column_id++, assoc.loop_edge_ids_.data(), assoc.loop_edge_ids_.size() * sizeof(int), SQLITE_STATIC);
     }
     return ret == SQLITE_OK;
 }
 
-bool map_database::save_associations_to_db(sqlite3* db, const std::string& table_name) const {
-    const auto columns = association_columns();
-    bool ok = util::sqlite3_util::create_table(db, table_name, columns);
-    ok = ok && util::sqlite3_util::begin(db);
-    if (!ok) {
-        return false;
+bool map_database::save_associations_to_db(sqlite3* db, const std::string& table_name,
+                                           const std::vector<std::shared_ptr<keyframe>>& keyfrms) const {
+    // encode the rows in parallel, then bind them sequentially
+    std::vector<association> assocs(keyfrms.size());
+#ifdef USE_OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (int64_t i = 0; i < static_cast<int64_t>(keyfrms.size()); ++i) {
+        assocs.at(i) = encode_association(keyfrms.at(i));
     }
-    sqlite3_stmt* stmt = util::sqlite3_util::create_insert_stmt(db, table_name, columns);
+
+    sqlite3_stmt* stmt = util::sqlite3_util::create_insert_stmt(db, table_name, association_columns(), true);
     if (!stmt) {
         return false;
     }
-    for (const auto& id_keyfrm : keyframes_) {
-        const auto keyfrm = id_keyfrm.second;
-        assert(keyfrm);
-        assert(!keyfrm->will_be_erased());
-        ok = bind_association_to_stmt(stmt, keyfrm);
+    bool ok = true;
+    for (const auto& assoc : assocs) {
+        ok = bind_association_to_stmt(stmt, assoc);
         ok = ok && util::sqlite3_util::next(db, stmt);
         if (!ok) {
-            return false;
+            spdlog::error("SQLite error (association): {}", sqlite3_errmsg(db));
+            break;
         }
     }
     sqlite3_finalize(stmt);
-    return util::sqlite3_util::commit(db);
+    return ok;
 }
 
 } // namespace data
@@ -3,10 +3,19 @@
 
 #include "stella_vslam/data/bow_vocabulary_fwd.h"
 #include "stella_vslam/data/frame_statistics.h"
-
+#include "stella_vslam/data/memory_usage.h"
+#include "stella_vslam/data/observation_encoding.h"
+#include "stella_vslam/data/slot_table.h"
+#include "stella_vslam/util/lock_profiler.h"
+#include "stella_vslam/util/shared_mutex.h"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
 #include <mutex>
 #include <vector>
 #include <unordered_map>
+#include <unordered_set>
 #include <memory>
 
 #include <nlohmann/json_fwd.hpp>
@@ -19,6 +28,10 @@ namespace camera {
 class base;
 } // namespace camera
 
+namespace util {
+class async_reclaimer;
+} // namespace util
+
 namespace data {
 
 class frame;
@@ -28,6 +41,9 @@ class marker;
 class camera_database;
 class orb_params_database;
 class bow_database;
+class keyframe_spatial_index;
+class map_change_journal;
+class landmark_descriptor_index;
 
 class map_database {
 public:
@@ -59,6 +75,13 @@ public:
      */
     std::shared_ptr<keyframe> get_keyframe(unsigned int id) const;
 
+    /**
+     * Get keyframe from the database by the handle, without the reference counting
+     * (NOTE: nullptr if the keyframe is erased. The pointer is valid while the keyframe is held by the database)
+     * @param handle
+     */
+    keyframe* get_keyframe(const slot_handle handle) const;
+
     /**
      * Add landmark to the database
      * @param lm
@@ -71,12 +94,25 @@ public:
      */
     void erase_landmark(unsigned int id);
 
+    /**
+     * Erase landmarks from the database at once
+     * @param ids
+     */
+    void erase_landmarks(const std::vector<unsigned int>& ids);
+
     /**
      * Get landmark from the database
      * @param id
      */
     std::shared_ptr<landmark> get_landmark(unsigned int id) const;
 
+    /**
+     * Get landmark from the database by the handle, without the reference counting
+     * (NOTE: nullptr if the landmark is erased. The pointer is valid while the landmark is held by the database)
+     * @param handle
+     */
+    landmark* get_landmark(const slot_handle handle) const;
+
     /**
      * Add marker to the database
      * @param mkr
@@ -101,6 +137,65 @@ public:
      */
     std::vector<std::shared_ptr<landmark>> get_local_landmarks() const;
 
+    /**
+     * Get local landmarks without copying them
+     * (NOTE: the snapshot is immutable and is replaced as a whole by set_local_landmarks())
+     * @return
+     */
+    std::shared_ptr<const std::vector<std::shared_ptr<landmark>>> get_local_landmarks_snapshot() const;
+
+    /**
+     * Get the version of the database, which is incremented whenever keyframes, landmarks, markers or spanning roots are added or erased
+     * @return
+     */
+    uint64_t get_version() const { return version_; }
+
+    /**
+     * Get the journal of the additions, the updates and the erasures of the keyframes and the landmarks
+     * (NOTE: the journal is reset when the map is cleared, loaded, or a new spanning root is added)
+     * @return
+     */
+    std::shared_ptr<const map_change_journal> get_change_journal() const { return change_journal_; }
+
+    /**
+     * Get the multi-index hash of the representative descriptors of the landmarks
+     * (NOTE: the index may still contain the landmarks which are being erased, so verify them with get_landmark())
+     * @return
+     */
+    std::shared_ptr<const landmark_descriptor_index> get_landmark_descriptor_index() const { return lm_descriptor_index_; }
+
+    /**
+     * Get all of the keyframes in the database as an immutable snapshot
+     * (NOTE: the snapshot is shared between the callers until the version is changed)
+     * @return
+     */
+    std::shared_ptr<const std::vector<std::shared_ptr<keyframe>>> get_all_keyframes_snapshot() const;
+
+    /**
+     * Get all of the landmarks in the database as an immutable snapshot
+     * (NOTE: the snapshot is shared between the callers until the version is changed)
+     * @return
+     */
+    std::shared_ptr<const std::vector<std::shared_ptr<landmark>>> get_all_landmarks_snapshot() const;
+
+    /**
+     * Visit all of the keyframes in the database without copying them
+     * (NOTE: the database is locked in shared mode during the visit, so DO NOT call the other methods of map_database in func.
+     *  The shared lock is not recursive, then a re-entrant call blocks forever if a writer is waiting meanwhile.
+     *  This is asserted in the debug build.)
+     * @param func
+     */
+    void for_each_keyframe(const std::function<void(const std::shared_ptr<keyframe>&)>& func) const;
+
+    /**
+     * Visit all of the landmarks in the database without copying them
+     * (NOTE: the database is locked in shared mode during the visit, so DO NOT call the other methods of map_database in func.
+     *  The shared lock is not recursive, then a re-entrant call blocks forever if a writer is waiting meanwhile.
+     *  This is asserted in the debug build.)
+     * @param func
+     */
+    void for_each_landmark(const std::function<void(const std::shared_ptr<landmark>&)>& func) const;
+
     /**
      * Get all of the keyframes in the database
      * NOTE: Access multiple spanning trees. Used only to read and write databases.
@@ -178,12 +273,25 @@ public:
      */
     std::vector<std::shared_ptr<keyframe>> get_spanning_roots();
 
+    /**
+     * Erase spanning root (used when the spanning tree is merged into another one)
+     */
+    void erase_spanning_root(const std::shared_ptr<keyframe>& keyframe);
+
     /**
      * Get the number of landmarks
      * @return
      */
     unsigned int get_num_landmarks() const;
 
+    /**
+     * Get the estimated memory usage of the keyframes, the landmarks, the containers of the database and the frame statistics
+     * (NOTE: the keyframes and the landmarks are counted incrementally by themselves (see memory_counter),
+     *  so all of them alive in the process are included. The BoW database and the optimizers are not included)
+     * @return
+     */
+    memory_usage get_memory_usage() const;
+
     /**
      * Get minimum threshold for covisibility graph connection
      * @return minimum threshold for covisibility graph connection
@@ -196,8 +304,13 @@ public:
      * @param is_lost
      */
     void update_frame_statistics(const data::frame& frm, const bool is_lost) {
-        std::lock_guard<std::mutex> lock(mtx_map_access_);
-        frm_stats_.update_frame_statistics(frm, is_lost);
+        std::lock_guard<std::mutex> lock(mtx_frm_stats_);
+        if (record_frm_stats_) {
+            frm_stats_.update_frame_statistics(frm, is_lost);
+        }
+        if (frm_stats_observer_) {
+            frm_stats_observer_->on_frame_tracked(frm, is_lost);
+        }
     }
 
     /**
@@ -206,8 +319,33 @@ public:
      * @param new_keyfrm
      */
     void replace_reference_keyframe(const std::shared_ptr<data::keyframe>& old_keyfrm, const std::shared_ptr<data::keyframe>& new_keyfrm) {
-        std::lock_guard<std::mutex> lock(mtx_map_access_);
+        std::lock_guard<std::mutex> lock(mtx_frm_stats_);
         frm_stats_.replace_reference_keyframe(old_keyfrm, new_keyfrm);
+        if (frm_stats_observer_) {
+            frm_stats_observer_->on_reference_keyframe_replaced(old_keyfrm, new_keyfrm);
+        }
+    }
+
+    /**
+     * Bound the number of the frames recorded in the frame statistics (the recorded frames are cleared)
+     * @param max_num_frames maximum number of the recorded frames (0 means unlimited)
+     * @param decimation every decimation-th frame is recorded (1 means all the frames)
+     */
+    void set_frame_statistics_limits(const unsigned int max_num_frames, const unsigned int decimation) {
+        std::lock_guard<std::mutex> lock(mtx_frm_stats_);
+        frm_stats_ = frame_statistics(max_num_frames, decimation);
+    }
+
+    /**
+     * Set the observer of the frame statistics
+     * @param observer observer notified of each update (nullptr to remove)
+     * @param record_frame_statistics if false, the frame statistics are not accumulated in memory
+     *                                (then the frame trajectory cannot be dumped by io::trajectory_io)
+     */
+    void set_frame_statistics_observer(const std::shared_ptr<frame_statistics_observer>& observer, const bool record_frame_statistics) {
+        std::lock_guard<std::mutex> lock(mtx_frm_stats_);
+        frm_stats_observer_ = observer;
+        record_frm_stats_ = record_frame_statistics;
     }
 
     /**
@@ -215,15 +353,22 @@ public:
      * @return
      */
     frame_statistics get_frame_statistics() const {
-        std::lock_guard<std::mutex> lock(mtx_map_access_);
+        std::lock_guard<std::mutex> lock(mtx_frm_stats_);
         return frm_stats_;
     }
 
     /**
      * Clear the database
+     * (NOTE: the keyframes, the landmarks and the markers are destroyed on the reclaimer if set)
      */
     void clear();
 
+    /**
+     * Set the reclaimer which destroys the objects of the cleared map in the background (destroyed in clear() if nullptr)
+     * @param reclaimer
+     */
+    void set_reclaimer(const std::shared_ptr<util::async_reclaimer>& reclaimer);
+
     /**
      * Load keyframes and landmarks from JSON
      * @param cam_db
@@ -239,8 +384,10 @@ public:
      * Dump keyframes and landmarks as JSON
      * @param json_keyfrms
      * @param json_landmarks
+     * @param encoding encoding of the keypoints, the descriptors and the stereo observations of the keyframes
      */
-    void to_json(nlohmann::json& json_keyfrms, nlohmann::json& json_landmarks) const;
+    void to_json(nlohmann::json& json_keyfrms, nlohmann::json& json_landmarks,
+                 const observation_encoding_t encoding = observation_encoding_t::Json) const;
 
     /**
      * Load keyframes and landmarks from database
@@ -252,12 +399,44 @@ public:
 
     /**
      * Dump keyframes and landmarks to database
+     * (NOTE: the caller must begin and commit the transaction)
+     * @param db
+     * @param incremental if true, only the keyframes and the landmarks modified at or after modified_since_epoch are written
+     *                    and the erased ones are deleted, instead of recreating the tables
+     * @param modified_since_epoch
+     */
+    bool to_db(sqlite3* db, const bool incremental = false, const unsigned int modified_since_epoch = 0) const;
+
+    /**
+     * Copy the keyframes, the landmarks and the spanning tree into a new database, which can be saved without blocking the SLAM threads
+     * (NOTE: mtx_database_ must be locked. The descriptors are shared with the original keyframes since they are immutable.
+     *  The BoW, the covisibility graph, the landmark observations and the markers are not copied, which are not saved.)
+     */
+    std::shared_ptr<map_database> create_snapshot() const;
+
+    /**
+     * Advance save_epoch_ and return the epoch which the saved keyframes and landmarks belong to
+     * (NOTE: a snapshot returns the epoch when it was taken, since the objects modified after that are not contained)
      */
-    bool to_db(sqlite3* db) const;
+    unsigned int advance_save_epoch() const;
+
+    /**
+     * Register the keyframes and the landmarks decoded by a map_database_io backend
+     * (NOTE: the spanning tree, the loop edges and the keyframe-landmark associations must be set beforehand.
+     *  The spanning roots, the covisibility graph and the landmark geometry are updated here.)
+     * @param keyfrms
+     * @param lms
+     */
+    void register_loaded_map(const std::vector<std::shared_ptr<keyframe>>& keyfrms,
+                             const std::vector<std::shared_ptr<landmark>>& lms);
 
     //! mutex for locking ALL access to the database
     //! (NOTE: cannot used in map_database class)
-    static std::mutex mtx_database_;
+    static util::profiled_mutex mtx_database_;
+
+    //! epoch of the map saving, which is advanced by each save
+    //! (NOTE: the keyframes and the landmarks record the epoch of their last modification for the incremental saving)
+    static std::atomic<unsigned int> save_epoch_;
 
     //! next ID
     std::atomic<unsigned int> next_keyframe_id_{0};
@@ -265,24 +444,33 @@ public:
 
 private:
     /**
-     * Decode JSON and register keyframe information to the map database
-     * (NOTE: objects which are not constructed yet will be set as nullptr)
+     * Get the keyframes which are registered in the database
+     * @param keyfrm_ids
+     * @return keyframes (the IDs which are not registered are skipped)
+     */
+    std::vector<std::shared_ptr<keyframe>> get_keyframes_by_ids(const std::vector<unsigned int>& keyfrm_ids) const;
+
+    /**
+     * Decode JSON of a keyframe
+     * (NOTE: the keyframe is not registered to the database, and this function can be called in parallel)
      * @param cam_db
      * @param orb_params_db
      * @param bow_vocab
      * @param id
      * @param json_keyfrm
+     * @return keyframe whose graph and landmarks are not set yet
      */
-    void register_keyframe(camera_database* cam_db, orb_params_database* orb_params_db, bow_vocabulary* bow_vocab,
-                           const unsigned int id, const nlohmann::json& json_keyfrm);
+    std::shared_ptr<keyframe> decode_keyframe(camera_database* cam_db, orb_params_database* orb_params_db, bow_vocabulary* bow_vocab,
+                                              const unsigned int id, const nlohmann::json& json_keyfrm) const;
 
     /**
      * Decode JSON and register landmark information to the map database
      * (NOTE: objects which are not constructed yet will be set as nullptr)
      * @param id
      * @param json_landmark
+     * @return registered landmark
      */
-    void register_landmark(const unsigned int id, const nlohmann::json& json_landmark);
+    std::shared_ptr<landmark> register_landmark(const unsigned int id, const nlohmann::json& json_landmark);
 
     /**
      * Decode JSON and register essential graph information
@@ -304,12 +492,16 @@ private:
                                 const std::string& table_name,
                                 camera_database* cam_db,
                                 orb_params_database* orb_params_db,
-                                bow_vocabulary* bow_vocab);
-    bool load_landmarks_from_db(sqlite3* db, const std::string& table_name);
+                                bow_vocabulary* bow_vocab,
+                                std::vector<std::shared_ptr<keyframe>>& keyfrms);
+    bool load_landmarks_from_db(sqlite3* db, const std::string& table_name,
+                                std::vector<std::shared_ptr<landmark>>& lms);
     void load_association_from_stmt(sqlite3_stmt* stmt);
     bool load_associations_from_db(sqlite3* db, const std::string& table_name);
-    bool save_keyframes_to_db(sqlite3* db, const std::string& table_name) const;
-    bool save_landmarks_to_db(sqlite3* db, const std::string& table_name) const;
+    bool save_keyframes_to_db(sqlite3* db, const std::string& table_name,
+                              const std::vector<std::shared_ptr<keyframe>>& keyfrms) const;
+    bool save_landmarks_to_db(sqlite3* db, const std::string& table_name,
+                              const std::vector<std::shared_ptr<landmark>>& lms) const;
     static std::vector<std::pair<std::string, std::string>> association_columns() {
         return std::vector<std::pair<std::string, std::string>>{
             {"lm_ids", "BLOB"},
@@ -319,20 +511,63 @@ private:
             {"n_loop_edges", "INTEGER"},
             {"loop_edges", "BLOB"}};
     };
-    bool bind_association_to_stmt(sqlite3_stmt* stmt,
-                                  const std::shared_ptr<keyframe>& keyfrm) const;
-    bool save_associations_to_db(sqlite3* db, const std::string& table_name) const;
+    /**
+     * Find the spanning roots, and update the covisibility graph and the landmark geometry of the loaded objects
+     * (NOTE: mtx_map_access_ must be locked. The landmark geometry is updated in parallel when built with USE_OPENMP.)
+     * @param keyfrms
+     * @param lms
+     */
+    void update_loaded_map(const std::vector<std::shared_ptr<keyframe>>& keyfrms,
+                           const std::vector<std::shared_ptr<landmark>>& lms);
+
+    //! Row of the association table
+    struct association {
+        unsigned int keyfrm_id_;
+        std::vector<int> lm_ids_;
+        int64_t spanning_parent_id_;
+        std::vector<int> spanning_child_ids_;
+        std::vector<int> loop_edge_ids_;
+    };
+    static association encode_association(const std::shared_ptr<keyframe>& keyfrm);
+    bool bind_association_to_stmt(sqlite3_stmt* stmt, const association& assoc) const;
+    bool save_associations_to_db(sqlite3* db, const std::string& table_name,
+                                 const std::vector<std::shared_ptr<keyframe>>& keyfrms) const;
+    //! Delete the rows whose IDs are not in ids_to_keep
+    bool delete_erased_rows_from_db(sqlite3* db, const std::string& table_name,
+                                    const std::unordered_set<unsigned int>& ids_to_keep) const;
+
+    //! Containers swapped out by clear(), whose objects are destroyed together
+    struct cleared_objects {
+        std::unordered_map<unsigned int, std::shared_ptr<keyframe>> keyframes_;
+        std::unordered_map<unsigned int, std::shared_ptr<landmark>> landmarks_;
+        std::unordered_map<unsigned int, std::shared_ptr<marker>> markers_;
+        std::vector<std::shared_ptr<keyframe>> spanning_roots_;
+        std::shared_ptr<keyframe> last_inserted_keyfrm_;
+        std::shared_ptr<const std::vector<std::shared_ptr<keyframe>>> keyfrms_snapshot_;
+        std::shared_ptr<const std::vector<std::shared_ptr<landmark>>> lms_snapshot_;
+        std::shared_ptr<const std::vector<std::shared_ptr<landmark>>> local_landmarks_;
+    };
 
-    //! mutex for mutual exclusion controll between class methods
-    mutable std::mutex mtx_map_access_;
+    //! reader-writer lock for the keyframes, landmarks, markers and spanning roots
+    //! (the getters take the shared lock, the methods which modify them take the exclusive lock)
+    mutable util::profiled_shared_mutex mtx_map_access_{"map_database::mtx_map_access_"};
 
     //-----------------------------------------
     // keyframe and landmark database
 
     //! IDs and keyframes
     std::unordered_map<unsigned int, std::shared_ptr<keyframe>> keyframes_;
+    //! spatial index of the camera centers of the keyframes (updated by the keyframes themselves)
+    std::shared_ptr<keyframe_spatial_index> keyfrm_spatial_index_;
+    //! journal of the changes of the keyframes and the landmarks (updated by the keyframes and landmarks themselves)
+    std::shared_ptr<map_change_journal> change_journal_;
+    //! multi-index hash of the descriptors of the landmarks (updated by the landmarks themselves)
+    std::shared_ptr<landmark_descriptor_index> lm_descriptor_index_;
     //! IDs and landmarks
     std::unordered_map<unsigned int, std::shared_ptr<landmark>> landmarks_;
+    //! dense tables of the keyframes and the landmarks referred by their handles (keyframe::handle_, landmark::handle_)
+    slot_table<keyframe> keyfrm_slots_;
+    slot_table<landmark> lm_slots_;
     //! IDs and markers
     std::unordered_map<unsigned int, std::shared_ptr<marker>> markers_;
 
@@ -342,8 +577,22 @@ private:
     //! The last keyframe added to the database
     std::shared_ptr<keyframe> last_inserted_keyfrm_ = nullptr;
 
-    //! local landmarks
-    std::vector<std::shared_ptr<landmark>> local_landmarks_;
+    //! incremented whenever the members guarded by mtx_map_access_ are added or erased
+    std::atomic<uint64_t> version_{0};
+
+    //! mutex for the cached snapshots (NOTE: lock mtx_map_access_ first)
+    mutable std::mutex mtx_snapshots_;
+    //! cached snapshot of all of the keyframes and its version
+    mutable std::shared_ptr<const std::vector<std::shared_ptr<keyframe>>> keyfrms_snapshot_;
+    mutable uint64_t keyfrms_snapshot_version_ = 0;
+    //! cached snapshot of all of the landmarks and its version
+    mutable std::shared_ptr<const std::vector<std::shared_ptr<landmark>>> lms_snapshot_;
+    mutable uint64_t lms_snapshot_version_ = 0;
+
+    //! mutex for local_landmarks_ (separated from mtx_map_access_ because they are replaced every frame)
+    mutable std::mutex mtx_local_lms_;
+    //! local landmarks (immutable snapshot)
+    std::shared_ptr<const std::vector<std::shared_ptr<landmark>>> local_landmarks_;
 
     //-----------------------------------------
     // parameters for global/local mapping (optimization)
@@ -351,11 +600,23 @@ private:
     //! minimum threshold for covisibility graph connection
     const unsigned int min_num_shared_lms_ = 15;
 
+    //! save epoch when this snapshot was taken (-1 if this is not a snapshot)
+    int64_t snapshot_epoch_ = -1;
+
     //-----------------------------------------
     // frame statistics for odometry evaluation
 
+    //! mutex for frm_stats_ (separated from mtx_map_access_ because they are updated every frame)
+    mutable std::mutex mtx_frm_stats_;
     //! frame statistics
     frame_statistics frm_stats_;
+    //! accumulate the frame statistics or not
+    bool record_frm_stats_ = true;
+    //! observer of the frame statistics
+    std::shared_ptr<frame_statistics_observer> frm_stats_observer_ = nullptr;
+
+    //! reclaimer of the objects of the cleared map (nullptr if they are destroyed in clear())
+    std::shared_ptr<util::async_reclaimer> reclaimer_ = nullptr;
 };
 
 } // namespace data
@@ -0,0 +1,19 @@
+#include "stella_vslam/data/memory_usage.h"
+
+namespace stella_vslam {
+namespace data {
+
+std::array<std::atomic<int64_t>, num_memory_categories>& memory_counter::get_counters() {
+    // (NOTE: intentionally leaked so that it outlives the objects released during the static destruction)
+    static auto* counters = [] {
+        auto* counters = new std::array<std::atomic<int64_t>, num_memory_categories>();
+        for (auto& counter : *counters) {
+            counter = 0;
+        }
+        return counters;
+    }();
+    return *counters;
+}
+
+} // namespace data
+} // namespace stella_vslam
@@ -0,0 +1,133 @@
+#ifndef STELLA_VSLAM_DATA_MEMORY_USAGE_H
+#define STELLA_VSLAM_DATA_MEMORY_USAGE_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace stella_vslam {
+namespace data {
+
+//! Category of the memory counted by memory_counter
+enum class memory_category_t : unsigned int {
+    //! descriptors of the keyframes (including the compact representation, excluding the paged ones)
+    KeyframeDescriptors = 0,
+    //! keypoints, bearings, depths and stereo coordinates of the keyframes
+    KeyframeKeypoints = 1,
+    //! keypoint grids of the keyframes
+    KeyframeGrids = 2,
+    //! BoW vectors and BoW feature vectors of the keyframes
+    KeyframeBoW = 3,
+    //! keyframe objects and their landmark associations
+    KeyframeObjects = 4,
+    //! landmark objects and their descriptors
+    LandmarkObjects = 5,
+    //! observation maps of the landmarks
+    LandmarkObservations = 6
+};
+
+//! Number of the categories
+constexpr unsigned int num_memory_categories = 7;
+
+/**
+ * Live bytes of the keyframes and the landmarks in the process by category
+ * (the objects add the differences of their estimates on each change, so reading the counters is O(1))
+ */
+class memory_counter {
+public:
+    //! Add the difference of the bytes to the category
+    static void add(const memory_category_t category, const int64_t bytes) {
+        get_counters()[static_cast<unsigned int>(category)].fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    //! Get the live bytes of the category
+    static size_t get(const memory_category_t category) {
+        const auto bytes = get_counters()[static_cast<unsigned int>(category)].load(std::memory_order_relaxed);
+        return bytes < 0 ? 0 : static_cast<size_t>(bytes);
+    }
+
+private:
+    static std::array<std::atomic<int64_t>, num_memory_categories>& get_counters();
+};
+
+/**
+ * Bytes accounted to memory_counter by an object, whose changes are added to the counters
+ * (NOTE: not thread-safe, the owner must serialize the updates)
+ */
+class memory_account {
+public:
+    memory_account() {
+        bytes_.fill(0);
+    }
+
+    ~memory_account() {
+        for (unsigned int idx = 0; idx < num_memory_categories; ++idx) {
+            if (bytes_[idx] != 0) {
+                memory_counter::add(static_cast<memory_category_t>(idx), -bytes_[idx]);
+            }
+        }
+    }
+
+    memory_account(const memory_account&) = delete;
+    memory_account& operator=(const memory_account&) = delete;
+
+    //! Set the bytes of the category
+    void set(const memory_category_t category, const size_t bytes) {
+        auto& accounted = bytes_[static_cast<unsigned int>(category)];
+        const auto diff = static_cast<int64_t>(bytes) - accounted;
+        if (diff != 0) {
+            memory_counter::add(category, diff);
+            accounted = static_cast<int64_t>(bytes);
+        }
+    }
+
+private:
+    std::array<int64_t, num_memory_categories> bytes_;
+};
+
+/**
+ * Estimated memory usage of the map and the runtime structures [bytes]
+ * (the estimates count the capacities of the containers and the sizes of the objects, not the allocator overheads)
+ */
+struct memory_usage {
+    //! descriptors of the keyframes
+    size_t keyfrm_descriptors_ = 0;
+    //! keypoints of the keyframes
+    size_t keyfrm_keypoints_ = 0;
+    //! keypoint grids of the keyframes
+    size_t keyfrm_grids_ = 0;
+    //! BoW vectors of the keyframes
+    size_t keyfrm_bow_vectors_ = 0;
+    //! keyframe objects
+    size_t keyfrm_objects_ = 0;
+    //! landmark objects
+    size_t lm_objects_ = 0;
+    //! observation maps of the landmarks
+    size_t lm_observations_ = 0;
+    //! containers of the map database (hash maps and spatial indices)
+    size_t map_database_ = 0;
+    //! inverted index of the BoW database
+    size_t bow_database_ = 0;
+    //! frame statistics
+    size_t frame_statistics_ = 0;
+    //! scratch space of the local BA
+    size_t optimizer_scratch_ = 0;
+
+    //! Sum of all of the structures
+    size_t total() const {
+        return keyfrm_descriptors_ + keyfrm_keypoints_ + keyfrm_grids_ + keyfrm_bow_vectors_ + keyfrm_objects_
+               + lm_objects_ + lm_observations_ + map_database_ + bow_database_ + frame_statistics_ + optimizer_scratch_;
+    }
+};
+
+//! Estimated bytes of a node of std::map or std::unordered_map (pointers and the value)
+template<typename Value>
+constexpr size_t get_node_bytes() {
+    return sizeof(Value) + 3 * sizeof(void*);
+}
+
+} // namespace data
+} // namespace stella_vslam
+
+#endif // STELLA_VSLAM_DATA_MEMORY_USAGE_H
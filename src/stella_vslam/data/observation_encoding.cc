@@ -0,0 +1,23 @@
+#include "stella_vslam/data/observation_encoding.h"
+#include "stella_vslam/util/blob_codec.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace stella_vslam {
+namespace data {
+
+observation_encoding_t load_observation_encoding(const std::string& observation_encoding_str) {
+    const auto itr = std::find(observation_encoding_to_string.begin(), observation_encoding_to_string.end(), observation_encoding_str);
+    if (itr == observation_encoding_to_string.end()) {
+        throw std::runtime_error("Invalid observation encoding: " + observation_encoding_str);
+    }
+    const auto observation_encoding = static_cast<observation_encoding_t>(std::distance(observation_encoding_to_string.begin(), itr));
+    if (observation_encoding == observation_encoding_t::Compressed && !util::blob_codec::compression_is_available()) {
+        throw std::runtime_error("Observation encoding compressed is not available (build with USE_ZLIB)");
+    }
+    return observation_encoding;
+}
+
+} // namespace data
+} // namespace stella_vslam
@@ -0,0 +1,31 @@
+#ifndef STELLA_VSLAM_DATA_OBSERVATION_ENCODING_H
+#define STELLA_VSLAM_DATA_OBSERVATION_ENCODING_H
+
+#include <array>
+#include <string>
+
+namespace stella_vslam {
+namespace data {
+
+/**
+ * Encoding of the keypoints, the descriptors and the stereo observations of the keyframes in the MessagePack map
+ * (NOTE: the decoder accepts all the encodings, so the maps saved with any encoding can be loaded)
+ */
+enum class observation_encoding_t {
+    //! element-wise JSON arrays
+    Json = 0,
+    //! packed blobs (quantized keypoints and raw descriptors)
+    Compact = 1,
+    //! packed blobs compressed by zlib (available only when built with USE_ZLIB)
+    Compressed = 2
+};
+
+const std::array<std::string, 3> observation_encoding_to_string = {{"json", "compact", "compressed"}};
+
+//! Load the observation encoding from the string (throw std::runtime_error if invalid or unavailable)
+observation_encoding_t load_observation_encoding(const std::string& observation_encoding_str);
+
+} // namespace data
+} // namespace stella_vslam
+
+#endif // STELLA_VSLAM_DATA_OBSERVATION_ENCODING_H
@@ -0,0 +1,126 @@
+#ifndef STELLA_VSLAM_DATA_SLOT_TABLE_H
+#define STELLA_VSLAM_DATA_SLOT_TABLE_H
+
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+namespace stella_vslam {
+namespace data {
+
+/**
+ * Compact reference to an element of slot_table
+ * (the lower bits are the index of the slot and the upper bits are the generation of the slot)
+ */
+struct slot_handle {
+    static constexpr unsigned int num_index_bits = 24;
+    static constexpr uint32_t index_mask = (1u << num_index_bits) - 1;
+    static constexpr uint32_t invalid_value = ~static_cast<uint32_t>(0);
+
+    slot_handle() = default;
+    slot_handle(const uint32_t index, const uint8_t generation)
+        : value_((static_cast<uint32_t>(generation) << num_index_bits) | index) {}
+
+    uint32_t index() const { return value_ & index_mask; }
+    uint8_t generation() const { return static_cast<uint8_t>(value_ >> num_index_bits); }
+    bool is_valid() const { return value_ != invalid_value; }
+
+    bool operator==(const slot_handle& handle) const { return value_ == handle.value_; }
+    bool operator!=(const slot_handle& handle) const { return value_ != handle.value_; }
+
+    uint32_t value_ = invalid_value;
+};
+
+/**
+ * Dense table of the non-owning pointers which are referred by the generational handles
+ * (NOTE: the slots of the erased elements are reused, and the handles of them are invalidated by advancing the generation.
+ *  The generation wraps around after 256 reuses of a slot, so the handles should not be kept for long.)
+ * This is not thread-safe, so guard it with the lock of the owner.
+ */
+template<typename T>
+class slot_table {
+public:
+    //! Insert the element and get its handle
+    slot_handle insert(T* elem) {
+        uint32_t index;
+        if (free_indices_.empty()) {
+            if (slot_handle::index_mask <= slots_.size()) {
+                throw std::runtime_error("slot_table: the number of the slots exceeds the limit");
+            }
+            index = static_cast<uint32_t>(slots_.size());
+            slots_.emplace_back();
+        }
+        else {
+            index = free_indices_.back();
+            free_indices_.pop_back();
+        }
+        auto& slot = slots_[index];
+        slot.elem_ = elem;
+        ++num_elems_;
+        return slot_handle(index, slot.generation_);
+    }
+
+    //! Erase the element (return false if the handle is invalid)
+    bool erase(const slot_handle handle) {
+        if (!get(handle)) {
+            return false;
+        }
+        auto& slot = slots_[handle.index()];
+        slot.elem_ = nullptr;
+        ++slot.generation_;
+        free_indices_.push_back(handle.index());
+        --num_elems_;
+        return true;
+    }
+
+    //! Get the element (nullptr if the handle is invalid or the element is erased)
+    T* get(const slot_handle handle) const {
+        if (!handle.is_valid() || slots_.size() <= handle.index()) {
+            return nullptr;
+        }
+        const auto& slot = slots_[handle.index()];
+        return slot.generation_ == handle.generation() ? slot.elem_ : nullptr;
+    }
+
+    //! Erase all of the elements (the handles issued so far are invalidated)
+    void clear() {
+        free_indices_.clear();
+        for (uint32_t index = 0; index < slots_.size(); ++index) {
+            auto& slot = slots_[index];
+            if (slot.elem_) {
+                slot.elem_ = nullptr;
+                ++slot.generation_;
+            }
+            free_indices_.push_back(index);
+        }
+        num_elems_ = 0;
+    }
+
+    //! Number of the elements
+    size_t size() const {
+        return num_elems_;
+    }
+
+    //! Bytes of the slots
+    size_t get_memory_bytes() const {
+        return slots_.capacity() * sizeof(slot) + free_indices_.capacity() * sizeof(uint32_t);
+    }
+
+private:
+    struct slot {
+        T* elem_ = nullptr;
+        uint8_t generation_ = 0;
+    };
+
+    //! slots indexed by the handles
+    std::vector<slot> slots_;
+    //! indices of the empty slots
+    std::vector<uint32_t> free_indices_;
+    //! number of the elements
+    size_t num_elems_ = 0;
+};
+
+} // namespace data
+} // namespace stella_vslam
+
+#endif // STELLA_VSLAM_DATA_SLOT_TABLE_H
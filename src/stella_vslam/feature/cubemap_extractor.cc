@@ -0,0 +1,203 @@
+#include "stella_vslam/feature/cubemap_extractor.h"
+#include "stella_vslam/feature/orb_extractor.h"
+#include "stella_vslam/util/thread_pool.h"
+
+#include <cmath>
+#include <future>
+#include <stdexcept>
+
+#include <opencv2/imgproc.hpp>
+
+namespace stella_vslam {
+namespace feature {
+
+cubemap_extractor::cubemap_extractor(const orb_params* orb_params, const unsigned int min_size, const unsigned int num_faces,
+                                     const unsigned int face_size, const double face_fov_deg)
+    : face_size_(face_size), face_fov_(face_fov_deg * M_PI / 180.0) {
+    if (num_faces != 6 && num_faces != 4) {
+        throw std::runtime_error("the number of the faces of the cube map must be 6 or 4");
+    }
+    if (face_fov_deg < 90.0 || 150.0 < face_fov_deg) {
+        throw std::runtime_error("the field of view of the faces of the cube map must be in 90-150 deg");
+    }
+
+    // the columns are the x, y and z axes of the faces in the equirectangular camera
+    // (x: right, y: down, z: forward, which is the center of the equirectangular image)
+    const auto face_rot = [](const Vec3_t& x_axis, const Vec3_t& y_axis, const Vec3_t& z_axis) {
+        Mat33_t rot_cf;
+        rot_cf << x_axis, y_axis, z_axis;
+        return rot_cf;
+    };
+    // front, right, back and left
+    rots_cf_.push_back(face_rot(Vec3_t::UnitX(), Vec3_t::UnitY(), Vec3_t::UnitZ()));
+    rots_cf_.push_back(face_rot(-Vec3_t::UnitZ(), Vec3_t::UnitY(), Vec3_t::UnitX()));
+    rots_cf_.push_back(face_rot(-Vec3_t::UnitX(), Vec3_t::UnitY(), -Vec3_t::UnitZ()));
+    rots_cf_.push_back(face_rot(Vec3_t::UnitZ(), Vec3_t::UnitY(), -Vec3_t::UnitX()));
+    if (num_faces == 6) {
+        // top and bottom
+        rots_cf_.push_back(face_rot(Vec3_t::UnitX(), Vec3_t::UnitZ(), -Vec3_t::UnitY()));
+        rots_cf_.push_back(face_rot(Vec3_t::UnitX(), -Vec3_t::UnitZ(), Vec3_t::UnitY()));
+    }
+
+    for (unsigned int i = 0; i < num_faces; ++i) {
+        face_extractors_.emplace_back(new orb_extractor(orb_params, min_size));
+    }
+    face_images_.resize(num_faces);
+    face_masks_.resize(num_faces);
+    face_keypts_.resize(num_faces);
+    face_descriptors_.resize(num_faces);
+    maps_1_.resize(num_faces);
+    maps_2_.resize(num_faces);
+
+    pool_.reset(new util::thread_pool(num_faces - 1));
+}
+
+cubemap_extractor::~cubemap_extractor() = default;
+
+void cubemap_extractor::create_maps(const unsigned int cols, const unsigned int rows) {
+    cols_ = cols;
+    rows_ = rows;
+    if (face_size_ == 0) {
+        face_focal_ = cols / 8.0;
+        face_size_ = static_cast<unsigned int>(std::ceil(2.0 * face_focal_ * std::tan(face_fov_ / 2.0)));
+    }
+    else {
+        face_focal_ = face_size_ / (2.0 * std::tan(face_fov_ / 2.0));
+    }
+
+    for (unsigned int face_idx = 0; face_idx < get_num_faces(); ++face_idx) {
+        cv::Mat map_x(face_size_, face_size_, CV_32FC1);
+        cv::Mat map_y(face_size_, face_size_, CV_32FC1);
+        for (unsigned int y = 0; y < face_size_; ++y) {
+            auto map_x_row = map_x.ptr<float>(y);
+            auto map_y_row = map_y.ptr<float>(y);
+            for (unsigned int x = 0; x < face_size_; ++x) {
+                const auto pt = map_to_equirectangular(face_idx, cv::Point2f(x, y));
+                map_x_row[x] = pt.x;
+                map_y_row[x] = pt.y;
+            }
+        }
+        // (the fixed-point maps are faster to remap)
+        cv::convertMaps(map_x, map_y, maps_1_.at(face_idx), maps_2_.at(face_idx), CV_16SC2);
+    }
+}
+
+Vec3_t cubemap_extractor::compute_bearing(const unsigned int face_idx, const cv::Point2f& pt) const {
+    const double center = face_size_ / 2.0;
+    const Vec3_t ray_f{(pt.x - center) / face_focal_, (pt.y - center) / face_focal_, 1.0};
+    return (rots_cf_.at(face_idx) * ray_f).normalized();
+}
+
+cv::Point2f cubemap_extractor::map_to_equirectangular(const unsigned int face_idx, const cv::Point2f& pt) const {
+    // as camera::equirectangular::convert_bearing_to_point()
+    const Vec3_t bearing = compute_bearing(face_idx, pt);
+    const double lat = -std::atan2(bearing(1), std::sqrt(bearing(0) * bearing(0) + bearing(2) * bearing(2)));
+    const double lon = std::atan2(bearing(0), bearing(2));
+    return cv::Point2f(cols_ * (0.5 + lon / (2.0 * M_PI)), rows_ * (0.5 - lat / M_PI));
+}
+
+void cubemap_extractor::extract(const cv::Mat& image, const cv::Mat& mask,
+                                std::vector<cv::KeyPoint>& keypts, const cv::_OutputArray& out_descriptors) {
+    if (image.cols != static_cast<int>(cols_) || image.rows != static_cast<int>(rows_)) {
+        create_maps(image.cols, image.rows);
+    }
+
+    // the first face is extracted on this thread
+    std::vector<std::future<void>> futures;
+    for (unsigned int face_idx = 1; face_idx < get_num_faces(); ++face_idx) {
+        futures.push_back(pool_->submit([this, face_idx, &image, &mask] {
+            extract_on_face(face_idx, image, mask);
+        }));
+    }
+    extract_on_face(0, image, mask);
+    for (auto& future : futures) {
+        pool_->wait(future);
+        future.get();
+    }
+
+    // concatenate the keypoints of the faces
+    unsigned int num_keypts = 0;
+    for (const auto& keypts_on_face : face_keypts_) {
+        num_keypts += keypts_on_face.size();
+    }
+    keypts.clear();
+    keypts.reserve(num_keypts);
+    if (num_keypts == 0) {
+        out_descriptors.release();
+        return;
+    }
+    out_descriptors.create(num_keypts, 32, CV_8U);
+    cv::Mat descriptors = out_descriptors.getMat();
+    for (unsigned int face_idx = 0; face_idx < get_num_faces(); ++face_idx) {
+        const auto& keypts_on_face = face_keypts_.at(face_idx);
+        if (keypts_on_face.empty()) {
+            continue;
+        }
+        face_descriptors_.at(face_idx).copyTo(descriptors.rowRange(keypts.size(), keypts.size() + keypts_on_face.size()));
+        keypts.insert(keypts.end(), keypts_on_face.begin(), keypts_on_face.end());
+    }
+}
+
+void cubemap_extractor::extract_on_face(const unsigned int face_idx, const cv::Mat& image, const cv::Mat& mask) {
+    // (the longitude wraps around at the left and right edges of the equirectangular image)
+    cv::remap(image, face_images_.at(face_idx), maps_1_.at(face_idx), maps_2_.at(face_idx), cv::INTER_LINEAR, cv::BORDER_WRAP);
+    cv::Mat face_mask;
+    if (!mask.empty()) {
+        cv::remap(mask, face_masks_.at(face_idx), maps_1_.at(face_idx), maps_2_.at(face_idx), cv::INTER_NEAREST, cv::BORDER_WRAP);
+        face_mask = face_masks_.at(face_idx);
+    }
+
+    auto& keypts = face_keypts_.at(face_idx);
+    cv::Mat& descriptors = face_descriptors_.at(face_idx);
+    face_extractors_.at(face_idx)->extract(face_images_.at(face_idx), face_mask, keypts, descriptors);
+
+    // keep the keypoints whose bearings are the closest to the direction of this face (the overlaps are removed),
+    // and map them to the equirectangular image
+    const Vec3_t face_dir = rots_cf_.at(face_idx).col(2);
+    unsigned int num_kept = 0;
+    for (unsigned int idx = 0; idx < keypts.size(); ++idx) {
+        auto keypt = keypts.at(idx);
+        const Vec3_t bearing = compute_bearing(face_idx, keypt.pt);
+        const double cos_to_face = bearing.dot(face_dir);
+        bool is_owned = true;
+        for (unsigned int other_face_idx = 0; other_face_idx < get_num_faces(); ++other_face_idx) {
+            if (other_face_idx != face_idx && cos_to_face < bearing.dot(rots_cf_.at(other_face_idx).col(2))) {
+                is_owned = false;
+                break;
+            }
+        }
+        if (!is_owned) {
+            continue;
+        }
+
+        // the angle is measured along the direction of the keypoint mapped to the equirectangular image
+        const auto pt = map_to_equirectangular(face_idx, keypt.pt);
+        const float angle_rad = keypt.angle * static_cast<float>(M_PI / 180.0);
+        const auto pt_ahead = map_to_equirectangular(face_idx, keypt.pt + cv::Point2f(std::cos(angle_rad), std::sin(angle_rad)));
+        float dx = pt_ahead.x - pt.x;
+        if (cols_ / 2.0f < dx) {
+            dx -= cols_;
+        }
+        else if (dx < -(cols_ / 2.0f)) {
+            dx += cols_;
+        }
+        float angle = std::atan2(pt_ahead.y - pt.y, dx) * static_cast<float>(180.0 / M_PI);
+        if (angle < 0.0f) {
+            angle += 360.0f;
+        }
+
+        keypt.pt = cv::Point2f(std::fmod(pt.x + cols_, static_cast<float>(cols_)), std::min(pt.y, rows_ - 1.0f));
+        keypt.angle = angle;
+        if (num_kept != idx) {
+            descriptors.row(idx).copyTo(descriptors.row(num_kept));
+        }
+        keypts.at(num_kept++) = keypt;
+    }
+    keypts.resize(num_kept);
+    if (!descriptors.empty()) {
+        descriptors = descriptors.rowRange(0, num_kept);
+    }
+}
+
+} // namespace feature
+} // namespace stella_vslam
@@ -0,0 +1,107 @@
+#ifndef STELLA_VSLAM_FEATURE_CUBEMAP_EXTRACTOR_H
+#define STELLA_VSLAM_FEATURE_CUBEMAP_EXTRACTOR_H
+
+#include "stella_vslam/type.h"
+
+#include <memory>
+#include <vector>
+
+#include <opencv2/core/mat.hpp>
+#include <opencv2/core/types.hpp>
+
+namespace stella_vslam {
+
+namespace util {
+class thread_pool;
+} // namespace util
+
+namespace feature {
+
+class orb_extractor;
+struct orb_params;
+
+/**
+ * ORB extraction of the equirectangular images on the faces of a cube map
+ * The equirectangular image is reprojected to the perspective images of the faces, and the ORB features are extracted
+ * on the faces in parallel, then the keypoints are mapped back to the equirectangular image.
+ * The faces are not stretched near the poles, so the keypoints are distributed uniformly over the sphere
+ * with fewer pixels processed than the full panorama (about 10% fewer with the default size of the 6 faces).
+ * With 4 faces (the sides of the cube), the band around the horizon is extracted and the zenith and the nadir are skipped
+ * (about 40% fewer pixels).
+ * The field of view of each face is wider than 90 deg, so that the keypoints close to the edges of the faces are detected,
+ * and each keypoint is kept only on the face whose direction is the closest to its bearing.
+ * (NOTE: the descriptors are computed on the faces, and the angles of the keypoints are converted to the equirectangular image)
+ */
+class cubemap_extractor {
+public:
+    /**
+     * Constructor
+     * @param orb_params
+     * @param min_size size of the node occupied by one feature point (of each face)
+     * @param num_faces 6 (the whole sphere) or 4 (the band around the horizon)
+     * @param face_size width and height of the faces [px] (if 0, the focal length of the faces is cols / 8 of the equirectangular image,
+     *                  which makes the 90 deg of the faces cols / 4 pixels)
+     * @param face_fov_deg field of view of the faces [deg]
+     */
+    cubemap_extractor(const orb_params* orb_params, const unsigned int min_size, const unsigned int num_faces = 6,
+                      const unsigned int face_size = 0, const double face_fov_deg = 95.0);
+
+    //! Destructor
+    ~cubemap_extractor();
+
+    //! Extract the keypoints (in the equirectangular image) and each descriptor of them
+    //! (the mask is of the equirectangular image)
+    void extract(const cv::Mat& image, const cv::Mat& mask,
+                 std::vector<cv::KeyPoint>& keypts, const cv::_OutputArray& out_descriptors);
+
+    //! Get the number of the faces
+    unsigned int get_num_faces() const {
+        return rots_cf_.size();
+    }
+
+    //! Map the point of the face to the equirectangular image (after the first extraction, or the maps are created)
+    cv::Point2f map_to_equirectangular(const unsigned int face_idx, const cv::Point2f& pt) const;
+
+    //! Create the maps for the equirectangular images of the size (the maps are created by the first extraction if not called)
+    void create_maps(const unsigned int cols, const unsigned int rows);
+
+    //! extractors of the faces
+    std::vector<std::unique_ptr<orb_extractor>> face_extractors_;
+
+private:
+    //! Compute the bearing (in the equirectangular camera) of the point of the face
+    Vec3_t compute_bearing(const unsigned int face_idx, const cv::Point2f& pt) const;
+
+    //! Extract the keypoints on the face, and map them back to the equirectangular image
+    void extract_on_face(const unsigned int face_idx, const cv::Mat& image, const cv::Mat& mask);
+
+    //! width and height of the faces (0 until the maps are created if not given)
+    unsigned int face_size_;
+    //! field of view of the faces [rad]
+    const double face_fov_;
+    //! focal length of the faces [px]
+    double face_focal_ = 0.0;
+    //! size of the equirectangular images for which the maps are created
+    unsigned int cols_ = 0;
+    unsigned int rows_ = 0;
+
+    //! rotations from the faces to the equirectangular camera
+    eigen_alloc_vector<Mat33_t> rots_cf_;
+    //! maps from the pixels of the faces to those of the equirectangular image (for cv::remap())
+    std::vector<cv::Mat> maps_1_;
+    std::vector<cv::Mat> maps_2_;
+
+    //! buffers of each face reused across the frames
+    std::vector<cv::Mat> face_images_;
+    std::vector<cv::Mat> face_masks_;
+    std::vector<std::vector<cv::KeyPoint>> face_keypts_;
+    std::vector<cv::Mat> face_descriptors_;
+
+    //! workers which extract on the faces other than the first one
+    std::unique_ptr<util::thread_pool> pool_;
+};
+
+} // namespace feature
+} // namespace stella_vslam
+
+#endif // STELLA_VSLAM_FEATURE_CUBEMAP_EXTRACTOR_H
@@ -0,0 +1,205 @@
+#include "stella_vslam/feature/feature_cache.h"
+#include "stella_vslam/util/mapped_file.h"
+
+#include <cstring>
+#include <stdexcept>
+
+#include <spdlog/spdlog.h>
+
+namespace stella_vslam {
+namespace feature {
+
+namespace {
+constexpr char magic[4] = {'S', 'V', 'F', 'C'};
+constexpr uint32_t version = 1;
+//! magic, version and the length of the fingerprint
+constexpr size_t header_size = 4 + 4 + 4;
+//! key, number of the keypoints and the extraction settings
+constexpr size_t record_header_size = 8 + 4 + 5 * 4;
+//! x, y, size, angle, response and octave
+constexpr size_t keypt_size = 6 * 4;
+constexpr size_t descriptor_size = 32;
+
+template<typename T>
+T read_value(const uint8_t* data) {
+    T value;
+    std::memcpy(&value, data, sizeof(T));
+    return value;
+}
+
+template<typename T>
+void write_value(std::ofstream& ofs, const T value) {
+    ofs.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+constexpr uint64_t fnv_offset_basis = 14695981039346656037ull;
+constexpr uint64_t fnv_prime = 1099511628211ull;
+
+uint64_t hash_bytes(const uint8_t* data, const size_t size, uint64_t hash) {
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= data[i];
+        hash *= fnv_prime;
+    }
+    return hash;
+}
+} // namespace
+
+feature_cache::feature_cache(const std::string& path, const std::string& fingerprint)
+    : path_(path) {
+    bool is_valid = false;
+    bool is_truncated = false;
+    if (std::ifstream(path, std::ios::in | std::ios::binary).good()) {
+        file_.reset(new util::mapped_file(path));
+        const auto data = file_->data();
+        const auto size = file_->size();
+        if (header_size <= size
+            && std::memcmp(data, magic, sizeof(magic)) == 0
+            && read_value<uint32_t>(data + 4) == version
+            && read_value<uint32_t>(data + 8) == fingerprint.size()
+            && header_size + fingerprint.size() <= size
+            && std::memcmp(data + header_size, fingerprint.data(), fingerprint.size()) == 0) {
+            is_valid = true;
+            is_truncated = !build_index(header_size + fingerprint.size());
+        }
+        else {
+            spdlog::warn("feature cache at {} was created with the different parameters, rebuild it", path);
+            file_.reset();
+        }
+    }
+
+    if (!is_valid) {
+        ofs_.open(path, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!ofs_.is_open()) {
+            throw std::runtime_error("cannot create the feature cache at " + path);
+        }
+        ofs_.write(magic, sizeof(magic));
+        write_value<uint32_t>(ofs_, version);
+        write_value<uint32_t>(ofs_, static_cast<uint32_t>(fingerprint.size()));
+        ofs_.write(fingerprint.data(), fingerprint.size());
+        ofs_.flush();
+    }
+    else if (!is_truncated) {
+        ofs_.open(path, std::ios::out | std::ios::binary | std::ios::app);
+        if (!ofs_.is_open()) {
+            throw std::runtime_error("cannot open the feature cache at " + path);
+        }
+    }
+    else {
+        spdlog::warn("the tail of the feature cache at {} is corrupted, the cache is used read-only", path);
+    }
+    spdlog::info("load the feature cache of {} frames from {}", offsets_.size(), path);
+}
+
+feature_cache::~feature_cache() = default;
+
+bool feature_cache::build_index(const size_t begin) {
+    const auto data = file_->data();
+    const auto size = file_->size();
+    size_t offset = begin;
+    while (offset < size) {
+        if (size < offset + record_header_size) {
+            return false;
+        }
+        const auto key = read_value<uint64_t>(data + offset);
+        const auto num_keypts = read_value<uint32_t>(data + offset + 8);
+        const size_t record_size = record_header_size + num_keypts * (keypt_size + descriptor_size);
+        if (size < offset + record_size) {
+            return false;
+        }
+        offsets_.emplace(key, offset);
+        offset += record_size;
+    }
+    return true;
+}
+
+bool feature_cache::contains(const uint64_t key) const {
+    return offsets_.count(key) != 0;
+}
+
+bool feature_cache::find(const uint64_t key, std::vector<cv::KeyPoint>& keypts, cv::Mat& descriptors,
+                         orb_extraction_settings& extraction_settings) const {
+    const auto iter = offsets_.find(key);
+    if (iter == offsets_.end()) {
+        return false;
+    }
+    const uint8_t* data = file_->data() + iter->second;
+    const auto num_keypts = read_value<uint32_t>(data + 8);
+    extraction_settings.num_levels_ = read_value<uint32_t>(data + 12);
+    extraction_settings.ini_fast_thr_ = read_value<uint32_t>(data + 16);
+    extraction_settings.min_fast_thr_ = read_value<uint32_t>(data + 20);
+    extraction_settings.min_size_ = read_value<uint32_t>(data + 24);
+    extraction_settings.degradation_level_ = read_value<uint32_t>(data + 28);
+    extraction_settings.elapsed_ms_ = 0.0;
+    data += record_header_size;
+
+    keypts.resize(num_keypts);
+    for (auto& keypt : keypts) {
+        keypt.pt.x = read_value<float>(data);
+        keypt.pt.y = read_value<float>(data + 4);
+        keypt.size = read_value<float>(data + 8);
+        keypt.angle = read_value<float>(data + 12);
+        keypt.response = read_value<float>(data + 16);
+        keypt.octave = read_value<int32_t>(data + 20);
+        keypt.class_id = -1;
+        data += keypt_size;
+    }
+
+    descriptors.create(num_keypts, descriptor_size, CV_8U);
+    if (0 < num_keypts) {
+        std::memcpy(descriptors.data, data, num_keypts * descriptor_size);
+    }
+    return true;
+}
+
+void feature_cache::store(const uint64_t key, const std::vector<cv::KeyPoint>& keypts, const cv::Mat& descriptors,
+                          const orb_extraction_settings& extraction_settings) {
+    if (keypts.size() != static_cast<size_t>(descriptors.rows)
+        || (!keypts.empty() && (descriptors.type() != CV_8U || descriptors.cols != static_cast<int>(descriptor_size)))) {
+        throw std::runtime_error("invalid descriptors are stored to the feature cache");
+    }
+
+    std::lock_guard<std::mutex> lock(mtx_store_);
+    if (!ofs_.is_open() || contains(key) || !stored_keys_.insert(key).second) {
+        return;
+    }
+    write_value<uint64_t>(ofs_, key);
+    write_value<uint32_t>(ofs_, static_cast<uint32_t>(keypts.size()));
+    write_value<uint32_t>(ofs_, extraction_settings.num_levels_);
+    write_value<uint32_t>(ofs_, extraction_settings.ini_fast_thr_);
+    write_value<uint32_t>(ofs_, extraction_settings.min_fast_thr_);
+    write_value<uint32_t>(ofs_, extraction_settings.min_size_);
+    write_value<uint32_t>(ofs_, extraction_settings.degradation_level_);
+    for (const auto& keypt : keypts) {
+        write_value<float>(ofs_, keypt.pt.x);
+        write_value<float>(ofs_, keypt.pt.y);
+        write_value<float>(ofs_, keypt.size);
+        write_value<float>(ofs_, keypt.angle);
+        write_value<float>(ofs_, keypt.response);
+        write_value<int32_t>(ofs_, keypt.octave);
+    }
+    for (int row = 0; row < descriptors.rows; ++row) {
+        ofs_.write(reinterpret_cast<const char*>(descriptors.ptr<uint8_t>(row)), descriptor_size);
+    }
+    // keep the records complete if the process is aborted
+    ofs_.flush();
+    if (!ofs_.good()) {
+        throw std::runtime_error("cannot write the feature cache at " + path_);
+    }
+}
+
+uint64_t feature_cache::compute_key(const std::string& str) {
+    return hash_bytes(reinterpret_cast<const uint8_t*>(str.data()), str.size(), fnv_offset_basis);
+}
+
+uint64_t feature_cache::compute_key(const cv::Mat& img) {
+    const int32_t shape[3] = {img.rows, img.cols, img.type()};
+    uint64_t hash = hash_bytes(reinterpret_cast<const uint8_t*>(shape), sizeof(shape), fnv_offset_basis);
+    const size_t row_size = img.cols * img.elemSize();
+    for (int row = 0; row < img.rows; ++row) {
+        hash = hash_bytes(img.ptr<uint8_t>(row), row_size, hash);
+    }
+    return hash;
+}
+
+} // namespace feature
+} // namespace stella_vslam
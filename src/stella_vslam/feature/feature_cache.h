@@ -0,0 +1,111 @@
+#ifndef STELLA_VSLAM_FEATURE_FEATURE_CACHE_H
+#define STELLA_VSLAM_FEATURE_FEATURE_CACHE_H
+
+#include "stella_vslam/feature/orb_extraction_budget.h"
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <opencv2/core/mat.hpp>
+#include <opencv2/core/types.hpp>
+
+namespace stella_vslam {
+
+namespace util {
+class mapped_file;
+} // namespace util
+
+namespace feature {
+
+/**
+ * On-disk cache of the ORB features of the images, which skips the extraction in the repeated offline runs
+ * (e.g. the parameter sweeps over the same recording).
+ * The file consists of a header with the fingerprint of the extraction parameters,
+ * followed by the records of the keypoints and the descriptors appended in the order of store().
+ * The file is memory-mapped when opened, and rebuilt if the fingerprint differs.
+ * (NOTE: the records stored in this session are found after the file is opened again.
+ *  contains() and find() are thread-safe, and store() can be called concurrently with them.)
+ */
+class feature_cache {
+public:
+    /**
+     * Constructor
+     * @param path path of the cache file, which is created if it does not exist
+     * @param fingerprint description of the parameters which affect the features (see system::get_feature_fingerprint())
+     */
+    feature_cache(const std::string& path, const std::string& fingerprint);
+
+    //! Destructor
+    ~feature_cache();
+
+    feature_cache(const feature_cache&) = delete;
+    feature_cache& operator=(const feature_cache&) = delete;
+
+    //! The features of the key are cached in the file or not
+    bool contains(const uint64_t key) const;
+
+    /**
+     * Get the cached features
+     * @param key
+     * @param keypts
+     * @param descriptors (copied from the file)
+     * @param extraction_settings settings used for the extraction (elapsed_ms_ is 0)
+     * @return false if the features are not cached
+     */
+    bool find(const uint64_t key, std::vector<cv::KeyPoint>& keypts, cv::Mat& descriptors,
+              orb_extraction_settings& extraction_settings) const;
+
+    /**
+     * Append the features to the file (ignored if the key is already cached or the file is read-only)
+     * @param key
+     * @param keypts
+     * @param descriptors CV_8U matrix of 32 bytes per keypoint
+     * @param extraction_settings
+     */
+    void store(const uint64_t key, const std::vector<cv::KeyPoint>& keypts, const cv::Mat& descriptors,
+               const orb_extraction_settings& extraction_settings);
+
+    //! Number of the records found in the file when opened
+    size_t size() const {
+        return offsets_.size();
+    }
+
+    //! New records can be appended or not (false if the tail of the file is corrupted)
+    bool is_writable() const {
+        return ofs_.is_open();
+    }
+
+    //! Key of the string (e.g. the path and the size of the image file, which is known before decoding)
+    static uint64_t compute_key(const std::string& str);
+
+    //! Key of the content of the image
+    static uint64_t compute_key(const cv::Mat& img);
+
+private:
+    //! Scan the records of the mapped file (return false if a record is truncated)
+    bool build_index(const size_t begin);
+
+    //! path of the cache file
+    const std::string path_;
+    //! mapped view of the records found when opened
+    std::unique_ptr<util::mapped_file> file_;
+    //! key -> offset of the record in file_
+    std::unordered_map<uint64_t, size_t> offsets_;
+
+    //! stream to append the new records
+    std::ofstream ofs_;
+    //! keys of the records appended in this session
+    std::unordered_set<uint64_t> stored_keys_;
+    mutable std::mutex mtx_store_;
+};
+
+} // namespace feature
+} // namespace stella_vslam
+
+#endif // STELLA_VSLAM_FEATURE_FEATURE_CACHE_H
@@ -0,0 +1,78 @@
+#include "stella_vslam/feature/orb_params.h"
+#include "stella_vslam/feature/orb_extraction_budget.h"
+
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
+#include <spdlog/spdlog.h>
+
+namespace stella_vslam {
+namespace feature {
+
+constexpr unsigned int orb_extraction_budget::max_degradation_level_;
+
+orb_extraction_budget::orb_extraction_budget(const orb_params* orb_params, const unsigned int min_size,
+                                             const double budget_ms, const unsigned int num_timing_records)
+    : orb_params_(orb_params), min_size_(min_size), budget_ms_(budget_ms), num_timing_records_(num_timing_records) {
+    if (budget_ms <= 0.0) {
+        throw std::runtime_error("Time budget of ORB extraction must be greater than 0");
+    }
+    if (num_timing_records == 0) {
+        throw std::runtime_error("Number of timing records of ORB extraction must be greater than 0");
+    }
+    apply_degradation_level(0);
+}
+
+void orb_extraction_budget::update(const double elapsed_ms) {
+    settings_.elapsed_ms_ = elapsed_ms;
+
+    elapsed_ms_history_.push_back(elapsed_ms);
+    if (num_timing_records_ < elapsed_ms_history_.size()) {
+        elapsed_ms_history_.pop_front();
+    }
+    const double mean_elapsed_ms = std::accumulate(elapsed_ms_history_.begin(), elapsed_ms_history_.end(), 0.0)
+                                   / elapsed_ms_history_.size();
+
+    // Degrade quickly (as soon as two frames are over the budget on average) to avoid dropping frames,
+    // and restore slowly (only after the whole history is well below the budget) to avoid oscillation
+    constexpr double restoration_ratio = 0.75;
+    const unsigned int num_records_to_degrade = std::min(2u, num_timing_records_);
+    unsigned int degradation_level = settings_.degradation_level_;
+    if (num_records_to_degrade <= elapsed_ms_history_.size() && budget_ms_ < mean_elapsed_ms
+        && degradation_level < max_degradation_level_) {
+        ++degradation_level;
+    }
+    else if (num_timing_records_ <= elapsed_ms_history_.size() && mean_elapsed_ms < restoration_ratio * budget_ms_
+             && 0 < degradation_level) {
+        --degradation_level;
+    }
+    else {
+        return;
+    }
+
+    spdlog::debug("ORB extraction: degradation level {} -> {} (mean elapsed time: {:.2f} ms, budget: {:.2f} ms)",
+                  settings_.degradation_level_, degradation_level, mean_elapsed_ms, budget_ms_);
+    apply_degradation_level(degradation_level);
+    // The history is measured under the previous settings
+    elapsed_ms_history_.clear();
+}
+
+void orb_extraction_budget::apply_degradation_level(const unsigned int degradation_level) {
+    settings_.degradation_level_ = degradation_level;
+
+    // Drop the coarsest level every two degradation levels, but keep at least half of the levels
+    const unsigned int min_num_levels = std::max(1u, (orb_params_->num_levels_ + 1) / 2);
+    settings_.num_levels_ = std::max(min_num_levels, orb_params_->num_levels_ - std::min(orb_params_->num_levels_, degradation_level / 2));
+
+    // Raise the FAST thresholds so that fewer corners are scored and distributed
+    constexpr unsigned int max_fast_thr = 255;
+    settings_.ini_fast_thr_ = std::min(max_fast_thr, orb_params_->ini_fast_thr_ + 2 * degradation_level);
+    settings_.min_fast_thr_ = std::min(settings_.ini_fast_thr_, orb_params_->min_fast_thr_ + degradation_level);
+
+    // Enlarge the node size per keypoint so that fewer keypoints are described
+    settings_.min_size_ = min_size_ + min_size_ * degradation_level / 2;
+}
+
+} // namespace feature
+} // namespace stella_vslam
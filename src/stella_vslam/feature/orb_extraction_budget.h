@@ -0,0 +1,80 @@
+#ifndef STELLA_VSLAM_FEATURE_ORB_EXTRACTION_BUDGET_H
+#define STELLA_VSLAM_FEATURE_ORB_EXTRACTION_BUDGET_H
+
+#include <deque>
+
+namespace stella_vslam {
+namespace feature {
+
+struct orb_params;
+
+//! Settings used for the ORB extraction of a frame
+struct orb_extraction_settings {
+    //! number of the pyramid levels where the keypoints are extracted
+    unsigned int num_levels_ = 0;
+    //! initial FAST threshold of each cell
+    unsigned int ini_fast_thr_ = 0;
+    //! FAST threshold used when no keypoint is found with the initial one
+    unsigned int min_fast_thr_ = 0;
+    //! size of node occupied by one feature point (the larger, the fewer keypoints)
+    unsigned int min_size_ = 0;
+    //! degradation level chosen by the time budget (0 means the full settings)
+    unsigned int degradation_level_ = 0;
+    //! elapsed time of the extraction [ms]
+    double elapsed_ms_ = 0.0;
+};
+
+/**
+ * Controller which adapts the ORB extraction settings to a per-frame time budget
+ * The settings are degraded step by step while the recent extraction times exceed the budget,
+ * and restored while they stay well below it.
+ * Each degradation level increases the node size per keypoint and the FAST thresholds,
+ * and drops the coarsest pyramid level every two levels.
+ */
+class orb_extraction_budget {
+public:
+    /**
+     * Constructor
+     * @param orb_params parameters of the full settings
+     * @param min_size size of node occupied by one feature point in the full settings
+     * @param budget_ms time budget of the extraction per frame [ms]
+     * @param num_timing_records number of the recent extraction times used to restore the settings
+     */
+    orb_extraction_budget(const orb_params* orb_params, const unsigned int min_size,
+                          const double budget_ms, const unsigned int num_timing_records = 5);
+
+    //! Get the settings to be used for the next extraction
+    const orb_extraction_settings& get_settings() const { return settings_; }
+
+    //! Get the time budget [ms]
+    double get_budget_ms() const { return budget_ms_; }
+
+    //! Record the elapsed time of an extraction and choose the settings for the next one
+    void update(const double elapsed_ms);
+
+    //! Maximum degradation level
+    static constexpr unsigned int max_degradation_level_ = 8;
+
+private:
+    //! Compute the settings from the degradation level
+    void apply_degradation_level(const unsigned int degradation_level);
+
+    //! parameters of the full settings
+    const orb_params* orb_params_;
+    //! size of node occupied by one feature point in the full settings
+    const unsigned int min_size_;
+    //! time budget per frame [ms]
+    const double budget_ms_;
+    //! number of the recent extraction times used to restore the settings
+    const unsigned int num_timing_records_;
+
+    //! recent extraction times under the current settings [ms]
+    std::deque<double> elapsed_ms_history_;
+    //! current settings
+    orb_extraction_settings settings_;
+};
+
+} // namespace feature
+} // namespace stella_vslam
+
+#endif // STELLA_VSLAM_FEATURE_ORB_EXTRACTION_BUDGET_H
@@ -1,12 +1,19 @@
 #include "stella_vslam/feature/orb_extractor.h"
+#include "stella_vslam/feature/cubemap_extractor.h"
 #include "stella_vslam/type.h"
 
 #include <opencv2/core/mat.hpp>
 #include <opencv2/core/types.hpp>
 #include <opencv2/imgproc.hpp>
 #include <opencv2/features2d.hpp>
+#ifdef USE_OPENCL_ORB
+#include <opencv2/core/ocl.hpp>
+#endif
 
+#include <algorithm>
+#include <chrono>
 #include <iostream>
+#include <stdexcept>
 
 #include <spdlog/spdlog.h>
 
@@ -15,10 +22,89 @@ namespace feature {
 
 orb_extractor::orb_extractor(const orb_params* orb_params,
                              const unsigned int min_size,
-                             const std::vector<std::vector<float>>& mask_rects)
+                             const std::vector<std::vector<float>>& mask_rects,
+                             const bool use_opencl)
     : orb_params_(orb_params), mask_rects_(mask_rects), min_size_(min_size) {
     // resize buffers according to the number of levels
+    // (NOTE: the buffers are reused across frames to avoid allocation in the steady state)
     image_pyramid_.resize(orb_params_->num_levels_);
+    blurred_image_pyramid_.resize(orb_params_->num_levels_);
+    all_keypts_.resize(orb_params_->num_levels_);
+    keypts_to_distribute_.resize(orb_params_->num_levels_);
+    fast_cell_ranges_.resize(orb_params_->num_levels_);
+    descriptor_offsets_.resize(orb_params_->num_levels_);
+
+    set_time_budget(0.0);
+
+    if (use_opencl) {
+#ifdef USE_OPENCL_ORB
+        if (cv::ocl::haveOpenCL()) {
+            cv::ocl::setUseOpenCL(true);
+            use_opencl_ = cv::ocl::useOpenCL();
+        }
+        if (use_opencl_) {
+            spdlog::info("ORB extraction: OpenCL device {} is used for the image pyramid", cv::ocl::Device::getDefault().name());
+            image_pyramid_umat_.resize(orb_params_->num_levels_);
+            blurred_image_pyramid_umat_.resize(orb_params_->num_levels_);
+        }
+        else {
+            spdlog::warn("ORB extraction: OpenCL is not available, fall back to CPU");
+        }
+#else
+        spdlog::warn("ORB extraction: use_opencl is ignored because stella_vslam is built without USE_OPENCL_ORB");
+#endif
+    }
+}
+
+orb_extractor::~orb_extractor() = default;
+
+void orb_extractor::set_time_budget(const double budget_ms, const unsigned int num_timing_records) {
+    if (cubemap_) {
+        for (auto& face_extractor : cubemap_->face_extractors_) {
+            face_extractor->set_time_budget(budget_ms, num_timing_records);
+        }
+    }
+    if (budget_ms <= 0.0) {
+        budget_ = nullptr;
+        settings_ = orb_extraction_settings();
+        settings_.num_levels_ = orb_params_->num_levels_;
+        settings_.ini_fast_thr_ = orb_params_->ini_fast_thr_;
+        settings_.min_fast_thr_ = orb_params_->min_fast_thr_;
+        settings_.min_size_ = min_size_;
+        return;
+    }
+    budget_.reset(new orb_extraction_budget(orb_params_, min_size_, budget_ms, num_timing_records));
+    settings_ = budget_->get_settings();
+    spdlog::info("ORB extraction: time budget is {} ms per frame", budget_ms);
+}
+
+void orb_extractor::set_first_level(const unsigned int first_level, const bool refine_to_full_resolution) {
+    if (orb_params_->num_levels_ <= first_level) {
+        throw std::runtime_error("First level of ORB extraction must be less than the number of levels");
+    }
+    first_level_ = first_level;
+    refine_to_full_resolution_ = 0 < first_level && refine_to_full_resolution;
+    if (cubemap_) {
+        for (auto& face_extractor : cubemap_->face_extractors_) {
+            face_extractor->set_first_level(first_level, refine_to_full_resolution);
+        }
+    }
+    if (0 < first_level) {
+        spdlog::info("ORB extraction: keypoints are extracted from level {} (downscaled by {:.2f}){}", first_level,
+                     orb_params_->scale_factors_.at(first_level), refine_to_full_resolution_ ? " and refined to the full resolution" : "");
+    }
+}
+
+void orb_extractor::set_cubemap_extraction(const unsigned int num_faces, const unsigned int face_size, const double face_fov_deg) {
+    if (num_faces == 0) {
+        cubemap_ = nullptr;
+        return;
+    }
+    cubemap_.reset(new cubemap_extractor(orb_params_, min_size_, num_faces, face_size, face_fov_deg));
+    for (auto& face_extractor : cubemap_->face_extractors_) {
+        face_extractor->set_first_level(first_level_, refine_to_full_resolution_);
+    }
+    spdlog::info("ORB extraction: keypoints are extracted on {} faces of a cube map", num_faces);
 }
 
 void orb_extractor::extract(const cv::_InputArray& in_image, const cv::_InputArray& in_image_mask,
@@ -27,12 +113,42 @@ void orb_extractor::extract(const cv::_InputArray& in_image, const cv::_InputArr
         return;
     }
 
+    const auto start = std::chrono::steady_clock::now();
+    if (budget_) {
+        settings_ = budget_->get_settings();
+    }
+
     // get cv::Mat of image
     const auto image = in_image.getMat();
     assert(image.type() == CV_8UC1);
 
+    // the keypoints are extracted on the faces of the cube map instead of the whole image
+    if (cubemap_) {
+        if (!mask_is_initialized_ && !mask_rects_.empty()) {
+            create_rectangle_mask(image.cols, image.rows);
+            mask_is_initialized_ = true;
+        }
+        const cv::Mat mask = in_image_mask.empty() ? rect_mask_ : in_image_mask.getMat();
+        cubemap_->extract(image, mask, keypts, out_descriptors);
+        // (the faces share the settings except for the elapsed time)
+        settings_ = cubemap_->face_extractors_.at(0)->get_extraction_settings();
+        settings_.elapsed_ms_ = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        return;
+    }
+
     // build image pyramid
+    // (NOTE: all the levels are built even in the latency-budget mode, because the stereo matcher looks up
+    //        the right image at the levels of the left keypoints)
+#ifdef USE_OPENCL_ORB
+    if (use_opencl_) {
+        compute_image_pyramid_opencl(image);
+    }
+    else {
+        compute_image_pyramid(image);
+    }
+#else
     compute_image_pyramid(image);
+#endif
 
     // mask initialization
     if (!mask_is_initialized_ && !mask_rects_.empty()) {
@@ -40,7 +156,7 @@ void orb_extractor::extract(const cv::_InputArray& in_image, const cv::_InputArr
         mask_is_initialized_ = true;
     }
 
-    std::vector<std::vector<cv::KeyPoint>> all_keypts;
+    auto& all_keypts = all_keypts_;
 
     // select mask to use
     if (!in_image_mask.empty()) {
@@ -73,11 +189,18 @@ void orb_extractor::extract(const cv::_InputArray& in_image, const cv::_InputArr
         descriptors = out_descriptors.getMat();
     }
 
-    keypts.clear();
-    keypts.reserve(num_keypts);
+    // Assign the row range of the output descriptor matrix to each level in advance,
+    // so that the levels can be processed independently
+    auto& offsets = descriptor_offsets_;
+    offsets.at(0) = 0;
+    for (unsigned int level = 1; level < orb_params_->num_levels_; ++level) {
+        offsets.at(level) = offsets.at(level - 1) + all_keypts.at(level - 1).size();
+    }
 
-    unsigned int offset = 0;
-    for (unsigned int level = 0; level < orb_params_->num_levels_; ++level) {
+#ifdef USE_OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (int64_t level = 0; level < orb_params_->num_levels_; ++level) {
         auto& keypts_at_level = all_keypts.at(level);
         const auto num_keypts_at_level = keypts_at_level.size();
 
@@ -85,17 +208,34 @@ void orb_extractor::extract(const cv::_InputArray& in_image, const cv::_InputArr
             continue;
         }
 
-        cv::Mat blurred_image = image_pyramid_.at(level).clone();
-        cv::GaussianBlur(blurred_image, blurred_image, cv::Size(7, 7), 2, 2, cv::BORDER_REFLECT_101);
+        // Orientations are computed on the original (not blurred) image
+        compute_orientation(image_pyramid_.at(level), keypts_at_level);
 
-        cv::Mat descriptors_at_level = descriptors.rowRange(offset, offset + num_keypts_at_level);
-        compute_orb_descriptors(blurred_image, keypts_at_level, descriptors_at_level);
+        // (NOTE: the blurred images have been already computed on the device if OpenCL is used)
+        cv::Mat& blurred_image = blurred_image_pyramid_.at(level);
+        if (!use_opencl_) {
+            cv::GaussianBlur(image_pyramid_.at(level), blurred_image, cv::Size(7, 7), 2, 2, cv::BORDER_REFLECT_101);
+        }
 
-        offset += num_keypts_at_level;
+        cv::Mat descriptors_at_level = descriptors.rowRange(offsets.at(level), offsets.at(level) + num_keypts_at_level);
+        compute_orb_descriptors(blurred_image, keypts_at_level, descriptors_at_level);
 
         correct_keypoint_scale(keypts_at_level, level);
 
-        keypts.insert(keypts.end(), keypts_at_level.begin(), keypts_at_level.end());
+        if (refine_to_full_resolution_) {
+            refine_keypoints_to_full_resolution(keypts_at_level, level);
+        }
+    }
+
+    keypts.clear();
+    keypts.reserve(num_keypts);
+    for (unsigned int level = 0; level < orb_params_->num_levels_; ++level) {
+        keypts.insert(keypts.end(), all_keypts.at(level).begin(), all_keypts.at(level).end());
+    }
+
+    settings_.elapsed_ms_ = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    if (budget_) {
+        budget_->update(settings_.elapsed_ms_);
     }
 }
 
@@ -125,7 +265,32 @@ void orb_extractor::compute_image_pyramid(const cv::Mat& image) {
     }
 }
 
-void orb_extractor::compute_fast_keypoints(std::vector<std::vector<cv::KeyPoint>>& all_keypts, const cv::Mat& mask) const {
+#ifdef USE_OPENCL_ORB
+void orb_extractor::compute_image_pyramid_opencl(const cv::Mat& image) {
+    image.copyTo(image_pyramid_umat_.at(0));
+    for (unsigned int level = 1; level < orb_params_->num_levels_; ++level) {
+        // determine the size of an image
+        const double scale = orb_params_->scale_factors_.at(level);
+        const cv::Size size(std::round(image.cols * 1.0 / scale), std::round(image.rows * 1.0 / scale));
+        // resize
+        cv::resize(image_pyramid_umat_.at(level - 1), image_pyramid_umat_.at(level), size, 0, 0, cv::INTER_LINEAR);
+    }
+    for (unsigned int level = 0; level < orb_params_->num_levels_; ++level) {
+        cv::GaussianBlur(image_pyramid_umat_.at(level), blurred_image_pyramid_umat_.at(level), cv::Size(7, 7), 2, 2, cv::BORDER_REFLECT_101);
+    }
+
+    // FAST, orientation and description run on the host
+    image_pyramid_.at(0) = image;
+    for (unsigned int level = 1; level < orb_params_->num_levels_; ++level) {
+        image_pyramid_umat_.at(level).copyTo(image_pyramid_.at(level));
+    }
+    for (unsigned int level = 0; level < orb_params_->num_levels_; ++level) {
+        blurred_image_pyramid_umat_.at(level).copyTo(blurred_image_pyramid_.at(level));
+    }
+}
+#endif
+
+void orb_extractor::compute_fast_keypoints(std::vector<std::vector<cv::KeyPoint>>& all_keypts, const cv::Mat& mask) {
     all_keypts.resize(orb_params_->num_levels_);
 
     // An anonymous function which checks mask(image or rectangle)
@@ -136,14 +301,27 @@ void orb_extractor::compute_fast_keypoints(std::vector<std::vector<cv::KeyPoint>
     constexpr unsigned int overlap = 6;
     constexpr unsigned int cell_size = 64;
 
-#ifdef USE_OPENMP
-#pragma omp parallel for
-#endif
-    for (int64_t level = 0; level < orb_params_->num_levels_; ++level) {
-        const float scale_factor = orb_params_->scale_factors_.at(level);
+    // The levels below the first level and the ones dropped by the latency-budget mode have no keypoints
+    // (NOTE: at least the first level is kept even in the latency-budget mode)
+    const unsigned int end_level = std::max(settings_.num_levels_, first_level_ + 1);
+    for (unsigned int level = 0; level < orb_params_->num_levels_; ++level) {
+        if (level < first_level_ || end_level <= level) {
+            all_keypts.at(level).clear();
+        }
+    }
+
+    const unsigned int ini_fast_thr = settings_.ini_fast_thr_;
+    const unsigned int min_fast_thr = settings_.min_fast_thr_;
+    // Shrink the node size so that the first level gets as many keypoints as the full-resolution image would
+    const float first_scale_factor = orb_params_->scale_factors_.at(first_level_);
+    const unsigned int min_size = settings_.min_size_ / (first_scale_factor * first_scale_factor);
 
-        constexpr unsigned int min_border_x = orb_patch_radius_;
-        constexpr unsigned int min_border_y = orb_patch_radius_;
+    constexpr unsigned int min_border_x = orb_patch_radius_;
+    constexpr unsigned int min_border_y = orb_patch_radius_;
+
+    // Enumerate the cells of all the levels, so that FAST runs in one flat parallel loop without nested teams
+    fast_cells_.clear();
+    for (unsigned int level = first_level_; level < end_level; ++level) {
         const unsigned int max_border_x = image_pyramid_.at(level).cols - orb_patch_radius_;
         const unsigned int max_border_y = image_pyramid_.at(level).rows - orb_patch_radius_;
 
@@ -153,80 +331,106 @@ void orb_extractor::compute_fast_keypoints(std::vector<std::vector<cv::KeyPoint>
         const unsigned int num_cols = std::ceil(width / cell_size) + 1;
         const unsigned int num_rows = std::ceil(height / cell_size) + 1;
 
-        std::vector<cv::KeyPoint> keypts_to_distribute;
-
-#ifdef USE_OPENMP
-#pragma omp parallel for
-#endif
-        for (int64_t i = 0; i < num_rows; ++i) {
+        const unsigned int begin = fast_cells_.size();
+        for (unsigned int i = 0; i < num_rows; ++i) {
             const unsigned int min_y = min_border_y + i * cell_size;
             if (max_border_y - overlap <= min_y) {
                 continue;
             }
-            unsigned int max_y = min_y + cell_size + overlap;
-            if (max_border_y < max_y) {
-                max_y = max_border_y;
-            }
+            const unsigned int max_y = std::min(min_y + cell_size + overlap, max_border_y);
 
-#ifdef USE_OPENMP
-#pragma omp parallel for
-#endif
-            for (int64_t j = 0; j < num_cols; ++j) {
+            for (unsigned int j = 0; j < num_cols; ++j) {
                 const unsigned int min_x = min_border_x + j * cell_size;
                 if (max_border_x - overlap <= min_x) {
                     continue;
                 }
-                unsigned int max_x = min_x + cell_size + overlap;
-                if (max_border_x < max_x) {
-                    max_x = max_border_x;
-                }
+                const unsigned int max_x = std::min(min_x + cell_size + overlap, max_border_x);
+                fast_cells_.push_back(fast_cell{level, min_x, max_x, min_y, max_y});
+            }
+        }
+        fast_cell_ranges_.at(level) = std::make_pair(begin, static_cast<unsigned int>(fast_cells_.size()));
+    }
+    if (keypts_in_cells_.size() < fast_cells_.size()) {
+        keypts_in_cells_.resize(fast_cells_.size());
+    }
 
-                // Pass FAST computation if one of the corners of a patch is in the mask
-                if (!mask.empty()) {
-                    if (is_in_mask(min_y, min_x, scale_factor) || is_in_mask(max_y, min_x, scale_factor)
-                        || is_in_mask(min_y, max_x, scale_factor) || is_in_mask(max_y, max_x, scale_factor)) {
-                        continue;
-                    }
-                }
+    // FAST is computed once with the lower threshold.
+    // The response of a FAST keypoint is the largest threshold with which it is still detected,
+    // so the keypoints detected with the initial threshold are those whose responses reach it
+    // (NOTE: the non-maximum suppression keeps the same ones, since the additional keypoints have the lower responses)
+    const unsigned int detection_fast_thr = std::min(ini_fast_thr, min_fast_thr);
 
-                std::vector<cv::KeyPoint> keypts_in_cell;
-                cv::FAST(image_pyramid_.at(level).rowRange(min_y, max_y).colRange(min_x, max_x),
-                         keypts_in_cell, orb_params_->ini_fast_thr_, true);
+#ifdef USE_OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (int64_t idx = 0; idx < static_cast<int64_t>(fast_cells_.size()); ++idx) {
+        const auto& cell = fast_cells_.at(idx);
+        std::vector<cv::KeyPoint>& keypts_in_cell = keypts_in_cells_.at(idx);
+        keypts_in_cell.clear();
+
+        // Pass FAST computation if one of the corners of a patch is in the mask
+        const float scale_factor = orb_params_->scale_factors_.at(cell.level_);
+        if (!mask.empty()) {
+            if (is_in_mask(cell.min_y_, cell.min_x_, scale_factor) || is_in_mask(cell.max_y_, cell.min_x_, scale_factor)
+                || is_in_mask(cell.min_y_, cell.max_x_, scale_factor) || is_in_mask(cell.max_y_, cell.max_x_, scale_factor)) {
+                continue;
+            }
+        }
 
-                // Re-compute FAST keypoint with reduced threshold if enough keypoint was not got
-                if (keypts_in_cell.empty()) {
-                    cv::FAST(image_pyramid_.at(level).rowRange(min_y, max_y).colRange(min_x, max_x),
-                             keypts_in_cell, orb_params_->min_fast_thr_, true);
-                }
+        cv::FAST(image_pyramid_.at(cell.level_).rowRange(cell.min_y_, cell.max_y_).colRange(cell.min_x_, cell.max_x_),
+                 keypts_in_cell, detection_fast_thr, true);
+
+        // Keep only the keypoints of the initial threshold if any,
+        // otherwise all the keypoints of the reduced threshold are used
+        const auto num_strong_keypts = std::count_if(keypts_in_cell.begin(), keypts_in_cell.end(),
+                                                     [ini_fast_thr](const cv::KeyPoint& keypt) {
+                                                         return ini_fast_thr <= keypt.response;
+                                                     });
+        if (0 < num_strong_keypts && static_cast<size_t>(num_strong_keypts) < keypts_in_cell.size()) {
+            keypts_in_cell.erase(std::remove_if(keypts_in_cell.begin(), keypts_in_cell.end(),
+                                                [ini_fast_thr](const cv::KeyPoint& keypt) {
+                                                    return keypt.response < ini_fast_thr;
+                                                }),
+                                 keypts_in_cell.end());
+        }
 
-                if (keypts_in_cell.empty()) {
-                    continue;
-                }
+        // Translate the keypoints to the coordinates relative to the border
+        for (auto& keypt : keypts_in_cell) {
+            keypt.pt.x += cell.min_x_ - min_border_x;
+            keypt.pt.y += cell.min_y_ - min_border_y;
+        }
+    }
 
-                // Collect keypoints for every scale
 #ifdef USE_OPENMP
-#pragma omp critical
+#pragma omp parallel for schedule(dynamic)
 #endif
-                {
-                    for (auto& keypt : keypts_in_cell) {
-                        keypt.pt.x += j * cell_size;
-                        keypt.pt.y += i * cell_size;
-                        // Check if the keypoint is in the mask
-                        if (!mask.empty() && is_in_mask(min_border_y + keypt.pt.y, min_border_x + keypt.pt.x, scale_factor)) {
-                            continue;
-                        }
-                        keypts_to_distribute.push_back(keypt);
-                    }
+    for (int64_t level = first_level_; level < end_level; ++level) {
+        const float scale_factor = orb_params_->scale_factors_.at(level);
+
+        const unsigned int max_border_x = image_pyramid_.at(level).cols - orb_patch_radius_;
+        const unsigned int max_border_y = image_pyramid_.at(level).rows - orb_patch_radius_;
+
+        // Collect keypoints of the cells at this level (each level is merged by one thread only)
+        std::vector<cv::KeyPoint>& keypts_to_distribute = keypts_to_distribute_.at(level);
+        keypts_to_distribute.clear();
+        const auto& cell_range = fast_cell_ranges_.at(level);
+        for (unsigned int idx = cell_range.first; idx < cell_range.second; ++idx) {
+            for (const auto& keypt : keypts_in_cells_.at(idx)) {
+                // Check if the keypoint is in the mask
+                if (!mask.empty() && is_in_mask(min_border_y + keypt.pt.y, min_border_x + keypt.pt.x, scale_factor)) {
+                    continue;
                 }
+                keypts_to_distribute.push_back(keypt);
             }
         }
 
         std::vector<cv::KeyPoint>& keypts_at_level = all_keypts.at(level);
 
         // Distribute keypoints via tree
-        keypts_at_level = distribute_keypoints_via_tree(keypts_to_distribute,
-                                                        min_border_x, max_border_x, min_border_y, max_border_y,
-                                                        scale_factor);
+        // (NOTE: write into the existing buffer to keep its capacity)
+        distribute_keypoints_in_place(keypts_to_distribute,
+                                      min_border_x, max_border_x, min_border_y, max_border_y,
+                                      min_size, scale_factor, keypts_at_level);
         SPDLOG_TRACE("keypts_at_level {} filtered={} raw={}", level, keypts_at_level.size(), keypts_to_distribute.size());
 
         // Keypoint size is patch size modified by the scale factor
@@ -241,163 +445,6 @@ void orb_extractor::compute_fast_keypoints(std::vector<std::vector<cv::KeyPoint>
             keypt.size = scaled_patch_size;
         }
     }
-
-    // Compute orientations
-    for (unsigned int level = 0; level < orb_params_->num_levels_; ++level) {
-        compute_orientation(image_pyramid_.at(level), all_keypts.at(level));
-    }
-}
-
-std::vector<cv::KeyPoint> orb_extractor::distribute_keypoints_via_tree(const std::vector<cv::KeyPoint>& keypts_to_distribute,
-                                                                       const int min_x, const int max_x, const int min_y, const int max_y,
-                                                                       const float scale_factor) const {
-    auto nodes = initialize_nodes(keypts_to_distribute, min_x, max_x, min_y, max_y);
-
-    // Forkable leaf nodes list
-    // The pool is used when a forking makes nodes more than a limited number
-    std::vector<std::pair<int, orb_extractor_node*>> leaf_nodes_pool;
-    leaf_nodes_pool.reserve(nodes.size() * 10);
-
-    while (true) {
-        const unsigned int prev_size = nodes.size();
-
-        auto iter = nodes.begin();
-        leaf_nodes_pool.clear();
-
-        // Fork node and remove the old one from nodes
-        while (iter != nodes.end()) {
-            if (iter->keypts_.size() == 1 || iter->size() * scale_factor * scale_factor <= min_size_) {
-                iter++;
-                continue;
-            }
-
-            // Divide node and assign to the leaf node pool
-            const auto child_nodes = iter->divide_node();
-            assign_child_nodes(child_nodes, nodes, leaf_nodes_pool);
-            // Remove the old node
-            iter = nodes.erase(iter);
-        }
-
-        // Stop iteration when the number of nodes is over the designated size or new node is not generated
-        if (nodes.size() == prev_size) {
-            break;
-        }
-    }
-
-    return find_keypoints_with_max_response(nodes);
-}
-
-std::list<orb_extractor_node> orb_extractor::initialize_nodes(const std::vector<cv::KeyPoint>& keypts_to_distribute,
-                                                              const int min_x, const int max_x, const int min_y, const int max_y) const {
-    // The aspect ratio of the target area for keypoint detection
-    const auto ratio = static_cast<double>(max_x - min_x) / (max_y - min_y);
-    // The width and height of the patches allocated to the initial node
-    double delta_x, delta_y;
-    // The number of columns or rows
-    unsigned int num_x_grid, num_y_grid;
-
-    if (ratio > 1) {
-        // If the aspect ratio is greater than 1, the patches are made in a horizontal direction
-        num_x_grid = std::round(ratio);
-        num_y_grid = 1;
-        delta_x = static_cast<double>(max_x - min_x) / num_x_grid;
-        delta_y = max_y - min_y;
-    }
-    else {
-        // If the aspect ratio is equal to or less than 1, the patches are made in a vertical direction
-        num_x_grid = 1;
-        num_y_grid = std::round(1 / ratio);
-        delta_x = max_x - min_y;
-        delta_y = static_cast<double>(max_y - min_y) / num_y_grid;
-    }
-
-    // The number of the initial nodes
-    const unsigned int num_initial_nodes = num_x_grid * num_y_grid;
-
-    // A list of node
-    std::list<orb_extractor_node> nodes;
-
-    // Initial node objects
-    std::vector<orb_extractor_node*> initial_nodes;
-    initial_nodes.resize(num_initial_nodes);
-
-    // Create initial node substances
-    for (unsigned int i = 0; i < num_initial_nodes; ++i) {
-        orb_extractor_node node;
-
-        // x / y index of the node's patch in the grid
-        const unsigned int ix = i % num_x_grid;
-        const unsigned int iy = i / num_x_grid;
-
-        node.pt_begin_ = cv::Point2i(delta_x * ix, delta_y * iy);
-        node.pt_end_ = cv::Point2i(delta_x * (ix + 1), delta_y * (iy + 1));
-        node.keypts_.reserve(keypts_to_distribute.size());
-
-        nodes.push_back(node);
-        initial_nodes.at(i) = &nodes.back();
-    }
-
-    // Assign all keypoints to initial nodes which own keypoint's position
-    for (const auto& keypt : keypts_to_distribute) {
-        // x / y index of the patch where the keypt is placed
-        const unsigned int ix = keypt.pt.x / delta_x;
-        const unsigned int iy = keypt.pt.y / delta_y;
-
-        const unsigned int node_idx = ix + iy * num_x_grid;
-        initial_nodes.at(node_idx)->keypts_.push_back(keypt);
-    }
-
-    auto iter = nodes.begin();
-    while (iter != nodes.end()) {
-        // Remove empty nodes
-        if (iter->keypts_.empty()) {
-            iter = nodes.erase(iter);
-            continue;
-        }
-        iter++;
-    }
-
-    return nodes;
-}
-
-void orb_extractor::assign_child_nodes(const std::array<orb_extractor_node, 4>& child_nodes, std::list<orb_extractor_node>& nodes,
-                                       std::vector<std::pair<int, orb_extractor_node*>>& leaf_nodes) const {
-    for (const auto& child_node : child_nodes) {
-        if (child_node.keypts_.empty()) {
-            continue;
-        }
-        nodes.push_front(child_node);
-        if (child_node.keypts_.size() == 1) {
-            continue;
-        }
-        leaf_nodes.emplace_back(std::make_pair(child_node.keypts_.size(), &nodes.front()));
-        // Keep the self iterator to remove from std::list randomly
-        nodes.front().iter_ = nodes.begin();
-    }
-}
-
-std::vector<cv::KeyPoint> orb_extractor::find_keypoints_with_max_response(std::list<orb_extractor_node>& nodes) const {
-    // A vector contains result keypoint
-    std::vector<cv::KeyPoint> result_keypts;
-    result_keypts.reserve(nodes.size());
-
-    // Store keypoints which has maximum response in the node patch
-    for (auto& node : nodes) {
-        auto& node_keypts = node.keypts_;
-        auto& keypt = node_keypts.at(0);
-        double max_response = keypt.response;
-
-        for (unsigned int k = 1; k < node_keypts.size(); ++k) {
-            if (node_keypts.at(k).response > max_response) {
-                keypt = node_keypts.at(k);
-                max_response = node_keypts.at(k).response;
-            }
-        }
-
-        result_keypts.push_back(keypt);
-    }
-
-    return result_keypts;
 }
 
 void orb_extractor::compute_orientation(const cv::Mat& image, std::vector<cv::KeyPoint>& keypts) const {
@@ -416,6 +463,33 @@ void orb_extractor::correct_keypoint_scale(std::vector<cv::KeyPoint>& keypts_at_
     }
 }
 
+void orb_extractor::refine_keypoints_to_full_resolution(std::vector<cv::KeyPoint>& keypts_at_level, const unsigned int level) const {
+    if (level == 0 || keypts_at_level.empty()) {
+        return;
+    }
+    const float scale_at_level = orb_params_->scale_factors_.at(level);
+
+    std::vector<cv::Point2f> refined_pts;
+    refined_pts.reserve(keypts_at_level.size());
+    for (const auto& keypt : keypts_at_level) {
+        refined_pts.push_back(keypt.pt);
+    }
+
+    // The search window covers the quantization error of the level
+    const int half_win_size = std::max(2, cvCeil(scale_at_level));
+    cv::cornerSubPix(image_pyramid_.at(0), refined_pts, cv::Size(half_win_size, half_win_size), cv::Size(-1, -1),
+                     cv::TermCriteria(cv::TermCriteria::EPS + cv::TermCriteria::COUNT, 10, 0.01));
+
+    // Keep the original position if the refinement drifted away (e.g. on an edge)
+    const float max_sq_shift = scale_at_level * scale_at_level;
+    for (unsigned int idx = 0; idx < keypts_at_level.size(); ++idx) {
+        const cv::Point2f shift = refined_pts.at(idx) - keypts_at_level.at(idx).pt;
+        if (shift.dot(shift) <= max_sq_shift) {
+            keypts_at_level.at(idx).pt = refined_pts.at(idx);
+        }
+    }
+}
+
 float orb_extractor::ic_angle(const cv::Mat& image, const cv::Point2f& point) const {
     return orb_impl_.ic_angle(image, point);
 }
@@ -4,6 +4,11 @@
 #include "stella_vslam/feature/orb_params.h"
 #include "stella_vslam/feature/orb_extractor_node.h"
 #include "stella_vslam/feature/orb_impl.h"
+#include "stella_vslam/feature/orb_extraction_budget.h"
+
+#include <memory>
+#include <utility>
+#include <vector>
 
 #include <opencv2/core/mat.hpp>
 #include <opencv2/core/types.hpp>
@@ -11,22 +16,46 @@
 namespace stella_vslam {
 namespace feature {
 
+class cubemap_extractor;
+
 class orb_extractor {
 public:
     orb_extractor() = delete;
 
     //! Constructor
+    //! (NOTE: use_opencl is effective only when built with USE_OPENCL_ORB and an OpenCL device is available)
     orb_extractor(const orb_params* orb_params,
                   const unsigned int max_num_keypts,
-                  const std::vector<std::vector<float>>& mask_rects = {});
+                  const std::vector<std::vector<float>>& mask_rects = {},
+                  const bool use_opencl = false);
 
     //! Destructor
-    virtual ~orb_extractor() = default;
+    virtual ~orb_extractor();
 
     //! Extract keypoints and each descriptor of them
     void extract(const cv::_InputArray& in_image, const cv::_InputArray& in_image_mask,
                  std::vector<cv::KeyPoint>& keypts, const cv::_OutputArray& out_descriptors);
 
+    //! Enable the latency-budget mode, which adapts the settings to keep each extraction within budget_ms
+    //! (NOTE: budget_ms = 0 disables the mode and restores the full settings)
+    void set_time_budget(const double budget_ms, const unsigned int num_timing_records = 5);
+
+    //! Get the settings used for the last extraction
+    const orb_extraction_settings& get_extraction_settings() const { return settings_; }
+
+    //! Extract keypoints only at the pyramid levels from first_level (i.e. on the downscaled images),
+    //! and refine their positions to subpixel accuracy on the full-resolution image if refine_to_full_resolution is true
+    //! (NOTE: first_level = 0 restores the extraction from the full-resolution image)
+    void set_first_level(const unsigned int first_level, const bool refine_to_full_resolution = true);
+
+    //! Get the first pyramid level where keypoints are extracted
+    unsigned int get_first_level() const { return first_level_; }
+
+    //! Extract the keypoints of the equirectangular images on the faces of a cube map (see cubemap_extractor),
+    //! to which the time budget and the first level are also applied
+    //! (NOTE: num_faces = 0 restores the extraction on the whole image)
+    void set_cubemap_extraction(const unsigned int num_faces, const unsigned int face_size = 0, const double face_fov_deg = 95.0);
+
     //! parameters for ORB extraction
     const orb_params* orb_params_;
 
@@ -47,24 +76,13 @@ private:
     //! Compute image pyramid
     void compute_image_pyramid(const cv::Mat& image);
 
-    //! Compute fast keypoints for cells in each image pyramid
-    void compute_fast_keypoints(std::vector<std::vector<cv::KeyPoint>>& all_keypts, const cv::Mat& mask) const;
-
-    //! Pick computed keypoints on the image uniformly
-    std::vector<cv::KeyPoint> distribute_keypoints_via_tree(const std::vector<cv::KeyPoint>& keypts_to_distribute,
-                                                            int min_x, int max_x, int min_y, int max_y,
-                                                            float inv_scale_factor) const;
+#ifdef USE_OPENCL_ORB
+    //! Compute image pyramid and blurred images on the OpenCL device
+    void compute_image_pyramid_opencl(const cv::Mat& image);
+#endif
 
-    //! Initialize nodes that used for keypoint distribution tree
-    std::list<orb_extractor_node> initialize_nodes(const std::vector<cv::KeyPoint>& keypts_to_distribute,
-                                                   int min_x, int max_x, int min_y, int max_y) const;
-
-    //! Assign child nodes to the all node list
-    void assign_child_nodes(const std::array<orb_extractor_node, 4>& child_nodes, std::list<orb_extractor_node>& nodes,
-                            std::vector<std::pair<int, orb_extractor_node*>>& leaf_nodes) const;
-
-    //! Find keypoint which has maximum value of response
-    std::vector<cv::KeyPoint> find_keypoints_with_max_response(std::list<orb_extractor_node>& nodes) const;
+    //! Compute fast keypoints for cells in each image pyramid
+    void compute_fast_keypoints(std::vector<std::vector<cv::KeyPoint>>& all_keypts, const cv::Mat& mask);
 
     //! Compute orientation for each keypoint
     void compute_orientation(const cv::Mat& image, std::vector<cv::KeyPoint>& keypts) const;
@@ -72,6 +90,9 @@ private:
     //! Correct keypoint's position to comply with the scale
     void correct_keypoint_scale(std::vector<cv::KeyPoint>& keypts_at_level, const unsigned int level) const;
 
+    //! Refine positions of the keypoints (already corrected to the scale) on the full-resolution image
+    void refine_keypoints_to_full_resolution(std::vector<cv::KeyPoint>& keypts_at_level, const unsigned int level) const;
+
     //! Compute the gradient direction of pixel intensity in a circle around the point
     float ic_angle(const cv::Mat& image, const cv::Point2f& point) const;
 
@@ -81,16 +102,59 @@ private:
     //! Compute orb descriptor of a keypoint
     void compute_orb_descriptor(const cv::KeyPoint& keypt, const cv::Mat& image, uchar* desc) const;
 
-    //! Size of node occupied by one feature point
+    //! Size of node occupied by one feature point in the full settings
     unsigned int min_size_;
 
+    //! Settings used for the last (or the ongoing) extraction
+    orb_extraction_settings settings_;
+    //! Controller of the latency-budget mode (nullptr if disabled)
+    std::unique_ptr<orb_extraction_budget> budget_ = nullptr;
+
+    //! First pyramid level where keypoints are extracted
+    unsigned int first_level_ = 0;
+    //! Refine the keypoints extracted on the downscaled images to the full resolution or not
+    bool refine_to_full_resolution_ = false;
+
     //! size of maximum ORB patch radius
     static constexpr unsigned int orb_patch_radius_ = 19;
 
+    //! Extractor on the faces of a cube map (nullptr if disabled)
+    std::unique_ptr<cubemap_extractor> cubemap_;
+
     //! rectangle mask has been already initialized or not
     bool mask_is_initialized_ = false;
     cv::Mat rect_mask_;
 
+    //! Buffers reused across frames (sized to the number of levels in the constructor)
+    //! Blurred images used for ORB description
+    std::vector<cv::Mat> blurred_image_pyramid_;
+    //! Keypoints at each level
+    std::vector<std::vector<cv::KeyPoint>> all_keypts_;
+    //! FAST keypoints at each level before distribution
+    std::vector<std::vector<cv::KeyPoint>> keypts_to_distribute_;
+    //! Cell of an image pyramid level where FAST is computed
+    struct fast_cell {
+        unsigned int level_;
+        //! range of the cell in the level (including the overlap)
+        unsigned int min_x_, max_x_, min_y_, max_y_;
+    };
+    //! Cells of all the levels (sorted by level)
+    std::vector<fast_cell> fast_cells_;
+    //! Range of the cells of each level in fast_cells_
+    std::vector<std::pair<unsigned int, unsigned int>> fast_cell_ranges_;
+    //! FAST keypoints in each cell (written by one thread only)
+    std::vector<std::vector<cv::KeyPoint>> keypts_in_cells_;
+    //! Offset of each level in the output descriptor matrix
+    std::vector<unsigned int> descriptor_offsets_;
+
+    //! Compute the image pyramid and the blurred images on the OpenCL device or not
+    bool use_opencl_ = false;
+#ifdef USE_OPENCL_ORB
+    //! Device-side buffers of the image pyramid and the blurred images
+    std::vector<cv::UMat> image_pyramid_umat_;
+    std::vector<cv::UMat> blurred_image_pyramid_umat_;
+#endif
+
     orb_impl orb_impl_;
 };
 
@@ -1,5 +1,8 @@
 #include "stella_vslam/feature/orb_extractor_node.h"
 
+#include <algorithm>
+#include <cmath>
+
 namespace stella_vslam {
 namespace feature {
 
@@ -49,5 +52,156 @@ std::array<orb_extractor_node, 4> orb_extractor_node::divide_node() {
     return child_nodes;
 }
 
+namespace {
+
+//! Node of the quadtree which refers to a range of the index array
+struct index_range_node {
+    //! Range of the index array
+    unsigned int first_, last_;
+    //! Begin and end of the allocated area on the image
+    cv::Point2i pt_begin_, pt_end_;
+};
+
+} // namespace
+
+void distribute_keypoints_in_place(const std::vector<cv::KeyPoint>& keypts_to_distribute,
+                                   const int min_x, const int max_x, const int min_y, const int max_y,
+                                   const unsigned int min_size, const float scale_factor,
+                                   std::vector<cv::KeyPoint>& distributed_keypts) {
+    distributed_keypts.clear();
+    if (keypts_to_distribute.empty()) {
+        return;
+    }
+
+    // Initial nodes which divide the area along its longer side
+    const auto ratio = static_cast<double>(max_x - min_x) / (max_y - min_y);
+    double delta_x, delta_y;
+    unsigned int num_x_grid, num_y_grid;
+    if (ratio > 1) {
+        num_x_grid = std::round(ratio);
+        num_y_grid = 1;
+        delta_x = static_cast<double>(max_x - min_x) / num_x_grid;
+        delta_y = max_y - min_y;
+    }
+    else {
+        num_x_grid = 1;
+        num_y_grid = std::round(1 / ratio);
+        delta_x = max_x - min_y;
+        delta_y = static_cast<double>(max_y - min_y) / num_y_grid;
+    }
+    const unsigned int num_initial_nodes = num_x_grid * num_y_grid;
+
+    // Sort the keypoint indices by the initial node (counting sort)
+    std::vector<unsigned int> node_indices(keypts_to_distribute.size());
+    std::vector<unsigned int> offsets(num_initial_nodes + 1, 0);
+    for (unsigned int idx = 0; idx < keypts_to_distribute.size(); ++idx) {
+        const auto& keypt = keypts_to_distribute.at(idx);
+        const unsigned int ix = keypt.pt.x / delta_x;
+        const unsigned int iy = keypt.pt.y / delta_y;
+        node_indices.at(idx) = ix + iy * num_x_grid;
+        ++offsets.at(node_indices.at(idx) + 1);
+    }
+    for (unsigned int i = 0; i < num_initial_nodes; ++i) {
+        offsets.at(i + 1) += offsets.at(i);
+    }
+    std::vector<unsigned int> indices(keypts_to_distribute.size());
+    {
+        std::vector<unsigned int> cursors(offsets.begin(), offsets.end() - 1);
+        for (unsigned int idx = 0; idx < keypts_to_distribute.size(); ++idx) {
+            indices.at(cursors.at(node_indices.at(idx))++) = idx;
+        }
+    }
+
+    std::vector<index_range_node> nodes;
+    nodes.reserve(num_initial_nodes);
+    for (unsigned int i = 0; i < num_initial_nodes; ++i) {
+        if (offsets.at(i) == offsets.at(i + 1)) {
+            continue;
+        }
+        const unsigned int ix = i % num_x_grid;
+        const unsigned int iy = i / num_x_grid;
+        nodes.push_back({offsets.at(i), offsets.at(i + 1),
+                         cv::Point2i(delta_x * ix, delta_y * iy),
+                         cv::Point2i(delta_x * (ix + 1), delta_y * (iy + 1))});
+    }
+
+    // Pick the keypoint which has the maximum response in the node
+    // (the first one of the input order is taken if tied, as the quadtree does)
+    auto pick_keypoint = [&](const index_range_node& node) {
+        unsigned int best_idx = indices.at(node.first_);
+        for (unsigned int i = node.first_ + 1; i < node.last_; ++i) {
+            const unsigned int idx = indices.at(i);
+            const float response = keypts_to_distribute.at(idx).response;
+            const float best_response = keypts_to_distribute.at(best_idx).response;
+            if (best_response < response || (response == best_response && idx < best_idx)) {
+                best_idx = idx;
+            }
+        }
+        distributed_keypts.push_back(keypts_to_distribute.at(best_idx));
+    };
+
+    // Divide the nodes level by level
+    // (NOTE: the quadtree stops dividing when a whole level does not increase the number of nodes,
+    //        so the levels are processed synchronously to give the same leaf nodes)
+    std::vector<index_range_node> child_nodes;
+    while (!nodes.empty()) {
+        child_nodes.clear();
+        unsigned int num_divided_nodes = 0;
+
+        for (const auto& node : nodes) {
+            const unsigned int area = (node.pt_end_.x - node.pt_begin_.x) * (node.pt_end_.y - node.pt_begin_.y);
+            if (node.last_ - node.first_ == 1 || area * scale_factor * scale_factor <= min_size) {
+                pick_keypoint(node);
+                continue;
+            }
+            ++num_divided_nodes;
+
+            // Half width/height of the allocated patch area (same as orb_extractor_node::divide_node)
+            const unsigned int half_x = cvCeil((node.pt_end_.x - node.pt_begin_.x) / 2.0);
+            const unsigned int half_y = cvCeil((node.pt_end_.y - node.pt_begin_.y) / 2.0);
+            const float center_x = node.pt_begin_.x + half_x;
+            const float center_y = node.pt_begin_.y + half_y;
+
+            // Partition the index range into the upper/lower halves, then into the four quadrants
+            const auto first = indices.begin() + node.first_;
+            const auto last = indices.begin() + node.last_;
+            const auto mid_y = std::partition(first, last, [&](const unsigned int idx) {
+                return keypts_to_distribute[idx].pt.y < center_y;
+            });
+            const auto is_left = [&](const unsigned int idx) {
+                return keypts_to_distribute[idx].pt.x < center_x;
+            };
+            const auto mid_x_upper = std::partition(first, mid_y, is_left);
+            const auto mid_x_lower = std::partition(mid_y, last, is_left);
+
+            const auto pt_center = cv::Point2i(node.pt_begin_.x + half_x, node.pt_begin_.y + half_y);
+            const std::array<index_range_node, 4> quadrants{{
+                {node.first_, static_cast<unsigned int>(mid_x_upper - indices.begin()),
+                 node.pt_begin_, pt_center},
+                {static_cast<unsigned int>(mid_x_upper - indices.begin()), static_cast<unsigned int>(mid_y - indices.begin()),
+                 cv::Point2i(pt_center.x, node.pt_begin_.y), cv::Point2i(node.pt_end_.x, pt_center.y)},
+                {static_cast<unsigned int>(mid_y - indices.begin()), static_cast<unsigned int>(mid_x_lower - indices.begin()),
+                 cv::Point2i(node.pt_begin_.x, pt_center.y), cv::Point2i(pt_center.x, node.pt_end_.y)},
+                {static_cast<unsigned int>(mid_x_lower - indices.begin()), node.last_,
+                 pt_center, node.pt_end_},
+            }};
+            for (const auto& quadrant : quadrants) {
+                if (quadrant.first_ != quadrant.last_) {
+                    child_nodes.push_back(quadrant);
+                }
+            }
+        }
+
+        // Stop when the number of nodes has not increased
+        if (child_nodes.size() == num_divided_nodes) {
+            for (const auto& node : child_nodes) {
+                pick_keypoint(node);
+            }
+            break;
+        }
+        nodes.swap(child_nodes);
+    }
+}
+
 } // namespace feature
 } // namespace stella_vslam
@@ -3,7 +3,7 @@
 
 #include <array>
 #include <list>
-#include <array>
+#include <vector>
 
 #include <opencv2/core/types.hpp>
 
@@ -33,6 +33,24 @@ public:
     std::list<orb_extractor_node>::iterator iter_;
 };
 
+/**
+ * Pick the keypoints uniformly via the quadtree without building the nodes
+ * The keypoints are partitioned in place over one index array,
+ * and the result is equivalent (except for the order) to the quadtree of orb_extractor_node.
+ * @param keypts_to_distribute keypoints relative to (min_x, min_y)
+ * @param min_x
+ * @param max_x
+ * @param min_y
+ * @param max_y
+ * @param min_size size of node occupied by one feature point
+ * @param scale_factor scale factor of the pyramid level
+ * @param distributed_keypts the keypoint which has the maximum response in each of the leaf nodes
+ */
+void distribute_keypoints_in_place(const std::vector<cv::KeyPoint>& keypts_to_distribute,
+                                   const int min_x, const int max_x, const int min_y, const int max_y,
+                                   const unsigned int min_size, const float scale_factor,
+                                   std::vector<cv::KeyPoint>& distributed_keypts);
+
 } // namespace feature
 } // namespace stella_vslam
 
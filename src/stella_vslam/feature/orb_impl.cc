@@ -37,18 +37,219 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "stella_vslam/feature/orb_point_pairs.h"
 #include "stella_vslam/util/trigonometric.h"
 
-#ifdef USE_SSE_ORB
+// SSE3 is used only if it is enabled by USE_SSE_ORB and the target processor supports it
+#if defined(USE_SSE_ORB)                                              \
+    && ((defined _MSC_VER && defined _M_X64)                          \
+        || (defined __GNUC__ && defined __x86_64__ && defined __SSE3__) \
+        || CV_SSE3)
+#define STELLA_VSLAM_ORB_SSE3
+#endif
+
+// AVX2 is compiled for the functions with the target attribute, and selected at runtime
+#if defined __GNUC__ && (defined __x86_64__ || defined __i386__)
+#define STELLA_VSLAM_ORB_AVX2
+#endif
+
+// NEON is always available on AArch64
+#if defined __aarch64__ && defined __ARM_NEON
+#define STELLA_VSLAM_ORB_NEON
+#endif
+
+#ifdef STELLA_VSLAM_ORB_SSE3
 #ifdef _MSC_VER
 #include <intrin.h>
 #else
 #include <x86intrin.h>
 #endif
-#endif // USE_SSE_ORB
+#endif // STELLA_VSLAM_ORB_SSE3
+
+#ifdef STELLA_VSLAM_ORB_AVX2
+#include <immintrin.h>
+#endif // STELLA_VSLAM_ORB_AVX2
+
+#ifdef STELLA_VSLAM_ORB_NEON
+#include <arm_neon.h>
+#endif // STELLA_VSLAM_ORB_NEON
 
 namespace stella_vslam {
 namespace feature {
 
-orb_impl::orb_impl() {
+namespace {
+
+//! Number of the bytes loaded for each row of the patch (the patch is 31 pixels wide)
+constexpr int moment_row_size = 32;
+
+#ifdef STELLA_VSLAM_ORB_AVX2
+__attribute__((target("avx2"))) inline int horizontal_sum_avx2(const __m256i v) {
+    __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    sum = _mm_hadd_epi32(sum, sum);
+    sum = _mm_hadd_epi32(sum, sum);
+    return _mm_cvtsi128_si32(sum);
+}
+
+__attribute__((target("avx2"))) void compute_moments_avx2(const uchar* const center, const int step, const int16_t* const weights,
+                                                          int& m_01, int& m_10) {
+    const uchar* const begin = center - orb_impl::fast_half_patch_size_;
+    __m256i acc_10 = _mm256_setzero_si256();
+    __m256i acc_01 = _mm256_setzero_si256();
+
+    // center row
+    {
+        const __m256i row = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin));
+        const __m256i row_lo = _mm256_cvtepu8_epi16(_mm256_castsi256_si128(row));
+        const __m256i row_hi = _mm256_cvtepu8_epi16(_mm256_extracti128_si256(row, 1));
+        const int16_t* const weights_u = weights;
+        acc_10 = _mm256_add_epi32(acc_10, _mm256_madd_epi16(row_lo, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(weights_u))));
+        acc_10 = _mm256_add_epi32(acc_10, _mm256_madd_epi16(row_hi, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(weights_u + 16))));
+    }
+
+    // the rows above and below the center
+    for (int v = 1; v <= orb_impl::fast_half_patch_size_; ++v) {
+        const __m256i row_plus = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin + v * step));
+        const __m256i row_minus = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin - v * step));
+        const __m256i plus_lo = _mm256_cvtepu8_epi16(_mm256_castsi256_si128(row_plus));
+        const __m256i plus_hi = _mm256_cvtepu8_epi16(_mm256_extracti128_si256(row_plus, 1));
+        const __m256i minus_lo = _mm256_cvtepu8_epi16(_mm256_castsi256_si128(row_minus));
+        const __m256i minus_hi = _mm256_cvtepu8_epi16(_mm256_extracti128_si256(row_minus, 1));
+
+        const int16_t* const weights_u = weights + 2 * v * moment_row_size;
+        const int16_t* const weights_v = weights_u + moment_row_size;
+        acc_10 = _mm256_add_epi32(acc_10, _mm256_madd_epi16(_mm256_add_epi16(plus_lo, minus_lo),
+                                                            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(weights_u))));
+        acc_10 = _mm256_add_epi32(acc_10, _mm256_madd_epi16(_mm256_add_epi16(plus_hi, minus_hi),
+                                                            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(weights_u + 16))));
+        acc_01 = _mm256_add_epi32(acc_01, _mm256_madd_epi16(_mm256_sub_epi16(plus_lo, minus_lo),
+                                                            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(weights_v))));
+        acc_01 = _mm256_add_epi32(acc_01, _mm256_madd_epi16(_mm256_sub_epi16(plus_hi, minus_hi),
+                                                            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(weights_v + 16))));
+    }
+
+    m_01 = horizontal_sum_avx2(acc_01);
+    m_10 = horizontal_sum_avx2(acc_10);
+}
+
+__attribute__((target("avx2"))) void compute_orb_descriptor_avx2(const uchar* const center, const int step,
+                                                                 const float cos_angle, const float sin_angle,
+                                                                 const float* const point_pairs_soa, uchar* desc) {
+    const __m256 cos_v = _mm256_set1_ps(cos_angle);
+    const __m256 sin_v = _mm256_set1_ps(sin_angle);
+    const __m256i step_v = _mm256_set1_epi32(step);
+    const __m256i byte_mask = _mm256_set1_epi32(0xff);
+    // (NOTE: 32-bit words are gathered and masked, since the patch is far enough from the end of the image)
+    const int* const base = reinterpret_cast<const int*>(center);
+
+    for (unsigned int i = 0; i < 32; ++i) {
+        const float* const pairs = point_pairs_soa + 32 * i;
+        const __m256 x_1 = _mm256_loadu_ps(pairs);
+        const __m256 y_1 = _mm256_loadu_ps(pairs + 8);
+        const __m256 x_2 = _mm256_loadu_ps(pairs + 16);
+        const __m256 y_2 = _mm256_loadu_ps(pairs + 24);
+
+        // rotate the point pairs (rounded to the nearest as cvRound)
+        const __m256i row_1 = _mm256_cvtps_epi32(_mm256_add_ps(_mm256_mul_ps(x_1, sin_v), _mm256_mul_ps(y_1, cos_v)));
+        const __m256i col_1 = _mm256_cvtps_epi32(_mm256_sub_ps(_mm256_mul_ps(x_1, cos_v), _mm256_mul_ps(y_1, sin_v)));
+        const __m256i row_2 = _mm256_cvtps_epi32(_mm256_add_ps(_mm256_mul_ps(x_2, sin_v), _mm256_mul_ps(y_2, cos_v)));
+        const __m256i col_2 = _mm256_cvtps_epi32(_mm256_sub_ps(_mm256_mul_ps(x_2, cos_v), _mm256_mul_ps(y_2, sin_v)));
+
+        const __m256i offset_1 = _mm256_add_epi32(_mm256_mullo_epi32(row_1, step_v), col_1);
+        const __m256i offset_2 = _mm256_add_epi32(_mm256_mullo_epi32(row_2, step_v), col_2);
+        const __m256i val_1 = _mm256_and_si256(_mm256_i32gather_epi32(base, offset_1, 1), byte_mask);
+        const __m256i val_2 = _mm256_and_si256(_mm256_i32gather_epi32(base, offset_2, 1), byte_mask);
+
+        // bit k is set if val_1 < val_2 at the k-th pair
+        desc[i] = static_cast<uchar>(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(val_2, val_1))));
+    }
+}
+#endif // STELLA_VSLAM_ORB_AVX2
+
+#ifdef STELLA_VSLAM_ORB_NEON
+inline void load_row_neon(const uchar* const row, int16x8_t& lo, int16x8_t& hi, int16x8_t& lo_2, int16x8_t& hi_2) {
+    const uint8x16_t half_1 = vld1q_u8(row);
+    const uint8x16_t half_2 = vld1q_u8(row + 16);
+    lo = vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(half_1)));
+    hi = vreinterpretq_s16_u16(vmovl_u8(vget_high_u8(half_1)));
+    lo_2 = vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(half_2)));
+    hi_2 = vreinterpretq_s16_u16(vmovl_u8(vget_high_u8(half_2)));
+}
+
+inline int32x4_t multiply_accumulate_neon(int32x4_t acc, const int16x8_t val, const int16_t* const weights) {
+    const int16x8_t w = vld1q_s16(weights);
+    acc = vmlal_s16(acc, vget_low_s16(val), vget_low_s16(w));
+    return vmlal_s16(acc, vget_high_s16(val), vget_high_s16(w));
+}
+
+void compute_moments_neon(const uchar* const center, const int step, const int16_t* const weights,
+                          int& m_01, int& m_10) {
+    const uchar* const begin = center - orb_impl::fast_half_patch_size_;
+    int32x4_t acc_10 = vdupq_n_s32(0);
+    int32x4_t acc_01 = vdupq_n_s32(0);
+
+    // center row
+    {
+        int16x8_t row[4];
+        load_row_neon(begin, row[0], row[1], row[2], row[3]);
+        for (unsigned int k = 0; k < 4; ++k) {
+            acc_10 = multiply_accumulate_neon(acc_10, row[k], weights + 8 * k);
+        }
+    }
+
+    // the rows above and below the center
+    for (int v = 1; v <= orb_impl::fast_half_patch_size_; ++v) {
+        int16x8_t plus[4], minus[4];
+        load_row_neon(begin + v * step, plus[0], plus[1], plus[2], plus[3]);
+        load_row_neon(begin - v * step, minus[0], minus[1], minus[2], minus[3]);
+
+        const int16_t* const weights_u = weights + 2 * v * moment_row_size;
+        const int16_t* const weights_v = weights_u + moment_row_size;
+        for (unsigned int k = 0; k < 4; ++k) {
+            acc_10 = multiply_accumulate_neon(acc_10, vaddq_s16(plus[k], minus[k]), weights_u + 8 * k);
+            acc_01 = multiply_accumulate_neon(acc_01, vsubq_s16(plus[k], minus[k]), weights_v + 8 * k);
+        }
+    }
+
+    m_01 = vaddvq_s32(acc_01);
+    m_10 = vaddvq_s32(acc_10);
+}
+
+void compute_orb_descriptor_neon(const uchar* const center, const int step,
+                                 const float cos_angle, const float sin_angle,
+                                 const float* const point_pairs_soa, uchar* desc) {
+    const float32x4_t cos_v = vdupq_n_f32(cos_angle);
+    const float32x4_t sin_v = vdupq_n_f32(sin_angle);
+    const int32x4_t step_v = vdupq_n_s32(step);
+    alignas(16) int32_t offsets_1[8];
+    alignas(16) int32_t offsets_2[8];
+
+    for (unsigned int i = 0; i < 32; ++i) {
+        const float* const pairs = point_pairs_soa + 32 * i;
+        for (unsigned int h = 0; h < 2; ++h) {
+            const float32x4_t x_1 = vld1q_f32(pairs + 4 * h);
+            const float32x4_t y_1 = vld1q_f32(pairs + 8 + 4 * h);
+            const float32x4_t x_2 = vld1q_f32(pairs + 16 + 4 * h);
+            const float32x4_t y_2 = vld1q_f32(pairs + 24 + 4 * h);
+
+            // rotate the point pairs (rounded to the nearest as cvRound)
+            const int32x4_t row_1 = vcvtnq_s32_f32(vaddq_f32(vmulq_f32(x_1, sin_v), vmulq_f32(y_1, cos_v)));
+            const int32x4_t col_1 = vcvtnq_s32_f32(vsubq_f32(vmulq_f32(x_1, cos_v), vmulq_f32(y_1, sin_v)));
+            const int32x4_t row_2 = vcvtnq_s32_f32(vaddq_f32(vmulq_f32(x_2, sin_v), vmulq_f32(y_2, cos_v)));
+            const int32x4_t col_2 = vcvtnq_s32_f32(vsubq_f32(vmulq_f32(x_2, cos_v), vmulq_f32(y_2, sin_v)));
+
+            vst1q_s32(offsets_1 + 4 * h, vmlaq_s32(col_1, row_1, step_v));
+            vst1q_s32(offsets_2 + 4 * h, vmlaq_s32(col_2, row_2, step_v));
+        }
+
+        int32_t val = 0;
+        for (unsigned int k = 0; k < 8; ++k) {
+            val |= (center[offsets_1[k]] < center[offsets_2[k]]) << k;
+        }
+        desc[i] = static_cast<uchar>(val);
+    }
+}
+#endif // STELLA_VSLAM_ORB_NEON
+
+} // namespace
+
+orb_impl::orb_impl(const bool use_simd) {
     // Preparate  for computation of orientation
     u_max_.resize(fast_half_patch_size_ + 1);
     const unsigned int vmax = std::floor(fast_half_patch_size_ * std::sqrt(2.0) / 2 + 1);
@@ -63,6 +264,39 @@ orb_impl::orb_impl() {
         u_max_.at(v) = v0;
         ++v0;
     }
+
+    if (!use_simd) {
+        return;
+    }
+#ifdef STELLA_VSLAM_ORB_AVX2
+    use_avx2_ = __builtin_cpu_supports("avx2");
+#endif
+#ifdef STELLA_VSLAM_ORB_NEON
+    use_neon_ = true;
+#endif
+    if (!uses_simd()) {
+        return;
+    }
+
+    // rearrange the point pairs to load each coordinate of 8 pairs at once
+    point_pairs_soa_.resize(orb_point_pairs_size);
+    for (unsigned int i = 0; i < orb_point_pairs_size / 32; ++i) {
+        for (unsigned int k = 0; k < 8; ++k) {
+            for (unsigned int c = 0; c < 4; ++c) {
+                point_pairs_soa_.at(32 * i + 8 * c + k) = orb_point_pairs[32 * i + 4 * k + c];
+            }
+        }
+    }
+
+    // weights of u and v in the patch for each row (zero outside of the circle and at the padding)
+    moment_weights_.resize(2 * (fast_half_patch_size_ + 1) * moment_row_size, 0);
+    for (int v = 0; v <= fast_half_patch_size_; ++v) {
+        const int d = (v == 0) ? fast_half_patch_size_ : u_max_.at(v);
+        for (int u = -d; u <= d; ++u) {
+            moment_weights_.at(2 * v * moment_row_size + u + fast_half_patch_size_) = u;
+            moment_weights_.at((2 * v + 1) * moment_row_size + u + fast_half_patch_size_) = v;
+        }
+    }
 }
 
 float orb_impl::ic_angle(const cv::Mat& image, const cv::Point2f& point) const {
@@ -70,6 +304,19 @@ float orb_impl::ic_angle(const cv::Mat& image, const cv::Point2f& point) const {
 
     const uchar* const center = &image.at<uchar>(cvRound(point.y), cvRound(point.x));
 
+#ifdef STELLA_VSLAM_ORB_AVX2
+    if (use_avx2_) {
+        compute_moments_avx2(center, static_cast<int>(image.step1()), moment_weights_.data(), m_01, m_10);
+        return cv::fastAtan2(m_01, m_10);
+    }
+#endif
+#ifdef STELLA_VSLAM_ORB_NEON
+    if (use_neon_) {
+        compute_moments_neon(center, static_cast<int>(image.step1()), moment_weights_.data(), m_01, m_10);
+        return cv::fastAtan2(m_01, m_10);
+    }
+#endif
+
     for (int u = -fast_half_patch_size_; u <= fast_half_patch_size_; ++u) {
         m_10 += u * center[u];
     }
@@ -98,13 +345,20 @@ void orb_impl::compute_orb_descriptor(const cv::KeyPoint& keypt, const cv::Mat&
     const uchar* const center = &image.at<uchar>(cvRound(keypt.pt.y), cvRound(keypt.pt.x));
     const auto step = static_cast<int>(image.step);
 
-#ifdef USE_SSE_ORB
-#if !((defined _MSC_VER && defined _M_X64)                            \
-      || (defined __GNUC__ && defined __x86_64__ && defined __SSE3__) \
-      || CV_SSE3)
-#error "The processor is not compatible with SSE. Please configure the CMake with -DUSE_SSE_ORB=OFF."
+#ifdef STELLA_VSLAM_ORB_AVX2
+    if (use_avx2_) {
+        compute_orb_descriptor_avx2(center, step, cos_angle, sin_angle, point_pairs_soa_.data(), desc);
+        return;
+    }
+#endif
+#ifdef STELLA_VSLAM_ORB_NEON
+    if (use_neon_) {
+        compute_orb_descriptor_neon(center, step, cos_angle, sin_angle, point_pairs_soa_.data(), desc);
+        return;
+    }
 #endif
 
+#ifdef STELLA_VSLAM_ORB_SSE3
     const __m128 _trig1 = _mm_set_ps(cos_angle, sin_angle, cos_angle, sin_angle);
     const __m128 _trig2 = _mm_set_ps(-sin_angle, cos_angle, -sin_angle, cos_angle);
     __m128 _point_pairs;
@@ -4,12 +4,17 @@
 #include <opencv2/core/mat.hpp>
 #include <opencv2/core/types.hpp>
 
+#include <cstdint>
+#include <vector>
+
 namespace stella_vslam {
 namespace feature {
 
 class orb_impl {
 public:
-    orb_impl();
+    //! Constructor
+    //! (NOTE: the SIMD implementation (AVX2 or NEON) is selected at runtime if use_simd is true and the processor supports it)
+    orb_impl(const bool use_simd = true);
     float ic_angle(const cv::Mat& image, const cv::Point2f& point) const;
     void compute_orb_descriptor(const cv::KeyPoint& keypt, const cv::Mat& image, uchar* desc) const;
 
@@ -18,9 +23,21 @@ public:
     //! half size of FAST patch
     static constexpr int fast_half_patch_size_ = fast_patch_size_ / 2;
 
+    //! Whether one of the SIMD implementations is used or not
+    bool uses_simd() const { return use_avx2_ || use_neon_; }
+
 private:
     //! Index limitation that used for calculating of keypoint orientation
     std::vector<int> u_max_;
+
+    //! Use the AVX2 implementation or not
+    bool use_avx2_ = false;
+    //! Use the NEON implementation or not
+    bool use_neon_ = false;
+    //! Point pairs rearranged for SIMD: (X1 x 8, Y1 x 8, X2 x 8, Y2 x 8) for each byte of a descriptor
+    std::vector<float> point_pairs_soa_;
+    //! Weights of the moments for each row of the patch: (u weights x 32, v weights x 32) for each v
+    std::vector<int16_t> moment_weights_;
 };
 
 } // namespace feature
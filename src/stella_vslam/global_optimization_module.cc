@@ -3,26 +3,54 @@
 #include "stella_vslam/tracking_module.h"
 #include "stella_vslam/data/keyframe.h"
 #include "stella_vslam/data/landmark.h"
+#include "stella_vslam/data/landmark_spatial_hash.h"
 #include "stella_vslam/data/map_database.h"
+#include "stella_vslam/data/map_correction.h"
 #include "stella_vslam/match/fuse.h"
 #include "stella_vslam/util/converter.h"
+#include "stella_vslam/util/cpu_time.h"
+#include "stella_vslam/util/keyframe_tracer.h"
+#include "stella_vslam/util/parallel_for.h"
 #include "stella_vslam/util/yaml.h"
 
 #include <spdlog/spdlog.h>
 
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <memory>
+
 namespace stella_vslam {
 
 global_optimization_module::global_optimization_module(data::map_database* map_db, data::bow_database* bow_db,
                                                        data::bow_vocabulary* bow_vocab, const YAML::Node& yaml_node,
                                                        const bool fix_scale)
-    : loop_detector_(new module::loop_detector(bow_db, bow_vocab, util::yaml_optional_ref(yaml_node, "LoopDetector"), fix_scale)),
-      loop_bundle_adjuster_(new module::loop_bundle_adjuster(map_db)),
+    : coalesce_queue_depth_(util::yaml_optional_ref(yaml_node, "LoopDetector")["coalesce_queue_depth"].as<unsigned int>(8)),
+      loop_detector_(new module::loop_detector(bow_db, bow_vocab, util::yaml_optional_ref(yaml_node, "LoopDetector"), fix_scale)),
+      loop_bundle_adjuster_(new module::loop_bundle_adjuster(map_db, util::yaml_optional_ref(yaml_node, "GlobalOptimizer"))),
+      map_merger_(new module::map_merger(map_db, bow_db, bow_vocab, yaml_node, fix_scale)),
+      enable_inter_map_merge_(util::yaml_optional_ref(yaml_node, "GlobalOptimizer")["enable_inter_map_merge"].as<bool>(true)),
       map_db_(map_db),
-      graph_optimizer_(new optimize::graph_optimizer(fix_scale)) {
+      graph_optimizer_(new optimize::graph_optimizer(
+          fix_scale,
+          optimize::load_linear_solver_type(util::yaml_optional_ref(yaml_node, "GlobalOptimizer")["graph_optimizer_linear_solver"].as<std::string>("csparse")))),
+      cpu_budget_(util::yaml_optional_ref(yaml_node, "GlobalOptimizer")),
+      loop_BA_max_deferral_ms_(util::yaml_optional_ref(yaml_node, "GlobalOptimizer")["loop_BA_max_deferral_ms"].as<double>(0.0)),
+      fusion_search_radius_ratio_(util::yaml_optional_ref(yaml_node, "GlobalOptimizer")["fusion_search_radius_ratio"].as<double>(0.1)) {
     spdlog::debug("CONSTRUCT: global_optimization_module");
+    if (cpu_budget_.is_limited()) {
+        spdlog::info("global optimization module is limited to {} of a core", cpu_budget_.get_core_share());
+    }
+    const auto num_validation_threads = util::yaml_optional_ref(yaml_node, "LoopDetector")["num_validation_threads"].as<unsigned int>(2);
+    loop_validation_pool_ = std::make_shared<util::thread_pool>(num_validation_threads);
 }
 
 global_optimization_module::~global_optimization_module() {
+    // the pending validations refer to the loop detector (the pool might be shared with the other modules)
+    for (const auto& pending : pending_loop_detections_) {
+        loop_validation_pool_->wait(pending.future_, util::task_priority_t::Low);
+    }
+    loop_validation_pool_.reset();
     abort_loop_BA();
     if (thread_for_loop_BA_) {
         thread_for_loop_BA_->join();
@@ -30,6 +58,17 @@ global_optimization_module::~global_optimization_module() {
     spdlog::debug("DESTRUCT: global_optimization_module");
 }
 
+void global_optimization_module::set_thread_pool(const std::shared_ptr<util::thread_pool>& thread_pool) {
+    loop_validation_pool_ = thread_pool;
+    thread_pool_ = thread_pool;
+    loop_bundle_adjuster_->set_thread_pool(thread_pool.get());
+}
+
+void global_optimization_module::set_loop_BA_thread_scheduling(const util::thread_scheduling_params& params) {
+    std::lock_guard<std::mutex> lock(mtx_loop_BA_thread_scheduling_);
+    loop_BA_thread_scheduling_ = params;
+}
+
 void global_optimization_module::set_tracking_module(tracking_module* tracker) {
     tracker_ = tracker;
 }
@@ -39,6 +78,14 @@ void global_optimization_module::set_mapping_module(mapping_module* mapper) {
     loop_bundle_adjuster_->set_mapping_module(mapper);
 }
 
+void global_optimization_module::set_metrics_publisher(const std::shared_ptr<publish::metrics_publisher>& metrics_publisher) {
+    loop_bundle_adjuster_->set_metrics_publisher(metrics_publisher);
+}
+
+void global_optimization_module::set_keyframe_tracer(const std::shared_ptr<util::keyframe_tracer>& keyfrm_tracer) {
+    keyfrm_tracer_ = keyfrm_tracer;
+}
+
 void global_optimization_module::enable_loop_detector() {
     spdlog::info("enable loop detector");
     loop_detector_->enable_loop_detector();
@@ -62,6 +109,7 @@ bool global_optimization_module::request_loop_closure(unsigned int keyfrm1_id, u
     loop_closure_is_requested_ = true;
     loop_closure_request_.keyfrm1_id_ = keyfrm1_id;
     loop_closure_request_.keyfrm2_id_ = keyfrm2_id;
+    notify_wakeup();
     return true;
 }
 
@@ -81,18 +129,22 @@ void global_optimization_module::finish_loop_closure_request() {
 }
 
 bool global_optimization_module::loop_closure(const loop_closure_request& request) {
+    // the pending validations might use the keyframes of the request
+    discard_pending_loop_detections();
+
+    module::loop_detection detection;
     {
-        std::lock_guard<std::mutex> lock(data::map_database::mtx_database_);
+        std::lock_guard<util::profiled_mutex> lock(data::map_database::mtx_database_);
         unsigned int curr_keyfrm_id = std::max(request.keyfrm1_id_, request.keyfrm2_id_);
         unsigned int candidate_keyfrm_id = std::min(request.keyfrm1_id_, request.keyfrm2_id_);
         // not to be removed during loop detection and correction
-        cur_keyfrm_ = map_db_->get_keyframe(curr_keyfrm_id);
-        if (cur_keyfrm_ == nullptr) {
+        const auto cur_keyfrm = map_db_->get_keyframe(curr_keyfrm_id);
+        if (cur_keyfrm == nullptr) {
             spdlog::info("keyframe {} not found", curr_keyfrm_id);
             return false;
         }
-        cur_keyfrm_->set_not_to_be_erased();
-        loop_detector_->set_current_keyframe(cur_keyfrm_);
+        cur_keyfrm->set_not_to_be_erased();
+        loop_detector_->set_current_keyframe(cur_keyfrm);
         auto candidate_keyfrm = map_db_->get_keyframe(candidate_keyfrm_id);
         if (candidate_keyfrm == nullptr) {
             spdlog::info("candidate keyframe {} not found", candidate_keyfrm_id);
@@ -101,15 +153,15 @@ bool global_optimization_module::loop_closure(const loop_closure_request& reques
         loop_detector_->add_loop_candidate(candidate_keyfrm);
 
         // validate candidates and select ONE candidate from them
-        if (!loop_detector_->validate_candidates()) {
+        if (!loop_detector_->validate_candidates(detection)) {
             // could not find
             // allow the removal of the current keyframe
-            cur_keyfrm_->set_to_be_erased();
+            cur_keyfrm->set_to_be_erased();
             return false;
         }
     }
 
-    correct_loop();
+    correct_loop(detection);
     finish_loop_closure_request();
     return true;
 }
@@ -120,11 +172,13 @@ void global_optimization_module::run() {
     is_terminated_ = false;
 
     while (true) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        // wait until a keyframe is queued or any request is made
+        wait_for_wakeup(true);
 
         // check if termination is requested
         if (terminate_is_requested()) {
             // terminate and break
+            discard_pending_loop_detections();
             terminate();
             break;
         }
@@ -136,67 +190,218 @@ void global_optimization_module::run() {
 
         // check if pause is requested
         if (pause_is_requested()) {
+            // the validations can not run during pause
+            discard_pending_loop_detections();
             // pause and wait
             pause();
             // check if termination or reset is requested during pause
             while (is_paused() && !terminate_is_requested() && !reset_is_requested()) {
-                std::this_thread::sleep_for(std::chrono::milliseconds(3));
+                wait_for_wakeup(false);
             }
         }
 
         // check if reset is requested
         if (reset_is_requested()) {
             // reset and continue
+            discard_pending_loop_detections();
             reset();
             continue;
         }
 
-        // if the queue is empty, the following process is not needed
-        if (!keyframe_is_queued()) {
-            continue;
+        const auto start = std::chrono::steady_clock::now();
+
+        // detection stage: detect the loop candidates of all of the queued keyframes,
+        // then validate them in the background
+        detect_loop_candidates_of_queued_keyframes();
+
+        // correction stage: the loops are corrected one by one in the order of the keyframes
+        if (!pending_loop_detections_.empty()) {
+            correct_loop_of_oldest_pending_keyframe();
+        }
+
+        if (cpu_budget_.is_limited()) {
+            const double elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            sleep_interruptibly(cpu_budget_.get_rest_ms(elapsed_ms));
         }
+    }
+
+    spdlog::info("terminate global optimization module");
+}
+
+void global_optimization_module::start_offline() {
+    spdlog::info("start global optimization module (offline)");
+
+    is_offline_ = true;
+    std::lock_guard<std::mutex> lock(mtx_terminate_);
+    is_terminated_ = false;
+}
 
-        // dequeue the keyframe from the queue -> cur_keyfrm_
+void global_optimization_module::process_queued_keyframes() {
+    // (the requests have been carried out when they were made, see async_pause(), async_reset() and async_terminate())
+    if (is_paused() || is_terminated()) {
+        return;
+    }
+
+    if (loop_closure_is_requested()) {
+        loop_closure(get_loop_closure_request());
+    }
+
+    detect_loop_candidates_of_queued_keyframes();
+    // correct all of the loops before the next frame, so that the result does not depend on the timing of the validations
+    while (!pending_loop_detections_.empty()) {
+        correct_loop_of_oldest_pending_keyframe();
+    }
+}
+
+void global_optimization_module::detect_loop_candidates_of_queued_keyframes() {
+    while (true) {
+        std::shared_ptr<data::keyframe> keyfrm;
+        bool is_coalesced = false;
         {
             std::lock_guard<std::mutex> lock(mtx_keyfrm_queue_);
-            cur_keyfrm_ = keyfrms_queue_.front();
+            if (keyfrms_queue_.empty()) {
+                break;
+            }
+            // if the queue is deep, the keyframe followed by the next one is only registered to the BoW database,
+            // because the back-to-back keyframes observe almost the same scene
+            is_coalesced = 0 < coalesce_queue_depth_ && coalesce_queue_depth_ < keyfrms_queue_.size()
+                           && keyfrms_queue_.front()->id_ + 1 == (*std::next(keyfrms_queue_.begin()))->id_;
+            keyfrm = keyfrms_queue_.front();
             keyfrms_queue_.pop_front();
         }
+        if (keyfrm_tracer_) {
+            keyfrm_tracer_->record(keyfrm->id_, util::keyframe_stage_t::LoopCheckStarted);
+        }
 
-        {
-            std::lock_guard<std::mutex> lock(data::map_database::mtx_database_);
-            // not to be removed during loop detection and correction
-            cur_keyfrm_->set_not_to_be_erased();
-
-            // pass the current keyframe to the loop detector
-            loop_detector_->set_current_keyframe(cur_keyfrm_);
-
-            // detect some loop candidate with BoW
-            if (!loop_detector_->detect_loop_candidates()) {
-                // could not find
-                // allow the removal of the current keyframe
-                cur_keyfrm_->set_to_be_erased();
-                continue;
+        std::lock_guard<util::profiled_mutex> lock(data::map_database::mtx_database_);
+        // pass the current keyframe to the loop detector
+        loop_detector_->set_current_keyframe(keyfrm);
+
+        if (is_coalesced) {
+            SPDLOG_TRACE("global_optimization_module: coalesce keyframe {}", keyfrm->id_);
+            loop_detector_->skip_loop_detection();
+            if (keyfrm_tracer_) {
+                keyfrm_tracer_->record(keyfrm->id_, util::keyframe_stage_t::LoopChecked);
             }
+            continue;
+        }
 
-            // validate candidates and select ONE candidate from them
-            if (!loop_detector_->validate_candidates()) {
-                // could not find
-                // allow the removal of the current keyframe
-                cur_keyfrm_->set_to_be_erased();
-                continue;
+        // detect some loop candidate with BoW
+        if (!loop_detector_->detect_loop_candidates()) {
+            if (keyfrm_tracer_) {
+                keyfrm_tracer_->record(keyfrm->id_, util::keyframe_stage_t::LoopChecked);
             }
+            continue;
         }
 
-        correct_loop();
+        launch_loop_validation(keyfrm, loop_detector_->get_loop_candidates());
+    }
+}
+
+void global_optimization_module::launch_loop_validation(const std::shared_ptr<data::keyframe>& keyfrm,
+                                                        const std::unordered_set<std::shared_ptr<data::keyframe>>& loop_candidates) {
+    // not to be removed during loop detection and correction
+    keyfrm->set_not_to_be_erased();
+    for (const auto& candidate : loop_candidates) {
+        candidate->set_not_to_be_erased();
     }
 
-    spdlog::info("terminate global optimization module");
+    pending_loop_detection pending;
+    pending.cur_keyfrm_ = keyfrm;
+    pending.loop_candidates_ = loop_candidates;
+    pending.num_loop_corrections_ = num_loop_corrections_;
+    // (NOTE: the validation does not lock the map database, because it accesses the keyframes and the landmarks through their own mutexes,
+    //  and the keyframes used by it are not removed)
+    const auto loop_detector = loop_detector_.get();
+    pending.future_ = loop_validation_pool_->submit(
+        [loop_detector, keyfrm, loop_candidates]() -> std::shared_ptr<module::loop_detection> {
+            std::shared_ptr<module::loop_detection> detection(new module::loop_detection());
+            if (!loop_detector->validate_candidates(keyfrm, loop_candidates, *detection)) {
+                return std::shared_ptr<module::loop_detection>(nullptr);
+            }
+            return detection;
+        },
+        util::task_priority_t::Low);
+    pending_loop_detections_.push_back(std::move(pending));
+}
+
+void global_optimization_module::correct_loop_of_oldest_pending_keyframe() {
+    auto pending = std::move(pending_loop_detections_.front());
+    pending_loop_detections_.pop_front();
+    loop_validation_pool_->wait(pending.future_, util::task_priority_t::Low);
+    const auto detection = pending.future_.get();
+
+    {
+        std::lock_guard<util::profiled_mutex> lock(data::map_database::mtx_database_);
+
+        if (detection && pending.num_loop_corrections_ != num_loop_corrections_) {
+            // the map has been corrected during the validation, then the estimated Sim3 is not valid
+            // if the loop has been corrected recently, cannot perfrom the loop correction
+            if (pending.cur_keyfrm_->id_ < loop_detector_->get_loop_correct_keyframe_id() + 10) {
+                release_pending_loop_detection(pending, nullptr);
+                if (keyfrm_tracer_) {
+                    keyfrm_tracer_->record(pending.cur_keyfrm_->id_, util::keyframe_stage_t::LoopChecked);
+                }
+                return;
+            }
+            // otherwise, validate again in the corrected map (the keyframes are still protected)
+            launch_loop_validation(pending.cur_keyfrm_, pending.loop_candidates_);
+            // keep the order of the keyframes
+            pending_loop_detections_.splice(pending_loop_detections_.begin(), pending_loop_detections_, std::prev(pending_loop_detections_.end()));
+            return;
+        }
+
+        // if could not find, allow the removal of the current keyframe and all of the candidates
+        release_pending_loop_detection(pending, detection ? detection->selected_candidate_ : nullptr);
+        if (keyfrm_tracer_) {
+            keyfrm_tracer_->record(pending.cur_keyfrm_->id_, util::keyframe_stage_t::LoopChecked);
+        }
+        if (!detection) {
+            return;
+        }
+    }
+
+    correct_loop(*detection);
+}
+
+void global_optimization_module::release_pending_loop_detection(const pending_loop_detection& pending,
+                                                                const std::shared_ptr<data::keyframe>& selected_candidate) const {
+    // the keyframes used by the other pending detections are still protected
+    std::unordered_set<std::shared_ptr<data::keyframe>> keyfrms_in_use;
+    for (const auto& other : pending_loop_detections_) {
+        keyfrms_in_use.insert(other.cur_keyfrm_);
+        keyfrms_in_use.insert(other.loop_candidates_.begin(), other.loop_candidates_.end());
+    }
+    // the current keyframe is used by the loop correction if the candidate is selected
+    if (!selected_candidate && !keyfrms_in_use.count(pending.cur_keyfrm_)) {
+        pending.cur_keyfrm_->set_to_be_erased();
+    }
+    // allow the removal of the candidates except for the selected one
+    for (const auto& loop_candidate : pending.loop_candidates_) {
+        if (loop_candidate == selected_candidate || keyfrms_in_use.count(loop_candidate)) {
+            continue;
+        }
+        loop_candidate->set_to_be_erased();
+    }
+}
+
+void global_optimization_module::discard_pending_loop_detections() {
+    while (!pending_loop_detections_.empty()) {
+        auto pending = std::move(pending_loop_detections_.front());
+        pending_loop_detections_.pop_front();
+        loop_validation_pool_->wait(pending.future_, util::task_priority_t::Low);
+
+        std::lock_guard<util::profiled_mutex> lock(data::map_database::mtx_database_);
+        release_pending_loop_detection(pending, nullptr);
+    }
 }
 
 void global_optimization_module::queue_keyframe(const std::shared_ptr<data::keyframe>& keyfrm) {
-    std::lock_guard<std::mutex> lock(mtx_keyfrm_queue_);
-    keyfrms_queue_.push_back(keyfrm);
+    {
+        std::lock_guard<std::mutex> lock(mtx_keyfrm_queue_);
+        keyfrms_queue_.push_back(keyfrm);
+    }
+    notify_wakeup();
 }
 
 bool global_optimization_module::keyframe_is_queued() const {
@@ -204,13 +409,56 @@ bool global_optimization_module::keyframe_is_queued() const {
     return !keyfrms_queue_.empty();
 }
 
-void global_optimization_module::correct_loop() {
-    auto final_candidate_keyfrm = loop_detector_->get_selected_candidate_keyframe();
+void global_optimization_module::notify_wakeup() {
+    {
+        std::lock_guard<std::mutex> lock(mtx_wakeup_);
+        wakeup_is_requested_ = true;
+    }
+    cond_wakeup_.notify_all();
+}
+
+void global_optimization_module::wait_for_wakeup(const bool wake_on_pending_work) {
+    // (checked before locking mtx_wakeup_, because the requests are made while holding the other mutexes)
+    if (wake_on_pending_work && (keyframe_is_queued() || !pending_loop_detections_.empty() || pause_is_requested())) {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(mtx_wakeup_);
+    cond_wakeup_.wait(lock, [this] { return wakeup_is_requested_; });
+    wakeup_is_requested_ = false;
+}
+
+void global_optimization_module::sleep_interruptibly(const double sleep_ms) {
+    if (sleep_ms <= 0.0) {
+        return;
+    }
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(static_cast<int64_t>(sleep_ms * 1000.0));
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mtx_wakeup_);
+            if (!cond_wakeup_.wait_until(lock, deadline, [this] { return wakeup_is_requested_; })) {
+                return;
+            }
+            wakeup_is_requested_ = false;
+        }
+        // (checked after unlocking mtx_wakeup_, see wait_for_wakeup())
+        if (pause_is_requested() || reset_is_requested() || terminate_is_requested() || loop_closure_is_requested()) {
+            // the consumed wakeup is handled by the main loop
+            notify_wakeup();
+            return;
+        }
+    }
+}
+
+void global_optimization_module::correct_loop(const module::loop_detection& detection) {
+    cur_keyfrm_ = detection.cur_keyfrm_;
+    auto final_candidate_keyfrm = detection.selected_candidate_;
 
     spdlog::info("detect loop: keyframe {} - keyframe {}", final_candidate_keyfrm->id_, cur_keyfrm_->id_);
 
-    if (cur_keyfrm_->graph_node_->get_spanning_root() != final_candidate_keyfrm->graph_node_->get_spanning_root()) {
-        spdlog::warn("The feature to merge two spanning trees has not yet been implemented.");
+    // the loop can be detected across the maps (e.g. the new map started after tracking was lost, see tracking_module)
+    const bool is_inter_map_loop = cur_keyfrm_->graph_node_->get_spanning_root() != final_candidate_keyfrm->graph_node_->get_spanning_root();
+    if (is_inter_map_loop && !enable_inter_map_merge_) {
+        spdlog::warn("discard the inter-map loop because GlobalOptimizer.enable_inter_map_merge is false");
         return;
     }
 
@@ -218,6 +466,17 @@ void global_optimization_module::correct_loop() {
 
     // 0-1. stop the mapping module and the previous loop bundle adjuster
 
+    // the aborted loop bundle adjuster pauses the mapping module by itself to apply the partial result,
+    // so wait for it before pausing the mapping module
+    if (loop_bundle_adjuster_->applies_partial_result() && loop_bundle_adjuster_->is_running()) {
+        SPDLOG_TRACE("global_optimization_module: abort loop bundle adjustment and wait for the partial result");
+        abort_loop_BA();
+        while (loop_bundle_adjuster_->is_running()) {
+            std::this_thread::sleep_for(std::chrono::microseconds(1000));
+        }
+    }
+    // the deferred loop BA is cancelled before the pause ends its wait
+    deferred_loop_BA_is_cancelled_ = true;
     // pause the mapping module
     SPDLOG_TRACE("global_optimization_module: pause the mapping module");
     auto future_pause = mapper_->async_pause();
@@ -229,6 +488,82 @@ void global_optimization_module::correct_loop() {
     // wait till the mapping module pauses
     future_pause.get();
 
+    if (is_inter_map_loop) {
+        // align the map of the current keyframe to the map of the candidate, join the spanning trees and fuse the landmarks
+        // (the loop edge is added by the map merger, and the merged map is refined by the loop BA below)
+        spdlog::info("merge the map of keyframe {} into the map of keyframe {}",
+                     cur_keyfrm_->graph_node_->get_spanning_root()->id_, final_candidate_keyfrm->graph_node_->get_spanning_root()->id_);
+        map_merger_->merge_maps(detection);
+    }
+    else {
+        correct_loop_in_map(detection);
+    }
+
+    // 5. launch loop BA
+
+    SPDLOG_TRACE("global_optimization_module: wait for loop BA");
+    while (loop_bundle_adjuster_->is_running()) {
+        std::this_thread::sleep_for(std::chrono::microseconds(1000));
+    }
+    if (thread_for_loop_BA_) {
+        SPDLOG_TRACE("global_optimization_module: wait for last loop BA");
+        thread_for_loop_BA_->join();
+        thread_for_loop_BA_.reset(nullptr);
+    }
+    if (!is_offline_) {
+        SPDLOG_TRACE("global_optimization_module: launch loop BA");
+        util::thread_scheduling_params scheduling;
+        {
+            std::lock_guard<std::mutex> lock(mtx_loop_BA_thread_scheduling_);
+            scheduling = loop_BA_thread_scheduling_;
+        }
+        const auto loop_bundle_adjuster = loop_bundle_adjuster_.get();
+        const auto cur_keyfrm = cur_keyfrm_;
+        const auto mapper = mapper_;
+        const auto max_deferral_ms = loop_BA_max_deferral_ms_;
+        deferred_loop_BA_is_cancelled_ = false;
+        const auto is_cancelled = &deferred_loop_BA_is_cancelled_;
+        const auto cpu_time_ns = &loop_BA_cpu_time_ns_;
+        // (the tasks of the loop BA are accounted to the client of this module in the thread pool)
+        const auto pool_client_id = util::thread_pool::get_current_client_id();
+        thread_for_loop_BA_ = std::unique_ptr<std::thread>(new std::thread([loop_bundle_adjuster, cur_keyfrm, scheduling, mapper, max_deferral_ms, is_cancelled, cpu_time_ns, pool_client_id] {
+            if (!scheduling.is_default()) {
+                util::apply_current_thread_scheduling(scheduling);
+            }
+            util::thread_cpu_time_scope cpu_time_scope(*cpu_time_ns);
+            const util::thread_pool::client_scope pool_client_scope(pool_client_id);
+            // the loop BA is not urgent, so it waits for the backlog of the mapping module to be consumed
+            // (the mapping module is paused by the next loop correction, which also ends the wait)
+            if (0.0 < max_deferral_ms) {
+                mapper->wait_until_idle(max_deferral_ms);
+                if (*is_cancelled) {
+                    return;
+                }
+            }
+            loop_bundle_adjuster->optimize(cur_keyfrm);
+        }));
+    }
+
+    // 6. post-processing
+
+    SPDLOG_TRACE("global_optimization_module: resume the mapping module");
+    // resume the mapping module
+    mapper_->resume();
+
+    // set the loop fusion information to the loop detector
+    loop_detector_->set_loop_correct_keyframe_id(cur_keyfrm_->id_);
+    ++num_loop_corrections_;
+
+    if (is_offline_) {
+        // the loop BA is not overlapped with the tracking in the offline mode
+        SPDLOG_TRACE("global_optimization_module: run loop BA");
+        loop_bundle_adjuster_->optimize(cur_keyfrm_);
+    }
+}
+
+void global_optimization_module::correct_loop_in_map(const module::loop_detection& detection) {
+    auto final_candidate_keyfrm = detection.selected_candidate_;
+
     // 1. compute the Sim3 of the covisibilities of the current keyframe whose Sim3 is already estimated by the loop detector
     //    then, the covisibilities are moved to the corrected positions
     //    finally, landmarks observed in them are also moved to the correct position using the camera poses before and after camera pose correction
@@ -244,9 +579,9 @@ void global_optimization_module::correct_loop() {
     module::keyframe_Sim3_pairs_t Sim3s_nw_after_correction;
 
     std::unordered_map<unsigned int, unsigned int> found_lm_to_ref_keyfrm_id;
-    const auto g2o_Sim3_cw_after_correction = loop_detector_->get_Sim3_world_to_current();
+    const auto& g2o_Sim3_cw_after_correction = detection.g2o_Sim3_world_to_curr_;
     {
-        std::lock_guard<std::mutex> lock(data::map_database::mtx_database_);
+        std::lock_guard<util::profiled_mutex> lock(data::map_database::mtx_database_);
 
         // camera pose of the current keyframe BEFORE loop correction
         const Mat44_t cam_pose_wc_before_correction = cur_keyfrm_->get_pose_wc();
@@ -255,18 +590,26 @@ void global_optimization_module::correct_loop() {
         Sim3s_nw_before_correction = get_Sim3s_before_loop_correction(curr_neighbors);
         // compute Sim3s AFTER loop correction
         Sim3s_nw_after_correction = get_Sim3s_after_loop_correction(cam_pose_wc_before_correction, g2o_Sim3_cw_after_correction, curr_neighbors);
+    }
 
-        // correct covibisibility landmark positions
-        correct_covisibility_landmarks(Sim3s_nw_before_correction, Sim3s_nw_after_correction, found_lm_to_ref_keyfrm_id);
-        // correct covisibility keyframe camera poses
-        correct_covisibility_keyframes(Sim3s_nw_after_correction);
+    // compute the corrections into the side buffer without locking the map database,
+    // because the tracking module locks it for each frame
+    data::map_correction correction;
+    // correct covibisibility landmark positions
+    correct_covisibility_landmarks(Sim3s_nw_before_correction, Sim3s_nw_after_correction, found_lm_to_ref_keyfrm_id, correction);
+    // correct covisibility keyframe camera poses
+    correct_covisibility_keyframes(Sim3s_nw_after_correction, correction);
+    correction.compute_prediction_parameters(thread_pool_.get());
+    {
+        std::lock_guard<util::profiled_mutex> lock(data::map_database::mtx_database_);
+        // publish all the corrections at once
+        correction.publish();
     }
 
     // 2. resolve duplications of landmarks caused by loop fusion
 
     SPDLOG_TRACE("global_optimization_module: resolve duplications of landmarks caused by loop fusion");
-    const auto curr_match_lms_observed_in_cand = loop_detector_->current_matched_landmarks_observed_in_candidate();
-    replace_duplicated_landmarks(curr_match_lms_observed_in_cand, Sim3s_nw_after_correction);
+    replace_duplicated_landmarks(detection, Sim3s_nw_after_correction);
 
     // 3. extract the new connections created after loop fusion
 
@@ -281,29 +624,6 @@ void global_optimization_module::correct_loop() {
     // add a loop edge
     final_candidate_keyfrm->graph_node_->add_loop_edge(cur_keyfrm_);
     cur_keyfrm_->graph_node_->add_loop_edge(final_candidate_keyfrm);
-
-    // 5. launch loop BA
-
-    SPDLOG_TRACE("global_optimization_module: wait for loop BA");
-    while (loop_bundle_adjuster_->is_running()) {
-        std::this_thread::sleep_for(std::chrono::microseconds(1000));
-    }
-    if (thread_for_loop_BA_) {
-        SPDLOG_TRACE("global_optimization_module: wait for last loop BA");
-        thread_for_loop_BA_->join();
-        thread_for_loop_BA_.reset(nullptr);
-    }
-    SPDLOG_TRACE("global_optimization_module: launch loop BA");
-    thread_for_loop_BA_ = std::unique_ptr<std::thread>(new std::thread(&module::loop_bundle_adjuster::optimize, loop_bundle_adjuster_.get(), cur_keyfrm_));
-
-    // 6. post-processing
-
-    SPDLOG_TRACE("global_optimization_module: resume the mapping module");
-    // resume the mapping module
-    mapper_->resume();
-
-    // set the loop fusion information to the loop detector
-    loop_detector_->set_loop_correct_keyframe_id(cur_keyfrm_->id_);
 }
 
 module::keyframe_Sim3_pairs_t global_optimization_module::get_Sim3s_before_loop_correction(const std::vector<std::shared_ptr<data::keyframe>>& neighbors) const {
@@ -345,13 +665,24 @@ module::keyframe_Sim3_pairs_t global_optimization_module::get_Sim3s_after_loop_c
 
 void global_optimization_module::correct_covisibility_landmarks(const module::keyframe_Sim3_pairs_t& Sim3s_nw_before_correction,
                                                                 const module::keyframe_Sim3_pairs_t& Sim3s_nw_after_correction,
-                                                                std::unordered_map<unsigned int, unsigned int>& found_lm_to_ref_keyfrm_id) const {
+                                                                std::unordered_map<unsigned int, unsigned int>& found_lm_to_ref_keyfrm_id,
+                                                                data::map_correction& correction) const {
+    // assign each landmark to the first neighbor which observes it, then transform the positions in parallel
+    // (the assignment is serial to keep the reference keyframes the same as the order of Sim3s_nw_after_correction)
+    eigen_alloc_vector<Mat44_t> Sim3s_corrections;
+    Sim3s_corrections.reserve(Sim3s_nw_after_correction.size());
+    std::vector<std::shared_ptr<data::landmark>> lms_to_correct;
+    std::vector<unsigned int> lm_to_correction_idx;
+
     for (const auto& t : Sim3s_nw_after_correction) {
         auto neighbor = t.first;
         // neighbor->world AFTER loop correction
         const auto Sim3_wn_after_correction = t.second.inverse();
         // world->neighbor BEFORE loop correction
         const auto& Sim3_nw_before_correction = Sim3s_nw_before_correction.at(neighbor);
+        // world BEFORE loop correction -> world AFTER loop correction
+        const auto correction_idx = static_cast<unsigned int>(Sim3s_corrections.size());
+        Sim3s_corrections.push_back(util::converter::to_eigen_mat(Sim3_wn_after_correction * Sim3_nw_before_correction));
 
         const auto ngh_landmarks = neighbor->get_landmarks();
         for (const auto& lm : ngh_landmarks) {
@@ -369,37 +700,93 @@ void global_optimization_module::correct_covisibility_landmarks(const module::ke
             // record the reference keyframe used in loop fusion of landmarks
             found_lm_to_ref_keyfrm_id[lm->id_] = neighbor->id_;
 
-            // correct position of `lm`
-            const Vec3_t pos_w_before_correction = lm->get_pos_in_world();
-            const Vec3_t pos_w_after_correction = Sim3_wn_after_correction.map(Sim3_nw_before_correction.map(pos_w_before_correction));
-            lm->set_pos_in_world(pos_w_after_correction);
-            // update geometry
-            lm->update_mean_normal_and_obs_scale_variance();
+            lms_to_correct.push_back(lm);
+            lm_to_correction_idx.push_back(correction_idx);
         }
     }
+
+    // correct positions of the landmarks
+    eigen_alloc_vector<Vec3_t> pos_w_after_correction(lms_to_correct.size());
+    util::parallel_for(
+        thread_pool_.get(), 0, static_cast<int64_t>(lms_to_correct.size()), [&](const int64_t idx) {
+            const Mat44_t& Sim3_correction = Sim3s_corrections.at(lm_to_correction_idx.at(idx));
+            const Vec3_t pos_w_before_correction = lms_to_correct.at(idx)->get_pos_in_world();
+            pos_w_after_correction.at(idx) = Sim3_correction.block<3, 3>(0, 0) * pos_w_before_correction + Sim3_correction.block<3, 1>(0, 3);
+        },
+        util::task_priority_t::Low);
+
+    for (unsigned int idx = 0; idx < lms_to_correct.size(); ++idx) {
+        correction.set_landmark_position(lms_to_correct.at(idx), pos_w_after_correction.at(idx));
+    }
 }
 
-void global_optimization_module::correct_covisibility_keyframes(const module::keyframe_Sim3_pairs_t& Sim3s_nw_after_correction) const {
+void global_optimization_module::correct_covisibility_keyframes(const module::keyframe_Sim3_pairs_t& Sim3s_nw_after_correction,
+                                                                data::map_correction& correction) const {
+    std::vector<std::shared_ptr<data::keyframe>> neighbors;
+    neighbors.reserve(Sim3s_nw_after_correction.size());
+    std::vector<const g2o::Sim3*> Sim3s;
+    Sim3s.reserve(Sim3s_nw_after_correction.size());
     for (const auto& t : Sim3s_nw_after_correction) {
-        auto neighbor = t.first;
-        const auto Sim3_nw_after_correction = t.second;
+        neighbors.push_back(t.first);
+        Sim3s.push_back(&t.second);
+    }
+
+    eigen_alloc_vector<Mat44_t> cam_poses_nw(neighbors.size());
+    util::parallel_for(
+        thread_pool_.get(), 0, static_cast<int64_t>(neighbors.size()), [&Sim3s, &cam_poses_nw](const int64_t idx) {
+            const auto& Sim3_nw_after_correction = *Sim3s.at(idx);
 
-        const auto s_nw = Sim3_nw_after_correction.scale();
-        const Mat33_t rot_nw = Sim3_nw_after_correction.rotation().toRotationMatrix();
-        const Vec3_t trans_nw = Sim3_nw_after_correction.translation() / s_nw;
-        const Mat44_t cam_pose_nw = util::converter::to_eigen_pose(rot_nw, trans_nw);
-        neighbor->set_pose_cw(cam_pose_nw);
+            const auto s_nw = Sim3_nw_after_correction.scale();
+            const Mat33_t rot_nw = Sim3_nw_after_correction.rotation().toRotationMatrix();
+            const Vec3_t trans_nw = Sim3_nw_after_correction.translation() / s_nw;
+            cam_poses_nw.at(idx) = util::converter::to_eigen_pose(rot_nw, trans_nw);
+        },
+        util::task_priority_t::Low);
+
+    for (unsigned int idx = 0; idx < neighbors.size(); ++idx) {
+        correction.set_keyframe_pose(neighbors.at(idx), cam_poses_nw.at(idx));
     }
 }
 
-void global_optimization_module::replace_duplicated_landmarks(const std::vector<std::shared_ptr<data::landmark>>& curr_match_lms_observed_in_cand,
+void global_optimization_module::replace_duplicated_landmarks(const module::loop_detection& detection,
                                                               const module::keyframe_Sim3_pairs_t& Sim3s_nw_after_correction) const {
+    const auto& curr_match_lms_observed_in_cand = detection.curr_match_lms_observed_in_cand_;
     nondeterministic::unordered_map<std::shared_ptr<data::landmark>, std::shared_ptr<data::landmark>> replaced_lms;
+    // follow the replacements to the landmark which survives
+    const auto get_survivor = [&replaced_lms](std::shared_ptr<data::landmark> lm) {
+        auto itr = replaced_lms.find(lm);
+        while (itr != replaced_lms.end()) {
+            lm = itr->second;
+            itr = replaced_lms.find(lm);
+        }
+        return lm;
+    };
+    // the landmarks whose descriptors and prediction parameters are updated together after fusing
+    std::vector<std::shared_ptr<data::landmark>> lms_to_update;
+    // update them once for each (NOTE: mtx_database_ must be locked)
+    const auto update_fused_lms = [this, &lms_to_update, &get_survivor]() {
+        for (auto& lm : lms_to_update) {
+            lm = get_survivor(lm);
+        }
+        std::sort(lms_to_update.begin(), lms_to_update.end());
+        lms_to_update.erase(std::unique(lms_to_update.begin(), lms_to_update.end()), lms_to_update.end());
+        util::parallel_for(
+            thread_pool_.get(), 0, static_cast<int64_t>(lms_to_update.size()), [&lms_to_update](const int64_t idx) {
+                const auto& lm = lms_to_update.at(idx);
+                if (!lm->will_be_erased() && !lm->has_representative_descriptor()) {
+                    lm->compute_descriptor();
+                }
+            },
+            util::task_priority_t::Low);
+        data::landmark::update_prediction_parameters(lms_to_update, thread_pool_.get());
+        lms_to_update.clear();
+    };
+
     // resolve duplications of landmarks between the current keyframe and the loop candidate
     {
-        std::lock_guard<std::mutex> lock(data::map_database::mtx_database_);
+        std::lock_guard<util::profiled_mutex> lock(data::map_database::mtx_database_);
 
-        for (unsigned int idx = 0; idx < cur_keyfrm_->frm_obs_.num_keypts_; ++idx) {
+        for (unsigned int idx = 0; idx < cur_keyfrm_->frm_obs_->num_keypts_; ++idx) {
             auto curr_match_lm_in_cand = curr_match_lms_observed_in_cand.at(idx);
             if (!curr_match_lm_in_cand) {
                 continue;
@@ -420,67 +807,122 @@ void global_optimization_module::replace_duplicated_landmarks(const std::vector<
                 if (lm_in_curr->id_ != curr_match_lm_in_cand->id_) {
                     replaced_lms[lm_in_curr] = curr_match_lm_in_cand;
                     lm_in_curr->replace(curr_match_lm_in_cand, map_db_);
-                    if (!curr_match_lm_in_cand->has_representative_descriptor()) {
-                        curr_match_lm_in_cand->compute_descriptor();
-                    }
-                    if (!curr_match_lm_in_cand->has_valid_prediction_parameters()) {
-                        curr_match_lm_in_cand->update_mean_normal_and_obs_scale_variance();
-                    }
+                    lms_to_update.push_back(curr_match_lm_in_cand);
                 }
             }
             else {
                 // if landmark corresponding `idx` does not exists,
                 // add association between the current keyframe and `curr_match_lm_in_cand`
                 curr_match_lm_in_cand->connect_to_keyframe(cur_keyfrm_, idx);
-                curr_match_lm_in_cand->update_mean_normal_and_obs_scale_variance();
-                curr_match_lm_in_cand->compute_descriptor();
+                lms_to_update.push_back(curr_match_lm_in_cand);
             }
         }
+        update_fused_lms();
     }
 
     // resolve duplications of landmarks between the current keyframe and the candidates of the loop candidate
-    auto curr_match_lms_observed_in_cand_covis = loop_detector_->current_matched_landmarks_observed_in_candidate_covisibilities();
+    // (the duplications are detected for all the neighbors in parallel, then they are fused at once)
+    const auto& curr_match_lms_observed_in_cand_covis = detection.curr_match_lms_observed_in_cand_covis_;
     match::fuse fuse_matcher(0.8);
+    std::vector<std::shared_ptr<data::keyframe>> neighbors;
+    std::vector<const g2o::Sim3*> Sim3s;
     for (const auto& t : Sim3s_nw_after_correction) {
-        auto neighbor = t.first;
-        const Mat44_t Sim3_nw_after_correction = util::converter::to_eigen_mat(t.second);
-
-        // reproject the landmarks observed in the current keyframe to the neighbor,
-        // then search duplication of the landmarks
-        std::unordered_map<std::shared_ptr<data::landmark>, std::shared_ptr<data::landmark>> duplicated_lms_in_keyfrm;
-        std::unordered_map<unsigned int, std::shared_ptr<data::landmark>> new_connections;
-        // Convert Sim3 into SE3
-        const Mat33_t s_rot_cw = Sim3_nw_after_correction.block<3, 3>(0, 0);
-        const auto s_cw = std::sqrt(s_rot_cw.block<1, 3>(0, 0).dot(s_rot_cw.block<1, 3>(0, 0)));
-        const Mat33_t rot_cw = s_rot_cw / s_cw;
-        const Vec3_t trans_cw = Sim3_nw_after_correction.block<3, 1>(0, 3) / s_cw;
-        fuse_matcher.detect_duplication(neighbor, rot_cw, trans_cw, curr_match_lms_observed_in_cand_covis, 4.0, duplicated_lms_in_keyfrm, new_connections);
-
-        std::lock_guard<std::mutex> lock(data::map_database::mtx_database_);
-
-        for (const auto& best_idx_lm : new_connections) {
-            const auto& best_idx = best_idx_lm.first;
-            const auto& lm = best_idx_lm.second;
-            lm->connect_to_keyframe(neighbor, best_idx);
-            lm->update_mean_normal_and_obs_scale_variance();
-            lm->compute_descriptor();
-        }
-
-        // if any landmark duplication is found, replace it
-        for (const auto& lms_pair : duplicated_lms_in_keyfrm) {
-            const auto& lm_to_replace = lms_pair.first;
-            const auto& lm_in_neighbor = lms_pair.second;
-            if (lm_to_replace->id_ != lm_in_neighbor->id_) {
-                replaced_lms[lm_to_replace] = lm_in_neighbor;
-                lm_to_replace->replace(lm_in_neighbor, map_db_);
-                if (!lm_in_neighbor->has_representative_descriptor()) {
-                    lm_in_neighbor->compute_descriptor();
+        neighbors.push_back(t.first);
+        Sim3s.push_back(&t.second);
+    }
+    std::vector<std::unordered_map<std::shared_ptr<data::landmark>, std::shared_ptr<data::landmark>>> duplicated_lms_in_neighbors(neighbors.size());
+    std::vector<std::unordered_map<unsigned int, std::shared_ptr<data::landmark>>> new_connections_in_neighbors(neighbors.size());
+
+    // (the prediction parameters are computed lazily, so they are prepared before the landmarks are shared by the threads)
+    std::vector<std::shared_ptr<data::landmark>> lms_to_check;
+    lms_to_check.reserve(curr_match_lms_observed_in_cand_covis.size());
+    for (const auto& lm : curr_match_lms_observed_in_cand_covis) {
+        if (lm) {
+            lms_to_check.push_back(lm);
+        }
+    }
+    data::landmark::update_prediction_parameters(lms_to_check, thread_pool_.get());
+
+    // hash the positions of the landmarks to check, so that only those near the landmarks of each neighbor are reprojected to it
+    // (the neighbors and their landmarks have been corrected, and the landmarks to check are not moved by the correction)
+    const float median_depth = cur_keyfrm_->compute_median_depth(true);
+    const double search_radius = fusion_search_radius_ratio_ * median_depth;
+    std::unique_ptr<data::landmark_spatial_hash> lm_hash;
+    if (0.0 < search_radius && std::isfinite(search_radius)) {
+        eigen_alloc_vector<Vec3_t> positions;
+        positions.reserve(lms_to_check.size());
+        for (const auto& lm : lms_to_check) {
+            positions.push_back(lm->get_pos_in_world());
+        }
+        lm_hash.reset(new data::landmark_spatial_hash(search_radius));
+        lm_hash->build(positions);
+    }
+
+    util::parallel_for(
+        thread_pool_.get(), 0, static_cast<int64_t>(neighbors.size()), [&](const int64_t i) {
+            const Mat44_t Sim3_nw_after_correction = util::converter::to_eigen_mat(*Sim3s.at(i));
+
+            // shortlist the landmarks in the neighborhood of the landmarks observed in the neighbor
+            std::vector<std::shared_ptr<data::landmark>> shortlisted_lms;
+            if (lm_hash) {
+                eigen_alloc_vector<Vec3_t> lm_positions_in_neighbor;
+                neighbors.at(i)->for_each_landmark([&lm_positions_in_neighbor](const std::shared_ptr<data::landmark>& lm, const unsigned int) {
+                    if (lm && !lm->will_be_erased()) {
+                        lm_positions_in_neighbor.push_back(lm->get_pos_in_world());
+                    }
+                });
+                for (const auto idx : lm_hash->get_landmarks_near(lm_positions_in_neighbor, search_radius)) {
+                    shortlisted_lms.push_back(lms_to_check.at(idx));
+                }
+            }
+            const auto& lms_to_fuse = lm_hash ? shortlisted_lms : curr_match_lms_observed_in_cand_covis;
+
+            // reproject the landmarks observed in the current keyframe to the neighbor,
+            // then search duplication of the landmarks
+            // Convert Sim3 into SE3
+            const Mat33_t s_rot_cw = Sim3_nw_after_correction.block<3, 3>(0, 0);
+            const auto s_cw = std::sqrt(s_rot_cw.block<1, 3>(0, 0).dot(s_rot_cw.block<1, 3>(0, 0)));
+            const Mat33_t rot_cw = s_rot_cw / s_cw;
+            const Vec3_t trans_cw = Sim3_nw_after_correction.block<3, 1>(0, 3) / s_cw;
+            fuse_matcher.detect_duplication(neighbors.at(i), rot_cw, trans_cw, lms_to_fuse, 4.0,
+                                            duplicated_lms_in_neighbors.at(i), new_connections_in_neighbors.at(i));
+        },
+        util::task_priority_t::Low);
+
+    {
+        std::lock_guard<util::profiled_mutex> lock(data::map_database::mtx_database_);
+
+        for (unsigned int i = 0; i < neighbors.size(); ++i) {
+            const auto& neighbor = neighbors.at(i);
+
+            for (const auto& best_idx_lm : new_connections_in_neighbors.at(i)) {
+                const auto& best_idx = best_idx_lm.first;
+                // (the landmark can have been replaced while fusing the other neighbors)
+                const auto lm = get_survivor(best_idx_lm.second);
+                if (lm->will_be_erased() || lm->is_observed_in_keyframe(neighbor) || neighbor->get_landmark(best_idx)) {
+                    continue;
                 }
-                if (!lm_in_neighbor->has_valid_prediction_parameters()) {
-                    lm_in_neighbor->update_mean_normal_and_obs_scale_variance();
+                lm->connect_to_keyframe(neighbor, best_idx);
+                lms_to_update.push_back(lm);
+            }
+
+            // if any landmark duplication is found, replace it
+            for (const auto& lms_pair : duplicated_lms_in_neighbors.at(i)) {
+                const auto lm_to_replace = get_survivor(lms_pair.first);
+                const auto lm_in_neighbor = get_survivor(lms_pair.second);
+                if (lm_to_replace->id_ == lm_in_neighbor->id_) {
+                    continue;
                 }
+                if (lm_to_replace->will_be_erased() || lm_in_neighbor->will_be_erased()) {
+                    continue;
+                }
+                replaced_lms[lm_to_replace] = lm_in_neighbor;
+                lm_to_replace->replace(lm_in_neighbor, map_db_);
+                lms_to_update.push_back(lm_in_neighbor);
             }
         }
+
+        update_fused_lms();
     }
     tracker_->replace_landmarks_in_last_frm(replaced_lms);
 }
@@ -512,12 +954,23 @@ auto global_optimization_module::extract_new_connections(const std::vector<std::
 }
 
 std::shared_future<void> global_optimization_module::async_reset() {
-    std::lock_guard<std::mutex> lock(mtx_reset_);
-    reset_is_requested_ = true;
-    if (!future_reset_.valid()) {
-        future_reset_ = promise_reset_.get_future().share();
+    std::shared_future<void> future_reset;
+    {
+        std::lock_guard<std::mutex> lock(mtx_reset_);
+        reset_is_requested_ = true;
+        if (!future_reset_.valid()) {
+            future_reset_ = promise_reset_.get_future().share();
+        }
+        future_reset = future_reset_;
+    }
+    if (is_offline_) {
+        // no keyframe is being processed while the request is made
+        discard_pending_loop_detections();
+        reset();
+        return future_reset;
     }
-    return future_reset_;
+    notify_wakeup();
+    return future_reset;
 }
 
 bool global_optimization_module::reset_is_requested() const {
@@ -537,12 +990,23 @@ void global_optimization_module::reset() {
 }
 
 std::shared_future<void> global_optimization_module::async_pause() {
-    std::lock_guard<std::mutex> lock1(mtx_pause_);
-    pause_is_requested_ = true;
-    if (!future_pause_.valid()) {
-        future_pause_ = promise_pause_.get_future().share();
+    std::shared_future<void> future_pause;
+    {
+        std::lock_guard<std::mutex> lock1(mtx_pause_);
+        pause_is_requested_ = true;
+        if (!future_pause_.valid()) {
+            future_pause_ = promise_pause_.get_future().share();
+        }
+        future_pause = future_pause_;
+    }
+    if (is_offline_ && !is_terminated()) {
+        // no keyframe is being processed while the request is made
+        discard_pending_loop_detections();
+        pause();
+        return future_pause;
     }
-    return future_pause_;
+    notify_wakeup();
+    return future_pause;
 }
 
 bool global_optimization_module::pause_is_requested() const {
@@ -575,17 +1039,29 @@ void global_optimization_module::resume() {
 
     is_paused_ = false;
     pause_is_requested_ = false;
+    notify_wakeup();
 
     spdlog::info("resume global optimization module");
 }
 
 std::shared_future<void> global_optimization_module::async_terminate() {
-    std::lock_guard<std::mutex> lock(mtx_terminate_);
-    terminate_is_requested_ = true;
-    if (!future_terminate_.valid()) {
-        future_terminate_ = promise_terminate_.get_future().share();
+    std::shared_future<void> future_terminate;
+    {
+        std::lock_guard<std::mutex> lock(mtx_terminate_);
+        terminate_is_requested_ = true;
+        if (!future_terminate_.valid()) {
+            future_terminate_ = promise_terminate_.get_future().share();
+        }
+        future_terminate = future_terminate_;
     }
-    return future_terminate_;
+    if (is_offline_) {
+        // no keyframe is being processed while the request is made
+        discard_pending_loop_detections();
+        terminate();
+        return future_terminate;
+    }
+    notify_wakeup();
+    return future_terminate;
 }
 
 bool global_optimization_module::is_terminated() const {
@@ -610,7 +1086,12 @@ bool global_optimization_module::loop_BA_is_running() const {
     return loop_bundle_adjuster_->is_running();
 }
 
+double global_optimization_module::get_loop_BA_cpu_time() const {
+    return loop_BA_cpu_time_ns_ * 1e-9;
+}
+
 void global_optimization_module::abort_loop_BA() {
+    deferred_loop_BA_is_cancelled_ = true;
     loop_bundle_adjuster_->abort();
 }
 
@@ -6,13 +6,20 @@
 #include "stella_vslam/module/type.h"
 #include "stella_vslam/module/loop_detector.h"
 #include "stella_vslam/module/loop_bundle_adjuster.h"
+#include "stella_vslam/module/map_merger.h"
 #include "stella_vslam/optimize/graph_optimizer.h"
+#include "stella_vslam/util/cpu_budget.h"
+#include "stella_vslam/util/thread_pool.h"
+#include "stella_vslam/util/thread_scheduling.h"
 
+#include <atomic>
 #include <list>
 #include <mutex>
+#include <condition_variable>
 #include <thread>
 #include <memory>
 #include <future>
+#include <unordered_set>
 
 namespace stella_vslam {
 
@@ -23,8 +30,13 @@ namespace data {
 class keyframe;
 class bow_database;
 class map_database;
+class map_correction;
 } // namespace data
 
+namespace util {
+class keyframe_tracer;
+} // namespace util
+
 struct loop_closure_request {
     unsigned int keyfrm1_id_;
     unsigned int keyfrm2_id_;
@@ -44,6 +56,20 @@ public:
     //! Set the mapping module
     void set_mapping_module(mapping_module* mapper);
 
+    //! Replace the worker threads of the loop validation with the thread pool shared among the modules,
+    //! and run the parallel loops of the loop correction and the loop BA on it instead of the OpenMP threads
+    //! (call before the module runs)
+    void set_thread_pool(const std::shared_ptr<util::thread_pool>& thread_pool);
+
+    //! Set the scheduling of the thread of the loop BA (applied from the next loop BA)
+    void set_loop_BA_thread_scheduling(const util::thread_scheduling_params& params);
+
+    //! Set the metrics publisher which records the durations of the loop BA
+    void set_metrics_publisher(const std::shared_ptr<publish::metrics_publisher>& metrics_publisher);
+
+    //! Set the tracer which records the times when the loop detection of the keyframes starts and finishes
+    void set_keyframe_tracer(const std::shared_ptr<util::keyframe_tracer>& keyfrm_tracer);
+
     //-----------------------------------------
     // interfaces to ON/OFF loop detector
 
@@ -62,6 +88,15 @@ public:
     //! Run main loop of the global optimization module
     void run();
 
+    //! Start the global optimization module without its own thread (offline mapping mode)
+    //! (NOTE: the queued keyframes are processed with process_queued_keyframes() instead of run(), the loop BA runs on the caller thread,
+    //!  and the pause, reset and terminate requests are carried out on the caller threads, so the callers must be serialized)
+    void start_offline();
+
+    //! Detect and correct the loops of all of the queued keyframes on the caller thread (offline mapping mode)
+    //! (the candidates are still validated on the thread pool)
+    void process_queued_keyframes();
+
     //! Queue a keyframe to the BoW database
     void queue_keyframe(const std::shared_ptr<data::keyframe>& keyfrm);
 
@@ -101,6 +136,9 @@ public:
     //! Check if loop BA is running or not
     bool loop_BA_is_running() const;
 
+    //! Get the CPU time consumed by the threads of the loop BA which have exited [s]
+    double get_loop_BA_cpu_time() const;
+
     //! Abort the loop BA externally
     //! (NOTE: this function does not wait for abort)
     void abort_loop_BA();
@@ -115,7 +153,11 @@ private:
     // main process
 
     //! Perform loop closing
-    void correct_loop();
+    void correct_loop(const module::loop_detection& detection);
+
+    //! Correct the camera poses and the landmarks of the map containing both ends of the loop (steps 1-4 of correct_loop)
+    //! (NOTE: the mapping module must be paused)
+    void correct_loop_in_map(const module::loop_detection& detection);
 
     //! Compute Sim3s (world to covisibility) which are prior to loop correction
     module::keyframe_Sim3_pairs_t get_Sim3s_before_loop_correction(const std::vector<std::shared_ptr<data::keyframe>>& neighbors) const;
@@ -124,21 +166,90 @@ private:
     module::keyframe_Sim3_pairs_t get_Sim3s_after_loop_correction(const Mat44_t& cam_pose_wc_before_correction, const g2o::Sim3& g2o_Sim3_cw_after_correction,
                                                                   const std::vector<std::shared_ptr<data::keyframe>>& neighbors) const;
 
-    //! Correct the positions of the landmarks which are seen in covisibilities
+    //! Compute the corrected positions of the landmarks which are seen in covisibilities
     void correct_covisibility_landmarks(const module::keyframe_Sim3_pairs_t& Sim3s_nw_before_correction,
                                         const module::keyframe_Sim3_pairs_t& Sim3s_nw_after_correction,
-                                        std::unordered_map<unsigned int, unsigned int>& found_lm_to_ref_keyfrm_id) const;
+                                        std::unordered_map<unsigned int, unsigned int>& found_lm_to_ref_keyfrm_id,
+                                        data::map_correction& correction) const;
 
-    //! Correct the camera poses of the covisibilities
-    void correct_covisibility_keyframes(const module::keyframe_Sim3_pairs_t& Sim3s_nw_after_correction) const;
+    //! Compute the corrected camera poses of the covisibilities
+    void correct_covisibility_keyframes(const module::keyframe_Sim3_pairs_t& Sim3s_nw_after_correction,
+                                        data::map_correction& correction) const;
 
     //! Detect and replace duplicated landmarks
-    void replace_duplicated_landmarks(const std::vector<std::shared_ptr<data::landmark>>& curr_match_lms_observed_in_cand,
+    void replace_duplicated_landmarks(const module::loop_detection& detection,
                                       const module::keyframe_Sim3_pairs_t& Sim3s_nw_after_correction) const;
 
     //! Extract the new connections which will be created AFTER loop correction
     std::map<std::shared_ptr<data::keyframe>, std::set<std::shared_ptr<data::keyframe>>> extract_new_connections(const std::vector<std::shared_ptr<data::keyframe>>& covisibilities) const;
 
+    //-----------------------------------------
+    // asynchronous loop detection
+
+    //! loop candidates of a keyframe which are being validated on the thread pool
+    struct pending_loop_detection {
+        //! keyframe which detected the loop candidates
+        std::shared_ptr<data::keyframe> cur_keyfrm_;
+        //! loop candidates to validate
+        std::unordered_set<std::shared_ptr<data::keyframe>> loop_candidates_;
+        //! number of the loop corrections when the validation was launched
+        unsigned int num_loop_corrections_;
+        //! result of the validation (nullptr if no candidate is selected)
+        std::future<std::shared_ptr<module::loop_detection>> future_;
+    };
+
+    //! Detect the loop candidates of the queued keyframes, then launch their validations on the thread pool
+    //! (the back-to-back keyframes are coalesced if the queue is deeper than the threshold)
+    void detect_loop_candidates_of_queued_keyframes();
+
+    //! Launch the validation of the loop candidates of the keyframe
+    //! (NOTE: this function must be called while locking the map database)
+    void launch_loop_validation(const std::shared_ptr<data::keyframe>& keyfrm,
+                                const std::unordered_set<std::shared_ptr<data::keyframe>>& loop_candidates);
+
+    //! Wait for the validation of the oldest pending keyframe, then correct the loop if detected
+    void correct_loop_of_oldest_pending_keyframe();
+
+    //! Allow the removal of the keyframes of the pending detection except for the ones used by the other pending detections
+    //! (if the candidate is selected, it and the current keyframe are kept for the loop correction)
+    //! (NOTE: this function must be called while locking the map database)
+    void release_pending_loop_detection(const pending_loop_detection& pending, const std::shared_ptr<data::keyframe>& selected_candidate) const;
+
+    //! Wait for all of the pending validations, then discard them (called before pause, reset and termination)
+    void discard_pending_loop_detections();
+
+    //! thread pool to validate the loop candidates of several keyframes concurrently
+    std::shared_ptr<util::thread_pool> loop_validation_pool_ = nullptr;
+    //! thread pool shared among the modules to run the parallel loops on (nullptr if not set)
+    std::shared_ptr<util::thread_pool> thread_pool_ = nullptr;
+    //! pending detections (in the order of the keyframes)
+    std::list<pending_loop_detection> pending_loop_detections_;
+    //! the back-to-back keyframes are coalesced if the number of the queued keyframes exceeds this (0 means disabled)
+    const unsigned int coalesce_queue_depth_;
+    //! number of the loop corrections so far
+    unsigned int num_loop_corrections_ = 0;
+
+    //-----------------------------------------
+    // wakeup of the main loop
+
+    //! mutex for the wakeup flag
+    std::mutex mtx_wakeup_;
+    //! condition variable notified by notify_wakeup()
+    std::condition_variable cond_wakeup_;
+    //! flag which indicates the main loop should check the requests and the queue
+    bool wakeup_is_requested_ = false;
+
+    //! Wake up the main loop (called after a keyframe is queued or any request is made)
+    void notify_wakeup();
+
+    //! Block until notify_wakeup() is called
+    //! (if wake_on_pending_work is true, also return while a keyframe is queued or the pause is requested,
+    //!  because the previous iteration might have consumed the wakeup without handling them)
+    void wait_for_wakeup(const bool wake_on_pending_work);
+
+    //! Block for sleep_ms unless the pause, reset, termination or loop closure is requested
+    void sleep_interruptibly(const double sleep_ms);
+
     //-----------------------------------------
     // management for reset process
 
@@ -233,6 +344,10 @@ private:
     std::unique_ptr<module::loop_detector> loop_detector_ = nullptr;
     //! loop bundle adjuster
     std::unique_ptr<module::loop_bundle_adjuster> loop_bundle_adjuster_ = nullptr;
+    //! merger of the maps, used when the loop is detected across the maps (the spanning trees)
+    std::unique_ptr<module::map_merger> map_merger_ = nullptr;
+    //! If true, merge the maps at the inter-map loops, otherwise discard the loops
+    const bool enable_inter_map_merge_;
 
     //! map database
     data::map_database* map_db_ = nullptr;
@@ -249,6 +364,10 @@ private:
     //! queue for keyframes
     std::list<std::shared_ptr<data::keyframe>> keyfrms_queue_;
 
+    //! keyframe tracer (nullptr if not set)
+    std::shared_ptr<util::keyframe_tracer> keyfrm_tracer_ = nullptr;
+
+    //! keyframe of the loop being corrected
     std::shared_ptr<data::keyframe> cur_keyfrm_ = nullptr;
 
     //-----------------------------------------
@@ -262,6 +381,35 @@ private:
 
     //! thread for running loop BA
     std::unique_ptr<std::thread> thread_for_loop_BA_ = nullptr;
+
+    //! mutex to access loop_BA_thread_scheduling_
+    mutable std::mutex mtx_loop_BA_thread_scheduling_;
+    //! scheduling of the thread for running loop BA
+    util::thread_scheduling_params loop_BA_thread_scheduling_;
+
+    //-----------------------------------------
+    // CPU budget
+
+    //! duty cycle of the main loop (the detection and the correction of the loops)
+    const util::cpu_budget cpu_budget_;
+
+    //! The loop BA waits for the mapping module to be idle up to this duration (0: starts immediately) [ms]
+    const double loop_BA_max_deferral_ms_;
+
+    //! The landmarks are checked for the duplication in a neighbor only if they are within this ratio of the median depth of the current keyframe
+    //! from any landmark of the neighbor (0: all of the landmarks are checked)
+    const double fusion_search_radius_ratio_;
+
+    //! set by abort_loop_BA() to cancel the loop BA waiting for the mapping module
+    std::atomic<bool> deferred_loop_BA_is_cancelled_{false};
+    //! CPU time consumed by the threads of the loop BA [ns]
+    std::atomic<int64_t> loop_BA_cpu_time_ns_{0};
+
+    //-----------------------------------------
+    // offline mapping mode
+
+    //! the global optimization module is driven by process_queued_keyframes() instead of run()
+    std::atomic<bool> is_offline_{false};
 };
 
 } // namespace stella_vslam
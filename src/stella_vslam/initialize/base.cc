@@ -1,6 +1,7 @@
 #include "stella_vslam/data/frame.h"
 #include "stella_vslam/initialize/base.h"
 #include "stella_vslam/solve/triangulator.h"
+#include "stella_vslam/util/thread_pool.h"
 
 namespace stella_vslam {
 namespace initialize {
@@ -11,7 +12,7 @@ base::base(const data::frame& ref_frm,
            const unsigned int min_num_valid_pts,
            const float parallax_deg_thr,
            const float reproj_err_thr)
-    : ref_camera_(ref_frm.camera_), ref_undist_keypts_(ref_frm.frm_obs_.undist_keypts_), ref_bearings_(ref_frm.frm_obs_.bearings_),
+    : ref_camera_(ref_frm.camera_), ref_undist_keypts_(ref_frm.frm_obs_->undist_keypts_), ref_bearings_(ref_frm.frm_obs_->bearings_),
       num_ransac_iters_(num_ransac_iters), min_num_triangulated_(min_num_triangulated),
       min_num_valid_pts_(min_num_valid_pts),
       parallax_deg_thr_(parallax_deg_thr), reproj_err_thr_(reproj_err_thr) {}
@@ -33,7 +34,8 @@ std::vector<bool> base::get_triangulated_flags() const {
 }
 
 bool base::find_most_plausible_pose(const eigen_alloc_vector<Mat33_t>& init_rots, const eigen_alloc_vector<Vec3_t>& init_transes,
-                                    const std::vector<bool>& is_inlier_match, const bool depth_is_positive) {
+                                    const std::vector<bool>& is_inlier_match, const bool depth_is_positive,
+                                    util::thread_pool* thread_pool) {
     assert(init_rots.size() == init_transes.size());
     const auto num_hypothesis = init_rots.size();
 
@@ -48,9 +50,27 @@ bool base::find_most_plausible_pose(const eigen_alloc_vector<Mat33_t>& init_rots
     // number of triangulated 3D points
     std::vector<unsigned int> num_triangulated_pts(num_hypothesis);
 
-    for (unsigned int i = 0; i < num_hypothesis; ++i) {
+    const auto reconstruct = [&](const unsigned int i) {
         nums_valid_pts.at(i) = triangulate(init_rots.at(i), init_transes.at(i), is_inlier_match, depth_is_positive,
                                            init_triangulated_pts.at(i), init_is_triangulated.at(i), num_triangulated_pts.at(i), init_parallax.at(i));
+    };
+    if (thread_pool && 1 < num_hypothesis) {
+        // the hypotheses except the last one are reconstructed on the workers, and the last one on this thread
+        std::vector<std::future<void>> futures;
+        futures.reserve(num_hypothesis - 1);
+        for (unsigned int i = 0; i + 1 < num_hypothesis; ++i) {
+            futures.push_back(thread_pool->submit(std::bind(reconstruct, i), util::task_priority_t::High));
+        }
+        reconstruct(num_hypothesis - 1);
+        for (auto& future : futures) {
+            thread_pool->wait(future, util::task_priority_t::High);
+            future.get();
+        }
+    }
+    else {
+        for (unsigned int i = 0; i < num_hypothesis; ++i) {
+            reconstruct(i);
+        }
     }
 
     rot_ref_to_cur_ = Mat33_t::Zero();
@@ -101,8 +121,8 @@ unsigned int base::triangulate(const Mat33_t& rot_ref_to_cur, const Vec3_t& tran
                                unsigned int& num_triangulated_pts,
                                float& parallax_cos) {
     // = cos(0.5deg)
-    constexpr float cos_parallax_thr = 0.99996192306;
-    const float reproj_err_thr_sq = reproj_err_thr_ * reproj_err_thr_;
+    constexpr double cos_parallax_thr = 0.99996192306;
+    const double reproj_err_thr_sq = reproj_err_thr_ * reproj_err_thr_;
 
     // resize buffers according to the number of observed keypoints in the reference
     is_triangulated.resize(ref_undist_keypts_.size(), false);
@@ -111,88 +131,85 @@ unsigned int base::triangulate(const Mat33_t& rot_ref_to_cur, const Vec3_t& tran
     std::vector<float> cos_parallaxes;
     cos_parallaxes.reserve(ref_undist_keypts_.size());
 
-    // camera centers
-    const Vec3_t ref_cam_center = Vec3_t::Zero();
-    const Vec3_t cur_cam_center = -rot_ref_to_cur.transpose() * trans_ref_to_cur;
-
-    unsigned int num_valid_pts = 0;
-    num_triangulated_pts = 0;
-
-    // for each matching, triangulate a 3D point and compute a parallax and a reprojection error
+    // gather the inlier matches (one match per row)
+    std::vector<unsigned int> inlier_match_indices;
+    inlier_match_indices.reserve(ref_cur_matches_.size());
     for (unsigned int i = 0; i < ref_cur_matches_.size(); ++i) {
-        if (!is_inlier_match.at(i)) {
-            continue;
-        }
-
-        const Vec3_t& ref_bearing = ref_bearings_.at(ref_cur_matches_.at(i).first);
-        const Vec3_t& cur_bearing = cur_bearings_.at(ref_cur_matches_.at(i).second);
-
-        const Vec3_t pos_c_in_ref = solve::triangulator::triangulate(ref_bearing, cur_bearing, rot_ref_to_cur, trans_ref_to_cur);
-
-        if (!std::isfinite(pos_c_in_ref(0))
-            || !std::isfinite(pos_c_in_ref(1))
-            || !std::isfinite(pos_c_in_ref(2))) {
-            continue;
+        if (is_inlier_match.at(i)) {
+            inlier_match_indices.push_back(i);
         }
+    }
+    const auto num_inlier_matches = inlier_match_indices.size();
+    MatX3_t ref_bearings(num_inlier_matches, 3);
+    MatX3_t cur_bearings(num_inlier_matches, 3);
+    MatX2_t ref_keypts(num_inlier_matches, 2);
+    MatX2_t cur_keypts(num_inlier_matches, 2);
+    for (unsigned int j = 0; j < num_inlier_matches; ++j) {
+        const auto& match = ref_cur_matches_.at(inlier_match_indices.at(j));
+        ref_bearings.row(j) = ref_bearings_.at(match.first).transpose();
+        cur_bearings.row(j) = cur_bearings_.at(match.second).transpose();
+        ref_keypts(j, 0) = ref_undist_keypts_.at(match.first).pt.x;
+        ref_keypts(j, 1) = ref_undist_keypts_.at(match.first).pt.y;
+        cur_keypts(j, 0) = cur_undist_keypts_.at(match.second).pt.x;
+        cur_keypts(j, 1) = cur_undist_keypts_.at(match.second).pt.y;
+    }
 
-        // compute a parallax
-        const Vec3_t ref_normal = pos_c_in_ref - ref_cam_center;
-        const float ref_norm = ref_normal.norm();
-        const Vec3_t cur_normal = pos_c_in_ref - cur_cam_center;
-        const float cur_norm = cur_normal.norm();
-        const float cos_parallax = ref_normal.dot(cur_normal) / (ref_norm * cur_norm);
-
-        const bool parallax_is_small = cos_parallax_thr < cos_parallax;
-
-        // reject if the 3D point is in front of the cameras
-        if (depth_is_positive) {
-            if (!parallax_is_small && pos_c_in_ref(2) <= 0) {
-                continue;
-            }
-            const Vec3_t pos_c_in_cur = rot_ref_to_cur * pos_c_in_ref + trans_ref_to_cur;
-            if (!parallax_is_small && pos_c_in_cur(2) <= 0) {
-                continue;
-            }
-        }
+    // triangulate 3D points of all of the matches at once
+    MatX3_t pos_cs_in_ref;
+    solve::triangulator::triangulate(ref_bearings, cur_bearings, rot_ref_to_cur, trans_ref_to_cur, pos_cs_in_ref);
+    const VecXb_t is_finite = pos_cs_in_ref.array().isFinite().rowwise().all();
 
-        const auto& ref_undist_keypt = ref_undist_keypts_.at(ref_cur_matches_.at(i).first);
-        const auto& cur_undist_keypt = cur_undist_keypts_.at(ref_cur_matches_.at(i).second);
+    // compute the parallaxes
+    // (the camera center of the reference is the origin)
+    const Vec3_t cur_cam_center = -rot_ref_to_cur.transpose() * trans_ref_to_cur;
+    const MatX3_t cur_normals = pos_cs_in_ref.rowwise() - cur_cam_center.transpose();
+    const Eigen::ArrayXd cos_parallaxes_of_matches = pos_cs_in_ref.cwiseProduct(cur_normals).rowwise().sum().array()
+                                                     / (pos_cs_in_ref.rowwise().norm().array() * cur_normals.rowwise().norm().array());
+    const VecXb_t parallax_is_small = cos_parallax_thr < cos_parallaxes_of_matches;
+
+    // reject if the 3D point is in front of the cameras
+    // (the point with the small parallax is kept regardless of the depth and the visibility, though it is not triangulated)
+    const MatX3_t pos_cs_in_cur = (pos_cs_in_ref * rot_ref_to_cur.transpose()).rowwise() + trans_ref_to_cur.transpose();
+    VecXb_t is_valid = is_finite;
+    if (depth_is_positive) {
+        is_valid = is_valid && (parallax_is_small || (0.0 < pos_cs_in_ref.col(2).array() && 0.0 < pos_cs_in_cur.col(2).array()));
+    }
 
-        // compute a reprojection error in the reference
-        Vec2_t reproj_in_ref;
-        float x_right_in_ref;
-        const auto is_valid_ref = ref_camera_->reproject_to_image(Mat33_t::Identity(), Vec3_t::Zero(), pos_c_in_ref,
-                                                                  reproj_in_ref, x_right_in_ref);
-        if (!parallax_is_small && !is_valid_ref) {
-            continue;
-        }
+    // compute the reprojection errors in the reference and the current
+    MatX2_t reprojs_in_ref;
+    VecX_t x_rights_in_ref;
+    VecXb_t is_visible_in_ref;
+    ref_camera_->reproject_points_to_image(Mat33_t::Identity(), Vec3_t::Zero(), pos_cs_in_ref,
+                                           reprojs_in_ref, x_rights_in_ref, is_visible_in_ref);
+    MatX2_t reprojs_in_cur;
+    VecX_t x_rights_in_cur;
+    VecXb_t is_visible_in_cur;
+    cur_camera_->reproject_points_to_image(rot_ref_to_cur, trans_ref_to_cur, pos_cs_in_ref,
+                                           reprojs_in_cur, x_rights_in_cur, is_visible_in_cur);
+    const Eigen::ArrayXd ref_reproj_err_sqs = (reprojs_in_ref - ref_keypts).rowwise().squaredNorm().array();
+    const Eigen::ArrayXd cur_reproj_err_sqs = (reprojs_in_cur - cur_keypts).rowwise().squaredNorm().array();
+    is_valid = is_valid
+               && (parallax_is_small || (is_visible_in_ref && is_visible_in_cur))
+               && ref_reproj_err_sqs <= reproj_err_thr_sq
+               && cur_reproj_err_sqs <= reproj_err_thr_sq;
 
-        const float ref_reproj_err_sq = (reproj_in_ref - ref_undist_keypt.pt).squaredNorm();
-        if (reproj_err_thr_sq < ref_reproj_err_sq) {
-            continue;
-        }
+    unsigned int num_valid_pts = 0;
+    num_triangulated_pts = 0;
 
-        // compute a reprojection error in the current
-        Vec2_t reproj_in_cur;
-        float x_right_in_cur;
-        const auto is_valid_cur = cur_camera_->reproject_to_image(rot_ref_to_cur, trans_ref_to_cur, pos_c_in_ref,
-                                                                  reproj_in_cur, x_right_in_cur);
-        if (!parallax_is_small && !is_valid_cur) {
-            continue;
-        }
-        const float cur_reproj_err_sq = (reproj_in_cur - cur_undist_keypt.pt).squaredNorm();
-        if (reproj_err_thr_sq < cur_reproj_err_sq) {
+    for (unsigned int j = 0; j < num_inlier_matches; ++j) {
+        if (!is_valid(j)) {
             continue;
         }
 
         // triangulation is valid
         ++num_valid_pts;
-        cos_parallaxes.push_back(cos_parallax);
+        cos_parallaxes.push_back(cos_parallaxes_of_matches(j));
 
-        if (!parallax_is_small) {
+        if (!parallax_is_small(j)) {
             // triangulated
-            triangulated_pts.at(ref_cur_matches_.at(i).first) = pos_c_in_ref;
-            is_triangulated.at(ref_cur_matches_.at(i).first) = true;
+            const auto ref_idx = ref_cur_matches_.at(inlier_match_indices.at(j)).first;
+            triangulated_pts.at(ref_idx) = pos_cs_in_ref.row(j).transpose();
+            is_triangulated.at(ref_idx) = true;
             num_triangulated_pts++;
         }
     }
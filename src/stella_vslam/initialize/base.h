@@ -15,6 +15,10 @@ namespace data {
 class frame;
 } // namespace data
 
+namespace util {
+class thread_pool;
+} // namespace util
+
 namespace initialize {
 
 class base {
@@ -51,8 +55,10 @@ public:
 
 protected:
     //! Find the most plausible pose and set them to the member variables (outputs)
+    //! (the hypotheses are reconstructed concurrently on the workers if thread_pool is not nullptr)
     bool find_most_plausible_pose(const eigen_alloc_vector<Mat33_t>& init_rots, const eigen_alloc_vector<Vec3_t>& init_transes,
-                                  const std::vector<bool>& is_inlier_match, const bool depth_is_positive);
+                                  const std::vector<bool>& is_inlier_match, const bool depth_is_positive,
+                                  util::thread_pool* thread_pool = nullptr);
 
     //! Generate 3D points from matches with valid and sufficient parallax
     unsigned int triangulate(const Mat33_t& rot_ref_to_cur, const Vec3_t& trans_ref_to_cur,
@@ -13,9 +13,10 @@ bearing_vector::bearing_vector(const data::frame& ref_frm,
                                const unsigned int min_num_valid_pts,
                                const float parallax_deg_thr,
                                const float reproj_err_thr,
-                               bool use_fixed_seed)
+                               bool use_fixed_seed,
+                               util::thread_pool* thread_pool)
     : base(ref_frm, num_ransac_iters, min_num_triangulated, min_num_valid_pts, parallax_deg_thr, reproj_err_thr),
-      use_fixed_seed_(use_fixed_seed) {
+      use_fixed_seed_(use_fixed_seed), thread_pool_(thread_pool) {
     spdlog::debug("CONSTRUCT: initialize::bearing_vector");
 }
 
@@ -27,11 +28,11 @@ bool bearing_vector::initialize(const data::frame& cur_frm, const std::vector<in
     // set the current camera model
     cur_camera_ = cur_frm.camera_;
     // store the keypoints and bearings
-    cur_undist_keypts_ = cur_frm.frm_obs_.undist_keypts_;
-    cur_bearings_ = cur_frm.frm_obs_.bearings_;
+    cur_undist_keypts_ = cur_frm.frm_obs_->undist_keypts_;
+    cur_bearings_ = cur_frm.frm_obs_->bearings_;
     // align matching information
     ref_cur_matches_.clear();
-    ref_cur_matches_.reserve(cur_frm.frm_obs_.undist_keypts_.size());
+    ref_cur_matches_.reserve(cur_frm.frm_obs_->undist_keypts_.size());
     for (unsigned int ref_idx = 0; ref_idx < ref_matches_with_cur.size(); ++ref_idx) {
         const auto cur_idx = ref_matches_with_cur.at(ref_idx);
         if (0 <= cur_idx) {
@@ -41,7 +42,7 @@ bool bearing_vector::initialize(const data::frame& cur_frm, const std::vector<in
 
     // compute an E matrix
     auto essential_solver = solve::essential_solver(ref_bearings_, cur_bearings_, ref_cur_matches_, use_fixed_seed_);
-    essential_solver.find_via_ransac(num_ransac_iters_, false);
+    essential_solver.find_via_ransac(num_ransac_iters_, false, thread_pool_);
 
     // reconstruct map if the solution is valid
     if (essential_solver.solution_is_valid()) {
@@ -67,7 +68,7 @@ bool bearing_vector::reconstruct_with_E(const Mat33_t& E_ref_to_cur, const std::
     assert(init_rots.size() == 4);
     assert(init_transes.size() == 4);
 
-    const auto pose_is_found = find_most_plausible_pose(init_rots, init_transes, is_inlier_match, false);
+    const auto pose_is_found = find_most_plausible_pose(init_rots, init_transes, is_inlier_match, false, thread_pool_);
     if (!pose_is_found) {
         return false;
     }
@@ -10,6 +10,10 @@ namespace data {
 class frame;
 } // namespace data
 
+namespace util {
+class thread_pool;
+} // namespace util
+
 namespace initialize {
 
 class bearing_vector final : public base {
@@ -25,7 +29,8 @@ public:
                    const unsigned int min_num_valid_pts,
                    const float parallax_deg_thr,
                    const float reproj_err_thr,
-                   bool use_fixed_seed = false);
+                   bool use_fixed_seed = false,
+                   util::thread_pool* thread_pool = nullptr);
 
     //! Destructor
     ~bearing_vector() override;
@@ -40,6 +45,9 @@ private:
 
     //! Use fixed random seed for RANSAC if true
     const bool use_fixed_seed_;
+
+    //! worker threads to verify the E matrix hypotheses and to reconstruct the poses concurrently (computed sequentially if nullptr)
+    util::thread_pool* const thread_pool_;
 };
 
 } // namespace initialize
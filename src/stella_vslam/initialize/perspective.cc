@@ -5,8 +5,7 @@
 #include "stella_vslam/initialize/perspective.h"
 #include "stella_vslam/solve/homography_solver.h"
 #include "stella_vslam/solve/fundamental_solver.h"
-
-#include <thread>
+#include "stella_vslam/util/thread_pool.h"
 
 #include <spdlog/spdlog.h>
 
@@ -19,9 +18,10 @@ perspective::perspective(const data::frame& ref_frm,
                          const unsigned int min_num_valid_pts,
                          const float parallax_deg_thr,
                          const float reproj_err_thr,
-                         bool use_fixed_seed)
+                         bool use_fixed_seed,
+                         util::thread_pool* thread_pool)
     : base(ref_frm, num_ransac_iters, min_num_triangulated, min_num_valid_pts, parallax_deg_thr, reproj_err_thr),
-      ref_cam_matrix_(get_camera_matrix(ref_frm.camera_)), use_fixed_seed_(use_fixed_seed) {
+      ref_cam_matrix_(get_camera_matrix(ref_frm.camera_)), use_fixed_seed_(use_fixed_seed), thread_pool_(thread_pool) {
     spdlog::debug("CONSTRUCT: initialize::perspective");
 }
 
@@ -33,11 +33,11 @@ bool perspective::initialize(const data::frame& cur_frm, const std::vector<int>&
     // set the current camera model
     cur_camera_ = cur_frm.camera_;
     // store the keypoints and bearings
-    cur_undist_keypts_ = cur_frm.frm_obs_.undist_keypts_;
-    cur_bearings_ = cur_frm.frm_obs_.bearings_;
+    cur_undist_keypts_ = cur_frm.frm_obs_->undist_keypts_;
+    cur_bearings_ = cur_frm.frm_obs_->bearings_;
     // align matching information
     ref_cur_matches_.clear();
-    ref_cur_matches_.reserve(cur_frm.frm_obs_.undist_keypts_.size());
+    ref_cur_matches_.reserve(cur_frm.frm_obs_->undist_keypts_.size());
     for (unsigned int ref_idx = 0; ref_idx < ref_matches_with_cur.size(); ++ref_idx) {
         const auto cur_idx = ref_matches_with_cur.at(ref_idx);
         if (0 <= cur_idx) {
@@ -52,10 +52,21 @@ bool perspective::initialize(const data::frame& cur_frm, const std::vector<int>&
     const float sigma = 1.0f;
     auto homography_solver = solve::homography_solver(ref_undist_keypts_, cur_undist_keypts_, ref_cur_matches_, sigma, use_fixed_seed_);
     auto fundamental_solver = solve::fundamental_solver(ref_undist_keypts_, cur_undist_keypts_, ref_cur_matches_, sigma, use_fixed_seed_);
-    std::thread thread_for_H(&solve::homography_solver::find_via_ransac, &homography_solver, num_ransac_iters_, false);
-    std::thread thread_for_F(&solve::fundamental_solver::find_via_ransac, &fundamental_solver, num_ransac_iters_, false);
-    thread_for_H.join();
-    thread_for_F.join();
+    if (thread_pool_) {
+        // H matrix is computed on a worker while F matrix is computed on this thread
+        auto future_H = thread_pool_->submit(
+            [this, &homography_solver] {
+                homography_solver.find_via_ransac(num_ransac_iters_, false);
+            },
+            util::task_priority_t::High);
+        fundamental_solver.find_via_ransac(num_ransac_iters_, false);
+        thread_pool_->wait(future_H, util::task_priority_t::High);
+        future_H.get();
+    }
+    else {
+        homography_solver.find_via_ransac(num_ransac_iters_, false);
+        fundamental_solver.find_via_ransac(num_ransac_iters_, false);
+    }
 
     // compute a cost
     const auto cost_H = homography_solver.get_best_cost();
@@ -94,7 +105,7 @@ bool perspective::reconstruct_with_H(const Mat33_t& H_ref_to_cur, const std::vec
     assert(init_rots.size() == 8);
     assert(init_transes.size() == 8);
 
-    const auto pose_is_found = find_most_plausible_pose(init_rots, init_transes, is_inlier_match, true);
+    const auto pose_is_found = find_most_plausible_pose(init_rots, init_transes, is_inlier_match, true, thread_pool_);
     if (!pose_is_found) {
         return false;
     }
@@ -116,7 +127,7 @@ bool perspective::reconstruct_with_F(const Mat33_t& F_ref_to_cur, const std::vec
     assert(init_rots.size() == 4);
     assert(init_transes.size() == 4);
 
-    const auto pose_is_found = find_most_plausible_pose(init_rots, init_transes, is_inlier_match, true);
+    const auto pose_is_found = find_most_plausible_pose(init_rots, init_transes, is_inlier_match, true, thread_pool_);
     if (!pose_is_found) {
         return false;
     }
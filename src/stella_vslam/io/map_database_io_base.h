@@ -3,6 +3,7 @@
 
 #include "stella_vslam/data/bow_vocabulary.h"
 
+#include <functional>
 #include <string>
 
 namespace stella_vslam {
@@ -19,6 +20,7 @@ class map_database_io_base {
 public:
     /**
      * Save the map database
+     * (NOTE: map_database::mtx_database_ is locked while saving)
      */
     virtual void save(const std::string& path,
                       const data::camera_database* const cam_db,
@@ -26,6 +28,16 @@ public:
                       const data::map_database* const map_db)
         = 0;
 
+    /**
+     * Save the map database without locking map_database::mtx_database_
+     * (NOTE: map_db must not be modified by the other threads, e.g. a snapshot created by map_database::create_snapshot())
+     */
+    virtual void save_unlocked(const std::string& path,
+                               const data::camera_database* const cam_db,
+                               const data::orb_params_database* const orb_params_db,
+                               const data::map_database* const map_db)
+        = 0;
+
     /**
      * Load the map database
      */
@@ -36,6 +48,35 @@ public:
                       data::bow_database* bow_db,
                       data::bow_vocabulary* bow_vocab)
         = 0;
+
+    /**
+     * Set the function called in load() before the vocabulary is used
+     * (e.g. to wait for the vocabulary loaded in parallel, then the map file is read in the meantime)
+     */
+    void set_vocabulary_waiter(const std::function<void()>& waiter) {
+        vocabulary_waiter_ = waiter;
+    }
+
+    /**
+     * Leave the loaded keyframes out of the BoW database in load()
+     * (the caller adds them later, e.g. in the background after the tracking starts)
+     */
+    void set_defer_bow_database(const bool defer_bow_database) {
+        defer_bow_database_ = defer_bow_database;
+    }
+
+protected:
+    //! Wait until the vocabulary becomes available
+    void wait_for_vocabulary() const {
+        if (vocabulary_waiter_) {
+            vocabulary_waiter_();
+        }
+    }
+
+    //! function called before the vocabulary is used (empty if it is available)
+    std::function<void()> vocabulary_waiter_;
+    //! leave the loaded keyframes out of the BoW database or not
+    bool defer_bow_database_ = false;
 };
 
 } // namespace io
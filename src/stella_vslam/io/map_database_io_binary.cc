@@ -0,0 +1,737 @@
+#include "stella_vslam/data/common.h"
+#include "stella_vslam/data/frame.h"
+#include "stella_vslam/data/keyframe.h"
+#include "stella_vslam/data/landmark.h"
+#include "stella_vslam/data/camera_database.h"
+#include "stella_vslam/data/orb_params_database.h"
+#include "stella_vslam/data/bow_database.h"
+#include "stella_vslam/data/map_database.h"
+#include "stella_vslam/io/map_database_io_binary.h"
+#include "stella_vslam/io/map_tile_streamer.h"
+#include "stella_vslam/util/mapped_file.h"
+
+#include <spdlog/spdlog.h>
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <unordered_map>
+
+namespace stella_vslam {
+namespace io {
+
+namespace {
+
+//! identifier at the beginning of the file
+constexpr char file_magic[8] = {'S', 'V', 'S', 'L', 'M', 'A', 'P', '\0'};
+//! version of the layout
+//! (version 2 appends the BoW sections, and the files of version 1 are still loadable)
+constexpr uint32_t format_version = 2;
+//! written in the native byte order to detect a mismatch on load
+constexpr uint32_t byte_order_mark = 0x01020304;
+//! alignment of each section
+constexpr uint64_t section_alignment = 64;
+//! size of an ORB descriptor in bytes
+constexpr uint64_t descriptor_size = 32;
+
+enum section_index : unsigned int {
+    //! MessagePack of the cameras, the ORB parameters and their names referred to by the keyframe records
+    meta_section = 0,
+    //! keyframe_record x num_keyframes
+    keyframe_section,
+    //! landmark_record x num_landmarks
+    landmark_section,
+    //! keypoint_record x num_keypoints
+    keypoint_section,
+    //! float x num_depths
+    stereo_x_right_section,
+    //! float x num_depths
+    depth_section,
+    //! uint8_t x descriptor_size x num_keypoints
+    descriptor_section,
+    //! int32_t x num_keypoints (-1 if no landmark is associated)
+    landmark_id_section,
+    //! int32_t x num_graph_ids (spanning children followed by loop edges of each keyframe)
+    graph_id_section,
+    //! bow_record x num_keyframes
+    bow_section,
+    //! bow_word_record x num_bow_words
+    bow_word_section,
+    //! bow_node_record x num_bow_nodes
+    bow_node_section,
+    //! uint32_t x num_bow_feature_indices (keypoint indices of each node)
+    bow_feature_index_section,
+    num_sections
+};
+
+//! number of the sections in the files of version 1
+constexpr unsigned int num_sections_v1 = graph_id_section + 1;
+
+struct section {
+    uint64_t offset_;
+    uint64_t size_;
+};
+
+struct file_header {
+    char magic_[8];
+    uint32_t version_;
+    uint32_t byte_order_mark_;
+    uint32_t keyframe_next_id_;
+    uint32_t landmark_next_id_;
+    uint64_t num_keyframes_;
+    uint64_t num_landmarks_;
+    uint64_t num_keypoints_;
+    uint64_t num_depths_;
+    uint64_t num_graph_ids_;
+    section sections_[num_sections];
+};
+
+struct keyframe_record {
+    //! camera pose (column-major)
+    double pose_cw_[16];
+    double timestamp_;
+    //! offset in the keypoint, descriptor and landmark ID sections
+    uint64_t keypts_begin_;
+    //! offset in the stereo_x_right and depth sections
+    uint64_t depths_begin_;
+    //! offset in the graph ID section
+    uint64_t graph_ids_begin_;
+    uint32_t id_;
+    uint32_t num_keypts_;
+    //! 0 (monocular) or num_keypts_
+    uint32_t num_depths_;
+    //! index of the names in the meta section
+    uint32_t camera_index_;
+    uint32_t orb_params_index_;
+    //! -1 if the keyframe is a spanning root
+    int32_t spanning_parent_id_;
+    uint32_t num_spanning_children_;
+    uint32_t num_loop_edges_;
+};
+
+struct keypoint_record {
+    float x_;
+    float y_;
+    float size_;
+    float angle_;
+    float response_;
+    int32_t octave_;
+};
+
+struct landmark_record {
+    double pos_w_[3];
+    uint32_t id_;
+    uint32_t first_keyfrm_id_;
+    uint32_t ref_keyfrm_id_;
+    uint32_t num_visible_;
+    uint32_t num_found_;
+    uint32_t padding_;
+};
+
+//! BoW of a keyframe (num_words_ is 0 if the BoW is not stored, e.g. a keyframe of a snapshot)
+struct bow_record {
+    //! offset in the BoW word section
+    uint64_t words_begin_;
+    //! offset in the BoW node section
+    uint64_t nodes_begin_;
+    uint32_t num_words_;
+    uint32_t num_nodes_;
+};
+
+struct bow_word_record {
+    uint32_t id_;
+    uint32_t padding_;
+    double value_;
+};
+
+struct bow_node_record {
+    //! offset in the BoW feature index section
+    uint64_t indices_begin_;
+    uint32_t id_;
+    uint32_t num_indices_;
+};
+
+static_assert(sizeof(keyframe_record) == 192, "keyframe_record must not have implicit padding");
+static_assert(sizeof(keypoint_record) == 24, "keypoint_record must not have implicit padding");
+static_assert(sizeof(landmark_record) == 48, "landmark_record must not have implicit padding");
+static_assert(sizeof(bow_record) == 24, "bow_record must not have implicit padding");
+static_assert(sizeof(bow_word_record) == 16, "bow_word_record must not have implicit padding");
+static_assert(sizeof(bow_node_record) == 16, "bow_node_record must not have implicit padding");
+//! the sections of version 2 are appended to the header of version 1
+constexpr size_t file_header_size_v1 = sizeof(file_header) - (num_sections - num_sections_v1) * sizeof(section);
+
+uint64_t align_offset(const uint64_t offset) {
+    return (offset + section_alignment - 1) / section_alignment * section_alignment;
+}
+
+//! Sequential writer which keeps track of the position to pad the sections
+class stream_writer {
+public:
+    explicit stream_writer(std::ofstream& ofs)
+        : ofs_(ofs) {}
+
+    void write(const void* data, const uint64_t size) {
+        ofs_.write(reinterpret_cast<const char*>(data), size);
+        pos_ += size;
+    }
+
+    void seek_section(const section& sec) {
+        assert(pos_ <= sec.offset_);
+        static const char zeros[section_alignment] = {};
+        while (pos_ < sec.offset_) {
+            write(zeros, std::min<uint64_t>(section_alignment, sec.offset_ - pos_));
+        }
+    }
+
+private:
+    std::ofstream& ofs_;
+    uint64_t pos_ = 0;
+};
+
+//! Typed view of a section in the mapped file
+template<typename T>
+const T* get_section(const util::mapped_file& file, const file_header& header, const section_index idx, const uint64_t num_elements) {
+    const auto& sec = header.sections_[idx];
+    if (sec.size_ != num_elements * sizeof(T) || file.size() < sec.offset_ || file.size() - sec.offset_ < sec.size_
+        || sec.offset_ % section_alignment != 0) {
+        throw std::runtime_error("corrupted map file: invalid section " + std::to_string(idx));
+    }
+    return reinterpret_cast<const T*>(file.data() + sec.offset_);
+}
+
+//! Get the number of the elements in the section
+template<typename T>
+uint64_t get_num_elements(const file_header& header, const section_index idx) {
+    const auto& sec = header.sections_[idx];
+    if (sec.size_ % sizeof(T) != 0) {
+        throw std::runtime_error("corrupted map file: invalid section " + std::to_string(idx));
+    }
+    return sec.size_ / sizeof(T);
+}
+
+} // namespace
+
+void map_database_io_binary::save(const std::string& path,
+                                  const data::camera_database* const cam_db,
+                                  const data::orb_params_database* const orb_params_db,
+                                  const data::map_database* const map_db) {
+    std::lock_guard<util::profiled_mutex> lock(data::map_database::mtx_database_);
+    save_unlocked(path, cam_db, orb_params_db, map_db);
+}
+
+void map_database_io_binary::save_unlocked(const std::string& path,
+                                           const data::camera_database* const cam_db,
+                                           const data::orb_params_database* const orb_params_db,
+                                           const data::map_database* const map_db) {
+    assert(cam_db && orb_params_db && map_db);
+    auto keyfrms = map_db->get_all_keyframes();
+    const auto lms = map_db->get_all_landmarks();
+    if (tile_streamer_) {
+        // store the keyframes of a tile contiguously, so that the tile is paged in at once
+        std::vector<std::pair<int64_t, std::shared_ptr<data::keyframe>>> tile_keys_and_keyfrms;
+        tile_keys_and_keyfrms.reserve(keyfrms.size());
+        for (const auto& keyfrm : keyfrms) {
+            tile_keys_and_keyfrms.emplace_back(tile_streamer_->get_tile_key(keyfrm->get_trans_wc()), keyfrm);
+        }
+        std::sort(tile_keys_and_keyfrms.begin(), tile_keys_and_keyfrms.end(),
+                  [](const std::pair<int64_t, std::shared_ptr<data::keyframe>>& a,
+                     const std::pair<int64_t, std::shared_ptr<data::keyframe>>& b) {
+                      return a.first < b.first || (a.first == b.first && a.second->id_ < b.second->id_);
+                  });
+        for (unsigned int i = 0; i < keyfrms.size(); ++i) {
+            keyfrms.at(i) = tile_keys_and_keyfrms.at(i).second;
+        }
+    }
+
+    // Step 1. Compute the layout (the graph IDs are gathered here to keep the counts consistent)
+    file_header header{};
+    std::memcpy(header.magic_, file_magic, sizeof(file_magic));
+    header.version_ = format_version;
+    header.byte_order_mark_ = byte_order_mark;
+    header.keyframe_next_id_ = map_db->next_keyframe_id_;
+    header.landmark_next_id_ = map_db->next_landmark_id_;
+    header.num_keyframes_ = keyfrms.size();
+    header.num_landmarks_ = lms.size();
+
+    std::vector<std::string> camera_names;
+    std::vector<std::string> orb_params_names;
+    std::unordered_map<std::string, uint32_t> camera_indices;
+    std::unordered_map<std::string, uint32_t> orb_params_indices;
+    std::vector<keyframe_record> keyfrm_records(keyfrms.size());
+    std::vector<int32_t> graph_ids;
+    for (unsigned int i = 0; i < keyfrms.size(); ++i) {
+        const auto& keyfrm = keyfrms.at(i);
+        assert(!keyfrm->will_be_erased());
+        const auto& frm_obs = *keyfrm->frm_obs_;
+        const auto keyfrm_descriptors = keyfrm->get_descriptors();
+        if (keyfrm_descriptors.rows != static_cast<int>(frm_obs.num_keypts_)
+            || keyfrm_descriptors.cols * keyfrm_descriptors.elemSize() != descriptor_size
+            || frm_obs.stereo_x_right_.size() != frm_obs.depths_.size()) {
+            throw std::runtime_error("keyframe " + std::to_string(keyfrm->id_) + " cannot be stored in the binary map format");
+        }
+
+        auto& record = keyfrm_records.at(i);
+        const Mat44_t pose_cw = keyfrm->get_pose_cw();
+        std::memcpy(record.pose_cw_, pose_cw.data(), sizeof(record.pose_cw_));
+        record.timestamp_ = keyfrm->timestamp_;
+        record.keypts_begin_ = header.num_keypoints_;
+        record.depths_begin_ = header.num_depths_;
+        record.graph_ids_begin_ = graph_ids.size();
+        record.id_ = keyfrm->id_;
+        record.num_keypts_ = frm_obs.num_keypts_;
+        record.num_depths_ = frm_obs.depths_.size();
+        header.num_keypoints_ += record.num_keypts_;
+        header.num_depths_ += record.num_depths_;
+
+        const auto camera_idx = camera_indices.emplace(keyfrm->camera_->name_, camera_names.size());
+        if (camera_idx.second) {
+            camera_names.push_back(keyfrm->camera_->name_);
+        }
+        record.camera_index_ = camera_idx.first->second;
+        const auto orb_params_idx = orb_params_indices.emplace(keyfrm->orb_params_->name_, orb_params_names.size());
+        if (orb_params_idx.second) {
+            orb_params_names.push_back(keyfrm->orb_params_->name_);
+        }
+        record.orb_params_index_ = orb_params_idx.first->second;
+
+        keyfrm->graph_node_->update_connections(map_db->get_min_num_shared_lms());
+        const auto spanning_parent = keyfrm->graph_node_->get_spanning_parent();
+        record.spanning_parent_id_ = spanning_parent ? static_cast<int32_t>(spanning_parent->id_) : -1;
+        const auto spanning_children = keyfrm->graph_node_->get_spanning_children();
+        for (const auto& spanning_child : spanning_children) {
+            graph_ids.push_back(spanning_child->id_);
+        }
+        record.num_spanning_children_ = spanning_children.size();
+        const auto loop_edges = keyfrm->graph_node_->get_loop_edges();
+        for (const auto& loop_edge : loop_edges) {
+            graph_ids.push_back(loop_edge->id_);
+        }
+        record.num_loop_edges_ = loop_edges.size();
+    }
+    header.num_graph_ids_ = graph_ids.size();
+
+    // the BoW is stored to skip its computation on load
+    std::vector<bow_record> bow_records(keyfrms.size());
+    std::vector<bow_word_record> bow_word_records;
+    std::vector<bow_node_record> bow_node_records;
+    std::vector<uint32_t> bow_feature_indices;
+    for (unsigned int i = 0; i < keyfrms.size(); ++i) {
+        const auto& keyfrm = keyfrms.at(i);
+        auto& record = bow_records.at(i);
+        record.words_begin_ = bow_word_records.size();
+        record.nodes_begin_ = bow_node_records.size();
+        record.num_words_ = keyfrm->bow_vec_.size();
+        record.num_nodes_ = keyfrm->bow_feat_vec_.size();
+        for (const auto& word : keyfrm->bow_vec_) {
+            bow_word_records.push_back(bow_word_record{word.first, 0, word.second});
+        }
+        for (const auto& node : keyfrm->bow_feat_vec_) {
+            bow_node_records.push_back(bow_node_record{bow_feature_indices.size(), node.first, static_cast<uint32_t>(node.second.size())});
+            bow_feature_indices.insert(bow_feature_indices.end(), node.second.begin(), node.second.end());
+        }
+    }
+
+    const nlohmann::json json_meta{{"cameras", cam_db->to_json()},
+                                   {"orb_params", orb_params_db->to_json()},
+                                   {"camera_names", camera_names},
+                                   {"orb_params_names", orb_params_names}};
+    const auto meta = nlohmann::json::to_msgpack(json_meta);
+
+    const uint64_t section_sizes[num_sections] = {
+        meta.size(),
+        header.num_keyframes_ * sizeof(keyframe_record),
+        header.num_landmarks_ * sizeof(landmark_record),
+        header.num_keypoints_ * sizeof(keypoint_record),
+        header.num_depths_ * sizeof(float),
+        header.num_depths_ * sizeof(float),
+        header.num_keypoints_ * descriptor_size,
+        header.num_keypoints_ * sizeof(int32_t),
+        header.num_graph_ids_ * sizeof(int32_t),
+        bow_records.size() * sizeof(bow_record),
+        bow_word_records.size() * sizeof(bow_word_record),
+        bow_node_records.size() * sizeof(bow_node_record),
+        bow_feature_indices.size() * sizeof(uint32_t)};
+    uint64_t offset = align_offset(sizeof(file_header));
+    for (unsigned int idx = 0; idx < num_sections; ++idx) {
+        header.sections_[idx] = section{offset, section_sizes[idx]};
+        offset = align_offset(offset + section_sizes[idx]);
+    }
+
+    // NOTE: the file is written to a temporary path, then renamed,
+    //       since the file at the path can be memory-mapped by the keyframes loaded with the descriptor paging
+    const auto tmp_path = path + ".tmp";
+    std::ofstream ofs(tmp_path, std::ios::out | std::ios::binary);
+    if (!ofs.is_open()) {
+        spdlog::critical("cannot create a file at {}", tmp_path);
+        return;
+    }
+    spdlog::info("save the binary file of database to {}", path);
+
+    // Step 2. Stream the sections
+    stream_writer writer(ofs);
+    writer.write(&header, sizeof(header));
+
+    writer.seek_section(header.sections_[meta_section]);
+    writer.write(meta.data(), meta.size());
+
+    writer.seek_section(header.sections_[keyframe_section]);
+    writer.write(keyfrm_records.data(), keyfrm_records.size() * sizeof(keyframe_record));
+
+    writer.seek_section(header.sections_[landmark_section]);
+    for (const auto& lm : lms) {
+        assert(!lm->will_be_erased());
+        landmark_record record{};
+        const Vec3_t pos_w = lm->get_pos_in_world();
+        std::memcpy(record.pos_w_, pos_w.data(), sizeof(record.pos_w_));
+        record.id_ = lm->id_;
+        record.first_keyfrm_id_ = lm->first_keyfrm_id_;
+        record.ref_keyfrm_id_ = lm->get_ref_keyframe()->id_;
+        record.num_visible_ = lm->get_num_observable();
+        record.num_found_ = lm->get_num_observed();
+        writer.write(&record, sizeof(record));
+    }
+
+    writer.seek_section(header.sections_[keypoint_section]);
+    std::vector<keypoint_record> keypt_records;
+    for (const auto& keyfrm : keyfrms) {
+        const auto& undist_keypts = keyfrm->frm_obs_->undist_keypts_;
+        keypt_records.resize(undist_keypts.size());
+        for (unsigned int idx = 0; idx < undist_keypts.size(); ++idx) {
+            const auto& keypt = undist_keypts.at(idx);
+            keypt_records.at(idx) = keypoint_record{keypt.pt.x, keypt.pt.y, keypt.size, keypt.angle, keypt.response, keypt.octave};
+        }
+        writer.write(keypt_records.data(), keypt_records.size() * sizeof(keypoint_record));
+    }
+
+    writer.seek_section(header.sections_[stereo_x_right_section]);
+    for (const auto& keyfrm : keyfrms) {
+        const auto& stereo_x_right = keyfrm->frm_obs_->stereo_x_right_;
+        writer.write(stereo_x_right.data(), stereo_x_right.size() * sizeof(float));
+    }
+
+    writer.seek_section(header.sections_[depth_section]);
+    for (const auto& keyfrm : keyfrms) {
+        const auto& depths = keyfrm->frm_obs_->depths_;
+        writer.write(depths.data(), depths.size() * sizeof(float));
+    }
+
+    writer.seek_section(header.sections_[descriptor_section]);
+    for (const auto& keyfrm : keyfrms) {
+        const auto descriptors = keyfrm->get_descriptors();
+        for (int row = 0; row < descriptors.rows; ++row) {
+            writer.write(descriptors.ptr(row), descriptor_size);
+        }
+    }
+
+    writer.seek_section(header.sections_[landmark_id_section]);
+    std::vector<int32_t> lm_ids;
+    for (const auto& keyfrm : keyfrms) {
+        const auto keyfrm_lms = keyfrm->get_landmarks();
+        lm_ids.assign(keyfrm_lms.size(), -1);
+        for (unsigned int idx = 0; idx < keyfrm_lms.size(); ++idx) {
+            if (keyfrm_lms.at(idx) && !keyfrm_lms.at(idx)->will_be_erased()) {
+                lm_ids.at(idx) = keyfrm_lms.at(idx)->id_;
+            }
+        }
+        writer.write(lm_ids.data(), lm_ids.size() * sizeof(int32_t));
+    }
+
+    writer.seek_section(header.sections_[graph_id_section]);
+    writer.write(graph_ids.data(), graph_ids.size() * sizeof(int32_t));
+
+    writer.seek_section(header.sections_[bow_section]);
+    writer.write(bow_records.data(), bow_records.size() * sizeof(bow_record));
+    writer.seek_section(header.sections_[bow_word_section]);
+    writer.write(bow_word_records.data(), bow_word_records.size() * sizeof(bow_word_record));
+    writer.seek_section(header.sections_[bow_node_section]);
+    writer.write(bow_node_records.data(), bow_node_records.size() * sizeof(bow_node_record));
+    writer.seek_section(header.sections_[bow_feature_index_section]);
+    writer.write(bow_feature_indices.data(), bow_feature_indices.size() * sizeof(uint32_t));
+
+    ofs.close();
+    if (ofs.fail()) {
+        spdlog::critical("failed to write the binary file of database to {}", tmp_path);
+        std::remove(tmp_path.c_str());
+        return;
+    }
+    if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+        spdlog::critical("failed to rename the binary file of database to {}", path);
+        std::remove(tmp_path.c_str());
+    }
+}
+
+void map_database_io_binary::load(const std::string& path,
+                                  data::camera_database* cam_db,
+                                  data::orb_params_database* orb_params_db,
+                                  data::map_database* map_db,
+                                  data::bow_database* bow_db,
+                                  data::bow_vocabulary* bow_vocab) {
+    std::lock_guard<util::profiled_mutex> lock(data::map_database::mtx_database_);
+    assert(cam_db && orb_params_db && map_db && bow_db && bow_vocab);
+
+    spdlog::info("load the binary file of database from {}", path);
+    const auto mapped = std::make_shared<util::mapped_file>(path);
+    const auto& file = *mapped;
+    // the descriptors refer to the mapped file instead of being copied
+    const bool page_descriptors = page_descriptors_ && file.is_mapped();
+    if (page_descriptors_ && !page_descriptors) {
+        spdlog::warn("the descriptors are copied since the map file cannot be memory-mapped");
+    }
+
+    // Step 1. Validate the header and the sections
+    file_header header{};
+    if (file.size() < file_header_size_v1) {
+        throw std::runtime_error("corrupted map file: too small " + path);
+    }
+    std::memcpy(&header, file.data(), file_header_size_v1);
+    if (std::memcmp(header.magic_, file_magic, sizeof(file_magic)) != 0) {
+        throw std::runtime_error("not a binary map file: " + path);
+    }
+    if (header.version_ != 1 && header.version_ != format_version) {
+        throw std::runtime_error("unsupported version of the binary map file: " + std::to_string(header.version_));
+    }
+    if (header.version_ == format_version) {
+        if (file.size() < sizeof(header)) {
+            throw std::runtime_error("corrupted map file: too small " + path);
+        }
+        std::memcpy(&header, file.data(), sizeof(header));
+    }
+    if (header.byte_order_mark_ != byte_order_mark) {
+        throw std::runtime_error("the binary map file was written with a different byte order");
+    }
+
+    const auto meta = get_section<uint8_t>(file, header, meta_section, header.sections_[meta_section].size_);
+    const auto keyfrm_records = get_section<keyframe_record>(file, header, keyframe_section, header.num_keyframes_);
+    const auto lm_records = get_section<landmark_record>(file, header, landmark_section, header.num_landmarks_);
+    const auto keypt_records = get_section<keypoint_record>(file, header, keypoint_section, header.num_keypoints_);
+    const auto stereo_x_rights = get_section<float>(file, header, stereo_x_right_section, header.num_depths_);
+    const auto depths = get_section<float>(file, header, depth_section, header.num_depths_);
+    const auto descriptors = get_section<uint8_t>(file, header, descriptor_section, header.num_keypoints_ * descriptor_size);
+    const auto lm_ids = get_section<int32_t>(file, header, landmark_id_section, header.num_keypoints_);
+    const auto graph_ids = get_section<int32_t>(file, header, graph_id_section, header.num_graph_ids_);
+    // the BoW stored in the file is used if specified (NOTE: the files of version 1 have no BoW)
+    const bool load_bow = load_bow_ && header.version_ == format_version;
+    const bow_record* bow_records = nullptr;
+    const bow_word_record* bow_word_records = nullptr;
+    const bow_node_record* bow_node_records = nullptr;
+    const uint32_t* bow_feature_indices = nullptr;
+    uint64_t num_bow_words = 0, num_bow_nodes = 0, num_bow_feature_indices = 0;
+    if (load_bow) {
+        num_bow_words = get_num_elements<bow_word_record>(header, bow_word_section);
+        num_bow_nodes = get_num_elements<bow_node_record>(header, bow_node_section);
+        num_bow_feature_indices = get_num_elements<uint32_t>(header, bow_feature_index_section);
+        bow_records = get_section<bow_record>(file, header, bow_section, header.num_keyframes_);
+        bow_word_records = get_section<bow_word_record>(file, header, bow_word_section, num_bow_words);
+        bow_node_records = get_section<bow_node_record>(file, header, bow_node_section, num_bow_nodes);
+        bow_feature_indices = get_section<uint32_t>(file, header, bow_feature_index_section, num_bow_feature_indices);
+    }
+    else if (load_bow_) {
+        spdlog::warn("the BoW is computed since the map file of version {} does not store it", header.version_);
+    }
+
+    // Step 2. Load the cameras and the ORB parameters
+    const auto json_meta = nlohmann::json::from_msgpack(meta, meta + header.sections_[meta_section].size_);
+    cam_db->from_json(json_meta.at("cameras"));
+    orb_params_db->from_json(json_meta.at("orb_params"));
+    std::vector<camera::base*> cameras;
+    for (const auto& camera_name : json_meta.at("camera_names").get<std::vector<std::string>>()) {
+        cameras.push_back(cam_db->get_camera(camera_name));
+        if (!cameras.back()) {
+            throw std::runtime_error("camera not found in the map file: " + camera_name);
+        }
+    }
+    std::vector<feature::orb_params*> orb_params;
+    for (const auto& orb_params_name : json_meta.at("orb_params_names").get<std::vector<std::string>>()) {
+        orb_params.push_back(orb_params_db->get_orb_params(orb_params_name));
+        if (!orb_params.back()) {
+            throw std::runtime_error("orb_params not found in the map file: " + orb_params_name);
+        }
+    }
+
+    // the IDs in the file are offset by the ones already used
+    const unsigned int keyfrm_id_offset = map_db->next_keyframe_id_;
+    const unsigned int lm_id_offset = map_db->next_landmark_id_;
+
+    // Step 3. Decode the keyframes
+    // (the vocabulary is needed only to compute the BoW)
+    if (!load_bow) {
+        wait_for_vocabulary();
+    }
+    spdlog::info("decoding {} keyframes to load", header.num_keyframes_);
+    for (uint64_t i = 0; i < header.num_keyframes_; ++i) {
+        const auto& record = keyfrm_records[i];
+        if (header.num_keypoints_ < record.keypts_begin_ + record.num_keypts_
+            || header.num_depths_ < record.depths_begin_ + record.num_depths_
+            || (record.num_depths_ != 0 && record.num_depths_ != record.num_keypts_)
+            || header.num_graph_ids_ < record.graph_ids_begin_ + record.num_spanning_children_ + record.num_loop_edges_
+            || cameras.size() <= record.camera_index_ || orb_params.size() <= record.orb_params_index_) {
+            throw std::runtime_error("corrupted map file: invalid keyframe record " + std::to_string(record.id_));
+        }
+        if (!load_bow) {
+            continue;
+        }
+        const auto& bow = bow_records[i];
+        if (num_bow_words < bow.words_begin_ + bow.num_words_ || num_bow_nodes < bow.nodes_begin_ + bow.num_nodes_) {
+            throw std::runtime_error("corrupted map file: invalid BoW record " + std::to_string(record.id_));
+        }
+        for (uint64_t k = bow.nodes_begin_; k < bow.nodes_begin_ + bow.num_nodes_; ++k) {
+            const auto& node = bow_node_records[k];
+            if (num_bow_feature_indices < node.indices_begin_ + node.num_indices_) {
+                throw std::runtime_error("corrupted map file: invalid BoW record " + std::to_string(record.id_));
+            }
+        }
+    }
+
+    // the records are independent of each other, so the keyframes (including the grid assignment and the BoW computation)
+    // are decoded in parallel
+    std::vector<std::shared_ptr<data::keyframe>> keyfrms(header.num_keyframes_);
+#ifdef USE_OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (int64_t i = 0; i < static_cast<int64_t>(header.num_keyframes_); ++i) {
+        const auto& record = keyfrm_records[i];
+        const auto camera = cameras.at(record.camera_index_);
+
+        Mat44_t pose_cw;
+        std::memcpy(pose_cw.data(), record.pose_cw_, sizeof(record.pose_cw_));
+
+        const auto num_keypts = record.num_keypts_;
+        std::vector<cv::KeyPoint> undist_keypts;
+        undist_keypts.reserve(num_keypts);
+        for (unsigned int idx = 0; idx < num_keypts; ++idx) {
+            const auto& keypt = keypt_records[record.keypts_begin_ + idx];
+            undist_keypts.emplace_back(keypt.x_, keypt.y_, keypt.size_, keypt.angle_, keypt.response_, keypt.octave_);
+        }
+        auto bearings = eigen_alloc_vector<Vec3_t>();
+        camera->convert_keypoints_to_bearings(undist_keypts, bearings);
+        const std::vector<float> stereo_x_right(stereo_x_rights + record.depths_begin_, stereo_x_rights + record.depths_begin_ + record.num_depths_);
+        const std::vector<float> keypt_depths(depths + record.depths_begin_, depths + record.depths_begin_ + record.num_depths_);
+        cv::Mat keypt_descriptors;
+        if (page_descriptors) {
+            // NOTE: the mapping is read-only, and the keyframe descriptors are never modified
+            keypt_descriptors = cv::Mat(num_keypts, descriptor_size, CV_8U,
+                                        const_cast<uint8_t*>(descriptors + record.keypts_begin_ * descriptor_size));
+        }
+        else {
+            // copy the descriptors out of the mapped file
+            keypt_descriptors.create(num_keypts, descriptor_size, CV_8U);
+            std::memcpy(keypt_descriptors.data, descriptors + record.keypts_begin_ * descriptor_size, num_keypts * descriptor_size);
+        }
+
+        data::bow_vector bow_vec;
+        data::bow_feature_vector bow_feat_vec;
+        // Assign all the keypoints into grid
+        data::keypoint_grid keypt_indices_in_cells;
+        data::assign_keypoints_to_grid(camera, undist_keypts, keypt_indices_in_cells);
+        // Construct frame_observation
+        // (the descriptors are held by the keyframe apart from the observations)
+        data::frame_observation frm_obs{num_keypts, cv::Mat(), undist_keypts, bearings, stereo_x_right, keypt_depths, keypt_indices_in_cells};
+        if (load_bow && 0 < bow_records[i].num_words_) {
+            // Restore BoW
+            const auto& bow = bow_records[i];
+            for (uint64_t k = bow.words_begin_; k < bow.words_begin_ + bow.num_words_; ++k) {
+                const auto& word = bow_word_records[k];
+                bow_vec.emplace(word.id_, static_cast<data::bow_vector::mapped_type>(word.value_));
+            }
+            for (uint64_t k = bow.nodes_begin_; k < bow.nodes_begin_ + bow.num_nodes_; ++k) {
+                const auto& node = bow_node_records[k];
+                bow_feat_vec.emplace(node.id_, data::bow_feature_vector::mapped_type(bow_feature_indices + node.indices_begin_,
+                                                                                      bow_feature_indices + node.indices_begin_ + node.num_indices_));
+            }
+        }
+        else {
+            // Compute BoW
+            data::bow_vocabulary_util::compute_bow(bow_vocab, keypt_descriptors, bow_vec, bow_feat_vec);
+        }
+        keyfrms.at(i) = data::keyframe::make_keyframe(
+            record.id_ + keyfrm_id_offset, record.timestamp_, pose_cw, camera, orb_params.at(record.orb_params_index_),
+            data::make_frame_observation(std::move(frm_obs)), bow_vec, bow_feat_vec, keypt_descriptors);
+    }
+
+    std::unordered_map<unsigned int, std::shared_ptr<data::keyframe>> keyfrms_by_id;
+    for (const auto& keyfrm : keyfrms) {
+        keyfrms_by_id[keyfrm->id_] = keyfrm;
+    }
+
+    const auto get_keyframe = [&keyfrms_by_id, keyfrm_id_offset](const int32_t id_in_storage) {
+        const auto iter = keyfrms_by_id.find(id_in_storage + keyfrm_id_offset);
+        if (id_in_storage < 0 || iter == keyfrms_by_id.end()) {
+            throw std::runtime_error("corrupted map file: keyframe " + std::to_string(id_in_storage) + " not found");
+        }
+        return iter->second;
+    };
+
+    // Step 4. Decode the landmarks
+    spdlog::info("decoding {} landmarks to load", header.num_landmarks_);
+    std::vector<std::shared_ptr<data::landmark>> lms;
+    lms.reserve(header.num_landmarks_);
+    std::unordered_map<unsigned int, std::shared_ptr<data::landmark>> lms_by_id;
+    for (uint64_t i = 0; i < header.num_landmarks_; ++i) {
+        const auto& record = lm_records[i];
+        const Vec3_t pos_w(record.pos_w_[0], record.pos_w_[1], record.pos_w_[2]);
+        auto lm = data::landmark::create(
+            record.id_ + lm_id_offset, record.first_keyfrm_id_ + keyfrm_id_offset, pos_w,
+            get_keyframe(record.ref_keyfrm_id_), record.num_visible_, record.num_found_);
+        lms_by_id[lm->id_] = lm;
+        lms.push_back(lm);
+    }
+
+    // Step 5. Register the graph and the keyframe-landmark associations
+    spdlog::info("registering essential graph and keyframe-landmark association");
+    for (uint64_t i = 0; i < header.num_keyframes_; ++i) {
+        const auto& record = keyfrm_records[i];
+        const auto& keyfrm = keyfrms.at(i);
+
+        keyfrm->graph_node_->set_spanning_parent((record.spanning_parent_id_ < 0) ? nullptr : get_keyframe(record.spanning_parent_id_));
+        const auto spanning_child_ids = graph_ids + record.graph_ids_begin_;
+        for (unsigned int k = 0; k < record.num_spanning_children_; ++k) {
+            keyfrm->graph_node_->add_spanning_child(get_keyframe(spanning_child_ids[k]));
+        }
+        const auto loop_edge_ids = spanning_child_ids + record.num_spanning_children_;
+        for (unsigned int k = 0; k < record.num_loop_edges_; ++k) {
+            keyfrm->graph_node_->add_loop_edge(get_keyframe(loop_edge_ids[k]));
+        }
+
+        const auto keyfrm_lm_ids = lm_ids + record.keypts_begin_;
+        for (unsigned int idx = 0; idx < record.num_keypts_; ++idx) {
+            if (keyfrm_lm_ids[idx] < 0) {
+                continue;
+            }
+            const auto iter = lms_by_id.find(keyfrm_lm_ids[idx] + lm_id_offset);
+            if (iter == lms_by_id.end()) {
+                spdlog::warn("landmark {}: not found in the database", keyfrm_lm_ids[idx] + lm_id_offset);
+                continue;
+            }
+            iter->second->connect_to_keyframe(keyfrm, idx);
+        }
+    }
+
+    // Step 6. Register to the map database
+    map_db->register_loaded_map(keyfrms, lms);
+    // load next ID
+    map_db->next_keyframe_id_ += header.keyframe_next_id_;
+    map_db->next_landmark_id_ += header.landmark_next_id_;
+
+    // update bow database
+    if (!defer_bow_database_) {
+        bow_db->add_keyframes(keyfrms);
+    }
+
+    if (page_descriptors && !keyfrms.empty()) {
+        // drop the descriptor pages read by the BoW computation, then they are paged in on demand
+        // (NOTE: the kernel evicts the clean pages of the mapping under memory pressure)
+        const auto& descriptor_sec = header.sections_[descriptor_section];
+        mapped->advise_random_access();
+        mapped->release(descriptor_sec.offset_, descriptor_sec.size_);
+        paged_files_.push_back(mapped);
+        spdlog::info("the keyframe descriptors are paged from {}", path);
+        if (tile_streamer_) {
+            tile_streamer_->add_map(mapped, keyfrms);
+        }
+    }
+}
+
+} // namespace io
+} // namespace stella_vslam
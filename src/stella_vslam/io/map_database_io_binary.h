@@ -0,0 +1,98 @@
+#ifndef STELLA_VSLAM_IO_MAP_DATABASE_IO_BINARY_H
+#define STELLA_VSLAM_IO_MAP_DATABASE_IO_BINARY_H
+
+#include "stella_vslam/io/map_database_io_base.h"
+#include "stella_vslam/data/bow_vocabulary.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace stella_vslam {
+
+namespace util {
+class mapped_file;
+} // namespace util
+
+namespace data {
+class camera_database;
+class bow_database;
+class map_database;
+} // namespace data
+
+namespace io {
+
+class map_tile_streamer;
+
+/**
+ * Map database I/O with a columnar binary layout
+ * (NOTE: the file consists of a fixed-size header followed by 64-byte aligned sections,
+ *  each of which is a contiguous array of fixed-size records (keyframes, landmarks, keypoints, descriptors, BoW, ...).
+ *  The keyframe records refer to the per-keypoint arrays by offsets, so the file is written by streaming
+ *  the records without an intermediate DOM, and is loaded from a memory-mapped view.
+ *  Only the small camera and ORB parameter databases are stored as MessagePack.
+ *  The byte order is the native one of the writer, and is checked on load.)
+ */
+class map_database_io_binary : public map_database_io_base {
+public:
+    /**
+     * Constructor
+     * @param page_descriptors if true, the descriptors of the loaded keyframes refer to the memory-mapped file
+     *                         instead of being copied, so that they are paged in on demand
+     * @param tile_streamer if not nullptr, the keyframes are saved in the order of the tiles,
+     *                      and the paged descriptors of the loaded keyframes are registered to it
+     * @param load_bow if true, the BoW of the keyframes is restored from the file instead of being computed
+     *                 (NOTE: the map must be loaded with the same vocabulary as the one used to build it)
+     */
+    explicit map_database_io_binary(const bool page_descriptors = false,
+                                    const std::shared_ptr<map_tile_streamer>& tile_streamer = nullptr,
+                                    const bool load_bow = false)
+        : page_descriptors_(page_descriptors), tile_streamer_(tile_streamer), load_bow_(load_bow) {}
+
+    /**
+     * Destructor
+     */
+    virtual ~map_database_io_binary() = default;
+
+    /**
+     * Save the map database as the columnar binary file
+     */
+    void save(const std::string& path,
+              const data::camera_database* const cam_db,
+              const data::orb_params_database* const orb_params_db,
+              const data::map_database* const map_db) override;
+
+    /**
+     * Save the map database without locking map_database::mtx_database_
+     */
+    void save_unlocked(const std::string& path,
+                       const data::camera_database* const cam_db,
+                       const data::orb_params_database* const orb_params_db,
+                       const data::map_database* const map_db) override;
+
+    /**
+     * Load the map database from the columnar binary file
+     */
+    void load(const std::string& path,
+              data::camera_database* cam_db,
+              data::orb_params_database* orb_params_db,
+              data::map_database* map_db,
+              data::bow_database* bow_db,
+              data::bow_vocabulary* bow_vocab) override;
+
+private:
+    //! the descriptors of the loaded keyframes refer to the memory-mapped file or not
+    const bool page_descriptors_;
+    //! streamer of the paged descriptors (nullptr if the map is not tiled)
+    const std::shared_ptr<map_tile_streamer> tile_streamer_;
+    //! the BoW of the loaded keyframes is restored from the file or not
+    const bool load_bow_;
+    //! files referred to by the loaded keyframes
+    //! (NOTE: they are kept until destruction since the keyframes do not own the mapping)
+    std::vector<std::shared_ptr<util::mapped_file>> paged_files_;
+};
+
+} // namespace io
+} // namespace stella_vslam
+
+#endif // STELLA_VSLAM_IO_MAP_DATABASE_IO_BINARY_H
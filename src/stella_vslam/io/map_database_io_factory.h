@@ -4,10 +4,13 @@
 #include "stella_vslam/data/bow_vocabulary.h"
 #include "stella_vslam/io/map_database_io_base.h"
 #include "stella_vslam/io/map_database_io_msgpack.h"
+#include "stella_vslam/io/map_database_io_binary.h"
 #include "stella_vslam/io/map_database_io_sqlite3.h"
 
 #include <string>
 
+#include <spdlog/spdlog.h>
+
 namespace stella_vslam {
 
 namespace data {
@@ -20,13 +23,37 @@ namespace io {
 
 class map_database_io_factory {
 public:
-    static std::shared_ptr<map_database_io_base> create(const std::string& map_format) {
+    /**
+     * Create the map database I/O of the format
+     * @param map_format "sqlite3", "msgpack" or "binary"
+     * @param page_keyframe_descriptors the descriptors of the loaded keyframes are paged in from the map file on demand
+     *                                  (supported by the binary format)
+     * @param tile_streamer streamer of the paged descriptors (supported by the binary format)
+     * @param observation_encoding encoding of the keyframe observations to save (supported by the msgpack format)
+     * @param load_bow_from_map the BoW of the keyframes is restored from the map file (supported by the binary format)
+     */
+    static std::shared_ptr<map_database_io_base> create(const std::string& map_format, const bool page_keyframe_descriptors = false,
+                                                        const std::shared_ptr<map_tile_streamer>& tile_streamer = nullptr,
+                                                        const data::observation_encoding_t observation_encoding = data::observation_encoding_t::Json,
+                                                        const bool load_bow_from_map = false) {
+        if (page_keyframe_descriptors && map_format != "binary") {
+            spdlog::warn("page_keyframe_descriptors is supported only by the binary map format");
+        }
+        if (observation_encoding != data::observation_encoding_t::Json && map_format != "msgpack") {
+            spdlog::warn("map_encoding is supported only by the msgpack map format");
+        }
+        if (load_bow_from_map && map_format != "binary") {
+            spdlog::warn("load_bow_from_map is supported only by the binary map format");
+        }
         std::shared_ptr<map_database_io_base> map_database_io;
         if (map_format == "sqlite3") {
             map_database_io = std::make_shared<io::map_database_io_sqlite3>();
         }
         else if (map_format == "msgpack") {
-            map_database_io = std::make_shared<io::map_database_io_msgpack>();
+            map_database_io = std::make_shared<io::map_database_io_msgpack>(observation_encoding);
+        }
+        else if (map_format == "binary") {
+            map_database_io = std::make_shared<io::map_database_io_binary>(page_keyframe_descriptors, tile_streamer, load_bow_from_map);
         }
         else {
             throw std::runtime_error("Invalid map format: " + map_format);
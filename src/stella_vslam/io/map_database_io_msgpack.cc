@@ -19,14 +19,20 @@ void map_database_io_msgpack::save(const std::string& path,
                                    const data::camera_database* const cam_db,
                                    const data::orb_params_database* const orb_params_db,
                                    const data::map_database* const map_db) {
-    std::lock_guard<std::mutex> lock(data::map_database::mtx_database_);
+    std::lock_guard<util::profiled_mutex> lock(data::map_database::mtx_database_);
+    save_unlocked(path, cam_db, orb_params_db, map_db);
+}
 
+void map_database_io_msgpack::save_unlocked(const std::string& path,
+                                            const data::camera_database* const cam_db,
+                                            const data::orb_params_database* const orb_params_db,
+                                            const data::map_database* const map_db) {
     assert(cam_db && orb_params_db && map_db);
     const auto cameras = cam_db->to_json();
     const auto orb_params = orb_params_db->to_json();
     nlohmann::json keyfrms;
     nlohmann::json landmarks;
-    map_db->to_json(keyfrms, landmarks);
+    map_db->to_json(keyfrms, landmarks, encoding_);
 
     nlohmann::json json{{"cameras", cameras},
                         {"orb_params", orb_params},
@@ -54,7 +60,7 @@ void map_database_io_msgpack::load(const std::string& path,
                                    data::map_database* map_db,
                                    data::bow_database* bow_db,
                                    data::bow_vocabulary* bow_vocab) {
-    std::lock_guard<std::mutex> lock(data::map_database::mtx_database_);
+    std::lock_guard<util::profiled_mutex> lock(data::map_database::mtx_database_);
     assert(cam_db && orb_params_db && map_db && bow_db && bow_vocab);
 
     // load binary bytes
@@ -88,15 +94,16 @@ void map_database_io_msgpack::load(const std::string& path,
     orb_params_db->from_json(json_orb_params);
     const auto json_keyfrms = json.at("keyframes");
     const auto json_landmarks = json.at("landmarks");
+    // (the file is read and parsed while the vocabulary is being loaded)
+    wait_for_vocabulary();
     map_db->from_json(cam_db, orb_params_db, bow_vocab, json_keyfrms, json_landmarks);
     // load next ID
     map_db->next_keyframe_id_ += json.at("keyframe_next_id").get<unsigned int>();
     map_db->next_landmark_id_ += json.at("landmark_next_id").get<unsigned int>();
 
     // update bow database
-    const auto keyfrms = map_db->get_all_keyframes();
-    for (const auto& keyfrm : keyfrms) {
-        bow_db->add_keyframe(keyfrm);
+    if (!defer_bow_database_) {
+        bow_db->add_keyframes(map_db->get_all_keyframes());
     }
 }
 
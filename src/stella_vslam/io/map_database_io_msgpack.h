@@ -3,6 +3,7 @@
 
 #include "stella_vslam/io/map_database_io_base.h"
 #include "stella_vslam/data/bow_vocabulary.h"
+#include "stella_vslam/data/observation_encoding.h"
 
 #include <string>
 
@@ -20,8 +21,10 @@ class map_database_io_msgpack : public map_database_io_base {
 public:
     /**
      * Constructor
+     * @param encoding encoding of the keypoints, the descriptors and the stereo observations of the keyframes to save
      */
-    map_database_io_msgpack() = default;
+    explicit map_database_io_msgpack(const data::observation_encoding_t encoding = data::observation_encoding_t::Json)
+        : encoding_(encoding) {}
 
     /**
      * Destructor
@@ -36,6 +39,14 @@ public:
               const data::orb_params_database* const orb_params_db,
               const data::map_database* const map_db) override;
 
+    /**
+     * Save the map database without locking map_database::mtx_database_
+     */
+    void save_unlocked(const std::string& path,
+                       const data::camera_database* const cam_db,
+                       const data::orb_params_database* const orb_params_db,
+                       const data::map_database* const map_db) override;
+
     /**
      * Load the map database from MessagePack
      */
@@ -45,6 +56,10 @@ public:
               data::map_database* map_db,
               data::bow_database* bow_db,
               data::bow_vocabulary* bow_vocab) override;
+
+private:
+    //! Encoding of the keyframe observations to save (any encoding can be loaded)
+    const data::observation_encoding_t encoding_;
 };
 
 } // namespace io
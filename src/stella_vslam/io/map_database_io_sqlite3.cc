@@ -5,6 +5,7 @@
 #include "stella_vslam/data/bow_database.h"
 #include "stella_vslam/data/map_database.h"
 #include "stella_vslam/io/map_database_io_sqlite3.h"
+#include "stella_vslam/util/sqlite3.h"
 
 #include <spdlog/spdlog.h>
 #include <nlohmann/json.hpp>
@@ -19,8 +20,14 @@ void map_database_io_sqlite3::save(const std::string& path,
                                    const data::camera_database* const cam_db,
                                    const data::orb_params_database* const orb_params_db,
                                    const data::map_database* const map_db) {
-    std::lock_guard<std::mutex> lock(data::map_database::mtx_database_);
+    std::lock_guard<util::profiled_mutex> lock(data::map_database::mtx_database_);
+    save_unlocked(path, cam_db, orb_params_db, map_db);
+}
 
+void map_database_io_sqlite3::save_unlocked(const std::string& path,
+                                            const data::camera_database* const cam_db,
+                                            const data::orb_params_database* const orb_params_db,
+                                            const data::map_database* const map_db) {
     assert(cam_db && map_db);
 
     // Open database
@@ -31,14 +38,35 @@ void map_database_io_sqlite3::save(const std::string& path,
         return;
     }
 
-    // Write data into database
-    bool ok = save_stats(db, map_db);
+    // NOTE: the journal mode is persistent in the database file
+    if (!util::sqlite3_util::enable_wal(db)) {
+        spdlog::warn("Failed to enable the write-ahead logging of SQL database");
+    }
+
+    // The keyframes and the landmarks modified since the last save are written if the map is saved again to the same file
+    const auto saved_epoch = map_db->advance_save_epoch();
+    const bool incremental = path == last_saved_path_
+                             && util::sqlite3_util::table_exists(db, "keyframes")
+                             && util::sqlite3_util::table_exists(db, "landmarks")
+                             && util::sqlite3_util::table_exists(db, "associations");
+
+    // Write data into database in a single transaction
+    bool ok = util::sqlite3_util::begin(db);
+    ok = ok && save_stats(db, map_db);
     ok = ok && cam_db->to_db(db);
-    ok = ok && map_db->to_db(db);
+    ok = ok && map_db->to_db(db, incremental, last_saved_epoch_ + 1);
+    if (ok) {
+        ok = util::sqlite3_util::commit(db);
+    }
+    else {
+        util::sqlite3_util::rollback(db);
+    }
 
     sqlite3_close(db);
     if (ok) {
-        spdlog::info("Save the map database to {}", path);
+        last_saved_path_ = path;
+        last_saved_epoch_ = saved_epoch;
+        spdlog::info("Save the map database to {}{}", path, incremental ? " (incremental)" : "");
     }
     else {
         spdlog::info("Failed save the map database");
@@ -51,9 +79,12 @@ void map_database_io_sqlite3::load(const std::string& path,
                                    data::map_database* map_db,
                                    data::bow_database* bow_db,
                                    data::bow_vocabulary* bow_vocab) {
-    std::lock_guard<std::mutex> lock(data::map_database::mtx_database_);
+    std::lock_guard<util::profiled_mutex> lock(data::map_database::mtx_database_);
     assert(cam_db && map_db && bow_db && bow_vocab);
 
+    // the next save to the last saved file recreates the tables
+    last_saved_path_.clear();
+
     // Open database
     sqlite3* db = nullptr;
     int ret = sqlite3_open(path.c_str(), &db);
@@ -64,15 +95,13 @@ void map_database_io_sqlite3::load(const std::string& path,
 
     // load from database
     bool ok = cam_db->from_db(db);
+    wait_for_vocabulary();
     ok = ok && map_db->from_db(db, cam_db, orb_params_db, bow_vocab);
     ok = ok && load_stats(db, map_db);
 
     // update bow database
-    if (ok) {
-        const auto keyfrms = map_db->get_all_keyframes();
-        for (const auto& keyfrm : keyfrms) {
-            bow_db->add_keyframe(keyfrm);
-        }
+    if (ok && !defer_bow_database_) {
+        bow_db->add_keyframes(map_db->get_all_keyframes());
     }
 
     sqlite3_close(db);
@@ -83,9 +112,6 @@ bool map_database_io_sqlite3::save_stats(sqlite3* db, const data::map_database*
     if (ret == SQLITE_OK) {
         ret = sqlite3_exec(db, "CREATE TABLE stats(id INTEGER PRIMARY KEY, frame_next_id INTEGER, keyframe_next_id INTEGER, landmark_next_id INTEGER);", nullptr, nullptr, nullptr);
     }
-    if (ret == SQLITE_OK) {
-        ret = sqlite3_exec(db, "BEGIN;", nullptr, nullptr, nullptr);
-    }
     sqlite3_stmt* stmt = nullptr;
     if (ret == SQLITE_OK) {
         ret = sqlite3_prepare_v2(db, "INSERT INTO stats(id, frame_next_id, keyframe_next_id, landmark_next_id) VALUES(?, ?, ?, ?)", -1, &stmt, nullptr);
@@ -114,16 +140,7 @@ bool map_database_io_sqlite3::save_stats(sqlite3* db, const data::map_database*
         spdlog::error("SQLite step is not done: {}", sqlite3_errmsg(db));
     }
     sqlite3_finalize(stmt);
-    if (ret == SQLITE_DONE) {
-        ret = sqlite3_exec(db, "COMMIT;", nullptr, nullptr, nullptr);
-    }
-    if (ret != SQLITE_OK) {
-        spdlog::error("SQLite error: {}", sqlite3_errmsg(db));
-        return false;
-    }
-    else {
-        return true;
-    }
+    return ret == SQLITE_DONE;
 }
 
 bool map_database_io_sqlite3::load_stats(sqlite3* db, data::map_database* map_db) const {
@@ -38,6 +38,14 @@ public:
               const data::orb_params_database* const orb_params_db,
               const data::map_database* const map_db) override;
 
+    /**
+     * Save the map database without locking map_database::mtx_database_
+     */
+    void save_unlocked(const std::string& path,
+                       const data::camera_database* const cam_db,
+                       const data::orb_params_database* const orb_params_db,
+                       const data::map_database* const map_db) override;
+
     /**
      * Load the map database from MessagePack
      */
@@ -49,8 +57,14 @@ public:
               data::bow_vocabulary* bow_vocab) override;
 
 private:
+    //! (NOTE: the caller must begin and commit the transaction)
     bool save_stats(sqlite3* db, const data::map_database* map_db) const;
     bool load_stats(sqlite3* db, data::map_database* map_db) const;
+
+    //! Path of the last successful save
+    std::string last_saved_path_;
+    //! Save epoch of the last successful save
+    unsigned int last_saved_epoch_ = 0;
 };
 
 } // namespace io
@@ -0,0 +1,148 @@
+#include "stella_vslam/data/keyframe.h"
+#include "stella_vslam/io/map_tile_streamer.h"
+#include "stella_vslam/util/mapped_file.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+
+#include <spdlog/spdlog.h>
+
+namespace stella_vslam {
+namespace io {
+
+namespace {
+// 21 bits for each axis
+constexpr int64_t tile_index_bits = 21;
+constexpr int64_t tile_index_offset = int64_t(1) << (tile_index_bits - 1);
+constexpr int64_t tile_index_mask = (int64_t(1) << tile_index_bits) - 1;
+
+int64_t encode_tile_key(const int64_t ix, const int64_t iy, const int64_t iz) {
+    return (((ix + tile_index_offset) & tile_index_mask) << (2 * tile_index_bits))
+           | (((iy + tile_index_offset) & tile_index_mask) << tile_index_bits)
+           | ((iz + tile_index_offset) & tile_index_mask);
+}
+
+void decode_tile_key(const int64_t key, int64_t& ix, int64_t& iy, int64_t& iz) {
+    ix = ((key >> (2 * tile_index_bits)) & tile_index_mask) - tile_index_offset;
+    iy = ((key >> tile_index_bits) & tile_index_mask) - tile_index_offset;
+    iz = (key & tile_index_mask) - tile_index_offset;
+}
+} // namespace
+
+map_tile_streamer::map_tile_streamer(const double tile_size, const unsigned int num_neighbor_tiles)
+    : tile_size_(tile_size), num_neighbor_tiles_(static_cast<int>(num_neighbor_tiles)) {
+    spdlog::debug("CONSTRUCT: io::map_tile_streamer");
+    if (tile_size_ <= 0.0) {
+        throw std::runtime_error("tile_size must be positive");
+    }
+}
+
+map_tile_streamer::map_tile_streamer(const YAML::Node& yaml_node)
+    : map_tile_streamer(yaml_node["tile_size"].as<double>(50.0),
+                        yaml_node["num_neighbor_tiles"].as<unsigned int>(1)) {}
+
+int64_t map_tile_streamer::get_tile_key(const Vec3_t& pos_w) const {
+    return encode_tile_key(static_cast<int64_t>(std::floor(pos_w(0) / tile_size_)),
+                           static_cast<int64_t>(std::floor(pos_w(1) / tile_size_)),
+                           static_cast<int64_t>(std::floor(pos_w(2) / tile_size_)));
+}
+
+void map_tile_streamer::add_map(const std::shared_ptr<util::mapped_file>& file,
+                                const std::vector<std::shared_ptr<data::keyframe>>& keyfrms) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    const auto file_begin = file->data();
+    const auto file_end = file->data() + file->size();
+    for (const auto& keyfrm : keyfrms) {
+        const auto descriptors = keyfrm->get_descriptors();
+        const uint8_t* begin = descriptors.data;
+        const size_t size = descriptors.total() * descriptors.elemSize();
+        if (size == 0 || begin < file_begin || file_end < begin + size) {
+            continue;
+        }
+        auto& ranges = tiles_[get_tile_key(keyfrm->get_trans_wc())].ranges_;
+        const size_t offset = begin - file_begin;
+        // merge the contiguous ranges (the keyframes are stored in the order of the tiles)
+        if (!ranges.empty() && ranges.back().first == file
+            && ranges.back().second.first + ranges.back().second.second == offset) {
+            ranges.back().second.second += size;
+        }
+        else {
+            ranges.emplace_back(file, std::make_pair(offset, size));
+        }
+    }
+    // the tiles are loaded again around the camera
+    has_curr_key_ = false;
+    resident_keys_.clear();
+    spdlog::info("map tiles: {} tiles of {} m", tiles_.size(), tile_size_);
+}
+
+void map_tile_streamer::update(const Vec3_t& cam_center) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    const auto key = get_tile_key(cam_center);
+    if (tiles_.empty() || (has_curr_key_ && key == curr_key_)) {
+        return;
+    }
+    curr_key_ = key;
+    has_curr_key_ = true;
+
+    int64_t cx, cy, cz;
+    decode_tile_key(key, cx, cy, cz);
+    std::unordered_set<int64_t> keys_to_be_resident;
+    for (int64_t dx = -num_neighbor_tiles_; dx <= num_neighbor_tiles_; ++dx) {
+        for (int64_t dy = -num_neighbor_tiles_; dy <= num_neighbor_tiles_; ++dy) {
+            for (int64_t dz = -num_neighbor_tiles_; dz <= num_neighbor_tiles_; ++dz) {
+                const auto neighbor_key = encode_tile_key(cx + dx, cy + dy, cz + dz);
+                if (tiles_.count(neighbor_key)) {
+                    keys_to_be_resident.insert(neighbor_key);
+                }
+            }
+        }
+    }
+
+    for (const auto resident_key : resident_keys_) {
+        if (!keys_to_be_resident.count(resident_key)) {
+            release(tiles_.at(resident_key));
+        }
+    }
+    for (const auto resident_key : keys_to_be_resident) {
+        if (!resident_keys_.count(resident_key)) {
+            prefetch(tiles_.at(resident_key));
+        }
+    }
+    spdlog::debug("map tiles: {} resident tiles", keys_to_be_resident.size());
+    resident_keys_ = std::move(keys_to_be_resident);
+}
+
+void map_tile_streamer::clear() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    tiles_.clear();
+    resident_keys_.clear();
+    has_curr_key_ = false;
+}
+
+unsigned int map_tile_streamer::get_num_tiles() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return tiles_.size();
+}
+
+unsigned int map_tile_streamer::get_num_resident_tiles() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return resident_keys_.size();
+}
+
+void map_tile_streamer::prefetch(const tile& t) const {
+    for (const auto& range : t.ranges_) {
+        range.first->prefetch(range.second.first, range.second.second);
+    }
+}
+
+void map_tile_streamer::release(const tile& t) const {
+    for (const auto& range : t.ranges_) {
+        range.first->release(range.second.first, range.second.second);
+    }
+}
+
+} // namespace io
+} // namespace stella_vslam
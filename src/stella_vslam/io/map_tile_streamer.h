@@ -0,0 +1,97 @@
+#ifndef STELLA_VSLAM_IO_MAP_TILE_STREAMER_H
+#define STELLA_VSLAM_IO_MAP_TILE_STREAMER_H
+
+#include "stella_vslam/type.h"
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <yaml-cpp/yaml.h>
+
+namespace stella_vslam {
+
+namespace data {
+class keyframe;
+} // namespace data
+
+namespace util {
+class mapped_file;
+} // namespace util
+
+namespace io {
+
+/**
+ * Streamer of the spatial tiles of the keyframe descriptors paged from the binary map file (see map_database_io_binary)
+ * The keyframes are grouped by the cubic tiles of their camera centers.
+ * The descriptors of the tiles around the current camera are prefetched, and the ones of the other tiles are released,
+ * so that only the neighborhood of the camera is resident while the poses and the BoW (global index) are kept for all of the keyframes.
+ * (NOTE: the binary writer stores the keyframes in the order of the tiles, so the descriptors of a tile are contiguous in the file.)
+ */
+class map_tile_streamer {
+public:
+    /**
+     * Constructor
+     * @param tile_size edge length of a tile [m]
+     * @param num_neighbor_tiles tiles within this Chebyshev distance (in tiles) from the current one are resident
+     */
+    explicit map_tile_streamer(const double tile_size = 50.0, const unsigned int num_neighbor_tiles = 1);
+
+    explicit map_tile_streamer(const YAML::Node& yaml_node);
+
+    //! Key of the tile which contains the point
+    int64_t get_tile_key(const Vec3_t& pos_w) const;
+
+    /**
+     * Register the descriptors of the keyframes loaded from the mapped file
+     * (NOTE: the descriptors of the keyframes must refer to the file. They are released until the camera comes close.)
+     */
+    void add_map(const std::shared_ptr<util::mapped_file>& file,
+                 const std::vector<std::shared_ptr<data::keyframe>>& keyfrms);
+
+    /**
+     * Prefetch the tiles around the camera center and release the others
+     * (NOTE: nothing is done if the camera stays in the same tile. The pages are read ahead by the kernel asynchronously.)
+     */
+    void update(const Vec3_t& cam_center);
+
+    //! Forget all of the tiles
+    void clear();
+
+    //! Number of the registered tiles
+    unsigned int get_num_tiles() const;
+
+    //! Number of the resident tiles
+    unsigned int get_num_resident_tiles() const;
+
+private:
+    //! Byte ranges of the descriptors in a mapped file
+    struct tile {
+        std::vector<std::pair<std::shared_ptr<util::mapped_file>, std::pair<size_t, size_t>>> ranges_;
+    };
+
+    void prefetch(const tile& t) const;
+    void release(const tile& t) const;
+
+    //! edge length of a tile
+    const double tile_size_;
+    //! tiles within this distance from the current one are resident
+    const int num_neighbor_tiles_;
+
+    mutable std::mutex mtx_;
+    //! all of the tiles
+    std::unordered_map<int64_t, tile> tiles_;
+    //! keys of the resident tiles
+    std::unordered_set<int64_t> resident_keys_;
+    //! key of the tile of the last update (the tiles are updated when it changes)
+    int64_t curr_key_ = 0;
+    bool has_curr_key_ = false;
+};
+
+} // namespace io
+} // namespace stella_vslam
+
+#endif // STELLA_VSLAM_IO_MAP_TILE_STREAMER_H
@@ -0,0 +1,164 @@
+#include "stella_vslam/io/replay_log.h"
+
+#include <cstdint>
+#include <stdexcept>
+
+#include <spdlog/spdlog.h>
+#include <nlohmann/json.hpp>
+
+namespace stella_vslam {
+namespace io {
+
+namespace {
+
+//! version of the log format
+constexpr unsigned int replay_log_version = 1;
+
+void write_mat(std::ofstream& ofs, const cv::Mat& mat) {
+    const int32_t header[3] = {mat.rows, mat.cols, mat.type()};
+    ofs.write(reinterpret_cast<const char*>(header), sizeof(header));
+    const auto row_bytes = mat.cols * mat.elemSize();
+    for (int y = 0; y < mat.rows; ++y) {
+        ofs.write(reinterpret_cast<const char*>(mat.ptr(y)), row_bytes);
+    }
+}
+
+cv::Mat read_mat(std::ifstream& ifs) {
+    int32_t header[3];
+    ifs.read(reinterpret_cast<char*>(header), sizeof(header));
+    cv::Mat mat(header[0], header[1], header[2]);
+    ifs.read(reinterpret_cast<char*>(mat.data), mat.total() * mat.elemSize());
+    if (!ifs) {
+        throw std::runtime_error("replay log: the input file is truncated");
+    }
+    return mat;
+}
+
+} // namespace
+
+replay_recorder::replay_recorder(const std::string& dir_path, const std::string& setup_type) {
+    spdlog::debug("CONSTRUCT: io::replay_recorder");
+    ofs_inputs_.open(dir_path + "/inputs.bin", std::ios::out | std::ios::binary);
+    ofs_frames_.open(dir_path + "/frames.jsonl", std::ios::out);
+    if (!ofs_inputs_.is_open() || !ofs_frames_.is_open()) {
+        spdlog::critical("cannot create the replay log in {}", dir_path);
+        throw std::runtime_error("cannot create the replay log in " + dir_path);
+    }
+    spdlog::info("record the fed frames to {}", dir_path);
+    // the header line
+    ofs_frames_ << nlohmann::json{{"version", replay_log_version}, {"setup_type", setup_type}}.dump() << std::endl;
+}
+
+replay_recorder::~replay_recorder() {
+    if (!queued_frms_.empty()) {
+        spdlog::warn("replay log: {} frames were fed but not tracked", queued_frms_.size());
+    }
+    spdlog::info("recorded {} frames", num_recorded_frms_);
+    spdlog::debug("DESTRUCT: io::replay_recorder");
+}
+
+void replay_recorder::queue_inputs(const double timestamp, const std::vector<cv::Mat>& imgs, const cv::Mat& mask) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    replay_frame frm;
+    frm.idx_ = num_queued_frms_++;
+    frm.timestamp_ = timestamp;
+    frm.num_imgs_ = imgs.size();
+    frm.has_mask_ = !mask.empty();
+    frm.offset_ = ofs_inputs_.tellp();
+    for (const auto& img : imgs) {
+        write_mat(ofs_inputs_, img);
+    }
+    if (frm.has_mask_) {
+        write_mat(ofs_inputs_, mask);
+    }
+    queued_frms_.push_back(frm);
+}
+
+void replay_recorder::discard_inputs(const double timestamp) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    // (the images are left in the file without being referred)
+    for (auto itr = queued_frms_.begin(); itr != queued_frms_.end(); ++itr) {
+        if (itr->timestamp_ == timestamp) {
+            queued_frms_.erase(itr);
+            return;
+        }
+    }
+}
+
+void replay_recorder::record_tracking(const unsigned int num_mapped_keyfrms, const double feed_time_ms) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    // the frame is not fed via feed_*_frame()
+    if (queued_frms_.empty()) {
+        return;
+    }
+    auto frm = queued_frms_.front();
+    queued_frms_.pop_front();
+    frm.num_mapped_keyfrms_ = num_mapped_keyfrms;
+    frm.feed_time_ms_ = feed_time_ms;
+
+    // the images are flushed before the frame, so that the log of a crashed run can be replayed up to the last line
+    ofs_inputs_.flush();
+    const nlohmann::json json_frm = {{"idx", frm.idx_},
+                                     {"timestamp", frm.timestamp_},
+                                     {"num_imgs", frm.num_imgs_},
+                                     {"has_mask", frm.has_mask_},
+                                     {"offset", static_cast<long long>(frm.offset_)},
+                                     {"num_mapped_keyframes", frm.num_mapped_keyfrms_},
+                                     {"feed_time_ms", frm.feed_time_ms_}};
+    ofs_frames_ << json_frm.dump() << std::endl;
+    ++num_recorded_frms_;
+}
+
+unsigned int replay_recorder::get_num_recorded_frames() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return num_recorded_frms_;
+}
+
+replay_log::replay_log(const std::string& dir_path) {
+    std::ifstream ifs_frames(dir_path + "/frames.jsonl", std::ios::in);
+    ifs_inputs_.open(dir_path + "/inputs.bin", std::ios::in | std::ios::binary);
+    if (!ifs_frames.is_open() || !ifs_inputs_.is_open()) {
+        spdlog::critical("cannot load the replay log in {}", dir_path);
+        throw std::runtime_error("cannot load the replay log in " + dir_path);
+    }
+
+    std::string line;
+    if (!std::getline(ifs_frames, line)) {
+        throw std::runtime_error("replay log: the header is missing");
+    }
+    const auto json_header = nlohmann::json::parse(line);
+    if (json_header.at("version").get<unsigned int>() != replay_log_version) {
+        throw std::runtime_error("replay log: unsupported version");
+    }
+    setup_type_ = json_header.at("setup_type").get<std::string>();
+
+    while (std::getline(ifs_frames, line)) {
+        if (line.empty()) {
+            continue;
+        }
+        const auto json_frm = nlohmann::json::parse(line);
+        replay_frame frm;
+        frm.idx_ = json_frm.at("idx").get<unsigned int>();
+        frm.timestamp_ = json_frm.at("timestamp").get<double>();
+        frm.num_imgs_ = json_frm.at("num_imgs").get<unsigned int>();
+        frm.has_mask_ = json_frm.at("has_mask").get<bool>();
+        frm.offset_ = json_frm.at("offset").get<long long>();
+        frm.num_mapped_keyfrms_ = json_frm.at("num_mapped_keyframes").get<unsigned int>();
+        frm.feed_time_ms_ = json_frm.at("feed_time_ms").get<double>();
+        frms_.push_back(frm);
+    }
+    spdlog::info("load the replay log of {} frames from {}", frms_.size(), dir_path);
+}
+
+void replay_log::load_inputs(const replay_frame& frm, std::vector<cv::Mat>& imgs, cv::Mat& mask) {
+    ifs_inputs_.clear();
+    ifs_inputs_.seekg(frm.offset_);
+    imgs.resize(frm.num_imgs_);
+    for (auto& img : imgs) {
+        img = read_mat(ifs_inputs_);
+    }
+    mask = frm.has_mask_ ? read_mat(ifs_inputs_) : cv::Mat{};
+}
+
+} // namespace io
+} // namespace stella_vslam
@@ -0,0 +1,123 @@
+#ifndef STELLA_VSLAM_IO_REPLAY_LOG_H
+#define STELLA_VSLAM_IO_REPLAY_LOG_H
+
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <opencv2/core/mat.hpp>
+
+namespace stella_vslam {
+namespace io {
+
+/**
+ * Recorded input and scheduling decision of a frame
+ */
+struct replay_frame {
+    //! index of the frame in the log
+    unsigned int idx_ = 0;
+    //! timestamp of the frame
+    double timestamp_ = 0.0;
+    //! number of the images (monocular: 1, stereo: left and right, RGBD: RGB and depth)
+    unsigned int num_imgs_ = 0;
+    //! the mask is recorded or not
+    bool has_mask_ = false;
+    //! offset of the images in the input file [bytes]
+    std::streamoff offset_ = 0;
+    //! number of the keyframes which the mapping module had processed before the frame was tracked
+    //! (counted from the start of the recording)
+    unsigned int num_mapped_keyfrms_ = 0;
+    //! duration of the feeding in the recorded run [ms]
+    double feed_time_ms_ = 0.0;
+};
+
+/**
+ * Recorder of the fed frames and the scheduling of the mapping module
+ * The images are stored in "inputs.bin" without compression, and the frames are appended to "frames.jsonl" (one JSON per line).
+ * The inputs are queued when a frame is fed, and completed with the scheduling when the frame is tracked,
+ * so the frames fed to the extraction pipeline are recorded in the tracked order as well.
+ */
+class replay_recorder {
+public:
+    /**
+     * Constructor
+     * @param dir_path directory of the log (must exist)
+     * @param setup_type setup type of the camera (checked when replayed)
+     */
+    replay_recorder(const std::string& dir_path, const std::string& setup_type);
+
+    /**
+     * Destructor
+     */
+    ~replay_recorder();
+
+    //! Write the images of a fed frame (the frame is completed by record_tracking())
+    void queue_inputs(const double timestamp, const std::vector<cv::Mat>& imgs, const cv::Mat& mask);
+
+    //! Discard the queued frame of the timestamp which is not tracked (e.g. dropped by the frame QoS)
+    void discard_inputs(const double timestamp);
+
+    //! Complete the oldest queued frame with the number of the mapped keyframes and the feeding time
+    void record_tracking(const unsigned int num_mapped_keyfrms, const double feed_time_ms);
+
+    //! Get the number of the recorded frames
+    unsigned int get_num_recorded_frames() const;
+
+private:
+    mutable std::mutex mtx_;
+    //! file of the images
+    std::ofstream ofs_inputs_;
+    //! file of the frames
+    std::ofstream ofs_frames_;
+    //! frames whose inputs are written but not tracked yet
+    std::deque<replay_frame> queued_frms_;
+    //! number of the written frames
+    unsigned int num_recorded_frms_ = 0;
+    //! number of the frames whose inputs are written
+    unsigned int num_queued_frms_ = 0;
+};
+
+/**
+ * Reader of the log written by replay_recorder
+ */
+class replay_log {
+public:
+    /**
+     * Constructor
+     * @param dir_path directory of the log
+     */
+    explicit replay_log(const std::string& dir_path);
+
+    //! Get the setup type of the camera of the recorded run
+    const std::string& get_setup_type() const {
+        return setup_type_;
+    }
+
+    //! Get the recorded frames
+    const std::vector<replay_frame>& get_frames() const {
+        return frms_;
+    }
+
+    /**
+     * Load the images of the frame
+     * @param frm
+     * @param imgs
+     * @param mask (empty if not recorded)
+     */
+    void load_inputs(const replay_frame& frm, std::vector<cv::Mat>& imgs, cv::Mat& mask);
+
+private:
+    //! setup type of the camera
+    std::string setup_type_;
+    //! recorded frames
+    std::vector<replay_frame> frms_;
+    //! file of the images
+    std::ifstream ifs_inputs_;
+};
+
+} // namespace io
+} // namespace stella_vslam
+
+#endif // STELLA_VSLAM_IO_REPLAY_LOG_H
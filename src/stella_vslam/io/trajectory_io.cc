@@ -3,6 +3,7 @@
 #include "stella_vslam/io/trajectory_io.h"
 #include "stella_vslam/util/converter.h"
 
+#include <cmath>
 #include <iostream>
 #include <iomanip>
 
@@ -18,7 +19,7 @@ trajectory_io::trajectory_io(data::map_database* map_db)
     : map_db_(map_db) {}
 
 void trajectory_io::save_frame_trajectory(const std::string& path, const std::string& format) const {
-    std::lock_guard<std::mutex> lock(data::map_database::mtx_database_);
+    std::lock_guard<util::profiled_mutex> lock(data::map_database::mtx_database_);
 
     // 1. acquire the frame stats
 
@@ -46,6 +47,7 @@ void trajectory_io::save_frame_trajectory(const std::string& path, const std::st
 
     spdlog::info("dump frame trajectory in \"{}\" format from frame {} to frame {} ({} frames)",
                  format, reference_keyframes.begin()->first, reference_keyframes.rbegin()->first, num_valid_frms);
+    write_header(ofs, format);
 
     const auto rk_itr_bgn = reference_keyframes.begin();
     const auto rc_itr_bgn = rel_cam_poses_from_ref_keyfrms.begin();
@@ -68,8 +70,11 @@ void trajectory_io::save_frame_trajectory(const std::string& path, const std::st
         }
 
         // check if the frame was skipped or not
+        // (NOTE: the frames are skipped regularly if the frame statistics are decimated)
         if (frm_id != i + offset) {
-            spdlog::warn("frame(s) from {} to {} was/were skipped", prev_frm_id + 1, frm_id - 1);
+            if (frm_stats.get_decimation() == 1) {
+                spdlog::warn("frame(s) from {} to {} was/were skipped", prev_frm_id + 1, frm_id - 1);
+            }
             offset = frm_id - i;
         }
 
@@ -80,25 +85,7 @@ void trajectory_io::save_frame_trajectory(const std::string& path, const std::st
         const Mat44_t cam_pose_cw = rel_cam_pose_cr * cam_pose_rw;
         Mat44_t cam_pose_wc = util::converter::inverse_pose(cam_pose_cw);
 
-        if (format == "KITTI") {
-            ofs << std::setprecision(9)
-                << cam_pose_wc(0, 0) << " " << cam_pose_wc(0, 1) << " " << cam_pose_wc(0, 2) << " " << cam_pose_wc(0, 3) << " "
-                << cam_pose_wc(1, 0) << " " << cam_pose_wc(1, 1) << " " << cam_pose_wc(1, 2) << " " << cam_pose_wc(1, 3) << " "
-                << cam_pose_wc(2, 0) << " " << cam_pose_wc(2, 1) << " " << cam_pose_wc(2, 2) << " " << cam_pose_wc(2, 3) << std::endl;
-        }
-        else if (format == "TUM") {
-            const Mat33_t& rot_wc = cam_pose_wc.block<3, 3>(0, 0);
-            const Vec3_t& trans_wc = cam_pose_wc.block<3, 1>(0, 3);
-            const Quat_t quat_wc = Quat_t(rot_wc);
-            ofs << std::setprecision(15)
-                << timestamps.at(frm_id) << " "
-                << std::setprecision(9)
-                << trans_wc(0) << " " << trans_wc(1) << " " << trans_wc(2) << " "
-                << quat_wc.x() << " " << quat_wc.y() << " " << quat_wc.z() << " " << quat_wc.w() << std::endl;
-        }
-        else {
-            throw std::runtime_error("Not implemented: trajectory format \"" + format + "\"");
-        }
+        write_pose(ofs, format, timestamps.at(frm_id), cam_pose_wc);
 
         prev_frm_id = frm_id;
     }
@@ -111,7 +98,7 @@ void trajectory_io::save_frame_trajectory(const std::string& path, const std::st
 }
 
 void trajectory_io::save_keyframe_trajectory(const std::string& path, const std::string& format) const {
-    std::lock_guard<std::mutex> lock(data::map_database::mtx_database_);
+    std::lock_guard<util::profiled_mutex> lock(data::map_database::mtx_database_);
 
     // 1. acquire keyframes and sort them
 
@@ -141,34 +128,55 @@ void trajectory_io::save_keyframe_trajectory(const std::string& path, const std:
 
     spdlog::info("dump keyframe trajectory in \"{}\" format from keyframe {} to keyframe {} ({} keyframes)",
                  format, (*keyfrms.begin())->id_, (*keyfrms.rbegin())->id_, keyfrms.size());
+    write_header(ofs, format);
 
     for (const auto& keyfrm : keyfrms) {
         const Mat44_t cam_pose_wc = keyfrm->get_pose_wc();
         const auto timestamp = keyfrm->timestamp_;
 
-        if (format == "KITTI") {
-            ofs << std::setprecision(9)
-                << cam_pose_wc(0, 0) << " " << cam_pose_wc(0, 1) << " " << cam_pose_wc(0, 2) << " " << cam_pose_wc(0, 3) << " "
-                << cam_pose_wc(1, 0) << " " << cam_pose_wc(1, 1) << " " << cam_pose_wc(1, 2) << " " << cam_pose_wc(1, 3) << " "
-                << cam_pose_wc(2, 0) << " " << cam_pose_wc(2, 1) << " " << cam_pose_wc(2, 2) << " " << cam_pose_wc(2, 3) << std::endl;
-        }
-        else if (format == "TUM") {
-            const Mat33_t& rot_wc = cam_pose_wc.block<3, 3>(0, 0);
-            const Vec3_t& trans_wc = cam_pose_wc.block<3, 1>(0, 3);
-            const Quat_t quat_wc = Quat_t(rot_wc);
-            ofs << std::setprecision(15)
-                << timestamp << " "
-                << std::setprecision(9)
-                << trans_wc(0) << " " << trans_wc(1) << " " << trans_wc(2) << " "
-                << quat_wc.x() << " " << quat_wc.y() << " " << quat_wc.z() << " " << quat_wc.w() << std::endl;
-        }
-        else {
-            throw std::runtime_error("Not implemented: trajectory format \"" + format + "\"");
-        }
+        write_pose(ofs, format, timestamp, cam_pose_wc);
     }
 
     ofs.close();
 }
 
+void trajectory_io::write_header(std::ostream& os, const std::string& format) {
+    if (format == "EuRoC") {
+        os << "#timestamp [ns],p_RS_R_x [m],p_RS_R_y [m],p_RS_R_z [m],q_RS_w [],q_RS_x [],q_RS_y [],q_RS_z []" << std::endl;
+    }
+}
+
+void trajectory_io::write_pose(std::ostream& os, const std::string& format, const double timestamp, const Mat44_t& cam_pose_wc) {
+    if (format == "KITTI") {
+        os << std::setprecision(9)
+           << cam_pose_wc(0, 0) << " " << cam_pose_wc(0, 1) << " " << cam_pose_wc(0, 2) << " " << cam_pose_wc(0, 3) << " "
+           << cam_pose_wc(1, 0) << " " << cam_pose_wc(1, 1) << " " << cam_pose_wc(1, 2) << " " << cam_pose_wc(1, 3) << " "
+           << cam_pose_wc(2, 0) << " " << cam_pose_wc(2, 1) << " " << cam_pose_wc(2, 2) << " " << cam_pose_wc(2, 3) << std::endl;
+    }
+    else if (format == "TUM") {
+        const Mat33_t& rot_wc = cam_pose_wc.block<3, 3>(0, 0);
+        const Vec3_t& trans_wc = cam_pose_wc.block<3, 1>(0, 3);
+        const Quat_t quat_wc = Quat_t(rot_wc);
+        os << std::setprecision(15)
+           << timestamp << " "
+           << std::setprecision(9)
+           << trans_wc(0) << " " << trans_wc(1) << " " << trans_wc(2) << " "
+           << quat_wc.x() << " " << quat_wc.y() << " " << quat_wc.z() << " " << quat_wc.w() << std::endl;
+    }
+    else if (format == "EuRoC") {
+        // the timestamp is written in nanoseconds, and the quaternion in the order of w, x, y, z
+        const Mat33_t& rot_wc = cam_pose_wc.block<3, 3>(0, 0);
+        const Vec3_t& trans_wc = cam_pose_wc.block<3, 1>(0, 3);
+        const Quat_t quat_wc = Quat_t(rot_wc);
+        os << static_cast<long long>(std::llround(timestamp * 1e9)) << ","
+           << std::setprecision(9)
+           << trans_wc(0) << "," << trans_wc(1) << "," << trans_wc(2) << ","
+           << quat_wc.w() << "," << quat_wc.x() << "," << quat_wc.y() << "," << quat_wc.z() << std::endl;
+    }
+    else {
+        throw std::runtime_error("Not implemented: trajectory format \"" + format + "\"");
+    }
+}
+
 } // namespace io
 } // namespace stella_vslam
@@ -1,6 +1,9 @@
 #ifndef STELLA_VSLAM_IO_TRAJECTORY_IO_H
 #define STELLA_VSLAM_IO_TRAJECTORY_IO_H
 
+#include "stella_vslam/type.h"
+
+#include <ostream>
 #include <string>
 
 namespace stella_vslam {
@@ -33,6 +36,23 @@ public:
      */
     void save_keyframe_trajectory(const std::string& path, const std::string& format) const;
 
+    /**
+     * Write the header line of the format if needed
+     * @param os
+     * @param format "KITTI", "TUM" or "EuRoC"
+     */
+    static void write_header(std::ostream& os, const std::string& format);
+
+    /**
+     * Write the camera pose as a line of the format
+     * (NOTE: throw std::runtime_error if the format is not implemented)
+     * @param os
+     * @param format "KITTI", "TUM" or "EuRoC"
+     * @param timestamp
+     * @param cam_pose_wc
+     */
+    static void write_pose(std::ostream& os, const std::string& format, const double timestamp, const Mat44_t& cam_pose_wc);
+
 private:
     //! map_database
     data::map_database* const map_db_ = nullptr;
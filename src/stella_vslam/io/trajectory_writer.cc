@@ -0,0 +1,96 @@
+#include "stella_vslam/data/frame.h"
+#include "stella_vslam/data/keyframe.h"
+#include "stella_vslam/io/trajectory_io.h"
+#include "stella_vslam/io/trajectory_writer.h"
+#include "stella_vslam/util/converter.h"
+
+#include <stdexcept>
+
+#include <spdlog/spdlog.h>
+
+namespace stella_vslam {
+namespace io {
+
+trajectory_writer::trajectory_writer(const std::string& path, const std::string& format, const unsigned int max_num_buffered_frames)
+    : format_(format), max_num_buffered_frames_(max_num_buffered_frames) {
+    spdlog::debug("CONSTRUCT: io::trajectory_writer");
+    if (format_ != "KITTI" && format_ != "TUM" && format_ != "EuRoC") {
+        throw std::runtime_error("Not implemented: trajectory format \"" + format_ + "\"");
+    }
+    ofs_.open(path, std::ios::out);
+    if (!ofs_.is_open()) {
+        spdlog::critical("cannot create a file at {}", path);
+        throw std::runtime_error("cannot create a file at " + path);
+    }
+    spdlog::info("stream frame trajectory in \"{}\" format to {}", format_, path);
+    trajectory_io::write_header(ofs_, format_);
+}
+
+trajectory_writer::trajectory_writer(const YAML::Node& yaml_node)
+    : trajectory_writer(yaml_node["path"].as<std::string>(),
+                        yaml_node["format"].as<std::string>("TUM"),
+                        yaml_node["max_num_buffered_frames"].as<unsigned int>(300)) {}
+
+trajectory_writer::~trajectory_writer() {
+    flush();
+    spdlog::debug("DESTRUCT: io::trajectory_writer");
+}
+
+void trajectory_writer::on_frame_tracked(const data::frame& frm, const bool is_lost) {
+    if (is_lost || !frm.pose_is_valid() || !frm.ref_keyfrm_) {
+        return;
+    }
+    buffered_frame buffered_frm;
+    buffered_frm.id_ = frm.id_;
+    buffered_frm.timestamp_ = frm.timestamp_;
+    buffered_frm.ref_keyfrm_ = frm.ref_keyfrm_;
+    buffered_frm.rel_cam_pose_cr_ = frm.get_pose_cw() * frm.ref_keyfrm_->get_pose_wc();
+
+    std::lock_guard<std::mutex> lock(mtx_);
+    buffered_frms_.push_back(buffered_frm);
+    while (max_num_buffered_frames_ < buffered_frms_.size()) {
+        write_front();
+    }
+}
+
+void trajectory_writer::on_reference_keyframe_replaced(const std::shared_ptr<data::keyframe>& old_keyfrm, const std::shared_ptr<data::keyframe>& new_keyfrm) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    const Mat44_t old_ref_cam_pose_cw = old_keyfrm->get_pose_cw();
+    const Mat44_t new_ref_cam_pose_wc = new_keyfrm->get_pose_wc();
+    for (auto& buffered_frm : buffered_frms_) {
+        if (buffered_frm.ref_keyfrm_ != old_keyfrm) {
+            continue;
+        }
+        // same as frame_statistics::replace_reference_keyframe()
+        buffered_frm.ref_keyfrm_ = new_keyfrm;
+        buffered_frm.rel_cam_pose_cr_ = buffered_frm.rel_cam_pose_cr_ * old_ref_cam_pose_cw * new_ref_cam_pose_wc;
+    }
+}
+
+void trajectory_writer::on_cleared() {
+    flush();
+}
+
+void trajectory_writer::flush() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    while (!buffered_frms_.empty()) {
+        write_front();
+    }
+    ofs_.flush();
+}
+
+unsigned int trajectory_writer::get_num_written_frames() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return num_written_frms_;
+}
+
+void trajectory_writer::write_front() {
+    const auto& buffered_frm = buffered_frms_.front();
+    const Mat44_t cam_pose_cw = buffered_frm.rel_cam_pose_cr_ * buffered_frm.ref_keyfrm_->get_pose_cw();
+    trajectory_io::write_pose(ofs_, format_, buffered_frm.timestamp_, util::converter::inverse_pose(cam_pose_cw));
+    ++num_written_frms_;
+    buffered_frms_.pop_front();
+}
+
+} // namespace io
+} // namespace stella_vslam
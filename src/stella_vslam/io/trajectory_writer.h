@@ -0,0 +1,90 @@
+#ifndef STELLA_VSLAM_IO_TRAJECTORY_WRITER_H
+#define STELLA_VSLAM_IO_TRAJECTORY_WRITER_H
+
+#include "stella_vslam/type.h"
+#include "stella_vslam/data/frame_statistics.h"
+
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include <yaml-cpp/yaml.h>
+
+namespace stella_vslam {
+
+namespace data {
+class frame;
+class keyframe;
+} // namespace data
+
+namespace io {
+
+/**
+ * Writer which streams the frame trajectory to the file while tracking, instead of dumping it from the frame statistics at the end
+ * Each tracked frame is buffered with its reference keyframe and the relative pose, and written when it leaves the buffer of the latest frames.
+ * The pose is computed from the reference keyframe when written, so the corrections by the local BA and the loop closure
+ * within the buffered segment are reflected, while the memory is bounded by max_num_buffered_frames.
+ * (NOTE: the frames written before a loop closure are not rewritten. Use io::trajectory_io for the fully corrected trajectory.)
+ */
+class trajectory_writer final : public data::frame_statistics_observer {
+public:
+    /**
+     * Constructor
+     * @param path path of the trajectory file
+     * @param format "KITTI", "TUM" or "EuRoC"
+     * @param max_num_buffered_frames number of the latest frames whose poses are not written yet
+     */
+    trajectory_writer(const std::string& path, const std::string& format, const unsigned int max_num_buffered_frames = 300);
+
+    explicit trajectory_writer(const YAML::Node& yaml_node);
+
+    ~trajectory_writer() override;
+
+    void on_frame_tracked(const data::frame& frm, const bool is_lost) override;
+
+    void on_reference_keyframe_replaced(const std::shared_ptr<data::keyframe>& old_keyfrm, const std::shared_ptr<data::keyframe>& new_keyfrm) override;
+
+    //! Write all the buffered frames (e.g. before the map is cleared)
+    void on_cleared() override;
+
+    //! Write all the buffered frames and flush the file
+    void flush();
+
+    //! Get the number of the written frames
+    unsigned int get_num_written_frames() const;
+
+private:
+    struct buffered_frame {
+        unsigned int id_;
+        double timestamp_;
+        std::shared_ptr<data::keyframe> ref_keyfrm_;
+        //! relative pose from the reference keyframe
+        Mat44_t rel_cam_pose_cr_;
+
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    };
+
+    //! Write and pop the oldest buffered frame (NOTE: mtx_ must be locked)
+    void write_front();
+
+    //! Trajectory format
+    const std::string format_;
+    //! Number of the latest frames whose poses are not written yet
+    const unsigned int max_num_buffered_frames_;
+
+    //! mutex for the buffer and the file
+    mutable std::mutex mtx_;
+    //! Trajectory file
+    std::ofstream ofs_;
+    //! Latest frames whose poses are not written yet
+    std::deque<buffered_frame, Eigen::aligned_allocator<buffered_frame>> buffered_frms_;
+    //! Number of the written frames
+    unsigned int num_written_frms_ = 0;
+};
+
+} // namespace io
+} // namespace stella_vslam
+
+#endif // STELLA_VSLAM_IO_TRAJECTORY_WRITER_H
@@ -0,0 +1,155 @@
+#include "stella_vslam/localizer.h"
+#include "stella_vslam/config.h"
+#include "stella_vslam/camera/base.h"
+#include "stella_vslam/data/common.h"
+#include "stella_vslam/data/frame.h"
+#include "stella_vslam/data/frame_observation.h"
+#include "stella_vslam/data/keyframe.h"
+#include "stella_vslam/data/map_database.h"
+#include "stella_vslam/data/marker2d.h"
+#include "stella_vslam/feature/orb_extractor.h"
+#include "stella_vslam/module/relocalizer.h"
+#include "stella_vslam/util/image_converter.h"
+#include "stella_vslam/util/thread_pool.h"
+#include "stella_vslam/util/yaml.h"
+
+#include <spdlog/spdlog.h>
+
+namespace stella_vslam {
+
+localizer::localizer(const std::shared_ptr<config>& cfg, camera::base* camera, feature::orb_params* orb_params,
+                     data::map_database* map_db, data::bow_database* bow_db, data::bow_vocabulary* bow_vocab,
+                     const unsigned int num_threads)
+    : cfg_(cfg), camera_(camera), orb_params_(orb_params), map_db_(map_db), bow_db_(bow_db), bow_vocab_(bow_vocab),
+      pool_(new util::thread_pool(num_threads)) {
+    spdlog::debug("CONSTRUCT: localizer");
+
+    const auto preprocessing_params = util::yaml_optional_ref(cfg_->yaml_node_, "Preprocessing");
+    mask_rectangles_ = util::get_rectangles(preprocessing_params["mask_rectangles"]);
+    min_size_ = preprocessing_params["min_size"].as<unsigned int>(min_size_);
+    use_opencl_ = util::yaml_optional_ref(cfg_->yaml_node_, "Feature")["use_opencl"].as<bool>(use_opencl_);
+
+    const auto localizer_params = util::yaml_optional_ref(cfg_->yaml_node_, "Localizer");
+    prior_distance_threshold_ = localizer_params["prior_distance_threshold"].as<double>(prior_distance_threshold_);
+    prior_angle_threshold_ = localizer_params["prior_angle_threshold"].as<double>(prior_angle_threshold_);
+    fallback_to_bow_ = localizer_params["fallback_to_bow"].as<bool>(fallback_to_bow_);
+
+    spdlog::info("localizer: {} workers", num_threads);
+}
+
+localizer::~localizer() {
+    // the pending queries use the extractors, so the workers are joined first
+    pool_.reset();
+    spdlog::debug("DESTRUCT: localizer");
+}
+
+std::shared_ptr<Mat44_t> localizer::localize(const cv::Mat& img, const cv::Mat& mask, const Mat44_t* pose_prior_cw) const {
+    if (img.empty()) {
+        spdlog::warn("localizer: empty image");
+        return nullptr;
+    }
+    if (!camera_->is_valid_shape(img)) {
+        spdlog::warn("localizer: Input image size is invalid");
+    }
+    cv::Mat img_gray = img;
+    util::convert_to_grayscale(img_gray, camera_->color_order_);
+
+    std::vector<cv::KeyPoint> keypts;
+    cv::Mat descriptors;
+    auto extractor = acquire_extractor();
+    extractor->extract(img_gray, mask, keypts, descriptors);
+    release_extractor(std::move(extractor));
+
+    return localize(keypts, descriptors, pose_prior_cw);
+}
+
+std::shared_ptr<Mat44_t> localizer::localize(const std::vector<cv::KeyPoint>& keypts, const cv::Mat& descriptors,
+                                             const Mat44_t* pose_prior_cw) const {
+    if (keypts.empty()) {
+        spdlog::warn("localizer: cannot extract any keypoints");
+        return nullptr;
+    }
+    if (static_cast<size_t>(descriptors.rows) != keypts.size()) {
+        spdlog::warn("localizer: {} descriptors are given for {} keypoints", descriptors.rows, keypts.size());
+        return nullptr;
+    }
+    auto frm = create_frame(keypts, descriptors);
+    return localize(frm, pose_prior_cw);
+}
+
+std::future<std::shared_ptr<Mat44_t>> localizer::async_localize(const cv::Mat& img, const cv::Mat& mask,
+                                                                const std::shared_ptr<Mat44_t>& pose_prior_cw) const {
+    return pool_->submit([this, img, mask, pose_prior_cw] {
+        return localize(img, mask, pose_prior_cw.get());
+    });
+}
+
+std::future<std::shared_ptr<Mat44_t>> localizer::async_localize(const std::vector<cv::KeyPoint>& keypts, const cv::Mat& descriptors,
+                                                                const std::shared_ptr<Mat44_t>& pose_prior_cw) const {
+    return pool_->submit([this, keypts, descriptors, pose_prior_cw] {
+        return localize(keypts, descriptors, pose_prior_cw.get());
+    });
+}
+
+data::frame localizer::create_frame(const std::vector<cv::KeyPoint>& keypts, const cv::Mat& descriptors) const {
+    data::frame_observation frm_obs;
+    frm_obs.descriptors_ = descriptors;
+    frm_obs.num_keypts_ = keypts.size();
+
+    // Undistort keypoints
+    camera_->undistort_keypoints(keypts, frm_obs.undist_keypts_);
+
+    // Convert to bearing vector
+    camera_->convert_keypoints_to_bearings(frm_obs.undist_keypts_, frm_obs.bearings_);
+
+    // Assign all the keypoints into grid
+    data::assign_keypoints_to_grid(camera_, frm_obs.undist_keypts_, frm_obs.keypt_indices_in_cells_);
+
+    // (the queries are not ordered in time)
+    return data::frame(0.0, camera_, orb_params_, std::move(frm_obs), std::unordered_map<unsigned int, data::marker2d>());
+}
+
+std::shared_ptr<Mat44_t> localizer::localize(data::frame& frm, const Mat44_t* pose_prior_cw) const {
+    frm.compute_bow(bow_vocab_);
+
+    // the relocalizer is not shared between the queries
+    module::relocalizer relocalizer(util::yaml_optional_ref(cfg_->yaml_node_, "Relocalizer"));
+
+    bool succeeded = false;
+    if (pose_prior_cw) {
+        const auto candidates = map_db_->get_close_keyframes(*pose_prior_cw, prior_distance_threshold_, prior_angle_threshold_);
+        if (!candidates.empty()) {
+            frm.set_pose_cw(*pose_prior_cw);
+            succeeded = relocalizer.reloc_by_candidates(frm, candidates);
+        }
+        if (!succeeded && !fallback_to_bow_) {
+            return nullptr;
+        }
+    }
+    if (!succeeded) {
+        succeeded = relocalizer.relocalize(bow_db_, map_db_, frm);
+    }
+    if (!succeeded) {
+        return nullptr;
+    }
+    return std::make_shared<Mat44_t>(frm.get_pose_wc());
+}
+
+std::unique_ptr<feature::orb_extractor> localizer::acquire_extractor() const {
+    {
+        std::lock_guard<std::mutex> lock(mtx_extractors_);
+        if (!idle_extractors_.empty()) {
+            auto extractor = std::move(idle_extractors_.back());
+            idle_extractors_.pop_back();
+            return extractor;
+        }
+    }
+    return std::unique_ptr<feature::orb_extractor>(new feature::orb_extractor(orb_params_, min_size_, mask_rectangles_, use_opencl_));
+}
+
+void localizer::release_extractor(std::unique_ptr<feature::orb_extractor> extractor) const {
+    std::lock_guard<std::mutex> lock(mtx_extractors_);
+    idle_extractors_.push_back(std::move(extractor));
+}
+
+} // namespace stella_vslam
@@ -0,0 +1,145 @@
+#ifndef STELLA_VSLAM_LOCALIZER_H
+#define STELLA_VSLAM_LOCALIZER_H
+
+#include "stella_vslam/type.h"
+#include "stella_vslam/data/bow_vocabulary_fwd.h"
+
+#include <future>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <opencv2/core/mat.hpp>
+#include <opencv2/core/types.hpp>
+
+namespace stella_vslam {
+
+class config;
+
+namespace camera {
+class base;
+} // namespace camera
+
+namespace data {
+class frame;
+class map_database;
+class bow_database;
+} // namespace data
+
+namespace feature {
+class orb_extractor;
+struct orb_params;
+} // namespace feature
+
+namespace util {
+class thread_pool;
+} // namespace util
+
+/**
+ * Stateless localization queries against a map shared by the clients (e.g. the images uploaded by the phones or the other robots)
+ * Each query builds its own frame and its own relocalizer, so the queries can run concurrently on the thread pool
+ * without the state of the tracking module.
+ * The map is only read by the queries: the map must not be modified while they run
+ * (e.g. load the map with system::load_map_database() and keep the mapping module disabled).
+ * (NOTE: the image is used as that of a monocular camera regardless of the setup type)
+ */
+class localizer {
+public:
+    /**
+     * Constructor
+     * @param cfg (the Preprocessing, Feature, Relocalizer and Localizer sections are used)
+     * @param camera
+     * @param orb_params
+     * @param map_db
+     * @param bow_db
+     * @param bow_vocab
+     * @param num_threads number of the worker threads of async_localize()
+     */
+    localizer(const std::shared_ptr<config>& cfg, camera::base* camera, feature::orb_params* orb_params,
+              data::map_database* map_db, data::bow_database* bow_db, data::bow_vocabulary* bow_vocab,
+              const unsigned int num_threads);
+
+    /**
+     * Destructor (the pending queries are run before the workers are joined)
+     */
+    ~localizer();
+
+    localizer(const localizer&) = delete;
+    localizer& operator=(const localizer&) = delete;
+
+    /**
+     * Localize the image in the map (thread-safe)
+     * @param img
+     * @param mask
+     * @param pose_prior_cw if not nullptr, the keyframes close to the prior are tried before the BoW retrieval
+     * @return the camera pose (pose_wc), or nullptr if the localization fails
+     */
+    std::shared_ptr<Mat44_t> localize(const cv::Mat& img, const cv::Mat& mask = cv::Mat{},
+                                      const Mat44_t* pose_prior_cw = nullptr) const;
+
+    /**
+     * Localize the ORB features extracted by the client in the map (thread-safe)
+     * (NOTE: the features must be extracted with the same ORB parameters as the map)
+     * @param keypts distorted keypoints
+     * @param descriptors
+     * @param pose_prior_cw if not nullptr, the keyframes close to the prior are tried before the BoW retrieval
+     * @return the camera pose (pose_wc), or nullptr if the localization fails
+     */
+    std::shared_ptr<Mat44_t> localize(const std::vector<cv::KeyPoint>& keypts, const cv::Mat& descriptors,
+                                      const Mat44_t* pose_prior_cw = nullptr) const;
+
+    /**
+     * Localize the image in the map on the thread pool
+     * (the image and the mask are shared with the query, so they must not be overwritten until the result is obtained)
+     */
+    std::future<std::shared_ptr<Mat44_t>> async_localize(const cv::Mat& img, const cv::Mat& mask = cv::Mat{},
+                                                         const std::shared_ptr<Mat44_t>& pose_prior_cw = nullptr) const;
+
+    /**
+     * Localize the ORB features extracted by the client in the map on the thread pool
+     */
+    std::future<std::shared_ptr<Mat44_t>> async_localize(const std::vector<cv::KeyPoint>& keypts, const cv::Mat& descriptors,
+                                                         const std::shared_ptr<Mat44_t>& pose_prior_cw = nullptr) const;
+
+private:
+    //! Create the frame from the distorted keypoints and the descriptors
+    data::frame create_frame(const std::vector<cv::KeyPoint>& keypts, const cv::Mat& descriptors) const;
+
+    //! Relocalize the frame with the prior first if given
+    std::shared_ptr<Mat44_t> localize(data::frame& frm, const Mat44_t* pose_prior_cw) const;
+
+    //! Take an idle extractor from the pool (a new one is created if all of them are in use)
+    std::unique_ptr<feature::orb_extractor> acquire_extractor() const;
+
+    //! Return the extractor to the pool
+    void release_extractor(std::unique_ptr<feature::orb_extractor> extractor) const;
+
+    const std::shared_ptr<config> cfg_;
+    camera::base* const camera_;
+    feature::orb_params* const orb_params_;
+    data::map_database* const map_db_;
+    data::bow_database* const bow_db_;
+    data::bow_vocabulary* const bow_vocab_;
+
+    //! parameters of the extractors
+    std::vector<std::vector<float>> mask_rectangles_;
+    unsigned int min_size_ = 800;
+    bool use_opencl_ = false;
+
+    //! thresholds of the keyframes close to the pose prior
+    double prior_distance_threshold_ = 0.2;
+    double prior_angle_threshold_ = 0.45;
+    //! fall back to the BoW retrieval if the localization with the pose prior fails
+    bool fallback_to_bow_ = true;
+
+    //! idle extractors (each of them is used by one query at a time)
+    mutable std::mutex mtx_extractors_;
+    mutable std::vector<std::unique_ptr<feature::orb_extractor>> idle_extractors_;
+
+    //! workers of async_localize()
+    std::unique_ptr<util::thread_pool> pool_;
+};
+
+} // namespace stella_vslam
+
+#endif // STELLA_VSLAM_LOCALIZER_H
@@ -8,8 +8,12 @@
 #include "stella_vslam/match/fuse.h"
 #include "stella_vslam/match/robust.h"
 #include "stella_vslam/module/two_view_triangulator.h"
+#include "stella_vslam/publish/metrics_publisher.h"
 #include "stella_vslam/solve/essential_solver.h"
+#include "stella_vslam/util/keyframe_tracer.h"
+#include "stella_vslam/util/parallel_for.h"
 
+#include <chrono>
 #include <thread>
 
 #include <spdlog/spdlog.h>
@@ -22,8 +26,11 @@ mapping_module::mapping_module(const YAML::Node& yaml_node, data::map_database*
       local_bundle_adjuster_(new optimize::local_bundle_adjuster(yaml_node)),
       enable_interruption_of_landmark_generation_(yaml_node["enable_interruption_of_landmark_generation"].as<bool>(true)),
       enable_interruption_before_local_BA_(yaml_node["enable_interruption_before_local_BA"].as<bool>(true)),
+      max_num_batched_keyframes_(yaml_node["max_num_batched_keyframes"].as<unsigned int>(4)),
       num_covisibilities_for_landmark_generation_(yaml_node["num_covisibilities_for_landmark_generation"].as<unsigned int>(10)),
-      num_covisibilities_for_landmark_fusion_(yaml_node["num_covisibilities_for_landmark_fusion"].as<unsigned int>(10)) {
+      num_covisibilities_for_landmark_fusion_(yaml_node["num_covisibilities_for_landmark_fusion"].as<unsigned int>(10)),
+      cpu_budget_(yaml_node),
+      idle_work_delay_ms_(yaml_node["idle_work_delay_ms"].as<double>(0.0)) {
     spdlog::debug("CONSTRUCT: mapping_module");
     spdlog::debug("load mapping parameters");
 
@@ -55,6 +62,19 @@ void mapping_module::set_global_optimization_module(global_optimization_module*
     global_optimizer_ = global_optimizer;
 }
 
+void mapping_module::set_metrics_publisher(const std::shared_ptr<publish::metrics_publisher>& metrics_publisher) {
+    metrics_publisher_ = metrics_publisher;
+}
+
+void mapping_module::set_keyframe_tracer(const std::shared_ptr<util::keyframe_tracer>& keyfrm_tracer) {
+    keyfrm_tracer_ = keyfrm_tracer;
+}
+
+void mapping_module::set_thread_pool(const std::shared_ptr<util::thread_pool>& thread_pool) {
+    thread_pool_ = thread_pool;
+    local_bundle_adjuster_->set_thread_pool(thread_pool.get());
+}
+
 void mapping_module::run() {
     spdlog::info("start mapping module");
 
@@ -62,8 +82,8 @@ void mapping_module::run() {
     set_is_idle(true);
 
     while (true) {
-        // waiting time for the other threads
-        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        // wait until a keyframe is queued or any request is made
+        wait_for_wakeup(true);
 
         // check if termination is requested
         if (terminate_is_requested()) {
@@ -92,7 +112,7 @@ void mapping_module::run() {
                 SPDLOG_TRACE("mapping_module: waiting");
                 // check if termination or reset is requested during pause
                 while (is_paused() && !terminate_is_requested() && !reset_is_requested()) {
-                    std::this_thread::sleep_for(std::chrono::milliseconds(3));
+                    wait_for_wakeup(false);
                 }
                 auto future_start_keyframe_insertion = tracker_->async_start_keyframe_insertion();
                 future_start_keyframe_insertion.get();
@@ -100,28 +120,114 @@ void mapping_module::run() {
             }
         }
 
-        // if the queue is empty, the following process is not needed
-        if (!keyframe_is_queued()) {
+        // if the queue is empty (or the queued keyframes are held by the limit), the following process is not needed
+        if (!keyframe_is_ready()) {
             set_is_idle(true);
+            // remove the redundant keyframes in the background until a new keyframe is queued
+            // (the mapping module is regarded as idle, so that the tracker can insert a new keyframe to preempt it)
+            if (!processed_keyframes_are_limited()) {
+                // defer the cleaning while the keyframes are inserted one after another
+                const double idle_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - last_keyfrm_processed_at_).count();
+                if (idle_ms < idle_work_delay_ms_ && sleep_interruptibly(idle_work_delay_ms_ - idle_ms, true)) {
+                    continue;
+                }
+                const auto abort_is_requested = [this] {
+                    return keyframe_is_queued() || pause_is_requested() || reset_is_requested() || terminate_is_requested();
+                };
+                const auto start = std::chrono::steady_clock::now();
+                local_map_cleaner_->remove_redundant_keyframes(abort_is_requested);
+                // then bound the size of the map with the lowest-utility keyframes
+                local_map_cleaner_->summarize_map(abort_is_requested);
+                local_map_cleaner_->compact_keyframe_descriptors(abort_is_requested);
+                const double elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+                // (the keyframe can end the rest, because the cleaning is preempted by the keyframes anyway)
+                sleep_interruptibly(cpu_budget_.get_rest_ms(elapsed_ms), true);
+            }
+            // (then wait_for_wakeup() sleeps without polling until a new keyframe is queued or any request is made)
             continue;
         }
 
         set_is_idle(false);
-        // create and extend the map with the new keyframe
-        mapping_with_new_keyframe();
-        // send the new keyframe to the global optimization module
-        if (!cur_keyfrm_->graph_node_->is_spanning_root()) {
-            global_optimizer_->queue_keyframe(cur_keyfrm_);
+        const auto start = std::chrono::steady_clock::now();
+        process_new_keyframe();
+        last_keyfrm_processed_at_ = std::chrono::steady_clock::now();
+        if (cpu_budget_.is_limited()) {
+            const double elapsed_ms = std::chrono::duration<double, std::milli>(last_keyfrm_processed_at_ - start).count();
+            sleep_interruptibly(cpu_budget_.get_rest_ms(elapsed_ms), false);
         }
     }
 
     spdlog::info("terminate mapping module");
 }
 
-void mapping_module::queue_keyframe(const std::shared_ptr<data::keyframe>& keyfrm) {
-    std::lock_guard<std::mutex> lock(mtx_keyfrm_queue_);
-    keyfrms_queue_.push_back(keyfrm);
-    abort_local_BA_ = true;
+void mapping_module::start_offline() {
+    spdlog::info("start mapping module (offline)");
+
+    is_offline_ = true;
+    {
+        std::lock_guard<std::mutex> lock(mtx_terminate_);
+        is_terminated_ = false;
+    }
+    set_is_idle(true);
+}
+
+void mapping_module::process_queued_keyframes() {
+    // (the requests have been carried out when they were made, see async_pause(), async_reset() and async_terminate())
+    if (is_paused() || is_terminated()) {
+        return;
+    }
+
+    while (keyframe_is_ready()) {
+        set_is_idle(false);
+        process_new_keyframe();
+    }
+    // remove the redundant keyframes here instead of in the idle time of run()
+    if (!processed_keyframes_are_limited()) {
+        local_map_cleaner_->remove_redundant_keyframes();
+        local_map_cleaner_->summarize_map();
+        local_map_cleaner_->compact_keyframe_descriptors();
+    }
+    set_is_idle(true);
+}
+
+void mapping_module::process_new_keyframe() {
+    // create and extend the map with the new keyframe
+    const auto start = std::chrono::steady_clock::now();
+    mapping_with_new_keyframe();
+    const double elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    // (the throughput of the mapping module is used to pace the keyframe insertion)
+    constexpr double alpha = 0.2;
+    const double mean_ms = mean_keyfrm_mapping_ms_;
+    mean_keyfrm_mapping_ms_ = (mean_ms == 0.0) ? elapsed_ms : (1.0 - alpha) * mean_ms + alpha * elapsed_ms;
+    if (keyfrm_tracer_) {
+        keyfrm_tracer_->record(cur_keyfrm_->id_, util::keyframe_stage_t::Mapped);
+    }
+    // send the new keyframe to the global optimization module
+    if (!cur_keyfrm_->graph_node_->is_spanning_root()) {
+        global_optimizer_->queue_keyframe(cur_keyfrm_);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mtx_keyfrm_queue_);
+        ++num_processed_keyfrms_;
+    }
+    cond_processed_keyfrms_.notify_all();
+}
+
+void mapping_module::queue_keyframe(const std::shared_ptr<data::keyframe>& keyfrm,
+                                    const std::function<void()>& materializer) {
+    {
+        std::lock_guard<std::mutex> lock(mtx_keyfrm_queue_);
+        keyfrms_queue_.push_back(keyfrm);
+        if (materializer) {
+            keyfrm_materializers_[keyfrm->id_] = materializer;
+        }
+        abort_local_BA_ = true;
+    }
+    if (keyfrm_tracer_) {
+        keyfrm_tracer_->record(keyfrm->id_, util::keyframe_stage_t::Queued);
+    }
+    notify_wakeup();
 }
 
 unsigned int mapping_module::get_num_queued_keyframes() const {
@@ -129,17 +235,76 @@ unsigned int mapping_module::get_num_queued_keyframes() const {
     return keyfrms_queue_.size();
 }
 
+size_t mapping_module::get_local_BA_scratch_memory_bytes() const {
+    return local_bundle_adjuster_->get_scratch_memory_bytes();
+}
+
 bool mapping_module::keyframe_is_queued() const {
     std::lock_guard<std::mutex> lock(mtx_keyfrm_queue_);
     return !keyfrms_queue_.empty();
 }
 
+bool mapping_module::keyframe_is_ready() const {
+    std::lock_guard<std::mutex> lock(mtx_keyfrm_queue_);
+    return !keyfrms_queue_.empty()
+           && (!processed_keyfrms_are_limited_ || num_processed_keyfrms_ < max_num_processed_keyfrms_);
+}
+
+unsigned int mapping_module::get_num_processed_keyframes() const {
+    std::lock_guard<std::mutex> lock(mtx_keyfrm_queue_);
+    return num_processed_keyfrms_;
+}
+
+void mapping_module::limit_processed_keyframes(const unsigned int max_num_processed_keyfrms) {
+    {
+        std::lock_guard<std::mutex> lock(mtx_keyfrm_queue_);
+        processed_keyfrms_are_limited_ = true;
+        max_num_processed_keyfrms_ = max_num_processed_keyfrms;
+    }
+    notify_wakeup();
+}
+
+void mapping_module::unlimit_processed_keyframes() {
+    {
+        std::lock_guard<std::mutex> lock(mtx_keyfrm_queue_);
+        processed_keyfrms_are_limited_ = false;
+    }
+    notify_wakeup();
+}
+
+bool mapping_module::processed_keyframes_are_limited() const {
+    std::lock_guard<std::mutex> lock(mtx_keyfrm_queue_);
+    return processed_keyfrms_are_limited_;
+}
+
+bool mapping_module::wait_for_processed_keyframes(const unsigned int num_processed_keyfrms) {
+    std::unique_lock<std::mutex> lock(mtx_keyfrm_queue_);
+    cond_processed_keyfrms_.wait(lock, [this, num_processed_keyfrms] {
+        return num_processed_keyfrms <= num_processed_keyfrms_ || (keyfrms_queue_.empty() && is_idle_);
+    });
+    return num_processed_keyfrms <= num_processed_keyfrms_;
+}
+
 bool mapping_module::is_idle() const {
     return is_idle_;
 }
 
+bool mapping_module::wait_until_idle(const double max_wait_ms) {
+    std::unique_lock<std::mutex> lock(mtx_keyfrm_queue_);
+    return cond_processed_keyfrms_.wait_for(lock, std::chrono::microseconds(static_cast<int64_t>(max_wait_ms * 1000.0)), [this] {
+        return keyfrms_queue_.empty() && is_idle_;
+    });
+}
+
 void mapping_module::set_is_idle(const bool is_idle) {
     is_idle_ = is_idle;
+    if (is_idle_) {
+        // the waiters of the processed keyframes check the queue again
+        {
+            std::lock_guard<std::mutex> lock(mtx_keyfrm_queue_);
+        }
+        cond_processed_keyfrms_.notify_all();
+    }
 
 #ifdef DETERMINISTIC
     // alert the tracker that it can carry on
@@ -153,17 +318,68 @@ bool mapping_module::is_skipping_localBA() const {
     return queued_keyframes >= queue_threshold_;
 }
 
+void mapping_module::notify_wakeup() {
+    {
+        std::lock_guard<std::mutex> lock(mtx_wakeup_);
+        wakeup_is_requested_ = true;
+    }
+    cond_wakeup_.notify_all();
+}
+
+void mapping_module::wait_for_wakeup(const bool wake_on_pending_work) {
+    // (checked before locking mtx_wakeup_, because the requests are made while holding the other mutexes)
+    if (wake_on_pending_work
+        && (keyframe_is_ready() || pause_is_requested()
+            || (!processed_keyframes_are_limited() && local_map_cleaner_->redundant_keyframe_candidates_are_queued()))) {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(mtx_wakeup_);
+    cond_wakeup_.wait(lock, [this] { return wakeup_is_requested_; });
+    wakeup_is_requested_ = false;
+}
+
+bool mapping_module::sleep_interruptibly(const double sleep_ms, const bool wake_on_keyframe) {
+    if (sleep_ms <= 0.0) {
+        return false;
+    }
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(static_cast<int64_t>(sleep_ms * 1000.0));
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mtx_wakeup_);
+            if (!cond_wakeup_.wait_until(lock, deadline, [this] { return wakeup_is_requested_; })) {
+                return false;
+            }
+            wakeup_is_requested_ = false;
+        }
+        // (checked after unlocking mtx_wakeup_, see wait_for_wakeup())
+        if ((wake_on_keyframe && keyframe_is_ready()) || pause_is_requested() || reset_is_requested() || terminate_is_requested()) {
+            // the consumed wakeup is handled by the main loop
+            notify_wakeup();
+            return true;
+        }
+    }
+}
+
 void mapping_module::abort_local_BA() {
     abort_local_BA_ = true;
 }
 
 void mapping_module::mapping_with_new_keyframe() {
     // dequeue
+    std::function<void()> materializer;
     {
         std::lock_guard<std::mutex> lock(mtx_keyfrm_queue_);
         // dequeue -> cur_keyfrm_
         cur_keyfrm_ = keyfrms_queue_.front();
         keyfrms_queue_.pop_front();
+        const auto itr = keyfrm_materializers_.find(cur_keyfrm_->id_);
+        if (itr != keyfrm_materializers_.end()) {
+            materializer = std::move(itr->second);
+            keyfrm_materializers_.erase(itr);
+        }
+    }
+    if (keyfrm_tracer_) {
+        keyfrm_tracer_->record(cur_keyfrm_->id_, util::keyframe_stage_t::MappingStarted);
     }
 
 #ifdef DETERMINISTIC
@@ -171,6 +387,12 @@ void mapping_module::mapping_with_new_keyframe() {
     std::lock_guard<std::mutex> tracking_lock(mtx_processing_);
 #endif
 
+    // finish the construction of the keyframe deferred by the tracker
+    if (materializer) {
+        std::lock_guard<util::profiled_mutex> lock(data::map_database::mtx_database_);
+        materializer();
+    }
+
     SPDLOG_TRACE("mapping_module: current keyframe is {}", cur_keyfrm_->id_);
 
     // store the new keyframe to the database
@@ -181,7 +403,8 @@ void mapping_module::mapping_with_new_keyframe() {
 
     // triangulate new landmarks between the current frame and each of the covisibilities
     std::atomic<bool> abort_create_new_landmarks{false};
-    if (!enable_interruption_of_landmark_generation_) {
+    // (no keyframe is queued during the triangulation in the offline mode)
+    if (!enable_interruption_of_landmark_generation_ || is_offline_) {
         create_new_landmarks(abort_create_new_landmarks);
     }
     else {
@@ -201,9 +424,35 @@ void mapping_module::mapping_with_new_keyframe() {
     // detect and resolve the duplication of the landmarks observed in the current frame
     update_new_keyframe();
 
-    if (enable_interruption_before_local_BA_ && (keyframe_is_queued() || pause_is_requested())) {
-        return;
+    // check the redundancy of the covisibilities later
+    // (the redundant keyframes are removed while no keyframe is queued, see run())
+    local_map_cleaner_->queue_redundant_keyframe_candidates(cur_keyfrm_);
+    // compact the descriptors after the keyframe leaves the local map
+    local_map_cleaner_->queue_keyframe_to_compact(cur_keyfrm_);
+#ifdef DETERMINISTIC
+    // remove them before the tracker resumes
+    local_map_cleaner_->remove_redundant_keyframes();
+#else
+    if (processed_keyframes_are_limited()) {
+        // remove them before the next frame is replayed (not in the background, whose progress depends on the timing)
+        local_map_cleaner_->remove_redundant_keyframes();
+    }
+#endif
+
+    // (the offline mode does not skip the local BA to catch up with the tracking)
+    batched_keyfrms_.push_back(cur_keyfrm_);
+    bool batch_is_full = false;
+    if (enable_interruption_before_local_BA_ && !is_offline_ && (keyframe_is_queued() || pause_is_requested())) {
+        // integrate the queued keyframes first, then optimize them together with a single local BA over the union of their local windows
+        // (the local BA is not postponed infinitely, but it can be aborted by the next keyframe after the minimum iterations)
+        batch_is_full = !pause_is_requested() && 0 < max_num_batched_keyframes_
+                        && max_num_batched_keyframes_ <= batched_keyfrms_.size();
+        if (!batch_is_full) {
+            return;
+        }
     }
+    const auto batched_keyfrms = std::move(batched_keyfrms_);
+    batched_keyfrms_.clear();
 
     SPDLOG_TRACE("mapping_module: local bundle adjustment (current keyframe is {})", cur_keyfrm_->id_);
 
@@ -211,14 +460,33 @@ void mapping_module::mapping_with_new_keyframe() {
     abort_local_BA_ = false;
     // If the processing speed is insufficient, skip localBA.
     if (2 < map_db_->get_num_keyframes()) {
-        if (is_skipping_localBA()) {
+        // (the local BA of the full batch is not skipped, otherwise the batched keyframes are never optimized)
+        if (!batch_is_full && is_skipping_localBA()) {
             spdlog::debug("Skipped localBA due to insufficient performance");
+            if (metrics_publisher_) {
+                metrics_publisher_->increment("local_BA_skips_total");
+            }
         }
         else {
-            local_bundle_adjuster_->optimize(map_db_, cur_keyfrm_, &abort_local_BA_);
+            const auto start = std::chrono::steady_clock::now();
+            local_bundle_adjuster_->optimize(map_db_, batched_keyfrms, &abort_local_BA_);
+            if (keyfrm_tracer_) {
+                std::vector<unsigned int> batched_keyfrm_ids;
+                batched_keyfrm_ids.reserve(batched_keyfrms.size());
+                for (const auto& keyfrm : batched_keyfrms) {
+                    batched_keyfrm_ids.push_back(keyfrm->id_);
+                }
+                keyfrm_tracer_->record(batched_keyfrm_ids, util::keyframe_stage_t::LocalBA);
+            }
+            if (metrics_publisher_) {
+                const auto end = std::chrono::steady_clock::now();
+                metrics_publisher_->observe("local_BA_duration_ms", std::chrono::duration<double, std::milli>(end - start).count());
+                if (abort_local_BA_) {
+                    metrics_publisher_->increment("local_BA_aborts_total");
+                }
+            }
         }
     }
-    local_map_cleaner_->remove_redundant_keyframes(cur_keyfrm_);
 }
 
 void mapping_module::store_new_keyframe() {
@@ -253,20 +521,20 @@ void mapping_module::create_new_landmarks(std::atomic<bool>& abort_create_new_la
     // in order to triangulate landmarks between `cur_keyfrm_` and each of the covisibilities
     const auto cur_covisibilities = cur_keyfrm_->graph_node_->get_top_n_covisibilities(num_covisibilities_for_landmark_generation_);
 
-    // lowe's_ratio will not be used
-    match::robust robust_matcher(0.0, false);
-
     // camera center of the current keyframe
     const Vec3_t cur_cam_center = cur_keyfrm_->get_trans_wc();
 
-    for (unsigned int i = 0; i < cur_covisibilities.size(); ++i) {
+    // 1. match and triangulate each pair independently
+    //    (the map is not modified, so the pairs are processed in parallel)
+    std::vector<std::vector<triangulated_match>> triangulated_matches(cur_covisibilities.size());
+    util::parallel_for(thread_pool_.get(), 0, cur_covisibilities.size(), [&](const int64_t i) {
         // if any keyframe is queued, abort the triangulation
         if (1 < i && abort_create_new_landmarks) {
             return;
         }
 
         // get the neighbor keyframe
-        auto ngh_keyfrm = cur_covisibilities.at(i);
+        const auto& ngh_keyfrm = cur_covisibilities.at(i);
 
         // camera center of the neighbor keyframe
         const Vec3_t ngh_cam_center = ngh_keyfrm->get_trans_wc();
@@ -279,12 +547,12 @@ void mapping_module::create_new_landmarks(std::atomic<bool>& abort_create_new_la
         if (use_baseline_dist_thr_ratio_) {
             const float median_depth_in_ngh = ngh_keyfrm->compute_median_depth(true);
             if (baseline_dist < baseline_dist_thr_ratio_ * median_depth_in_ngh) {
-                continue;
+                return;
             }
         }
         else {
             if (baseline_dist < baseline_dist_thr_) {
-                continue;
+                return;
             }
         }
 
@@ -297,56 +565,73 @@ void mapping_module::create_new_landmarks(std::atomic<bool>& abort_create_new_la
                                                                           cur_keyfrm_->get_rot_cw(), cur_keyfrm_->get_trans_cw());
 
         // vector of matches (idx in the current, idx in the neighbor)
+        // (lowe's_ratio will not be used)
+        const match::robust robust_matcher(0.0, false);
         std::vector<std::pair<unsigned int, unsigned int>> matches;
         robust_matcher.match_for_triangulation(cur_keyfrm_, ngh_keyfrm, E_ngh_to_cur, matches);
 
         // triangulation
-        triangulate_with_two_keyframes(cur_keyfrm_, ngh_keyfrm, matches);
-    }
-}
-
-void mapping_module::triangulate_with_two_keyframes(const std::shared_ptr<data::keyframe>& keyfrm_1, const std::shared_ptr<data::keyframe>& keyfrm_2,
-                                                    const std::vector<std::pair<unsigned int, unsigned int>>& matches) {
-    std::lock_guard<std::mutex> lock(data::map_database::mtx_database_);
-    const module::two_view_triangulator triangulator(keyfrm_1, keyfrm_2, 1.0);
+        triangulate_with_two_keyframes(cur_keyfrm_, ngh_keyfrm, matches, triangulated_matches.at(i));
+    });
+
+    // 2. create the landmarks in the order of the covisibilities
+    //    (a keypoint of the current keyframe can be matched in several pairs, so the earlier pair takes precedence,
+    //     as in the serial triangulation which excludes the keypoints associated with the landmarks by the previous pairs)
+    std::lock_guard<util::profiled_mutex> lock(data::map_database::mtx_database_);
+    std::vector<std::shared_ptr<data::landmark>> new_lms;
+    for (unsigned int i = 0; i < cur_covisibilities.size(); ++i) {
+        const auto& ngh_keyfrm = cur_covisibilities.at(i);
+        for (const auto& triangulated : triangulated_matches.at(i)) {
+            if (cur_keyfrm_->get_landmark(triangulated.idx_1_) || ngh_keyfrm->get_landmark(triangulated.idx_2_)) {
+                continue;
+            }
 
-#ifdef USE_OPENMP
-#pragma omp parallel for
-#endif
-    for (int64_t i = 0; i < static_cast<int64_t>(matches.size()); ++i) {
-        const auto idx_1 = matches.at(i).first;
-        const auto idx_2 = matches.at(i).second;
-
-        // triangulate between idx_1 and idx_2
-        Vec3_t pos_w;
-        if (!triangulator.triangulate(idx_1, idx_2, pos_w)) {
-            // failed
-            continue;
-        }
-        // succeeded
+            // create a landmark object
+            auto lm = data::landmark::create(map_db_->next_landmark_id_++, triangulated.pos_w_, cur_keyfrm_);
 
-        // create a landmark object
-        auto lm = std::make_shared<data::landmark>(map_db_->next_landmark_id_++, pos_w, keyfrm_1);
+            lm->connect_to_keyframe(cur_keyfrm_, triangulated.idx_1_);
+            lm->connect_to_keyframe(ngh_keyfrm, triangulated.idx_2_);
 
-        lm->connect_to_keyframe(keyfrm_1, idx_1);
-        lm->connect_to_keyframe(keyfrm_2, idx_2);
+            new_lms.push_back(lm);
+        }
+    }
 
+    // compute the descriptors and the geometries (independent for each landmark)
+    util::parallel_for(thread_pool_.get(), 0, new_lms.size(), [&new_lms](const int64_t i) {
+        const auto& lm = new_lms.at(i);
         lm->compute_descriptor();
         lm->update_mean_normal_and_obs_scale_variance();
+    });
 
+    for (auto& lm : new_lms) {
         map_db_->add_landmark(lm);
         // wait for redundancy check
-#ifdef USE_OPENMP
-#pragma omp critical
-#endif
-        {
-            local_map_cleaner_->add_fresh_landmark(lm);
+        local_map_cleaner_->add_fresh_landmark(lm);
+    }
+}
+
+void mapping_module::triangulate_with_two_keyframes(const std::shared_ptr<data::keyframe>& keyfrm_1, const std::shared_ptr<data::keyframe>& keyfrm_2,
+                                                    const std::vector<std::pair<unsigned int, unsigned int>>& matches,
+                                                    std::vector<triangulated_match>& triangulated_matches) const {
+    const module::two_view_triangulator triangulator(keyfrm_1, keyfrm_2, 1.0);
+
+    // triangulate all of the matches at once
+    MatX3_t pos_ws;
+    std::vector<bool> is_triangulated;
+    const auto num_triangulated = triangulator.triangulate(matches, pos_ws, is_triangulated);
+
+    triangulated_matches.clear();
+    triangulated_matches.reserve(num_triangulated);
+    for (unsigned int i = 0; i < matches.size(); ++i) {
+        if (!is_triangulated.at(i)) {
+            continue;
         }
+        triangulated_matches.push_back(triangulated_match{matches.at(i).first, matches.at(i).second, pos_ws.row(i).transpose()});
     }
 }
 
 void mapping_module::update_new_keyframe() {
-    std::lock_guard<std::mutex> lock(data::map_database::mtx_database_);
+    std::lock_guard<util::profiled_mutex> lock(data::map_database::mtx_database_);
 
     // get the targets to check landmark fusion
     const auto fuse_tgt_keyfrms = cur_keyfrm_->graph_node_->get_top_n_covisibilities(num_covisibilities_for_landmark_fusion_);
@@ -388,48 +673,23 @@ void mapping_module::fuse_landmark_duplication(const std::vector<std::shared_ptr
         // - additional matches
         // - duplication of matches
         // then, add matches and solve duplication
-        auto cur_landmarks = cur_keyfrm_->get_landmarks();
-        for (const auto& fuse_tgt_keyfrm : fuse_tgt_keyfrms) {
-            std::unordered_map<std::shared_ptr<data::landmark>, std::shared_ptr<data::landmark>> duplicated_lms_in_keyfrm;
-            std::unordered_map<unsigned int, std::shared_ptr<data::landmark>> new_connections;
+
+        // 1. detect the duplication for each of the targets
+        //    (read-only, so the targets are processed in parallel)
+        const auto cur_landmarks = cur_keyfrm_->get_landmarks();
+        std::vector<std::unordered_map<std::shared_ptr<data::landmark>, std::shared_ptr<data::landmark>>> duplicated_lms_in_keyfrms(fuse_tgt_keyfrms.size());
+        std::vector<std::unordered_map<unsigned int, std::shared_ptr<data::landmark>>> new_connections_in_keyfrms(fuse_tgt_keyfrms.size());
+        util::parallel_for(thread_pool_.get(), 0, fuse_tgt_keyfrms.size(), [&](const int64_t i) {
+            const auto& fuse_tgt_keyfrm = fuse_tgt_keyfrms.at(i);
             const Mat33_t rot_cw = fuse_tgt_keyfrm->get_rot_cw();
             const Vec3_t trans_cw = fuse_tgt_keyfrm->get_trans_cw();
-            fuse_matcher.detect_duplication(fuse_tgt_keyfrm, rot_cw, trans_cw, cur_landmarks, 3.0, duplicated_lms_in_keyfrm, new_connections, true);
-
-            // There is association between the 3D point and the keyframe
-            // -> Duplication exists
-            for (const auto& lms_pair : duplicated_lms_in_keyfrm) {
-                auto lm_to_replace = lms_pair.first;
-                auto lm_in_keyfrm = lms_pair.second;
-                // Replace with more reliable 3D points (= more observable)
-                assert(!replaced_lms.count(lm_in_keyfrm));
-                assert(!replaced_lms.count(lm_to_replace));
-                if (lm_to_replace->num_observations() < lm_in_keyfrm->num_observations()) {
-                    std::swap(lm_to_replace, lm_in_keyfrm);
-                }
-                // Replace lm_in_keyfrm with lm_to_replace
-                if (lm_to_replace->id_ != lm_in_keyfrm->id_) {
-                    replaced_lms[lm_in_keyfrm] = lm_to_replace;
-                    lm_in_keyfrm->replace(lm_to_replace, map_db_);
-                    if (!lm_to_replace->has_representative_descriptor()) {
-                        lm_to_replace->compute_descriptor();
-                    }
-                    if (!lm_to_replace->has_valid_prediction_parameters()) {
-                        lm_to_replace->update_mean_normal_and_obs_scale_variance();
-                    }
-                }
-            }
+            fuse_matcher.detect_duplication(fuse_tgt_keyfrm, rot_cw, trans_cw, cur_landmarks, 3.0,
+                                            duplicated_lms_in_keyfrms.at(i), new_connections_in_keyfrms.at(i), true);
+        });
 
-            for (const auto& best_idx_lm : new_connections) {
-                const auto& best_idx = best_idx_lm.first;
-                auto lm = best_idx_lm.second;
-                while (replaced_lms.count(lm)) {
-                    lm = replaced_lms[lm];
-                }
-                lm->connect_to_keyframe(fuse_tgt_keyfrm, best_idx);
-                lm->update_mean_normal_and_obs_scale_variance();
-                lm->compute_descriptor();
-            }
+        // 2. apply the replacements and the new connections in the order of the targets
+        for (unsigned int i = 0; i < fuse_tgt_keyfrms.size(); ++i) {
+            apply_landmark_fusion(fuse_tgt_keyfrms.at(i), duplicated_lms_in_keyfrms.at(i), new_connections_in_keyfrms.at(i), replaced_lms);
         }
     }
 
@@ -464,50 +724,77 @@ void mapping_module::fuse_landmark_duplication(const std::vector<std::shared_ptr
         const Vec3_t trans_cw = cur_keyfrm_->get_trans_cw();
         fuse_matcher.detect_duplication(cur_keyfrm_, rot_cw, trans_cw, candidate_landmarks_to_fuse, 3.0, duplicated_lms_in_keyfrm, new_connections, true);
 
-        // There is association between the 3D point and the keyframe
-        // -> Duplication exists
-        for (const auto& lms_pair : duplicated_lms_in_keyfrm) {
-            auto lm_to_replace = lms_pair.first;
-            auto lm_in_keyfrm = lms_pair.second;
-            // Replace with more reliable 3D points (= more observable)
-            assert(!replaced_lms.count(lm_in_keyfrm));
-            assert(!replaced_lms.count(lm_to_replace));
-            if (lm_to_replace->num_observations() < lm_in_keyfrm->num_observations()) {
-                std::swap(lm_to_replace, lm_in_keyfrm);
+        apply_landmark_fusion(cur_keyfrm_, duplicated_lms_in_keyfrm, new_connections, replaced_lms);
+    }
+}
+
+void mapping_module::apply_landmark_fusion(const std::shared_ptr<data::keyframe>& keyfrm,
+                                           const std::unordered_map<std::shared_ptr<data::landmark>, std::shared_ptr<data::landmark>>& duplicated_lms_in_keyfrm,
+                                           const std::unordered_map<unsigned int, std::shared_ptr<data::landmark>>& new_connections,
+                                           nondeterministic::unordered_map<std::shared_ptr<data::landmark>, std::shared_ptr<data::landmark>>& replaced_lms) {
+    // follow the replacements applied after the detection
+    const auto resolve = [&replaced_lms](std::shared_ptr<data::landmark> lm) {
+        while (replaced_lms.count(lm)) {
+            lm = replaced_lms[lm];
+        }
+        return lm;
+    };
+
+    // There is association between the 3D point and the keyframe
+    // -> Duplication exists
+    for (const auto& lms_pair : duplicated_lms_in_keyfrm) {
+        auto lm_to_replace = resolve(lms_pair.first);
+        auto lm_in_keyfrm = resolve(lms_pair.second);
+        if (lm_to_replace->will_be_erased() || lm_in_keyfrm->will_be_erased()) {
+            continue;
+        }
+        // Replace with more reliable 3D points (= more observable)
+        if (lm_to_replace->num_observations() < lm_in_keyfrm->num_observations()) {
+            std::swap(lm_to_replace, lm_in_keyfrm);
+        }
+        // Replace lm_in_keyfrm with lm_to_replace
+        if (lm_to_replace->id_ != lm_in_keyfrm->id_) {
+            replaced_lms[lm_in_keyfrm] = lm_to_replace;
+            lm_in_keyfrm->replace(lm_to_replace, map_db_);
+            if (!lm_to_replace->has_representative_descriptor()) {
+                lm_to_replace->compute_descriptor();
             }
-            // Replace lm_in_keyfrm with lm_to_replace
-            if (lm_to_replace->id_ != lm_in_keyfrm->id_) {
-                replaced_lms[lm_in_keyfrm] = lm_to_replace;
-                lm_in_keyfrm->replace(lm_to_replace, map_db_);
-                if (!lm_to_replace->has_representative_descriptor()) {
-                    lm_to_replace->compute_descriptor();
-                }
-                if (!lm_to_replace->has_valid_prediction_parameters()) {
-                    lm_to_replace->update_mean_normal_and_obs_scale_variance();
-                }
+            if (!lm_to_replace->has_valid_prediction_parameters()) {
+                lm_to_replace->update_mean_normal_and_obs_scale_variance();
             }
         }
+    }
 
-        for (const auto& best_idx_lm : new_connections) {
-            const auto& best_idx = best_idx_lm.first;
-            auto lm = best_idx_lm.second;
-            while (replaced_lms.count(lm)) {
-                lm = replaced_lms[lm];
-            }
-            lm->connect_to_keyframe(cur_keyfrm_, best_idx);
-            lm->update_mean_normal_and_obs_scale_variance();
-            lm->compute_descriptor();
+    for (const auto& best_idx_lm : new_connections) {
+        const auto& best_idx = best_idx_lm.first;
+        const auto lm = resolve(best_idx_lm.second);
+        // the keypoint or the landmark might be associated by the replacements
+        if (lm->will_be_erased() || keyfrm->get_landmark(best_idx) || lm->is_observed_in_keyframe(keyfrm)) {
+            continue;
         }
+        lm->connect_to_keyframe(keyfrm, best_idx);
+        lm->update_mean_normal_and_obs_scale_variance();
+        lm->compute_descriptor();
     }
 }
 
 std::shared_future<void> mapping_module::async_reset() {
-    std::lock_guard<std::mutex> lock(mtx_reset_);
-    reset_is_requested_ = true;
-    if (!future_reset_.valid()) {
-        future_reset_ = promise_reset_.get_future().share();
+    std::shared_future<void> future_reset;
+    {
+        std::lock_guard<std::mutex> lock(mtx_reset_);
+        reset_is_requested_ = true;
+        if (!future_reset_.valid()) {
+            future_reset_ = promise_reset_.get_future().share();
+        }
+        future_reset = future_reset_;
+    }
+    if (is_offline_) {
+        // no keyframe is being processed while the request is made
+        reset();
+        return future_reset;
     }
-    return future_reset_;
+    notify_wakeup();
+    return future_reset;
 }
 
 bool mapping_module::reset_is_requested() const {
@@ -518,7 +805,13 @@ bool mapping_module::reset_is_requested() const {
 void mapping_module::reset() {
     std::lock_guard<std::mutex> lock(mtx_reset_);
     spdlog::info("reset mapping module");
-    keyfrms_queue_.clear();
+    {
+        std::lock_guard<std::mutex> lock_queue(mtx_keyfrm_queue_);
+        keyfrms_queue_.clear();
+        keyfrm_materializers_.clear();
+    }
+    batched_keyfrms_.clear();
+    cond_processed_keyfrms_.notify_all();
     local_map_cleaner_->reset();
     reset_is_requested_ = false;
     promise_reset_.set_value();
@@ -527,6 +820,22 @@ void mapping_module::reset() {
 }
 
 std::shared_future<void> mapping_module::async_pause() {
+    if (is_offline_ && !is_terminated()) {
+        // no keyframe is being processed while the request is made, so pause it here as run() does
+        tracker_->async_stop_keyframe_insertion().get();
+        std::shared_future<void> future_pause;
+        {
+            std::lock_guard<std::mutex> lock_pause(mtx_pause_);
+            pause_is_requested_ = true;
+            if (!future_pause_.valid()) {
+                future_pause_ = promise_pause_.get_future().share();
+            }
+            future_pause = future_pause_;
+        }
+        pause();
+        return future_pause;
+    }
+
     std::lock_guard<std::mutex> lock_pause(mtx_pause_);
     pause_is_requested_ = true;
     abort_local_BA_ = true;
@@ -543,6 +852,7 @@ std::shared_future<void> mapping_module::async_pause() {
         promise_pause_ = std::promise<void>();
         future_pause_ = std::shared_future<void>();
     }
+    notify_wakeup();
     return future_pause;
 }
 
@@ -578,17 +888,32 @@ void mapping_module::resume() {
 
     is_paused_ = false;
     pause_is_requested_ = false;
+    if (is_offline_) {
+        // (run() restarts the keyframe insertion after the pause)
+        tracker_->async_start_keyframe_insertion().get();
+    }
+    notify_wakeup();
 
     spdlog::info("resume mapping module");
 }
 
 std::shared_future<void> mapping_module::async_terminate() {
-    std::lock_guard<std::mutex> lock(mtx_terminate_);
-    terminate_is_requested_ = true;
-    if (!future_terminate_.valid()) {
-        future_terminate_ = promise_terminate_.get_future().share();
+    std::shared_future<void> future_terminate;
+    {
+        std::lock_guard<std::mutex> lock(mtx_terminate_);
+        terminate_is_requested_ = true;
+        if (!future_terminate_.valid()) {
+            future_terminate_ = promise_terminate_.get_future().share();
+        }
+        future_terminate = future_terminate_;
+    }
+    if (is_offline_) {
+        // no keyframe is being processed while the request is made
+        terminate();
+        return future_terminate;
     }
-    return future_terminate_;
+    notify_wakeup();
+    return future_terminate;
 }
 
 bool mapping_module::is_terminated() const {
@@ -6,11 +6,16 @@
 #include "stella_vslam/module/local_map_cleaner.h"
 #include "stella_vslam/optimize/local_bundle_adjuster.h"
 #include "stella_vslam/data/bow_vocabulary_fwd.h"
+#include "stella_vslam/util/cpu_budget.h"
 
 #include <mutex>
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
 #include <memory>
 #include <future>
+#include <unordered_map>
 
 #include <yaml-cpp/yaml.h>
 
@@ -30,6 +35,15 @@ class bow_database;
 class map_database;
 } // namespace data
 
+namespace publish {
+class metrics_publisher;
+} // namespace publish
+
+namespace util {
+class keyframe_tracer;
+class thread_pool;
+} // namespace util
+
 class mapping_module {
 public:
     //! Constructor
@@ -44,27 +58,77 @@ public:
     //! Set the global optimization module
     void set_global_optimization_module(global_optimization_module* global_optimizer);
 
+    //! Set the metrics publisher which records the durations of the local BA
+    void set_metrics_publisher(const std::shared_ptr<publish::metrics_publisher>& metrics_publisher);
+
+    //! Set the tracer which records the times when the keyframes are queued, dequeued, mapped and locally optimized
+    void set_keyframe_tracer(const std::shared_ptr<util::keyframe_tracer>& keyfrm_tracer);
+
+    //! Set the thread pool shared among the modules, which runs the parallel loops of the mapping and the local BA
+    void set_thread_pool(const std::shared_ptr<util::thread_pool>& thread_pool);
+
     //-----------------------------------------
     // main process
 
     //! Run main loop of the mapping module
     void run();
 
+    //! Start the mapping module without its own thread (offline mapping mode)
+    //! (NOTE: the queued keyframes are processed with process_queued_keyframes() instead of run(),
+    //!  and the pause, reset and terminate requests are carried out on the caller threads, so the callers must be serialized)
+    void start_offline();
+
+    //! Process all of the queued keyframes on the caller thread (offline mapping mode)
+    void process_queued_keyframes();
+
     //! Queue a keyframe to process the mapping
-    void queue_keyframe(const std::shared_ptr<data::keyframe>& keyfrm);
+    //! (if materializer is given, it is called on the mapping thread before the keyframe is stored to the map database,
+    //!  so that the tracker can defer the expensive construction of the keyframe, see module::keyframe_inserter)
+    void queue_keyframe(const std::shared_ptr<data::keyframe>& keyfrm,
+                        const std::function<void()>& materializer = nullptr);
 
     //! Check if keyframe is queued
     bool keyframe_is_queued() const;
 
+    //! Check if a keyframe is queued and allowed to be processed by the limit of the processed keyframes
+    bool keyframe_is_ready() const;
+
     //! Get the number of queued keyframes
     unsigned int get_num_queued_keyframes() const;
 
+    //! Get the exponential moving average of the time to map a keyframe [ms] (0 until a keyframe is mapped)
+    double get_mean_keyframe_mapping_ms() const { return mean_keyfrm_mapping_ms_; }
+
+    //! Get the estimated bytes of the scratch space of the last local BA
+    size_t get_local_BA_scratch_memory_bytes() const;
+
     //! True when no keyframes are being processed
     bool is_idle() const;
 
+    //! Wait until the queue is empty and no keyframe is being processed
+    //! (return false if max_wait_ms has elapsed before that)
+    bool wait_until_idle(const double max_wait_ms);
+
     //! If the size of the queue exceeds this threshold, skip the localBA
     bool is_skipping_localBA() const;
 
+    //-----------------------------------------
+    // scheduling of the keyframes (for record and replay)
+
+    //! Get the number of the keyframes processed since the mapping module is constructed
+    unsigned int get_num_processed_keyframes() const;
+
+    //! Hold the queued keyframes while the number of the processed keyframes reaches the limit
+    //! (NOTE: the redundant keyframes are removed right after each keyframe instead of in the background while limited)
+    void limit_processed_keyframes(const unsigned int max_num_processed_keyfrms);
+
+    //! Remove the limit of the processed keyframes
+    void unlimit_processed_keyframes();
+
+    //! Wait until the number of the processed keyframes reaches num_processed_keyfrms
+    //! (return false if no keyframe is left to be processed before reaching it)
+    bool wait_for_processed_keyframes(const unsigned int num_processed_keyfrms);
+
     //-----------------------------------------
     // management for reset process
 
@@ -117,6 +181,9 @@ private:
     //-----------------------------------------
     // main process
 
+    //! Process the oldest queued keyframe, then send it to the global optimization module
+    void process_new_keyframe();
+
     //! Create and extend the map with the new keyframe
     void mapping_with_new_keyframe();
 
@@ -126,9 +193,18 @@ private:
     //! Create new landmarks using neighbor keyframes
     void create_new_landmarks(std::atomic<bool>& abort_create_new_landmarks);
 
-    //! Triangulate landmarks between the keyframes 1 and 2
+    //! A match between the keyframes 1 and 2, and its triangulated position
+    struct triangulated_match {
+        unsigned int idx_1_;
+        unsigned int idx_2_;
+        Vec3_t pos_w_;
+    };
+
+    //! Triangulate the matches between the keyframes 1 and 2
+    //! (NOTE: the landmarks are not created here, so this function can be called in parallel)
     void triangulate_with_two_keyframes(const std::shared_ptr<data::keyframe>& keyfrm_1, const std::shared_ptr<data::keyframe>& keyfrm_2,
-                                        const std::vector<std::pair<unsigned int, unsigned int>>& matches);
+                                        const std::vector<std::pair<unsigned int, unsigned int>>& matches,
+                                        std::vector<triangulated_match>& triangulated_matches) const;
 
     //! Update the new keyframe
     void update_new_keyframe();
@@ -137,9 +213,44 @@ private:
     void fuse_landmark_duplication(const std::vector<std::shared_ptr<data::keyframe>>& fuse_tgt_keyfrms,
                                    nondeterministic::unordered_map<std::shared_ptr<data::landmark>, std::shared_ptr<data::landmark>>& replaced_lms);
 
+    //! Apply the duplication and the new connections detected by match::fuse to the keyframe
+    //! (NOTE: the landmarks replaced after the detection are followed via replaced_lms)
+    void apply_landmark_fusion(const std::shared_ptr<data::keyframe>& keyfrm,
+                               const std::unordered_map<std::shared_ptr<data::landmark>, std::shared_ptr<data::landmark>>& duplicated_lms_in_keyfrm,
+                               const std::unordered_map<unsigned int, std::shared_ptr<data::landmark>>& new_connections,
+                               nondeterministic::unordered_map<std::shared_ptr<data::landmark>, std::shared_ptr<data::landmark>>& replaced_lms);
+
     //! Set is_idle (True when no keyframes are being processed.)
     void set_is_idle(const bool is_idle);
 
+    //! The number of the processed keyframes is limited or not
+    bool processed_keyframes_are_limited() const;
+
+    //! the mapping module is driven by process_queued_keyframes() instead of run()
+    std::atomic<bool> is_offline_{false};
+
+    //-----------------------------------------
+    // wakeup of the main loop
+
+    //! mutex for the wakeup flag
+    std::mutex mtx_wakeup_;
+    //! condition variable notified by notify_wakeup()
+    std::condition_variable cond_wakeup_;
+    //! flag which indicates the main loop should check the requests and the queue
+    bool wakeup_is_requested_ = false;
+
+    //! Wake up the main loop (called after a keyframe is queued or any request is made)
+    void notify_wakeup();
+
+    //! Block until notify_wakeup() is called
+    //! (if wake_on_pending_work is true, also return while a keyframe is queued or the pause is requested,
+    //!  because the previous iteration might have consumed the wakeup without handling them)
+    void wait_for_wakeup(const bool wake_on_pending_work);
+
+    //! Block for sleep_ms unless the pause, reset or termination is requested (or a keyframe is queued if wake_on_keyframe is true)
+    //! (return true if interrupted)
+    bool sleep_interruptibly(const double sleep_ms, const bool wake_on_keyframe);
+
     //-----------------------------------------
     // management for reset process
 
@@ -235,6 +346,19 @@ private:
 
     //! queue for keyframes
     std::list<std::shared_ptr<data::keyframe>> keyfrms_queue_;
+    //! deferred construction of the queued keyframes (keyframe ID -> materializer)
+    std::unordered_map<unsigned int, std::function<void()>> keyfrm_materializers_;
+
+    //! number of the processed keyframes
+    unsigned int num_processed_keyfrms_ = 0;
+    //! the number of the processed keyframes is limited or not
+    bool processed_keyfrms_are_limited_ = false;
+    //! maximum number of the processed keyframes (if limited)
+    unsigned int max_num_processed_keyfrms_ = 0;
+    //! notified when a keyframe is processed or the queue is cleared
+    std::condition_variable cond_processed_keyfrms_;
+    //! exponential moving average of the time to map a keyframe [ms]
+    std::atomic<double> mean_keyfrm_mapping_ms_{0.0};
 
     //-----------------------------------------
     // optimizer
@@ -245,6 +369,18 @@ private:
     //! bridge flag to abort local BA
     bool abort_local_BA_ = false;
 
+    //! keyframes integrated since the last local BA (optimized together with the next local BA)
+    std::vector<std::shared_ptr<data::keyframe>> batched_keyfrms_;
+
+    //! metrics publisher (nullptr if not set)
+    std::shared_ptr<publish::metrics_publisher> metrics_publisher_ = nullptr;
+
+    //! keyframe tracer (nullptr if not set)
+    std::shared_ptr<util::keyframe_tracer> keyfrm_tracer_ = nullptr;
+
+    //! thread pool shared among the modules (nullptr if not set, then the OpenMP loops are used)
+    std::shared_ptr<util::thread_pool> thread_pool_ = nullptr;
+
     //-----------------------------------------
     // others
 
@@ -275,11 +411,27 @@ private:
     //! if true, enable interruption before local BA
     const bool enable_interruption_before_local_BA_ = true;
 
+    //! Maximum number of the keyframes integrated before a single local BA while keyframes are queued (0: unlimited)
+    const unsigned int max_num_batched_keyframes_ = 4;
+
     //! Number of keyframes used for landmark generation
     const unsigned int num_covisibilities_for_landmark_generation_ = 10;
 
     //! Number of keyframes used for landmark fusion
     const unsigned int num_covisibilities_for_landmark_fusion_ = 10;
+
+    //-----------------------------------------
+    // CPU budget
+
+    //! duty cycle of the main loop (the keyframes and the cleaning in the idle time)
+    const util::cpu_budget cpu_budget_;
+
+    //! The cleaning in the idle time (redundant keyframes, summarization and compaction) is deferred
+    //! until no keyframe has been processed for this duration [ms]
+    const double idle_work_delay_ms_ = 0.0;
+
+    //! time when the last keyframe was processed
+    std::chrono::steady_clock::time_point last_keyfrm_processed_at_;
 };
 
 } // namespace stella_vslam
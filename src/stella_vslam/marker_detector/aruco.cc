@@ -70,8 +70,9 @@ namespace marker_detector {
 aruco::aruco(const camera::base* camera,
              const std::shared_ptr<marker_model::base>& marker_model,
              const unsigned int num_iter,
-             const double reproj_error_threshold)
-    : base(camera, marker_model, num_iter, reproj_error_threshold) {
+             const double reproj_error_threshold,
+             const double decimation)
+    : base(camera, marker_model, num_iter, reproj_error_threshold, decimation) {
     parameters_ = cv::aruco::DetectorParameters::create();
     auto aruco_marker_model = std::static_pointer_cast<marker_model::aruco>(marker_model);
     dictionary_ = get_predefined_dictionary(aruco_marker_model->marker_size_, aruco_marker_model->max_markers_);
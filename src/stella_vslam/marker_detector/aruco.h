@@ -36,7 +36,8 @@ public:
     aruco(const camera::base* camera,
           const std::shared_ptr<marker_model::base>& marker_model,
           unsigned int num_iter = 10,
-          double reproj_error_threshold = 0.1);
+          double reproj_error_threshold = 0.1,
+          double decimation = 1.0);
 
     virtual ~aruco() = default;
 
@@ -6,8 +6,9 @@ namespace marker_detector {
 aruco::aruco(const camera::base* camera,
              const std::shared_ptr<marker_model::base>& marker_model,
              const unsigned int num_iter,
-             const double reproj_error_threshold)
-    : base(camera, marker_model, num_iter, reproj_error_threshold) {
+             const double reproj_error_threshold,
+             const double decimation)
+    : base(camera, marker_model, num_iter, reproj_error_threshold, decimation) {
 }
 
 bool aruco::is_valid() {
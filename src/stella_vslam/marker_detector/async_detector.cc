@@ -0,0 +1,76 @@
+#include "stella_vslam/marker_detector/async_detector.h"
+#include "stella_vslam/marker_detector/base.h"
+
+#include <spdlog/spdlog.h>
+
+namespace stella_vslam {
+namespace marker_detector {
+
+async_detector::async_detector(const base* detector)
+    : detector_(detector) {
+    spdlog::debug("CONSTRUCT: marker_detector::async_detector");
+    thread_ = std::thread(&async_detector::run, this);
+}
+
+async_detector::~async_detector() {
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        terminate_is_requested_ = true;
+    }
+    cond_.notify_one();
+    thread_.join();
+
+    // the frames waiting for the pending request get no markers
+    if (pending_promise_) {
+        pending_promise_->set_value(markers_2d_t());
+    }
+    spdlog::debug("DESTRUCT: marker_detector::async_detector");
+}
+
+std::shared_future<async_detector::markers_2d_t> async_detector::request(const cv::Mat& img) {
+    std::unique_ptr<std::promise<markers_2d_t>> promise(new std::promise<markers_2d_t>());
+    std::shared_future<markers_2d_t> future = promise->get_future().share();
+    // the caller might reuse the buffer of the image
+    const cv::Mat img_copy = img.clone();
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (pending_promise_) {
+            SPDLOG_TRACE("async_detector: the pending request is superseded");
+            pending_promise_->set_value(markers_2d_t());
+        }
+        pending_img_ = img_copy;
+        pending_promise_ = std::move(promise);
+    }
+    cond_.notify_one();
+    return future;
+}
+
+void async_detector::run() {
+    while (true) {
+        cv::Mat img;
+        std::unique_ptr<std::promise<markers_2d_t>> promise;
+        {
+            std::unique_lock<std::mutex> lock(mtx_);
+            cond_.wait(lock, [this] { return terminate_is_requested_ || pending_promise_; });
+            if (terminate_is_requested_) {
+                break;
+            }
+            img = pending_img_;
+            pending_img_ = cv::Mat();
+            promise = std::move(pending_promise_);
+        }
+
+        markers_2d_t markers_2d;
+        try {
+            detector_->detect(img, markers_2d);
+        }
+        catch (const std::exception& e) {
+            spdlog::warn("async_detector: marker detection failed: {}", e.what());
+            markers_2d.clear();
+        }
+        promise->set_value(std::move(markers_2d));
+    }
+}
+
+} // namespace marker_detector
+} // namespace stella_vslam
@@ -0,0 +1,62 @@
+#ifndef STELLA_VSLAM_MARKER_DETECTOR_ASYNC_DETECTOR_H
+#define STELLA_VSLAM_MARKER_DETECTOR_ASYNC_DETECTOR_H
+
+#include "stella_vslam/data/marker2d.h"
+
+#include <condition_variable>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#include <opencv2/core/mat.hpp>
+
+namespace stella_vslam {
+namespace marker_detector {
+
+class base;
+
+/**
+ * Run the marker detection on a worker thread, off the critical path of the tracking
+ * (NOTE: only the latest request waits for the worker.
+ *  The result of a request which is superseded before its detection starts is empty.)
+ */
+class async_detector {
+public:
+    using markers_2d_t = std::unordered_map<unsigned int, data::marker2d>;
+
+    //! Constructor
+    explicit async_detector(const base* detector);
+
+    //! Destructor
+    ~async_detector();
+
+    //! Request the detection on the grayscale image (the image is copied)
+    std::shared_future<markers_2d_t> request(const cv::Mat& img);
+
+private:
+    //! Main loop of the worker
+    void run();
+
+    //! marker detector
+    const base* detector_;
+
+    //! mutex to access the variables below
+    std::mutex mtx_;
+    std::condition_variable cond_;
+    //! the worker is requested to terminate
+    bool terminate_is_requested_ = false;
+    //! image of the pending request
+    cv::Mat pending_img_;
+    //! promise of the pending request (nullptr if no request is pending)
+    std::unique_ptr<std::promise<markers_2d_t>> pending_promise_;
+
+    //! worker thread
+    std::thread thread_;
+};
+
+} // namespace marker_detector
+} // namespace stella_vslam
+
+#endif // STELLA_VSLAM_MARKER_DETECTOR_ASYNC_DETECTOR_H
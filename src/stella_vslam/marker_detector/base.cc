@@ -4,13 +4,17 @@
 #include "stella_vslam/marker_model/base.h"
 #include "stella_vslam/solve/pnp_solver.h"
 
+#include <opencv2/imgproc.hpp>
+
 namespace stella_vslam {
 namespace marker_detector {
 base::base(const camera::base* camera,
            const std::shared_ptr<marker_model::base>& marker_model,
            const unsigned int num_iter,
-           const double reproj_error_threshold)
-    : camera_(camera), marker_model_(marker_model), num_iter_(num_iter), reproj_error_threshold_(reproj_error_threshold) {}
+           const double reproj_error_threshold,
+           const double decimation)
+    : camera_(camera), marker_model_(marker_model), num_iter_(num_iter), reproj_error_threshold_(reproj_error_threshold),
+      decimation_(decimation) {}
 
 bool base::is_valid() {
     return true;
@@ -27,7 +31,20 @@ void base::detect(const cv::_InputArray& in_image, std::unordered_map<unsigned i
     // Get corner positions on image
     std::vector<int> ids;
     std::vector<std::vector<cv::Point2f>> corners;
-    detect_2d(image, corners, ids);
+    if (1.0 < decimation_) {
+        cv::Mat decimated_image;
+        cv::resize(image, decimated_image, cv::Size(), 1.0 / decimation_, 1.0 / decimation_, cv::INTER_AREA);
+        detect_2d(decimated_image, corners, ids);
+        // scale the corner positions back to the original image
+        for (auto& marker_corners : corners) {
+            for (auto& corner : marker_corners) {
+                corner *= static_cast<float>(decimation_);
+            }
+        }
+    }
+    else {
+        detect_2d(image, corners, ids);
+    }
 
     for (unsigned int i = 0; i < corners.size(); ++i) {
         // undistort corner positions
@@ -26,10 +26,12 @@ namespace marker_detector {
 class base {
 public:
     //! Constructor
+    //! (the markers are detected on the image downscaled by 1 / decimation if decimation > 1)
     base(const camera::base* camera,
          const std::shared_ptr<marker_model::base>& marker_model,
          unsigned int num_iter = 10,
-         double reproj_error_threshold = 0.1);
+         double reproj_error_threshold = 0.1,
+         double decimation = 1.0);
 
     virtual ~base() = default;
 
@@ -52,6 +54,9 @@ public:
 
     //! reprojection error threshold
     double reproj_error_threshold_ = 0.1;
+
+    //! decimation of the image for the detection of the corners
+    double decimation_ = 1.0;
 };
 
 } // namespace marker_detector
@@ -1,52 +1,171 @@
+#include "stella_vslam/camera/base.h"
 #include "stella_vslam/data/frame.h"
 #include "stella_vslam/match/area.h"
 #include "stella_vslam/util/angle.h"
+#include "stella_vslam/util/scratch_buffer.h"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef USE_OPENMP
+#include <omp.h>
+#endif
 
 namespace stella_vslam {
 namespace match {
 
+namespace {
+
+//! Keypoint of frame 2 in the window and its Hamming distance
+struct area_candidate {
+    unsigned int idx_2_;
+    unsigned int dist_;
+};
+
+//! Range of the candidates of a keypoint of frame 1 in the buffer of a thread
+struct area_candidate_range {
+    unsigned int thread_idx_ = 0;
+    unsigned int begin_ = 0;
+    unsigned int end_ = 0;
+};
+
+} // namespace
+
 unsigned int area::match_in_consistent_area(data::frame& frm_1, data::frame& frm_2, std::vector<cv::Point2f>& prev_matched_pts,
                                             std::vector<int>& matched_indices_2_in_frm_1, int margin) {
     unsigned int num_matches = 0;
 
-    matched_indices_2_in_frm_1 = std::vector<int>(frm_1.frm_obs_.undist_keypts_.size(), -1);
-
-    std::vector<unsigned int> matched_dists_in_frm_2(frm_2.frm_obs_.undist_keypts_.size(), MAX_HAMMING_DIST);
-    std::vector<int> matched_indices_1_in_frm_2(frm_2.frm_obs_.undist_keypts_.size(), -1);
+    const auto& undist_keypts_1 = frm_1.frm_obs_->undist_keypts_;
+    const auto& undist_keypts_2 = frm_2.frm_obs_->undist_keypts_;
+    const unsigned int num_keypts_1 = undist_keypts_1.size();
+
+    matched_indices_2_in_frm_1 = std::vector<int>(num_keypts_1, -1);
+
+    // (the buffers are reused across the calls on the thread)
+    util::scratch_vector<unsigned int> matched_dists_in_frm_2(undist_keypts_2.size(), MAX_HAMMING_DIST);
+    util::scratch_vector<int> matched_indices_1_in_frm_2(undist_keypts_2.size(), -1);
+
+    // 1. Gather the keypoints of frame 2 with the 0-th scale in the order of the grid cells,
+    //    so that the descriptors in each cell are contiguous
+    const camera::base* camera = frm_2.camera_;
+    const auto& grid = frm_2.frm_obs_->keypt_indices_in_cells_;
+    const int num_grid_cols = camera->num_grid_cols_;
+    const int num_grid_rows = camera->num_grid_rows_;
+    util::scratch_vector<unsigned int> cell_offsets(num_grid_cols * num_grid_rows + 1, 0);
+    util::scratch_vector<unsigned int> cell_ordered_indices_2;
+    util::scratch_vector<uint8_t> cell_ordered_descs_2;
+    cell_ordered_indices_2->reserve(grid.num_assigned());
+    cell_ordered_descs_2->reserve(grid.num_assigned() * 32);
+    for (int cell_idx_x = 0; cell_idx_x < num_grid_cols; ++cell_idx_x) {
+        for (int cell_idx_y = 0; cell_idx_y < num_grid_rows; ++cell_idx_y) {
+            for (const auto idx_2 : grid.cell(cell_idx_x, cell_idx_y)) {
+                if (0 < undist_keypts_2.at(idx_2).octave) {
+                    continue;
+                }
+                cell_ordered_indices_2->push_back(idx_2);
+                const uint8_t* desc_2 = frm_2.frm_obs_->descriptors_.ptr<uint8_t>(idx_2);
+                cell_ordered_descs_2->insert(cell_ordered_descs_2->end(), desc_2, desc_2 + 32);
+            }
+            cell_offsets->at(cell_idx_x * num_grid_rows + cell_idx_y + 1) = cell_ordered_indices_2->size();
+        }
+    }
 
-    for (unsigned int idx_1 = 0; idx_1 < frm_1.frm_obs_.undist_keypts_.size(); ++idx_1) {
-        const auto& undist_keypt_1 = frm_1.frm_obs_.undist_keypts_.at(idx_1);
-        const auto scale_level_1 = undist_keypt_1.octave;
+    // 2. Compute the distances to the keypoints in the window of each keypoint of frame 1 in parallel
+    //    (NOTE: the candidates are listed in the same order as data::get_keypoints_in_cell())
+#ifdef USE_OPENMP
+    const bool use_threads = !omp_in_parallel();
+    const unsigned int num_threads = use_threads ? omp_get_max_threads() : 1;
+#else
+    const unsigned int num_threads = 1;
+#endif
+    std::vector<std::vector<area_candidate>> candidates_of_threads(num_threads);
+    util::scratch_vector<area_candidate_range> candidate_ranges(num_keypts_1);
+
+#ifdef USE_OPENMP
+#pragma omp parallel if (use_threads)
+#endif
+    {
+#ifdef USE_OPENMP
+        const unsigned int thread_idx = omp_get_thread_num();
+#else
+        const unsigned int thread_idx = 0;
+#endif
+        auto& candidates = candidates_of_threads.at(thread_idx);
+        util::scratch_vector<unsigned int> dists;
+
+#ifdef USE_OPENMP
+#pragma omp for schedule(dynamic, 32)
+#endif
+        for (int64_t idx_1 = 0; idx_1 < static_cast<int64_t>(num_keypts_1); ++idx_1) {
+            auto& range = candidate_ranges->at(idx_1);
+            range.thread_idx_ = thread_idx;
+            range.begin_ = range.end_ = candidates.size();
+
+            // Use only keypoints with the 0-th scale
+            if (0 < undist_keypts_1.at(idx_1).octave) {
+                continue;
+            }
 
-        // Use only keypoints with the 0-th scale
-        if (0 < scale_level_1) {
-            continue;
+            // Get keypoints in the cells neighboring to the previous match
+            const float ref_x = prev_matched_pts.at(idx_1).x;
+            const float ref_y = prev_matched_pts.at(idx_1).y;
+            const int min_cell_idx_x = std::max(0, cvFloor((ref_x - camera->img_bounds_.min_x_ - margin) * camera->inv_cell_width_));
+            const int max_cell_idx_x = std::min(num_grid_cols - 1, cvCeil((ref_x - camera->img_bounds_.min_x_ + margin) * camera->inv_cell_width_));
+            const int min_cell_idx_y = std::max(0, cvFloor((ref_y - camera->img_bounds_.min_y_ - margin) * camera->inv_cell_height_));
+            const int max_cell_idx_y = std::min(num_grid_rows - 1, cvCeil((ref_y - camera->img_bounds_.min_y_ + margin) * camera->inv_cell_height_));
+
+            const uint8_t* desc_1 = frm_1.frm_obs_->descriptors_.ptr<uint8_t>(idx_1);
+
+            for (int cell_idx_x = min_cell_idx_x; cell_idx_x <= max_cell_idx_x; ++cell_idx_x) {
+                for (int cell_idx_y = min_cell_idx_y; cell_idx_y <= max_cell_idx_y; ++cell_idx_y) {
+                    const auto cell_idx = cell_idx_x * num_grid_rows + cell_idx_y;
+                    const auto begin = cell_offsets->at(cell_idx);
+                    const auto end = cell_offsets->at(cell_idx + 1);
+                    if (begin == end) {
+                        continue;
+                    }
+
+                    // Compute the distances to all the keypoints in the cell at once
+                    dists->resize(end - begin);
+                    compute_hamming_distances_256(desc_1, cell_ordered_descs_2->data() + begin * 32, 32, end - begin, dists->data());
+
+                    for (unsigned int k = begin; k < end; ++k) {
+                        const auto idx_2 = cell_ordered_indices_2->at(k);
+                        const auto& pt_2 = undist_keypts_2.at(idx_2).pt;
+                        if (margin <= std::abs(pt_2.x - ref_x) || margin <= std::abs(pt_2.y - ref_y)) {
+                            continue;
+                        }
+                        candidates.push_back(area_candidate{idx_2, dists->at(k - begin)});
+                    }
+                }
+            }
+            range.end_ = candidates.size();
         }
+    }
 
-        // Get keypoints in the cells neighboring to the previous match
-        const auto indices = frm_2.get_keypoints_in_cell(prev_matched_pts.at(idx_1).x, prev_matched_pts.at(idx_1).y,
-                                                         margin, scale_level_1, scale_level_1);
-        if (indices.empty()) {
+    // 3. Associate the keypoints in the order of frame 1 with the orientation check
+    //    (the association depends on the earlier ones, so this is done serially on the computed distances)
+    for (unsigned int idx_1 = 0; idx_1 < num_keypts_1; ++idx_1) {
+        const auto& range = candidate_ranges->at(idx_1);
+        if (range.begin_ == range.end_) {
             continue;
         }
-
-        const auto& desc_1 = frm_1.frm_obs_.descriptors_.row(idx_1);
+        const auto& candidates = candidates_of_threads.at(range.thread_idx_);
 
         unsigned int best_hamm_dist = MAX_HAMMING_DIST;
         unsigned int second_best_hamm_dist = MAX_HAMMING_DIST;
         int best_idx_2 = -1;
 
-        for (const auto idx_2 : indices) {
-            if (check_orientation_ && std::abs(util::angle::diff(frm_1.frm_obs_.undist_keypts_.at(idx_1).angle, frm_2.frm_obs_.undist_keypts_.at(idx_2).angle)) > 30.0) {
+        for (unsigned int k = range.begin_; k < range.end_; ++k) {
+            const auto idx_2 = candidates.at(k).idx_2_;
+            const auto hamm_dist = candidates.at(k).dist_;
+
+            if (check_orientation_ && std::abs(util::angle::diff(undist_keypts_1.at(idx_1).angle, undist_keypts_2.at(idx_2).angle)) > 30.0) {
                 continue;
             }
 
-            const auto& desc_2 = frm_2.frm_obs_.descriptors_.row(idx_2);
-
-            const auto hamm_dist = compute_descriptor_distance_32(desc_1, desc_2);
-
             // Ignore if the already-matched point is closer in Hamming space
-            if (matched_dists_in_frm_2.at(idx_2) <= hamm_dist) {
+            if (matched_dists_in_frm_2->at(idx_2) <= hamm_dist) {
                 continue;
             }
 
@@ -74,7 +193,7 @@ unsigned int area::match_in_consistent_area(data::frame& frm_1, data::frame& frm
         // If a match associated to the best index 2 exists, to overwrite the matching information of the previous index 1 (= prev_idx_1),
         // 'matched_indices_2_in_frm_1.at(prev_idx_1)' must be deleted to overrwrite the updates
         // ('matched_indices_1_in_frm_2.at (best_idx_2)' will be overwritten, so there is no need to delete it)
-        const auto prev_idx_1 = matched_indices_1_in_frm_2.at(best_idx_2);
+        const auto prev_idx_1 = matched_indices_1_in_frm_2->at(best_idx_2);
         if (0 <= prev_idx_1) {
             matched_indices_2_in_frm_1.at(prev_idx_1) = -1;
             --num_matches;
@@ -82,15 +201,15 @@ unsigned int area::match_in_consistent_area(data::frame& frm_1, data::frame& frm
 
         // Record the mutual matching information
         matched_indices_2_in_frm_1.at(idx_1) = best_idx_2;
-        matched_indices_1_in_frm_2.at(best_idx_2) = idx_1;
-        matched_dists_in_frm_2.at(best_idx_2) = best_hamm_dist;
+        matched_indices_1_in_frm_2->at(best_idx_2) = idx_1;
+        matched_dists_in_frm_2->at(best_idx_2) = best_hamm_dist;
         ++num_matches;
     }
 
     // Update the previous matches
     for (unsigned int idx_1 = 0; idx_1 < matched_indices_2_in_frm_1.size(); ++idx_1) {
         if (0 <= matched_indices_2_in_frm_1.at(idx_1)) {
-            prev_matched_pts.at(idx_1) = frm_2.frm_obs_.undist_keypts_.at(matched_indices_2_in_frm_1.at(idx_1)).pt;
+            prev_matched_pts.at(idx_1) = frm_2.frm_obs_->undist_keypts_.at(matched_indices_2_in_frm_1.at(idx_1)).pt;
         }
     }
 
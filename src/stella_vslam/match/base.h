@@ -1,9 +1,13 @@
 #ifndef STELLA_VSLAM_MATCH_BASE_H
 #define STELLA_VSLAM_MATCH_BASE_H
 
+#include "stella_vslam/match/hamming.h"
+
 #include <array>
 #include <algorithm>
+#include <cassert>
 #include <numeric>
+#include <vector>
 
 #include <opencv2/core/mat.hpp>
 
@@ -15,51 +19,26 @@ static constexpr unsigned int HAMMING_DIST_THR_HIGH = 100;
 static constexpr unsigned int MAX_HAMMING_DIST = 256;
 
 //! ORB特徴量間のハミング距離を計算する
+//! (NOTE: computed inline with the 64-bit popcounts, see compute_hamming_distance_256_inline())
 inline unsigned int compute_descriptor_distance_32(const cv::Mat& desc_1, const cv::Mat& desc_2) {
-    // http://graphics.stanford.edu/~seander/bithacks.html#CountBitsSetParallel
-
-    constexpr uint32_t mask_1 = 0x55555555U;
-    constexpr uint32_t mask_2 = 0x33333333U;
-    constexpr uint32_t mask_3 = 0x0F0F0F0FU;
-    constexpr uint32_t mask_4 = 0x01010101U;
-
-    const auto* pa = desc_1.ptr<uint32_t>();
-    const auto* pb = desc_2.ptr<uint32_t>();
-
-    unsigned int dist = 0;
-
-    for (unsigned int i = 0; i < 8; ++i, ++pa, ++pb) {
-        auto v = *pa ^ *pb;
-        v -= ((v >> 1) & mask_1);
-        v = (v & mask_2) + ((v >> 2) & mask_2);
-        dist += (((v + (v >> 4)) & mask_3) * mask_4) >> 24;
-    }
-
-    return dist;
+    return compute_hamming_distance_256_inline(desc_1.ptr<uint8_t>(), desc_2.ptr<uint8_t>());
 }
 
 //! ORB特徴量間のハミング距離を計算する
+//! (NOTE: the same as compute_descriptor_distance_32(), both of which take the 32-byte ORB descriptors)
 inline unsigned int compute_descriptor_distance_64(const cv::Mat& desc_1, const cv::Mat& desc_2) {
-    // https://stackoverflow.com/questions/21826292/t-sql-hamming-distance-function-capable-of-decimal-string-uint64?lq=1
-
-    constexpr uint64_t mask_1 = 0x5555555555555555UL;
-    constexpr uint64_t mask_2 = 0x3333333333333333UL;
-    constexpr uint64_t mask_3 = 0x0F0F0F0F0F0F0F0FUL;
-    constexpr uint64_t mask_4 = 0x0101010101010101UL;
-
-    const auto* pa = desc_1.ptr<uint64_t>();
-    const auto* pb = desc_2.ptr<uint64_t>();
-
-    unsigned int dist = 0;
+    return compute_hamming_distance_256_inline(desc_1.ptr<uint8_t>(), desc_2.ptr<uint8_t>());
+}
 
-    for (unsigned int i = 0; i < 4; ++i, ++pa, ++pb) {
-        auto v = *pa ^ *pb;
-        v -= (v >> 1) & mask_1;
-        v = (v & mask_2) + ((v >> 2) & mask_2);
-        dist += (((v + (v >> 4)) & mask_3) * mask_4) >> 56;
+//! Compute the Hamming distances between a descriptor and all rows of the descriptor matrix
+//! (NOTE: dispatched to the SIMD kernel selected by CPU detection, see match/hamming.h)
+inline void compute_descriptor_distances(const cv::Mat& desc, const cv::Mat& descs, std::vector<unsigned int>& dists) {
+    assert(descs.empty() || descs.cols == 32);
+    dists.resize(descs.rows);
+    if (descs.empty()) {
+        return;
     }
-
-    return dist;
+    compute_hamming_distances_256(desc.ptr<uint8_t>(), descs.ptr<uint8_t>(), descs.step[0], descs.rows, dists.data());
 }
 
 class base {
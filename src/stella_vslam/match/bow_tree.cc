@@ -3,32 +3,118 @@
 #include "stella_vslam/data/keyframe.h"
 #include "stella_vslam/data/landmark.h"
 #include "stella_vslam/match/bow_tree.h"
+#include "stella_vslam/match/descriptor_block.h"
 #include "stella_vslam/util/angle.h"
 
+#include <cstring>
+
+#ifdef USE_OPENMP
+#include <omp.h>
+#endif
+
 namespace stella_vslam {
 namespace match {
 
+namespace {
+
+//! Minimum number of the shared nodes to use the threads
+//! (NOTE: the matchers called from the parallel loops of the relocalizer and the loop detector run serially)
+constexpr size_t min_num_shared_nodes_to_parallelize = 64;
+
+inline bool use_threads(const size_t num_shared_nodes) {
+#ifdef USE_OPENMP
+    return min_num_shared_nodes_to_parallelize <= num_shared_nodes && !omp_in_parallel();
+#else
+    (void)num_shared_nodes;
+    return false;
+#endif
+}
+
+//! Gather the descriptors of the node into the contiguous buffer
+inline void gather_descriptors(const descriptor_block& descs, const unsigned int* indices, const unsigned int num_indices,
+                               std::vector<uint8_t>& buffer) {
+    buffer.resize(num_indices * 32);
+    for (unsigned int i = 0; i < num_indices; ++i) {
+        std::memcpy(buffer.data() + i * 32, descs.at(indices[i]), 32);
+    }
+}
+
+} // namespace
+
+flat_bow_feature_vector::flat_bow_feature_vector(const data::bow_feature_vector& bow_feat_vec) {
+    node_ids_.reserve(bow_feat_vec.size());
+    offsets_.reserve(bow_feat_vec.size() + 1);
+    offsets_.push_back(0);
+    for (const auto& node : bow_feat_vec) {
+        node_ids_.push_back(node.first);
+        indices_.insert(indices_.end(), node.second.begin(), node.second.end());
+        offsets_.push_back(indices_.size());
+    }
+}
+
+std::vector<std::pair<unsigned int, unsigned int>> find_shared_nodes(const flat_bow_feature_vector& feat_vec_1,
+                                                                     const flat_bow_feature_vector& feat_vec_2) {
+    std::vector<std::pair<unsigned int, unsigned int>> shared_nodes;
+    unsigned int pos_1 = 0;
+    unsigned int pos_2 = 0;
+    while (pos_1 < feat_vec_1.node_ids_.size() && pos_2 < feat_vec_2.node_ids_.size()) {
+        const auto node_id_1 = feat_vec_1.node_ids_[pos_1];
+        const auto node_id_2 = feat_vec_2.node_ids_[pos_2];
+        if (node_id_1 == node_id_2) {
+            shared_nodes.emplace_back(pos_1, pos_2);
+            ++pos_1;
+            ++pos_2;
+        }
+        else if (node_id_1 < node_id_2) {
+            ++pos_1;
+        }
+        else {
+            ++pos_2;
+        }
+    }
+    return shared_nodes;
+}
+
 unsigned int bow_tree::match_frame_and_keyframe(const std::shared_ptr<data::keyframe>& keyfrm, data::frame& frm, std::vector<std::shared_ptr<data::landmark>>& matched_lms_in_frm) const {
     unsigned int num_matches = 0;
 
-    matched_lms_in_frm = std::vector<std::shared_ptr<data::landmark>>(frm.frm_obs_.num_keypts_, nullptr);
+    matched_lms_in_frm = std::vector<std::shared_ptr<data::landmark>>(frm.frm_obs_->num_keypts_, nullptr);
 
     const auto keyfrm_lms = keyfrm->get_landmarks();
 
-    data::bow_feature_vector::const_iterator keyfrm_itr = keyfrm->bow_feat_vec_.begin();
-    data::bow_feature_vector::const_iterator frm_itr = frm.bow_feat_vec_.begin();
-    const data::bow_feature_vector::const_iterator kryfrm_end = keyfrm->bow_feat_vec_.end();
-    const data::bow_feature_vector::const_iterator frm_end = frm.bow_feat_vec_.end();
-
-    while (keyfrm_itr != kryfrm_end && frm_itr != frm_end) {
-        // Check if the node numbers of BoW tree match
-        if (keyfrm_itr->first == frm_itr->first) {
-            // If the node numbers of BoW tree match,
-            // Check in practice if matches exist between the frame and keyframe
-            const auto& keyfrm_indices = keyfrm_itr->second;
-            const auto& frm_indices = frm_itr->second;
-
-            for (const auto keyfrm_idx : keyfrm_indices) {
+    const auto keyfrm_descriptors = keyfrm->get_descriptors();
+    const descriptor_block keyfrm_descs(keyfrm_descriptors);
+    const descriptor_block frm_descs(frm.frm_obs_->descriptors_);
+
+    // Each keypoint belongs to one node only, so the nodes are matched independently
+    const flat_bow_feature_vector keyfrm_feat_vec(keyfrm->bow_feat_vec_);
+    const flat_bow_feature_vector frm_feat_vec(frm.bow_feat_vec_);
+    const auto shared_nodes = find_shared_nodes(keyfrm_feat_vec, frm_feat_vec);
+
+#ifdef USE_OPENMP
+#pragma omp parallel if (use_threads(shared_nodes.size()))
+#endif
+    {
+        // Descriptors of the frame in the node and the distances to them (reused for each node)
+        std::vector<uint8_t> frm_descs_in_node;
+        std::vector<unsigned int> dists;
+
+#ifdef USE_OPENMP
+#pragma omp for schedule(dynamic, 16) reduction(+ : num_matches)
+#endif
+        for (int64_t i = 0; i < static_cast<int64_t>(shared_nodes.size()); ++i) {
+            const auto keyfrm_pos = shared_nodes.at(i).first;
+            const auto frm_pos = shared_nodes.at(i).second;
+            const unsigned int* keyfrm_indices = keyfrm_feat_vec.indices_.data() + keyfrm_feat_vec.offsets_.at(keyfrm_pos);
+            const unsigned int num_keyfrm_indices = keyfrm_feat_vec.offsets_.at(keyfrm_pos + 1) - keyfrm_feat_vec.offsets_.at(keyfrm_pos);
+            const unsigned int* frm_indices = frm_feat_vec.indices_.data() + frm_feat_vec.offsets_.at(frm_pos);
+            const unsigned int num_frm_indices = frm_feat_vec.offsets_.at(frm_pos + 1) - frm_feat_vec.offsets_.at(frm_pos);
+
+            gather_descriptors(frm_descs, frm_indices, num_frm_indices, frm_descs_in_node);
+            dists.resize(num_frm_indices);
+
+            for (unsigned int k = 0; k < num_keyfrm_indices; ++k) {
+                const auto keyfrm_idx = keyfrm_indices[k];
                 // Ignore if the keypoint of keyframe is not associated any 3D points
                 auto& lm = keyfrm_lms.at(keyfrm_idx);
                 if (!lm) {
@@ -38,35 +124,35 @@ unsigned int bow_tree::match_frame_and_keyframe(const std::shared_ptr<data::keyf
                     continue;
                 }
 
-                const auto& keyfrm_desc = keyfrm->frm_obs_.descriptors_.row(keyfrm_idx);
-
-                unsigned int best_hamm_dist = MAX_HAMMING_DIST;
-                int best_frm_idx = -1;
-                unsigned int second_best_hamm_dist = MAX_HAMMING_DIST;
+                // Compute the distances to all the keypoints of the frame in the node at once
+                compute_hamming_distances_256(keyfrm_descs.at(keyfrm_idx), frm_descs_in_node.data(), 32, num_frm_indices, dists.data());
 
-                for (const auto frm_idx : frm_indices) {
+                best_two_result best_two;
+                for (unsigned int j = 0; j < num_frm_indices; ++j) {
+                    const auto frm_idx = frm_indices[j];
                     if (matched_lms_in_frm.at(frm_idx)) {
                         continue;
                     }
 
-                    if (check_orientation_ && std::abs(util::angle::diff(keyfrm->frm_obs_.undist_keypts_.at(keyfrm_idx).angle, frm.frm_obs_.undist_keypts_.at(frm_idx).angle)) > 30.0) {
+                    if (check_orientation_ && std::abs(util::angle::diff(keyfrm->frm_obs_->undist_keypts_.at(keyfrm_idx).angle, frm.frm_obs_->undist_keypts_.at(frm_idx).angle)) > 30.0) {
                         continue;
                     }
 
-                    const auto& frm_desc = frm.frm_obs_.descriptors_.row(frm_idx);
-
-                    const auto hamm_dist = compute_descriptor_distance_32(keyfrm_desc, frm_desc);
-
-                    if (hamm_dist < best_hamm_dist) {
-                        second_best_hamm_dist = best_hamm_dist;
-                        best_hamm_dist = hamm_dist;
-                        best_frm_idx = frm_idx;
+                    const auto dist = dists.at(j);
+                    if (dist < best_two.best_dist_) {
+                        best_two.second_best_dist_ = best_two.best_dist_;
+                        best_two.best_dist_ = dist;
+                        best_two.best_idx_ = static_cast<int>(frm_idx);
                     }
-                    else if (hamm_dist < second_best_hamm_dist) {
-                        second_best_hamm_dist = hamm_dist;
+                    else if (dist < best_two.second_best_dist_) {
+                        best_two.second_best_dist_ = dist;
                     }
                 }
 
+                const unsigned int best_hamm_dist = best_two.best_dist_;
+                const int best_frm_idx = best_two.best_idx_;
+                const unsigned int second_best_hamm_dist = best_two.second_best_dist_;
+
                 if (HAMMING_DIST_THR_LOW < best_hamm_dist) {
                     continue;
                 }
@@ -80,17 +166,6 @@ unsigned int bow_tree::match_frame_and_keyframe(const std::shared_ptr<data::keyf
 
                 ++num_matches;
             }
-
-            ++keyfrm_itr;
-            ++frm_itr;
-        }
-        else if (keyfrm_itr->first < frm_itr->first) {
-            // Since the node number of the keyframe is smaller, increment the iterator until the node numbers match
-            keyfrm_itr = keyfrm->bow_feat_vec_.lower_bound(frm_itr->first);
-        }
-        else {
-            // Since the node number of the frame is smaller, increment the iterator until the node numbers match
-            frm_itr = frm.bow_feat_vec_.lower_bound(keyfrm_itr->first);
         }
     }
 
@@ -102,27 +177,60 @@ unsigned int bow_tree::match_keyframes(const std::shared_ptr<data::keyframe>& ke
 
     const auto keyfrm_1_lms = keyfrm_1->get_landmarks();
     const auto keyfrm_2_lms = keyfrm_2->get_landmarks();
+    const auto keyfrm_1_descriptors = keyfrm_1->get_descriptors();
+    const auto keyfrm_2_descriptors = keyfrm_2->get_descriptors();
+    const descriptor_block keyfrm_1_descs(keyfrm_1_descriptors);
+    const descriptor_block keyfrm_2_descs(keyfrm_2_descriptors);
 
     matched_lms_in_keyfrm_1 = std::vector<std::shared_ptr<data::landmark>>(keyfrm_1_lms.size(), nullptr);
 
     // Set 'true' if a keypoint in keyframe 2 is associated to the keypoint in keyframe 1
     // NOTE: the size matches the number of the keypoints in keyframe 2
-    std::vector<bool> is_already_matched_in_keyfrm_2(keyfrm_2_lms.size(), false);
-
-    data::bow_feature_vector::const_iterator itr_1 = keyfrm_1->bow_feat_vec_.begin();
-    data::bow_feature_vector::const_iterator itr_2 = keyfrm_2->bow_feat_vec_.begin();
-    const data::bow_feature_vector::const_iterator itr_1_end = keyfrm_1->bow_feat_vec_.end();
-    const data::bow_feature_vector::const_iterator itr_2_end = keyfrm_2->bow_feat_vec_.end();
-
-    while (itr_1 != itr_1_end && itr_2 != itr_2_end) {
-        // Check if the node numbers of BoW tree match
-        if (itr_1->first == itr_2->first) {
-            // If the node numbers of BoW tree match,
-            // Check in practice if matches exist between keyframes
-            const auto& keyfrm_1_indices = itr_1->second;
-            const auto& keyfrm_2_indices = itr_2->second;
-
-            for (const auto idx_1 : keyfrm_1_indices) {
+    // (NOTE: not std::vector<bool>, since the nodes write the flags from the threads)
+    std::vector<unsigned char> is_already_matched_in_keyfrm_2(keyfrm_2_lms.size(), false);
+
+    // Each keypoint belongs to one node only, so the nodes are matched independently
+    const flat_bow_feature_vector feat_vec_1(keyfrm_1->bow_feat_vec_);
+    const flat_bow_feature_vector feat_vec_2(keyfrm_2->bow_feat_vec_);
+    const auto shared_nodes = find_shared_nodes(feat_vec_1, feat_vec_2);
+
+#ifdef USE_OPENMP
+#pragma omp parallel if (use_threads(shared_nodes.size()))
+#endif
+    {
+        // Keypoints of keyframe 2 in the node which are associated with 3D points, their descriptors and the distances to them
+        // (because this function is used for Sim3 estimation)
+        std::vector<unsigned int> candidate_indices_2;
+        std::vector<uint8_t> candidate_descs_2;
+        std::vector<unsigned int> dists;
+
+#ifdef USE_OPENMP
+#pragma omp for schedule(dynamic, 16) reduction(+ : num_matches)
+#endif
+        for (int64_t i = 0; i < static_cast<int64_t>(shared_nodes.size()); ++i) {
+            const auto pos_1 = shared_nodes.at(i).first;
+            const auto pos_2 = shared_nodes.at(i).second;
+
+            candidate_indices_2.clear();
+            for (unsigned int offset = feat_vec_2.offsets_.at(pos_2); offset < feat_vec_2.offsets_.at(pos_2 + 1); ++offset) {
+                const auto idx_2 = feat_vec_2.indices_.at(offset);
+                auto& lm_2 = keyfrm_2_lms.at(idx_2);
+                if (!lm_2) {
+                    continue;
+                }
+                if (lm_2->will_be_erased()) {
+                    continue;
+                }
+                candidate_indices_2.push_back(idx_2);
+            }
+            if (candidate_indices_2.empty()) {
+                continue;
+            }
+            gather_descriptors(keyfrm_2_descs, candidate_indices_2.data(), candidate_indices_2.size(), candidate_descs_2);
+            dists.resize(candidate_indices_2.size());
+
+            for (unsigned int offset = feat_vec_1.offsets_.at(pos_1); offset < feat_vec_1.offsets_.at(pos_1 + 1); ++offset) {
+                const auto idx_1 = feat_vec_1.indices_.at(offset);
                 // Ignore if the keypoint is not associated any 3D points
                 // (because this function is used for Sim3 estimation)
                 auto& lm_1 = keyfrm_1_lms.at(idx_1);
@@ -133,34 +241,24 @@ unsigned int bow_tree::match_keyframes(const std::shared_ptr<data::keyframe>& ke
                     continue;
                 }
 
-                const auto& desc_1 = keyfrm_1->frm_obs_.descriptors_.row(idx_1);
+                // Compute the distances to all the candidates in the node at once
+                compute_hamming_distances_256(keyfrm_1_descs.at(idx_1), candidate_descs_2.data(), 32, candidate_indices_2.size(), dists.data());
 
                 unsigned int best_hamm_dist = MAX_HAMMING_DIST;
                 int best_idx_2 = -1;
                 unsigned int second_best_hamm_dist = MAX_HAMMING_DIST;
 
-                for (const auto idx_2 : keyfrm_2_indices) {
-                    // Ignore if the keypoint is not associated any 3D points
-                    // (because this function is used for Sim3 estimation)
-                    auto& lm_2 = keyfrm_2_lms.at(idx_2);
-                    if (!lm_2) {
-                        continue;
-                    }
-                    if (lm_2->will_be_erased()) {
-                        continue;
-                    }
-
+                for (unsigned int j = 0; j < candidate_indices_2.size(); ++j) {
+                    const auto idx_2 = candidate_indices_2.at(j);
                     if (is_already_matched_in_keyfrm_2.at(idx_2)) {
                         continue;
                     }
 
-                    if (check_orientation_ && std::abs(util::angle::diff(keyfrm_1->frm_obs_.undist_keypts_.at(idx_1).angle, keyfrm_2->frm_obs_.undist_keypts_.at(idx_2).angle)) > 30.0) {
+                    if (check_orientation_ && std::abs(util::angle::diff(keyfrm_1->frm_obs_->undist_keypts_.at(idx_1).angle, keyfrm_2->frm_obs_->undist_keypts_.at(idx_2).angle)) > 30.0) {
                         continue;
                     }
 
-                    const auto& desc_2 = keyfrm_2->frm_obs_.descriptors_.row(idx_2);
-
-                    const auto hamm_dist = compute_descriptor_distance_32(desc_1, desc_2);
+                    const auto hamm_dist = dists.at(j);
 
                     if (hamm_dist < best_hamm_dist) {
                         second_best_hamm_dist = best_hamm_dist;
@@ -189,17 +287,6 @@ unsigned int bow_tree::match_keyframes(const std::shared_ptr<data::keyframe>& ke
 
                 num_matches++;
             }
-
-            ++itr_1;
-            ++itr_2;
-        }
-        else if (itr_1->first < itr_2->first) {
-            // Since the node number of keyframe 1 is smaller, increment the iterator until the node numbers match
-            itr_1 = keyfrm_1->bow_feat_vec_.lower_bound(itr_2->first);
-        }
-        else {
-            // Since the node number of keyframe 2 is smaller, increment the iterator until the node numbers match
-            itr_2 = keyfrm_2->bow_feat_vec_.lower_bound(itr_1->first);
         }
     }
 
@@ -2,8 +2,11 @@
 #define STELLA_VSLAM_MATCH_BOW_TREE_H
 
 #include "stella_vslam/match/base.h"
+#include "stella_vslam/data/bow_vocabulary_fwd.h"
 
 #include <memory>
+#include <utility>
+#include <vector>
 
 namespace stella_vslam {
 
@@ -15,6 +18,26 @@ class landmark;
 
 namespace match {
 
+/**
+ * Flattened BoW feature vector
+ * The node IDs are sorted and the feature indices of each node are stored contiguously,
+ * so the shared nodes of two feature vectors are found by a linear merge instead of the lookups of std::map.
+ */
+struct flat_bow_feature_vector {
+    explicit flat_bow_feature_vector(const data::bow_feature_vector& bow_feat_vec);
+
+    //! sorted node IDs
+    std::vector<unsigned int> node_ids_;
+    //! the indices of the i-th node are indices_[offsets_[i], offsets_[i + 1])
+    std::vector<unsigned int> offsets_;
+    //! feature indices of all the nodes
+    std::vector<unsigned int> indices_;
+};
+
+//! Find the pairs of the positions of the nodes shared by the two feature vectors
+std::vector<std::pair<unsigned int, unsigned int>> find_shared_nodes(const flat_bow_feature_vector& feat_vec_1,
+                                                                     const flat_bow_feature_vector& feat_vec_2);
+
 class bow_tree final : public base {
 public:
     explicit bow_tree(const float lowe_ratio = 0.6, const bool check_orientation = true)
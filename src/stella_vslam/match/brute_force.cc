@@ -0,0 +1,157 @@
+#include "stella_vslam/match/brute_force.h"
+#include "stella_vslam/match/device_matcher.h"
+#include "stella_vslam/util/angle.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+
+#ifdef USE_OPENMP
+#include <omp.h>
+#endif
+
+namespace stella_vslam {
+namespace match {
+
+namespace {
+
+//! Number of the queries compared with a tile of the candidates at once
+constexpr size_t query_tile_size = 32;
+//! Number of the candidates in a tile (8 KiB of the descriptors)
+constexpr size_t candidate_tile_size = 256;
+//! Minimum number of the pairs to use the threads
+constexpr size_t min_num_pairs_to_parallelize = 64 * 1024;
+
+//! Best query of a candidate (for the cross-check)
+struct best_query {
+    unsigned int dist_ = MAX_HAMMING_DIST + 1;
+    int pos_ = -1;
+};
+
+} // namespace
+
+std::vector<best_two_result> find_best_two_all_pairs(const descriptor_block& queries, const std::vector<unsigned int>& query_indices,
+                                                     const descriptor_block& candidates, const all_pairs_options& options) {
+    const size_t num_queries = query_indices.size();
+    const size_t num_candidates = candidates.size();
+    std::vector<best_two_result> results(num_queries);
+    if (num_queries == 0 || num_candidates == 0) {
+        return results;
+    }
+    if (find_best_two_all_pairs_on_device(queries, query_indices, candidates, options, results)) {
+        return results;
+    }
+
+    const bool check_orientation = options.query_keypts_ && options.candidate_keypts_;
+    const int64_t num_query_tiles = (num_queries + query_tile_size - 1) / query_tile_size;
+    const bool parallelize = min_num_pairs_to_parallelize <= num_queries * num_candidates && 1 < num_query_tiles;
+
+    // The best query of each candidate is kept per thread, and the buffers are merged after the search
+#ifdef USE_OPENMP
+    const unsigned int num_threads = parallelize ? omp_get_max_threads() : 1;
+#else
+    const unsigned int num_threads = 1;
+#endif
+    std::vector<std::vector<best_query>> best_queries(options.cross_check_ ? num_threads : 0);
+
+#ifdef USE_OPENMP
+#pragma omp parallel if (parallelize)
+#endif
+    {
+#ifdef USE_OPENMP
+        const unsigned int thread_idx = omp_get_thread_num();
+#else
+        const unsigned int thread_idx = 0;
+#endif
+        std::vector<best_query>* best_queries_of_thread = nullptr;
+        if (options.cross_check_) {
+            best_queries_of_thread = &best_queries.at(thread_idx);
+            best_queries_of_thread->resize(num_candidates);
+        }
+        unsigned int dists[candidate_tile_size];
+
+#ifdef USE_OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+        for (int64_t query_tile = 0; query_tile < num_query_tiles; ++query_tile) {
+            const size_t query_begin = query_tile * query_tile_size;
+            const size_t query_end = std::min(query_begin + query_tile_size, num_queries);
+
+            for (size_t candidate_begin = 0; candidate_begin < num_candidates; candidate_begin += candidate_tile_size) {
+                const size_t num_candidates_in_tile = std::min(candidate_tile_size, num_candidates - candidate_begin);
+
+                for (size_t pos = query_begin; pos < query_end; ++pos) {
+                    const auto query_idx = query_indices.at(pos);
+                    compute_hamming_distances_256(queries.at(query_idx), candidates.at(candidate_begin), candidates.stride(),
+                                                  num_candidates_in_tile, dists);
+
+                    auto& result = results.at(pos);
+                    for (size_t k = 0; k < num_candidates_in_tile; ++k) {
+                        const int candidate_idx = static_cast<int>(candidate_begin + k);
+                        if (check_orientation
+                            && options.max_angle_diff_ < std::abs(util::angle::diff(options.query_keypts_->at(query_idx).angle,
+                                                                                    options.candidate_keypts_->at(candidate_idx).angle))) {
+                            continue;
+                        }
+
+                        const auto dist = dists[k];
+                        if (dist < result.best_dist_) {
+                            result.second_best_dist_ = result.best_dist_;
+                            result.second_best_idx_ = result.best_idx_;
+                            result.best_dist_ = dist;
+                            result.best_idx_ = candidate_idx;
+                        }
+                        else if (dist < result.second_best_dist_) {
+                            result.second_best_dist_ = dist;
+                            result.second_best_idx_ = candidate_idx;
+                        }
+
+                        if (best_queries_of_thread) {
+                            // (the queries are visited in ascending order in each thread)
+                            auto& best = best_queries_of_thread->at(candidate_idx);
+                            if (dist < best.dist_) {
+                                best.dist_ = dist;
+                                best.pos_ = static_cast<int>(pos);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    if (!options.cross_check_) {
+        return results;
+    }
+
+    // Merge the best queries of the threads (ties keep the first query)
+    std::vector<best_query> merged_best_queries(num_candidates);
+    for (const auto& best_queries_of_thread : best_queries) {
+        if (best_queries_of_thread.empty()) {
+            continue;
+        }
+        for (size_t candidate_idx = 0; candidate_idx < num_candidates; ++candidate_idx) {
+            const auto& best = best_queries_of_thread.at(candidate_idx);
+            auto& merged = merged_best_queries.at(candidate_idx);
+            if (best.dist_ < merged.dist_ || (best.dist_ == merged.dist_ && 0 <= best.pos_ && best.pos_ < merged.pos_)) {
+                merged = best;
+            }
+        }
+    }
+
+    for (size_t pos = 0; pos < num_queries; ++pos) {
+        auto& result = results.at(pos);
+        if (result.best_idx_ < 0) {
+            continue;
+        }
+        if (merged_best_queries.at(result.best_idx_).pos_ != static_cast<int>(pos)) {
+            result.best_idx_ = -1;
+        }
+    }
+
+    return results;
+}
+
+} // namespace match
+} // namespace stella_vslam
@@ -0,0 +1,41 @@
+#ifndef STELLA_VSLAM_MATCH_BRUTE_FORCE_H
+#define STELLA_VSLAM_MATCH_BRUTE_FORCE_H
+
+#include "stella_vslam/match/descriptor_block.h"
+
+#include <vector>
+
+#include <opencv2/core/types.hpp>
+
+namespace stella_vslam {
+namespace match {
+
+//! Options of the all-pairs search
+struct all_pairs_options {
+    //! Keypoints of the queries and the candidates for the orientation check (nullptr disables the check)
+    const std::vector<cv::KeyPoint>* query_keypts_ = nullptr;
+    const std::vector<cv::KeyPoint>* candidate_keypts_ = nullptr;
+    //! Maximum difference of the keypoint angles [deg]
+    float max_angle_diff_ = 30.0;
+    //! Keep only the pairs which are the best of each other (best_idx_ = -1 otherwise)
+    bool cross_check_ = false;
+};
+
+/**
+ * Find the best and the second-best candidates of each query among all the candidates
+ * The queries and the candidates are compared tile by tile, so that a tile of the candidates stays in the L1 cache
+ * while a tile of the queries is compared with it, and the tiles of the queries are distributed to the threads.
+ * (NOTE: ties keep the first candidate, as in the per-pair loops of the matchers)
+ * @param queries
+ * @param query_indices indices of the queries to search (the results are in the same order)
+ * @param candidates
+ * @param options
+ * @return best/second-best distances and the indices of the candidates
+ */
+std::vector<best_two_result> find_best_two_all_pairs(const descriptor_block& queries, const std::vector<unsigned int>& query_indices,
+                                                     const descriptor_block& candidates, const all_pairs_options& options = all_pairs_options());
+
+} // namespace match
+} // namespace stella_vslam
+
+#endif // STELLA_VSLAM_MATCH_BRUTE_FORCE_H
@@ -0,0 +1,100 @@
+#ifndef STELLA_VSLAM_MATCH_DESCRIPTOR_BLOCK_H
+#define STELLA_VSLAM_MATCH_DESCRIPTOR_BLOCK_H
+
+#include "stella_vslam/match/base.h"
+#include "stella_vslam/match/hamming.h"
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <opencv2/core/mat.hpp>
+
+namespace stella_vslam {
+namespace match {
+
+/**
+ * Non-owning view of 32-byte ORB descriptors laid out in a contiguous block
+ * (NOTE: the referenced matrix must outlive the view)
+ */
+class descriptor_block {
+public:
+    descriptor_block() = default;
+
+    descriptor_block(const uint8_t* data, const size_t stride, const size_t num_descs)
+        : data_(data), stride_(stride), num_descs_(num_descs) {}
+
+    //! Create the view of all rows of the descriptor matrix (N x 32, CV_8U)
+    explicit descriptor_block(const cv::Mat& descs)
+        : data_(descs.empty() ? nullptr : descs.ptr<uint8_t>()),
+          stride_(descs.empty() ? 32 : descs.step[0]),
+          num_descs_(descs.empty() ? 0 : descs.rows) {
+        assert(descs.empty() || (descs.cols == 32 && descs.type() == CV_8U));
+    }
+
+    //! Get the pointer to the idx-th descriptor
+    const uint8_t* at(const size_t idx) const {
+        assert(idx < num_descs_);
+        return data_ + idx * stride_;
+    }
+
+    size_t size() const { return num_descs_; }
+
+    bool empty() const { return num_descs_ == 0; }
+
+    size_t stride() const { return stride_; }
+
+    const uint8_t* data() const { return data_; }
+
+private:
+    const uint8_t* data_ = nullptr;
+    size_t stride_ = 32;
+    size_t num_descs_ = 0;
+};
+
+//! Result of the best/second-best search
+struct best_two_result {
+    unsigned int best_dist_ = MAX_HAMMING_DIST;
+    int best_idx_ = -1;
+    unsigned int second_best_dist_ = MAX_HAMMING_DIST;
+    int second_best_idx_ = -1;
+};
+
+/**
+ * Find the best and the second-best candidates of the query descriptor among the indexed descriptors in the block
+ * (NOTE: ties keep the first candidate, as in the per-pair loops of the matchers)
+ * @param query 32-byte query descriptor
+ * @param block descriptor block
+ * @param indices indices of the candidates in the block
+ * @return best/second-best distances and the corresponding indices (-1 if not found)
+ */
+template<typename T>
+inline best_two_result best_two_in_block(const uint8_t* query, const descriptor_block& block, const std::vector<T>& indices) {
+    best_two_result result;
+    for (const auto idx : indices) {
+        // (the candidates are not contiguous, then each pair is computed inline)
+        const auto dist = compute_hamming_distance_256_inline(query, block.at(idx));
+        if (dist < result.best_dist_) {
+            result.second_best_dist_ = result.best_dist_;
+            result.second_best_idx_ = result.best_idx_;
+            result.best_dist_ = dist;
+            result.best_idx_ = static_cast<int>(idx);
+        }
+        else if (dist < result.second_best_dist_) {
+            result.second_best_dist_ = dist;
+            result.second_best_idx_ = static_cast<int>(idx);
+        }
+    }
+    return result;
+}
+
+template<typename T>
+inline best_two_result best_two_in_block(const cv::Mat& query, const descriptor_block& block, const std::vector<T>& indices) {
+    return best_two_in_block(query.ptr<uint8_t>(), block, indices);
+}
+
+} // namespace match
+} // namespace stella_vslam
+
+#endif // STELLA_VSLAM_MATCH_DESCRIPTOR_BLOCK_H
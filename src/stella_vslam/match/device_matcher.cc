@@ -0,0 +1,308 @@
+#include "stella_vslam/match/device_matcher.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+
+#include <spdlog/spdlog.h>
+
+#ifdef USE_OPENCL_MATCHER
+#include <opencv2/core/mat.hpp>
+#include <opencv2/core/ocl.hpp>
+#endif
+
+namespace stella_vslam {
+namespace match {
+
+namespace {
+
+std::atomic<bool> device_matching_is_enabled(false);
+
+#ifdef USE_OPENCL_MATCHER
+//! Minimum number of the pairs to be worth the transfers to the device
+constexpr size_t min_num_pairs_on_device = 16 * 1024;
+
+//! Kernels of the matching (each work-item handles a pair or a query, and the descriptors are read as 8 uints)
+const char* const matcher_kernel_source = R"(
+inline int hamming_distance_256(__global const uint* desc_1, __global const uint* desc_2) {
+    int dist = 0;
+    for (int k = 0; k < 8; ++k) {
+        dist += popcount(desc_1[k] ^ desc_2[k]);
+    }
+    return dist;
+}
+
+inline float angle_diff(const float angle_1, const float angle_2) {
+    float ret = angle_1 - angle_2;
+    if (ret <= -180.0f) {
+        ret += 360.0f;
+    }
+    if (ret > 180.0f) {
+        ret -= 360.0f;
+    }
+    return ret;
+}
+
+__kernel void hamming_distances_of_pairs(__global const uint* queries, __global const uint* candidates,
+                                         __global const int* pair_query_indices, __global const int* pair_candidate_indices,
+                                         __global int* dists, const int num_pairs) {
+    const int i = get_global_id(0);
+    if (num_pairs <= i) {
+        return;
+    }
+    dists[i] = hamming_distance_256(queries + 8 * pair_query_indices[i], candidates + 8 * pair_candidate_indices[i]);
+}
+
+__kernel void best_two_all_pairs(__global const uint* queries, __global const int* query_indices,
+                                 __global const float* query_angles, const int num_queries,
+                                 __global const uint* candidates, __global const int* candidate_indices,
+                                 __global const float* candidate_angles, const int num_candidates,
+                                 const float max_angle_diff, __global int* results) {
+    const int pos = get_global_id(0);
+    if (num_queries <= pos) {
+        return;
+    }
+    const int query_idx = query_indices[pos];
+    __global const uint* query = queries + 8 * query_idx;
+
+    int best_dist = 256;
+    int best_pos = -1;
+    int second_best_dist = 256;
+    int second_best_pos = -1;
+    for (int c = 0; c < num_candidates; ++c) {
+        const int candidate_idx = candidate_indices[c];
+        if (0.0f <= max_angle_diff && max_angle_diff < fabs(angle_diff(query_angles[query_idx], candidate_angles[candidate_idx]))) {
+            continue;
+        }
+        const int dist = hamming_distance_256(query, candidates + 8 * candidate_idx);
+        if (dist < best_dist) {
+            second_best_dist = best_dist;
+            second_best_pos = best_pos;
+            best_dist = dist;
+            best_pos = c;
+        }
+        else if (dist < second_best_dist) {
+            second_best_dist = dist;
+            second_best_pos = c;
+        }
+    }
+    results[4 * pos + 0] = best_dist;
+    results[4 * pos + 1] = best_pos;
+    results[4 * pos + 2] = second_best_dist;
+    results[4 * pos + 3] = second_best_pos;
+}
+)";
+
+const cv::ocl::ProgramSource& get_program_source() {
+    static const cv::ocl::ProgramSource source(matcher_kernel_source);
+    return source;
+}
+
+//! Disable the device matching after a failure, so that the matching falls back to the CPU
+void disable_after_failure(const char* kernel_name) {
+    if (device_matching_is_enabled.exchange(false)) {
+        spdlog::warn("device matching: failed to run the OpenCL kernel {}, fall back to CPU", kernel_name);
+    }
+}
+
+//! Upload the descriptors (contiguous 32-byte rows) to the device
+cv::UMat upload_descriptors(const descriptor_block& block) {
+    cv::UMat descs_umat;
+    const cv::Mat descs(block.size(), 32, CV_8U, const_cast<uint8_t*>(block.data()), block.stride());
+    descs.copyTo(descs_umat);
+    return descs_umat;
+}
+
+cv::UMat upload_indices(const std::vector<unsigned int>& indices) {
+    cv::UMat indices_umat;
+    const cv::Mat indices_mat(1, indices.size(), CV_32S, const_cast<unsigned int*>(indices.data()));
+    indices_mat.copyTo(indices_umat);
+    return indices_umat;
+}
+
+cv::UMat upload_angles(const std::vector<cv::KeyPoint>* keypts) {
+    cv::Mat angles(1, keypts ? std::max<size_t>(1, keypts->size()) : 1, CV_32F, cv::Scalar(0));
+    if (keypts) {
+        for (size_t idx = 0; idx < keypts->size(); ++idx) {
+            angles.at<float>(0, idx) = keypts->at(idx).angle;
+        }
+    }
+    cv::UMat angles_umat;
+    angles.copyTo(angles_umat);
+    return angles_umat;
+}
+
+//! Find the best two of each query on the device (the indices of the results are the positions in candidate_indices)
+bool run_best_two_all_pairs(const cv::UMat& queries, const cv::UMat& query_indices, const cv::UMat& query_angles, const int num_queries,
+                            const cv::UMat& candidates, const cv::UMat& candidate_indices, const cv::UMat& candidate_angles, const int num_candidates,
+                            const float max_angle_diff, std::vector<best_two_result>& results) {
+    cv::ocl::Kernel kernel("best_two_all_pairs", get_program_source());
+    if (kernel.empty()) {
+        return false;
+    }
+    cv::UMat results_umat(1, 4 * num_queries, CV_32S);
+    kernel.args(cv::ocl::KernelArg::PtrReadOnly(queries), cv::ocl::KernelArg::PtrReadOnly(query_indices),
+                cv::ocl::KernelArg::PtrReadOnly(query_angles), num_queries,
+                cv::ocl::KernelArg::PtrReadOnly(candidates), cv::ocl::KernelArg::PtrReadOnly(candidate_indices),
+                cv::ocl::KernelArg::PtrReadOnly(candidate_angles), num_candidates,
+                max_angle_diff, cv::ocl::KernelArg::PtrWriteOnly(results_umat));
+    size_t global_size = num_queries;
+    if (!kernel.run(1, &global_size, nullptr, true)) {
+        return false;
+    }
+
+    cv::Mat results_mat;
+    results_umat.copyTo(results_mat);
+    const int* values = results_mat.ptr<int>();
+    results.resize(num_queries);
+    for (int pos = 0; pos < num_queries; ++pos) {
+        auto& result = results.at(pos);
+        result.best_dist_ = values[4 * pos + 0];
+        result.best_idx_ = values[4 * pos + 1];
+        result.second_best_dist_ = values[4 * pos + 2];
+        result.second_best_idx_ = values[4 * pos + 3];
+    }
+    return true;
+}
+#endif
+
+} // namespace
+
+bool set_device_matching(const bool enabled) {
+    if (!enabled) {
+        device_matching_is_enabled = false;
+        return true;
+    }
+#ifdef USE_OPENCL_MATCHER
+    if (cv::ocl::haveOpenCL()) {
+        cv::ocl::setUseOpenCL(true);
+    }
+    if (!cv::ocl::useOpenCL()) {
+        spdlog::warn("device matching: OpenCL is not available, fall back to CPU");
+        return false;
+    }
+    // build the kernels in advance to check the device supports them
+    if (cv::ocl::Kernel("hamming_distances_of_pairs", get_program_source()).empty()) {
+        spdlog::warn("device matching: failed to build the OpenCL kernels, fall back to CPU");
+        return false;
+    }
+    spdlog::info("device matching: OpenCL device {} is used for the descriptor matching", cv::ocl::Device::getDefault().name());
+    device_matching_is_enabled = true;
+    return true;
+#else
+    spdlog::warn("device matching: ignored because stella_vslam is built without USE_OPENCL_MATCHER");
+    return false;
+#endif
+}
+
+bool get_device_matching() {
+    return device_matching_is_enabled;
+}
+
+void compute_hamming_distances_of_pairs(const descriptor_block& queries, const descriptor_block& candidates,
+                                        const std::vector<unsigned int>& pair_query_indices,
+                                        const std::vector<unsigned int>& pair_candidate_indices,
+                                        std::vector<unsigned int>& dists) {
+    assert(pair_query_indices.size() == pair_candidate_indices.size());
+    const size_t num_pairs = pair_query_indices.size();
+    dists.resize(num_pairs);
+    if (num_pairs == 0) {
+        return;
+    }
+
+#ifdef USE_OPENCL_MATCHER
+    if (device_matching_is_enabled && min_num_pairs_on_device <= num_pairs) {
+        cv::ocl::Kernel kernel("hamming_distances_of_pairs", get_program_source());
+        if (!kernel.empty()) {
+            const auto queries_umat = upload_descriptors(queries);
+            const auto candidates_umat = upload_descriptors(candidates);
+            const auto pair_query_indices_umat = upload_indices(pair_query_indices);
+            const auto pair_candidate_indices_umat = upload_indices(pair_candidate_indices);
+            cv::UMat dists_umat(1, num_pairs, CV_32S);
+            kernel.args(cv::ocl::KernelArg::PtrReadOnly(queries_umat), cv::ocl::KernelArg::PtrReadOnly(candidates_umat),
+                        cv::ocl::KernelArg::PtrReadOnly(pair_query_indices_umat), cv::ocl::KernelArg::PtrReadOnly(pair_candidate_indices_umat),
+                        cv::ocl::KernelArg::PtrWriteOnly(dists_umat), static_cast<int>(num_pairs));
+            size_t global_size = num_pairs;
+            if (kernel.run(1, &global_size, nullptr, true)) {
+                // (the distances are non-negative, so they are read as unsigned int)
+                cv::Mat dists_mat(1, num_pairs, CV_32S, dists.data());
+                dists_umat.copyTo(dists_mat);
+                return;
+            }
+        }
+        disable_after_failure("hamming_distances_of_pairs");
+    }
+#endif
+
+    for (size_t i = 0; i < num_pairs; ++i) {
+        dists[i] = compute_hamming_distance_256(queries.at(pair_query_indices[i]), candidates.at(pair_candidate_indices[i]));
+    }
+}
+
+bool find_best_two_all_pairs_on_device(const descriptor_block& queries, const std::vector<unsigned int>& query_indices,
+                                       const descriptor_block& candidates, const all_pairs_options& options,
+                                       std::vector<best_two_result>& results) {
+#ifdef USE_OPENCL_MATCHER
+    const size_t num_queries = query_indices.size();
+    const size_t num_candidates = candidates.size();
+    if (!device_matching_is_enabled || num_queries * num_candidates < min_num_pairs_on_device) {
+        return false;
+    }
+
+    const bool check_orientation = options.query_keypts_ && options.candidate_keypts_;
+    const float max_angle_diff = check_orientation ? options.max_angle_diff_ : -1.0f;
+
+    std::vector<unsigned int> candidate_indices(num_candidates);
+    for (size_t idx = 0; idx < num_candidates; ++idx) {
+        candidate_indices[idx] = idx;
+    }
+
+    const auto queries_umat = upload_descriptors(queries);
+    const auto candidates_umat = upload_descriptors(candidates);
+    const auto query_indices_umat = upload_indices(query_indices);
+    const auto candidate_indices_umat = upload_indices(candidate_indices);
+    const auto query_angles_umat = upload_angles(check_orientation ? options.query_keypts_ : nullptr);
+    const auto candidate_angles_umat = upload_angles(check_orientation ? options.candidate_keypts_ : nullptr);
+
+    // (the positions in candidate_indices are the indices of the candidates)
+    if (!run_best_two_all_pairs(queries_umat, query_indices_umat, query_angles_umat, num_queries,
+                                candidates_umat, candidate_indices_umat, candidate_angles_umat, num_candidates,
+                                max_angle_diff, results)) {
+        disable_after_failure("best_two_all_pairs");
+        return false;
+    }
+    if (!options.cross_check_) {
+        return true;
+    }
+
+    // Search the best query of each candidate in reverse for the cross-check
+    // (NOTE: the candidate keypoints are compared with the query keypoints, so the angle differences are only negated)
+    std::vector<best_two_result> best_queries;
+    if (!run_best_two_all_pairs(candidates_umat, candidate_indices_umat, candidate_angles_umat, num_candidates,
+                                queries_umat, query_indices_umat, query_angles_umat, num_queries,
+                                max_angle_diff, best_queries)) {
+        disable_after_failure("best_two_all_pairs");
+        return false;
+    }
+    for (size_t pos = 0; pos < num_queries; ++pos) {
+        auto& result = results.at(pos);
+        if (result.best_idx_ < 0) {
+            continue;
+        }
+        if (best_queries.at(result.best_idx_).best_idx_ != static_cast<int>(pos)) {
+            result.best_idx_ = -1;
+        }
+    }
+    return true;
+#else
+    (void)queries;
+    (void)query_indices;
+    (void)candidates;
+    (void)options;
+    (void)results;
+    return false;
+#endif
+}
+
+} // namespace match
+} // namespace stella_vslam
@@ -0,0 +1,45 @@
+#ifndef STELLA_VSLAM_MATCH_DEVICE_MATCHER_H
+#define STELLA_VSLAM_MATCH_DEVICE_MATCHER_H
+
+#include "stella_vslam/match/brute_force.h"
+#include "stella_vslam/match/descriptor_block.h"
+
+#include <vector>
+
+namespace stella_vslam {
+namespace match {
+
+//! Enable the descriptor matching on the OpenCL device (used by match::robust, match::projection and match::fuse)
+//! (NOTE: returns false if stella_vslam is built without USE_OPENCL_MATCHER or no OpenCL device is available)
+bool set_device_matching(const bool enabled);
+
+//! Check whether the descriptor matching on the OpenCL device is enabled or not
+bool get_device_matching();
+
+/**
+ * Compute the Hamming distances of the listed pairs of the queries and the candidates
+ * (on the OpenCL device if enabled and the batch is large enough, otherwise on the CPU)
+ * @param queries
+ * @param candidates
+ * @param pair_query_indices index of the query of each pair
+ * @param pair_candidate_indices index of the candidate of each pair
+ * @param dists output distances of the pairs
+ */
+void compute_hamming_distances_of_pairs(const descriptor_block& queries, const descriptor_block& candidates,
+                                        const std::vector<unsigned int>& pair_query_indices,
+                                        const std::vector<unsigned int>& pair_candidate_indices,
+                                        std::vector<unsigned int>& dists);
+
+/**
+ * Find the best and the second-best candidates of each query among all the candidates on the OpenCL device
+ * (see find_best_two_all_pairs())
+ * @return false if the device matching is disabled or failed, or the batch is too small to be worth the transfers
+ */
+bool find_best_two_all_pairs_on_device(const descriptor_block& queries, const std::vector<unsigned int>& query_indices,
+                                       const descriptor_block& candidates, const all_pairs_options& options,
+                                       std::vector<best_two_result>& results);
+
+} // namespace match
+} // namespace stella_vslam
+
+#endif // STELLA_VSLAM_MATCH_DEVICE_MATCHER_H
@@ -2,6 +2,9 @@
 #include "stella_vslam/camera/base.h"
 #include "stella_vslam/data/keyframe.h"
 #include "stella_vslam/data/landmark.h"
+#include "stella_vslam/match/descriptor_block.h"
+#include "stella_vslam/match/device_matcher.h"
+#include "stella_vslam/util/scratch_buffer.h"
 
 #include <vector>
 
@@ -19,10 +22,14 @@ unsigned int fuse::detect_duplication(const std::shared_ptr<data::keyframe>& key
                                       bool do_reprojection_matching) const {
     const Vec3_t trans_wc = -rot_cw.transpose() * trans_cw;
     unsigned int num_fused = 0;
-    std::unordered_set<unsigned int> already_matched_idx_in_keyfrm;
+    util::scratch_vector<bool> is_already_matched_in_keyfrm(keyfrm->frm_obs_->num_keypts_, false);
 
     duplicated_lms_in_keyfrm.clear();
 
+    const auto keyfrm_descs = keyfrm->get_descriptors();
+
+    util::scratch_vector<std::shared_ptr<data::landmark>> candidate_lms;
+    candidate_lms->reserve(landmarks_to_check.size());
     for (auto& lm : landmarks_to_check) {
         if (!lm) {
             continue;
@@ -33,20 +40,42 @@ unsigned int fuse::detect_duplication(const std::shared_ptr<data::keyframe>& key
         if (lm->is_observed_in_keyframe(keyfrm)) {
             continue;
         }
+        candidate_lms->push_back(lm);
+    }
 
-        // 3D point coordinates with the global reference
-        const Vec3_t pos_w = lm->get_pos_in_world();
-
-        // Reproject and compute visibility
-        Vec2_t reproj;
-        float x_right;
-        const bool in_image = keyfrm->camera_->reproject_to_image(rot_cw, trans_cw, pos_w, reproj, x_right);
-
+    // Reproject the 3D points at once and compute visibility
+    MatX3_t pos_ws(candidate_lms->size(), 3);
+    for (unsigned int i = 0; i < candidate_lms->size(); ++i) {
+        pos_ws.row(i) = candidate_lms->at(i)->get_pos_in_world().transpose();
+    }
+    MatX2_t reprojs;
+    VecX_t x_rights;
+    VecXb_t in_image;
+    keyfrm->camera_->reproject_points_to_image(rot_cw, trans_cw, pos_ws, reprojs, x_rights, in_image);
+
+    // 1. List the keypoints which passed the geometric checks as the candidates of each landmark
+    //    (the candidates of the i-th landmark are pair_*_indices[candidate_offsets[i], candidate_offsets[i + 1]))
+    //    (the buffers are reused across the calls on the thread)
+    util::scratch_vector<std::shared_ptr<data::landmark>> lms_to_match;
+    lms_to_match->reserve(candidate_lms->size());
+    util::scratch_vector<uint8_t> lm_descs;
+    lm_descs->reserve(candidate_lms->size() * 32);
+    util::scratch_vector<unsigned int> candidate_offsets(1, 0);
+    candidate_offsets->reserve(candidate_lms->size() + 1);
+    util::scratch_vector<unsigned int> pair_lm_indices;
+    util::scratch_vector<unsigned int> pair_keypt_indices;
+    util::scratch_vector<unsigned int> indices;
+    for (unsigned int i = 0; i < candidate_lms->size(); ++i) {
         // Ignore if it is reprojected outside the image
-        if (!in_image) {
+        if (!in_image(i)) {
             continue;
         }
 
+        const auto& lm = candidate_lms->at(i);
+        const Vec3_t pos_w = pos_ws.row(i).transpose();
+        const Vec2_t reproj = reprojs.row(i).transpose();
+        const float x_right = x_rights(i);
+
         // Check if it's within ORB scale levels
         const Vec3_t cam_to_lm_vec = pos_w - trans_wc;
         const auto cam_to_lm_dist = cam_to_lm_vec.norm();
@@ -69,23 +98,15 @@ unsigned int fuse::detect_duplication(const std::shared_ptr<data::keyframe>& key
 
         // Acquire keypoints in the cell where the reprojected 3D points exist
         const auto pred_scale_level = lm->predict_scale_level(cam_to_lm_dist, keyfrm->orb_params_->num_levels_, keyfrm->orb_params_->log_scale_factor_);
-        const auto indices = keyfrm->get_keypoints_in_cell(reproj(0), reproj(1), margin * keyfrm->orb_params_->scale_factors_.at(pred_scale_level));
+        keyfrm->get_keypoints_in_cell(reproj(0), reproj(1), margin * keyfrm->orb_params_->scale_factors_.at(pred_scale_level), -1, -1, *indices);
 
-        if (indices.empty()) {
+        if (indices->empty()) {
             continue;
         }
 
-        // Find a keypoint with the closest descriptor
-        const auto lm_desc = lm->get_descriptor();
-
-        unsigned int best_dist = MAX_HAMMING_DIST;
-        int best_idx = -1;
-
-        for (const auto idx : indices) {
-            if (already_matched_idx_in_keyfrm.count(idx)) {
-                continue;
-            }
-            const auto& undist_keypt = keyfrm->frm_obs_.undist_keypts_.at(idx);
+        const unsigned int lm_idx = lms_to_match->size();
+        for (const auto idx : *indices) {
+            const auto& undist_keypt = keyfrm->frm_obs_->undist_keypts_.at(idx);
 
             const auto scale_level = static_cast<unsigned int>(undist_keypt.octave);
 
@@ -95,11 +116,11 @@ unsigned int fuse::detect_duplication(const std::shared_ptr<data::keyframe>& key
             }
 
             if (do_reprojection_matching) {
-                if (!keyfrm->frm_obs_.stereo_x_right_.empty() && keyfrm->frm_obs_.stereo_x_right_.at(idx) >= 0) {
+                if (!keyfrm->frm_obs_->stereo_x_right_.empty() && keyfrm->frm_obs_->stereo_x_right_.at(idx) >= 0) {
                     // Compute reprojection error with 3 degrees of freedom if a stereo match exists
                     const auto e_x = reproj(0) - undist_keypt.pt.x;
                     const auto e_y = reproj(1) - undist_keypt.pt.y;
-                    const auto e_x_right = x_right - keyfrm->frm_obs_.stereo_x_right_.at(idx);
+                    const auto e_x_right = x_right - keyfrm->frm_obs_->stereo_x_right_.at(idx);
                     const auto reproj_error_sq = e_x * e_x + e_y * e_y + e_x_right * e_x_right;
 
                     // n=3
@@ -122,9 +143,36 @@ unsigned int fuse::detect_duplication(const std::shared_ptr<data::keyframe>& key
                 }
             }
 
-            const auto& desc = keyfrm->frm_obs_.descriptors_.row(idx);
+            pair_lm_indices->push_back(lm_idx);
+            pair_keypt_indices->push_back(idx);
+        }
+
+        lms_to_match->push_back(lm);
+        const auto lm_desc = lm->get_descriptor();
+        lm_descs->insert(lm_descs->end(), lm_desc.ptr<uint8_t>(), lm_desc.ptr<uint8_t>() + 32);
+        candidate_offsets->push_back(pair_keypt_indices->size());
+    }
+
+    // 2. Compute the distances of all the candidates at once (on the device if enabled)
+    util::scratch_vector<unsigned int> dists;
+    compute_hamming_distances_of_pairs(descriptor_block(lm_descs->data(), 32, lms_to_match->size()), descriptor_block(keyfrm_descs),
+                                       *pair_lm_indices, *pair_keypt_indices, *dists);
+
+    // 3. Find a keypoint with the closest descriptor in the order of the landmarks
+    //    (the keypoints matched to the earlier landmarks are excluded)
+    for (unsigned int lm_idx = 0; lm_idx < lms_to_match->size(); ++lm_idx) {
+        const auto& lm = lms_to_match->at(lm_idx);
+
+        unsigned int best_dist = MAX_HAMMING_DIST;
+        int best_idx = -1;
+
+        for (unsigned int k = candidate_offsets->at(lm_idx); k < candidate_offsets->at(lm_idx + 1); ++k) {
+            const auto idx = pair_keypt_indices->at(k);
+            if (is_already_matched_in_keyfrm->at(idx)) {
+                continue;
+            }
 
-            const auto hamm_dist = compute_descriptor_distance_32(lm_desc, desc);
+            const auto hamm_dist = dists->at(k);
 
             if (hamm_dist < best_dist) {
                 best_dist = hamm_dist;
@@ -136,7 +184,7 @@ unsigned int fuse::detect_duplication(const std::shared_ptr<data::keyframe>& key
             continue;
         }
 
-        already_matched_idx_in_keyfrm.insert(best_idx);
+        is_already_matched_in_keyfrm->at(best_idx) = true;
         auto lm_in_keyfrm = keyfrm->get_landmark(best_idx);
         if (lm_in_keyfrm) {
             // There is association between the 3D point and the keyframe
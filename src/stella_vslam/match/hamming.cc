@@ -0,0 +1,262 @@
+#include "stella_vslam/match/hamming.h"
+
+#include <atomic>
+#include <cstring>
+
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+#define STELLA_VSLAM_HAMMING_X86
+#include <immintrin.h>
+#if defined(__clang__) || __GNUC__ >= 8
+#define STELLA_VSLAM_HAMMING_AVX512
+#endif
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define STELLA_VSLAM_HAMMING_NEON
+#include <arm_neon.h>
+#endif
+
+namespace stella_vslam {
+namespace match {
+
+namespace {
+
+using distance_func_t = unsigned int (*)(const uint8_t*, const uint8_t*);
+using distances_func_t = void (*)(const uint8_t*, const uint8_t*, const size_t, const size_t, unsigned int*);
+
+struct hamming_kernel {
+    hamming_impl_t impl_;
+    distance_func_t distance_;
+    distances_func_t distances_;
+};
+
+inline uint64_t load_u64(const uint8_t* p) {
+    uint64_t v;
+    std::memcpy(&v, p, sizeof(uint64_t));
+    return v;
+}
+
+template<distance_func_t Distance>
+void distances_generic(const uint8_t* query, const uint8_t* candidates, const size_t stride,
+                       const size_t num_candidates, unsigned int* dists) {
+    for (size_t i = 0; i < num_candidates; ++i) {
+        dists[i] = Distance(query, candidates + i * stride);
+    }
+}
+
+unsigned int distance_scalar(const uint8_t* desc_1, const uint8_t* desc_2) {
+    // https://stackoverflow.com/questions/21826292/t-sql-hamming-distance-function-capable-of-decimal-string-uint64?lq=1
+
+    constexpr uint64_t mask_1 = 0x5555555555555555UL;
+    constexpr uint64_t mask_2 = 0x3333333333333333UL;
+    constexpr uint64_t mask_3 = 0x0F0F0F0F0F0F0F0FUL;
+    constexpr uint64_t mask_4 = 0x0101010101010101UL;
+
+    unsigned int dist = 0;
+
+    for (unsigned int i = 0; i < 4; ++i) {
+        auto v = load_u64(desc_1 + 8 * i) ^ load_u64(desc_2 + 8 * i);
+        v -= (v >> 1) & mask_1;
+        v = (v & mask_2) + ((v >> 2) & mask_2);
+        dist += (((v + (v >> 4)) & mask_3) * mask_4) >> 56;
+    }
+
+    return dist;
+}
+
+#ifdef STELLA_VSLAM_HAMMING_X86
+
+__attribute__((target("popcnt"))) unsigned int distance_popcnt(const uint8_t* desc_1, const uint8_t* desc_2) {
+    return __builtin_popcountll(load_u64(desc_1) ^ load_u64(desc_2))
+           + __builtin_popcountll(load_u64(desc_1 + 8) ^ load_u64(desc_2 + 8))
+           + __builtin_popcountll(load_u64(desc_1 + 16) ^ load_u64(desc_2 + 16))
+           + __builtin_popcountll(load_u64(desc_1 + 24) ^ load_u64(desc_2 + 24));
+}
+
+__attribute__((target("avx2"))) inline unsigned int popcount_avx2(const __m256i v) {
+    // nibble lookup table (Mula's algorithm)
+    const __m256i lut = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                         0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low_mask = _mm256_set1_epi8(0x0F);
+    const __m256i lo = _mm256_and_si256(v, low_mask);
+    const __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), low_mask);
+    const __m256i cnt = _mm256_add_epi8(_mm256_shuffle_epi8(lut, lo), _mm256_shuffle_epi8(lut, hi));
+    // the sums of the 8-byte groups are stored in the four 64-bit lanes
+    const __m256i sad = _mm256_sad_epu8(cnt, _mm256_setzero_si256());
+    const __m128i sum = _mm_add_epi64(_mm256_castsi256_si128(sad), _mm256_extracti128_si256(sad, 1));
+    return static_cast<unsigned int>(_mm_cvtsi128_si64(sum) + _mm_cvtsi128_si64(_mm_unpackhi_epi64(sum, sum)));
+}
+
+__attribute__((target("avx2"))) unsigned int distance_avx2(const uint8_t* desc_1, const uint8_t* desc_2) {
+    const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(desc_1));
+    const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(desc_2));
+    return popcount_avx2(_mm256_xor_si256(a, b));
+}
+
+__attribute__((target("avx2"))) void distances_avx2(const uint8_t* query, const uint8_t* candidates, const size_t stride,
+                                                    const size_t num_candidates, unsigned int* dists) {
+    const __m256i q = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(query));
+    for (size_t i = 0; i < num_candidates; ++i) {
+        const __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(candidates + i * stride));
+        dists[i] = popcount_avx2(_mm256_xor_si256(q, c));
+    }
+}
+
+#ifdef STELLA_VSLAM_HAMMING_AVX512
+
+__attribute__((target("avx2,avx512f,avx512vl,avx512vpopcntdq"))) unsigned int distance_avx512(const uint8_t* desc_1, const uint8_t* desc_2) {
+    const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(desc_1));
+    const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(desc_2));
+    const __m256i cnt = _mm256_popcnt_epi64(_mm256_xor_si256(a, b));
+    const __m128i sum = _mm_add_epi64(_mm256_castsi256_si128(cnt), _mm256_extracti128_si256(cnt, 1));
+    return static_cast<unsigned int>(_mm_cvtsi128_si64(sum) + _mm_cvtsi128_si64(_mm_unpackhi_epi64(sum, sum)));
+}
+
+__attribute__((target("avx2,avx512f,avx512vl,avx512vpopcntdq"))) void distances_avx512(const uint8_t* query, const uint8_t* candidates, const size_t stride,
+                                                                                       const size_t num_candidates, unsigned int* dists) {
+    // two candidates are compared at once
+    const __m512i q = _mm512_maskz_broadcast_i64x4(0xFF, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(query)));
+    alignas(64) uint64_t counts[8];
+
+    size_t i = 0;
+    for (; i + 1 < num_candidates; i += 2) {
+        const __m256i c_0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(candidates + i * stride));
+        const __m256i c_1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(candidates + (i + 1) * stride));
+        // lower half: c_0, upper half: c_1
+        const __m512i c = _mm512_mask_broadcast_i64x4(_mm512_maskz_broadcast_i64x4(0x0F, c_0), 0xF0, c_1);
+        _mm512_store_si512(reinterpret_cast<__m512i*>(counts), _mm512_popcnt_epi64(_mm512_xor_si512(q, c)));
+        dists[i] = static_cast<unsigned int>(counts[0] + counts[1] + counts[2] + counts[3]);
+        dists[i + 1] = static_cast<unsigned int>(counts[4] + counts[5] + counts[6] + counts[7]);
+    }
+    if (i < num_candidates) {
+        dists[i] = distance_avx512(query, candidates + i * stride);
+    }
+}
+
+#endif // STELLA_VSLAM_HAMMING_AVX512
+
+#endif // STELLA_VSLAM_HAMMING_X86
+
+#ifdef STELLA_VSLAM_HAMMING_NEON
+
+unsigned int distance_neon(const uint8_t* desc_1, const uint8_t* desc_2) {
+    const uint8x16_t v_0 = veorq_u8(vld1q_u8(desc_1), vld1q_u8(desc_2));
+    const uint8x16_t v_1 = veorq_u8(vld1q_u8(desc_1 + 16), vld1q_u8(desc_2 + 16));
+    // each byte holds at most 16, so 8-bit accumulation does not overflow
+    const uint8x16_t cnt = vaddq_u8(vcntq_u8(v_0), vcntq_u8(v_1));
+    const uint64x2_t sum = vpaddlq_u32(vpaddlq_u16(vpaddlq_u8(cnt)));
+    return static_cast<unsigned int>(vgetq_lane_u64(sum, 0) + vgetq_lane_u64(sum, 1));
+}
+
+#endif // STELLA_VSLAM_HAMMING_NEON
+
+const hamming_kernel scalar_kernel{hamming_impl_t::Scalar, &distance_scalar, &distances_generic<&distance_scalar>};
+#ifdef STELLA_VSLAM_HAMMING_X86
+const hamming_kernel popcnt_kernel{hamming_impl_t::Popcnt, &distance_popcnt, &distances_generic<&distance_popcnt>};
+const hamming_kernel avx2_kernel{hamming_impl_t::AVX2, &distance_avx2, &distances_avx2};
+#ifdef STELLA_VSLAM_HAMMING_AVX512
+const hamming_kernel avx512_kernel{hamming_impl_t::AVX512_VPOPCNTDQ, &distance_avx512, &distances_avx512};
+#endif
+#endif
+#ifdef STELLA_VSLAM_HAMMING_NEON
+const hamming_kernel neon_kernel{hamming_impl_t::NEON, &distance_neon, &distances_generic<&distance_neon>};
+#endif
+
+//! Return the kernel if it can run on this CPU, otherwise nullptr
+const hamming_kernel* find_supported_kernel(const hamming_impl_t impl) {
+#ifdef STELLA_VSLAM_HAMMING_X86
+    __builtin_cpu_init();
+#endif
+    switch (impl) {
+        case hamming_impl_t::Scalar:
+            return &scalar_kernel;
+        case hamming_impl_t::Popcnt:
+#ifdef STELLA_VSLAM_HAMMING_X86
+            if (__builtin_cpu_supports("popcnt")) {
+                return &popcnt_kernel;
+            }
+#endif
+            return nullptr;
+        case hamming_impl_t::AVX2:
+#ifdef STELLA_VSLAM_HAMMING_X86
+            if (__builtin_cpu_supports("avx2")) {
+                return &avx2_kernel;
+            }
+#endif
+            return nullptr;
+        case hamming_impl_t::AVX512_VPOPCNTDQ:
+#ifdef STELLA_VSLAM_HAMMING_AVX512
+            if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vl")
+                && __builtin_cpu_supports("avx512vpopcntdq")) {
+                return &avx512_kernel;
+            }
+#endif
+            return nullptr;
+        case hamming_impl_t::NEON:
+#ifdef STELLA_VSLAM_HAMMING_NEON
+            return &neon_kernel;
+#else
+            return nullptr;
+#endif
+    }
+    return nullptr;
+}
+
+const hamming_kernel* detect_kernel() {
+    // the fastest implementation comes first
+    for (const auto impl : {hamming_impl_t::AVX512_VPOPCNTDQ, hamming_impl_t::AVX2, hamming_impl_t::NEON, hamming_impl_t::Popcnt}) {
+        const auto kernel = find_supported_kernel(impl);
+        if (kernel) {
+            return kernel;
+        }
+    }
+    return &scalar_kernel;
+}
+
+std::atomic<const hamming_kernel*>& active_kernel() {
+    static std::atomic<const hamming_kernel*> kernel{detect_kernel()};
+    return kernel;
+}
+
+} // namespace
+
+std::string get_hamming_impl_name(const hamming_impl_t impl) {
+    switch (impl) {
+        case hamming_impl_t::Scalar:
+            return "scalar";
+        case hamming_impl_t::Popcnt:
+            return "POPCNT";
+        case hamming_impl_t::AVX2:
+            return "AVX2";
+        case hamming_impl_t::AVX512_VPOPCNTDQ:
+            return "AVX-512 VPOPCNTDQ";
+        case hamming_impl_t::NEON:
+            return "NEON";
+    }
+    return "unknown";
+}
+
+hamming_impl_t get_hamming_impl() {
+    return active_kernel().load(std::memory_order_relaxed)->impl_;
+}
+
+bool set_hamming_impl(const hamming_impl_t impl) {
+    const auto kernel = find_supported_kernel(impl);
+    if (!kernel) {
+        return false;
+    }
+    active_kernel().store(kernel, std::memory_order_relaxed);
+    return true;
+}
+
+unsigned int compute_hamming_distance_256(const uint8_t* desc_1, const uint8_t* desc_2) {
+    return active_kernel().load(std::memory_order_relaxed)->distance_(desc_1, desc_2);
+}
+
+void compute_hamming_distances_256(const uint8_t* query, const uint8_t* candidates, const size_t stride,
+                                   const size_t num_candidates, unsigned int* dists) {
+    active_kernel().load(std::memory_order_relaxed)->distances_(query, candidates, stride, num_candidates, dists);
+}
+
+} // namespace match
+} // namespace stella_vslam
@@ -0,0 +1,62 @@
+#ifndef STELLA_VSLAM_MATCH_HAMMING_H
+#define STELLA_VSLAM_MATCH_HAMMING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+namespace stella_vslam {
+namespace match {
+
+//! Implementations of the 256-bit Hamming distance kernel
+enum class hamming_impl_t {
+    Scalar,
+    Popcnt,
+    AVX2,
+    AVX512_VPOPCNTDQ,
+    NEON
+};
+
+//! Get the name of the kernel implementation
+std::string get_hamming_impl_name(const hamming_impl_t impl);
+
+//! Get the kernel implementation which was selected by CPU detection at startup
+hamming_impl_t get_hamming_impl();
+
+//! Select the kernel implementation explicitly (for testing and benchmarking)
+//! (NOTE: returns false if the implementation is not supported on this CPU)
+bool set_hamming_impl(const hamming_impl_t impl);
+
+//! Compute the Hamming distance between two 256-bit (32-byte) ORB descriptors
+unsigned int compute_hamming_distance_256(const uint8_t* desc_1, const uint8_t* desc_2);
+
+//! Compute the Hamming distance between two 256-bit (32-byte) ORB descriptors inline
+//! (NOTE: for a single pair in the per-pair loops, which avoids the load of the kernel and the indirect call per pair.
+//!  The distances to many candidates should be computed by compute_hamming_distances_256() instead.)
+inline unsigned int compute_hamming_distance_256_inline(const uint8_t* desc_1, const uint8_t* desc_2) {
+    uint64_t words_1[4];
+    uint64_t words_2[4];
+    std::memcpy(words_1, desc_1, sizeof(words_1));
+    std::memcpy(words_2, desc_2, sizeof(words_2));
+    return __builtin_popcountll(words_1[0] ^ words_2[0])
+           + __builtin_popcountll(words_1[1] ^ words_2[1])
+           + __builtin_popcountll(words_1[2] ^ words_2[2])
+           + __builtin_popcountll(words_1[3] ^ words_2[3]);
+}
+
+/**
+ * Compute the Hamming distances between one query descriptor and N candidate descriptors
+ * @param query 32-byte query descriptor
+ * @param candidates pointer to the first candidate descriptor
+ * @param stride byte offset between consecutive candidates (32 for a contiguous block)
+ * @param num_candidates number of candidates
+ * @param dists output distances (must have space for num_candidates values)
+ */
+void compute_hamming_distances_256(const uint8_t* query, const uint8_t* candidates, const size_t stride,
+                                   const size_t num_candidates, unsigned int* dists);
+
+} // namespace match
+} // namespace stella_vslam
+
+#endif // STELLA_VSLAM_MATCH_HAMMING_H
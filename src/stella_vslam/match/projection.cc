@@ -4,22 +4,158 @@
 #include "stella_vslam/data/frame_observation.h"
 #include "stella_vslam/data/keyframe.h"
 #include "stella_vslam/data/landmark.h"
+#include "stella_vslam/data/local_map_snapshot.h"
+#include "stella_vslam/match/descriptor_block.h"
+#include "stella_vslam/match/device_matcher.h"
 #include "stella_vslam/match/projection.h"
 #include "stella_vslam/util/angle.h"
+#include "stella_vslam/util/converter.h"
+#include "stella_vslam/util/frame_arena.h"
+#include "stella_vslam/util/prefetch.h"
+#include "stella_vslam/util/scratch_buffer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
 
 namespace stella_vslam {
 namespace match {
 
+namespace {
+//! Chi-squared value with significance level of 5% (two degree-of-freedom)
+constexpr double chi_sq_2D = 5.99146;
+
+//! Get the number of pixels per radian around the optical axis
+double compute_pixels_per_radian(const camera::base* camera) {
+    constexpr double delta = 1e-3;
+    const auto center = camera->convert_bearing_to_point(Vec3_t{0.0, 0.0, 1.0});
+    const auto shifted = camera->convert_bearing_to_point(Vec3_t{std::sin(delta), 0.0, std::cos(delta)});
+    return std::hypot(shifted.x - center.x, shifted.y - center.y) / delta;
+}
+
+/**
+ * Compute the radius of the search window of the landmark
+ * @param pose_cov covariance of the left perturbation [rotation, translation] of the camera pose
+ * @param pos_c position of the landmark in the camera
+ * @param pixels_per_rad
+ * @param scale_factor scale factor of the predicted octave
+ * @param num_obs number of the observations of the landmark
+ * @param max_radius upper bound of the radius
+ */
+float compute_search_radius(const Mat66_t& pose_cov, const Vec3_t& pos_c, const double pixels_per_rad,
+                            const float scale_factor, const unsigned int num_obs, const float max_radius) {
+    const double dist_sq = pos_c.squaredNorm();
+    if (dist_sq < 1e-12) {
+        return max_radius;
+    }
+
+    // covariance of the point in the camera caused by the pose uncertainty
+    MatRC_t<3, 6> jacobian;
+    jacobian.block<3, 3>(0, 0) = -util::converter::to_skew_symmetric_mat(pos_c);
+    jacobian.block<3, 3>(0, 3) = Mat33_t::Identity();
+    const Mat33_t cov_c = jacobian * pose_cov * jacobian.transpose();
+    // variance of the direction to the point [px^2] (the component along the bearing does not move the reprojection)
+    const Vec3_t bearing = pos_c / std::sqrt(dist_sq);
+    const Mat33_t perp = Mat33_t::Identity() - bearing * bearing.transpose();
+    const double pose_var = (perp * cov_c * perp).trace() / dist_sq * pixels_per_rad * pixels_per_rad;
+
+    // the position of the landmark is as uncertain as the keypoints at the octave,
+    // and more uncertain when it is triangulated from few observations
+    const double lm_var = scale_factor * scale_factor * (1.0 + 2.0 / std::max(1u, num_obs));
+
+    return std::min(max_radius, static_cast<float>(std::sqrt(chi_sq_2D * (pose_var + lm_var))));
+}
+
+/**
+ * Acquire the 2D-3D matches from the candidates in the order of the landmarks
+ * (the keypoints matched to the earlier landmarks are excluded)
+ * @param frm
+ * @param lms
+ * @param lm_indices indices of the landmarks to match in lms
+ * @param candidate_offsets the candidates of the lm_indices.at(i)-th landmark are pair_keypt_indices[candidate_offsets[i], candidate_offsets[i + 1])
+ * @param pair_keypt_indices
+ * @param dists Hamming distances of the candidates
+ * @param lowe_ratio
+ * @return number of the matches
+ */
+unsigned int add_best_matches(data::frame& frm, const std::vector<std::shared_ptr<data::landmark>>& lms,
+                              const util::arena_vector<unsigned int>& lm_indices,
+                              const util::arena_vector<unsigned int>& candidate_offsets,
+                              const std::vector<unsigned int>& pair_keypt_indices,
+                              const std::vector<unsigned int>& dists, const float lowe_ratio) {
+    unsigned int num_matches = 0;
+    for (unsigned int i = 0; i < lm_indices.size(); ++i) {
+        const auto& local_lm = lms.at(lm_indices.at(i));
+
+        best_two_result best_two;
+        for (unsigned int k = candidate_offsets.at(i); k < candidate_offsets.at(i + 1); ++k) {
+            const auto idx = pair_keypt_indices.at(k);
+            const auto& lm = frm.get_landmark(idx);
+            if (lm && lm->has_observation()) {
+                continue;
+            }
+
+            const auto dist = dists.at(k);
+            if (dist < best_two.best_dist_) {
+                best_two.second_best_dist_ = best_two.best_dist_;
+                best_two.second_best_idx_ = best_two.best_idx_;
+                best_two.best_dist_ = dist;
+                best_two.best_idx_ = static_cast<int>(idx);
+            }
+            else if (dist < best_two.second_best_dist_) {
+                best_two.second_best_dist_ = dist;
+                best_two.second_best_idx_ = static_cast<int>(idx);
+            }
+        }
+
+        const unsigned int best_hamm_dist = best_two.best_dist_;
+        const unsigned int second_best_hamm_dist = best_two.second_best_dist_;
+        const int best_idx = best_two.best_idx_;
+        const int best_scale_level = (0 <= best_two.best_idx_) ? frm.frm_obs_->undist_keypts_soa_.octave_.at(best_two.best_idx_) : -1;
+        const int second_best_scale_level = (0 <= best_two.second_best_idx_) ? frm.frm_obs_->undist_keypts_soa_.octave_.at(best_two.second_best_idx_) : -1;
+
+        if (best_hamm_dist <= HAMMING_DIST_THR_HIGH) {
+            // Lowe's ratio test
+            if (best_scale_level == second_best_scale_level && best_hamm_dist > lowe_ratio * second_best_hamm_dist) {
+                continue;
+            }
+
+            // Add the matching information
+            frm.add_landmark(local_lm, best_idx);
+            ++num_matches;
+        }
+    }
+    return num_matches;
+}
+} // namespace
+
 unsigned int projection::match_frame_and_landmarks(data::frame& frm,
                                                    const std::vector<std::shared_ptr<data::landmark>>& local_landmarks,
                                                    eigen_alloc_unord_map<unsigned int, Vec2_t>& lm_to_reproj,
                                                    std::unordered_map<unsigned int, float>& lm_to_x_right,
                                                    std::unordered_map<unsigned int, int>& lm_to_scale,
-                                                   const float margin) const {
-    unsigned int num_matches = 0;
-
-    // Reproject the 3D points to the frame, then acquire the 2D-3D matches
-    for (auto local_lm : local_landmarks) {
+                                                   const float margin,
+                                                   const Mat66_t* pose_cov) const {
+    const descriptor_block frm_descs(frm.frm_obs_->descriptors_);
+    const Mat33_t rot_cw = frm.get_rot_cw();
+    const Vec3_t trans_cw = frm.get_trans_cw();
+    const double pixels_per_rad = pose_cov ? compute_pixels_per_radian(frm.camera_) : 0.0;
+
+    // 1. Reproject the 3D points to the frame, then list the keypoints which passed the geometric checks as the candidates
+    //    (the candidates of the i-th landmark are pair_*_indices[candidate_offsets[i], candidate_offsets[i + 1]))
+    //    (the scratch buffers are taken from the frame arena on the tracking thread,
+    //     and the vectors passed to the other modules are reused across the calls)
+    util::arena_vector<unsigned int> lms_to_match;
+    lms_to_match.reserve(local_landmarks.size());
+    util::arena_vector<uint8_t> lm_descs;
+    lm_descs.reserve(local_landmarks.size() * 32);
+    util::arena_vector<unsigned int> candidate_offsets(1, 0);
+    candidate_offsets.reserve(local_landmarks.size() + 1);
+    util::scratch_vector<unsigned int> pair_lm_indices;
+    util::scratch_vector<unsigned int> pair_keypt_indices;
+    util::scratch_vector<unsigned int> indices_in_cell;
+    for (unsigned int local_lm_idx = 0; local_lm_idx < local_landmarks.size(); ++local_lm_idx) {
+        const auto& local_lm = local_landmarks.at(local_lm_idx);
         if (!lm_to_reproj.count(local_lm->id_)) {
             continue;
         }
@@ -29,69 +165,144 @@ unsigned int projection::match_frame_and_landmarks(data::frame& frm,
 
         const auto pred_scale_level = lm_to_scale.at(local_lm->id_);
 
+        const float scale_factor = frm.orb_params_->scale_factors_.at(pred_scale_level);
+        const float radius = pose_cov
+                                 ? compute_search_radius(*pose_cov, rot_cw * local_lm->get_pos_in_world() + trans_cw, pixels_per_rad,
+                                                         scale_factor, local_lm->num_observations(), margin * scale_factor)
+                                 : margin * scale_factor;
+
         // Acquire keypoints in the cell where the reprojected 3D points exist
         Vec2_t reproj = lm_to_reproj.at(local_lm->id_);
-        const auto indices_in_cell = frm.get_keypoints_in_cell(reproj(0), reproj(1),
-                                                               margin * frm.orb_params_->scale_factors_.at(pred_scale_level),
-                                                               pred_scale_level - 1, pred_scale_level);
-        if (indices_in_cell.empty()) {
+        frm.get_keypoints_in_cell(reproj(0), reproj(1), radius, pred_scale_level - 1, pred_scale_level, *indices_in_cell);
+        if (indices_in_cell->empty()) {
             continue;
         }
 
-        const cv::Mat lm_desc = local_lm->get_descriptor();
-
-        unsigned int best_hamm_dist = MAX_HAMMING_DIST;
-        int best_scale_level = -1;
-        unsigned int second_best_hamm_dist = MAX_HAMMING_DIST;
-        int second_best_scale_level = -1;
-        int best_idx = -1;
-
-        for (const auto idx : indices_in_cell) {
+        const unsigned int lm_idx = lms_to_match.size();
+        for (const auto idx : *indices_in_cell) {
             const auto& lm = frm.get_landmark(idx);
             if (lm && lm->has_observation()) {
                 continue;
             }
 
-            if (!frm.frm_obs_.stereo_x_right_.empty() && 0 < frm.frm_obs_.stereo_x_right_.at(idx)) {
-                const auto reproj_error = std::abs(lm_to_x_right.at(local_lm->id_) - frm.frm_obs_.stereo_x_right_.at(idx));
-                if (margin * frm.orb_params_->scale_factors_.at(pred_scale_level) < reproj_error) {
+            if (!frm.frm_obs_->stereo_x_right_.empty() && 0 < frm.frm_obs_->stereo_x_right_.at(idx)) {
+                const auto reproj_error = std::abs(lm_to_x_right.at(local_lm->id_) - frm.frm_obs_->stereo_x_right_.at(idx));
+                if (radius < reproj_error) {
                     continue;
                 }
             }
 
-            const cv::Mat& desc = frm.frm_obs_.descriptors_.row(idx);
+            pair_lm_indices->push_back(lm_idx);
+            pair_keypt_indices->push_back(idx);
+        }
 
-            const auto dist = compute_descriptor_distance_32(lm_desc, desc);
+        lms_to_match.push_back(local_lm_idx);
+        const cv::Mat lm_desc = local_lm->get_descriptor();
+        lm_descs.insert(lm_descs.end(), lm_desc.ptr<uint8_t>(), lm_desc.ptr<uint8_t>() + 32);
+        candidate_offsets.push_back(pair_keypt_indices->size());
+    }
 
-            if (dist < best_hamm_dist) {
-                second_best_hamm_dist = best_hamm_dist;
-                best_hamm_dist = dist;
-                second_best_scale_level = best_scale_level;
-                best_scale_level = frm.frm_obs_.undist_keypts_.at(idx).octave;
-                best_idx = idx;
-            }
-            else if (dist < second_best_hamm_dist) {
-                second_best_scale_level = frm.frm_obs_.undist_keypts_.at(idx).octave;
-                second_best_hamm_dist = dist;
-            }
+    // 2. Compute the distances of all the candidates at once (on the device if enabled)
+    util::scratch_vector<unsigned int> dists;
+    compute_hamming_distances_of_pairs(descriptor_block(lm_descs.data(), 32, lms_to_match.size()), frm_descs,
+                                       *pair_lm_indices, *pair_keypt_indices, *dists);
+
+    // 3. Acquire the 2D-3D matches in the order of the landmarks
+    return add_best_matches(frm, local_landmarks, lms_to_match, candidate_offsets, *pair_keypt_indices, *dists, lowe_ratio_);
+}
+
+unsigned int projection::match_frame_and_landmarks(data::frame& frm,
+                                                   const data::local_map_snapshot& local_map,
+                                                   const std::vector<bool>& is_candidate,
+                                                   const eigen_alloc_vector<Vec2_t>& reprojs,
+                                                   const std::vector<float>& x_rights,
+                                                   const std::vector<unsigned int>& pred_scale_levels,
+                                                   const float margin,
+                                                   const Mat66_t* pose_cov) const {
+    assert(is_candidate.size() == local_map.size());
+    const descriptor_block frm_descs(frm.frm_obs_->descriptors_);
+    const Mat33_t rot_cw = frm.get_rot_cw();
+    const Vec3_t trans_cw = frm.get_trans_cw();
+    const double pixels_per_rad = pose_cov ? compute_pixels_per_radian(frm.camera_) : 0.0;
+    const bool has_stereo = !frm.frm_obs_->stereo_x_right_.empty();
+
+    // the candidates are listed first, so that the entries of the later ones can be prefetched
+    util::arena_vector<unsigned int> candidate_lm_indices;
+    candidate_lm_indices.reserve(local_map.size());
+    for (unsigned int i = 0; i < local_map.size(); ++i) {
+        if (is_candidate.at(i)) {
+            candidate_lm_indices.push_back(i);
         }
+    }
+    const auto num_candidates = candidate_lm_indices.size();
+
+    // 1. List the keypoints around the reprojections which passed the geometric checks as the candidates
+    //    (the landmarks are read from the snapshot without locking, and the descriptors are referred in place)
+    util::arena_vector<unsigned int> lms_to_match;
+    lms_to_match.reserve(num_candidates);
+    util::arena_vector<unsigned int> candidate_offsets(1, 0);
+    candidate_offsets.reserve(num_candidates + 1);
+    util::scratch_vector<unsigned int> pair_lm_indices;
+    util::scratch_vector<unsigned int> pair_keypt_indices;
+    util::scratch_vector<unsigned int> indices_in_cell;
+    // (the entries are visited sparsely, which the hardware prefetcher does not predict)
+    constexpr unsigned int prefetch_distance = 8;
+    for (unsigned int k = 0; k < num_candidates; ++k) {
+        if (k + prefetch_distance < num_candidates) {
+            const auto next_idx = candidate_lm_indices[k + prefetch_distance];
+            util::prefetch(reprojs.data() + next_idx);
+            util::prefetch(pred_scale_levels.data() + next_idx);
+            util::prefetch(local_map.get_descriptor(next_idx));
+        }
+
+        const auto lm_idx = candidate_lm_indices[k];
+        const auto pred_scale_level = static_cast<int>(pred_scale_levels.at(lm_idx));
+
+        const float scale_factor = frm.orb_params_->scale_factors_.at(pred_scale_level);
+        const float radius = pose_cov
+                                 ? compute_search_radius(*pose_cov, rot_cw * local_map.pos_ws_.row(lm_idx).transpose().cast<double>() + trans_cw,
+                                                         pixels_per_rad, scale_factor, local_map.num_observations_.at(lm_idx), margin * scale_factor)
+                                 : margin * scale_factor;
 
-        if (best_hamm_dist <= HAMMING_DIST_THR_HIGH) {
-            // Lowe's ratio test
-            if (best_scale_level == second_best_scale_level && best_hamm_dist > lowe_ratio_ * second_best_hamm_dist) {
+        // Acquire keypoints in the cell where the reprojected 3D points exist
+        const Vec2_t& reproj = reprojs.at(lm_idx);
+        frm.get_keypoints_in_cell(reproj(0), reproj(1), radius, pred_scale_level - 1, pred_scale_level, *indices_in_cell);
+        if (indices_in_cell->empty()) {
+            continue;
+        }
+
+        for (const auto idx : *indices_in_cell) {
+            const auto& lm = frm.get_landmark(idx);
+            if (lm && lm->has_observation()) {
                 continue;
             }
 
-            // Add the matching information
-            frm.add_landmark(local_lm, best_idx);
-            ++num_matches;
+            if (has_stereo && 0 < frm.frm_obs_->stereo_x_right_.at(idx)) {
+                const auto reproj_error = std::abs(x_rights.at(lm_idx) - frm.frm_obs_->stereo_x_right_.at(idx));
+                if (radius < reproj_error) {
+                    continue;
+                }
+            }
+
+            pair_lm_indices->push_back(lm_idx);
+            pair_keypt_indices->push_back(idx);
         }
+
+        lms_to_match.push_back(lm_idx);
+        candidate_offsets.push_back(pair_keypt_indices->size());
     }
 
-    return num_matches;
+    // 2. Compute the distances of all the candidates at once (on the device if enabled)
+    util::scratch_vector<unsigned int> dists;
+    compute_hamming_distances_of_pairs(descriptor_block(local_map.descriptors_.data(), data::local_map_snapshot::descriptor_size, local_map.size()),
+                                       frm_descs, *pair_lm_indices, *pair_keypt_indices, *dists);
+
+    // 3. Acquire the 2D-3D matches in the order of the snapshot
+    return add_best_matches(frm, local_map.landmarks_, lms_to_match, candidate_offsets, *pair_keypt_indices, *dists, lowe_ratio_);
 }
 
-unsigned int projection::match_current_and_last_frames(data::frame& curr_frm, const data::frame& last_frm, const float margin) const {
+unsigned int projection::match_current_and_last_frames(data::frame& curr_frm, const data::frame& last_frm, const float margin,
+                                                       const Mat66_t* pose_cov) const {
     unsigned int num_matches = 0;
 
     const Mat33_t rot_cw = curr_frm.get_rot_cw();
@@ -114,9 +325,10 @@ unsigned int projection::match_current_and_last_frames(data::frame& curr_frm, co
                                      ? false
                                      : -trans_lc(2) > curr_frm.camera_->true_baseline_;
 
-    // Reproject the 3D points associated to the keypoints of the last frame,
-    // then acquire the 2D-3D matches
-    for (unsigned int idx_last = 0; idx_last < last_frm.frm_obs_.num_keypts_; ++idx_last) {
+    // Collect the 3D points associated to the keypoints of the last frame
+    util::scratch_vector<unsigned int> last_indices;
+    last_indices->reserve(last_frm.frm_obs_->num_keypts_);
+    for (unsigned int idx_last = 0; idx_last < last_frm.frm_obs_->num_keypts_; ++idx_last) {
         const auto& lm = last_frm.get_landmark(idx_last);
         if (!lm) {
             continue;
@@ -124,22 +336,36 @@ unsigned int projection::match_current_and_last_frames(data::frame& curr_frm, co
         if (lm->will_be_erased()) {
             continue;
         }
+        last_indices->push_back(idx_last);
+    }
 
-        // 3D point coordinates with the global reference
-        const Vec3_t pos_w = lm->get_pos_in_world();
-
-        // Reproject and compute visibility
-        Vec2_t reproj;
-        float x_right;
-        const bool in_image = curr_frm.camera_->reproject_to_image(rot_cw, trans_cw, pos_w, reproj, x_right);
-
+    // Reproject them at once and compute visibility
+    TrkMatX3_t pos_ws(last_indices->size(), 3);
+    for (unsigned int i = 0; i < last_indices->size(); ++i) {
+        pos_ws.row(i) = last_frm.get_landmark(last_indices->at(i))->get_pos_in_world().transpose().cast<tracking_real_t>();
+    }
+    TrkMatX2_t reprojs;
+    TrkVecX_t x_rights;
+    VecXb_t in_image;
+    curr_frm.camera_->reproject_points_to_image(rot_cw.cast<tracking_real_t>(), trans_cw.cast<tracking_real_t>(), pos_ws,
+                                                reprojs, x_rights, in_image);
+    const double pixels_per_rad = pose_cov ? compute_pixels_per_radian(curr_frm.camera_) : 0.0;
+
+    // Acquire the 2D-3D matches
+    util::scratch_vector<unsigned int> indices;
+    for (unsigned int i = 0; i < last_indices->size(); ++i) {
         // Ignore if it is reprojected outside the image
-        if (!in_image) {
+        if (!in_image(i)) {
             continue;
         }
 
+        const auto idx_last = last_indices->at(i);
+        const auto& lm = last_frm.get_landmark(idx_last);
+        const Vec2_t reproj = reprojs.row(i).transpose().cast<double>();
+        const float x_right = x_rights(i);
+
         // Acquire keypoints in the cell where the reprojected 3D points exist
-        const auto last_scale_level = last_frm.frm_obs_.undist_keypts_.at(idx_last).octave;
+        const auto last_scale_level = last_frm.frm_obs_->undist_keypts_soa_.octave_.at(idx_last);
         int min_level;
         int max_level;
         if (assume_forward) {
@@ -154,10 +380,13 @@ unsigned int projection::match_current_and_last_frames(data::frame& curr_frm, co
             min_level = last_scale_level - 1;
             max_level = last_scale_level + 1;
         }
-        auto indices = curr_frm.get_keypoints_in_cell(reproj(0), reproj(1),
-                                                      margin * curr_frm.orb_params_->scale_factors_.at(last_scale_level),
-                                                      min_level, max_level);
-        if (indices.empty()) {
+        const float scale_factor = curr_frm.orb_params_->scale_factors_.at(last_scale_level);
+        const float radius = pose_cov
+                                 ? compute_search_radius(*pose_cov, rot_cw * pos_ws.row(i).transpose().cast<double>() + trans_cw, pixels_per_rad,
+                                                         scale_factor, lm->num_observations(), margin * scale_factor)
+                                 : margin * scale_factor;
+        curr_frm.get_keypoints_in_cell(reproj(0), reproj(1), radius, min_level, max_level, *indices);
+        if (indices->empty()) {
             continue;
         }
 
@@ -166,24 +395,24 @@ unsigned int projection::match_current_and_last_frames(data::frame& curr_frm, co
         unsigned int best_hamm_dist = MAX_HAMMING_DIST;
         int best_idx = -1;
 
-        for (const auto curr_idx : indices) {
+        for (const auto curr_idx : *indices) {
             const auto& curr_lm = curr_frm.get_landmark(curr_idx);
             if (curr_lm && curr_lm->has_observation()) {
                 continue;
             }
 
-            if (!curr_frm.frm_obs_.stereo_x_right_.empty() && curr_frm.frm_obs_.stereo_x_right_.at(curr_idx) > 0) {
-                const float reproj_error = std::fabs(x_right - curr_frm.frm_obs_.stereo_x_right_.at(curr_idx));
-                if (margin * curr_frm.orb_params_->scale_factors_.at(last_scale_level) < reproj_error) {
+            if (!curr_frm.frm_obs_->stereo_x_right_.empty() && curr_frm.frm_obs_->stereo_x_right_.at(curr_idx) > 0) {
+                const float reproj_error = std::fabs(x_right - curr_frm.frm_obs_->stereo_x_right_.at(curr_idx));
+                if (radius < reproj_error) {
                     continue;
                 }
             }
 
-            if (check_orientation_ && std::abs(util::angle::diff(last_frm.frm_obs_.undist_keypts_.at(idx_last).angle, curr_frm.frm_obs_.undist_keypts_.at(curr_idx).angle)) > 30.0) {
+            if (check_orientation_ && std::abs(util::angle::diff(last_frm.frm_obs_->undist_keypts_soa_.angle_.at(idx_last), curr_frm.frm_obs_->undist_keypts_soa_.angle_.at(curr_idx))) > 30.0) {
                 continue;
             }
 
-            const auto& desc = curr_frm.frm_obs_.descriptors_.row(curr_idx);
+            const auto& desc = curr_frm.frm_obs_->descriptors_.row(curr_idx);
 
             const auto hamm_dist = compute_descriptor_distance_32(lm_desc, desc);
 
@@ -208,7 +437,8 @@ unsigned int projection::match_current_and_last_frames(data::frame& curr_frm, co
 unsigned int projection::match_frame_and_keyframe(data::frame& curr_frm, const std::shared_ptr<data::keyframe>& keyfrm, const std::set<std::shared_ptr<data::landmark>>& already_matched_lms,
                                                   const float margin, const unsigned int hamm_dist_thr) const {
     auto lms = curr_frm.get_landmarks();
-    auto num_matches = match_frame_and_keyframe(curr_frm.get_pose_cw(), curr_frm.camera_, curr_frm.frm_obs_, curr_frm.orb_params_, lms, keyfrm, already_matched_lms, margin, hamm_dist_thr);
+    auto num_matches = match_frame_and_keyframe(curr_frm.get_pose_cw(), curr_frm.camera_, *curr_frm.frm_obs_, curr_frm.frm_obs_->descriptors_, curr_frm.orb_params_,
+                                                lms, keyfrm, already_matched_lms, margin, hamm_dist_thr);
     curr_frm.set_landmarks(lms);
     return num_matches;
 }
@@ -216,6 +446,7 @@ unsigned int projection::match_frame_and_keyframe(data::frame& curr_frm, const s
 unsigned int projection::match_frame_and_keyframe(const Mat44_t& cam_pose_cw,
                                                   const camera::base* camera,
                                                   const data::frame_observation& frm_obs,
+                                                  const cv::Mat& descriptors,
                                                   const feature::orb_params* orb_params,
                                                   std::vector<std::shared_ptr<data::landmark>>& frm_landmarks,
                                                   const std::shared_ptr<data::keyframe>& keyfrm,
@@ -227,36 +458,47 @@ unsigned int projection::match_frame_and_keyframe(const Mat44_t& cam_pose_cw,
     const Vec3_t trans_cw = cam_pose_cw.block<3, 1>(0, 3);
     const Vec3_t cam_center = -rot_cw.transpose() * trans_cw;
 
-    const auto landmarks = keyfrm->get_landmarks();
-
-    // Reproject the 3D points associated to the keypoints of the keyframe,
-    // then acquire the 2D-3D matches
-    for (unsigned int idx = 0; idx < landmarks.size(); idx++) {
-        auto& lm = landmarks.at(idx);
+    // Collect the 3D points associated to the keypoints of the keyframe
+    // (the landmarks are visited without copying the whole association)
+    util::scratch_vector<std::pair<std::shared_ptr<data::landmark>, unsigned int>> lms_and_indices;
+    keyfrm->for_each_landmark([&](const std::shared_ptr<data::landmark>& lm, const unsigned int idx) {
         if (!lm) {
-            continue;
+            return;
         }
         if (lm->will_be_erased()) {
-            continue;
+            return;
         }
         // Avoid duplication
         if (already_matched_lms.count(lm)) {
-            continue;
+            return;
         }
+        lms_and_indices->emplace_back(lm, idx);
+    });
 
-        // 3D point coordinates with the global reference
-        const Vec3_t pos_w = lm->get_pos_in_world();
-
-        // Reproject and compute visibility
-        Vec2_t reproj;
-        float x_right;
-        const bool in_image = camera->reproject_to_image(rot_cw, trans_cw, pos_w, reproj, x_right);
-
+    // Reproject them at once and compute visibility
+    TrkMatX3_t pos_ws(lms_and_indices->size(), 3);
+    for (unsigned int i = 0; i < lms_and_indices->size(); ++i) {
+        pos_ws.row(i) = lms_and_indices->at(i).first->get_pos_in_world().transpose().cast<tracking_real_t>();
+    }
+    TrkMatX2_t reprojs;
+    TrkVecX_t x_rights;
+    VecXb_t in_image;
+    camera->reproject_points_to_image(rot_cw.cast<tracking_real_t>(), trans_cw.cast<tracking_real_t>(), pos_ws,
+                                      reprojs, x_rights, in_image);
+
+    // Acquire the 2D-3D matches
+    util::scratch_vector<unsigned int> indices;
+    for (unsigned int i = 0; i < lms_and_indices->size(); ++i) {
         // Ignore if it is reprojected outside the image
-        if (!in_image) {
+        if (!in_image(i)) {
             continue;
         }
 
+        const auto& lm = lms_and_indices->at(i).first;
+        const auto idx = lms_and_indices->at(i).second;
+        const Vec3_t pos_w = pos_ws.row(i).transpose().cast<double>();
+        const Vec2_t reproj = reprojs.row(i).transpose().cast<double>();
+
         // Check if it's within ORB scale levels
         const Vec3_t cam_to_lm_vec = pos_w - cam_center;
         const auto cam_to_lm_dist = cam_to_lm_vec.norm();
@@ -272,11 +514,11 @@ unsigned int projection::match_frame_and_keyframe(const Mat44_t& cam_pose_cw,
         // Acquire keypoints in the cell where the reprojected 3D points exist
         const auto pred_scale_level = lm->predict_scale_level(cam_to_lm_dist, orb_params->num_levels_, orb_params->log_scale_factor_);
 
-        const auto indices = data::get_keypoints_in_cell(camera, frm_obs, reproj(0), reproj(1),
-                                                         margin * orb_params->scale_factors_.at(pred_scale_level),
-                                                         pred_scale_level - 1, pred_scale_level + 1);
+        data::get_keypoints_in_cell(camera, frm_obs, reproj(0), reproj(1),
+                                    margin * orb_params->scale_factors_.at(pred_scale_level),
+                                    pred_scale_level - 1, pred_scale_level + 1, *indices);
 
-        if (indices.empty()) {
+        if (indices->empty()) {
             continue;
         }
 
@@ -285,16 +527,16 @@ unsigned int projection::match_frame_and_keyframe(const Mat44_t& cam_pose_cw,
         unsigned int best_hamm_dist = MAX_HAMMING_DIST;
         int best_idx = -1;
 
-        for (unsigned long curr_idx : indices) {
+        for (unsigned long curr_idx : *indices) {
             if (frm_landmarks.at(curr_idx)) {
                 continue;
             }
 
-            if (check_orientation_ && std::abs(util::angle::diff(keyfrm->frm_obs_.undist_keypts_.at(idx).angle, frm_obs.undist_keypts_.at(curr_idx).angle)) > 30.0) {
+            if (check_orientation_ && std::abs(util::angle::diff(keyfrm->frm_obs_->undist_keypts_soa_.angle_.at(idx), frm_obs.undist_keypts_soa_.angle_.at(curr_idx))) > 30.0) {
                 continue;
             }
 
-            const auto& desc = frm_obs.descriptors_.row(curr_idx);
+            const auto& desc = descriptors.row(curr_idx);
 
             const auto hamm_dist = compute_descriptor_distance_32(lm_desc, desc);
 
@@ -330,6 +572,10 @@ unsigned int projection::match_by_Sim3_transform(const std::shared_ptr<data::key
     std::set<std::shared_ptr<data::landmark>> already_matched(matched_lms_in_keyfrm.begin(), matched_lms_in_keyfrm.end());
     already_matched.erase(nullptr);
 
+    const auto keyfrm_descs = keyfrm->get_descriptors();
+
+    util::scratch_vector<std::shared_ptr<data::landmark>> candidate_lms;
+    candidate_lms->reserve(landmarks.size());
     for (const auto& lm : landmarks) {
         if (lm->will_be_erased()) {
             continue;
@@ -337,20 +583,30 @@ unsigned int projection::match_by_Sim3_transform(const std::shared_ptr<data::key
         if (already_matched.count(lm)) {
             continue;
         }
+        candidate_lms->push_back(lm);
+    }
 
-        // 3D point coordinates with the global reference
-        const Vec3_t pos_w = lm->get_pos_in_world();
-
-        // Reproject and compute visibility
-        Vec2_t reproj;
-        float x_right;
-        const bool in_image = keyfrm->camera_->reproject_to_image(rot_cw, trans_cw, pos_w, reproj, x_right);
+    // Reproject the 3D points at once and compute visibility
+    MatX3_t pos_ws(candidate_lms->size(), 3);
+    for (unsigned int i = 0; i < candidate_lms->size(); ++i) {
+        pos_ws.row(i) = candidate_lms->at(i)->get_pos_in_world().transpose();
+    }
+    MatX2_t reprojs;
+    VecX_t x_rights;
+    VecXb_t in_image;
+    keyfrm->camera_->reproject_points_to_image(rot_cw, trans_cw, pos_ws, reprojs, x_rights, in_image);
 
+    util::scratch_vector<unsigned int> indices;
+    for (unsigned int i = 0; i < candidate_lms->size(); ++i) {
         // Ignore if it is reprojected outside the image
-        if (!in_image) {
+        if (!in_image(i)) {
             continue;
         }
 
+        const auto& lm = candidate_lms->at(i);
+        const Vec3_t pos_w = pos_ws.row(i).transpose();
+        const Vec2_t reproj = reprojs.row(i).transpose();
+
         // Check if it's within ORB scale levels
         const Vec3_t cam_to_lm_vec = pos_w - cam_center;
         const auto cam_to_lm_dist = cam_to_lm_vec.norm();
@@ -373,9 +629,9 @@ unsigned int projection::match_by_Sim3_transform(const std::shared_ptr<data::key
 
         // Acquire keypoints in the cell where the reprojected 3D points exist
         const auto pred_scale_level = lm->predict_scale_level(cam_to_lm_dist, keyfrm->orb_params_->num_levels_, keyfrm->orb_params_->log_scale_factor_);
-        const auto indices = keyfrm->get_keypoints_in_cell(reproj(0), reproj(1), margin * keyfrm->orb_params_->scale_factors_.at(pred_scale_level));
+        keyfrm->get_keypoints_in_cell(reproj(0), reproj(1), margin * keyfrm->orb_params_->scale_factors_.at(pred_scale_level), -1, -1, *indices);
 
-        if (indices.empty()) {
+        if (indices->empty()) {
             continue;
         }
 
@@ -385,19 +641,19 @@ unsigned int projection::match_by_Sim3_transform(const std::shared_ptr<data::key
         unsigned int best_dist = MAX_HAMMING_DIST;
         int best_idx = -1;
 
-        for (const auto idx : indices) {
+        for (const auto idx : *indices) {
             if (matched_lms_in_keyfrm.at(idx)) {
                 continue;
             }
 
-            const auto scale_level = static_cast<unsigned int>(keyfrm->frm_obs_.undist_keypts_.at(idx).octave);
+            const auto scale_level = static_cast<unsigned int>(keyfrm->frm_obs_->undist_keypts_soa_.octave_.at(idx));
 
             // TODO: should determine the scale with 'keyfrm-> get_keypts_in_cell ()'
             if (scale_level < pred_scale_level - 1 || pred_scale_level < scale_level) {
                 continue;
             }
 
-            const auto& desc = keyfrm->frm_obs_.descriptors_.row(idx);
+            const auto& desc = keyfrm_descs.row(idx);
 
             const auto hamm_dist = compute_descriptor_distance_32(lm_desc, desc);
 
@@ -435,10 +691,12 @@ unsigned int projection::match_keyframes_mutually(const std::shared_ptr<data::ke
 
     const auto landmarks_1 = keyfrm_1->get_landmarks();
     const auto landmarks_2 = keyfrm_2->get_landmarks();
+    const auto descs_1 = keyfrm_1->get_descriptors();
+    const auto descs_2 = keyfrm_2->get_descriptors();
 
     // Contain matching information if there are already matches between the keyframes 1 and 2
-    std::vector<bool> is_already_matched_in_keyfrm_1(landmarks_1.size(), false);
-    std::vector<bool> is_already_matched_in_keyfrm_2(landmarks_2.size(), false);
+    util::scratch_vector<bool> is_already_matched_in_keyfrm_1(landmarks_1.size(), false);
+    util::scratch_vector<bool> is_already_matched_in_keyfrm_2(landmarks_2.size(), false);
 
     for (unsigned int idx_1 = 0; idx_1 < landmarks_1.size(); ++idx_1) {
         auto& lm = matched_lms_in_keyfrm_1.at(idx_1);
@@ -447,13 +705,14 @@ unsigned int projection::match_keyframes_mutually(const std::shared_ptr<data::ke
         }
         const auto idx_2 = lm->get_index_in_keyframe(keyfrm_2);
         if (0 <= idx_2 && idx_2 < static_cast<int>(landmarks_2.size())) {
-            is_already_matched_in_keyfrm_1.at(idx_1) = true;
-            is_already_matched_in_keyfrm_2.at(idx_2) = true;
+            is_already_matched_in_keyfrm_1->at(idx_1) = true;
+            is_already_matched_in_keyfrm_2->at(idx_2) = true;
         }
     }
 
-    std::vector<int> matched_indices_2_in_keyfrm_1(landmarks_1.size(), -1);
-    std::vector<int> matched_indices_1_in_keyfrm_2(landmarks_2.size(), -1);
+    util::scratch_vector<int> matched_indices_2_in_keyfrm_1(landmarks_1.size(), -1);
+    util::scratch_vector<int> matched_indices_1_in_keyfrm_2(landmarks_2.size(), -1);
+    util::scratch_vector<unsigned int> indices;
 
     // Compute the similarity transformation from the 3D points observed in keyframe 1 to keyframe 2 coordinates,
     // then project the result, and search keypoint matches
@@ -472,7 +731,7 @@ unsigned int projection::match_keyframes_mutually(const std::shared_ptr<data::ke
                 continue;
             }
 
-            if (is_already_matched_in_keyfrm_1.at(idx_1)) {
+            if (is_already_matched_in_keyfrm_1->at(idx_1)) {
                 continue;
             }
 
@@ -503,9 +762,9 @@ unsigned int projection::match_keyframes_mutually(const std::shared_ptr<data::ke
 
             // Acquire keypoints in the cell where the reprojected 3D points exist
             const auto pred_scale_level = lm->predict_scale_level(cam_to_lm_dist, keyfrm_2->orb_params_->num_levels_, keyfrm_2->orb_params_->log_scale_factor_);
-            const auto indices = keyfrm_2->get_keypoints_in_cell(reproj(0), reproj(1), margin * keyfrm_2->orb_params_->scale_factors_.at(pred_scale_level));
+            keyfrm_2->get_keypoints_in_cell(reproj(0), reproj(1), margin * keyfrm_2->orb_params_->scale_factors_.at(pred_scale_level), -1, -1, *indices);
 
-            if (indices.empty()) {
+            if (indices->empty()) {
                 continue;
             }
 
@@ -515,15 +774,15 @@ unsigned int projection::match_keyframes_mutually(const std::shared_ptr<data::ke
             unsigned int best_hamm_dist = MAX_HAMMING_DIST;
             int best_idx_2 = -1;
 
-            for (const auto idx_2 : indices) {
-                const auto scale_level = static_cast<unsigned int>(keyfrm_2->frm_obs_.undist_keypts_.at(idx_2).octave);
+            for (const auto idx_2 : *indices) {
+                const auto scale_level = static_cast<unsigned int>(keyfrm_2->frm_obs_->undist_keypts_soa_.octave_.at(idx_2));
 
                 // TODO: should determine the scale with 'keyfrm-> get_keypts_in_cell ()'
                 if (scale_level < pred_scale_level - 1 || pred_scale_level < scale_level) {
                     continue;
                 }
 
-                const auto& desc = keyfrm_2->frm_obs_.descriptors_.row(idx_2);
+                const auto& desc = descs_2.row(idx_2);
 
                 const auto hamm_dist = compute_descriptor_distance_32(lm_desc, desc);
 
@@ -534,7 +793,7 @@ unsigned int projection::match_keyframes_mutually(const std::shared_ptr<data::ke
             }
 
             if (best_hamm_dist <= HAMMING_DIST_THR_HIGH) {
-                matched_indices_2_in_keyfrm_1.at(idx_1) = best_idx_2;
+                matched_indices_2_in_keyfrm_1->at(idx_1) = best_idx_2;
             }
         }
     }
@@ -556,7 +815,7 @@ unsigned int projection::match_keyframes_mutually(const std::shared_ptr<data::ke
                 continue;
             }
 
-            if (is_already_matched_in_keyfrm_2.at(idx_2)) {
+            if (is_already_matched_in_keyfrm_2->at(idx_2)) {
                 continue;
             }
 
@@ -588,9 +847,9 @@ unsigned int projection::match_keyframes_mutually(const std::shared_ptr<data::ke
             // Acquire keypoints in the cell where the reprojected 3D points exist
             const auto pred_scale_level = lm->predict_scale_level(cam_to_lm_dist, keyfrm_1->orb_params_->num_levels_, keyfrm_1->orb_params_->log_scale_factor_);
 
-            const auto indices = keyfrm_1->get_keypoints_in_cell(reproj(0), reproj(1), margin * keyfrm_1->orb_params_->scale_factors_.at(pred_scale_level));
+            keyfrm_1->get_keypoints_in_cell(reproj(0), reproj(1), margin * keyfrm_1->orb_params_->scale_factors_.at(pred_scale_level), -1, -1, *indices);
 
-            if (indices.empty()) {
+            if (indices->empty()) {
                 continue;
             }
 
@@ -600,15 +859,15 @@ unsigned int projection::match_keyframes_mutually(const std::shared_ptr<data::ke
             unsigned int best_hamm_dist = MAX_HAMMING_DIST;
             int best_idx_1 = -1;
 
-            for (const auto idx_1 : indices) {
-                const auto scale_level = static_cast<unsigned int>(keyfrm_1->frm_obs_.undist_keypts_.at(idx_1).octave);
+            for (const auto idx_1 : *indices) {
+                const auto scale_level = static_cast<unsigned int>(keyfrm_1->frm_obs_->undist_keypts_soa_.octave_.at(idx_1));
 
                 // TODO: should determine the scale with 'keyfrm-> get_keypts_in_cell ()'
                 if (scale_level < pred_scale_level - 1 || pred_scale_level < scale_level) {
                     continue;
                 }
 
-                const auto& desc = keyfrm_1->frm_obs_.descriptors_.row(idx_1);
+                const auto& desc = descs_1.row(idx_1);
 
                 const auto hamm_dist = compute_descriptor_distance_32(lm_desc, desc);
 
@@ -619,7 +878,7 @@ unsigned int projection::match_keyframes_mutually(const std::shared_ptr<data::ke
             }
 
             if (best_hamm_dist <= HAMMING_DIST_THR_HIGH) {
-                matched_indices_1_in_keyfrm_2.at(idx_2) = best_idx_1;
+                matched_indices_1_in_keyfrm_2->at(idx_2) = best_idx_1;
             }
         }
     }
@@ -627,12 +886,12 @@ unsigned int projection::match_keyframes_mutually(const std::shared_ptr<data::ke
     // Record only the cross-matches
     unsigned int num_matches = 0;
     for (unsigned int i = 0; i < landmarks_1.size(); ++i) {
-        const auto idx_2 = matched_indices_2_in_keyfrm_1.at(i);
+        const auto idx_2 = matched_indices_2_in_keyfrm_1->at(i);
         if (idx_2 < 0) {
             continue;
         }
 
-        const auto idx_1 = matched_indices_1_in_keyfrm_2.at(idx_2);
+        const auto idx_1 = matched_indices_1_in_keyfrm_2->at(idx_2);
         if (idx_1 == static_cast<int>(i)) {
             matched_lms_in_keyfrm_1.at(idx_1) = landmarks_2.at(idx_2);
             ++num_matches;
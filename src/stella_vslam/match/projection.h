@@ -14,6 +14,7 @@ class frame;
 struct frame_observation;
 class keyframe;
 class landmark;
+struct local_map_snapshot;
 } // namespace data
 
 namespace match {
@@ -31,10 +32,28 @@ public:
                                            eigen_alloc_unord_map<unsigned int, Vec2_t>& lm_to_reproj,
                                            std::unordered_map<unsigned int, float>& lm_to_x_right,
                                            std::unordered_map<unsigned int, int>& lm_to_scale,
-                                           const float margin = 5.0) const;
+                                           const float margin = 5.0,
+                                           const Mat66_t* pose_cov = nullptr) const;
+
+    //! match_frame_and_landmarks() over the packed local map, which is traversed with the software prefetching
+    //! (the reprojections are the results of frame::can_observe() indexed as the snapshot,
+    //!  and the landmarks are matched in the order of the snapshot only if is_candidate is true)
+    unsigned int match_frame_and_landmarks(data::frame& frm,
+                                           const data::local_map_snapshot& local_map,
+                                           const std::vector<bool>& is_candidate,
+                                           const eigen_alloc_vector<Vec2_t>& reprojs,
+                                           const std::vector<float>& x_rights,
+                                           const std::vector<unsigned int>& pred_scale_levels,
+                                           const float margin = 5.0,
+                                           const Mat66_t* pose_cov = nullptr) const;
 
     //! last frameで観測している3次元点をcurrent frameに再投影し，frame.landmarks_に対応情報を記録する
-    unsigned int match_current_and_last_frames(data::frame& curr_frm, const data::frame& last_frm, const float margin) const;
+    unsigned int match_current_and_last_frames(data::frame& curr_frm, const data::frame& last_frm, const float margin,
+                                               const Mat66_t* pose_cov = nullptr) const;
+
+    // (NOTE: if pose_cov, the covariance of the left perturbation [rotation, translation] of the frame pose, is given,
+    //  the search window of each landmark is derived from the uncertainties of the pose and the landmark,
+    //  and the margin scaled by the octave is used as its upper bound)
 
     //! keyfarmeで観測している3次元点をcurrent frameに再投影し，frame.landmarks_に対応情報を記録する
     //! current frameとすでに対応が取れているものは，already_matched_lmsに指定して再投影しないようにする
@@ -43,6 +62,7 @@ public:
     unsigned int match_frame_and_keyframe(const Mat44_t& cam_pose_cw,
                                           const camera::base* camera,
                                           const data::frame_observation& frm_obs,
+                                          const cv::Mat& descriptors,
                                           const feature::orb_params* orb_params,
                                           std::vector<std::shared_ptr<data::landmark>>& frm_landmarks,
                                           const std::shared_ptr<data::keyframe>& keyfrm,
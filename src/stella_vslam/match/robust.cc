@@ -4,10 +4,13 @@
 #include "stella_vslam/data/frame_observation.h"
 #include "stella_vslam/data/keyframe.h"
 #include "stella_vslam/data/landmark.h"
+#include "stella_vslam/match/brute_force.h"
 #include "stella_vslam/match/robust.h"
 #include "stella_vslam/solve/essential_solver.h"
 #include "stella_vslam/util/angle.h"
 
+#include <cstring>
+
 namespace stella_vslam {
 namespace match {
 
@@ -26,13 +29,20 @@ unsigned int robust::match_for_triangulation(const std::shared_ptr<data::keyfram
     // Acquire the 3D point information of the keframes
     const auto assoc_lms_in_keyfrm_1 = keyfrm_1->get_landmarks();
     const auto assoc_lms_in_keyfrm_2 = keyfrm_2->get_landmarks();
+    const auto descs_1 = keyfrm_1->get_descriptors();
+    const auto descs_2 = keyfrm_2->get_descriptors();
 
     // Save the matching information
     // Discard the already matched keypoints in keyframe 2
     // to acquire a unique association to each keypoint in keyframe 1
-    std::vector<bool> is_already_matched_in_keyfrm_2(keyfrm_2->frm_obs_.num_keypts_, false);
+    std::vector<bool> is_already_matched_in_keyfrm_2(keyfrm_2->frm_obs_->num_keypts_, false);
     // Save the keypoint idx in keyframe 2 which is already associated to the keypoint idx in keyframe 1
-    std::vector<int> matched_indices_2_in_keyfrm_1(keyfrm_1->frm_obs_.num_keypts_, -1);
+    std::vector<int> matched_indices_2_in_keyfrm_1(keyfrm_1->frm_obs_->num_keypts_, -1);
+
+    // Buffers of the candidates in keyframe 2 at each node
+    std::vector<unsigned int> candidate_indices_2;
+    std::vector<uint8_t> candidate_descs_2;
+    std::vector<unsigned int> candidate_dists_2;
 
     data::bow_feature_vector::const_iterator itr_1 = keyfrm_1->bow_feat_vec_.begin();
     data::bow_feature_vector::const_iterator itr_2 = keyfrm_2->bow_feat_vec_.begin();
@@ -47,6 +57,26 @@ unsigned int robust::match_for_triangulation(const std::shared_ptr<data::keyfram
             const auto& keyfrm_1_indices = itr_1->second;
             const auto& keyfrm_2_indices = itr_2->second;
 
+            // Gather the keypoints in keyframe 2 which are not associated with any 3D points
+            // (because this function is used for triangulation),
+            // so that the distances from each keypoint in keyframe 1 are computed at once on the contiguous descriptors
+            candidate_indices_2.clear();
+            for (const auto idx_2 : keyfrm_2_indices) {
+                if (!assoc_lms_in_keyfrm_2.at(idx_2)) {
+                    candidate_indices_2.push_back(idx_2);
+                }
+            }
+            if (candidate_indices_2.empty()) {
+                ++itr_1;
+                ++itr_2;
+                continue;
+            }
+            candidate_descs_2.resize(candidate_indices_2.size() * 32);
+            for (unsigned int i = 0; i < candidate_indices_2.size(); ++i) {
+                std::memcpy(candidate_descs_2.data() + i * 32, descs_2.ptr<uint8_t>(candidate_indices_2.at(i)), 32);
+            }
+            candidate_dists_2.resize(candidate_indices_2.size());
+
             for (const auto idx_1 : keyfrm_1_indices) {
                 const auto& lm_1 = assoc_lms_in_keyfrm_1.at(idx_1);
                 // 3次元点が存在"する"場合はスルー(triangulation前のmatchingであるため)
@@ -55,47 +85,42 @@ unsigned int robust::match_for_triangulation(const std::shared_ptr<data::keyfram
                 }
 
                 // Check if it's a stereo keypoint or not
-                const bool is_stereo_keypt_1 = !keyfrm_1->frm_obs_.stereo_x_right_.empty() && 0 <= keyfrm_1->frm_obs_.stereo_x_right_.at(idx_1);
+                const bool is_stereo_keypt_1 = !keyfrm_1->frm_obs_->stereo_x_right_.empty() && 0 <= keyfrm_1->frm_obs_->stereo_x_right_.at(idx_1);
 
                 // Acquire the keypoints and ORB feature vectors
-                const auto& keypt_1 = keyfrm_1->frm_obs_.undist_keypts_.at(idx_1);
-                const Vec3_t& bearing_1 = keyfrm_1->frm_obs_.bearings_.at(idx_1);
-                const auto& desc_1 = keyfrm_1->frm_obs_.descriptors_.row(idx_1);
+                const auto& keypt_1 = keyfrm_1->frm_obs_->undist_keypts_.at(idx_1);
+                const Vec3_t& bearing_1 = keyfrm_1->frm_obs_->bearings_.at(idx_1);
+
+                // Compute the distances to all the candidates
+                compute_hamming_distances_256(descs_1.ptr<uint8_t>(idx_1), candidate_descs_2.data(), 32,
+                                              candidate_indices_2.size(), candidate_dists_2.data());
 
                 // Find a keypoint in keyframe 2 that has the minimum hamming distance
                 unsigned int best_hamm_dist = HAMMING_DIST_THR_LOW;
                 int best_idx_2 = -1;
 
-                for (const auto idx_2 : keyfrm_2_indices) {
-                    // Ignore if the keypoint is associated any 3D points
-                    // (because this function is used for triangulation)
-                    const auto& lm_2 = assoc_lms_in_keyfrm_2.at(idx_2);
-                    if (lm_2) {
+                for (unsigned int i = 0; i < candidate_indices_2.size(); ++i) {
+                    const auto hamm_dist = candidate_dists_2.at(i);
+                    if (HAMMING_DIST_THR_LOW < hamm_dist || best_hamm_dist < hamm_dist) {
                         continue;
                     }
 
+                    const auto idx_2 = candidate_indices_2.at(i);
+
                     // Ignore if matches are already aquired
                     if (is_already_matched_in_keyfrm_2.at(idx_2)) {
                         continue;
                     }
 
-                    if (check_orientation_ && std::abs(util::angle::diff(keypt_1.angle, keyfrm_2->frm_obs_.undist_keypts_.at(idx_2).angle)) > 30.0) {
+                    if (check_orientation_ && std::abs(util::angle::diff(keypt_1.angle, keyfrm_2->frm_obs_->undist_keypts_.at(idx_2).angle)) > 30.0) {
                         continue;
                     }
 
                     // Check if it's a stereo keypoint or not
-                    const bool is_stereo_keypt_2 = !keyfrm_2->frm_obs_.stereo_x_right_.empty() && 0 <= keyfrm_2->frm_obs_.stereo_x_right_.at(idx_2);
-
-                    // Acquire the keypoints and ORB feature vectors
-                    const Vec3_t& bearing_2 = keyfrm_2->frm_obs_.bearings_.at(idx_2);
-                    const auto& desc_2 = keyfrm_2->frm_obs_.descriptors_.row(idx_2);
+                    const bool is_stereo_keypt_2 = !keyfrm_2->frm_obs_->stereo_x_right_.empty() && 0 <= keyfrm_2->frm_obs_->stereo_x_right_.at(idx_2);
 
-                    // Compute the distance
-                    const auto hamm_dist = compute_descriptor_distance_32(desc_1, desc_2);
-
-                    if (HAMMING_DIST_THR_LOW < hamm_dist || best_hamm_dist < hamm_dist) {
-                        continue;
-                    }
+                    // Acquire the keypoints
+                    const Vec3_t& bearing_2 = keyfrm_2->frm_obs_->bearings_.at(idx_2);
 
                     if (valid_epiplane && !is_stereo_keypt_1 && !is_stereo_keypt_2) {
                         // Do not use any keypoints near the epipole if both are not stereo keypoints
@@ -157,18 +182,20 @@ unsigned int robust::match_keyframes(const std::shared_ptr<data::keyframe>& keyf
                                      std::vector<std::shared_ptr<data::landmark>>& matched_lms_in_frm,
                                      bool validate_with_essential_solver, bool use_fixed_seed) const {
     // Initialization
-    const auto num_frm_keypts = keyfrm1->frm_obs_.num_keypts_;
+    const auto num_frm_keypts = keyfrm1->frm_obs_->num_keypts_;
     const auto keyfrm_lms = keyfrm2->get_landmarks();
     unsigned int num_inlier_matches = 0;
     matched_lms_in_frm = std::vector<std::shared_ptr<data::landmark>>(num_frm_keypts, nullptr);
 
     // Compute brute-force match
+    const auto descriptors_1 = keyfrm1->get_descriptors();
     std::vector<std::pair<int, int>> matches;
-    brute_force_match(keyfrm1->frm_obs_, keyfrm2, matches);
+    brute_force_match(*keyfrm1->frm_obs_, descriptors_1, keyfrm2, matches);
 
     // Extract only inliers with eight-point RANSAC
     if (validate_with_essential_solver) {
-        solve::essential_solver solver(keyfrm1->frm_obs_.bearings_, keyfrm2->frm_obs_.bearings_, matches, use_fixed_seed);
+        solve::essential_solver solver(keyfrm1->frm_obs_->bearings_, keyfrm2->frm_obs_->bearings_, matches, use_fixed_seed);
+        solver.set_descriptor_distances(compute_descriptor_distances(descriptors_1, keyfrm2->get_descriptors(), matches));
         solver.find_via_ransac(50, false);
         if (!solver.solution_is_valid()) {
             return 0;
@@ -205,17 +232,18 @@ unsigned int robust::match_frame_and_keyframe(data::frame& frm, const std::share
                                               std::vector<std::shared_ptr<data::landmark>>& matched_lms_in_frm,
                                               bool use_fixed_seed) const {
     // Initialization
-    const auto num_frm_keypts = frm.frm_obs_.num_keypts_;
+    const auto num_frm_keypts = frm.frm_obs_->num_keypts_;
     const auto keyfrm_lms = keyfrm->get_landmarks();
     unsigned int num_inlier_matches = 0;
     matched_lms_in_frm = std::vector<std::shared_ptr<data::landmark>>(num_frm_keypts, nullptr);
 
     // Compute brute-force match
     std::vector<std::pair<int, int>> matches;
-    brute_force_match(frm.frm_obs_, keyfrm, matches);
+    brute_force_match(*frm.frm_obs_, frm.frm_obs_->descriptors_, keyfrm, matches);
 
     // Extract only inliers with eight-point RANSAC
-    solve::essential_solver solver(frm.frm_obs_.bearings_, keyfrm->frm_obs_.bearings_, matches, use_fixed_seed);
+    solve::essential_solver solver(frm.frm_obs_->bearings_, keyfrm->frm_obs_->bearings_, matches, use_fixed_seed);
+    solver.set_descriptor_distances(compute_descriptor_distances(frm.frm_obs_->descriptors_, keyfrm->get_descriptors(), matches));
     solver.find_via_ransac(50, false);
     if (!solver.solution_is_valid()) {
         return 0;
@@ -237,29 +265,28 @@ unsigned int robust::match_frame_and_keyframe(data::frame& frm, const std::share
     return num_inlier_matches;
 }
 
-unsigned int robust::brute_force_match(const data::frame_observation& frm_obs, const std::shared_ptr<data::keyframe>& keyfrm, std::vector<std::pair<int, int>>& matches) const {
+unsigned int robust::brute_force_match(const data::frame_observation& frm_obs, const cv::Mat& descriptors,
+                                       const std::shared_ptr<data::keyframe>& keyfrm, std::vector<std::pair<int, int>>& matches,
+                                       const bool cross_check) const {
     unsigned int num_matches = 0;
 
     // 1. Acquire the frame and keyframe information
 
     const auto num_keypts_1 = frm_obs.num_keypts_;
-    const auto num_keypts_2 = keyfrm->frm_obs_.num_keypts_;
-    const auto keypts_1 = frm_obs.undist_keypts_;
-    const auto keypts_2 = keyfrm->frm_obs_.undist_keypts_;
+    const auto num_keypts_2 = keyfrm->frm_obs_->num_keypts_;
+    const auto& keypts_1 = frm_obs.undist_keypts_;
+    const auto& keypts_2 = keyfrm->frm_obs_->undist_keypts_;
     const auto lms_2 = keyfrm->get_landmarks();
-    const auto& descs_1 = frm_obs.descriptors_;
-    const auto& descs_2 = keyfrm->frm_obs_.descriptors_;
+    const auto& descs_1 = descriptors;
+    const auto descs_2 = keyfrm->get_descriptors();
 
     // 2. Acquire ORB descriptors in the keyframe which are the first and second closest to the descriptors in the frame
     //    it is assumed that keypoint in the keyframe are associated to 3D points
 
-    // Index 2 associated to each index 1
-    auto matched_indices_2_in_1 = std::vector<int>(num_keypts_1, -1);
-    // Avoid duplication
-    std::unordered_set<int> already_matched_indices_1;
-
+    // 3次元点が有効なもののみ対象にする
+    std::vector<unsigned int> indices_2;
+    indices_2.reserve(num_keypts_2);
     for (unsigned int idx_2 = 0; idx_2 < num_keypts_2; ++idx_2) {
-        // 3次元点が有効なもののみ対象にする
         const auto& lm_2 = lms_2.at(idx_2);
         if (!lm_2) {
             continue;
@@ -267,39 +294,59 @@ unsigned int robust::brute_force_match(const data::frame_observation& frm_obs, c
         if (lm_2->will_be_erased()) {
             continue;
         }
+        indices_2.push_back(idx_2);
+    }
 
-        // Acquire the descriptor for index 2
-        const auto& desc_2 = descs_2.row(idx_2);
-
-        // Acquire the descriptors in the frame which are the first and second closest to the descriptor in the keyframe
-        unsigned int best_hamm_dist = MAX_HAMMING_DIST;
-        int best_idx_1 = -1;
-        unsigned int second_best_hamm_dist = MAX_HAMMING_DIST;
-
-        for (unsigned int idx_1 = 0; idx_1 < num_keypts_1; ++idx_1) {
-            // Avoid duplication
-            if (static_cast<bool>(already_matched_indices_1.count(idx_1))) {
-                continue;
-            }
-
-            if (check_orientation_ && std::abs(util::angle::diff(keypts_1.at(idx_1).angle, keypts_2.at(idx_2).angle)) > 30.0) {
-                continue;
-            }
-
-            const auto& desc_1 = descs_1.row(idx_1);
-
-            const auto hamm_dist = compute_descriptor_distance_32(desc_2, desc_1);
+    // Search the best two for all the pairs at once
+    const descriptor_block block_1(descs_1);
+    const descriptor_block block_2(descs_2);
+    all_pairs_options options;
+    if (check_orientation_) {
+        options.query_keypts_ = &keypts_2;
+        options.candidate_keypts_ = &keypts_1;
+    }
+    options.cross_check_ = cross_check;
+    auto best_twos = find_best_two_all_pairs(block_2, indices_2, block_1, options);
 
-            if (hamm_dist < best_hamm_dist) {
-                second_best_hamm_dist = best_hamm_dist;
-                best_hamm_dist = hamm_dist;
-                best_idx_1 = idx_1;
-            }
-            else if (hamm_dist < second_best_hamm_dist) {
-                second_best_hamm_dist = hamm_dist;
+    // Index 2 associated to each index 1
+    auto matched_indices_2_in_1 = std::vector<int>(num_keypts_1, -1);
+    // Avoid duplication
+    std::vector<bool> is_already_matched_in_1(num_keypts_1, false);
+
+    for (unsigned int pos = 0; pos < indices_2.size(); ++pos) {
+        const auto idx_2 = indices_2.at(pos);
+        auto& best_two = best_twos.at(pos);
+
+        // The index 1 matched to an earlier index 2 is excluded from the search, so search again only if the best two include it
+        // (NOTE: the cross-checked pairs are unique already)
+        if ((0 <= best_two.best_idx_ && is_already_matched_in_1.at(best_two.best_idx_))
+            || (0 <= best_two.second_best_idx_ && is_already_matched_in_1.at(best_two.second_best_idx_))) {
+            best_two = best_two_result();
+            for (unsigned int idx_1 = 0; idx_1 < num_keypts_1; ++idx_1) {
+                if (is_already_matched_in_1.at(idx_1)) {
+                    continue;
+                }
+                if (check_orientation_ && std::abs(util::angle::diff(keypts_1.at(idx_1).angle, keypts_2.at(idx_2).angle)) > 30.0) {
+                    continue;
+                }
+                const auto hamm_dist = compute_hamming_distance_256(block_2.at(idx_2), block_1.at(idx_1));
+                if (hamm_dist < best_two.best_dist_) {
+                    best_two.second_best_dist_ = best_two.best_dist_;
+                    best_two.second_best_idx_ = best_two.best_idx_;
+                    best_two.best_dist_ = hamm_dist;
+                    best_two.best_idx_ = idx_1;
+                }
+                else if (hamm_dist < best_two.second_best_dist_) {
+                    best_two.second_best_dist_ = hamm_dist;
+                    best_two.second_best_idx_ = idx_1;
+                }
             }
         }
 
+        const auto best_hamm_dist = best_two.best_dist_;
+        const auto second_best_hamm_dist = best_two.second_best_dist_;
+        const int best_idx_1 = best_two.best_idx_;
+
         if (HAMMING_DIST_THR_LOW < best_hamm_dist) {
             continue;
         }
@@ -315,7 +362,7 @@ unsigned int robust::brute_force_match(const data::frame_observation& frm_obs, c
 
         matched_indices_2_in_1.at(best_idx_1) = idx_2;
         // Avoid duplication
-        already_matched_indices_1.insert(best_idx_1);
+        is_already_matched_in_1.at(best_idx_1) = true;
 
         ++num_matches;
     }
@@ -333,6 +380,17 @@ unsigned int robust::brute_force_match(const data::frame_observation& frm_obs, c
     return num_matches;
 }
 
+std::vector<unsigned int> robust::compute_descriptor_distances(const cv::Mat& descriptors_1, const cv::Mat& descriptors_2,
+                                                               const std::vector<std::pair<int, int>>& matches) const {
+    std::vector<unsigned int> distances;
+    distances.reserve(matches.size());
+    for (const auto& match : matches) {
+        distances.push_back(compute_descriptor_distance_32(descriptors_1.row(match.first),
+                                                           descriptors_2.row(match.second)));
+    }
+    return distances;
+}
+
 bool robust::check_epipolar_constraint(const Vec3_t& bearing_1, const Vec3_t& bearing_2,
                                        const Mat33_t& E_12, const float bearing_1_scale_factor) const {
     // Normal vector of the epipolar plane on keyframe 1
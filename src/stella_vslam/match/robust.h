@@ -35,9 +35,17 @@ public:
                                           std::vector<std::shared_ptr<data::landmark>>& matched_lms_in_frm,
                                           bool use_fixed_seed = false) const;
 
-    unsigned int brute_force_match(const data::frame_observation& frm_obs, const std::shared_ptr<data::keyframe>& keyfrm, std::vector<std::pair<int, int>>& matches) const;
+    //! (NOTE: descriptors are the ones of frm_obs, since the keyframes hold them apart from the observations. See data::keyframe::get_descriptors())
+    //! (NOTE: if cross_check is true, only the pairs which are the best of each other are matched)
+    unsigned int brute_force_match(const data::frame_observation& frm_obs, const cv::Mat& descriptors,
+                                   const std::shared_ptr<data::keyframe>& keyfrm, std::vector<std::pair<int, int>>& matches,
+                                   const bool cross_check = false) const;
 
 private:
+    //! Compute the descriptor distances of the matches (for the progressive sampling of RANSAC)
+    std::vector<unsigned int> compute_descriptor_distances(const cv::Mat& descriptors_1, const cv::Mat& descriptors_2,
+                                                           const std::vector<std::pair<int, int>>& matches) const;
+
     bool check_epipolar_constraint(const Vec3_t& bearing_1, const Vec3_t& bearing_2,
                                    const Mat33_t& E_12, const float bearing_1_scale_factor = 1.0) const;
 };
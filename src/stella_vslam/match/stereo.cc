@@ -2,6 +2,10 @@
 
 #include <opencv2/core.hpp>
 
+#include <array>
+#include <cstdlib>
+#include <limits>
+
 namespace stella_vslam {
 namespace match {
 
@@ -17,6 +21,35 @@ stereo::stereo(const std::vector<cv::Mat>& left_image_pyramid, const std::vector
       focal_x_baseline_(focal_x_baseline), true_baseline_(true_baseline),
       min_disp_(0.0f), max_disp_(focal_x_baseline_ / true_baseline_) {}
 
+void stereo::set_depth_prior(const std::vector<cv::Point2f>& pts_left, const std::vector<float>& depths_left, const float margin_ratio) {
+    const auto& left_image = left_image_pyramid_.at(0);
+    num_prior_cols_ = (left_image.cols + prior_cell_size_ - 1) / prior_cell_size_;
+    num_prior_rows_ = (left_image.rows + prior_cell_size_ - 1) / prior_cell_size_;
+    prior_depth_ranges_.assign(num_prior_cols_ * num_prior_rows_, std::make_pair(-1.0f, -1.0f));
+    prior_margin_ratio_ = margin_ratio;
+
+    for (unsigned int i = 0; i < pts_left.size(); ++i) {
+        const auto& pt = pts_left.at(i);
+        const float depth = depths_left.at(i);
+        if (depth <= 0.0f || pt.x < 0.0f || pt.y < 0.0f) {
+            continue;
+        }
+        const int col = static_cast<int>(pt.x) / prior_cell_size_;
+        const int row = static_cast<int>(pt.y) / prior_cell_size_;
+        if (num_prior_cols_ <= col || num_prior_rows_ <= row) {
+            continue;
+        }
+        auto& depth_range = prior_depth_ranges_.at(row * num_prior_cols_ + col);
+        if (depth_range.first <= 0.0f) {
+            depth_range = std::make_pair(depth, depth);
+        }
+        else {
+            depth_range.first = std::min(depth_range.first, depth);
+            depth_range.second = std::max(depth_range.second, depth);
+        }
+    }
+}
+
 void stereo::compute(std::vector<float>& stereo_x_right, std::vector<float>& depths) const {
     // Save keypoint indices on the right image in each image row
     const auto indices_right_in_row = get_right_keypoint_indices_in_each_row(2.0);
@@ -24,11 +57,12 @@ void stereo::compute(std::vector<float>& stereo_x_right, std::vector<float>& dep
     // Compute the parallax and depth for each keypoint on the left image in a subpixel precision
     stereo_x_right.resize(num_keypts_, -1.0f);
     depths.resize(num_keypts_, -1.0f);
-    std::vector<std::pair<int, int>> correlation_and_idx_left;
-    correlation_and_idx_left.reserve(num_keypts_);
+    // Correlation of each left keypoint (negative if not matched)
+    // NOTE: written per keypoint so that the parallel loop needs no critical section
+    std::vector<float> correlations_left(num_keypts_, -1.0f);
 
 #ifdef USE_OPENMP
-#pragma omp parallel for
+#pragma omp parallel for schedule(dynamic, 64)
 #endif
     for (int64_t idx_left = 0; idx_left < num_keypts_; ++idx_left) {
         const auto& keypt_left = keypts_left_.at(idx_left);
@@ -51,10 +85,19 @@ void stereo::compute(std::vector<float>& stereo_x_right, std::vector<float>& dep
         }
 
         // Search the best candidate index on the right image whose feature vector is the closest to that on the left
+        // (within the disparity range of the depth prior first, then within the full range if not found)
         unsigned int best_idx_right = 0;
         unsigned int best_hamm_dist = hamm_dist_thr_;
-        find_closest_keypoints_in_stereo(idx_left, scale_level_left, candidate_indices_right,
-                                         min_x_right, max_x_right, best_idx_right, best_hamm_dist);
+        float min_prior_disp, max_prior_disp;
+        const bool has_prior = get_disparity_range_from_prior(keypt_left, min_prior_disp, max_prior_disp);
+        if (has_prior) {
+            find_closest_keypoints_in_stereo(idx_left, scale_level_left, candidate_indices_right,
+                                             x_left - max_prior_disp, x_left - min_prior_disp, best_idx_right, best_hamm_dist);
+        }
+        if (!has_prior || hamm_dist_thr_ <= best_hamm_dist) {
+            find_closest_keypoints_in_stereo(idx_left, scale_level_left, candidate_indices_right,
+                                             min_x_right, max_x_right, best_idx_right, best_hamm_dist);
+        }
         // Discard if the hamming distance threshold isn't satisfied
         if (hamm_dist_thr_ <= best_hamm_dist) {
             continue;
@@ -85,12 +128,16 @@ void stereo::compute(std::vector<float>& stereo_x_right, std::vector<float>& dep
         // Set the results
         depths.at(idx_left) = focal_x_baseline_ / best_disp;
         stereo_x_right.at(idx_left) = best_x_right;
-#ifdef USE_OPENMP
-#pragma omp critical
-#endif
-        {
-            correlation_and_idx_left.emplace_back(std::make_pair(best_correlation, idx_left));
+        correlations_left.at(idx_left) = best_correlation;
+    }
+
+    std::vector<std::pair<int, int>> correlation_and_idx_left;
+    correlation_and_idx_left.reserve(num_keypts_);
+    for (unsigned int idx_left = 0; idx_left < num_keypts_; ++idx_left) {
+        if (correlations_left.at(idx_left) < 0.0f) {
+            continue;
         }
+        correlation_and_idx_left.emplace_back(std::make_pair(correlations_left.at(idx_left), idx_left));
     }
 
     // Acquire the median of correlation
@@ -118,11 +165,10 @@ std::vector<std::vector<unsigned int>> stereo::get_right_keypoint_indices_in_eac
     const unsigned int num_img_rows = left_image_pyramid_.at(0).rows;
 
     std::vector<std::vector<unsigned int>> indices_right_in_row(num_img_rows, std::vector<unsigned int>());
-    for (unsigned int row = 0; row < num_img_rows; ++row) {
-        indices_right_in_row.at(row).reserve(100);
-    }
 
+    // Compute the row range of each keypoint on the right image once
     const unsigned int num_keypts_right = keypts_right_.size();
+    std::vector<std::pair<int, int>> row_ranges_right(num_keypts_right);
     for (unsigned int idx_right = 0; idx_right < num_keypts_right; ++idx_right) {
         // Acquire the cordinates y of the keypoint on the right image
         const auto& keypt_right = keypts_right_.at(idx_right);
@@ -130,18 +176,66 @@ std::vector<std::vector<unsigned int>> stereo::get_right_keypoint_indices_in_eac
         // Compute uncertainty of the cordinates according to scale
         const float r = margin * scale_factors_.at(keypts_right_.at(idx_right).octave);
         // Compute the max and the min values
-        const int max_r = cvCeil(y_right + r);
-        const int min_r = cvFloor(y_right - r);
+        row_ranges_right.at(idx_right) = std::make_pair(cvFloor(y_right - r), cvCeil(y_right + r));
+    }
 
-        // Save the index of the keypoint for all the row numbers between the max and the min values
-        for (int row_right = min_r; row_right <= max_r; ++row_right) {
-            indices_right_in_row.at(row_right).push_back(idx_right);
+    // Split the image rows into bands, and fill the candidate lists of each band independently
+    // NOTE: the indices in each row are kept in ascending order as in the serial version
+    constexpr int band_height = 32;
+    const int num_bands = (num_img_rows + band_height - 1) / band_height;
+#ifdef USE_OPENMP
+#pragma omp parallel for
+#endif
+    for (int64_t band = 0; band < num_bands; ++band) {
+        const int band_min_row = static_cast<int>(band) * band_height;
+        const int band_max_row = std::min(band_min_row + band_height, static_cast<int>(num_img_rows)) - 1;
+        for (int row = band_min_row; row <= band_max_row; ++row) {
+            indices_right_in_row.at(row).reserve(100);
+        }
+        for (unsigned int idx_right = 0; idx_right < num_keypts_right; ++idx_right) {
+            const int min_r = std::max(row_ranges_right.at(idx_right).first, band_min_row);
+            const int max_r = std::min(row_ranges_right.at(idx_right).second, band_max_row);
+            // Save the index of the keypoint for all the row numbers between the max and the min values
+            for (int row_right = min_r; row_right <= max_r; ++row_right) {
+                indices_right_in_row.at(row_right).push_back(idx_right);
+            }
         }
     }
 
     return indices_right_in_row;
 }
 
+bool stereo::get_disparity_range_from_prior(const cv::KeyPoint& keypt_left, float& min_disp, float& max_disp) const {
+    if (prior_depth_ranges_.empty()) {
+        return false;
+    }
+
+    // Collect the depths in the cell of the keypoint and its neighbors
+    const int col = static_cast<int>(keypt_left.pt.x) / prior_cell_size_;
+    const int row = static_cast<int>(keypt_left.pt.y) / prior_cell_size_;
+    float min_depth = std::numeric_limits<float>::max();
+    float max_depth = 0.0f;
+    for (int r = std::max(row - 1, 0); r <= std::min(row + 1, num_prior_rows_ - 1); ++r) {
+        for (int c = std::max(col - 1, 0); c <= std::min(col + 1, num_prior_cols_ - 1); ++c) {
+            const auto& depth_range = prior_depth_ranges_.at(r * num_prior_cols_ + c);
+            if (depth_range.first <= 0.0f) {
+                continue;
+            }
+            min_depth = std::min(min_depth, depth_range.first);
+            max_depth = std::max(max_depth, depth_range.second);
+        }
+    }
+    if (max_depth <= 0.0f) {
+        return false;
+    }
+
+    // Convert the depth range with the margin to the disparity range
+    min_disp = std::max(min_disp_, focal_x_baseline_ / (max_depth * (1.0f + prior_margin_ratio_)));
+    const float min_depth_with_margin = min_depth * (1.0f - prior_margin_ratio_);
+    max_disp = (min_depth_with_margin <= 0.0f) ? max_disp_ : std::min(max_disp_, focal_x_baseline_ / min_depth_with_margin);
+    return min_disp <= max_disp;
+}
+
 void stereo::find_closest_keypoints_in_stereo(const unsigned int idx_left, const int scale_level_left,
                                               const std::vector<unsigned int>& candidate_indices_right,
                                               const float min_x_right, const float max_x_right,
@@ -199,25 +293,33 @@ bool stereo::compute_subpixel_disparity(const cv::KeyPoint& keypt_left, const cv
     // Compute the pixel correlation surrounding the keypoint, and compute the parallax in subpixel precision by parabolic fitting
     best_correlation = std::numeric_limits<float>::max();
     int best_offset = 0;
-    std::vector<float> correlations(2 * slide_width + 1, -1);
+    std::array<float, 2 * slide_width + 1> correlations;
+    correlations.fill(-1);
 
-    // Extract a patch on the left image
-    auto patch_left = left_image_pyramid_.at(keypt_left.octave)
-                          .rowRange(scaled_y_left - win_size, scaled_y_left + win_size + 1)
-                          .colRange(scaled_x_left - win_size, scaled_x_left + win_size + 1);
-    patch_left.convertTo(patch_left, CV_32F);
-    patch_left -= patch_left.at<float>(win_size, win_size) * cv::Mat::ones(patch_left.rows, patch_left.cols, CV_32F);
+    const cv::Mat& left_image = left_image_pyramid_.at(keypt_left.octave);
+    const cv::Mat& right_image = right_image_pyramid_.at(keypt_left.octave);
+    if (scaled_y_left - win_size < 0 || right_image.rows <= scaled_y_left + win_size) {
+        return false;
+    }
+
+    // Patch on the left image, centered by the keypoint intensity
+    const int center_left = left_image.at<uchar>(scaled_y_left, scaled_x_left);
 
     for (int offset = -slide_width; offset <= +slide_width; ++offset) {
-        // Extract a patch on the right image
-        auto patch_right = right_image_pyramid_.at(keypt_left.octave)
-                               .rowRange(scaled_y_left - win_size, scaled_y_left + win_size + 1)
-                               .colRange(scaled_x_right + offset - win_size, scaled_x_right + offset + win_size + 1);
-        patch_right.convertTo(patch_right, CV_32F);
-        patch_right -= patch_right.at<float>(win_size, win_size) * cv::Mat::ones(patch_right.rows, patch_right.cols, CV_32F);
-
-        // Acquire correlation L1
-        const float correlation = cv::norm(patch_left, patch_right, cv::NORM_L1);
+        // Patch on the right image, centered by its center intensity
+        const int x_right_patch = scaled_x_right + offset;
+        const int center_right = right_image.at<uchar>(scaled_y_left, x_right_patch);
+
+        // Acquire correlation L1 (sum of absolute differences on integer intensities, without temporary patches)
+        int sad = 0;
+        for (int dy = -win_size; dy <= win_size; ++dy) {
+            const uchar* const row_left = left_image.ptr<uchar>(scaled_y_left + dy) + scaled_x_left - win_size;
+            const uchar* const row_right = right_image.ptr<uchar>(scaled_y_left + dy) + x_right_patch - win_size;
+            for (int dx = 0; dx < 2 * win_size + 1; ++dx) {
+                sad += std::abs((row_left[dx] - center_left) - (row_right[dx] - center_right));
+            }
+        }
+        const float correlation = static_cast<float>(sad);
         if (correlation < best_correlation) {
             best_correlation = correlation;
             best_offset = offset;
@@ -23,6 +23,15 @@ public:
 
     virtual ~stereo() = default;
 
+    /**
+     * Set the depth prior to narrow the disparity search of the left keypoints near the points
+     * (the full disparity range is searched for the other keypoints, or if no match is found within the narrowed range)
+     * @param pts_left positions of the points on the left image (e.g. the landmarks predicted with the motion model)
+     * @param depths_left depths of the points
+     * @param margin_ratio relative margin of the depths
+     */
+    void set_depth_prior(const std::vector<cv::Point2f>& pts_left, const std::vector<float>& depths_left, const float margin_ratio);
+
     /**
      * Compute stereo matching in subpixel order
      */
@@ -36,6 +45,15 @@ private:
      */
     std::vector<std::vector<unsigned int>> get_right_keypoint_indices_in_each_row(const float margin) const;
 
+    /**
+     * Get the disparity range of the left keypoint from the depth prior
+     * @param keypt_left
+     * @param min_disp
+     * @param max_disp
+     * @return false if the keypoint has no depth prior
+     */
+    bool get_disparity_range_from_prior(const cv::KeyPoint& keypt_left, float& min_disp, float& max_disp) const;
+
     /**
      * Find the closest right keypoint for each left keypoint in stereo
      * @param idx_left
@@ -95,6 +113,17 @@ private:
     //! maximum disparity
     const float max_disp_;
 
+    //! depth prior: minimum and maximum depths of the points in each cell of the left image (non-positive if empty)
+    std::vector<std::pair<float, float>> prior_depth_ranges_;
+    //! number of the columns of the cells of the depth prior
+    int num_prior_cols_ = 0;
+    //! number of the rows of the cells of the depth prior
+    int num_prior_rows_ = 0;
+    //! relative margin of the depth prior
+    float prior_margin_ratio_ = 0.0f;
+    //! size of the cells of the depth prior [px]
+    static constexpr int prior_cell_size_ = 16;
+
     //! maximum hamming distance
     static constexpr unsigned int hamm_dist_thr_ = (match::HAMMING_DIST_THR_HIGH + match::HAMMING_DIST_THR_LOW) / 2;
 };
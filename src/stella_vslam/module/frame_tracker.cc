@@ -6,6 +6,7 @@
 #include "stella_vslam/match/projection.h"
 #include "stella_vslam/match/robust.h"
 #include "stella_vslam/module/frame_tracker.h"
+#include "stella_vslam/util/latency_profiler.h"
 
 #include <spdlog/spdlog.h>
 
@@ -15,7 +16,10 @@ namespace module {
 frame_tracker::frame_tracker(camera::base* camera, const unsigned int num_matches_thr, bool use_fixed_seed)
     : camera_(camera), num_matches_thr_(num_matches_thr), use_fixed_seed_(use_fixed_seed), pose_optimizer_() {}
 
-bool frame_tracker::motion_based_track(data::frame& curr_frm, const data::frame& last_frm, const Mat44_t& velocity) const {
+bool frame_tracker::motion_based_track(data::frame& curr_frm, const data::frame& last_frm, const Mat44_t& velocity, const float margin_scale,
+                                       const Mat66_t* pred_pose_cov) const {
+    STELLA_VSLAM_LATENCY_SPAN("frame_tracker::motion_based_track");
+
     match::projection projection_matcher(0.9, true);
 
     // Set the initial pose by using the motion model
@@ -26,10 +30,11 @@ bool frame_tracker::motion_based_track(data::frame& curr_frm, const data::frame&
 
     // Reproject the 3D points observed in the last frame and find 2D-3D matches
     const float margin = (camera_->setup_type_ != camera::setup_type_t::Stereo) ? 20 : 10;
-    auto num_matches = projection_matcher.match_current_and_last_frames(curr_frm, last_frm, margin);
+    auto num_matches = projection_matcher.match_current_and_last_frames(curr_frm, last_frm, margin_scale * margin, pred_pose_cov);
 
     if (num_matches < num_matches_thr_) {
         // Increment the margin, and search again
+        // (the narrowed margin is not used, in case the prediction is wrong)
         curr_frm.erase_landmarks();
         num_matches = projection_matcher.match_current_and_last_frames(curr_frm, last_frm, 2 * margin);
     }
@@ -42,7 +47,7 @@ bool frame_tracker::motion_based_track(data::frame& curr_frm, const data::frame&
     // Pose optimization
     g2o::SE3Quat optimized_pose;
     std::vector<bool> outlier_flags;
-    pose_optimizer_.optimize(curr_frm, optimized_pose, outlier_flags);
+    pose_optimizer_.optimize(curr_frm, optimized_pose, outlier_flags, &curr_frm.pose_cov_);
     curr_frm.set_pose_cw(optimized_pose);
 
     // Discard the outliers
@@ -57,7 +62,46 @@ bool frame_tracker::motion_based_track(data::frame& curr_frm, const data::frame&
     }
 }
 
+bool frame_tracker::optical_flow_based_track(data::frame& curr_frm, const data::frame& last_frm, const Mat44_t& velocity) const {
+    STELLA_VSLAM_LATENCY_SPAN("frame_tracker::optical_flow_based_track");
+
+    // Set the initial pose by using the motion model
+    curr_frm.set_pose_cw(velocity * last_frm.get_pose_cw());
+
+    // The 2D-3D matches have been already given by the optical flow
+    unsigned int num_matches = 0;
+    for (const auto& lm : curr_frm.get_landmarks()) {
+        if (lm && !lm->will_be_erased()) {
+            ++num_matches;
+        }
+    }
+
+    if (num_matches < num_matches_thr_) {
+        spdlog::debug("optical flow based tracking failed: {} matches < {}", num_matches, num_matches_thr_);
+        return false;
+    }
+
+    // Pose optimization
+    g2o::SE3Quat optimized_pose;
+    std::vector<bool> outlier_flags;
+    pose_optimizer_.optimize(curr_frm, optimized_pose, outlier_flags, &curr_frm.pose_cov_);
+    curr_frm.set_pose_cw(optimized_pose);
+
+    // Discard the outliers
+    const auto num_valid_matches = discard_outliers(outlier_flags, curr_frm);
+
+    if (num_valid_matches < num_matches_thr_) {
+        spdlog::debug("optical flow based tracking failed: {} inlier matches < {}", num_valid_matches, num_matches_thr_);
+        return false;
+    }
+    else {
+        return true;
+    }
+}
+
 bool frame_tracker::bow_match_based_track(data::frame& curr_frm, const data::frame& last_frm, const std::shared_ptr<data::keyframe>& ref_keyfrm) const {
+    STELLA_VSLAM_LATENCY_SPAN("frame_tracker::bow_match_based_track");
+
     match::bow_tree bow_matcher(0.7, true);
 
     // Search 2D-2D matches between the ref keyframes and the current frame
@@ -94,6 +138,8 @@ bool frame_tracker::bow_match_based_track(data::frame& curr_frm, const data::fra
 }
 
 bool frame_tracker::robust_match_based_track(data::frame& curr_frm, const data::frame& last_frm, const std::shared_ptr<data::keyframe>& ref_keyfrm) const {
+    STELLA_VSLAM_LATENCY_SPAN("frame_tracker::robust_match_based_track");
+
     match::robust robust_matcher(0.8, true);
 
     // Search 2D-2D matches between the ref keyframes and the current frame
@@ -132,7 +178,7 @@ bool frame_tracker::robust_match_based_track(data::frame& curr_frm, const data::
 unsigned int frame_tracker::discard_outliers(const std::vector<bool>& outlier_flags, data::frame& curr_frm) const {
     unsigned int num_valid_matches = 0;
 
-    for (unsigned int idx = 0; idx < curr_frm.frm_obs_.num_keypts_; ++idx) {
+    for (unsigned int idx = 0; idx < curr_frm.frm_obs_->num_keypts_; ++idx) {
         if (curr_frm.get_landmark(idx) == nullptr) {
             continue;
         }
@@ -24,7 +24,14 @@ class frame_tracker {
 public:
     explicit frame_tracker(camera::base* camera, const unsigned int num_matches_thr = 20, bool use_fixed_seed = false);
 
-    bool motion_based_track(data::frame& curr_frm, const data::frame& last_frm, const Mat44_t& velocity) const;
+    //! Track with the projection matching from the last frame
+    //! (margin_scale < 1 narrows the first search window when the velocity is predicted accurately, e.g. by the IMU.
+    //!  If pred_pose_cov, the covariance of the predicted pose, is given, the first search windows are derived from it)
+    bool motion_based_track(data::frame& curr_frm, const data::frame& last_frm, const Mat44_t& velocity, const float margin_scale = 1.0,
+                            const Mat66_t* pred_pose_cov = nullptr) const;
+
+    //! Track with the 2D-3D matches which are carried over from the last frame by the optical flow
+    bool optical_flow_based_track(data::frame& curr_frm, const data::frame& last_frm, const Mat44_t& velocity) const;
 
     bool bow_match_based_track(data::frame& curr_frm, const data::frame& last_frm, const std::shared_ptr<data::keyframe>& ref_keyfrm) const;
 
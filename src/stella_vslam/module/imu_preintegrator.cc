@@ -0,0 +1,112 @@
+#include "stella_vslam/module/imu_preintegrator.h"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+#include <spdlog/spdlog.h>
+
+namespace stella_vslam {
+namespace module {
+
+namespace {
+Mat33_t load_rot_cb(const YAML::Node& yaml_node) {
+    if (!yaml_node["extrinsics"]) {
+        return Mat33_t::Identity();
+    }
+    const auto extrinsics = yaml_node["extrinsics"].as<std::vector<double>>();
+    if (extrinsics.size() != 16) {
+        throw std::runtime_error("the extrinsics of the IMU must have 16 values");
+    }
+    Mat33_t rot_cb;
+    for (unsigned int i = 0; i < 3; ++i) {
+        for (unsigned int j = 0; j < 3; ++j) {
+            rot_cb(i, j) = extrinsics.at(4 * i + j);
+        }
+    }
+    return rot_cb;
+}
+
+Vec3_t load_gyr_bias(const YAML::Node& yaml_node) {
+    if (!yaml_node["gyr_bias"]) {
+        return Vec3_t::Zero();
+    }
+    const auto gyr_bias = yaml_node["gyr_bias"].as<std::vector<double>>();
+    if (gyr_bias.size() != 3) {
+        throw std::runtime_error("the gyroscope bias of the IMU must have 3 values");
+    }
+    return Vec3_t{gyr_bias.at(0), gyr_bias.at(1), gyr_bias.at(2)};
+}
+} // namespace
+
+imu_preintegrator::imu_preintegrator(const Mat33_t& rot_cb, const Vec3_t& gyr_bias, const double max_extrapolation)
+    : rot_cb_(rot_cb), gyr_bias_(gyr_bias), max_extrapolation_(max_extrapolation) {}
+
+imu_preintegrator::imu_preintegrator(const YAML::Node& yaml_node)
+    : imu_preintegrator(load_rot_cb(yaml_node),
+                        load_gyr_bias(yaml_node),
+                        yaml_node["max_extrapolation"].as<double>(0.01)) {}
+
+void imu_preintegrator::queue_measurements(const std::vector<data::imu_measurement>& measurements) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    for (const auto& measurement : measurements) {
+        if (!measurements_.empty() && measurement.timestamp_ <= measurements_.back().timestamp_) {
+            spdlog::debug("imu_preintegrator: discard the IMU measurement which is not newer than the queued ones ({})", measurement.timestamp_);
+            continue;
+        }
+        measurements_.push_back(measurement);
+    }
+}
+
+bool imu_preintegrator::integrate_rotation(const double last_timestamp, const double curr_timestamp, Mat33_t& rot_curr_last) const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (measurements_.empty() || curr_timestamp <= last_timestamp) {
+        return false;
+    }
+    if (last_timestamp + max_extrapolation_ < measurements_.front().timestamp_
+        || measurements_.back().timestamp_ < curr_timestamp - max_extrapolation_) {
+        return false;
+    }
+
+    // rotation of the IMU: last -> current
+    // (the angular velocity is held constant between the measurements, and before the first or after the last one)
+    Mat33_t rot_last_curr = Mat33_t::Identity();
+    const auto num_measurements = measurements_.size();
+    for (unsigned int i = 0; i < num_measurements; ++i) {
+        const double begin = (i == 0) ? -std::numeric_limits<double>::infinity() : measurements_.at(i).timestamp_;
+        const double end = (i + 1 == num_measurements) ? std::numeric_limits<double>::infinity() : measurements_.at(i + 1).timestamp_;
+        const double dt = std::min(end, curr_timestamp) - std::max(begin, last_timestamp);
+        if (dt <= 0.0) {
+            continue;
+        }
+        const Vec3_t gyr = (i + 1 == num_measurements)
+                               ? measurements_.at(i).gyr_
+                               : Vec3_t(0.5 * (measurements_.at(i).gyr_ + measurements_.at(i + 1).gyr_));
+        const Vec3_t rot_vec = (gyr - gyr_bias_) * dt;
+        const double angle = rot_vec.norm();
+        if (angle < 1e-12) {
+            continue;
+        }
+        rot_last_curr = rot_last_curr * Eigen::AngleAxisd(angle, rot_vec / angle).toRotationMatrix();
+    }
+
+    // convert to the rotation of the camera: current <- last
+    rot_curr_last = rot_cb_ * rot_last_curr.transpose() * rot_cb_.transpose();
+    return true;
+}
+
+void imu_preintegrator::discard_measurements(const double timestamp) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    // keep the last measurement before the timestamp to integrate from it
+    while (2 <= measurements_.size() && measurements_.at(1).timestamp_ <= timestamp) {
+        measurements_.pop_front();
+    }
+}
+
+void imu_preintegrator::reset() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    measurements_.clear();
+}
+
+} // namespace module
+} // namespace stella_vslam
@@ -0,0 +1,73 @@
+#ifndef STELLA_VSLAM_MODULE_IMU_PREINTEGRATOR_H
+#define STELLA_VSLAM_MODULE_IMU_PREINTEGRATOR_H
+
+#include "stella_vslam/type.h"
+#include "stella_vslam/data/imu_measurement.h"
+
+#include <deque>
+#include <mutex>
+#include <vector>
+
+#include <yaml-cpp/yaml.h>
+
+namespace stella_vslam {
+namespace module {
+
+/**
+ * Preintegrator of the angular velocity of an IMU rigidly mounted with the camera,
+ * which predicts the rotation of the camera between two frames for the motion model
+ * (NOTE: the accelerometer is not integrated, because the velocity, the gravity direction and the scale of the map are not estimated)
+ */
+class imu_preintegrator {
+public:
+    /**
+     * Constructor
+     * @param rot_cb rotation from the IMU frame to the camera frame
+     * @param gyr_bias bias of the gyroscope [rad/s]
+     * @param max_extrapolation maximum gap [s] between the measurements and the frame timestamps to extrapolate over
+     */
+    explicit imu_preintegrator(const Mat33_t& rot_cb = Mat33_t::Identity(),
+                               const Vec3_t& gyr_bias = Vec3_t::Zero(),
+                               const double max_extrapolation = 0.01);
+
+    /**
+     * Constructor
+     * @param yaml_node (the "IMU" section)
+     */
+    explicit imu_preintegrator(const YAML::Node& yaml_node);
+
+    //! Queue the measurements (sorted by the timestamps, and newer than the queued ones)
+    void queue_measurements(const std::vector<data::imu_measurement>& measurements);
+
+    /**
+     * Integrate the angular velocity between the timestamps
+     * @param last_timestamp timestamp of the last frame
+     * @param curr_timestamp timestamp of the current frame
+     * @param rot_curr_last rotation of the camera from the last frame to the current frame (same convention as the motion model)
+     * @return false if the queued measurements do not cover the interval
+     */
+    bool integrate_rotation(const double last_timestamp, const double curr_timestamp, Mat33_t& rot_curr_last) const;
+
+    //! Discard the measurements which are not needed to integrate from the timestamp
+    void discard_measurements(const double timestamp);
+
+    //! Discard all the measurements
+    void reset();
+
+private:
+    //! rotation from the IMU frame to the camera frame
+    const Mat33_t rot_cb_;
+    //! bias of the gyroscope
+    const Vec3_t gyr_bias_;
+    //! maximum gap between the measurements and the frame timestamps to extrapolate over
+    const double max_extrapolation_;
+
+    mutable std::mutex mtx_;
+    //! queued measurements
+    std::deque<data::imu_measurement, Eigen::aligned_allocator<data::imu_measurement>> measurements_;
+};
+
+} // namespace module
+} // namespace stella_vslam
+
+#endif // STELLA_VSLAM_MODULE_IMU_PREINTEGRATOR_H
@@ -9,9 +9,14 @@
 #include "stella_vslam/match/area.h"
 #include "stella_vslam/module/initializer.h"
 #include "stella_vslam/optimize/global_bundle_adjuster.h"
+#include "stella_vslam/util/thread_pool.h"
 
 #include <spdlog/spdlog.h>
 
+#include <algorithm>
+#include <functional>
+#include <future>
+
 namespace stella_vslam {
 namespace module {
 
@@ -25,8 +30,12 @@ initializer::initializer(data::map_database* map_db, data::bow_database* bow_db,
       reproj_err_thr_(yaml_node["reprojection_error_threshold"].as<float>(4.0)),
       num_ba_iters_(yaml_node["num_ba_iterations"].as<unsigned int>(20)),
       scaling_factor_(yaml_node["scaling_factor"].as<float>(1.0)),
-      use_fixed_seed_(yaml_node["use_fixed_seed"].as<bool>(false)) {
+      use_fixed_seed_(yaml_node["use_fixed_seed"].as<bool>(false)),
+      num_reference_frms_(std::max(1U, yaml_node["num_reference_frames"].as<unsigned int>(1))),
+      reference_frm_interval_(yaml_node["reference_frame_interval"].as<unsigned int>(5)) {
     spdlog::debug("CONSTRUCT: module::initializer");
+    // each attempt computes H matrix on a worker and F matrix on the thread of the attempt
+    thread_pool_ = std::make_shared<util::thread_pool>(2 * num_reference_frms_ - 1);
 }
 
 initializer::~initializer() {
@@ -34,6 +43,7 @@ initializer::~initializer() {
 }
 
 void initializer::reset() {
+    references_.clear();
     initializer_.reset(nullptr);
     state_ = initializer_state_t::NotReady;
     init_frm_id_ = 0;
@@ -56,6 +66,10 @@ bool initializer::get_use_fixed_seed() const {
     return use_fixed_seed_;
 }
 
+void initializer::set_thread_pool(const std::shared_ptr<util::thread_pool>& thread_pool) {
+    thread_pool_ = thread_pool;
+}
+
 bool initializer::initialize(const camera::setup_type_t setup_type,
                              data::bow_vocabulary* bow_vocab, data::frame& curr_frm) {
     switch (setup_type) {
@@ -107,58 +121,111 @@ bool initializer::initialize(const camera::setup_type_t setup_type,
 }
 
 void initializer::create_initializer(data::frame& curr_frm) {
-    // set the initial frame
-    init_frm_ = data::frame(curr_frm);
+    references_.clear();
+    initializer_.reset(nullptr);
+    add_reference(curr_frm);
+    state_ = initializer_state_t::Initializing;
+}
+
+void initializer::add_reference(data::frame& curr_frm) {
+    std::unique_ptr<reference> ref(new reference);
+
+    // set the reference frame
+    ref->frm_ = data::frame(curr_frm);
 
     // initialize the previously matched coordinates
-    prev_matched_coords_.resize(init_frm_.frm_obs_.undist_keypts_.size());
-    for (unsigned int i = 0; i < init_frm_.frm_obs_.undist_keypts_.size(); ++i) {
-        prev_matched_coords_.at(i) = init_frm_.frm_obs_.undist_keypts_.at(i).pt;
+    ref->prev_matched_coords_.resize(ref->frm_.frm_obs_->undist_keypts_.size());
+    for (unsigned int i = 0; i < ref->frm_.frm_obs_->undist_keypts_.size(); ++i) {
+        ref->prev_matched_coords_.at(i) = ref->frm_.frm_obs_->undist_keypts_.at(i).pt;
     }
 
-    // initialize matchings (init_idx -> curr_idx)
-    std::fill(init_matches_.begin(), init_matches_.end(), -1);
-
     // build a initializer
-    initializer_.reset(nullptr);
-    switch (init_frm_.camera_->model_type_) {
+    switch (ref->frm_.camera_->model_type_) {
         case camera::model_type_t::Perspective:
         case camera::model_type_t::Fisheye:
         case camera::model_type_t::RadialDivision: {
-            initializer_ = std::unique_ptr<initialize::perspective>(
+            ref->initializer_ = std::unique_ptr<initialize::perspective>(
                 new initialize::perspective(
-                    init_frm_, num_ransac_iters_, min_num_triangulated_pts_, min_num_valid_pts_,
-                    parallax_deg_thr_, reproj_err_thr_, use_fixed_seed_));
+                    ref->frm_, num_ransac_iters_, min_num_triangulated_pts_, min_num_valid_pts_,
+                    parallax_deg_thr_, reproj_err_thr_, use_fixed_seed_, thread_pool_.get()));
             break;
         }
         case camera::model_type_t::Equirectangular: {
-            initializer_ = std::unique_ptr<initialize::bearing_vector>(
+            ref->initializer_ = std::unique_ptr<initialize::bearing_vector>(
                 new initialize::bearing_vector(
-                    init_frm_, num_ransac_iters_, min_num_triangulated_pts_, min_num_valid_pts_,
-                    parallax_deg_thr_, reproj_err_thr_, use_fixed_seed_));
+                    ref->frm_, num_ransac_iters_, min_num_triangulated_pts_, min_num_valid_pts_,
+                    parallax_deg_thr_, reproj_err_thr_, use_fixed_seed_, thread_pool_.get()));
             break;
         }
     }
 
-    state_ = initializer_state_t::Initializing;
+    references_.push_back(std::move(ref));
 }
 
 bool initializer::try_initialize_for_monocular(data::frame& curr_frm) {
     assert(state_ == initializer_state_t::Initializing);
+    assert(!references_.empty());
+
+    // try to initialize with each reference frame and the current frame
+    // (NOTE: the attempts against the older reference frames run on the workers, and the newest one runs on this thread)
+    const unsigned int num_refs = references_.size();
+    std::vector<unsigned int> num_matches(num_refs, 0);
+    std::vector<char> is_initialized(num_refs, false);
+    const auto attempt = [this, &curr_frm, &num_matches, &is_initialized](const unsigned int i) {
+        auto& ref = *references_.at(i);
+        match::area matcher(0.9, true);
+        num_matches.at(i) = matcher.match_in_consistent_area(ref.frm_, curr_frm, ref.prev_matched_coords_, ref.matches_, 100);
+        if (num_matches.at(i) < min_num_valid_pts_) {
+            return;
+        }
+        spdlog::debug("try to initialize with the reference frame and the current frame: frame {} - frame {}", ref.frm_.id_, curr_frm.id_);
+        is_initialized.at(i) = ref.initializer_->initialize(curr_frm, ref.matches_);
+    };
+    std::vector<std::future<void>> futures;
+    futures.reserve(num_refs - 1);
+    for (unsigned int i = 0; i + 1 < num_refs; ++i) {
+        futures.push_back(thread_pool_->submit(std::bind(attempt, i), util::task_priority_t::High));
+    }
+    attempt(num_refs - 1);
+    for (auto& future : futures) {
+        thread_pool_->wait(future, util::task_priority_t::High);
+        future.get();
+    }
 
-    match::area matcher(0.9, true);
-    const auto num_matches = matcher.match_in_consistent_area(init_frm_, curr_frm, prev_matched_coords_, init_matches_, 100);
+    // adopt the oldest reference frame which succeeded in initialization
+    for (unsigned int i = 0; i < num_refs; ++i) {
+        if (!is_initialized.at(i)) {
+            continue;
+        }
+        auto& ref = *references_.at(i);
+        init_frm_ = ref.frm_;
+        init_matches_ = ref.matches_;
+        initializer_ = std::move(ref.initializer_);
+        references_.clear();
+        return true;
+    }
 
-    if (num_matches < min_num_valid_pts_) {
+    // discard the reference frames which lost the matches
+    std::vector<std::unique_ptr<reference>> tracked_references;
+    for (unsigned int i = 0; i < num_refs; ++i) {
+        if (num_matches.at(i) < min_num_valid_pts_) {
+            spdlog::debug("discard the reference frame {} (number of matches: {})", references_.at(i)->frm_.id_, num_matches.at(i));
+            continue;
+        }
+        tracked_references.push_back(std::move(references_.at(i)));
+    }
+    references_ = std::move(tracked_references);
+    if (references_.empty()) {
         // rebuild the initializer with the next frame
         reset();
         return false;
     }
 
-    // try to initialize with the initial frame and the current frame
-    assert(initializer_);
-    spdlog::debug("try to initialize with the initial frame and the current frame: frame {} - frame {}", init_frm_.id_, curr_frm.id_);
-    return initializer_->initialize(curr_frm, init_matches_);
+    // add the current frame as a new reference frame, whose attempts start from the next frame
+    if (references_.size() < num_reference_frms_ && reference_frm_interval_ <= curr_frm.id_ - references_.back()->frm_.id_) {
+        add_reference(curr_frm);
+    }
+    return false;
 }
 
 bool initializer::create_map_for_monocular(data::bow_vocabulary* bow_vocab, data::frame& curr_frm) {
@@ -224,7 +291,7 @@ bool initializer::create_map_for_monocular(data::bow_vocabulary* bow_vocab, data
         }
 
         // construct a landmark
-        auto lm = std::make_shared<data::landmark>(map_db_->next_landmark_id_++, init_triangulated_pts.at(init_idx), curr_keyfrm);
+        auto lm = data::landmark::create(map_db_->next_landmark_id_++, init_triangulated_pts.at(init_idx), curr_keyfrm);
 
         // set the assocications to the new keyframes
         lm->connect_to_keyframe(init_keyfrm, init_idx);
@@ -317,7 +384,7 @@ void initializer::scale_map(const std::shared_ptr<data::keyframe>& init_keyfrm,
 bool initializer::try_initialize_for_stereo(data::frame& curr_frm) {
     assert(state_ == initializer_state_t::Initializing);
     // count the number of valid depths
-    unsigned int num_valid_depths = std::count_if(curr_frm.frm_obs_.depths_.begin(), curr_frm.frm_obs_.depths_.end(),
+    unsigned int num_valid_depths = std::count_if(curr_frm.frm_obs_->depths_.begin(), curr_frm.frm_obs_->depths_.end(),
                                                   [](const float depth) {
                                                       return 0 < depth;
                                                   });
@@ -343,16 +410,16 @@ bool initializer::create_map_for_stereo(data::bow_vocabulary* bow_vocab, data::f
     curr_frm.ref_keyfrm_ = curr_keyfrm;
     map_db_->update_frame_statistics(curr_frm, false);
 
-    for (unsigned int idx = 0; idx < curr_frm.frm_obs_.num_keypts_; ++idx) {
+    for (unsigned int idx = 0; idx < curr_frm.frm_obs_->num_keypts_; ++idx) {
         // add a new landmark if tht corresponding depth is valid
-        const auto z = curr_frm.frm_obs_.depths_.at(idx);
+        const auto z = curr_frm.frm_obs_->depths_.at(idx);
         if (z <= 0) {
             continue;
         }
 
         // build a landmark
         const Vec3_t pos_w = curr_frm.triangulate_stereo(idx);
-        auto lm = std::make_shared<data::landmark>(map_db_->next_landmark_id_++, pos_w, curr_keyfrm);
+        auto lm = data::landmark::create(map_db_->next_landmark_id_++, pos_w, curr_keyfrm);
 
         // set the associations to the new keyframe
         lm->connect_to_keyframe(curr_keyfrm, idx);
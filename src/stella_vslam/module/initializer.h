@@ -6,6 +6,7 @@
 #include "stella_vslam/data/bow_vocabulary_fwd.h"
 
 #include <memory>
+#include <vector>
 
 namespace stella_vslam {
 
@@ -17,6 +18,10 @@ class map_database;
 class bow_database;
 } // namespace data
 
+namespace util {
+class thread_pool;
+} // namespace util
+
 namespace module {
 
 // initializer state
@@ -53,6 +58,9 @@ public:
     //! Get whether to use a fixed seed for RANSAC
     bool get_use_fixed_seed() const;
 
+    //! Replace the worker threads with the thread pool shared among the modules (call before the initialization starts)
+    void set_thread_pool(const std::shared_ptr<util::thread_pool>& thread_pool);
+
     //! Initialize with the current frame
     bool initialize(const camera::setup_type_t setup_type,
                     data::bow_vocabulary* bow_vocab, data::frame& curr_frm);
@@ -89,13 +97,34 @@ private:
     const float scaling_factor_;
     //! Use fixed random seed for RANSAC if true
     const bool use_fixed_seed_;
+    //! max number of reference frames whose initialization attempts overlap (only for monocular initializer)
+    const unsigned int num_reference_frms_;
+    //! min number of frames between the reference frames (only for monocular initializer)
+    const unsigned int reference_frm_interval_;
 
     //-----------------------------------------
     // for monocular camera model
 
+    //! reference frame of the monocular initialization, which is tracked with the area-based matching
+    struct reference {
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+        //! reference frame
+        data::frame frm_;
+        //! coordinates of previously matched points to perform area-based matching
+        std::vector<cv::Point2f> prev_matched_coords_;
+        //! matching indices (index: idx of reference frame, value: idx of current frame)
+        std::vector<int> matches_;
+        //! initializer with the reference frame
+        std::unique_ptr<initialize::base> initializer_;
+    };
+
     //! Create initializer for monocular
     void create_initializer(data::frame& curr_frm);
 
+    //! Add the current frame as a reference frame
+    void add_reference(data::frame& curr_frm);
+
     //! Try to initialize a map with monocular camera setup
     bool try_initialize_for_monocular(data::frame& curr_frm);
 
@@ -105,12 +134,15 @@ private:
     //! Scaling up or down a initial map
     void scale_map(const std::shared_ptr<data::keyframe>& init_keyfrm, const std::shared_ptr<data::keyframe>& curr_keyfrm, const double scale);
 
-    //! initializer for monocular
+    //! reference frames in the order of the frame ID (the oldest one has the largest parallax)
+    std::vector<std::unique_ptr<reference>> references_;
+    //! worker threads to attempt the initialization against the reference frames concurrently
+    std::shared_ptr<util::thread_pool> thread_pool_;
+
+    //! initializer for monocular (moved from the reference which succeeded in initialization)
     std::unique_ptr<initialize::base> initializer_ = nullptr;
     //! initial frame
     data::frame init_frm_;
-    //! coordinates of previously matched points to perform area-based matching
-    std::vector<cv::Point2f> prev_matched_coords_;
     //! initial matching indices (index: idx of initial frame, value: idx of current frame)
     std::vector<int> init_matches_;
 
@@ -4,6 +4,9 @@
 #include "stella_vslam/data/map_database.h"
 #include "stella_vslam/marker_model/base.h"
 #include "stella_vslam/module/keyframe_inserter.h"
+#include "stella_vslam/util/keyframe_tracer.h"
+
+#include <limits>
 
 #include <spdlog/spdlog.h>
 
@@ -15,13 +18,17 @@ keyframe_inserter::keyframe_inserter(const double max_interval,
                                      const double max_distance,
                                      const double lms_ratio_thr_almost_all_lms_are_tracked,
                                      const double lms_ratio_thr_view_changed,
-                                     const unsigned int enough_lms_thr)
+                                     const unsigned int enough_lms_thr,
+                                     const bool materialize_in_mapping_module,
+                                     const keyframe_rate_controller& rate_controller)
     : max_interval_(max_interval),
       min_interval_(min_interval),
       max_distance_(max_distance),
       lms_ratio_thr_almost_all_lms_are_tracked_(lms_ratio_thr_almost_all_lms_are_tracked),
       lms_ratio_thr_view_changed_(lms_ratio_thr_view_changed),
-      enough_lms_thr_(enough_lms_thr) {}
+      enough_lms_thr_(enough_lms_thr),
+      materialize_in_mapping_module_(materialize_in_mapping_module),
+      rate_controller_(rate_controller) {}
 
 keyframe_inserter::keyframe_inserter(const YAML::Node& yaml_node)
     : keyframe_inserter(yaml_node["max_interval"].as<double>(1.0),
@@ -29,12 +36,18 @@ keyframe_inserter::keyframe_inserter(const YAML::Node& yaml_node)
                         yaml_node["max_distance"].as<double>(-1.0),
                         yaml_node["lms_ratio_thr_almost_all_lms_are_tracked"].as<double>(0.9),
                         yaml_node["lms_ratio_thr_view_changed"].as<double>(0.5),
-                        yaml_node["enough_lms_thr"].as<unsigned int>(100)) {}
+                        yaml_node["enough_lms_thr"].as<unsigned int>(100),
+                        yaml_node["materialize_in_mapping_module"].as<bool>(false),
+                        keyframe_rate_controller(yaml_node)) {}
 
 void keyframe_inserter::set_mapping_module(mapping_module* mapper) {
     mapper_ = mapper;
 }
 
+void keyframe_inserter::set_keyframe_tracer(const std::shared_ptr<util::keyframe_tracer>& keyfrm_tracer) {
+    keyfrm_tracer_ = keyfrm_tracer;
+}
+
 void keyframe_inserter::reset() {
 }
 
@@ -96,16 +109,68 @@ bool keyframe_inserter::new_keyframe_is_needed(data::map_database* map_db,
     SPDLOG_TRACE("keyframe_inserter: tracking_is_unstable={}", tracking_is_unstable);
     SPDLOG_TRACE("keyframe_inserter: almost_all_lms_are_tracked={}", almost_all_lms_are_tracked);
     SPDLOG_TRACE("keyframe_inserter: mapper_is_skipping_localBA={}", mapper_is_skipping_localBA);
-    return (max_interval_elapsed || max_distance_traveled || view_changed || not_enough_lms)
-           && (!enough_keyfrms || min_interval_elapsed)
-           && !tracking_is_unstable
-           && !almost_all_lms_are_tracked
-           && !mapper_is_skipping_localBA;
+    const bool is_needed = (max_interval_elapsed || max_distance_traveled || view_changed || not_enough_lms)
+                           && (!enough_keyfrms || min_interval_elapsed)
+                           && !tracking_is_unstable
+                           && !almost_all_lms_are_tracked
+                           && !mapper_is_skipping_localBA;
+    if (!is_needed || !rate_controller_.is_enabled()) {
+        return is_needed;
+    }
+
+    // pace the insertion by the backlog of the mapping module
+    // (the deferred candidate is replaced by the following frames, so the redundant candidates are coalesced)
+    const double elapsed_ms = last_inserted_keyfrm
+                                  ? 1000.0 * (curr_frm.timestamp_ - last_inserted_keyfrm->timestamp_)
+                                  : std::numeric_limits<double>::max();
+    if (!rate_controller_.accepts(mapper_->get_num_queued_keyframes(), mapper_->is_idle(), mapper_->get_mean_keyframe_mapping_ms(),
+                                  elapsed_ms, not_enough_lms)) {
+        SPDLOG_TRACE("keyframe_inserter: the keyframe is deferred by the backlog of the mapping module");
+        return false;
+    }
+    return true;
 }
 
 std::shared_ptr<data::keyframe> keyframe_inserter::insert_new_keyframe(data::map_database* map_db,
                                                                        data::frame& curr_frm) {
     auto keyfrm = data::keyframe::make_keyframe(map_db->next_keyframe_id_++, curr_frm);
+    if (keyfrm_tracer_) {
+        keyfrm_tracer_->record(keyfrm->id_, util::keyframe_stage_t::Created);
+    }
+
+    if (materialize_in_mapping_module_) {
+        // Queue up the keyframe with its materialization, which is carried out on the mapping thread
+        // (the map database is locked by the mapping module while materializing)
+        std::weak_ptr<data::keyframe> weak_keyfrm = keyfrm;
+        mapper_->queue_keyframe(keyfrm, [this, map_db, weak_keyfrm] {
+            if (auto keyfrm = weak_keyfrm.lock()) {
+                materialize_keyframe(map_db, keyfrm, nullptr);
+            }
+        });
+        return keyfrm;
+    }
+
+    materialize_keyframe(map_db, keyfrm, &curr_frm);
+
+    // Queue up the keyframe to the mapping module
+    queue_keyframe(keyfrm);
+    return keyfrm;
+}
+
+void keyframe_inserter::materialize_keyframe(data::map_database* map_db,
+                                             const std::shared_ptr<data::keyframe>& keyfrm,
+                                             data::frame* curr_frm) const {
+    if (!curr_frm) {
+        // Discard the landmarks which have been erased since the keyframe was created,
+        // because the keyframe is not yet registered as their observation
+        const auto lms = keyfrm->get_landmarks();
+        for (unsigned int idx = 0; idx < lms.size(); ++idx) {
+            if (lms.at(idx) && lms.at(idx)->will_be_erased()) {
+                keyfrm->erase_landmark_with_index(idx);
+            }
+        }
+    }
+
     keyfrm->update_landmarks();
 
     for (const auto& id_mkr2d : keyfrm->markers_2d_) {
@@ -123,28 +188,26 @@ std::shared_ptr<data::keyframe> keyframe_inserter::insert_new_keyframe(data::map
         marker->observations_.push_back(keyfrm);
     }
 
-    // Queue up the keyframe to the mapping module
     if (!keyfrm->depth_is_available()) {
-        queue_keyframe(keyfrm);
-        return keyfrm;
+        return;
     }
 
     // Save the valid depth and index pairs
+    const auto& frm_obs = keyfrm->frm_obs_;
     std::vector<std::pair<float, unsigned int>> depth_idx_pairs;
-    depth_idx_pairs.reserve(curr_frm.frm_obs_.num_keypts_);
-    for (unsigned int idx = 0; idx < curr_frm.frm_obs_.num_keypts_; ++idx) {
-        assert(!curr_frm.frm_obs_.depths_.empty());
-        const auto depth = curr_frm.frm_obs_.depths_.at(idx);
+    depth_idx_pairs.reserve(frm_obs->num_keypts_);
+    for (unsigned int idx = 0; idx < frm_obs->num_keypts_; ++idx) {
+        assert(!frm_obs->depths_.empty());
+        const auto depth = frm_obs->depths_.at(idx);
         // Add if the depth is valid
         if (0 < depth) {
             depth_idx_pairs.emplace_back(std::make_pair(depth, idx));
         }
     }
 
-    // Queue up the keyframe to the mapping module if any valid depth values don't exist
+    // Any landmarks are not created if any valid depth values don't exist
     if (depth_idx_pairs.empty()) {
-        queue_keyframe(keyfrm);
-        return keyfrm;
+        return;
     }
 
     // Sort in order of distance to the camera
@@ -163,8 +226,9 @@ std::shared_ptr<data::keyframe> keyframe_inserter::insert_new_keyframe(data::map
         }
 
         // Stereo-triangulation cannot be performed if the 3D point has been already associated to the keypoint index
+        // (the landmarks of the keyframe are copied from the current frame)
         {
-            const auto& lm = curr_frm.get_landmark(idx);
+            const auto lm = keyfrm->get_landmark(idx);
             if (lm) {
                 assert(lm->has_observation());
                 continue;
@@ -172,21 +236,19 @@ std::shared_ptr<data::keyframe> keyframe_inserter::insert_new_keyframe(data::map
         }
 
         // Stereo-triangulation can be performed if the 3D point is not yet associated to the keypoint index
-        const Vec3_t pos_w = curr_frm.triangulate_stereo(idx);
-        auto lm = std::make_shared<data::landmark>(map_db->next_landmark_id_++, pos_w, keyfrm);
+        const Vec3_t pos_w = keyfrm->triangulate_stereo(idx);
+        auto lm = data::landmark::create(map_db->next_landmark_id_++, pos_w, keyfrm);
 
         lm->connect_to_keyframe(keyfrm, idx);
-        curr_frm.add_landmark(lm, idx);
+        if (curr_frm) {
+            curr_frm->add_landmark(lm, idx);
+        }
 
         lm->compute_descriptor();
         lm->update_mean_normal_and_obs_scale_variance();
 
         map_db->add_landmark(lm);
     }
-
-    // Queue up the keyframe to the mapping module
-    queue_keyframe(keyfrm);
-    return keyfrm;
 }
 
 void keyframe_inserter::queue_keyframe(const std::shared_ptr<data::keyframe>& keyfrm) {
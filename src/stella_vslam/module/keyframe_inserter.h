@@ -4,6 +4,7 @@
 #include "stella_vslam/camera/base.h"
 #include "stella_vslam/data/frame.h"
 #include "stella_vslam/data/keyframe.h"
+#include "stella_vslam/module/keyframe_rate_controller.h"
 
 #include <memory>
 
@@ -15,6 +16,10 @@ namespace data {
 class map_database;
 } // namespace data
 
+namespace util {
+class keyframe_tracer;
+} // namespace util
+
 namespace module {
 
 class keyframe_inserter {
@@ -24,7 +29,9 @@ public:
                                const double max_distance = -1.0,
                                const double lms_ratio_thr_almost_all_lms_are_tracked = 0.9,
                                const double lms_ratio_thr_view_changed = 0.8,
-                               const unsigned int enough_lms_thr = 100);
+                               const unsigned int enough_lms_thr = 100,
+                               const bool materialize_in_mapping_module = false,
+                               const keyframe_rate_controller& rate_controller = keyframe_rate_controller());
 
     explicit keyframe_inserter(const YAML::Node& yaml_node);
 
@@ -32,6 +39,9 @@ public:
 
     void set_mapping_module(mapping_module* mapper);
 
+    //! Set the tracer which records the times when the keyframes are created
+    void set_keyframe_tracer(const std::shared_ptr<util::keyframe_tracer>& keyfrm_tracer);
+
     void reset();
 
     /**
@@ -46,10 +56,18 @@ public:
 
     /**
      * Insert the new keyframe derived from the current frame
+     * (if materialize_in_mapping_module_ is true, only the keyframe is created here,
+     *  and the rest of the construction is carried out on the mapping thread, see materialize_keyframe())
      */
     std::shared_ptr<data::keyframe> insert_new_keyframe(data::map_database* map_db, data::frame& curr_frm);
 
 private:
+    /**
+     * Register the keyframe to the observed landmarks, create the markers and the landmarks from the valid depths
+     * (the new landmarks are also set to curr_frm if it is given)
+     */
+    void materialize_keyframe(data::map_database* map_db, const std::shared_ptr<data::keyframe>& keyfrm, data::frame* curr_frm) const;
+
     /**
      * Queue the new keyframe to the mapping module
      */
@@ -58,6 +76,9 @@ private:
     //! mapping module
     mapping_module* mapper_ = nullptr;
 
+    //! keyframe tracer (nullptr if not set)
+    std::shared_ptr<util::keyframe_tracer> keyfrm_tracer_ = nullptr;
+
     //! max interval to insert keyframe
     const double max_interval_ = 1.0;
     const double min_interval_ = 0.1;
@@ -68,6 +89,13 @@ private:
     const double lms_ratio_thr_view_changed_ = 0.8;
 
     const unsigned int enough_lms_thr_ = 100;
+
+    //! If true, the keyframe is materialized on the mapping thread instead of the tracking thread
+    //! (NOTE: the landmarks created from the depths are not set to the current frame in this case)
+    const bool materialize_in_mapping_module_ = false;
+
+    //! controller which defers the candidates by the backlog of the mapping module
+    const keyframe_rate_controller rate_controller_;
 };
 
 } // namespace module
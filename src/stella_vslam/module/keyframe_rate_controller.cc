@@ -0,0 +1,49 @@
+#include "stella_vslam/module/keyframe_rate_controller.h"
+
+#include <stdexcept>
+
+#include <yaml-cpp/yaml.h>
+
+namespace stella_vslam {
+namespace module {
+
+keyframe_rate_controller::keyframe_rate_controller(const double target_latency_ms,
+                                                   const unsigned int max_num_queued_keyfrms,
+                                                   const double max_utilization)
+    : target_latency_ms_(target_latency_ms), max_num_queued_keyfrms_(max_num_queued_keyfrms), max_utilization_(max_utilization) {
+    if (max_utilization_ <= 0.0) {
+        throw std::runtime_error("max_mapping_utilization must be greater than 0");
+    }
+}
+
+keyframe_rate_controller::keyframe_rate_controller(const YAML::Node& yaml_node)
+    : keyframe_rate_controller(yaml_node["target_mapping_latency_ms"].as<double>(0.0),
+                               yaml_node["max_num_queued_keyframes"].as<unsigned int>(0),
+                               yaml_node["max_mapping_utilization"].as<double>(0.9)) {}
+
+double keyframe_rate_controller::predict_latency_ms(const unsigned int num_queued_keyfrms, const bool mapper_is_idle, const double mean_mapping_ms) {
+    // the new keyframe waits for the queued ones and the one being mapped
+    // (half of the keyframe being mapped is left on average)
+    const double num_waiting_keyfrms = num_queued_keyfrms + (mapper_is_idle ? 0.0 : 0.5);
+    return (num_waiting_keyfrms + 1.0) * mean_mapping_ms;
+}
+
+bool keyframe_rate_controller::accepts(const unsigned int num_queued_keyfrms, const bool mapper_is_idle, const double mean_mapping_ms,
+                                       const double elapsed_since_last_keyfrm_ms, const bool is_urgent) const {
+    // the queue is bounded even for the urgent candidates
+    if (0 < max_num_queued_keyfrms_ && max_num_queued_keyfrms_ <= num_queued_keyfrms) {
+        return false;
+    }
+    // the throughput of the mapping module is unknown until a keyframe is mapped
+    if (is_urgent || target_latency_ms_ <= 0.0 || mean_mapping_ms <= 0.0) {
+        return true;
+    }
+    if (target_latency_ms_ < predict_latency_ms(num_queued_keyfrms, mapper_is_idle, mean_mapping_ms)) {
+        return false;
+    }
+    // do not insert the keyframes faster than the mapping module can process them
+    return mean_mapping_ms <= max_utilization_ * elapsed_since_last_keyfrm_ms;
+}
+
+} // namespace module
+} // namespace stella_vslam
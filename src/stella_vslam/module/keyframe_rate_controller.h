@@ -0,0 +1,72 @@
+#ifndef STELLA_VSLAM_MODULE_KEYFRAME_RATE_CONTROLLER_H
+#define STELLA_VSLAM_MODULE_KEYFRAME_RATE_CONTROLLER_H
+
+namespace YAML {
+class Node;
+} // namespace YAML
+
+namespace stella_vslam {
+namespace module {
+
+/**
+ * Controller which paces the keyframe insertion by the backlog of the mapping module
+ * The latency of a new keyframe is predicted from the queued keyframes and the measured time to map a keyframe,
+ * and the candidates are deferred while it exceeds the target latency.
+ * The deferred candidates are coalesced, since the tracker only inserts the latest one when the backlog is consumed.
+ * The urgent candidates (e.g. too few tracked landmarks) are deferred only by the hard limit of the queue.
+ */
+class keyframe_rate_controller {
+public:
+    /**
+     * Constructor
+     * @param target_latency_ms target time from the insertion to the end of the mapping of a keyframe [ms] (0 disables the pacing)
+     * @param max_num_queued_keyfrms hard limit of the queued keyframes (0 disables the limit)
+     * @param max_utilization max ratio of the time of the mapping module spent on the keyframes
+     */
+    keyframe_rate_controller(const double target_latency_ms = 0.0,
+                             const unsigned int max_num_queued_keyfrms = 0,
+                             const double max_utilization = 0.9);
+
+    /**
+     * Constructor
+     * @param yaml_node (the "KeyframeInserter" section)
+     */
+    explicit keyframe_rate_controller(const YAML::Node& yaml_node);
+
+    //! The controller defers any candidate or not
+    bool is_enabled() const { return 0.0 < target_latency_ms_ || 0 < max_num_queued_keyfrms_; }
+
+    /**
+     * Predict the latency of a keyframe inserted now
+     * @param num_queued_keyfrms number of the keyframes in the queue of the mapping module
+     * @param mapper_is_idle the mapping module is idle or not
+     * @param mean_mapping_ms mean time to map a keyframe [ms]
+     * @return
+     */
+    static double predict_latency_ms(const unsigned int num_queued_keyfrms, const bool mapper_is_idle, const double mean_mapping_ms);
+
+    /**
+     * Check if a candidate of the keyframe can be inserted now
+     * @param num_queued_keyfrms number of the keyframes in the queue of the mapping module
+     * @param mapper_is_idle the mapping module is idle or not
+     * @param mean_mapping_ms mean time to map a keyframe [ms] (0 if unknown)
+     * @param elapsed_since_last_keyfrm_ms time since the last keyframe was inserted [ms]
+     * @param is_urgent the candidate is urgent or not
+     * @return
+     */
+    bool accepts(const unsigned int num_queued_keyfrms, const bool mapper_is_idle, const double mean_mapping_ms,
+                 const double elapsed_since_last_keyfrm_ms, const bool is_urgent) const;
+
+private:
+    //! target time from the insertion to the end of the mapping of a keyframe [ms]
+    const double target_latency_ms_;
+    //! hard limit of the queued keyframes
+    const unsigned int max_num_queued_keyfrms_;
+    //! max ratio of the time of the mapping module spent on the keyframes
+    const double max_utilization_;
+};
+
+} // namespace module
+} // namespace stella_vslam
+
+#endif // STELLA_VSLAM_MODULE_KEYFRAME_RATE_CONTROLLER_H
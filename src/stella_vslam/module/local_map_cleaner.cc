@@ -3,6 +3,11 @@
 #include "stella_vslam/data/map_database.h"
 #include "stella_vslam/module/local_map_cleaner.h"
 
+#include <algorithm>
+#include <unordered_set>
+
+#include <spdlog/spdlog.h>
+
 namespace stella_vslam {
 namespace module {
 
@@ -11,81 +16,110 @@ local_map_cleaner::local_map_cleaner(const YAML::Node& yaml_node, data::map_data
       redundant_obs_ratio_thr_(yaml_node["redundant_obs_ratio_thr"].as<double>(0.9)),
       observed_ratio_thr_(yaml_node["observed_ratio_thr"].as<double>(0.3)),
       num_reliable_keyfrms_(yaml_node["num_reliable_keyfrms"].as<unsigned int>(2)),
-      top_n_covisibilities_to_search_(yaml_node["top_n_covisibilities_to_search"].as<unsigned int>(30)) {}
+      top_n_covisibilities_to_search_(yaml_node["top_n_covisibilities_to_search"].as<unsigned int>(30)),
+      max_num_keyfrms_(yaml_node["max_num_keyframes"].as<unsigned int>(0)),
+      num_summarized_keyfrms_per_batch_(yaml_node["num_summarized_keyframes_per_batch"].as<unsigned int>(10)),
+      descriptor_compaction_window_(yaml_node["descriptor_compaction_window"].as<unsigned int>(0)) {}
 
 void local_map_cleaner::reset() {
     fresh_landmarks_.clear();
+    redundant_keyfrm_candidates_.clear();
+    redundant_keyfrm_candidate_ids_.clear();
+    keyfrms_to_compact_.clear();
+}
+
+void local_map_cleaner::add_fresh_landmark(std::shared_ptr<data::landmark>& lm) {
+    fresh_landmarks_[lm->first_keyfrm_id_].push_back(lm);
 }
 
 unsigned int local_map_cleaner::remove_invalid_landmarks(const unsigned int cur_keyfrm_id) {
-    std::lock_guard<std::mutex> lock(data::map_database::mtx_database_);
-    // states of observed landmarks
-    enum class lm_state_t { Valid,
-                            Invalid,
-                            NotClear };
+    std::lock_guard<util::profiled_mutex> lock(data::map_database::mtx_database_);
 
-    unsigned int num_removed = 0;
-    auto iter = fresh_landmarks_.begin();
-    while (iter != fresh_landmarks_.end()) {
-        const auto& lm = *iter;
+    // IDs of the landmarks to erase from the database at once
+    std::vector<unsigned int> invalid_lm_ids;
 
-        // decide the state of lms the buffer
-        auto lm_state = lm_state_t::NotClear;
-        if (lm->will_be_erased()) {
-            // in case `lm` will be erased
-            // remove `lm` from the buffer
-            lm_state = lm_state_t::Valid;
-        }
-        else if (lm->get_observed_ratio() < observed_ratio_thr_) {
-            // if `lm` is not reliable
-            // remove `lm` from the buffer and the database
-            lm_state = lm_state_t::Invalid;
-        }
-        else if (num_reliable_keyfrms_ + lm->first_keyfrm_id_ < cur_keyfrm_id) {
-            // if the number of the observers of `lm` is sufficient after some keyframes were inserted
-            // remove `lm` from the buffer
-            lm_state = lm_state_t::Valid;
-        }
+    auto bucket_iter = fresh_landmarks_.begin();
+    while (bucket_iter != fresh_landmarks_.end()) {
+        // if the number of the observers of the landmarks is sufficient after some keyframes were inserted,
+        // remove the bucket from the buffer after checking the reliability
+        const bool is_reliable = num_reliable_keyfrms_ + bucket_iter->first < cur_keyfrm_id;
 
-        // select to remove `lm` according to the state
-        if (lm_state == lm_state_t::Valid) {
-            iter = fresh_landmarks_.erase(iter);
-        }
-        else if (lm_state == lm_state_t::Invalid) {
-            ++num_removed;
-            lm->prepare_for_erasing(map_db_);
-            iter = fresh_landmarks_.erase(iter);
+        auto& bucket = bucket_iter->second;
+        const auto end = std::remove_if(bucket.begin(), bucket.end(), [&](const std::shared_ptr<data::landmark>& lm) {
+            if (lm->will_be_erased()) {
+                // in case `lm` will be erased
+                // remove `lm` from the buffer
+                return true;
+            }
+            if (lm->get_observed_ratio() < observed_ratio_thr_) {
+                // if `lm` is not reliable
+                // remove `lm` from the buffer and the database
+                lm->prepare_for_erasing();
+                invalid_lm_ids.push_back(lm->id_);
+                return true;
+            }
+            // hold decision if the state is not clear
+            return is_reliable;
+        });
+        bucket.erase(end, bucket.end());
+
+        if (bucket.empty()) {
+            bucket_iter = fresh_landmarks_.erase(bucket_iter);
         }
         else {
-            // hold decision because the state is NotClear
-            iter++;
+            ++bucket_iter;
         }
     }
 
-    return num_removed;
+    map_db_->erase_landmarks(invalid_lm_ids);
+
+    return invalid_lm_ids.size();
 }
 
-unsigned int local_map_cleaner::remove_redundant_keyframes(const std::shared_ptr<data::keyframe>& cur_keyfrm) const {
+void local_map_cleaner::queue_redundant_keyframe_candidates(const std::shared_ptr<data::keyframe>& cur_keyfrm) {
     if (redundant_obs_ratio_thr_ < 0.0 || top_n_covisibilities_to_search_ <= 0) {
-        return 0;
+        return;
     }
 
-    std::lock_guard<std::mutex> lock(data::map_database::mtx_database_);
+    std::lock_guard<util::profiled_mutex> lock(data::map_database::mtx_database_);
+    latest_keyfrm_id_ = cur_keyfrm->id_;
+    // check redundancy for each of the covisibilities
+    const auto cur_covisibilities = cur_keyfrm->graph_node_->get_top_n_covisibilities(top_n_covisibilities_to_search_);
+    for (const auto& covisibility : cur_covisibilities) {
+        // the keyframe already queued is checked only once
+        if (redundant_keyfrm_candidate_ids_.insert(covisibility->id_).second) {
+            redundant_keyfrm_candidates_.push_back(covisibility);
+        }
+    }
+}
+
+unsigned int local_map_cleaner::remove_redundant_keyframes(const std::function<bool()>& abort_is_requested) {
     // window size not to remove
     constexpr unsigned int window_size_not_to_remove = 2;
     // if the redundancy ratio of observations is larger than this threshold,
     // the corresponding keyframe will be erased
     unsigned int num_removed = 0;
-    // check redundancy for each of the covisibilities
-    const auto cur_covisibilities = cur_keyfrm->graph_node_->get_top_n_covisibilities(top_n_covisibilities_to_search_);
-    for (const auto& covisibility : cur_covisibilities) {
+    while (!redundant_keyfrm_candidates_.empty()) {
+        if (abort_is_requested && abort_is_requested()) {
+            break;
+        }
+
+        const auto covisibility = redundant_keyfrm_candidates_.front();
+        redundant_keyfrm_candidates_.pop_front();
+        redundant_keyfrm_candidate_ids_.erase(covisibility->id_);
+
+        std::lock_guard<util::profiled_mutex> lock(data::map_database::mtx_database_);
+        // the keyframe might be erased after it was queued
+        if (covisibility->will_be_erased()) {
+            continue;
+        }
         // cannot remove the root node
         if (covisibility->graph_node_->is_spanning_root()) {
             continue;
         }
         // cannot remove the recent keyframe(s)
-        if (covisibility->id_ <= cur_keyfrm->id_
-            && cur_keyfrm->id_ <= covisibility->id_ + window_size_not_to_remove) {
+        if (covisibility->id_ <= latest_keyfrm_id_
+            && latest_keyfrm_id_ <= covisibility->id_ + window_size_not_to_remove) {
             continue;
         }
 
@@ -100,26 +134,181 @@ unsigned int local_map_cleaner::remove_redundant_keyframes(const std::shared_ptr
             ++num_removed;
             const auto cur_landmarks = covisibility->get_landmarks();
             covisibility->prepare_for_erasing(map_db_, bow_db_);
-            for (const auto& lm : cur_landmarks) {
-                if (!lm) {
-                    continue;
-                }
-                if (lm->will_be_erased()) {
-                    continue;
-                }
-                if (!lm->has_representative_descriptor()) {
-                    lm->compute_descriptor();
-                }
-                if (!lm->has_valid_prediction_parameters()) {
-                    lm->update_mean_normal_and_obs_scale_variance();
-                }
+            update_landmarks_of_erased_keyframes(cur_landmarks);
+        }
+    }
+
+    return num_removed;
+}
+
+bool local_map_cleaner::map_summarization_is_needed() const {
+    return 0 < max_num_keyfrms_ && max_num_keyfrms_ < map_db_->get_num_keyframes();
+}
+
+unsigned int local_map_cleaner::summarize_map(const std::function<bool()>& abort_is_requested) {
+    // window size not to remove
+    constexpr unsigned int window_size_not_to_remove = 2;
+
+    unsigned int num_removed = 0;
+    while (map_summarization_is_needed()) {
+        if (abort_is_requested && abort_is_requested()) {
+            break;
+        }
+
+        std::lock_guard<util::profiled_mutex> lock(data::map_database::mtx_database_);
+        const auto num_keyfrms = map_db_->get_num_keyframes();
+        if (num_keyfrms <= max_num_keyfrms_) {
+            break;
+        }
+        const auto num_keyfrms_to_remove = std::min(num_keyfrms - max_num_keyfrms_, std::max(1u, num_summarized_keyfrms_per_batch_));
+
+        const auto keyfrms = map_db_->get_all_keyframes();
+        unsigned int max_keyfrm_id = 0;
+        for (const auto& keyfrm : keyfrms) {
+            max_keyfrm_id = std::max(max_keyfrm_id, keyfrm->id_);
+        }
+
+        // score the candidates with the number of the observations which are not redundant
+        std::vector<std::pair<unsigned int, std::shared_ptr<data::keyframe>>> utility_keyfrm_pairs;
+        utility_keyfrm_pairs.reserve(keyfrms.size());
+        for (const auto& keyfrm : keyfrms) {
+            if (keyfrm->will_be_erased()) {
+                continue;
+            }
+            // cannot remove the root node
+            if (keyfrm->graph_node_->is_spanning_root()) {
+                continue;
+            }
+            // keep the keyframes which hold the loop constraints
+            if (keyfrm->graph_node_->has_loop_edge()) {
+                continue;
+            }
+            // cannot remove the recent keyframe(s)
+            if (max_keyfrm_id <= keyfrm->id_ + window_size_not_to_remove) {
+                continue;
+            }
+
+            unsigned int num_redundant_obs = 0;
+            unsigned int num_valid_obs = 0;
+            count_redundant_observations(keyfrm, num_valid_obs, num_redundant_obs);
+            utility_keyfrm_pairs.emplace_back(num_valid_obs - num_redundant_obs, keyfrm);
+        }
+        if (utility_keyfrm_pairs.empty()) {
+            break;
+        }
+
+        // the lowest utility first (the older one first if tied)
+        std::sort(utility_keyfrm_pairs.begin(), utility_keyfrm_pairs.end(),
+                  [](const std::pair<unsigned int, std::shared_ptr<data::keyframe>>& a,
+                     const std::pair<unsigned int, std::shared_ptr<data::keyframe>>& b) {
+                      return a.first != b.first ? a.first < b.first : a.second->id_ < b.second->id_;
+                  });
+
+        // the neighbors of the selected keyframes in the spanning tree are left for the next batch
+        std::vector<std::shared_ptr<data::keyframe>> keyfrms_to_remove;
+        std::unordered_set<unsigned int> excluded_keyfrm_ids;
+        for (const auto& utility_keyfrm : utility_keyfrm_pairs) {
+            if (num_keyfrms_to_remove <= keyfrms_to_remove.size()) {
+                break;
+            }
+            const auto& keyfrm = utility_keyfrm.second;
+            if (excluded_keyfrm_ids.count(keyfrm->id_)) {
+                continue;
+            }
+            keyfrms_to_remove.push_back(keyfrm);
+            const auto parent = keyfrm->graph_node_->get_spanning_parent();
+            if (parent) {
+                excluded_keyfrm_ids.insert(parent->id_);
+            }
+            for (const auto& child : keyfrm->graph_node_->get_spanning_children()) {
+                excluded_keyfrm_ids.insert(child->id_);
             }
         }
+
+        std::vector<std::shared_ptr<data::landmark>> landmarks;
+        for (const auto& keyfrm : keyfrms_to_remove) {
+            const auto keyfrm_landmarks = keyfrm->get_landmarks();
+            landmarks.insert(landmarks.end(), keyfrm_landmarks.begin(), keyfrm_landmarks.end());
+        }
+        const auto num_removed_in_batch = data::keyframe::prepare_for_erasing(keyfrms_to_remove, map_db_, bow_db_);
+        update_landmarks_of_erased_keyframes(landmarks);
+
+        num_removed += num_removed_in_batch;
+        if (num_removed_in_batch == 0) {
+            break;
+        }
     }
 
+    if (0 < num_removed) {
+        spdlog::debug("map summarization: removed {} keyframes", num_removed);
+    }
     return num_removed;
 }
 
+void local_map_cleaner::queue_keyframe_to_compact(const std::shared_ptr<data::keyframe>& keyfrm) {
+    if (descriptor_compaction_window_ == 0) {
+        return;
+    }
+    keyfrms_to_compact_.push_back(keyfrm);
+}
+
+unsigned int local_map_cleaner::compact_keyframe_descriptors(const std::function<bool()>& abort_is_requested) {
+    if (keyfrms_to_compact_.size() <= descriptor_compaction_window_) {
+        return 0;
+    }
+
+    // the keyframes in the local map of the latest one are kept hydrated
+    const auto latest_keyfrm = keyfrms_to_compact_.back();
+    std::unordered_set<unsigned int> local_keyfrm_ids;
+    for (const auto& local_keyfrm : latest_keyfrm->graph_node_->get_top_n_covisibilities(top_n_covisibilities_to_search_)) {
+        local_keyfrm_ids.insert(local_keyfrm->id_);
+        if (local_keyfrm->descriptors_are_compacted()) {
+            local_keyfrm->hydrate_descriptors();
+            keyfrms_to_compact_.push_back(local_keyfrm);
+        }
+    }
+
+    unsigned int num_compacted = 0;
+    // (the keyframes in the local map are queued again, and checked after the window passes)
+    const auto num_candidates = keyfrms_to_compact_.size() - descriptor_compaction_window_;
+    for (unsigned int i = 0; i < num_candidates; ++i) {
+        if (abort_is_requested && abort_is_requested()) {
+            break;
+        }
+        const auto keyfrm = keyfrms_to_compact_.front();
+        keyfrms_to_compact_.pop_front();
+        if (keyfrm->will_be_erased()) {
+            continue;
+        }
+        if (local_keyfrm_ids.count(keyfrm->id_)) {
+            keyfrms_to_compact_.push_back(keyfrm);
+            continue;
+        }
+        if (keyfrm->compact_descriptors()) {
+            ++num_compacted;
+        }
+    }
+
+    return num_compacted;
+}
+
+void local_map_cleaner::update_landmarks_of_erased_keyframes(const std::vector<std::shared_ptr<data::landmark>>& landmarks) const {
+    for (const auto& lm : landmarks) {
+        if (!lm) {
+            continue;
+        }
+        if (lm->will_be_erased()) {
+            continue;
+        }
+        if (!lm->has_representative_descriptor()) {
+            lm->compute_descriptor();
+        }
+        if (!lm->has_valid_prediction_parameters()) {
+            lm->update_mean_normal_and_obs_scale_variance();
+        }
+    }
+}
+
 void local_map_cleaner::count_redundant_observations(const std::shared_ptr<data::keyframe>& keyfrm, unsigned int& num_valid_obs, unsigned int& num_redundant_obs) const {
     // if the number of keyframes that observes the landmark with more reliable scale than the specified keyframe does,
     // it is considered as redundant
@@ -140,8 +329,8 @@ void local_map_cleaner::count_redundant_observations(const std::shared_ptr<data:
 
         // if depth is within the valid range, it won't be considered
         if (keyfrm->depth_is_available()) {
-            assert(!keyfrm->frm_obs_.depths_.empty());
-            const auto depth = keyfrm->frm_obs_.depths_.at(idx);
+            assert(!keyfrm->frm_obs_->depths_.empty());
+            const auto depth = keyfrm->frm_obs_->depths_.at(idx);
             if (depth < 0.0 || keyfrm->camera_->depth_thr_ < depth) {
                 continue;
             }
@@ -155,36 +344,15 @@ void local_map_cleaner::count_redundant_observations(const std::shared_ptr<data:
         }
 
         // `keyfrm` observes `lm` with the scale level `scale_level`
-        const auto scale_level = keyfrm->frm_obs_.undist_keypts_.at(idx).octave;
-        // get observers of `lm`
-        const auto observations = lm->get_observations();
+        const unsigned int scale_level = keyfrm->frm_obs_->undist_keypts_.at(idx).octave;
 
-        bool obs_by_keyfrm_is_redundant = false;
+        // the number of the keyframes that observe `lm` with the more reliable (closer) scale,
+        // which includes `keyfrm` itself
+        const auto num_better_obs = lm->num_observations_up_to_scale_level(scale_level + 1);
 
-        // the number of the keyframes that observe `lm` with the more reliable (closer) scale
-        unsigned int num_better_obs = 0;
-
-        for (const auto& obs : observations) {
-            const auto ngh_keyfrm = obs.first.lock();
-            if (*ngh_keyfrm == *keyfrm) {
-                continue;
-            }
-
-            // `ngh_keyfrm` observes `lm` with the scale level `ngh_scale_level`
-            const auto ngh_scale_level = ngh_keyfrm->frm_obs_.undist_keypts_.at(obs.second).octave;
-
-            // compare the scale levels
-            if (ngh_scale_level <= scale_level + 1) {
-                // the observation by `ngh_keyfrm` is more reliable than `keyfrm`
-                ++num_better_obs;
-                if (num_better_obs_thr <= num_better_obs) {
-                    // if the number of the better observations is greater than the threshold,
-                    // consider the observation of `lm` by `keyfrm` is redundant
-                    obs_by_keyfrm_is_redundant = true;
-                    break;
-                }
-            }
-        }
+        // if the number of the better observations by the other keyframes is greater than the threshold,
+        // consider the observation of `lm` by `keyfrm` is redundant
+        const bool obs_by_keyfrm_is_redundant = num_better_obs_thr < num_better_obs;
 
         if (obs_by_keyfrm_is_redundant) {
             ++num_redundant_obs;
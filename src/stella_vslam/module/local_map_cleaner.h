@@ -1,8 +1,12 @@
 #ifndef STELLA_VSLAM_MODULE_LOCAL_MAP_CLEANER_H
 #define STELLA_VSLAM_MODULE_LOCAL_MAP_CLEANER_H
 
-#include <list>
+#include <deque>
+#include <functional>
+#include <map>
 #include <memory>
+#include <set>
+#include <vector>
 
 namespace stella_vslam {
 
@@ -30,9 +34,7 @@ public:
     /**
      * Add fresh landmark to check their redundancy
      */
-    void add_fresh_landmark(std::shared_ptr<data::landmark>& lm) {
-        fresh_landmarks_.push_back(lm);
-    }
+    void add_fresh_landmark(std::shared_ptr<data::landmark>& lm);
 
     /**
      * Reset the buffer
@@ -45,16 +47,67 @@ public:
     unsigned int remove_invalid_landmarks(const unsigned int cur_keyfrm_id);
 
     /**
-     * Remove redundant keyframes
+     * Queue the covisibilities of the current keyframe to check their redundancy
+     */
+    void queue_redundant_keyframe_candidates(const std::shared_ptr<data::keyframe>& cur_keyfrm);
+
+    /**
+     * Whether any candidate of the redundant keyframes is queued
+     */
+    bool redundant_keyframe_candidates_are_queued() const {
+        return !redundant_keyfrm_candidates_.empty();
+    }
+
+    /**
+     * Remove redundant keyframes among the queued candidates
+     * The candidates are checked one by one, and the rest of them are kept for the next call if abort is requested.
+     * (NOTE: the candidates are checked with the map database locked one by one, then this function can be preempted between them)
+     * @param abort_is_requested returns true to stop checking (e.g. if a new keyframe is queued)
+     * @return number of the removed keyframes
      */
-    unsigned int remove_redundant_keyframes(const std::shared_ptr<data::keyframe>& cur_keyfrm) const;
+    unsigned int remove_redundant_keyframes(const std::function<bool()>& abort_is_requested = nullptr);
 
     /**
      * Count the valid and the redundant observations in the specified keyframe
      */
     void count_redundant_observations(const std::shared_ptr<data::keyframe>& keyfrm, unsigned int& num_valid_obs, unsigned int& num_redundant_obs) const;
 
+    /**
+     * Remove the keyframes with the lowest utility until the number of the keyframes is within max_num_keyfrms_
+     * The utility is the number of the valid observations which are not redundant (see count_redundant_observations()),
+     * and the keyframes adjacent to each other in the spanning tree are not removed in the same batch to keep the viewpoint coverage.
+     * (NOTE: the keyframes are removed in batches with the map database locked, then this function can be preempted between them)
+     * @param abort_is_requested returns true to stop removing (e.g. if a new keyframe is queued)
+     * @return number of the removed keyframes
+     */
+    unsigned int summarize_map(const std::function<bool()>& abort_is_requested = nullptr);
+
+    /**
+     * Whether the number of the keyframes exceeds the budget
+     */
+    bool map_summarization_is_needed() const;
+
+    /**
+     * Queue the keyframe to compact its descriptors after it leaves the local map (see data::keyframe::compact_descriptors())
+     */
+    void queue_keyframe_to_compact(const std::shared_ptr<data::keyframe>& keyfrm);
+
+    /**
+     * Compact the descriptors of the queued keyframes which are older than descriptor_compaction_window_ keyframes
+     * and are not in the local map (the top n covisibilities) of the latest keyframe.
+     * The compacted keyframes which come back to the local map are hydrated and queued again.
+     * @param abort_is_requested returns true to stop compacting (e.g. if a new keyframe is queued)
+     * @return number of the compacted keyframes
+     */
+    unsigned int compact_keyframe_descriptors(const std::function<bool()>& abort_is_requested = nullptr);
+
 private:
+    /**
+     * Update the representative descriptors and the prediction parameters of the landmarks
+     * which were observed by the erased keyframes
+     */
+    void update_landmarks_of_erased_keyframes(const std::vector<std::shared_ptr<data::landmark>>& landmarks) const;
+
     //! map database
     data::map_database* map_db_ = nullptr;
     //! BoW database
@@ -72,8 +125,28 @@ private:
     //! Top n covisibilities to search (0 means disabled)
     unsigned int top_n_covisibilities_to_search_;
 
-    //! fresh landmarks to check their redundancy
-    std::list<std::shared_ptr<data::landmark>> fresh_landmarks_;
+    //! Maximum number of the keyframes kept by the map summarization (0 means disabled)
+    unsigned int max_num_keyfrms_;
+
+    //! Maximum number of the keyframes removed with the map database locked once
+    unsigned int num_summarized_keyfrms_per_batch_;
+
+    //! The descriptors of the keyframes older than this number of keyframes are compacted (0 means disabled)
+    unsigned int descriptor_compaction_window_;
+
+    //! fresh landmarks to check their redundancy, bucketed by the ID of the keyframe which created them
+    //! (the buckets older than num_reliable_keyfrms_ are dropped at once)
+    std::map<unsigned int, std::vector<std::shared_ptr<data::landmark>>> fresh_landmarks_;
+
+    //! candidates of the redundant keyframes (in the queued order)
+    std::deque<std::shared_ptr<data::keyframe>> redundant_keyfrm_candidates_;
+    //! IDs of the queued candidates (to avoid checking a keyframe twice for a queue)
+    std::set<unsigned int> redundant_keyfrm_candidate_ids_;
+    //! ID of the latest keyframe which queued the candidates
+    unsigned int latest_keyfrm_id_ = 0;
+
+    //! keyframes to compact their descriptors (in the queued order)
+    std::deque<std::shared_ptr<data::keyframe>> keyfrms_to_compact_;
 };
 
 } // namespace module
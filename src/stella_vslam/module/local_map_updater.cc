@@ -7,7 +7,7 @@ namespace stella_vslam {
 namespace module {
 
 local_map_updater::local_map_updater(const data::frame& curr_frm, const unsigned int max_num_local_keyfrms)
-    : frm_lms_(curr_frm.get_landmarks()), num_keypts_(curr_frm.frm_obs_.num_keypts_),
+    : frm_lms_(curr_frm.get_landmarks()), num_keypts_(curr_frm.frm_obs_->num_keypts_),
       max_num_local_keyfrms_(max_num_local_keyfrms) {}
 
 std::vector<std::shared_ptr<data::keyframe>> local_map_updater::get_local_keyframes() const {
@@ -43,8 +43,10 @@ bool local_map_updater::find_local_keyframes() {
 
 local_map_updater::keyframe_to_num_shared_lms_t local_map_updater::count_num_shared_lms() const {
     // count the number of sharing landmarks between the current frame and each of the neighbor keyframes
-    // key: keyframe, value: number of sharing landmarks
+    // the counters are indexed by keyframe ID to avoid hashing the shared pointers
     keyframe_to_num_shared_lms_t keyfrm_to_num_shared_lms;
+    // index of each keyframe in keyfrm_to_num_shared_lms plus one (0 means not found yet), indexed by keyframe ID
+    std::vector<unsigned int> keyfrm_id_to_pos;
     for (unsigned int idx = 0; idx < num_keypts_; ++idx) {
         auto& lm = frm_lms_.at(idx);
         if (!lm) {
@@ -54,8 +56,20 @@ local_map_updater::keyframe_to_num_shared_lms_t local_map_updater::count_num_sha
             continue;
         }
         const auto observations = lm->get_observations();
-        for (auto obs : observations) {
-            ++keyfrm_to_num_shared_lms[obs.first.lock()];
+        for (const auto& obs : observations) {
+            auto keyfrm = obs.first.lock();
+            if (!keyfrm) {
+                continue;
+            }
+            if (keyfrm_id_to_pos.size() <= keyfrm->id_) {
+                keyfrm_id_to_pos.resize(2 * (keyfrm->id_ + 1), 0);
+            }
+            auto& pos = keyfrm_id_to_pos.at(keyfrm->id_);
+            if (pos == 0) {
+                keyfrm_to_num_shared_lms.emplace_back(std::move(keyfrm), 0);
+                pos = keyfrm_to_num_shared_lms.size();
+            }
+            ++keyfrm_to_num_shared_lms.at(pos - 1).second;
         }
     }
     return keyfrm_to_num_shared_lms;
@@ -120,9 +134,19 @@ auto local_map_updater::find_second_local_keyframes(const std::vector<std::share
 
         const auto& keyfrm = *iter;
 
-        // covisibilities of the neighbor keyframe
-        const auto neighbors = keyfrm->graph_node_->get_top_n_covisibilities(10);
-        for (const auto& neighbor : neighbors) {
+        // top-10 covisibilities of the neighbor keyframe
+        // (read from the snapshot in order to stop locking the keyframes as soon as one is added)
+        const auto snapshot = keyfrm->graph_node_->get_covisibility_snapshot();
+        unsigned int num_neighbors = 0;
+        for (const auto& weak_neighbor : snapshot->keyfrms_) {
+            if (num_neighbors == 10) {
+                break;
+            }
+            const auto neighbor = weak_neighbor.lock();
+            if (!neighbor) {
+                continue;
+            }
+            ++num_neighbors;
             if (add_second_local_keyframe(neighbor)) {
                 break;
             }
@@ -145,10 +169,19 @@ auto local_map_updater::find_second_local_keyframes(const std::vector<std::share
 }
 
 bool local_map_updater::find_local_landmarks() {
-    local_lms_.clear();
-    local_lms_.reserve(50 * local_keyfrms_.size());
+    // flags of the already found landmarks, indexed by landmark ID
+    std::vector<bool> already_found_lms;
+    auto check_and_mark = [&already_found_lms](const unsigned int id) {
+        if (already_found_lms.size() <= id) {
+            already_found_lms.resize(2 * (id + 1), false);
+        }
+        if (already_found_lms[id]) {
+            return false;
+        }
+        already_found_lms[id] = true;
+        return true;
+    };
 
-    std::unordered_set<unsigned int> already_found_lms_ids;
     for (unsigned int idx = 0; idx < num_keypts_; ++idx) {
         auto& lm = frm_lms_.at(idx);
         if (!lm) {
@@ -157,26 +190,37 @@ bool local_map_updater::find_local_landmarks() {
         if (lm->will_be_erased()) {
             continue;
         }
-        already_found_lms_ids.insert(lm->id_);
+        check_and_mark(lm->id_);
     }
-    for (const auto& keyfrm : local_keyfrms_) {
-        const auto& lms = keyfrm->get_landmarks();
 
-        for (const auto& lm : lms) {
+    // gather the valid landmarks of each local keyframe in parallel
+    std::vector<std::vector<std::shared_ptr<data::landmark>>> keyfrm_lms(local_keyfrms_.size());
+#ifdef USE_OPENMP
+#pragma omp parallel for
+#endif
+    for (int64_t i = 0; i < static_cast<int64_t>(local_keyfrms_.size()); ++i) {
+        auto& lms = keyfrm_lms.at(i);
+        local_keyfrms_.at(i)->for_each_landmark([&lms](const std::shared_ptr<data::landmark>& lm, const unsigned int) {
             if (!lm) {
-                continue;
+                return;
             }
             if (lm->will_be_erased()) {
-                continue;
+                return;
             }
+            lms.push_back(lm);
+        });
+    }
 
+    // merge them in order of the local keyframes
+    local_lms_.clear();
+    local_lms_.reserve(50 * local_keyfrms_.size());
+    for (auto& lms : keyfrm_lms) {
+        for (auto& lm : lms) {
             // avoid duplication
-            if (already_found_lms_ids.count(lm->id_)) {
+            if (!check_and_mark(lm->id_)) {
                 continue;
             }
-            already_found_lms_ids.insert(lm->id_);
-
-            local_lms_.push_back(lm);
+            local_lms_.push_back(std::move(lm));
         }
     }
 
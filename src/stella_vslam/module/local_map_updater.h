@@ -2,6 +2,9 @@
 #define STELLA_VSLAM_MODULE_LOCAL_MAP_UPDATER_H
 
 #include <memory>
+#include <unordered_set>
+#include <utility>
+#include <vector>
 
 namespace stella_vslam {
 
@@ -15,7 +18,8 @@ namespace module {
 
 class local_map_updater {
 public:
-    using keyframe_to_num_shared_lms_t = nondeterministic::unordered_map<std::shared_ptr<data::keyframe>, unsigned int>;
+    //! pairs of the keyframe and the number of the shared landmarks (in order of the first observation)
+    using keyframe_to_num_shared_lms_t = std::vector<std::pair<std::shared_ptr<data::keyframe>, unsigned int>>;
 
     //! Constructor
     explicit local_map_updater(const data::frame& curr_frm, const unsigned int max_num_local_keyfrms);
@@ -4,21 +4,37 @@
 #include "stella_vslam/data/map_database.h"
 #include "stella_vslam/module/loop_bundle_adjuster.h"
 #include "stella_vslam/optimize/global_bundle_adjuster.h"
+#include "stella_vslam/publish/metrics_publisher.h"
+#include "stella_vslam/util/converter.h"
+#include "stella_vslam/util/parallel_for.h"
 
+#include <chrono>
 #include <thread>
+#include <unordered_map>
+#include <unordered_set>
 
 #include <spdlog/spdlog.h>
 
 namespace stella_vslam {
 namespace module {
 
-loop_bundle_adjuster::loop_bundle_adjuster(data::map_database* map_db, const unsigned int num_iter)
-    : map_db_(map_db), num_iter_(num_iter) {}
+loop_bundle_adjuster::loop_bundle_adjuster(data::map_database* map_db, const YAML::Node& yaml_node)
+    : map_db_(map_db),
+      num_iter_(yaml_node["loop_BA_num_iterations"].as<unsigned int>(10)),
+      linear_solver_type_(optimize::load_linear_solver_type(yaml_node["loop_BA_linear_solver"].as<std::string>("csparse"))),
+      num_keyfrms_per_submap_(yaml_node["loop_BA_num_keyframes_per_submap"].as<unsigned int>(0)),
+      time_budget_(yaml_node["loop_BA_time_budget"].as<double>(0.0)),
+      use_partial_result_(yaml_node["loop_BA_use_partial_result"].as<bool>(false)),
+      num_region_hops_(yaml_node["loop_BA_num_region_hops"].as<unsigned int>(0)) {}
 
 void loop_bundle_adjuster::set_mapping_module(mapping_module* mapper) {
     mapper_ = mapper;
 }
 
+void loop_bundle_adjuster::set_metrics_publisher(const std::shared_ptr<publish::metrics_publisher>& metrics_publisher) {
+    metrics_publisher_ = metrics_publisher;
+}
+
 void loop_bundle_adjuster::abort() {
     std::lock_guard<std::mutex> lock(mtx_thread_);
     abort_loop_BA_ = true;
@@ -31,6 +47,7 @@ bool loop_bundle_adjuster::is_running() const {
 
 void loop_bundle_adjuster::optimize(const std::shared_ptr<data::keyframe>& curr_keyfrm) {
     spdlog::info("start loop bundle adjustment");
+    const auto start = std::chrono::steady_clock::now();
 
     {
         std::lock_guard<std::mutex> lock(mtx_thread_);
@@ -42,11 +59,30 @@ void loop_bundle_adjuster::optimize(const std::shared_ptr<data::keyframe>& curr_
     std::unordered_set<unsigned int> optimized_landmark_ids;
     eigen_alloc_unord_map<unsigned int, Vec3_t> lm_to_pos_w_after_global_BA;
     eigen_alloc_unord_map<unsigned int, Mat44_t> keyfrm_to_pose_cw_after_global_BA;
-    const auto global_BA = optimize::global_bundle_adjuster(num_iter_, false);
-    bool ok = global_BA.optimize(curr_keyfrm->graph_node_->get_keyframes_from_root(),
-                                 optimized_keyfrm_ids, optimized_landmark_ids,
-                                 lm_to_pos_w_after_global_BA,
-                                 keyfrm_to_pose_cw_after_global_BA, &abort_loop_BA_);
+    auto global_BA = optimize::global_bundle_adjuster(num_iter_, false, linear_solver_type_, num_keyfrms_per_submap_,
+                                                time_budget_, use_partial_result_);
+    global_BA.set_thread_pool(thread_pool_);
+    bool ok = false;
+    if (0 < num_region_hops_) {
+        ok = global_BA.optimize_region(get_region_keyframes(curr_keyfrm),
+                                       optimized_keyfrm_ids, optimized_landmark_ids,
+                                       lm_to_pos_w_after_global_BA,
+                                       keyfrm_to_pose_cw_after_global_BA, &abort_loop_BA_);
+    }
+    else {
+        ok = global_BA.optimize(curr_keyfrm->graph_node_->get_keyframes_from_root(),
+                                optimized_keyfrm_ids, optimized_landmark_ids,
+                                lm_to_pos_w_after_global_BA,
+                                keyfrm_to_pose_cw_after_global_BA, &abort_loop_BA_);
+    }
+
+    if (metrics_publisher_) {
+        const auto end = std::chrono::steady_clock::now();
+        metrics_publisher_->observe("loop_BA_duration_ms", std::chrono::duration<double, std::milli>(end - start).count());
+        if (!ok) {
+            metrics_publisher_->increment("loop_BA_aborts_total");
+        }
+    }
 
     {
         std::lock_guard<std::mutex> lock1(mtx_thread_);
@@ -67,44 +103,85 @@ void loop_bundle_adjuster::optimize(const std::shared_ptr<data::keyframe>& curr_
         spdlog::debug("loop_bundle_adjuster::optimize: wait for mapper_->async_pause");
         future_pause.get();
 
-        std::lock_guard<std::mutex> lock2(data::map_database::mtx_database_);
+        std::lock_guard<util::profiled_mutex> lock2(data::map_database::mtx_database_);
 
         spdlog::debug("update the camera pose along the spanning tree from the root");
-        eigen_alloc_unord_map<unsigned int, Mat44_t> keyfrm_to_cam_pose_cw_before_BA;
-        std::list<std::shared_ptr<data::keyframe>> keyfrms_to_check;
-        keyfrms_to_check.push_back(curr_keyfrm->graph_node_->get_spanning_root());
-        while (!keyfrms_to_check.empty()) {
-            auto parent = keyfrms_to_check.front();
-            const Mat44_t cam_pose_wp = parent->get_pose_wc();
-
-            const auto children = parent->graph_node_->get_spanning_children();
-            for (auto child : children) {
-                if (!optimized_keyfrm_ids.count(child->id_)) {
-                    // if `child` is NOT optimized by the loop BA
-                    // propagate the pose correction from the spanning parent
-
-                    // parent->child
-                    const Mat44_t cam_pose_cp = child->get_pose_cw() * cam_pose_wp;
-                    // world->child AFTER correction = parent->child * world->parent AFTER correction
-                    keyfrm_to_pose_cw_after_global_BA[child->id_] = cam_pose_cp * keyfrm_to_pose_cw_after_global_BA.at(parent->id_);
-                    // check as `child` has been corrected
-                    optimized_keyfrm_ids.insert(child->id_);
-                }
+        const auto spanning_root = curr_keyfrm->graph_node_->get_spanning_root();
+        // (the spanning root is held fixed, and it is not contained in the result if it is outside of the region)
+        if (!optimized_keyfrm_ids.count(spanning_root->id_)) {
+            keyfrm_to_pose_cw_after_global_BA[spanning_root->id_] = spanning_root->get_pose_cw();
+            optimized_keyfrm_ids.insert(spanning_root->id_);
+        }
 
-                // need updating
-                keyfrms_to_check.push_back(child);
+        // keyframes in the breadth-first order of the spanning tree, with the indices of their parents
+        std::vector<std::shared_ptr<data::keyframe>> keyfrms{spanning_root};
+        std::vector<int> parent_idxs{-1};
+        // camera poses BEFORE and AFTER the correction (same order as keyfrms)
+        eigen_alloc_vector<Mat44_t> cam_poses_cw_before_BA{spanning_root->get_pose_cw()};
+        eigen_alloc_vector<Mat44_t> cam_poses_cw_after_BA{keyfrm_to_pose_cw_after_global_BA.at(spanning_root->id_)};
+
+        // propagate the pose correction level by level
+        // (the keyframes in the same level depend only on their parents in the previous level)
+        size_t level_begin = 0;
+        while (level_begin < keyfrms.size()) {
+            const size_t level_end = keyfrms.size();
+
+            std::vector<std::vector<std::shared_ptr<data::keyframe>>> children_of_level(level_end - level_begin);
+            util::parallel_for(
+                thread_pool_, 0, static_cast<int64_t>(level_end - level_begin), [&](const int64_t i) {
+                    const auto children = keyfrms.at(level_begin + i)->graph_node_->get_spanning_children();
+                    children_of_level.at(i).assign(children.begin(), children.end());
+                },
+                util::task_priority_t::Low);
+            for (size_t i = 0; i < children_of_level.size(); ++i) {
+                for (const auto& child : children_of_level.at(i)) {
+                    keyfrms.push_back(child);
+                    parent_idxs.push_back(static_cast<int>(level_begin + i));
+                }
             }
 
-            // temporally store the camera pose BEFORE correction (for correction of landmark positions)
-            keyfrm_to_cam_pose_cw_before_BA[parent->id_] = parent->get_pose_cw();
-            // update the camera pose
-            parent->set_pose_cw(keyfrm_to_pose_cw_after_global_BA.at(parent->id_));
-            // finish updating
-            keyfrms_to_check.pop_front();
+            cam_poses_cw_before_BA.resize(keyfrms.size());
+            cam_poses_cw_after_BA.resize(keyfrms.size());
+            util::parallel_for(
+                thread_pool_, static_cast<int64_t>(level_end), static_cast<int64_t>(keyfrms.size()), [&](const int64_t idx) {
+                    const auto& child = keyfrms.at(idx);
+                    const auto parent_idx = parent_idxs.at(idx);
+                    cam_poses_cw_before_BA.at(idx) = child->get_pose_cw();
+
+                    const auto itr = keyfrm_to_pose_cw_after_global_BA.find(child->id_);
+                    if (itr != keyfrm_to_pose_cw_after_global_BA.end()) {
+                        cam_poses_cw_after_BA.at(idx) = itr->second;
+                    }
+                    else {
+                        // if `child` is NOT optimized by the loop BA
+                        // propagate the pose correction from the spanning parent
+
+                        // parent->child
+                        const Mat44_t cam_pose_cp = cam_poses_cw_before_BA.at(idx) * util::converter::inverse_pose(cam_poses_cw_before_BA.at(parent_idx));
+                        // world->child AFTER correction = parent->child * world->parent AFTER correction
+                        cam_poses_cw_after_BA.at(idx) = cam_pose_cp * cam_poses_cw_after_BA.at(parent_idx);
+                    }
+                },
+                util::task_priority_t::Low);
+
+            level_begin = level_end;
         }
 
+        // index of the keyframe in keyfrms (for correction of landmark positions)
+        std::unordered_map<unsigned int, unsigned int> keyfrm_id_to_idx;
+        keyfrm_id_to_idx.reserve(keyfrms.size());
+        for (unsigned int idx = 0; idx < keyfrms.size(); ++idx) {
+            keyfrm_id_to_idx.emplace(keyfrms.at(idx)->id_, idx);
+        }
+
+        // update the camera poses
+        util::parallel_for(
+            thread_pool_, 0, static_cast<int64_t>(keyfrms.size()), [&keyfrms, &cam_poses_cw_after_BA](const int64_t idx) {
+                keyfrms.at(idx)->set_pose_cw(cam_poses_cw_after_BA.at(idx));
+            },
+            util::task_priority_t::Low);
+
         spdlog::debug("update the positions of the landmarks");
-        auto keyfrms = curr_keyfrm->graph_node_->get_keyframes_from_root();
         std::unordered_set<unsigned int> already_found_landmark_ids;
         std::vector<std::shared_ptr<data::landmark>> lms;
         for (const auto& keyfrm : keyfrms) {
@@ -124,39 +201,44 @@ void loop_bundle_adjuster::optimize(const std::shared_ptr<data::keyframe>& curr_
             }
         }
 
-        for (const auto& lm : lms) {
-            if (lm->will_be_erased()) {
-                continue;
-            }
-
-            if (optimized_landmark_ids.count(lm->id_)) {
-                // if `lm` is optimized by the loop BA
-
-                // update with the optimized position
-                lm->set_pos_in_world(lm_to_pos_w_after_global_BA.at(lm->id_));
-            }
-            else {
-                // if `lm` is NOT optimized by the loop BA
-
-                // correct the position according to the move of the camera pose of the reference keyframe
-                auto ref_keyfrm = lm->get_ref_keyframe();
-
-                assert(optimized_keyfrm_ids.count(ref_keyfrm->id_));
+        util::parallel_for(
+            thread_pool_, 0, static_cast<int64_t>(lms.size()), [&](const int64_t i) {
+                const auto& lm = lms.at(i);
+                if (lm->will_be_erased()) {
+                    return;
+                }
 
-                // convert the position to the camera-reference using the camera pose BEFORE the correction
-                const Mat44_t pose_cw_before_BA = keyfrm_to_cam_pose_cw_before_BA.at(ref_keyfrm->id_);
-                const Mat33_t rot_cw_before_BA = pose_cw_before_BA.block<3, 3>(0, 0);
-                const Vec3_t trans_cw_before_BA = pose_cw_before_BA.block<3, 1>(0, 3);
-                const Vec3_t pos_c = rot_cw_before_BA * lm->get_pos_in_world() + trans_cw_before_BA;
+                if (optimized_landmark_ids.count(lm->id_)) {
+                    // if `lm` is optimized by the loop BA
 
-                // convert the position to the world-reference using the camera pose AFTER the correction
-                const Mat44_t cam_pose_wc = ref_keyfrm->get_pose_wc();
-                const Mat33_t rot_wc = cam_pose_wc.block<3, 3>(0, 0);
-                const Vec3_t trans_wc = cam_pose_wc.block<3, 1>(0, 3);
-                lm->set_pos_in_world(rot_wc * pos_c + trans_wc);
-            }
-            lm->update_mean_normal_and_obs_scale_variance();
-        }
+                    // update with the optimized position
+                    lm->set_pos_in_world(lm_to_pos_w_after_global_BA.at(lm->id_));
+                }
+                else {
+                    // if `lm` is NOT optimized by the loop BA
+
+                    // correct the position according to the move of the camera pose of the reference keyframe
+                    auto ref_keyfrm = lm->get_ref_keyframe();
+
+                    assert(keyfrm_id_to_idx.count(ref_keyfrm->id_));
+                    const auto ref_keyfrm_idx = keyfrm_id_to_idx.at(ref_keyfrm->id_);
+
+                    // convert the position to the camera-reference using the camera pose BEFORE the correction
+                    const Mat44_t& pose_cw_before_BA = cam_poses_cw_before_BA.at(ref_keyfrm_idx);
+                    const Mat33_t rot_cw_before_BA = pose_cw_before_BA.block<3, 3>(0, 0);
+                    const Vec3_t trans_cw_before_BA = pose_cw_before_BA.block<3, 1>(0, 3);
+                    const Vec3_t pos_c = rot_cw_before_BA * lm->get_pos_in_world() + trans_cw_before_BA;
+
+                    // convert the position to the world-reference using the camera pose AFTER the correction
+                    const Mat44_t cam_pose_wc = util::converter::inverse_pose(cam_poses_cw_after_BA.at(ref_keyfrm_idx));
+                    const Mat33_t rot_wc = cam_pose_wc.block<3, 3>(0, 0);
+                    const Vec3_t trans_wc = cam_pose_wc.block<3, 1>(0, 3);
+                    lm->set_pos_in_world(rot_wc * pos_c + trans_wc);
+                }
+            },
+            util::task_priority_t::Low, 256);
+        // (the prediction parameters are invalidated by the new positions and the new camera poses)
+        data::landmark::update_prediction_parameters(lms, thread_pool_);
 
         mapper_->resume();
         loop_BA_is_running_ = false;
@@ -165,5 +247,44 @@ void loop_bundle_adjuster::optimize(const std::shared_ptr<data::keyframe>& curr_
     }
 }
 
+std::vector<std::shared_ptr<data::keyframe>> loop_bundle_adjuster::get_region_keyframes(const std::shared_ptr<data::keyframe>& curr_keyfrm) const {
+    std::vector<std::shared_ptr<data::keyframe>> region_keyfrms;
+    std::unordered_set<unsigned int> region_keyfrm_ids;
+
+    // Breadth-first search from the current keyframe, which has the loop edges to the other side of the loop
+    std::vector<std::shared_ptr<data::keyframe>> keyfrms_to_check{curr_keyfrm};
+    region_keyfrm_ids.insert(curr_keyfrm->id_);
+    region_keyfrms.push_back(curr_keyfrm);
+    for (unsigned int hop = 0; hop < num_region_hops_ && !keyfrms_to_check.empty(); ++hop) {
+        std::vector<std::shared_ptr<data::keyframe>> next_keyfrms_to_check;
+        const auto add_neighbor = [&](const std::shared_ptr<data::keyframe>& neighbor) {
+            if (!neighbor || neighbor->will_be_erased() || region_keyfrm_ids.count(neighbor->id_)) {
+                return;
+            }
+            region_keyfrm_ids.insert(neighbor->id_);
+            region_keyfrms.push_back(neighbor);
+            next_keyfrms_to_check.push_back(neighbor);
+        };
+
+        for (const auto& keyfrm : keyfrms_to_check) {
+            for (const auto& covisibility : keyfrm->graph_node_->get_covisibilities()) {
+                add_neighbor(covisibility);
+            }
+            add_neighbor(keyfrm->graph_node_->get_spanning_parent());
+            for (const auto& child : keyfrm->graph_node_->get_spanning_children()) {
+                add_neighbor(child);
+            }
+            for (const auto& loop_keyfrm : keyfrm->graph_node_->get_loop_edges()) {
+                add_neighbor(loop_keyfrm);
+            }
+        }
+        keyfrms_to_check = std::move(next_keyfrms_to_check);
+    }
+
+    spdlog::debug("loop_bundle_adjuster: {} keyframes within {} hops of keyframe {}",
+                  region_keyfrms.size(), num_region_hops_, curr_keyfrm->id_);
+    return region_keyfrms;
+}
+
 } // namespace module
 } // namespace stella_vslam
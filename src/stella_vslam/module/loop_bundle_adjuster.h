@@ -1,7 +1,13 @@
 #ifndef STELLA_VSLAM_MODULE_LOOP_BUNDLE_ADJUSTER_H
 #define STELLA_VSLAM_MODULE_LOOP_BUNDLE_ADJUSTER_H
 
+#include "stella_vslam/optimize/linear_solver_type.h"
+
+#include <memory>
 #include <mutex>
+#include <vector>
+
+#include <yaml-cpp/yaml.h>
 
 namespace stella_vslam {
 
@@ -12,14 +18,24 @@ class keyframe;
 class map_database;
 } // namespace data
 
+namespace publish {
+class metrics_publisher;
+} // namespace publish
+
+namespace util {
+class thread_pool;
+} // namespace util
+
 namespace module {
 
 class loop_bundle_adjuster {
 public:
     /**
      * Constructor
+     * @param map_db
+     * @param yaml_node (the loop_BA_* parameters are used)
      */
-    explicit loop_bundle_adjuster(data::map_database* map_db, const unsigned int num_iter = 10);
+    loop_bundle_adjuster(data::map_database* map_db, const YAML::Node& yaml_node);
 
     /**
      * Destructor
@@ -31,11 +47,30 @@ public:
      */
     void set_mapping_module(mapping_module* mapper);
 
+    /**
+     * Set the metrics publisher which records the durations of the loop BA
+     * @param metrics_publisher
+     */
+    void set_metrics_publisher(const std::shared_ptr<publish::metrics_publisher>& metrics_publisher);
+
+    /**
+     * Set the thread pool to run the parallel loops of the loop BA on
+     * (the OpenMP threads are used if nullptr)
+     * @param thread_pool
+     */
+    void set_thread_pool(util::thread_pool* thread_pool) { thread_pool_ = thread_pool; }
+
     /**
      * Abort loop BA externally
      */
     void abort();
 
+    /**
+     * The aborted loop BA applies the estimates so far or not
+     * (NOTE: if true, wait for is_running() to become false after abort() before modifying the map)
+     */
+    bool applies_partial_result() const { return use_partial_result_; }
+
     /**
      * Loop BA is running or not
      */
@@ -47,15 +82,42 @@ public:
     void optimize(const std::shared_ptr<data::keyframe>& curr_keyfrm);
 
 private:
+    /**
+     * Get the keyframes within num_region_hops_ hops of the current keyframe
+     * (along the covisibility graph, the spanning tree and the loop edges)
+     */
+    std::vector<std::shared_ptr<data::keyframe>> get_region_keyframes(const std::shared_ptr<data::keyframe>& curr_keyfrm) const;
+
     //! map database
     data::map_database* map_db_ = nullptr;
 
     //! mapping module
     mapping_module* mapper_ = nullptr;
 
+    //! metrics publisher (nullptr if not set)
+    std::shared_ptr<publish::metrics_publisher> metrics_publisher_ = nullptr;
+
+    //! thread pool to run the parallel loops on (nullptr if not set)
+    util::thread_pool* thread_pool_ = nullptr;
+
     //! number of iteration for optimization
     const unsigned int num_iter_ = 10;
 
+    //! linear solver of global BA
+    const optimize::linear_solver_type_t linear_solver_type_;
+
+    //! maximum number of keyframes in a submap of hierarchical global BA (0: disabled)
+    const unsigned int num_keyfrms_per_submap_;
+
+    //! time budget of global BA in seconds (0: unlimited)
+    const double time_budget_;
+
+    //! apply the estimates so far when aborted
+    const bool use_partial_result_;
+
+    //! optimize only the keyframes within this number of hops of the loop, and propagate the correction to the others (0: optimize the whole map)
+    const unsigned int num_region_hops_;
+
     //-----------------------------------------
     // thread management
 
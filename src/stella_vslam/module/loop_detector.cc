@@ -12,11 +12,14 @@
 
 #include <spdlog/spdlog.h>
 
+#include <algorithm>
+
 namespace stella_vslam {
 namespace module {
 
 loop_detector::loop_detector(data::bow_database* bow_db, data::bow_vocabulary* bow_vocab, const YAML::Node& yaml_node, const bool fix_scale_in_Sim3_estimation)
-    : bow_db_(bow_db), bow_vocab_(bow_vocab), transform_optimizer_(fix_scale_in_Sim3_estimation), pose_optimizer_(),
+    : bow_db_(bow_db), bow_vocab_(bow_vocab), transform_optimizer_(fix_scale_in_Sim3_estimation, 10, yaml_node["use_dedicated_transform_solver"].as<bool>(false)),
+      pose_optimizer_(),
       loop_detector_is_enabled_(yaml_node["enabled"].as<bool>(true)),
       fix_scale_in_Sim3_estimation_(fix_scale_in_Sim3_estimation),
       num_final_matches_thr_(yaml_node["num_final_matches_threshold"].as<unsigned int>(40)),
@@ -27,7 +30,8 @@ loop_detector::loop_detector(data::bow_database* bow_db, data::bow_vocabulary* b
       num_matches_thr_brute_force_(yaml_node["num_matches_thr_robust_matcher"].as<unsigned int>(0)),
       num_optimized_inliers_thr_(yaml_node["num_optimized_inliers_thr"].as<unsigned int>(20)),
       top_n_covisibilities_to_search_(yaml_node["top_n_covisibilities_to_search"].as<unsigned int>(0)),
-      use_fixed_seed_(yaml_node["use_fixed_seed"].as<bool>(false)) {
+      use_fixed_seed_(yaml_node["use_fixed_seed"].as<bool>(false)),
+      num_global_descriptor_neighbors_(yaml_node["num_global_descriptor_neighbors"].as<unsigned int>(0)) {
     spdlog::debug("CONSTRUCT: loop_detector");
 }
 
@@ -54,10 +58,20 @@ bool loop_detector::detect_loop_candidates() {
     return succeeded;
 }
 
+void loop_detector::skip_loop_detection() {
+    loop_candidates_to_validate_.clear();
+    // register to the BoW database
+    bow_db_->add_keyframe(cur_keyfrm_);
+}
+
 void loop_detector::add_loop_candidate(const std::shared_ptr<data::keyframe>& keyfrm) {
     loop_candidates_to_validate_.insert(keyfrm);
 }
 
+std::unordered_set<std::shared_ptr<data::keyframe>> loop_detector::get_loop_candidates() const {
+    return loop_candidates_to_validate_;
+}
+
 bool loop_detector::detect_loop_candidates_impl() {
     // if the loop detector is disabled or the loop has been corrected recently,
     // cannot perfrom the loop correction
@@ -115,13 +129,17 @@ bool loop_detector::detect_loop_candidates_impl() {
         }
     }
 
-    const auto init_loop_candidates = bow_db_->acquire_keyframes(cur_keyfrm_->bow_vec_, min_score, keyfrms_to_reject);
+    const auto init_loop_candidates = (0 < num_global_descriptor_neighbors_)
+                                          ? bow_db_->acquire_keyframes_by_global_descriptor(cur_keyfrm_->bow_vec_, num_global_descriptor_neighbors_,
+                                                                                            min_score, keyfrms_to_reject)
+                                          : bow_db_->acquire_keyframes(cur_keyfrm_->bow_vec_, min_score, keyfrms_to_reject);
 
     // 1-3. if no candidates are found, cannot perform the loop correction
 
     if (init_loop_candidates.empty()) {
         // clear the buffer because any candidates are not found
         cont_detected_keyfrm_sets_.clear();
+        keyfrm_expansions_.clear();
         return false;
     }
 
@@ -168,17 +186,17 @@ bool loop_detector::detect_loop_candidates_impl() {
     return !loop_candidates_to_validate_.empty();
 }
 
-bool loop_detector::validate_candidates() {
+bool loop_detector::validate_candidates(loop_detection& detection) const {
     // disallow the removal of the candidates
     for (const auto& candidate : loop_candidates_to_validate_) {
         candidate->set_not_to_be_erased();
     }
 
-    auto succeeded = validate_candidates_impl();
+    auto succeeded = validate_candidates(cur_keyfrm_, loop_candidates_to_validate_, detection);
     if (succeeded) {
         // allow the removal of the candidates except for the selected one
         for (const auto& loop_candidate : loop_candidates_to_validate_) {
-            if (*loop_candidate == *selected_candidate_) {
+            if (*loop_candidate == *detection.selected_candidate_) {
                 continue;
             }
             loop_candidate->set_to_be_erased();
@@ -193,28 +211,33 @@ bool loop_detector::validate_candidates() {
     return succeeded;
 }
 
-bool loop_detector::validate_candidates_impl() {
+bool loop_detector::validate_candidates(const std::shared_ptr<data::keyframe>& cur_keyfrm,
+                                        const std::unordered_set<std::shared_ptr<data::keyframe>>& loop_candidates,
+                                        loop_detection& detection) const {
+    detection.cur_keyfrm_ = cur_keyfrm;
+
     // 1. for each of the candidates, estimate and validate the Sim3 between it and the current keyframe using the observed landmarks
     //    then, select ONE candaite
 
-    const bool candidate_is_found = select_loop_candidate_via_Sim3(loop_candidates_to_validate_, selected_candidate_,
-                                                                   g2o_Sim3_world_to_curr_, curr_match_lms_observed_in_cand_);
-    Sim3_world_to_curr_ = util::converter::to_eigen_mat(g2o_Sim3_world_to_curr_);
+    const bool candidate_is_found = select_loop_candidate_via_Sim3(cur_keyfrm, loop_candidates, detection.selected_candidate_,
+                                                                   detection.g2o_Sim3_world_to_curr_, detection.curr_match_lms_observed_in_cand_);
+    const Mat44_t Sim3_world_to_curr = util::converter::to_eigen_mat(detection.g2o_Sim3_world_to_curr_);
 
     if (!candidate_is_found) {
         return false;
     }
 
-    spdlog::debug("detect loop candidate via Sim3 estimation: keyframe {} - keyframe {}", selected_candidate_->id_, cur_keyfrm_->id_);
+    spdlog::debug("detect loop candidate via Sim3 estimation: keyframe {} - keyframe {}", detection.selected_candidate_->id_, cur_keyfrm->id_);
 
     // 2. reproject the landmarks observed in covisibilities of the selected candidate to the current keyframe,
     //    then acquire the extra 2D-3D matches
 
     // matches between the keypoints in the current and the landmarks observed in the covisibilities of the selected candidate
-    curr_match_lms_observed_in_cand_covis_.clear();
+    auto& curr_match_lms_observed_in_cand_covis = detection.curr_match_lms_observed_in_cand_covis_;
+    curr_match_lms_observed_in_cand_covis.clear();
 
-    auto cand_covisibilities = selected_candidate_->graph_node_->get_covisibilities();
-    cand_covisibilities.push_back(selected_candidate_);
+    auto cand_covisibilities = detection.selected_candidate_->graph_node_->get_covisibilities();
+    cand_covisibilities.push_back(detection.selected_candidate_);
 
     // acquire all of the landmarks observed in the covisibilities of the candidate
     // check the already inserted landmarks
@@ -232,22 +255,22 @@ bool loop_detector::validate_candidates_impl() {
             if (already_inserted.count(lm)) {
                 continue;
             }
-            curr_match_lms_observed_in_cand_covis_.push_back(lm);
+            curr_match_lms_observed_in_cand_covis.push_back(lm);
             already_inserted.insert(lm);
         }
     }
 
-    // reproject the landmarks observed in the covisibilities of the candidate to the current keyframe using Sim3 `Sim3_world_to_curr_`,
+    // reproject the landmarks observed in the covisibilities of the candidate to the current keyframe using Sim3 `Sim3_world_to_curr`,
     // then, acquire the extra 2D-3D matches
     // however, landmarks in `curr_match_lms_observed_in_cand_` are already matched with keypoints in the current keyframe,
     // thus they are excluded from the reprojection
     match::projection projection_matcher(0.75);
-    projection_matcher.match_by_Sim3_transform(cur_keyfrm_, Sim3_world_to_curr_, curr_match_lms_observed_in_cand_covis_,
-                                               curr_match_lms_observed_in_cand_, 10);
+    projection_matcher.match_by_Sim3_transform(cur_keyfrm, Sim3_world_to_curr, curr_match_lms_observed_in_cand_covis,
+                                               detection.curr_match_lms_observed_in_cand_, 10);
 
     // count up the matches
     unsigned int num_final_matches = 0;
-    for (const auto& curr_assoc_lm_in_cand : curr_match_lms_observed_in_cand_) {
+    for (const auto& curr_assoc_lm_in_cand : detection.curr_match_lms_observed_in_cand_) {
         if (curr_assoc_lm_in_cand) {
             ++num_final_matches;
         }
@@ -287,38 +310,62 @@ float loop_detector::compute_min_score_in_covisibilities(const std::shared_ptr<d
 }
 
 keyframe_sets loop_detector::find_continuously_detected_keyframe_sets(const keyframe_sets& prev_cont_detected_keyfrm_sets,
-                                                                      const std::vector<std::shared_ptr<data::keyframe>>& keyfrms_to_search) const {
+                                                                      const std::vector<std::shared_ptr<data::keyframe>>& keyfrms_to_search) {
     // count up the number of the detection of each of the keyframe sets
 
     // buffer to store continuity and keyframe set
     keyframe_sets curr_cont_detected_keyfrm_sets;
 
     // check the already counted keyframe sets to prevent from counting the same set twice
-    std::map<std::set<std::shared_ptr<data::keyframe>>, bool> already_checked;
-    for (const auto& prev : prev_cont_detected_keyfrm_sets) {
-        already_checked[prev.keyfrm_set_] = false;
+    // (the flag of the first one is used for the sets which consist of the same keyframes)
+    std::vector<unsigned int> flag_indices(prev_cont_detected_keyfrm_sets.size());
+    for (unsigned int i = 0; i < prev_cont_detected_keyfrm_sets.size(); ++i) {
+        flag_indices.at(i) = i;
+        for (unsigned int j = 0; j < i; ++j) {
+            if (*prev_cont_detected_keyfrm_sets.at(j).keyfrm_ids_ == *prev_cont_detected_keyfrm_sets.at(i).keyfrm_ids_) {
+                flag_indices.at(i) = j;
+                break;
+            }
+        }
     }
+    std::vector<bool> already_checked(prev_cont_detected_keyfrm_sets.size(), false);
 
+    std::unordered_map<unsigned int, keyframe_expansion> curr_keyfrm_expansions;
     for (const auto& keyfrm_to_search : keyfrms_to_search) {
         // enlarge the candidate to the "keyframe set"
-        const auto keyfrm_set = keyfrm_to_search->graph_node_->get_connected_keyframes();
+        // (the one of the previous call is reused if the connections of the candidate are not changed)
+        const auto version = keyfrm_to_search->graph_node_->get_covisibility_snapshot()->version_;
+        std::shared_ptr<const std::vector<unsigned int>> keyfrm_ids;
+        const auto expansion_itr = keyfrm_expansions_.find(keyfrm_to_search->id_);
+        if (expansion_itr != keyfrm_expansions_.end() && expansion_itr->second.version_ == version
+            && expansion_itr->second.keyfrm_.lock() == keyfrm_to_search) {
+            keyfrm_ids = expansion_itr->second.keyfrm_ids_;
+        }
+        else {
+            keyfrm_ids = std::make_shared<const std::vector<unsigned int>>(keyfrm_to_search->graph_node_->get_connected_keyframe_ids());
+        }
+        auto& expansion = curr_keyfrm_expansions[keyfrm_to_search->id_];
+        expansion.keyfrm_ = keyfrm_to_search;
+        expansion.version_ = version;
+        expansion.keyfrm_ids_ = keyfrm_ids;
 
         // check if the initialization of the buffer is needed or not
         bool initialization_is_needed = true;
 
         // check continuity for each of the previously detected keyframe set
-        for (const auto& prev : prev_cont_detected_keyfrm_sets) {
-            // prev.keyfrm_set_: keyframe set
+        for (unsigned int i = 0; i < prev_cont_detected_keyfrm_sets.size(); ++i) {
+            // prev.keyfrm_ids_: keyframe set
             // prev.lead_keyfrm_: the leader keyframe of the set
             // prev.continuity_: continuity
+            const auto& prev = prev_cont_detected_keyfrm_sets.at(i);
 
             // check if the keyframe set is already counted or not
-            if (already_checked.at(prev.keyfrm_set_)) {
+            if (already_checked.at(flag_indices.at(i))) {
                 continue;
             }
 
             // compute intersection between the previous set and the current set, then check if it is empty or not
-            if (prev.intersection_is_empty(keyfrm_set)) {
+            if (prev.intersection_is_empty(*keyfrm_ids)) {
                 continue;
             }
 
@@ -328,23 +375,27 @@ keyframe_sets loop_detector::find_continuously_detected_keyframe_sets(const keyf
             // create the new statistics by incrementing the continuity
             const auto curr_continuity = prev.continuity_ + 1;
             curr_cont_detected_keyfrm_sets.emplace_back(
-                keyframe_set{keyfrm_set, keyfrm_to_search, curr_continuity});
+                keyframe_set{keyfrm_ids, keyfrm_to_search, curr_continuity});
 
             // this keyframe set is already checked
-            already_checked.at(prev.keyfrm_set_) = true;
+            already_checked.at(flag_indices.at(i)) = true;
         }
 
         // if initialization is needed, add the new statistics
         if (initialization_is_needed) {
             curr_cont_detected_keyfrm_sets.emplace_back(
-                keyframe_set{keyfrm_set, keyfrm_to_search, 0});
+                keyframe_set{keyfrm_ids, keyfrm_to_search, 0});
         }
     }
 
+    // the keyframe sets are reused only in the next call
+    keyfrm_expansions_.swap(curr_keyfrm_expansions);
+
     return curr_cont_detected_keyfrm_sets;
 }
 
-bool loop_detector::select_loop_candidate_via_Sim3(const std::unordered_set<std::shared_ptr<data::keyframe>>& loop_candidates,
+bool loop_detector::select_loop_candidate_via_Sim3(const std::shared_ptr<data::keyframe>& cur_keyfrm,
+                                                   const std::unordered_set<std::shared_ptr<data::keyframe>>& loop_candidates,
                                                    std::shared_ptr<data::keyframe>& selected_candidate,
                                                    g2o::Sim3& g2o_Sim3_world_to_curr,
                                                    std::vector<std::shared_ptr<data::landmark>>& curr_match_lms_observed_in_cand) const {
@@ -352,257 +403,347 @@ bool loop_detector::select_loop_candidate_via_Sim3(const std::unordered_set<std:
     // the Sim3 is estimated both in linear and non-linear ways
     // if the inlier after the estimation is lower than the threshold, discard tha candidate
 
-    match::robust robust_matcher(0.75, false);
-    match::bow_tree bow_matcher(0.75, false);
-    match::projection projection_matcher(0.75, false);
-
+    // the candidates are sorted by the ID to make the result independent of the order of the set
+    std::vector<std::shared_ptr<data::keyframe>> candidates;
+    candidates.reserve(loop_candidates.size());
     for (const auto& candidate : loop_candidates) {
         if (candidate->will_be_erased()) {
             continue;
         }
-
-        // estimate the matches between the keypoints in the current keyframe and the landmarks observed in the candidate
-        curr_match_lms_observed_in_cand.clear();
-        const auto num_matches = bow_matcher.match_keyframes(cur_keyfrm_, candidate, curr_match_lms_observed_in_cand);
-
-        // check the threshold
-        if (num_matches < num_matches_thr_) {
-            continue;
-        }
-
-        spdlog::debug("Checking if the loop candidate is appropriate: keyframe {} - keyframe {} (num_matches: {})", candidate->id_, cur_keyfrm_->id_, num_matches);
-
-        if (num_matches_thr_brute_force_ > 0) {
-            // Look for more correspondence over more time
-            const auto num_matches_brute_force = robust_matcher.match_keyframes(cur_keyfrm_, candidate, curr_match_lms_observed_in_cand, false);
-
-            spdlog::debug("num_matches_brute_force: {}", num_matches_brute_force);
-
-            if (num_matches_brute_force < num_matches_thr_brute_force_) {
-                continue;
-            }
-        }
-
-        std::vector<unsigned int> valid_indices;
-        valid_indices.reserve(curr_match_lms_observed_in_cand.size());
-        for (unsigned int idx = 0; idx < curr_match_lms_observed_in_cand.size(); ++idx) {
-            auto lm = curr_match_lms_observed_in_cand.at(idx);
+        candidates.push_back(candidate);
+    }
+    std::sort(candidates.begin(), candidates.end(), [](const std::shared_ptr<data::keyframe>& a, const std::shared_ptr<data::keyframe>& b) {
+        return a->id_ < b->id_;
+    });
+    const unsigned int num_candidates = candidates.size();
+
+    // prefetch the landmarks of the current keyframe, which are shared among the verifications of the candidates
+    current_landmarks curr_lms;
+    curr_lms.landmarks_ = cur_keyfrm->get_landmarks();
+    curr_lms.pos_cs_.resize(curr_lms.landmarks_.size());
+    {
+        const Mat33_t rot_cw = cur_keyfrm->get_rot_cw();
+        const Vec3_t trans_cw = cur_keyfrm->get_trans_cw();
+        for (unsigned int idx = 0; idx < curr_lms.landmarks_.size(); ++idx) {
+            auto& lm = curr_lms.landmarks_.at(idx);
             if (!lm) {
                 continue;
             }
             if (lm->will_be_erased()) {
+                lm = nullptr;
                 continue;
             }
-            valid_indices.push_back(idx);
+            curr_lms.pos_cs_.at(idx) = rot_cw * lm->get_pos_in_world() + trans_cw;
         }
+    }
 
-        // Resample valid elements
-        const auto valid_bearings = util::resample_by_indices(cur_keyfrm_->frm_obs_.bearings_, valid_indices);
-        const auto valid_keypts = util::resample_by_indices(cur_keyfrm_->frm_obs_.undist_keypts_, valid_indices);
-        const auto valid_assoc_lms = util::resample_by_indices(curr_match_lms_observed_in_cand, valid_indices);
-        eigen_alloc_vector<Vec3_t> valid_landmarks(valid_indices.size());
-        for (unsigned int i = 0; i < valid_indices.size(); ++i) {
-            valid_landmarks.at(i) = valid_assoc_lms.at(i)->get_pos_in_world();
-        }
-        // Setup PnP solver
-        auto pnp_solver = std::unique_ptr<solve::pnp_solver>(new solve::pnp_solver(valid_bearings, valid_keypts, valid_landmarks,
-                                                                                   cur_keyfrm_->orb_params_->scale_factors_,
-                                                                                   use_fixed_seed_));
-
-        pnp_solver->find_via_ransac(30, false);
-        if (!pnp_solver->solution_is_valid()) {
-            spdlog::debug("solution is not valid.");
+    // estimate the matches between the keypoints in the current keyframe and the landmarks observed in each candidate
+    // (NOTE: the number of the matches is used as the cheap pre-score of the candidate)
+    std::vector<std::vector<std::shared_ptr<data::landmark>>> matched_lms(num_candidates);
+    std::vector<unsigned int> num_matches(num_candidates, 0);
+#ifdef USE_OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (int64_t i = 0; i < static_cast<int64_t>(num_candidates); ++i) {
+        match::bow_tree bow_matcher(0.75, false);
+        num_matches.at(i) = bow_matcher.match_keyframes(cur_keyfrm, candidates.at(i), matched_lms.at(i));
+    }
+
+    // rank the candidates in descending order of the number of matches
+    std::vector<unsigned int> ranked_indices;
+    ranked_indices.reserve(num_candidates);
+    for (unsigned int i = 0; i < num_candidates; ++i) {
+        // check the threshold
+        if (num_matches.at(i) < num_matches_thr_) {
             continue;
         }
-
-        const auto inlier_indices = util::resample_by_indices(valid_indices, pnp_solver->get_inlier_flags());
-
-        // Set 2D-3D matches for the pose optimization
-        auto lms_in_cand = std::vector<std::shared_ptr<data::landmark>>(cur_keyfrm_->frm_obs_.num_keypts_, nullptr);
-        for (const auto idx : inlier_indices) {
-            // Set only the valid 3D points to the current frame
-            lms_in_cand.at(idx) = curr_match_lms_observed_in_cand.at(idx);
+        ranked_indices.push_back(i);
+    }
+    std::stable_sort(ranked_indices.begin(), ranked_indices.end(), [&num_matches](const unsigned int a, const unsigned int b) {
+        return num_matches.at(a) > num_matches.at(b);
+    });
+
+    // verify the candidates in parallel
+    // the best-ranked candidate which passes is adopted, and the candidates ranked below it are cancelled
+    // (NOTE: the result does not depend on the number of threads, when the RANSAC seed is fixed)
+    const unsigned int num_ranked = ranked_indices.size();
+    std::atomic<unsigned int> best_rank(num_ranked);
+    eigen_alloc_vector<g2o::Sim3> g2o_Sim3s_world_to_curr(num_ranked);
+#ifdef USE_OPENMP
+#pragma omp parallel for schedule(dynamic, 1)
+#endif
+    for (int64_t rank = 0; rank < static_cast<int64_t>(num_ranked); ++rank) {
+        const auto is_cancelled = [&best_rank, rank] {
+            return best_rank.load() < static_cast<unsigned int>(rank);
+        };
+        if (is_cancelled()) {
+            continue;
         }
-        curr_match_lms_observed_in_cand = lms_in_cand;
-
-        // Pose optimization
-        std::vector<bool> outlier_flags;
-        g2o::SE3Quat optimized_pose;
-        auto num_valid_obs = pose_optimizer_.optimize(pnp_solver->get_best_cam_pose(), cur_keyfrm_->frm_obs_, cur_keyfrm_->orb_params_, cur_keyfrm_->camera_,
-                                                      curr_match_lms_observed_in_cand, optimized_pose, outlier_flags);
-
-        // Discard the candidate if the number of the inliers is less than the threshold
-        const int min_num_matches_after_pose_optimize = 10;
-        if (num_valid_obs < min_num_matches_after_pose_optimize) {
-            spdlog::debug("1. Number of inliers ({}) < threshold ({})", num_valid_obs, min_num_matches_after_pose_optimize);
+        const auto idx = ranked_indices.at(rank);
+        if (!verify_loop_candidate(cur_keyfrm, candidates.at(idx), num_matches.at(idx), curr_lms, matched_lms.at(idx),
+                                   g2o_Sim3s_world_to_curr.at(rank), is_cancelled)) {
             continue;
         }
-
-        // Reject outliers
-        for (unsigned int idx = 0; idx < cur_keyfrm_->frm_obs_.num_keypts_; idx++) {
-            if (!outlier_flags.at(idx)) {
-                continue;
-            }
-            lms_in_cand.at(idx) = nullptr;
+        // cancel the candidates ranked below this one
+        auto prev_best_rank = best_rank.load();
+        while (static_cast<unsigned int>(rank) < prev_best_rank
+               && !best_rank.compare_exchange_weak(prev_best_rank, static_cast<unsigned int>(rank))) {
         }
+    }
 
-        std::set<std::shared_ptr<data::landmark>> already_found_landmarks;
-        for (const auto idx : inlier_indices) {
-            if (outlier_flags.at(idx)) {
-                continue;
-            }
-            // Record the 3D points already associated to the frame keypoints
-            already_found_landmarks.insert(curr_match_lms_observed_in_cand.at(idx));
+    if (best_rank < num_ranked) {
+        const auto idx = ranked_indices.at(best_rank);
+        selected_candidate = candidates.at(idx);
+        g2o_Sim3_world_to_curr = g2o_Sim3s_world_to_curr.at(best_rank);
+        curr_match_lms_observed_in_cand = matched_lms.at(idx);
+        return true;
+    }
+
+    curr_match_lms_observed_in_cand.clear();
+    return false;
+}
+
+bool loop_detector::verify_loop_candidate(const std::shared_ptr<data::keyframe>& cur_keyfrm,
+                                          const std::shared_ptr<data::keyframe>& candidate,
+                                          const unsigned int num_matches,
+                                          const current_landmarks& curr_lms,
+                                          std::vector<std::shared_ptr<data::landmark>>& curr_match_lms_observed_in_cand,
+                                          g2o::Sim3& g2o_Sim3_world_to_curr,
+                                          const std::function<bool()>& is_cancelled) const {
+    match::robust robust_matcher(0.75, false);
+    match::projection projection_matcher(0.75, false);
+    const auto cur_keyfrm_descs = cur_keyfrm->get_descriptors();
+
+    spdlog::debug("Checking if the loop candidate is appropriate: keyframe {} - keyframe {} (num_matches: {})", candidate->id_, cur_keyfrm->id_, num_matches);
+
+    if (num_matches_thr_brute_force_ > 0) {
+        // Look for more correspondence over more time
+        const auto num_matches_brute_force = robust_matcher.match_keyframes(cur_keyfrm, candidate, curr_match_lms_observed_in_cand, false);
+
+        spdlog::debug("num_matches_brute_force: {}", num_matches_brute_force);
+
+        if (num_matches_brute_force < num_matches_thr_brute_force_) {
+            return false;
         }
+    }
 
-        // Projection match based on the pre-optimized camera pose
-        auto num_found = projection_matcher.match_frame_and_keyframe(util::converter::to_eigen_mat(optimized_pose), cur_keyfrm_->camera_, cur_keyfrm_->frm_obs_,
-                                                                     cur_keyfrm_->orb_params_, curr_match_lms_observed_in_cand,
-                                                                     candidate, already_found_landmarks, 10, 100);
-        // Discard the candidate if the number of the inliers is less than the threshold
-        const unsigned int min_num_valid_obs1 = 25;
-        if (already_found_landmarks.size() + num_found < min_num_valid_obs1) {
-            spdlog::debug("2. Number of matches ({}) < threshold ({})",
-                          already_found_landmarks.size() + num_found, min_num_valid_obs1);
+    std::vector<unsigned int> valid_indices;
+    valid_indices.reserve(curr_match_lms_observed_in_cand.size());
+    for (unsigned int idx = 0; idx < curr_match_lms_observed_in_cand.size(); ++idx) {
+        auto lm = curr_match_lms_observed_in_cand.at(idx);
+        if (!lm) {
             continue;
         }
+        if (lm->will_be_erased()) {
+            continue;
+        }
+        valid_indices.push_back(idx);
+    }
+
+    // Resample valid elements
+    const auto valid_bearings = util::resample_by_indices(cur_keyfrm->frm_obs_->bearings_, valid_indices);
+    const auto valid_keypts = util::resample_by_indices(cur_keyfrm->frm_obs_->undist_keypts_, valid_indices);
+    const auto valid_assoc_lms = util::resample_by_indices(curr_match_lms_observed_in_cand, valid_indices);
+    eigen_alloc_vector<Vec3_t> valid_landmarks(valid_indices.size());
+    std::vector<unsigned int> descriptor_distances(valid_indices.size());
+    for (unsigned int i = 0; i < valid_indices.size(); ++i) {
+        valid_landmarks.at(i) = valid_assoc_lms.at(i)->get_pos_in_world();
+        descriptor_distances.at(i) = match::compute_descriptor_distance_32(cur_keyfrm_descs.row(valid_indices.at(i)),
+                                                                           valid_assoc_lms.at(i)->get_descriptor());
+    }
+    // Setup PnP solver
+    auto pnp_solver = std::unique_ptr<solve::pnp_solver>(new solve::pnp_solver(valid_bearings, valid_keypts, valid_landmarks,
+                                                                               cur_keyfrm->orb_params_->scale_factors_,
+                                                                               use_fixed_seed_));
+    pnp_solver->set_descriptor_distances(descriptor_distances);
+
+    pnp_solver->find_via_ransac(30, false);
+    if (!pnp_solver->solution_is_valid()) {
+        spdlog::debug("solution is not valid.");
+        return false;
+    }
+    if (is_cancelled()) {
+        return false;
+    }
+
+    const auto inlier_indices = util::resample_by_indices(valid_indices, pnp_solver->get_inlier_flags());
 
-        g2o::SE3Quat optimized_pose1;
-        std::vector<bool> outlier_flags1;
-        auto num_valid_obs1 = pose_optimizer_.optimize(util::converter::to_eigen_mat(optimized_pose),
-                                                       cur_keyfrm_->frm_obs_, cur_keyfrm_->orb_params_, cur_keyfrm_->camera_,
-                                                       curr_match_lms_observed_in_cand, optimized_pose1, outlier_flags1);
+    // Set 2D-3D matches for the pose optimization
+    auto lms_in_cand = std::vector<std::shared_ptr<data::landmark>>(cur_keyfrm->frm_obs_->num_keypts_, nullptr);
+    for (const auto idx : inlier_indices) {
+        // Set only the valid 3D points to the current frame
+        lms_in_cand.at(idx) = curr_match_lms_observed_in_cand.at(idx);
+    }
+    curr_match_lms_observed_in_cand = lms_in_cand;
+
+    // Pose optimization
+    std::vector<bool> outlier_flags;
+    g2o::SE3Quat optimized_pose;
+    auto num_valid_obs = pose_optimizer_.optimize(pnp_solver->get_best_cam_pose(), *cur_keyfrm->frm_obs_, cur_keyfrm->orb_params_, cur_keyfrm->camera_,
+                                                  curr_match_lms_observed_in_cand, optimized_pose, outlier_flags);
+
+    // Discard the candidate if the number of the inliers is less than the threshold
+    const int min_num_matches_after_pose_optimize = 10;
+    if (num_valid_obs < min_num_matches_after_pose_optimize) {
+        spdlog::debug("1. Number of inliers ({}) < threshold ({})", num_valid_obs, min_num_matches_after_pose_optimize);
+        return false;
+    }
 
-        if (num_valid_obs1 < min_num_valid_obs1) {
-            spdlog::debug("2. Number of inliers ({}) < threshold ({})", num_valid_obs1, min_num_valid_obs1);
+    // Reject outliers
+    for (unsigned int idx = 0; idx < cur_keyfrm->frm_obs_->num_keypts_; idx++) {
+        if (!outlier_flags.at(idx)) {
             continue;
         }
+        lms_in_cand.at(idx) = nullptr;
+    }
 
-        // Exclude the already-associated landmarks
-        std::set<std::shared_ptr<data::landmark>> already_found_landmarks1;
-        for (unsigned int idx = 0; idx < cur_keyfrm_->frm_obs_.num_keypts_; ++idx) {
-            if (!curr_match_lms_observed_in_cand.at(idx)) {
-                continue;
-            }
-            already_found_landmarks1.insert(curr_match_lms_observed_in_cand.at(idx));
-        }
-        // Apply projection match again, then set the 2D-3D matches
-        auto num_additional = projection_matcher.match_frame_and_keyframe(util::converter::to_eigen_mat(optimized_pose1), cur_keyfrm_->camera_, cur_keyfrm_->frm_obs_,
-                                                                          cur_keyfrm_->orb_params_, curr_match_lms_observed_in_cand,
-                                                                          candidate, already_found_landmarks, 3, 64);
-
-        const unsigned int min_num_valid_obs2 = 40;
-        // Discard if the number of the observations is less than the threshold
-        if (num_valid_obs1 + num_additional < min_num_valid_obs2) {
-            spdlog::debug("3. Number of matches ({}) < threshold ({})", num_valid_obs1 + num_additional, min_num_valid_obs2);
-            return false;
+    std::set<std::shared_ptr<data::landmark>> already_found_landmarks;
+    for (const auto idx : inlier_indices) {
+        if (outlier_flags.at(idx)) {
+            continue;
         }
+        // Record the 3D points already associated to the frame keypoints
+        already_found_landmarks.insert(curr_match_lms_observed_in_cand.at(idx));
+    }
 
-        // Perform optimization again
-        g2o::SE3Quat optimized_pose2;
-        std::vector<bool> outlier_flags2;
-        auto num_valid_obs2 = pose_optimizer_.optimize(util::converter::to_eigen_mat(optimized_pose1),
-                                                       cur_keyfrm_->frm_obs_, cur_keyfrm_->orb_params_, cur_keyfrm_->camera_,
-                                                       curr_match_lms_observed_in_cand, optimized_pose2, outlier_flags2);
+    if (is_cancelled()) {
+        return false;
+    }
 
-        // Discard if falling below the threshold
-        if (num_valid_obs2 < min_num_valid_obs2) {
-            spdlog::debug("3. Number of inliers ({}) < threshold ({})", num_valid_obs2, min_num_valid_obs2);
-            return false;
-        }
+    // Projection match based on the pre-optimized camera pose
+    auto num_found = projection_matcher.match_frame_and_keyframe(util::converter::to_eigen_mat(optimized_pose), cur_keyfrm->camera_, *cur_keyfrm->frm_obs_,
+                                                                 cur_keyfrm_descs, cur_keyfrm->orb_params_, curr_match_lms_observed_in_cand,
+                                                                 candidate, already_found_landmarks, 10, 100);
+    // Discard the candidate if the number of the inliers is less than the threshold
+    const unsigned int min_num_valid_obs1 = 25;
+    if (already_found_landmarks.size() + num_found < min_num_valid_obs1) {
+        spdlog::debug("2. Number of matches ({}) < threshold ({})",
+                      already_found_landmarks.size() + num_found, min_num_valid_obs1);
+        return false;
+    }
 
-        // Reject outliers
-        for (unsigned int idx = 0; idx < cur_keyfrm_->frm_obs_.num_keypts_; ++idx) {
-            if (!outlier_flags2.at(idx)) {
-                continue;
-            }
-            curr_match_lms_observed_in_cand.at(idx) = nullptr;
-        }
+    g2o::SE3Quat optimized_pose1;
+    std::vector<bool> outlier_flags1;
+    auto num_valid_obs1 = pose_optimizer_.optimize(util::converter::to_eigen_mat(optimized_pose),
+                                                   *cur_keyfrm->frm_obs_, cur_keyfrm->orb_params_, cur_keyfrm->camera_,
+                                                   curr_match_lms_observed_in_cand, optimized_pose1, outlier_flags1);
 
-        const Mat44_t pose_1w_in_cand = util::converter::to_eigen_mat(optimized_pose2);
-        const Mat33_t rot_1w_in_cand = pose_1w_in_cand.block<3, 3>(0, 0);
-        const Vec3_t trans_1w_in_cand = pose_1w_in_cand.block<3, 1>(0, 3);
-        auto lms_curr = cur_keyfrm_->get_landmarks();
-        std::vector<float> scales;
-        for (unsigned int idx = 0; idx < lms_curr.size(); ++idx) {
-            auto& lm_curr = lms_curr.at(idx);
-            auto& lm_cand = curr_match_lms_observed_in_cand.at(idx);
-            if (!lm_cand || !lm_curr) {
-                continue;
-            }
-            if (lm_cand->will_be_erased() || lm_curr->will_be_erased()) {
-                continue;
-            }
-            const Vec3_t pos_w_lm_cand = lm_cand->get_pos_in_world();
-            const Vec3_t pos_w_lm_curr = lm_curr->get_pos_in_world();
-            const Vec3_t pos_1_in_cand = rot_1w_in_cand * pos_w_lm_cand + trans_1w_in_cand;
-            const Vec3_t pos_1_in_curr = cur_keyfrm_->get_rot_cw() * pos_w_lm_curr + cur_keyfrm_->get_trans_cw();
-            const float norm_pos_1_in_cand = pos_1_in_cand.norm();
-            const float norm_pos_1_in_curr = pos_1_in_curr.norm();
-            const float cos_parallax = pos_1_in_cand.dot(pos_1_in_curr) / (norm_pos_1_in_cand * norm_pos_1_in_curr);
-            // = cos(0.5deg)
-            constexpr float cos_parallax_thr = 0.99996192306;
-            const bool parallax_is_small = cos_parallax_thr < cos_parallax;
-            if (!parallax_is_small) {
-                continue;
-            }
-            scales.push_back(norm_pos_1_in_curr / norm_pos_1_in_cand);
-        }
-        if (scales.size() < 1) {
-            spdlog::debug("not enough scale references {}", scales.size());
+    if (num_valid_obs1 < min_num_valid_obs1) {
+        spdlog::debug("2. Number of inliers ({}) < threshold ({})", num_valid_obs1, min_num_valid_obs1);
+        return false;
+    }
+
+    // Exclude the already-associated landmarks
+    std::set<std::shared_ptr<data::landmark>> already_found_landmarks1;
+    for (unsigned int idx = 0; idx < cur_keyfrm->frm_obs_->num_keypts_; ++idx) {
+        if (!curr_match_lms_observed_in_cand.at(idx)) {
             continue;
         }
-        const Mat33_t rot_12 = rot_1w_in_cand * candidate->get_rot_cw().transpose();
-        const Vec3_t trans_12 = -rot_12 * candidate->get_trans_cw() + trans_1w_in_cand;
-        std::sort(scales.begin(), scales.end());
-        const float scale_12 = scales[(scales.size() - 1) / 2];
+        already_found_landmarks1.insert(curr_match_lms_observed_in_cand.at(idx));
+    }
+    // Apply projection match again, then set the 2D-3D matches
+    auto num_additional = projection_matcher.match_frame_and_keyframe(util::converter::to_eigen_mat(optimized_pose1), cur_keyfrm->camera_, *cur_keyfrm->frm_obs_,
+                                                                      cur_keyfrm_descs, cur_keyfrm->orb_params_, curr_match_lms_observed_in_cand,
+                                                                      candidate, already_found_landmarks, 3, 64);
+
+    const unsigned int min_num_valid_obs2 = 40;
+    // Discard if the number of the observations is less than the threshold
+    if (num_valid_obs1 + num_additional < min_num_valid_obs2) {
+        spdlog::debug("3. Number of matches ({}) < threshold ({})", num_valid_obs1 + num_additional, min_num_valid_obs2);
+        return false;
+    }
 
-        // perforn non-linear optimization of the estimated Sim3
+    // Perform optimization again
+    g2o::SE3Quat optimized_pose2;
+    std::vector<bool> outlier_flags2;
+    auto num_valid_obs2 = pose_optimizer_.optimize(util::converter::to_eigen_mat(optimized_pose1),
+                                                   *cur_keyfrm->frm_obs_, cur_keyfrm->orb_params_, cur_keyfrm->camera_,
+                                                   curr_match_lms_observed_in_cand, optimized_pose2, outlier_flags2);
 
-        projection_matcher.match_keyframes_mutually(cur_keyfrm_, candidate, curr_match_lms_observed_in_cand,
-                                                    scale_12, rot_12, trans_12, 7.5);
+    // Discard if falling below the threshold
+    if (num_valid_obs2 < min_num_valid_obs2) {
+        spdlog::debug("3. Number of inliers ({}) < threshold ({})", num_valid_obs2, min_num_valid_obs2);
+        return false;
+    }
 
-        g2o::Sim3 g2o_sim3_12(rot_12, trans_12, scale_12);
-        const auto num_optimized_inliers = transform_optimizer_.optimize(cur_keyfrm_, candidate, curr_match_lms_observed_in_cand,
-                                                                         g2o_sim3_12, 10);
+    // Reject outliers
+    for (unsigned int idx = 0; idx < cur_keyfrm->frm_obs_->num_keypts_; ++idx) {
+        if (!outlier_flags2.at(idx)) {
+            continue;
+        }
+        curr_match_lms_observed_in_cand.at(idx) = nullptr;
+    }
 
-        // check the threshold
-        if (num_optimized_inliers < num_optimized_inliers_thr_) {
+    const Mat44_t pose_1w_in_cand = util::converter::to_eigen_mat(optimized_pose2);
+    const Mat33_t rot_1w_in_cand = pose_1w_in_cand.block<3, 3>(0, 0);
+    const Vec3_t trans_1w_in_cand = pose_1w_in_cand.block<3, 1>(0, 3);
+    std::vector<float> scales;
+    for (unsigned int idx = 0; idx < curr_lms.landmarks_.size(); ++idx) {
+        const auto& lm_curr = curr_lms.landmarks_.at(idx);
+        auto& lm_cand = curr_match_lms_observed_in_cand.at(idx);
+        if (!lm_cand || !lm_curr) {
+            continue;
+        }
+        if (lm_cand->will_be_erased()) {
+            continue;
+        }
+        const Vec3_t pos_w_lm_cand = lm_cand->get_pos_in_world();
+        const Vec3_t pos_1_in_cand = rot_1w_in_cand * pos_w_lm_cand + trans_1w_in_cand;
+        const Vec3_t& pos_1_in_curr = curr_lms.pos_cs_.at(idx);
+        const float norm_pos_1_in_cand = pos_1_in_cand.norm();
+        const float norm_pos_1_in_curr = pos_1_in_curr.norm();
+        const float cos_parallax = pos_1_in_cand.dot(pos_1_in_curr) / (norm_pos_1_in_cand * norm_pos_1_in_curr);
+        // = cos(0.5deg)
+        constexpr float cos_parallax_thr = 0.99996192306;
+        const bool parallax_is_small = cos_parallax_thr < cos_parallax;
+        if (!parallax_is_small) {
             continue;
         }
+        scales.push_back(norm_pos_1_in_curr / norm_pos_1_in_cand);
+    }
+    if (scales.size() < 1) {
+        spdlog::debug("not enough scale references {}", scales.size());
+        return false;
+    }
+    const Mat33_t rot_12 = rot_1w_in_cand * candidate->get_rot_cw().transpose();
+    const Vec3_t trans_12 = -rot_12 * candidate->get_trans_cw() + trans_1w_in_cand;
+    std::sort(scales.begin(), scales.end());
+    const float scale_12 = scales[(scales.size() - 1) / 2];
 
-        spdlog::debug("found loop candidate via nonlinear Sim3 optimization: keyframe {} - keyframe {} (num_optimized_inliers: {})", candidate->id_, cur_keyfrm_->id_, num_optimized_inliers);
+    if (is_cancelled()) {
+        return false;
+    }
 
-        selected_candidate = candidate;
-        // convert the estimated Sim3 from "candidate -> current" to "world -> current"
-        // this Sim3 indicates the correct camera pose oof the current keyframe after loop correction
-        g2o_Sim3_world_to_curr = g2o_sim3_12 * g2o::Sim3(candidate->get_rot_cw(), candidate->get_trans_cw(), 1.0);
+    // perforn non-linear optimization of the estimated Sim3
 
-        return true;
-    }
+    projection_matcher.match_keyframes_mutually(cur_keyfrm, candidate, curr_match_lms_observed_in_cand,
+                                                scale_12, rot_12, trans_12, 7.5);
 
-    return false;
-}
+    g2o::Sim3 g2o_sim3_12(rot_12, trans_12, scale_12);
+    const auto num_optimized_inliers = transform_optimizer_.optimize(cur_keyfrm, candidate, curr_match_lms_observed_in_cand,
+                                                                     g2o_sim3_12, 10);
 
-std::shared_ptr<data::keyframe> loop_detector::get_selected_candidate_keyframe() const {
-    return selected_candidate_;
-}
+    // check the threshold
+    if (num_optimized_inliers < num_optimized_inliers_thr_) {
+        return false;
+    }
 
-g2o::Sim3 loop_detector::get_Sim3_world_to_current() const {
-    return g2o_Sim3_world_to_curr_;
-}
+    spdlog::debug("found loop candidate via nonlinear Sim3 optimization: keyframe {} - keyframe {} (num_optimized_inliers: {})", candidate->id_, cur_keyfrm->id_, num_optimized_inliers);
 
-std::vector<std::shared_ptr<data::landmark>> loop_detector::current_matched_landmarks_observed_in_candidate() const {
-    return curr_match_lms_observed_in_cand_;
-}
+    // convert the estimated Sim3 from "candidate -> current" to "world -> current"
+    // this Sim3 indicates the correct camera pose oof the current keyframe after loop correction
+    g2o_Sim3_world_to_curr = g2o_sim3_12 * g2o::Sim3(candidate->get_rot_cw(), candidate->get_trans_cw(), 1.0);
 
-std::vector<std::shared_ptr<data::landmark>> loop_detector::current_matched_landmarks_observed_in_candidate_covisibilities() const {
-    return curr_match_lms_observed_in_cand_covis_;
+    return true;
 }
 
 void loop_detector::set_loop_correct_keyframe_id(const unsigned int loop_correct_keyfrm_id) {
     prev_loop_correct_keyfrm_id_ = loop_correct_keyfrm_id;
 }
 
+unsigned int loop_detector::get_loop_correct_keyframe_id() const {
+    return prev_loop_correct_keyfrm_id_;
+}
+
 } // namespace module
 } // namespace stella_vslam
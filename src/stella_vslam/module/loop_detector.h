@@ -1,13 +1,17 @@
 #ifndef STELLA_VSLAM_MODULE_LOOP_DETECTOR_H
 #define STELLA_VSLAM_MODULE_LOOP_DETECTOR_H
 
+#include "stella_vslam/type.h"
 #include "stella_vslam/data/bow_vocabulary.h"
 #include "stella_vslam/module/type.h"
 #include "stella_vslam/optimize/transform_optimizer.h"
 #include "stella_vslam/optimize/pose_optimizer.h"
 
 #include <atomic>
+#include <cstdint>
+#include <functional>
 #include <memory>
+#include <unordered_map>
 
 #include <yaml-cpp/yaml.h>
 
@@ -20,6 +24,22 @@ class bow_database;
 
 namespace module {
 
+//! loop detected by the loop detector, which is passed to the loop correction
+struct loop_detection {
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    //! current keyframe
+    std::shared_ptr<data::keyframe> cur_keyfrm_ = nullptr;
+    //! final loop candidate
+    std::shared_ptr<data::keyframe> selected_candidate_ = nullptr;
+    //! the Sim3 camera pose of the current keyframe AFTER loop correction
+    g2o::Sim3 g2o_Sim3_world_to_curr_;
+    //! matches between the keypoint indices of the current keyframe and the landmarks observed in the candidate
+    std::vector<std::shared_ptr<data::landmark>> curr_match_lms_observed_in_cand_;
+    //! matches between the keypoint indices of the current keyframe and the landmarks observed in covisibilities of the candidate
+    std::vector<std::shared_ptr<data::landmark>> curr_match_lms_observed_in_cand_covis_;
+};
+
 class loop_detector {
 public:
     EIGEN_MAKE_ALIGNED_OPERATOR_NEW
@@ -55,39 +75,44 @@ public:
     bool detect_loop_candidates();
 
     /**
-     * Add loop candidate
+     * Register the current keyframe to the BoW database without detecting loop candidates
+     * (used to coalesce the back-to-back keyframes)
      */
-    void add_loop_candidate(const std::shared_ptr<data::keyframe>& keyfrm);
+    void skip_loop_detection();
 
     /**
-     * Validate loop candidates selected in detect_loop_candidate()
+     * Add loop candidate
      */
-    bool validate_candidates();
+    void add_loop_candidate(const std::shared_ptr<data::keyframe>& keyfrm);
 
     /**
-     * Get the selected candidate keyframe after loop detection and validation
+     * Get the loop candidates selected in detect_loop_candidate() or added by add_loop_candidate()
      */
-    std::shared_ptr<data::keyframe> get_selected_candidate_keyframe() const;
+    std::unordered_set<std::shared_ptr<data::keyframe>> get_loop_candidates() const;
 
     /**
-     * Get the estimated Sim3 from the world the the current
+     * Validate loop candidates selected in detect_loop_candidate()
      */
-    g2o::Sim3 get_Sim3_world_to_current() const;
+    bool validate_candidates(loop_detection& detection) const;
 
     /**
-     * Get the matches between the keypoint indices of the current keyframe and the landmarks observed in the candidate
+     * Validate the loop candidates of the keyframe, then select ONE candidate from them
+     * (NOTE: this function does not depend on the state of the detection, then it can be called concurrently for several keyframes.
+     *  the caller must disallow the removal of the current keyframe and the candidates during the validation)
      */
-    std::vector<std::shared_ptr<data::landmark>> current_matched_landmarks_observed_in_candidate() const;
+    bool validate_candidates(const std::shared_ptr<data::keyframe>& cur_keyfrm,
+                             const std::unordered_set<std::shared_ptr<data::keyframe>>& loop_candidates,
+                             loop_detection& detection) const;
 
     /**
-     * Get the matches between the keypoint indices of the current keyframe and the landmarks observed in covisibilities of the candidate
+     * Set the keyframe ID when loop correction is performed
      */
-    std::vector<std::shared_ptr<data::landmark>> current_matched_landmarks_observed_in_candidate_covisibilities() const;
+    void set_loop_correct_keyframe_id(const unsigned int loop_correct_keyfrm_id);
 
     /**
-     * Set the keyframe ID when loop correction is performed
+     * Get the keyframe ID when the previous loop correction was performed
      */
-    void set_loop_correct_keyframe_id(const unsigned int loop_correct_keyfrm_id);
+    unsigned int get_loop_correct_keyframe_id() const;
 
 private:
     /**
@@ -95,11 +120,6 @@ private:
      */
     bool detect_loop_candidates_impl();
 
-    /**
-     * called by validate_candidates
-     */
-    bool validate_candidates_impl();
-
     /**
      * Compute the minimum score among covisibilities
      */
@@ -107,19 +127,58 @@ private:
 
     /**
      * Find continuously detected keyframe sets
+     * (the keyframe sets of the candidates found in the previous call are reused if their connections are not changed)
      */
     keyframe_sets find_continuously_detected_keyframe_sets(const keyframe_sets& prev_cont_detected_keyfrm_sets,
-                                                           const std::vector<std::shared_ptr<data::keyframe>>& keyfrms_to_search) const;
+                                                           const std::vector<std::shared_ptr<data::keyframe>>& keyfrms_to_search);
+
+    //! "keyframe set" of a candidate, which consists of the connected keyframes
+    struct keyframe_expansion {
+        //! the candidate (compared to detect the IDs reused after the map is cleared)
+        std::weak_ptr<data::keyframe> keyfrm_;
+        //! version of the covisibility snapshot of the candidate when expanded, which is incremented when the connections change
+        uint64_t version_ = 0;
+        //! IDs of the connected keyframes in ascending order
+        std::shared_ptr<const std::vector<unsigned int>> keyfrm_ids_;
+    };
 
     /**
      * Select ONE candidate from the candidates via linear and nonlinear Sim3 validation
      */
     bool select_loop_candidate_via_Sim3(
+        const std::shared_ptr<data::keyframe>& cur_keyfrm,
         const std::unordered_set<std::shared_ptr<data::keyframe>>& loop_candidates,
         std::shared_ptr<data::keyframe>& selected_candidate,
         g2o::Sim3& g2o_Sim3_world_to_curr,
         std::vector<std::shared_ptr<data::landmark>>& curr_match_lms_observed_in_cand) const;
 
+    //! landmarks of the current keyframe, which are shared among the verifications of the candidates
+    struct current_landmarks {
+        //! landmarks observed in the current keyframe (nullptr if not observed or will be erased)
+        std::vector<std::shared_ptr<data::landmark>> landmarks_;
+        //! positions of the landmarks in the camera coordinates of the current keyframe
+        eigen_alloc_vector<Vec3_t> pos_cs_;
+    };
+
+    /**
+     * Verify the candidate via linear and nonlinear Sim3 validation
+     * @param cur_keyfrm
+     * @param candidate
+     * @param num_matches number of the BoW matches with the candidate
+     * @param curr_lms
+     * @param curr_match_lms_observed_in_cand BoW matches with the candidate (they are refined during the validation)
+     * @param g2o_Sim3_world_to_curr
+     * @param is_cancelled the verification is abandoned between the stages if this returns true
+     * @return
+     */
+    bool verify_loop_candidate(const std::shared_ptr<data::keyframe>& cur_keyfrm,
+                               const std::shared_ptr<data::keyframe>& candidate,
+                               const unsigned int num_matches,
+                               const current_landmarks& curr_lms,
+                               std::vector<std::shared_ptr<data::landmark>>& curr_match_lms_observed_in_cand,
+                               g2o::Sim3& g2o_Sim3_world_to_curr,
+                               const std::function<bool()>& is_cancelled) const;
+
     //! BoW database
     data::bow_database* bow_db_;
     //! BoW vocabulary
@@ -168,29 +227,24 @@ private:
 
     //! current keyframe
     std::shared_ptr<data::keyframe> cur_keyfrm_;
-    //! final loop candidate
-    std::shared_ptr<data::keyframe> selected_candidate_ = nullptr;
 
     //! previously detected keyframe sets as loop candidate
     keyframe_sets cont_detected_keyfrm_sets_;
+    //! keyframe sets of the candidates found in the previous call (key: ID of the candidate)
+    std::unordered_map<unsigned int, keyframe_expansion> keyfrm_expansions_;
     //! loop candidate for validation
     std::unordered_set<std::shared_ptr<data::keyframe>> loop_candidates_to_validate_;
 
-    //! matches between the keypoint indices of the current keyframe and the landmarks observed in the candidate
-    std::vector<std::shared_ptr<data::landmark>> curr_match_lms_observed_in_cand_;
-    //! matches between the keypoint indices of the current keyframe and the landmarks observed in covisibilities of the candidate
-    std::vector<std::shared_ptr<data::landmark>> curr_match_lms_observed_in_cand_covis_;
-
-    //! the Sim3 camera pose of the current keyframe AFTER loop correction (in Mat44_t format)
-    Mat44_t Sim3_world_to_curr_;
-    //! the Sim3 camera pose of the current keyframe AFTER loop correction (in g2o::Sim3 format)
-    g2o::Sim3 g2o_Sim3_world_to_curr_;
-
     //! the keyframe ID when the previouls loop correction was performed
-    unsigned int prev_loop_correct_keyfrm_id_ = 0;
+    //! (NOTE: it is set by the loop correction, which might run concurrently with the detection)
+    std::atomic<unsigned int> prev_loop_correct_keyfrm_id_{0};
 
     //! Use fixed random seed for RANSAC if true
     const bool use_fixed_seed_;
+
+    //! number of the keyframes retrieved by the global descriptor before the BoW scoring
+    //! (0: all the keyframes which share words with the current keyframe are scored)
+    const unsigned int num_global_descriptor_neighbors_;
 };
 
 } // namespace module
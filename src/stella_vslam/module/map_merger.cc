@@ -0,0 +1,309 @@
+#include "stella_vslam/data/keyframe.h"
+#include "stella_vslam/data/landmark.h"
+#include "stella_vslam/data/map_database.h"
+#include "stella_vslam/data/bow_database.h"
+#include "stella_vslam/match/fuse.h"
+#include "stella_vslam/module/map_merger.h"
+#include "stella_vslam/optimize/global_bundle_adjuster.h"
+#include "stella_vslam/util/converter.h"
+#include "stella_vslam/util/yaml.h"
+
+#include <algorithm>
+#include <set>
+#include <unordered_set>
+
+#include <spdlog/spdlog.h>
+
+namespace stella_vslam {
+namespace module {
+
+map_merger::map_merger(data::map_database* map_db, data::bow_database* bow_db, data::bow_vocabulary* bow_vocab,
+                       const YAML::Node& yaml_node, const bool fix_scale)
+    : map_db_(map_db), bow_db_(bow_db),
+      loop_detector_(new loop_detector(bow_db, bow_vocab, util::yaml_optional_ref(yaml_node, "LoopDetector"), fix_scale)),
+      min_bow_score_(util::yaml_optional_ref(yaml_node, "MapMerger")["min_bow_score"].as<float>(0.01)),
+      max_num_candidates_(util::yaml_optional_ref(yaml_node, "MapMerger")["max_num_candidates"].as<unsigned int>(5)),
+      keyfrm_stride_(std::max(1u, util::yaml_optional_ref(yaml_node, "MapMerger")["keyframe_stride"].as<unsigned int>(1))),
+      num_iter_(util::yaml_optional_ref(yaml_node, "GlobalOptimizer")["loop_BA_num_iterations"].as<unsigned int>(10)),
+      linear_solver_type_(optimize::load_linear_solver_type(util::yaml_optional_ref(yaml_node, "GlobalOptimizer")["loop_BA_linear_solver"].as<std::string>("csparse"))) {
+    spdlog::debug("CONSTRUCT: module::map_merger");
+}
+
+unsigned int map_merger::merge() {
+    unsigned int num_merges = 0;
+    std::vector<std::shared_ptr<data::keyframe>> merged_roots;
+    bool merged = true;
+    while (merged) {
+        merged = false;
+        const auto roots = map_db_->get_spanning_roots();
+        if (roots.size() < 2) {
+            break;
+        }
+        for (const auto& root : roots) {
+            loop_detection detection;
+            if (!detect_inter_map_loop(root, detection)) {
+                continue;
+            }
+            merge_maps(detection);
+            merged_roots.push_back(detection.selected_candidate_->graph_node_->get_spanning_root());
+            ++num_merges;
+            merged = true;
+            // the spanning roots are changed
+            break;
+        }
+    }
+
+    // optimize each merged map once
+    std::set<std::shared_ptr<data::keyframe>> already_optimized;
+    for (const auto& root : map_db_->get_spanning_roots()) {
+        for (const auto& merged_root : merged_roots) {
+            if (merged_root->graph_node_->get_spanning_root() == root && !already_optimized.count(root)) {
+                optimize_merged_map(root);
+                already_optimized.insert(root);
+            }
+        }
+    }
+
+    spdlog::info("merged the maps {} times, {} maps remain", num_merges, map_db_->get_spanning_roots().size());
+    return num_merges;
+}
+
+bool map_merger::detect_inter_map_loop(const std::shared_ptr<data::keyframe>& root, loop_detection& detection) const {
+    const auto keyfrms = root->graph_node_->get_keyframes_from_root();
+    // the candidates in the same map are rejected
+    const std::set<std::shared_ptr<data::keyframe>> keyfrms_to_reject(keyfrms.begin(), keyfrms.end());
+
+    for (unsigned int i = 0; i < keyfrms.size(); i += keyfrm_stride_) {
+        const auto& keyfrm = keyfrms.at(i);
+        if (keyfrm->will_be_erased()) {
+            continue;
+        }
+
+        const auto candidates = bow_db_->acquire_keyframes(keyfrm->bow_vec_, min_bow_score_, keyfrms_to_reject);
+        std::unordered_set<std::shared_ptr<data::keyframe>> loop_candidates;
+        for (const auto& candidate : candidates) {
+            if (candidate->will_be_erased()) {
+                continue;
+            }
+            loop_candidates.insert(candidate);
+            if (max_num_candidates_ <= loop_candidates.size()) {
+                break;
+            }
+        }
+        if (loop_candidates.empty()) {
+            continue;
+        }
+
+        if (loop_detector_->validate_candidates(keyfrm, loop_candidates, detection)) {
+            spdlog::info("detect an inter-map loop: keyframe {} (map of {}) - keyframe {} (map of {})",
+                         keyfrm->id_, root->id_, detection.selected_candidate_->id_,
+                         detection.selected_candidate_->graph_node_->get_spanning_root()->id_);
+            return true;
+        }
+    }
+    return false;
+}
+
+void map_merger::merge_maps(const loop_detection& detection) {
+    const auto& cur_keyfrm = detection.cur_keyfrm_;
+    const auto& candidate = detection.selected_candidate_;
+    auto cur_root = cur_keyfrm->graph_node_->get_spanning_root();
+    auto cand_root = candidate->graph_node_->get_spanning_root();
+
+    const auto keyfrms = cur_root->graph_node_->get_keyframes_from_root();
+    std::vector<std::shared_ptr<data::landmark>> lms;
+    {
+        std::unordered_set<unsigned int> already_found_landmark_ids;
+        for (const auto& keyfrm : keyfrms) {
+            for (const auto& lm : keyfrm->get_landmarks()) {
+                if (!lm || lm->will_be_erased() || already_found_landmark_ids.count(lm->id_)) {
+                    continue;
+                }
+                already_found_landmark_ids.insert(lm->id_);
+                lms.push_back(lm);
+            }
+        }
+    }
+
+    {
+        std::lock_guard<util::profiled_mutex> lock(data::map_database::mtx_database_);
+
+        // 1. align the map of the current keyframe to the map of the candidate
+
+        // world (of the current map) -> current
+        const Mat44_t cam_pose_cw = cur_keyfrm->get_pose_cw();
+        const g2o::Sim3 Sim3_cw_cur_map(cam_pose_cw.block<3, 3>(0, 0), cam_pose_cw.block<3, 1>(0, 3), 1.0);
+        // world (of the candidate map) -> world (of the current map)
+        const g2o::Sim3 Sim3_cur_cand = Sim3_cw_cur_map.inverse() * detection.g2o_Sim3_world_to_curr_;
+        const g2o::Sim3 Sim3_cand_cur = Sim3_cur_cand.inverse();
+
+        for (const auto& keyfrm : keyfrms) {
+            const Mat44_t pose_cw = keyfrm->get_pose_cw();
+            const g2o::Sim3 Sim3_cw(pose_cw.block<3, 3>(0, 0), pose_cw.block<3, 1>(0, 3), 1.0);
+            const g2o::Sim3 Sim3_cw_after_merge = Sim3_cw * Sim3_cur_cand;
+            const auto s_cw = Sim3_cw_after_merge.scale();
+            const Mat33_t rot_cw = Sim3_cw_after_merge.rotation().toRotationMatrix();
+            const Vec3_t trans_cw = Sim3_cw_after_merge.translation() / s_cw;
+            keyfrm->set_pose_cw(util::converter::to_eigen_pose(rot_cw, trans_cw));
+        }
+        for (const auto& lm : lms) {
+            lm->set_pos_in_world(Sim3_cand_cur.map(lm->get_pos_in_world()));
+        }
+
+        // 2. join the spanning trees (the current keyframe becomes the child of the candidate)
+
+        // reverse the path from the current keyframe to the root
+        std::vector<std::shared_ptr<data::keyframe>> path{cur_keyfrm};
+        while (!path.back()->graph_node_->is_spanning_root()) {
+            path.push_back(path.back()->graph_node_->get_spanning_parent());
+        }
+        for (unsigned int k = 0; k + 1 < path.size(); ++k) {
+            path.at(k + 1)->graph_node_->erase_spanning_child(path.at(k));
+        }
+        for (unsigned int k = path.size() - 1; 0 < k; --k) {
+            path.at(k)->graph_node_->change_spanning_parent(path.at(k - 1));
+        }
+        cur_keyfrm->graph_node_->change_spanning_parent(candidate);
+        for (const auto& keyfrm : keyfrms) {
+            keyfrm->graph_node_->set_spanning_root(cand_root);
+        }
+        map_db_->erase_spanning_root(cur_root);
+
+        // add a loop edge
+        candidate->graph_node_->add_loop_edge(cur_keyfrm);
+        cur_keyfrm->graph_node_->add_loop_edge(candidate);
+    }
+
+    // 3. fuse the landmarks around the inter-map loop
+    replace_duplicated_landmarks(detection);
+
+    auto covisibilities = cur_keyfrm->graph_node_->get_covisibilities();
+    covisibilities.push_back(cur_keyfrm);
+    covisibilities.push_back(candidate);
+    for (const auto& covisibility : covisibilities) {
+        covisibility->graph_node_->update_connections(map_db_->get_min_num_shared_lms());
+    }
+}
+
+void map_merger::replace_duplicated_landmarks(const loop_detection& detection) const {
+    const auto& cur_keyfrm = detection.cur_keyfrm_;
+    const auto& curr_match_lms_observed_in_cand = detection.curr_match_lms_observed_in_cand_;
+    {
+        std::lock_guard<util::profiled_mutex> lock(data::map_database::mtx_database_);
+
+        for (unsigned int idx = 0; idx < cur_keyfrm->frm_obs_->num_keypts_; ++idx) {
+            auto curr_match_lm_in_cand = curr_match_lms_observed_in_cand.at(idx);
+            if (!curr_match_lm_in_cand || curr_match_lm_in_cand->will_be_erased()) {
+                continue;
+            }
+
+            const auto& lm_in_curr = cur_keyfrm->get_landmark(idx);
+            if (lm_in_curr) {
+                if (lm_in_curr->id_ != curr_match_lm_in_cand->id_) {
+                    lm_in_curr->replace(curr_match_lm_in_cand, map_db_);
+                    if (!curr_match_lm_in_cand->has_representative_descriptor()) {
+                        curr_match_lm_in_cand->compute_descriptor();
+                    }
+                    if (!curr_match_lm_in_cand->has_valid_prediction_parameters()) {
+                        curr_match_lm_in_cand->update_mean_normal_and_obs_scale_variance();
+                    }
+                }
+            }
+            else if (!curr_match_lm_in_cand->is_observed_in_keyframe(cur_keyfrm)) {
+                curr_match_lm_in_cand->connect_to_keyframe(cur_keyfrm, idx);
+                curr_match_lm_in_cand->update_mean_normal_and_obs_scale_variance();
+                curr_match_lm_in_cand->compute_descriptor();
+            }
+        }
+    }
+
+    // reproject the landmarks around the candidate to the covisibilities of the current keyframe (already aligned)
+    const auto& curr_match_lms_observed_in_cand_covis = detection.curr_match_lms_observed_in_cand_covis_;
+    auto neighbors = cur_keyfrm->graph_node_->get_covisibilities();
+    neighbors.push_back(cur_keyfrm);
+    match::fuse fuse_matcher(0.8);
+    for (const auto& neighbor : neighbors) {
+        std::unordered_map<std::shared_ptr<data::landmark>, std::shared_ptr<data::landmark>> duplicated_lms_in_keyfrm;
+        std::unordered_map<unsigned int, std::shared_ptr<data::landmark>> new_connections;
+        const Mat44_t cam_pose_cw = neighbor->get_pose_cw();
+        fuse_matcher.detect_duplication(neighbor, cam_pose_cw.block<3, 3>(0, 0), cam_pose_cw.block<3, 1>(0, 3),
+                                        curr_match_lms_observed_in_cand_covis, 4.0, duplicated_lms_in_keyfrm, new_connections);
+
+        std::lock_guard<util::profiled_mutex> lock(data::map_database::mtx_database_);
+
+        for (const auto& best_idx_lm : new_connections) {
+            const auto& lm = best_idx_lm.second;
+            lm->connect_to_keyframe(neighbor, best_idx_lm.first);
+            lm->update_mean_normal_and_obs_scale_variance();
+            lm->compute_descriptor();
+        }
+        for (const auto& lms_pair : duplicated_lms_in_keyfrm) {
+            const auto& lm_to_replace = lms_pair.first;
+            const auto& lm_in_neighbor = lms_pair.second;
+            if (lm_to_replace->id_ != lm_in_neighbor->id_) {
+                lm_to_replace->replace(lm_in_neighbor, map_db_);
+                if (!lm_in_neighbor->has_representative_descriptor()) {
+                    lm_in_neighbor->compute_descriptor();
+                }
+                if (!lm_in_neighbor->has_valid_prediction_parameters()) {
+                    lm_in_neighbor->update_mean_normal_and_obs_scale_variance();
+                }
+            }
+        }
+    }
+}
+
+void map_merger::optimize_merged_map(const std::shared_ptr<data::keyframe>& keyfrm) const {
+    spdlog::info("start global BA of the merged map");
+    const auto keyfrms = keyfrm->graph_node_->get_keyframes_from_root();
+    const auto global_BA = optimize::global_bundle_adjuster(num_iter_, false, linear_solver_type_);
+    std::unordered_set<unsigned int> optimized_keyfrm_ids;
+    std::unordered_set<unsigned int> optimized_landmark_ids;
+    eigen_alloc_unord_map<unsigned int, Vec3_t> lm_to_pos_w_after_global_BA;
+    eigen_alloc_unord_map<unsigned int, Mat44_t> keyfrm_to_pose_cw_after_global_BA;
+    if (!global_BA.optimize(keyfrms, optimized_keyfrm_ids, optimized_landmark_ids,
+                            lm_to_pos_w_after_global_BA, keyfrm_to_pose_cw_after_global_BA)) {
+        spdlog::warn("global BA of the merged map failed");
+        return;
+    }
+
+    std::lock_guard<util::profiled_mutex> lock(data::map_database::mtx_database_);
+
+    // the keyframes and the landmarks which are not optimized follow their reference keyframes
+    eigen_alloc_unord_map<unsigned int, Mat44_t> keyfrm_to_cam_pose_cw_before_BA;
+    for (const auto& keyfrm_to_update : keyfrms) {
+        keyfrm_to_cam_pose_cw_before_BA[keyfrm_to_update->id_] = keyfrm_to_update->get_pose_cw();
+        if (optimized_keyfrm_ids.count(keyfrm_to_update->id_)) {
+            keyfrm_to_update->set_pose_cw(keyfrm_to_pose_cw_after_global_BA.at(keyfrm_to_update->id_));
+        }
+    }
+
+    std::unordered_set<unsigned int> already_found_landmark_ids;
+    for (const auto& keyfrm_to_update : keyfrms) {
+        for (const auto& lm : keyfrm_to_update->get_landmarks()) {
+            if (!lm || lm->will_be_erased() || already_found_landmark_ids.count(lm->id_)) {
+                continue;
+            }
+            already_found_landmark_ids.insert(lm->id_);
+
+            if (optimized_landmark_ids.count(lm->id_)) {
+                lm->set_pos_in_world(lm_to_pos_w_after_global_BA.at(lm->id_));
+            }
+            else {
+                auto ref_keyfrm = lm->get_ref_keyframe();
+                if (!ref_keyfrm || !keyfrm_to_cam_pose_cw_before_BA.count(ref_keyfrm->id_)) {
+                    continue;
+                }
+                const Mat44_t& pose_cw_before_BA = keyfrm_to_cam_pose_cw_before_BA.at(ref_keyfrm->id_);
+                const Vec3_t pos_c = pose_cw_before_BA.block<3, 3>(0, 0) * lm->get_pos_in_world() + pose_cw_before_BA.block<3, 1>(0, 3);
+                const Mat44_t cam_pose_wc = ref_keyfrm->get_pose_wc();
+                lm->set_pos_in_world(cam_pose_wc.block<3, 3>(0, 0) * pos_c + cam_pose_wc.block<3, 1>(0, 3));
+            }
+            lm->update_mean_normal_and_obs_scale_variance();
+        }
+    }
+    spdlog::info("finish global BA of the merged map");
+}
+
+} // namespace module
+} // namespace stella_vslam
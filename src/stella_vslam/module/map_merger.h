@@ -0,0 +1,101 @@
+#ifndef STELLA_VSLAM_MODULE_MAP_MERGER_H
+#define STELLA_VSLAM_MODULE_MAP_MERGER_H
+
+#include "stella_vslam/module/loop_detector.h"
+#include "stella_vslam/optimize/linear_solver_type.h"
+
+#include <memory>
+#include <vector>
+
+#include <yaml-cpp/yaml.h>
+
+namespace stella_vslam {
+
+namespace data {
+class keyframe;
+class map_database;
+} // namespace data
+
+namespace module {
+
+/**
+ * Merger of the maps (the spanning trees) in the map database
+ * The maps are built separately (e.g. by the sessions mapped in parallel) and loaded into one map database.
+ * The inter-map loops are detected with the BoW database and validated by the Sim3 estimation of the loop detector,
+ * then each map is aligned to the other one and the spanning trees are joined.
+ * A global BA over the merged map is performed at the end.
+ */
+class map_merger {
+public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    /**
+     * Constructor
+     * @param map_db
+     * @param bow_db
+     * @param bow_vocab
+     * @param yaml_node (the whole config, the LoopDetector, GlobalOptimizer and MapMerger sections are used)
+     * @param fix_scale
+     */
+    map_merger(data::map_database* map_db, data::bow_database* bow_db, data::bow_vocabulary* bow_vocab,
+               const YAML::Node& yaml_node, const bool fix_scale);
+
+    /**
+     * Destructor
+     */
+    ~map_merger() = default;
+
+    /**
+     * Merge the maps until no inter-map loop is found, then perform the global BA over each merged map
+     * (NOTE: the other threads must be paused)
+     * @return the number of the merges
+     */
+    unsigned int merge();
+
+    /**
+     * Align the map of the current keyframe to the map of the selected candidate, then join the spanning trees
+     * (NOTE: the mapping module must be paused, and the map database is locked while the map is aligned)
+     */
+    void merge_maps(const loop_detection& detection);
+
+private:
+    /**
+     * Find an inter-map loop from a keyframe of the map of `root` to the other maps
+     */
+    bool detect_inter_map_loop(const std::shared_ptr<data::keyframe>& root, loop_detection& detection) const;
+
+    /**
+     * Resolve the duplications of the landmarks between the current keyframe and the selected candidate
+     */
+    void replace_duplicated_landmarks(const loop_detection& detection) const;
+
+    /**
+     * Perform the global BA over the map of the keyframe
+     */
+    void optimize_merged_map(const std::shared_ptr<data::keyframe>& keyfrm) const;
+
+    //! map database
+    data::map_database* map_db_ = nullptr;
+    //! BoW database
+    data::bow_database* bow_db_ = nullptr;
+
+    //! loop detector (used for the Sim3 validation)
+    std::unique_ptr<loop_detector> loop_detector_ = nullptr;
+
+    //! minimum BoW score of the inter-map candidates
+    const float min_bow_score_;
+    //! maximum number of the candidates validated for each keyframe
+    const unsigned int max_num_candidates_;
+    //! stride of the keyframes which query the inter-map candidates
+    const unsigned int keyfrm_stride_;
+
+    //! number of the iterations of the global BA
+    const unsigned int num_iter_;
+    //! linear solver type of the global BA
+    const optimize::linear_solver_type_t linear_solver_type_;
+};
+
+} // namespace module
+} // namespace stella_vslam
+
+#endif // STELLA_VSLAM_MODULE_MAP_MERGER_H
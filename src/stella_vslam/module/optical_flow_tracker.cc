@@ -0,0 +1,173 @@
+#include "stella_vslam/data/frame.h"
+#include "stella_vslam/data/landmark.h"
+#include "stella_vslam/module/optical_flow_tracker.h"
+#include "stella_vslam/util/latency_profiler.h"
+
+#include <opencv2/video/tracking.hpp>
+#include <spdlog/spdlog.h>
+
+namespace stella_vslam {
+namespace module {
+
+optical_flow_tracker::optical_flow_tracker(const unsigned int win_size,
+                                           const unsigned int max_level,
+                                           const unsigned int max_num_frames,
+                                           const double min_tracked_ratio,
+                                           const unsigned int min_num_tracked,
+                                           const double max_forward_backward_error)
+    : win_size_(win_size),
+      max_level_(max_level),
+      max_num_frames_(max_num_frames),
+      min_tracked_ratio_(min_tracked_ratio),
+      min_num_tracked_(min_num_tracked),
+      max_forward_backward_error_(max_forward_backward_error) {
+    spdlog::debug("CONSTRUCT: module::optical_flow_tracker");
+}
+
+optical_flow_tracker::optical_flow_tracker(const YAML::Node& yaml_node)
+    : optical_flow_tracker(yaml_node["win_size"].as<unsigned int>(21),
+                           yaml_node["max_level"].as<unsigned int>(3),
+                           yaml_node["max_num_frames"].as<unsigned int>(4),
+                           yaml_node["min_tracked_ratio"].as<double>(0.7),
+                           yaml_node["min_num_tracked"].as<unsigned int>(50),
+                           yaml_node["max_forward_backward_error"].as<double>(1.0)) {}
+
+void optical_flow_tracker::reset() {
+    ref_pyramid_.clear();
+    curr_pyramid_.clear();
+    ref_keypts_.clear();
+    ref_descriptors_.release();
+    ref_lms_.clear();
+    ref_is_available_ = false;
+    extraction_is_requested_ = false;
+    num_frames_since_extraction_ = 0;
+    num_tracked_at_extraction_ = 0;
+}
+
+bool optical_flow_tracker::is_available() const {
+    if (!ref_is_available_ || extraction_is_requested_) {
+        return false;
+    }
+    if (max_num_frames_ <= num_frames_since_extraction_) {
+        return false;
+    }
+    // the flow track quality drops
+    return min_num_tracked_ <= ref_keypts_.size()
+           && min_tracked_ratio_ * num_tracked_at_extraction_ <= ref_keypts_.size();
+}
+
+bool optical_flow_tracker::track(const cv::Mat& img_gray, std::vector<cv::KeyPoint>& keypts, cv::Mat& descriptors,
+                                 std::vector<std::shared_ptr<data::landmark>>& lms) {
+    STELLA_VSLAM_LATENCY_SPAN("optical_flow_tracker::track");
+
+    keypts.clear();
+    lms.clear();
+    if (!is_available()) {
+        return false;
+    }
+
+    const cv::Size win_size(win_size_, win_size_);
+    const cv::TermCriteria criteria(cv::TermCriteria::COUNT + cv::TermCriteria::EPS, 30, 0.01);
+    cv::buildOpticalFlowPyramid(img_gray, curr_pyramid_, win_size, max_level_);
+
+    std::vector<cv::Point2f> ref_pts;
+    ref_pts.reserve(ref_keypts_.size());
+    for (const auto& keypt : ref_keypts_) {
+        ref_pts.push_back(keypt.pt);
+    }
+
+    // forward flow
+    std::vector<cv::Point2f> curr_pts;
+    std::vector<uchar> status;
+    std::vector<float> err;
+    cv::calcOpticalFlowPyrLK(ref_pyramid_, curr_pyramid_, ref_pts, curr_pts, status, err, win_size, max_level_, criteria);
+
+    // backward flow to reject the drifted tracks
+    std::vector<cv::Point2f> back_pts;
+    std::vector<uchar> back_status;
+    cv::calcOpticalFlowPyrLK(curr_pyramid_, ref_pyramid_, curr_pts, back_pts, back_status, err, win_size, max_level_, criteria);
+
+    const float max_sq_error = max_forward_backward_error_ * max_forward_backward_error_;
+    std::vector<int> tracked_indices;
+    tracked_indices.reserve(ref_pts.size());
+    for (unsigned int idx = 0; idx < ref_pts.size(); ++idx) {
+        if (!status.at(idx) || !back_status.at(idx)) {
+            continue;
+        }
+        const auto& pt = curr_pts.at(idx);
+        if (pt.x < 0 || img_gray.cols <= pt.x || pt.y < 0 || img_gray.rows <= pt.y) {
+            continue;
+        }
+        const cv::Point2f back_error = back_pts.at(idx) - ref_pts.at(idx);
+        if (max_sq_error < back_error.dot(back_error)) {
+            continue;
+        }
+        if (ref_lms_.at(idx)->will_be_erased()) {
+            continue;
+        }
+        tracked_indices.push_back(idx);
+    }
+
+    if (tracked_indices.size() < min_num_tracked_) {
+        spdlog::debug("optical flow tracking failed: {} tracked keypoints < {}", tracked_indices.size(), min_num_tracked_);
+        return false;
+    }
+
+    keypts.reserve(tracked_indices.size());
+    lms.reserve(tracked_indices.size());
+    descriptors.create(tracked_indices.size(), ref_descriptors_.cols, ref_descriptors_.type());
+    for (unsigned int i = 0; i < tracked_indices.size(); ++i) {
+        const auto idx = tracked_indices.at(i);
+        keypts.push_back(ref_keypts_.at(idx));
+        keypts.back().pt = curr_pts.at(idx);
+        ref_descriptors_.row(idx).copyTo(descriptors.row(i));
+        lms.push_back(ref_lms_.at(idx));
+    }
+
+    return true;
+}
+
+void optical_flow_tracker::update_reference(const cv::Mat& img_gray, const std::vector<cv::KeyPoint>& keypts, const data::frame& frm,
+                                            const bool tracking_succeeded, const bool extraction_is_requested) {
+    if (!tracking_succeeded) {
+        reset();
+        return;
+    }
+
+    const bool is_tracked_by_optical_flow = frm.frm_obs_->is_tracked_by_optical_flow_;
+
+    // the inliers of the frame are followed in the next frame
+    ref_keypts_.clear();
+    ref_lms_.clear();
+    std::vector<int> inlier_indices;
+    for (unsigned int idx = 0; idx < frm.frm_obs_->num_keypts_; ++idx) {
+        const auto& lm = frm.get_landmark(idx);
+        if (!lm || lm->will_be_erased()) {
+            continue;
+        }
+        inlier_indices.push_back(idx);
+        ref_keypts_.push_back(keypts.at(idx));
+        ref_lms_.push_back(lm);
+    }
+    ref_descriptors_.create(inlier_indices.size(), frm.frm_obs_->descriptors_.cols, frm.frm_obs_->descriptors_.type());
+    for (unsigned int i = 0; i < inlier_indices.size(); ++i) {
+        frm.frm_obs_->descriptors_.row(inlier_indices.at(i)).copyTo(ref_descriptors_.row(i));
+    }
+
+    // reuse the pyramid built in track()
+    if (is_tracked_by_optical_flow) {
+        ref_pyramid_.swap(curr_pyramid_);
+        ++num_frames_since_extraction_;
+    }
+    else {
+        cv::buildOpticalFlowPyramid(img_gray, ref_pyramid_, cv::Size(win_size_, win_size_), max_level_);
+        num_frames_since_extraction_ = 0;
+        num_tracked_at_extraction_ = ref_keypts_.size();
+    }
+
+    ref_is_available_ = true;
+    extraction_is_requested_ = extraction_is_requested;
+}
+
+} // namespace module
+} // namespace stella_vslam
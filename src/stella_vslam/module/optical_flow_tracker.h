@@ -0,0 +1,108 @@
+#ifndef STELLA_VSLAM_MODULE_OPTICAL_FLOW_TRACKER_H
+#define STELLA_VSLAM_MODULE_OPTICAL_FLOW_TRACKER_H
+
+#include <memory>
+#include <vector>
+
+#include <opencv2/core/mat.hpp>
+#include <opencv2/core/types.hpp>
+#include <yaml-cpp/yaml.h>
+
+namespace stella_vslam {
+
+namespace data {
+class frame;
+class landmark;
+} // namespace data
+
+namespace module {
+
+/**
+ * Tracker which follows the inlier keypoints of the last frame into the current image by the pyramidal KLT optical flow,
+ * so that the ORB extraction can be skipped while the flow track is reliable
+ * The followed keypoints carry over the descriptors and the 2D-3D associations of the last frame.
+ */
+class optical_flow_tracker {
+public:
+    explicit optical_flow_tracker(const unsigned int win_size = 21,
+                                  const unsigned int max_level = 3,
+                                  const unsigned int max_num_frames = 4,
+                                  const double min_tracked_ratio = 0.7,
+                                  const unsigned int min_num_tracked = 50,
+                                  const double max_forward_backward_error = 1.0);
+
+    explicit optical_flow_tracker(const YAML::Node& yaml_node);
+
+    virtual ~optical_flow_tracker() = default;
+
+    //! Discard the reference
+    void reset();
+
+    /**
+     * Check whether the next frame can be tracked by the optical flow, that is,
+     * the reference is available, the number of the frames since the last ORB extraction is less than max_num_frames,
+     * and the keypoints are tracked well enough compared to the last ORB extraction
+     */
+    bool is_available() const;
+
+    /**
+     * Follow the reference keypoints into the image
+     * @param img_gray grayscale image of the current frame
+     * @param keypts followed keypoints (distorted)
+     * @param descriptors descriptors of the followed keypoints (copied from the reference)
+     * @param lms landmarks associated with the followed keypoints
+     * @return true if enough keypoints are followed
+     */
+    bool track(const cv::Mat& img_gray, std::vector<cv::KeyPoint>& keypts, cv::Mat& descriptors,
+               std::vector<std::shared_ptr<data::landmark>>& lms);
+
+    /**
+     * Update the reference with the tracked frame
+     * @param img_gray grayscale image of the frame
+     * @param keypts keypoints of the frame (distorted)
+     * @param frm tracked frame
+     * @param tracking_succeeded tracking of the frame succeeded or not
+     * @param extraction_is_requested ORB extraction is needed for the next frame (e.g. a new keyframe is likely)
+     */
+    void update_reference(const cv::Mat& img_gray, const std::vector<cv::KeyPoint>& keypts, const data::frame& frm,
+                          const bool tracking_succeeded, const bool extraction_is_requested);
+
+private:
+    //! Window size of the KLT search at each level
+    const unsigned int win_size_;
+    //! Maximum pyramid level of the KLT search (0 means the original image only)
+    const unsigned int max_level_;
+    //! Maximum number of the consecutive frames tracked by the optical flow
+    const unsigned int max_num_frames_;
+    //! Minimum ratio of the tracked landmarks to the ones just after the last ORB extraction
+    const double min_tracked_ratio_;
+    //! Minimum number of the followed keypoints
+    const unsigned int min_num_tracked_;
+    //! Maximum distance between the reference keypoint and the one tracked back from the current image
+    const double max_forward_backward_error_;
+
+    //! KLT pyramid of the reference image
+    std::vector<cv::Mat> ref_pyramid_;
+    //! KLT pyramid of the current image (becomes the reference if the current frame is tracked by the optical flow)
+    std::vector<cv::Mat> curr_pyramid_;
+    //! Reference keypoints (inliers of the reference frame)
+    std::vector<cv::KeyPoint> ref_keypts_;
+    //! Descriptors of the reference keypoints
+    cv::Mat ref_descriptors_;
+    //! Landmarks associated with the reference keypoints
+    std::vector<std::shared_ptr<data::landmark>> ref_lms_;
+
+    //! Whether the reference is available or not
+    bool ref_is_available_ = false;
+    //! ORB extraction is requested for the next frame or not
+    bool extraction_is_requested_ = false;
+    //! Number of the frames tracked by the optical flow since the last ORB extraction
+    unsigned int num_frames_since_extraction_ = 0;
+    //! Number of the tracked landmarks just after the last ORB extraction
+    unsigned int num_tracked_at_extraction_ = 0;
+};
+
+} // namespace module
+} // namespace stella_vslam
+
+#endif // STELLA_VSLAM_MODULE_OPTICAL_FLOW_TRACKER_H
@@ -2,23 +2,33 @@
 #include "stella_vslam/data/keyframe.h"
 #include "stella_vslam/data/landmark.h"
 #include "stella_vslam/data/bow_database.h"
+#include "stella_vslam/data/landmark_descriptor_index.h"
+#include "stella_vslam/data/map_database.h"
 #include "stella_vslam/module/local_map_updater.h"
 #include "stella_vslam/module/relocalizer.h"
 #include "stella_vslam/util/fancy_index.h"
 
 #include <spdlog/spdlog.h>
 
+#include <algorithm>
+#include <atomic>
+#include <unordered_map>
+
 namespace stella_vslam {
 namespace module {
 
 relocalizer::relocalizer(const double bow_match_lowe_ratio, const double proj_match_lowe_ratio,
                          const double robust_match_lowe_ratio,
                          const unsigned int min_num_bow_matches, const unsigned int min_num_valid_obs,
-                         const bool use_fixed_seed)
+                         const bool use_fixed_seed, const bool use_p3p,
+                         const bool use_landmark_index, const double landmark_index_lowe_ratio,
+                         const unsigned int num_global_descriptor_neighbors)
     : min_num_bow_matches_(min_num_bow_matches), min_num_valid_obs_(min_num_valid_obs),
       bow_matcher_(bow_match_lowe_ratio, false), proj_matcher_(proj_match_lowe_ratio, false),
       robust_matcher_(robust_match_lowe_ratio, false),
-      pose_optimizer_(), use_fixed_seed_(use_fixed_seed) {
+      pose_optimizer_(), use_fixed_seed_(use_fixed_seed), use_p3p_(use_p3p),
+      use_landmark_index_(use_landmark_index), landmark_index_lowe_ratio_(landmark_index_lowe_ratio),
+      num_global_descriptor_neighbors_(num_global_descriptor_neighbors) {
     spdlog::debug("CONSTRUCT: module::relocalizer");
 }
 
@@ -28,7 +38,11 @@ relocalizer::relocalizer(const YAML::Node& yaml_node)
                   yaml_node["robust_match_lowe_ratio"].as<double>(0.8),
                   yaml_node["min_num_bow_matches"].as<unsigned int>(20),
                   yaml_node["min_num_valid_obs"].as<unsigned int>(50),
-                  yaml_node["use_fixed_seed"].as<bool>(false)) {
+                  yaml_node["use_fixed_seed"].as<bool>(false),
+                  yaml_node["use_p3p"].as<bool>(false),
+                  yaml_node["use_landmark_index"].as<bool>(false),
+                  yaml_node["landmark_index_lowe_ratio"].as<double>(0.8),
+                  yaml_node["num_global_descriptor_neighbors"].as<unsigned int>(0)) {
 }
 
 relocalizer::~relocalizer() {
@@ -37,7 +51,9 @@ relocalizer::~relocalizer() {
 
 bool relocalizer::relocalize(data::bow_database* bow_db, data::frame& curr_frm) {
     // Acquire relocalization candidates
-    const auto reloc_candidates = bow_db->acquire_keyframes(curr_frm.bow_vec_);
+    const auto reloc_candidates = (0 < num_global_descriptor_neighbors_)
+                                      ? bow_db->acquire_keyframes_by_global_descriptor(curr_frm.bow_vec_, num_global_descriptor_neighbors_)
+                                      : bow_db->acquire_keyframes(curr_frm.bow_vec_);
     if (reloc_candidates.empty()) {
         return false;
     }
@@ -45,6 +61,43 @@ bool relocalizer::relocalize(data::bow_database* bow_db, data::frame& curr_frm)
     return reloc_by_candidates(curr_frm, reloc_candidates);
 }
 
+bool relocalizer::relocalize(data::bow_database* bow_db, data::map_database* map_db, data::frame& curr_frm) {
+    if (relocalize(bow_db, curr_frm)) {
+        return true;
+    }
+    if (!use_landmark_index_) {
+        return false;
+    }
+    return reloc_by_landmark_index(map_db, curr_frm);
+}
+
+bool relocalizer::reloc_by_landmark_index(data::map_database* map_db, data::frame& curr_frm) const {
+    spdlog::debug("Start relocalization with the landmark descriptor index");
+
+    std::vector<std::shared_ptr<data::landmark>> matched_landmarks;
+    const auto num_matches = match_landmark_index(map_db, curr_frm, matched_landmarks);
+    // Discard if the number of 2D-3D matches is less than the threshold
+    if (num_matches < min_num_bow_matches_) {
+        spdlog::debug("Number of 2D-3D matches with the landmark index ({}) < threshold ({})", num_matches, min_num_bow_matches_);
+        curr_frm.invalidate_pose();
+        return false;
+    }
+
+    const auto candidate_keyfrm = get_most_observing_keyframe(matched_landmarks);
+    if (!candidate_keyfrm) {
+        curr_frm.invalidate_pose();
+        return false;
+    }
+
+    if (!reloc_by_matches(curr_frm, candidate_keyfrm, matched_landmarks, [] { return false; })) {
+        curr_frm.invalidate_pose();
+        return false;
+    }
+
+    spdlog::info("relocalization with the landmark index succeeded (id={})", candidate_keyfrm->id_);
+    return true;
+}
+
 bool relocalizer::reloc_by_candidates(data::frame& curr_frm,
                                       const std::vector<std::shared_ptr<stella_vslam::data::keyframe>>& reloc_candidates,
                                       bool use_robust_matcher) {
@@ -53,21 +106,76 @@ bool relocalizer::reloc_by_candidates(data::frame& curr_frm,
     spdlog::debug("Start relocalization. Number of candidate keyframes is {}", num_candidates);
 
     // Compute matching points for each candidate by using BoW tree matcher
-    for (unsigned int i = 0; i < num_candidates; ++i) {
+    // (NOTE: the number of 2D-3D matches is used as the cheap pre-score of the candidate,
+    //  and the matchers only read the current frame)
+    std::vector<std::vector<std::shared_ptr<data::landmark>>> matched_landmarks(num_candidates);
+    std::vector<unsigned int> num_matches(num_candidates, 0);
+#ifdef USE_OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (int64_t i = 0; i < static_cast<int64_t>(num_candidates); ++i) {
         const auto& candidate_keyfrm = reloc_candidates.at(i);
         if (candidate_keyfrm->will_be_erased()) {
             spdlog::debug("keyframe will be erased. candidate keyframe id is {}", candidate_keyfrm->id_);
             continue;
         }
+        num_matches.at(i) = match_candidate(curr_frm, candidate_keyfrm, use_robust_matcher, matched_landmarks.at(i));
+    }
 
-        bool ok = reloc_by_candidate(curr_frm, candidate_keyfrm, use_robust_matcher);
-        if (ok) {
-            spdlog::info("relocalization succeeded (id={})", candidate_keyfrm->id_);
-            // TODO: should set the reference keyframe of the current frame
-            return true;
+    // Rank the candidates in descending order of the number of matches
+    std::vector<unsigned int> ranked_indices;
+    ranked_indices.reserve(num_candidates);
+    for (unsigned int i = 0; i < num_candidates; ++i) {
+        // Discard the candidate if the number of 2D-3D matches is less than the threshold
+        if (num_matches.at(i) < min_num_bow_matches_) {
+            if (!reloc_candidates.at(i)->will_be_erased()) {
+                spdlog::debug("Number of 2D-3D matches ({}) < threshold ({}). candidate keyframe id is {}", num_matches.at(i), min_num_bow_matches_, reloc_candidates.at(i)->id_);
+            }
+            continue;
+        }
+        ranked_indices.push_back(i);
+    }
+    std::stable_sort(ranked_indices.begin(), ranked_indices.end(), [&num_matches](const unsigned int a, const unsigned int b) {
+        return num_matches.at(a) > num_matches.at(b);
+    });
+
+    // Evaluate the candidates in parallel on the copies of the current frame.
+    // The best-ranked success is adopted, and the candidates ranked below it are cancelled.
+    // (NOTE: the result does not depend on the number of threads, when the RANSAC seed is fixed)
+    const unsigned int num_ranked = ranked_indices.size();
+    std::atomic<unsigned int> best_rank(num_ranked);
+    std::vector<std::unique_ptr<data::frame>> reloc_frms(num_ranked);
+#ifdef USE_OPENMP
+#pragma omp parallel for schedule(dynamic, 1)
+#endif
+    for (int64_t rank = 0; rank < static_cast<int64_t>(num_ranked); ++rank) {
+        const auto is_cancelled = [&best_rank, rank] {
+            return best_rank.load() < static_cast<unsigned int>(rank);
+        };
+        if (is_cancelled()) {
+            continue;
+        }
+        const auto idx = ranked_indices.at(rank);
+        std::unique_ptr<data::frame> reloc_frm(new data::frame(curr_frm));
+        if (!reloc_by_matches(*reloc_frm, reloc_candidates.at(idx), matched_landmarks.at(idx), is_cancelled)) {
+            continue;
+        }
+        reloc_frms.at(rank) = std::move(reloc_frm);
+        // Cancel the candidates ranked below this one
+        auto prev_best_rank = best_rank.load();
+        while (static_cast<unsigned int>(rank) < prev_best_rank
+               && !best_rank.compare_exchange_weak(prev_best_rank, static_cast<unsigned int>(rank))) {
         }
     }
 
+    if (best_rank < num_ranked) {
+        const auto& candidate_keyfrm = reloc_candidates.at(ranked_indices.at(best_rank));
+        curr_frm = *reloc_frms.at(best_rank);
+        spdlog::info("relocalization succeeded (id={})", candidate_keyfrm->id_);
+        // TODO: should set the reference keyframe of the current frame
+        return true;
+    }
+
     curr_frm.invalidate_pose();
     return false;
 }
@@ -75,10 +183,23 @@ bool relocalizer::reloc_by_candidates(data::frame& curr_frm,
 bool relocalizer::reloc_by_candidate(data::frame& curr_frm,
                                      const std::shared_ptr<stella_vslam::data::keyframe>& candidate_keyfrm,
                                      bool use_robust_matcher) {
-    std::vector<unsigned int> inlier_indices;
     std::vector<std::shared_ptr<data::landmark>> matched_landmarks;
-    bool ok = relocalize_by_pnp_solver(curr_frm, candidate_keyfrm, use_robust_matcher, inlier_indices, matched_landmarks);
-    if (!ok) {
+    const auto num_matches = match_candidate(curr_frm, candidate_keyfrm, use_robust_matcher, matched_landmarks);
+    // Discard the candidate if the number of 2D-3D matches is less than the threshold
+    if (num_matches < min_num_bow_matches_) {
+        spdlog::debug("Number of 2D-3D matches ({}) < threshold ({}). candidate keyframe id is {}", num_matches, min_num_bow_matches_, candidate_keyfrm->id_);
+        return false;
+    }
+    return reloc_by_matches(curr_frm, candidate_keyfrm, matched_landmarks, [] { return false; });
+}
+
+bool relocalizer::reloc_by_matches(data::frame& curr_frm,
+                                   const std::shared_ptr<stella_vslam::data::keyframe>& candidate_keyfrm,
+                                   const std::vector<std::shared_ptr<data::landmark>>& matched_landmarks,
+                                   const std::function<bool()>& is_cancelled) const {
+    std::vector<unsigned int> inlier_indices;
+    bool ok = solve_pnp(curr_frm, candidate_keyfrm, matched_landmarks, inlier_indices);
+    if (!ok || is_cancelled()) {
         return false;
     }
 
@@ -91,7 +212,7 @@ bool relocalizer::reloc_by_candidate(data::frame& curr_frm,
 
     std::vector<bool> outlier_flags;
     ok = optimize_pose(curr_frm, candidate_keyfrm, outlier_flags);
-    if (!ok) {
+    if (!ok || is_cancelled()) {
         return false;
     }
 
@@ -105,7 +226,7 @@ bool relocalizer::reloc_by_candidate(data::frame& curr_frm,
     }
 
     ok = refine_pose(curr_frm, candidate_keyfrm, already_found_landmarks);
-    if (!ok) {
+    if (!ok || is_cancelled()) {
         return false;
     }
 
@@ -118,18 +239,105 @@ bool relocalizer::relocalize_by_pnp_solver(data::frame& curr_frm,
                                            bool use_robust_matcher,
                                            std::vector<unsigned int>& inlier_indices,
                                            std::vector<std::shared_ptr<data::landmark>>& matched_landmarks) const {
-    const auto num_matches = use_robust_matcher ? robust_matcher_.match_frame_and_keyframe(curr_frm, candidate_keyfrm, matched_landmarks)
-                                                : bow_matcher_.match_frame_and_keyframe(candidate_keyfrm, curr_frm, matched_landmarks);
+    const auto num_matches = match_candidate(curr_frm, candidate_keyfrm, use_robust_matcher, matched_landmarks);
     // Discard the candidate if the number of 2D-3D matches is less than the threshold
     if (num_matches < min_num_bow_matches_) {
         spdlog::debug("Number of 2D-3D matches ({}) < threshold ({}). candidate keyframe id is {}", num_matches, min_num_bow_matches_, candidate_keyfrm->id_);
         return false;
     }
 
+    return solve_pnp(curr_frm, candidate_keyfrm, matched_landmarks, inlier_indices);
+}
+
+unsigned int relocalizer::match_candidate(data::frame& curr_frm,
+                                          const std::shared_ptr<stella_vslam::data::keyframe>& candidate_keyfrm,
+                                          bool use_robust_matcher,
+                                          std::vector<std::shared_ptr<data::landmark>>& matched_landmarks) const {
+    return use_robust_matcher ? robust_matcher_.match_frame_and_keyframe(curr_frm, candidate_keyfrm, matched_landmarks)
+                              : bow_matcher_.match_frame_and_keyframe(candidate_keyfrm, curr_frm, matched_landmarks);
+}
+
+unsigned int relocalizer::match_landmark_index(const data::map_database* map_db, const data::frame& curr_frm,
+                                               std::vector<std::shared_ptr<data::landmark>>& matched_landmarks) const {
+    const auto lm_descriptor_index = map_db->get_landmark_descriptor_index();
+    const auto num_keypts = curr_frm.frm_obs_->num_keypts_;
+    const auto& descriptors = curr_frm.frm_obs_->descriptors_;
+
+    // Find the nearest landmark of each keypoint which passes the ratio test
+    std::vector<int> best_lm_ids(num_keypts, -1);
+    std::vector<unsigned int> best_dists(num_keypts, match::MAX_HAMMING_DIST);
+#ifdef USE_OPENMP
+#pragma omp parallel for schedule(dynamic, 64)
+#endif
+    for (int64_t idx = 0; idx < static_cast<int64_t>(num_keypts); ++idx) {
+        const auto nearest_lms = lm_descriptor_index->get_nearest_landmarks(descriptors.ptr<uint8_t>(idx), match::HAMMING_DIST_THR_HIGH, 2);
+        if (nearest_lms.empty() || match::HAMMING_DIST_THR_LOW < nearest_lms.front().second) {
+            continue;
+        }
+        if (nearest_lms.size() == 2 && landmark_index_lowe_ratio_ * nearest_lms.back().second < nearest_lms.front().second) {
+            continue;
+        }
+        best_lm_ids.at(idx) = static_cast<int>(nearest_lms.front().first);
+        best_dists.at(idx) = nearest_lms.front().second;
+    }
+
+    // Keep only the nearest keypoint for each landmark
+    std::unordered_map<unsigned int, unsigned int> lm_id_to_idx;
+    for (unsigned int idx = 0; idx < num_keypts; ++idx) {
+        if (best_lm_ids.at(idx) < 0) {
+            continue;
+        }
+        const auto result = lm_id_to_idx.emplace(best_lm_ids.at(idx), idx);
+        if (!result.second && best_dists.at(idx) < best_dists.at(result.first->second)) {
+            result.first->second = idx;
+        }
+    }
+
+    matched_landmarks.assign(num_keypts, nullptr);
+    unsigned int num_matches = 0;
+    for (const auto& lm_id_and_idx : lm_id_to_idx) {
+        // the index may still contain the landmarks which are being erased
+        auto lm = map_db->get_landmark(lm_id_and_idx.first);
+        if (!lm || lm->will_be_erased()) {
+            continue;
+        }
+        matched_landmarks.at(lm_id_and_idx.second) = lm;
+        ++num_matches;
+    }
+    return num_matches;
+}
+
+std::shared_ptr<data::keyframe> relocalizer::get_most_observing_keyframe(const std::vector<std::shared_ptr<data::landmark>>& matched_landmarks) const {
+    std::unordered_map<unsigned int, unsigned int> num_votes;
+    std::shared_ptr<data::keyframe> best_keyfrm = nullptr;
+    unsigned int max_num_votes = 0;
+    for (const auto& lm : matched_landmarks) {
+        if (!lm || lm->will_be_erased()) {
+            continue;
+        }
+        for (const auto& obs : lm->get_observations()) {
+            const auto keyfrm = obs.first.lock();
+            if (!keyfrm || keyfrm->will_be_erased()) {
+                continue;
+            }
+            const auto num = ++num_votes[keyfrm->id_];
+            if (max_num_votes < num || (max_num_votes == num && keyfrm->id_ < best_keyfrm->id_)) {
+                max_num_votes = num;
+                best_keyfrm = keyfrm;
+            }
+        }
+    }
+    return best_keyfrm;
+}
+
+bool relocalizer::solve_pnp(data::frame& curr_frm,
+                            const std::shared_ptr<stella_vslam::data::keyframe>& candidate_keyfrm,
+                            const std::vector<std::shared_ptr<data::landmark>>& matched_landmarks,
+                            std::vector<unsigned int>& inlier_indices) const {
     // Setup an PnP solver with the current 2D-3D matches
     const auto valid_indices = extract_valid_indices(matched_landmarks);
-    auto pnp_solver = setup_pnp_solver(valid_indices, curr_frm.frm_obs_.bearings_, curr_frm.frm_obs_.undist_keypts_,
-                                       matched_landmarks, curr_frm.orb_params_->scale_factors_);
+    auto pnp_solver = setup_pnp_solver(valid_indices, curr_frm.frm_obs_->bearings_, curr_frm.frm_obs_->undist_keypts_,
+                                       curr_frm.frm_obs_->descriptors_, matched_landmarks, curr_frm.orb_params_->scale_factors_);
 
     // 1. Estimate the camera pose using EPnP (+ RANSAC)
 
@@ -162,7 +370,7 @@ bool relocalizer::optimize_pose(data::frame& curr_frm,
     }
 
     // Reject outliers
-    for (unsigned int idx = 0; idx < curr_frm.frm_obs_.num_keypts_; idx++) {
+    for (unsigned int idx = 0; idx < curr_frm.frm_obs_->num_keypts_; idx++) {
         if (!outlier_flags.at(idx)) {
             continue;
         }
@@ -195,7 +403,7 @@ bool relocalizer::refine_pose(data::frame& curr_frm,
 
     // Exclude the already-associated landmarks
     std::set<std::shared_ptr<data::landmark>> already_found_landmarks1;
-    for (unsigned int idx = 0; idx < curr_frm.frm_obs_.num_keypts_; ++idx) {
+    for (unsigned int idx = 0; idx < curr_frm.frm_obs_->num_keypts_; ++idx) {
         const auto& lm = curr_frm.get_landmark(idx);
         if (!lm) {
             continue;
@@ -225,7 +433,7 @@ bool relocalizer::refine_pose(data::frame& curr_frm,
     }
 
     // Reject outliers
-    for (unsigned int idx = 0; idx < curr_frm.frm_obs_.num_keypts_; ++idx) {
+    for (unsigned int idx = 0; idx < curr_frm.frm_obs_->num_keypts_; ++idx) {
         if (!outlier_flags2.at(idx)) {
             continue;
         }
@@ -265,14 +473,8 @@ bool relocalizer::refine_pose_by_local_map(data::frame& curr_frm,
             curr_landmark_ids.insert(lm->id_);
         }
 
-        bool found_proj_candidate = false;
-        // temporary variables
-        Vec2_t reproj;
-        float x_right;
-        unsigned int pred_scale_level;
-        eigen_alloc_unord_map<unsigned int, Vec2_t> lm_to_reproj;
-        std::unordered_map<unsigned int, float> lm_to_x_right;
-        std::unordered_map<unsigned int, int> lm_to_scale;
+        std::vector<std::shared_ptr<data::landmark>> candidate_lms;
+        candidate_lms.reserve(local_landmarks.size());
         for (const auto& lm : local_landmarks) {
             if (curr_landmark_ids.count(lm->id_)) {
                 continue;
@@ -280,15 +482,30 @@ bool relocalizer::refine_pose_by_local_map(data::frame& curr_frm,
             if (lm->will_be_erased()) {
                 continue;
             }
+            candidate_lms.push_back(lm);
+        }
 
-            // check the observability
-            if (curr_frm.can_observe(lm, 0.5, reproj, x_right, pred_scale_level)) {
-                lm_to_reproj[lm->id_] = reproj;
-                lm_to_x_right[lm->id_] = x_right;
-                lm_to_scale[lm->id_] = pred_scale_level;
+        // check the observability at once (the camera model is dispatched once per batch)
+        std::vector<bool> is_observable;
+        eigen_alloc_vector<Vec2_t> reprojs;
+        std::vector<float> x_rights;
+        std::vector<unsigned int> pred_scale_levels;
+        curr_frm.can_observe(candidate_lms, 0.5, is_observable, reprojs, x_rights, pred_scale_levels);
 
-                found_proj_candidate = true;
+        bool found_proj_candidate = false;
+        eigen_alloc_unord_map<unsigned int, Vec2_t> lm_to_reproj;
+        std::unordered_map<unsigned int, float> lm_to_x_right;
+        std::unordered_map<unsigned int, int> lm_to_scale;
+        for (unsigned int k = 0; k < candidate_lms.size(); ++k) {
+            if (!is_observable.at(k)) {
+                continue;
             }
+            const auto lm_id = candidate_lms.at(k)->id_;
+            lm_to_reproj[lm_id] = reprojs.at(k);
+            lm_to_x_right[lm_id] = x_rights.at(k);
+            lm_to_scale[lm_id] = pred_scale_levels.at(k);
+
+            found_proj_candidate = true;
         }
 
         if (!found_proj_candidate) {
@@ -307,7 +524,7 @@ bool relocalizer::refine_pose_by_local_map(data::frame& curr_frm,
         curr_frm.set_pose_cw(optimized_pose);
 
         // Reject outliers
-        for (unsigned int idx = 0; idx < curr_frm.frm_obs_.num_keypts_; ++idx) {
+        for (unsigned int idx = 0; idx < curr_frm.frm_obs_->num_keypts_; ++idx) {
             if (!outlier_flags.at(idx)) {
                 continue;
             }
@@ -347,6 +564,7 @@ std::vector<unsigned int> relocalizer::extract_valid_indices(const std::vector<s
 std::unique_ptr<solve::pnp_solver> relocalizer::setup_pnp_solver(const std::vector<unsigned int>& valid_indices,
                                                                  const eigen_alloc_vector<Vec3_t>& bearings,
                                                                  const std::vector<cv::KeyPoint>& keypts,
+                                                                 const cv::Mat& descriptors,
                                                                  const std::vector<std::shared_ptr<data::landmark>>& matched_landmarks,
                                                                  const std::vector<float>& scale_factors) const {
     // Resample valid elements
@@ -354,11 +572,18 @@ std::unique_ptr<solve::pnp_solver> relocalizer::setup_pnp_solver(const std::vect
     const auto valid_keypts = util::resample_by_indices(keypts, valid_indices);
     const auto valid_assoc_lms = util::resample_by_indices(matched_landmarks, valid_indices);
     eigen_alloc_vector<Vec3_t> valid_landmarks(valid_indices.size());
+    std::vector<unsigned int> descriptor_distances(valid_indices.size());
     for (unsigned int i = 0; i < valid_indices.size(); ++i) {
         valid_landmarks.at(i) = valid_assoc_lms.at(i)->get_pos_in_world();
+        descriptor_distances.at(i) = match::compute_descriptor_distance_32(descriptors.row(valid_indices.at(i)),
+                                                                           valid_assoc_lms.at(i)->get_descriptor());
     }
     // Setup PnP solver
-    return std::unique_ptr<solve::pnp_solver>(new solve::pnp_solver(valid_bearings, valid_keypts, valid_landmarks, scale_factors, use_fixed_seed_));
+    auto pnp_solver = std::unique_ptr<solve::pnp_solver>(new solve::pnp_solver(valid_bearings, valid_keypts, valid_landmarks, scale_factors, use_fixed_seed_));
+    // the minimal sets are sampled from the matches with the smaller descriptor distances first
+    pnp_solver->set_descriptor_distances(descriptor_distances);
+    pnp_solver->set_use_p3p(use_p3p_);
+    return pnp_solver;
 }
 
 } // namespace module
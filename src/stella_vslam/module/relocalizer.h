@@ -7,6 +7,7 @@
 #include "stella_vslam/optimize/pose_optimizer.h"
 #include "stella_vslam/solve/pnp_solver.h"
 
+#include <functional>
 #include <memory>
 
 namespace stella_vslam {
@@ -14,6 +15,7 @@ namespace stella_vslam {
 namespace data {
 class frame;
 class bow_database;
+class map_database;
 } // namespace data
 
 namespace module {
@@ -24,7 +26,9 @@ public:
     explicit relocalizer(const double bow_match_lowe_ratio = 0.75, const double proj_match_lowe_ratio = 0.9,
                          const double robust_match_lowe_ratio = 0.8,
                          const unsigned int min_num_bow_matches = 20, const unsigned int min_num_valid_obs = 50,
-                         const bool use_fixed_seed = false);
+                         const bool use_fixed_seed = false, const bool use_p3p = false,
+                         const bool use_landmark_index = false, const double landmark_index_lowe_ratio = 0.8,
+                         const unsigned int num_global_descriptor_neighbors = 0);
 
     explicit relocalizer(const YAML::Node& yaml_node);
 
@@ -34,7 +38,24 @@ public:
     //! Relocalize the specified frame
     bool relocalize(data::bow_database* bow_db, data::frame& curr_frm);
 
-    //! Relocalize the specified frame by given candidates list
+    /**
+     * Relocalize the specified frame
+     * (NOTE: the frame is matched directly with the landmarks in the descriptor index of the map
+     *  if the BoW retrieval fails and use_landmark_index is enabled)
+     */
+    bool relocalize(data::bow_database* bow_db, data::map_database* map_db, data::frame& curr_frm);
+
+    /**
+     * Relocalize the specified frame by the 2D-3D matches with the descriptor index of the landmarks, without the BoW retrieval
+     * (NOTE: the keyframe which observes the most of the matched landmarks is used for the refinement)
+     */
+    bool reloc_by_landmark_index(data::map_database* map_db, data::frame& curr_frm) const;
+
+    /**
+     * Relocalize the specified frame by given candidates list
+     * (NOTE: the candidates are ranked by the number of 2D-3D matches and evaluated in parallel when built with USE_OPENMP,
+     *  then the best-ranked candidate which succeeds is adopted)
+     */
     bool reloc_by_candidates(data::frame& curr_frm,
                              const std::vector<std::shared_ptr<stella_vslam::data::keyframe>>& reloc_candidates,
                              bool use_robust_matcher = false);
@@ -56,6 +77,38 @@ public:
                                   const std::shared_ptr<stella_vslam::data::keyframe>& candidate_keyfrm) const;
 
 private:
+    //! Compute the 2D-3D matches between the frame and the candidate keyframe (the frame is not modified)
+    unsigned int match_candidate(data::frame& curr_frm,
+                                 const std::shared_ptr<stella_vslam::data::keyframe>& candidate_keyfrm,
+                                 bool use_robust_matcher,
+                                 std::vector<std::shared_ptr<data::landmark>>& matched_landmarks) const;
+
+    //! Compute the 2D-3D matches between the frame and the descriptor index of the landmarks (the frame is not modified)
+    unsigned int match_landmark_index(const data::map_database* map_db, const data::frame& curr_frm,
+                                      std::vector<std::shared_ptr<data::landmark>>& matched_landmarks) const;
+
+    //! Get the keyframe which observes the most of the matched landmarks
+    std::shared_ptr<data::keyframe> get_most_observing_keyframe(const std::vector<std::shared_ptr<data::landmark>>& matched_landmarks) const;
+
+    //! Estimate the camera pose from the 2D-3D matches by using EPnP (+ RANSAC)
+    bool solve_pnp(data::frame& curr_frm,
+                   const std::shared_ptr<stella_vslam::data::keyframe>& candidate_keyfrm,
+                   const std::vector<std::shared_ptr<data::landmark>>& matched_landmarks,
+                   std::vector<unsigned int>& inlier_indices) const;
+
+    /**
+     * Relocalize the frame by the 2D-3D matches with the candidate keyframe
+     * @param curr_frm
+     * @param candidate_keyfrm
+     * @param matched_landmarks
+     * @param is_cancelled the evaluation is abandoned between the stages if this returns true
+     * @return
+     */
+    bool reloc_by_matches(data::frame& curr_frm,
+                          const std::shared_ptr<stella_vslam::data::keyframe>& candidate_keyfrm,
+                          const std::vector<std::shared_ptr<data::landmark>>& matched_landmarks,
+                          const std::function<bool()>& is_cancelled) const;
+
     //! Extract valid (non-deleted) landmarks from landmark vector
     std::vector<unsigned int> extract_valid_indices(const std::vector<std::shared_ptr<data::landmark>>& landmarks) const;
 
@@ -63,6 +116,7 @@ private:
     std::unique_ptr<solve::pnp_solver> setup_pnp_solver(const std::vector<unsigned int>& valid_indices,
                                                         const eigen_alloc_vector<Vec3_t>& bearings,
                                                         const std::vector<cv::KeyPoint>& keypts,
+                                                        const cv::Mat& descriptors,
                                                         const std::vector<std::shared_ptr<data::landmark>>& matched_landmarks,
                                                         const std::vector<float>& scale_factors) const;
 
@@ -82,6 +136,17 @@ private:
 
     //! Use fixed random seed for RANSAC if true
     const bool use_fixed_seed_;
+    //! Compute the hypotheses of PnP RANSAC by P3P instead of EPnP if true
+    const bool use_p3p_;
+
+    //! Match the frame directly with the descriptor index of the landmarks if the BoW retrieval fails
+    const bool use_landmark_index_;
+    //! Lowe's ratio of the matching with the descriptor index
+    const double landmark_index_lowe_ratio_;
+
+    //! number of the keyframes retrieved by the global descriptor before the BoW scoring
+    //! (0: all the keyframes which share words with the current frame are scored)
+    const unsigned int num_global_descriptor_neighbors_;
 };
 
 } // namespace module
@@ -0,0 +1,269 @@
+#include "stella_vslam/camera/base.h"
+#include "stella_vslam/data/bow_database.h"
+#include "stella_vslam/data/bow_vocabulary.h"
+#include "stella_vslam/data/camera_database.h"
+#include "stella_vslam/data/common.h"
+#include "stella_vslam/data/frame_observation.h"
+#include "stella_vslam/data/keyframe.h"
+#include "stella_vslam/data/landmark.h"
+#include "stella_vslam/data/map_database.h"
+#include "stella_vslam/data/orb_params_database.h"
+#include "stella_vslam/module/remote_map_integrator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <unordered_set>
+
+#include <Eigen/Geometry>
+#include <spdlog/spdlog.h>
+
+namespace stella_vslam {
+namespace module {
+
+remote_map_integrator::remote_map_integrator(data::camera_database* cam_db, data::orb_params_database* orb_params_db,
+                                             data::map_database* map_db, data::bow_database* bow_db, data::bow_vocabulary* bow_vocab)
+    : cam_db_(cam_db), orb_params_db_(orb_params_db), map_db_(map_db), bow_db_(bow_db), bow_vocab_(bow_vocab) {
+    spdlog::debug("CONSTRUCT: module::remote_map_integrator");
+}
+
+remote_map_integrator::~remote_map_integrator() {
+    spdlog::debug("DESTRUCT: module::remote_map_integrator");
+}
+
+unsigned int remote_map_integrator::integrate(const remote_segment& segment) {
+    std::lock_guard<util::profiled_mutex> lock(data::map_database::mtx_database_);
+
+    auto& robot_ptr = robots_[segment.robot_id_];
+    if (!robot_ptr) {
+        spdlog::info("remote_map_integrator: new robot {}", segment.robot_id_);
+        robot_ptr.reset(new robot_map());
+    }
+    auto& robot = *robot_ptr;
+    const auto& Sim3_global_from_local = robot.Sim3_global_from_local_;
+
+    // Step 1. Create the new keyframes (the poses of the known ones are updated)
+    std::vector<std::pair<const remote_keyframe*, std::shared_ptr<data::keyframe>>> new_keyfrms;
+    for (const auto& remote_keyfrm : segment.keyfrms_) {
+        const Mat44_t& pose_cw_local = remote_keyfrm.pose_cw_;
+        const g2o::Sim3 Sim3_cw_local(pose_cw_local.block<3, 3>(0, 0), pose_cw_local.block<3, 1>(0, 3), 1.0);
+        const g2o::Sim3 Sim3_cw_global = Sim3_cw_local * Sim3_global_from_local.inverse();
+        const auto s_cw = Sim3_cw_global.scale();
+        Mat44_t pose_cw_global = Mat44_t::Identity();
+        pose_cw_global.block<3, 3>(0, 0) = Sim3_cw_global.rotation().toRotationMatrix();
+        pose_cw_global.block<3, 1>(0, 3) = Sim3_cw_global.translation() / s_cw;
+
+        robot.local_cam_centers_[remote_keyfrm.id_] = -pose_cw_local.block<3, 3>(0, 0).transpose() * pose_cw_local.block<3, 1>(0, 3);
+
+        const auto iter = robot.keyfrms_.find(remote_keyfrm.id_);
+        if (iter != robot.keyfrms_.end()) {
+            iter->second->set_pose_cw(pose_cw_global);
+            continue;
+        }
+
+        auto keyfrm = create_keyframe(remote_keyfrm, pose_cw_global);
+        robot.keyfrms_[remote_keyfrm.id_] = keyfrm;
+        new_keyfrms.emplace_back(&remote_keyfrm, keyfrm);
+    }
+
+    // Step 2. Create the new landmarks (the positions of the known ones are updated)
+    std::unordered_set<std::shared_ptr<data::landmark>> updated_lms;
+    for (const auto& remote_lm : segment.lms_) {
+        const Vec3_t pos_w = Sim3_global_from_local.map(remote_lm.pos_w_);
+
+        auto iter = robot.lms_.find(remote_lm.id_);
+        if (iter != robot.lms_.end() && iter->second->will_be_erased()) {
+            // the landmark has been replaced with that of the other map
+            robot.lms_.erase(iter);
+            iter = robot.lms_.end();
+        }
+        if (iter != robot.lms_.end()) {
+            iter->second->set_pos_in_world(pos_w);
+            updated_lms.insert(iter->second);
+            continue;
+        }
+
+        const auto ref_keyfrm_iter = robot.keyfrms_.find(remote_lm.ref_keyfrm_id_);
+        if (ref_keyfrm_iter == robot.keyfrms_.end()) {
+            spdlog::debug("remote_map_integrator: the reference keyframe of landmark {} of robot {} is unknown", remote_lm.id_, segment.robot_id_);
+            continue;
+        }
+        auto lm = data::landmark::create(map_db_->next_landmark_id_++, pos_w, ref_keyfrm_iter->second);
+        map_db_->add_landmark(lm);
+        robot.lms_[remote_lm.id_] = lm;
+        updated_lms.insert(lm);
+    }
+
+    // Step 3. Associate the new keyframes with the landmarks
+    for (const auto& remote_keyfrm_and_keyfrm : new_keyfrms) {
+        const auto& landmark_ids = remote_keyfrm_and_keyfrm.first->landmark_ids_;
+        const auto& keyfrm = remote_keyfrm_and_keyfrm.second;
+        for (unsigned int idx = 0; idx < landmark_ids.size(); ++idx) {
+            if (landmark_ids.at(idx) < 0) {
+                continue;
+            }
+            const auto iter = robot.lms_.find(static_cast<unsigned int>(landmark_ids.at(idx)));
+            if (iter == robot.lms_.end() || iter->second->will_be_erased() || iter->second->is_observed_in_keyframe(keyfrm)) {
+                continue;
+            }
+            iter->second->connect_to_keyframe(keyfrm, idx);
+            updated_lms.insert(iter->second);
+        }
+    }
+    for (const auto& lm : updated_lms) {
+        lm->compute_descriptor();
+        lm->update_mean_normal_and_obs_scale_variance();
+    }
+
+    // Step 4. Register the new keyframes in the order of the local IDs
+    // (the first keyframe of the robot becomes a spanning root, and the others are attached to the nearest covisibilities)
+    std::sort(new_keyfrms.begin(), new_keyfrms.end(),
+              [](const std::pair<const remote_keyframe*, std::shared_ptr<data::keyframe>>& a,
+                 const std::pair<const remote_keyframe*, std::shared_ptr<data::keyframe>>& b) {
+                  return a.first->id_ < b.first->id_;
+              });
+    for (const auto& remote_keyfrm_and_keyfrm : new_keyfrms) {
+        auto keyfrm = remote_keyfrm_and_keyfrm.second;
+        if (!robot.last_keyfrm_) {
+            keyfrm->graph_node_->set_spanning_root(keyfrm);
+            map_db_->add_spanning_root(keyfrm);
+        }
+        keyfrm->graph_node_->update_connections(map_db_->get_min_num_shared_lms());
+        if (!keyfrm->graph_node_->get_spanning_parent() && !keyfrm->graph_node_->is_spanning_root()) {
+            // no landmark is shared with the integrated keyframes
+            keyfrm->graph_node_->set_spanning_parent(robot.last_keyfrm_);
+            auto root = robot.last_keyfrm_->graph_node_->get_spanning_root();
+            keyfrm->graph_node_->set_spanning_root(root);
+            robot.last_keyfrm_->graph_node_->add_spanning_child(keyfrm);
+        }
+        map_db_->add_keyframe(keyfrm);
+        bow_db_->add_keyframe(keyfrm);
+        robot.last_keyfrm_ = keyfrm;
+    }
+
+    spdlog::debug("remote_map_integrator: {} keyframes and {} landmarks of robot {}",
+                  new_keyfrms.size(), segment.lms_.size(), segment.robot_id_);
+    return new_keyfrms.size();
+}
+
+eigen_alloc_vector<remote_correction> remote_map_integrator::compute_corrections() {
+    std::lock_guard<util::profiled_mutex> lock(data::map_database::mtx_database_);
+
+    eigen_alloc_vector<remote_correction> corrections;
+    corrections.reserve(robots_.size());
+    for (auto& id_robot : robots_) {
+        auto& robot = *id_robot.second;
+
+        g2o::Sim3 Sim3_global_from_local;
+        if (!estimate_global_from_local(robot, Sim3_global_from_local)) {
+            continue;
+        }
+        robot.Sim3_global_from_local_ = Sim3_global_from_local;
+
+        remote_correction correction;
+        correction.robot_id_ = id_robot.first;
+        correction.global_from_local_.block<3, 3>(0, 0) = Sim3_global_from_local.scale() * Sim3_global_from_local.rotation().toRotationMatrix();
+        correction.global_from_local_.block<3, 1>(0, 3) = Sim3_global_from_local.translation();
+
+        // the poses and the positions in the shared map are expressed in the local map
+        correction.keyfrm_poses_.reserve(robot.keyfrms_.size());
+        for (const auto& id_keyfrm : robot.keyfrms_) {
+            if (id_keyfrm.second->will_be_erased()) {
+                continue;
+            }
+            const Mat44_t pose_cw_global = id_keyfrm.second->get_pose_cw();
+            const g2o::Sim3 Sim3_cw_global(pose_cw_global.block<3, 3>(0, 0), pose_cw_global.block<3, 1>(0, 3), 1.0);
+            const g2o::Sim3 Sim3_cw_local = Sim3_cw_global * Sim3_global_from_local;
+            const auto s_cw = Sim3_cw_local.scale();
+
+            remote_correction::keyframe_pose keyfrm_pose;
+            keyfrm_pose.id_ = id_keyfrm.first;
+            keyfrm_pose.pose_cw_.block<3, 3>(0, 0) = Sim3_cw_local.rotation().toRotationMatrix();
+            keyfrm_pose.pose_cw_.block<3, 1>(0, 3) = Sim3_cw_local.translation() / s_cw;
+            correction.keyfrm_poses_.push_back(keyfrm_pose);
+        }
+
+        const auto Sim3_local_from_global = Sim3_global_from_local.inverse();
+        correction.lms_.reserve(robot.lms_.size());
+        for (auto iter = robot.lms_.begin(); iter != robot.lms_.end();) {
+            if (iter->second->will_be_erased()) {
+                iter = robot.lms_.erase(iter);
+                continue;
+            }
+            remote_landmark lm;
+            lm.id_ = iter->first;
+            lm.ref_keyfrm_id_ = 0;
+            lm.pos_w_ = Sim3_local_from_global.map(iter->second->get_pos_in_world());
+            correction.lms_.push_back(lm);
+            ++iter;
+        }
+
+        corrections.push_back(std::move(correction));
+    }
+    return corrections;
+}
+
+std::shared_ptr<data::keyframe> remote_map_integrator::create_keyframe(const remote_keyframe& remote_keyfrm, const Mat44_t& pose_cw) const {
+    const auto camera = cam_db_->get_camera(remote_keyfrm.camera_name_);
+    if (!camera) {
+        throw std::runtime_error("the camera of the remote keyframe is not registered: " + remote_keyfrm.camera_name_);
+    }
+    const auto orb_params = orb_params_db_->get_orb_params(remote_keyfrm.orb_params_name_);
+    if (!orb_params) {
+        throw std::runtime_error("the ORB parameters of the remote keyframe are not registered: " + remote_keyfrm.orb_params_name_);
+    }
+    const auto num_keypts = static_cast<unsigned int>(remote_keyfrm.undist_keypts_.size());
+    if (static_cast<unsigned int>(remote_keyfrm.descriptors_.rows) != num_keypts
+        || remote_keyfrm.landmark_ids_.size() != num_keypts) {
+        throw std::runtime_error("the observations of the remote keyframe are inconsistent");
+    }
+
+    // bearings
+    auto bearings = eigen_alloc_vector<Vec3_t>();
+    camera->convert_keypoints_to_bearings(remote_keyfrm.undist_keypts_, bearings);
+    // Assign all the keypoints into grid
+    data::keypoint_grid keypt_indices_in_cells;
+    data::assign_keypoints_to_grid(camera, remote_keyfrm.undist_keypts_, keypt_indices_in_cells);
+    // (the descriptors are held by the keyframe apart from the observations)
+    data::frame_observation frm_obs{num_keypts, cv::Mat(), remote_keyfrm.undist_keypts_, bearings,
+                                    remote_keyfrm.stereo_x_right_, remote_keyfrm.depths_, keypt_indices_in_cells};
+    // Compute BoW
+    data::bow_vector bow_vec;
+    data::bow_feature_vector bow_feat_vec;
+    data::bow_vocabulary_util::compute_bow(bow_vocab_, remote_keyfrm.descriptors_, bow_vec, bow_feat_vec);
+    return data::keyframe::make_keyframe(
+        map_db_->next_keyframe_id_++, remote_keyfrm.timestamp_, pose_cw, camera, orb_params,
+        data::make_frame_observation(std::move(frm_obs)), bow_vec, bow_feat_vec, remote_keyfrm.descriptors_);
+}
+
+bool remote_map_integrator::estimate_global_from_local(const robot_map& robot, g2o::Sim3& Sim3_global_from_local) const {
+    std::vector<unsigned int> ids;
+    ids.reserve(robot.keyfrms_.size());
+    for (const auto& id_keyfrm : robot.keyfrms_) {
+        if (!id_keyfrm.second->will_be_erased()) {
+            ids.push_back(id_keyfrm.first);
+        }
+    }
+    // (at least three non-collinear camera centers are needed)
+    if (ids.size() < 3) {
+        return false;
+    }
+
+    MatX3_t local_cam_centers(ids.size(), 3);
+    MatX3_t global_cam_centers(ids.size(), 3);
+    for (unsigned int i = 0; i < ids.size(); ++i) {
+        local_cam_centers.row(i) = robot.local_cam_centers_.at(ids.at(i)).transpose();
+        global_cam_centers.row(i) = robot.keyfrms_.at(ids.at(i))->get_trans_wc().transpose();
+    }
+    const Mat44_t global_from_local = Eigen::umeyama(local_cam_centers.transpose(), global_cam_centers.transpose(), true);
+    const Mat33_t sR = global_from_local.block<3, 3>(0, 0);
+    const double scale = std::cbrt(sR.determinant());
+    if (!std::isfinite(scale) || scale <= 0.0) {
+        return false;
+    }
+    Sim3_global_from_local = g2o::Sim3(sR / scale, global_from_local.block<3, 1>(0, 3), scale);
+    return true;
+}
+
+} // namespace module
+} // namespace stella_vslam
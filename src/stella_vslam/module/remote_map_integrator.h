@@ -0,0 +1,156 @@
+#ifndef STELLA_VSLAM_MODULE_REMOTE_MAP_INTEGRATOR_H
+#define STELLA_VSLAM_MODULE_REMOTE_MAP_INTEGRATOR_H
+
+#include "stella_vslam/type.h"
+#include "stella_vslam/data/bow_vocabulary_fwd.h"
+
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <g2o/types/sim3/types_seven_dof_expmap.h>
+#include <opencv2/core/mat.hpp>
+#include <opencv2/core/types.hpp>
+
+namespace stella_vslam {
+
+namespace data {
+class keyframe;
+class landmark;
+class camera_database;
+class orb_params_database;
+class map_database;
+class bow_database;
+} // namespace data
+
+namespace module {
+
+//! Keyframe streamed from a robot (expressed in the local map of the robot)
+struct remote_keyframe {
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    //! ID in the local map
+    unsigned int id_ = 0;
+    double timestamp_ = 0.0;
+    Mat44_t pose_cw_ = Mat44_t::Identity();
+    std::string camera_name_;
+    std::string orb_params_name_;
+    std::vector<cv::KeyPoint> undist_keypts_;
+    std::vector<float> stereo_x_right_;
+    std::vector<float> depths_;
+    cv::Mat descriptors_;
+    //! landmark ID in the local map of each keypoint (-1 if not associated)
+    std::vector<int> landmark_ids_;
+};
+
+//! Landmark streamed from a robot (expressed in the local map of the robot)
+struct remote_landmark {
+    //! ID in the local map
+    unsigned int id_ = 0;
+    unsigned int ref_keyfrm_id_ = 0;
+    Vec3_t pos_w_ = Vec3_t::Zero();
+};
+
+//! Keyframes and landmarks streamed at once from a robot
+struct remote_segment {
+    unsigned int robot_id_ = 0;
+    eigen_alloc_vector<remote_keyframe> keyfrms_;
+    std::vector<remote_landmark> lms_;
+};
+
+//! Corrections of the local map of a robot, which are pushed back to the robot after the shared map is optimized
+struct remote_correction {
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    struct keyframe_pose {
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+        unsigned int id_ = 0;
+        Mat44_t pose_cw_ = Mat44_t::Identity();
+    };
+
+    unsigned int robot_id_ = 0;
+    //! similarity transformation from the local map to the shared map ([sR t; 0 1])
+    Mat44_t global_from_local_ = Mat44_t::Identity();
+    //! corrected poses of the keyframes (in the local map)
+    eigen_alloc_vector<keyframe_pose> keyfrm_poses_;
+    //! corrected positions of the landmarks (in the local map)
+    std::vector<remote_landmark> lms_;
+};
+
+/**
+ * Integrator of the keyframes streamed from the robots into the shared map
+ * Each robot builds its own map, whose first keyframe becomes a spanning root of the shared map,
+ * so the maps of the robots are joined by module::map_merger via the inter-map loops.
+ * The mapping from the local map of each robot to the shared map is re-estimated after the maps are merged or optimized,
+ * and applied to the keyframes and the landmarks streamed afterwards.
+ */
+class remote_map_integrator {
+public:
+    /**
+     * Constructor
+     * @param cam_db (the cameras of the robots are identified by their names)
+     * @param orb_params_db (the ORB parameters of the robots are identified by their names)
+     * @param map_db
+     * @param bow_db
+     * @param bow_vocab
+     */
+    remote_map_integrator(data::camera_database* cam_db, data::orb_params_database* orb_params_db,
+                          data::map_database* map_db, data::bow_database* bow_db, data::bow_vocabulary* bow_vocab);
+
+    /**
+     * Destructor
+     */
+    ~remote_map_integrator();
+
+    /**
+     * Integrate the segment into the shared map
+     * (NOTE: the other threads must be paused. Throw std::runtime_error if the camera or the ORB parameters are unknown)
+     * @return the number of the new keyframes
+     */
+    unsigned int integrate(const remote_segment& segment);
+
+    /**
+     * Re-estimate the mapping from the local map of each robot to the shared map, then compute the corrections of the local maps
+     * (NOTE: the other threads must be paused. Call this after the shared map is merged or optimized)
+     */
+    eigen_alloc_vector<remote_correction> compute_corrections();
+
+private:
+    //! keyframes and landmarks of a robot in the shared map
+    struct robot_map {
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+        //! local ID -> keyframe in the shared map
+        std::unordered_map<unsigned int, std::shared_ptr<data::keyframe>> keyfrms_;
+        //! local ID -> camera center reported by the robot (in the local map)
+        eigen_alloc_unord_map<unsigned int, Vec3_t> local_cam_centers_;
+        //! local ID -> landmark in the shared map
+        std::unordered_map<unsigned int, std::shared_ptr<data::landmark>> lms_;
+        //! the keyframe integrated last
+        std::shared_ptr<data::keyframe> last_keyfrm_ = nullptr;
+        //! the mapping from the local map to the shared map
+        g2o::Sim3 Sim3_global_from_local_;
+    };
+
+    //! Create the keyframe with the pose in the shared map
+    std::shared_ptr<data::keyframe> create_keyframe(const remote_keyframe& remote_keyfrm, const Mat44_t& pose_cw) const;
+
+    //! Estimate the mapping from the pairs of the camera centers (false if it cannot be estimated)
+    bool estimate_global_from_local(const robot_map& robot, g2o::Sim3& Sim3_global_from_local) const;
+
+    data::camera_database* cam_db_ = nullptr;
+    data::orb_params_database* orb_params_db_ = nullptr;
+    data::map_database* map_db_ = nullptr;
+    data::bow_database* bow_db_ = nullptr;
+    data::bow_vocabulary* bow_vocab_ = nullptr;
+
+    //! robot ID -> map of the robot
+    std::map<unsigned int, std::unique_ptr<robot_map>> robots_;
+};
+
+} // namespace module
+} // namespace stella_vslam
+
+#endif // STELLA_VSLAM_MODULE_REMOTE_MAP_INTEGRATOR_H
@@ -1,3 +1,4 @@
+#include "stella_vslam/data/common.h"
 #include "stella_vslam/data/keyframe.h"
 #include "stella_vslam/module/two_view_triangulator.h"
 #include "stella_vslam/solve/triangulator.h"
@@ -5,6 +6,92 @@
 namespace stella_vslam {
 namespace module {
 
+namespace {
+
+//! observations of the matched keypoints in a keyframe (one match per row)
+struct matched_observations {
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    matched_observations(const std::shared_ptr<data::keyframe>& keyfrm, const std::vector<unsigned int>& indices);
+
+    //! bearing vectors
+    MatX3_t bearings_;
+    //! undistorted keypoints
+    MatX2_t keypts_;
+    //! x coordinates in the right image (negative if the keypoint is not observed as stereo)
+    VecX_t x_rights_;
+    //! cosines of the stereo parallaxes (2.0 if the keypoint is not observed as stereo)
+    VecX_t cos_stereo_parallaxes_;
+    //! sigma^2 of the scale levels
+    VecX_t level_sigma_sqs_;
+    //! scale factors of the scale levels
+    VecX_t scale_factors_;
+};
+
+matched_observations::matched_observations(const std::shared_ptr<data::keyframe>& keyfrm, const std::vector<unsigned int>& indices) {
+    const auto& frm_obs = *keyfrm->frm_obs_;
+    const auto& undist_keypts = frm_obs.undist_keypts_soa_;
+    const auto& orb_params = keyfrm->orb_params_;
+    const auto num_matches = indices.size();
+
+    bearings_.resize(num_matches, 3);
+    keypts_.resize(num_matches, 2);
+    x_rights_.resize(num_matches);
+    VecX_t depths(num_matches);
+    level_sigma_sqs_.resize(num_matches);
+    scale_factors_.resize(num_matches);
+    for (unsigned int i = 0; i < num_matches; ++i) {
+        const auto idx = indices.at(i);
+        bearings_.row(i) = frm_obs.bearings_.at(idx).transpose();
+        keypts_(i, 0) = undist_keypts.x_.at(idx);
+        keypts_(i, 1) = undist_keypts.y_.at(idx);
+        x_rights_(i) = frm_obs.stereo_x_right_.empty() ? -1.0 : frm_obs.stereo_x_right_.at(idx);
+        depths(i) = frm_obs.depths_.empty() ? -1.0 : frm_obs.depths_.at(idx);
+        const auto octave = undist_keypts.octave_.at(idx);
+        level_sigma_sqs_(i) = orb_params->level_sigma_sq_.at(octave);
+        scale_factors_(i) = orb_params->scale_factors_.at(octave);
+    }
+
+    // cos(2 * atan2(baseline / 2, depth)) = (depth^2 - (baseline / 2)^2) / (depth^2 + (baseline / 2)^2)
+    const double half_baseline_sq = 0.25 * keyfrm->camera_->true_baseline_ * keyfrm->camera_->true_baseline_;
+    const Eigen::ArrayXd depths_sq = depths.array().square();
+    cos_stereo_parallaxes_ = (0.0 <= x_rights_.array())
+                                 .select((depths_sq - half_baseline_sq) / (depths_sq + half_baseline_sq), 2.0)
+                                 .matrix();
+}
+
+//! Check that the depths are positive (if camera model is equirectangular, always true)
+VecXb_t check_depths_are_positive(const MatX3_t& pos_ws, const Mat33_t& rot_cw, const Vec3_t& trans_cw, const camera::base* camera) {
+    if (camera->model_type_ == camera::model_type_t::Equirectangular) {
+        return VecXb_t::Constant(pos_ws.rows(), true);
+    }
+    return 0.0 < ((pos_ws * rot_cw.row(2).transpose()).array() + trans_cw(2));
+}
+
+//! Check that the reprojection errors are within the acceptable threshold
+VecXb_t check_reprojection_errors(const MatX3_t& pos_ws, const Mat33_t& rot_cw, const Vec3_t& trans_cw, const camera::base* camera,
+                                  const matched_observations& obs) {
+    // chi-squared values for p=5%
+    // (n=2)
+    constexpr double chi_sq_2D = 5.99146;
+    // (n=3)
+    constexpr double chi_sq_3D = 7.81473;
+
+    MatX2_t reprojs;
+    VecX_t x_rights;
+    VecXb_t is_visible;
+    camera->reproject_points_to_image(rot_cw, trans_cw, pos_ws, reprojs, x_rights, is_visible);
+
+    const Eigen::ArrayXd reproj_err_sqs = (reprojs - obs.keypts_).rowwise().squaredNorm().array();
+    const Eigen::ArrayXd reproj_err_x_right_sqs = (x_rights - obs.x_rights_).array().square();
+    const Eigen::ArrayXd level_sigma_sqs = obs.level_sigma_sqs_.array();
+    return (0.0 <= obs.x_rights_.array())
+        .select(reproj_err_sqs + reproj_err_x_right_sqs <= chi_sq_3D * level_sigma_sqs,
+                reproj_err_sqs <= chi_sq_2D * level_sigma_sqs);
+}
+
+} // namespace
+
 two_view_triangulator::two_view_triangulator(const std::shared_ptr<data::keyframe>& keyfrm_1, const std::shared_ptr<data::keyframe>& keyfrm_2,
                                              const float rays_parallax_deg_thr)
     : keyfrm_1_(keyfrm_1), keyfrm_2_(keyfrm_2),
@@ -16,109 +103,91 @@ two_view_triangulator::two_view_triangulator(const std::shared_ptr<data::keyfram
       cos_rays_parallax_thr_(std::cos(rays_parallax_deg_thr * M_PI / 180.0)) {}
 
 bool two_view_triangulator::triangulate(const unsigned idx_1, const unsigned int idx_2, Vec3_t& pos_w) const {
-    const auto& keypt_1 = keyfrm_1_->frm_obs_.undist_keypts_.at(idx_1);
-    const float keypt_1_x_right = keyfrm_1_->frm_obs_.stereo_x_right_.empty() ? -1.0f : keyfrm_1_->frm_obs_.stereo_x_right_.at(idx_1);
-    const bool is_stereo_1 = 0 <= keypt_1_x_right;
+    MatX3_t pos_ws;
+    std::vector<bool> is_triangulated;
+    if (triangulate({{idx_1, idx_2}}, pos_ws, is_triangulated) == 0) {
+        return false;
+    }
+    pos_w = pos_ws.row(0).transpose();
+    return true;
+}
 
-    const auto& keypt_2 = keyfrm_2_->frm_obs_.undist_keypts_.at(idx_2);
-    const float keypt_2_x_right = keyfrm_2_->frm_obs_.stereo_x_right_.empty() ? -1.0f : keyfrm_2_->frm_obs_.stereo_x_right_.at(idx_2);
-    const bool is_stereo_2 = 0 <= keypt_2_x_right;
+unsigned int two_view_triangulator::triangulate(const std::vector<std::pair<unsigned int, unsigned int>>& matches,
+                                                MatX3_t& pos_ws, std::vector<bool>& is_triangulated) const {
+    const auto num_matches = matches.size();
+    std::vector<unsigned int> indices_1(num_matches);
+    std::vector<unsigned int> indices_2(num_matches);
+    for (unsigned int i = 0; i < num_matches; ++i) {
+        indices_1.at(i) = matches.at(i).first;
+        indices_2.at(i) = matches.at(i).second;
+    }
+    const matched_observations obs_1(keyfrm_1_, indices_1);
+    const matched_observations obs_2(keyfrm_2_, indices_2);
 
-    // rays with reference of each camera
-    const Vec3_t ray_c_1 = keyfrm_1_->frm_obs_.bearings_.at(idx_1);
-    const Vec3_t ray_c_2 = keyfrm_2_->frm_obs_.bearings_.at(idx_2);
     // rays with the world reference
-    const Vec3_t ray_w_1 = rot_w1_ * ray_c_1;
-    const Vec3_t ray_w_2 = rot_w2_ * ray_c_2;
-    const auto cos_rays_parallax = ray_w_1.dot(ray_w_2);
-
-    // compute the stereo parallax if the keypoint is observed as stereo
-    const float depth_1 = keyfrm_1_->frm_obs_.depths_.empty() ? -1.0f : keyfrm_1_->frm_obs_.depths_.at(idx_1);
-    const auto cos_stereo_parallax_1 = is_stereo_1
-                                           ? std::cos(2.0 * atan2(camera_1_->true_baseline_ / 2.0, depth_1))
-                                           : 2.0;
-    const float depth_2 = keyfrm_2_->frm_obs_.depths_.empty() ? -1.0f : keyfrm_2_->frm_obs_.depths_.at(idx_2);
-    const auto cos_stereo_parallax_2 = is_stereo_2
-                                           ? std::cos(2.0 * atan2(camera_2_->true_baseline_ / 2.0, depth_2))
-                                           : 2.0;
-    const auto cos_stereo_parallax = std::min(cos_stereo_parallax_1, cos_stereo_parallax_2);
+    const MatX3_t rays_w_1 = obs_1.bearings_ * rot_1w_;
+    const MatX3_t rays_w_2 = obs_2.bearings_ * rot_2w_;
+    const Eigen::ArrayXd cos_rays_parallaxes = rays_w_1.cwiseProduct(rays_w_2).rowwise().sum().array();
 
     // select to use "linear triangulation" or "stereo triangulation"
-    // threshold of minimum angle of the two rays
-    const bool triangulate_with_two_cameras =
-        // check if the sufficient parallax is provided
-        ((!is_stereo_1 && !is_stereo_2) && 0.0 < cos_rays_parallax && cos_rays_parallax < cos_rays_parallax_thr_)
-        // check if the parallax between the two cameras is larger than the stereo parallax
-        || ((is_stereo_1 || is_stereo_2) && 0.0 < cos_rays_parallax && cos_rays_parallax < cos_stereo_parallax);
+    const VecXb_t is_stereo_1 = 0.0 <= obs_1.x_rights_.array();
+    const VecXb_t is_stereo_2 = 0.0 <= obs_2.x_rights_.array();
+    const Eigen::ArrayXd cos_stereo_parallaxes_1 = obs_1.cos_stereo_parallaxes_.array();
+    const Eigen::ArrayXd cos_stereo_parallaxes_2 = obs_2.cos_stereo_parallaxes_.array();
+    // threshold of minimum angle of the two rays,
+    // or the stereo parallax if the keypoint is observed as stereo (then the parallax between the two cameras should be larger)
+    const Eigen::ArrayXd cos_parallax_thrs = (is_stereo_1 || is_stereo_2)
+                                                 .select(cos_stereo_parallaxes_1.min(cos_stereo_parallaxes_2),
+                                                         static_cast<double>(cos_rays_parallax_thr_));
+    const VecXb_t triangulate_with_two_cameras = (0.0 < cos_rays_parallaxes) && (cos_rays_parallaxes < cos_parallax_thrs);
 
     // triangulate
-    if (triangulate_with_two_cameras) {
-        pos_w = solve::triangulator::triangulate(ray_c_1, ray_c_2, cam_pose_1w_, cam_pose_2w_);
-    }
-    else if (is_stereo_1 && cos_stereo_parallax_1 < cos_stereo_parallax_2) {
-        pos_w = keyfrm_1_->triangulate_stereo(idx_1);
-    }
-    else if (is_stereo_2 && cos_stereo_parallax_2 < cos_stereo_parallax_1) {
-        pos_w = keyfrm_2_->triangulate_stereo(idx_2);
-    }
-    else {
-        return false;
+    solve::triangulator::triangulate(obs_1.bearings_, obs_2.bearings_, cam_pose_1w_, cam_pose_2w_, pos_ws);
+    VecXb_t is_valid = triangulate_with_two_cameras;
+    for (unsigned int i = 0; i < num_matches; ++i) {
+        if (triangulate_with_two_cameras(i)) {
+            continue;
+        }
+        if (is_stereo_1(i) && cos_stereo_parallaxes_1(i) < cos_stereo_parallaxes_2(i)) {
+            pos_ws.row(i) = data::triangulate_stereo(camera_1_, rot_w1_, cam_center_1_, *keyfrm_1_->frm_obs_, indices_1.at(i)).transpose();
+            is_valid(i) = true;
+        }
+        else if (is_stereo_2(i) && cos_stereo_parallaxes_2(i) < cos_stereo_parallaxes_1(i)) {
+            pos_ws.row(i) = data::triangulate_stereo(camera_2_, rot_w2_, cam_center_2_, *keyfrm_2_->frm_obs_, indices_2.at(i)).transpose();
+            is_valid(i) = true;
+        }
     }
 
     // check the triangulated point is located in front of the two cameras
-    if (!check_depth_is_positive(pos_w, rot_1w_, trans_1w_, camera_1_)
-        || !check_depth_is_positive(pos_w, rot_2w_, trans_2w_, camera_2_)) {
-        return false;
-    }
+    is_valid = is_valid
+               && check_depths_are_positive(pos_ws, rot_1w_, trans_1w_, camera_1_)
+               && check_depths_are_positive(pos_ws, rot_2w_, trans_2w_, camera_2_);
 
     // reject the point if reprojection errors are larger than reasonable threshold
-    if (!check_reprojection_error(pos_w, rot_1w_, trans_1w_, camera_1_, keypt_1.pt, keypt_1_x_right,
-                                  keyfrm_1_->orb_params_->level_sigma_sq_.at(keypt_1.octave), is_stereo_1)
-        || !check_reprojection_error(pos_w, rot_2w_, trans_2w_, camera_2_, keypt_2.pt, keypt_2_x_right,
-                                     keyfrm_2_->orb_params_->level_sigma_sq_.at(keypt_2.octave), is_stereo_2)) {
-        return false;
-    }
+    is_valid = is_valid
+               && check_reprojection_errors(pos_ws, rot_1w_, trans_1w_, camera_1_, obs_1)
+               && check_reprojection_errors(pos_ws, rot_2w_, trans_2w_, camera_2_, obs_2);
 
     // reject the point if the real scale factor and the predicted one are much different
-    if (!check_scale_factors(pos_w,
-                             keyfrm_1_->orb_params_->scale_factors_.at(keypt_1.octave),
-                             keyfrm_2_->orb_params_->scale_factors_.at(keypt_2.octave))) {
-        return false;
-    }
+    is_valid = is_valid && check_scale_factors(pos_ws, obs_1.scale_factors_, obs_2.scale_factors_);
 
-    return true;
+    is_triangulated.resize(num_matches);
+    for (unsigned int i = 0; i < num_matches; ++i) {
+        is_triangulated.at(i) = is_valid(i);
+    }
+    return is_valid.count();
 }
 
-template<typename T>
-bool two_view_triangulator::check_reprojection_error(const Vec3_t& pos_w, const Mat33_t& rot_cw, const Vec3_t& trans_cw, camera::base* const camera,
-                                                     const cv::Point_<T>& keypt, const float x_right, const float sigma_sq, const bool is_stereo) const {
-    assert(is_stereo ^ (x_right < 0));
+VecXb_t two_view_triangulator::check_scale_factors(const MatX3_t& pos_ws, const VecX_t& scale_factors_1, const VecX_t& scale_factors_2) const {
+    const Eigen::ArrayXd cam_1_to_lm_dists = (pos_ws.rowwise() - cam_center_1_.transpose()).rowwise().norm().array();
+    const Eigen::ArrayXd cam_2_to_lm_dists = (pos_ws.rowwise() - cam_center_2_.transpose()).rowwise().norm().array();
 
-    // chi-squared values for p=5%
-    // (n=2)
-    constexpr float chi_sq_2D = 5.99146;
-    // (n=3)
-    constexpr float chi_sq_3D = 7.81473;
-
-    Vec2_t reproj_in_cur;
-    float x_right_in_cur;
-    camera->reproject_to_image(rot_cw, trans_cw, pos_w, reproj_in_cur, x_right_in_cur);
-
-    if (is_stereo) {
-        const Vec2_t reproj_err = reproj_in_cur - keypt;
-        const auto reproj_err_x_right = x_right_in_cur - x_right;
-        if ((chi_sq_3D * sigma_sq) < (reproj_err.squaredNorm() + reproj_err_x_right * reproj_err_x_right)) {
-            return false;
-        }
-    }
-    else {
-        const Vec2_t reproj_err = reproj_in_cur - keypt;
-        if ((chi_sq_2D * sigma_sq) < reproj_err.squaredNorm()) {
-            return false;
-        }
-    }
+    const Eigen::ArrayXd ratio_dists = cam_2_to_lm_dists / cam_1_to_lm_dists;
+    const Eigen::ArrayXd ratio_octaves = scale_factors_1.array() / scale_factors_2.array();
+    const double ratio_factor = ratio_factor_;
 
-    return true;
+    return (cam_1_to_lm_dists != 0.0) && (cam_2_to_lm_dists != 0.0)
+           && (ratio_octaves / ratio_dists < ratio_factor) && (ratio_dists / ratio_octaves < ratio_factor);
 }
 
 } // namespace module
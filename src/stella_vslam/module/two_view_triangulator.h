@@ -4,6 +4,7 @@
 #include "stella_vslam/type.h"
 
 #include <memory>
+#include <vector>
 
 namespace stella_vslam {
 
@@ -37,23 +38,22 @@ public:
      */
     bool triangulate(const unsigned idx_1, const unsigned int idx_2, Vec3_t& pos_w) const;
 
-private:
-    /**
-     * Check depth is positive or not (if camera model is equirectangular, always return true)
-     */
-    bool check_depth_is_positive(const Vec3_t& pos_w, const Mat33_t& rot_cw, const Vec3_t& trans_cw, camera::base* camera) const;
-
     /**
-     * Check reprojection error is within the acceptable threshold
+     * Triangulate the landmarks of all of the matches between the keypoints of keyfrm_1 and the ones of keyfrm_2
+     * (the matches are triangulated and checked at once on the columns of the coordinates)
+     * @param matches pairs of the keypoint indices of keyfrm_1 and keyfrm_2
+     * @param pos_ws triangulated positions in the world reference (one match per row)
+     * @param is_triangulated true if the match is triangulated successfully
+     * @return number of the triangulated matches
      */
-    template<typename T>
-    bool check_reprojection_error(const Vec3_t& pos_w, const Mat33_t& rot_cw, const Vec3_t& trans_cw, camera::base* camera,
-                                  const cv::Point_<T>& keypt, const float x_right, const float sigma_sq, const bool is_stereo) const;
+    unsigned int triangulate(const std::vector<std::pair<unsigned int, unsigned int>>& matches,
+                             MatX3_t& pos_ws, std::vector<bool>& is_triangulated) const;
 
+private:
     /**
      * Check estimated and actual scale factors are within the acceptable threshold
      */
-    bool check_scale_factors(const Vec3_t& pos_w, const float scale_factor_1, const float scale_factor_2) const;
+    VecXb_t check_scale_factors(const MatX3_t& pos_ws, const VecX_t& scale_factors_1, const VecX_t& scale_factors_2) const;
 
     //! pointer to keyframe 1
     std::shared_ptr<data::keyframe> const keyfrm_1_;
@@ -85,28 +85,6 @@ private:
     const float cos_rays_parallax_thr_;
 };
 
-inline bool two_view_triangulator::check_depth_is_positive(const Vec3_t& pos_w, const Mat33_t& rot_cw, const Vec3_t& trans_cw, camera::base* const camera) const {
-    const auto pos_z = rot_cw.block<1, 3>(2, 0).dot(pos_w) + trans_cw(2);
-    return camera->model_type_ == camera::model_type_t::Equirectangular || 0 < pos_z;
-}
-
-inline bool two_view_triangulator::check_scale_factors(const Vec3_t& pos_w, const float scale_factor_1, const float scale_factor_2) const {
-    const Vec3_t cam_1_to_lm_vec = pos_w - cam_center_1_;
-    const auto cam_1_to_lm_dist = cam_1_to_lm_vec.norm();
-
-    const Vec3_t cam_2_to_lm_vec = pos_w - cam_center_2_;
-    const auto cam_2_to_lm_dist = cam_2_to_lm_vec.norm();
-
-    if (cam_1_to_lm_dist == 0 || cam_2_to_lm_dist == 0) {
-        return false;
-    }
-
-    const auto ratio_dists = cam_2_to_lm_dist / cam_1_to_lm_dist;
-    const auto ratio_octave = scale_factor_1 / scale_factor_2;
-
-    return ratio_octave / ratio_dists < ratio_factor_ && ratio_dists / ratio_octave < ratio_factor_;
-}
-
 } // namespace module
 } // namespace stella_vslam
 
@@ -4,6 +4,7 @@
 #include <g2o/types/sim3/types_seven_dof_expmap.h>
 
 #include <memory>
+#include <vector>
 
 namespace stella_vslam {
 
@@ -21,16 +22,27 @@ typedef std::map<std::shared_ptr<data::keyframe>,
     keyframe_Sim3_pairs_t;
 
 // キーフレームの集合, 中心のキーフレーム, 連続検出回数を合わせた構造体
+// (the set is kept as the sorted IDs of the keyframes, which are shared with the expansion cache of the loop detector)
 struct keyframe_set {
-    keyframe_set(const std::set<std::shared_ptr<data::keyframe>>& keyfrm_set, const std::shared_ptr<data::keyframe>& lead_keyfrm, const unsigned int continuity)
-        : keyfrm_set_(keyfrm_set), lead_keyfrm_(lead_keyfrm), continuity_(continuity) {}
-    std::set<std::shared_ptr<data::keyframe>> keyfrm_set_;
+    keyframe_set(const std::shared_ptr<const std::vector<unsigned int>>& keyfrm_ids, const std::shared_ptr<data::keyframe>& lead_keyfrm, const unsigned int continuity)
+        : keyfrm_ids_(keyfrm_ids), lead_keyfrm_(lead_keyfrm), continuity_(continuity) {}
+    //! IDs of the keyframes in the set in ascending order
+    std::shared_ptr<const std::vector<unsigned int>> keyfrm_ids_;
     std::shared_ptr<data::keyframe> lead_keyfrm_;
     unsigned int continuity_ = 0;
 
-    bool intersection_is_empty(const std::set<std::shared_ptr<data::keyframe>>& other_set) const {
-        for (const auto& this_keyfrm : keyfrm_set_) {
-            if (static_cast<bool>(other_set.count(this_keyfrm))) {
+    //! (other_ids must be in ascending order)
+    bool intersection_is_empty(const std::vector<unsigned int>& other_ids) const {
+        auto this_itr = keyfrm_ids_->begin();
+        auto other_itr = other_ids.begin();
+        while (this_itr != keyfrm_ids_->end() && other_itr != other_ids.end()) {
+            if (*this_itr < *other_itr) {
+                ++this_itr;
+            }
+            else if (*other_itr < *this_itr) {
+                ++other_itr;
+            }
+            else {
                 return false;
             }
         }
@@ -38,7 +50,7 @@ struct keyframe_set {
     }
 
     bool intersection_is_empty(const keyframe_set& other_set) const {
-        return intersection_is_empty(other_set.keyfrm_set_);
+        return intersection_is_empty(*other_set.keyfrm_ids_);
     }
 };
 
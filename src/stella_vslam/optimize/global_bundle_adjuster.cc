@@ -9,21 +9,29 @@
 #include "stella_vslam/optimize/internal/marker_vertex_container.h"
 #include "stella_vslam/optimize/internal/se3/shot_vertex_container.h"
 #include "stella_vslam/optimize/internal/se3/reproj_edge_wrapper.h"
+#include "stella_vslam/optimize/internal/linear_solver.h"
 #include "stella_vslam/util/converter.h"
+#include "stella_vslam/util/parallel_for.h"
+
+#include <algorithm>
+#include <chrono>
+#include <list>
+#include <map>
+#include <unordered_map>
 
 #include <g2o/core/solver.h>
 #include <g2o/core/block_solver.h>
 #include <g2o/core/sparse_optimizer.h>
 #include <g2o/core/robust_kernel_impl.h>
 #include <g2o/types/sba/types_six_dof_expmap.h>
-#include <g2o/solvers/eigen/linear_solver_eigen.h>
-#include <g2o/solvers/csparse/linear_solver_csparse.h>
 #include <g2o/core/optimization_algorithm_levenberg.h>
 
+#include <spdlog/spdlog.h>
+
 namespace stella_vslam {
 namespace optimize {
 
-void optimize_impl(g2o::SparseOptimizer& optimizer,
+int optimize_impl(g2o::SparseOptimizer& optimizer,
                    const std::vector<std::shared_ptr<data::keyframe>>& keyfrms,
                    const std::vector<std::shared_ptr<data::landmark>>& lms,
                    const std::vector<std::shared_ptr<data::marker>>& markers,
@@ -33,11 +41,12 @@ void optimize_impl(g2o::SparseOptimizer& optimizer,
                    internal::marker_vertex_container& marker_vtx_container,
                    unsigned int num_iter,
                    bool use_huber_kernel,
+                   linear_solver_type_t linear_solver_type,
                    bool* const force_stop_flag) {
     // 2. Construct an optimizer
 
     std::unique_ptr<g2o::BlockSolverBase> block_solver;
-    auto linear_solver = g2o::make_unique<g2o::LinearSolverCSparse<g2o::BlockSolver_6_3::PoseMatrixType>>();
+    auto linear_solver = internal::create_linear_solver<g2o::BlockSolver_6_3>(linear_solver_type);
     block_solver = g2o::make_unique<g2o::BlockSolver_6_3>(std::move(linear_solver));
     auto algorithm = new g2o::OptimizationAlgorithmLevenberg(std::move(block_solver));
 
@@ -106,8 +115,8 @@ void optimize_impl(g2o::SparseOptimizer& optimizer,
             }
 
             const auto keyfrm_vtx = keyfrm_vtx_container.get_vertex(keyfrm);
-            const auto& undist_keypt = keyfrm->frm_obs_.undist_keypts_.at(idx);
-            const float x_right = keyfrm->frm_obs_.stereo_x_right_.empty() ? -1.0f : keyfrm->frm_obs_.stereo_x_right_.at(idx);
+            const auto& undist_keypt = keyfrm->frm_obs_->undist_keypts_.at(idx);
+            const float x_right = keyfrm->frm_obs_->stereo_x_right_.empty() ? -1.0f : keyfrm->frm_obs_->stereo_x_right_.at(idx);
             const float inv_sigma_sq = keyfrm->orb_params_->inv_level_sigma_sq_.at(undist_keypt.octave);
             const auto sqrt_chi_sq = (keyfrm->camera_->setup_type_ == camera::setup_type_t::Monocular)
                                          ? sqrt_chi_sq_2D
@@ -165,16 +174,192 @@ void optimize_impl(g2o::SparseOptimizer& optimizer,
 
     // 5. Perform optimization
 
+    optimizer.initializeOptimization();
+    return optimizer.optimize(num_iter);
+}
+
+//! Subproblem of the hierarchical optimization
+struct ba_subproblem {
+    //! key: keyframe ID, value: keyframe and whether it is held fixed
+    std::unordered_map<unsigned int, std::pair<std::shared_ptr<data::keyframe>, bool>> keyfrms_;
+    //! key: landmark ID, value: landmark and whether it is held fixed
+    std::unordered_map<unsigned int, std::pair<std::shared_ptr<data::landmark>, bool>> lms_;
+};
+
+/**
+ * Partition the keyframes into submaps of connected keyframes by growing them along the covisibility graph
+ * @param keyfrms
+ * @param num_keyfrms_per_submap
+ * @param keyfrm_to_submap key: keyframe ID, value: submap index
+ * @return number of the submaps
+ */
+unsigned int partition_into_submaps(const std::vector<std::shared_ptr<data::keyframe>>& keyfrms,
+                                    const unsigned int num_keyfrms_per_submap,
+                                    std::unordered_map<unsigned int, unsigned int>& keyfrm_to_submap) {
+    std::unordered_set<unsigned int> valid_keyfrm_ids;
+    for (const auto& keyfrm : keyfrms) {
+        if (keyfrm && !keyfrm->will_be_erased()) {
+            valid_keyfrm_ids.insert(keyfrm->id_);
+        }
+    }
+
+    unsigned int num_submaps = 0;
+    for (const auto& seed : keyfrms) {
+        if (!seed || !valid_keyfrm_ids.count(seed->id_) || keyfrm_to_submap.count(seed->id_)) {
+            continue;
+        }
+
+        // Breadth-first search from the seed
+        const auto submap_idx = num_submaps++;
+        unsigned int num_keyfrms = 0;
+        std::list<std::shared_ptr<data::keyframe>> keyfrms_to_check{seed};
+        keyfrm_to_submap[seed->id_] = submap_idx;
+        while (!keyfrms_to_check.empty() && num_keyfrms < num_keyfrms_per_submap) {
+            const auto keyfrm = keyfrms_to_check.front();
+            keyfrms_to_check.pop_front();
+            ++num_keyfrms;
+
+            for (const auto& covisibility : keyfrm->graph_node_->get_covisibilities()) {
+                if (!covisibility || !valid_keyfrm_ids.count(covisibility->id_) || keyfrm_to_submap.count(covisibility->id_)) {
+                    continue;
+                }
+                if (num_keyfrms + keyfrms_to_check.size() >= num_keyfrms_per_submap) {
+                    break;
+                }
+                keyfrm_to_submap[covisibility->id_] = submap_idx;
+                keyfrms_to_check.push_back(covisibility);
+            }
+        }
+    }
+    return num_submaps;
+}
+
+/**
+ * Optimize the subproblem of the hierarchical optimization
+ * @param problem
+ * @param init_keyfrm_to_pose_cw initial poses (the current ones are used for the keyframes not contained)
+ * @param init_lm_to_pos_w initial positions (the current ones are used for the landmarks not contained)
+ * @param keyfrm_to_pose_cw optimized poses of the keyframes not held fixed
+ * @param lm_to_pos_w optimized positions of the landmarks not held fixed
+ * @param num_iter
+ * @param use_huber_kernel
+ * @param linear_solver_type
+ * @param deadline deadline of the optimization (nullptr: unlimited)
+ * (NOTE: the force stop flag is not passed to the optimizer because the terminate action overwrites it)
+ */
+void optimize_subproblem(const ba_subproblem& problem,
+                         const eigen_alloc_unord_map<unsigned int, Mat44_t>& init_keyfrm_to_pose_cw,
+                         const eigen_alloc_unord_map<unsigned int, Vec3_t>& init_lm_to_pos_w,
+                         eigen_alloc_unord_map<unsigned int, Mat44_t>& keyfrm_to_pose_cw,
+                         eigen_alloc_unord_map<unsigned int, Vec3_t>& lm_to_pos_w,
+                         unsigned int num_iter,
+                         bool use_huber_kernel,
+                         linear_solver_type_t linear_solver_type,
+                         const std::chrono::steady_clock::time_point* deadline) {
+    auto linear_solver = internal::create_linear_solver<g2o::BlockSolver_6_3>(linear_solver_type);
+    auto block_solver = g2o::make_unique<g2o::BlockSolver_6_3>(std::move(linear_solver));
+    auto algorithm = new g2o::OptimizationAlgorithmLevenberg(std::move(block_solver));
+
+    g2o::SparseOptimizer optimizer;
+    terminate_action terminate;
+    terminate.setGainThreshold(1e-3);
+    if (deadline) {
+        terminate.set_deadline(*deadline);
+    }
+    optimizer.addPostIterationAction(&terminate);
+    optimizer.setAlgorithm(algorithm);
+
+    auto vtx_id_offset = std::make_shared<unsigned int>(0);
+    internal::se3::shot_vertex_container keyfrm_vtx_container(vtx_id_offset, problem.keyfrms_.size());
+    internal::landmark_vertex_container lm_vtx_container(vtx_id_offset, problem.lms_.size());
+
+    for (const auto& id_keyfrm : problem.keyfrms_) {
+        const auto& keyfrm = id_keyfrm.second.first;
+        const auto init_itr = init_keyfrm_to_pose_cw.find(keyfrm->id_);
+        const Mat44_t pose_cw = (init_itr != init_keyfrm_to_pose_cw.end()) ? init_itr->second : keyfrm->get_pose_cw();
+        auto keyfrm_vtx = keyfrm_vtx_container.create_vertex(keyfrm->id_, pose_cw, id_keyfrm.second.second);
+        optimizer.addVertex(keyfrm_vtx);
+    }
+
+    using reproj_edge_wrapper = internal::se3::reproj_edge_wrapper<data::keyframe>;
+    std::vector<reproj_edge_wrapper> reproj_edge_wraps;
+
+    // Chi-squared value with significance level of 5%
+    // Two degree-of-freedom (n=2)
+    constexpr float chi_sq_2D = 5.99146;
+    const float sqrt_chi_sq_2D = std::sqrt(chi_sq_2D);
+    // Three degree-of-freedom (n=3)
+    constexpr float chi_sq_3D = 7.81473;
+    const float sqrt_chi_sq_3D = std::sqrt(chi_sq_3D);
+
+    for (const auto& id_lm : problem.lms_) {
+        const auto& lm = id_lm.second.first;
+        const bool lm_is_fixed = id_lm.second.second;
+        const auto init_itr = init_lm_to_pos_w.find(lm->id_);
+        const Vec3_t pos_w = (init_itr != init_lm_to_pos_w.end()) ? init_itr->second : lm->get_pos_in_world();
+        auto lm_vtx = lm_vtx_container.create_vertex(lm->id_, pos_w, lm_is_fixed);
+        optimizer.addVertex(lm_vtx);
+
+        for (const auto& obs : lm->get_observations()) {
+            auto keyfrm = obs.first.lock();
+            auto idx = obs.second;
+            if (!keyfrm) {
+                continue;
+            }
+            const auto keyfrm_itr = problem.keyfrms_.find(keyfrm->id_);
+            if (keyfrm_itr == problem.keyfrms_.end()) {
+                continue;
+            }
+            // The edge between the fixed vertices has no effect
+            if (lm_is_fixed && keyfrm_itr->second.second) {
+                continue;
+            }
+
+            const auto keyfrm_vtx = keyfrm_vtx_container.get_vertex(keyfrm->id_);
+            const auto& undist_keypt = keyfrm->frm_obs_->undist_keypts_.at(idx);
+            const float x_right = keyfrm->frm_obs_->stereo_x_right_.empty() ? -1.0f : keyfrm->frm_obs_->stereo_x_right_.at(idx);
+            const float inv_sigma_sq = keyfrm->orb_params_->inv_level_sigma_sq_.at(undist_keypt.octave);
+            const auto sqrt_chi_sq = (keyfrm->camera_->setup_type_ == camera::setup_type_t::Monocular)
+                                         ? sqrt_chi_sq_2D
+                                         : sqrt_chi_sq_3D;
+            auto reproj_edge_wrap = reproj_edge_wrapper(keyfrm, keyfrm_vtx, lm, lm_vtx,
+                                                        idx, undist_keypt.pt.x, undist_keypt.pt.y, x_right,
+                                                        inv_sigma_sq, sqrt_chi_sq, use_huber_kernel);
+            reproj_edge_wraps.push_back(reproj_edge_wrap);
+            optimizer.addEdge(reproj_edge_wrap.edge_);
+        }
+    }
+
     optimizer.initializeOptimization();
     optimizer.optimize(num_iter);
+    optimizer.removePostIterationAction(&terminate);
 
-    if (force_stop_flag && *force_stop_flag) {
-        return;
+    for (const auto& id_keyfrm : problem.keyfrms_) {
+        if (id_keyfrm.second.second) {
+            continue;
+        }
+        keyfrm_to_pose_cw[id_keyfrm.first] = util::converter::to_eigen_mat(keyfrm_vtx_container.get_vertex(id_keyfrm.first)->estimate());
+    }
+    for (const auto& id_lm : problem.lms_) {
+        if (id_lm.second.second) {
+            continue;
+        }
+        lm_to_pos_w[id_lm.first] = lm_vtx_container.get_vertex(id_lm.first)->estimate();
     }
 }
 
-global_bundle_adjuster::global_bundle_adjuster(const unsigned int num_iter, const bool use_huber_kernel)
-    : num_iter_(num_iter), use_huber_kernel_(use_huber_kernel) {}
+global_bundle_adjuster::global_bundle_adjuster(const unsigned int num_iter, const bool use_huber_kernel,
+                                               const linear_solver_type_t linear_solver_type,
+                                               const unsigned int num_keyfrms_per_submap,
+                                               const double time_budget,
+                                               const bool use_partial_result)
+    : num_iter_(num_iter), use_huber_kernel_(use_huber_kernel), linear_solver_type_(linear_solver_type),
+      num_keyfrms_per_submap_(num_keyfrms_per_submap), time_budget_(time_budget), use_partial_result_(use_partial_result) {}
+
+std::chrono::steady_clock::time_point global_bundle_adjuster::get_deadline() const {
+    return std::chrono::steady_clock::now()
+           + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(time_budget_));
+}
 
 void global_bundle_adjuster::optimize_for_initialization(const std::vector<std::shared_ptr<data::keyframe>>& keyfrms,
                                                          const std::vector<std::shared_ptr<data::landmark>>& lms,
@@ -193,7 +378,7 @@ void global_bundle_adjuster::optimize_for_initialization(const std::vector<std::
     g2o::SparseOptimizer optimizer;
 
     optimize_impl(optimizer, keyfrms, lms, markers, is_optimized_lm, keyfrm_vtx_container, lm_vtx_container, marker_vtx_container,
-                  num_iter_, use_huber_kernel_, force_stop_flag);
+                  num_iter_, use_huber_kernel_, linear_solver_type_, force_stop_flag);
 
     if (force_stop_flag && *force_stop_flag) {
         return;
@@ -211,6 +396,8 @@ void global_bundle_adjuster::optimize_for_initialization(const std::vector<std::
         keyfrm->set_pose_cw(cam_pose_cw);
     }
 
+    std::vector<std::shared_ptr<data::landmark>> updated_lms;
+    updated_lms.reserve(lms.size());
     for (unsigned int i = 0; i < lms.size(); ++i) {
         if (!is_optimized_lm.at(i)) {
             continue;
@@ -228,8 +415,9 @@ void global_bundle_adjuster::optimize_for_initialization(const std::vector<std::
         const Vec3_t pos_w = lm_vtx->estimate();
 
         lm->set_pos_in_world(pos_w);
-        lm->update_mean_normal_and_obs_scale_variance();
+        updated_lms.push_back(lm);
     }
+    data::landmark::update_prediction_parameters(updated_lms);
 }
 
 bool global_bundle_adjuster::optimize(const std::vector<std::shared_ptr<data::keyframe>>& keyfrms,
@@ -238,6 +426,11 @@ bool global_bundle_adjuster::optimize(const std::vector<std::shared_ptr<data::ke
                                       eigen_alloc_unord_map<unsigned int, Vec3_t>& lm_to_pos_w_after_global_BA,
                                       eigen_alloc_unord_map<unsigned int, Mat44_t>& keyfrm_to_pose_cw_after_global_BA,
                                       bool* const force_stop_flag) const {
+    if (0 < num_keyfrms_per_submap_ && 2 * num_keyfrms_per_submap_ < keyfrms.size()) {
+        return optimize_hierarchical(keyfrms, optimized_keyfrm_ids, optimized_landmark_ids,
+                                     lm_to_pos_w_after_global_BA, keyfrm_to_pose_cw_after_global_BA, force_stop_flag);
+    }
+
     std::unordered_set<unsigned int> already_found_landmark_ids;
     std::vector<std::shared_ptr<data::landmark>> lms;
     for (const auto& keyfrm : keyfrms) {
@@ -286,13 +479,24 @@ bool global_bundle_adjuster::optimize(const std::vector<std::shared_ptr<data::ke
     g2o::SparseOptimizer optimizer;
     auto terminateAction = new terminate_action;
     terminateAction->setGainThreshold(1e-3);
+    if (0.0 < time_budget_) {
+        terminateAction->set_deadline(get_deadline());
+    }
     optimizer.addPostIterationAction(terminateAction);
 
-    optimize_impl(optimizer, keyfrms, lms, markers, is_optimized_lm, keyfrm_vtx_container, lm_vtx_container, marker_vtx_container,
-                  num_iter_, use_huber_kernel_, force_stop_flag);
+    const auto num_performed_iter = optimize_impl(optimizer, keyfrms, lms, markers, is_optimized_lm, keyfrm_vtx_container, lm_vtx_container, marker_vtx_container,
+                                                  num_iter_, use_huber_kernel_, linear_solver_type_, force_stop_flag);
 
     if (force_stop_flag && *force_stop_flag && !terminateAction->stopped_by_terminate_action_) {
-        return false;
+        // Each iteration of Levenberg-Marquardt ends in an accepted state, so the estimates so far can be used
+        if (!use_partial_result_ || num_performed_iter <= 0) {
+            delete terminateAction;
+            return false;
+        }
+        spdlog::info("global bundle adjustment was aborted after {} iterations, use the partial result", num_performed_iter);
+    }
+    else if (terminateAction->stopped_by_deadline_) {
+        spdlog::info("global bundle adjustment reached the time budget after {} iterations", num_performed_iter);
     }
 
     delete terminateAction;
@@ -333,5 +537,274 @@ bool global_bundle_adjuster::optimize(const std::vector<std::shared_ptr<data::ke
     return true;
 }
 
+bool global_bundle_adjuster::optimize_region(const std::vector<std::shared_ptr<data::keyframe>>& region_keyfrms,
+                                             std::unordered_set<unsigned int>& optimized_keyfrm_ids,
+                                             std::unordered_set<unsigned int>& optimized_landmark_ids,
+                                             eigen_alloc_unord_map<unsigned int, Vec3_t>& lm_to_pos_w_after_global_BA,
+                                             eigen_alloc_unord_map<unsigned int, Mat44_t>& keyfrm_to_pose_cw_after_global_BA,
+                                             bool* const force_stop_flag) const {
+    ba_subproblem problem;
+    for (const auto& keyfrm : region_keyfrms) {
+        if (!keyfrm || keyfrm->will_be_erased()) {
+            continue;
+        }
+        problem.keyfrms_[keyfrm->id_] = {keyfrm, keyfrm->graph_node_->is_spanning_root()};
+    }
+    if (problem.keyfrms_.empty()) {
+        return false;
+    }
+    const auto num_region_keyfrms = problem.keyfrms_.size();
+
+    // The keyframes outside of the region which observe the landmarks are held fixed, which anchors the region
+    for (const auto& keyfrm : region_keyfrms) {
+        if (!keyfrm || keyfrm->will_be_erased()) {
+            continue;
+        }
+        for (const auto& lm : keyfrm->get_landmarks()) {
+            if (!lm || lm->will_be_erased() || problem.lms_.count(lm->id_)) {
+                continue;
+            }
+            problem.lms_[lm->id_] = {lm, false};
+
+            for (const auto& obs : lm->get_observations()) {
+                const auto obs_keyfrm = obs.first.lock();
+                if (!obs_keyfrm || obs_keyfrm->will_be_erased()) {
+                    continue;
+                }
+                problem.keyfrms_.emplace(obs_keyfrm->id_, std::make_pair(obs_keyfrm, true));
+            }
+        }
+    }
+    spdlog::info("region global bundle adjustment: {} keyframes ({} fixed), {} landmarks",
+                 problem.keyfrms_.size(), problem.keyfrms_.size() - num_region_keyfrms, problem.lms_.size());
+
+    // (the abort request is checked after the optimization, as in the submaps of the hierarchical mode)
+    const auto deadline = get_deadline();
+    const auto deadline_ptr = (0.0 < time_budget_) ? &deadline : nullptr;
+    // The region starts from the current poses and positions
+    const eigen_alloc_unord_map<unsigned int, Mat44_t> current_poses{};
+    const eigen_alloc_unord_map<unsigned int, Vec3_t> current_positions{};
+    optimize_subproblem(problem, current_poses, current_positions, keyfrm_to_pose_cw_after_global_BA, lm_to_pos_w_after_global_BA,
+                        num_iter_, use_huber_kernel_, linear_solver_type_, deadline_ptr);
+
+    if (force_stop_flag && *force_stop_flag && !use_partial_result_) {
+        return false;
+    }
+
+    // The fixed keyframes keep their poses, which are consistent with the optimized landmarks
+    for (const auto& id_keyfrm : problem.keyfrms_) {
+        if (id_keyfrm.second.second) {
+            keyfrm_to_pose_cw_after_global_BA.emplace(id_keyfrm.first, id_keyfrm.second.first->get_pose_cw());
+        }
+    }
+
+    for (const auto& id_pose : keyfrm_to_pose_cw_after_global_BA) {
+        optimized_keyfrm_ids.insert(id_pose.first);
+    }
+    for (const auto& id_pos : lm_to_pos_w_after_global_BA) {
+        optimized_landmark_ids.insert(id_pos.first);
+    }
+
+    return true;
+}
+
+bool global_bundle_adjuster::optimize_hierarchical(const std::vector<std::shared_ptr<data::keyframe>>& keyfrms,
+                                                   std::unordered_set<unsigned int>& optimized_keyfrm_ids,
+                                                   std::unordered_set<unsigned int>& optimized_landmark_ids,
+                                                   eigen_alloc_unord_map<unsigned int, Vec3_t>& lm_to_pos_w_after_global_BA,
+                                                   eigen_alloc_unord_map<unsigned int, Mat44_t>& keyfrm_to_pose_cw_after_global_BA,
+                                                   bool* const force_stop_flag) const {
+    // 1. Partition the keyframes into submaps
+
+    std::unordered_map<unsigned int, unsigned int> keyfrm_to_submap;
+    const auto num_submaps = partition_into_submaps(keyfrms, num_keyfrms_per_submap_, keyfrm_to_submap);
+    spdlog::info("hierarchical global bundle adjustment: {} keyframes in {} submaps", keyfrm_to_submap.size(), num_submaps);
+
+    std::unordered_map<unsigned int, std::shared_ptr<data::keyframe>> id_to_keyfrm;
+    for (const auto& keyfrm : keyfrms) {
+        if (keyfrm && keyfrm_to_submap.count(keyfrm->id_)) {
+            id_to_keyfrm[keyfrm->id_] = keyfrm;
+        }
+    }
+
+    // 2. Assign each landmark to the submap which observes it most, and find the landmarks on the boundaries
+
+    std::vector<ba_subproblem> submap_problems(num_submaps);
+    ba_subproblem separator_problem;
+    std::unordered_map<unsigned int, unsigned int> lm_to_submap;
+
+    for (const auto& keyfrm : keyfrms) {
+        if (!keyfrm || !keyfrm_to_submap.count(keyfrm->id_)) {
+            continue;
+        }
+        for (const auto& lm : keyfrm->get_landmarks()) {
+            if (!lm || lm->will_be_erased() || lm_to_submap.count(lm->id_)) {
+                continue;
+            }
+
+            std::map<unsigned int, unsigned int> submap_to_num_obs;
+            for (const auto& obs : lm->get_observations()) {
+                const auto obs_keyfrm = obs.first.lock();
+                if (!obs_keyfrm) {
+                    continue;
+                }
+                const auto itr = keyfrm_to_submap.find(obs_keyfrm->id_);
+                if (itr != keyfrm_to_submap.end()) {
+                    ++submap_to_num_obs[itr->second];
+                }
+            }
+            if (submap_to_num_obs.empty()) {
+                continue;
+            }
+
+            const auto owner = std::max_element(submap_to_num_obs.begin(), submap_to_num_obs.end(),
+                                                [](const std::pair<const unsigned int, unsigned int>& a,
+                                                   const std::pair<const unsigned int, unsigned int>& b) {
+                                                    return a.second < b.second;
+                                                })
+                                   ->first;
+            lm_to_submap[lm->id_] = owner;
+
+            for (const auto& submap_num_obs : submap_to_num_obs) {
+                // Free in the owner submap, and fixed in the others
+                submap_problems.at(submap_num_obs.first).lms_[lm->id_] = {lm, submap_num_obs.first != owner};
+            }
+
+            if (1 < submap_to_num_obs.size()) {
+                separator_problem.lms_[lm->id_] = {lm, false};
+            }
+        }
+    }
+
+    // 3. Set the keyframes of each submap problem
+
+    for (auto& problem : submap_problems) {
+        for (const auto& id_lm : problem.lms_) {
+            if (id_lm.second.second) {
+                continue;
+            }
+            for (const auto& obs : id_lm.second.first->get_observations()) {
+                const auto keyfrm = obs.first.lock();
+                if (!keyfrm || !keyfrm_to_submap.count(keyfrm->id_)) {
+                    continue;
+                }
+                // The keyframes in the other submaps are held fixed as the boundary
+                problem.keyfrms_.emplace(keyfrm->id_, std::make_pair(keyfrm, true));
+            }
+        }
+    }
+    for (const auto& id_keyfrm : id_to_keyfrm) {
+        const auto& keyfrm = id_keyfrm.second;
+        submap_problems.at(keyfrm_to_submap.at(keyfrm->id_)).keyfrms_[keyfrm->id_] = {keyfrm, keyfrm->graph_node_->is_spanning_root()};
+    }
+
+    // 4. Optimize the submaps in parallel
+    // (the abort request and the deadline are checked between the submaps)
+
+    const auto deadline = get_deadline();
+    const auto deadline_ptr = (0.0 < time_budget_) ? &deadline : nullptr;
+    const auto is_interrupted = [&]() {
+        return (force_stop_flag && *force_stop_flag) || (deadline_ptr && *deadline_ptr <= std::chrono::steady_clock::now());
+    };
+
+    // The submaps start from the current poses and positions
+    const eigen_alloc_unord_map<unsigned int, Mat44_t> current_poses{};
+    const eigen_alloc_unord_map<unsigned int, Vec3_t> current_positions{};
+    std::vector<eigen_alloc_unord_map<unsigned int, Mat44_t>> submap_keyfrm_to_pose_cw(num_submaps);
+    std::vector<eigen_alloc_unord_map<unsigned int, Vec3_t>> submap_lm_to_pos_w(num_submaps);
+    std::vector<unsigned char> submap_is_optimized(num_submaps, 0);
+    util::parallel_for(
+        thread_pool_, 0, static_cast<int64_t>(num_submaps), [&](const int64_t i) {
+            if (is_interrupted()) {
+                return;
+            }
+            optimize_subproblem(submap_problems.at(i), current_poses, current_positions,
+                                submap_keyfrm_to_pose_cw.at(i), submap_lm_to_pos_w.at(i),
+                                num_iter_, use_huber_kernel_, linear_solver_type_, deadline_ptr);
+            submap_is_optimized.at(i) = 1;
+        },
+        util::task_priority_t::Low);
+
+    const auto num_optimized_submaps = std::count(submap_is_optimized.begin(), submap_is_optimized.end(), 1);
+    if (num_optimized_submaps == 0 || (force_stop_flag && *force_stop_flag && !use_partial_result_)) {
+        return false;
+    }
+
+    for (unsigned int i = 0; i < num_submaps; ++i) {
+        keyfrm_to_pose_cw_after_global_BA.insert(submap_keyfrm_to_pose_cw.at(i).begin(), submap_keyfrm_to_pose_cw.at(i).end());
+        lm_to_pos_w_after_global_BA.insert(submap_lm_to_pos_w.at(i).begin(), submap_lm_to_pos_w.at(i).end());
+    }
+    // The spanning root is held fixed
+    // (the keyframes in the submaps which have not been optimized are corrected through the spanning tree by the caller)
+    for (const auto& id_keyfrm : id_to_keyfrm) {
+        if (submap_is_optimized.at(keyfrm_to_submap.at(id_keyfrm.first)) || id_keyfrm.second->graph_node_->is_spanning_root()) {
+            keyfrm_to_pose_cw_after_global_BA.emplace(id_keyfrm.first, id_keyfrm.second->get_pose_cw());
+        }
+    }
+
+    if (num_optimized_submaps < static_cast<long>(num_submaps)) {
+        spdlog::info("hierarchical global bundle adjustment was interrupted after {} of {} submaps, use the partial result",
+                     num_optimized_submaps, num_submaps);
+        for (const auto& id_pose : keyfrm_to_pose_cw_after_global_BA) {
+            optimized_keyfrm_ids.insert(id_pose.first);
+        }
+        for (const auto& id_pos : lm_to_pos_w_after_global_BA) {
+            optimized_landmark_ids.insert(id_pos.first);
+        }
+        return true;
+    }
+
+    // 5. Reconcile the submaps by optimizing the landmarks on the boundaries and the keyframes observing them
+
+    for (const auto& id_lm : separator_problem.lms_) {
+        for (const auto& obs : id_lm.second.first->get_observations()) {
+            const auto keyfrm = obs.first.lock();
+            if (!keyfrm || !keyfrm_to_submap.count(keyfrm->id_)) {
+                continue;
+            }
+            separator_problem.keyfrms_[keyfrm->id_] = {keyfrm, keyfrm->graph_node_->is_spanning_root()};
+        }
+    }
+    // The interior landmarks observed by the boundary keyframes are held fixed, which anchors the submaps
+    for (const auto& id_keyfrm : separator_problem.keyfrms_) {
+        for (const auto& lm : id_keyfrm.second.first->get_landmarks()) {
+            if (!lm || !lm_to_submap.count(lm->id_) || separator_problem.lms_.count(lm->id_)) {
+                continue;
+            }
+            separator_problem.lms_[lm->id_] = {lm, true};
+        }
+    }
+
+    if (!separator_problem.lms_.empty()) {
+        eigen_alloc_unord_map<unsigned int, Mat44_t> separator_keyfrm_to_pose_cw;
+        eigen_alloc_unord_map<unsigned int, Vec3_t> separator_lm_to_pos_w;
+        optimize_subproblem(separator_problem, keyfrm_to_pose_cw_after_global_BA, lm_to_pos_w_after_global_BA,
+                            separator_keyfrm_to_pose_cw, separator_lm_to_pos_w,
+                            num_iter_, use_huber_kernel_, linear_solver_type_, deadline_ptr);
+
+        if (force_stop_flag && *force_stop_flag && !use_partial_result_) {
+            return false;
+        }
+
+        for (const auto& id_pose : separator_keyfrm_to_pose_cw) {
+            keyfrm_to_pose_cw_after_global_BA[id_pose.first] = id_pose.second;
+        }
+        for (const auto& id_pos : separator_lm_to_pos_w) {
+            lm_to_pos_w_after_global_BA[id_pos.first] = id_pos.second;
+        }
+    }
+
+    // 6. Extract the result
+
+    for (const auto& id_pose : keyfrm_to_pose_cw_after_global_BA) {
+        optimized_keyfrm_ids.insert(id_pose.first);
+    }
+    for (const auto& id_pos : lm_to_pos_w_after_global_BA) {
+        optimized_landmark_ids.insert(id_pos.first);
+    }
+
+    return true;
+}
+
 } // namespace optimize
 } // namespace stella_vslam
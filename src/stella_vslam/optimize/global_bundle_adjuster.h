@@ -1,12 +1,20 @@
 #ifndef STELLA_VSLAM_OPTIMIZE_GLOBAL_BUNDLE_ADJUSTER_H
 #define STELLA_VSLAM_OPTIMIZE_GLOBAL_BUNDLE_ADJUSTER_H
 
+#include "stella_vslam/optimize/linear_solver_type.h"
+
+#include <chrono>
+
 namespace stella_vslam {
 
 namespace data {
 class map_database;
 } // namespace data
 
+namespace util {
+class thread_pool;
+} // namespace util
+
 namespace optimize {
 
 class global_bundle_adjuster {
@@ -15,14 +23,28 @@ public:
      * Constructor
      * @param num_iter
      * @param use_huber_kernel
+     * @param linear_solver_type
+     * @param num_keyfrms_per_submap (0: optimize the whole map at once)
+     * @param time_budget time budget of optimize() in seconds (0: unlimited)
+     * @param use_partial_result return the estimates so far from optimize() when aborted
      */
-    explicit global_bundle_adjuster(const unsigned int num_iter = 10, const bool use_huber_kernel = true);
+    explicit global_bundle_adjuster(const unsigned int num_iter = 10, const bool use_huber_kernel = true,
+                                    const linear_solver_type_t linear_solver_type = linear_solver_type_t::CSparse,
+                                    const unsigned int num_keyfrms_per_submap = 0,
+                                    const double time_budget = 0.0,
+                                    const bool use_partial_result = false);
 
     /**
      * Destructor
      */
     virtual ~global_bundle_adjuster() = default;
 
+    /**
+     * Set the thread pool to optimize the submaps of the hierarchical mode on
+     * (the OpenMP threads are used if nullptr)
+     */
+    void set_thread_pool(util::thread_pool* thread_pool) { thread_pool_ = thread_pool; }
+
     void optimize_for_initialization(const std::vector<std::shared_ptr<data::keyframe>>& keyfrms,
                                      const std::vector<std::shared_ptr<data::landmark>>& lms,
                                      const std::vector<std::shared_ptr<data::marker>>& markers,
@@ -30,13 +52,14 @@ public:
 
     /**
      * Perform optimization
+     * (NOTE: the hierarchical mode is used if the number of the keyframes exceeds twice num_keyfrms_per_submap)
      * @param keyfrms
      * @param optimized_keyfrm_ids
      * @param optimized_landmark_ids
      * @param lm_to_pos_w_after_global_BA
      * @param keyfrm_to_pose_cw_after_global_BA
      * @param force_stop_flag
-     * @return false if aborted
+     * @return false if aborted (without use_partial_result)
      */
     bool optimize(const std::vector<std::shared_ptr<data::keyframe>>& keyfrms,
                   std::unordered_set<unsigned int>& optimized_keyfrm_ids,
@@ -45,12 +68,58 @@ public:
                   eigen_alloc_unord_map<unsigned int, Mat44_t>& keyfrm_to_pose_cw_after_global_BA,
                   bool* const force_stop_flag = nullptr) const;
 
+    /**
+     * Perform optimization of a region of the map
+     * The keyframes in the region and the landmarks observed by them are optimized,
+     * while the other keyframes observing the landmarks are held fixed and returned with their current poses.
+     * (NOTE: markers are not used in this mode, and the spanning root is held fixed)
+     * @param region_keyfrms
+     * @param optimized_keyfrm_ids
+     * @param optimized_landmark_ids
+     * @param lm_to_pos_w_after_global_BA
+     * @param keyfrm_to_pose_cw_after_global_BA
+     * @param force_stop_flag
+     * @return false if aborted (without use_partial_result)
+     */
+    bool optimize_region(const std::vector<std::shared_ptr<data::keyframe>>& region_keyfrms,
+                         std::unordered_set<unsigned int>& optimized_keyfrm_ids,
+                         std::unordered_set<unsigned int>& optimized_landmark_ids,
+                         eigen_alloc_unord_map<unsigned int, Vec3_t>& lm_to_pos_w_after_global_BA,
+                         eigen_alloc_unord_map<unsigned int, Mat44_t>& keyfrm_to_pose_cw_after_global_BA,
+                         bool* const force_stop_flag = nullptr) const;
+
 private:
+    //! Get the deadline of the optimization which starts now
+    std::chrono::steady_clock::time_point get_deadline() const;
+
+    /**
+     * Perform hierarchical optimization
+     * The covisibility graph is partitioned into submaps, which are optimized in parallel with their boundaries held fixed.
+     * Then the keyframes and the landmarks on the boundaries are reconciled by optimizing the separator problem.
+     * (NOTE: markers are not used in this mode)
+     */
+    bool optimize_hierarchical(const std::vector<std::shared_ptr<data::keyframe>>& keyfrms,
+                               std::unordered_set<unsigned int>& optimized_keyfrm_ids,
+                               std::unordered_set<unsigned int>& optimized_landmark_ids,
+                               eigen_alloc_unord_map<unsigned int, Vec3_t>& lm_to_pos_w_after_global_BA,
+                               eigen_alloc_unord_map<unsigned int, Mat44_t>& keyfrm_to_pose_cw_after_global_BA,
+                               bool* const force_stop_flag) const;
+
     //! number of iterations of optimization
     unsigned int num_iter_;
 
     //! use Huber loss or not
     const bool use_huber_kernel_;
+    //! linear solver for the reduced camera system
+    const linear_solver_type_t linear_solver_type_;
+    //! maximum number of keyframes in a submap of the hierarchical optimization (0: disabled)
+    const unsigned int num_keyfrms_per_submap_;
+    //! time budget of optimize() in seconds (0: unlimited)
+    const double time_budget_;
+    //! return the estimates so far when aborted
+    const bool use_partial_result_;
+    //! thread pool to optimize the submaps on (nullptr if not set)
+    util::thread_pool* thread_pool_ = nullptr;
 };
 
 } // namespace optimize
@@ -1,10 +1,12 @@
 #include "stella_vslam/data/keyframe.h"
 #include "stella_vslam/data/landmark.h"
 #include "stella_vslam/data/map_database.h"
+#include "stella_vslam/data/map_correction.h"
 #include "stella_vslam/optimize/graph_optimizer.h"
 #include "stella_vslam/optimize/terminate_action.h"
 #include "stella_vslam/optimize/internal/sim3/shot_vertex.h"
 #include "stella_vslam/optimize/internal/sim3/graph_opt_edge.h"
+#include "stella_vslam/optimize/internal/linear_solver.h"
 #include "stella_vslam/util/converter.h"
 
 #include <Eigen/StdVector>
@@ -12,34 +14,21 @@
 #include <g2o/core/block_solver.h>
 #include <g2o/core/sparse_optimizer.h>
 #include <g2o/core/robust_kernel_impl.h>
-#include <g2o/solvers/csparse/linear_solver_csparse.h>
 #include <g2o/core/optimization_algorithm_levenberg.h>
 #include <g2o/core/sparse_optimizer_terminate_action.h>
 
 namespace stella_vslam {
 namespace optimize {
 
-graph_optimizer::graph_optimizer(const bool fix_scale)
-    : fix_scale_(fix_scale) {}
+graph_optimizer::graph_optimizer(const bool fix_scale, const linear_solver_type_t linear_solver_type)
+    : fix_scale_(fix_scale), linear_solver_type_(linear_solver_type) {}
 
 void graph_optimizer::optimize(const std::shared_ptr<data::keyframe>& loop_keyfrm, const std::shared_ptr<data::keyframe>& curr_keyfrm,
                                const module::keyframe_Sim3_pairs_t& non_corrected_Sim3s,
                                const module::keyframe_Sim3_pairs_t& pre_corrected_Sim3s,
                                const std::map<std::shared_ptr<data::keyframe>, std::set<std::shared_ptr<data::keyframe>>>& loop_connections,
                                std::unordered_map<unsigned int, unsigned int>& found_lm_to_ref_keyfrm_id) const {
-    // 1. Construct an optimizer
-
-    auto linear_solver = g2o::make_unique<g2o::LinearSolverCSparse<g2o::BlockSolver_7_3::PoseMatrixType>>();
-    auto block_solver = g2o::make_unique<g2o::BlockSolver_7_3>(std::move(linear_solver));
-    auto algorithm = new g2o::OptimizationAlgorithmLevenberg(std::move(block_solver));
-
-    g2o::SparseOptimizer optimizer;
-    auto terminateAction = new terminate_action;
-    terminateAction->setGainThreshold(1e-3);
-    optimizer.addPostIterationAction(terminateAction);
-    optimizer.setAlgorithm(algorithm);
-
-    // 2. Add vertices
+    // 1. Collect the vertices
 
     const auto all_keyfrms = curr_keyfrm->graph_node_->get_keyframes_from_root();
     std::unordered_set<unsigned int> already_found_landmark_ids;
@@ -63,8 +52,8 @@ void graph_optimizer::optimize(const std::shared_ptr<data::keyframe>& loop_keyfr
 
     // Transform the pre-modified poses of all the keyframes to Sim3, and save them
     eigen_alloc_unord_map<unsigned int, g2o::Sim3> Sim3s_cw;
-    // Save the added vertices
-    std::unordered_map<unsigned int, internal::sim3::shot_vertex*> vertices;
+    // IDs of the vertices which are not optimized
+    std::unordered_set<unsigned int> fixed_ids;
 
     constexpr int min_num_shared_lms = 100;
 
@@ -72,7 +61,6 @@ void graph_optimizer::optimize(const std::shared_ptr<data::keyframe>& loop_keyfr
         if (keyfrm->will_be_erased()) {
             continue;
         }
-        auto keyfrm_vtx = new internal::sim3::shot_vertex();
 
         const auto id = keyfrm->id_;
 
@@ -81,7 +69,6 @@ void graph_optimizer::optimize(const std::shared_ptr<data::keyframe>& loop_keyfr
         if (iter != pre_corrected_Sim3s.end()) {
             // BEFORE optimization, set the already-modified poses for verices
             Sim3s_cw[id] = iter->second;
-            keyfrm_vtx->setEstimate(iter->second);
         }
         else {
             // Transform an unmodified pose to Sim3, and set it for a vertex
@@ -90,38 +77,25 @@ void graph_optimizer::optimize(const std::shared_ptr<data::keyframe>& loop_keyfr
             const g2o::Sim3 Sim3_cw(rot_cw, trans_cw, 1.0);
 
             Sim3s_cw[id] = Sim3_cw;
-            keyfrm_vtx->setEstimate(Sim3_cw);
         }
 
         // Fix the loop keyframe or root keyframe
         if (*keyfrm == *loop_keyfrm || keyfrm->graph_node_->is_spanning_root()) {
-            keyfrm_vtx->setFixed(true);
+            fixed_ids.insert(id);
         }
-
-        // Set the vertex to the optimizer
-        keyfrm_vtx->setId(id);
-        keyfrm_vtx->fix_scale_ = fix_scale_;
-
-        optimizer.addVertex(keyfrm_vtx);
-        vertices[id] = keyfrm_vtx;
     }
 
-    // 3. Add edges
+    // 2. Collect the constraints
 
     // Save keyframe pairs which the edge is inserted between
     std::set<std::pair<unsigned int, unsigned int>> inserted_edge_pairs;
 
-    // Function to add a constraint edge
-    const auto insert_edge =
-        [&optimizer, &vertices, &inserted_edge_pairs](unsigned int id1, unsigned int id2, const g2o::Sim3& Sim3_21) {
-            auto edge = new internal::sim3::graph_opt_edge();
-            edge->setVertex(0, vertices.at(id1));
-            edge->setVertex(1, vertices.at(id2));
-            edge->setMeasurement(Sim3_21);
-
-            edge->information() = MatRC_t<7, 7>::Identity();
+    eigen_alloc_vector<pose_graph_constraint> constraints;
 
-            optimizer.addEdge(edge);
+    // Function to add a constraint
+    const auto insert_edge =
+        [&constraints, &inserted_edge_pairs](unsigned int id1, unsigned int id2, const g2o::Sim3& Sim3_21) {
+            constraints.emplace_back(id1, id2, Sim3_21);
             inserted_edge_pairs.insert(std::make_pair(std::min(id1, id2), std::max(id1, id2)));
         };
 
@@ -250,58 +224,131 @@ void graph_optimizer::optimize(const std::shared_ptr<data::keyframe>& loop_keyfr
         }
     }
 
-    // 4. Perform a pose graph optimization
+    // 3. Perform a pose graph optimization
 
-    optimizer.initializeOptimization();
-    optimizer.optimize(50);
+    eigen_alloc_unord_map<unsigned int, g2o::Sim3> corrected_Sim3s_cw;
+    optimize_pose_graph(Sim3s_cw, fixed_ids, constraints, corrected_Sim3s_cw);
 
-    delete terminateAction;
+    // 4. Update the camera poses and point-cloud
 
-    // 5. Update the camera poses and point-cloud
+    // compute the corrections into the side buffer without locking the map database,
+    // then publish them at once so that the tracking module is not blocked during the computation
+    data::map_correction correction;
 
-    {
-        std::lock_guard<std::mutex> lock(data::map_database::mtx_database_);
+    // For modification of a point-cloud, save the post-modified poses of all the keyframes
+    eigen_alloc_unord_map<unsigned int, g2o::Sim3> corrected_Sim3s_wc;
 
-        // For modification of a point-cloud, save the post-modified poses of all the keyframes
-        std::unordered_map<unsigned int, g2o::Sim3> corrected_Sim3s_wc;
+    for (auto keyfrm : all_keyfrms) {
+        const auto id = keyfrm->id_;
 
-        for (auto keyfrm : all_keyfrms) {
-            const auto id = keyfrm->id_;
+        const auto iter = corrected_Sim3s_cw.find(id);
+        if (iter == corrected_Sim3s_cw.end()) {
+            continue;
+        }
 
-            auto keyfrm_vtx = static_cast<internal::sim3::shot_vertex*>(optimizer.vertex(id));
+        const g2o::Sim3& corrected_Sim3_cw = iter->second;
+        const float s = corrected_Sim3_cw.scale();
+        const Mat33_t rot_cw = corrected_Sim3_cw.rotation().toRotationMatrix();
+        const Vec3_t trans_cw = corrected_Sim3_cw.translation() / s;
 
-            const g2o::Sim3& corrected_Sim3_cw = keyfrm_vtx->estimate();
-            const float s = corrected_Sim3_cw.scale();
-            const Mat33_t rot_cw = corrected_Sim3_cw.rotation().toRotationMatrix();
-            const Vec3_t trans_cw = corrected_Sim3_cw.translation() / s;
+        const Mat44_t cam_pose_cw = util::converter::to_eigen_pose(rot_cw, trans_cw);
+        correction.set_keyframe_pose(keyfrm, cam_pose_cw);
 
-            const Mat44_t cam_pose_cw = util::converter::to_eigen_pose(rot_cw, trans_cw);
-            keyfrm->set_pose_cw(cam_pose_cw);
+        corrected_Sim3s_wc[id] = corrected_Sim3_cw.inverse();
+    }
 
-            corrected_Sim3s_wc[id] = corrected_Sim3_cw.inverse();
+    // Update the point-cloud
+    for (const auto& lm : all_lms) {
+        if (lm->will_be_erased()) {
+            continue;
         }
 
-        // Update the point-cloud
-        for (const auto& lm : all_lms) {
-            if (lm->will_be_erased()) {
-                continue;
-            }
+        const auto id = (found_lm_to_ref_keyfrm_id.count(lm->id_))
+                            ? found_lm_to_ref_keyfrm_id.at(lm->id_)
+                            : lm->get_ref_keyframe()->id_;
 
-            const auto id = (found_lm_to_ref_keyfrm_id.count(lm->id_))
-                                ? found_lm_to_ref_keyfrm_id.at(lm->id_)
-                                : lm->get_ref_keyframe()->id_;
+        const g2o::Sim3& Sim3_cw = Sim3s_cw.at(id);
+        const g2o::Sim3& corrected_Sim3_wc = corrected_Sim3s_wc.at(id);
 
-            const g2o::Sim3& Sim3_cw = Sim3s_cw.at(id);
-            const g2o::Sim3& corrected_Sim3_wc = corrected_Sim3s_wc.at(id);
+        const Vec3_t pos_w = lm->get_pos_in_world();
+        const Vec3_t corrected_pos_w = corrected_Sim3_wc.map(Sim3_cw.map(pos_w));
 
-            const Vec3_t pos_w = lm->get_pos_in_world();
-            const Vec3_t corrected_pos_w = corrected_Sim3_wc.map(Sim3_cw.map(pos_w));
+        correction.set_landmark_position(lm, corrected_pos_w);
+    }
 
-            lm->set_pos_in_world(corrected_pos_w);
-            lm->update_mean_normal_and_obs_scale_variance();
-        }
+    correction.compute_prediction_parameters();
+
+    {
+        std::lock_guard<util::profiled_mutex> lock(data::map_database::mtx_database_);
+        correction.publish();
     }
 }
 
+unsigned int graph_optimizer::optimize_pose_graph(const eigen_alloc_unord_map<unsigned int, g2o::Sim3>& Sim3s_cw,
+                                                  const std::unordered_set<unsigned int>& fixed_ids,
+                                                  const eigen_alloc_vector<pose_graph_constraint>& constraints,
+                                                  eigen_alloc_unord_map<unsigned int, g2o::Sim3>& corrected_Sim3s_cw) const {
+    // 1. Construct an optimizer
+
+    auto linear_solver = internal::create_linear_solver<g2o::BlockSolver_7_3>(linear_solver_type_);
+    auto block_solver = g2o::make_unique<g2o::BlockSolver_7_3>(std::move(linear_solver));
+    auto algorithm = new g2o::OptimizationAlgorithmLevenberg(std::move(block_solver));
+
+    g2o::SparseOptimizer optimizer;
+    terminate_action terminateAction;
+    terminateAction.setGainThreshold(1e-3);
+    optimizer.addPostIterationAction(&terminateAction);
+    optimizer.setAlgorithm(algorithm);
+
+    // 2. Add vertices
+
+    // Save the added vertices
+    std::unordered_map<unsigned int, internal::sim3::shot_vertex*> vertices;
+    vertices.reserve(Sim3s_cw.size());
+
+    for (const auto& id_Sim3_cw : Sim3s_cw) {
+        const auto id = id_Sim3_cw.first;
+
+        auto vtx = new internal::sim3::shot_vertex();
+        vtx->setEstimate(id_Sim3_cw.second);
+        vtx->setFixed(static_cast<bool>(fixed_ids.count(id)));
+        vtx->setId(id);
+        vtx->fix_scale_ = fix_scale_;
+
+        optimizer.addVertex(vtx);
+        vertices[id] = vtx;
+    }
+
+    // 3. Add edges
+
+    for (const auto& constraint : constraints) {
+        auto edge = new internal::sim3::graph_opt_edge();
+        edge->setVertex(0, vertices.at(constraint.id1_));
+        edge->setVertex(1, vertices.at(constraint.id2_));
+        edge->setMeasurement(constraint.Sim3_21_);
+
+        edge->information() = MatRC_t<7, 7>::Identity();
+
+        optimizer.addEdge(edge);
+    }
+
+    // 4. Perform a pose graph optimization
+
+    optimizer.initializeOptimization();
+    const auto num_iter = optimizer.optimize(50);
+
+    optimizer.removePostIterationAction(&terminateAction);
+
+    // 5. Save the optimized poses
+
+    corrected_Sim3s_cw.clear();
+    corrected_Sim3s_cw.reserve(vertices.size());
+    for (const auto& id_vtx : vertices) {
+        corrected_Sim3s_cw[id_vtx.first] = id_vtx.second->estimate();
+    }
+
+    return (0 < num_iter) ? static_cast<unsigned int>(num_iter) : 0;
+}
+
 } // namespace optimize
 } // namespace stella_vslam
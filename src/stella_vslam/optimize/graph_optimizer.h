@@ -1,11 +1,16 @@
 #ifndef STELLA_VSLAM_OPTIMIZE_GRAPH_OPTIMIZER_H
 #define STELLA_VSLAM_OPTIMIZE_GRAPH_OPTIMIZER_H
 
+#include "stella_vslam/type.h"
 #include "stella_vslam/module/type.h"
+#include "stella_vslam/optimize/linear_solver_type.h"
 
 #include <map>
 #include <set>
 #include <memory>
+#include <unordered_set>
+
+#include <g2o/types/sim3/sim3.h>
 
 namespace stella_vslam {
 
@@ -16,13 +21,28 @@ class map_database;
 
 namespace optimize {
 
+//! Relative Sim3 constraint between two vertices of the pose graph
+struct pose_graph_constraint {
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    pose_graph_constraint(const unsigned int id1, const unsigned int id2, const g2o::Sim3& Sim3_21)
+        : id1_(id1), id2_(id2), Sim3_21_(Sim3_21) {}
+
+    unsigned int id1_;
+    unsigned int id2_;
+    //! relative pose from the vertex 1 to the vertex 2 (Sim3_2w * Sim3_w1)
+    g2o::Sim3 Sim3_21_;
+};
+
 class graph_optimizer {
 public:
     /**
      * Constructor
      * @param fix_scale
+     * @param linear_solver_type
      */
-    explicit graph_optimizer(const bool fix_scale);
+    explicit graph_optimizer(const bool fix_scale,
+                             const linear_solver_type_t linear_solver_type = linear_solver_type_t::CSparse);
 
     /**
      * Destructor
@@ -43,9 +63,25 @@ public:
                   const std::map<std::shared_ptr<data::keyframe>, std::set<std::shared_ptr<data::keyframe>>>& loop_connections,
                   std::unordered_map<unsigned int, unsigned int>& found_lm_to_ref_keyfrm_id) const;
 
+    /**
+     * Optimize the poses of the vertices with the relative pose constraints
+     * (NOTE: this does not touch the map database, so it can be used for a standalone pose graph)
+     * @param Sim3s_cw initial poses of the vertices (key: vertex ID)
+     * @param fixed_ids IDs of the vertices which are not optimized
+     * @param constraints relative pose constraints between the vertices
+     * @param corrected_Sim3s_cw optimized poses of the vertices (key: vertex ID)
+     * @return number of the performed iterations
+     */
+    unsigned int optimize_pose_graph(const eigen_alloc_unord_map<unsigned int, g2o::Sim3>& Sim3s_cw,
+                                     const std::unordered_set<unsigned int>& fixed_ids,
+                                     const eigen_alloc_vector<pose_graph_constraint>& constraints,
+                                     eigen_alloc_unord_map<unsigned int, g2o::Sim3>& corrected_Sim3s_cw) const;
+
 private:
     //! SE3 optimization or Sim3 optimization
     const bool fix_scale_;
+    //! linear solver for the pose graph
+    const linear_solver_type_t linear_solver_type_;
 };
 
 } // namespace optimize
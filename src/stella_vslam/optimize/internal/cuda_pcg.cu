@@ -0,0 +1,272 @@
+#include "stella_vslam/optimize/internal/cuda_pcg.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#include <cuda_runtime.h>
+
+namespace stella_vslam {
+namespace optimize {
+namespace internal {
+
+namespace {
+
+constexpr int num_threads_per_block = 256;
+constexpr int max_num_blocks_of_reduction = 1024;
+
+void check_cuda_error(const cudaError_t err, const char* what) {
+    if (err != cudaSuccess) {
+        throw std::runtime_error(std::string("CUDA error in ") + what + ": " + cudaGetErrorString(err));
+    }
+}
+
+unsigned int get_num_blocks(const unsigned int n) {
+    return (n + num_threads_per_block - 1) / num_threads_per_block;
+}
+
+/**
+ * Device buffer which is grown as needed
+ */
+template<typename T>
+class device_buffer {
+public:
+    device_buffer() = default;
+
+    ~device_buffer() {
+        if (ptr_) {
+            cudaFree(ptr_);
+        }
+    }
+
+    device_buffer(const device_buffer&) = delete;
+    device_buffer& operator=(const device_buffer&) = delete;
+
+    void resize(const size_t size) {
+        if (capacity_ < size) {
+            if (ptr_) {
+                check_cuda_error(cudaFree(ptr_), "cudaFree");
+                ptr_ = nullptr;
+            }
+            check_cuda_error(cudaMalloc(&ptr_, size * sizeof(T)), "cudaMalloc");
+            capacity_ = size;
+        }
+        size_ = size;
+    }
+
+    void upload(const std::vector<T>& host) {
+        resize(host.size());
+        check_cuda_error(cudaMemcpy(ptr_, host.data(), host.size() * sizeof(T), cudaMemcpyHostToDevice), "cudaMemcpy");
+    }
+
+    void download(std::vector<T>& host) const {
+        host.resize(size_);
+        check_cuda_error(cudaMemcpy(host.data(), ptr_, size_ * sizeof(T), cudaMemcpyDeviceToHost), "cudaMemcpy");
+    }
+
+    T* get() const { return ptr_; }
+
+private:
+    T* ptr_ = nullptr;
+    size_t capacity_ = 0;
+    size_t size_ = 0;
+};
+
+//! y = A x (one thread per scalar row, the blocks are column-major)
+__global__ void bsr_spmv_kernel(const int block_dim, const int num_rows,
+                                const int* __restrict__ row_ptrs, const int* __restrict__ col_idxs,
+                                const double* __restrict__ block_values,
+                                const double* __restrict__ x, double* __restrict__ y) {
+    const int row = blockIdx.x * blockDim.x + threadIdx.x;
+    if (num_rows <= row) {
+        return;
+    }
+    const int block_row = row / block_dim;
+    const int local_row = row % block_dim;
+    const size_t block_size = block_dim * block_dim;
+
+    double sum = 0.0;
+    for (int k = row_ptrs[block_row]; k < row_ptrs[block_row + 1]; ++k) {
+        const double* block = block_values + k * block_size;
+        const double* x_col = x + col_idxs[k] * block_dim;
+        for (int j = 0; j < block_dim; ++j) {
+            sum += block[j * block_dim + local_row] * x_col[j];
+        }
+    }
+    y[row] = sum;
+}
+
+//! z = M^-1 r with the inverse of the diagonal blocks
+__global__ void block_jacobi_kernel(const int block_dim, const int num_rows,
+                                    const double* __restrict__ inv_diag_blocks,
+                                    const double* __restrict__ r, double* __restrict__ z) {
+    const int row = blockIdx.x * blockDim.x + threadIdx.x;
+    if (num_rows <= row) {
+        return;
+    }
+    const int block_row = row / block_dim;
+    const int local_row = row % block_dim;
+    const double* block = inv_diag_blocks + block_row * block_dim * block_dim;
+    const double* r_block = r + block_row * block_dim;
+
+    double sum = 0.0;
+    for (int j = 0; j < block_dim; ++j) {
+        sum += block[j * block_dim + local_row] * r_block[j];
+    }
+    z[row] = sum;
+}
+
+//! result += a^T b (the result must be zero-initialized)
+__global__ void dot_kernel(const int n, const double* __restrict__ a, const double* __restrict__ b, double* result) {
+    __shared__ double cache[num_threads_per_block];
+
+    double sum = 0.0;
+    for (int i = blockIdx.x * blockDim.x + threadIdx.x; i < n; i += blockDim.x * gridDim.x) {
+        sum += a[i] * b[i];
+    }
+    cache[threadIdx.x] = sum;
+    __syncthreads();
+
+    for (int stride = blockDim.x / 2; 0 < stride; stride /= 2) {
+        if (threadIdx.x < stride) {
+            cache[threadIdx.x] += cache[threadIdx.x + stride];
+        }
+        __syncthreads();
+    }
+
+    if (threadIdx.x == 0) {
+        atomicAdd(result, cache[0]);
+    }
+}
+
+//! x += alpha p, r -= alpha q
+__global__ void update_solution_kernel(const int n, const double alpha,
+                                       const double* __restrict__ p, const double* __restrict__ q,
+                                       double* __restrict__ x, double* __restrict__ r) {
+    const int i = blockIdx.x * blockDim.x + threadIdx.x;
+    if (n <= i) {
+        return;
+    }
+    x[i] += alpha * p[i];
+    r[i] -= alpha * q[i];
+}
+
+//! p = z + beta p
+__global__ void update_direction_kernel(const int n, const double beta,
+                                        const double* __restrict__ z, double* __restrict__ p) {
+    const int i = blockIdx.x * blockDim.x + threadIdx.x;
+    if (n <= i) {
+        return;
+    }
+    p[i] = z[i] + beta * p[i];
+}
+
+} // namespace
+
+struct cuda_pcg::impl {
+    //! compute a^T b on the device, then copy it to the host
+    double dot(const int n, const double* a, const double* b) {
+        check_cuda_error(cudaMemset(scalar_.get(), 0, sizeof(double)), "cudaMemset");
+        const unsigned int num_blocks = std::min<unsigned int>(get_num_blocks(n), max_num_blocks_of_reduction);
+        dot_kernel<<<num_blocks, num_threads_per_block>>>(n, a, b, scalar_.get());
+        check_cuda_error(cudaGetLastError(), "dot_kernel");
+        double result = 0.0;
+        check_cuda_error(cudaMemcpy(&result, scalar_.get(), sizeof(double), cudaMemcpyDeviceToHost), "cudaMemcpy");
+        return result;
+    }
+
+    device_buffer<int> row_ptrs_;
+    device_buffer<int> col_idxs_;
+    device_buffer<double> block_values_;
+    device_buffer<double> inv_diag_blocks_;
+    device_buffer<double> b_;
+    device_buffer<double> x_;
+    device_buffer<double> r_;
+    device_buffer<double> z_;
+    device_buffer<double> p_;
+    device_buffer<double> q_;
+    device_buffer<double> scalar_;
+};
+
+cuda_pcg::cuda_pcg(const unsigned int max_num_iter, const double tolerance)
+    : impl_(new impl()), max_num_iter_(max_num_iter), tolerance_(tolerance) {}
+
+cuda_pcg::~cuda_pcg() = default;
+
+unsigned int cuda_pcg::solve(const unsigned int block_dim,
+                             const std::vector<int>& row_ptrs, const std::vector<int>& col_idxs,
+                             const std::vector<double>& block_values, const std::vector<double>& inv_diag_blocks,
+                             const std::vector<double>& b, std::vector<double>& x) {
+    const int n = static_cast<int>(b.size());
+    x.assign(n, 0.0);
+    if (n == 0) {
+        return 0;
+    }
+
+    auto& d = *impl_;
+    d.row_ptrs_.upload(row_ptrs);
+    d.col_idxs_.upload(col_idxs);
+    d.block_values_.upload(block_values);
+    d.inv_diag_blocks_.upload(inv_diag_blocks);
+    d.b_.upload(b);
+    // x = 0, r = b
+    d.x_.upload(x);
+    d.r_.upload(b);
+    d.z_.resize(n);
+    d.p_.resize(n);
+    d.q_.resize(n);
+    d.scalar_.resize(1);
+
+    const unsigned int num_blocks = get_num_blocks(n);
+    const int bdim = static_cast<int>(block_dim);
+
+    const double b_sq_norm = d.dot(n, d.b_.get(), d.b_.get());
+    if (b_sq_norm == 0.0) {
+        return 0;
+    }
+    const double threshold = tolerance_ * tolerance_ * b_sq_norm;
+
+    // z = M^-1 r, p = z
+    block_jacobi_kernel<<<num_blocks, num_threads_per_block>>>(bdim, n, d.inv_diag_blocks_.get(), d.r_.get(), d.z_.get());
+    check_cuda_error(cudaGetLastError(), "block_jacobi_kernel");
+    check_cuda_error(cudaMemcpy(d.p_.get(), d.z_.get(), n * sizeof(double), cudaMemcpyDeviceToDevice), "cudaMemcpy");
+    double rz = d.dot(n, d.r_.get(), d.z_.get());
+
+    const unsigned int max_num_iter = (max_num_iter_ == 0) ? static_cast<unsigned int>(n) : max_num_iter_;
+    unsigned int num_iter = 0;
+    while (num_iter < max_num_iter) {
+        ++num_iter;
+
+        // q = A p
+        bsr_spmv_kernel<<<num_blocks, num_threads_per_block>>>(bdim, n, d.row_ptrs_.get(), d.col_idxs_.get(),
+                                                               d.block_values_.get(), d.p_.get(), d.q_.get());
+        check_cuda_error(cudaGetLastError(), "bsr_spmv_kernel");
+
+        const double pq = d.dot(n, d.p_.get(), d.q_.get());
+        if (pq <= 0.0) {
+            break;
+        }
+        const double alpha = rz / pq;
+        update_solution_kernel<<<num_blocks, num_threads_per_block>>>(n, alpha, d.p_.get(), d.q_.get(), d.x_.get(), d.r_.get());
+        check_cuda_error(cudaGetLastError(), "update_solution_kernel");
+
+        if (d.dot(n, d.r_.get(), d.r_.get()) <= threshold) {
+            break;
+        }
+
+        block_jacobi_kernel<<<num_blocks, num_threads_per_block>>>(bdim, n, d.inv_diag_blocks_.get(), d.r_.get(), d.z_.get());
+        check_cuda_error(cudaGetLastError(), "block_jacobi_kernel");
+        const double rz_new = d.dot(n, d.r_.get(), d.z_.get());
+        const double beta = rz_new / rz;
+        rz = rz_new;
+        update_direction_kernel<<<num_blocks, num_threads_per_block>>>(n, beta, d.z_.get(), d.p_.get());
+        check_cuda_error(cudaGetLastError(), "update_direction_kernel");
+    }
+
+    d.x_.download(x);
+    return num_iter;
+}
+
+} // namespace internal
+} // namespace optimize
+} // namespace stella_vslam
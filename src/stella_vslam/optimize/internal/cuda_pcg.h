@@ -0,0 +1,61 @@
+#ifndef STELLA_VSLAM_OPTIMIZE_G2O_CUDA_PCG_H
+#define STELLA_VSLAM_OPTIMIZE_G2O_CUDA_PCG_H
+
+#include <memory>
+#include <vector>
+
+namespace stella_vslam {
+namespace optimize {
+namespace internal {
+
+/**
+ * Preconditioned conjugate gradient on the GPU for a symmetric block-sparse system
+ * (block-Jacobi preconditioner, the same iteration as g2o::LinearSolverPCG)
+ * The device buffers are kept across the calls and grown as needed.
+ * (NOTE: available only when built with USE_CUDA_BA)
+ */
+class cuda_pcg {
+public:
+    /**
+     * Constructor
+     * @param max_num_iter maximum number of iterations (0: the dimension of the system)
+     * @param tolerance relative tolerance of the residual norm to the norm of the right-hand side
+     */
+    explicit cuda_pcg(const unsigned int max_num_iter = 0, const double tolerance = 1e-6);
+
+    /**
+     * Destructor
+     */
+    ~cuda_pcg();
+
+    /**
+     * Solve A x = b, where A is given in the block compressed sparse row format with both triangles
+     * (throw std::runtime_error if any of the CUDA calls fails)
+     * @param block_dim dimension of the square blocks
+     * @param row_ptrs offsets of the block rows in col_idxs (the number of the block rows + 1)
+     * @param col_idxs column indices of the blocks
+     * @param block_values column-major blocks in the order of col_idxs
+     * @param inv_diag_blocks column-major inverse of the diagonal blocks (the preconditioner)
+     * @param b right-hand side
+     * @param x solution (starts from zero)
+     * @return the number of iterations
+     */
+    unsigned int solve(const unsigned int block_dim,
+                       const std::vector<int>& row_ptrs, const std::vector<int>& col_idxs,
+                       const std::vector<double>& block_values, const std::vector<double>& inv_diag_blocks,
+                       const std::vector<double>& b, std::vector<double>& x);
+
+private:
+    //! device buffers
+    struct impl;
+    std::unique_ptr<impl> impl_;
+
+    const unsigned int max_num_iter_;
+    const double tolerance_;
+};
+
+} // namespace internal
+} // namespace optimize
+} // namespace stella_vslam
+
+#endif // STELLA_VSLAM_OPTIMIZE_G2O_CUDA_PCG_H
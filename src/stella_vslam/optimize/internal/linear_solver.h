@@ -0,0 +1,63 @@
+#ifndef STELLA_VSLAM_OPTIMIZE_G2O_LINEAR_SOLVER_H
+#define STELLA_VSLAM_OPTIMIZE_G2O_LINEAR_SOLVER_H
+
+#include "stella_vslam/optimize/linear_solver_type.h"
+
+#include <memory>
+#include <stdexcept>
+
+#include <g2o/core/linear_solver.h>
+#include <g2o/solvers/eigen/linear_solver_eigen.h>
+#include <g2o/solvers/csparse/linear_solver_csparse.h>
+#include <g2o/solvers/dense/linear_solver_dense.h>
+#include <g2o/solvers/pcg/linear_solver_pcg.h>
+#ifdef USE_G2O_CHOLMOD
+#include <g2o/solvers/cholmod/linear_solver_cholmod.h>
+#endif
+#ifdef USE_CUDA_BA
+#include "stella_vslam/optimize/internal/linear_solver_cuda_pcg.h"
+#endif
+
+namespace stella_vslam {
+namespace optimize {
+namespace internal {
+
+/**
+ * Create the linear solver of the block solver
+ * @tparam BlockSolver g2o block solver (e.g. g2o::BlockSolver_6_3)
+ * @param linear_solver_type
+ * @return linear solver for the pose matrix of the block solver
+ */
+template<typename BlockSolver>
+std::unique_ptr<g2o::LinearSolver<typename BlockSolver::PoseMatrixType>> create_linear_solver(const linear_solver_type_t linear_solver_type) {
+    using pose_matrix_t = typename BlockSolver::PoseMatrixType;
+    switch (linear_solver_type) {
+        case linear_solver_type_t::Eigen:
+            return std::unique_ptr<g2o::LinearSolver<pose_matrix_t>>(new g2o::LinearSolverEigen<pose_matrix_t>());
+        case linear_solver_type_t::CSparse:
+            return std::unique_ptr<g2o::LinearSolver<pose_matrix_t>>(new g2o::LinearSolverCSparse<pose_matrix_t>());
+        case linear_solver_type_t::Dense:
+            return std::unique_ptr<g2o::LinearSolver<pose_matrix_t>>(new g2o::LinearSolverDense<pose_matrix_t>());
+        case linear_solver_type_t::PCG:
+            return std::unique_ptr<g2o::LinearSolver<pose_matrix_t>>(new g2o::LinearSolverPCG<pose_matrix_t>());
+        case linear_solver_type_t::CHOLMOD:
+#ifdef USE_G2O_CHOLMOD
+            return std::unique_ptr<g2o::LinearSolver<pose_matrix_t>>(new g2o::LinearSolverCholmod<pose_matrix_t>());
+#else
+            throw std::runtime_error("Linear solver type cholmod is not available (build with USE_G2O_CHOLMOD)");
+#endif
+        case linear_solver_type_t::CUDA_PCG:
+#ifdef USE_CUDA_BA
+            return std::unique_ptr<g2o::LinearSolver<pose_matrix_t>>(new linear_solver_cuda_pcg<pose_matrix_t>());
+#else
+            throw std::runtime_error("Linear solver type cuda_pcg is not available (build with USE_CUDA_BA)");
+#endif
+    }
+    throw std::runtime_error("Invalid linear solver type");
+}
+
+} // namespace internal
+} // namespace optimize
+} // namespace stella_vslam
+
+#endif // STELLA_VSLAM_OPTIMIZE_G2O_LINEAR_SOLVER_H
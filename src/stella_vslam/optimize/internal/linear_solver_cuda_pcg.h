@@ -0,0 +1,150 @@
+#ifndef STELLA_VSLAM_OPTIMIZE_G2O_LINEAR_SOLVER_CUDA_PCG_H
+#define STELLA_VSLAM_OPTIMIZE_G2O_LINEAR_SOLVER_CUDA_PCG_H
+
+#include "stella_vslam/optimize/internal/cuda_pcg.h"
+
+#include <algorithm>
+#include <exception>
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/LU>
+#include <g2o/core/linear_solver.h>
+#include <g2o/core/sparse_block_matrix.h>
+
+#include <spdlog/spdlog.h>
+
+namespace stella_vslam {
+namespace optimize {
+namespace internal {
+
+/**
+ * Linear solver of g2o which solves the reduced camera system with cuda_pcg
+ * (the Hessian and the Schur complement are still built by the block solver on the CPU with the existing edges)
+ */
+template<typename MatrixType>
+class linear_solver_cuda_pcg : public g2o::LinearSolver<MatrixType> {
+public:
+    linear_solver_cuda_pcg() = default;
+
+    ~linear_solver_cuda_pcg() override = default;
+
+    bool init() override {
+        return true;
+    }
+
+    bool solve(const g2o::SparseBlockMatrix<MatrixType>& A, g2o::number_t* x, g2o::number_t* b) override;
+
+private:
+    //! Convert the upper triangular blocks of A to the block compressed sparse row format with both triangles
+    bool convert(const g2o::SparseBlockMatrix<MatrixType>& A);
+
+    cuda_pcg pcg_;
+
+    //! buffers reused across the calls
+    unsigned int block_dim_ = 0;
+    std::vector<int> row_ptrs_;
+    std::vector<int> col_idxs_;
+    std::vector<double> block_values_;
+    std::vector<double> inv_diag_blocks_;
+    std::vector<double> b_;
+    std::vector<double> x_;
+};
+
+template<typename MatrixType>
+bool linear_solver_cuda_pcg<MatrixType>::solve(const g2o::SparseBlockMatrix<MatrixType>& A, g2o::number_t* x, g2o::number_t* b) {
+    if (!convert(A)) {
+        spdlog::error("linear_solver_cuda_pcg: the blocks of the reduced camera system must be square with the same size");
+        return false;
+    }
+
+    const auto dim = static_cast<unsigned int>(A.rows());
+    b_.assign(b, b + dim);
+    try {
+        pcg_.solve(block_dim_, row_ptrs_, col_idxs_, block_values_, inv_diag_blocks_, b_, x_);
+    }
+    catch (const std::exception& e) {
+        spdlog::error("linear_solver_cuda_pcg: {}", e.what());
+        return false;
+    }
+    std::copy(x_.begin(), x_.end(), x);
+    return true;
+}
+
+template<typename MatrixType>
+bool linear_solver_cuda_pcg<MatrixType>::convert(const g2o::SparseBlockMatrix<MatrixType>& A) {
+    const auto& block_cols = A.blockCols();
+    const auto num_blocks = static_cast<int>(block_cols.size());
+    if (num_blocks == 0) {
+        return false;
+    }
+    block_dim_ = A.colsOfBlock(0);
+    for (int c = 0; c < num_blocks; ++c) {
+        if (static_cast<unsigned int>(A.colsOfBlock(c)) != block_dim_ || static_cast<unsigned int>(A.rowsOfBlock(c)) != block_dim_) {
+            return false;
+        }
+    }
+    const unsigned int block_size = block_dim_ * block_dim_;
+
+    // Count the blocks of each row (the lower triangle is the transpose of the stored upper one)
+    row_ptrs_.assign(num_blocks + 1, 0);
+    for (int c = 0; c < num_blocks; ++c) {
+        for (const auto& row_block : block_cols.at(c)) {
+            const int r = row_block.first;
+            ++row_ptrs_.at(r + 1);
+            if (r != c) {
+                ++row_ptrs_.at(c + 1);
+            }
+        }
+    }
+    for (int r = 0; r < num_blocks; ++r) {
+        row_ptrs_.at(r + 1) += row_ptrs_.at(r);
+    }
+
+    const int num_nonzero_blocks = row_ptrs_.at(num_blocks);
+    col_idxs_.resize(num_nonzero_blocks);
+    block_values_.resize(static_cast<size_t>(num_nonzero_blocks) * block_size);
+    // The identity is used as the preconditioner of the missing or singular diagonal blocks
+    inv_diag_blocks_.assign(static_cast<size_t>(num_blocks) * block_size, 0.0);
+    for (int r = 0; r < num_blocks; ++r) {
+        for (unsigned int i = 0; i < block_dim_; ++i) {
+            inv_diag_blocks_.at(r * block_size + i * block_dim_ + i) = 1.0;
+        }
+    }
+
+    // Fill the blocks (column-major)
+    std::vector<int> next(row_ptrs_.begin(), row_ptrs_.end() - 1);
+    for (int c = 0; c < num_blocks; ++c) {
+        for (const auto& row_block : block_cols.at(c)) {
+            const int r = row_block.first;
+            const auto& block = *row_block.second;
+
+            const int k = next.at(r)++;
+            col_idxs_.at(k) = c;
+            Eigen::Map<Eigen::MatrixXd>(block_values_.data() + static_cast<size_t>(k) * block_size, block_dim_, block_dim_)
+                = block.template cast<double>();
+
+            if (r != c) {
+                const int k_t = next.at(c)++;
+                col_idxs_.at(k_t) = r;
+                Eigen::Map<Eigen::MatrixXd>(block_values_.data() + static_cast<size_t>(k_t) * block_size, block_dim_, block_dim_)
+                    = block.transpose().template cast<double>();
+            }
+            else {
+                const Eigen::FullPivLU<Eigen::MatrixXd> lu(block.template cast<double>());
+                if (lu.isInvertible()) {
+                    Eigen::Map<Eigen::MatrixXd>(inv_diag_blocks_.data() + static_cast<size_t>(r) * block_size, block_dim_, block_dim_)
+                        = lu.inverse();
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+} // namespace internal
+} // namespace optimize
+} // namespace stella_vslam
+
+#endif // STELLA_VSLAM_OPTIMIZE_G2O_LINEAR_SOLVER_CUDA_PCG_H
@@ -80,51 +80,20 @@ inline void equirectangular_reproj_edge::linearizeOplus() {
     const auto pcx = pos_c(0);
     const auto pcy = pos_c(1);
     const auto pcz = pos_c(2);
-    const auto L = pos_c.norm();
-
-    // 回転に対する微分
-    const Vec3_t d_pc_d_rx(0, -pcz, pcy);
-    const Vec3_t d_pc_d_ry(pcz, 0, -pcx);
-    const Vec3_t d_pc_d_rz(-pcy, pcx, 0);
-    // 並進に対する微分
-    const Vec3_t d_pc_d_tx(1, 0, 0);
-    const Vec3_t d_pc_d_ty(0, 1, 0);
-    const Vec3_t d_pc_d_tz(0, 0, 1);
-    // 3次元点に対する微分
-    const Vec3_t d_pc_d_pwx = rot_cw.block<3, 1>(0, 0);
-    const Vec3_t d_pc_d_pwy = rot_cw.block<3, 1>(0, 1);
-    const Vec3_t d_pc_d_pwz = rot_cw.block<3, 1>(0, 2);
-
-    // 状態ベクトルを x = [rx, ry, rz, tx, ty, tz, pwx, pwy, pwz] として，
-    // 導関数ベクトル d_pcx_d_x, d_pcy_d_x, d_pcz_d_x を作成
-    VecR_t<9> d_pcx_d_x;
-    d_pcx_d_x << d_pc_d_rx(0), d_pc_d_ry(0), d_pc_d_rz(0),
-        d_pc_d_tx(0), d_pc_d_ty(0), d_pc_d_tz(0),
-        d_pc_d_pwx(0), d_pc_d_pwy(0), d_pc_d_pwz(0);
-    VecR_t<9> d_pcy_d_x;
-    d_pcy_d_x << d_pc_d_rx(1), d_pc_d_ry(1), d_pc_d_rz(1),
-        d_pc_d_tx(1), d_pc_d_ty(1), d_pc_d_tz(1),
-        d_pc_d_pwx(1), d_pc_d_pwy(1), d_pc_d_pwz(1);
-    VecR_t<9> d_pcz_d_x;
-    d_pcz_d_x << d_pc_d_rx(2), d_pc_d_ry(2), d_pc_d_rz(2),
-        d_pc_d_tx(2), d_pc_d_ty(2), d_pc_d_tz(2),
-        d_pc_d_pwx(2), d_pc_d_pwy(2), d_pc_d_pwz(2);
-
-    // 導関数ベクトル d_L_d_x を作成
-    const VecR_t<9> d_L_d_x = (1.0 / L) * (pcx * d_pcx_d_x + pcy * d_pcy_d_x + pcz * d_pcz_d_x);
-
-    // ヤコビ行列を作成
-    MatRC_t<2, 9> jacobian = MatRC_t<2, 9>::Zero();
-    jacobian.block<1, 9>(0, 0) = -(cols_ / (2 * M_PI)) * (1.0 / (pcx * pcx + pcz * pcz))
-                                 * (pcz * d_pcx_d_x - pcx * d_pcz_d_x);
-    jacobian.block<1, 9>(1, 0) = -(rows_ / M_PI) * (1.0 / (L * std::sqrt(pcx * pcx + pcz * pcz)))
-                                 * (L * d_pcy_d_x - pcy * d_L_d_x);
-
-    // g2oの変数にセット
-    // 3次元点に対する微分
-    _jacobianOplusXi = jacobian.block<2, 3>(0, 6);
-    // 姿勢に対する微分
-    _jacobianOplusXj = jacobian.block<2, 6>(0, 0);
+    const auto xz_sq = pcx * pcx + pcz * pcz;
+    const auto L_sq = xz_sq + pcy * pcy;
+
+    // Jacobian of the projection w.r.t. the point in the camera coordinates
+    const auto u_coeff = (cols_ / (2 * M_PI)) / xz_sq;
+    const auto v_coeff = (rows_ / M_PI) / (L_sq * std::sqrt(xz_sq));
+    MatRC_t<2, 3> proj_jac;
+    proj_jac << u_coeff * pcz, 0.0, -u_coeff * pcx,
+        -v_coeff * pcx * pcy, v_coeff * xz_sq, -v_coeff * pcy * pcz;
+
+    // error = obs - proj(exp(xi) * cam_pose_cw * pos_w), xi = [rotation, translation]
+    _jacobianOplusXi = -proj_jac * rot_cw;
+    _jacobianOplusXj.block<2, 3>(0, 0) = proj_jac * g2o::skew(pos_c);
+    _jacobianOplusXj.block<2, 3>(0, 3) = -proj_jac;
 }
 
 inline Vec2_t equirectangular_reproj_edge::cam_project(const Vec3_t& pos_c) const {
@@ -81,32 +81,20 @@ inline void mono_perspective_reproj_edge::linearizeOplus() {
 
     const auto x = pos_c(0);
     const auto y = pos_c(1);
-    const auto z = pos_c(2);
-    const auto z_sq = z * z;
+    const auto inv_z = 1.0 / pos_c(2);
+    const auto inv_z_sq = inv_z * inv_z;
 
     const Mat33_t rot_cw = cam_pose_cw.rotation().toRotationMatrix();
 
-    _jacobianOplusXi(0, 0) = -fx_ * rot_cw(0, 0) / z + fx_ * x * rot_cw(2, 0) / z_sq;
-    _jacobianOplusXi(0, 1) = -fx_ * rot_cw(0, 1) / z + fx_ * x * rot_cw(2, 1) / z_sq;
-    _jacobianOplusXi(0, 2) = -fx_ * rot_cw(0, 2) / z + fx_ * x * rot_cw(2, 2) / z_sq;
-
-    _jacobianOplusXi(1, 0) = -fy_ * rot_cw(1, 0) / z + fy_ * y * rot_cw(2, 0) / z_sq;
-    _jacobianOplusXi(1, 1) = -fy_ * rot_cw(1, 1) / z + fy_ * y * rot_cw(2, 1) / z_sq;
-    _jacobianOplusXi(1, 2) = -fy_ * rot_cw(1, 2) / z + fy_ * y * rot_cw(2, 2) / z_sq;
-
-    _jacobianOplusXj(0, 0) = x * y / z_sq * fx_;
-    _jacobianOplusXj(0, 1) = -(1.0 + (x * x / z_sq)) * fx_;
-    _jacobianOplusXj(0, 2) = y / z * fx_;
-    _jacobianOplusXj(0, 3) = -1.0 / z * fx_;
-    _jacobianOplusXj(0, 4) = 0.0;
-    _jacobianOplusXj(0, 5) = x / z_sq * fx_;
-
-    _jacobianOplusXj(1, 0) = (1.0 + y * y / z_sq) * fy_;
-    _jacobianOplusXj(1, 1) = -x * y / z_sq * fy_;
-    _jacobianOplusXj(1, 2) = -x / z * fy_;
-    _jacobianOplusXj(1, 3) = 0.0;
-    _jacobianOplusXj(1, 4) = -1.0 / z * fy_;
-    _jacobianOplusXj(1, 5) = y / z_sq * fy_;
+    // Jacobian of the projection w.r.t. the point in the camera coordinates
+    MatRC_t<2, 3> proj_jac;
+    proj_jac << fx_ * inv_z, 0.0, -fx_ * x * inv_z_sq,
+        0.0, fy_ * inv_z, -fy_ * y * inv_z_sq;
+
+    // error = obs - proj(exp(xi) * cam_pose_cw * pos_w), xi = [rotation, translation]
+    _jacobianOplusXi = -proj_jac * rot_cw;
+    _jacobianOplusXj.block<2, 3>(0, 0) = proj_jac * g2o::skew(pos_c);
+    _jacobianOplusXj.block<2, 3>(0, 3) = -proj_jac;
 }
 
 inline bool mono_perspective_reproj_edge::depth_is_positive() const {
@@ -187,43 +175,21 @@ inline void stereo_perspective_reproj_edge::linearizeOplus() {
 
     const auto x = pos_c(0);
     const auto y = pos_c(1);
-    const auto z = pos_c(2);
-    const auto z_sq = z * z;
+    const auto inv_z = 1.0 / pos_c(2);
+    const auto inv_z_sq = inv_z * inv_z;
 
     const Mat33_t rot_cw = cam_pose_cw.rotation().toRotationMatrix();
 
-    _jacobianOplusXi(0, 0) = -fx_ * rot_cw(0, 0) / z + fx_ * x * rot_cw(2, 0) / z_sq;
-    _jacobianOplusXi(0, 1) = -fx_ * rot_cw(0, 1) / z + fx_ * x * rot_cw(2, 1) / z_sq;
-    _jacobianOplusXi(0, 2) = -fx_ * rot_cw(0, 2) / z + fx_ * x * rot_cw(2, 2) / z_sq;
-
-    _jacobianOplusXi(1, 0) = -fy_ * rot_cw(1, 0) / z + fy_ * y * rot_cw(2, 0) / z_sq;
-    _jacobianOplusXi(1, 1) = -fy_ * rot_cw(1, 1) / z + fy_ * y * rot_cw(2, 1) / z_sq;
-    _jacobianOplusXi(1, 2) = -fy_ * rot_cw(1, 2) / z + fy_ * y * rot_cw(2, 2) / z_sq;
-
-    _jacobianOplusXi(2, 0) = _jacobianOplusXi(0, 0) - focal_x_baseline_ * rot_cw(2, 0) / z_sq;
-    _jacobianOplusXi(2, 1) = _jacobianOplusXi(0, 1) - focal_x_baseline_ * rot_cw(2, 1) / z_sq;
-    _jacobianOplusXi(2, 2) = _jacobianOplusXi(0, 2) - focal_x_baseline_ * rot_cw(2, 2) / z_sq;
-
-    _jacobianOplusXj(0, 0) = x * y / z_sq * fx_;
-    _jacobianOplusXj(0, 1) = -(1.0 + (x * x / z_sq)) * fx_;
-    _jacobianOplusXj(0, 2) = y / z * fx_;
-    _jacobianOplusXj(0, 3) = -1.0 / z * fx_;
-    _jacobianOplusXj(0, 4) = 0.0;
-    _jacobianOplusXj(0, 5) = x / z_sq * fx_;
-
-    _jacobianOplusXj(1, 0) = (1.0 + y * y / z_sq) * fy_;
-    _jacobianOplusXj(1, 1) = -x * y / z_sq * fy_;
-    _jacobianOplusXj(1, 2) = -x / z * fy_;
-    _jacobianOplusXj(1, 3) = 0.0;
-    _jacobianOplusXj(1, 4) = -1.0 / z * fy_;
-    _jacobianOplusXj(1, 5) = y / z_sq * fy_;
-
-    _jacobianOplusXj(2, 0) = _jacobianOplusXj(0, 0) - focal_x_baseline_ * y / z_sq;
-    _jacobianOplusXj(2, 1) = _jacobianOplusXj(0, 1) + focal_x_baseline_ * x / z_sq;
-    _jacobianOplusXj(2, 2) = _jacobianOplusXj(0, 2);
-    _jacobianOplusXj(2, 3) = _jacobianOplusXj(0, 3);
-    _jacobianOplusXj(2, 4) = 0;
-    _jacobianOplusXj(2, 5) = _jacobianOplusXj(0, 5) - focal_x_baseline_ / z_sq;
+    // Jacobian of the projection w.r.t. the point in the camera coordinates
+    Mat33_t proj_jac;
+    proj_jac << fx_ * inv_z, 0.0, -fx_ * x * inv_z_sq,
+        0.0, fy_ * inv_z, -fy_ * y * inv_z_sq,
+        fx_ * inv_z, 0.0, (focal_x_baseline_ - fx_ * x) * inv_z_sq;
+
+    // error = obs - proj(exp(xi) * cam_pose_cw * pos_w), xi = [rotation, translation]
+    _jacobianOplusXi = -proj_jac * rot_cw;
+    _jacobianOplusXj.block<3, 3>(0, 0) = proj_jac * g2o::skew(pos_c);
+    _jacobianOplusXj.block<3, 3>(0, 3) = -proj_jac;
 }
 
 inline bool stereo_perspective_reproj_edge::depth_is_positive() const {
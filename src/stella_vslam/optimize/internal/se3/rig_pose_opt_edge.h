@@ -0,0 +1,119 @@
+#ifndef STELLA_VSLAM_OPTIMIZER_G2O_SE3_RIG_POSE_OPT_EDGE_H
+#define STELLA_VSLAM_OPTIMIZER_G2O_SE3_RIG_POSE_OPT_EDGE_H
+
+#include "stella_vslam/type.h"
+#include "stella_vslam/optimize/internal/se3/shot_vertex.h"
+
+#include <g2o/core/base_unary_edge.h>
+
+namespace stella_vslam {
+namespace optimize {
+namespace internal {
+namespace se3 {
+
+/**
+ * Reprojection edge of an auxiliary camera of the multi-camera rig
+ * The vertex is the pose of the primary camera, and the observation is projected with the extrinsics of the auxiliary camera
+ * (perspective-like models)
+ */
+class mono_rig_pose_opt_edge final : public g2o::BaseUnaryEdge<2, Vec2_t, shot_vertex> {
+public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    mono_rig_pose_opt_edge();
+
+    bool read(std::istream& is) override;
+
+    bool write(std::ostream& os) const override;
+
+    void computeError() override;
+
+    void linearizeOplus() override;
+
+    bool depth_is_positive() const;
+
+    Vec2_t cam_project(const Vec3_t& pos_c) const;
+
+    Vec3_t pos_w_;
+    //! rotation and translation of the auxiliary camera: primary camera -> auxiliary camera
+    Mat33_t rot_cb_;
+    Vec3_t trans_cb_;
+    number_t fx_, fy_, cx_, cy_;
+};
+
+inline mono_rig_pose_opt_edge::mono_rig_pose_opt_edge()
+    : g2o::BaseUnaryEdge<2, Vec2_t, shot_vertex>() {}
+
+inline bool mono_rig_pose_opt_edge::read(std::istream& is) {
+    for (unsigned int i = 0; i < 2; ++i) {
+        is >> _measurement(i);
+    }
+    for (int i = 0; i < information().rows(); ++i) {
+        for (int j = i; j < information().cols(); ++j) {
+            is >> information()(i, j);
+            if (i != j) {
+                information()(j, i) = information()(i, j);
+            }
+        }
+    }
+    return true;
+}
+
+inline bool mono_rig_pose_opt_edge::write(std::ostream& os) const {
+    for (unsigned int i = 0; i < 2; ++i) {
+        os << measurement()(i) << " ";
+    }
+    for (int i = 0; i < information().rows(); ++i) {
+        for (int j = i; j < information().cols(); ++j) {
+            os << " " << information()(i, j);
+        }
+    }
+    return os.good();
+}
+
+inline void mono_rig_pose_opt_edge::computeError() {
+    const auto v1 = static_cast<const shot_vertex*>(_vertices.at(0));
+    const Vec2_t obs(_measurement);
+    _error = obs - cam_project(rot_cb_ * v1->estimate().map(pos_w_) + trans_cb_);
+}
+
+inline void mono_rig_pose_opt_edge::linearizeOplus() {
+    auto vi = static_cast<shot_vertex*>(_vertices.at(0));
+    const g2o::SE3Quat& cam_pose_bw = vi->shot_vertex::estimate();
+    const Vec3_t pos_b = cam_pose_bw.map(pos_w_);
+    const Vec3_t pos_c = rot_cb_ * pos_b + trans_cb_;
+
+    const auto x = pos_c(0);
+    const auto y = pos_c(1);
+    const auto z = pos_c(2);
+    const auto z_sq = z * z;
+
+    // derivative of the projection
+    Eigen::Matrix<number_t, 2, 3> proj_jacobian;
+    proj_jacobian << fx_ / z, 0.0, -x / z_sq * fx_,
+        0.0, fy_ / z, -y / z_sq * fy_;
+
+    // derivative of the point in the primary camera w.r.t. the update [rotation, translation] (left multiplication)
+    Eigen::Matrix<number_t, 3, 6> pos_b_jacobian;
+    pos_b_jacobian << 0.0, pos_b(2), -pos_b(1), 1.0, 0.0, 0.0,
+        -pos_b(2), 0.0, pos_b(0), 0.0, 1.0, 0.0,
+        pos_b(1), -pos_b(0), 0.0, 0.0, 0.0, 1.0;
+
+    _jacobianOplusXi = -proj_jacobian * rot_cb_ * pos_b_jacobian;
+}
+
+inline bool mono_rig_pose_opt_edge::depth_is_positive() const {
+    const auto v1 = static_cast<const shot_vertex*>(_vertices.at(0));
+    return 0 < (rot_cb_ * v1->estimate().map(pos_w_) + trans_cb_)(2);
+}
+
+inline Vec2_t mono_rig_pose_opt_edge::cam_project(const Vec3_t& pos_c) const {
+    return {fx_ * pos_c(0) / pos_c(2) + cx_, fy_ * pos_c(1) / pos_c(2) + cy_};
+}
+
+} // namespace se3
+} // namespace internal
+} // namespace optimize
+} // namespace stella_vslam
+
+#endif // STELLA_VSLAM_OPTIMIZER_G2O_SE3_RIG_POSE_OPT_EDGE_H
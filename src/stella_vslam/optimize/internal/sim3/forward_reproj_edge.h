@@ -23,8 +23,13 @@ public:
 
     void computeError() final;
 
+    void linearizeOplus() final;
+
     virtual Vec2_t cam_project(const Vec3_t& pos_c) const = 0;
 
+    //! Jacobian of cam_project() w.r.t. the point in the camera coordinates
+    virtual MatRC_t<2, 3> cam_project_jacobian(const Vec3_t& pos_c) const = 0;
+
     Vec3_t pos_w_;
 };
 
@@ -75,6 +80,24 @@ inline void base_forward_reproj_edge::computeError() {
     _error = obs - cam_project(pos_1);
 }
 
+inline void base_forward_reproj_edge::linearizeOplus() {
+    const auto v1 = static_cast<const transform_vertex*>(_vertices.at(0));
+    const g2o::Sim3& Sim3_12 = v1->estimate();
+    const Vec3_t pos_2 = v1->rot_2w_ * pos_w_ + v1->trans_2w_;
+    const Vec3_t pos_1 = Sim3_12.map(pos_2);
+
+    // error = obs - proj(exp(delta) * Sim3_12 * pos_2), delta = [rotation, translation, scale]
+    const MatRC_t<2, 3> proj_jac = cam_project_jacobian(pos_1);
+    _jacobianOplusXi.block<2, 3>(0, 0) = proj_jac * g2o::skew(pos_1);
+    _jacobianOplusXi.block<2, 3>(0, 3) = -proj_jac;
+    if (v1->fix_scale_) {
+        _jacobianOplusXi.block<2, 1>(0, 6).setZero();
+    }
+    else {
+        _jacobianOplusXi.block<2, 1>(0, 6) = -proj_jac * pos_1;
+    }
+}
+
 class perspective_forward_reproj_edge final : public base_forward_reproj_edge {
 public:
     EIGEN_MAKE_ALIGNED_OPERATOR_NEW
@@ -83,6 +106,8 @@ public:
 
     Vec2_t cam_project(const Vec3_t& pos_c) const override;
 
+    MatRC_t<2, 3> cam_project_jacobian(const Vec3_t& pos_c) const override;
+
     double fx_, fy_, cx_, cy_;
 };
 
@@ -93,6 +118,14 @@ inline Vec2_t perspective_forward_reproj_edge::cam_project(const Vec3_t& pos_c)
     return {fx_ * pos_c(0) / pos_c(2) + cx_, fy_ * pos_c(1) / pos_c(2) + cy_};
 }
 
+inline MatRC_t<2, 3> perspective_forward_reproj_edge::cam_project_jacobian(const Vec3_t& pos_c) const {
+    const auto inv_z = 1.0 / pos_c(2);
+    MatRC_t<2, 3> proj_jac;
+    proj_jac << fx_ * inv_z, 0.0, -fx_ * pos_c(0) * inv_z * inv_z,
+        0.0, fy_ * inv_z, -fy_ * pos_c(1) * inv_z * inv_z;
+    return proj_jac;
+}
+
 class equirectangular_forward_reproj_edge final : public base_forward_reproj_edge {
 public:
     EIGEN_MAKE_ALIGNED_OPERATOR_NEW
@@ -101,6 +134,8 @@ public:
 
     Vec2_t cam_project(const Vec3_t& pos_c) const override;
 
+    MatRC_t<2, 3> cam_project_jacobian(const Vec3_t& pos_c) const override;
+
     double cols_, rows_;
 };
 
@@ -113,6 +148,17 @@ inline Vec2_t equirectangular_forward_reproj_edge::cam_project(const Vec3_t& pos
     return {cols_ * (0.5 + theta / (2 * M_PI)), rows_ * (0.5 - phi / M_PI)};
 }
 
+inline MatRC_t<2, 3> equirectangular_forward_reproj_edge::cam_project_jacobian(const Vec3_t& pos_c) const {
+    const auto xz_sq = pos_c(0) * pos_c(0) + pos_c(2) * pos_c(2);
+    const auto L_sq = xz_sq + pos_c(1) * pos_c(1);
+    const auto u_coeff = (cols_ / (2 * M_PI)) / xz_sq;
+    const auto v_coeff = (rows_ / M_PI) / (L_sq * std::sqrt(xz_sq));
+    MatRC_t<2, 3> proj_jac;
+    proj_jac << u_coeff * pos_c(2), 0.0, -u_coeff * pos_c(0),
+        -v_coeff * pos_c(0) * pos_c(1), v_coeff * xz_sq, -v_coeff * pos_c(1) * pos_c(2);
+    return proj_jac;
+}
+
 } // namespace sim3
 } // namespace internal
 } // namespace optimize
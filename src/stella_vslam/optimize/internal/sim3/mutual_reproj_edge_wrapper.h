@@ -68,7 +68,7 @@ inline mutual_reproj_edge_wapper<T>::mutual_reproj_edge_wapper(const std::shared
                 // 3次元点はkeyfrm_2で観測しているもの，カメラモデルと特徴点はkeyfrm_1のもの
                 auto edge_12 = new internal::sim3::perspective_forward_reproj_edge();
                 // 特徴点情報と再投影誤差分散をセット
-                const auto& undist_keypt_1 = shot1->frm_obs_.undist_keypts_.at(idx1);
+                const auto& undist_keypt_1 = shot1->frm_obs_->undist_keypts_.at(idx1);
                 const Vec2_t obs_1{undist_keypt_1.pt.x, undist_keypt_1.pt.y};
                 const float inv_sigma_sq_1 = shot1->orb_params_->inv_level_sigma_sq_.at(undist_keypt_1.octave);
                 edge_12->setMeasurement(obs_1);
@@ -92,7 +92,7 @@ inline mutual_reproj_edge_wapper<T>::mutual_reproj_edge_wapper(const std::shared
                 // 3次元点はkeyfrm_2で観測しているもの，カメラモデルと特徴点はkeyfrm_1のもの
                 auto edge_12 = new internal::sim3::perspective_forward_reproj_edge();
                 // 特徴点情報と再投影誤差分散をセット
-                const auto& undist_keypt_1 = shot1->frm_obs_.undist_keypts_.at(idx1);
+                const auto& undist_keypt_1 = shot1->frm_obs_->undist_keypts_.at(idx1);
                 const Vec2_t obs_1{undist_keypt_1.pt.x, undist_keypt_1.pt.y};
                 const float inv_sigma_sq_1 = shot1->orb_params_->inv_level_sigma_sq_.at(undist_keypt_1.octave);
                 edge_12->setMeasurement(obs_1);
@@ -116,7 +116,7 @@ inline mutual_reproj_edge_wapper<T>::mutual_reproj_edge_wapper(const std::shared
                 // 3次元点はkeyfrm_2で観測しているもの，カメラモデルと特徴点はkeyfrm_1のもの
                 auto edge_12 = new internal::sim3::equirectangular_forward_reproj_edge();
                 // 特徴点情報と再投影誤差分散をセット
-                const auto& undist_keypt_1 = shot1->frm_obs_.undist_keypts_.at(idx1);
+                const auto& undist_keypt_1 = shot1->frm_obs_->undist_keypts_.at(idx1);
                 const Vec2_t obs_1{undist_keypt_1.pt.x, undist_keypt_1.pt.y};
                 const float inv_sigma_sq_1 = shot1->orb_params_->inv_level_sigma_sq_.at(undist_keypt_1.octave);
                 edge_12->setMeasurement(obs_1);
@@ -138,7 +138,7 @@ inline mutual_reproj_edge_wapper<T>::mutual_reproj_edge_wapper(const std::shared
                 // 3次元点はkeyfrm_2で観測しているもの，カメラモデルと特徴点はkeyfrm_1のもの
                 auto edge_12 = new internal::sim3::perspective_forward_reproj_edge();
                 // 特徴点情報と再投影誤差分散をセット
-                const auto& undist_keypt_1 = shot1->frm_obs_.undist_keypts_.at(idx1);
+                const auto& undist_keypt_1 = shot1->frm_obs_->undist_keypts_.at(idx1);
                 const Vec2_t obs_1{undist_keypt_1.pt.x, undist_keypt_1.pt.y};
                 const float inv_sigma_sq_1 = shot1->orb_params_->inv_level_sigma_sq_.at(undist_keypt_1.octave);
                 edge_12->setMeasurement(obs_1);
@@ -175,7 +175,7 @@ inline mutual_reproj_edge_wapper<T>::mutual_reproj_edge_wapper(const std::shared
                 // 3次元点はkeyfrm_1で観測しているもの，カメラモデルと特徴点はkeyfrm_2のもの
                 auto edge_21 = new internal::sim3::perspective_backward_reproj_edge();
                 // 特徴点情報と再投影誤差分散をセット
-                const auto& undist_keypt_2 = shot2->frm_obs_.undist_keypts_.at(idx2);
+                const auto& undist_keypt_2 = shot2->frm_obs_->undist_keypts_.at(idx2);
                 const Vec2_t obs_2{undist_keypt_2.pt.x, undist_keypt_2.pt.y};
                 const float inv_sigma_sq_2 = shot2->orb_params_->inv_level_sigma_sq_.at(undist_keypt_2.octave);
                 edge_21->setMeasurement(obs_2);
@@ -199,7 +199,7 @@ inline mutual_reproj_edge_wapper<T>::mutual_reproj_edge_wapper(const std::shared
                 // 3次元点はkeyfrm_1で観測しているもの，カメラモデルと特徴点はkeyfrm_2のもの
                 auto edge_21 = new internal::sim3::perspective_backward_reproj_edge();
                 // 特徴点情報と再投影誤差分散をセット
-                const auto& undist_keypt_2 = shot2->frm_obs_.undist_keypts_.at(idx2);
+                const auto& undist_keypt_2 = shot2->frm_obs_->undist_keypts_.at(idx2);
                 const Vec2_t obs_2{undist_keypt_2.pt.x, undist_keypt_2.pt.y};
                 const float inv_sigma_sq_2 = shot2->orb_params_->inv_level_sigma_sq_.at(undist_keypt_2.octave);
                 edge_21->setMeasurement(obs_2);
@@ -223,7 +223,7 @@ inline mutual_reproj_edge_wapper<T>::mutual_reproj_edge_wapper(const std::shared
                 // 3次元点はkeyfrm_1で観測しているもの，カメラモデルと特徴点はkeyfrm_2のもの
                 auto edge_21 = new internal::sim3::equirectangular_backward_reproj_edge();
                 // 特徴点情報と再投影誤差分散をセット
-                const auto& undist_keypt_2 = shot2->frm_obs_.undist_keypts_.at(idx2);
+                const auto& undist_keypt_2 = shot2->frm_obs_->undist_keypts_.at(idx2);
                 const Vec2_t obs_2{undist_keypt_2.pt.x, undist_keypt_2.pt.y};
                 const float inv_sigma_sq_2 = shot2->orb_params_->inv_level_sigma_sq_.at(undist_keypt_2.octave);
                 edge_21->setMeasurement(obs_2);
@@ -245,7 +245,7 @@ inline mutual_reproj_edge_wapper<T>::mutual_reproj_edge_wapper(const std::shared
                 // 3次元点はkeyfrm_1で観測しているもの，カメラモデルと特徴点はkeyfrm_2のもの
                 auto edge_21 = new internal::sim3::perspective_backward_reproj_edge();
                 // 特徴点情報と再投影誤差分散をセット
-                const auto& undist_keypt_2 = shot2->frm_obs_.undist_keypts_.at(idx2);
+                const auto& undist_keypt_2 = shot2->frm_obs_->undist_keypts_.at(idx2);
                 const Vec2_t obs_2{undist_keypt_2.pt.x, undist_keypt_2.pt.y};
                 const float inv_sigma_sq_2 = shot2->orb_params_->inv_level_sigma_sq_.at(undist_keypt_2.octave);
                 edge_21->setMeasurement(obs_2);
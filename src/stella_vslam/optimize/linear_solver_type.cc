@@ -0,0 +1,29 @@
+#include "stella_vslam/optimize/linear_solver_type.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace stella_vslam {
+namespace optimize {
+
+linear_solver_type_t load_linear_solver_type(const std::string& linear_solver_type_str) {
+    const auto itr = std::find(linear_solver_type_to_string.begin(), linear_solver_type_to_string.end(), linear_solver_type_str);
+    if (itr == linear_solver_type_to_string.end()) {
+        throw std::runtime_error("Invalid linear solver type: " + linear_solver_type_str);
+    }
+    const auto linear_solver_type = static_cast<linear_solver_type_t>(std::distance(linear_solver_type_to_string.begin(), itr));
+#ifndef USE_G2O_CHOLMOD
+    if (linear_solver_type == linear_solver_type_t::CHOLMOD) {
+        throw std::runtime_error("Linear solver type cholmod is not available (build with USE_G2O_CHOLMOD)");
+    }
+#endif
+#ifndef USE_CUDA_BA
+    if (linear_solver_type == linear_solver_type_t::CUDA_PCG) {
+        throw std::runtime_error("Linear solver type cuda_pcg is not available (build with USE_CUDA_BA)");
+    }
+#endif
+    return linear_solver_type;
+}
+
+} // namespace optimize
+} // namespace stella_vslam
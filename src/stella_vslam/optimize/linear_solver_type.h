@@ -0,0 +1,37 @@
+#ifndef STELLA_VSLAM_OPTIMIZE_LINEAR_SOLVER_TYPE_H
+#define STELLA_VSLAM_OPTIMIZE_LINEAR_SOLVER_TYPE_H
+
+#include <array>
+#include <string>
+
+namespace stella_vslam {
+namespace optimize {
+
+/**
+ * Linear solver for the reduced camera system
+ * (NOTE: the landmarks are always eliminated via the Schur complement of the block solver)
+ */
+enum class linear_solver_type_t {
+    //! sparse Cholesky decomposition of Eigen
+    Eigen = 0,
+    //! sparse Cholesky decomposition of CSparse
+    CSparse = 1,
+    //! dense Cholesky decomposition (suitable for small problems)
+    Dense = 2,
+    //! preconditioned conjugate gradient (iterative, no factorization)
+    PCG = 3,
+    //! supernodal sparse Cholesky decomposition of CHOLMOD (available only when built with USE_G2O_CHOLMOD)
+    CHOLMOD = 4,
+    //! preconditioned conjugate gradient on the GPU (available only when built with USE_CUDA_BA)
+    CUDA_PCG = 5
+};
+
+const std::array<std::string, 6> linear_solver_type_to_string = {{"eigen", "csparse", "dense", "pcg", "cholmod", "cuda_pcg"}};
+
+//! Load the linear solver type from the string (throw std::runtime_error if invalid or unavailable)
+linear_solver_type_t load_linear_solver_type(const std::string& linear_solver_type_str);
+
+} // namespace optimize
+} // namespace stella_vslam
+
+#endif // STELLA_VSLAM_OPTIMIZE_LINEAR_SOLVER_TYPE_H
@@ -9,7 +9,9 @@
 #include "stella_vslam/optimize/internal/marker_vertex_container.h"
 #include "stella_vslam/optimize/internal/se3/shot_vertex_container.h"
 #include "stella_vslam/optimize/internal/se3/reproj_edge_wrapper.h"
+#include "stella_vslam/optimize/internal/linear_solver.h"
 #include "stella_vslam/util/converter.h"
+#include "stella_vslam/util/parallel_for.h"
 
 #include <unordered_map>
 
@@ -19,7 +21,6 @@
 #include <g2o/core/sparse_optimizer.h>
 #include <g2o/core/robust_kernel_impl.h>
 #include <g2o/types/sba/types_six_dof_expmap.h>
-#include <g2o/solvers/eigen/linear_solver_eigen.h>
 #include <g2o/core/optimization_algorithm_levenberg.h>
 
 #include <spdlog/spdlog.h>
@@ -27,59 +28,374 @@
 namespace stella_vslam {
 namespace optimize {
 
+namespace {
+// Chi-squared value with significance level of 5%
+// Two degree-of-freedom (n=2)
+constexpr float chi_sq_2D = 5.99146;
+// Three degree-of-freedom (n=3)
+constexpr float chi_sq_3D = 7.81473;
+} // namespace
+
+struct local_bundle_adjuster::problem {
+    //! Type of the reprojection edge, used to check the depth without the edge wrapper
+    enum class edge_type_t : unsigned char {
+        Equirectangular,
+        MonoPerspective,
+        StereoPerspective
+    };
+
+    //! Release the references to the map, keeping the capacity of the buffers
+    void clear() {
+        keyfrms_.clear();
+        keyfrm_vtxs_.clear();
+        num_local_keyfrms_ = 0;
+        lms_.clear();
+        lm_vtxs_.clear();
+        lm_is_valid_.clear();
+        edges_.clear();
+        edge_types_.clear();
+        chi_sq_.clear();
+        obs_keyfrm_idxs_.clear();
+        obs_lm_idxs_.clear();
+        obs_keypt_idxs_.clear();
+        is_outlier_.clear();
+        keyfrm_poses_cw_.clear();
+        lm_positions_.clear();
+        has_result_ = false;
+    }
+
+    //! Estimated bytes of the buffers, and of the graph and the Hessian blocks while they are built
+    size_t get_memory_bytes() const {
+        const size_t buffer_bytes = keyfrms_.capacity() * sizeof(std::shared_ptr<data::keyframe>)
+                                    + keyfrm_vtxs_.capacity() * sizeof(internal::se3::shot_vertex*)
+                                    + lms_.capacity() * sizeof(std::shared_ptr<data::landmark>)
+                                    + lm_vtxs_.capacity() * sizeof(internal::landmark_vertex*)
+                                    + lm_is_valid_.capacity()
+                                    + edges_.capacity() * (sizeof(g2o::OptimizableGraph::Edge*) + sizeof(edge_type_t) + sizeof(float)
+                                                           + 3 * sizeof(unsigned int) + sizeof(unsigned char))
+                                    + keyfrm_poses_cw_.capacity() * sizeof(Mat44_t)
+                                    + lm_positions_.capacity() * sizeof(Vec3_t);
+        // (the largest reprojection edge with an off-diagonal block of the Hessian per observation)
+        const size_t graph_bytes = keyfrms_.size() * (sizeof(internal::se3::shot_vertex) + sizeof(Mat66_t))
+                                   + lms_.size() * (sizeof(internal::landmark_vertex) + sizeof(Mat33_t))
+                                   + edges_.size() * (sizeof(internal::se3::stereo_perspective_reproj_edge) + sizeof(Eigen::Matrix<double, 6, 3>));
+        return buffer_bytes + graph_bytes;
+    }
+
+    void reserve_observations(const size_t num_obs) {
+        edges_.reserve(num_obs);
+        edge_types_.reserve(num_obs);
+        chi_sq_.reserve(num_obs);
+        obs_keyfrm_idxs_.reserve(num_obs);
+        obs_lm_idxs_.reserve(num_obs);
+        obs_keypt_idxs_.reserve(num_obs);
+        is_outlier_.reserve(num_obs);
+    }
+
+    template<typename T>
+    void add_observation(const internal::se3::reproj_edge_wrapper<T>& reproj_edge_wrap,
+                         const unsigned int keyfrm_idx, const unsigned int lm_idx, const unsigned int keypt_idx) {
+        edges_.push_back(reproj_edge_wrap.edge_);
+        if (reproj_edge_wrap.camera_->model_type_ == camera::model_type_t::Equirectangular) {
+            edge_types_.push_back(edge_type_t::Equirectangular);
+        }
+        else {
+            edge_types_.push_back(reproj_edge_wrap.is_monocular_ ? edge_type_t::MonoPerspective : edge_type_t::StereoPerspective);
+        }
+        chi_sq_.push_back(reproj_edge_wrap.is_monocular_ ? chi_sq_2D : chi_sq_3D);
+        obs_keyfrm_idxs_.push_back(keyfrm_idx);
+        obs_lm_idxs_.push_back(lm_idx);
+        obs_keypt_idxs_.push_back(keypt_idx);
+        is_outlier_.push_back(false);
+    }
+
+    bool depth_is_positive(const unsigned int obs_idx) const {
+        switch (edge_types_[obs_idx]) {
+            case edge_type_t::MonoPerspective:
+                return static_cast<internal::se3::mono_perspective_reproj_edge*>(edges_[obs_idx])->depth_is_positive();
+            case edge_type_t::StereoPerspective:
+                return static_cast<internal::se3::stereo_perspective_reproj_edge*>(edges_[obs_idx])->depth_is_positive();
+            default:
+                return true;
+        }
+    }
+
+    //! keyframes of the graph (the first num_local_keyfrms_ keyframes are optimized, and the others are fixed)
+    std::vector<std::shared_ptr<data::keyframe>> keyfrms_;
+    //! vertices of the local keyframes
+    std::vector<internal::se3::shot_vertex*> keyfrm_vtxs_;
+    size_t num_local_keyfrms_ = 0;
+
+    //! local landmarks and their vertices
+    std::vector<std::shared_ptr<data::landmark>> lms_;
+    std::vector<internal::landmark_vertex*> lm_vtxs_;
+    //! (not erased during the optimization)
+    std::vector<unsigned char> lm_is_valid_;
+
+    //! observations (one element per reprojection edge of the landmarks)
+    std::vector<g2o::OptimizableGraph::Edge*> edges_;
+    std::vector<edge_type_t> edge_types_;
+    //! threshold of the chi-squared value
+    std::vector<float> chi_sq_;
+    std::vector<unsigned int> obs_keyfrm_idxs_;
+    std::vector<unsigned int> obs_lm_idxs_;
+    //! indices of the keypoints in the keyframes
+    std::vector<unsigned int> obs_keypt_idxs_;
+    std::vector<unsigned char> is_outlier_;
+
+    //! result of the optimization
+    eigen_alloc_vector<Mat44_t> keyfrm_poses_cw_;
+    eigen_alloc_vector<Vec3_t> lm_positions_;
+    bool has_result_ = false;
+};
+
 local_bundle_adjuster::local_bundle_adjuster(const YAML::Node& yaml_node,
                                              const unsigned int num_first_iter,
                                              const unsigned int num_second_iter)
     : num_first_iter_(num_first_iter), num_second_iter_(num_second_iter),
-      use_additional_keyframes_for_monocular_(yaml_node["use_additional_keyframes_for_monocular"].as<bool>(false)) {}
+      use_additional_keyframes_for_monocular_(yaml_node["use_additional_keyframes_for_monocular"].as<bool>(false)),
+      linear_solver_type_(load_linear_solver_type(yaml_node["local_BA_linear_solver"].as<std::string>("eigen"))),
+      warm_start_(yaml_node["warm_start_local_BA"].as<bool>(false)),
+      min_num_iter_before_abort_(yaml_node["min_num_local_BA_iterations_before_abort"].as<unsigned int>(2)) {
+    auto linear_solver = internal::create_linear_solver<g2o::BlockSolver_6_3>(linear_solver_type_);
+    auto block_solver = g2o::make_unique<g2o::BlockSolver_6_3>(std::move(linear_solver));
+    algorithm_ = new g2o::OptimizationAlgorithmLevenberg(std::move(block_solver));
+
+    optimizer_ = g2o::make_unique<g2o::SparseOptimizer>();
+    terminate_action_ = g2o::make_unique<terminate_action>();
+    terminate_action_->setGainThreshold(1e-3);
+    optimizer_->addPostIterationAction(terminate_action_.get());
+    optimizer_->setAlgorithm(algorithm_);
+
+    problem_ = g2o::make_unique<problem>();
+}
+
+local_bundle_adjuster::~local_bundle_adjuster() {
+    optimizer_->removePostIterationAction(terminate_action_.get());
+}
 
 void local_bundle_adjuster::optimize(data::map_database* map_db,
-                                     const std::shared_ptr<stella_vslam::data::keyframe>& curr_keyfrm, bool* const force_stop_flag) const {
+                                     const std::shared_ptr<stella_vslam::data::keyframe>& curr_keyfrm, bool* const force_stop_flag) {
+    optimize(map_db, std::vector<std::shared_ptr<data::keyframe>>{curr_keyfrm}, force_stop_flag);
+}
+
+void local_bundle_adjuster::optimize(data::map_database* map_db,
+                                     const std::vector<std::shared_ptr<stella_vslam::data::keyframe>>& curr_keyfrms, bool* const force_stop_flag) {
+    if (compute(curr_keyfrms, force_stop_flag)) {
+        apply(map_db);
+    }
+}
+
+bool local_bundle_adjuster::compute(const std::vector<std::shared_ptr<data::keyframe>>& curr_keyfrms, bool* const force_stop_flag) {
+    auto& prob = *problem_;
+    prob.clear();
+
+    // 1. Build the graph of the local window
+
+    auto& optimizer = *optimizer_;
+    if (!build_problem(curr_keyfrms)) {
+        optimizer.clear();
+        return false;
+    }
+    scratch_memory_bytes_ = prob.get_memory_bytes();
+
+    // 2. Prepare the optimizer
+
+    // The solver is reused, and the graph of the previous optimization has been cleared
+    optimizer.setForceStopFlag(&stop_flag_);
+    terminate_action_->set_abort_request_flag(force_stop_flag, min_num_iter_before_abort_);
+    algorithm_->setUserLambdaInit(warm_start_ ? last_lambda_ : 0.0);
+
+    // 3. Perform the first optimization
+
+    // (the optimization is not skipped if the minimum number of iterations is guaranteed)
+    if (force_stop_flag && *force_stop_flag && min_num_iter_before_abort_ == 0) {
+        terminate_action_->set_abort_request_flag(nullptr);
+        optimizer.clear();
+        return false;
+    }
+
+    stop_flag_ = false;
+    optimizer.initializeOptimization();
+    optimizer.optimize(num_first_iter_);
+
+    // 4. Discard outliers, then perform the second optimization
+
+    bool run_robust_BA = true;
+
+    // (the partially optimized state is stored below even if aborted)
+    if (terminate_action_->stopped_by_abort_request_ || (force_stop_flag && *force_stop_flag)) {
+        run_robust_BA = false;
+    }
+
+    if (run_robust_BA) {
+        classify_outliers();
+
+        const auto num_obs = static_cast<int64_t>(prob.edges_.size());
+        util::parallel_for(
+            thread_pool_, 0, num_obs, [&prob](const int64_t i) {
+                auto edge = prob.edges_[i];
+                if (!prob.lm_is_valid_[prob.obs_lm_idxs_[i]]) {
+                    return;
+                }
+                if (prob.is_outlier_[i]) {
+                    edge->setLevel(1);
+                }
+                edge->setRobustKernel(nullptr);
+            },
+            util::task_priority_t::Normal, parallel_for_grain_size_);
+
+        stop_flag_ = false;
+        optimizer.initializeOptimization();
+        optimizer.optimize(num_second_iter_);
+    }
+    terminate_action_->set_abort_request_flag(nullptr);
+
+    if (warm_start_) {
+        last_lambda_ = algorithm_->currentLambda();
+    }
+
+    // 5. Classify the outliers, and copy the estimates out of the graph
+
+    classify_outliers();
+
+    const auto num_local_keyfrms = static_cast<int64_t>(prob.num_local_keyfrms_);
+    prob.keyfrm_poses_cw_.resize(num_local_keyfrms);
+    util::parallel_for(
+        thread_pool_, 0, num_local_keyfrms, [&prob](const int64_t i) {
+            prob.keyfrm_poses_cw_[i] = util::converter::to_eigen_mat(prob.keyfrm_vtxs_[i]->estimate());
+        },
+        util::task_priority_t::Normal, parallel_for_grain_size_);
+
+    const auto num_lms = static_cast<int64_t>(prob.lms_.size());
+    prob.lm_positions_.resize(num_lms);
+    util::parallel_for(
+        thread_pool_, 0, num_lms, [&prob](const int64_t i) {
+            prob.lm_positions_[i] = prob.lm_vtxs_[i]->estimate();
+        },
+        util::task_priority_t::Normal, parallel_for_grain_size_);
+
+    // Release the vertices and the edges, keeping the solver for the next optimization
+    optimizer.clear();
+    prob.keyfrm_vtxs_.clear();
+    prob.lm_vtxs_.clear();
+    prob.edges_.clear();
+
+    prob.has_result_ = true;
+    return true;
+}
+
+void local_bundle_adjuster::apply(data::map_database* map_db) {
+    auto& prob = *problem_;
+    if (!prob.has_result_) {
+        return;
+    }
+    prob.has_result_ = false;
+
+    // (the prediction parameters invalidated by the new positions are refreshed together after releasing the lock)
+    std::vector<std::shared_ptr<data::landmark>> updated_lms;
+    updated_lms.reserve(prob.lms_.size());
+    {
+        std::lock_guard<util::profiled_mutex> lock(data::map_database::mtx_database_);
+
+        // (the map can be modified between compute() and apply(), so the erased elements are checked again,
+        //  and the observations which have been removed or replaced by the fusion are skipped)
+        for (unsigned int i = 0; i < prob.is_outlier_.size(); ++i) {
+            if (!prob.is_outlier_[i] || !prob.lm_is_valid_[prob.obs_lm_idxs_[i]]) {
+                continue;
+            }
+            const auto& keyfrm = prob.keyfrms_[prob.obs_keyfrm_idxs_[i]];
+            const auto& lm = prob.lms_[prob.obs_lm_idxs_[i]];
+            if (lm->will_be_erased()) {
+                continue;
+            }
+            if (!lm->is_observed_in_keyframe(keyfrm) || keyfrm->get_landmark(prob.obs_keypt_idxs_[i]) != lm) {
+                continue;
+            }
+            keyfrm->erase_landmark(lm);
+            lm->erase_observation(map_db, keyfrm);
+            if (!lm->will_be_erased()) {
+                lm->compute_descriptor();
+            }
+        }
+
+        for (unsigned int i = 0; i < prob.num_local_keyfrms_; ++i) {
+            const auto& local_keyfrm = prob.keyfrms_[i];
+            if (local_keyfrm->will_be_erased()) {
+                continue;
+            }
+            local_keyfrm->set_pose_cw(prob.keyfrm_poses_cw_[i]);
+        }
+
+        for (unsigned int i = 0; i < prob.lms_.size(); ++i) {
+            const auto& local_lm = prob.lms_[i];
+            if (local_lm->will_be_erased()) {
+                continue;
+            }
+            local_lm->set_pos_in_world(prob.lm_positions_[i]);
+            updated_lms.push_back(local_lm);
+        }
+    }
+    data::landmark::update_prediction_parameters(updated_lms, thread_pool_);
+
+    // Release the references to the map
+    prob.clear();
+}
+
+bool local_bundle_adjuster::build_problem(const std::vector<std::shared_ptr<data::keyframe>>& curr_keyfrms) {
+    auto& prob = *problem_;
+
     // 1. Aggregate the local and fixed keyframes, and local landmarks
 
-    // Correct the local keyframes of the current keyframe
+    // Correct the local keyframes of the current keyframes
     std::unordered_map<unsigned int, std::shared_ptr<data::keyframe>> local_keyfrms;
     bool has_scale = false;
 
-    local_keyfrms[curr_keyfrm->id_] = curr_keyfrm;
-    const auto curr_covisibilities = curr_keyfrm->graph_node_->get_covisibilities();
-    for (const auto& local_keyfrm : curr_covisibilities) {
-        if (!local_keyfrm) {
-            continue;
-        }
-        if (local_keyfrm->will_be_erased()) {
-            continue;
-        }
-        if (local_keyfrm->graph_node_->is_spanning_root()) {
+    for (const auto& curr_keyfrm : curr_keyfrms) {
+        // (the keyframes of the batch can be removed as redundant before the optimization)
+        if (curr_keyfrm->will_be_erased()) {
             continue;
         }
 
-        local_keyfrms[local_keyfrm->id_] = local_keyfrm;
-        if (local_keyfrm->camera_->setup_type_ != camera::setup_type_t::Monocular) {
-            has_scale = true;
+        local_keyfrms[curr_keyfrm->id_] = curr_keyfrm;
+        const auto curr_covisibilities = curr_keyfrm->graph_node_->get_covisibilities();
+        for (const auto& local_keyfrm : curr_covisibilities) {
+            if (!local_keyfrm) {
+                continue;
+            }
+            if (local_keyfrm->will_be_erased()) {
+                continue;
+            }
+            if (local_keyfrm->graph_node_->is_spanning_root()) {
+                continue;
+            }
+
+            local_keyfrms[local_keyfrm->id_] = local_keyfrm;
+            if (local_keyfrm->camera_->setup_type_ != camera::setup_type_t::Monocular) {
+                has_scale = true;
+            }
         }
     }
 
+    if (local_keyfrms.empty()) {
+        return false;
+    }
+
     // Correct landmarks seen in local keyframes
     std::unordered_map<unsigned int, std::shared_ptr<data::landmark>> local_lms;
 
     for (const auto& local_keyfrm : local_keyfrms) {
-        const auto landmarks = local_keyfrm.second->get_landmarks();
-        for (const auto& local_lm : landmarks) {
+        local_keyfrm.second->for_each_landmark([&local_lms](const std::shared_ptr<data::landmark>& local_lm, const unsigned int) {
             if (!local_lm) {
-                continue;
+                return;
             }
             if (local_lm->will_be_erased()) {
-                continue;
+                return;
             }
 
             // Avoid duplication
-            if (local_lms.count(local_lm->id_)) {
-                continue;
-            }
-
-            local_lms[local_lm->id_] = local_lm;
-        }
+            local_lms.emplace(local_lm->id_, local_lm);
+        });
     }
 
     // Correct markers seen in local keyframes
@@ -103,9 +419,12 @@ void local_bundle_adjuster::optimize(data::map_database* map_db,
 
     // Fixed keyframes: keyframes which observe local landmarks but which are NOT in local keyframes
     std::unordered_map<unsigned int, std::shared_ptr<data::keyframe>> fixed_keyfrms;
+    // Upper bound of the number of the reprojection edges
+    size_t num_observations = 0;
 
     for (const auto& local_lm : local_lms) {
         const auto observations = local_lm.second->get_observations();
+        num_observations += observations.size();
         for (const auto& obs : observations) {
             const auto fixed_keyfrm = obs.first.lock();
             if (!fixed_keyfrm) {
@@ -143,65 +462,52 @@ void local_bundle_adjuster::optimize(data::map_database* map_db,
         }
     }
 
-    // 2. Construct an optimizer
-
-    std::unique_ptr<g2o::BlockSolverBase> block_solver;
-    auto linear_solver = g2o::make_unique<g2o::LinearSolverEigen<g2o::BlockSolver_6_3::PoseMatrixType>>();
-    block_solver = g2o::make_unique<g2o::BlockSolver_6_3>(std::move(linear_solver));
-    auto algorithm = new g2o::OptimizationAlgorithmLevenberg(std::move(block_solver));
+    // 2. Convert each of the keyframe to the g2o vertex, then set it to the optimizer
 
-    g2o::SparseOptimizer optimizer;
-    auto terminateAction = new terminate_action;
-    terminateAction->setGainThreshold(1e-3);
-    optimizer.addPostIterationAction(terminateAction);
-    optimizer.setAlgorithm(algorithm);
-
-    if (force_stop_flag) {
-        optimizer.setForceStopFlag(force_stop_flag);
-    }
-
-    // 3. Convert each of the keyframe to the g2o vertex, then set it to the optimizer
+    auto& optimizer = *optimizer_;
 
     // Container of the shot vertices
     auto vtx_id_offset = std::make_shared<unsigned int>(0);
     internal::se3::shot_vertex_container keyfrm_vtx_container(vtx_id_offset, local_keyfrms.size() + fixed_keyfrms.size());
-    // Save the converted keyframes
-    std::unordered_map<unsigned int, std::shared_ptr<data::keyframe>> all_keyfrms;
+    // Index of the keyframe in prob.keyfrms_ (the local keyframes are placed first)
+    std::unordered_map<unsigned int, unsigned int> keyfrm_id_to_idx;
+    keyfrm_id_to_idx.reserve(local_keyfrms.size() + fixed_keyfrms.size());
+    prob.keyfrms_.reserve(local_keyfrms.size() + fixed_keyfrms.size());
+    prob.keyfrm_vtxs_.reserve(local_keyfrms.size());
 
     // Set the local keyframes to the optimizer
     for (const auto& id_local_keyfrm_pair : local_keyfrms) {
         const auto& local_keyfrm = id_local_keyfrm_pair.second;
 
-        all_keyfrms.emplace(id_local_keyfrm_pair);
+        keyfrm_id_to_idx.emplace(local_keyfrm->id_, prob.keyfrms_.size());
+        prob.keyfrms_.push_back(local_keyfrm);
         auto keyfrm_vtx = keyfrm_vtx_container.create_vertex(local_keyfrm, false);
+        prob.keyfrm_vtxs_.push_back(keyfrm_vtx);
         optimizer.addVertex(keyfrm_vtx);
     }
+    prob.num_local_keyfrms_ = prob.keyfrms_.size();
 
     // Set the fixed keyframes to the optimizer
     for (const auto& id_fixed_keyfrm_pair : fixed_keyfrms) {
         const auto& fixed_keyfrm = id_fixed_keyfrm_pair.second;
 
-        all_keyfrms.emplace(id_fixed_keyfrm_pair);
+        keyfrm_id_to_idx.emplace(fixed_keyfrm->id_, prob.keyfrms_.size());
+        prob.keyfrms_.push_back(fixed_keyfrm);
         auto keyfrm_vtx = keyfrm_vtx_container.create_vertex(fixed_keyfrm, true);
         optimizer.addVertex(keyfrm_vtx);
     }
 
-    // 4. Connect the vertices of the keyframe and the landmark by using an edge of reprojection constraint
+    // 3. Connect the vertices of the keyframe and the landmark by using an edge of reprojection constraint
 
     // Container of the landmark vertices
     internal::landmark_vertex_container lm_vtx_container(vtx_id_offset, local_lms.size());
+    prob.lms_.reserve(local_lms.size());
+    prob.lm_vtxs_.reserve(local_lms.size());
+    prob.reserve_observations(num_observations);
 
-    // Container of the reprojection edges
     using reproj_edge_wrapper = internal::se3::reproj_edge_wrapper<data::keyframe>;
-    std::vector<reproj_edge_wrapper> reproj_edge_wraps;
-    reproj_edge_wraps.reserve(all_keyfrms.size() * local_lms.size());
 
-    // Chi-squared value with significance level of 5%
-    // Two degree-of-freedom (n=2)
-    constexpr float chi_sq_2D = 5.99146;
     const float sqrt_chi_sq_2D = std::sqrt(chi_sq_2D);
-    // Three degree-of-freedom (n=3)
-    constexpr float chi_sq_3D = 7.81473;
     const float sqrt_chi_sq_3D = std::sqrt(chi_sq_3D);
 
     for (const auto& id_local_lm_pair : local_lms) {
@@ -215,6 +521,9 @@ void local_bundle_adjuster::optimize(data::map_database* map_db,
         // Convert the landmark to the g2o vertex, then set to the optimizer
         auto lm_vtx = lm_vtx_container.create_vertex(local_lm, false);
         optimizer.addVertex(lm_vtx);
+        const unsigned int lm_idx = prob.lms_.size();
+        prob.lms_.push_back(local_lm);
+        prob.lm_vtxs_.push_back(lm_vtx);
 
         for (const auto& obs : observations) {
             const auto keyfrm = obs.first.lock();
@@ -225,29 +534,30 @@ void local_bundle_adjuster::optimize(data::map_database* map_db,
             if (keyfrm->will_be_erased()) {
                 continue;
             }
-            if (!keyfrm_vtx_container.contain(keyfrm)) {
+            const auto keyfrm_idx_itr = keyfrm_id_to_idx.find(keyfrm->id_);
+            if (keyfrm_idx_itr == keyfrm_id_to_idx.end()) {
                 continue;
             }
 
             const auto keyfrm_vtx = keyfrm_vtx_container.get_vertex(keyfrm);
-            const auto& undist_keypt = keyfrm->frm_obs_.undist_keypts_.at(idx);
-            const float x_right = keyfrm->frm_obs_.stereo_x_right_.empty() ? -1.0f : keyfrm->frm_obs_.stereo_x_right_.at(idx);
+            const auto& undist_keypt = keyfrm->frm_obs_->undist_keypts_.at(idx);
+            const float x_right = keyfrm->frm_obs_->stereo_x_right_.empty() ? -1.0f : keyfrm->frm_obs_->stereo_x_right_.at(idx);
             const float inv_sigma_sq = keyfrm->orb_params_->inv_level_sigma_sq_.at(undist_keypt.octave);
             const auto sqrt_chi_sq = (keyfrm->camera_->setup_type_ == camera::setup_type_t::Monocular)
                                          ? sqrt_chi_sq_2D
                                          : sqrt_chi_sq_3D;
-            auto reproj_edge_wrap = reproj_edge_wrapper(keyfrm, keyfrm_vtx, local_lm, lm_vtx,
-                                                        idx, undist_keypt.pt.x, undist_keypt.pt.y, x_right,
-                                                        inv_sigma_sq, sqrt_chi_sq);
-            reproj_edge_wraps.push_back(reproj_edge_wrap);
+            const auto reproj_edge_wrap = reproj_edge_wrapper(keyfrm, keyfrm_vtx, local_lm, lm_vtx,
+                                                              idx, undist_keypt.pt.x, undist_keypt.pt.y, x_right,
+                                                              inv_sigma_sq, sqrt_chi_sq);
+            prob.add_observation(reproj_edge_wrap, keyfrm_idx_itr->second, lm_idx, idx);
             optimizer.addEdge(reproj_edge_wrap.edge_);
         }
     }
 
+    // 4. Set the corners of the markers as the fixed vertices
+
     // Container of the reprojection edges for corners of markers
     internal::marker_vertex_container marker_vtx_container(vtx_id_offset, local_mkrs.size());
-    std::vector<reproj_edge_wrapper> mkr_reproj_edge_wraps;
-    mkr_reproj_edge_wraps.reserve(all_keyfrms.size() * local_mkrs.size());
 
     for (auto& id_local_mkr_pair : local_mkrs) {
         auto mkr = id_local_mkr_pair.second;
@@ -279,117 +589,35 @@ void local_bundle_adjuster::optimize(data::map_database* map_db,
                 auto reproj_edge_wrap = reproj_edge_wrapper(keyfrm, keyfrm_vtx, nullptr, corner_vtx,
                                                             0, undist_pt.x, undist_pt.y, x_right,
                                                             inv_sigma_sq, 0.0, false);
-                mkr_reproj_edge_wraps.push_back(reproj_edge_wrap);
                 optimizer.addEdge(reproj_edge_wrap.edge_);
             }
         }
     }
 
-    // 5. Perform the first optimization
-
-    if (force_stop_flag && *force_stop_flag) {
-        return;
-    }
-
-    optimizer.initializeOptimization();
-    optimizer.optimize(num_first_iter_);
-
-    // 6. Discard outliers, then perform the second optimization
-
-    bool run_robust_BA = true;
-
-    if (force_stop_flag && *force_stop_flag) {
-        run_robust_BA = false;
-    }
-
-    if (run_robust_BA) {
-        for (auto& reproj_edge_wrap : reproj_edge_wraps) {
-            auto edge = reproj_edge_wrap.edge_;
-
-            const auto& local_lm = reproj_edge_wrap.lm_;
-            if (local_lm->will_be_erased()) {
-                continue;
-            }
-
-            if (reproj_edge_wrap.is_monocular_) {
-                if (chi_sq_2D < edge->chi2() || !reproj_edge_wrap.depth_is_positive()) {
-                    reproj_edge_wrap.set_as_outlier();
-                }
-            }
-            else {
-                if (chi_sq_3D < edge->chi2() || !reproj_edge_wrap.depth_is_positive()) {
-                    reproj_edge_wrap.set_as_outlier();
-                }
-            }
-
-            edge->setRobustKernel(nullptr);
-        }
-
-        optimizer.initializeOptimization();
-        optimizer.optimize(num_second_iter_);
-    }
-
-    delete terminateAction;
-
-    // 7. Count the outliers
-
-    std::vector<std::pair<std::shared_ptr<data::keyframe>, std::shared_ptr<data::landmark>>> outlier_observations;
-    outlier_observations.reserve(reproj_edge_wraps.size());
-
-    for (auto& reproj_edge_wrap : reproj_edge_wraps) {
-        auto edge = reproj_edge_wrap.edge_;
-
-        const auto& local_lm = reproj_edge_wrap.lm_;
-        if (local_lm->will_be_erased()) {
-            continue;
-        }
-
-        if (reproj_edge_wrap.is_monocular_) {
-            if (chi_sq_2D < edge->chi2() || !reproj_edge_wrap.depth_is_positive()) {
-                outlier_observations.emplace_back(std::make_pair(reproj_edge_wrap.shot_, reproj_edge_wrap.lm_));
-            }
-        }
-        else {
-            if (chi_sq_3D < edge->chi2() || !reproj_edge_wrap.depth_is_positive()) {
-                outlier_observations.emplace_back(std::make_pair(reproj_edge_wrap.shot_, reproj_edge_wrap.lm_));
-            }
-        }
-    }
-
-    // 8. Update the information
-
-    {
-        std::lock_guard<std::mutex> lock(data::map_database::mtx_database_);
-
-        for (const auto& outlier_obs : outlier_observations) {
-            const auto& keyfrm = outlier_obs.first;
-            const auto& lm = outlier_obs.second;
-            keyfrm->erase_landmark(lm);
-            lm->erase_observation(map_db, keyfrm);
-            if (!lm->will_be_erased()) {
-                lm->compute_descriptor();
-                lm->update_mean_normal_and_obs_scale_variance();
-            }
-        }
-
-        for (const auto& id_local_keyfrm_pair : local_keyfrms) {
-            const auto& local_keyfrm = id_local_keyfrm_pair.second;
-
-            auto keyfrm_vtx = keyfrm_vtx_container.get_vertex(local_keyfrm);
-            local_keyfrm->set_pose_cw(keyfrm_vtx->estimate());
-        }
+    return true;
+}
 
-        for (const auto& id_local_lm_pair : local_lms) {
-            const auto& local_lm = id_local_lm_pair.second;
-            if (local_lm->will_be_erased()) {
-                continue;
+void local_bundle_adjuster::classify_outliers() {
+    auto& prob = *problem_;
+
+    const auto num_lms = static_cast<int64_t>(prob.lms_.size());
+    prob.lm_is_valid_.resize(num_lms);
+    util::parallel_for(
+        thread_pool_, 0, num_lms, [&prob](const int64_t i) {
+            prob.lm_is_valid_[i] = !prob.lms_[i]->will_be_erased();
+        },
+        util::task_priority_t::Normal, parallel_for_grain_size_);
+
+    const auto num_obs = static_cast<int64_t>(prob.edges_.size());
+    util::parallel_for(
+        thread_pool_, 0, num_obs, [&prob](const int64_t i) {
+            if (!prob.lm_is_valid_[prob.obs_lm_idxs_[i]]) {
+                prob.is_outlier_[i] = false;
+                return;
             }
-
-            auto lm_vtx = lm_vtx_container.get_vertex(local_lm);
-            local_lm->set_pos_in_world(lm_vtx->estimate());
-            local_lm->update_mean_normal_and_obs_scale_variance();
-        }
-    }
+            prob.is_outlier_[i] = prob.chi_sq_[i] < prob.edges_[i]->chi2() || !prob.depth_is_positive(i);
+        },
+        util::task_priority_t::Normal, parallel_for_grain_size_);
 }
 
 } // namespace optimize
@@ -1,7 +1,18 @@
 #ifndef STELLA_VSLAM_OPTIMIZE_LOCAL_BUNDLE_ADJUSTER_H
 #define STELLA_VSLAM_OPTIMIZE_LOCAL_BUNDLE_ADJUSTER_H
 
+#include "stella_vslam/optimize/linear_solver_type.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
 #include <memory>
+#include <vector>
+
+namespace g2o {
+class SparseOptimizer;
+class OptimizationAlgorithmLevenberg;
+} // namespace g2o
 
 namespace stella_vslam {
 
@@ -10,8 +21,14 @@ class keyframe;
 class map_database;
 } // namespace data
 
+namespace util {
+class thread_pool;
+} // namespace util
+
 namespace optimize {
 
+class terminate_action;
+
 class local_bundle_adjuster {
 public:
     /**
@@ -27,23 +44,104 @@ public:
     /**
      * Destructor
      */
-    virtual ~local_bundle_adjuster() = default;
+    virtual ~local_bundle_adjuster();
 
     /**
      * Perform optimization
+     * (NOTE: the optimizer is reused across calls, so this function must not be called concurrently)
+     * The optimization is aborted when force_stop_flag is set, after min_num_iterations_before_abort iterations.
+     * The partially optimized poses and positions are stored in the map, so that the next optimization resumes from them.
      * @param map_db
      * @param curr_keyfrm
      * @param force_stop_flag
      */
-    void optimize(data::map_database* map_db, const std::shared_ptr<data::keyframe>& curr_keyfrm, bool* const force_stop_flag) const;
+    void optimize(data::map_database* map_db, const std::shared_ptr<data::keyframe>& curr_keyfrm, bool* const force_stop_flag);
+
+    /**
+     * Perform optimization of the union of the local windows of the keyframes
+     * (the keyframes integrated in a batch are optimized together, see mapping_module)
+     * @param map_db
+     * @param curr_keyfrms
+     * @param force_stop_flag
+     */
+    void optimize(data::map_database* map_db, const std::vector<std::shared_ptr<data::keyframe>>& curr_keyfrms, bool* const force_stop_flag);
+
+    /**
+     * Perform optimization without modifying the map (compute-only)
+     * The map locks are not held during the optimization. The optimized poses and positions and the outlier observations
+     * are kept in the adjuster until the next call, and stored in the map by apply().
+     * @param curr_keyfrms
+     * @param force_stop_flag
+     * @return true if the result is available
+     */
+    bool compute(const std::vector<std::shared_ptr<data::keyframe>>& curr_keyfrms, bool* const force_stop_flag);
+
+    /**
+     * Store the result of the last compute() in the map
+     * (NOTE: mtx_database_ is locked in this function)
+     * @param map_db
+     */
+    void apply(data::map_database* map_db);
+
+    /**
+     * Set the thread pool which runs the parallel loops over the observations (the OpenMP loops are used if nullptr)
+     * @param thread_pool
+     */
+    void set_thread_pool(util::thread_pool* thread_pool) { thread_pool_ = thread_pool; }
+
+    /**
+     * Estimated bytes of the scratch space of the last optimization
+     * (the reused buffers, and the graph and the Hessian blocks at the peak)
+     */
+    size_t get_scratch_memory_bytes() const { return scratch_memory_bytes_; }
 
 private:
+    //! Problem of the local BA packed per observation (defined in the source file, the buffers are reused across calls)
+    struct problem;
+
+    //! Build the graph of the problem from the local window of the keyframes
+    bool build_problem(const std::vector<std::shared_ptr<data::keyframe>>& curr_keyfrms);
+
+    //! Classify the observations by the chi-squared values and the depths (in parallel)
+    void classify_outliers();
+
+
     //! number of iterations of first optimization
     const unsigned int num_first_iter_;
     //! number of iterations of second optimization
     const unsigned int num_second_iter_;
     //!
     const unsigned int use_additional_keyframes_for_monocular_ = false;
+    //! linear solver for the reduced camera system
+    const linear_solver_type_t linear_solver_type_;
+    //! start the Levenberg-Marquardt iterations from the damping of the previous optimization
+    const bool warm_start_ = false;
+    //! minimum number of iterations of each optimization before the abort request is honored
+    const unsigned int min_num_iter_before_abort_ = 0;
+
+    //! stop flag of the optimizer (separated from the abort request, which is only read by the terminate action)
+    bool stop_flag_ = false;
+
+    //! damping factor at the end of the previous optimization (0 if not available)
+    double last_lambda_ = 0.0;
+
+    //! terminate action registered to the optimizer
+    std::unique_ptr<terminate_action> terminate_action_;
+    //! optimizer reused across the calls (the graph is cleared after each optimization)
+    std::unique_ptr<g2o::SparseOptimizer> optimizer_;
+    //! optimization algorithm owned by optimizer_
+    g2o::OptimizationAlgorithmLevenberg* algorithm_ = nullptr;
+
+    //! problem reused across the calls
+    std::unique_ptr<problem> problem_;
+
+    //! estimated bytes of the scratch space of the last optimization
+    std::atomic<size_t> scratch_memory_bytes_{0};
+
+    //! thread pool which runs the parallel loops (nullptr if not set)
+    util::thread_pool* thread_pool_ = nullptr;
+    //! number of the observations or the vertices processed at once by a thread of the parallel loops
+    static constexpr int64_t parallel_for_grain_size_ = 256;
 };
 
 } // namespace optimize
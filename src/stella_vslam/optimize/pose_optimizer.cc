@@ -2,13 +2,17 @@
 #include "stella_vslam/data/keyframe.h"
 #include "stella_vslam/data/landmark.h"
 #include "stella_vslam/optimize/pose_optimizer.h"
+#include "stella_vslam/optimize/pose_solver.h"
 #include "stella_vslam/optimize/terminate_action.h"
 #include "stella_vslam/optimize/internal/se3/pose_opt_edge_wrapper.h"
+#include "stella_vslam/optimize/internal/se3/rig_pose_opt_edge.h"
 #include "stella_vslam/util/converter.h"
 
+#include <tuple>
 #include <vector>
 #include <mutex>
 
+#include <Eigen/Cholesky>
 #include <Eigen/StdVector>
 #include <g2o/core/solver.h>
 #include <g2o/core/block_solver.h>
@@ -20,27 +24,60 @@
 namespace stella_vslam {
 namespace optimize {
 
-pose_optimizer::pose_optimizer(const unsigned int num_trials, const unsigned int num_each_iter)
-    : num_trials_(num_trials), num_each_iter_(num_each_iter) {}
+pose_optimizer::pose_optimizer(const unsigned int num_trials, const unsigned int num_each_iter,
+                               const bool use_dedicated_solver)
+    : num_trials_(num_trials), num_each_iter_(num_each_iter), use_dedicated_solver_(use_dedicated_solver) {}
 
-unsigned int pose_optimizer::optimize(const data::frame& frm, g2o::SE3Quat& optimized_pose, std::vector<bool>& outlier_flags) const {
-    auto num_valid_obs = optimize(frm.get_pose_cw(), frm.frm_obs_, frm.orb_params_, frm.camera_,
-                                  frm.get_landmarks(), optimized_pose, outlier_flags);
+unsigned int pose_optimizer::optimize(const data::frame& frm, g2o::SE3Quat& optimized_pose, std::vector<bool>& outlier_flags,
+                                      Mat66_t* pose_cov) const {
+    std::vector<std::vector<bool>> rig_outlier_flags;
+    auto num_valid_obs = optimize(frm.get_pose_cw(), *frm.frm_obs_, frm.orb_params_, frm.camera_,
+                                  frm.get_landmarks(), {}, optimized_pose, outlier_flags, rig_outlier_flags, pose_cov);
     return num_valid_obs;
 }
 
 unsigned int pose_optimizer::optimize(const data::keyframe* keyfrm, g2o::SE3Quat& optimized_pose, std::vector<bool>& outlier_flags) const {
-    auto num_valid_obs = optimize(keyfrm->get_pose_cw(), keyfrm->frm_obs_, keyfrm->orb_params_, keyfrm->camera_,
+    auto num_valid_obs = optimize(keyfrm->get_pose_cw(), *keyfrm->frm_obs_, keyfrm->orb_params_, keyfrm->camera_,
                                   keyfrm->get_landmarks(), optimized_pose, outlier_flags);
     return num_valid_obs;
 }
 
+unsigned int pose_optimizer::optimize(const data::frame& frm, g2o::SE3Quat& optimized_pose, std::vector<bool>& outlier_flags,
+                                      std::vector<std::vector<bool>>& rig_outlier_flags, Mat66_t* pose_cov) const {
+    auto num_valid_obs = optimize(frm.get_pose_cw(), *frm.frm_obs_, frm.orb_params_, frm.camera_,
+                                  frm.get_landmarks(), frm.rig_frms_, optimized_pose, outlier_flags, rig_outlier_flags, pose_cov);
+    return num_valid_obs;
+}
+
 unsigned int pose_optimizer::optimize(const Mat44_t& cam_pose_cw, const data::frame_observation& frm_obs,
                                       const feature::orb_params* orb_params,
                                       const camera::base* camera,
                                       const std::vector<std::shared_ptr<data::landmark>>& landmarks,
                                       g2o::SE3Quat& optimized_pose,
                                       std::vector<bool>& outlier_flags) const {
+    std::vector<std::vector<bool>> rig_outlier_flags;
+    return optimize(cam_pose_cw, frm_obs, orb_params, camera, landmarks, {}, optimized_pose, outlier_flags, rig_outlier_flags, nullptr);
+}
+
+unsigned int pose_optimizer::optimize(const Mat44_t& cam_pose_cw, const data::frame_observation& frm_obs,
+                                      const feature::orb_params* orb_params,
+                                      const camera::base* camera,
+                                      const std::vector<std::shared_ptr<data::landmark>>& landmarks,
+                                      const std::vector<std::shared_ptr<data::rig_frame>>& rig_frms,
+                                      g2o::SE3Quat& optimized_pose,
+                                      std::vector<bool>& outlier_flags,
+                                      std::vector<std::vector<bool>>& rig_outlier_flags,
+                                      Mat66_t* pose_cov) const {
+    if (pose_cov) {
+        pose_cov->setZero();
+    }
+
+    // (the rig cameras and the equirectangular model are handled only by g2o)
+    if (use_dedicated_solver_ && rig_frms.empty() && camera->model_type_ != camera::model_type_t::Equirectangular) {
+        return optimize_with_dedicated_solver(cam_pose_cw, frm_obs, orb_params, camera, landmarks,
+                                              optimized_pose, outlier_flags, pose_cov);
+    }
+
     // 1. Construct an optimizer
 
     auto linear_solver = g2o::make_unique<g2o::LinearSolverEigen<g2o::BlockSolver_6_3::PoseMatrixType>>();
@@ -82,6 +119,8 @@ unsigned int pose_optimizer::optimize(const Mat44_t& cam_pose_cw, const data::fr
     constexpr float chi_sq_3D = 7.81473;
     const float sqrt_chi_sq_3D = std::sqrt(chi_sq_3D);
 
+    const auto& undist_keypts = frm_obs.undist_keypts_soa_;
+    assert(undist_keypts.size() == num_keypts);
     for (unsigned int idx = 0; idx < num_keypts; ++idx) {
         const auto& lm = landmarks.at(idx);
         if (!lm) {
@@ -94,19 +133,86 @@ unsigned int pose_optimizer::optimize(const Mat44_t& cam_pose_cw, const data::fr
         ++num_init_obs;
 
         // Connect the frame and the landmark vertices using the projection edges
-        const auto& undist_keypt = frm_obs.undist_keypts_.at(idx);
         const float x_right = frm_obs.stereo_x_right_.empty() ? -1.0f : frm_obs.stereo_x_right_.at(idx);
-        const float inv_sigma_sq = orb_params->inv_level_sigma_sq_.at(undist_keypt.octave);
+        const float inv_sigma_sq = orb_params->inv_level_sigma_sq_.at(undist_keypts.octave_.at(idx));
         const auto sqrt_chi_sq = (camera->setup_type_ == camera::setup_type_t::Monocular)
                                      ? sqrt_chi_sq_2D
                                      : sqrt_chi_sq_3D;
         auto pose_opt_edge_wrap = pose_opt_edge_wrapper(camera, frm_vtx, lm->get_pos_in_world(),
-                                                        idx, undist_keypt.pt.x, undist_keypt.pt.y, x_right,
+                                                        idx, undist_keypts.x_.at(idx), undist_keypts.y_.at(idx), x_right,
                                                         inv_sigma_sq, sqrt_chi_sq);
         pose_opt_edge_wraps.push_back(pose_opt_edge_wrap);
         optimizer.addEdge(pose_opt_edge_wrap.edge_);
     }
 
+    // Connect the landmarks observed in the auxiliary cameras of the rig
+    using rig_pose_opt_edge = internal::se3::mono_rig_pose_opt_edge;
+    // (rig camera index, keypoint index, edge)
+    std::vector<std::tuple<unsigned int, unsigned int, rig_pose_opt_edge*>> rig_pose_opt_edges;
+    rig_outlier_flags.resize(rig_frms.size());
+    for (unsigned int rig_idx = 0; rig_idx < rig_frms.size(); ++rig_idx) {
+        const auto& rig_frm = rig_frms.at(rig_idx)->frm_;
+        const auto& pose_cb = rig_frms.at(rig_idx)->pose_cb_;
+        const auto rig_landmarks = rig_frm.get_landmarks();
+        const auto& rig_undist_keypts = rig_frm.frm_obs_->undist_keypts_soa_;
+        rig_outlier_flags.at(rig_idx).assign(rig_frm.frm_obs_->num_keypts_, false);
+        for (unsigned int idx = 0; idx < rig_frm.frm_obs_->num_keypts_; ++idx) {
+            const auto& lm = rig_landmarks.at(idx);
+            if (!lm) {
+                continue;
+            }
+            if (lm->will_be_erased()) {
+                continue;
+            }
+
+            ++num_init_obs;
+
+            auto edge = new rig_pose_opt_edge();
+            const Vec2_t obs{rig_undist_keypts.x_.at(idx), rig_undist_keypts.y_.at(idx)};
+            edge->setMeasurement(obs);
+            const float inv_sigma_sq = rig_frm.orb_params_->inv_level_sigma_sq_.at(rig_undist_keypts.octave_.at(idx));
+            edge->setInformation(Mat22_t::Identity() * inv_sigma_sq);
+            // (the perspective-like models share the intrinsics of the undistorted keypoints)
+            switch (rig_frm.camera_->model_type_) {
+                case camera::model_type_t::Fisheye: {
+                    const auto c = static_cast<const camera::fisheye*>(rig_frm.camera_);
+                    edge->fx_ = c->fx_;
+                    edge->fy_ = c->fy_;
+                    edge->cx_ = c->cx_;
+                    edge->cy_ = c->cy_;
+                    break;
+                }
+                case camera::model_type_t::RadialDivision: {
+                    const auto c = static_cast<const camera::radial_division*>(rig_frm.camera_);
+                    edge->fx_ = c->fx_;
+                    edge->fy_ = c->fy_;
+                    edge->cx_ = c->cx_;
+                    edge->cy_ = c->cy_;
+                    break;
+                }
+                default: {
+                    const auto c = static_cast<const camera::perspective*>(rig_frm.camera_);
+                    edge->fx_ = c->fx_;
+                    edge->fy_ = c->fy_;
+                    edge->cx_ = c->cx_;
+                    edge->cy_ = c->cy_;
+                    break;
+                }
+            }
+            edge->rot_cb_ = pose_cb.block<3, 3>(0, 0);
+            edge->trans_cb_ = pose_cb.block<3, 1>(0, 3);
+            edge->pos_w_ = lm->get_pos_in_world();
+            edge->setVertex(0, frm_vtx);
+
+            auto huber_kernel = new g2o::RobustKernelHuber();
+            huber_kernel->setDelta(sqrt_chi_sq_2D);
+            edge->setRobustKernel(huber_kernel);
+
+            rig_pose_opt_edges.emplace_back(rig_idx, idx, edge);
+            optimizer.addEdge(edge);
+        }
+    }
+
     if (num_init_obs < 5) {
         return 0;
     }
@@ -155,6 +261,30 @@ unsigned int pose_optimizer::optimize(const Mat44_t& cam_pose_cw, const data::fr
             }
         }
 
+        for (auto& rig_pose_opt_edge : rig_pose_opt_edges) {
+            auto& flags = rig_outlier_flags.at(std::get<0>(rig_pose_opt_edge));
+            const auto idx = std::get<1>(rig_pose_opt_edge);
+            auto edge = std::get<2>(rig_pose_opt_edge);
+
+            if (flags.at(idx)) {
+                edge->computeError();
+            }
+
+            if (chi_sq_2D < edge->chi2() || !edge->depth_is_positive()) {
+                flags.at(idx) = true;
+                edge->setLevel(1);
+                ++num_bad_obs;
+            }
+            else {
+                flags.at(idx) = false;
+                edge->setLevel(0);
+            }
+
+            if (trial == num_trials_ - 2) {
+                edge->setRobustKernel(nullptr);
+            }
+        }
+
         if (num_init_obs - num_bad_obs < 5) {
             break;
         }
@@ -166,8 +296,100 @@ unsigned int pose_optimizer::optimize(const Mat44_t& cam_pose_cw, const data::fr
 
     optimized_pose = frm_vtx->estimate();
 
+    if (pose_cov) {
+        // Invert the Hessian of the inlier observations at the last iteration
+        // (the damping of Levenberg-Marquardt is removed after each iteration)
+        const Mat66_t hessian = frm_vtx->A();
+        const Eigen::LDLT<Mat66_t> ldlt(hessian);
+        if (ldlt.info() == Eigen::Success && ldlt.isPositive() && 0.0 < ldlt.vectorD().minCoeff()) {
+            *pose_cov = ldlt.solve(Mat66_t::Identity());
+        }
+    }
+
     return num_init_obs - num_bad_obs;
 }
 
+unsigned int pose_optimizer::optimize_with_dedicated_solver(const Mat44_t& cam_pose_cw, const data::frame_observation& frm_obs,
+                                                            const feature::orb_params* orb_params,
+                                                            const camera::base* camera,
+                                                            const std::vector<std::shared_ptr<data::landmark>>& landmarks,
+                                                            g2o::SE3Quat& optimized_pose,
+                                                            std::vector<bool>& outlier_flags,
+                                                            Mat66_t* pose_cov) const {
+    // (the perspective-like models share the intrinsics of the undistorted keypoints)
+    pose_solver::intrinsics intr;
+    switch (camera->model_type_) {
+        case camera::model_type_t::Fisheye: {
+            const auto c = static_cast<const camera::fisheye*>(camera);
+            intr.fx_ = c->fx_;
+            intr.fy_ = c->fy_;
+            intr.cx_ = c->cx_;
+            intr.cy_ = c->cy_;
+            break;
+        }
+        case camera::model_type_t::RadialDivision: {
+            const auto c = static_cast<const camera::radial_division*>(camera);
+            intr.fx_ = c->fx_;
+            intr.fy_ = c->fy_;
+            intr.cx_ = c->cx_;
+            intr.cy_ = c->cy_;
+            break;
+        }
+        default: {
+            const auto c = static_cast<const camera::perspective*>(camera);
+            intr.fx_ = c->fx_;
+            intr.fy_ = c->fy_;
+            intr.cx_ = c->cx_;
+            intr.cy_ = c->cy_;
+            break;
+        }
+    }
+    intr.focal_x_baseline_ = camera->focal_x_baseline_;
+
+    const unsigned int num_keypts = frm_obs.num_keypts_;
+    outlier_flags.assign(num_keypts, false);
+
+    // Chi-squared value with significance level of 5% (the Huber kernel is chosen by the setup type as the g2o path)
+    const float sqrt_chi_sq = (camera->setup_type_ == camera::setup_type_t::Monocular)
+                                  ? std::sqrt(5.99146)
+                                  : std::sqrt(7.81473);
+
+    pose_solver solver(num_trials_, num_each_iter_);
+    solver.reserve(num_keypts);
+    std::vector<unsigned int> keypt_idxs;
+    keypt_idxs.reserve(num_keypts);
+
+    const auto& undist_keypts = frm_obs.undist_keypts_soa_;
+    for (unsigned int idx = 0; idx < num_keypts; ++idx) {
+        const auto& lm = landmarks.at(idx);
+        if (!lm) {
+            continue;
+        }
+        if (lm->will_be_erased()) {
+            continue;
+        }
+
+        const float x_right = frm_obs.stereo_x_right_.empty() ? -1.0f : frm_obs.stereo_x_right_.at(idx);
+        const float inv_sigma_sq = orb_params->inv_level_sigma_sq_.at(undist_keypts.octave_.at(idx));
+        solver.add_observation(lm->get_pos_in_world(), undist_keypts.x_.at(idx), undist_keypts.y_.at(idx), x_right,
+                               inv_sigma_sq, sqrt_chi_sq);
+        keypt_idxs.push_back(idx);
+    }
+
+    if (solver.num_observations() < 5) {
+        return 0;
+    }
+
+    Mat44_t pose_cw = cam_pose_cw;
+    std::vector<bool> obs_outlier_flags;
+    const auto num_valid_obs = solver.solve(intr, pose_cw, obs_outlier_flags, pose_cov);
+    for (unsigned int i = 0; i < keypt_idxs.size(); ++i) {
+        outlier_flags.at(keypt_idxs.at(i)) = obs_outlier_flags.at(i);
+    }
+
+    optimized_pose = util::converter::to_g2o_SE3(pose_cw);
+    return num_valid_obs;
+}
+
 } // namespace optimize
 } // namespace stella_vslam
@@ -9,6 +9,7 @@ namespace data {
 class frame;
 struct frame_observation;
 class keyframe;
+struct rig_frame;
 } // namespace data
 
 namespace camera {
@@ -27,8 +28,10 @@ public:
      * Constructor
      * @param num_trials
      * @param num_each_iter
+     * @param use_dedicated_solver if true, use pose_solver instead of g2o for the pinhole-like cameras without the rig cameras
      */
-    explicit pose_optimizer(const unsigned int num_trials = 4, const unsigned int num_each_iter = 10);
+    explicit pose_optimizer(const unsigned int num_trials = 4, const unsigned int num_each_iter = 10,
+                            const bool use_dedicated_solver = false);
 
     /**
      * Destructor
@@ -38,9 +41,14 @@ public:
     /**
      * Perform pose optimization
      * @param frm
+     * @param optimized_pose
+     * @param outlier_flags
+     * @param pose_cov if not nullptr, set to the covariance of the left perturbation [rotation, translation] of the optimized pose
+     *                 (zero if it cannot be estimated)
      * @return
      */
-    unsigned int optimize(const data::frame& frm, g2o::SE3Quat& optimized_pose, std::vector<bool>& outlier_flags) const;
+    unsigned int optimize(const data::frame& frm, g2o::SE3Quat& optimized_pose, std::vector<bool>& outlier_flags,
+                          Mat66_t* pose_cov = nullptr) const;
     unsigned int optimize(const data::keyframe* keyfrm, g2o::SE3Quat& optimized_pose, std::vector<bool>& outlier_flags) const;
 
     unsigned int optimize(const Mat44_t& cam_pose_cw, const data::frame_observation& frm_obs,
@@ -50,12 +58,46 @@ public:
                           g2o::SE3Quat& optimized_pose,
                           std::vector<bool>& outlier_flags) const;
 
+    /**
+     * Perform pose optimization jointly with the observations of the auxiliary cameras of the multi-camera rig
+     * @param frm
+     * @param optimized_pose
+     * @param outlier_flags
+     * @param rig_outlier_flags (the outlier flags of frm.rig_frms_.at(i) are stored in the i-th element)
+     * @param pose_cov if not nullptr, set to the covariance of the optimized pose (zero if it cannot be estimated)
+     * @return the number of the valid observations (including the ones of the rig cameras)
+     */
+    unsigned int optimize(const data::frame& frm, g2o::SE3Quat& optimized_pose, std::vector<bool>& outlier_flags,
+                          std::vector<std::vector<bool>>& rig_outlier_flags, Mat66_t* pose_cov = nullptr) const;
+
 private:
+    unsigned int optimize(const Mat44_t& cam_pose_cw, const data::frame_observation& frm_obs,
+                          const feature::orb_params* orb_params,
+                          const camera::base* camera,
+                          const std::vector<std::shared_ptr<data::landmark>>& landmarks,
+                          const std::vector<std::shared_ptr<data::rig_frame>>& rig_frms,
+                          g2o::SE3Quat& optimized_pose,
+                          std::vector<bool>& outlier_flags,
+                          std::vector<std::vector<bool>>& rig_outlier_flags,
+                          Mat66_t* pose_cov) const;
+
+    //! Perform pose optimization with pose_solver
+    unsigned int optimize_with_dedicated_solver(const Mat44_t& cam_pose_cw, const data::frame_observation& frm_obs,
+                                                const feature::orb_params* orb_params,
+                                                const camera::base* camera,
+                                                const std::vector<std::shared_ptr<data::landmark>>& landmarks,
+                                                g2o::SE3Quat& optimized_pose,
+                                                std::vector<bool>& outlier_flags,
+                                                Mat66_t* pose_cov) const;
+
     //! robust optimizationの試行回数
     const unsigned int num_trials_ = 4;
 
     //! 毎回のoptimizationのiteration回数
     const unsigned int num_each_iter_ = 10;
+
+    //! use pose_solver instead of g2o or not
+    const bool use_dedicated_solver_ = false;
 };
 
 } // namespace optimize
@@ -0,0 +1,324 @@
+#include "stella_vslam/optimize/pose_solver.h"
+
+#include <cmath>
+#include <limits>
+
+#include <Eigen/Cholesky>
+
+namespace stella_vslam {
+namespace optimize {
+
+namespace {
+//! Huber kernel (the same as g2o::RobustKernelHuber): the robust error and the weight of the information matrix
+inline void robustify(const double chi_sq, const double delta, double& robust_chi_sq, double& weight) {
+    const double delta_sq = delta * delta;
+    if (chi_sq <= delta_sq) {
+        robust_chi_sq = chi_sq;
+        weight = 1.0;
+    }
+    else {
+        const double sqrt_chi_sq = std::sqrt(chi_sq);
+        robust_chi_sq = 2.0 * sqrt_chi_sq * delta - delta_sq;
+        weight = delta / sqrt_chi_sq;
+    }
+}
+
+//! Normalize the rotation in the same way as g2o::SE3Quat
+inline void normalize_rotation(Quat_t& rot) {
+    if (rot.w() < 0.0) {
+        rot.coeffs() *= -1.0;
+    }
+    rot.normalize();
+}
+
+//! Left-multiply the exponential of the perturbation [rotation, translation] (the same as g2o::SE3Quat::exp(update) * pose)
+inline void apply_update(const Vec6_t& update, Quat_t& rot, Vec3_t& trans) {
+    const Vec3_t omega = update.head<3>();
+    const Vec3_t upsilon = update.tail<3>();
+    const double theta = omega.norm();
+
+    Mat33_t skew_omega;
+    skew_omega << 0.0, -omega(2), omega(1),
+        omega(2), 0.0, -omega(0),
+        -omega(1), omega(0), 0.0;
+    const Mat33_t skew_omega_sq = skew_omega * skew_omega;
+
+    Mat33_t rot_exp;
+    Mat33_t left_jacobian;
+    if (theta < 0.00001) {
+        rot_exp = Mat33_t::Identity() + skew_omega + skew_omega_sq;
+        left_jacobian = rot_exp;
+    }
+    else {
+        const double theta_sq = theta * theta;
+        rot_exp = Mat33_t::Identity() + std::sin(theta) / theta * skew_omega + (1.0 - std::cos(theta)) / theta_sq * skew_omega_sq;
+        left_jacobian = Mat33_t::Identity() + (1.0 - std::cos(theta)) / theta_sq * skew_omega
+                        + (theta - std::sin(theta)) / (theta_sq * theta) * skew_omega_sq;
+    }
+
+    Quat_t quat_exp(rot_exp);
+    normalize_rotation(quat_exp);
+    trans = quat_exp * trans + left_jacobian * upsilon;
+    rot = quat_exp * rot;
+    normalize_rotation(rot);
+}
+} // namespace
+
+pose_solver::pose_solver(const unsigned int num_trials, const unsigned int num_each_iter)
+    : num_trials_(num_trials), num_each_iter_(num_each_iter) {}
+
+void pose_solver::clear() {
+    pos_w_.clear();
+    obs_.clear();
+    inv_sigma_sq_.clear();
+    huber_delta_.clear();
+    is_monocular_.clear();
+}
+
+void pose_solver::reserve(const unsigned int num_obs) {
+    pos_w_.reserve(num_obs);
+    obs_.reserve(num_obs);
+    inv_sigma_sq_.reserve(num_obs);
+    huber_delta_.reserve(num_obs);
+    is_monocular_.reserve(num_obs);
+}
+
+void pose_solver::add_observation(const Vec3_t& pos_w, const float x, const float y, const float x_right,
+                                  const float inv_sigma_sq, const float sqrt_chi_sq) {
+    pos_w_.push_back(pos_w.cast<tracking_real_t>());
+    obs_.emplace_back(x, y, x_right);
+    inv_sigma_sq_.push_back(inv_sigma_sq);
+    huber_delta_.push_back(sqrt_chi_sq);
+    is_monocular_.push_back(x_right < 0);
+}
+
+unsigned int pose_solver::solve(const intrinsics& intr, Mat44_t& cam_pose_cw, std::vector<bool>& outlier_flags,
+                                Mat66_t* pose_cov) const {
+    if (pose_cov) {
+        pose_cov->setZero();
+    }
+
+    const unsigned int num_obs = num_observations();
+    outlier_flags.assign(num_obs, false);
+
+    Quat_t rot_cw(Mat33_t(cam_pose_cw.block<3, 3>(0, 0)));
+    normalize_rotation(rot_cw);
+    Vec3_t trans_cw = cam_pose_cw.block<3, 1>(0, 3);
+
+    // Perform the robust optimization, then reject the outliers in each trial
+    // (the robust kernel is removed in the last trial)
+    Mat66_t hessian = Mat66_t::Zero();
+    unsigned int num_bad_obs = 0;
+    for (unsigned int trial = 0; trial < num_trials_; ++trial) {
+        const bool use_robust_kernel = num_trials_ < 2 || trial < num_trials_ - 1;
+        optimize(intr, rot_cw, trans_cw, outlier_flags, use_robust_kernel, hessian);
+
+        num_bad_obs = 0;
+        const TrkMat33_t rot_cw_mat = rot_cw.toRotationMatrix().cast<tracking_real_t>();
+        const TrkVec3_t trans_cw_trk = trans_cw.cast<tracking_real_t>();
+        for (unsigned int idx = 0; idx < num_obs; ++idx) {
+            TrkVec3_t error;
+            const auto dim = compute_error(intr, rot_cw_mat * pos_w_.at(idx) + trans_cw_trk, idx, error);
+            const double chi_sq = inv_sigma_sq_.at(idx) * error.head(dim).squaredNorm();
+            if ((is_monocular_.at(idx) ? chi_sq_2D_ : chi_sq_3D_) < chi_sq) {
+                outlier_flags.at(idx) = true;
+                ++num_bad_obs;
+            }
+            else {
+                outlier_flags.at(idx) = false;
+            }
+        }
+
+        if (num_obs - num_bad_obs < 5) {
+            break;
+        }
+    }
+
+    cam_pose_cw = Mat44_t::Identity();
+    cam_pose_cw.block<3, 3>(0, 0) = rot_cw.toRotationMatrix();
+    cam_pose_cw.block<3, 1>(0, 3) = trans_cw;
+
+    if (pose_cov) {
+        // Invert the Hessian of the inlier observations at the last iteration
+        const Eigen::LDLT<Mat66_t> ldlt(hessian);
+        if (ldlt.info() == Eigen::Success && ldlt.isPositive() && 0.0 < ldlt.vectorD().minCoeff()) {
+            *pose_cov = ldlt.solve(Mat66_t::Identity());
+        }
+    }
+
+    return num_obs - num_bad_obs;
+}
+
+void pose_solver::optimize(const intrinsics& intr, Quat_t& rot_cw, Vec3_t& trans_cw, const std::vector<bool>& outlier_flags,
+                           const bool use_robust_kernel, Mat66_t& hessian) const {
+    // (the same parameters as g2o::OptimizationAlgorithmLevenberg and terminate_action)
+    constexpr double tau = 1e-5;
+    constexpr unsigned int max_trials_after_failure = 10;
+    constexpr double gain_threshold = 1e-3;
+
+    const unsigned int num_obs = num_observations();
+    double chi_sq = compute_chi_sq(intr, rot_cw, trans_cw, outlier_flags, use_robust_kernel);
+    double last_chi_sq = chi_sq;
+    double lambda = 0.0;
+    double ni = 2.0;
+
+    for (unsigned int iter = 0; iter < num_each_iter_; ++iter) {
+        // Accumulate the normal equation at the current pose
+        Mat66_t H = Mat66_t::Zero();
+        Vec6_t b = Vec6_t::Zero();
+        const TrkMat33_t rot_cw_mat = rot_cw.toRotationMatrix().cast<tracking_real_t>();
+        const TrkVec3_t trans_cw_trk = trans_cw.cast<tracking_real_t>();
+        const auto fx = static_cast<tracking_real_t>(intr.fx_);
+        const auto fy = static_cast<tracking_real_t>(intr.fy_);
+        const auto focal_x_baseline = static_cast<tracking_real_t>(intr.focal_x_baseline_);
+        for (unsigned int idx = 0; idx < num_obs; ++idx) {
+            if (outlier_flags.at(idx)) {
+                continue;
+            }
+
+            const TrkVec3_t pos_c = rot_cw_mat * pos_w_.at(idx) + trans_cw_trk;
+            TrkVec3_t error;
+            const auto dim = compute_error(intr, pos_c, idx, error);
+
+            double weight = 1.0;
+            if (use_robust_kernel) {
+                double robust_chi_sq;
+                robustify(inv_sigma_sq_.at(idx) * error.head(dim).squaredNorm(), huber_delta_.at(idx), robust_chi_sq, weight);
+            }
+            const double info = weight * inv_sigma_sq_.at(idx);
+
+            // Jacobian of the error w.r.t. the left perturbation of the pose
+            const tracking_real_t x = pos_c(0);
+            const tracking_real_t y = pos_c(1);
+            const tracking_real_t z = pos_c(2);
+            const tracking_real_t inv_z = 1 / z;
+            const tracking_real_t inv_z_sq = inv_z * inv_z;
+            Eigen::Matrix<tracking_real_t, 3, 6> jacobian;
+            jacobian(0, 0) = x * y * inv_z_sq * fx;
+            jacobian(0, 1) = -(1 + x * x * inv_z_sq) * fx;
+            jacobian(0, 2) = y * inv_z * fx;
+            jacobian(0, 3) = -inv_z * fx;
+            jacobian(0, 4) = 0;
+            jacobian(0, 5) = x * inv_z_sq * fx;
+
+            jacobian(1, 0) = (1 + y * y * inv_z_sq) * fy;
+            jacobian(1, 1) = -x * y * inv_z_sq * fy;
+            jacobian(1, 2) = -x * inv_z * fy;
+            jacobian(1, 3) = 0;
+            jacobian(1, 4) = -inv_z * fy;
+            jacobian(1, 5) = y * inv_z_sq * fy;
+
+            if (dim == 2) {
+                const MatRC_t<2, 6> J = jacobian.topRows<2>().cast<double>();
+                H.noalias() += info * J.transpose() * J;
+                b.noalias() -= info * J.transpose() * error.head<2>().cast<double>();
+            }
+            else {
+                jacobian(2, 0) = jacobian(0, 0) - focal_x_baseline * y * inv_z_sq;
+                jacobian(2, 1) = jacobian(0, 1) + focal_x_baseline * x * inv_z_sq;
+                jacobian(2, 2) = jacobian(0, 2);
+                jacobian(2, 3) = jacobian(0, 3);
+                jacobian(2, 4) = 0;
+                jacobian(2, 5) = jacobian(0, 5) - focal_x_baseline * inv_z_sq;
+                const MatRC_t<3, 6> J = jacobian.cast<double>();
+                H.noalias() += info * J.transpose() * J;
+                b.noalias() -= info * J.transpose() * error.cast<double>();
+            }
+        }
+        hessian = H;
+
+        if (iter == 0) {
+            lambda = tau * H.diagonal().maxCoeff();
+            ni = 2.0;
+        }
+
+        // Solve the damped system until the error decreases
+        double rho = 0.0;
+        unsigned int num_failures = 0;
+        do {
+            const Mat66_t H_damped = H + lambda * Mat66_t::Identity();
+            const Eigen::LDLT<Mat66_t> ldlt(H_damped);
+            const Vec6_t delta = ldlt.solve(b);
+
+            Quat_t new_rot_cw = rot_cw;
+            Vec3_t new_trans_cw = trans_cw;
+            apply_update(delta, new_rot_cw, new_trans_cw);
+            double new_chi_sq = compute_chi_sq(intr, new_rot_cw, new_trans_cw, outlier_flags, use_robust_kernel);
+            if (ldlt.info() != Eigen::Success || !std::isfinite(new_chi_sq)) {
+                new_chi_sq = std::numeric_limits<double>::max();
+            }
+
+            const double scale = delta.dot(lambda * delta + b) + 1e-3;
+            rho = (chi_sq - new_chi_sq) / scale;
+            if (0.0 < rho && std::isfinite(new_chi_sq)) {
+                // accept the update
+                const double alpha = std::min(1.0 - std::pow(2.0 * rho - 1.0, 3), 2.0 / 3.0);
+                lambda *= std::max(1.0 / 3.0, alpha);
+                ni = 2.0;
+                rot_cw = new_rot_cw;
+                trans_cw = new_trans_cw;
+                chi_sq = new_chi_sq;
+            }
+            else {
+                lambda *= ni;
+                ni *= 2.0;
+            }
+            ++num_failures;
+        } while (rho < 0.0 && num_failures < max_trials_after_failure);
+
+        if (num_failures == max_trials_after_failure || rho == 0.0 || !std::isfinite(chi_sq)) {
+            break;
+        }
+
+        // Stop if the gain of the error is below the threshold
+        if (0 < iter) {
+            const double gain = (last_chi_sq - chi_sq) / chi_sq;
+            if (0.0 <= gain && gain < gain_threshold) {
+                break;
+            }
+        }
+        last_chi_sq = chi_sq;
+    }
+}
+
+double pose_solver::compute_chi_sq(const intrinsics& intr, const Quat_t& rot_cw, const Vec3_t& trans_cw,
+                                   const std::vector<bool>& outlier_flags, const bool use_robust_kernel) const {
+    double sum_chi_sq = 0.0;
+    const TrkMat33_t rot_cw_mat = rot_cw.toRotationMatrix().cast<tracking_real_t>();
+    const TrkVec3_t trans_cw_trk = trans_cw.cast<tracking_real_t>();
+    for (unsigned int idx = 0; idx < num_observations(); ++idx) {
+        if (outlier_flags.at(idx)) {
+            continue;
+        }
+        TrkVec3_t error;
+        const auto dim = compute_error(intr, rot_cw_mat * pos_w_.at(idx) + trans_cw_trk, idx, error);
+        const double chi_sq = inv_sigma_sq_.at(idx) * error.head(dim).squaredNorm();
+        if (use_robust_kernel) {
+            double robust_chi_sq;
+            double weight;
+            robustify(chi_sq, huber_delta_.at(idx), robust_chi_sq, weight);
+            sum_chi_sq += robust_chi_sq;
+        }
+        else {
+            sum_chi_sq += chi_sq;
+        }
+    }
+    return sum_chi_sq;
+}
+
+unsigned int pose_solver::compute_error(const intrinsics& intr, const TrkVec3_t& pos_c, const unsigned int idx, TrkVec3_t& error) const {
+    const auto& obs = obs_.at(idx);
+    const tracking_real_t inv_z = 1 / pos_c(2);
+    const tracking_real_t reproj_x = static_cast<tracking_real_t>(intr.fx_) * pos_c(0) * inv_z + static_cast<tracking_real_t>(intr.cx_);
+    error(0) = obs(0) - reproj_x;
+    error(1) = obs(1) - (static_cast<tracking_real_t>(intr.fy_) * pos_c(1) * inv_z + static_cast<tracking_real_t>(intr.cy_));
+    if (is_monocular_.at(idx)) {
+        error(2) = 0;
+        return 2;
+    }
+    error(2) = obs(2) - (reproj_x - static_cast<tracking_real_t>(intr.focal_x_baseline_) * inv_z);
+    return 3;
+}
+
+} // namespace optimize
+} // namespace stella_vslam
@@ -0,0 +1,91 @@
+#ifndef STELLA_VSLAM_OPTIMIZE_POSE_SOLVER_H
+#define STELLA_VSLAM_OPTIMIZE_POSE_SOLVER_H
+
+#include "stella_vslam/type.h"
+
+#include <vector>
+
+namespace stella_vslam {
+namespace optimize {
+
+/**
+ * Levenberg-Marquardt solver dedicated to a single camera pose observing fixed landmarks with a pinhole model
+ * (the same formulation as pose_optimizer with g2o: the left perturbation [rotation, translation] of cam_pose_cw,
+ *  the Huber kernel and the outlier rejection rounds, but without the graph and the edge objects)
+ */
+class pose_solver {
+public:
+    //! Intrinsics of the undistorted keypoints
+    struct intrinsics {
+        double fx_ = 0.0;
+        double fy_ = 0.0;
+        double cx_ = 0.0;
+        double cy_ = 0.0;
+        //! (used only for the stereo observations)
+        double focal_x_baseline_ = 0.0;
+    };
+
+    /**
+     * Constructor
+     * @param num_trials
+     * @param num_each_iter
+     */
+    explicit pose_solver(const unsigned int num_trials = 4, const unsigned int num_each_iter = 10);
+
+    //! Remove the observations
+    void clear();
+
+    //! Reserve the buffers of the observations
+    void reserve(const unsigned int num_obs);
+
+    //! Add the observation of the landmark (x_right < 0 if it is monocular, sqrt_chi_sq is the delta of the Huber kernel)
+    void add_observation(const Vec3_t& pos_w, const float x, const float y, const float x_right,
+                         const float inv_sigma_sq, const float sqrt_chi_sq);
+
+    //! Number of the observations
+    unsigned int num_observations() const { return static_cast<unsigned int>(pos_w_.size()); }
+
+    /**
+     * Optimize the camera pose
+     * @param intr
+     * @param cam_pose_cw initial pose, which is overwritten with the optimized one
+     * @param outlier_flags set in the order of add_observation()
+     * @param pose_cov if not nullptr, set to the covariance of the left perturbation of the optimized pose (zero if it cannot be estimated)
+     * @return the number of the inliers
+     */
+    unsigned int solve(const intrinsics& intr, Mat44_t& cam_pose_cw, std::vector<bool>& outlier_flags,
+                       Mat66_t* pose_cov = nullptr) const;
+
+private:
+    //! Run the Levenberg-Marquardt iterations on the inliers (the same damping control as g2o::OptimizationAlgorithmLevenberg)
+    void optimize(const intrinsics& intr, Quat_t& rot_cw, Vec3_t& trans_cw, const std::vector<bool>& outlier_flags,
+                  const bool use_robust_kernel, Mat66_t& hessian) const;
+
+    //! Compute the (robust) chi-squared error of the inliers
+    double compute_chi_sq(const intrinsics& intr, const Quat_t& rot_cw, const Vec3_t& trans_cw,
+                          const std::vector<bool>& outlier_flags, const bool use_robust_kernel) const;
+
+    //! Compute the reprojection error of the observation (return the dimension of the error)
+    unsigned int compute_error(const intrinsics& intr, const TrkVec3_t& pos_c, const unsigned int idx, TrkVec3_t& error) const;
+
+    //! Chi-squared value with significance level of 5% (two and three degree-of-freedom)
+    static constexpr double chi_sq_2D_ = 5.99146;
+    static constexpr double chi_sq_3D_ = 7.81473;
+
+    const unsigned int num_trials_;
+    const unsigned int num_each_iter_;
+
+    //! observations
+    //! (the per-observation errors and Jacobians are computed in tracking_real_t, the normal equation is accumulated in double)
+    eigen_alloc_vector<TrkVec3_t> pos_w_;
+    //! (x, y, x_right) of the keypoints
+    eigen_alloc_vector<TrkVec3_t> obs_;
+    std::vector<double> inv_sigma_sq_;
+    std::vector<double> huber_delta_;
+    std::vector<bool> is_monocular_;
+};
+
+} // namespace optimize
+} // namespace stella_vslam
+
+#endif // STELLA_VSLAM_OPTIMIZE_POSE_SOLVER_H
@@ -47,10 +47,17 @@ g2o::HyperGraphAction* terminate_action::operator()(
         // Hence, we reset the stop flag
         setOptimizerStopFlag(optimizer, false);
         stopped_by_terminate_action_ = false;
+        stopped_by_deadline_ = false;
+        stopped_by_abort_request_ = false;
     }
     else if (params->iteration == 0) {
         // first iteration, just store the chi2 value
         _lastChi = optimizer->activeRobustChi2();
+        if (abort_is_requested(params->iteration)) {
+            setOptimizerStopFlag(optimizer, true);
+            stopped_by_terminate_action_ = true;
+            stopped_by_abort_request_ = true;
+        }
     }
     else {
         // compute the gain and stop the optimizer in case the
@@ -67,6 +74,14 @@ g2o::HyperGraphAction* terminate_action::operator()(
         else {
             stopOptimizer = true;
         }
+        if (has_deadline_ && deadline_ <= std::chrono::steady_clock::now()) {
+            stopOptimizer = true;
+            stopped_by_deadline_ = true;
+        }
+        if (abort_is_requested(params->iteration)) {
+            stopOptimizer = true;
+            stopped_by_abort_request_ = true;
+        }
         if (stopOptimizer) { // tell the optimizer to stop
             setOptimizerStopFlag(optimizer, true);
             stopped_by_terminate_action_ = true;
@@ -75,5 +90,22 @@ g2o::HyperGraphAction* terminate_action::operator()(
     return this;
 }
 
+void terminate_action::set_deadline(const std::chrono::steady_clock::time_point& deadline) {
+    has_deadline_ = true;
+    deadline_ = deadline;
+}
+
+void terminate_action::set_abort_request_flag(const bool* const abort_request_flag, const unsigned int min_num_iter) {
+    abort_request_flag_ = abort_request_flag;
+    min_num_iter_before_abort_ = min_num_iter;
+    stopped_by_abort_request_ = false;
+}
+
+bool terminate_action::abort_is_requested(const int iteration) const {
+    // (the iteration index starts from 0)
+    return abort_request_flag_ && *abort_request_flag_
+           && min_num_iter_before_abort_ <= static_cast<unsigned int>(iteration + 1);
+}
+
 } // namespace optimize
 } // namespace stella_vslam
@@ -29,6 +29,8 @@
 #ifndef STELLA_VSLAM_OPTIMIZE_TERMINATE_ACTION_H
 #define STELLA_VSLAM_OPTIMIZE_TERMINATE_ACTION_H
 
+#include <chrono>
+
 #include <g2o/core/hyper_graph_action.h>
 #include <g2o/core/sparse_optimizer_terminate_action.h>
 
@@ -40,7 +42,28 @@ class terminate_action : public g2o::SparseOptimizerTerminateAction {
         const g2o::HyperGraph* graph, Parameters* parameters) override;
 
 public:
+    //! Stop the optimization after the iteration which exceeds the deadline
+    void set_deadline(const std::chrono::steady_clock::time_point& deadline);
+
+    //! Stop the optimization when the request flag is set, but not before the minimum number of iterations
+    //! (the flag is only read, so that the requester can distinguish its request from the convergence)
+    void set_abort_request_flag(const bool* const abort_request_flag, const unsigned int min_num_iter = 0);
+
     bool stopped_by_terminate_action_ = false;
+    //! The optimization was stopped by the deadline or not (a subset of stopped_by_terminate_action_)
+    bool stopped_by_deadline_ = false;
+    //! The optimization was stopped by the abort request or not (a subset of stopped_by_terminate_action_)
+    bool stopped_by_abort_request_ = false;
+
+private:
+    //! The abort is requested and the minimum number of iterations has been performed or not
+    bool abort_is_requested(const int iteration) const;
+
+    bool has_deadline_ = false;
+    std::chrono::steady_clock::time_point deadline_;
+
+    const bool* abort_request_flag_ = nullptr;
+    unsigned int min_num_iter_before_abort_ = 0;
 };
 
 } // namespace optimize
@@ -1,6 +1,13 @@
+#include "stella_vslam/camera/base.h"
+#include "stella_vslam/camera/equirectangular.h"
+#include "stella_vslam/camera/fisheye.h"
+#include "stella_vslam/camera/perspective.h"
+#include "stella_vslam/camera/radial_division.h"
 #include "stella_vslam/data/keyframe.h"
 #include "stella_vslam/data/landmark.h"
+#include "stella_vslam/feature/orb_params.h"
 #include "stella_vslam/optimize/transform_optimizer.h"
+#include "stella_vslam/optimize/transform_solver.h"
 #include "stella_vslam/optimize/internal/sim3/transform_vertex.h"
 #include "stella_vslam/optimize/internal/sim3/mutual_reproj_edge_wrapper.h"
 
@@ -14,12 +21,57 @@
 namespace stella_vslam {
 namespace optimize {
 
-transform_optimizer::transform_optimizer(const bool fix_scale, const unsigned int num_iter)
-    : fix_scale_(fix_scale), num_iter_(num_iter) {}
+namespace {
+//! Camera model of transform_solver (the perspective-like models share the intrinsics of the undistorted keypoints)
+transform_solver::camera_model get_camera_model(const camera::base* camera) {
+    transform_solver::camera_model cam;
+    switch (camera->model_type_) {
+        case camera::model_type_t::Equirectangular: {
+            const auto c = static_cast<const camera::equirectangular*>(camera);
+            cam.is_equirectangular_ = true;
+            cam.cols_ = c->cols_;
+            cam.rows_ = c->rows_;
+            break;
+        }
+        case camera::model_type_t::Fisheye: {
+            const auto c = static_cast<const camera::fisheye*>(camera);
+            cam.fx_ = c->fx_;
+            cam.fy_ = c->fy_;
+            cam.cx_ = c->cx_;
+            cam.cy_ = c->cy_;
+            break;
+        }
+        case camera::model_type_t::RadialDivision: {
+            const auto c = static_cast<const camera::radial_division*>(camera);
+            cam.fx_ = c->fx_;
+            cam.fy_ = c->fy_;
+            cam.cx_ = c->cx_;
+            cam.cy_ = c->cy_;
+            break;
+        }
+        default: {
+            const auto c = static_cast<const camera::perspective*>(camera);
+            cam.fx_ = c->fx_;
+            cam.fy_ = c->fy_;
+            cam.cx_ = c->cx_;
+            cam.cy_ = c->cy_;
+            break;
+        }
+    }
+    return cam;
+}
+} // namespace
+
+transform_optimizer::transform_optimizer(const bool fix_scale, const unsigned int num_iter, const bool use_dedicated_solver)
+    : fix_scale_(fix_scale), num_iter_(num_iter), use_dedicated_solver_(use_dedicated_solver) {}
 
 unsigned int transform_optimizer::optimize(const std::shared_ptr<data::keyframe>& keyfrm_1, const std::shared_ptr<data::keyframe>& keyfrm_2,
                                            std::vector<std::shared_ptr<data::landmark>>& matched_lms_in_keyfrm_2,
                                            ::g2o::Sim3& g2o_Sim3_12, const float chi_sq) const {
+    if (use_dedicated_solver_) {
+        return optimize_with_dedicated_solver(keyfrm_1, keyfrm_2, matched_lms_in_keyfrm_2, g2o_Sim3_12, chi_sq);
+    }
+
     const float sqrt_chi_sq = std::sqrt(chi_sq);
 
     // 1. Construct an optimizer
@@ -157,5 +209,73 @@ unsigned int transform_optimizer::optimize(const std::shared_ptr<data::keyframe>
     return num_inliers;
 }
 
+unsigned int transform_optimizer::optimize_with_dedicated_solver(const std::shared_ptr<data::keyframe>& keyfrm_1, const std::shared_ptr<data::keyframe>& keyfrm_2,
+                                                            std::vector<std::shared_ptr<data::landmark>>& matched_lms_in_keyfrm_2,
+                                                            ::g2o::Sim3& g2o_Sim3_12, const float chi_sq) const {
+    // (the candidates are verified in parallel, so each thread reuses its own buffers)
+    thread_local transform_solver solver;
+    solver.clear();
+
+    const Mat33_t rot_1w = keyfrm_1->get_rot_cw();
+    const Vec3_t trans_1w = keyfrm_1->get_trans_cw();
+    const Mat33_t rot_2w = keyfrm_2->get_rot_cw();
+    const Vec3_t trans_2w = keyfrm_2->get_trans_cw();
+
+    const unsigned int num_matches = matched_lms_in_keyfrm_2.size();
+    solver.reserve(num_matches);
+    std::vector<unsigned int> idxs_1;
+    idxs_1.reserve(num_matches);
+
+    // Add the same matches as the edges of the g2o path
+    const auto lms_in_keyfrm_1 = keyfrm_1->get_landmarks();
+    for (unsigned int idx1 = 0; idx1 < num_matches; ++idx1) {
+        const auto& lm_2 = matched_lms_in_keyfrm_2.at(idx1);
+        if (!lm_2) {
+            continue;
+        }
+        const auto& lm_1 = lms_in_keyfrm_1.at(idx1);
+        if (!lm_1) {
+            continue;
+        }
+        if (lm_1->will_be_erased() || lm_2->will_be_erased()) {
+            continue;
+        }
+
+        const auto idx2 = lm_2->get_index_in_keyframe(keyfrm_2);
+        if (idx2 < 0) {
+            continue;
+        }
+
+        const auto& undist_keypt_1 = keyfrm_1->frm_obs_->undist_keypts_.at(idx1);
+        const auto& undist_keypt_2 = keyfrm_2->frm_obs_->undist_keypts_.at(idx2);
+        solver.add_match(rot_2w * lm_2->get_pos_in_world() + trans_2w, Vec2_t{undist_keypt_1.pt.x, undist_keypt_1.pt.y},
+                         keyfrm_1->orb_params_->inv_level_sigma_sq_.at(undist_keypt_1.octave),
+                         rot_1w * lm_1->get_pos_in_world() + trans_1w, Vec2_t{undist_keypt_2.pt.x, undist_keypt_2.pt.y},
+                         keyfrm_2->orb_params_->inv_level_sigma_sq_.at(undist_keypt_2.octave));
+        idxs_1.push_back(idx1);
+    }
+
+    Mat33_t rot_12 = g2o_Sim3_12.rotation().toRotationMatrix();
+    Vec3_t trans_12 = g2o_Sim3_12.translation();
+    double scale_12 = g2o_Sim3_12.scale();
+    std::vector<bool> outlier_flags;
+    const auto num_inliers = solver.solve(get_camera_model(keyfrm_1->camera_), get_camera_model(keyfrm_2->camera_), fix_scale_,
+                                          5, num_iter_, chi_sq, rot_12, trans_12, scale_12, outlier_flags);
+
+    // Reject the outliers
+    for (unsigned int i = 0; i < idxs_1.size(); ++i) {
+        if (outlier_flags.at(i)) {
+            matched_lms_in_keyfrm_2.at(idxs_1.at(i)) = nullptr;
+        }
+    }
+
+    if (num_inliers == 0) {
+        return 0;
+    }
+
+    g2o_Sim3_12 = ::g2o::Sim3(rot_12, trans_12, scale_12);
+    return num_inliers;
+}
+
 } // namespace optimize
 } // namespace stella_vslam
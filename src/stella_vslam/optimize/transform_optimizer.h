@@ -21,8 +21,10 @@ public:
      * Constructor
      * @param fix_scale
      * @param num_iter
+     * @param use_dedicated_solver if true, use transform_solver instead of g2o
      */
-    explicit transform_optimizer(const bool fix_scale, const unsigned int num_iter = 10);
+    explicit transform_optimizer(const bool fix_scale, const unsigned int num_iter = 10,
+                                 const bool use_dedicated_solver = false);
 
     /**
      * Destructor
@@ -43,11 +45,19 @@ public:
                           g2o::Sim3& g2o_Sim3_12, const float chi_sq) const;
 
 private:
+    //! Perform optimization with transform_solver
+    unsigned int optimize_with_dedicated_solver(const std::shared_ptr<data::keyframe>& keyfrm_1, const std::shared_ptr<data::keyframe>& keyfrm_2,
+                                                std::vector<std::shared_ptr<data::landmark>>& matched_lms_in_keyfrm_2,
+                                                g2o::Sim3& g2o_Sim3_12, const float chi_sq) const;
+
     //! transform is Sim3 or SE3
     const bool fix_scale_;
 
     //! number of iterations of optimization
     const unsigned int num_iter_;
+
+    //! use transform_solver instead of g2o or not
+    const bool use_dedicated_solver_ = false;
 };
 
 } // namespace optimize
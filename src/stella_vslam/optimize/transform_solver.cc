@@ -0,0 +1,390 @@
+#include "stella_vslam/optimize/transform_solver.h"
+
+#include <cmath>
+#include <limits>
+
+#include <Eigen/Cholesky>
+
+namespace stella_vslam {
+namespace optimize {
+
+namespace {
+//! Huber kernel (the same as g2o::RobustKernelHuber): the robust error and the weight of the information matrix
+inline void robustify(const double chi_sq, const double delta, double& robust_chi_sq, double& weight) {
+    const double delta_sq = delta * delta;
+    if (chi_sq <= delta_sq) {
+        robust_chi_sq = chi_sq;
+        weight = 1.0;
+    }
+    else {
+        const double sqrt_chi_sq = std::sqrt(chi_sq);
+        robust_chi_sq = 2.0 * sqrt_chi_sq * delta - delta_sq;
+        weight = delta / sqrt_chi_sq;
+    }
+}
+
+inline Mat33_t skew(const Vec3_t& v) {
+    Mat33_t skew_v;
+    skew_v << 0.0, -v(2), v(1),
+        v(2), 0.0, -v(0),
+        -v(1), v(0), 0.0;
+    return skew_v;
+}
+
+//! Left-multiply the exponential of the perturbation [rotation, translation, scale] (the same as g2o::Sim3(update) * Sim3)
+inline void apply_update(const Vec7_t& update, Quat_t& rot, Vec3_t& trans, double& scale) {
+    const Vec3_t omega = update.head<3>();
+    const Vec3_t upsilon = update.segment<3>(3);
+    const double sigma = update(6);
+    const double theta = omega.norm();
+
+    const Mat33_t skew_omega = skew(omega);
+    const Mat33_t skew_omega_sq = skew_omega * skew_omega;
+    const double scale_exp = std::exp(sigma);
+
+    constexpr double eps = 0.00001;
+    Mat33_t rot_exp;
+    double A, B, C;
+    if (theta < eps) {
+        rot_exp = Mat33_t::Identity() + skew_omega + skew_omega_sq;
+    }
+    else {
+        rot_exp = Mat33_t::Identity() + std::sin(theta) / theta * skew_omega + (1.0 - std::cos(theta)) / (theta * theta) * skew_omega_sq;
+    }
+    if (std::abs(sigma) < eps) {
+        C = 1.0;
+        if (theta < eps) {
+            A = 0.5;
+            B = 1.0 / 6.0;
+        }
+        else {
+            const double theta_sq = theta * theta;
+            A = (1.0 - std::cos(theta)) / theta_sq;
+            B = (theta - std::sin(theta)) / (theta_sq * theta);
+        }
+    }
+    else {
+        C = (scale_exp - 1.0) / sigma;
+        const double sigma_sq = sigma * sigma;
+        if (theta < eps) {
+            A = ((sigma - 1.0) * scale_exp + 1.0) / sigma_sq;
+            B = ((0.5 * sigma_sq - sigma + 1.0) * scale_exp - 1.0) / (sigma_sq * sigma);
+        }
+        else {
+            const double a = scale_exp * std::sin(theta);
+            const double b = scale_exp * std::cos(theta);
+            const double theta_sq = theta * theta;
+            const double c = theta_sq + sigma_sq;
+            A = (a * sigma + (1.0 - b) * theta) / (theta * c);
+            B = (C - ((b - 1.0) * sigma + a * theta) / c) / theta_sq;
+        }
+    }
+    const Mat33_t W = A * skew_omega + B * skew_omega_sq + C * Mat33_t::Identity();
+
+    const Quat_t quat_exp(rot_exp);
+    trans = scale_exp * (quat_exp * trans) + W * upsilon;
+    rot = (quat_exp * rot).normalized();
+    scale *= scale_exp;
+}
+
+//! Jacobian of the projection w.r.t. the point in the camera coordinates
+inline MatRC_t<2, 3> project_jacobian(const transform_solver::camera_model& cam, const Vec3_t& pos_c) {
+    MatRC_t<2, 3> proj_jac;
+    if (cam.is_equirectangular_) {
+        const double xz_sq = pos_c(0) * pos_c(0) + pos_c(2) * pos_c(2);
+        const double L_sq = xz_sq + pos_c(1) * pos_c(1);
+        const double u_coeff = (cam.cols_ / (2 * M_PI)) / xz_sq;
+        const double v_coeff = (cam.rows_ / M_PI) / (L_sq * std::sqrt(xz_sq));
+        proj_jac << u_coeff * pos_c(2), 0.0, -u_coeff * pos_c(0),
+            -v_coeff * pos_c(0) * pos_c(1), v_coeff * xz_sq, -v_coeff * pos_c(1) * pos_c(2);
+    }
+    else {
+        const double inv_z = 1.0 / pos_c(2);
+        proj_jac << cam.fx_ * inv_z, 0.0, -cam.fx_ * pos_c(0) * inv_z * inv_z,
+            0.0, cam.fy_ * inv_z, -cam.fy_ * pos_c(1) * inv_z * inv_z;
+    }
+    return proj_jac;
+}
+} // namespace
+
+void transform_solver::clear() {
+    pos_2_.clear();
+    obs_1_.clear();
+    inv_sigma_sq_1_.clear();
+    pos_1_.clear();
+    obs_2_.clear();
+    inv_sigma_sq_2_.clear();
+}
+
+void transform_solver::reserve(const unsigned int num_matches) {
+    pos_2_.reserve(num_matches);
+    obs_1_.reserve(num_matches);
+    inv_sigma_sq_1_.reserve(num_matches);
+    pos_1_.reserve(num_matches);
+    obs_2_.reserve(num_matches);
+    inv_sigma_sq_2_.reserve(num_matches);
+}
+
+void transform_solver::add_match(const Vec3_t& pos_2, const Vec2_t& obs_1, const double inv_sigma_sq_1,
+                                 const Vec3_t& pos_1, const Vec2_t& obs_2, const double inv_sigma_sq_2) {
+    pos_2_.push_back(pos_2);
+    obs_1_.push_back(obs_1);
+    inv_sigma_sq_1_.push_back(inv_sigma_sq_1);
+    pos_1_.push_back(pos_1);
+    obs_2_.push_back(obs_2);
+    inv_sigma_sq_2_.push_back(inv_sigma_sq_2);
+}
+
+unsigned int transform_solver::solve(const camera_model& cam_1, const camera_model& cam_2, const bool fix_scale,
+                                     const unsigned int num_first_iter, const unsigned int num_second_iter, const double chi_sq,
+                                     Mat33_t& rot_12, Vec3_t& trans_12, double& scale_12, std::vector<bool>& outlier_flags) {
+    const unsigned int num_matches = this->num_matches();
+    outlier_flags.assign(num_matches, false);
+    const double huber_delta = std::sqrt(chi_sq);
+
+    Quat_t rot(rot_12);
+    rot.normalize();
+    Vec3_t trans = trans_12;
+    double scale = scale_12;
+
+    // 1. Perform the robust optimization, then reject the outliers
+
+    optimize(cam_1, cam_2, fix_scale, num_first_iter, huber_delta, outlier_flags, rot, trans, scale);
+
+    compute_chi_sqs(cam_1, cam_2, rot, trans, scale);
+    unsigned int num_outliers = 0;
+    for (unsigned int idx = 0; idx < num_matches; ++idx) {
+        if (chi_sq_12_.at(idx) < chi_sq && chi_sq_21_.at(idx) < chi_sq) {
+            continue;
+        }
+        outlier_flags.at(idx) = true;
+        ++num_outliers;
+    }
+
+    if (num_matches - num_outliers < 10) {
+        return 0;
+    }
+
+    // 2. Perform the optimization again, then count the inliers
+
+    optimize(cam_1, cam_2, fix_scale, num_second_iter, huber_delta, outlier_flags, rot, trans, scale);
+
+    compute_chi_sqs(cam_1, cam_2, rot, trans, scale);
+    unsigned int num_inliers = 0;
+    for (unsigned int idx = 0; idx < num_matches; ++idx) {
+        if (outlier_flags.at(idx)) {
+            continue;
+        }
+        if (chi_sq < chi_sq_12_.at(idx) || chi_sq < chi_sq_21_.at(idx)) {
+            outlier_flags.at(idx) = true;
+            continue;
+        }
+        ++num_inliers;
+    }
+
+    rot_12 = rot.toRotationMatrix();
+    trans_12 = trans;
+    scale_12 = scale;
+
+    return num_inliers;
+}
+
+void transform_solver::optimize(const camera_model& cam_1, const camera_model& cam_2, const bool fix_scale, const unsigned int num_iter,
+                                const double huber_delta, const std::vector<bool>& outlier_flags,
+                                Quat_t& rot_12, Vec3_t& trans_12, double& scale_12) {
+    // (the same parameters as g2o::OptimizationAlgorithmLevenberg)
+    constexpr double tau = 1e-5;
+    constexpr unsigned int max_trials_after_failure = 10;
+
+    const unsigned int num_matches = this->num_matches();
+    double chi_sq = compute_robust_chi_sq(cam_1, cam_2, huber_delta, outlier_flags, rot_12, trans_12, scale_12);
+    double lambda = 0.0;
+    double ni = 2.0;
+
+    for (unsigned int iter = 0; iter < num_iter; ++iter) {
+        // Accumulate the normal equation at the current Sim3
+        // (the reprojections and the errors of the current Sim3 are in the buffers, which are computed with the last accepted update)
+        Mat77_t H = Mat77_t::Zero();
+        Vec7_t b = Vec7_t::Zero();
+        const Mat33_t rot_12_mat = rot_12.toRotationMatrix();
+        const Mat33_t rot_21_mat = rot_12_mat.transpose();
+        const double scale_21 = 1.0 / scale_12;
+        const Vec3_t trans_21 = -scale_21 * (rot_21_mat * trans_12);
+        for (unsigned int idx = 0; idx < num_matches; ++idx) {
+            if (outlier_flags.at(idx)) {
+                continue;
+            }
+
+            // error_12 = obs_1 - proj_1(exp(delta) * Sim3_12 * pos_2)
+            {
+                const Vec3_t pos_c = scale_12 * (rot_12_mat * pos_2_.at(idx)) + trans_12;
+                const MatRC_t<2, 3> proj_jac = project_jacobian(cam_1, pos_c);
+                MatRC_t<2, 7> J;
+                J.block<2, 3>(0, 0) = proj_jac * skew(pos_c);
+                J.block<2, 3>(0, 3) = -proj_jac;
+                if (fix_scale) {
+                    J.block<2, 1>(0, 6).setZero();
+                }
+                else {
+                    J.block<2, 1>(0, 6) = -proj_jac * pos_c;
+                }
+
+                const Vec2_t error = obs_1_.at(idx) - reprojs_.at(idx);
+                double robust_chi_sq;
+                double weight;
+                robustify(chi_sq_12_.at(idx), huber_delta, robust_chi_sq, weight);
+                const double info = weight * inv_sigma_sq_1_.at(idx);
+                H.noalias() += info * J.transpose() * J;
+                b.noalias() -= info * J.transpose() * error;
+            }
+
+            // error_21 = obs_2 - proj_2(Sim3_12^-1 * exp(-delta) * pos_1)
+            {
+                const Vec3_t pos_c = scale_21 * (rot_21_mat * pos_1_.at(idx)) + trans_21;
+                const MatRC_t<2, 3> jac = -project_jacobian(cam_2, pos_c) * (scale_21 * rot_21_mat);
+                MatRC_t<2, 7> J;
+                J.block<2, 3>(0, 0) = jac * skew(pos_1_.at(idx));
+                J.block<2, 3>(0, 3) = -jac;
+                if (fix_scale) {
+                    J.block<2, 1>(0, 6).setZero();
+                }
+                else {
+                    J.block<2, 1>(0, 6) = -jac * pos_1_.at(idx);
+                }
+
+                const Vec2_t error = obs_2_.at(idx) - reprojs_.at(num_matches + idx);
+                double robust_chi_sq;
+                double weight;
+                robustify(chi_sq_21_.at(idx), huber_delta, robust_chi_sq, weight);
+                const double info = weight * inv_sigma_sq_2_.at(idx);
+                H.noalias() += info * J.transpose() * J;
+                b.noalias() -= info * J.transpose() * error;
+            }
+        }
+
+        if (iter == 0) {
+            lambda = tau * H.diagonal().maxCoeff();
+            ni = 2.0;
+        }
+
+        // Solve the damped system until the error decreases
+        double rho = 0.0;
+        unsigned int num_failures = 0;
+        do {
+            const Mat77_t H_damped = H + lambda * Mat77_t::Identity();
+            const Eigen::LDLT<Mat77_t> ldlt(H_damped);
+            Vec7_t delta = ldlt.solve(b);
+            if (fix_scale) {
+                delta(6) = 0.0;
+            }
+
+            Quat_t new_rot_12 = rot_12;
+            Vec3_t new_trans_12 = trans_12;
+            double new_scale_12 = scale_12;
+            apply_update(delta, new_rot_12, new_trans_12, new_scale_12);
+            double new_chi_sq = compute_robust_chi_sq(cam_1, cam_2, huber_delta, outlier_flags, new_rot_12, new_trans_12, new_scale_12);
+            if (ldlt.info() != Eigen::Success || !std::isfinite(new_chi_sq)) {
+                new_chi_sq = std::numeric_limits<double>::max();
+            }
+
+            const double scale = delta.dot(lambda * delta + b) + 1e-3;
+            rho = (chi_sq - new_chi_sq) / scale;
+            if (0.0 < rho && std::isfinite(new_chi_sq)) {
+                // accept the update
+                const double alpha = std::min(1.0 - std::pow(2.0 * rho - 1.0, 3), 2.0 / 3.0);
+                lambda *= std::max(1.0 / 3.0, alpha);
+                ni = 2.0;
+                rot_12 = new_rot_12;
+                trans_12 = new_trans_12;
+                scale_12 = new_scale_12;
+                chi_sq = new_chi_sq;
+            }
+            else {
+                lambda *= ni;
+                ni *= 2.0;
+            }
+            ++num_failures;
+        } while (rho < 0.0 && num_failures < max_trials_after_failure);
+
+        if (num_failures == max_trials_after_failure || rho == 0.0 || !std::isfinite(chi_sq)) {
+            break;
+        }
+    }
+}
+
+void transform_solver::compute_chi_sqs(const camera_model& cam_1, const camera_model& cam_2,
+                                       const Quat_t& rot_12, const Vec3_t& trans_12, const double scale_12) {
+    const unsigned int num_matches = this->num_matches();
+    transformed_.resize(2 * num_matches);
+    reprojs_.resize(2 * num_matches);
+    chi_sq_12_.resize(num_matches);
+    chi_sq_21_.resize(num_matches);
+    if (num_matches == 0) {
+        return;
+    }
+
+    const Mat33_t sR_12 = scale_12 * rot_12.toRotationMatrix();
+    const Mat33_t sR_21 = sR_12.inverse();
+    const Vec3_t trans_21 = -sR_21 * trans_12;
+
+    // Transform all the points at once, forward in the first half and backward in the second half
+    Eigen::Map<Mat3X_t> transformed_12(transformed_.front().data(), 3, num_matches);
+    Eigen::Map<Mat3X_t> transformed_21(transformed_.at(num_matches).data(), 3, num_matches);
+    transformed_12.noalias() = sR_12 * Eigen::Map<const Mat3X_t>(pos_2_.front().data(), 3, num_matches);
+    transformed_12.colwise() += trans_12;
+    transformed_21.noalias() = sR_21 * Eigen::Map<const Mat3X_t>(pos_1_.front().data(), 3, num_matches);
+    transformed_21.colwise() += trans_21;
+
+    project(cam_1, 0, num_matches);
+    project(cam_2, num_matches, num_matches);
+
+    using Mat2X_t = Eigen::Matrix<double, 2, Eigen::Dynamic>;
+    const Eigen::Map<const Mat2X_t> reprojs(reprojs_.front().data(), 2, 2 * num_matches);
+    Eigen::Map<Eigen::ArrayXd>(chi_sq_12_.data(), num_matches)
+        = (Eigen::Map<const Mat2X_t>(obs_1_.front().data(), 2, num_matches) - reprojs.leftCols(num_matches)).colwise().squaredNorm().transpose().array()
+          * Eigen::Map<const Eigen::ArrayXd>(inv_sigma_sq_1_.data(), num_matches);
+    Eigen::Map<Eigen::ArrayXd>(chi_sq_21_.data(), num_matches)
+        = (Eigen::Map<const Mat2X_t>(obs_2_.front().data(), 2, num_matches) - reprojs.rightCols(num_matches)).colwise().squaredNorm().transpose().array()
+          * Eigen::Map<const Eigen::ArrayXd>(inv_sigma_sq_2_.data(), num_matches);
+}
+
+double transform_solver::compute_robust_chi_sq(const camera_model& cam_1, const camera_model& cam_2, const double huber_delta,
+                                               const std::vector<bool>& outlier_flags,
+                                               const Quat_t& rot_12, const Vec3_t& trans_12, const double scale_12) {
+    compute_chi_sqs(cam_1, cam_2, rot_12, trans_12, scale_12);
+    double sum_chi_sq = 0.0;
+    for (unsigned int idx = 0; idx < num_matches(); ++idx) {
+        if (outlier_flags.at(idx)) {
+            continue;
+        }
+        double robust_chi_sq;
+        double weight;
+        robustify(chi_sq_12_.at(idx), huber_delta, robust_chi_sq, weight);
+        sum_chi_sq += robust_chi_sq;
+        robustify(chi_sq_21_.at(idx), huber_delta, robust_chi_sq, weight);
+        sum_chi_sq += robust_chi_sq;
+    }
+    return sum_chi_sq;
+}
+
+void transform_solver::project(const camera_model& cam, const unsigned int begin, const unsigned int num_points) {
+    using Mat2X_t = Eigen::Matrix<double, 2, Eigen::Dynamic>;
+    const Eigen::Map<const Mat3X_t> pos_cs(transformed_.at(begin).data(), 3, num_points);
+    Eigen::Map<Mat2X_t> reprojs(reprojs_.at(begin).data(), 2, num_points);
+    if (cam.is_equirectangular_) {
+        for (unsigned int idx = 0; idx < num_points; ++idx) {
+            const Vec3_t pos_c = pos_cs.col(idx);
+            const double theta = std::atan2(pos_c(0), pos_c(2));
+            const double phi = -std::asin(pos_c(1) / pos_c.norm());
+            reprojs(0, idx) = cam.cols_ * (0.5 + theta / (2 * M_PI));
+            reprojs(1, idx) = cam.rows_ * (0.5 - phi / M_PI);
+        }
+    }
+    else {
+        reprojs.row(0) = (cam.fx_ * pos_cs.row(0).array() / pos_cs.row(2).array() + cam.cx_).matrix();
+        reprojs.row(1) = (cam.fy_ * pos_cs.row(1).array() / pos_cs.row(2).array() + cam.cy_).matrix();
+    }
+}
+
+} // namespace optimize
+} // namespace stella_vslam
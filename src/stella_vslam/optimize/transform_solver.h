@@ -0,0 +1,108 @@
+#ifndef STELLA_VSLAM_OPTIMIZE_TRANSFORM_SOLVER_H
+#define STELLA_VSLAM_OPTIMIZE_TRANSFORM_SOLVER_H
+
+#include "stella_vslam/type.h"
+
+#include <vector>
+
+namespace stella_vslam {
+namespace optimize {
+
+/**
+ * Levenberg-Marquardt solver dedicated to the Sim3 between two keyframes observing fixed landmarks
+ * (the same formulation as transform_optimizer with g2o: the left perturbation [rotation, translation, scale] of Sim3_12,
+ *  the mutual reprojection errors with the Huber kernel and the outlier rejection, but without the graph and the edge objects)
+ * The buffers are kept by clear(), so the solver reused for the candidates does not allocate in the steady state.
+ * (NOTE: the solver is not thread-safe, use one solver per thread)
+ */
+class transform_solver {
+public:
+    //! Camera model of the undistorted keypoints
+    struct camera_model {
+        //! if true, cols_ and rows_ are used instead of the pinhole intrinsics
+        bool is_equirectangular_ = false;
+        double fx_ = 0.0;
+        double fy_ = 0.0;
+        double cx_ = 0.0;
+        double cy_ = 0.0;
+        double cols_ = 0.0;
+        double rows_ = 0.0;
+    };
+
+    //! Remove the matches
+    void clear();
+
+    //! Reserve the buffers of the matches
+    void reserve(const unsigned int num_matches);
+
+    /**
+     * Add the match between the landmarks
+     * @param pos_2 position of the landmark observed in keyframe 2, in the camera coordinates of keyframe 2
+     * @param obs_1 keypoint of keyframe 1 matched with the landmark of keyframe 2
+     * @param inv_sigma_sq_1
+     * @param pos_1 position of the landmark observed in keyframe 1, in the camera coordinates of keyframe 1
+     * @param obs_2 keypoint of keyframe 2 matched with the landmark of keyframe 1
+     * @param inv_sigma_sq_2
+     */
+    void add_match(const Vec3_t& pos_2, const Vec2_t& obs_1, const double inv_sigma_sq_1,
+                   const Vec3_t& pos_1, const Vec2_t& obs_2, const double inv_sigma_sq_2);
+
+    //! Number of the matches
+    unsigned int num_matches() const { return static_cast<unsigned int>(pos_1_.size()); }
+
+    /**
+     * Optimize the Sim3 (2->1), then reject the outliers and optimize it again
+     * @param cam_1
+     * @param cam_2
+     * @param fix_scale
+     * @param num_first_iter number of the iterations before the outlier rejection
+     * @param num_second_iter number of the iterations after the outlier rejection
+     * @param chi_sq threshold of the chi-squared error in each direction (its square root is the delta of the Huber kernel)
+     * @param rot_12 initial rotation, which is overwritten with the optimized one unless 0 is returned
+     * @param trans_12 initial translation, which is overwritten with the optimized one unless 0 is returned
+     * @param scale_12 initial scale, which is overwritten with the optimized one unless 0 is returned
+     * @param outlier_flags set in the order of add_match()
+     * @return the number of the inliers (0 if fewer than 10 inliers remain after the first optimization)
+     */
+    unsigned int solve(const camera_model& cam_1, const camera_model& cam_2, const bool fix_scale,
+                       const unsigned int num_first_iter, const unsigned int num_second_iter, const double chi_sq,
+                       Mat33_t& rot_12, Vec3_t& trans_12, double& scale_12, std::vector<bool>& outlier_flags);
+
+private:
+    //! Run the Levenberg-Marquardt iterations on the inliers (the same damping control as g2o::OptimizationAlgorithmLevenberg)
+    void optimize(const camera_model& cam_1, const camera_model& cam_2, const bool fix_scale, const unsigned int num_iter,
+                  const double huber_delta, const std::vector<bool>& outlier_flags,
+                  Quat_t& rot_12, Vec3_t& trans_12, double& scale_12);
+
+    //! Compute the chi-squared errors of all the matches in chi_sq_12_ and chi_sq_21_ at once
+    void compute_chi_sqs(const camera_model& cam_1, const camera_model& cam_2,
+                         const Quat_t& rot_12, const Vec3_t& trans_12, const double scale_12);
+
+    //! Compute the sum of the robust chi-squared errors of the inliers
+    double compute_robust_chi_sq(const camera_model& cam_1, const camera_model& cam_2, const double huber_delta,
+                                 const std::vector<bool>& outlier_flags,
+                                 const Quat_t& rot_12, const Vec3_t& trans_12, const double scale_12);
+
+    //! Project the points of transformed_ in [begin, begin + num_points) to the same range of reprojs_
+    void project(const camera_model& cam, const unsigned int begin, const unsigned int num_points);
+
+    //! keyframe 2 -> keyframe 1
+    eigen_alloc_vector<Vec3_t> pos_2_;
+    eigen_alloc_vector<Vec2_t> obs_1_;
+    std::vector<double> inv_sigma_sq_1_;
+    //! keyframe 1 -> keyframe 2
+    eigen_alloc_vector<Vec3_t> pos_1_;
+    eigen_alloc_vector<Vec2_t> obs_2_;
+    std::vector<double> inv_sigma_sq_2_;
+
+    //! buffers of the batch computation of the errors
+    eigen_alloc_vector<Vec3_t> transformed_;
+    eigen_alloc_vector<Vec2_t> reprojs_;
+    std::vector<double> chi_sq_12_;
+    std::vector<double> chi_sq_21_;
+};
+
+} // namespace optimize
+} // namespace stella_vslam
+
+#endif // STELLA_VSLAM_OPTIMIZE_TRANSFORM_SOLVER_H
@@ -29,11 +29,13 @@ cv::Mat frame_publisher::draw_frame() {
     bool mapping_is_enabled;
     std::vector<std::shared_ptr<data::landmark>> curr_lms;
 
-    // copy to avoid memory access conflict
+    frame_is_requested_ = true;
+
+    // copy the headers only, the system thread never writes into the front buffers
     {
         std::lock_guard<std::mutex> lock(mtx_);
 
-        img_.copyTo(img);
+        img = img_;
 
         tracking_state = tracking_state_;
 
@@ -46,7 +48,7 @@ cv::Mat frame_publisher::draw_frame() {
     }
 
     // resize image
-    const float mag = (img_width_ < img_.cols) ? static_cast<float>(img_width_) / img.cols : 1.0;
+    const float mag = (img_width_ < img.cols) ? static_cast<float>(img_width_) / img.cols : 1.0;
     if (mag != 1.0) {
         cv::resize(img, img, cv::Size(), mag, mag, cv::INTER_NEAREST);
     }
@@ -55,6 +57,10 @@ cv::Mat frame_publisher::draw_frame() {
     if (img.channels() < 3) {
         cvtColor(img, img, cv::COLOR_GRAY2BGR);
     }
+    else if (mag == 1.0) {
+        // draw on a copy of the shared image
+        img = img.clone();
+    }
 
     // draw keypoints
     unsigned int num_tracked = 0;
@@ -112,18 +118,37 @@ unsigned int frame_publisher::draw_tracked_points(cv::Mat& img, const std::vecto
 void frame_publisher::update(const std::vector<std::shared_ptr<data::landmark>>& curr_lms,
                              bool mapping_is_enabled,
                              tracker_state_t tracking_state,
-                             std::vector<cv::KeyPoint>& keypts,
+                             const std::vector<cv::KeyPoint>& keypts,
                              const cv::Mat& img,
                              double elapsed_ms) {
-    std::lock_guard<std::mutex> lock(mtx_);
+    // fill the back buffers without the lock (skipped until a consumer requests the frame)
+    const bool frame_is_requested = frame_is_requested_;
+    if (frame_is_requested) {
+        // the back buffer might be still referred by a consumer of the previous frame
+        if (back_img_.u && 1 < back_img_.u->refcount) {
+            back_img_ = cv::Mat();
+        }
+        img.copyTo(back_img_);
+        back_keypts_.assign(keypts.begin(), keypts.end());
+        back_lms_.assign(curr_lms.begin(), curr_lms.end());
+    }
 
-    img.copyTo(img_);
+    std::lock_guard<std::mutex> lock(mtx_);
 
-    curr_keypts_ = keypts;
+    if (frame_is_requested) {
+        cv::swap(img_, back_img_);
+        curr_keypts_.swap(back_keypts_);
+        curr_lms_.swap(back_lms_);
+    }
     elapsed_ms_ = elapsed_ms;
     mapping_is_enabled_ = mapping_is_enabled;
     tracking_state_ = tracking_state;
-    curr_lms_ = curr_lms;
+    ++num_updates_;
+}
+
+uint64_t frame_publisher::get_num_updates() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return num_updates_;
 }
 
 } // namespace publish
@@ -4,6 +4,8 @@
 #include "stella_vslam/config.h"
 #include "stella_vslam/tracking_module.h"
 
+#include <atomic>
+#include <cstdint>
 #include <mutex>
 #include <vector>
 #include <memory>
@@ -37,20 +39,29 @@ public:
     /**
      * Update tracking information
      * NOTE: should be accessed from system thread
+     * (NOTE: the information is written into the back buffers and swapped with the front ones,
+     *  and the image is copied only after a consumer has requested the frame)
      */
     void update(const std::vector<std::shared_ptr<data::landmark>>& curr_lms,
                 bool mapping_is_enabled,
                 tracker_state_t tracking_state,
-                std::vector<cv::KeyPoint>& keypts,
+                const std::vector<cv::KeyPoint>& keypts,
                 const cv::Mat& img,
                 double elapsed_ms);
 
     /**
      * Get the current image with tracking information
      * NOTE: should be accessed from viewer thread
+     * (NOTE: the tracking information is drawn on the consumer side)
      */
     cv::Mat draw_frame();
 
+    /**
+     * Get the number of the updates, which is used to detect the new frame
+     * NOTE: should be accessed from viewer thread
+     */
+    uint64_t get_num_updates();
+
 protected:
     unsigned int draw_tracked_points(cv::Mat& img, const std::vector<cv::KeyPoint>& curr_keypts,
                                      const std::vector<std::shared_ptr<data::landmark>>& curr_lms,
@@ -87,6 +98,20 @@ protected:
     bool mapping_is_enabled_;
 
     std::vector<std::shared_ptr<data::landmark>> curr_lms_;
+
+    //! number of the updates
+    uint64_t num_updates_ = 0;
+
+    // -------------------------------------------
+    // back buffers, which are accessed only from the system thread
+    // (NOTE: they are swapped with the front ones to reuse the allocated memory)
+
+    cv::Mat back_img_;
+    std::vector<cv::KeyPoint> back_keypts_;
+    std::vector<std::shared_ptr<data::landmark>> back_lms_;
+
+    //! a consumer has requested the frame (the image is not copied until then)
+    std::atomic<bool> frame_is_requested_{false};
 };
 
 } // namespace publish
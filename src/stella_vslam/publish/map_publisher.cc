@@ -1,7 +1,14 @@
+#include "stella_vslam/config.h"
+#include "stella_vslam/tracking_module.h"
 #include "stella_vslam/data/landmark.h"
 #include "stella_vslam/data/keyframe.h"
 #include "stella_vslam/data/map_database.h"
+#include "stella_vslam/data/map_change_journal.h"
 #include "stella_vslam/publish/map_publisher.h"
+#include "stella_vslam/util/yaml.h"
+
+#include <algorithm>
+#include <chrono>
 
 #include <spdlog/spdlog.h>
 
@@ -9,7 +16,8 @@ namespace stella_vslam {
 namespace publish {
 
 map_publisher::map_publisher(const std::shared_ptr<config>& cfg, data::map_database* map_db)
-    : cfg_(cfg), map_db_(map_db) {
+    : cfg_(cfg), map_db_(map_db),
+      max_prediction_time_(util::yaml_optional_ref(cfg->yaml_node_, "MapPublisher")["max_prediction_time"].as<double>(0.2)) {
     spdlog::debug("CONSTRUCT: publish::map_publisher");
 }
 
@@ -18,53 +26,267 @@ map_publisher::~map_publisher() {
 }
 
 void map_publisher::set_current_cam_pose(const Mat44_t& cam_pose_cw) {
-    std::lock_guard<std::mutex> lock(mtx_cam_pose_);
-    cam_pose_cw_ = cam_pose_cw;
+    update_cam_pose_record(&cam_pose_cw, nullptr, nullptr);
+}
+
+void map_publisher::set_current_cam_pose(const Mat44_t& cam_pose_cw, const double timestamp, const tracker_state_t tracking_state) {
+    update_cam_pose_record(&cam_pose_cw, &timestamp, &tracking_state);
+}
+
+void map_publisher::set_current_cam_pose(const Mat44_t& cam_pose_cw, const double timestamp, const tracker_state_t tracking_state,
+                                         const Mat44_t& twist, const double twist_dt, const double latency) {
+    update_cam_pose_record(&cam_pose_cw, &timestamp, &tracking_state, &twist, twist_dt, latency);
 }
 
-Mat44_t map_publisher::get_current_cam_pose() {
+void map_publisher::set_rotation_integrator(const std::function<bool(double, double, Mat33_t&)>& rotation_integrator) {
+    std::lock_guard<std::mutex> lock(mtx_rotation_integrator_);
+    rotation_integrator_ = rotation_integrator;
+    has_rotation_integrator_ = static_cast<bool>(rotation_integrator);
+}
+
+void map_publisher::set_current_tracking_state(const double timestamp, const tracker_state_t tracking_state) {
+    update_cam_pose_record(nullptr, &timestamp, &tracking_state);
+}
+
+void map_publisher::update_cam_pose_record(const Mat44_t* cam_pose_cw, const double* timestamp, const tracker_state_t* tracking_state,
+                                           const Mat44_t* twist, const double twist_dt, const double latency) {
     std::lock_guard<std::mutex> lock(mtx_cam_pose_);
-    return cam_pose_cw_;
+    auto record = cam_pose_.load();
+    // the velocities per second of the constant velocity model
+    record.velocity_is_valid_ = twist && 0.0 < twist_dt;
+    if (record.velocity_is_valid_) {
+        const Eigen::AngleAxisd angle_axis(Mat33_t(twist->block<3, 3>(0, 0)));
+        Eigen::Map<Vec3_t>(record.angular_velocity_) = angle_axis.angle() / twist_dt * angle_axis.axis();
+        Eigen::Map<Vec3_t>(record.linear_velocity_) = twist->block<3, 1>(0, 3) / twist_dt;
+    }
+    record.latency_ = latency;
+    record.updated_at_ = std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    if (cam_pose_cw) {
+        Eigen::Map<Mat44_t>(record.cam_pose_cw_) = *cam_pose_cw;
+    }
+    if (timestamp) {
+        record.timestamp_ = *timestamp;
+    }
+    if (tracking_state) {
+        record.tracking_state_ = static_cast<int>(*tracking_state);
+    }
+    cam_pose_.store(record);
+}
+
+Mat44_t map_publisher::get_current_cam_pose() const {
+    const auto record = cam_pose_.load();
+    return Eigen::Map<const Mat44_t>(record.cam_pose_cw_);
+}
+
+current_cam_pose map_publisher::get_current_cam_pose_with_state() const {
+    current_cam_pose pose;
+    const auto record = cam_pose_.load(pose.seq_);
+    pose.cam_pose_cw_ = Eigen::Map<const Mat44_t>(record.cam_pose_cw_);
+    pose.timestamp_ = record.timestamp_;
+    pose.tracking_state_ = static_cast<tracker_state_t>(record.tracking_state_);
+    pose.seq_ /= 2;
+    return pose;
+}
+
+Mat44_t map_publisher::get_pose_at(const double timestamp) const {
+    return predict_pose(cam_pose_.load(), timestamp);
+}
+
+Mat44_t map_publisher::get_latency_compensated_pose(const double lead_time) const {
+    const auto record = cam_pose_.load();
+    const double now = std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    return predict_pose(record, record.timestamp_ + record.latency_ + (now - record.updated_at_) + lead_time);
+}
+
+Mat44_t map_publisher::predict_pose(const cam_pose_record& record, const double timestamp) const {
+    const Mat44_t cam_pose_cw = Eigen::Map<const Mat44_t>(record.cam_pose_cw_);
+    if (!record.velocity_is_valid_ || static_cast<tracker_state_t>(record.tracking_state_) != tracker_state_t::Tracking) {
+        return cam_pose_cw;
+    }
+    const double dt = std::max(-max_prediction_time_, std::min(max_prediction_time_, timestamp - record.timestamp_));
+
+    // the relative pose from the frame is extrapolated with the constant velocities
+    // (the rotation is integrated with the IMU if the measurements cover the interval)
+    Mat44_t delta = Mat44_t::Identity();
+    bool rot_is_integrated = false;
+    if (0.0 < dt && has_rotation_integrator_) {
+        std::lock_guard<std::mutex> lock(mtx_rotation_integrator_);
+        Mat33_t rot_curr_last;
+        if (rotation_integrator_ && rotation_integrator_(record.timestamp_, record.timestamp_ + dt, rot_curr_last)) {
+            delta.block<3, 3>(0, 0) = rot_curr_last;
+            rot_is_integrated = true;
+        }
+    }
+    if (!rot_is_integrated) {
+        const Vec3_t rot_vec = dt * Eigen::Map<const Vec3_t>(record.angular_velocity_);
+        const double angle = rot_vec.norm();
+        if (0.0 < angle) {
+            delta.block<3, 3>(0, 0) = Eigen::AngleAxisd(angle, rot_vec / angle).toRotationMatrix();
+        }
+    }
+    delta.block<3, 1>(0, 3) = dt * Eigen::Map<const Vec3_t>(record.linear_velocity_);
+    return delta * cam_pose_cw;
+}
+
+void map_publisher::update_landmarks_snapshot() {
+    const auto journal_version = map_db_->get_change_journal()->get_version();
+    const auto local_lms = map_db_->get_local_landmarks_snapshot();
+    const auto prev_snapshot = get_landmarks_snapshot();
+    const bool points_are_changed = journal_version != lms_snapshot_journal_version_;
+    if (!points_are_changed && local_lms == lms_snapshot_local_lms_) {
+        return;
+    }
+
+    auto snapshot = std::make_shared<landmarks_snapshot>();
+    snapshot->version_ = prev_snapshot->version_ + 1;
+
+    if (points_are_changed) {
+        // the positions are collected again only if the journal records the changes
+        auto points = std::make_shared<landmark_points>();
+        {
+            std::lock_guard<std::mutex> lock(mtx_map_cache_);
+            if (update_map_cache()) {
+                if (!cached_landmarks_are_valid_) {
+                    collect_cached_landmarks();
+                }
+                points->ids_.reserve(cached_landmarks_.size());
+                points->positions_.reserve(3 * cached_landmarks_.size());
+                points->observed_ratios_.reserve(cached_landmarks_.size());
+                for (const auto& lm : cached_landmarks_) {
+                    if (lm->will_be_erased()) {
+                        continue;
+                    }
+                    const Vec3_t pos_w = lm->get_pos_in_world();
+                    points->ids_.push_back(lm->id_);
+                    points->positions_.push_back(pos_w(0));
+                    points->positions_.push_back(pos_w(1));
+                    points->positions_.push_back(pos_w(2));
+                    points->observed_ratios_.push_back(lm->get_observed_ratio());
+                }
+            }
+        }
+
+        lms_snapshot_indices_.clear();
+        lms_snapshot_indices_.reserve(points->ids_.size());
+        for (unsigned int idx = 0; idx < points->ids_.size(); ++idx) {
+            lms_snapshot_indices_.emplace(points->ids_.at(idx), idx);
+        }
+        snapshot->points_ = points;
+        lms_snapshot_journal_version_ = journal_version;
+    }
+    else {
+        snapshot->points_ = prev_snapshot->points_;
+    }
+
+    snapshot->local_flags_.assign((snapshot->size() + 63) / 64, 0);
+    for (const auto& lm : *local_lms) {
+        const auto iter = lms_snapshot_indices_.find(lm->id_);
+        if (iter == lms_snapshot_indices_.end()) {
+            continue;
+        }
+        snapshot->local_flags_.at(iter->second / 64) |= uint64_t(1) << (iter->second % 64);
+    }
+    lms_snapshot_local_lms_ = local_lms;
+
+    std::lock_guard<std::mutex> lock(mtx_lms_snapshot_);
+    lms_snapshot_ = snapshot;
+}
+
+std::shared_ptr<const landmarks_snapshot> map_publisher::get_landmarks_snapshot() const {
+    std::lock_guard<std::mutex> lock(mtx_lms_snapshot_);
+    return lms_snapshot_;
 }
 
 unsigned int map_publisher::get_keyframes(std::vector<std::shared_ptr<data::keyframe>>& all_keyfrms) {
-    auto roots = map_db_->get_spanning_roots();
-    if (roots.empty()) {
+    std::lock_guard<std::mutex> lock(mtx_map_cache_);
+    if (!update_map_cache()) {
         return 0;
     }
-    all_keyfrms = roots.back()->graph_node_->get_keyframes_from_root();
+    all_keyfrms = cached_keyfrms_;
     return map_db_->get_num_keyframes();
 }
 
 unsigned int map_publisher::get_landmarks(std::vector<std::shared_ptr<data::landmark>>& all_landmarks,
                                           std::set<std::shared_ptr<data::landmark>>& local_landmarks) {
+    {
+        std::lock_guard<std::mutex> lock(mtx_map_cache_);
+        if (!update_map_cache()) {
+            return 0;
+        }
+        if (!cached_landmarks_are_valid_) {
+            collect_cached_landmarks();
+        }
+        all_landmarks.clear();
+        all_landmarks.reserve(cached_landmarks_.size());
+        for (const auto& lm : cached_landmarks_) {
+            // the landmarks can be flagged after the cache was built
+            if (lm->will_be_erased()) {
+                continue;
+            }
+            all_landmarks.push_back(lm);
+        }
+    }
+
+    const auto _local_landmarks = map_db_->get_local_landmarks_snapshot();
+    local_landmarks = std::set<std::shared_ptr<data::landmark>>(_local_landmarks->begin(), _local_landmarks->end());
+    return map_db_->get_num_landmarks();
+}
+
+std::shared_ptr<data::keyframe> map_publisher::get_keyframe(const unsigned int id) const {
+    return map_db_->get_keyframe(id);
+}
+
+std::shared_ptr<data::landmark> map_publisher::get_landmark(const unsigned int id) const {
+    return map_db_->get_landmark(id);
+}
+
+bool map_publisher::get_map_changes_since(const uint64_t version, std::vector<data::map_change>& changes, uint64_t& latest_version) const {
+    return map_db_->get_change_journal()->get_changes_since(version, changes, latest_version);
+}
+
+uint64_t map_publisher::get_map_change_version() const {
+    return map_db_->get_change_journal()->get_version();
+}
+
+bool map_publisher::update_map_cache() {
+    // read the version before collecting, so that the modifications during the collection invalidate the cache
+    const auto version = map_db_->get_version();
+    if (map_cache_is_valid_ && version == map_cache_version_) {
+        return !cached_keyfrms_.empty();
+    }
+
+    cached_keyfrms_.clear();
+    cached_landmarks_.clear();
+    cached_landmarks_are_valid_ = false;
+    map_cache_version_ = version;
+    map_cache_is_valid_ = true;
+
     auto roots = map_db_->get_spanning_roots();
     if (roots.empty()) {
-        return 0;
+        return false;
     }
-    auto keyfrms = roots.back()->graph_node_->get_keyframes_from_root();
+    cached_keyfrms_ = roots.back()->graph_node_->get_keyframes_from_root();
+    return !cached_keyfrms_.empty();
+}
+
+void map_publisher::collect_cached_landmarks() {
+    cached_landmarks_are_valid_ = true;
     std::unordered_set<unsigned int> already_found_landmark_ids;
-    all_landmarks.clear();
-    for (const auto& keyfrm : keyfrms) {
-        for (const auto& lm : keyfrm->get_landmarks()) {
+    for (const auto& keyfrm : cached_keyfrms_) {
+        keyfrm->for_each_landmark([this, &already_found_landmark_ids](const std::shared_ptr<data::landmark>& lm, const unsigned int) {
             if (!lm) {
-                continue;
+                return;
             }
             if (lm->will_be_erased()) {
-                continue;
+                return;
             }
-            if (already_found_landmark_ids.count(lm->id_)) {
-                continue;
+            if (!already_found_landmark_ids.insert(lm->id_).second) {
+                return;
             }
 
-            already_found_landmark_ids.insert(lm->id_);
-            all_landmarks.push_back(lm);
-        }
+            cached_landmarks_.push_back(lm);
+        });
     }
-
-    const auto _local_landmarks = map_db_->get_local_landmarks();
-    local_landmarks = std::set<std::shared_ptr<data::landmark>>(_local_landmarks.begin(), _local_landmarks.end());
-    return map_db_->get_num_landmarks();
 }
 
 } // namespace publish
@@ -2,22 +2,73 @@
 #define STELLA_VSLAM_PUBLISH_MAP_PUBLISHER_H
 
 #include "stella_vslam/type.h"
+#include "stella_vslam/util/seqlock.h"
 
+#include <atomic>
+#include <cstdint>
+#include <functional>
 #include <mutex>
 #include <memory>
+#include <vector>
+#include <unordered_map>
 
 namespace stella_vslam {
 
 class config;
+enum class tracker_state_t;
 
 namespace data {
 class keyframe;
 class landmark;
 class map_database;
+struct map_change;
 } // namespace data
 
 namespace publish {
 
+//! Latest camera pose with the frame
+struct current_cam_pose {
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    //! camera pose of the last tracked frame
+    Mat44_t cam_pose_cw_ = Mat44_t::Identity();
+    //! timestamp of the latest frame
+    double timestamp_ = 0.0;
+    //! tracking state of the latest frame (the pose is not updated unless it is Tracking)
+    tracker_state_t tracking_state_{};
+    //! sequence number of the update (0 until the first update, then it increases at each update)
+    uint64_t seq_ = 0;
+};
+
+//! Flat arrays of the landmarks in the current map
+struct landmark_points {
+    //! landmark IDs
+    std::vector<unsigned int> ids_;
+    //! positions in the world coordinates (x, y and z of each landmark)
+    std::vector<float> positions_;
+    //! observed ratios of the landmarks
+    std::vector<float> observed_ratios_;
+};
+
+//! Immutable snapshot of the landmarks which the viewers read without locking the map
+struct landmarks_snapshot {
+    //! incremented whenever a new snapshot is published
+    uint64_t version_ = 0;
+    //! landmarks in the current map (shared between the snapshots until the map is changed)
+    std::shared_ptr<const landmark_points> points_ = std::make_shared<const landmark_points>();
+    //! bitmap of the local landmarks (the bit of the i-th landmark is (i % 64) of the (i / 64)-th word)
+    std::vector<uint64_t> local_flags_;
+
+    //! number of the landmarks
+    size_t size() const { return points_->ids_.size(); }
+
+    //! position of the i-th landmark
+    const float* get_position(const size_t idx) const { return points_->positions_.data() + 3 * idx; }
+
+    //! the i-th landmark is a local landmark or not
+    bool is_local(const size_t idx) const { return (local_flags_.at(idx / 64) >> (idx % 64)) & 1; }
+};
+
 class map_publisher {
 public:
     EIGEN_MAKE_ALIGNED_OPERATOR_NEW
@@ -41,12 +92,87 @@ public:
      */
     void set_current_cam_pose(const Mat44_t& cam_pose_cw);
 
+    /**
+     * Set current camera pose with the frame
+     * NOTE: should be accessed from tracker thread
+     * @param cam_pose_cw
+     * @param timestamp
+     * @param tracking_state
+     */
+    void set_current_cam_pose(const Mat44_t& cam_pose_cw, const double timestamp, const tracker_state_t tracking_state);
+
+    /**
+     * Set current camera pose with the frame and the motion model to extrapolate the pose
+     * NOTE: should be accessed from tracker thread
+     * @param cam_pose_cw
+     * @param timestamp
+     * @param tracking_state
+     * @param twist relative pose from the last frame to the current frame (the constant velocity model of the tracker)
+     * @param twist_dt time between the frames of the twist [s] (the pose is not extrapolated if it is not positive)
+     * @param latency time from the input of the frame to this call [s]
+     */
+    void set_current_cam_pose(const Mat44_t& cam_pose_cw, const double timestamp, const tracker_state_t tracking_state,
+                              const Mat44_t& twist, const double twist_dt, const double latency);
+
+    /**
+     * Set the function which integrates the rotation of the camera between the timestamps with the IMU
+     * (e.g. tracking_module::integrate_imu_rotation, the rotation is extrapolated by the motion model if it returns false)
+     * @param rotation_integrator (nullptr to remove)
+     */
+    void set_rotation_integrator(const std::function<bool(double, double, Mat33_t&)>& rotation_integrator);
+
+    /**
+     * Set the timestamp and the tracking state of the frame whose pose is not available
+     * NOTE: should be accessed from tracker thread
+     * @param timestamp
+     * @param tracking_state
+     */
+    void set_current_tracking_state(const double timestamp, const tracker_state_t tracking_state);
+
     /**
      * Get current camera pose
+     * NOTE: can be polled at high rates from any thread (lock-free, never blocks the tracker)
+     * @return
+     */
+    Mat44_t get_current_cam_pose() const;
+
+    /**
+     * Get current camera pose with the timestamp and the tracking state
+     * NOTE: can be polled at high rates from any thread (lock-free, never blocks the tracker)
+     * @return
+     */
+    current_cam_pose get_current_cam_pose_with_state() const;
+
+    /**
+     * Get the camera pose at the timestamp extrapolated from the latest pose
+     * (the pose is kept beyond max_prediction_time, or while the frames are not tracked)
+     * NOTE: can be polled at high rates from any thread (lock-free unless the rotation is integrated with the IMU)
+     * @param timestamp time in the clock of the frame timestamps
+     * @return
+     */
+    Mat44_t get_pose_at(const double timestamp) const;
+
+    /**
+     * Get the camera pose extrapolated to the present, which compensates the latency of the tracking
+     * and the time since the latest pose was set
+     * NOTE: can be polled at high rates from any thread (lock-free unless the rotation is integrated with the IMU)
+     * @param lead_time time to predict ahead additionally [s] (e.g. the latency of the consumer)
+     * @return
+     */
+    Mat44_t get_latency_compensated_pose(const double lead_time = 0.0) const;
+
+    /**
+     * Publish a new snapshot of the landmarks if the map or the local landmarks are changed
+     * NOTE: should be accessed from tracker thread (once per frame)
+     */
+    void update_landmarks_snapshot();
+
+    /**
+     * Get the latest snapshot of the landmarks without locking the map
      * NOTE: should be accessed from viewer thread
      * @return
      */
-    Mat44_t get_current_cam_pose();
+    std::shared_ptr<const landmarks_snapshot> get_landmarks_snapshot() const;
 
     /**
      * Get all keyframes
@@ -64,6 +190,35 @@ public:
     unsigned int get_landmarks(std::vector<std::shared_ptr<data::landmark>>& all_landmarks,
                                std::set<std::shared_ptr<data::landmark>>& local_landmarks);
 
+    /**
+     * Get the keyframe or nullptr if it does not exist
+     * @param id
+     * @return
+     */
+    std::shared_ptr<data::keyframe> get_keyframe(const unsigned int id) const;
+
+    /**
+     * Get the landmark or nullptr if it does not exist
+     * @param id
+     * @return
+     */
+    std::shared_ptr<data::landmark> get_landmark(const unsigned int id) const;
+
+    /**
+     * Get the changes of the keyframes and the landmarks after the version of the change journal
+     * @param version last version which the caller read
+     * @param changes
+     * @param latest_version version which the caller reads next time
+     * @return false if the caller has to collect the whole map again (e.g. the changes were discarded or the map was reset)
+     */
+    bool get_map_changes_since(const uint64_t version, std::vector<data::map_change>& changes, uint64_t& latest_version) const;
+
+    /**
+     * Get the version of the change journal, which is incremented whenever the keyframes or the landmarks are changed
+     * @return
+     */
+    uint64_t get_map_change_version() const;
+
 private:
     //! config
     std::shared_ptr<config> cfg_;
@@ -71,10 +226,84 @@ private:
     data::map_database* map_db_;
 
     // -------------------------------------------
-    //! mutex to access camera pose
+    //! trivially copyable record of the camera pose for the seqlock
+    struct cam_pose_record {
+        //! column-major camera pose
+        double cam_pose_cw_[16] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+        double timestamp_ = 0.0;
+        //! tracker_state_t (Initializing)
+        int tracking_state_ = 0;
+        //! angular velocity (rotation vector per second) of the motion model in the camera coordinates
+        double angular_velocity_[3] = {0, 0, 0};
+        //! translational velocity of the motion model in the camera coordinates [/s]
+        double linear_velocity_[3] = {0, 0, 0};
+        //! the velocities are valid or not
+        bool velocity_is_valid_ = false;
+        //! time from the input of the frame to the update [s]
+        double latency_ = 0.0;
+        //! steady clock when the record was updated [s]
+        double updated_at_ = 0.0;
+    };
+
+    //! Update the record of the camera pose (the pose is kept if nullptr, and the velocities are reset unless the twist is given)
+    void update_cam_pose_record(const Mat44_t* cam_pose_cw, const double* timestamp, const tracker_state_t* tracking_state,
+                                const Mat44_t* twist = nullptr, const double twist_dt = 0.0, const double latency = 0.0);
+
+    //! Extrapolate the pose of the record to the timestamp
+    Mat44_t predict_pose(const cam_pose_record& record, const double timestamp) const;
+
+    //! maximum time to extrapolate the pose [s]
+    const double max_prediction_time_;
+    //! mutex to access rotation_integrator_
+    mutable std::mutex mtx_rotation_integrator_;
+    //! integrator of the rotation with the IMU (can be empty)
+    std::function<bool(double, double, Mat33_t&)> rotation_integrator_;
+    //! rotation_integrator_ is set or not (the pollers do not lock the mutex without it)
+    std::atomic<bool> has_rotation_integrator_{false};
+
+    //! mutex to serialize the writers of the camera pose (the readers do not lock it)
     std::mutex mtx_cam_pose_;
-    Mat44_t cam_pose_cw_ = Mat44_t::Identity();
-    Mat44_t cam_pose_wc_ = Mat44_t::Identity();
+    //! latest camera pose
+    util::seqlock<cam_pose_record> cam_pose_;
+
+    // -------------------------------------------
+    //! mutex to swap the snapshot of the landmarks
+    mutable std::mutex mtx_lms_snapshot_;
+    //! latest snapshot of the landmarks
+    std::shared_ptr<const landmarks_snapshot> lms_snapshot_ = std::make_shared<const landmarks_snapshot>();
+    //! version of the change journal when the points of the snapshot were collected (accessed from tracker thread only)
+    uint64_t lms_snapshot_journal_version_ = 0;
+    //! local landmarks which the bitmap of the snapshot was built from (accessed from tracker thread only)
+    std::shared_ptr<const std::vector<std::shared_ptr<data::landmark>>> lms_snapshot_local_lms_ = nullptr;
+    //! indices of the landmarks in the points of the snapshot (accessed from tracker thread only)
+    std::unordered_map<unsigned int, unsigned int> lms_snapshot_indices_;
+
+    // -------------------------------------------
+    /**
+     * Collect the keyframes and landmarks of the current map again if the map database has been modified
+     * (NOTE: call this while locking mtx_map_cache_)
+     * @return false if there is no map
+     */
+    bool update_map_cache();
+
+    /**
+     * Collect the landmarks observed by the cached keyframes
+     * (NOTE: call this while locking mtx_map_cache_)
+     */
+    void collect_cached_landmarks();
+
+    //! mutex to access the cache of the current map
+    std::mutex mtx_map_cache_;
+    //! version of the map database when the cache was built
+    uint64_t map_cache_version_ = 0;
+    //! the cache is valid or not
+    bool map_cache_is_valid_ = false;
+    //! keyframes in the spanning tree of the current map
+    std::vector<std::shared_ptr<data::keyframe>> cached_keyfrms_;
+    //! landmarks observed by cached_keyfrms_ (collected on demand, since the keyframes alone are enough for the graph)
+    std::vector<std::shared_ptr<data::landmark>> cached_landmarks_;
+    //! cached_landmarks_ is collected from cached_keyfrms_ or not
+    bool cached_landmarks_are_valid_ = false;
 };
 
 } // namespace publish
@@ -0,0 +1,167 @@
+#include "stella_vslam/publish/metrics_publisher.h"
+
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+
+namespace stella_vslam {
+namespace publish {
+
+metrics_publisher::metrics_publisher(const std::string& prefix)
+    : prefix_(prefix) {}
+
+void metrics_publisher::describe(const std::string& name, const metric_type_t type, const std::string& help) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    get_metric(name, type).help_ = help;
+}
+
+void metrics_publisher::increment(const std::string& name, const std::string& labels, const uint64_t count) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    get_metric(name, metric_type_t::Counter).values_[labels].value_ += count;
+}
+
+void metrics_publisher::observe(const std::string& name, const double value, const std::string& labels) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto& metric_value = get_metric(name, metric_type_t::Summary).values_[labels];
+    metric_value.max_ = (metric_value.count_ == 0) ? value : std::max(metric_value.max_, value);
+    metric_value.value_ += value;
+    ++metric_value.count_;
+}
+
+void metrics_publisher::set_gauge(const std::string& name, const std::function<double()>& sampler, const std::string& help) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto& metric = get_metric(name, metric_type_t::Gauge);
+    metric.sampler_ = sampler;
+    if (!help.empty()) {
+        metric.help_ = help;
+    }
+}
+
+metric_value metrics_publisher::get_value(const std::string& name, const std::string& labels) const {
+    std::function<double()> sampler;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        const auto iter = metrics_.find(name);
+        if (iter == metrics_.end()) {
+            return metric_value();
+        }
+        if (!iter->second.sampler_) {
+            const auto value_iter = iter->second.values_.find(labels);
+            return (value_iter != iter->second.values_.end()) ? value_iter->second : metric_value();
+        }
+        sampler = iter->second.sampler_;
+    }
+    // (NOTE: the sampler might lock the map database, then it is called without the lock)
+    metric_value value;
+    value.value_ = sampler();
+    return value;
+}
+
+std::string metrics_publisher::get_prometheus_text() const {
+    // copy to call the samplers without the lock
+    std::map<std::string, metric> metrics;
+    std::vector<std::function<std::string(const std::string&)>> collectors;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        metrics = metrics_;
+        collectors = collectors_;
+    }
+
+    std::ostringstream oss;
+    oss.precision(17);
+    for (auto& name_metric : metrics) {
+        const auto name = prefix_ + name_metric.first;
+        auto& metric = name_metric.second;
+        if (metric.sampler_) {
+            metric.values_[""].value_ = metric.sampler_();
+        }
+        if (metric.values_.empty()) {
+            continue;
+        }
+
+        if (!metric.help_.empty()) {
+            oss << "# HELP " << name << " " << metric.help_ << "\n";
+        }
+        switch (metric.type_) {
+            case metric_type_t::Counter: {
+                oss << "# TYPE " << name << " counter\n";
+                break;
+            }
+            case metric_type_t::Gauge: {
+                oss << "# TYPE " << name << " gauge\n";
+                break;
+            }
+            case metric_type_t::Summary: {
+                oss << "# TYPE " << name << " summary\n";
+                break;
+            }
+        }
+
+        for (const auto& labels_value : metric.values_) {
+            const auto labels = labels_value.first.empty() ? std::string() : "{" + labels_value.first + "}";
+            const auto& value = labels_value.second;
+            if (metric.type_ != metric_type_t::Summary) {
+                oss << name << labels << " " << value.value_ << "\n";
+                continue;
+            }
+            oss << name << "_sum" << labels << " " << value.value_ << "\n";
+            oss << name << "_count" << labels << " " << value.count_ << "\n";
+        }
+        // the maximums of the summaries are exposed as the gauges
+        if (metric.type_ == metric_type_t::Summary) {
+            oss << "# TYPE " << name << "_max gauge\n";
+            for (const auto& labels_value : metric.values_) {
+                const auto labels = labels_value.first.empty() ? std::string() : "{" + labels_value.first + "}";
+                oss << name << "_max" << labels << " " << labels_value.second.max_ << "\n";
+            }
+        }
+    }
+    for (const auto& collector : collectors) {
+        oss << collector(prefix_);
+    }
+    return oss.str();
+}
+
+void metrics_publisher::add_collector(const std::function<std::string(const std::string&)>& collector) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    collectors_.push_back(collector);
+}
+
+void metrics_publisher::set_callback(const std::function<void(const std::string&)>& callback, const unsigned int interval_ms) {
+    std::lock_guard<std::mutex> lock(mtx_callback_);
+    callback_ = callback;
+    callback_interval_ms_ = interval_ms;
+    last_notified_ms_ = 0;
+}
+
+void metrics_publisher::notify_if_due() {
+    std::function<void(const std::string&)> callback;
+    {
+        std::lock_guard<std::mutex> lock(mtx_callback_);
+        if (!callback_) {
+            return;
+        }
+        const int64_t now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                                   std::chrono::steady_clock::now().time_since_epoch())
+                                   .count();
+        if (last_notified_ms_ != 0 && now_ms - last_notified_ms_ < static_cast<int64_t>(callback_interval_ms_)) {
+            return;
+        }
+        last_notified_ms_ = now_ms;
+        callback = callback_;
+    }
+    callback(get_prometheus_text());
+}
+
+metrics_publisher::metric& metrics_publisher::get_metric(const std::string& name, const metric_type_t type) {
+    const auto iter = metrics_.find(name);
+    if (iter != metrics_.end()) {
+        return iter->second;
+    }
+    auto& metric = metrics_[name];
+    metric.type_ = type;
+    return metric;
+}
+
+} // namespace publish
+} // namespace stella_vslam
@@ -0,0 +1,121 @@
+#ifndef STELLA_VSLAM_PUBLISH_METRICS_PUBLISHER_H
+#define STELLA_VSLAM_PUBLISH_METRICS_PUBLISHER_H
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace stella_vslam {
+namespace publish {
+
+//! Type of a metric
+enum class metric_type_t {
+    Counter,
+    Gauge,
+    Summary
+};
+
+//! Value of a metric with a set of labels
+struct metric_value {
+    //! value of the counter or the gauge, or the sum of the observations of the summary
+    double value_ = 0.0;
+    //! number of the observations of the summary
+    uint64_t count_ = 0;
+    //! maximum of the observations of the summary
+    double max_ = 0.0;
+};
+
+/**
+ * Counters, gauges and summaries of the SLAM pipeline, which can be scraped without any viewer
+ * The modules push the counters and the summaries, and the gauges are sampled when the metrics are read.
+ * The labels are written in the Prometheus syntax, e.g. "from=\"Tracking\",to=\"Lost\"".
+ */
+class metrics_publisher {
+public:
+    /**
+     * Constructor
+     * @param prefix prefix of the metric names
+     */
+    explicit metrics_publisher(const std::string& prefix = "stella_vslam_");
+
+    /**
+     * Destructor
+     */
+    virtual ~metrics_publisher() = default;
+
+    /**
+     * Set the help text of the metric
+     * @param name
+     * @param type
+     * @param help
+     */
+    void describe(const std::string& name, const metric_type_t type, const std::string& help);
+
+    //! Increment the counter
+    void increment(const std::string& name, const std::string& labels = "", const uint64_t count = 1);
+
+    //! Add an observation (e.g. a duration [ms]) to the summary
+    void observe(const std::string& name, const double value, const std::string& labels = "");
+
+    //! Set the function which samples the gauge when the metrics are read
+    void set_gauge(const std::string& name, const std::function<double()>& sampler, const std::string& help = "");
+
+    //! Add the function which writes the metrics of its own in the Prometheus text exposition format
+    //! (called with the prefix of the metric names when the metrics are read, e.g. util::lock_profiler::get_prometheus_text())
+    void add_collector(const std::function<std::string(const std::string&)>& collector);
+
+    //! Get the value of the metric (the gauges are sampled)
+    metric_value get_value(const std::string& name, const std::string& labels = "") const;
+
+    //! Get all of the metrics in the Prometheus text exposition format
+    std::string get_prometheus_text() const;
+
+    /**
+     * Call the callback with the text of the metrics if the interval has passed since the last call
+     * (NOTE: this is called by the system on each frame, then the callback runs on the tracking thread)
+     * @param callback
+     * @param interval_ms
+     */
+    void set_callback(const std::function<void(const std::string&)>& callback, const unsigned int interval_ms);
+
+    //! Call the callback if it is due (called from the tracking thread)
+    void notify_if_due();
+
+private:
+    struct metric {
+        metric_type_t type_ = metric_type_t::Counter;
+        std::string help_;
+        //! values of each set of labels
+        std::map<std::string, metric_value> values_;
+        //! sampler of the gauge
+        std::function<double()> sampler_;
+    };
+
+    //! Get the metric, which is created as the type if it does not exist (mtx_ must be locked)
+    metric& get_metric(const std::string& name, const metric_type_t type);
+
+    //! prefix of the metric names
+    const std::string prefix_;
+
+    //! mutex to access the metrics
+    mutable std::mutex mtx_;
+    //! metrics ordered by the name
+    std::map<std::string, metric> metrics_;
+    //! writers of the other metrics
+    std::vector<std::function<std::string(const std::string&)>> collectors_;
+
+    //! mutex to access the callback
+    std::mutex mtx_callback_;
+    std::function<void(const std::string&)> callback_;
+    unsigned int callback_interval_ms_ = 0;
+    //! time of the last call of the callback [ms] (steady clock)
+    int64_t last_notified_ms_ = 0;
+};
+
+} // namespace publish
+} // namespace stella_vslam
+
+#endif // STELLA_VSLAM_PUBLISH_METRICS_PUBLISHER_H
@@ -1,8 +1,12 @@
 #include "stella_vslam/solve/essential_solver.h"
+#include "stella_vslam/solve/ransac.h"
 #include "stella_vslam/util/converter.h"
 #include "stella_vslam/util/random_array.h"
+#include "stella_vslam/util/thread_pool.h"
 #include "stella_vslam/util/trigonometric.h"
 
+#include <algorithm>
+
 namespace stella_vslam {
 namespace solve {
 
@@ -11,7 +15,7 @@ essential_solver::essential_solver(const eigen_alloc_vector<Vec3_t>& bearings_1,
     : bearings_1_(bearings_1), bearings_2_(bearings_2), matches_12_(matches_12),
       random_engine_(util::create_random_engine(use_fixed_seed)) {}
 
-void essential_solver::find_via_ransac(const unsigned int max_num_iter, const bool recompute) {
+void essential_solver::find_via_ransac(const unsigned int max_num_iter, const bool recompute, util::thread_pool* thread_pool) {
     const auto num_matches = static_cast<unsigned int>(matches_12_.size());
 
     // 1. Prepare for RANSAC
@@ -27,39 +31,112 @@ void essential_solver::find_via_ransac(const unsigned int max_num_iter, const bo
     best_cost_ = std::numeric_limits<float>::max();
     is_inlier_match_ = std::vector<bool>(num_matches, false);
 
-    // minimum set of keypoint matches
-    eigen_alloc_vector<Vec3_t> min_set_bearings_1(min_set_size);
-    eigen_alloc_vector<Vec3_t> min_set_bearings_2(min_set_size);
+    // number of the minimal sets sampled at once
+    // (NOTE: the hypotheses of a batch are computed and verified concurrently if thread_pool is given)
+    constexpr unsigned int num_min_sets_in_batch = 8;
 
-    // shared variables in RANSAC loop
-    // essential matrix from shot 1 to shot 2
-    Mat33_t E_21_in_sac;
-    // inlier/outlier flags
-    std::vector<bool> is_inlier_match_in_sac(num_matches, false);
+    // hypotheses computed from the minimal sets of a batch, and the results of their verification
+    std::vector<std::vector<unsigned int>> min_sets_in_batch(num_min_sets_in_batch);
+    eigen_alloc_vector<Mat33_t> Es_21_in_batch(num_min_sets_in_batch);
+    std::vector<ransac::verification_state> states_in_batch(num_min_sets_in_batch);
+    std::vector<std::vector<bool>> is_inlier_matches_in_batch(num_min_sets_in_batch, std::vector<bool>(num_matches, false));
+    std::vector<unsigned int> num_inliers_in_batch(num_min_sets_in_batch);
+    std::vector<float> costs_in_batch(num_min_sets_in_batch);
 
     // 2. RANSAC loop
 
-    for (unsigned int iter = 0; iter < max_num_iter; iter++) {
+    ransac sac(num_matches, min_set_size, max_num_iter, random_engine_);
+    sac.set_sampling_order(sampling_order_);
+
+    // the matches are checked in the random order
+    verification_order_ = sac.get_verification_order();
+    matched_bearings_1_.resize(3, num_matches);
+    matched_bearings_2_.resize(3, num_matches);
+    for (unsigned int i = 0; i < num_matches; ++i) {
+        const auto& match = matches_12_.at(verification_order_.at(i));
+        matched_bearings_1_.col(i) = bearings_1_.at(match.first);
+        matched_bearings_2_.col(i) = bearings_2_.at(match.second);
+    }
+
+    // compute the hypothesis of the k-th minimal set in the batch and verify it
+    // (NOTE: only the k-th elements of the batch are written, and the SPRT threshold is not changed during the batch)
+    const auto evaluate = [&](const unsigned int k) {
         // 2-1. Create a minimum set
-        const auto indices = util::create_random_array(min_set_size, 0U, num_matches - 1, random_engine_);
+        eigen_alloc_vector<Vec3_t> min_set_bearings_1(min_set_size);
+        eigen_alloc_vector<Vec3_t> min_set_bearings_2(min_set_size);
         for (unsigned int i = 0; i < min_set_size; ++i) {
-            const auto idx = indices.at(i);
+            const auto idx = min_sets_in_batch.at(k).at(i);
             min_set_bearings_1.at(i) = bearings_1_.at(matches_12_.at(idx).first);
             min_set_bearings_2.at(i) = bearings_2_.at(matches_12_.at(idx).second);
         }
 
         // 2-2. Compute an essential matrix
-        E_21_in_sac = compute_E_21(min_set_bearings_1, min_set_bearings_2);
+        Es_21_in_batch.at(k) = compute_E_21(min_set_bearings_1, min_set_bearings_2);
 
         // 2-3. Check inliers and compute a cost
-        float cost_in_sac;
-        unsigned int num_inliers = check_inliers(E_21_in_sac, is_inlier_match_in_sac, cost_in_sac);
-
-        // 2-4. Update the best model
-        if (num_inliers > min_set_size && best_cost_ > cost_in_sac) {
-            best_cost_ = cost_in_sac;
-            best_E_21_ = E_21_in_sac;
-            is_inlier_match_ = is_inlier_match_in_sac;
+        states_in_batch.at(k) = ransac::verification_state();
+        num_inliers_in_batch.at(k) = check_inliers(Es_21_in_batch.at(k), is_inlier_matches_in_batch.at(k), costs_in_batch.at(k),
+                                                   &sac, &states_in_batch.at(k));
+    };
+
+    // essential matrix, inlier/outlier flags and cost of the local optimization
+    Mat33_t E_21_in_sac;
+    std::vector<bool> is_inlier_match_in_sac(num_matches, false);
+    float cost_in_sac;
+
+    bool is_terminated = false;
+    while (!is_terminated) {
+        unsigned int num_in_batch = 0;
+        while (num_in_batch < num_min_sets_in_batch) {
+            if (!sac.next_min_set(min_sets_in_batch.at(num_in_batch))) {
+                is_terminated = true;
+                break;
+            }
+            ++num_in_batch;
+        }
+        if (num_in_batch == 0) {
+            continue;
+        }
+
+        if (thread_pool && 1 < num_in_batch) {
+            // the minimal sets except the last one are evaluated on the workers, and the last one on this thread
+            std::vector<std::future<void>> futures;
+            futures.reserve(num_in_batch - 1);
+            for (unsigned int k = 0; k + 1 < num_in_batch; ++k) {
+                futures.push_back(thread_pool->submit(std::bind(evaluate, k), util::task_priority_t::High));
+            }
+            evaluate(num_in_batch - 1);
+            for (auto& future : futures) {
+                thread_pool->wait(future, util::task_priority_t::High);
+                future.get();
+            }
+        }
+        else {
+            for (unsigned int k = 0; k < num_in_batch; ++k) {
+                evaluate(k);
+            }
+        }
+
+        // 2-4. Update the best model in the sampling order
+        for (unsigned int k = 0; k < num_in_batch; ++k) {
+            const bool is_best = !states_in_batch.at(k).is_rejected_ && num_inliers_in_batch.at(k) > min_set_size
+                                 && best_cost_ > costs_in_batch.at(k);
+            if (is_best) {
+                best_cost_ = costs_in_batch.at(k);
+                best_E_21_ = Es_21_in_batch.at(k);
+                is_inlier_match_ = is_inlier_matches_in_batch.at(k);
+
+                // 2-5. Refine the best model with its inliers (local optimization),
+                //      which keeps the accuracy even if the iterations are terminated early
+                E_21_in_sac = compute_E_21_from_inliers(is_inlier_matches_in_batch.at(k));
+                const auto num_inliers = check_inliers(E_21_in_sac, is_inlier_match_in_sac, cost_in_sac);
+                if (num_inliers > min_set_size && best_cost_ > cost_in_sac) {
+                    best_cost_ = cost_in_sac;
+                    best_E_21_ = E_21_in_sac;
+                    is_inlier_match_ = is_inlier_match_in_sac;
+                }
+            }
+            sac.end_verification(states_in_batch.at(k), is_best);
         }
     }
 
@@ -71,18 +148,22 @@ void essential_solver::find_via_ransac(const unsigned int max_num_iter, const bo
 
     // 3. Recompute an essential matrix only with the inlier matches
 
+    best_E_21_ = compute_E_21_from_inliers(is_inlier_match_);
+    check_inliers(best_E_21_, is_inlier_match_, best_cost_);
+}
+
+Mat33_t essential_solver::compute_E_21_from_inliers(const std::vector<bool>& is_inlier_match) const {
     eigen_alloc_vector<Vec3_t> inlier_bearing_1;
     eigen_alloc_vector<Vec3_t> inlier_bearing_2;
     inlier_bearing_1.reserve(matches_12_.size());
     inlier_bearing_2.reserve(matches_12_.size());
     for (unsigned int i = 0; i < matches_12_.size(); ++i) {
-        if (is_inlier_match_.at(i)) {
+        if (is_inlier_match.at(i)) {
             inlier_bearing_1.push_back(bearings_1_.at(matches_12_.at(i).first));
             inlier_bearing_2.push_back(bearings_2_.at(matches_12_.at(i).second));
         }
     }
-    best_E_21_ = solve::essential_solver::compute_E_21(inlier_bearing_1, inlier_bearing_2);
-    check_inliers(best_E_21_, is_inlier_match_, best_cost_);
+    return solve::essential_solver::compute_E_21(inlier_bearing_1, inlier_bearing_2);
 }
 
 Mat33_t essential_solver::compute_E_21(const eigen_alloc_vector<Vec3_t>& bearings_1, const eigen_alloc_vector<Vec3_t>& bearings_2) {
@@ -154,9 +235,14 @@ Mat33_t essential_solver::create_E_21(const Mat33_t& rot_1w, const Vec3_t& trans
     return trans_21_x * rot_21;
 }
 
-unsigned int essential_solver::check_inliers(const Mat33_t& E_21, std::vector<bool>& is_inlier_match, float& cost) {
+void essential_solver::set_descriptor_distances(const std::vector<unsigned int>& distances) {
+    sampling_order_ = ransac::sort_by_distance(distances);
+}
+
+unsigned int essential_solver::check_inliers(const Mat33_t& E_21, std::vector<bool>& is_inlier_match, float& cost,
+                                             const ransac* sac, ransac::verification_state* state) const {
     unsigned int num_inliers = 0;
-    const auto num_points = matches_12_.size();
+    const unsigned int num_points = matches_12_.size();
 
     is_inlier_match.resize(num_points);
 
@@ -167,26 +253,57 @@ unsigned int essential_solver::check_inliers(const Mat33_t& E_21, std::vector<bo
     // outlier threshold of cosine between a bearing vector and the epipolar plane
     const float cos_angle_thr = util::cos(1.0 * M_PI / 180.0);
 
-    for (unsigned int i = 0; i < num_points; ++i) {
-        const auto& bearing_1 = bearings_1_.at(matches_12_.at(i).first);
-        const auto& bearing_2 = bearings_2_.at(matches_12_.at(i).second);
-
-        const Vec3_t epiplane_in_2 = E_21 * bearing_1;
-        const float cos_in_2 = epiplane_in_2.cross(bearing_2).norm() / epiplane_in_2.norm();
-
-        const Vec3_t epiplane_in_1 = E_12 * bearing_2;
-        const float cos_in_1 = epiplane_in_1.cross(bearing_1).norm() / epiplane_in_1.norm();
-
-        float worst_cos_angle = std::min(cos_in_1, cos_in_2);
-
-        if (cos_angle_thr < worst_cos_angle) {
-            is_inlier_match.at(i) = true;
-            cost += 1.0 - worst_cos_angle;
-            num_inliers++;
+    // cosine of the angles between the bearing vectors and the epipolar planes,
+    // i.e. the norms of the cross products of the unit bearing vectors and the unit normals of the planes
+    // (NOTE: the coordinates are handled as the contiguous arrays, which are vectorized by Eigen with SSE/AVX/NEON)
+    const auto compute_cos_to_planes = [](const Mat33_t& E, const RowMajorMat3X_t& bearings_from, const RowMajorMat3X_t& bearings_to,
+                                          const unsigned int begin, const unsigned int num_block) {
+        const auto x_from = bearings_from.row(0).segment(begin, num_block).array();
+        const auto y_from = bearings_from.row(1).segment(begin, num_block).array();
+        const auto z_from = bearings_from.row(2).segment(begin, num_block).array();
+        const auto x_to = bearings_to.row(0).segment(begin, num_block).array();
+        const auto y_to = bearings_to.row(1).segment(begin, num_block).array();
+        const auto z_to = bearings_to.row(2).segment(begin, num_block).array();
+
+        // normals of the epipolar planes
+        const ransac::block_array_t n_x = E(0, 0) * x_from + E(0, 1) * y_from + E(0, 2) * z_from;
+        const ransac::block_array_t n_y = E(1, 0) * x_from + E(1, 1) * y_from + E(1, 2) * z_from;
+        const ransac::block_array_t n_z = E(2, 0) * x_from + E(2, 1) * y_from + E(2, 2) * z_from;
+
+        const ransac::block_array_t cross_x = n_y * z_to - n_z * y_to;
+        const ransac::block_array_t cross_y = n_z * x_to - n_x * z_to;
+        const ransac::block_array_t cross_z = n_x * y_to - n_y * x_to;
+        const ransac::block_array_t cos_angles = ((cross_x.square() + cross_y.square() + cross_z.square())
+                                                  / (n_x.square() + n_y.square() + n_z.square()))
+                                                     .sqrt();
+        return cos_angles;
+    };
+
+    for (unsigned int begin = 0; begin < num_points; begin += ransac::verification_block_size) {
+        const unsigned int num_block = std::min(ransac::verification_block_size, num_points - begin);
+
+        const ransac::block_array_t cos_in_2 = compute_cos_to_planes(E_21, matched_bearings_1_, matched_bearings_2_, begin, num_block);
+        const ransac::block_array_t cos_in_1 = compute_cos_to_planes(E_12, matched_bearings_2_, matched_bearings_1_, begin, num_block);
+
+        unsigned int num_inliers_in_block = 0;
+        for (unsigned int j = 0; j < num_block; ++j) {
+            const auto i = verification_order_.at(begin + j);
+            const float worst_cos_angle = std::min(cos_in_1(j), cos_in_2(j));
+
+            if (cos_angle_thr < worst_cos_angle) {
+                is_inlier_match.at(i) = true;
+                cost += 1.0 - worst_cos_angle;
+                num_inliers_in_block++;
+            }
+            else {
+                is_inlier_match.at(i) = false;
+                cost += 1.0 - cos_angle_thr;
+            }
         }
-        else {
-            is_inlier_match.at(i) = false;
-            cost += 1.0 - cos_angle_thr;
+        num_inliers += num_inliers_in_block;
+
+        if (sac && !sac->verify(*state, num_inliers_in_block, num_block)) {
+            break;
         }
     }
 
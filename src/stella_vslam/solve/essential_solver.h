@@ -2,11 +2,17 @@
 #define STELLA_VSLAM_SOLVE_ESSENTIAL_SOLVER_H
 
 #include "stella_vslam/type.h"
+#include "stella_vslam/solve/ransac.h"
 
 #include <vector>
 #include <random>
 
 namespace stella_vslam {
+
+namespace util {
+class thread_pool;
+} // namespace util
+
 namespace solve {
 
 class essential_solver {
@@ -20,8 +26,21 @@ public:
     //! Destructor
     virtual ~essential_solver() = default;
 
-    //! Find the most reliable essential matrix via RANSAC
-    void find_via_ransac(const unsigned int max_num_iter, const bool recompute = true);
+    /**
+     * Sample the minimal sets progressively from the matches with the smaller descriptor distances (PROSAC)
+     * @param distances descriptor distances of the matches
+     */
+    void set_descriptor_distances(const std::vector<unsigned int>& distances);
+
+    /**
+     * Find the most reliable essential matrix via RANSAC
+     * (NOTE: the hypotheses of a batch of the minimal sets are computed and verified concurrently on the workers if thread_pool is not nullptr,
+     *  and the best one is selected in the sampling order, so the solution does not depend on the threads)
+     * @param max_num_iter
+     * @param recompute
+     * @param thread_pool
+     */
+    void find_via_ransac(const unsigned int max_num_iter, const bool recompute = true, util::thread_pool* thread_pool = nullptr);
 
     //! Check if the solution is valid or not
     bool solution_is_valid() const {
@@ -54,8 +73,12 @@ public:
 
 private:
     //! Check inliers of the epipolar constraint
-    //! (Note: inlier flags are set to `inlier_match`)
-    unsigned int check_inliers(const Mat33_t& E_21, std::vector<bool>& is_inlier_match, float& cost);
+    //! (Note: inlier flags are set to `inlier_match`, and the check is stopped if the hypothesis is rejected by SPRT of `sac` with `state`)
+    unsigned int check_inliers(const Mat33_t& E_21, std::vector<bool>& is_inlier_match, float& cost,
+                               const ransac* sac = nullptr, ransac::verification_state* state = nullptr) const;
+
+    //! Compute an essential matrix only with the inlier matches
+    Mat33_t compute_E_21_from_inliers(const std::vector<bool>& is_inlier_match) const;
 
     //! bearing vectors of shot 1
     const eigen_alloc_vector<Vec3_t>& bearings_1_;
@@ -74,6 +97,13 @@ private:
     std::vector<bool> is_inlier_match_;
     //! random engine for RANSAC
     std::mt19937 random_engine_;
+    //! sampling order of the matches for PROSAC (empty if not used)
+    std::vector<unsigned int> sampling_order_;
+    //! order of the matches to check the inliers, and the matched bearing vectors of shots 1 and 2 in this order
+    //! as the structure of arrays (for the vectorized check of the inliers)
+    std::vector<unsigned int> verification_order_;
+    RowMajorMat3X_t matched_bearings_1_;
+    RowMajorMat3X_t matched_bearings_2_;
 };
 
 } // namespace solve
@@ -1,10 +1,13 @@
 #include "stella_vslam/solve/common.h"
 #include "stella_vslam/solve/essential_solver.h"
 #include "stella_vslam/solve/fundamental_solver.h"
+#include "stella_vslam/solve/ransac.h"
 #include "stella_vslam/util/converter.h"
 #include "stella_vslam/util/random_array.h"
 #include "stella_vslam/util/trigonometric.h"
 
+#include <algorithm>
+
 namespace stella_vslam {
 namespace solve {
 
@@ -51,9 +54,40 @@ void fundamental_solver::find_via_ransac(const unsigned int max_num_iter, const
 
     // 2. RANSAC loop
 
-    for (unsigned int iter = 0; iter < max_num_iter; iter++) {
+    ransac sac(num_matches, min_set_size, max_num_iter, random_engine_);
+    sac.set_sampling_order(sampling_order_);
+    std::vector<unsigned int> indices;
+
+    // the matches are checked in the random order
+    verification_order_ = sac.get_verification_order();
+    matched_pts_1_.resize(2, num_matches);
+    matched_pts_2_.resize(2, num_matches);
+    for (unsigned int i = 0; i < num_matches; ++i) {
+        const auto& match = matches_12_.at(verification_order_.at(i));
+        const auto& pt_1 = undist_keypts_1_.at(match.first).pt;
+        const auto& pt_2 = undist_keypts_2_.at(match.second).pt;
+        matched_pts_1_.col(i) << pt_1.x, pt_1.y;
+        matched_pts_2_.col(i) << pt_2.x, pt_2.y;
+    }
+
+    // compute a fundamental matrix only with the inlier matches
+    const auto compute_F_21_from_inliers = [&](const std::vector<bool>& is_inlier_match) -> Mat33_t {
+        std::vector<cv::Point2f> inlier_normalized_keypts_1;
+        std::vector<cv::Point2f> inlier_normalized_keypts_2;
+        inlier_normalized_keypts_1.reserve(matches_12_.size());
+        inlier_normalized_keypts_2.reserve(matches_12_.size());
+        for (unsigned int i = 0; i < matches_12_.size(); ++i) {
+            if (is_inlier_match.at(i)) {
+                inlier_normalized_keypts_1.push_back(normalized_keypts_1.at(matches_12_.at(i).first));
+                inlier_normalized_keypts_2.push_back(normalized_keypts_2.at(matches_12_.at(i).second));
+            }
+        }
+        const Mat33_t normalized_F_21 = compute_F_21(inlier_normalized_keypts_1, inlier_normalized_keypts_2);
+        return transform_2_t * normalized_F_21 * transform_1;
+    };
+
+    while (sac.next_min_set(indices)) {
         // 2-1. Create a minimum set
-        const auto indices = util::create_random_array(min_set_size, 0U, num_matches - 1, random_engine_);
         for (unsigned int i = 0; i < min_set_size; ++i) {
             const auto idx = indices.at(i);
             min_set_keypts_1.at(i) = normalized_keypts_1.at(matches_12_.at(idx).first);
@@ -65,15 +99,28 @@ void fundamental_solver::find_via_ransac(const unsigned int max_num_iter, const
         F_21_in_sac = transform_2_t * normalized_F_21 * transform_1;
 
         // 2-3. Check inliers and compute a cost
+        sac.begin_verification();
         float cost_in_sac;
-        unsigned int num_inliers = check_inliers(F_21_in_sac, is_inlier_match_in_sac, cost_in_sac);
+        unsigned int num_inliers = check_inliers(F_21_in_sac, is_inlier_match_in_sac, cost_in_sac, &sac);
 
         // 2-4. Update the best model
-        if (num_inliers > min_set_size && best_cost_ > cost_in_sac) {
+        const bool is_best = !sac.is_rejected() && num_inliers > min_set_size && best_cost_ > cost_in_sac;
+        if (is_best) {
             best_cost_ = cost_in_sac;
             best_F_21_ = F_21_in_sac;
             is_inlier_match_ = is_inlier_match_in_sac;
+
+            // 2-5. Refine the best model with its inliers (local optimization),
+            //      which keeps the accuracy even if the iterations are terminated early
+            F_21_in_sac = compute_F_21_from_inliers(is_inlier_match_in_sac);
+            num_inliers = check_inliers(F_21_in_sac, is_inlier_match_in_sac, cost_in_sac);
+            if (num_inliers > min_set_size && best_cost_ > cost_in_sac) {
+                best_cost_ = cost_in_sac;
+                best_F_21_ = F_21_in_sac;
+                is_inlier_match_ = is_inlier_match_in_sac;
+            }
         }
+        sac.end_verification(is_best);
     }
 
     solution_is_valid_ = best_cost_ < std::numeric_limits<float>::max();
@@ -84,18 +131,7 @@ void fundamental_solver::find_via_ransac(const unsigned int max_num_iter, const
 
     // 3. Recompute a fundamental matrix only with the inlier matches
 
-    std::vector<cv::Point2f> inlier_normalized_keypts_1;
-    std::vector<cv::Point2f> inlier_normalized_keypts_2;
-    inlier_normalized_keypts_1.reserve(matches_12_.size());
-    inlier_normalized_keypts_2.reserve(matches_12_.size());
-    for (unsigned int i = 0; i < matches_12_.size(); ++i) {
-        if (is_inlier_match_.at(i)) {
-            inlier_normalized_keypts_1.push_back(normalized_keypts_1.at(matches_12_.at(i).first));
-            inlier_normalized_keypts_2.push_back(normalized_keypts_2.at(matches_12_.at(i).second));
-        }
-    }
-    const Mat33_t normalized_F_21 = solve::fundamental_solver::compute_F_21(inlier_normalized_keypts_1, inlier_normalized_keypts_2);
-    best_F_21_ = transform_2_t * normalized_F_21 * transform_1;
+    best_F_21_ = compute_F_21_from_inliers(is_inlier_match_);
     check_inliers(best_F_21_, is_inlier_match_, best_cost_);
 }
 
@@ -145,9 +181,13 @@ Mat33_t fundamental_solver::create_F_21(const Mat33_t& rot_1w, const Vec3_t& tra
     return cam_matrix_2.transpose().inverse() * E_21 * cam_matrix_1.inverse();
 }
 
-unsigned int fundamental_solver::check_inliers(const Mat33_t& F_21, std::vector<bool>& is_inlier_match, float& cost) {
+void fundamental_solver::set_descriptor_distances(const std::vector<unsigned int>& distances) {
+    sampling_order_ = ransac::sort_by_distance(distances);
+}
+
+unsigned int fundamental_solver::check_inliers(const Mat33_t& F_21, std::vector<bool>& is_inlier_match, float& cost, ransac* sac) const {
     unsigned int num_inliers = 0;
-    const auto num_points = matches_12_.size();
+    const unsigned int num_points = matches_12_.size();
 
     // chi-squared value (p=0.05, n=2)
     constexpr float chi_sq = 5.991;
@@ -158,31 +198,50 @@ unsigned int fundamental_solver::check_inliers(const Mat33_t& F_21, std::vector<
 
     cost = 0.0;
 
-    for (unsigned int i = 0; i < num_points; ++i) {
-        const auto& keypt_1 = undist_keypts_1_.at(matches_12_.at(i).first);
-        const auto& keypt_2 = undist_keypts_2_.at(matches_12_.at(i).second);
+    for (unsigned int begin = 0; begin < num_points; begin += ransac::verification_block_size) {
+        const unsigned int num_block = std::min(ransac::verification_block_size, num_points - begin);
 
-        // 1. Transform to homogeneous coordinates
+        // 1. Acquire the keypoints
+        // (NOTE: the coordinates are handled as the contiguous arrays, which are vectorized by Eigen with SSE/AVX/NEON)
 
-        const Vec3_t pt_1 = util::converter::to_homogeneous(keypt_1.pt);
-        const Vec3_t pt_2 = util::converter::to_homogeneous(keypt_2.pt);
+        const auto x_1 = matched_pts_1_.row(0).segment(begin, num_block).array();
+        const auto y_1 = matched_pts_1_.row(1).segment(begin, num_block).array();
+        const auto x_2 = matched_pts_2_.row(0).segment(begin, num_block).array();
+        const auto y_2 = matched_pts_2_.row(1).segment(begin, num_block).array();
 
         // 2. Compute sampson error
 
-        const Vec3_t F_21_pt_1 = F_21 * pt_1;
-        const MatRC_t<1, 3> pt_2_F_21 = pt_2.transpose() * F_21;
-        const double pt_2_F_21_pt_1 = pt_2_F_21 * pt_1;
-        const double dist_sq = pt_2_F_21_pt_1 * pt_2_F_21_pt_1 / (F_21_pt_1.block<2, 1>(0, 0).squaredNorm() + pt_2_F_21.block<1, 2>(0, 0).squaredNorm());
-
-        const float thr = chi_sq * sigma_sq;
-        if (thr > dist_sq) {
-            is_inlier_match.at(i) = true;
-            cost += dist_sq;
-            num_inliers++;
+        // epipolar lines in shot 2 (F_21 * pt_1)
+        const ransac::block_array_t a_2 = F_21(0, 0) * x_1 + F_21(0, 1) * y_1 + F_21(0, 2);
+        const ransac::block_array_t b_2 = F_21(1, 0) * x_1 + F_21(1, 1) * y_1 + F_21(1, 2);
+        const ransac::block_array_t c_2 = F_21(2, 0) * x_1 + F_21(2, 1) * y_1 + F_21(2, 2);
+        // epipolar lines in shot 1 (transposed pt_2^T * F_21)
+        const ransac::block_array_t a_1 = F_21(0, 0) * x_2 + F_21(1, 0) * y_2 + F_21(2, 0);
+        const ransac::block_array_t b_1 = F_21(0, 1) * x_2 + F_21(1, 1) * y_2 + F_21(2, 1);
+
+        const ransac::block_array_t pt_2_F_21_pt_1 = a_2 * x_2 + b_2 * y_2 + c_2;
+        const ransac::block_array_t dist_sqs = pt_2_F_21_pt_1.square() / (a_2.square() + b_2.square() + a_1.square() + b_1.square());
+
+        unsigned int num_inliers_in_block = 0;
+        for (unsigned int j = 0; j < num_block; ++j) {
+            const auto i = verification_order_.at(begin + j);
+            const double dist_sq = dist_sqs(j);
+
+            const float thr = chi_sq * sigma_sq;
+            if (thr > dist_sq) {
+                is_inlier_match.at(i) = true;
+                cost += dist_sq;
+                num_inliers_in_block++;
+            }
+            else {
+                is_inlier_match.at(i) = false;
+                cost += thr;
+            }
         }
-        else {
-            is_inlier_match.at(i) = false;
-            cost += thr;
+        num_inliers += num_inliers_in_block;
+
+        if (sac && !sac->verify(num_inliers_in_block, num_block)) {
+            break;
         }
     }
 
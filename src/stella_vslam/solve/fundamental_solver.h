@@ -11,6 +11,8 @@
 namespace stella_vslam {
 namespace solve {
 
+class ransac;
+
 class fundamental_solver {
 public:
     EIGEN_MAKE_ALIGNED_OPERATOR_NEW
@@ -22,6 +24,12 @@ public:
     //! Destructor
     virtual ~fundamental_solver() = default;
 
+    /**
+     * Sample the minimal sets progressively from the matches with the smaller descriptor distances (PROSAC)
+     * @param distances descriptor distances of the matches
+     */
+    void set_descriptor_distances(const std::vector<unsigned int>& distances);
+
     //! Find the most reliable fundamental matrix via RASNAC
     void find_via_ransac(const unsigned int max_num_iter, const bool recompute = true);
 
@@ -58,8 +66,8 @@ public:
 
 private:
     //! Check inliers of the epipolar constraint
-    //! (Note: inlier flags are set to `inlier_match`)
-    unsigned int check_inliers(const Mat33_t& F_21, std::vector<bool>& is_inlier_match, float& cost);
+    //! (Note: inlier flags are set to `inlier_match`, and the check is stopped if the hypothesis is rejected by SPRT of `sac`)
+    unsigned int check_inliers(const Mat33_t& F_21, std::vector<bool>& is_inlier_match, float& cost, ransac* sac = nullptr) const;
 
     //! undistorted keypoints of shot 1
     const std::vector<cv::KeyPoint> undist_keypts_1_;
@@ -80,6 +88,13 @@ private:
     std::vector<bool> is_inlier_match_;
     //! random engine for RANSAC
     std::mt19937 random_engine_;
+    //! sampling order of the matches for PROSAC (empty if not used)
+    std::vector<unsigned int> sampling_order_;
+    //! order of the matches to check the inliers, and the matched keypoints of shots 1 and 2 in this order
+    //! as the structure of arrays (for the vectorized check of the inliers)
+    std::vector<unsigned int> verification_order_;
+    RowMajorMat2X_t matched_pts_1_;
+    RowMajorMat2X_t matched_pts_2_;
 };
 
 } // namespace solve
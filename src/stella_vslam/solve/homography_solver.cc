@@ -1,9 +1,12 @@
 #include "stella_vslam/solve/common.h"
 #include "stella_vslam/solve/homography_solver.h"
+#include "stella_vslam/solve/ransac.h"
 #include "stella_vslam/util/converter.h"
 #include "stella_vslam/util/random_array.h"
 #include "stella_vslam/util/trigonometric.h"
 
+#include <algorithm>
+
 namespace stella_vslam {
 namespace solve {
 
@@ -51,9 +54,40 @@ void homography_solver::find_via_ransac(const unsigned int max_num_iter, const b
 
     // 2. RANSAC loop
 
-    for (unsigned int iter = 0; iter < max_num_iter; ++iter) {
+    ransac sac(num_matches, min_set_size, max_num_iter, random_engine_);
+    sac.set_sampling_order(sampling_order_);
+    std::vector<unsigned int> indices;
+
+    // the matches are checked in the random order
+    verification_order_ = sac.get_verification_order();
+    matched_pts_1_.resize(2, num_matches);
+    matched_pts_2_.resize(2, num_matches);
+    for (unsigned int i = 0; i < num_matches; ++i) {
+        const auto& match = matches_12_.at(verification_order_.at(i));
+        const auto& pt_1 = undist_keypts_1_.at(match.first).pt;
+        const auto& pt_2 = undist_keypts_2_.at(match.second).pt;
+        matched_pts_1_.col(i) << pt_1.x, pt_1.y;
+        matched_pts_2_.col(i) << pt_2.x, pt_2.y;
+    }
+
+    // compute a homography matrix only with the inlier matches
+    const auto compute_H_21_from_inliers = [&](const std::vector<bool>& is_inlier_match) -> Mat33_t {
+        std::vector<cv::Point2f> inlier_normalized_keypts_1;
+        std::vector<cv::Point2f> inlier_normalized_keypts_2;
+        inlier_normalized_keypts_1.reserve(matches_12_.size());
+        inlier_normalized_keypts_2.reserve(matches_12_.size());
+        for (unsigned int i = 0; i < matches_12_.size(); ++i) {
+            if (is_inlier_match.at(i)) {
+                inlier_normalized_keypts_1.push_back(normalized_keypts_1.at(matches_12_.at(i).first));
+                inlier_normalized_keypts_2.push_back(normalized_keypts_2.at(matches_12_.at(i).second));
+            }
+        }
+        const Mat33_t normalized_H_21 = compute_H_21(inlier_normalized_keypts_1, inlier_normalized_keypts_2);
+        return transform_2_inv * normalized_H_21 * transform_1;
+    };
+
+    while (sac.next_min_set(indices)) {
         // 2-1. Create a minimum set
-        const auto indices = util::create_random_array(min_set_size, 0U, num_matches - 1, random_engine_);
         for (unsigned int i = 0; i < min_set_size; ++i) {
             const auto idx = indices.at(i);
             min_set_keypts_1.at(i) = normalized_keypts_1.at(matches_12_.at(idx).first);
@@ -65,15 +99,28 @@ void homography_solver::find_via_ransac(const unsigned int max_num_iter, const b
         H_21_in_sac = transform_2_inv * normalized_H_21 * transform_1;
 
         // 2-3. Check inliers and compute a score
+        sac.begin_verification();
         float cost_in_sac;
-        unsigned int num_inliers = check_inliers(H_21_in_sac, is_inlier_match_in_sac, cost_in_sac);
+        unsigned int num_inliers = check_inliers(H_21_in_sac, is_inlier_match_in_sac, cost_in_sac, &sac);
 
         // 2-4. Update the best model
-        if (num_inliers > min_set_size && best_cost_ > cost_in_sac) {
+        const bool is_best = !sac.is_rejected() && num_inliers > min_set_size && best_cost_ > cost_in_sac;
+        if (is_best) {
             best_cost_ = cost_in_sac;
             best_H_21_ = H_21_in_sac;
             is_inlier_match_ = is_inlier_match_in_sac;
+
+            // 2-5. Refine the best model with its inliers (local optimization),
+            //      which keeps the accuracy even if the iterations are terminated early
+            H_21_in_sac = compute_H_21_from_inliers(is_inlier_match_in_sac);
+            num_inliers = check_inliers(H_21_in_sac, is_inlier_match_in_sac, cost_in_sac);
+            if (num_inliers > min_set_size && best_cost_ > cost_in_sac) {
+                best_cost_ = cost_in_sac;
+                best_H_21_ = H_21_in_sac;
+                is_inlier_match_ = is_inlier_match_in_sac;
+            }
         }
+        sac.end_verification(is_best);
     }
 
     solution_is_valid_ = best_cost_ < std::numeric_limits<float>::max();
@@ -84,18 +131,7 @@ void homography_solver::find_via_ransac(const unsigned int max_num_iter, const b
 
     // 3. Recompute a homography matrix only with the inlier matches
 
-    std::vector<cv::Point2f> inlier_normalized_keypts_1;
-    std::vector<cv::Point2f> inlier_normalized_keypts_2;
-    inlier_normalized_keypts_1.reserve(matches_12_.size());
-    inlier_normalized_keypts_2.reserve(matches_12_.size());
-    for (unsigned int i = 0; i < matches_12_.size(); ++i) {
-        if (is_inlier_match_.at(i)) {
-            inlier_normalized_keypts_1.push_back(normalized_keypts_1.at(matches_12_.at(i).first));
-            inlier_normalized_keypts_2.push_back(normalized_keypts_2.at(matches_12_.at(i).second));
-        }
-    }
-    const Mat33_t normalized_H_21 = solve::homography_solver::compute_H_21(inlier_normalized_keypts_1, inlier_normalized_keypts_2);
-    best_H_21_ = transform_2_inv * normalized_H_21 * transform_1;
+    best_H_21_ = compute_H_21_from_inliers(is_inlier_match_);
     check_inliers(best_H_21_, is_inlier_match_, best_cost_);
 }
 
@@ -239,9 +275,13 @@ bool homography_solver::decompose(const Mat33_t& H_21, const Mat33_t& cam_matrix
     return true;
 }
 
-unsigned int homography_solver::check_inliers(const Mat33_t& H_21, std::vector<bool>& is_inlier_match, float& cost) {
+void homography_solver::set_descriptor_distances(const std::vector<unsigned int>& distances) {
+    sampling_order_ = ransac::sort_by_distance(distances);
+}
+
+unsigned int homography_solver::check_inliers(const Mat33_t& H_21, std::vector<bool>& is_inlier_match, float& cost, ransac* sac) const {
     unsigned int num_inliers = 0;
-    const auto num_matches = matches_12_.size();
+    const unsigned int num_matches = matches_12_.size();
 
     // chi-squared value (p=0.05, n=2)
     constexpr float chi_sq = 5.991;
@@ -252,38 +292,52 @@ unsigned int homography_solver::check_inliers(const Mat33_t& H_21, std::vector<b
 
     const float sigma_sq = sigma_ * sigma_;
 
-    cost = 0;
-
-    for (unsigned int i = 0; i < num_matches; ++i) {
-        const auto& keypt_1 = undist_keypts_1_.at(matches_12_.at(i).first);
-        const auto& keypt_2 = undist_keypts_2_.at(matches_12_.at(i).second);
-
-        // 1. Transform to homogeneous coordinates
-
-        const Vec3_t pt_1 = util::converter::to_homogeneous(keypt_1.pt);
-        const Vec3_t pt_2 = util::converter::to_homogeneous(keypt_2.pt);
+    // squared distances between the transformed points and the matched points
+    // (NOTE: the coordinates are handled as the contiguous arrays, which are vectorized by Eigen with SSE/AVX/NEON)
+    const auto compute_transfer_errors = [](const Mat33_t& H, const RowMajorMat2X_t& pts_from, const RowMajorMat2X_t& pts_to,
+                                            const unsigned int begin, const unsigned int num_block) {
+        const auto x_from = pts_from.row(0).segment(begin, num_block).array();
+        const auto y_from = pts_from.row(1).segment(begin, num_block).array();
+        const auto x_to = pts_to.row(0).segment(begin, num_block).array();
+        const auto y_to = pts_to.row(1).segment(begin, num_block).array();
+
+        const ransac::block_array_t inv_z = 1.0 / (H(2, 0) * x_from + H(2, 1) * y_from + H(2, 2));
+        const ransac::block_array_t transformed_x = (H(0, 0) * x_from + H(0, 1) * y_from + H(0, 2)) * inv_z;
+        const ransac::block_array_t transformed_y = (H(1, 0) * x_from + H(1, 1) * y_from + H(1, 2)) * inv_z;
+        const ransac::block_array_t dist_sqs = (x_to - transformed_x).square() + (y_to - transformed_y).square();
+        return dist_sqs;
+    };
 
-        // 2. Compute error
-
-        Vec3_t transformed_pt_1 = H_21 * pt_1;
-        transformed_pt_1 = transformed_pt_1 / transformed_pt_1(2);
-        const float dist_sq_1 = (pt_2 - transformed_pt_1).squaredNorm();
-
-        Vec3_t transformed_pt_2 = H_12 * pt_2;
-        transformed_pt_2 = transformed_pt_2 / transformed_pt_2(2);
-        const float dist_sq_2 = (pt_1 - transformed_pt_2).squaredNorm();
-
-        const float dist_sq = std::max(dist_sq_1, dist_sq_2);
+    cost = 0;
 
-        double thr = chi_sq * sigma_sq;
-        if (thr > dist_sq) {
-            is_inlier_match.at(i) = true;
-            cost += dist_sq;
-            num_inliers++;
+    for (unsigned int begin = 0; begin < num_matches; begin += ransac::verification_block_size) {
+        const unsigned int num_block = std::min(ransac::verification_block_size, num_matches - begin);
+
+        // 1. Compute error
+
+        const ransac::block_array_t dist_sqs_1 = compute_transfer_errors(H_21, matched_pts_1_, matched_pts_2_, begin, num_block);
+        const ransac::block_array_t dist_sqs_2 = compute_transfer_errors(H_12, matched_pts_2_, matched_pts_1_, begin, num_block);
+
+        unsigned int num_inliers_in_block = 0;
+        for (unsigned int j = 0; j < num_block; ++j) {
+            const auto i = verification_order_.at(begin + j);
+            const float dist_sq = std::max(dist_sqs_1(j), dist_sqs_2(j));
+
+            double thr = chi_sq * sigma_sq;
+            if (thr > dist_sq) {
+                is_inlier_match.at(i) = true;
+                cost += dist_sq;
+                num_inliers_in_block++;
+            }
+            else {
+                is_inlier_match.at(i) = false;
+                cost += thr;
+            }
         }
-        else {
-            is_inlier_match.at(i) = false;
-            cost += thr;
+        num_inliers += num_inliers_in_block;
+
+        if (sac && !sac->verify(num_inliers_in_block, num_block)) {
+            break;
         }
     }
 
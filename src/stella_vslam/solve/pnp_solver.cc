@@ -5,6 +5,9 @@
 
 #include <spdlog/spdlog.h>
 
+#include <algorithm>
+#include <array>
+
 namespace stella_vslam {
 namespace solve {
 
@@ -45,11 +48,13 @@ void pnp_solver::find_via_ransac(const unsigned int max_num_iter, const bool rec
     // 1. Prepare for RANSAC
 
     // minimum number of samples (= 4)
-    static constexpr unsigned int min_set_size = 4;
-    if (num_matches_ < min_set_size || num_matches_ < min_num_inliers_) {
+    // (NOTE: the local optimization and the recomputation need 4 matches even if P3P is used)
+    static constexpr unsigned int min_num_matches = 4;
+    if (num_matches_ < min_num_matches || num_matches_ < min_num_inliers_) {
         solution_is_valid_ = false;
         return;
     }
+    const unsigned int min_set_size = use_p3p_ ? 3 : 4;
 
     // RANSAC variables
     is_inlier_match = std::vector<bool>(num_matches_, false);
@@ -65,38 +70,93 @@ void pnp_solver::find_via_ransac(const unsigned int max_num_iter, const bool rec
     eigen_alloc_vector<Vec3_t> min_set_bearings;
     eigen_alloc_vector<Vec3_t> min_set_pos_ws;
 
+    // hypotheses computed from the minimal sets of a batch, and the results of their verification
+    eigen_alloc_vector<Mat33_t> rots_cw_in_batch;
+    eigen_alloc_vector<Vec3_t> transs_cw_in_batch;
+    std::vector<ransac::verification_state> states_in_batch;
+    std::vector<unsigned int> num_inliers_in_batch;
+    std::vector<double> costs_in_batch;
+
     // 2. RANSAC loop
 
-    double min_cost = std::numeric_limits<double>::max();
-    for (unsigned int iter = 0; iter < max_num_iter; ++iter) {
-        // 2-1. Create a minimum set
-        const auto random_indices = util::create_random_array(min_set_size, 0U, num_matches_ - 1, random_engine_);
-        assert(random_indices.size() == min_set_size);
+    ransac sac(num_matches_, min_set_size, max_num_iter, random_engine_);
+    sac.set_sampling_order(sampling_order_);
+    std::vector<unsigned int> random_indices;
 
-        min_set_bearings.clear();
-        min_set_pos_ws.clear();
+    // the matches are checked in the random order
+    verification_order_ = sac.get_verification_order();
+    verified_bearings_.resize(3, num_matches_);
+    verified_landmarks_.resize(3, num_matches_);
+    verified_max_cos_errors_.resize(num_matches_);
+    for (unsigned int i = 0; i < num_matches_; ++i) {
+        verified_bearings_.col(i) = valid_bearings_.at(verification_order_.at(i));
+        verified_landmarks_.col(i) = valid_landmarks_.at(verification_order_.at(i));
+        verified_max_cos_errors_(i) = max_cos_errors_.at(verification_order_.at(i));
+    }
 
-        for (const auto i : random_indices) {
-            const Vec3_t& bearing = valid_bearings_.at(i);
-            const Vec3_t& pos_w = valid_landmarks_.at(i);
+    // number of the minimal sets sampled at once
+    // (NOTE: the hypotheses of a batch are verified together, which transforms the 3D points by the stacked rotations)
+    constexpr unsigned int num_min_sets_in_batch = 4;
+    // size of the non-minimal sets for the local optimization
+    constexpr unsigned int local_optimization_set_size = 3 * min_num_matches;
 
-            min_set_bearings.push_back(bearing);
-            min_set_pos_ws.push_back(pos_w);
+    double min_cost = std::numeric_limits<double>::max();
+    bool is_terminated = false;
+    while (!is_terminated) {
+        // 2-1. Create the minimum sets, and 2-2. Compute the camera poses
+        rots_cw_in_batch.clear();
+        transs_cw_in_batch.clear();
+        for (unsigned int i = 0; i < num_min_sets_in_batch; ++i) {
+            if (!sac.next_min_set(random_indices)) {
+                is_terminated = true;
+                break;
+            }
+            assert(random_indices.size() == min_set_size);
+            compute_hypotheses(random_indices, rots_cw_in_batch, transs_cw_in_batch);
+        }
+        if (rots_cw_in_batch.empty()) {
+            continue;
         }
 
-        // 2-2. Compute a camera pose
-        compute_pose(min_set_bearings, min_set_pos_ws, rot_cw_in_sac, trans_cw_in_sac, gauss_newton_num_iter_);
-
-        // 2-3. Check inliers and compute a score
-        double cost = 0.0;
-        const auto num_inliers = check_inliers(rot_cw_in_sac, trans_cw_in_sac, is_inlier_match_in_sac, cost);
-
-        // 2-4. Update the best model
-        if (num_inliers > min_num_inliers_ && min_cost > cost) {
-            min_cost = cost;
-            best_rot_cw_ = rot_cw_in_sac;
-            best_trans_cw_ = trans_cw_in_sac;
-            is_inlier_match = is_inlier_match_in_sac;
+        // 2-3. Check inliers and compute the scores of the batch
+        check_inliers_of_hypotheses(rots_cw_in_batch, transs_cw_in_batch, sac, states_in_batch, num_inliers_in_batch, costs_in_batch);
+
+        for (unsigned int k = 0; k < rots_cw_in_batch.size(); ++k) {
+            // 2-4. Update the best model
+            const bool is_best = !states_in_batch.at(k).is_rejected_ && num_inliers_in_batch.at(k) > min_num_inliers_ && min_cost > costs_in_batch.at(k);
+            if (is_best) {
+                min_cost = costs_in_batch.at(k);
+                best_rot_cw_ = rots_cw_in_batch.at(k);
+                best_trans_cw_ = transs_cw_in_batch.at(k);
+                double cost = 0.0;
+                check_inliers(best_rot_cw_, best_trans_cw_, is_inlier_match, cost);
+
+                // 2-5. Refine the best model with the subsets of its inliers (local optimization),
+                //      which keeps the accuracy even if the iterations are terminated early
+                //      (NOTE: EPnP with all of the inliers is affected by the noise of the close landmarks,
+                //       then the poses are computed from the random subsets and verified as LO-RANSAC)
+                const auto best_is_inlier_match = is_inlier_match;
+                for (unsigned int lo_iter = 0; lo_iter < ransac::num_local_optimization_iter; ++lo_iter) {
+                    if (!sac.sample_from_inliers(best_is_inlier_match, local_optimization_set_size, random_indices)) {
+                        break;
+                    }
+                    min_set_bearings.clear();
+                    min_set_pos_ws.clear();
+                    for (const auto i : random_indices) {
+                        min_set_bearings.push_back(valid_bearings_.at(i));
+                        min_set_pos_ws.push_back(valid_landmarks_.at(i));
+                    }
+                    compute_pose(min_set_bearings, min_set_pos_ws, rot_cw_in_sac, trans_cw_in_sac, gauss_newton_num_iter_);
+                    const auto num_refined_inliers = check_inliers(rot_cw_in_sac, trans_cw_in_sac, is_inlier_match_in_sac, cost);
+                    if (num_refined_inliers > min_num_inliers_ && min_cost > cost) {
+                        min_cost = cost;
+                        best_rot_cw_ = rot_cw_in_sac;
+                        best_trans_cw_ = trans_cw_in_sac;
+                        is_inlier_match = is_inlier_match_in_sac;
+                    }
+                }
+            }
+            sac.end_verification(states_in_batch.at(k), is_best);
         }
     }
 
@@ -108,50 +168,159 @@ void pnp_solver::find_via_ransac(const unsigned int max_num_iter, const bool rec
 
     // 3. Recompute a camera pose only with the inlier matches
 
-    eigen_alloc_vector<Vec3_t> inlier_bearings;
-    eigen_alloc_vector<Vec3_t> inlier_pos_ws;
-    for (unsigned int i = 0; i < num_matches_; ++i) {
-        if (!is_inlier_match.at(i)) {
-            continue;
-        }
-        const Vec3_t& bearing = valid_bearings_.at(i);
-        const Vec3_t& pos_w = valid_landmarks_.at(i);
-        inlier_bearings.push_back(bearing);
-        inlier_pos_ws.push_back(pos_w);
-    }
+    compute_pose_from_inliers(is_inlier_match, best_rot_cw_, best_trans_cw_);
+}
 
-    compute_pose(inlier_bearings, inlier_pos_ws, best_rot_cw_, best_trans_cw_, gauss_newton_num_iter_);
+void pnp_solver::set_descriptor_distances(const std::vector<unsigned int>& distances) {
+    sampling_order_ = ransac::sort_by_distance(distances);
 }
 
-unsigned int pnp_solver::check_inliers(const Mat33_t& rot_cw, const Vec3_t& trans_cw, std::vector<bool>& is_inlier, double& cost) {
+unsigned int pnp_solver::check_inliers(const Mat33_t& rot_cw, const Vec3_t& trans_cw, std::vector<bool>& is_inlier, double& cost,
+                                       ransac* sac) const {
     unsigned int num_inliers = 0;
 
     cost = 0.0;
     is_inlier.resize(num_matches_);
-    for (unsigned int i = 0; i < num_matches_; ++i) {
-        const Vec3_t& pos_w = valid_landmarks_.at(i);
-        const Vec3_t& bearing = valid_bearings_.at(i);
 
-        const Vec3_t pos_c = rot_cw * pos_w + trans_cw;
+    for (unsigned int begin = 0; begin < num_matches_; begin += ransac::verification_block_size) {
+        const unsigned int num_block = std::min(ransac::verification_block_size, num_matches_ - begin);
 
-        // Compute cosine similarity between the bearing vector and the position of the 3D point
-        const auto cos_angle = pos_c.dot(bearing) / pos_c.norm();
+        const Mat3X_t pos_cs = (rot_cw * verified_landmarks_.middleCols(begin, num_block)).colwise() + trans_cw;
 
-        // The match is inlier if the cosine similarity is less than or equal to the threshold
-        if (max_cos_errors_.at(i) < cos_angle) {
-            is_inlier.at(i) = true;
-            cost += 1 - cos_angle;
-            ++num_inliers;
+        // Compute cosine similarity between the bearing vector and the position of the 3D point
+        const Eigen::Array<double, 1, Eigen::Dynamic> cos_angles
+            = pos_cs.cwiseProduct(verified_bearings_.middleCols(begin, num_block)).colwise().sum().array()
+              / pos_cs.colwise().norm().array();
+
+        unsigned int num_inliers_in_block = 0;
+        for (unsigned int j = 0; j < num_block; ++j) {
+            const auto i = verification_order_.at(begin + j);
+            const auto cos_angle = cos_angles(j);
+
+            // The match is inlier if the cosine similarity is less than or equal to the threshold
+            if (max_cos_errors_.at(i) < cos_angle) {
+                is_inlier.at(i) = true;
+                cost += 1 - cos_angle;
+                ++num_inliers_in_block;
+            }
+            else {
+                cost += 1 - max_cos_errors_.at(i);
+                is_inlier.at(i) = false;
+            }
         }
-        else {
-            cost += 1 - max_cos_errors_.at(i);
-            is_inlier.at(i) = false;
+        num_inliers += num_inliers_in_block;
+
+        if (sac && !sac->verify(num_inliers_in_block, num_block)) {
+            break;
         }
     }
 
     return num_inliers;
 }
 
+void pnp_solver::compute_hypotheses(const std::vector<unsigned int>& min_set,
+                                    eigen_alloc_vector<Mat33_t>& rots_cw, eigen_alloc_vector<Vec3_t>& transs_cw) const {
+    if (use_p3p_) {
+        Mat33_t bearings;
+        Mat33_t pos_ws;
+        for (unsigned int i = 0; i < 3; ++i) {
+            bearings.col(i) = valid_bearings_.at(min_set.at(i));
+            pos_ws.col(i) = valid_landmarks_.at(min_set.at(i));
+        }
+        compute_poses_p3p(bearings, pos_ws, rots_cw, transs_cw);
+        return;
+    }
+
+    eigen_alloc_vector<Vec3_t> min_set_bearings;
+    eigen_alloc_vector<Vec3_t> min_set_pos_ws;
+    for (const auto i : min_set) {
+        min_set_bearings.push_back(valid_bearings_.at(i));
+        min_set_pos_ws.push_back(valid_landmarks_.at(i));
+    }
+    Mat33_t rot_cw;
+    Vec3_t trans_cw;
+    compute_pose(min_set_bearings, min_set_pos_ws, rot_cw, trans_cw, gauss_newton_num_iter_);
+    rots_cw.push_back(rot_cw);
+    transs_cw.push_back(trans_cw);
+}
+
+void pnp_solver::check_inliers_of_hypotheses(const eigen_alloc_vector<Mat33_t>& rots_cw, const eigen_alloc_vector<Vec3_t>& transs_cw,
+                                             const ransac& sac, std::vector<ransac::verification_state>& states,
+                                             std::vector<unsigned int>& num_inliers, std::vector<double>& costs) const {
+    const unsigned int num_hypotheses = rots_cw.size();
+    states.assign(num_hypotheses, ransac::verification_state());
+    num_inliers.assign(num_hypotheses, 0);
+    costs.assign(num_hypotheses, 0.0);
+
+    // indices of the hypotheses which have not been rejected yet, and their stacked poses
+    std::vector<unsigned int> active_indices(num_hypotheses);
+    for (unsigned int k = 0; k < num_hypotheses; ++k) {
+        active_indices.at(k) = k;
+    }
+    MatX3_t stacked_rots_cw;
+    VecX_t stacked_transs_cw;
+    bool stack_is_updated = true;
+
+    for (unsigned int begin = 0; begin < num_matches_ && !active_indices.empty(); begin += ransac::verification_block_size) {
+        const unsigned int num_block = std::min(ransac::verification_block_size, num_matches_ - begin);
+
+        if (stack_is_updated) {
+            const unsigned int num_active = active_indices.size();
+            stacked_rots_cw.resize(3 * num_active, 3);
+            stacked_transs_cw.resize(3 * num_active);
+            for (unsigned int a = 0; a < num_active; ++a) {
+                stacked_rots_cw.middleRows<3>(3 * a) = rots_cw.at(active_indices.at(a));
+                stacked_transs_cw.segment<3>(3 * a) = transs_cw.at(active_indices.at(a));
+            }
+            stack_is_updated = false;
+        }
+
+        // transform the 3D points in the block by all of the active hypotheses at once
+        const MatX_t stacked_pos_cs = (stacked_rots_cw * verified_landmarks_.middleCols(begin, num_block)).colwise() + stacked_transs_cw;
+        const auto bearings = verified_bearings_.middleCols(begin, num_block);
+        const auto max_cos_errors = verified_max_cos_errors_.segment(begin, num_block);
+
+        std::vector<unsigned int> next_active_indices;
+        next_active_indices.reserve(active_indices.size());
+        for (unsigned int a = 0; a < active_indices.size(); ++a) {
+            const auto k = active_indices.at(a);
+            const auto pos_cs = stacked_pos_cs.middleRows<3>(3 * a);
+
+            // Compute cosine similarity between the bearing vector and the position of the 3D point
+            const ransac::block_array_t cos_angles
+                = pos_cs.cwiseProduct(bearings).colwise().sum().array() / pos_cs.colwise().norm().array();
+
+            // The match is inlier if the cosine similarity is less than or equal to the threshold
+            const auto is_inlier = (max_cos_errors < cos_angles);
+            const unsigned int num_inliers_in_block = is_inlier.count();
+            costs.at(k) += is_inlier.select(1.0 - cos_angles, 1.0 - max_cos_errors).sum();
+            num_inliers.at(k) += num_inliers_in_block;
+
+            if (sac.verify(states.at(k), num_inliers_in_block, num_block)) {
+                next_active_indices.push_back(k);
+            }
+        }
+        stack_is_updated = next_active_indices.size() != active_indices.size();
+        active_indices = next_active_indices;
+    }
+}
+
+void pnp_solver::compute_pose_from_inliers(const std::vector<bool>& is_inlier, Mat33_t& rot_cw, Vec3_t& trans_cw) const {
+    eigen_alloc_vector<Vec3_t> inlier_bearings;
+    eigen_alloc_vector<Vec3_t> inlier_pos_ws;
+    for (unsigned int i = 0; i < num_matches_; ++i) {
+        if (!is_inlier.at(i)) {
+            continue;
+        }
+        const Vec3_t& bearing = valid_bearings_.at(i);
+        const Vec3_t& pos_w = valid_landmarks_.at(i);
+        inlier_bearings.push_back(bearing);
+        inlier_pos_ws.push_back(pos_w);
+    }
+
+    compute_pose(inlier_bearings, inlier_pos_ws, rot_cw, trans_cw, gauss_newton_num_iter_);
+}
+
 double pnp_solver::compute_pose(const eigen_alloc_vector<Vec3_t>& bearing_vectors,
                                 const eigen_alloc_vector<Vec3_t>& pos_ws,
                                 Mat33_t& rot_cw, Vec3_t& trans_cw, const unsigned int num_iter) {
@@ -578,5 +747,249 @@ Vec4_t pnp_solver::gauss_newton(const MatRC_t<6, 10>& L_6x10, const Vec6_t& Rho,
     return betas;
 }
 
+unsigned int pnp_solver::compute_poses_p3p(const Mat33_t& bearings, const Mat33_t& pos_ws,
+                                           eigen_alloc_vector<Mat33_t>& rots_cw, eigen_alloc_vector<Vec3_t>& transs_cw) {
+    // Lambda Twist: An Accurate Fast Robust Perspective Three Point (P3P) Solver
+    // (Persson and Nordberg in ECCV 2018)
+
+    const Vec3_t y1 = bearings.col(0).normalized();
+    const Vec3_t y2 = bearings.col(1).normalized();
+    const Vec3_t y3 = bearings.col(2).normalized();
+    const Vec3_t& x1 = pos_ws.col(0);
+    const Vec3_t& x2 = pos_ws.col(1);
+    const Vec3_t& x3 = pos_ws.col(2);
+
+    // The depths (lambdas) satisfy |lambda_i * y_i - lambda_j * y_j|^2 = a_ij
+    const double b12 = -2.0 * y1.dot(y2);
+    const double b13 = -2.0 * y1.dot(y3);
+    const double b23 = -2.0 * y2.dot(y3);
+
+    const Vec3_t d12 = x1 - x2;
+    const Vec3_t d13 = x1 - x3;
+    const Vec3_t d23 = x2 - x3;
+    const Vec3_t d12xd13 = d12.cross(d13);
+
+    const double a12 = d12.squaredNorm();
+    const double a13 = d13.squaredNorm();
+    const double a23 = d23.squaredNorm();
+
+    // Find gamma such that D1 + gamma * D2 is degenerate, which is a root of the cubic polynomial
+    const double c31 = -0.5 * b13;
+    const double c23 = -0.5 * b23;
+    const double c12 = -0.5 * b12;
+    const double blob = c12 * c23 * c31 - 1.0;
+
+    const double s31_squared = 1.0 - c31 * c31;
+    const double s23_squared = 1.0 - c23 * c23;
+    const double s12_squared = 1.0 - c12 * c12;
+
+    const double p3 = a13 * (a23 * s31_squared - a13 * s23_squared);
+    const double p2 = 2.0 * blob * a23 * a13 + a13 * (2.0 * a12 + a13) * s23_squared + a23 * (a23 - a12) * s31_squared;
+    const double p1 = a23 * (a13 - a23) * s12_squared - a12 * a12 * s23_squared - 2.0 * a12 * (blob * a23 + a13 * s23_squared);
+    const double p0 = a12 * (a12 * s23_squared - a23 * s12_squared);
+
+    // p3 corresponds to det(D2), then the configuration is degenerate if it is zero
+    if (std::abs(p3) < 1e-12) {
+        return 0;
+    }
+    const double g = find_cubic_root(p2 / p3, p1 / p3, p0 / p3);
+
+    // The degenerate matrix D0 = D1 + gamma * D2
+    Mat33_t D0;
+    D0(0, 0) = a23 * (1.0 - g);
+    D0(0, 1) = 0.5 * a23 * b12;
+    D0(0, 2) = -0.5 * a23 * b13 * g;
+    D0(1, 1) = a23 - a12 + a13 * g;
+    D0(1, 2) = 0.5 * b23 * (a13 * g - a12);
+    D0(2, 2) = g * (a13 - a23) - a12;
+    D0(1, 0) = D0(0, 1);
+    D0(2, 0) = D0(0, 2);
+    D0(2, 1) = D0(1, 2);
+
+    // Decompose D0, whose one eigenvalue is zero, into the eigenvalues sorted by the magnitude in descending order
+    const Eigen::SelfAdjointEigenSolver<Mat33_t> eigen_solver(D0);
+    const Vec3_t& eigenvalues = eigen_solver.eigenvalues();
+    std::array<unsigned int, 3> order{{0, 1, 2}};
+    std::sort(order.begin(), order.end(), [&eigenvalues](const unsigned int a, const unsigned int b) {
+        return std::abs(eigenvalues(a)) > std::abs(eigenvalues(b));
+    });
+    const Vec3_t v1 = eigen_solver.eigenvectors().col(order.at(0));
+    const Vec3_t v2 = eigen_solver.eigenvectors().col(order.at(1));
+    if (std::abs(eigenvalues(order.at(0))) < 1e-12) {
+        return 0;
+    }
+    // lambda^T D0 lambda = 0 reduces to (v1 - s * v2)^T lambda = 0
+    const double v = std::sqrt(std::max(0.0, -eigenvalues(order.at(1)) / eigenvalues(order.at(0))));
+
+    eigen_alloc_vector<Vec3_t> depths;
+    for (const double s : {v, -v}) {
+        // lambda_1 = w0 * lambda_2 + w1 * lambda_3
+        const double denom = s * v2(0) - v1(0);
+        if (std::abs(denom) < 1e-12) {
+            continue;
+        }
+        const double w2 = 1.0 / denom;
+        const double w0 = (v1(1) - s * v2(1)) * w2;
+        const double w1 = (v1(2) - s * v2(2)) * w2;
+
+        // tau = lambda_3 / lambda_2 is a root of the quadratic polynomial
+        const double a_denom = (a13 - a12) * w1 * w1 - a12 * b13 * w1 - a12;
+        if (std::abs(a_denom) < 1e-12) {
+            continue;
+        }
+        const double a = 1.0 / a_denom;
+        const double b = (a13 * b12 * w1 - a12 * b13 * w0 - 2.0 * w0 * w1 * (a12 - a13)) * a;
+        const double c = ((a13 - a12) * w0 * w0 + a13 * b12 * w0 + a13) * a;
+
+        double taus[2];
+        if (!find_quadratic_roots(b, c, taus[0], taus[1])) {
+            continue;
+        }
+        for (const double tau : taus) {
+            if (tau <= 0.0) {
+                continue;
+            }
+            // |lambda_2 * y_2 - lambda_3 * y_3|^2 = a23
+            const double d = a23 / (tau * (b23 + tau) + 1.0);
+            if (d <= 0.0) {
+                continue;
+            }
+            const double l2 = std::sqrt(d);
+            const double l3 = tau * l2;
+            const double l1 = w0 * l2 + w1 * l3;
+            if (l1 < 0.0) {
+                continue;
+            }
+            depths.emplace_back(Vec3_t{l1, l2, l3});
+        }
+    }
+
+    // Compute the rotations which map the triangle of the world points to the one of the local points
+    Mat33_t X;
+    X << d12, d13, d12xd13;
+    if (std::abs(X.determinant()) < 1e-12) {
+        return 0;
+    }
+    const Mat33_t X_inv = X.inverse();
+
+    unsigned int num_solutions = 0;
+    for (auto& depth : depths) {
+        refine_depths(depth, a12, a13, a23, b12, b13, b23);
+
+        const Vec3_t ry1 = depth(0) * y1;
+        const Vec3_t ry2 = depth(1) * y2;
+        const Vec3_t ry3 = depth(2) * y3;
+        const Vec3_t yd1 = ry1 - ry2;
+        const Vec3_t yd2 = ry1 - ry3;
+        Mat33_t Y;
+        Y << yd1, yd2, yd1.cross(yd2);
+
+        const Mat33_t rot_cw = Y * X_inv;
+        if (!rot_cw.allFinite()) {
+            continue;
+        }
+        rots_cw.push_back(rot_cw);
+        transs_cw.push_back(ry1 - rot_cw * x1);
+        ++num_solutions;
+    }
+    return num_solutions;
+}
+
+double pnp_solver::find_cubic_root(const double b, const double c, const double d) {
+    // Choose the initial value near the root which is farthest from the stationary points
+    double r0;
+    if (b * b >= 3.0 * c) {
+        // the cubic polynomial has two stationary points
+        const double v = std::sqrt(b * b - 3.0 * c);
+        const double t1 = (-b - v) / 3.0;
+        const double k1 = ((t1 + b) * t1 + c) * t1 + d;
+        if (k1 > 0.0) {
+            // the leftmost root of the second-order approximation around t1
+            r0 = t1 - std::sqrt(-k1 / (3.0 * t1 + b));
+        }
+        else {
+            const double t2 = (-b + v) / 3.0;
+            const double k2 = ((t2 + b) * t2 + c) * t2 + d;
+            // the rightmost root of the second-order approximation around t2
+            r0 = t2 + std::sqrt(-k2 / (3.0 * t2 + b));
+        }
+    }
+    else {
+        // the cubic polynomial is monotonic
+        r0 = -b / 3.0;
+        if (std::abs((3.0 * r0 + 2.0 * b) * r0 + c) < 1e-4) {
+            r0 += 1.0;
+        }
+    }
+
+    // Refine the root by the newton method
+    for (unsigned int i = 0; i < 50; ++i) {
+        const double fx = ((r0 + b) * r0 + c) * r0 + d;
+        if (7 <= i && std::abs(fx) < 1e-13) {
+            break;
+        }
+        const double fpx = (3.0 * r0 + 2.0 * b) * r0 + c;
+        if (fpx == 0.0) {
+            break;
+        }
+        r0 -= fx / fpx;
+    }
+    return r0;
+}
+
+bool pnp_solver::find_quadratic_roots(const double b, const double c, double& r1, double& r2) {
+    const double v = b * b - 4.0 * c;
+    if (v < -1e-12) {
+        return false;
+    }
+    if (v <= 0.0) {
+        // a double root
+        r1 = r2 = -0.5 * b;
+        return true;
+    }
+    // avoid the cancellation
+    const double y = std::sqrt(v);
+    if (b < 0.0) {
+        r1 = 0.5 * (-b + y);
+        r2 = 0.5 * (-b - y);
+    }
+    else {
+        r1 = 2.0 * c / (-b + y);
+        r2 = 2.0 * c / (-b - y);
+    }
+    return true;
+}
+
+void pnp_solver::refine_depths(Vec3_t& depths, const double a12, const double a13, const double a23,
+                               const double b12, const double b13, const double b23) {
+    const auto compute_residuals = [&](const Vec3_t& l) {
+        return Vec3_t{l(0) * l(0) + l(1) * l(1) + b12 * l(0) * l(1) - a12,
+                      l(0) * l(0) + l(2) * l(2) + b13 * l(0) * l(2) - a13,
+                      l(1) * l(1) + l(2) * l(2) + b23 * l(1) * l(2) - a23};
+    };
+
+    Vec3_t residuals = compute_residuals(depths);
+    for (unsigned int i = 0; i < 5; ++i) {
+        if (residuals.lpNorm<1>() < 1e-10) {
+            break;
+        }
+        Mat33_t J;
+        J << 2.0 * depths(0) + b12 * depths(1), 2.0 * depths(1) + b12 * depths(0), 0.0,
+            2.0 * depths(0) + b13 * depths(2), 0.0, 2.0 * depths(2) + b13 * depths(0),
+            0.0, 2.0 * depths(1) + b23 * depths(2), 2.0 * depths(2) + b23 * depths(1);
+        if (std::abs(J.determinant()) < 1e-12) {
+            break;
+        }
+        const Vec3_t refined_depths = depths - J.inverse() * residuals;
+        const Vec3_t refined_residuals = compute_residuals(refined_depths);
+        // accept only the improvement
+        if (refined_residuals.lpNorm<1>() > residuals.lpNorm<1>()) {
+            break;
+        }
+        depths = refined_depths;
+        residuals = refined_residuals;
+    }
+}
+
 } // namespace solve
 } // namespace stella_vslam
@@ -1,6 +1,7 @@
 #ifndef STELLA_VSLAM_SOLVE_PNP_SOLVER_H
 #define STELLA_VSLAM_SOLVE_PNP_SOLVER_H
 
+#include "stella_vslam/solve/ransac.h"
 #include "stella_vslam/util/converter.h"
 #include "stella_vslam/type.h"
 
@@ -26,7 +27,24 @@ public:
     //! Destructor
     virtual ~pnp_solver();
 
+    /**
+     * Sample the minimal sets progressively from the matches with the smaller descriptor distances (PROSAC)
+     * @param distances descriptor distances of the 2D-3D matches
+     */
+    void set_descriptor_distances(const std::vector<unsigned int>& distances);
+
+    /**
+     * Compute the hypotheses from the minimal sets of 3 matches by Lambda Twist P3P instead of 4 matches by EPnP
+     * (NOTE: P3P gives up to 4 hypotheses, all of which are verified,
+     *  and the number of the iterations required by the inlier ratio is smaller than EPnP)
+     * @param use_p3p
+     */
+    void set_use_p3p(const bool use_p3p) {
+        use_p3p_ = use_p3p;
+    }
+
     //! Find the most reliable camera pose via RANSAC
+    //! (Note: the iterations are terminated when the confidence is reached with the inlier ratio of the best solution)
     void find_via_ransac(const unsigned int max_num_iter, const bool recompute = true);
 
     //! Check if the solution is valid or not
@@ -56,8 +74,24 @@ public:
 
 private:
     //! Check inliers of 2D-3D matches
-    //! (Note: inlier flags are set to_inlier_match and the number of inliers is returned)
-    unsigned int check_inliers(const Mat33_t& rot_cw, const Vec3_t& trans_cw, std::vector<bool>& is_inlier, double& cost);
+    //! (Note: inlier flags are set to_inlier_match and the number of inliers is returned,
+    //!  and the check is stopped if the hypothesis is rejected by SPRT of `sac`)
+    unsigned int check_inliers(const Mat33_t& rot_cw, const Vec3_t& trans_cw, std::vector<bool>& is_inlier, double& cost,
+                               ransac* sac = nullptr) const;
+
+    //! Compute a camera pose only with the inlier matches
+    void compute_pose_from_inliers(const std::vector<bool>& is_inlier, Mat33_t& rot_cw, Vec3_t& trans_cw) const;
+
+    //! Compute the hypotheses from the minimal set and append them to the batch
+    void compute_hypotheses(const std::vector<unsigned int>& min_set,
+                            eigen_alloc_vector<Mat33_t>& rots_cw, eigen_alloc_vector<Vec3_t>& transs_cw) const;
+
+    //! Check inliers of 2D-3D matches for the batch of the hypotheses at once
+    //! (Note: the 3D points are transformed by the stacked rotations of the hypotheses which have not been rejected by SPRT of `sac` yet,
+    //!  and the number of inliers and the cost of each hypothesis are set. the inlier flags are not computed)
+    void check_inliers_of_hypotheses(const eigen_alloc_vector<Mat33_t>& rots_cw, const eigen_alloc_vector<Vec3_t>& transs_cw,
+                                     const ransac& sac, std::vector<ransac::verification_state>& states,
+                                     std::vector<unsigned int>& num_inliers, std::vector<double>& costs) const;
 
     //! the number of 2D-3D matches
     const unsigned int num_matches_;
@@ -68,6 +102,11 @@ private:
     eigen_alloc_vector<Vec3_t> valid_landmarks_;
     //! acceptable maximum error
     std::vector<float> max_cos_errors_;
+    //! order of the matches to check the inliers, and the matches in this order as 3xN matrices (for the vectorized check)
+    std::vector<unsigned int> verification_order_;
+    Mat3X_t verified_bearings_;
+    Mat3X_t verified_landmarks_;
+    Eigen::Array<double, 1, Eigen::Dynamic> verified_max_cos_errors_;
 
     //! minimum number of inliers
     //! (Note: if the number of inliers is less than this, the solution is regarded as invalid)
@@ -83,6 +122,10 @@ private:
     std::vector<bool> is_inlier_match;
     //! random engine for RANSAC
     std::mt19937 random_engine_;
+    //! sampling order of the matches for PROSAC (empty if not used)
+    std::vector<unsigned int> sampling_order_;
+    //! compute the hypotheses by P3P instead of EPnP
+    bool use_p3p_ = false;
 
     //! Number of iterations of Gauss-Newton method in EPnP
     const unsigned int gauss_newton_num_iter_;
@@ -139,6 +182,32 @@ private:
 
     //! Estimate R and t by the local 3D points and the world 3D points
     static void estimate_R_and_t(const eigen_alloc_vector<Vec3_t>& pws, const eigen_alloc_vector<Vec3_t>& pcs, Mat33_t& rot, Vec3_t& trans);
+
+    //-----------------------------------------
+    // Lambda Twist P3P
+
+public:
+    /**
+     * Compute the camera poses by 3 local bearing vectors and world point positions
+     * @param bearings bearing vectors (3 columns)
+     * @param pos_ws world point positions (3 columns)
+     * @param rots_cw the rotations of the solutions are appended
+     * @param transs_cw the translations of the solutions are appended
+     * @return number of the solutions (up to 4)
+     */
+    static unsigned int compute_poses_p3p(const Mat33_t& bearings, const Mat33_t& pos_ws,
+                                          eigen_alloc_vector<Mat33_t>& rots_cw, eigen_alloc_vector<Vec3_t>& transs_cw);
+
+private:
+    //! Find a real root of the cubic polynomial x^3 + b x^2 + c x + d which is numerically stable
+    static double find_cubic_root(const double b, const double c, const double d);
+
+    //! Compute the real roots of the quadratic polynomial x^2 + b x + c (return false if they do not exist)
+    static bool find_quadratic_roots(const double b, const double c, double& r1, double& r2);
+
+    //! Refine the depths by the gauss-newton algorithm on the constraints of the distances between the 3D points
+    static void refine_depths(Vec3_t& depths, const double a12, const double a13, const double a23,
+                              const double b12, const double b13, const double b23);
 };
 
 } // namespace solve
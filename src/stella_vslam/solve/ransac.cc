@@ -0,0 +1,175 @@
+#include "stella_vslam/solve/ransac.h"
+#include "stella_vslam/util/random_array.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace stella_vslam {
+namespace solve {
+
+constexpr unsigned int ransac::verification_block_size;
+constexpr unsigned int ransac::num_local_optimization_iter;
+
+ransac::ransac(const unsigned int num_data, const unsigned int min_set_size, const unsigned int max_num_iter,
+               std::mt19937& random_engine, const double confidence)
+    : num_data_(num_data), min_set_size_(min_set_size), max_num_iter_(max_num_iter),
+      random_engine_(random_engine), log_failure_prob_(std::log(1.0 - confidence)),
+      verification_order_(num_data), num_required_iter_(max_num_iter) {
+    std::iota(verification_order_.begin(), verification_order_.end(), 0);
+    std::shuffle(verification_order_.begin(), verification_order_.end(), random_engine_);
+    update_sprt_threshold();
+}
+
+void ransac::set_sampling_order(const std::vector<unsigned int>& sorted_indices) {
+    if (sorted_indices.size() != num_data_ || num_data_ < min_set_size_) {
+        sorted_indices_.clear();
+        return;
+    }
+    sorted_indices_ = sorted_indices;
+
+    // the sampling pool starts from the minimal set of the best data,
+    // and it grows so that all of the data are used by the end of the iterations
+    prosac_n_ = min_set_size_;
+    prosac_T_n_ = max_num_iter_;
+    for (unsigned int i = 0; i < min_set_size_; ++i) {
+        prosac_T_n_ *= static_cast<double>(min_set_size_ - i) / (num_data_ - i);
+    }
+    prosac_T_n_prime_ = 1;
+}
+
+std::vector<unsigned int> ransac::sort_by_distance(const std::vector<unsigned int>& distances) {
+    std::vector<unsigned int> sorted_indices(distances.size());
+    std::iota(sorted_indices.begin(), sorted_indices.end(), 0);
+    std::stable_sort(sorted_indices.begin(), sorted_indices.end(), [&distances](const unsigned int a, const unsigned int b) {
+        return distances.at(a) < distances.at(b);
+    });
+    return sorted_indices;
+}
+
+bool ransac::next_min_set(std::vector<unsigned int>& min_set) {
+    if (num_data_ < min_set_size_ || num_required_iter_ <= num_iter_) {
+        return false;
+    }
+    ++num_iter_;
+
+    if (sorted_indices_.empty()) {
+        min_set = util::create_random_array(min_set_size_, 0U, num_data_ - 1, random_engine_);
+        return true;
+    }
+
+    // Expand the sampling pool according to the growth function of PROSAC
+    while (prosac_n_ < num_data_ && prosac_T_n_prime_ < num_iter_) {
+        const double T_n_next = prosac_T_n_ * (prosac_n_ + 1) / (prosac_n_ + 1 - min_set_size_);
+        prosac_T_n_prime_ += static_cast<unsigned int>(std::ceil(T_n_next - prosac_T_n_));
+        prosac_T_n_ = T_n_next;
+        ++prosac_n_;
+    }
+
+    if (prosac_T_n_prime_ < num_iter_ || min_set_size_ < 2) {
+        // the pool covers all of the data, then the sampling is the same as the ordinary RANSAC
+        min_set = util::create_random_array(min_set_size_, 0U, prosac_n_ - 1, random_engine_);
+    }
+    else {
+        // the minimal set always contains the newest datum of the pool
+        min_set = util::create_random_array(min_set_size_ - 1, 0U, prosac_n_ - 2, random_engine_);
+        min_set.push_back(prosac_n_ - 1);
+    }
+    for (auto& idx : min_set) {
+        idx = sorted_indices_.at(idx);
+    }
+    return true;
+}
+
+bool ransac::sample_from_inliers(const std::vector<bool>& is_inlier, const unsigned int set_size, std::vector<unsigned int>& subset) {
+    std::vector<unsigned int> inlier_indices;
+    inlier_indices.reserve(is_inlier.size());
+    for (unsigned int i = 0; i < is_inlier.size(); ++i) {
+        if (is_inlier.at(i)) {
+            inlier_indices.push_back(i);
+        }
+    }
+    if (inlier_indices.size() <= set_size) {
+        return false;
+    }
+
+    subset = util::create_random_array(set_size, 0U, static_cast<unsigned int>(inlier_indices.size()) - 1, random_engine_);
+    for (auto& idx : subset) {
+        idx = inlier_indices.at(idx);
+    }
+    return true;
+}
+
+bool ransac::verify(verification_state& state, const unsigned int num_inliers, const unsigned int num_tested) const {
+    state.num_inliers_ += num_inliers;
+    state.num_tested_ += num_tested;
+    if (state.is_rejected_) {
+        return false;
+    }
+
+    state.log_lambda_ += num_inliers * sprt_log_inlier_ + (num_tested - num_inliers) * sprt_log_outlier_;
+    if (sprt_log_A_ < state.log_lambda_) {
+        state.is_rejected_ = true;
+        return false;
+    }
+    return true;
+}
+
+void ransac::end_verification(const verification_state& state, const bool is_best) {
+    if (state.is_rejected_) {
+        // delta is estimated as the average inlier ratio of the rejected hypotheses
+        ++num_rejected_;
+        sum_rejected_inlier_ratio_ += static_cast<double>(state.num_inliers_) / std::max(state.num_tested_, 1U);
+        sprt_delta_ = sum_rejected_inlier_ratio_ / num_rejected_;
+        update_sprt_threshold();
+        return;
+    }
+    if (!is_best) {
+        return;
+    }
+
+    const double inlier_ratio = static_cast<double>(state.num_inliers_) / num_data_;
+
+    // Adapt the number of the iterations to the inlier ratio of the best hypothesis
+    const double prob_good_min_set = std::pow(inlier_ratio, min_set_size_);
+    if (1.0 - 1e-9 < prob_good_min_set) {
+        num_required_iter_ = num_iter_;
+    }
+    else if (0.0 < prob_good_min_set) {
+        const double num_iter = std::ceil(log_failure_prob_ / std::log(1.0 - prob_good_min_set));
+        if (num_iter < num_required_iter_) {
+            num_required_iter_ = std::max(num_iter_, static_cast<unsigned int>(num_iter));
+        }
+    }
+
+    // epsilon is estimated as the inlier ratio of the best hypothesis
+    if (sprt_epsilon_ < inlier_ratio) {
+        sprt_epsilon_ = inlier_ratio;
+        update_sprt_threshold();
+    }
+}
+
+void ransac::update_sprt_threshold() {
+    // the test is meaningful only if a good hypothesis is supported by more data than a bad one
+    const double epsilon = std::min(sprt_epsilon_, 0.99);
+    const double delta = std::max(0.01, std::min(sprt_delta_, 0.9 * epsilon));
+
+    sprt_log_inlier_ = std::log(delta / epsilon);
+    sprt_log_outlier_ = std::log((1.0 - delta) / (1.0 - epsilon));
+
+    // the optimal threshold A satisfies A = t_M * C / m_S + 1 + log(A) (Matas and Chum, ICCV 2005),
+    // where t_M is the time to compute a hypothesis relative to the verification of a datum,
+    // and m_S is the number of the hypotheses computed from a minimal set
+    constexpr double t_M = 200.0;
+    constexpr double m_S = 1.0;
+    const double C = (1.0 - delta) * sprt_log_outlier_ + delta * sprt_log_inlier_;
+    const double A_0 = t_M * C / m_S + 1.0;
+    double A = A_0;
+    for (unsigned int i = 0; i < 10; ++i) {
+        A = A_0 + std::log(A);
+    }
+    sprt_log_A_ = std::log(A);
+}
+
+} // namespace solve
+} // namespace stella_vslam
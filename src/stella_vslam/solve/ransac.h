@@ -0,0 +1,197 @@
+#ifndef STELLA_VSLAM_SOLVE_RANSAC_H
+#define STELLA_VSLAM_SOLVE_RANSAC_H
+
+#include <random>
+#include <vector>
+
+#include <Eigen/Core>
+
+namespace stella_vslam {
+namespace solve {
+
+/**
+ * RANSAC engine shared by the solvers, which handles the sampling and the termination of the hypothesize-and-verify loop
+ *   - the number of the iterations is adapted to the inlier ratio of the best hypothesis
+ *   - the minimal sets are progressively sampled from the better data if the sampling order is given (PROSAC)
+ *   - the bad hypotheses are rejected during the verification by the sequential probability ratio test (SPRT)
+ * The solver evaluates the residuals in blocks and feeds the number of the inliers of each block to verify().
+ * Several hypotheses can be verified together against the same blocks by giving each of them its own verification_state.
+ * (NOTE: the data should be verified in the random order given by get_verification_order(),
+ *  because SPRT assumes that the inliers and the outliers are not clustered in the order of the verification)
+ */
+class ransac {
+public:
+    //! number of the data verified at once (the residuals of a block are computed in the vectorized form)
+    static constexpr unsigned int verification_block_size = 32;
+    //! residuals of a block (the size is bounded, then the array is allocated on the stack)
+    using block_array_t = Eigen::Array<double, 1, Eigen::Dynamic, Eigen::RowMajor, 1, verification_block_size>;
+    //! number of the hypotheses computed from the inliers of a new best hypothesis (local optimization)
+    static constexpr unsigned int num_local_optimization_iter = 10;
+
+    //! state of the verification of a hypothesis
+    struct verification_state {
+        //! log of the likelihood ratio of the hypothesis
+        double log_lambda_ = 0.0;
+        //! the hypothesis is rejected
+        bool is_rejected_ = false;
+        //! number of the inliers and the tested data of the hypothesis
+        unsigned int num_inliers_ = 0;
+        unsigned int num_tested_ = 0;
+    };
+
+    /**
+     * Constructor
+     * @param num_data number of the data (e.g. matches)
+     * @param min_set_size size of the minimal set
+     * @param max_num_iter maximum number of the iterations
+     * @param random_engine
+     * @param confidence probability that at least one minimal set without any outlier is sampled
+     */
+    ransac(const unsigned int num_data, const unsigned int min_set_size, const unsigned int max_num_iter,
+           std::mt19937& random_engine, const double confidence = 0.99);
+
+    //! Get the random order of the data to verify the hypotheses
+    const std::vector<unsigned int>& get_verification_order() const {
+        return verification_order_;
+    }
+
+    /**
+     * Sample the minimal sets progressively from the data in this order (PROSAC)
+     * @param sorted_indices indices of all of the data in the descending order of the quality
+     */
+    void set_sampling_order(const std::vector<unsigned int>& sorted_indices);
+
+    /**
+     * Compute the sampling order from the descriptor distances of the matches (the nearer the better)
+     * @param distances
+     * @return indices of the matches in ascending order of the distance
+     */
+    static std::vector<unsigned int> sort_by_distance(const std::vector<unsigned int>& distances);
+
+    /**
+     * Sample the next minimal set
+     * @param min_set indices of the data
+     * @return false if the termination criterion is satisfied
+     */
+    bool next_min_set(std::vector<unsigned int>& min_set);
+
+    /**
+     * Sample a non-minimal set from the inliers of the best hypothesis (local optimization)
+     * The hypotheses computed from these sets are more accurate than the ones from the minimal sets,
+     * then the accuracy is kept even if the iterations are terminated early.
+     * @param is_inlier inlier flags of the best hypothesis
+     * @param set_size size of the non-minimal set
+     * @param subset indices of the data
+     * @return false if the number of the inliers is not larger than the set size
+     */
+    bool sample_from_inliers(const std::vector<bool>& is_inlier, const unsigned int set_size, std::vector<unsigned int>& subset);
+
+    //! Begin the verification of the hypothesis
+    void begin_verification() {
+        state_ = verification_state();
+    }
+
+    /**
+     * Feed the result of the verification of a block of the data
+     * @param num_inliers number of the inliers in the block
+     * @param num_tested number of the data in the block
+     * @return false if the hypothesis is rejected by SPRT (the verification should be stopped)
+     */
+    bool verify(const unsigned int num_inliers, const unsigned int num_tested) {
+        return verify(state_, num_inliers, num_tested);
+    }
+
+    /**
+     * Feed the result of the verification of a block of the data to the state of a hypothesis
+     * (NOTE: the threshold of SPRT is not changed until end_verification() is called)
+     * @param state
+     * @param num_inliers number of the inliers in the block
+     * @param num_tested number of the data in the block
+     * @return false if the hypothesis is rejected by SPRT (the verification should be stopped)
+     */
+    bool verify(verification_state& state, const unsigned int num_inliers, const unsigned int num_tested) const;
+
+    //! The current hypothesis has been rejected by SPRT
+    bool is_rejected() const {
+        return state_.is_rejected_;
+    }
+
+    /**
+     * End the verification of the hypothesis
+     * @param is_best the hypothesis is adopted as the best one (then the number of the iterations is updated)
+     */
+    void end_verification(const bool is_best) {
+        end_verification(state_, is_best);
+    }
+
+    /**
+     * End the verification of the hypothesis with the state
+     * @param state
+     * @param is_best the hypothesis is adopted as the best one (then the number of the iterations is updated)
+     */
+    void end_verification(const verification_state& state, const bool is_best);
+
+    //! Get the number of the iterations so far
+    unsigned int get_num_iterations() const {
+        return num_iter_;
+    }
+
+    //! Get the number of the hypotheses rejected by SPRT so far
+    unsigned int get_num_rejected() const {
+        return num_rejected_;
+    }
+
+private:
+    //! Update the decision threshold of SPRT from the current inlier ratios
+    void update_sprt_threshold();
+
+    //! number of the data
+    const unsigned int num_data_;
+    //! size of the minimal set
+    const unsigned int min_set_size_;
+    //! maximum number of the iterations
+    const unsigned int max_num_iter_;
+    //! random engine of the solver
+    std::mt19937& random_engine_;
+    //! log(1 - confidence)
+    const double log_failure_prob_;
+
+    //! random order of the data to verify the hypotheses
+    std::vector<unsigned int> verification_order_;
+
+    //! number of the iterations so far
+    unsigned int num_iter_ = 0;
+    //! number of the iterations required by the inlier ratio of the best hypothesis
+    unsigned int num_required_iter_;
+
+    // PROSAC
+    //! indices of the data in the descending order of the quality (empty if PROSAC is not used)
+    std::vector<unsigned int> sorted_indices_;
+    //! size of the current sampling pool
+    unsigned int prosac_n_ = 0;
+    //! expected number of the minimal sets drawn from the pool (T_n)
+    double prosac_T_n_ = 0.0;
+    //! the iteration when the pool is expanded (T'_n)
+    unsigned int prosac_T_n_prime_ = 1;
+
+    // SPRT
+    //! probability that a datum is consistent with a good hypothesis (epsilon)
+    double sprt_epsilon_ = 0.1;
+    //! probability that a datum is consistent with a bad hypothesis (delta)
+    double sprt_delta_ = 0.05;
+    //! log of the decision threshold
+    double sprt_log_A_ = 0.0;
+    //! log of the likelihood ratio of an inlier and an outlier
+    double sprt_log_inlier_ = 0.0;
+    double sprt_log_outlier_ = 0.0;
+    //! state of the current hypothesis
+    verification_state state_;
+    //! statistics of the rejected hypotheses (to estimate delta)
+    unsigned int num_rejected_ = 0;
+    double sum_rejected_inlier_ratio_ = 0.0;
+};
+
+} // namespace solve
+} // namespace stella_vslam
+
+#endif // STELLA_VSLAM_SOLVE_RANSAC_H
@@ -0,0 +1,89 @@
+#include "stella_vslam/solve/triangulator.h"
+
+namespace stella_vslam {
+namespace solve {
+
+void triangulator::triangulate(const MatX3_t& bearings_1, const MatX3_t& bearings_2, const Mat33_t& rot_21, const Vec3_t& trans_21,
+                               MatX3_t& pts_in_1) {
+    assert(bearings_1.rows() == bearings_2.rows());
+
+    const Vec3_t trans_12 = -rot_21.transpose() * trans_21;
+    // (the i-th row is (rot_21^T * bearing_2)^T)
+    const MatX3_t bearings_2_in_1 = bearings_2 * rot_21;
+
+    // elements of the 2x2 system of each match
+    const Eigen::ArrayXd a_00 = bearings_1.rowwise().squaredNorm().array();
+    const Eigen::ArrayXd a_10 = bearings_1.cwiseProduct(bearings_2_in_1).rowwise().sum().array();
+    const Eigen::ArrayXd a_11 = -bearings_2_in_1.rowwise().squaredNorm().array();
+    const Eigen::ArrayXd b_0 = (bearings_1 * trans_12).array();
+    const Eigen::ArrayXd b_1 = (bearings_2_in_1 * trans_12).array();
+
+    // solve the systems with the inverses of the matrices (a_01 = -a_10)
+    const Eigen::ArrayXd det_inv = (a_00 * a_11 + a_10 * a_10).inverse();
+    const Eigen::ArrayXd lambda_0 = (a_11 * b_0 + a_10 * b_1) * det_inv;
+    const Eigen::ArrayXd lambda_1 = (a_00 * b_1 - a_10 * b_0) * det_inv;
+
+    // midpoints of the closest points on the two rays
+    pts_in_1.resize(bearings_1.rows(), 3);
+    for (unsigned int k = 0; k < 3; ++k) {
+        pts_in_1.col(k) = (0.5 * (lambda_0 * bearings_1.col(k).array() + lambda_1 * bearings_2_in_1.col(k).array() + trans_12(k))).matrix();
+    }
+}
+
+void triangulator::triangulate(const MatX3_t& bearings_1, const MatX3_t& bearings_2, const Mat44_t& cam_pose_1, const Mat44_t& cam_pose_2,
+                               MatX3_t& pos_ws) {
+    assert(bearings_1.rows() == bearings_2.rows());
+    const auto num_matches = bearings_1.rows();
+
+    // the upper triangle of the normal matrix and the right-hand side of each match
+    Eigen::ArrayXd m_00 = Eigen::ArrayXd::Zero(num_matches);
+    Eigen::ArrayXd m_01 = Eigen::ArrayXd::Zero(num_matches);
+    Eigen::ArrayXd m_02 = Eigen::ArrayXd::Zero(num_matches);
+    Eigen::ArrayXd m_11 = Eigen::ArrayXd::Zero(num_matches);
+    Eigen::ArrayXd m_12 = Eigen::ArrayXd::Zero(num_matches);
+    Eigen::ArrayXd m_22 = Eigen::ArrayXd::Zero(num_matches);
+    Eigen::ArrayXd r_0 = Eigen::ArrayXd::Zero(num_matches);
+    Eigen::ArrayXd r_1 = Eigen::ArrayXd::Zero(num_matches);
+    Eigen::ArrayXd r_2 = Eigen::ArrayXd::Zero(num_matches);
+
+    // accumulate the equation (u * P.row(2) - w * P.row(row)) * [X; 1] = 0, which is the same row as the single match version
+    const auto accumulate = [&](const Eigen::ArrayXd& u, const Eigen::ArrayXd& w, const Mat44_t& P, const unsigned int row) {
+        const Eigen::ArrayXd a_0 = u * P(2, 0) - w * P(row, 0);
+        const Eigen::ArrayXd a_1 = u * P(2, 1) - w * P(row, 1);
+        const Eigen::ArrayXd a_2 = u * P(2, 2) - w * P(row, 2);
+        const Eigen::ArrayXd a_3 = u * P(2, 3) - w * P(row, 3);
+        m_00 += a_0 * a_0;
+        m_01 += a_0 * a_1;
+        m_02 += a_0 * a_2;
+        m_11 += a_1 * a_1;
+        m_12 += a_1 * a_2;
+        m_22 += a_2 * a_2;
+        r_0 -= a_0 * a_3;
+        r_1 -= a_1 * a_3;
+        r_2 -= a_2 * a_3;
+    };
+
+    const Eigen::ArrayXd z_1 = bearings_1.col(2).array();
+    accumulate(bearings_1.col(0).array(), z_1, cam_pose_1, 0);
+    accumulate(bearings_1.col(1).array(), z_1, cam_pose_1, 1);
+    const Eigen::ArrayXd z_2 = bearings_2.col(2).array();
+    accumulate(bearings_2.col(0).array(), z_2, cam_pose_2, 0);
+    accumulate(bearings_2.col(1).array(), z_2, cam_pose_2, 1);
+
+    // solve the symmetric 3x3 systems with the adjugate matrices
+    const Eigen::ArrayXd c_00 = m_11 * m_22 - m_12 * m_12;
+    const Eigen::ArrayXd c_01 = m_02 * m_12 - m_01 * m_22;
+    const Eigen::ArrayXd c_02 = m_01 * m_12 - m_02 * m_11;
+    const Eigen::ArrayXd c_11 = m_00 * m_22 - m_02 * m_02;
+    const Eigen::ArrayXd c_12 = m_01 * m_02 - m_00 * m_12;
+    const Eigen::ArrayXd c_22 = m_00 * m_11 - m_01 * m_01;
+    const Eigen::ArrayXd det_inv = (m_00 * c_00 + m_01 * c_01 + m_02 * c_02).inverse();
+
+    pos_ws.resize(num_matches, 3);
+    pos_ws.col(0) = ((c_00 * r_0 + c_01 * r_1 + c_02 * r_2) * det_inv).matrix();
+    pos_ws.col(1) = ((c_01 * r_0 + c_11 * r_1 + c_12 * r_2) * det_inv).matrix();
+    pos_ws.col(2) = ((c_02 * r_0 + c_12 * r_1 + c_22 * r_2) * det_inv).matrix();
+}
+
+} // namespace solve
+} // namespace stella_vslam
@@ -40,6 +40,32 @@ public:
      * @return
      */
     static inline Vec3_t triangulate(const Vec3_t& bearing_1, const Vec3_t& bearing_2, const Mat44_t& cam_pose_1, const Mat44_t& cam_pose_2);
+
+    /**
+     * Triangulate the matches in the batch using the bearings and relative rotation & translation
+     * (the same midpoint method as the single match version, computed on the columns of the coordinates)
+     * @param bearings_1 bearings in the camera 1 (one match per row)
+     * @param bearings_2 bearings in the camera 2 (one match per row)
+     * @param rot_21
+     * @param trans_21
+     * @param pts_in_1 triangulated points in the camera 1 coordinates (one match per row)
+     */
+    static void triangulate(const MatX3_t& bearings_1, const MatX3_t& bearings_2, const Mat33_t& rot_21, const Vec3_t& trans_21,
+                            MatX3_t& pts_in_1);
+
+    /**
+     * Triangulate the matches in the batch using the bearings and absolute camera poses
+     * The linear equations of each match are solved in the inhomogeneous form (the normal equations of 3x3)
+     * instead of SVD, then all of the matches are solved at once on the columns of the coordinates.
+     * (NOTE: the point is not finite if the two rays are parallel)
+     * @param bearings_1 bearings in the camera 1 (one match per row)
+     * @param bearings_2 bearings in the camera 2 (one match per row)
+     * @param cam_pose_1
+     * @param cam_pose_2
+     * @param pos_ws triangulated points in the world reference (one match per row)
+     */
+    static void triangulate(const MatX3_t& bearings_1, const MatX3_t& bearings_2, const Mat44_t& cam_pose_1, const Mat44_t& cam_pose_2,
+                            MatX3_t& pos_ws);
 };
 
 Vec3_t triangulator::triangulate(const cv::Point2d& pt_1, const cv::Point2d& pt_2, const Mat34_t& P_1, const Mat34_t& P_2) {
@@ -3,7 +3,9 @@
 #include "stella_vslam/tracking_module.h"
 #include "stella_vslam/mapping_module.h"
 #include "stella_vslam/global_optimization_module.h"
+#include "stella_vslam/localizer.h"
 #include "stella_vslam/camera/camera_factory.h"
+#include "stella_vslam/camera/rig.h"
 #include "stella_vslam/data/camera_database.h"
 #include "stella_vslam/data/common.h"
 #include "stella_vslam/data/frame_observation.h"
@@ -11,36 +13,141 @@
 #include "stella_vslam/data/map_database.h"
 #include "stella_vslam/data/bow_database.h"
 #include "stella_vslam/data/bow_vocabulary.h"
+#include "stella_vslam/data/keyframe.h"
+#include "stella_vslam/data/landmark.h"
 #include "stella_vslam/data/marker2d.h"
 #include "stella_vslam/marker_detector/aruco.h"
+#include "stella_vslam/marker_detector/async_detector.h"
+#include "stella_vslam/module/map_merger.h"
+#include "stella_vslam/module/optical_flow_tracker.h"
+#include "stella_vslam/module/remote_map_integrator.h"
+#include "stella_vslam/match/device_matcher.h"
+#include "stella_vslam/match/hamming.h"
 #include "stella_vslam/match/stereo.h"
 #include "stella_vslam/feature/orb_extractor.h"
 #include "stella_vslam/io/trajectory_io.h"
+#include "stella_vslam/io/trajectory_writer.h"
 #include "stella_vslam/io/map_database_io_factory.h"
+#include "stella_vslam/io/map_tile_streamer.h"
+#include "stella_vslam/io/replay_log.h"
 #include "stella_vslam/publish/map_publisher.h"
 #include "stella_vslam/publish/frame_publisher.h"
+#include "stella_vslam/publish/metrics_publisher.h"
+#include "stella_vslam/util/allocation_counter.h"
+#include "stella_vslam/util/async_reclaimer.h"
 #include "stella_vslam/util/converter.h"
+#include "stella_vslam/util/cpu_time.h"
+#include "stella_vslam/util/frame_arena.h"
+#include "stella_vslam/util/frame_qos.h"
 #include "stella_vslam/util/image_converter.h"
+#include "stella_vslam/util/keyframe_tracer.h"
+#include "stella_vslam/util/latency_profiler.h"
+#include "stella_vslam/util/lock_profiler.h"
+#include "stella_vslam/util/thread_pool.h"
 #include "stella_vslam/util/yaml.h"
 
+#include <algorithm>
+#include <functional>
 #include <thread>
 
 #include <spdlog/spdlog.h>
 
 namespace stella_vslam {
 
+namespace {
+
+std::string tracker_state_to_string(const tracker_state_t tracking_state) {
+    switch (tracking_state) {
+        case tracker_state_t::Initializing:
+            return "Initializing";
+        case tracker_state_t::Tracking:
+            return "Tracking";
+        case tracker_state_t::Lost:
+            return "Lost";
+    }
+    return "Unknown";
+}
+
+} // namespace
+
+struct system::extraction_worker {
+    std::unique_ptr<feature::orb_extractor> extractor_left_ = nullptr;
+    std::unique_ptr<feature::orb_extractor> extractor_right_ = nullptr;
+};
+
+struct system::pipeline_job {
+    //! create a frame with the given extractors (left/monocular, right)
+    std::function<data::frame(feature::orb_extractor*, feature::orb_extractor*, std::vector<cv::KeyPoint>&, unsigned int)> create_frame_;
+    //! ID of the frame (reserved in the feeding order, since the workers finish the extraction out of order)
+    unsigned int frm_id_ = 0;
+    //! image for visualization
+    cv::Mat img_;
+    //! keypoints for visualization
+    std::vector<cv::KeyPoint> keypts_;
+    //! latency spans recorded on the extraction worker
+    std::vector<util::latency_span> extraction_spans_;
+    //! result of the extraction
+    std::promise<data::frame> promise_frm_;
+    std::future<data::frame> future_frm_ = promise_frm_.get_future();
+    //! result of the tracking
+    std::promise<std::shared_ptr<Mat44_t>> promise_cam_pose_wc_;
+    std::shared_future<std::shared_ptr<Mat44_t>> future_cam_pose_wc_ = promise_cam_pose_wc_.get_future().share();
+    //! timestamp of the frame
+    double timestamp_ = 0.0;
+    //! the tracker needed a new keyframe when the frame was fed (used by the frame QoS)
+    bool is_keyframe_candidate_ = false;
+    //! time when the frame was fed (used by the frame QoS)
+    std::chrono::steady_clock::time_point fed_at_;
+};
+
 system::system(const std::shared_ptr<config>& cfg, const std::string& vocab_file_path)
-    : cfg_(cfg) {
+    : system(cfg, vocab_file_path, nullptr, nullptr) {}
+
+system::system(const std::shared_ptr<config>& cfg, const std::shared_ptr<data::bow_vocabulary>& bow_vocab,
+               const std::shared_ptr<util::thread_pool>& thread_pool)
+    : system(cfg, "", bow_vocab, thread_pool) {
+    if (!bow_vocab) {
+        throw std::runtime_error("the shared vocabulary is not given");
+    }
+}
+
+system::system(const std::shared_ptr<config>& cfg, const std::string& vocab_file_path,
+               const std::shared_ptr<data::bow_vocabulary>& shared_bow_vocab, const std::shared_ptr<util::thread_pool>& shared_thread_pool)
+    : cfg_(cfg), shared_bow_vocab_(shared_bow_vocab) {
     spdlog::debug("CONSTRUCT: system");
     print_info();
 
-    // load ORB vocabulary
-    spdlog::info("loading ORB vocabulary: {}", vocab_file_path);
-    bow_vocab_ = data::bow_vocabulary_util::load(vocab_file_path);
-
     const auto system_params = util::yaml_optional_ref(cfg->yaml_node_, "System");
 
+    // load ORB vocabulary
+    // (with the parallel startup, it is loaded while the modules are constructed and the map file is read,
+    //  and the keyframes of the loaded map are added to the BoW database after the tracking starts)
+    parallel_startup_ = system_params["parallel_startup"].as<bool>(false);
+    if (shared_bow_vocab_) {
+        spdlog::info("use the shared ORB vocabulary");
+        bow_vocab_ = shared_bow_vocab_.get();
+    }
+    else if (parallel_startup_) {
+        spdlog::info("loading ORB vocabulary: {}", vocab_file_path);
+        bow_vocab_ = new data::bow_vocabulary();
+        auto bow_vocab = bow_vocab_;
+        vocab_loading_ = std::async(std::launch::async, [bow_vocab, vocab_file_path]() {
+                             data::bow_vocabulary_util::load(bow_vocab, vocab_file_path);
+                         }).share();
+    }
+    else {
+        spdlog::info("loading ORB vocabulary: {}", vocab_file_path);
+        bow_vocab_ = data::bow_vocabulary_util::load(vocab_file_path);
+    }
+
     camera_ = camera::camera_factory::create(util::yaml_optional_ref(cfg->yaml_node_, "Camera"));
+    // auxiliary cameras of the multi-camera rig
+    if (cfg->yaml_node_["Rig"]) {
+        if (camera_->setup_type_ != camera::setup_type_t::Monocular) {
+            throw std::runtime_error("the multi-camera rig requires the monocular primary camera");
+        }
+        rig_.reset(new camera::rig(cfg->yaml_node_["Rig"]));
+    }
     orb_params_ = new feature::orb_params(util::yaml_optional_ref(cfg->yaml_node_, "Feature"));
     spdlog::info("load orb_params \"{}\"", orb_params_->name_);
 
@@ -49,19 +156,88 @@ system::system(const std::shared_ptr<config>& cfg, const std::string& vocab_file
     cam_db_->add_camera(camera_);
     map_db_ = new data::map_database(system_params["min_num_shared_lms"].as<unsigned int>(15));
     bow_db_ = new data::bow_database(bow_vocab_);
+    // the keyframes and the landmarks of the cleared map are destroyed in the background,
+    // which keeps the tracking thread from stalling on the reset of a large map
+    if (system_params["background_reclamation"].as<bool>(false)) {
+        reclaimer_ = std::make_shared<util::async_reclaimer>();
+        map_db_->set_reclaimer(reclaimer_);
+        bow_db_->set_reclaimer(reclaimer_);
+    }
     orb_params_db_ = new data::orb_params_database();
     orb_params_db_->add_orb_params(orb_params_);
 
     // frame and map publisher
     frame_publisher_ = std::shared_ptr<publish::frame_publisher>(new publish::frame_publisher(cfg_, map_db_));
     map_publisher_ = std::shared_ptr<publish::map_publisher>(new publish::map_publisher(cfg_, map_db_));
+    metrics_publisher_ = std::make_shared<publish::metrics_publisher>();
+#ifdef USE_LOCK_PROFILER
+    // the wait and hold time histograms of the locks of the data module
+    metrics_publisher_->add_collector(util::lock_profiler::get_prometheus_text);
+#endif
 
     // map I/O
     auto map_format = system_params["map_format"].as<std::string>("msgpack");
-    map_database_io_ = io::map_database_io_factory::create(map_format);
+    // the map is only localized against (e.g. many localization processes share a fixed map on a host)
+    read_only_map_ = system_params["read_only_map"].as<bool>(false);
+    if (read_only_map_ && map_format != "binary") {
+        throw std::runtime_error("read_only_map requires the binary map format");
+    }
+    // NOTE: the descriptors, which are the largest part of a large map, are paged in from the map file on demand
+    //       (the pages of the read-only mapping are shared among the processes by the page cache)
+    const bool page_keyframe_descriptors = read_only_map_ || system_params["page_keyframe_descriptors"].as<bool>(false);
+    // the BoW is restored from the map file instead of being computed, which is the most of the loading time
+    const bool load_bow_from_map = read_only_map_ || system_params["load_bow_from_map"].as<bool>(false);
+    // the paged descriptors are streamed by the spatial tiles around the camera
+    const auto map_tiles_params = util::yaml_optional_ref(cfg->yaml_node_, "MapTiles");
+    if (map_tiles_params["enabled"].as<bool>(false)) {
+        if (map_format != "binary" || !page_keyframe_descriptors) {
+            spdlog::warn("map tiles require the binary map format and page_keyframe_descriptors");
+        }
+        else {
+            spdlog::info("map tiles: enabled");
+            map_tile_streamer_ = std::make_shared<io::map_tile_streamer>(map_tiles_params);
+        }
+    }
+    // the keypoints and the descriptors of the keyframes in the msgpack map are packed (and compressed) if specified
+    const auto observation_encoding = data::load_observation_encoding(system_params["map_encoding"].as<std::string>("json"));
+    map_database_io_ = io::map_database_io_factory::create(map_format, page_keyframe_descriptors, map_tile_streamer_, observation_encoding,
+                                                           load_bow_from_map);
+    if (parallel_startup_) {
+        map_database_io_->set_vocabulary_waiter([this]() {
+            wait_for_vocabulary();
+        });
+        map_database_io_->set_defer_bow_database(true);
+    }
+
+    // frame statistics for the trajectory dump (unlimited by default)
+    const auto frame_statistics_params = util::yaml_optional_ref(cfg->yaml_node_, "FrameStatistics");
+    map_db_->set_frame_statistics_limits(frame_statistics_params["max_num_frames"].as<unsigned int>(0),
+                                         frame_statistics_params["decimation"].as<unsigned int>(1));
+
+    // trajectory streaming
+    const auto trajectory_writer_params = util::yaml_optional_ref(cfg->yaml_node_, "TrajectoryWriter");
+    if (trajectory_writer_params["enabled"].as<bool>(false)) {
+        trajectory_writer_ = std::make_shared<io::trajectory_writer>(trajectory_writer_params);
+        // NOTE: the frame statistics, which grow with the number of the frames, are not accumulated unless specified
+        map_db_->set_frame_statistics_observer(trajectory_writer_, trajectory_writer_params["record_frame_statistics"].as<bool>(false));
+    }
+
+    // latency records
+    latency_profiler_.reset(new util::latency_profiler(system_params["num_latency_records"].as<unsigned int>(300)));
+    keyfrm_tracer_ = std::make_shared<util::keyframe_tracer>(system_params["num_keyframe_lifecycle_records"].as<unsigned int>(1000));
+
+    // the mapping and the global optimization are driven by the tracking thread (e.g. batch map building on the servers)
+    offline_mapping_ = system_params["offline_mapping"].as<bool>(false);
 
     // tracking module
     tracker_ = new tracking_module(cfg_, camera_, map_db_, bow_vocab_, bow_db_);
+    adaptive_local_map_tracking_is_configured_ = tracker_->enable_adaptive_local_map_tracking_;
+    {
+        auto tracker = tracker_;
+        map_publisher_->set_rotation_integrator([tracker](const double last_timestamp, const double curr_timestamp, Mat33_t& rot_curr_last) {
+            return tracker->integrate_imu_rotation(last_timestamp, curr_timestamp, rot_curr_last);
+        });
+    }
     // mapping module
     mapper_ = new mapping_module(cfg_->yaml_node_["Mapping"], map_db_, bow_db_, bow_vocab_);
     // global optimization module
@@ -74,19 +250,139 @@ system::system(const std::shared_ptr<config>& cfg, const std::string& vocab_file
         if (depthmap_factor_ < 0.) {
             throw std::runtime_error("depthmap_factor must be greater than 0");
         }
+        depth_consistency_ratio_ = preprocessing_params["depth_consistency_ratio"].as<float>(depth_consistency_ratio_);
+    }
+    if (camera_->setup_type_ == camera::setup_type_t::Stereo) {
+        stereo_depth_prior_margin_ = preprocessing_params["stereo_depth_prior_margin"].as<float>(stereo_depth_prior_margin_);
+        if (stereo_depth_prior_margin_ < 0.0f) {
+            throw std::runtime_error("stereo_depth_prior_margin must be greater than or equal to 0");
+        }
     }
     auto mask_rectangles = util::get_rectangles(preprocessing_params["mask_rectangles"]);
 
     const auto min_size = preprocessing_params["min_size"].as<unsigned int>(800);
-    extractor_left_ = new feature::orb_extractor(orb_params_, min_size, mask_rectangles);
+    const auto feature_params = util::yaml_optional_ref(cfg->yaml_node_, "Feature");
+    const auto use_opencl = feature_params["use_opencl"].as<bool>(false);
+    // descriptor matching on the OpenCL device (requires USE_OPENCL_MATCHER)
+    if (feature_params["use_opencl_matcher"].as<bool>(false)) {
+        match::set_device_matching(true);
+    }
+    // latency-budget mode of ORB extraction (disabled if 0)
+    const auto extraction_time_budget_ms = feature_params["extraction_time_budget_ms"].as<double>(0.0);
+    const auto num_extraction_timing_records = feature_params["num_extraction_timing_records"].as<unsigned int>(5);
+    // downscaled extraction with the refinement to the full resolution (disabled if 0)
+    const auto extraction_first_level = feature_params["extraction_first_level"].as<unsigned int>(0);
+    const auto refine_to_full_resolution = feature_params["refine_to_full_resolution"].as<bool>(true);
+    // extraction of the equirectangular images on the faces of a cube map ("full", "cubemap" or "cubemap_sides")
+    const auto equirectangular_extraction = feature_params["equirectangular_extraction"].as<std::string>("full");
+    unsigned int num_cubemap_faces = 0;
+    if (equirectangular_extraction == "cubemap") {
+        num_cubemap_faces = 6;
+    }
+    else if (equirectangular_extraction == "cubemap_sides") {
+        num_cubemap_faces = 4;
+    }
+    else if (equirectangular_extraction != "full") {
+        throw std::runtime_error("Invalid equirectangular_extraction: " + equirectangular_extraction);
+    }
+    const auto cubemap_face_size = feature_params["cubemap_face_size"].as<unsigned int>(0);
+    const auto cubemap_face_fov_deg = feature_params["cubemap_face_fov_deg"].as<double>(95.0);
+    auto configure_extractor = [&](feature::orb_extractor* extractor, const camera::base* camera) {
+        if (0 < num_cubemap_faces) {
+            if (camera->model_type_ == camera::model_type_t::Equirectangular) {
+                extractor->set_cubemap_extraction(num_cubemap_faces, cubemap_face_size, cubemap_face_fov_deg);
+            }
+            else {
+                spdlog::warn("equirectangular_extraction is ignored for the {} camera", camera->get_model_type_string());
+            }
+        }
+        extractor->set_time_budget(extraction_time_budget_ms, num_extraction_timing_records);
+        extractor->set_first_level(extraction_first_level, refine_to_full_resolution);
+    };
+    extractor_left_ = new feature::orb_extractor(orb_params_, min_size, mask_rectangles, use_opencl);
+    configure_extractor(extractor_left_, camera_);
     if (camera_->setup_type_ == camera::setup_type_t::Stereo) {
-        extractor_right_ = new feature::orb_extractor(orb_params_, min_size, mask_rectangles);
+        extractor_right_ = new feature::orb_extractor(orb_params_, min_size, mask_rectangles, use_opencl);
+        configure_extractor(extractor_right_, camera_);
+    }
+    if (rig_) {
+        for (unsigned int i = 0; i < rig_->get_num_cameras(); ++i) {
+            rig_extractors_.emplace_back(new feature::orb_extractor(orb_params_, min_size, {}, use_opencl));
+            configure_extractor(rig_extractors_.back().get(), rig_->cameras_.at(i));
+        }
+    }
+
+    // pipelined feature extraction (each worker owns its extractors)
+    const auto num_extraction_workers = system_params["num_extraction_workers"].as<unsigned int>(0);
+    for (unsigned int i = 0; i < num_extraction_workers; ++i) {
+        std::unique_ptr<extraction_worker> worker(new extraction_worker());
+        worker->extractor_left_.reset(new feature::orb_extractor(orb_params_, min_size, mask_rectangles, use_opencl));
+        configure_extractor(worker->extractor_left_.get(), camera_);
+        if (camera_->setup_type_ == camera::setup_type_t::Stereo) {
+            worker->extractor_right_.reset(new feature::orb_extractor(orb_params_, min_size, mask_rectangles, use_opencl));
+            configure_extractor(worker->extractor_right_.get(), camera_);
+        }
+        extraction_workers_.push_back(std::move(worker));
+    }
+    max_num_pipelined_frames_ = system_params["max_num_pipelined_frames"].as<unsigned int>(num_extraction_workers + 1);
+    if (num_extraction_workers > 0) {
+        if (max_num_pipelined_frames_ == 0) {
+            throw std::runtime_error("max_num_pipelined_frames must be greater than 0");
+        }
+        spdlog::info("pipelined feature extraction: {} workers, up to {} frames", num_extraction_workers, max_num_pipelined_frames_);
+        // the frame ID is rewound by push_pipeline_job() after draining the pipeline
+        tracker_->rewind_frame_id_on_reset_ = false;
+    }
+    precompute_bow_ = system_params["precompute_bow"].as<bool>(false);
+
+    // frame QoS (the frames fed asynchronously go through the mailbox, and the processing is degraded under the overload)
+    extraction_time_budget_ms_ = extraction_time_budget_ms;
+    num_extraction_timing_records_ = num_extraction_timing_records;
+    const auto qos_params = util::yaml_optional_ref(cfg->yaml_node_, "QoS");
+    if (qos_params["enabled"].as<bool>(false)) {
+        if (num_extraction_workers > 0) {
+            spdlog::warn("frame QoS is not supported with the pipelined feature extraction");
+        }
+        else {
+            frame_skip_policy_ = util::load_frame_skip_policy(qos_params["skip_policy"].as<std::string>("drop_oldest"));
+            mailbox_size_ = qos_params["mailbox_size"].as<unsigned int>(1);
+            if (mailbox_size_ == 0) {
+                throw std::runtime_error("mailbox_size must be greater than 0");
+            }
+            qos_extraction_budget_ratio_ = qos_params["extraction_budget_ratio"].as<double>(0.5);
+            frame_qos_.reset(new util::frame_qos_controller(qos_params, 0.0 < camera_->fps_ ? 1000.0 / camera_->fps_ : 1000.0 / 30.0));
+            spdlog::info("frame QoS: {} with {} frames, frame period {} ms", util::frame_skip_policy_to_string(frame_skip_policy_),
+                         mailbox_size_, frame_qos_->get_frame_period_ms());
+        }
+    }
+
+    // optical flow tracking between ORB extractions
+    const auto optical_flow_params = util::yaml_optional_ref(cfg->yaml_node_, "OpticalFlow");
+    if (optical_flow_params["enabled"].as<bool>(false)) {
+        if (camera_->setup_type_ == camera::setup_type_t::Stereo) {
+            spdlog::warn("optical flow tracking is not supported for stereo cameras");
+        }
+        else if (num_extraction_workers > 0) {
+            spdlog::warn("optical flow tracking is not supported with the pipelined feature extraction");
+        }
+        else {
+            spdlog::info("optical flow tracking: enabled");
+            optical_flow_tracker_.reset(new module::optical_flow_tracker(optical_flow_params));
+        }
     }
 
     if (cfg->marker_model_) {
         if (marker_detector::aruco::is_valid()) {
             spdlog::debug("marker detection: enabled");
-            marker_detector_ = new marker_detector::aruco(camera_, cfg->marker_model_);
+            const auto marker_detector_params = util::yaml_optional_ref(cfg->yaml_node_, "MarkerDetector");
+            marker_detector_ = new marker_detector::aruco(camera_, cfg->marker_model_,
+                                                          marker_detector_params["num_iter"].as<unsigned int>(10),
+                                                          marker_detector_params["reproj_error_threshold"].as<double>(0.1),
+                                                          marker_detector_params["decimation"].as<double>(1.0));
+            if (marker_detector_params["enable_async_detection"].as<bool>(false)) {
+                spdlog::debug("asynchronous marker detection: enabled");
+                async_marker_detector_.reset(new marker_detector::async_detector(marker_detector_));
+            }
         }
         else {
             spdlog::warn("Valid marker_detector is not installed");
@@ -100,9 +396,103 @@ system::system(const std::shared_ptr<config>& cfg, const std::string& vocab_file
     mapper_->set_global_optimization_module(global_optimizer_);
     global_optimizer_->set_tracking_module(tracker_);
     global_optimizer_->set_mapping_module(mapper_);
+
+    // scheduling of the threads of the modules
+    const auto thread_scheduling_params = util::yaml_optional_ref(cfg->yaml_node_, "ThreadScheduling");
+    thread_scheduling_params_.at(static_cast<unsigned int>(module_thread_t::Tracking))
+        = util::thread_scheduling_params::load(util::yaml_optional_ref(thread_scheduling_params, "Tracking"));
+    thread_scheduling_params_.at(static_cast<unsigned int>(module_thread_t::Mapping))
+        = util::thread_scheduling_params::load(util::yaml_optional_ref(thread_scheduling_params, "Mapping"));
+    thread_scheduling_params_.at(static_cast<unsigned int>(module_thread_t::GlobalOptimization))
+        = util::thread_scheduling_params::load(util::yaml_optional_ref(thread_scheduling_params, "GlobalOptimization"));
+    thread_scheduling_params_.at(static_cast<unsigned int>(module_thread_t::LoopBA))
+        = util::thread_scheduling_params::load(util::yaml_optional_ref(thread_scheduling_params, "LoopBA"));
+    global_optimizer_->set_loop_BA_thread_scheduling(thread_scheduling_params_.at(static_cast<unsigned int>(module_thread_t::LoopBA)));
+
+    // thread pool shared among the modules, which bounds the total parallelism
+    // (the tasks of the tracking are prioritized over the ones of the loop detection)
+    const auto thread_pool_params = util::yaml_optional_ref(cfg->yaml_node_, "ThreadPool");
+    const auto num_pool_threads = thread_pool_params["num_threads"].as<unsigned int>(0);
+    if (shared_thread_pool) {
+        // the tasks of this instance are scheduled fairly with the ones of the other instances
+        thread_pool_ = shared_thread_pool;
+        thread_pool_client_id_ = thread_pool_->add_client();
+        spdlog::info("shared thread pool among the instances: {} threads (client {})", thread_pool_->get_num_threads(), thread_pool_client_id_);
+        tracker_->set_thread_pool(thread_pool_);
+        mapper_->set_thread_pool(thread_pool_);
+        global_optimizer_->set_thread_pool(thread_pool_);
+    }
+    else if (0 < num_pool_threads) {
+        spdlog::info("shared thread pool: {} threads", num_pool_threads);
+        thread_pool_ = std::make_shared<util::thread_pool>(
+            num_pool_threads, thread_pool_params["cpu_affinity"].as<std::vector<int>>(std::vector<int>()));
+        tracker_->set_thread_pool(thread_pool_);
+        mapper_->set_thread_pool(thread_pool_);
+        global_optimizer_->set_thread_pool(thread_pool_);
+    }
+
+    // metrics (the gauges are sampled when the metrics are read)
+    mapper_->set_metrics_publisher(metrics_publisher_);
+    global_optimizer_->set_metrics_publisher(metrics_publisher_);
+    tracker_->set_keyframe_tracer(keyfrm_tracer_);
+    mapper_->set_keyframe_tracer(keyfrm_tracer_);
+    global_optimizer_->set_keyframe_tracer(keyfrm_tracer_);
+    const auto keyfrm_tracer = keyfrm_tracer_;
+    metrics_publisher_->add_collector([keyfrm_tracer](const std::string& prefix) {
+        return keyfrm_tracer->get_prometheus_text(prefix);
+    });
+    using publish::metric_type_t;
+    metrics_publisher_->describe("frames_total", metric_type_t::Counter, "number of the tracked frames");
+    metrics_publisher_->describe("frames_dropped_total", metric_type_t::Counter, "number of the frames dropped before the tracking (empty images)");
+    metrics_publisher_->describe("qos_frames_dropped_total", metric_type_t::Counter, "number of the frames dropped by the frame QoS (reason: mailbox or degradation)");
+    metrics_publisher_->describe("qos_frame_lag_ms", metric_type_t::Summary, "time from the feeding to the end of the tracking of a frame with the frame QoS [ms]");
+    metrics_publisher_->describe("local_map_searches_skipped_total", metric_type_t::Counter, "number of the frames which skipped the local map search in the adaptive mode");
+    metrics_publisher_->describe("tracking_state_transitions_total", metric_type_t::Counter, "number of the transitions of the tracking state");
+    metrics_publisher_->describe("tracking_latency_ms", metric_type_t::Summary, "latency of the tracking of a frame [ms]");
+    metrics_publisher_->describe("stage_latency_ms", metric_type_t::Summary, "latency of each stage of a frame [ms] (built with USE_LATENCY_PROFILER)");
+    metrics_publisher_->describe("tracking_allocations", metric_type_t::Summary, "number of the allocations in the tracking of a frame (built with USE_ALLOCATION_COUNTERS)");
+    metrics_publisher_->describe("stage_allocations", metric_type_t::Summary, "number of the allocations in each stage of a frame (built with USE_LATENCY_PROFILER and USE_ALLOCATION_COUNTERS)");
+    metrics_publisher_->describe("local_BA_duration_ms", metric_type_t::Summary, "duration of the local BA [ms]");
+    metrics_publisher_->describe("local_BA_aborts_total", metric_type_t::Counter, "number of the aborted local BA");
+    metrics_publisher_->describe("local_BA_skips_total", metric_type_t::Counter, "number of the local BA skipped due to insufficient performance");
+    metrics_publisher_->describe("loop_BA_duration_ms", metric_type_t::Summary, "duration of the loop BA [ms]");
+    metrics_publisher_->describe("loop_BA_aborts_total", metric_type_t::Counter, "number of the aborted loop BA");
+    metrics_publisher_->set_gauge(
+        "mapping_queued_keyframes", [this] { return static_cast<double>(mapper_->get_num_queued_keyframes()); },
+        "number of the keyframes queued in the mapping module");
+    metrics_publisher_->set_gauge(
+        "keyframes", [this] { return static_cast<double>(map_db_->get_num_keyframes()); },
+        "number of the keyframes");
+    metrics_publisher_->set_gauge(
+        "landmarks", [this] { return static_cast<double>(map_db_->get_num_landmarks()); },
+        "number of the landmarks");
+    metrics_publisher_->set_gauge(
+        "map_memory_bytes", [this] { return static_cast<double>(get_memory_usage().total()); },
+        "estimated memory occupied by the map and the runtime structures [bytes]");
+    metrics_publisher_->set_gauge(
+        "loop_BA_is_running", [this] { return global_optimizer_->loop_BA_is_running() ? 1.0 : 0.0; },
+        "the loop BA is running or not");
+    if (frame_qos_) {
+        metrics_publisher_->set_gauge(
+            "qos_degradation_level", [this] { return static_cast<double>(frame_degradation_level_.load()); },
+            "degradation level of the frame QoS (0: none, 1: skip the local map refresh, 2: reduce the keypoints, 3: drop the frames)");
+    }
+
+    // record the fed frames for the replay
+    const auto record_dir = system_params["record_dir"].as<std::string>("");
+    if (!record_dir.empty()) {
+        start_recording(record_dir);
+    }
 }
 
 system::~system() {
+    // the background map saving and the startup tasks refer to the databases
+    if (map_saving_.valid()) {
+        map_saving_.wait();
+    }
+    wait_for_vocabulary();
+    wait_for_bow_database();
+
     global_optimization_thread_.reset(nullptr);
     delete global_optimizer_;
     global_optimizer_ = nullptr;
@@ -111,16 +501,26 @@ system::~system() {
     delete mapper_;
     mapper_ = nullptr;
 
+    // the map publisher can outlive the system
+    map_publisher_->set_rotation_integrator(nullptr);
     delete tracker_;
     tracker_ = nullptr;
 
+    remote_map_integrator_.reset();
+
     delete bow_db_;
     bow_db_ = nullptr;
     delete map_db_;
     map_db_ = nullptr;
+    // the keyframes refer to the cameras
+    if (reclaimer_) {
+        reclaimer_->wait_until_idle();
+    }
     delete cam_db_;
     cam_db_ = nullptr;
-    delete bow_vocab_;
+    if (!shared_bow_vocab_) {
+        delete bow_vocab_;
+    }
     bow_vocab_ = nullptr;
 
     delete extractor_left_;
@@ -128,6 +528,8 @@ system::~system() {
     delete extractor_right_;
     extractor_right_ = nullptr;
 
+    // (the worker refers to the marker detector)
+    async_marker_detector_.reset();
     delete marker_detector_;
     marker_detector_ = nullptr;
 
@@ -157,30 +559,159 @@ void system::print_info() {
     message_stream << *cfg_ << std::endl;
 
     spdlog::info(message_stream.str());
+
+    spdlog::info("Hamming distance kernel: {}", match::get_hamming_impl_name(match::get_hamming_impl()));
+    spdlog::info("Descriptor matching on the OpenCL device: {}", match::get_device_matching() ? "ENABLED" : "DISABLED");
 }
 
 void system::startup(const bool need_initialize) {
     spdlog::info("startup SLAM system");
+    // (the BoW database might still be populated in the background)
+    wait_for_vocabulary();
+    spdlog::info("startup: {} ms after the construction",
+                 std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - construction_tp_).count());
     system_is_running_ = true;
 
     if (!need_initialize) {
         tracker_->tracking_state_ = tracker_state_t::Lost;
     }
 
-    mapping_thread_ = std::unique_ptr<std::thread>(new std::thread(&stella_vslam::mapping_module::run, mapper_));
-    global_optimization_thread_ = std::unique_ptr<std::thread>(new std::thread(&stella_vslam::global_optimization_module::run, global_optimizer_));
+    if (offline_mapping_) {
+        mapper_->start_offline();
+        global_optimizer_->start_offline();
+    }
+    else {
+        util::thread_scheduling_params mapping_scheduling, global_optimization_scheduling;
+        {
+            std::lock_guard<std::mutex> lock(mtx_thread_scheduling_);
+            mapping_scheduling = thread_scheduling_params_.at(static_cast<unsigned int>(module_thread_t::Mapping));
+            global_optimization_scheduling = thread_scheduling_params_.at(static_cast<unsigned int>(module_thread_t::GlobalOptimization));
+        }
+        mapping_thread_ = std::unique_ptr<std::thread>(new std::thread([this, mapping_scheduling] {
+            if (!mapping_scheduling.is_default()) {
+                util::apply_current_thread_scheduling(mapping_scheduling);
+            }
+            util::thread_cpu_time_scope cpu_time_scope(module_cpu_time_ns_.at(static_cast<unsigned int>(module_thread_t::Mapping)));
+            const util::thread_pool::client_scope pool_client_scope(thread_pool_client_id_);
+            mapper_->run();
+        }));
+        global_optimization_thread_ = std::unique_ptr<std::thread>(new std::thread([this, global_optimization_scheduling] {
+            if (!global_optimization_scheduling.is_default()) {
+                util::apply_current_thread_scheduling(global_optimization_scheduling);
+            }
+            util::thread_cpu_time_scope cpu_time_scope(module_cpu_time_ns_.at(static_cast<unsigned int>(module_thread_t::GlobalOptimization)));
+            const util::thread_pool::client_scope pool_client_scope(thread_pool_client_id_);
+            global_optimizer_->run();
+        }));
+    }
+
+    if (pipelined_extraction_is_enabled()) {
+        {
+            std::lock_guard<std::mutex> lock(mtx_pipeline_);
+            pipeline_is_terminated_ = false;
+        }
+        for (auto& worker : extraction_workers_) {
+            extraction_threads_.emplace_back(&system::run_extraction_worker, this, worker.get());
+        }
+        pipelined_tracking_thread_ = std::unique_ptr<std::thread>(new std::thread(&system::run_pipelined_tracking, this));
+    }
+    if (frame_qos_) {
+        {
+            std::lock_guard<std::mutex> lock(mtx_mailbox_);
+            mailbox_is_terminated_ = false;
+        }
+        qos_tracking_thread_ = std::unique_ptr<std::thread>(new std::thread(&system::run_qos_tracking, this));
+    }
+
+    // the read-only map is never modified by the mapping module
+    if (read_only_map_) {
+        disable_mapping_module();
+    }
+}
+
+void system::set_thread_scheduling(const module_thread_t thread, const util::thread_scheduling_params& params) {
+    std::lock_guard<std::mutex> lock(mtx_thread_scheduling_);
+    thread_scheduling_params_.at(static_cast<unsigned int>(thread)) = params;
+    if (thread == module_thread_t::Tracking) {
+        // applied again at the next frame
+        scheduled_tracking_thread_id_ = std::thread::id();
+    }
+    else if (thread == module_thread_t::LoopBA) {
+        global_optimizer_->set_loop_BA_thread_scheduling(params);
+    }
+}
+
+void system::apply_tracking_thread_scheduling() {
+    std::lock_guard<std::mutex> lock(mtx_thread_scheduling_);
+    if (scheduled_tracking_thread_id_ == std::this_thread::get_id()) {
+        return;
+    }
+    scheduled_tracking_thread_id_ = std::this_thread::get_id();
+    const auto& params = thread_scheduling_params_.at(static_cast<unsigned int>(module_thread_t::Tracking));
+    if (!params.is_default()) {
+        util::apply_current_thread_scheduling(params);
+    }
 }
 
 void system::shutdown() {
+    // drain the extraction pipeline, then stop its threads
+    if (pipelined_tracking_thread_) {
+        {
+            std::lock_guard<std::mutex> lock(mtx_pipeline_);
+            pipeline_is_terminated_ = true;
+        }
+        cond_pipeline_.notify_all();
+        for (auto& thread : extraction_threads_) {
+            thread.join();
+        }
+        extraction_threads_.clear();
+        pipelined_tracking_thread_->join();
+        pipelined_tracking_thread_.reset(nullptr);
+    }
+    // track the frames left in the mailbox, then stop the thread
+    if (qos_tracking_thread_) {
+        {
+            std::lock_guard<std::mutex> lock(mtx_mailbox_);
+            mailbox_is_terminated_ = true;
+        }
+        cond_mailbox_.notify_all();
+        qos_tracking_thread_->join();
+        qos_tracking_thread_.reset(nullptr);
+    }
+
+    wait_for_bow_database();
+
+    // wait for the background map saving
+    {
+        std::lock_guard<std::mutex> lock(mtx_map_saving_);
+        if (map_saving_.valid()) {
+            map_saving_.wait();
+        }
+    }
+
     // terminate the other threads
-    auto future_mapper_terminate = mapper_->async_terminate();
-    auto future_global_optimizer_terminate = global_optimizer_->async_terminate();
-    future_mapper_terminate.get();
-    future_global_optimizer_terminate.get();
+    {
+        std::unique_lock<std::mutex> lock_offline_mapping = lock_offline_mapping_if_enabled();
+        auto future_mapper_terminate = mapper_->async_terminate();
+        auto future_global_optimizer_terminate = global_optimizer_->async_terminate();
+        future_mapper_terminate.get();
+        future_global_optimizer_terminate.get();
+    }
 
     // wait until the threads stop
-    mapping_thread_->join();
-    global_optimization_thread_->join();
+    if (mapping_thread_) {
+        mapping_thread_->join();
+        mapping_thread_.reset(nullptr);
+    }
+    if (global_optimization_thread_) {
+        global_optimization_thread_->join();
+        global_optimization_thread_.reset(nullptr);
+    }
+
+    // write the rest of the trajectory after the last corrections
+    if (trajectory_writer_) {
+        trajectory_writer_->flush();
+    }
 
     spdlog::info("shutdown SLAM system");
     system_is_running_ = false;
@@ -201,17 +732,141 @@ void system::save_keyframe_trajectory(const std::string& path, const std::string
 }
 
 void system::load_map_database(const std::string& path) const {
+    // the keyframes of the previous map are added to the BoW database first
+    wait_for_bow_database();
     pause_other_threads();
     spdlog::debug("load_map_database: {}", path);
-    map_database_io_->load(path, cam_db_, orb_params_db_, map_db_, bow_db_, bow_vocab_);
+    {
+        std::lock_guard<std::mutex> lock(mtx_map_database_io_);
+        map_database_io_->load(path, cam_db_, orb_params_db_, map_db_, bow_db_, bow_vocab_);
+    }
     resume_other_threads();
+
+    if (parallel_startup_) {
+        populate_bow_database();
+    }
+}
+
+void system::populate_bow_database() const {
+    const auto keyfrms = map_db_->get_all_keyframes();
+    auto bow_db = bow_db_;
+    std::lock_guard<std::mutex> lock(mtx_startup_tasks_);
+    bow_db_population_ = std::async(std::launch::async, [bow_db, keyfrms]() {
+                             const auto tp_start = std::chrono::steady_clock::now();
+                             // the keyframes are added by the chunks so that the queries of the relocalization are not blocked for long
+                             // (the candidates are found among the added keyframes in the meantime)
+                             constexpr size_t chunk_size = 256;
+                             for (size_t begin = 0; begin < keyfrms.size(); begin += chunk_size) {
+                                 const auto end = std::min(begin + chunk_size, keyfrms.size());
+                                 bow_db->add_keyframes(std::vector<std::shared_ptr<data::keyframe>>(keyfrms.begin() + begin, keyfrms.begin() + end));
+                             }
+                             const auto tp_end = std::chrono::steady_clock::now();
+                             spdlog::info("added {} keyframes to the BoW database in the background ({} ms)", keyfrms.size(),
+                                          std::chrono::duration_cast<std::chrono::milliseconds>(tp_end - tp_start).count());
+                         }).share();
+}
+
+void system::wait_for_vocabulary() const {
+    if (vocab_loading_.valid()) {
+        vocab_loading_.wait();
+    }
+}
+
+void system::wait_for_bow_database() const {
+    std::shared_future<void> bow_db_population;
+    {
+        std::lock_guard<std::mutex> lock(mtx_startup_tasks_);
+        bow_db_population = bow_db_population_;
+    }
+    if (bow_db_population.valid()) {
+        bow_db_population.wait();
+    }
 }
 
 void system::save_map_database(const std::string& path) const {
+    if (read_only_map_) {
+        throw std::runtime_error("cannot save the read-only map");
+    }
     pause_other_threads();
     spdlog::debug("save_map_database: {}", path);
-    map_database_io_->save(path, cam_db_, orb_params_db_, map_db_);
+    {
+        std::lock_guard<std::mutex> lock(mtx_map_database_io_);
+        map_database_io_->save(path, cam_db_, orb_params_db_, map_db_);
+    }
+    resume_other_threads();
+}
+
+unsigned int system::merge_maps() {
+    wait_for_bow_database();
+    pause_other_threads();
+    spdlog::debug("merge_maps");
+    unsigned int num_merges = 0;
+    {
+        module::map_merger merger(map_db_, bow_db_, bow_vocab_, cfg_->yaml_node_, camera_->setup_type_ != camera::setup_type_t::Monocular);
+        num_merges = merger.merge();
+    }
+    resume_other_threads();
+    return num_merges;
+}
+
+std::unique_ptr<localizer> system::create_localizer(const unsigned int num_threads) const {
+    wait_for_vocabulary();
+    return std::unique_ptr<localizer>(new localizer(cfg_, camera_, orb_params_, map_db_, bow_db_, bow_vocab_, num_threads));
+}
+
+unsigned int system::integrate_remote_segment(const module::remote_segment& segment) {
+    std::lock_guard<std::mutex> lock(mtx_remote_map_);
+    if (!remote_map_integrator_) {
+        wait_for_vocabulary();
+        remote_map_integrator_.reset(new module::remote_map_integrator(cam_db_, orb_params_db_, map_db_, bow_db_, bow_vocab_));
+    }
+    pause_other_threads();
+    unsigned int num_new_keyfrms = 0;
+    try {
+        num_new_keyfrms = remote_map_integrator_->integrate(segment);
+    }
+    catch (const std::runtime_error& e) {
+        spdlog::error("integrate_remote_segment: {}", e.what());
+    }
+    resume_other_threads();
+    return num_new_keyfrms;
+}
+
+eigen_alloc_vector<module::remote_correction> system::compute_remote_corrections() {
+    std::lock_guard<std::mutex> lock(mtx_remote_map_);
+    if (!remote_map_integrator_) {
+        return {};
+    }
+    pause_other_threads();
+    auto corrections = remote_map_integrator_->compute_corrections();
     resume_other_threads();
+    return corrections;
+}
+
+std::shared_future<void> system::save_map_database_async(const std::string& path) const {
+    spdlog::debug("save_map_database_async: {}", path);
+    if (read_only_map_) {
+        throw std::runtime_error("cannot save the read-only map");
+    }
+    // NOTE: the cameras and the ORB parameters are only added, and they are locked by their databases
+    std::shared_ptr<data::map_database> snapshot;
+    {
+        std::lock_guard<util::profiled_mutex> lock(data::map_database::mtx_database_);
+        snapshot = map_db_->create_snapshot();
+    }
+
+    std::lock_guard<std::mutex> lock(mtx_map_saving_);
+    const auto prev_map_saving = map_saving_;
+    auto map_saving = std::async(std::launch::async, [this, path, snapshot, prev_map_saving]() {
+        // keep the order of the saves
+        if (prev_map_saving.valid()) {
+            prev_map_saving.wait();
+        }
+        std::lock_guard<std::mutex> lock(mtx_map_database_io_);
+        map_database_io_->save_unlocked(path, cam_db_, orb_params_db_, snapshot.get());
+    });
+    map_saving_ = map_saving.share();
+    return map_saving_;
 }
 
 const std::shared_ptr<publish::map_publisher> system::get_map_publisher() const {
@@ -222,13 +877,34 @@ const std::shared_ptr<publish::frame_publisher> system::get_frame_publisher() co
     return frame_publisher_;
 }
 
+const std::shared_ptr<publish::metrics_publisher> system::get_metrics_publisher() const {
+    return metrics_publisher_;
+}
+
+double system::get_module_cpu_time(const module_thread_t thread) const {
+    if (thread == module_thread_t::LoopBA) {
+        return global_optimizer_->get_loop_BA_cpu_time();
+    }
+    return module_cpu_time_ns_.at(static_cast<unsigned int>(thread)) * 1e-9;
+}
+
 void system::enable_mapping_module() {
     std::lock_guard<std::mutex> lock(mtx_mapping_);
     if (!system_is_running_) {
         spdlog::critical("please call system::enable_mapping_module() after system::startup()");
     }
+    if (read_only_map_) {
+        spdlog::warn("the mapping module is not enabled since the map is read-only");
+        return;
+    }
     // resume the mapping module
+    std::unique_lock<std::mutex> lock_offline_mapping = lock_offline_mapping_if_enabled();
+    const bool map_was_frozen = tracker_->map_is_frozen();
+    tracker_->set_map_is_frozen(false);
     mapper_->resume();
+    if (map_was_frozen) {
+        global_optimizer_->resume();
+    }
 }
 
 void system::disable_mapping_module() {
@@ -237,9 +913,20 @@ void system::disable_mapping_module() {
         spdlog::critical("please call system::disable_mapping_module() after system::startup()");
     }
     // pause the mapping module
+    std::unique_lock<std::mutex> lock_offline_mapping = lock_offline_mapping_if_enabled();
+    if (tracker_->freeze_map_in_localization_) {
+        // the loop correction moves the keyframes and the landmarks (and resumes the mapping module),
+        // so the global optimization module is paused after finishing the queued loop correction
+        auto future_pause_global_optimizer = global_optimizer_->async_pause();
+        future_pause_global_optimizer.get();
+    }
     auto future_pause = mapper_->async_pause();
     // wait until it stops
     future_pause.get();
+    // the map is not modified anymore, so the tracking module can track against the frozen map
+    if (tracker_->freeze_map_in_localization_) {
+        tracker_->set_map_is_frozen(true);
+    }
 }
 
 bool system::mapping_module_is_enabled() const {
@@ -261,6 +948,13 @@ bool system::loop_detector_is_enabled() const {
 }
 
 bool system::request_loop_closure(int keyfrm1_id, int keyfrm2_id) {
+    if (offline_mapping_) {
+        // the request is processed here instead of after the next frame
+        std::lock_guard<std::mutex> lock(mtx_offline_mapping_);
+        const bool is_requested = global_optimizer_->request_loop_closure(keyfrm1_id, keyfrm2_id);
+        global_optimizer_->process_queued_keyframes();
+        return is_requested;
+    }
     return global_optimizer_->request_loop_closure(keyfrm1_id, keyfrm2_id);
 }
 
@@ -273,6 +967,17 @@ void system::abort_loop_BA() {
 }
 
 data::frame system::create_monocular_frame(const cv::Mat& img, const double timestamp, const cv::Mat& mask) {
+    data::frame frm;
+    if (create_frame_by_optical_flow(img, cv::Mat{}, timestamp, frm)) {
+        return frm;
+    }
+    return create_monocular_frame(img, timestamp, mask, extractor_left_, keypts_, data::frame::next_id_++);
+}
+
+data::frame system::create_monocular_frame(const cv::Mat& img, const double timestamp, const cv::Mat& mask,
+                                           feature::orb_extractor* extractor, std::vector<cv::KeyPoint>& keypts, const unsigned int frm_id) {
+    STELLA_VSLAM_LATENCY_SPAN("system::create_monocular_frame");
+
     // color conversion
     if (!camera_->is_valid_shape(img)) {
         spdlog::warn("preprocess: Input image size is invalid");
@@ -283,15 +988,19 @@ data::frame system::create_monocular_frame(const cv::Mat& img, const double time
     data::frame_observation frm_obs;
 
     // Extract ORB feature
-    keypts_.clear();
-    extractor_left_->extract(img_gray, mask, keypts_, frm_obs.descriptors_);
-    frm_obs.num_keypts_ = keypts_.size();
-    if (keypts_.empty()) {
+    keypts.clear();
+    {
+        STELLA_VSLAM_LATENCY_SPAN("orb_extractor::extract");
+        extractor->extract(img_gray, mask, keypts, frm_obs.descriptors_);
+    }
+    frm_obs.num_keypts_ = keypts.size();
+    frm_obs.extraction_settings_ = extractor->get_extraction_settings();
+    if (keypts.empty()) {
         spdlog::warn("preprocess: cannot extract any keypoints");
     }
 
     // Undistort keypoints
-    camera_->undistort_keypoints(keypts_, frm_obs.undist_keypts_);
+    camera_->undistort_keypoints(keypts, frm_obs.undist_keypts_);
 
     // Convert to bearing vector
     camera_->convert_keypoints_to_bearings(frm_obs.undist_keypts_, frm_obs.bearings_);
@@ -299,16 +1008,61 @@ data::frame system::create_monocular_frame(const cv::Mat& img, const double time
     // Assign all the keypoints into grid
     data::assign_keypoints_to_grid(camera_, frm_obs.undist_keypts_, frm_obs.keypt_indices_in_cells_);
 
+    data::frame frm(frm_id, timestamp, camera_, orb_params_, std::move(frm_obs));
     // Detect marker
-    std::unordered_map<unsigned int, data::marker2d> markers_2d;
-    if (marker_detector_) {
-        marker_detector_->detect(img_gray, markers_2d);
+    detect_markers(img_gray, frm);
+    return frm;
+}
+
+data::frame system::create_rig_frame(const std::vector<cv::Mat>& imgs, const double timestamp, const cv::Mat& mask) {
+    STELLA_VSLAM_LATENCY_SPAN("system::create_rig_frame");
+
+    // extract the features of the auxiliary cameras on their own threads
+    const auto num_rig_cameras = rig_->get_num_cameras();
+    std::vector<data::frame_observation> rig_frm_obs(num_rig_cameras);
+    std::vector<std::thread> rig_threads;
+    for (unsigned int i = 0; i < num_rig_cameras; ++i) {
+        rig_threads.emplace_back([this, i, &imgs, &rig_frm_obs]() {
+            const auto rig_camera = rig_->cameras_.at(i);
+            auto& frm_obs = rig_frm_obs.at(i);
+            if (!rig_camera->is_valid_shape(imgs.at(i + 1))) {
+                spdlog::warn("preprocess: Input image size of the rig camera {} is invalid", i);
+            }
+            cv::Mat img_gray = imgs.at(i + 1);
+            util::convert_to_grayscale(img_gray, rig_camera->color_order_);
+
+            std::vector<cv::KeyPoint> keypts;
+            rig_extractors_.at(i)->extract(img_gray, cv::Mat{}, keypts, frm_obs.descriptors_);
+            frm_obs.num_keypts_ = keypts.size();
+            frm_obs.extraction_settings_ = rig_extractors_.at(i)->get_extraction_settings();
+            rig_camera->undistort_keypoints(keypts, frm_obs.undist_keypts_);
+            rig_camera->convert_keypoints_to_bearings(frm_obs.undist_keypts_, frm_obs.bearings_);
+            data::assign_keypoints_to_grid(rig_camera, frm_obs.undist_keypts_, frm_obs.keypt_indices_in_cells_);
+        });
+    }
+
+    // the primary camera is processed on this thread meanwhile
+    auto frm = create_monocular_frame(imgs.at(0), timestamp, mask);
+    for (auto& rig_thread : rig_threads) {
+        rig_thread.join();
     }
 
-    return data::frame(timestamp, camera_, orb_params_, frm_obs, std::move(markers_2d));
+    for (unsigned int i = 0; i < num_rig_cameras; ++i) {
+        const data::frame rig_frm(frm.id_, timestamp, rig_->cameras_.at(i), orb_params_, rig_frm_obs.at(i));
+        frm.rig_frms_.emplace_back(new data::rig_frame(rig_->poses_cb_.at(i), rig_frm));
+    }
+    return frm;
 }
 
 data::frame system::create_stereo_frame(const cv::Mat& left_img, const cv::Mat& right_img, const double timestamp, const cv::Mat& mask) {
+    return create_stereo_frame(left_img, right_img, timestamp, mask, extractor_left_, extractor_right_, keypts_, data::frame::next_id_++);
+}
+
+data::frame system::create_stereo_frame(const cv::Mat& left_img, const cv::Mat& right_img, const double timestamp, const cv::Mat& mask,
+                                        feature::orb_extractor* extractor_left, feature::orb_extractor* extractor_right,
+                                        std::vector<cv::KeyPoint>& keypts, const unsigned int frm_id) {
+    STELLA_VSLAM_LATENCY_SPAN("system::create_stereo_frame");
+
     // color conversion
     if (!camera_->is_valid_shape(left_img)) {
         spdlog::warn("preprocess: Input image size is invalid");
@@ -328,28 +1082,58 @@ data::frame system::create_stereo_frame(const cv::Mat& left_img, const cv::Mat&
     cv::Mat descriptors_right;
 
     // Extract ORB feature
-    keypts_.clear();
-    std::thread thread_left([this, &frm_obs, &img_gray, &mask]() {
-        extractor_left_->extract(img_gray, mask, keypts_, frm_obs.descriptors_);
-    });
-    std::thread thread_right([this, &frm_obs, &right_img_gray, &mask, &keypts_right, &descriptors_right]() {
-        extractor_right_->extract(right_img_gray, mask, keypts_right, descriptors_right);
-    });
-    thread_left.join();
-    thread_right.join();
-    frm_obs.num_keypts_ = keypts_.size();
-    if (keypts_.empty()) {
+    keypts.clear();
+    {
+        // (spans are recorded on this thread, so the left and right extractions are measured together)
+        STELLA_VSLAM_LATENCY_SPAN("orb_extractor::extract");
+        std::thread thread_left([extractor_left, &keypts, &frm_obs, &img_gray, &mask]() {
+            extractor_left->extract(img_gray, mask, keypts, frm_obs.descriptors_);
+        });
+        std::thread thread_right([extractor_right, &right_img_gray, &mask, &keypts_right, &descriptors_right]() {
+            extractor_right->extract(right_img_gray, mask, keypts_right, descriptors_right);
+        });
+        thread_left.join();
+        thread_right.join();
+    }
+    frm_obs.num_keypts_ = keypts.size();
+    frm_obs.extraction_settings_ = extractor_left->get_extraction_settings();
+    if (keypts.empty()) {
         spdlog::warn("preprocess: cannot extract any keypoints");
     }
 
     // Undistort keypoints
-    camera_->undistort_keypoints(keypts_, frm_obs.undist_keypts_);
+    camera_->undistort_keypoints(keypts, frm_obs.undist_keypts_);
 
     // Estimate depth with stereo match
-    match::stereo stereo_matcher(extractor_left_->image_pyramid_, extractor_right_->image_pyramid_,
-                                 keypts_, keypts_right, frm_obs.descriptors_, descriptors_right,
+    STELLA_VSLAM_LATENCY_SPAN("match::stereo::compute");
+    match::stereo stereo_matcher(extractor_left->image_pyramid_, extractor_right->image_pyramid_,
+                                 keypts, keypts_right, frm_obs.descriptors_, descriptors_right,
                                  orb_params_->scale_factors_, orb_params_->inv_scale_factors_,
                                  camera_->focal_x_baseline_, camera_->true_baseline_);
+    if (0.0f < stereo_depth_prior_margin_) {
+        // project the landmarks of the last frame with the motion model
+        // (NOTE: the prior may be older by a frame in the pipelined extraction, the full range is searched if no match is found)
+        Mat44_t pred_pose_cw;
+        eigen_alloc_vector<Vec3_t> pos_ws;
+        if (tracker_->predict_next_frame(pred_pose_cw, pos_ws)) {
+            const Mat33_t rot_cw = pred_pose_cw.block<3, 3>(0, 0);
+            const Vec3_t trans_cw = pred_pose_cw.block<3, 1>(0, 3);
+            std::vector<cv::Point2f> pts_left;
+            std::vector<float> depths_left;
+            pts_left.reserve(pos_ws.size());
+            depths_left.reserve(pos_ws.size());
+            for (const auto& pos_w : pos_ws) {
+                Vec2_t reproj;
+                float x_right;
+                if (!camera_->reproject_to_image(rot_cw, trans_cw, pos_w, reproj, x_right)) {
+                    continue;
+                }
+                pts_left.emplace_back(reproj(0), reproj(1));
+                depths_left.push_back((rot_cw * pos_w + trans_cw)(2));
+            }
+            stereo_matcher.set_depth_prior(pts_left, depths_left, stereo_depth_prior_margin_);
+        }
+    }
     stereo_matcher.compute(frm_obs.stereo_x_right_, frm_obs.depths_);
 
     // Convert to bearing vector
@@ -358,16 +1142,24 @@ data::frame system::create_stereo_frame(const cv::Mat& left_img, const cv::Mat&
     // Assign all the keypoints into grid
     data::assign_keypoints_to_grid(camera_, frm_obs.undist_keypts_, frm_obs.keypt_indices_in_cells_);
 
+    data::frame frm(frm_id, timestamp, camera_, orb_params_, std::move(frm_obs));
     // Detect marker
-    std::unordered_map<unsigned int, data::marker2d> markers_2d;
-    if (marker_detector_) {
-        marker_detector_->detect(img_gray, markers_2d);
-    }
-
-    return data::frame(timestamp, camera_, orb_params_, frm_obs, std::move(markers_2d));
+    detect_markers(img_gray, frm);
+    return frm;
 }
 
 data::frame system::create_RGBD_frame(const cv::Mat& rgb_img, const cv::Mat& depthmap, const double timestamp, const cv::Mat& mask) {
+    data::frame frm;
+    if (create_frame_by_optical_flow(rgb_img, depthmap, timestamp, frm)) {
+        return frm;
+    }
+    return create_RGBD_frame(rgb_img, depthmap, timestamp, mask, extractor_left_, keypts_, data::frame::next_id_++);
+}
+
+data::frame system::create_RGBD_frame(const cv::Mat& rgb_img, const cv::Mat& depthmap, const double timestamp, const cv::Mat& mask,
+                                      feature::orb_extractor* extractor, std::vector<cv::KeyPoint>& keypts, const unsigned int frm_id) {
+    STELLA_VSLAM_LATENCY_SPAN("system::create_RGBD_frame");
+
     // color and depth scale conversion
     if (!camera_->is_valid_shape(rgb_img)) {
         spdlog::warn("preprocess: Input image size is invalid");
@@ -376,43 +1168,65 @@ data::frame system::create_RGBD_frame(const cv::Mat& rgb_img, const cv::Mat& dep
         spdlog::warn("preprocess: Input image size is invalid");
     }
     cv::Mat img_gray = rgb_img;
-    cv::Mat img_depth = depthmap;
     util::convert_to_grayscale(img_gray, camera_->color_order_);
-    util::convert_to_true_depth(img_depth, depthmap_factor_);
 
     data::frame_observation frm_obs;
 
     // Extract ORB feature
-    keypts_.clear();
-    extractor_left_->extract(img_gray, mask, keypts_, frm_obs.descriptors_);
-    frm_obs.num_keypts_ = keypts_.size();
-    if (keypts_.empty()) {
+    keypts.clear();
+    {
+        STELLA_VSLAM_LATENCY_SPAN("orb_extractor::extract");
+        extractor->extract(img_gray, mask, keypts, frm_obs.descriptors_);
+    }
+    frm_obs.num_keypts_ = keypts.size();
+    frm_obs.extraction_settings_ = extractor->get_extraction_settings();
+    if (keypts.empty()) {
         spdlog::warn("preprocess: cannot extract any keypoints");
     }
 
     // Undistort keypoints
-    camera_->undistort_keypoints(keypts_, frm_obs.undist_keypts_);
+    camera_->undistort_keypoints(keypts, frm_obs.undist_keypts_);
 
     // Calculate disparity from depth
-    // Initialize with invalid value
-    frm_obs.stereo_x_right_ = std::vector<float>(frm_obs.num_keypts_, -1);
-    frm_obs.depths_ = std::vector<float>(frm_obs.num_keypts_, -1);
+    compute_depths_from_depthmap(depthmap, keypts, frm_obs);
 
-    for (unsigned int idx = 0; idx < frm_obs.num_keypts_; idx++) {
-        const auto& keypt = keypts_.at(idx);
-        const auto& undist_keypt = frm_obs.undist_keypts_.at(idx);
+    // Convert to bearing vector
+    camera_->convert_keypoints_to_bearings(frm_obs.undist_keypts_, frm_obs.bearings_);
 
-        const float x = keypt.pt.x;
-        const float y = keypt.pt.y;
+    // Assign all the keypoints into grid
+    data::assign_keypoints_to_grid(camera_, frm_obs.undist_keypts_, frm_obs.keypt_indices_in_cells_);
 
-        const float depth = img_depth.at<float>(y, x);
+    data::frame frm(frm_id, timestamp, camera_, orb_params_, std::move(frm_obs));
+    // Detect marker
+    detect_markers(img_gray, frm);
+    return frm;
+}
 
-        if (depth <= 0) {
-            continue;
-        }
+bool system::create_frame_by_optical_flow(const cv::Mat& img, const cv::Mat& depthmap, const double timestamp, data::frame& frm) {
+    if (!optical_flow_tracker_ || !optical_flow_tracker_->is_available()) {
+        return false;
+    }
+    STELLA_VSLAM_LATENCY_SPAN("system::create_frame_by_optical_flow");
 
-        frm_obs.depths_.at(idx) = depth;
-        frm_obs.stereo_x_right_.at(idx) = undist_keypt.pt.x - camera_->focal_x_baseline_ / depth;
+    cv::Mat img_gray = img;
+    util::convert_to_grayscale(img_gray, camera_->color_order_);
+
+    data::frame_observation frm_obs;
+    std::vector<std::shared_ptr<data::landmark>> lms;
+
+    // Follow the keypoints of the last frame
+    if (!optical_flow_tracker_->track(img_gray, keypts_, frm_obs.descriptors_, lms)) {
+        return false;
+    }
+    frm_obs.num_keypts_ = keypts_.size();
+    frm_obs.is_tracked_by_optical_flow_ = true;
+
+    // Undistort keypoints
+    camera_->undistort_keypoints(keypts_, frm_obs.undist_keypts_);
+
+    // Calculate disparity from depth
+    if (!depthmap.empty()) {
+        compute_depths_from_depthmap(depthmap, keypts_, frm_obs);
     }
 
     // Convert to bearing vector
@@ -421,65 +1235,726 @@ data::frame system::create_RGBD_frame(const cv::Mat& rgb_img, const cv::Mat& dep
     // Assign all the keypoints into grid
     data::assign_keypoints_to_grid(camera_, frm_obs.undist_keypts_, frm_obs.keypt_indices_in_cells_);
 
+    frm = data::frame(timestamp, camera_, orb_params_, std::move(frm_obs), std::unordered_map<unsigned int, data::marker2d>());
     // Detect marker
-    std::unordered_map<unsigned int, data::marker2d> markers_2d;
-    if (marker_detector_) {
-        marker_detector_->detect(img_gray, markers_2d);
+    detect_markers(img_gray, frm);
+    // carry over the 2D-3D associations
+    frm.set_landmarks(lms);
+    return true;
+}
+
+void system::detect_markers(const cv::Mat& img_gray, data::frame& frm) const {
+    if (async_marker_detector_) {
+        // the result is waited for only when the frame becomes a keyframe
+        frm.pending_markers_2d_ = async_marker_detector_->request(img_gray);
+    }
+    else if (marker_detector_) {
+        marker_detector_->detect(img_gray, frm.markers_2d_);
     }
+}
+
+void system::compute_depths_from_depthmap(const cv::Mat& depthmap, const std::vector<cv::KeyPoint>& keypts, data::frame_observation& frm_obs) const {
+    // Initialize with invalid value
+    frm_obs.stereo_x_right_ = std::vector<float>(frm_obs.num_keypts_, -1);
+    frm_obs.depths_ = std::vector<float>(frm_obs.num_keypts_, -1);
+
+    for (unsigned int idx = 0; idx < frm_obs.num_keypts_; idx++) {
+        const auto& keypt = keypts.at(idx);
+        const auto& undist_keypt = frm_obs.undist_keypts_.at(idx);
+
+        const float depth = util::sample_true_depth(depthmap, keypt.pt.x, keypt.pt.y, depthmap_factor_, depth_consistency_ratio_);
+
+        if (depth <= 0) {
+            continue;
+        }
 
-    return data::frame(timestamp, camera_, orb_params_, frm_obs, std::move(markers_2d));
+        frm_obs.depths_.at(idx) = depth;
+        frm_obs.stereo_x_right_.at(idx) = undist_keypt.pt.x - camera_->focal_x_baseline_ / depth;
+    }
 }
 
-std::shared_ptr<Mat44_t> system::feed_monocular_frame(const cv::Mat& img, const double timestamp, const cv::Mat& mask) {
+std::shared_ptr<Mat44_t> system::feed_monocular_frame(const cv::Mat& img, const double timestamp, const cv::Mat& mask, const std::vector<data::imu_measurement>& imu_measurements) {
     assert(camera_->setup_type_ == camera::setup_type_t::Monocular);
+    queue_imu_measurements(imu_measurements);
     if (img.empty()) {
         spdlog::warn("preprocess: empty image");
+        metrics_publisher_->increment("frames_dropped_total");
         return nullptr;
     }
+    if (const auto replay_recorder = get_replay_recorder()) {
+        replay_recorder->queue_inputs(timestamp, {img}, mask);
+    }
     return feed_frame(create_monocular_frame(img, timestamp, mask), img);
 }
 
-std::shared_ptr<Mat44_t> system::feed_stereo_frame(const cv::Mat& left_img, const cv::Mat& right_img, const double timestamp, const cv::Mat& mask) {
+std::shared_ptr<Mat44_t> system::feed_rig_frame(const std::vector<cv::Mat>& imgs, const double timestamp, const cv::Mat& mask, const std::vector<data::imu_measurement>& imu_measurements) {
+    queue_imu_measurements(imu_measurements);
+    if (!rig_) {
+        throw std::runtime_error("the multi-camera rig is not configured (Rig)");
+    }
+    if (imgs.size() != rig_->get_num_cameras() + 1) {
+        spdlog::warn("preprocess: {} images are fed for the rig of {} cameras", imgs.size(), rig_->get_num_cameras() + 1);
+        metrics_publisher_->increment("frames_dropped_total");
+        return nullptr;
+    }
+    for (const auto& img : imgs) {
+        if (img.empty()) {
+            spdlog::warn("preprocess: empty image");
+            metrics_publisher_->increment("frames_dropped_total");
+            return nullptr;
+        }
+    }
+    if (const auto replay_recorder = get_replay_recorder()) {
+        replay_recorder->queue_inputs(timestamp, imgs, mask);
+    }
+    return feed_frame(create_rig_frame(imgs, timestamp, mask), imgs.at(0));
+}
+
+std::shared_ptr<Mat44_t> system::feed_stereo_frame(const cv::Mat& left_img, const cv::Mat& right_img, const double timestamp, const cv::Mat& mask, const std::vector<data::imu_measurement>& imu_measurements) {
     assert(camera_->setup_type_ == camera::setup_type_t::Stereo);
+    queue_imu_measurements(imu_measurements);
     if (left_img.empty() || right_img.empty()) {
         spdlog::warn("preprocess: empty image");
+        metrics_publisher_->increment("frames_dropped_total");
         return nullptr;
     }
+    if (const auto replay_recorder = get_replay_recorder()) {
+        replay_recorder->queue_inputs(timestamp, {left_img, right_img}, mask);
+    }
     return feed_frame(create_stereo_frame(left_img, right_img, timestamp, mask), left_img);
 }
 
-std::shared_ptr<Mat44_t> system::feed_RGBD_frame(const cv::Mat& rgb_img, const cv::Mat& depthmap, const double timestamp, const cv::Mat& mask) {
+std::shared_ptr<Mat44_t> system::feed_RGBD_frame(const cv::Mat& rgb_img, const cv::Mat& depthmap, const double timestamp, const cv::Mat& mask, const std::vector<data::imu_measurement>& imu_measurements) {
     assert(camera_->setup_type_ == camera::setup_type_t::RGBD);
+    queue_imu_measurements(imu_measurements);
     if (rgb_img.empty() || depthmap.empty()) {
         spdlog::warn("preprocess: empty image");
+        metrics_publisher_->increment("frames_dropped_total");
         return nullptr;
     }
+    if (const auto replay_recorder = get_replay_recorder()) {
+        replay_recorder->queue_inputs(timestamp, {rgb_img, depthmap}, mask);
+    }
     return feed_frame(create_RGBD_frame(rgb_img, depthmap, timestamp, mask), rgb_img);
 }
 
-std::shared_ptr<Mat44_t> system::feed_frame(const data::frame& frm, const cv::Mat& img) {
-    check_reset_request();
+std::shared_ptr<Mat44_t> system::feed_monocular_frame(const util::image_buffer& img, const double timestamp, const cv::Mat& mask, const std::vector<data::imu_measurement>& imu_measurements) {
+    const util::scoped_image_buffer_release release(img);
+    return feed_monocular_frame(util::get_grayscale_view(img, input_gray_bufs_.at(0)), timestamp, mask, imu_measurements);
+}
+
+std::shared_ptr<Mat44_t> system::feed_stereo_frame(const util::image_buffer& left_img, const util::image_buffer& right_img, const double timestamp, const cv::Mat& mask, const std::vector<data::imu_measurement>& imu_measurements) {
+    const util::scoped_image_buffer_release release_left(left_img);
+    const util::scoped_image_buffer_release release_right(right_img);
+    return feed_stereo_frame(util::get_grayscale_view(left_img, input_gray_bufs_.at(0)), util::get_grayscale_view(right_img, input_gray_bufs_.at(1)),
+                             timestamp, mask, imu_measurements);
+}
+
+std::shared_ptr<Mat44_t> system::feed_RGBD_frame(const util::image_buffer& rgb_img, const cv::Mat& depthmap, const double timestamp, const cv::Mat& mask, const std::vector<data::imu_measurement>& imu_measurements) {
+    const util::scoped_image_buffer_release release(rgb_img);
+    return feed_RGBD_frame(util::get_grayscale_view(rgb_img, input_gray_bufs_.at(0)), depthmap, timestamp, mask, imu_measurements);
+}
+
+void system::extract_features(const cv::Mat& img, const cv::Mat& mask, std::vector<cv::KeyPoint>& keypts, cv::Mat& descriptors,
+                              feature::orb_extraction_settings& extraction_settings) {
+    STELLA_VSLAM_LATENCY_SPAN("orb_extractor::extract");
+    if (!camera_->is_valid_shape(img)) {
+        spdlog::warn("preprocess: Input image size is invalid");
+    }
+    cv::Mat img_gray = img;
+    util::convert_to_grayscale(img_gray, camera_->color_order_);
+    keypts.clear();
+    extractor_left_->extract(img_gray, mask, keypts, descriptors);
+    extraction_settings = extractor_left_->get_extraction_settings();
+}
+
+std::string system::get_feature_fingerprint() const {
+    // the sections are compared as a whole, so the cache is rebuilt if any of the parameters changes
+    std::string fingerprint;
+    for (const auto& section : {"Camera", "Feature", "Preprocessing"}) {
+        fingerprint += std::string(section) + ":\n" + YAML::Dump(util::yaml_optional_ref(cfg_->yaml_node_, section)) + "\n";
+    }
+    return fingerprint;
+}
+
+std::shared_ptr<Mat44_t> system::feed_precomputed_frame(const std::vector<cv::KeyPoint>& keypts, const cv::Mat& descriptors,
+                                                        const feature::orb_extraction_settings& extraction_settings, const double timestamp,
+                                                        const cv::Mat& img, const cv::Mat& depthmap,
+                                                        const std::vector<data::imu_measurement>& imu_measurements) {
+    if (camera_->setup_type_ != camera::setup_type_t::Monocular && camera_->setup_type_ != camera::setup_type_t::RGBD) {
+        throw std::runtime_error("the precomputed features are supported for the monocular and RGBD cameras only");
+    }
+    if (optical_flow_tracker_) {
+        throw std::runtime_error("the precomputed features cannot be used with the optical flow tracking (OpticalFlow)");
+    }
+    if (keypts.size() != static_cast<size_t>(descriptors.rows)) {
+        throw std::runtime_error("the numbers of the precomputed keypoints and descriptors differ");
+    }
+    queue_imu_measurements(imu_measurements);
+    if (camera_->setup_type_ == camera::setup_type_t::RGBD && depthmap.empty()) {
+        spdlog::warn("preprocess: empty depthmap");
+        metrics_publisher_->increment("frames_dropped_total");
+        return nullptr;
+    }
+    STELLA_VSLAM_LATENCY_SPAN("system::create_precomputed_frame");
+
+    data::frame_observation frm_obs;
+    frm_obs.descriptors_ = descriptors;
+    frm_obs.num_keypts_ = keypts.size();
+    frm_obs.extraction_settings_ = extraction_settings;
+    if (keypts.empty()) {
+        spdlog::warn("preprocess: cannot extract any keypoints");
+    }
+
+    // the same steps as create_monocular_frame() and create_RGBD_frame() after the extraction
+    camera_->undistort_keypoints(keypts, frm_obs.undist_keypts_);
+    if (camera_->setup_type_ == camera::setup_type_t::RGBD) {
+        compute_depths_from_depthmap(depthmap, keypts, frm_obs);
+    }
+    camera_->convert_keypoints_to_bearings(frm_obs.undist_keypts_, frm_obs.bearings_);
+    data::assign_keypoints_to_grid(camera_, frm_obs.undist_keypts_, frm_obs.keypt_indices_in_cells_);
+
+    data::frame frm(timestamp, camera_, orb_params_, std::move(frm_obs), std::unordered_map<unsigned int, data::marker2d>());
+    if (!img.empty()) {
+        cv::Mat img_gray = img;
+        util::convert_to_grayscale(img_gray, camera_->color_order_);
+        detect_markers(img_gray, frm);
+    }
+    return feed_frame(std::move(frm), img, keypts);
+}
+
+void system::queue_imu_measurements(const std::vector<data::imu_measurement>& imu_measurements) {
+    if (!imu_measurements.empty()) {
+        tracker_->queue_imu_measurements(imu_measurements);
+    }
+}
+
+std::shared_ptr<Mat44_t> system::feed_frame(data::frame frm, const cv::Mat& img) {
+    return feed_frame(std::move(frm), img, keypts_);
+}
+
+std::shared_ptr<Mat44_t> system::feed_frame(data::frame frm, const cv::Mat& img, const std::vector<cv::KeyPoint>& keypts, const bool reset_is_checked) {
+    apply_tracking_thread_scheduling();
+    // the tasks of the tracking (and of the offline mapping) are accounted to this instance
+    const util::thread_pool::client_scope pool_client_scope(thread_pool_client_id_);
+
+    // the other calls of the modules wait until the keyframes of the frame are processed in the offline mapping mode
+    std::unique_lock<std::mutex> lock_offline_mapping = lock_offline_mapping_if_enabled();
+
+    if (reset_is_checked) {
+        check_reset_request();
+    }
+
+    // the scheduling of the mapping module is recorded before the tracking
+    std::shared_ptr<io::replay_recorder> replay_recorder;
+    unsigned int num_mapped_keyfrms = 0;
+    {
+        std::lock_guard<std::mutex> lock(mtx_replay_recorder_);
+        replay_recorder = replay_recorder_;
+        num_mapped_keyfrms = mapper_->get_num_processed_keyframes() - num_processed_keyfrms_at_recording_;
+    }
 
     const auto start = std::chrono::system_clock::now();
 
-    const auto cam_pose_wc = tracker_->feed_frame(frm);
+    const auto last_tracking_state = tracker_->tracking_state_;
+    const auto frm_id = frm.id_;
+    const auto frm_timestamp = frm.timestamp_;
+    const auto begin_allocs = util::allocation_counter::get_thread_stats();
+    std::shared_ptr<Mat44_t> cam_pose_wc;
+    {
+        // the scratch buffers of the tracking are released at once after the frame
+        util::frame_arena_scope arena_scope;
+        util::thread_cpu_time_scope cpu_time_scope(module_cpu_time_ns_.at(static_cast<unsigned int>(module_thread_t::Tracking)));
+        cam_pose_wc = tracker_->feed_frame(std::move(frm));
+    }
+    const auto end_allocs = util::allocation_counter::get_thread_stats();
+    if (offline_mapping_) {
+        // map the keyframes inserted with the frame and correct the loops before the next frame
+        mapper_->process_queued_keyframes();
+        global_optimizer_->process_queued_keyframes();
+        lock_offline_mapping.unlock();
+    }
+
+    if (optical_flow_tracker_) {
+        // the tracked frame becomes the reference of the optical flow for the next frame
+        cv::Mat img_gray = img;
+        util::convert_to_grayscale(img_gray, camera_->color_order_);
+        optical_flow_tracker_->update_reference(img_gray, keypts, tracker_->curr_frm_,
+                                                tracker_->tracking_state_ == tracker_state_t::Tracking,
+                                                tracker_->keyframe_insertion_is_deferred());
+    }
 
     const auto end = std::chrono::system_clock::now();
     double elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
 
+    metrics_publisher_->increment("frames_total");
+    if (tracker_->local_map_search_is_skipped()) {
+        metrics_publisher_->increment("local_map_searches_skipped_total");
+    }
+    metrics_publisher_->observe("tracking_latency_ms", std::chrono::duration<double, std::milli>(end - start).count());
+    if (util::allocation_counter::is_enabled()) {
+        metrics_publisher_->observe("tracking_allocations", static_cast<double>(end_allocs.num_allocs_ - begin_allocs.num_allocs_));
+    }
+    if (replay_recorder) {
+        replay_recorder->record_tracking(num_mapped_keyfrms, std::chrono::duration<double, std::milli>(end - start).count());
+    }
+    if (tracker_->tracking_state_ != last_tracking_state) {
+        metrics_publisher_->increment("tracking_state_transitions_total",
+                                      "from=\"" + tracker_state_to_string(last_tracking_state) + "\",to=\"" + tracker_state_to_string(tracker_->tracking_state_) + "\"");
+    }
+
+#ifdef USE_LATENCY_PROFILER
+    // the spans of the extraction (on this thread or handed over from the worker) and the tracking
+    auto spans = util::latency_profiler::take_thread_spans();
+    for (const auto& span : spans) {
+        metrics_publisher_->observe("stage_latency_ms", span.duration_us_ / 1000.0, std::string("stage=\"") + span.name_ + "\"");
+        if (util::allocation_counter::is_enabled()) {
+            metrics_publisher_->observe("stage_allocations", static_cast<double>(span.num_allocs_), std::string("stage=\"") + span.name_ + "\"");
+        }
+    }
+    latency_profiler_->commit_frame(frm_id, frm_timestamp, std::move(spans));
+#endif
+
     frame_publisher_->update(tracker_->curr_frm_.get_landmarks(),
                              !mapper_->is_paused(),
                              tracker_->tracking_state_,
-                             keypts_,
+                             keypts,
                              img,
                              elapsed_ms);
+    map_publisher_->update_landmarks_snapshot();
     if (tracker_->tracking_state_ == tracker_state_t::Tracking && cam_pose_wc) {
-        map_publisher_->set_current_cam_pose(util::converter::inverse_pose(*cam_pose_wc));
+        // the pollers can extrapolate the pose between the frames with the motion model of the tracker
+        Mat44_t twist;
+        double twist_dt = 0.0;
+        if (!tracker_->get_motion_model(twist, twist_dt)) {
+            twist_dt = 0.0;
+        }
+        const double latency = std::chrono::duration<double>(std::chrono::system_clock::now() - start).count();
+        map_publisher_->set_current_cam_pose(util::converter::inverse_pose(*cam_pose_wc), frm_timestamp, tracker_->tracking_state_,
+                                             twist, twist_dt, latency);
+        if (map_tile_streamer_) {
+            map_tile_streamer_->update(cam_pose_wc->block<3, 1>(0, 3));
+        }
+    }
+    else {
+        // the pollers of the pose can tell that the pose is not updated
+        map_publisher_->set_current_tracking_state(frm_timestamp, tracker_->tracking_state_);
     }
+    metrics_publisher_->notify_if_due();
 
     return cam_pose_wc;
 }
 
+bool system::pipelined_extraction_is_enabled() const {
+    return !extraction_workers_.empty();
+}
+
+std::shared_future<std::shared_ptr<Mat44_t>> system::feed_monocular_frame_async(const cv::Mat& img, const double timestamp, const cv::Mat& mask, const std::vector<data::imu_measurement>& imu_measurements) {
+    assert(camera_->setup_type_ == camera::setup_type_t::Monocular);
+    queue_imu_measurements(imu_measurements);
+    auto job = std::make_shared<pipeline_job>();
+    job->timestamp_ = timestamp;
+    if (img.empty()) {
+        spdlog::warn("preprocess: empty image");
+        metrics_publisher_->increment("frames_dropped_total");
+        job->promise_cam_pose_wc_.set_value(nullptr);
+        return job->future_cam_pose_wc_;
+    }
+    if (const auto replay_recorder = get_replay_recorder()) {
+        replay_recorder->queue_inputs(timestamp, {img}, mask);
+    }
+    job->img_ = img.clone();
+    const cv::Mat img_copy = job->img_;
+    const cv::Mat mask_copy = mask.clone();
+    job->create_frame_ = [this, img_copy, timestamp, mask_copy](feature::orb_extractor* extractor_left, feature::orb_extractor*, std::vector<cv::KeyPoint>& keypts, const unsigned int frm_id) {
+        return create_monocular_frame(img_copy, timestamp, mask_copy, extractor_left, keypts, frm_id);
+    };
+    return push_pipeline_job(job);
+}
+
+std::shared_future<std::shared_ptr<Mat44_t>> system::feed_stereo_frame_async(const cv::Mat& left_img, const cv::Mat& right_img, const double timestamp, const cv::Mat& mask, const std::vector<data::imu_measurement>& imu_measurements) {
+    assert(camera_->setup_type_ == camera::setup_type_t::Stereo);
+    queue_imu_measurements(imu_measurements);
+    auto job = std::make_shared<pipeline_job>();
+    job->timestamp_ = timestamp;
+    if (left_img.empty() || right_img.empty()) {
+        spdlog::warn("preprocess: empty image");
+        metrics_publisher_->increment("frames_dropped_total");
+        job->promise_cam_pose_wc_.set_value(nullptr);
+        return job->future_cam_pose_wc_;
+    }
+    if (const auto replay_recorder = get_replay_recorder()) {
+        replay_recorder->queue_inputs(timestamp, {left_img, right_img}, mask);
+    }
+    job->img_ = left_img.clone();
+    const cv::Mat left_img_copy = job->img_;
+    const cv::Mat right_img_copy = right_img.clone();
+    const cv::Mat mask_copy = mask.clone();
+    job->create_frame_ = [this, left_img_copy, right_img_copy, timestamp, mask_copy](feature::orb_extractor* extractor_left, feature::orb_extractor* extractor_right, std::vector<cv::KeyPoint>& keypts, const unsigned int frm_id) {
+        return create_stereo_frame(left_img_copy, right_img_copy, timestamp, mask_copy, extractor_left, extractor_right, keypts, frm_id);
+    };
+    return push_pipeline_job(job);
+}
+
+std::shared_future<std::shared_ptr<Mat44_t>> system::feed_RGBD_frame_async(const cv::Mat& rgb_img, const cv::Mat& depthmap, const double timestamp, const cv::Mat& mask, const std::vector<data::imu_measurement>& imu_measurements) {
+    assert(camera_->setup_type_ == camera::setup_type_t::RGBD);
+    queue_imu_measurements(imu_measurements);
+    auto job = std::make_shared<pipeline_job>();
+    job->timestamp_ = timestamp;
+    if (rgb_img.empty() || depthmap.empty()) {
+        spdlog::warn("preprocess: empty image");
+        metrics_publisher_->increment("frames_dropped_total");
+        job->promise_cam_pose_wc_.set_value(nullptr);
+        return job->future_cam_pose_wc_;
+    }
+    if (const auto replay_recorder = get_replay_recorder()) {
+        replay_recorder->queue_inputs(timestamp, {rgb_img, depthmap}, mask);
+    }
+    job->img_ = rgb_img.clone();
+    const cv::Mat rgb_img_copy = job->img_;
+    const cv::Mat depthmap_copy = depthmap.clone();
+    const cv::Mat mask_copy = mask.clone();
+    job->create_frame_ = [this, rgb_img_copy, depthmap_copy, timestamp, mask_copy](feature::orb_extractor* extractor_left, feature::orb_extractor*, std::vector<cv::KeyPoint>& keypts, const unsigned int frm_id) {
+        return create_RGBD_frame(rgb_img_copy, depthmap_copy, timestamp, mask_copy, extractor_left, keypts, frm_id);
+    };
+    return push_pipeline_job(job);
+}
+
+void system::set_latency_callback(const std::function<void(const util::frame_latency&)>& callback) {
+    latency_profiler_->set_callback(callback);
+}
+
+std::vector<util::frame_latency> system::get_latency_records() const {
+    return latency_profiler_->get_records();
+}
+
+void system::save_latency_trace(const std::string& path) const {
+    spdlog::debug("save_latency_trace: {}", path);
+    latency_profiler_->save_chrome_trace(path);
+}
+
+std::vector<util::keyframe_lifecycle> system::get_keyframe_lifecycle_records() const {
+    return keyfrm_tracer_->get_records();
+}
+
+void system::save_keyframe_lifecycle_trace(const std::string& path) const {
+    spdlog::debug("save_keyframe_lifecycle_trace: {}", path);
+    keyfrm_tracer_->save_chrome_trace(path);
+}
+
+data::memory_usage system::get_memory_usage() const {
+    auto usage = map_db_->get_memory_usage();
+    usage.bow_database_ = bow_db_->get_memory_bytes();
+    usage.optimizer_scratch_ = mapper_->get_local_BA_scratch_memory_bytes();
+    return usage;
+}
+
+void system::start_recording(const std::string& dir_path) {
+    auto replay_recorder = std::make_shared<io::replay_recorder>(dir_path, camera_->get_setup_type_string());
+    std::lock_guard<std::mutex> lock(mtx_replay_recorder_);
+    replay_recorder_ = replay_recorder;
+    num_processed_keyfrms_at_recording_ = mapper_->get_num_processed_keyframes();
+}
+
+void system::stop_recording() {
+    std::lock_guard<std::mutex> lock(mtx_replay_recorder_);
+    replay_recorder_ = nullptr;
+}
+
+std::shared_ptr<io::replay_recorder> system::get_replay_recorder() const {
+    std::lock_guard<std::mutex> lock(mtx_replay_recorder_);
+    return replay_recorder_;
+}
+
+void system::replay(const std::string& dir_path, const std::function<void(const io::replay_frame&, const double)>& callback) {
+    io::replay_log log(dir_path);
+    if (log.get_setup_type() != camera_->get_setup_type_string()) {
+        throw std::runtime_error("the replay log is recorded with the " + log.get_setup_type() + " setup");
+    }
+
+    const auto num_processed_keyfrms_at_start = mapper_->get_num_processed_keyframes();
+    unsigned int num_diverged_frms = 0;
+    std::vector<cv::Mat> imgs;
+    cv::Mat mask;
+    for (const auto& frm : log.get_frames()) {
+        if (terminate_is_requested()) {
+            break;
+        }
+        log.load_inputs(frm, imgs, mask);
+
+        // process the keyframes which had been mapped before the frame in the recorded run, and hold the others
+        // (the offline mapping mode processes the keyframes after each frame by itself)
+        const auto num_processed_keyfrms = num_processed_keyfrms_at_start + frm.num_mapped_keyfrms_;
+        if (offline_mapping_) {
+            if (mapper_->get_num_processed_keyframes() != num_processed_keyfrms) {
+                ++num_diverged_frms;
+            }
+        }
+        else {
+            mapper_->limit_processed_keyframes(num_processed_keyfrms);
+            if (!mapper_->wait_for_processed_keyframes(num_processed_keyfrms)) {
+                // fewer keyframes are inserted than the recorded run
+                ++num_diverged_frms;
+            }
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        switch (camera_->setup_type_) {
+            case camera::setup_type_t::Monocular:
+                if (rig_) {
+                    feed_rig_frame(imgs, frm.timestamp_, mask);
+                }
+                else {
+                    feed_monocular_frame(imgs.at(0), frm.timestamp_, mask);
+                }
+                break;
+            case camera::setup_type_t::Stereo:
+                feed_stereo_frame(imgs.at(0), imgs.at(1), frm.timestamp_, mask);
+                break;
+            case camera::setup_type_t::RGBD:
+                feed_RGBD_frame(imgs.at(0), imgs.at(1), frm.timestamp_, mask);
+                break;
+        }
+        const auto end = std::chrono::steady_clock::now();
+
+        if (callback) {
+            callback(frm, std::chrono::duration<double, std::milli>(end - start).count());
+        }
+    }
+    if (!offline_mapping_) {
+        mapper_->unlimit_processed_keyframes();
+    }
+
+    if (0 < num_diverged_frms) {
+        spdlog::warn("replay: the scheduling diverged from the log at {} frames", num_diverged_frms);
+    }
+}
+
+void system::wait_for_pipelined_frames() {
+    if (qos_tracking_thread_) {
+        std::unique_lock<std::mutex> lock(mtx_mailbox_);
+        cond_mailbox_.wait(lock, [this] { return mailbox_.empty() && !qos_job_is_running_; });
+        return;
+    }
+    std::unique_lock<std::mutex> lock(mtx_pipeline_);
+    cond_pipeline_.wait(lock, [this] { return jobs_to_track_.empty(); });
+}
+
+std::shared_future<std::shared_ptr<Mat44_t>> system::push_pipeline_job(const std::shared_ptr<pipeline_job>& job) {
+    if (qos_tracking_thread_) {
+        return push_qos_job(job);
+    }
+    if (!pipelined_extraction_is_enabled() || !pipelined_tracking_thread_) {
+        // run synchronously on the caller's thread
+        auto frm = job->create_frame_(extractor_left_, extractor_right_, keypts_, data::frame::next_id_++);
+        job->promise_cam_pose_wc_.set_value(feed_frame(std::move(frm), job->img_, keypts_));
+        return job->future_cam_pose_wc_;
+    }
+
+    if (reset_is_requested()) {
+        // the IDs of the queued frames were reserved before the reset, so they are tracked before the frame ID is rewound
+        wait_for_pipelined_frames();
+        check_reset_request();
+        data::frame::next_id_ = 0;
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(mtx_pipeline_);
+        // block while the pipeline is full
+        cond_pipeline_.wait(lock, [this] { return jobs_to_track_.size() < max_num_pipelined_frames_; });
+        job->frm_id_ = data::frame::next_id_++;
+        jobs_to_extract_.push_back(job);
+        jobs_to_track_.push_back(job);
+    }
+    cond_pipeline_.notify_all();
+    return job->future_cam_pose_wc_;
+}
+
+void system::run_extraction_worker(extraction_worker* worker) {
+    while (true) {
+        std::shared_ptr<pipeline_job> job;
+        {
+            std::unique_lock<std::mutex> lock(mtx_pipeline_);
+            cond_pipeline_.wait(lock, [this] { return !jobs_to_extract_.empty() || pipeline_is_terminated_; });
+            if (jobs_to_extract_.empty()) {
+                return;
+            }
+            job = jobs_to_extract_.front();
+            jobs_to_extract_.pop_front();
+        }
+
+        try {
+            auto frm = job->create_frame_(worker->extractor_left_.get(), worker->extractor_right_.get(), job->keypts_, job->frm_id_);
+            if (precompute_bow_) {
+                // compute the BoW representation before the tracker needs it
+                // (it is reused by the relocalization, the BoW match based tracking and the keyframe insertion)
+                STELLA_VSLAM_LATENCY_SPAN("frame::compute_bow");
+                frm.compute_bow(bow_vocab_);
+            }
+#ifdef USE_LATENCY_PROFILER
+            // hand over the spans before the frame becomes visible to the tracking thread
+            job->extraction_spans_ = util::latency_profiler::take_thread_spans();
+#endif
+            job->promise_frm_.set_value(std::move(frm));
+        }
+        catch (...) {
+            job->promise_frm_.set_exception(std::current_exception());
+        }
+    }
+}
+
+bool system::frame_qos_is_enabled() const {
+    return static_cast<bool>(frame_qos_);
+}
+
+util::frame_degradation_level_t system::get_frame_degradation_level() const {
+    return static_cast<util::frame_degradation_level_t>(frame_degradation_level_.load());
+}
+
+std::shared_future<std::shared_ptr<Mat44_t>> system::push_qos_job(const std::shared_ptr<pipeline_job>& job) {
+    job->is_keyframe_candidate_ = keyframe_is_wanted_;
+    job->fed_at_ = std::chrono::steady_clock::now();
+    std::shared_ptr<pipeline_job> dropped_job = nullptr;
+    {
+        std::unique_lock<std::mutex> lock(mtx_mailbox_);
+        if (frame_skip_policy_ == util::frame_skip_policy_t::Block) {
+            cond_mailbox_.wait(lock, [this] { return mailbox_.size() < mailbox_size_; });
+        }
+        else if (mailbox_size_ <= mailbox_.size()) {
+            std::deque<bool> is_keyframe_candidate;
+            for (const auto& waiting_job : mailbox_) {
+                is_keyframe_candidate.push_back(waiting_job->is_keyframe_candidate_);
+            }
+            const auto idx = util::select_frame_to_drop(is_keyframe_candidate, frame_skip_policy_);
+            dropped_job = mailbox_.at(idx);
+            mailbox_.erase(mailbox_.begin() + idx);
+        }
+        mailbox_.push_back(job);
+    }
+    cond_mailbox_.notify_all();
+
+    if (dropped_job) {
+        metrics_publisher_->increment("qos_frames_dropped_total", dropped_job->is_keyframe_candidate_
+                                                                      ? "reason=\"mailbox\",keyframe_candidate=\"true\""
+                                                                      : "reason=\"mailbox\",keyframe_candidate=\"false\"");
+        if (const auto replay_recorder = get_replay_recorder()) {
+            replay_recorder->discard_inputs(dropped_job->timestamp_);
+        }
+        dropped_job->promise_cam_pose_wc_.set_value(nullptr);
+    }
+    return job->future_cam_pose_wc_;
+}
+
+void system::run_qos_tracking() {
+    while (true) {
+        std::shared_ptr<pipeline_job> job;
+        {
+            std::unique_lock<std::mutex> lock(mtx_mailbox_);
+            cond_mailbox_.wait(lock, [this] { return !mailbox_.empty() || mailbox_is_terminated_; });
+            if (mailbox_.empty()) {
+                return;
+            }
+            job = mailbox_.front();
+            mailbox_.pop_front();
+            qos_job_is_running_ = true;
+        }
+        cond_mailbox_.notify_all();
+
+        if (frame_qos_->should_drop(job->is_keyframe_candidate_)) {
+            metrics_publisher_->increment("qos_frames_dropped_total", "reason=\"degradation\",keyframe_candidate=\"false\"");
+            if (const auto replay_recorder = get_replay_recorder()) {
+                replay_recorder->discard_inputs(job->timestamp_);
+            }
+            job->promise_cam_pose_wc_.set_value(nullptr);
+        }
+        else {
+            const auto start = std::chrono::steady_clock::now();
+            try {
+                auto frm = job->create_frame_(extractor_left_, extractor_right_, keypts_, data::frame::next_id_++);
+                job->promise_cam_pose_wc_.set_value(feed_frame(std::move(frm), job->img_, keypts_));
+            }
+            catch (...) {
+                job->promise_cam_pose_wc_.set_exception(std::current_exception());
+            }
+            const auto end = std::chrono::steady_clock::now();
+
+            // the next frames are kept preferentially while the tracker needs a new keyframe
+            keyframe_is_wanted_ = tracker_->keyframe_is_needed() || tracker_->keyframe_insertion_is_deferred();
+            metrics_publisher_->observe("qos_frame_lag_ms", std::chrono::duration<double, std::milli>(end - job->fed_at_).count());
+            if (frame_qos_->update(std::chrono::duration<double, std::milli>(end - start).count())) {
+                apply_frame_degradation(frame_qos_->get_level());
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mtx_mailbox_);
+            qos_job_is_running_ = false;
+        }
+        cond_mailbox_.notify_all();
+    }
+}
+
+void system::apply_frame_degradation(const util::frame_degradation_level_t level) {
+    spdlog::info("frame QoS: degradation level {} (average processing time {:.1f} ms, frame period {:.1f} ms)",
+                 static_cast<unsigned int>(level), frame_qos_->get_average_ms(), frame_qos_->get_frame_period_ms());
+    frame_degradation_level_ = static_cast<unsigned int>(level);
+
+    // skip the local map refresh on the confidently tracked frames
+    if (static_cast<unsigned int>(level) >= static_cast<unsigned int>(util::frame_degradation_level_t::SkipLocalMapRefresh)) {
+        tracker_->enable_adaptive_local_map_tracking_ = true;
+    }
+    else {
+        tracker_->enable_adaptive_local_map_tracking_ = adaptive_local_map_tracking_is_configured_;
+    }
+
+    // the time budget of the ORB extraction lowers the number of the keypoints
+    double budget_ms = extraction_time_budget_ms_;
+    if (static_cast<unsigned int>(level) >= static_cast<unsigned int>(util::frame_degradation_level_t::ReduceKeypoints)) {
+        const double qos_budget_ms = qos_extraction_budget_ratio_ * frame_qos_->get_frame_period_ms();
+        budget_ms = (0.0 < budget_ms) ? std::min(budget_ms, qos_budget_ms) : qos_budget_ms;
+    }
+    extractor_left_->set_time_budget(budget_ms, num_extraction_timing_records_);
+    if (extractor_right_) {
+        extractor_right_->set_time_budget(budget_ms, num_extraction_timing_records_);
+    }
+    for (auto& extractor : rig_extractors_) {
+        extractor->set_time_budget(budget_ms, num_extraction_timing_records_);
+    }
+}
+
+void system::run_pipelined_tracking() {
+    while (true) {
+        std::shared_ptr<pipeline_job> job;
+        {
+            std::unique_lock<std::mutex> lock(mtx_pipeline_);
+            cond_pipeline_.wait(lock, [this] { return !jobs_to_track_.empty() || pipeline_is_terminated_; });
+            if (jobs_to_track_.empty()) {
+                return;
+            }
+            job = jobs_to_track_.front();
+        }
+
+        // wait for the extraction of the oldest frame, so that the frames are tracked in the feeding order
+        try {
+            auto frm = job->future_frm_.get();
+#ifdef USE_LATENCY_PROFILER
+            util::latency_profiler::append_thread_spans(job->extraction_spans_);
+#endif
+            // the reset is executed by push_pipeline_job() while the pipeline is empty
+            job->promise_cam_pose_wc_.set_value(feed_frame(std::move(frm), job->img_, job->keypts_, false));
+        }
+        catch (...) {
+            job->promise_cam_pose_wc_.set_exception(std::current_exception());
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mtx_pipeline_);
+            jobs_to_track_.pop_front();
+        }
+        cond_pipeline_.notify_all();
+    }
+}
+
 bool system::relocalize_by_pose(const Mat44_t& cam_pose_wc) {
     const Mat44_t cam_pose_cw = util::converter::inverse_pose(cam_pose_wc);
     bool status = tracker_->request_relocalize_by_pose(cam_pose_cw);
@@ -542,12 +2017,29 @@ camera::base* system::get_camera() const {
 void system::check_reset_request() {
     std::lock_guard<std::mutex> lock(mtx_reset_);
     if (reset_is_requested_) {
+        // the background population must not add the keyframes of the cleared map
+        wait_for_bow_database();
         tracker_->reset();
+        if (optical_flow_tracker_) {
+            optical_flow_tracker_->reset();
+        }
+        if (map_tile_streamer_) {
+            map_tile_streamer_->clear();
+        }
         reset_is_requested_ = false;
     }
 }
 
+std::unique_lock<std::mutex> system::lock_offline_mapping_if_enabled() const {
+    if (!offline_mapping_) {
+        return std::unique_lock<std::mutex>();
+    }
+    return std::unique_lock<std::mutex>(mtx_offline_mapping_);
+}
+
 void system::pause_other_threads() const {
+    // wait until the keyframes of the current frame are processed in the offline mapping mode
+    std::unique_lock<std::mutex> lock_offline_mapping = lock_offline_mapping_if_enabled();
     // pause the mapping module
     if (mapper_ && !mapper_->is_terminated()) {
         auto future_pause = mapper_->async_pause();
@@ -569,6 +2061,7 @@ void system::pause_other_threads() const {
 }
 
 void system::resume_other_threads() const {
+    std::unique_lock<std::mutex> lock_offline_mapping = lock_offline_mapping_if_enabled();
     // resume the global optimization module
     if (global_optimizer_) {
         global_optimizer_->resume();
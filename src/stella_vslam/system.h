@@ -3,13 +3,24 @@
 
 #include "stella_vslam/type.h"
 #include "stella_vslam/data/bow_vocabulary_fwd.h"
+#include "stella_vslam/data/imu_measurement.h"
+#include "stella_vslam/data/memory_usage.h"
+#include "stella_vslam/util/frame_qos.h"
+#include "stella_vslam/util/thread_scheduling.h"
 
+#include <array>
+#include <chrono>
 #include <string>
 #include <thread>
 #include <memory>
 #include <mutex>
 #include <atomic>
 #include <memory>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <vector>
 
 #include <opencv2/core/mat.hpp>
 
@@ -19,13 +30,16 @@ class config;
 class tracking_module;
 class mapping_module;
 class global_optimization_module;
+class localizer;
 
 namespace camera {
 class base;
+class rig;
 } // namespace camera
 
 namespace data {
 class frame;
+struct frame_observation;
 class camera_database;
 class orb_params_database;
 class map_database;
@@ -35,26 +49,74 @@ class bow_database;
 namespace feature {
 class orb_extractor;
 struct orb_params;
+struct orb_extraction_settings;
 } // namespace feature
 
+namespace module {
+class optical_flow_tracker;
+class remote_map_integrator;
+struct remote_segment;
+struct remote_correction;
+} // namespace module
+
 namespace marker_detector {
 class base;
+class async_detector;
 } // namespace marker_detector
 
 namespace publish {
 class map_publisher;
 class frame_publisher;
+class metrics_publisher;
 } // namespace publish
 
 namespace io {
 class map_database_io_base;
+class map_tile_streamer;
+class trajectory_writer;
+class replay_recorder;
+struct replay_frame;
 }
 
+namespace util {
+class latency_profiler;
+class keyframe_tracer;
+class thread_pool;
+class async_reclaimer;
+struct frame_latency;
+struct keyframe_lifecycle;
+struct image_buffer;
+} // namespace util
+
+//! threads of the modules whose scheduling is configurable
+enum class module_thread_t {
+    //! the thread which feeds the frames (or the pipelined tracking thread)
+    Tracking = 0,
+    //! the thread of the mapping module
+    Mapping = 1,
+    //! the thread of the global optimization module
+    GlobalOptimization = 2,
+    //! the thread of the loop BA launched by the global optimization module
+    LoopBA = 3
+};
+
 class system {
 public:
     //! Constructor
     system(const std::shared_ptr<config>& cfg, const std::string& vocab_file_path);
 
+    /**
+     * Constructor with the resources shared among the system instances in a process
+     * (NOTE: the vocabulary is only read, as the threads of the modules of an instance already do concurrently.
+     *  The parallel tasks of the instances are taken in turn within each priority from the shared thread pool
+     *  (see util::thread_pool::add_client()), and ThreadPool of the config is ignored.)
+     * @param cfg
+     * @param bow_vocab vocabulary loaded by data::bow_vocabulary_util::load_shared()
+     * @param thread_pool thread pool shared among the instances (the modules use ThreadPool of the config if nullptr)
+     */
+    system(const std::shared_ptr<config>& cfg, const std::shared_ptr<data::bow_vocabulary>& bow_vocab,
+           const std::shared_ptr<util::thread_pool>& thread_pool = nullptr);
+
     //! Destructor
     ~system();
 
@@ -67,6 +129,12 @@ public:
     //! Startup the SLAM system
     void startup(const bool need_initialize = true);
 
+    //! Set the scheduling (CPU affinity, SCHED_FIFO or nice, NUMA node) of the thread of the module
+    //! (the default values are loaded from the "ThreadScheduling" section.
+    //!  The mapping and the global optimization threads are scheduled at startup(), the tracking thread at the next frame,
+    //!  and the loop BA thread at the next loop BA)
+    void set_thread_scheduling(const module_thread_t thread, const util::thread_scheduling_params& params);
+
     //! Shutdown the SLAM system
     void shutdown();
 
@@ -82,15 +150,60 @@ public:
     //! Load the map database from file
     void load_map_database(const std::string& path) const;
 
-    //! Save the map database to file
+    //! Save the map database to file (throw std::runtime_error if System.read_only_map is set)
     void save_map_database(const std::string& path) const;
 
+    /**
+     * Save the map database to file in the background without pausing the other threads
+     * A snapshot of the map is taken while locking the map database shortly, then it is written by the selected map format.
+     * The requested saves are written in order.
+     * (NOTE: throw std::runtime_error if System.read_only_map is set)
+     * @param path
+     * @return future which becomes ready when the file is written (get() rethrows the error of the writing)
+     */
+    std::shared_future<void> save_map_database_async(const std::string& path) const;
+
+    /**
+     * Merge the maps loaded by load_map_database() via the inter-map loops,
+     * then perform the global BA over each merged map (see module::map_merger)
+     * @return the number of the merges
+     */
+    unsigned int merge_maps();
+
+    /**
+     * Create the localizer which answers the concurrent localization queries against the map of this system
+     * (NOTE: the map must not be modified while the localizer is used, e.g. keep the mapping module disabled)
+     * @param num_threads number of the worker threads of the localizer
+     */
+    std::unique_ptr<localizer> create_localizer(const unsigned int num_threads) const;
+
+    /**
+     * Integrate the keyframes and the landmarks streamed from a robot into the map (see module::remote_map_integrator)
+     * (NOTE: used by the map server, which does not feed the frames)
+     * @return the number of the new keyframes
+     */
+    unsigned int integrate_remote_segment(const module::remote_segment& segment);
+
+    /**
+     * Compute the corrections of the maps of the robots, which are pushed back to them
+     * (NOTE: call this after the map is merged or optimized, e.g. by merge_maps())
+     */
+    eigen_alloc_vector<module::remote_correction> compute_remote_corrections();
+
     //! Get the map publisher
     const std::shared_ptr<publish::map_publisher> get_map_publisher() const;
 
     //! Get the frame publisher
     const std::shared_ptr<publish::frame_publisher> get_frame_publisher() const;
 
+    //! Get the metrics publisher (the counters, the latencies and the map sizes in the Prometheus text format)
+    const std::shared_ptr<publish::metrics_publisher> get_metrics_publisher() const;
+
+    //! Get the CPU time consumed by the thread of the module since the construction [s]
+    //! (the tracking is accounted after each frame, and the other threads when they exit, i.e. completely after shutdown().
+    //!  The pools and the OpenMP threads which run the tasks of the modules are not included)
+    double get_module_cpu_time(const module_thread_t thread) const;
+
     //-----------------------------------------
     // module management
 
@@ -123,23 +236,147 @@ public:
 
     //-----------------------------------------
     // data feeding methods
+    // (NOTE: the IMU measurements are optional, and they are used to predict the rotation of the camera from the last frame.
+    //  Feed the measurements between the last frame and this one, sorted by the timestamps on the same clock as the frames.
+    //  The extrinsics and the gyroscope bias are set in the "IMU" section.)
 
-    std::shared_ptr<Mat44_t> feed_frame(const data::frame& frm, const cv::Mat& img);
+    std::shared_ptr<Mat44_t> feed_frame(data::frame frm, const cv::Mat& img);
 
     //! Feed a monocular frame to SLAM system
     //! (NOTE: distorted images are acceptable if calibrated)
     data::frame create_monocular_frame(const cv::Mat& img, const double timestamp, const cv::Mat& mask = cv::Mat{});
-    std::shared_ptr<Mat44_t> feed_monocular_frame(const cv::Mat& img, const double timestamp, const cv::Mat& mask = cv::Mat{});
+    std::shared_ptr<Mat44_t> feed_monocular_frame(const cv::Mat& img, const double timestamp, const cv::Mat& mask = cv::Mat{}, const std::vector<data::imu_measurement>& imu_measurements = {});
 
     //! Feed a stereo frame to SLAM system
     //! (Note: Left and Right images must be stereo-rectified)
     data::frame create_stereo_frame(const cv::Mat& left_img, const cv::Mat& right_img, const double timestamp, const cv::Mat& mask = cv::Mat{});
-    std::shared_ptr<Mat44_t> feed_stereo_frame(const cv::Mat& left_img, const cv::Mat& right_img, const double timestamp, const cv::Mat& mask = cv::Mat{});
+    std::shared_ptr<Mat44_t> feed_stereo_frame(const cv::Mat& left_img, const cv::Mat& right_img, const double timestamp, const cv::Mat& mask = cv::Mat{}, const std::vector<data::imu_measurement>& imu_measurements = {});
 
     //! Feed an RGBD frame to SLAM system
     //! (Note: RGB and Depth images must be aligned)
     data::frame create_RGBD_frame(const cv::Mat& rgb_img, const cv::Mat& depthmap, const double timestamp, const cv::Mat& mask);
-    std::shared_ptr<Mat44_t> feed_RGBD_frame(const cv::Mat& rgb_img, const cv::Mat& depthmap, const double timestamp, const cv::Mat& mask = cv::Mat{});
+    std::shared_ptr<Mat44_t> feed_RGBD_frame(const cv::Mat& rgb_img, const cv::Mat& depthmap, const double timestamp, const cv::Mat& mask = cv::Mat{}, const std::vector<data::imu_measurement>& imu_measurements = {});
+
+    //! Feed a frame of the multi-camera rig to SLAM system
+    //! (Note: imgs.at(0) is the image of the primary monocular camera, and imgs.at(i) is the one of the i-th camera in Rig.cameras.
+    //!  The features of the cameras are extracted in parallel, and the mask is applied to the primary camera only.)
+    data::frame create_rig_frame(const std::vector<cv::Mat>& imgs, const double timestamp, const cv::Mat& mask = cv::Mat{});
+    std::shared_ptr<Mat44_t> feed_rig_frame(const std::vector<cv::Mat>& imgs, const double timestamp, const cv::Mat& mask = cv::Mat{}, const std::vector<data::imu_measurement>& imu_measurements = {});
+
+    //! Feed a frame from the externally owned image buffers (see util::image_buffer)
+    //! (NOTE: the images are not copied before the feature extraction, and the Gray and NV12 buffers are used without conversion.
+    //!  The release callbacks are called before these methods return. The color order of the camera is not used.)
+    std::shared_ptr<Mat44_t> feed_monocular_frame(const util::image_buffer& img, const double timestamp, const cv::Mat& mask = cv::Mat{}, const std::vector<data::imu_measurement>& imu_measurements = {});
+    std::shared_ptr<Mat44_t> feed_stereo_frame(const util::image_buffer& left_img, const util::image_buffer& right_img, const double timestamp, const cv::Mat& mask = cv::Mat{}, const std::vector<data::imu_measurement>& imu_measurements = {});
+    std::shared_ptr<Mat44_t> feed_RGBD_frame(const util::image_buffer& rgb_img, const cv::Mat& depthmap, const double timestamp, const cv::Mat& mask = cv::Mat{}, const std::vector<data::imu_measurement>& imu_measurements = {});
+
+    //! Extract the ORB features of the monocular or RGBD image as create_monocular_frame() and create_RGBD_frame()
+    //! (e.g. to fill the feature cache, see feature::feature_cache)
+    void extract_features(const cv::Mat& img, const cv::Mat& mask, std::vector<cv::KeyPoint>& keypts, cv::Mat& descriptors,
+                          feature::orb_extraction_settings& extraction_settings);
+
+    //! Get the fingerprint of the parameters which affect the extracted features (the Camera, Feature and Preprocessing sections)
+    std::string get_feature_fingerprint() const;
+
+    //! Feed a monocular or RGBD frame with the features extracted beforehand by extract_features() (e.g. read from the feature cache)
+    //! (NOTE: the image is optional and used for the visualization and the marker detection only.
+    //!  The optical flow tracking is not supported because it requires the images.)
+    std::shared_ptr<Mat44_t> feed_precomputed_frame(const std::vector<cv::KeyPoint>& keypts, const cv::Mat& descriptors,
+                                                    const feature::orb_extraction_settings& extraction_settings, const double timestamp,
+                                                    const cv::Mat& img = cv::Mat{}, const cv::Mat& depthmap = cv::Mat{},
+                                                    const std::vector<data::imu_measurement>& imu_measurements = {});
+
+    //-----------------------------------------
+    // pipelined feature extraction
+    // (NOTE: enabled when System.num_extraction_workers > 0.
+    //  Feature extraction of the queued frames runs on the worker threads while the previous frame is tracked,
+    //  and the frames are handed off to the tracker in the order they were fed.
+    //  The images are copied, so the caller can reuse its buffers right after the call.
+    //  When System.precompute_bow is true, the BoW representation is also computed on the workers.
+    //  Do not mix these methods with the synchronous feed_*_frame methods.)
+
+    //! The pipelined feature extraction is enabled or not
+    bool pipelined_extraction_is_enabled() const;
+
+    //! Feed a monocular frame to the extraction pipeline
+    //! (NOTE: blocks while the pipeline is full, and runs synchronously if the pipeline is disabled)
+    std::shared_future<std::shared_ptr<Mat44_t>> feed_monocular_frame_async(const cv::Mat& img, const double timestamp, const cv::Mat& mask = cv::Mat{}, const std::vector<data::imu_measurement>& imu_measurements = {});
+
+    //! Feed a stereo frame to the extraction pipeline
+    std::shared_future<std::shared_ptr<Mat44_t>> feed_stereo_frame_async(const cv::Mat& left_img, const cv::Mat& right_img, const double timestamp, const cv::Mat& mask = cv::Mat{}, const std::vector<data::imu_measurement>& imu_measurements = {});
+
+    //! Feed an RGBD frame to the extraction pipeline
+    std::shared_future<std::shared_ptr<Mat44_t>> feed_RGBD_frame_async(const cv::Mat& rgb_img, const cv::Mat& depthmap, const double timestamp, const cv::Mat& mask = cv::Mat{}, const std::vector<data::imu_measurement>& imu_measurements = {});
+
+    //! Wait until all the frames in the extraction pipeline (or the mailbox of the frame QoS) are tracked
+    void wait_for_pipelined_frames();
+
+    //-----------------------------------------
+    // frame QoS
+    // (NOTE: enabled when QoS.enabled is true, and not supported with the pipelined feature extraction.
+    //  The frames fed with the feed_*_frame_async methods are put into a mailbox of QoS.mailbox_size frames,
+    //  and tracked on a dedicated thread. While the mailbox is full, a waiting frame is dropped by QoS.skip_policy
+    //  (block, drop_oldest or drop_non_keyframe_candidates), and the future of the dropped frame returns nullptr.
+    //  While the frames take longer than the frame period, the processing is degraded step by step (see util::frame_qos_controller).)
+
+    //! The frame QoS is enabled or not
+    bool frame_qos_is_enabled() const;
+
+    //! Get the current degradation level of the frame QoS
+    util::frame_degradation_level_t get_frame_degradation_level() const;
+
+    //-----------------------------------------
+    // latency profiling
+    // (NOTE: the spans are recorded only when built with USE_LATENCY_PROFILER.
+    //  The latest System.num_latency_records frames are kept.)
+
+    //! Set the callback which is called with the latency record of each tracked frame
+    //! (NOTE: called on the tracking thread, so it should return quickly)
+    void set_latency_callback(const std::function<void(const util::frame_latency&)>& callback);
+
+    //! Get the latency records of the latest frames (oldest first)
+    std::vector<util::frame_latency> get_latency_records() const;
+
+    //! Save the latency records in the Chrome trace event format
+    void save_latency_trace(const std::string& path) const;
+
+    //-----------------------------------------
+    // keyframe lifecycle tracing
+    // (NOTE: the times spent by the keyframes in the inserter, the queues, the mapping and the loop detection.
+    //  The latest System.num_keyframe_lifecycle_records keyframes are kept,
+    //  and the histograms are exposed through the metrics publisher)
+
+    //! Get the lifecycle records of the latest keyframes (ordered by the keyframe ID)
+    std::vector<util::keyframe_lifecycle> get_keyframe_lifecycle_records() const;
+
+    //! Save the lifecycle records of the keyframes in the Chrome trace event format
+    void save_keyframe_lifecycle_trace(const std::string& path) const;
+
+    //-----------------------------------------
+    // memory accounting
+
+    //! Get the estimated memory usage of the map and the runtime structures
+    //! (O(1) in the number of the keyframes, the keyframes and the landmarks maintain the counters incrementally)
+    data::memory_usage get_memory_usage() const;
+
+    //-----------------------------------------
+    // record and replay
+    // (NOTE: the frames fed with the feed_*_frame methods are recorded with the number of the keyframes
+    //  which the mapping module had processed before each frame was tracked.
+    //  When replayed, the mapping module processes the keyframes in between the frames as recorded,
+    //  so the replays are repeatable and follow the scheduling of the recorded run at the frame granularity.
+    //  Set use_fixed_seed of the RANSAC solvers and disable the loop detector, which is not scheduled, for the exact replays.
+    //  The recording is also started by System.record_dir.)
+
+    //! Start recording the fed frames into the directory (must exist)
+    void start_recording(const std::string& dir_path);
+
+    //! Stop recording
+    void stop_recording();
+
+    //! Replay the log in the directory (the callback is called after each frame with the recorded frame and the feeding time [ms])
+    //! (NOTE: blocks until all of the frames are fed, so call it on the thread which feeds the frames)
+    void replay(const std::string& dir_path, const std::function<void(const io::replay_frame&, const double)>& callback = nullptr);
 
     //-----------------------------------------
     // pose initializing/updating
@@ -186,8 +423,44 @@ public:
 
     //! depthmap factor (pixel_value / depthmap_factor = true_depth)
     double depthmap_factor_ = 1.0;
+    //! invalidate the depth of a keypoint if a neighboring depth differs more than this ratio (disabled if 0)
+    float depth_consistency_ratio_ = 0.0;
+    //! narrow the disparity search of the stereo matching with the landmarks predicted by the motion model,
+    //! within this relative margin of their depths (disabled if 0)
+    float stereo_depth_prior_margin_ = 0.0;
 
 private:
+    //! Constructor (the vocabulary is loaded from the file unless the shared one is given)
+    system(const std::shared_ptr<config>& cfg, const std::string& vocab_file_path,
+           const std::shared_ptr<data::bow_vocabulary>& shared_bow_vocab, const std::shared_ptr<util::thread_pool>& shared_thread_pool);
+
+    //! Create frames with the specified extractors, keypoint buffer and frame ID
+    data::frame create_monocular_frame(const cv::Mat& img, const double timestamp, const cv::Mat& mask,
+                                       feature::orb_extractor* extractor, std::vector<cv::KeyPoint>& keypts, const unsigned int frm_id);
+    data::frame create_stereo_frame(const cv::Mat& left_img, const cv::Mat& right_img, const double timestamp, const cv::Mat& mask,
+                                    feature::orb_extractor* extractor_left, feature::orb_extractor* extractor_right,
+                                    std::vector<cv::KeyPoint>& keypts, const unsigned int frm_id);
+    data::frame create_RGBD_frame(const cv::Mat& rgb_img, const cv::Mat& depthmap, const double timestamp, const cv::Mat& mask,
+                                  feature::orb_extractor* extractor, std::vector<cv::KeyPoint>& keypts, const unsigned int frm_id);
+
+    //! Create a frame by following the keypoints of the last frame with the optical flow instead of ORB extraction
+    //! (return false if the optical flow tracking is not available for the current image)
+    bool create_frame_by_optical_flow(const cv::Mat& img, const cv::Mat& depthmap, const double timestamp, data::frame& frm);
+
+    //! Detect the markers of the frame, or request the asynchronous detection
+    void detect_markers(const cv::Mat& img_gray, data::frame& frm) const;
+
+    //! Compute the depths and the right x coordinates of the keypoints from the raw depthmap
+    //! (the depths are sampled at the keypoints, and the whole depthmap is not converted)
+    void compute_depths_from_depthmap(const cv::Mat& depthmap, const std::vector<cv::KeyPoint>& keypts, data::frame_observation& frm_obs) const;
+
+    //! Feed a frame with the keypoints used for visualization
+    //! (the pipelined tracking thread leaves the reset request to push_pipeline_job())
+    std::shared_ptr<Mat44_t> feed_frame(data::frame frm, const cv::Mat& img, const std::vector<cv::KeyPoint>& keypts, const bool reset_is_checked = true);
+
+    //! Queue the IMU measurements to the tracking module
+    void queue_imu_measurements(const std::vector<data::imu_measurement>& imu_measurements);
+
     //! Check reset request of the system
     void check_reset_request();
 
@@ -197,10 +470,15 @@ private:
     //! Resume the mapping module and the global optimization module
     void resume_other_threads() const;
 
+    //! Lock mtx_offline_mapping_ if the offline mapping mode is enabled (otherwise, return the lock without the mutex)
+    std::unique_lock<std::mutex> lock_offline_mapping_if_enabled() const;
+
     //! config
     const std::shared_ptr<config> cfg_;
     //! camera model
     camera::base* camera_ = nullptr;
+    //! auxiliary cameras of the multi-camera rig (nullptr if the Rig section is not specified)
+    std::unique_ptr<camera::rig> rig_;
 
     //! camera database
     data::camera_database* cam_db_ = nullptr;
@@ -216,6 +494,8 @@ private:
 
     //! BoW vocabulary
     data::bow_vocabulary* bow_vocab_ = nullptr;
+    //! owner of the vocabulary shared with the other instances (nullptr if bow_vocab_ is owned by this instance)
+    std::shared_ptr<data::bow_vocabulary> shared_bow_vocab_;
 
     //! BoW database
     data::bow_database* bow_db_ = nullptr;
@@ -233,6 +513,33 @@ private:
     //! global optimization thread
     std::unique_ptr<std::thread> global_optimization_thread_ = nullptr;
 
+    //! thread pool shared among the modules (ThreadPool.num_threads; nullptr if the modules use their own worker threads)
+    std::shared_ptr<util::thread_pool> thread_pool_;
+    //! client of this instance in the thread pool (see util::thread_pool::add_client())
+    unsigned int thread_pool_client_id_ = 0;
+
+    //! thread which destroys the cleared map on reset (System.background_reclamation; nullptr if destroyed in the tracking thread)
+    std::shared_ptr<util::async_reclaimer> reclaimer_;
+
+    //! Apply the scheduling of the tracking thread if the frames are fed from another thread
+    void apply_tracking_thread_scheduling();
+
+    //! mutex to access the scheduling of the threads
+    std::mutex mtx_thread_scheduling_;
+    //! scheduling of the threads of the modules (indexed by module_thread_t)
+    std::array<util::thread_scheduling_params, 4> thread_scheduling_params_;
+    //! the thread to which the scheduling of the tracking thread is applied
+    std::thread::id scheduled_tracking_thread_id_;
+
+    //! CPU time consumed by the threads of the modules [ns] (indexed by module_thread_t, except the loop BA)
+    std::array<std::atomic<int64_t>, 3> module_cpu_time_ns_{};
+
+    //! the mapping and the global optimization run on the tracking thread after each frame instead of their own threads (System.offline_mapping)
+    //! (for the batch map building: the output does not depend on the timing of the threads)
+    bool offline_mapping_ = false;
+    //! mutex to serialize the calls of the modules in the offline mapping mode
+    mutable std::mutex mtx_offline_mapping_;
+
     // ORB extractors
     //! ORB extractor for left/monocular image
     feature::orb_extractor* extractor_left_ = nullptr;
@@ -240,17 +547,84 @@ private:
     feature::orb_extractor* extractor_right_ = nullptr;
     //! ORB extractor only when used in initializing
     feature::orb_extractor* ini_extractor_left_ = nullptr;
+    //! ORB extractors for the auxiliary cameras of the rig (one per camera)
+    std::vector<std::unique_ptr<feature::orb_extractor>> rig_extractors_;
 
     //! marker detector
     marker_detector::base* marker_detector_ = nullptr;
+    //! worker of the marker detection off the tracking thread (nullptr if disabled)
+    std::unique_ptr<marker_detector::async_detector> async_marker_detector_;
+
+    //! optical flow tracker which skips ORB extraction between frames (nullptr if disabled)
+    std::unique_ptr<module::optical_flow_tracker> optical_flow_tracker_;
+
+    //! integrator of the keyframes streamed from the robots (created on the first segment)
+    std::mutex mtx_remote_map_;
+    std::unique_ptr<module::remote_map_integrator> remote_map_integrator_;
 
     //! frame publisher
     std::shared_ptr<publish::frame_publisher> frame_publisher_ = nullptr;
     //! map publisher
     std::shared_ptr<publish::map_publisher> map_publisher_ = nullptr;
+    //! metrics publisher
+    std::shared_ptr<publish::metrics_publisher> metrics_publisher_ = nullptr;
+
+    //! streamer of the map tiles around the camera (nullptr if disabled)
+    std::shared_ptr<io::map_tile_streamer> map_tile_streamer_ = nullptr;
+
+    //! writer which streams the frame trajectory (nullptr if disabled)
+    std::shared_ptr<io::trajectory_writer> trajectory_writer_ = nullptr;
+
+    //! the map is read-only (localization only) or not
+    bool read_only_map_ = false;
 
     //! map I/O
     std::shared_ptr<io::map_database_io_base> map_database_io_ = nullptr;
+    //! mutex for map_database_io_ (NOTE: the map can be saved in the background)
+    mutable std::mutex mtx_map_database_io_;
+    //! mutex for map_saving_
+    mutable std::mutex mtx_map_saving_;
+    //! the last background map saving
+    mutable std::shared_future<void> map_saving_;
+
+    //-----------------------------------------
+    // parallel startup
+
+    //! Add the keyframes of the map database to the BoW database in the background
+    void populate_bow_database() const;
+
+    //! Wait until the vocabulary is loaded
+    void wait_for_vocabulary() const;
+
+    //! Wait until the keyframes of the loaded map are added to the BoW database
+    void wait_for_bow_database() const;
+
+    //! load the vocabulary and populate the BoW database in the background or not
+    bool parallel_startup_ = false;
+    //! time when the construction began
+    const std::chrono::steady_clock::time_point construction_tp_ = std::chrono::steady_clock::now();
+    //! loading of the vocabulary (invalid if it is loaded in the constructor)
+    std::shared_future<void> vocab_loading_;
+    //! mutex for bow_db_population_
+    mutable std::mutex mtx_startup_tasks_;
+    //! the last background population of the BoW database
+    mutable std::shared_future<void> bow_db_population_;
+
+    //! latency records of the tracked frames
+    std::unique_ptr<util::latency_profiler> latency_profiler_;
+
+    //! lifecycle records of the keyframes
+    std::shared_ptr<util::keyframe_tracer> keyfrm_tracer_;
+
+    //! Get the recorder of the fed frames (nullptr if not recording)
+    std::shared_ptr<io::replay_recorder> get_replay_recorder() const;
+
+    //! mutex for replay_recorder_
+    mutable std::mutex mtx_replay_recorder_;
+    //! recorder of the fed frames (nullptr if not recording)
+    std::shared_ptr<io::replay_recorder> replay_recorder_ = nullptr;
+    //! number of the keyframes processed by the mapping module when the recording is started
+    unsigned int num_processed_keyfrms_at_recording_ = 0;
 
     //! system running status flag
     std::atomic<bool> system_is_running_{false};
@@ -273,6 +647,90 @@ private:
 
     //! Temporary variables for visualization
     std::vector<cv::KeyPoint> keypts_;
+
+    //! Grayscale images converted from the fed image buffers (reused across the frames)
+    std::array<cv::Mat, 2> input_gray_bufs_;
+
+    //-----------------------------------------
+    // pipelined feature extraction
+
+    //! ORB extractors owned by an extraction worker
+    struct extraction_worker;
+    //! A frame which is waiting for extraction or tracking
+    struct pipeline_job;
+
+    //! Push a job to the pipeline (or run it immediately if the pipeline is disabled)
+    std::shared_future<std::shared_ptr<Mat44_t>> push_pipeline_job(const std::shared_ptr<pipeline_job>& job);
+
+    //! Main loop of an extraction worker
+    void run_extraction_worker(extraction_worker* worker);
+
+    //! Main loop of the thread which hands off the extracted frames to the tracker in order
+    void run_pipelined_tracking();
+
+    //! extraction workers (empty if the pipeline is disabled)
+    std::vector<std::unique_ptr<extraction_worker>> extraction_workers_;
+    //! extraction worker threads
+    std::vector<std::thread> extraction_threads_;
+    //! pipelined tracking thread
+    std::unique_ptr<std::thread> pipelined_tracking_thread_ = nullptr;
+    //! maximum number of the frames in the pipeline
+    unsigned int max_num_pipelined_frames_ = 0;
+    //! compute the BoW representation of each frame on the extraction workers or not
+    bool precompute_bow_ = false;
+
+    //! mutex for the pipeline queues
+    std::mutex mtx_pipeline_;
+    //! condition variable notified when the pipeline queues are updated
+    std::condition_variable cond_pipeline_;
+    //! jobs waiting for extraction
+    std::deque<std::shared_ptr<pipeline_job>> jobs_to_extract_;
+    //! jobs waiting for tracking (in the feeding order)
+    std::deque<std::shared_ptr<pipeline_job>> jobs_to_track_;
+    //! the pipeline threads should stop after draining the queues
+    bool pipeline_is_terminated_ = false;
+
+    //-----------------------------------------
+    // frame QoS
+
+    //! Put a job into the mailbox (and drop a waiting one by the policy if it is full)
+    std::shared_future<std::shared_ptr<Mat44_t>> push_qos_job(const std::shared_ptr<pipeline_job>& job);
+
+    //! Main loop of the thread which tracks the frames in the mailbox
+    void run_qos_tracking();
+
+    //! Apply the degradation level to the tracker and the extractors
+    void apply_frame_degradation(const util::frame_degradation_level_t level);
+
+    //! controller of the degradation level (nullptr if the frame QoS is disabled, accessed from the QoS thread only)
+    std::unique_ptr<util::frame_qos_controller> frame_qos_ = nullptr;
+    //! policy to drop the frames when the mailbox is full
+    util::frame_skip_policy_t frame_skip_policy_ = util::frame_skip_policy_t::DropOldest;
+    //! capacity of the mailbox
+    unsigned int mailbox_size_ = 1;
+    //! ratio of the frame period used as the time budget of the ORB extraction when the keypoints are reduced
+    double qos_extraction_budget_ratio_ = 0.5;
+    //! time budget of the ORB extraction in the configuration (restored when the degradation is lifted)
+    double extraction_time_budget_ms_ = 0.0;
+    unsigned int num_extraction_timing_records_ = 5;
+    //! adaptive local map tracking in the configuration (restored when the degradation is lifted)
+    bool adaptive_local_map_tracking_is_configured_ = false;
+    //! thread which tracks the frames in the mailbox
+    std::unique_ptr<std::thread> qos_tracking_thread_ = nullptr;
+    //! mutex for the mailbox
+    std::mutex mtx_mailbox_;
+    //! condition variable notified when the mailbox is updated
+    std::condition_variable cond_mailbox_;
+    //! frames waiting for tracking (oldest first)
+    std::deque<std::shared_ptr<pipeline_job>> mailbox_;
+    //! a frame taken from the mailbox is being tracked or not
+    bool qos_job_is_running_ = false;
+    //! the QoS thread should stop after draining the mailbox
+    bool mailbox_is_terminated_ = false;
+    //! the tracker needed a new keyframe for the last frame
+    std::atomic<bool> keyframe_is_wanted_{false};
+    //! current degradation level
+    std::atomic<unsigned int> frame_degradation_level_{0};
 };
 
 } // namespace stella_vslam
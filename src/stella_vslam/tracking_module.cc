@@ -7,12 +7,19 @@
 #include "stella_vslam/data/landmark.h"
 #include "stella_vslam/data/map_database.h"
 #include "stella_vslam/data/bow_database.h"
+#include "stella_vslam/feature/orb_params.h"
 #include "stella_vslam/match/projection.h"
 #include "stella_vslam/module/local_map_updater.h"
+#include "stella_vslam/util/converter.h"
+#include "stella_vslam/util/frame_arena.h"
+#include "stella_vslam/util/latency_profiler.h"
 #include "stella_vslam/util/yaml.h"
 
+#include <algorithm>
+#include <array>
 #include <chrono>
 #include <unordered_map>
+#include <unordered_set>
 
 #include <spdlog/spdlog.h>
 
@@ -26,16 +33,31 @@ tracking_module::tracking_module(const std::shared_ptr<config>& cfg, camera::bas
       enable_auto_relocalization_(util::yaml_optional_ref(cfg->yaml_node_, "Tracking")["enable_auto_relocalization"].as<bool>(true)),
       use_robust_matcher_for_relocalization_request_(util::yaml_optional_ref(cfg->yaml_node_, "Tracking")["use_robust_matcher_for_relocalization_request"].as<bool>(false)),
       max_num_local_keyfrms_(util::yaml_optional_ref(cfg->yaml_node_, "Tracking")["max_num_local_keyfrms"].as<unsigned int>(60)),
+      enable_async_local_map_update_(util::yaml_optional_ref(cfg->yaml_node_, "Tracking")["enable_async_local_map_update"].as<bool>(false)),
+      enable_async_relocalization_(util::yaml_optional_ref(cfg->yaml_node_, "Tracking")["enable_async_relocalization"].as<bool>(false)),
+      new_map_after_lost_sec_(util::yaml_optional_ref(cfg->yaml_node_, "Tracking")["new_map_after_lost_sec"].as<double>(0.0)),
+      imu_margin_scale_(util::yaml_optional_ref(cfg->yaml_node_, "IMU")["margin_scale"].as<float>(0.5)),
+      enable_adaptive_search_radius_(util::yaml_optional_ref(cfg->yaml_node_, "Tracking")["enable_adaptive_search_radius"].as<bool>(false)),
+      freeze_map_in_localization_(util::yaml_optional_ref(cfg->yaml_node_, "Tracking")["freeze_map_in_localization"].as<bool>(false)),
+      max_num_cached_local_maps_(util::yaml_optional_ref(cfg->yaml_node_, "Tracking")["max_num_cached_local_maps"].as<unsigned int>(256)),
+      enable_adaptive_local_map_tracking_(util::yaml_optional_ref(cfg->yaml_node_, "Tracking")["enable_adaptive_local_map_tracking"].as<bool>(false)),
+      local_map_refresh_interval_(util::yaml_optional_ref(cfg->yaml_node_, "Tracking")["local_map_refresh_interval"].as<unsigned int>(5)),
+      confident_min_num_inliers_(util::yaml_optional_ref(cfg->yaml_node_, "Tracking")["confident_min_num_inliers"].as<unsigned int>(150)),
+      confident_min_occupied_cell_ratio_(util::yaml_optional_ref(cfg->yaml_node_, "Tracking")["confident_min_occupied_cell_ratio"].as<double>(0.75)),
+      confident_max_reproj_error_(util::yaml_optional_ref(cfg->yaml_node_, "Tracking")["confident_max_reproj_error"].as<double>(1.5)),
       map_db_(map_db), bow_vocab_(bow_vocab), bow_db_(bow_db),
       initializer_(map_db, bow_db, util::yaml_optional_ref(cfg->yaml_node_, "Initializer")),
       frame_tracker_(camera_, 10, initializer_.get_use_fixed_seed()),
       relocalizer_(util::yaml_optional_ref(cfg->yaml_node_, "Relocalizer")),
-      pose_optimizer_(),
-      keyfrm_inserter_(util::yaml_optional_ref(cfg->yaml_node_, "KeyframeInserter")) {
+      pose_optimizer_(4, 10, util::yaml_optional_ref(cfg->yaml_node_, "Tracking")["use_dedicated_pose_solver"].as<bool>(false)),
+      keyfrm_inserter_(util::yaml_optional_ref(cfg->yaml_node_, "KeyframeInserter")),
+      imu_preintegrator_(util::yaml_optional_ref(cfg->yaml_node_, "IMU")) {
     spdlog::debug("CONSTRUCT: tracking_module");
 }
 
 tracking_module::~tracking_module() {
+    discard_prebuilt_local_map();
+    discard_async_relocalization();
     spdlog::debug("DESTRUCT: tracking_module");
 }
 
@@ -48,6 +70,14 @@ void tracking_module::set_global_optimization_module(global_optimization_module*
     global_optimizer_ = global_optimizer;
 }
 
+void tracking_module::set_thread_pool(const std::shared_ptr<util::thread_pool>& thread_pool) {
+    initializer_.set_thread_pool(thread_pool);
+}
+
+void tracking_module::set_keyframe_tracer(const std::shared_ptr<util::keyframe_tracer>& keyfrm_tracer) {
+    keyfrm_inserter_.set_keyframe_tracer(keyfrm_tracer);
+}
+
 bool tracking_module::request_relocalize_by_pose(const Mat44_t& pose_cw) {
     std::lock_guard<std::mutex> lock(mtx_relocalize_by_pose_request_);
     if (relocalize_by_pose_is_requested_) {
@@ -88,9 +118,26 @@ void tracking_module::finish_relocalize_by_pose_request() {
     relocalize_by_pose_is_requested_ = false;
 }
 
+void tracking_module::set_map_is_frozen(const bool map_is_frozen) {
+    std::lock_guard<std::mutex> lock(mtx_map_is_frozen_);
+    map_is_frozen_ = map_is_frozen;
+    cached_local_maps_.clear();
+}
+
+bool tracking_module::map_is_frozen() const {
+    std::lock_guard<std::mutex> lock(mtx_map_is_frozen_);
+    return map_is_frozen_;
+}
+
 void tracking_module::reset() {
     spdlog::info("resetting system");
 
+    discard_prebuilt_local_map();
+    discard_async_relocalization();
+    {
+        std::lock_guard<std::mutex> lock(mtx_map_is_frozen_);
+        cached_local_maps_.clear();
+    }
     initializer_.reset();
     keyfrm_inserter_.reset();
 
@@ -102,10 +149,13 @@ void tracking_module::reset() {
     bow_db_->clear();
     map_db_->clear();
 
-    data::frame::next_id_ = 0;
+    if (rewind_frame_id_on_reset_) {
+        data::frame::next_id_ = 0;
+    }
 
     last_reloc_frm_id_ = 0;
     last_reloc_frm_timestamp_ = 0.0;
+    motion_cov_ = Mat66_t::Zero();
 
     tracking_state_ = tracker_state_t::Initializing;
 }
@@ -113,11 +163,12 @@ void tracking_module::reset() {
 std::shared_ptr<Mat44_t> tracking_module::feed_frame(data::frame curr_frm) {
     // check if pause is requested
     pause_if_requested();
-    while (is_paused()) {
-        std::this_thread::sleep_for(std::chrono::microseconds(5000));
+    {
+        std::unique_lock<std::mutex> lock(mtx_pause_);
+        cond_pause_.wait(lock, [this] { return !is_paused_; });
     }
 
-    curr_frm_ = curr_frm;
+    curr_frm_ = std::move(curr_frm);
 
     bool succeeded = false;
     if (tracking_state_ == tracker_state_t::Initializing) {
@@ -133,7 +184,7 @@ std::shared_ptr<Mat44_t> tracking_module::feed_frame(data::frame curr_frm) {
     // make sure the mapper has processed any new keyframes before doing anything else
     std::unique_lock<std::mutex> mapping_lock(mapper_->mtx_processing_);
     mapper_->processing_cv_.wait(
-        mapping_lock, [this] { return mapper_->is_idle() && !mapper_->keyframe_is_queued(); });
+        mapping_lock, [this] { return mapper_->is_idle() && !mapper_->keyframe_is_ready(); });
     mapping_lock.unlock();
 #endif
 
@@ -143,16 +194,23 @@ std::shared_ptr<Mat44_t> tracking_module::feed_frame(data::frame curr_frm) {
     }
     else if (tracking_state_ == tracker_state_t::Tracking) {
         tracking_state_ = tracker_state_t::Lost;
+        lost_frm_timestamp_ = curr_frm_.timestamp_;
 
         spdlog::info("tracking lost: frame {}", curr_frm_.id_);
         // if tracking is failed within 5.0 sec after initialization, reset the system
+        // (unless the previous maps are kept, then a new map is started after new_map_after_lost_sec_ instead)
         constexpr float init_retry_thr = 5.0;
-        if (!mapper_->is_paused() && curr_frm_.timestamp_ - initializer_.get_initial_frame_timestamp() < init_retry_thr) {
+        const bool previous_maps_exist = 0.0 < new_map_after_lost_sec_ && 1 < map_db_->get_spanning_roots().size();
+        if (!mapper_->is_paused() && !previous_maps_exist && curr_frm_.timestamp_ - initializer_.get_initial_frame_timestamp() < init_retry_thr) {
             spdlog::info("tracking lost within {} sec after initialization", init_retry_thr);
             reset();
             return nullptr;
         }
     }
+    else if (tracking_state_ == tracker_state_t::Lost && 0.0 < new_map_after_lost_sec_ && !mapper_->is_paused()
+             && new_map_after_lost_sec_ <= curr_frm_.timestamp_ - lost_frm_timestamp_) {
+        start_new_map();
+    }
 
     std::shared_ptr<Mat44_t> cam_pose_wc = nullptr;
     // store the relative pose from the reference keyframe to the current frame
@@ -168,14 +226,32 @@ std::shared_ptr<Mat44_t> tracking_module::feed_frame(data::frame curr_frm) {
         std::lock_guard<std::mutex> lock(mtx_last_frm_);
         last_frm_ = curr_frm_;
     }
+    imu_preintegrator_.discard_measurements(last_frm_.timestamp_);
     SPDLOG_TRACE("tracking_module: finish tracking");
 
     return cam_pose_wc;
 }
 
+void tracking_module::queue_imu_measurements(const std::vector<data::imu_measurement>& imu_measurements) {
+    imu_preintegrator_.queue_measurements(imu_measurements);
+}
+
 bool tracking_module::track(bool relocalization_is_needed) {
-    // LOCK the map database
-    std::lock_guard<std::mutex> lock1(data::map_database::mtx_database_);
+    STELLA_VSLAM_LATENCY_SPAN("tracking_module::track");
+
+    // LOCK the map database unless it is frozen
+    // (the mapping and the global optimization modules are paused while the map is frozen, and they do not modify the map
+    //  except the loop BA launched before the map was frozen. The keyframes and the landmarks are guarded by their own locks anyway,
+    //  so the map database is locked until it finishes, or while the global optimization module is resumed by the others)
+    std::lock_guard<std::mutex> lock0(mtx_map_is_frozen_);
+    tracking_on_frozen_map_ = map_is_frozen_ && global_optimizer_->is_paused() && !global_optimizer_->loop_BA_is_running();
+    std::unique_lock<util::profiled_mutex> lock1(data::map_database::mtx_database_, std::defer_lock);
+    if (!tracking_on_frozen_map_) {
+        lock1.lock();
+        if (!cached_local_maps_.empty()) {
+            cached_local_maps_.clear();
+        }
+    }
     std::lock_guard<std::mutex> lock2(mtx_last_frm_);
     std::lock_guard<std::mutex> lock3(mtx_stop_keyframe_insertion_);
 
@@ -187,15 +263,24 @@ bool tracking_module::track(bool relocalization_is_needed) {
     // set the reference keyframe of the current frame
     curr_frm_.ref_keyfrm_ = last_frm_.ref_keyfrm_;
 
+    // (set by the tracking with the motion model)
+    pred_pose_is_valid_ = false;
+    tracked_by_motion_model_ = false;
+
     bool succeeded = false;
     if (relocalize_by_pose_is_requested()) {
         // Force relocalization by pose
+        // (the relocalizer is shared with the pending relocalization)
+        discard_async_relocalization();
         succeeded = relocalize_by_pose(get_relocalize_by_pose_request());
     }
     else if (!relocalization_is_needed) {
         SPDLOG_TRACE("tracking_module: track_current_frame (curr_frm_={})", curr_frm_.id_);
         succeeded = track_current_frame();
     }
+    else if (enable_auto_relocalization_ && enable_async_relocalization_) {
+        succeeded = relocalize_asynchronously();
+    }
     else if (enable_auto_relocalization_) {
         // Compute the BoW representations to perform relocalization
         SPDLOG_TRACE("tracking_module: Compute the BoW representations to perform relocalization (curr_frm_={})", curr_frm_.id_);
@@ -204,7 +289,8 @@ bool tracking_module::track(bool relocalization_is_needed) {
         }
         // try to relocalize
         SPDLOG_TRACE("tracking_module: try to relocalize (curr_frm_={})", curr_frm_.id_);
-        succeeded = relocalizer_.relocalize(bow_db_, curr_frm_);
+        STELLA_VSLAM_LATENCY_SPAN("relocalizer::relocalize");
+        succeeded = relocalizer_.relocalize(bow_db_, map_db_, curr_frm_);
         if (succeeded) {
             last_reloc_frm_id_ = curr_frm_.id_;
             last_reloc_frm_timestamp_ = curr_frm_.timestamp_;
@@ -215,12 +301,29 @@ bool tracking_module::track(bool relocalization_is_needed) {
     const unsigned int min_num_obs_thr = (3 <= map_db_->get_num_keyframes()) ? 3 : 2;
     unsigned int num_tracked_lms = 0;
     unsigned int num_reliable_lms = 0;
-    if (succeeded) {
+    // (in the adaptive mode, the local map search is skipped while the motion model tracks the frames confidently,
+    //  and the pose optimized by the motion based tracking is used as it is)
+    local_map_search_is_skipped_ = succeeded && enable_adaptive_local_map_tracking_ && tracked_by_motion_model_
+                                   && !local_map_refresh_is_needed_ && num_skipped_local_map_searches_ < local_map_refresh_interval_
+                                   && !local_landmarks_.empty() && is_confidently_tracked();
+    if (local_map_search_is_skipped_) {
+        SPDLOG_TRACE("tracking_module: skip the local map search (curr_frm_={})", curr_frm_.id_);
+        ++num_skipped_local_map_searches_;
+        clean_landmark_associations();
+        // (the landmarks observed in the skipped frames are not counted, because their observable counts are not increased)
+        count_tracked_landmarks(num_tracked_lms, num_reliable_lms, min_num_obs_thr, false);
+    }
+    else if (succeeded) {
+        num_skipped_local_map_searches_ = 0;
+        local_map_refresh_is_needed_ = false;
         SPDLOG_TRACE("tracking_module: update_local_map (curr_frm_={})", curr_frm_.id_);
         update_local_map();
         SPDLOG_TRACE("tracking_module: optimize_current_frame_with_local_map (curr_frm_={})", curr_frm_.id_);
         succeeded = optimize_current_frame_with_local_map(num_tracked_lms, num_reliable_lms, min_num_obs_thr);
     }
+    if (!succeeded) {
+        local_map_refresh_is_needed_ = true;
+    }
 
     // update the motion model
     if (succeeded) {
@@ -229,9 +332,27 @@ bool tracking_module::track(bool relocalization_is_needed) {
     }
 
     // check to insert the new keyframe derived from the current frame
-    if (succeeded && !is_stopped_keyframe_insertion_ && new_keyframe_is_needed(num_tracked_lms, num_reliable_lms, min_num_obs_thr)) {
-        SPDLOG_TRACE("tracking_module: insert_new_keyframe (curr_frm_={})", curr_frm_.id_);
-        insert_new_keyframe();
+    // (NOTE: the frames tracked by the optical flow have no new keypoints,
+    //        so the insertion is deferred to the next frame, on which ORB extraction is requested)
+    keyframe_insertion_is_deferred_ = false;
+    keyframe_is_needed_ = succeeded && !tracking_on_frozen_map_ && new_keyframe_is_needed(num_tracked_lms, num_reliable_lms, min_num_obs_thr);
+    if (keyframe_is_needed_ && !is_stopped_keyframe_insertion_) {
+        if (curr_frm_.frm_obs_->is_tracked_by_optical_flow_) {
+            keyframe_insertion_is_deferred_ = true;
+        }
+        else {
+            SPDLOG_TRACE("tracking_module: insert_new_keyframe (curr_frm_={})", curr_frm_.id_);
+            insert_new_keyframe();
+        }
+    }
+
+    // build the local map for the next frame while the current one is being finished
+    // (the cached local maps are used instead on the frozen map)
+    if (enable_async_local_map_update_) {
+        discard_prebuilt_local_map();
+        if (succeeded && !tracking_on_frozen_map_) {
+            prebuild_local_map();
+        }
     }
 
     // update the frame statistics
@@ -242,16 +363,25 @@ bool tracking_module::track(bool relocalization_is_needed) {
 }
 
 bool tracking_module::initialize() {
+    STELLA_VSLAM_LATENCY_SPAN("tracking_module::initialize");
+
     // LOCK the map database
-    std::lock_guard<std::mutex> lock1(data::map_database::mtx_database_);
+    std::lock_guard<util::profiled_mutex> lock1(data::map_database::mtx_database_);
     std::lock_guard<std::mutex> lock2(mtx_stop_keyframe_insertion_);
 
     // try to initialize with the current frame
     initializer_.initialize(camera_->setup_type_, bow_vocab_, curr_frm_);
 
     // if map building was failed -> reset the map database
+    // (only the failed map is discarded if the previous maps are kept)
     if (initializer_.get_state() == module::initializer_state_t::Wrong) {
-        reset();
+        if (0.0 < new_map_after_lost_sec_ && 1 < map_db_->get_spanning_roots().size()) {
+            discard_newest_map();
+            initializer_.reset();
+        }
+        else {
+            reset();
+        }
         return false;
     }
 
@@ -270,13 +400,75 @@ bool tracking_module::initialize() {
     return true;
 }
 
+void tracking_module::start_new_map() {
+    spdlog::info("start a new map: tracking has been lost for {} sec", curr_frm_.timestamp_ - lost_frm_timestamp_);
+
+    // the previous maps are kept in the map database, and merged with the new one when an inter-map loop is detected
+    // (see global_optimization_module::correct_loop)
+    discard_prebuilt_local_map();
+    discard_async_relocalization();
+    initializer_.reset();
+    keyfrm_inserter_.reset();
+
+    twist_is_valid_ = false;
+    motion_cov_ = Mat66_t::Zero();
+    last_reloc_frm_id_ = 0;
+    last_reloc_frm_timestamp_ = 0.0;
+    local_keyfrms_.clear();
+    local_landmarks_.clear();
+    local_map_snapshot_.clear();
+
+    tracking_state_ = tracker_state_t::Initializing;
+}
+
+void tracking_module::discard_newest_map() {
+    // the keyframes of the failed initialization have not been passed to the mapping module yet
+    auto roots = map_db_->get_spanning_roots();
+    const auto root = roots.back();
+    const auto keyfrms = root->graph_node_->get_keyframes_from_root();
+    std::unordered_set<unsigned int> lm_ids;
+    for (const auto& keyfrm : keyfrms) {
+        for (const auto& lm : keyfrm->get_landmarks()) {
+            if (lm) {
+                lm_ids.insert(lm->id_);
+            }
+        }
+    }
+    map_db_->erase_landmarks(std::vector<unsigned int>(lm_ids.begin(), lm_ids.end()));
+    for (const auto& keyfrm : keyfrms) {
+        map_db_->erase_keyframe(keyfrm);
+    }
+    map_db_->erase_spanning_root(root);
+    spdlog::info("discarded the new map of {} keyframes", keyfrms.size());
+}
+
 bool tracking_module::track_current_frame() {
+    STELLA_VSLAM_LATENCY_SPAN("tracking_module::track_current_frame");
+
     bool succeeded = false;
 
+    float margin_scale = 1.0;
+    const Mat44_t velocity = predict_velocity(margin_scale);
+    pred_pose_is_valid_ = twist_is_valid_;
+    if (pred_pose_is_valid_) {
+        pred_pose_cw_ = velocity * last_frm_.get_pose_cw();
+    }
+    const Mat66_t pred_pose_cov = (enable_adaptive_search_radius_ && twist_is_valid_) ? predict_pose_cov(velocity) : Mat66_t::Zero();
+
     // Tracking mode
-    if (twist_is_valid_ && last_reloc_frm_id_ + 2 < curr_frm_.id_) {
+    if (curr_frm_.frm_obs_->is_tracked_by_optical_flow_ && twist_is_valid_) {
+        // if the 2D-3D matches are carried over by the optical flow
+        succeeded = frame_tracker_.optical_flow_based_track(curr_frm_, last_frm_, velocity);
+        if (!succeeded) {
+            // the keypoints still have the descriptors of the last frame
+            curr_frm_.erase_landmarks();
+        }
+    }
+    if (!succeeded && twist_is_valid_ && last_reloc_frm_id_ + 2 < curr_frm_.id_) {
         // if the motion model is valid
-        succeeded = frame_tracker_.motion_based_track(curr_frm_, last_frm_, twist_);
+        succeeded = frame_tracker_.motion_based_track(curr_frm_, last_frm_, velocity, margin_scale,
+                                                      pred_pose_cov.isZero() ? nullptr : &pred_pose_cov);
+        tracked_by_motion_model_ = succeeded;
     }
     if (!succeeded) {
         // Compute the BoW representations to perform the BoW match
@@ -292,6 +484,49 @@ bool tracking_module::track_current_frame() {
     return succeeded;
 }
 
+bool tracking_module::relocalize_asynchronously() {
+    if (future_reloc_frm_.valid()) {
+        // skip the current frame while the relocalization is running
+        // (the next one is started on the latest frame after it finishes)
+        if (future_reloc_frm_.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            return false;
+        }
+
+        const auto reloc_frm = future_reloc_frm_.get();
+        if (reloc_frm) {
+            last_reloc_frm_id_ = reloc_frm->id_;
+            last_reloc_frm_timestamp_ = reloc_frm->timestamp_;
+
+            // catch up with the current frame by projecting the landmarks of the relocalized frame
+            // (the motion since the relocalized frame is unknown, so the search margin is widened)
+            SPDLOG_TRACE("tracking_module: catch up from the relocalized frame {} (curr_frm_={})", reloc_frm->id_, curr_frm_.id_);
+            constexpr float catch_up_margin_scale = 2.0;
+            if (frame_tracker_.motion_based_track(curr_frm_, *reloc_frm, Mat44_t::Identity(), catch_up_margin_scale)) {
+                curr_frm_.ref_keyfrm_ = reloc_frm->ref_keyfrm_;
+                return true;
+            }
+            curr_frm_.erase_landmarks();
+        }
+    }
+
+    // start relocalizing the current frame
+    // (the worker only accesses the keyframes and landmarks via their own locks, like the local map prebuilding)
+    if (!curr_frm_.bow_is_available()) {
+        curr_frm_.compute_bow(bow_vocab_);
+    }
+    auto reloc_frm = std::make_shared<data::frame>(curr_frm_);
+    future_reloc_frm_ = std::async(std::launch::async, [this, reloc_frm] {
+        return relocalizer_.relocalize(bow_db_, map_db_, *reloc_frm) ? reloc_frm : nullptr;
+    });
+    return false;
+}
+
+void tracking_module::discard_async_relocalization() {
+    if (future_reloc_frm_.valid()) {
+        future_reloc_frm_.get();
+    }
+}
+
 bool tracking_module::relocalize_by_pose(const pose_request& request) {
     bool succeeded = false;
     curr_frm_.set_pose_cw(request.pose_cw_);
@@ -334,23 +569,95 @@ std::vector<std::shared_ptr<data::keyframe>> tracking_module::get_close_keyframe
     }
 }
 
+Mat44_t tracking_module::predict_velocity(float& margin_scale) const {
+    margin_scale = 1.0;
+    Mat44_t velocity = twist_;
+    if (!twist_is_valid_) {
+        return velocity;
+    }
+    Mat33_t rot_curr_last;
+    if (imu_preintegrator_.integrate_rotation(last_frm_.timestamp_, curr_frm_.timestamp_, rot_curr_last)) {
+        // the translation is still predicted by the constant velocity model
+        velocity.block<3, 3>(0, 0) = rot_curr_last;
+        margin_scale = imu_margin_scale_;
+    }
+    return velocity;
+}
+
+Mat66_t tracking_module::predict_pose_cov(const Mat44_t& velocity) const {
+    if (last_frm_.pose_cov_.isZero() || motion_cov_.isZero()) {
+        return Mat66_t::Zero();
+    }
+    // transfer the covariance of the last pose with the adjoint of the velocity, then add the error of the motion model
+    const Mat33_t rot = velocity.block<3, 3>(0, 0);
+    const Vec3_t trans = velocity.block<3, 1>(0, 3);
+    Mat66_t adjoint = Mat66_t::Zero();
+    adjoint.block<3, 3>(0, 0) = rot;
+    adjoint.block<3, 3>(3, 0) = util::converter::to_skew_symmetric_mat(trans) * rot;
+    adjoint.block<3, 3>(3, 3) = rot;
+    return adjoint * last_frm_.pose_cov_ * adjoint.transpose() + motion_cov_;
+}
+
 void tracking_module::update_motion_model() {
+    if (enable_adaptive_search_radius_ && pred_pose_is_valid_) {
+        // error of the motion model as the left perturbation [rotation, translation] of the predicted pose
+        const g2o::SE3Quat error = util::converter::to_g2o_SE3(curr_frm_.get_pose_cw())
+                                   * util::converter::to_g2o_SE3(pred_pose_cw_).inverse();
+        const Vec6_t delta = error.log();
+        const Mat66_t delta_cov = delta * delta.transpose();
+        // exponential moving average
+        constexpr double alpha = 0.2;
+        motion_cov_ = motion_cov_.isZero() ? delta_cov : Mat66_t((1.0 - alpha) * motion_cov_ + alpha * delta_cov);
+    }
+    pred_pose_is_valid_ = false;
+
     if (last_frm_.pose_is_valid()) {
         Mat44_t last_frm_cam_pose_wc = Mat44_t::Identity();
         last_frm_cam_pose_wc.block<3, 3>(0, 0) = last_frm_.get_rot_wc();
         last_frm_cam_pose_wc.block<3, 1>(0, 3) = last_frm_.get_trans_wc();
         twist_is_valid_ = true;
         twist_ = curr_frm_.get_pose_cw() * last_frm_cam_pose_wc;
+        twist_dt_ = curr_frm_.timestamp_ - last_frm_.timestamp_;
     }
     else {
         twist_is_valid_ = false;
         twist_ = Mat44_t::Identity();
+        twist_dt_ = 0.0;
+    }
+}
+
+bool tracking_module::get_motion_model(Mat44_t& twist, double& dt) const {
+    twist = twist_;
+    dt = twist_dt_;
+    return twist_is_valid_ && 0.0 < twist_dt_;
+}
+
+bool tracking_module::predict_next_frame(Mat44_t& pred_pose_cw, eigen_alloc_vector<Vec3_t>& pos_ws) const {
+    pos_ws.clear();
+    // (the motion model and the last frame are updated while mtx_last_frm_ is locked)
+    std::lock_guard<std::mutex> lock(mtx_last_frm_);
+    if (!twist_is_valid_ || !last_frm_.pose_is_valid() || !last_frm_.frm_obs_) {
+        return false;
+    }
+    pred_pose_cw = twist_ * last_frm_.get_pose_cw();
+
+    pos_ws.reserve(last_frm_.frm_obs_->num_keypts_);
+    for (const auto& lm : last_frm_.get_landmarks()) {
+        if (!lm || lm->will_be_erased()) {
+            continue;
+        }
+        pos_ws.push_back(lm->get_pos_in_world());
     }
+    return true;
+}
+
+bool tracking_module::integrate_imu_rotation(const double last_timestamp, const double curr_timestamp, Mat33_t& rot_curr_last) const {
+    return imu_preintegrator_.integrate_rotation(last_timestamp, curr_timestamp, rot_curr_last);
 }
 
 void tracking_module::replace_landmarks_in_last_frm(nondeterministic::unordered_map<std::shared_ptr<data::landmark>, std::shared_ptr<data::landmark>>& replaced_lms) {
     std::lock_guard<std::mutex> lock(mtx_last_frm_);
-    for (unsigned int idx = 0; idx < last_frm_.frm_obs_.num_keypts_; ++idx) {
+    for (unsigned int idx = 0; idx < last_frm_.frm_obs_->num_keypts_; ++idx) {
         const auto& lm = last_frm_.get_landmark(idx);
         if (!lm) {
             continue;
@@ -377,27 +684,72 @@ void tracking_module::update_last_frame() {
 bool tracking_module::optimize_current_frame_with_local_map(unsigned int& num_tracked_lms,
                                                             unsigned int& num_reliable_lms,
                                                             const unsigned int min_num_obs_thr) {
+    STELLA_VSLAM_LATENCY_SPAN("tracking_module::optimize_current_frame_with_local_map");
+
     // acquire more 2D-3D matches by reprojecting the local landmarks to the current frame
     search_local_landmarks();
+    if (!curr_frm_.rig_frms_.empty()) {
+        search_local_landmarks_in_rig_frames();
+    }
 
-    // optimize the pose
+    // optimize the pose (jointly with the rig cameras if available)
     g2o::SE3Quat optimized_pose;
     std::vector<bool> outlier_flags;
-    pose_optimizer_.optimize(curr_frm_, optimized_pose, outlier_flags);
+    std::vector<std::vector<bool>> rig_outlier_flags;
+    pose_optimizer_.optimize(curr_frm_, optimized_pose, outlier_flags, rig_outlier_flags, &curr_frm_.pose_cov_);
     curr_frm_.set_pose_cw(optimized_pose);
 
     // Reject outliers
-    for (unsigned int idx = 0; idx < curr_frm_.frm_obs_.num_keypts_; ++idx) {
+    for (unsigned int idx = 0; idx < curr_frm_.frm_obs_->num_keypts_; ++idx) {
         if (!outlier_flags.at(idx)) {
             continue;
         }
         curr_frm_.erase_landmark_with_index(idx);
     }
+    // (the matches of the rig cameras are only used to constrain the pose)
+    unsigned int num_rig_tracked_lms = 0;
+    for (unsigned int rig_idx = 0; rig_idx < curr_frm_.rig_frms_.size(); ++rig_idx) {
+        auto& rig_frm = curr_frm_.rig_frms_.at(rig_idx)->frm_;
+        for (unsigned int idx = 0; idx < rig_frm.frm_obs_->num_keypts_; ++idx) {
+            if (!rig_frm.get_landmark(idx)) {
+                continue;
+            }
+            if (rig_outlier_flags.at(rig_idx).at(idx)) {
+                rig_frm.erase_landmark_with_index(idx);
+                continue;
+            }
+            ++num_rig_tracked_lms;
+        }
+    }
 
     // count up the number of tracked landmarks
+    count_tracked_landmarks(num_tracked_lms, num_reliable_lms, min_num_obs_thr, !tracking_on_frozen_map_);
+
+    constexpr unsigned int num_tracked_lms_thr = 20;
+
+    // if recently relocalized, use the more strict threshold
+    if (curr_frm_.timestamp_ < last_reloc_frm_timestamp_ + 1.0 && num_tracked_lms < 2 * num_tracked_lms_thr) {
+        spdlog::debug("local map tracking failed: {} matches < {}", num_tracked_lms, 2 * num_tracked_lms_thr);
+        return false;
+    }
+
+    // check the threshold of the number of tracked landmarks
+    // (the matches of the rig cameras keep the tracking while the primary camera observes few landmarks)
+    if (num_tracked_lms + num_rig_tracked_lms < num_tracked_lms_thr) {
+        spdlog::debug("local map tracking failed: {} matches (rig: {}) < {}", num_tracked_lms, num_rig_tracked_lms, num_tracked_lms_thr);
+        return false;
+    }
+
+    return true;
+}
+
+void tracking_module::count_tracked_landmarks(unsigned int& num_tracked_lms,
+                                              unsigned int& num_reliable_lms,
+                                              const unsigned int min_num_obs_thr,
+                                              const bool increase_num_observed) {
     num_tracked_lms = 0;
     num_reliable_lms = 0;
-    for (unsigned int idx = 0; idx < curr_frm_.frm_obs_.num_keypts_; ++idx) {
+    for (unsigned int idx = 0; idx < curr_frm_.frm_obs_->num_keypts_; ++idx) {
         const auto& lm = curr_frm_.get_landmark(idx);
         if (!lm) {
             continue;
@@ -416,29 +768,58 @@ bool tracking_module::optimize_current_frame_with_local_map(unsigned int& num_tr
         }
         ++num_tracked_lms;
         // increment the number of tracked frame
-        lm->increase_num_observed();
+        // (the statistics are used only for the culling by the mapping module)
+        if (increase_num_observed) {
+            lm->increase_num_observed();
+        }
     }
+}
 
-    constexpr unsigned int num_tracked_lms_thr = 20;
-
-    // if recently relocalized, use the more strict threshold
-    if (curr_frm_.timestamp_ < last_reloc_frm_timestamp_ + 1.0 && num_tracked_lms < 2 * num_tracked_lms_thr) {
-        spdlog::debug("local map tracking failed: {} matches < {}", num_tracked_lms, 2 * num_tracked_lms_thr);
+bool tracking_module::is_confidently_tracked() const {
+    // the matches of the rig cameras and the strict threshold after the relocalization need the local map search
+    if (!curr_frm_.rig_frms_.empty() || curr_frm_.timestamp_ < last_reloc_frm_timestamp_ + 1.0) {
         return false;
     }
 
-    // check the threshold of the number of tracked landmarks
-    if (num_tracked_lms < num_tracked_lms_thr) {
-        spdlog::debug("local map tracking failed: {} matches < {}", num_tracked_lms, num_tracked_lms_thr);
-        return false;
+    constexpr unsigned int num_grid_cells = 4;
+    std::array<bool, num_grid_cells * num_grid_cells> is_occupied{};
+    const Mat33_t rot_cw = curr_frm_.get_rot_cw();
+    const Vec3_t trans_cw = curr_frm_.get_trans_cw();
+    const auto& scale_factors = curr_frm_.orb_params_->scale_factors_;
+    unsigned int num_inliers = 0;
+    double sum_reproj_error = 0.0;
+    for (unsigned int idx = 0; idx < curr_frm_.frm_obs_->num_keypts_; ++idx) {
+        const auto& lm = curr_frm_.get_landmark(idx);
+        if (!lm || lm->will_be_erased()) {
+            continue;
+        }
+        const auto& keypt = curr_frm_.frm_obs_->undist_keypts_.at(idx);
+        Vec2_t reproj;
+        float x_right;
+        if (!camera_->reproject_to_image(rot_cw, trans_cw, lm->get_pos_in_world(), reproj, x_right)) {
+            continue;
+        }
+        // (the error is normalized to the original scale with the octave of the keypoint)
+        sum_reproj_error += (reproj - Vec2_t(keypt.pt.x, keypt.pt.y)).norm() / scale_factors.at(keypt.octave);
+        ++num_inliers;
+
+        const auto col = std::min(num_grid_cells - 1, static_cast<unsigned int>(std::max(0.0f, keypt.pt.x) * num_grid_cells / camera_->cols_));
+        const auto row = std::min(num_grid_cells - 1, static_cast<unsigned int>(std::max(0.0f, keypt.pt.y) * num_grid_cells / camera_->rows_));
+        is_occupied.at(row * num_grid_cells + col) = true;
     }
 
-    return true;
+    if (num_inliers < confident_min_num_inliers_) {
+        return false;
+    }
+    const auto num_occupied_cells = std::count(is_occupied.begin(), is_occupied.end(), true);
+    if (num_occupied_cells < confident_min_occupied_cell_ratio_ * is_occupied.size()) {
+        return false;
+    }
+    return sum_reproj_error / num_inliers <= confident_max_reproj_error_;
 }
 
-void tracking_module::update_local_map() {
-    // clean landmark associations
-    for (unsigned int idx = 0; idx < curr_frm_.frm_obs_.num_keypts_; ++idx) {
+void tracking_module::clean_landmark_associations() {
+    for (unsigned int idx = 0; idx < curr_frm_.frm_obs_->num_keypts_; ++idx) {
         const auto& lm = curr_frm_.get_landmark(idx);
         if (!lm) {
             continue;
@@ -448,16 +829,45 @@ void tracking_module::update_local_map() {
             continue;
         }
     }
+}
+
+void tracking_module::update_local_map() {
+    STELLA_VSLAM_LATENCY_SPAN("tracking_module::update_local_map");
+
+    clean_landmark_associations();
 
     // acquire the current local map
-    auto local_map_updater = module::local_map_updater(curr_frm_, max_num_local_keyfrms_);
-    if (!local_map_updater.acquire_local_map()) {
-        return;
+    // (use the one built from the landmark associations of the last frame if available)
+    // (use the one cached for the reference keyframe if the map is frozen)
+    std::shared_ptr<module::local_map_updater> local_map_updater;
+    if (future_local_map_.valid()) {
+        local_map_updater = future_local_map_.get();
+    }
+    const auto cache_key = curr_frm_.ref_keyfrm_ ? curr_frm_.ref_keyfrm_->id_ : 0;
+    if (!local_map_updater && tracking_on_frozen_map_ && curr_frm_.ref_keyfrm_) {
+        const auto itr = cached_local_maps_.find(cache_key);
+        if (itr != cached_local_maps_.end()) {
+            local_map_updater = itr->second;
+        }
+    }
+    if (!local_map_updater) {
+        local_map_updater = std::make_shared<module::local_map_updater>(curr_frm_, max_num_local_keyfrms_);
+        if (!local_map_updater->acquire_local_map()) {
+            // the landmarks of the previous local map may have been moved by the mapping module
+            local_map_snapshot_.build(local_landmarks_);
+            return;
+        }
+        if (tracking_on_frozen_map_ && curr_frm_.ref_keyfrm_) {
+            if (max_num_cached_local_maps_ <= cached_local_maps_.size()) {
+                cached_local_maps_.clear();
+            }
+            cached_local_maps_[cache_key] = local_map_updater;
+        }
     }
     // update the variables
-    local_keyfrms_ = local_map_updater.get_local_keyframes();
-    local_landmarks_ = local_map_updater.get_local_landmarks();
-    auto nearest_covisibility = local_map_updater.get_nearest_covisibility();
+    local_keyfrms_ = local_map_updater->get_local_keyframes();
+    local_landmarks_ = local_map_updater->get_local_landmarks();
+    auto nearest_covisibility = local_map_updater->get_nearest_covisibility();
 
     // update the reference keyframe for the current frame
     if (nearest_covisibility) {
@@ -465,11 +875,28 @@ void tracking_module::update_local_map() {
     }
 
     map_db_->set_local_landmarks(local_landmarks_);
+    local_map_snapshot_.build(local_landmarks_);
+}
+
+void tracking_module::prebuild_local_map() {
+    // the landmark associations are copied here, and the worker only accesses the keyframes and landmarks via their own locks
+    auto local_map_updater = std::make_shared<module::local_map_updater>(curr_frm_, max_num_local_keyfrms_);
+    future_local_map_ = std::async(std::launch::async, [local_map_updater] {
+        return local_map_updater->acquire_local_map() ? local_map_updater : nullptr;
+    });
+}
+
+void tracking_module::discard_prebuilt_local_map() {
+    if (future_local_map_.valid()) {
+        future_local_map_.get();
+    }
 }
 
 void tracking_module::search_local_landmarks() {
+    STELLA_VSLAM_LATENCY_SPAN("tracking_module::search_local_landmarks");
+
     // select the landmarks which can be reprojected from the ones observed in the current frame
-    std::unordered_set<unsigned int> curr_landmark_ids;
+    std::unordered_set<unsigned int, std::hash<unsigned int>, std::equal_to<unsigned int>, util::arena_allocator<unsigned int>> curr_landmark_ids;
     for (const auto& lm : curr_frm_.get_landmarks()) {
         if (!lm) {
             continue;
@@ -483,36 +910,36 @@ void tracking_module::search_local_landmarks() {
         curr_landmark_ids.insert(lm->id_);
 
         // this landmark is observable from the current frame
-        lm->increase_num_observable();
+        if (!tracking_on_frozen_map_) {
+            lm->increase_num_observable();
+        }
     }
 
+    // check the observability of all the landmarks in the packed local map at once
+    std::vector<bool> is_observable;
+    eigen_alloc_vector<Vec2_t> reprojs;
+    std::vector<float> x_rights;
+    std::vector<unsigned int> pred_scale_levels;
+    curr_frm_.can_observe(local_map_snapshot_, 0.5, is_observable, reprojs, x_rights, pred_scale_levels);
+
+    // select the candidates to be reprojected
     bool found_proj_candidate = false;
-    // temporary variables
-    Vec2_t reproj;
-    float x_right;
-    unsigned int pred_scale_level;
-    eigen_alloc_unord_map<unsigned int, Vec2_t> lm_to_reproj;
-    std::unordered_map<unsigned int, float> lm_to_x_right;
-    std::unordered_map<unsigned int, int> lm_to_scale;
-    for (const auto& lm : local_landmarks_) {
-        if (curr_landmark_ids.count(lm->id_)) {
+    for (unsigned int i = 0; i < local_map_snapshot_.size(); ++i) {
+        if (!is_observable.at(i)) {
             continue;
         }
-        if (lm->will_be_erased()) {
+        const auto& lm = local_map_snapshot_.landmarks_.at(i);
+        if (curr_landmark_ids.count(local_map_snapshot_.ids_.at(i)) || lm->will_be_erased()) {
+            is_observable.at(i) = false;
             continue;
         }
 
-        // check the observability
-        if (curr_frm_.can_observe(lm, 0.5, reproj, x_right, pred_scale_level)) {
-            lm_to_reproj[lm->id_] = reproj;
-            lm_to_x_right[lm->id_] = x_right;
-            lm_to_scale[lm->id_] = pred_scale_level;
-
-            // this landmark is observable from the current frame
+        // this landmark is observable from the current frame
+        if (!tracking_on_frozen_map_) {
             lm->increase_num_observable();
-
-            found_proj_candidate = true;
         }
+
+        found_proj_candidate = true;
     }
 
     if (!found_proj_candidate) {
@@ -526,7 +953,45 @@ void tracking_module::search_local_landmarks() {
                              : ((camera_->setup_type_ == camera::setup_type_t::RGBD)
                                     ? 10.0
                                     : 5.0);
-    projection_matcher.match_frame_and_landmarks(curr_frm_, local_landmarks_, lm_to_reproj, lm_to_x_right, lm_to_scale, margin);
+    const bool use_pose_cov = enable_adaptive_search_radius_ && !curr_frm_.pose_cov_.isZero();
+    projection_matcher.match_frame_and_landmarks(curr_frm_, local_map_snapshot_, is_observable, reprojs, x_rights, pred_scale_levels, margin,
+                                                 use_pose_cov ? &curr_frm_.pose_cov_ : nullptr);
+}
+
+void tracking_module::search_local_landmarks_in_rig_frames() {
+    STELLA_VSLAM_LATENCY_SPAN("tracking_module::search_local_landmarks_in_rig_frames");
+
+    std::vector<bool> is_erased(local_map_snapshot_.size());
+    for (unsigned int i = 0; i < local_map_snapshot_.size(); ++i) {
+        is_erased.at(i) = local_map_snapshot_.landmarks_.at(i)->will_be_erased();
+    }
+
+    match::projection projection_matcher(0.8);
+    const float margin = (curr_frm_.id_ < last_reloc_frm_id_ + 2) ? 20.0 : 5.0;
+    for (const auto& rig_frm : curr_frm_.rig_frms_) {
+        auto& frm = rig_frm->frm_;
+        // the landmarks matched in the previous tracking of this frame are searched again
+        frm.erase_landmarks();
+
+        std::vector<bool> is_observable;
+        eigen_alloc_vector<Vec2_t> reprojs;
+        std::vector<float> x_rights;
+        std::vector<unsigned int> pred_scale_levels;
+        frm.can_observe(local_map_snapshot_, 0.5, is_observable, reprojs, x_rights, pred_scale_levels);
+
+        bool found_proj_candidate = false;
+        for (unsigned int i = 0; i < local_map_snapshot_.size(); ++i) {
+            if (is_erased.at(i)) {
+                is_observable.at(i) = false;
+            }
+            found_proj_candidate |= is_observable.at(i);
+        }
+        if (!found_proj_candidate) {
+            continue;
+        }
+
+        projection_matcher.match_frame_and_landmarks(frm, local_map_snapshot_, is_observable, reprojs, x_rights, pred_scale_levels, margin);
+    }
 }
 
 bool tracking_module::new_keyframe_is_needed(unsigned int num_tracked_lms,
@@ -542,11 +1007,15 @@ bool tracking_module::new_keyframe_is_needed(unsigned int num_tracked_lms,
 }
 
 void tracking_module::insert_new_keyframe() {
+    STELLA_VSLAM_LATENCY_SPAN("tracking_module::insert_new_keyframe");
+
     // insert the new keyframe
     const auto ref_keyfrm = keyfrm_inserter_.insert_new_keyframe(map_db_, curr_frm_);
     // set the reference keyframe with the new keyframe
     if (ref_keyfrm) {
         curr_frm_.ref_keyfrm_ = ref_keyfrm;
+        // the local map is refreshed around the new keyframe on the next frame
+        local_map_refresh_is_needed_ = true;
     }
 }
 
@@ -604,6 +1073,7 @@ void tracking_module::resume() {
 
     is_paused_ = false;
     pause_is_requested_ = false;
+    cond_pause_.notify_all();
 
     spdlog::info("resume tracking module");
 }
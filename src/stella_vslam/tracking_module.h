@@ -3,14 +3,18 @@
 
 #include "stella_vslam/type.h"
 #include "stella_vslam/data/frame.h"
+#include "stella_vslam/data/local_map_snapshot.h"
 #include "stella_vslam/module/initializer.h"
 #include "stella_vslam/module/relocalizer.h"
 #include "stella_vslam/module/keyframe_inserter.h"
 #include "stella_vslam/module/frame_tracker.h"
+#include "stella_vslam/module/imu_preintegrator.h"
 
 #include <mutex>
 #include <memory>
 #include <future>
+#include <condition_variable>
+#include <unordered_map>
 
 #include <opencv2/core/types.hpp>
 #include <opencv2/features2d/features2d.hpp>
@@ -26,6 +30,15 @@ class map_database;
 class bow_database;
 } // namespace data
 
+namespace module {
+class local_map_updater;
+} // namespace module
+
+namespace util {
+class thread_pool;
+class keyframe_tracer;
+} // namespace util
+
 // tracker state
 enum class tracker_state_t {
     Initializing,
@@ -58,6 +71,12 @@ public:
     //! Set the global optimization module
     void set_global_optimization_module(global_optimization_module* global_optimizer);
 
+    //! Set the thread pool shared among the modules
+    void set_thread_pool(const std::shared_ptr<util::thread_pool>& thread_pool);
+
+    //! Set the tracer which records the times when the keyframes are created
+    void set_keyframe_tracer(const std::shared_ptr<util::keyframe_tracer>& keyfrm_tracer);
+
     //-----------------------------------------
     // interfaces for mapping module and global optimization module
 
@@ -70,11 +89,25 @@ public:
     //! Main stream of the tracking module
     std::shared_ptr<Mat44_t> feed_frame(data::frame frame);
 
+    //! Queue the IMU measurements to predict the rotation of the next frames
+    void queue_imu_measurements(const std::vector<data::imu_measurement>& imu_measurements);
+
     //! Request to update the pose to a given one.
     //! Return failure in case if previous request was not finished yet.
     bool request_relocalize_by_pose(const Mat44_t& pose_cw);
     bool request_relocalize_by_pose_2d(const Mat44_t& pose_cw, const Vec3_t& normal_vector);
 
+    //-----------------------------------------
+    // management for the localization against a prebuilt map
+
+    //! Freeze the map while the mapping and the global optimization modules are paused (see system::disable_mapping_module())
+    //! (the map database is not locked during the tracking, the local maps are cached per reference keyframe,
+    //!  and neither the keyframe insertion nor the observation statistics of the landmarks are handled)
+    void set_map_is_frozen(const bool map_is_frozen);
+
+    //! Check if the map is frozen or not
+    bool map_is_frozen() const;
+
     //-----------------------------------------
     // management for reset process
 
@@ -124,6 +157,81 @@ public:
     //! Max number of local keyframes for tracking
     unsigned int max_num_local_keyfrms_ = 60;
 
+    //! If true, build the local map for the next frame on a worker thread after tracking the current frame
+    bool enable_async_local_map_update_ = false;
+
+    //! If true, relocalize on a worker thread while lost, and skip the frames fed during the relocalization
+    bool enable_async_relocalization_ = false;
+
+    //! If positive, start a new map in the same map database after tracking has been lost for this duration [sec]
+    //! instead of relocalizing forever (the maps are merged at the inter-map loops by the global optimization module)
+    double new_map_after_lost_sec_ = 0.0;
+
+    //! Scale of the margin of the motion based tracking when the rotation is predicted by the IMU
+    float imu_margin_scale_ = 0.5;
+
+    //! If true, derive the search windows of the projection matching from the uncertainties of the pose and the landmarks
+    bool enable_adaptive_search_radius_ = false;
+
+    //! If true, freeze the map while the mapping module is disabled (Tracking.freeze_map_in_localization, opt-in)
+    //! (the global optimization module is also paused, so the loops are not corrected in the meantime,
+    //!  and the tracking runs on the local maps cached per reference keyframe without locking the map database
+    //!  nor updating the observed/observable counters of the landmarks)
+    bool freeze_map_in_localization_ = false;
+
+    //! If true, rewind the frame ID on the reset
+    //! (disabled while the IDs of the pipelined frames are reserved ahead of the tracking)
+    bool rewind_frame_id_on_reset_ = true;
+
+    //! Max number of the local maps cached while the map is frozen
+    unsigned int max_num_cached_local_maps_ = 256;
+
+    //! If true, skip the local map search on the frames confidently tracked with the motion model,
+    //! and refresh the local map every local_map_refresh_interval_ frames or after a keyframe is inserted
+    bool enable_adaptive_local_map_tracking_ = false;
+    //! Max number of the consecutive frames on which the local map search is skipped
+    unsigned int local_map_refresh_interval_ = 5;
+    //! Min number of the inliers of the motion based tracking to skip the local map search
+    unsigned int confident_min_num_inliers_ = 150;
+    //! Min ratio of the cells of the 4x4 image grid which have the inliers
+    double confident_min_occupied_cell_ratio_ = 0.75;
+    //! Max mean reprojection error of the inliers [px at the original scale]
+    double confident_max_reproj_error_ = 1.5;
+
+    //! Check if the local map search was skipped for the last frame
+    bool local_map_search_is_skipped() const { return local_map_search_is_skipped_; }
+
+    //! Check if a new keyframe was needed for the last frame but deferred (because it was tracked by the optical flow)
+    bool keyframe_insertion_is_deferred() const { return keyframe_insertion_is_deferred_; }
+
+    //! Check if a new keyframe was needed for the last frame (whether it was inserted or not)
+    bool keyframe_is_needed() const { return keyframe_is_needed_; }
+
+    /**
+     * Get the motion model of the current frame
+     * NOTE: should be accessed from tracker thread
+     * @param twist relative pose from the last frame to the current frame
+     * @param dt time between the frames [s]
+     * @return false if the motion model is not valid
+     */
+    bool get_motion_model(Mat44_t& twist, double& dt) const;
+
+    /**
+     * Predict the pose of the next frame with the motion model, and get the landmarks observed in the last frame
+     * (e.g. as the depth prior of the stereo matching)
+     * NOTE: can be accessed from any thread
+     * @param pred_pose_cw predicted pose of the next frame
+     * @param pos_ws positions of the landmarks in the world coordinates
+     * @return false if the motion model is not valid
+     */
+    bool predict_next_frame(Mat44_t& pred_pose_cw, eigen_alloc_vector<Vec3_t>& pos_ws) const;
+
+    /**
+     * Integrate the queued angular velocity of the IMU between the timestamps (see imu_preintegrator::integrate_rotation)
+     * NOTE: can be accessed from any thread
+     */
+    bool integrate_imu_rotation(const double last_timestamp, const double curr_timestamp, Mat33_t& rot_curr_last) const;
+
     //-----------------------------------------
     // variables
 
@@ -149,6 +257,19 @@ protected:
     //! Relocalization by pose
     bool relocalize_by_pose(const pose_request& request);
 
+    //! Collect the pending relocalization and track the current frame from it if succeeded,
+    //! otherwise start relocalizing the current frame on a worker thread (return true if the current frame is tracked)
+    bool relocalize_asynchronously();
+
+    //! Wait for and discard the pending relocalization
+    void discard_async_relocalization();
+
+    //! Keep the current maps and initialize a new one from the next frame
+    void start_new_map();
+
+    //! Erase the newest map (the spanning tree) whose initialization failed
+    void discard_newest_map();
+
     //! Get close keyframes
     std::vector<std::shared_ptr<data::keyframe>> get_close_keyframes(const pose_request& request);
 
@@ -163,12 +284,33 @@ protected:
                                                unsigned int& num_reliable_lms,
                                                const unsigned int min_num_obs_thr);
 
+    //! Count the tracked landmarks of the current frame (and increase their numbers of the observed frames if requested)
+    void count_tracked_landmarks(unsigned int& num_tracked_lms,
+                                 unsigned int& num_reliable_lms,
+                                 const unsigned int min_num_obs_thr,
+                                 const bool increase_num_observed);
+
+    //! Check if the current frame is tracked by the motion model confidently enough to skip the local map search
+    bool is_confidently_tracked() const;
+
+    //! Remove the associations of the current frame with the landmarks which will be erased
+    void clean_landmark_associations();
+
     //! Update the local map
     void update_local_map();
 
+    //! Start building the local map for the next frame from the current landmark associations
+    void prebuild_local_map();
+
+    //! Wait for and discard the local map being built for the next frame
+    void discard_prebuilt_local_map();
+
     //! Acquire more 2D-3D matches using initial camera pose estimation
     void search_local_landmarks();
 
+    //! Acquire the 2D-3D matches of the auxiliary cameras of the multi-camera rig by reprojecting the local landmarks
+    void search_local_landmarks_in_rig_frames();
+
     //! Check the new keyframe is needed or not
     bool new_keyframe_is_needed(unsigned int num_tracked_lms,
                                 unsigned int num_reliable_lms,
@@ -210,6 +352,12 @@ protected:
     std::vector<std::shared_ptr<data::keyframe>> local_keyfrms_;
     //! local landmarks
     std::vector<std::shared_ptr<data::landmark>> local_landmarks_;
+    //! packed copy of the local landmarks, which is searched in the current frame (rebuilt in update_local_map())
+    data::local_map_snapshot local_map_snapshot_;
+    //! local map being built for the next frame (nullptr if it was not found)
+    std::future<std::shared_ptr<module::local_map_updater>> future_local_map_;
+    //! frame being relocalized on the worker thread (nullptr if it failed)
+    std::future<std::shared_ptr<data::frame>> future_reloc_frm_;
 
     //! last frame
     data::frame last_frm_;
@@ -221,16 +369,66 @@ protected:
     unsigned int last_reloc_frm_id_ = 0;
     //! timestamp of latest frame which succeeded in relocalization
     double last_reloc_frm_timestamp_ = 0.0;
+    //! timestamp of the frame on which tracking was lost
+    double lost_frm_timestamp_ = 0.0;
 
     //! motion model
     Mat44_t twist_;
     //! motion model is valid or not
     bool twist_is_valid_ = false;
+    //! time between the frames of the motion model [s]
+    double twist_dt_ = 0.0;
+
+    //! preintegrator of the IMU measurements
+    module::imu_preintegrator imu_preintegrator_;
+
+    //! pose of the current frame predicted by the motion model (to update motion_cov_)
+    Mat44_t pred_pose_cw_;
+    //! pred_pose_cw_ is valid or not
+    bool pred_pose_is_valid_ = false;
+    //! covariance of the error of the motion model, which is averaged over the tracked frames (zero if unknown)
+    Mat66_t motion_cov_ = Mat66_t::Zero();
+
+    //! Get the covariance of the pose predicted with the velocity (zero if unknown)
+    Mat66_t predict_pose_cov(const Mat44_t& velocity) const;
+
+    //! Get the velocity used as the motion model of the current frame
+    //! (the rotation is replaced with the IMU prediction if available, and margin_scale is set accordingly)
+    Mat44_t predict_velocity(float& margin_scale) const;
+
+    //! a new keyframe was needed for the current frame but deferred
+    bool keyframe_insertion_is_deferred_ = false;
+    //! a new keyframe was needed for the current frame
+    bool keyframe_is_needed_ = false;
+
+    //! the current frame is tracked by the motion model
+    bool tracked_by_motion_model_ = false;
+    //! number of the consecutive frames on which the local map search is skipped
+    unsigned int num_skipped_local_map_searches_ = 0;
+    //! the local map search was skipped for the current frame or not
+    bool local_map_search_is_skipped_ = false;
+    //! the local map has to be refreshed on the next frame (e.g. a keyframe was inserted)
+    bool local_map_refresh_is_needed_ = true;
 
     //! current camera pose from reference keyframe
     //! (to update last camera pose at the beginning of each tracking)
     Mat44_t last_cam_pose_from_ref_keyfrm_;
 
+    //-----------------------------------------
+    // management for the frozen map
+
+    //! mutex for the frozen map (held during the tracking, so that the map is not unfrozen in the middle of it)
+    mutable std::mutex mtx_map_is_frozen_;
+
+    //! the map is requested to be frozen or not
+    bool map_is_frozen_ = false;
+
+    //! the current frame is tracked against the frozen map or not
+    bool tracking_on_frozen_map_ = false;
+
+    //! local maps cached per reference keyframe ID while the map is frozen
+    std::unordered_map<unsigned int, std::shared_ptr<module::local_map_updater>> cached_local_maps_;
+
     //-----------------------------------------
     // management for stop_keyframe_insertion process
 
@@ -245,6 +443,9 @@ protected:
     //! mutex for pause process
     mutable std::mutex mtx_pause_;
 
+    //! condition variable notified on resume
+    std::condition_variable cond_pause_;
+
     //! promise for pause
     std::promise<void> promise_pause_;
 
@@ -52,6 +52,22 @@ using Mat34_t = MatRC_t<3, 4>;
 
 using MatX_t = Eigen::MatrixXd;
 
+// N x C matrices whose columns are contiguous (e.g. x, y and z of N points)
+
+using MatX2_t = Eigen::Matrix<double, Eigen::Dynamic, 2>;
+
+using MatX3_t = Eigen::Matrix<double, Eigen::Dynamic, 3>;
+
+// 3 x N matrices whose columns are 3D vectors (e.g. N points, which can be mapped from eigen_alloc_vector<Vec3_t>)
+
+using Mat3X_t = Eigen::Matrix<double, 3, Eigen::Dynamic>;
+
+// R x N matrices whose rows are contiguous (structure of arrays, e.g. x, y and z of N points for the vectorized computation)
+
+using RowMajorMat2X_t = Eigen::Matrix<double, 2, Eigen::Dynamic, Eigen::RowMajor>;
+
+using RowMajorMat3X_t = Eigen::Matrix<double, 3, Eigen::Dynamic, Eigen::RowMajor>;
+
 // Eigen vector types
 
 template<size_t R>
@@ -71,6 +87,29 @@ using Vec7_t = VecR_t<7>;
 
 using VecX_t = Eigen::VectorXd;
 
+using VecXb_t = Eigen::Array<bool, Eigen::Dynamic, 1>;
+
+// Eigen types of the tracking-side geometry (the batch reprojection, the visibility culling and the dedicated pose solver)
+// (single precision if built with USE_SINGLE_PRECISION_TRACKING, while the map, BA and loop closure are kept in double)
+
+#ifdef USE_SINGLE_PRECISION_TRACKING
+typedef float tracking_real_t;
+#else
+typedef double tracking_real_t;
+#endif
+
+using TrkMat33_t = Eigen::Matrix<tracking_real_t, 3, 3>;
+
+using TrkVec3_t = Eigen::Matrix<tracking_real_t, 3, 1>;
+
+using TrkMatX2_t = Eigen::Matrix<tracking_real_t, Eigen::Dynamic, 2>;
+
+using TrkMatX3_t = Eigen::Matrix<tracking_real_t, Eigen::Dynamic, 3>;
+
+using TrkVecX_t = Eigen::Matrix<tracking_real_t, Eigen::Dynamic, 1>;
+
+using TrkArrayX_t = Eigen::Array<tracking_real_t, Eigen::Dynamic, 1>;
+
 // Eigen Quaternion type
 
 using Quat_t = Eigen::Quaterniond;
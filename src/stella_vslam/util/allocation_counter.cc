@@ -0,0 +1,87 @@
+#include "stella_vslam/util/allocation_counter.h"
+
+#include <cstdlib>
+#include <new>
+
+namespace stella_vslam {
+namespace util {
+
+namespace {
+// (trivially constructed, so that they can be touched by operator new during the thread startup and shutdown)
+thread_local uint64_t thread_num_allocs = 0;
+thread_local uint64_t thread_alloc_bytes = 0;
+} // namespace
+
+bool allocation_counter::is_enabled() {
+#ifdef USE_ALLOCATION_COUNTERS
+    return true;
+#else
+    return false;
+#endif
+}
+
+allocation_stats allocation_counter::get_thread_stats() {
+    return allocation_stats{thread_num_allocs, thread_alloc_bytes};
+}
+
+#ifdef USE_ALLOCATION_COUNTERS
+namespace {
+void* counted_allocate(std::size_t size) noexcept {
+    ++thread_num_allocs;
+    thread_alloc_bytes += size;
+    // (malloc is served by the allocator backend if one is linked, see ALLOCATOR_BACKEND)
+    return std::malloc(size ? size : 1);
+}
+
+void* counted_allocate_or_throw(std::size_t size) {
+    while (true) {
+        void* ptr = counted_allocate(size);
+        if (ptr) {
+            return ptr;
+        }
+        const auto handler = std::get_new_handler();
+        if (!handler) {
+            throw std::bad_alloc();
+        }
+        handler();
+    }
+}
+} // namespace
+#endif
+
+} // namespace util
+} // namespace stella_vslam
+
+#ifdef USE_ALLOCATION_COUNTERS
+void* operator new(std::size_t size) {
+    return stella_vslam::util::counted_allocate_or_throw(size);
+}
+
+void* operator new[](std::size_t size) {
+    return stella_vslam::util::counted_allocate_or_throw(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    return stella_vslam::util::counted_allocate(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    return stella_vslam::util::counted_allocate(size);
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept {
+    std::free(ptr);
+}
+#endif
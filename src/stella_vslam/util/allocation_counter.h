@@ -0,0 +1,32 @@
+#ifndef STELLA_VSLAM_UTIL_ALLOCATION_COUNTER_H
+#define STELLA_VSLAM_UTIL_ALLOCATION_COUNTER_H
+
+#include <cstdint>
+
+namespace stella_vslam {
+namespace util {
+
+//! Number and bytes of the allocations by operator new
+struct allocation_stats {
+    uint64_t num_allocs_;
+    uint64_t alloc_bytes_;
+};
+
+/**
+ * Counters of the allocations by operator new on the calling thread
+ * (NOTE: the global operator new and delete are replaced only when built with USE_ALLOCATION_COUNTERS,
+ *  otherwise the counters are always zero)
+ */
+class allocation_counter {
+public:
+    //! True if the allocations are counted
+    static bool is_enabled();
+
+    //! Get the cumulative counts of the calling thread
+    static allocation_stats get_thread_stats();
+};
+
+} // namespace util
+} // namespace stella_vslam
+
+#endif // STELLA_VSLAM_UTIL_ALLOCATION_COUNTER_H
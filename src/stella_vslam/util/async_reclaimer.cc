@@ -0,0 +1,68 @@
+#include "stella_vslam/util/async_reclaimer.h"
+#include "stella_vslam/util/thread_scheduling.h"
+
+namespace stella_vslam {
+namespace util {
+
+async_reclaimer::async_reclaimer()
+    : thread_(&async_reclaimer::run, this) {}
+
+async_reclaimer::~async_reclaimer() {
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        is_terminated_ = true;
+    }
+    cond_push_.notify_all();
+    thread_.join();
+}
+
+void async_reclaimer::push(std::function<void()>&& task) {
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        tasks_.push_back(std::move(task));
+        ++num_pending_tasks_;
+    }
+    cond_push_.notify_one();
+}
+
+void async_reclaimer::wait_until_idle() {
+    std::unique_lock<std::mutex> lock(mtx_);
+    cond_finish_.wait(lock, [this] { return num_pending_tasks_ == 0; });
+}
+
+unsigned int async_reclaimer::get_num_pending_tasks() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return num_pending_tasks_;
+}
+
+void async_reclaimer::run() {
+    // the destruction yields the cores to the other threads
+    thread_scheduling_params scheduling;
+    scheduling.nice_ = 19;
+    apply_current_thread_scheduling(scheduling);
+
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mtx_);
+            cond_push_.wait(lock, [this] { return is_terminated_ || !tasks_.empty(); });
+            if (tasks_.empty()) {
+                // terminated
+                return;
+            }
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+        }
+        task();
+        // the objects owned by the task are destroyed without the lock
+        task = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            --num_pending_tasks_;
+        }
+        cond_finish_.notify_all();
+    }
+}
+
+} // namespace util
+} // namespace stella_vslam
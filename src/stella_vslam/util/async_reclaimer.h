@@ -0,0 +1,59 @@
+#ifndef STELLA_VSLAM_UTIL_ASYNC_RECLAIMER_H
+#define STELLA_VSLAM_UTIL_ASYNC_RECLAIMER_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace stella_vslam {
+namespace util {
+
+/**
+ * Thread which destroys the objects handed over by their owners (e.g. the keyframes and the landmarks of a cleared map)
+ * The owners swap out their containers and return at once, and the destructors run on this thread with the lowest nice value.
+ * The objects are handed over as the tasks which own them, and destroyed after the tasks run
+ * (the tasks break the cyclic references among the objects, if any).
+ */
+class async_reclaimer {
+public:
+    //! Constructor
+    async_reclaimer();
+
+    //! Destructor (the pending objects are destroyed before the thread is joined)
+    ~async_reclaimer();
+
+    async_reclaimer(const async_reclaimer&) = delete;
+    async_reclaimer& operator=(const async_reclaimer&) = delete;
+
+    //! Hand over the task which owns the objects
+    void push(std::function<void()>&& task);
+
+    //! Wait until the objects handed over so far are destroyed
+    void wait_until_idle();
+
+    //! Number of the tasks which are not finished
+    unsigned int get_num_pending_tasks() const;
+
+private:
+    //! Main loop of the thread
+    void run();
+
+    mutable std::mutex mtx_;
+    //! notified when a task is pushed or the reclaimer is terminated
+    std::condition_variable cond_push_;
+    //! notified when a task is finished
+    std::condition_variable cond_finish_;
+    std::deque<std::function<void()>> tasks_;
+    //! number of the tasks which are pending or running
+    unsigned int num_pending_tasks_ = 0;
+    bool is_terminated_ = false;
+
+    std::thread thread_;
+};
+
+} // namespace util
+} // namespace stella_vslam
+
+#endif // STELLA_VSLAM_UTIL_ASYNC_RECLAIMER_H
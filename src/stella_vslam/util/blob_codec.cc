@@ -0,0 +1,110 @@
+#include "stella_vslam/util/blob_codec.h"
+
+#include <cstring>
+#include <stdexcept>
+
+#ifdef USE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace stella_vslam {
+namespace util {
+namespace blob_codec {
+
+namespace {
+enum class codec_t : uint8_t {
+    Raw = 0,
+    Zlib = 1
+};
+
+//! codec (1 byte) and raw size (4 bytes, little endian)
+constexpr size_t header_size = 5;
+
+void write_header(std::string& blob, const codec_t codec, const uint32_t raw_size) {
+    blob.resize(header_size);
+    blob[0] = static_cast<char>(codec);
+    for (unsigned int i = 0; i < 4; ++i) {
+        blob[1 + i] = static_cast<char>((raw_size >> (8 * i)) & 0xff);
+    }
+}
+} // namespace
+
+bool compression_is_available() {
+#ifdef USE_ZLIB
+    return true;
+#else
+    return false;
+#endif
+}
+
+std::string encode(const void* data, const size_t size, const bool compress) {
+    if (static_cast<uint64_t>(UINT32_MAX) < size) {
+        throw std::runtime_error("too large blob to encode: " + std::to_string(size) + " bytes");
+    }
+    std::string blob;
+#ifdef USE_ZLIB
+    if (compress && 0 < size) {
+        uLongf compressed_size = compressBound(size);
+        write_header(blob, codec_t::Zlib, size);
+        blob.resize(header_size + compressed_size);
+        // NOTE: the blobs are small and compressed in parallel, so the fast level is used
+        const int ret = compress2(reinterpret_cast<Bytef*>(&blob[header_size]), &compressed_size,
+                                  static_cast<const Bytef*>(data), size, Z_BEST_SPEED);
+        if (ret == Z_OK && compressed_size < size) {
+            blob.resize(header_size + compressed_size);
+            return blob;
+        }
+        // store the raw bytes if they are not compressible (e.g. descriptors)
+    }
+#else
+    (void)compress;
+#endif
+    write_header(blob, codec_t::Raw, size);
+    blob.append(static_cast<const char*>(data), size);
+    return blob;
+}
+
+std::vector<uint8_t> decode(const std::string& blob) {
+    if (blob.size() < header_size) {
+        throw std::runtime_error("corrupted blob: too small");
+    }
+    const auto codec = static_cast<codec_t>(blob[0]);
+    uint32_t raw_size = 0;
+    for (unsigned int i = 0; i < 4; ++i) {
+        raw_size |= static_cast<uint32_t>(static_cast<uint8_t>(blob[1 + i])) << (8 * i);
+    }
+
+    std::vector<uint8_t> bytes(raw_size);
+    switch (codec) {
+        case codec_t::Raw: {
+            if (blob.size() - header_size != raw_size) {
+                throw std::runtime_error("corrupted blob: size mismatch");
+            }
+            if (0 < raw_size) {
+                std::memcpy(bytes.data(), blob.data() + header_size, raw_size);
+            }
+            break;
+        }
+        case codec_t::Zlib: {
+#ifdef USE_ZLIB
+            uLongf decompressed_size = raw_size;
+            const int ret = uncompress(bytes.data(), &decompressed_size,
+                                       reinterpret_cast<const Bytef*>(blob.data() + header_size), blob.size() - header_size);
+            if (ret != Z_OK || decompressed_size != raw_size) {
+                throw std::runtime_error("corrupted blob: cannot decompress");
+            }
+            break;
+#else
+            throw std::runtime_error("the blob is compressed by zlib, but stella_vslam is built without USE_ZLIB");
+#endif
+        }
+        default: {
+            throw std::runtime_error("corrupted blob: unknown codec " + std::to_string(static_cast<int>(codec)));
+        }
+    }
+    return bytes;
+}
+
+} // namespace blob_codec
+} // namespace util
+} // namespace stella_vslam
@@ -0,0 +1,39 @@
+#ifndef STELLA_VSLAM_UTIL_BLOB_CODEC_H
+#define STELLA_VSLAM_UTIL_BLOB_CODEC_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace stella_vslam {
+namespace util {
+namespace blob_codec {
+
+/**
+ * Whether the blobs can be compressed or not (built with USE_ZLIB)
+ */
+bool compression_is_available();
+
+/**
+ * Pack the bytes into a blob, which is a header (the codec and the raw size) followed by the payload
+ * @param data
+ * @param size
+ * @param compress if true, the payload is compressed by zlib (ignored if the compression is not available)
+ * @return blob
+ */
+std::string encode(const void* data, const size_t size, const bool compress);
+
+/**
+ * Unpack the blob
+ * (NOTE: throw std::runtime_error if the blob is corrupted or compressed without the compression available)
+ * @param blob
+ * @return raw bytes
+ */
+std::vector<uint8_t> decode(const std::string& blob);
+
+} // namespace blob_codec
+} // namespace util
+} // namespace stella_vslam
+
+#endif // STELLA_VSLAM_UTIL_BLOB_CODEC_H
@@ -0,0 +1,34 @@
+#include "stella_vslam/util/cpu_budget.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <yaml-cpp/yaml.h>
+
+namespace stella_vslam {
+namespace util {
+
+cpu_budget::cpu_budget(const double core_share, const double max_rest_ms)
+    : core_share_(core_share), max_rest_ms_(max_rest_ms) {
+    if (core_share_ <= 0.0 || 1.0 < core_share_) {
+        throw std::runtime_error("cpu_share must be in (0, 1]");
+    }
+    if (max_rest_ms_ < 0.0) {
+        throw std::runtime_error("max_rest_ms must be non-negative");
+    }
+}
+
+cpu_budget::cpu_budget(const YAML::Node& yaml_node)
+    : cpu_budget(yaml_node["cpu_share"].as<double>(1.0),
+                 yaml_node["max_rest_ms"].as<double>(500.0)) {}
+
+double cpu_budget::get_rest_ms(const double busy_ms) const {
+    if (!is_limited() || busy_ms <= 0.0) {
+        return 0.0;
+    }
+    // busy / (busy + rest) = share
+    return std::min(busy_ms * (1.0 / core_share_ - 1.0), max_rest_ms_);
+}
+
+} // namespace util
+} // namespace stella_vslam
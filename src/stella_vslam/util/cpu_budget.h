@@ -0,0 +1,54 @@
+#ifndef STELLA_VSLAM_UTIL_CPU_BUDGET_H
+#define STELLA_VSLAM_UTIL_CPU_BUDGET_H
+
+namespace YAML {
+class Node;
+} // namespace YAML
+
+namespace stella_vslam {
+namespace util {
+
+/**
+ * Duty cycle of a background thread limited to a share of a core
+ * The thread rests after each burst of work, so that the busy time does not exceed the share of the wall time.
+ * (the wall time of a burst is regarded as its CPU time, which overestimates the usage if the thread is preempted)
+ */
+class cpu_budget {
+public:
+    /**
+     * Constructor
+     * @param core_share max share of a core used by the thread (1 disables the limit)
+     * @param max_rest_ms upper bound of a rest after a burst [ms]
+     */
+    explicit cpu_budget(const double core_share = 1.0, const double max_rest_ms = 500.0);
+
+    /**
+     * Constructor
+     * @param yaml_node (the section of the module, e.g. "Mapping")
+     */
+    explicit cpu_budget(const YAML::Node& yaml_node);
+
+    //! The thread rests after the bursts or not
+    bool is_limited() const { return core_share_ < 1.0; }
+
+    //! Get the max share of a core used by the thread
+    double get_core_share() const { return core_share_; }
+
+    /**
+     * Get the rest time after a burst of work
+     * @param busy_ms duration of the burst [ms]
+     * @return [ms]
+     */
+    double get_rest_ms(const double busy_ms) const;
+
+private:
+    //! max share of a core used by the thread
+    const double core_share_;
+    //! upper bound of a rest after a burst
+    const double max_rest_ms_;
+};
+
+} // namespace util
+} // namespace stella_vslam
+
+#endif // STELLA_VSLAM_UTIL_CPU_BUDGET_H
@@ -0,0 +1,41 @@
+#include "stella_vslam/util/cpu_time.h"
+
+#include <ctime>
+
+namespace stella_vslam {
+namespace util {
+
+#if defined(CLOCK_THREAD_CPUTIME_ID) && defined(CLOCK_PROCESS_CPUTIME_ID)
+
+namespace {
+int64_t get_cpu_time_ns(const clockid_t clock_id) {
+    timespec ts;
+    if (clock_gettime(clock_id, &ts) != 0) {
+        return 0;
+    }
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+} // namespace
+
+int64_t get_current_thread_cpu_time_ns() {
+    return get_cpu_time_ns(CLOCK_THREAD_CPUTIME_ID);
+}
+
+int64_t get_process_cpu_time_ns() {
+    return get_cpu_time_ns(CLOCK_PROCESS_CPUTIME_ID);
+}
+
+#else
+
+int64_t get_current_thread_cpu_time_ns() {
+    return 0;
+}
+
+int64_t get_process_cpu_time_ns() {
+    return 0;
+}
+
+#endif
+
+} // namespace util
+} // namespace stella_vslam
@@ -0,0 +1,40 @@
+#ifndef STELLA_VSLAM_UTIL_CPU_TIME_H
+#define STELLA_VSLAM_UTIL_CPU_TIME_H
+
+#include <atomic>
+#include <cstdint>
+
+namespace stella_vslam {
+namespace util {
+
+//! CPU time consumed by the calling thread [ns] (0 if not supported)
+int64_t get_current_thread_cpu_time_ns();
+
+//! CPU time consumed by all of the threads of the process [ns] (0 if not supported)
+int64_t get_process_cpu_time_ns();
+
+/**
+ * Scope which adds the CPU time consumed by the calling thread during the scope to the counter
+ * (e.g. to account the CPU time of a module thread, whose body is enclosed by the scope)
+ */
+class thread_cpu_time_scope {
+public:
+    explicit thread_cpu_time_scope(std::atomic<int64_t>& counter_ns)
+        : counter_ns_(counter_ns), begin_ns_(get_current_thread_cpu_time_ns()) {}
+
+    ~thread_cpu_time_scope() {
+        counter_ns_ += get_current_thread_cpu_time_ns() - begin_ns_;
+    }
+
+    thread_cpu_time_scope(const thread_cpu_time_scope&) = delete;
+    thread_cpu_time_scope& operator=(const thread_cpu_time_scope&) = delete;
+
+private:
+    std::atomic<int64_t>& counter_ns_;
+    const int64_t begin_ns_;
+};
+
+} // namespace util
+} // namespace stella_vslam
+
+#endif // STELLA_VSLAM_UTIL_CPU_TIME_H
@@ -0,0 +1,56 @@
+#include "stella_vslam/util/frame_arena.h"
+
+#include <algorithm>
+
+namespace stella_vslam {
+namespace util {
+
+frame_arena* frame_arena::get_active_arena() {
+    auto& arena = get_thread_arena();
+    return 0 < arena.scope_depth_ ? &arena : nullptr;
+}
+
+frame_arena& frame_arena::get_thread_arena() {
+    thread_local frame_arena arena;
+    return arena;
+}
+
+void* frame_arena::allocate(const std::size_t bytes, const std::size_t alignment) {
+    if (!blocks_.empty()) {
+        const auto& last_block = blocks_.back();
+        const auto begin = (offset_ + alignment - 1) / alignment * alignment;
+        if (begin + bytes <= last_block.size_) {
+            offset_ = begin + bytes;
+            used_bytes_ += bytes;
+            return last_block.data_.get() + begin;
+        }
+    }
+
+    // (the blocks from new[] are aligned for any fundamental type)
+    const auto block_size = std::max(blocks_.empty() ? initial_block_size : 2 * blocks_.back().size_, bytes);
+    blocks_.push_back(block{std::unique_ptr<unsigned char[]>(new unsigned char[block_size]), block_size});
+    offset_ = bytes;
+    used_bytes_ += bytes;
+    return blocks_.back().data_.get();
+}
+
+void frame_arena::reset() {
+    if (1 < blocks_.size()) {
+        const auto capacity_bytes = get_capacity_bytes();
+        blocks_.clear();
+        blocks_.push_back(block{std::unique_ptr<unsigned char[]>(new unsigned char[capacity_bytes]), capacity_bytes});
+    }
+    offset_ = 0;
+    used_bytes_ = 0;
+}
+
+std::size_t frame_arena::get_capacity_bytes() const {
+    std::size_t capacity_bytes = 0;
+    for (const auto& blk : blocks_) {
+        capacity_bytes += blk.size_;
+    }
+    return capacity_bytes;
+}
+
+} // namespace util
+} // namespace stella_vslam
@@ -0,0 +1,146 @@
+#ifndef STELLA_VSLAM_UTIL_FRAME_ARENA_H
+#define STELLA_VSLAM_UTIL_FRAME_ARENA_H
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <vector>
+
+namespace stella_vslam {
+namespace util {
+
+/**
+ * Per-thread bump arena for the scratch buffers of a frame
+ * The memory is handed out by bumping an offset and is released all at once when the outermost frame_arena_scope of the thread ends.
+ * The blocks are kept for the next frame, so the steady state does not touch the heap.
+ */
+class frame_arena {
+public:
+    //! Size of the first block [bytes]
+    static constexpr std::size_t initial_block_size = 64 * 1024;
+
+    frame_arena() = default;
+
+    frame_arena(const frame_arena&) = delete;
+    frame_arena& operator=(const frame_arena&) = delete;
+
+    //! Get the arena of the calling thread if a frame_arena_scope is active on it, otherwise nullptr
+    static frame_arena* get_active_arena();
+
+    //! Allocate the bytes with the alignment
+    void* allocate(const std::size_t bytes, const std::size_t alignment);
+
+    //! Release all of the allocations
+    //! (the blocks are merged into one which can hold the peak usage)
+    void reset();
+
+    //! Get the bytes allocated since the last reset
+    std::size_t get_used_bytes() const {
+        return used_bytes_;
+    }
+
+    //! Get the total bytes of the blocks
+    std::size_t get_capacity_bytes() const;
+
+private:
+    friend class frame_arena_scope;
+
+    //! Get the arena of the calling thread
+    static frame_arena& get_thread_arena();
+
+    struct block {
+        std::unique_ptr<unsigned char[]> data_;
+        std::size_t size_;
+    };
+
+    //! blocks, the allocations are bumped in the last one
+    std::vector<block> blocks_;
+    //! offset in the last block [bytes]
+    std::size_t offset_ = 0;
+    //! bytes allocated since the last reset
+    std::size_t used_bytes_ = 0;
+    //! depth of the nested frame_arena_scope
+    unsigned int scope_depth_ = 0;
+};
+
+/**
+ * Scope of a frame on the calling thread, whose arena is reset when the outermost one ends
+ * (NOTE: the containers with arena_allocator must not outlive the scope where they are created)
+ */
+class frame_arena_scope {
+public:
+    frame_arena_scope()
+        : arena_(frame_arena::get_thread_arena()) {
+        ++arena_.scope_depth_;
+    }
+
+    ~frame_arena_scope() {
+        if (--arena_.scope_depth_ == 0) {
+            arena_.reset();
+        }
+    }
+
+    frame_arena_scope(const frame_arena_scope&) = delete;
+    frame_arena_scope& operator=(const frame_arena_scope&) = delete;
+
+private:
+    frame_arena& arena_;
+};
+
+/**
+ * Allocator which takes the memory from the active frame_arena of the thread where it is created
+ * (falls back to operator new outside of frame_arena_scope, e.g. on the mapping thread)
+ */
+template<typename T>
+class arena_allocator {
+    static_assert(alignof(T) <= alignof(std::max_align_t), "over-aligned types are not supported");
+
+public:
+    using value_type = T;
+
+    template<typename U>
+    friend class arena_allocator;
+
+    arena_allocator() noexcept
+        : arena_(frame_arena::get_active_arena()) {}
+
+    template<typename U>
+    arena_allocator(const arena_allocator<U>& other) noexcept
+        : arena_(other.arena_) {}
+
+    T* allocate(const std::size_t n) {
+        if (!arena_) {
+            return static_cast<T*>(::operator new(n * sizeof(T)));
+        }
+        return static_cast<T*>(arena_->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T* ptr, const std::size_t) noexcept {
+        // (the arena is released at once at the end of the scope)
+        if (!arena_) {
+            ::operator delete(ptr);
+        }
+    }
+
+    template<typename U>
+    bool operator==(const arena_allocator<U>& other) const noexcept {
+        return arena_ == other.arena_;
+    }
+
+    template<typename U>
+    bool operator!=(const arena_allocator<U>& other) const noexcept {
+        return arena_ != other.arena_;
+    }
+
+private:
+    frame_arena* arena_;
+};
+
+//! std::vector on the frame arena
+template<typename T>
+using arena_vector = std::vector<T, arena_allocator<T>>;
+
+} // namespace util
+} // namespace stella_vslam
+
+#endif // STELLA_VSLAM_UTIL_FRAME_ARENA_H
@@ -0,0 +1,115 @@
+#include "stella_vslam/util/frame_qos.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <yaml-cpp/yaml.h>
+
+namespace stella_vslam {
+namespace util {
+
+frame_skip_policy_t load_frame_skip_policy(const std::string& name) {
+    if (name == "block") {
+        return frame_skip_policy_t::Block;
+    }
+    if (name == "drop_oldest") {
+        return frame_skip_policy_t::DropOldest;
+    }
+    if (name == "drop_non_keyframe_candidates") {
+        return frame_skip_policy_t::DropNonKeyframeCandidates;
+    }
+    throw std::runtime_error("Invalid frame skip policy: " + name);
+}
+
+std::string frame_skip_policy_to_string(const frame_skip_policy_t policy) {
+    switch (policy) {
+        case frame_skip_policy_t::Block:
+            return "block";
+        case frame_skip_policy_t::DropOldest:
+            return "drop_oldest";
+        case frame_skip_policy_t::DropNonKeyframeCandidates:
+            return "drop_non_keyframe_candidates";
+    }
+    return "";
+}
+
+unsigned int select_frame_to_drop(const std::deque<bool>& is_keyframe_candidate, const frame_skip_policy_t policy) {
+    const auto num_frames = static_cast<unsigned int>(is_keyframe_candidate.size());
+    if (num_frames == 0 || policy == frame_skip_policy_t::Block) {
+        return num_frames;
+    }
+    if (policy == frame_skip_policy_t::DropNonKeyframeCandidates) {
+        for (unsigned int idx = 0; idx < num_frames; ++idx) {
+            if (!is_keyframe_candidate.at(idx)) {
+                return idx;
+            }
+        }
+    }
+    return 0;
+}
+
+frame_qos_controller::frame_qos_controller(const double frame_period_ms,
+                                           const double high_load_ratio,
+                                           const double low_load_ratio,
+                                           const unsigned int num_frames_to_degrade,
+                                           const unsigned int num_frames_to_recover,
+                                           const frame_degradation_level_t max_level)
+    : frame_period_ms_(frame_period_ms), high_load_ratio_(high_load_ratio), low_load_ratio_(low_load_ratio),
+      num_frames_to_degrade_(num_frames_to_degrade), num_frames_to_recover_(num_frames_to_recover), max_level_(max_level) {
+    if (frame_period_ms_ <= 0.0) {
+        throw std::runtime_error("frame_period_ms must be greater than 0");
+    }
+    if (low_load_ratio_ >= high_load_ratio_) {
+        throw std::runtime_error("low_load_ratio must be less than high_load_ratio");
+    }
+}
+
+frame_qos_controller::frame_qos_controller(const YAML::Node& yaml_node, const double default_frame_period_ms)
+    : frame_qos_controller(yaml_node["frame_period_ms"].as<double>(default_frame_period_ms),
+                           yaml_node["high_load_ratio"].as<double>(1.0),
+                           yaml_node["low_load_ratio"].as<double>(0.6),
+                           yaml_node["num_frames_to_degrade"].as<unsigned int>(3),
+                           yaml_node["num_frames_to_recover"].as<unsigned int>(30),
+                           static_cast<frame_degradation_level_t>(
+                               std::min(yaml_node["max_degradation_level"].as<unsigned int>(3), 3u))) {}
+
+bool frame_qos_controller::update(const double elapsed_ms) {
+    constexpr double alpha = 0.3;
+    average_ms_ = (average_ms_ == 0.0) ? elapsed_ms : (1.0 - alpha) * average_ms_ + alpha * elapsed_ms;
+
+    const auto prev_level = level_;
+    const auto level = static_cast<unsigned int>(level_);
+    if (high_load_ratio_ * frame_period_ms_ < average_ms_) {
+        num_underloaded_frames_ = 0;
+        ++num_overloaded_frames_;
+        if (num_frames_to_degrade_ <= num_overloaded_frames_ && level_ != max_level_) {
+            level_ = static_cast<frame_degradation_level_t>(level + 1);
+            num_overloaded_frames_ = 0;
+        }
+    }
+    else if (average_ms_ < low_load_ratio_ * frame_period_ms_) {
+        num_overloaded_frames_ = 0;
+        ++num_underloaded_frames_;
+        if (num_frames_to_recover_ <= num_underloaded_frames_ && level_ != frame_degradation_level_t::None) {
+            level_ = static_cast<frame_degradation_level_t>(level - 1);
+            num_underloaded_frames_ = 0;
+        }
+    }
+    else {
+        num_overloaded_frames_ = 0;
+        num_underloaded_frames_ = 0;
+    }
+    return level_ != prev_level;
+}
+
+bool frame_qos_controller::should_drop(const bool is_keyframe_candidate) {
+    if (level_ != frame_degradation_level_t::DropFrames || is_keyframe_candidate || last_frame_is_dropped_) {
+        last_frame_is_dropped_ = false;
+        return false;
+    }
+    last_frame_is_dropped_ = true;
+    return true;
+}
+
+} // namespace util
+} // namespace stella_vslam
@@ -0,0 +1,130 @@
+#ifndef STELLA_VSLAM_UTIL_FRAME_QOS_H
+#define STELLA_VSLAM_UTIL_FRAME_QOS_H
+
+#include <deque>
+#include <string>
+
+namespace YAML {
+class Node;
+} // namespace YAML
+
+namespace stella_vslam {
+namespace util {
+
+//! Policy of the frame mailbox when a frame is submitted while it is full
+enum class frame_skip_policy_t {
+    //! block the caller until a frame is taken (no frame is dropped)
+    Block,
+    //! drop the oldest waiting frame (the latest frame wins)
+    DropOldest,
+    //! drop the oldest waiting frame which is not a keyframe candidate, or the oldest one if all of them are
+    DropNonKeyframeCandidates
+};
+
+frame_skip_policy_t load_frame_skip_policy(const std::string& name);
+
+std::string frame_skip_policy_to_string(const frame_skip_policy_t policy);
+
+/**
+ * Select the waiting frame to drop by the policy
+ * @param is_keyframe_candidate flags of the waiting frames (oldest first)
+ * @param policy
+ * @return index of the frame to drop (the size of the flags if nothing should be dropped)
+ */
+unsigned int select_frame_to_drop(const std::deque<bool>& is_keyframe_candidate, const frame_skip_policy_t policy);
+
+//! Degradation levels chosen by frame_qos_controller (each level includes the ones below)
+enum class frame_degradation_level_t : unsigned int {
+    //! full processing
+    None = 0,
+    //! skip the local map refresh on the frames confidently tracked with the motion model
+    SkipLocalMapRefresh = 1,
+    //! lower the number of the keypoints by the time budget of the ORB extraction
+    ReduceKeypoints = 2,
+    //! drop every other frame which is not a keyframe candidate
+    DropFrames = 3
+};
+
+/**
+ * Controller which chooses the degradation level from the measured processing times of the frames
+ * The level is raised after the average time has exceeded the frame period (times high_load_ratio) for several frames,
+ * and lowered after it has stayed below the frame period times low_load_ratio for more frames.
+ */
+class frame_qos_controller {
+public:
+    /**
+     * Constructor
+     * @param frame_period_ms period of the input frames [ms]
+     * @param high_load_ratio ratio of the frame period above which the level is raised
+     * @param low_load_ratio ratio of the frame period below which the level is lowered
+     * @param num_frames_to_degrade number of the consecutive overloaded frames to raise the level
+     * @param num_frames_to_recover number of the consecutive underloaded frames to lower the level
+     * @param max_level maximum degradation level
+     */
+    frame_qos_controller(const double frame_period_ms,
+                         const double high_load_ratio = 1.0,
+                         const double low_load_ratio = 0.6,
+                         const unsigned int num_frames_to_degrade = 3,
+                         const unsigned int num_frames_to_recover = 30,
+                         const frame_degradation_level_t max_level = frame_degradation_level_t::DropFrames);
+
+    /**
+     * Constructor
+     * @param yaml_node (the "QoS" section)
+     * @param default_frame_period_ms frame period used if frame_period_ms is not given (e.g. from Camera.fps)
+     */
+    frame_qos_controller(const YAML::Node& yaml_node, const double default_frame_period_ms);
+
+    /**
+     * Record the processing time of a frame and update the degradation level
+     * @param elapsed_ms
+     * @return true if the level is changed
+     */
+    bool update(const double elapsed_ms);
+
+    //! Get the current degradation level
+    frame_degradation_level_t get_level() const { return level_; }
+
+    //! Get the exponential moving average of the processing times [ms]
+    double get_average_ms() const { return average_ms_; }
+
+    //! Get the period of the input frames [ms]
+    double get_frame_period_ms() const { return frame_period_ms_; }
+
+    /**
+     * Check if the frame should be dropped at the current level (called for each frame taken from the mailbox)
+     * @param is_keyframe_candidate
+     * @return
+     */
+    bool should_drop(const bool is_keyframe_candidate);
+
+private:
+    //! period of the input frames
+    const double frame_period_ms_;
+    //! ratio of the frame period above which the level is raised
+    const double high_load_ratio_;
+    //! ratio of the frame period below which the level is lowered
+    const double low_load_ratio_;
+    //! number of the consecutive overloaded frames to raise the level
+    const unsigned int num_frames_to_degrade_;
+    //! number of the consecutive underloaded frames to lower the level
+    const unsigned int num_frames_to_recover_;
+    //! maximum degradation level
+    const frame_degradation_level_t max_level_;
+
+    //! current degradation level
+    frame_degradation_level_t level_ = frame_degradation_level_t::None;
+    //! exponential moving average of the processing times (0 until the first frame)
+    double average_ms_ = 0.0;
+    //! number of the consecutive overloaded frames
+    unsigned int num_overloaded_frames_ = 0;
+    //! number of the consecutive underloaded frames
+    unsigned int num_underloaded_frames_ = 0;
+    //! the last frame was dropped or not (to drop every other frame)
+    bool last_frame_is_dropped_ = false;
+};
+
+} // namespace util
+} // namespace stella_vslam
+
+#endif // STELLA_VSLAM_UTIL_FRAME_QOS_H
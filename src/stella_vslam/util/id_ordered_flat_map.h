@@ -0,0 +1,109 @@
+#ifndef STELLA_VSLAM_UTIL_ID_ORDERED_FLAT_MAP_H
+#define STELLA_VSLAM_UTIL_ID_ORDERED_FLAT_MAP_H
+
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace stella_vslam {
+namespace util {
+
+/**
+ * Map from weak pointers of the objects with id_ member (e.g. keyframes) to values, stored in contiguous arrays sorted by ID
+ * It is a drop-in replacement of std::map<std::weak_ptr<T>, U, id_less<std::weak_ptr<T>>> for the small maps,
+ * which avoids a heap allocation per element and the ID comparisons involving weak_ptr::lock().
+ * (NOTE: the elements cannot be modified via the iterators)
+ */
+template<typename T, typename U>
+class id_ordered_flat_map {
+public:
+    using key_type = std::weak_ptr<T>;
+    using mapped_type = U;
+    using value_type = std::pair<std::weak_ptr<T>, U>;
+    using const_iterator = typename std::vector<value_type>::const_iterator;
+    using size_type = typename std::vector<value_type>::size_type;
+
+    const_iterator begin() const { return elems_.begin(); }
+    const_iterator end() const { return elems_.end(); }
+
+    size_type size() const { return elems_.size(); }
+    bool empty() const { return elems_.empty(); }
+
+    //! Bytes of the arrays
+    size_t get_memory_bytes() const { return ids_.capacity() * sizeof(unsigned int) + elems_.capacity() * sizeof(value_type); }
+
+    void clear() {
+        ids_.clear();
+        elems_.clear();
+    }
+
+    void reserve(const size_type size) {
+        ids_.reserve(size);
+        elems_.reserve(size);
+    }
+
+    //! Get the number of the elements with the key (0 or 1)
+    size_type count(const std::shared_ptr<T>& key) const {
+        return key && find_index(key->id_) < ids_.size() ? 1 : 0;
+    }
+    size_type count(const std::weak_ptr<T>& key) const {
+        return count(key.lock());
+    }
+
+    //! Get the value with the key (throws std::out_of_range if the key does not exist)
+    const U& at(const std::shared_ptr<T>& key) const {
+        const auto idx = key ? find_index(key->id_) : ids_.size();
+        if (ids_.size() <= idx) {
+            throw std::out_of_range("id_ordered_flat_map::at");
+        }
+        return elems_[idx].second;
+    }
+    const U& at(const std::weak_ptr<T>& key) const {
+        return at(key.lock());
+    }
+
+    //! Get the value with the key, which is inserted if it does not exist
+    U& operator[](const std::shared_ptr<T>& key) {
+        const auto iter = std::lower_bound(ids_.begin(), ids_.end(), key->id_);
+        const auto idx = static_cast<size_type>(iter - ids_.begin());
+        if (iter == ids_.end() || *iter != key->id_) {
+            ids_.insert(iter, key->id_);
+            elems_.insert(elems_.begin() + idx, value_type(key, U()));
+        }
+        return elems_[idx].second;
+    }
+
+    //! Erase the element with the key and get the number of the erased elements (0 or 1)
+    size_type erase(const std::shared_ptr<T>& key) {
+        const auto idx = key ? find_index(key->id_) : ids_.size();
+        if (ids_.size() <= idx) {
+            return 0;
+        }
+        ids_.erase(ids_.begin() + idx);
+        elems_.erase(elems_.begin() + idx);
+        return 1;
+    }
+
+private:
+    //! Get the index of the element with the ID (ids_.size() if it does not exist)
+    template<typename Id>
+    size_type find_index(const Id id) const {
+        const auto iter = std::lower_bound(ids_.begin(), ids_.end(), id);
+        if (iter == ids_.end() || *iter != id) {
+            return ids_.size();
+        }
+        return static_cast<size_type>(iter - ids_.begin());
+    }
+
+    //! sorted IDs of the keys (same order as elems_)
+    std::vector<unsigned int> ids_;
+    //! keys and values
+    std::vector<value_type> elems_;
+};
+
+} // namespace util
+} // namespace stella_vslam
+
+#endif // STELLA_VSLAM_UTIL_ID_ORDERED_FLAT_MAP_H
@@ -1,10 +1,56 @@
 #include "stella_vslam/util/image_converter.h"
 
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
 #include <opencv2/imgproc.hpp>
 
 namespace stella_vslam {
 namespace util {
 
+cv::Mat get_grayscale_view(const image_buffer& buf, cv::Mat& gray_buf) {
+    if (buf.empty()) {
+        return cv::Mat();
+    }
+    const int rows = buf.height_;
+    const int cols = buf.width_;
+    auto* data = const_cast<uint8_t*>(buf.data_);
+    const auto step = [&buf](const size_t bytes_per_pixel) {
+        return buf.stride_ ? buf.stride_ : buf.width_ * bytes_per_pixel;
+    };
+
+    switch (buf.format_) {
+        case pixel_format_t::Gray:
+        case pixel_format_t::NV12: {
+            // the Y plane is used as the grayscale image
+            return cv::Mat(rows, cols, CV_8UC1, data, step(1));
+        }
+        case pixel_format_t::RGB: {
+            cv::cvtColor(cv::Mat(rows, cols, CV_8UC3, data, step(3)), gray_buf, cv::COLOR_RGB2GRAY);
+            return gray_buf;
+        }
+        case pixel_format_t::BGR: {
+            cv::cvtColor(cv::Mat(rows, cols, CV_8UC3, data, step(3)), gray_buf, cv::COLOR_BGR2GRAY);
+            return gray_buf;
+        }
+        case pixel_format_t::RGBA: {
+            cv::cvtColor(cv::Mat(rows, cols, CV_8UC4, data, step(4)), gray_buf, cv::COLOR_RGBA2GRAY);
+            return gray_buf;
+        }
+        case pixel_format_t::BGRA: {
+            cv::cvtColor(cv::Mat(rows, cols, CV_8UC4, data, step(4)), gray_buf, cv::COLOR_BGRA2GRAY);
+            return gray_buf;
+        }
+        case pixel_format_t::YUYV: {
+            // the Y channel is extracted in a single pass
+            cv::cvtColor(cv::Mat(rows, cols, CV_8UC2, data, step(2)), gray_buf, cv::COLOR_YUV2GRAY_YUY2);
+            return gray_buf;
+        }
+    }
+    throw std::runtime_error("unsupported pixel format of the image buffer");
+}
+
 void convert_to_grayscale(cv::Mat& img, const camera::color_order_t in_color_order) {
     if (img.channels() == 3) {
         switch (in_color_order) {
@@ -42,6 +88,47 @@ void convert_to_true_depth(cv::Mat& img, const double depthmap_factor) {
     img.convertTo(img, CV_32F, 1.0 / depthmap_factor);
 }
 
+namespace {
+float get_raw_depth(const cv::Mat& depthmap, const int x, const int y) {
+    switch (depthmap.depth()) {
+        case CV_16U:
+            return depthmap.at<unsigned short>(y, x);
+        case CV_32F:
+            return depthmap.at<float>(y, x);
+        case CV_64F:
+            return depthmap.at<double>(y, x);
+        default:
+            throw std::runtime_error("unsupported type of the depthmap");
+    }
+}
+} // namespace
+
+float sample_true_depth(const cv::Mat& depthmap, const float x, const float y, const double depthmap_factor,
+                        const float max_depth_diff_ratio) {
+    const int ix = static_cast<int>(x);
+    const int iy = static_cast<int>(y);
+    if (ix < 0 || iy < 0 || depthmap.cols <= ix || depthmap.rows <= iy) {
+        return -1.0;
+    }
+
+    const float depth = get_raw_depth(depthmap, ix, iy) / depthmap_factor;
+    if (depth <= 0 || max_depth_diff_ratio <= 0) {
+        return depth;
+    }
+
+    // check the consistency with the valid depths of the neighbors
+    const float max_depth_diff = max_depth_diff_ratio * depth;
+    for (int ny = std::max(0, iy - 1); ny <= std::min(depthmap.rows - 1, iy + 1); ++ny) {
+        for (int nx = std::max(0, ix - 1); nx <= std::min(depthmap.cols - 1, ix + 1); ++nx) {
+            const float neighbor_depth = get_raw_depth(depthmap, nx, ny) / depthmap_factor;
+            if (0 < neighbor_depth && max_depth_diff < std::abs(neighbor_depth - depth)) {
+                return -1.0;
+            }
+        }
+    }
+    return depth;
+}
+
 void equalize_histogram(cv::Mat& img) {
     assert(img.type() == CV_8UC1 || img.type() == CV_16UC1);
     if (img.type() == CV_16UC1) {
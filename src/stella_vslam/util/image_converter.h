@@ -3,15 +3,93 @@
 
 #include "stella_vslam/camera/base.h"
 
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
 #include <opencv2/core/mat.hpp>
 
 namespace stella_vslam {
 namespace util {
 
+enum class pixel_format_t {
+    Gray,
+    RGB,
+    BGR,
+    RGBA,
+    BGRA,
+    //! 8-bit Y plane followed by the interleaved UV plane (only the Y plane is read)
+    NV12,
+    //! packed 4:2:2 (Y0 U Y1 V)
+    YUYV
+};
+
+/**
+ * Image in a buffer which is owned by the caller (e.g. DMA-buf of V4L2, GStreamer or a camera SDK)
+ * (the buffer is not copied and must be valid until release_ is called)
+ */
+struct image_buffer {
+    //! pointer to the first pixel (the Y plane for NV12)
+    const uint8_t* data_ = nullptr;
+    unsigned int width_ = 0;
+    unsigned int height_ = 0;
+    //! bytes per row (0: no padding)
+    size_t stride_ = 0;
+    pixel_format_t format_ = pixel_format_t::Gray;
+    //! called once the library does not refer to the buffer anymore (optional)
+    std::function<void()> release_;
+
+    bool empty() const {
+        return !data_ || width_ == 0 || height_ == 0;
+    }
+};
+
+/**
+ * Get the grayscale image of the buffer
+ * (the Gray and NV12 buffers are wrapped without copying, the other formats are converted into gray_buf,
+ *  whose allocation is reused while the image size is unchanged)
+ * @param buf
+ * @param gray_buf
+ * @return CV_8UC1 image (which refers to either buf or gray_buf)
+ */
+cv::Mat get_grayscale_view(const image_buffer& buf, cv::Mat& gray_buf);
+
+//! Call the release callback of the image buffer on the destruction
+class scoped_image_buffer_release {
+public:
+    explicit scoped_image_buffer_release(const image_buffer& buf)
+        : buf_(buf) {}
+
+    ~scoped_image_buffer_release() {
+        if (buf_.release_) {
+            buf_.release_();
+        }
+    }
+
+    scoped_image_buffer_release(const scoped_image_buffer_release&) = delete;
+    scoped_image_buffer_release& operator=(const scoped_image_buffer_release&) = delete;
+
+private:
+    const image_buffer& buf_;
+};
+
 void convert_to_grayscale(cv::Mat& img, const camera::color_order_t in_color_order);
 
 void convert_to_true_depth(cv::Mat& img, const double depthmap_factor);
 
+/**
+ * Sample the true depth at the pixel from the raw depthmap without converting the whole image
+ * @param depthmap raw depthmap (CV_16U, CV_32F or CV_64F)
+ * @param x
+ * @param y
+ * @param depthmap_factor (pixel_value / depthmap_factor = true_depth)
+ * @param max_depth_diff_ratio if positive, the depth is invalidated when a valid depth of the 3x3 neighbors differs
+ *                             more than this ratio of the depth (e.g. at the object boundaries)
+ * @return true depth (not positive if invalid)
+ */
+float sample_true_depth(const cv::Mat& depthmap, const float x, const float y, const double depthmap_factor,
+                        const float max_depth_diff_ratio = 0.0);
+
 void equalize_histogram(cv::Mat& img);
 
 } // namespace util
@@ -0,0 +1,206 @@
+#include "stella_vslam/util/keyframe_tracer.h"
+#include "stella_vslam/util/latency_profiler.h"
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include <nlohmann/json.hpp>
+
+namespace stella_vslam {
+namespace util {
+
+keyframe_tracer::keyframe_tracer(const unsigned int capacity)
+    : capacity_(capacity) {}
+
+void keyframe_tracer::record(const unsigned int keyfrm_id, const keyframe_stage_t stage) {
+    const auto now_us = latency_profiler::now_us();
+    std::lock_guard<std::mutex> lock(mtx_);
+    record(keyfrm_id, stage, now_us);
+}
+
+void keyframe_tracer::record(const std::vector<unsigned int>& keyfrm_ids, const keyframe_stage_t stage) {
+    const auto now_us = latency_profiler::now_us();
+    std::lock_guard<std::mutex> lock(mtx_);
+    for (const auto keyfrm_id : keyfrm_ids) {
+        record(keyfrm_id, stage, now_us);
+    }
+}
+
+void keyframe_tracer::record(const unsigned int keyfrm_id, const keyframe_stage_t stage, const int64_t now_us) {
+    if (capacity_ == 0) {
+        return;
+    }
+
+    auto itr = records_.find(keyfrm_id);
+    if (itr == records_.end()) {
+        // the record of an older keyframe than the kept ones has been discarded
+        if (capacity_ <= records_.size() && keyfrm_id < records_.begin()->first) {
+            return;
+        }
+        keyframe_lifecycle lifecycle;
+        lifecycle.keyfrm_id_ = keyfrm_id;
+        lifecycle.stage_us_.fill(0);
+        itr = records_.emplace(keyfrm_id, lifecycle).first;
+        while (capacity_ < records_.size()) {
+            records_.erase(records_.begin());
+        }
+    }
+
+    auto& stage_us = itr->second.stage_us_;
+    const auto stage_idx = static_cast<unsigned int>(stage);
+    if (stage_us.at(stage_idx) != 0) {
+        // the ID has been reused after the map was reset if a keyframe is created or queued again
+        if (stage != keyframe_stage_t::Created && stage != keyframe_stage_t::Queued) {
+            return;
+        }
+        stage_us.fill(0);
+    }
+    stage_us.at(stage_idx) = now_us;
+
+    const auto preceding_stage_us = stage_us.at(static_cast<unsigned int>(get_preceding_stage(stage)));
+    if (stage != keyframe_stage_t::Created && preceding_stage_us != 0) {
+        observe(interval_hists_.at(stage_idx), now_us - preceding_stage_us);
+    }
+    const auto created_us = stage_us.at(static_cast<unsigned int>(keyframe_stage_t::Created));
+    if (stage == keyframe_stage_t::LoopChecked && created_us != 0) {
+        observe(total_hist_, now_us - created_us);
+    }
+}
+
+void keyframe_tracer::observe(histogram& hist, const int64_t duration_us) {
+    const double duration_ms = duration_us / 1000.0;
+    unsigned int bucket = 0;
+    while (bucket + 1 < num_buckets && get_bucket_upper_bound_ms(bucket) < duration_ms) {
+        ++bucket;
+    }
+    ++hist.counts_.at(bucket);
+    hist.sum_ms_ += duration_ms;
+}
+
+std::vector<keyframe_lifecycle> keyframe_tracer::get_records() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    std::vector<keyframe_lifecycle> records;
+    records.reserve(records_.size());
+    for (const auto& id_record : records_) {
+        records.push_back(id_record.second);
+    }
+    return records;
+}
+
+void keyframe_tracer::clear() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    records_.clear();
+    interval_hists_.fill(histogram());
+    total_hist_ = histogram();
+}
+
+std::string keyframe_tracer::get_prometheus_text(const std::string& prefix) const {
+    std::ostringstream oss;
+    oss.precision(17);
+    const auto write_histogram = [&oss](const std::string& name, const std::string& labels, const histogram& hist) {
+        const auto label_prefix = labels.empty() ? std::string("") : labels + ",";
+        uint64_t cumulative_count = 0;
+        for (unsigned int bucket = 0; bucket < num_buckets; ++bucket) {
+            cumulative_count += hist.counts_.at(bucket);
+            oss << name << "_bucket{" << label_prefix << "le=\"";
+            if (bucket + 1 < num_buckets) {
+                oss << get_bucket_upper_bound_ms(bucket);
+            }
+            else {
+                oss << "+Inf";
+            }
+            oss << "\"} " << cumulative_count << "\n";
+        }
+        oss << name << "_sum" << (labels.empty() ? "" : "{" + labels + "}") << " " << hist.sum_ms_ << "\n";
+        oss << name << "_count" << (labels.empty() ? "" : "{" + labels + "}") << " " << cumulative_count << "\n";
+    };
+
+    std::lock_guard<std::mutex> lock(mtx_);
+    const auto stage_name = prefix + "keyframe_stage_latency_ms";
+    oss << "# HELP " << stage_name << " time spent by a keyframe before reaching each stage [ms]\n";
+    oss << "# TYPE " << stage_name << " histogram\n";
+    for (unsigned int stage_idx = 1; stage_idx < num_keyframe_stages; ++stage_idx) {
+        const auto stage = static_cast<keyframe_stage_t>(stage_idx);
+        write_histogram(stage_name, std::string("stage=\"") + get_interval_name(stage) + "\"", interval_hists_.at(stage_idx));
+    }
+    const auto total_name = prefix + "keyframe_total_latency_ms";
+    oss << "# HELP " << total_name << " time from the creation of a keyframe to the end of its loop detection [ms]\n";
+    oss << "# TYPE " << total_name << " histogram\n";
+    write_histogram(total_name, "", total_hist_);
+    return oss.str();
+}
+
+void keyframe_tracer::save_chrome_trace(const std::string& path) const {
+    nlohmann::json events = nlohmann::json::array();
+    for (const auto& record : get_records()) {
+        for (unsigned int stage_idx = 1; stage_idx < num_keyframe_stages; ++stage_idx) {
+            const auto stage = static_cast<keyframe_stage_t>(stage_idx);
+            const auto end_us = record.stage_us_.at(stage_idx);
+            const auto begin_us = record.stage_us_.at(static_cast<unsigned int>(get_preceding_stage(stage)));
+            if (end_us == 0 || begin_us == 0) {
+                continue;
+            }
+            // (a row per stage)
+            events.push_back({{"name", get_interval_name(stage)},
+                              {"ph", "X"},
+                              {"ts", begin_us},
+                              {"dur", end_us - begin_us},
+                              {"pid", 1},
+                              {"tid", stage_idx},
+                              {"args", {{"keyframe_id", record.keyfrm_id_}}}});
+        }
+    }
+
+    std::ofstream ofs(path, std::ios::out);
+    if (!ofs.is_open()) {
+        throw std::runtime_error("cannot create a file at " + path);
+    }
+    ofs << nlohmann::json{{"traceEvents", events}, {"displayTimeUnit", "ms"}}.dump();
+}
+
+const char* keyframe_tracer::get_interval_name(const keyframe_stage_t stage) {
+    switch (stage) {
+        case keyframe_stage_t::Created:
+            return "created";
+        case keyframe_stage_t::Queued:
+            return "insertion";
+        case keyframe_stage_t::MappingStarted:
+            return "mapping_queue";
+        case keyframe_stage_t::LocalBA:
+            return "local_BA";
+        case keyframe_stage_t::Mapped:
+            return "mapping";
+        case keyframe_stage_t::LoopCheckStarted:
+            return "loop_queue";
+        case keyframe_stage_t::LoopChecked:
+            return "loop_detection";
+    }
+    return "";
+}
+
+keyframe_stage_t keyframe_tracer::get_preceding_stage(const keyframe_stage_t stage) {
+    switch (stage) {
+        case keyframe_stage_t::Created:
+            return keyframe_stage_t::Created;
+        case keyframe_stage_t::Queued:
+            return keyframe_stage_t::Created;
+        case keyframe_stage_t::MappingStarted:
+            return keyframe_stage_t::Queued;
+        case keyframe_stage_t::LocalBA:
+        case keyframe_stage_t::Mapped:
+            return keyframe_stage_t::MappingStarted;
+        case keyframe_stage_t::LoopCheckStarted:
+            return keyframe_stage_t::Mapped;
+        case keyframe_stage_t::LoopChecked:
+            return keyframe_stage_t::LoopCheckStarted;
+    }
+    return stage;
+}
+
+double keyframe_tracer::get_bucket_upper_bound_ms(const unsigned int bucket) {
+    return static_cast<double>(static_cast<uint64_t>(1) << bucket);
+}
+
+} // namespace util
+} // namespace stella_vslam
@@ -0,0 +1,111 @@
+#ifndef STELLA_VSLAM_UTIL_KEYFRAME_TRACER_H
+#define STELLA_VSLAM_UTIL_KEYFRAME_TRACER_H
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace stella_vslam {
+namespace util {
+
+//! Stage of the lifecycle of a keyframe
+enum class keyframe_stage_t : unsigned int {
+    //! created by keyframe_inserter
+    Created = 0,
+    //! queued to the mapping module
+    Queued = 1,
+    //! dequeued by the mapping module
+    MappingStarted = 2,
+    //! included in a finished local BA
+    LocalBA = 3,
+    //! processed by the mapping module and sent to the global optimization module
+    Mapped = 4,
+    //! dequeued by the global optimization module
+    LoopCheckStarted = 5,
+    //! loop detection (and validation) finished
+    LoopChecked = 6
+};
+
+//! Number of the stages
+constexpr unsigned int num_keyframe_stages = 7;
+
+//! Timestamps of the stages of a keyframe
+struct keyframe_lifecycle {
+    unsigned int keyfrm_id_;
+    //! time when the keyframe reached each stage [us] (steady clock, 0: not reached)
+    std::array<int64_t, num_keyframe_stages> stage_us_;
+};
+
+/**
+ * Per-keyframe timestamps of the stages from the creation to the loop detection,
+ * and the histograms of the time spent before each stage
+ * (the latest keyframes are kept, and the records of the older ones are discarded)
+ */
+class keyframe_tracer {
+public:
+    //! Number of the buckets of the histograms (the upper bounds are 1, 2, 4, ..., 2^15 [ms] and infinity)
+    static constexpr unsigned int num_buckets = 17;
+
+    //! Constructor
+    //! (capacity is the maximum number of the keyframes kept)
+    explicit keyframe_tracer(const unsigned int capacity);
+
+    //! Record the time when the keyframe reached the stage (only the first time is recorded)
+    void record(const unsigned int keyfrm_id, const keyframe_stage_t stage);
+
+    //! Record the time when the keyframes reached the stage
+    void record(const std::vector<unsigned int>& keyfrm_ids, const keyframe_stage_t stage);
+
+    //! Get the records (ordered by the keyframe ID)
+    std::vector<keyframe_lifecycle> get_records() const;
+
+    //! Clear the records and the histograms
+    void clear();
+
+    //! Get the histograms in the Prometheus text exposition format
+    std::string get_prometheus_text(const std::string& prefix) const;
+
+    //! Save the records in the Chrome trace event format (chrome://tracing, Perfetto)
+    void save_chrome_trace(const std::string& path) const;
+
+    //! Name of the interval which ends at the stage (e.g. "mapping_queue" for MappingStarted)
+    static const char* get_interval_name(const keyframe_stage_t stage);
+
+    //! Stage where the interval which ends at the stage begins (the stage itself for Created)
+    static keyframe_stage_t get_preceding_stage(const keyframe_stage_t stage);
+
+    //! Upper bound of the bucket [ms]
+    static double get_bucket_upper_bound_ms(const unsigned int bucket);
+
+private:
+    struct histogram {
+        std::array<uint64_t, num_buckets> counts_{};
+        double sum_ms_ = 0.0;
+    };
+
+    //! Add the duration to the histogram (mtx_ must be locked)
+    void observe(histogram& hist, const int64_t duration_us);
+
+    //! Record the stage with the given time (mtx_ must be locked)
+    void record(const unsigned int keyfrm_id, const keyframe_stage_t stage, const int64_t now_us);
+
+    //! maximum number of the records
+    const unsigned int capacity_;
+
+    //! mutex for the records and the histograms
+    mutable std::mutex mtx_;
+    //! records ordered by the keyframe ID
+    std::map<unsigned int, keyframe_lifecycle> records_;
+    //! histograms of the intervals which end at each stage
+    std::array<histogram, num_keyframe_stages> interval_hists_;
+    //! histogram of the total time from the creation to the loop detection
+    histogram total_hist_;
+};
+
+} // namespace util
+} // namespace stella_vslam
+
+#endif // STELLA_VSLAM_UTIL_KEYFRAME_TRACER_H
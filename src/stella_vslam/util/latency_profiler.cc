@@ -0,0 +1,111 @@
+#include "stella_vslam/util/latency_profiler.h"
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <stdexcept>
+
+#include <nlohmann/json.hpp>
+
+namespace stella_vslam {
+namespace util {
+
+namespace {
+//! upper bound of the spans buffered on a thread without commit (to bound the memory on unprofiled threads)
+constexpr size_t max_num_thread_spans = 4096;
+
+std::vector<latency_span>& get_thread_spans() {
+    thread_local std::vector<latency_span> spans;
+    return spans;
+}
+
+unsigned int get_thread_id() {
+    static std::atomic<unsigned int> next_thread_id{0};
+    thread_local const unsigned int thread_id = next_thread_id++;
+    return thread_id;
+}
+} // namespace
+
+latency_profiler::latency_profiler(const unsigned int capacity)
+    : capacity_(capacity) {}
+
+void latency_profiler::commit_frame(const unsigned int frame_id, const double timestamp, std::vector<latency_span> spans) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    frame_latency record{frame_id, timestamp, std::move(spans)};
+    if (callback_) {
+        callback_(record);
+    }
+    if (capacity_ == 0) {
+        return;
+    }
+    while (capacity_ <= records_.size()) {
+        records_.pop_front();
+    }
+    records_.push_back(std::move(record));
+}
+
+void latency_profiler::set_callback(const std::function<void(const frame_latency&)>& callback) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    callback_ = callback;
+}
+
+std::vector<frame_latency> latency_profiler::get_records() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return std::vector<frame_latency>(records_.begin(), records_.end());
+}
+
+void latency_profiler::clear() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    records_.clear();
+}
+
+void latency_profiler::save_chrome_trace(const std::string& path) const {
+    nlohmann::json events = nlohmann::json::array();
+    for (const auto& record : get_records()) {
+        for (const auto& span : record.spans_) {
+            events.push_back({{"name", span.name_},
+                              {"ph", "X"},
+                              {"ts", span.begin_us_},
+                              {"dur", span.duration_us_},
+                              {"pid", 0},
+                              {"tid", span.thread_id_},
+                              {"args", {{"frame_id", record.frame_id_},
+                                        {"timestamp", record.timestamp_},
+                                        {"num_allocs", span.num_allocs_},
+                                        {"alloc_bytes", span.alloc_bytes_}}}});
+        }
+    }
+
+    std::ofstream ofs(path, std::ios::out);
+    if (!ofs.is_open()) {
+        throw std::runtime_error("cannot create a file at " + path);
+    }
+    ofs << nlohmann::json{{"traceEvents", events}, {"displayTimeUnit", "ms"}}.dump();
+}
+
+int64_t latency_profiler::now_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void latency_profiler::record_span(const char* name, const int64_t begin_us, const int64_t end_us,
+                                   const uint64_t num_allocs, const uint64_t alloc_bytes) {
+    auto& spans = get_thread_spans();
+    if (max_num_thread_spans <= spans.size()) {
+        return;
+    }
+    spans.push_back(latency_span{name, begin_us, end_us - begin_us, get_thread_id(), num_allocs, alloc_bytes});
+}
+
+std::vector<latency_span> latency_profiler::take_thread_spans() {
+    std::vector<latency_span> spans;
+    spans.swap(get_thread_spans());
+    return spans;
+}
+
+void latency_profiler::append_thread_spans(const std::vector<latency_span>& spans) {
+    auto& thread_spans = get_thread_spans();
+    thread_spans.insert(thread_spans.end(), spans.begin(), spans.end());
+}
+
+} // namespace util
+} // namespace stella_vslam
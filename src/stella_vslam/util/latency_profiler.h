@@ -0,0 +1,125 @@
+#ifndef STELLA_VSLAM_UTIL_LATENCY_PROFILER_H
+#define STELLA_VSLAM_UTIL_LATENCY_PROFILER_H
+
+#include "stella_vslam/util/allocation_counter.h"
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace stella_vslam {
+namespace util {
+
+//! Time span recorded by scoped_latency_span
+struct latency_span {
+    //! name of the span (must be a string literal)
+    const char* name_;
+    //! begin time of the span [us] (steady clock)
+    int64_t begin_us_;
+    //! duration of the span [us]
+    int64_t duration_us_;
+    //! sequential ID of the thread which recorded the span
+    unsigned int thread_id_;
+    //! number and bytes of the allocations during the span (built with USE_ALLOCATION_COUNTERS, otherwise 0)
+    uint64_t num_allocs_;
+    uint64_t alloc_bytes_;
+};
+
+//! Spans recorded while processing a frame
+struct frame_latency {
+    unsigned int frame_id_;
+    double timestamp_;
+    std::vector<latency_span> spans_;
+};
+
+/**
+ * Per-frame latency records
+ * (NOTE: the spans are recorded to a thread-local buffer only when built with USE_LATENCY_PROFILER,
+ *  and they are moved to a per-frame record by commit_frame())
+ */
+class latency_profiler {
+public:
+    //! Constructor
+    //! (capacity is the maximum number of the frames kept in the ring buffer)
+    explicit latency_profiler(const unsigned int capacity);
+
+    //! Store the spans as a record of the frame, and call the callback
+    void commit_frame(const unsigned int frame_id, const double timestamp, std::vector<latency_span> spans);
+
+    //! Set the callback which is called on each commit_frame() (on the committing thread)
+    void set_callback(const std::function<void(const frame_latency&)>& callback);
+
+    //! Get the records in the ring buffer (oldest first)
+    std::vector<frame_latency> get_records() const;
+
+    //! Clear the records
+    void clear();
+
+    //! Save the records in the Chrome trace event format (chrome://tracing, Perfetto)
+    void save_chrome_trace(const std::string& path) const;
+
+    //! Current time of the steady clock [us]
+    static int64_t now_us();
+
+    //! Append a span to the buffer of the calling thread
+    static void record_span(const char* name, const int64_t begin_us, const int64_t end_us,
+                            const uint64_t num_allocs = 0, const uint64_t alloc_bytes = 0);
+
+    //! Move the spans out of the buffer of the calling thread
+    static std::vector<latency_span> take_thread_spans();
+
+    //! Append the spans recorded on another thread to the buffer of the calling thread
+    static void append_thread_spans(const std::vector<latency_span>& spans);
+
+private:
+    //! maximum number of the records
+    const unsigned int capacity_;
+
+    //! mutex for the records and the callback
+    mutable std::mutex mtx_;
+    //! ring buffer of the records
+    std::deque<frame_latency> records_;
+    //! callback called on each commit_frame()
+    std::function<void(const frame_latency&)> callback_;
+};
+
+//! Record the lifetime of the object as a span
+class scoped_latency_span {
+public:
+    explicit scoped_latency_span(const char* name)
+        : name_(name), begin_us_(latency_profiler::now_us()), begin_allocs_(allocation_counter::get_thread_stats()) {}
+
+    ~scoped_latency_span() {
+        const auto end_allocs = allocation_counter::get_thread_stats();
+        latency_profiler::record_span(name_, begin_us_, latency_profiler::now_us(),
+                                      end_allocs.num_allocs_ - begin_allocs_.num_allocs_,
+                                      end_allocs.alloc_bytes_ - begin_allocs_.alloc_bytes_);
+    }
+
+    scoped_latency_span(const scoped_latency_span&) = delete;
+    scoped_latency_span& operator=(const scoped_latency_span&) = delete;
+
+private:
+    const char* name_;
+    const int64_t begin_us_;
+    const allocation_stats begin_allocs_;
+};
+
+} // namespace util
+} // namespace stella_vslam
+
+#define STELLA_VSLAM_LATENCY_SPAN_CONCAT_IMPL(a, b) a##b
+#define STELLA_VSLAM_LATENCY_SPAN_CONCAT(a, b) STELLA_VSLAM_LATENCY_SPAN_CONCAT_IMPL(a, b)
+
+// Record the rest of the enclosing scope as a span (removed at compile time without USE_LATENCY_PROFILER)
+#ifdef USE_LATENCY_PROFILER
+#define STELLA_VSLAM_LATENCY_SPAN(name) \
+    const ::stella_vslam::util::scoped_latency_span STELLA_VSLAM_LATENCY_SPAN_CONCAT(latency_span_, __LINE__)(name)
+#else
+#define STELLA_VSLAM_LATENCY_SPAN(name)
+#endif
+
+#endif // STELLA_VSLAM_UTIL_LATENCY_PROFILER_H
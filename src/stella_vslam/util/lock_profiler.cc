@@ -0,0 +1,241 @@
+#include "stella_vslam/util/lock_profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <sstream>
+
+#if defined(USE_LOCK_PROFILER) && defined(__GNUC__) && !defined(_WIN32)
+#include <cxxabi.h>
+#include <dlfcn.h>
+#define STELLA_VSLAM_LOCK_PROFILER_USE_DLADDR
+#endif
+
+namespace stella_vslam {
+namespace util {
+
+namespace {
+//! Number of the call sites of a lock class (the last one collects the overflowed sites)
+constexpr unsigned int num_site_slots = 128;
+
+unsigned int get_bucket(const int64_t duration_ns) {
+    // the upper bound of the i-th bucket is 2^i [us]
+    const auto duration_us = static_cast<uint64_t>(std::max<int64_t>(0, duration_ns) + 999) / 1000;
+    unsigned int bucket = 0;
+    while (bucket + 1 < lock_profiler::num_buckets && (static_cast<uint64_t>(1) << bucket) < duration_us) {
+        ++bucket;
+    }
+    return bucket;
+}
+
+std::string resolve_site(const uintptr_t site) {
+#ifdef STELLA_VSLAM_LOCK_PROFILER_USE_DLADDR
+    Dl_info info;
+    if (dladdr(reinterpret_cast<const void*>(site), &info) && info.dli_sname) {
+        int status = 0;
+        char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+        const std::string symbol = (status == 0 && demangled) ? demangled : info.dli_sname;
+        std::free(demangled);
+        return symbol;
+    }
+#endif
+    std::ostringstream oss;
+    oss << "0x" << std::hex << site;
+    return oss.str();
+}
+
+std::string escape_label_value(const std::string& value) {
+    std::string escaped;
+    escaped.reserve(value.size());
+    for (const auto c : value) {
+        if (c == '"' || c == '\\') {
+            escaped.push_back('\\');
+        }
+        escaped.push_back(c == '\n' ? ' ' : c);
+    }
+    return escaped;
+}
+} // namespace
+
+struct lock_profiler::lock_class {
+    //! Histograms of a call site
+    struct site_slot {
+        //! return address of lock() (0: unused)
+        std::atomic<uintptr_t> site_;
+        std::atomic<uint64_t> wait_counts_[num_buckets];
+        std::atomic<uint64_t> hold_counts_[num_buckets];
+        std::atomic<uint64_t> wait_sum_ns_;
+        std::atomic<uint64_t> hold_sum_ns_;
+    };
+
+    explicit lock_class(const char* name)
+        : name_(name) {
+        for (auto& slot : slots_) {
+            slot.site_ = 0;
+        }
+        clear();
+    }
+
+    void clear() {
+        for (auto& slot : slots_) {
+            for (unsigned int bucket = 0; bucket < num_buckets; ++bucket) {
+                slot.wait_counts_[bucket] = 0;
+                slot.hold_counts_[bucket] = 0;
+            }
+            slot.wait_sum_ns_ = 0;
+            slot.hold_sum_ns_ = 0;
+        }
+    }
+
+    //! Find or claim the slot of the call site (lock-free)
+    site_slot& get_slot(const void* site) {
+        // (0 is reserved for the unused slots)
+        const uintptr_t key = site ? reinterpret_cast<uintptr_t>(site) : 1;
+        const unsigned int num_probes = num_site_slots - 1;
+        unsigned int slot_idx = static_cast<unsigned int>((key >> 4) * 2654435761u) % num_probes;
+        for (unsigned int i = 0; i < num_probes; ++i) {
+            auto& slot = slots_[slot_idx];
+            uintptr_t current = slot.site_.load(std::memory_order_acquire);
+            if (current == key) {
+                return slot;
+            }
+            if (current == 0 && slot.site_.compare_exchange_strong(current, key, std::memory_order_acq_rel)) {
+                return slot;
+            }
+            if (current == key) {
+                return slot;
+            }
+            slot_idx = (slot_idx + 1) % num_probes;
+        }
+        return slots_[num_site_slots - 1];
+    }
+
+    const char* const name_;
+    site_slot slots_[num_site_slots];
+};
+
+namespace {
+std::mutex mtx_lock_classes;
+//! lock classes ordered by the name (never destroyed, because the locks keep the pointers)
+std::map<std::string, std::unique_ptr<lock_profiler::lock_class>>& get_lock_classes() {
+    static auto* lock_classes = new std::map<std::string, std::unique_ptr<lock_profiler::lock_class>>();
+    return *lock_classes;
+}
+} // namespace
+
+lock_profiler::lock_class* lock_profiler::get_lock_class(const char* name) {
+    std::lock_guard<std::mutex> lock(mtx_lock_classes);
+    auto& lock_classes = get_lock_classes();
+    auto& cls = lock_classes[name];
+    if (!cls) {
+        cls.reset(new lock_class(name));
+    }
+    return cls.get();
+}
+
+void lock_profiler::record_wait(lock_class* cls, const void* site, const int64_t wait_ns) {
+    auto& slot = cls->get_slot(site);
+    slot.wait_counts_[get_bucket(wait_ns)].fetch_add(1, std::memory_order_relaxed);
+    slot.wait_sum_ns_.fetch_add(std::max<int64_t>(0, wait_ns), std::memory_order_relaxed);
+}
+
+void lock_profiler::record_hold(lock_class* cls, const void* site, const int64_t hold_ns) {
+    auto& slot = cls->get_slot(site);
+    slot.hold_counts_[get_bucket(hold_ns)].fetch_add(1, std::memory_order_relaxed);
+    slot.hold_sum_ns_.fetch_add(std::max<int64_t>(0, hold_ns), std::memory_order_relaxed);
+}
+
+std::vector<lock_site_stats> lock_profiler::get_stats() {
+    std::vector<lock_site_stats> stats;
+    std::lock_guard<std::mutex> lock(mtx_lock_classes);
+    for (const auto& name_cls : get_lock_classes()) {
+        const auto& cls = name_cls.second;
+        for (unsigned int slot_idx = 0; slot_idx < num_site_slots; ++slot_idx) {
+            const auto& slot = cls->slots_[slot_idx];
+            const auto site = slot.site_.load(std::memory_order_acquire);
+            const bool is_overflow = slot_idx + 1 == num_site_slots;
+            if (site == 0 && !is_overflow) {
+                continue;
+            }
+
+            lock_site_stats site_stats;
+            site_stats.lock_class_ = name_cls.first;
+            site_stats.site_ = is_overflow ? "(other)" : resolve_site(site);
+            site_stats.wait_counts_.resize(num_buckets);
+            site_stats.hold_counts_.resize(num_buckets);
+            uint64_t num_records = 0;
+            for (unsigned int bucket = 0; bucket < num_buckets; ++bucket) {
+                site_stats.wait_counts_.at(bucket) = slot.wait_counts_[bucket].load(std::memory_order_relaxed);
+                site_stats.hold_counts_.at(bucket) = slot.hold_counts_[bucket].load(std::memory_order_relaxed);
+                num_records += site_stats.wait_counts_.at(bucket) + site_stats.hold_counts_.at(bucket);
+            }
+            if (num_records == 0) {
+                continue;
+            }
+            site_stats.wait_sum_us_ = slot.wait_sum_ns_.load(std::memory_order_relaxed) / 1000.0;
+            site_stats.hold_sum_us_ = slot.hold_sum_ns_.load(std::memory_order_relaxed) / 1000.0;
+            stats.push_back(std::move(site_stats));
+        }
+    }
+
+    std::sort(stats.begin(), stats.end(), [](const lock_site_stats& a, const lock_site_stats& b) {
+        return a.wait_sum_us_ > b.wait_sum_us_;
+    });
+    return stats;
+}
+
+void lock_profiler::reset() {
+    std::lock_guard<std::mutex> lock(mtx_lock_classes);
+    for (auto& name_cls : get_lock_classes()) {
+        name_cls.second->clear();
+    }
+}
+
+std::string lock_profiler::get_prometheus_text(const std::string& prefix) {
+    const auto stats = get_stats();
+    if (stats.empty()) {
+        return "";
+    }
+
+    std::ostringstream oss;
+    oss.precision(17);
+    const auto write_histograms = [&oss, &stats](const std::string& name, const bool is_wait) {
+        oss << "# HELP " << name << " " << (is_wait ? "Wait time to acquire the lock [us]" : "Hold time of the lock [us]") << "\n";
+        oss << "# TYPE " << name << " histogram\n";
+        for (const auto& site_stats : stats) {
+            const auto labels = "class=\"" + escape_label_value(site_stats.lock_class_) + "\",site=\"" + escape_label_value(site_stats.site_) + "\"";
+            const auto& counts = is_wait ? site_stats.wait_counts_ : site_stats.hold_counts_;
+            uint64_t cumulative_count = 0;
+            for (unsigned int bucket = 0; bucket < num_buckets; ++bucket) {
+                cumulative_count += counts.at(bucket);
+                oss << name << "_bucket{" << labels << ",le=\"";
+                if (bucket + 1 < num_buckets) {
+                    oss << get_bucket_upper_bound_us(bucket);
+                }
+                else {
+                    oss << "+Inf";
+                }
+                oss << "\"} " << cumulative_count << "\n";
+            }
+            oss << name << "_sum{" << labels << "} " << (is_wait ? site_stats.wait_sum_us_ : site_stats.hold_sum_us_) << "\n";
+            oss << name << "_count{" << labels << "} " << cumulative_count << "\n";
+        }
+    };
+    write_histograms(prefix + "lock_wait_us", true);
+    write_histograms(prefix + "lock_hold_us", false);
+    return oss.str();
+}
+
+double lock_profiler::get_bucket_upper_bound_us(const unsigned int bucket) {
+    return static_cast<double>(static_cast<uint64_t>(1) << bucket);
+}
+
+int64_t lock_profiler::now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+} // namespace util
+} // namespace stella_vslam
@@ -0,0 +1,178 @@
+#ifndef STELLA_VSLAM_UTIL_LOCK_PROFILER_H
+#define STELLA_VSLAM_UTIL_LOCK_PROFILER_H
+
+#include "stella_vslam/util/shared_mutex.h"
+#include "stella_vslam/util/spinlock.h"
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#if defined(__GNUC__)
+#define STELLA_VSLAM_LOCK_PROFILER_NOINLINE __attribute__((noinline))
+#define STELLA_VSLAM_LOCK_PROFILER_CALL_SITE() __builtin_return_address(0)
+#else
+#define STELLA_VSLAM_LOCK_PROFILER_NOINLINE
+#define STELLA_VSLAM_LOCK_PROFILER_CALL_SITE() nullptr
+#endif
+
+namespace stella_vslam {
+namespace util {
+
+//! Wait and hold time histograms of a lock class at a call site
+struct lock_site_stats {
+    //! name of the lock class (e.g. "keyframe::mtx_pose_")
+    std::string lock_class_;
+    //! symbol of the function which acquired the lock (empty if it cannot be resolved)
+    std::string site_;
+    //! number of the acquisitions in each bucket of the wait time (see lock_profiler::get_bucket_upper_bound_us())
+    std::vector<uint64_t> wait_counts_;
+    //! number of the releases in each bucket of the hold time (the shared locks are not counted)
+    std::vector<uint64_t> hold_counts_;
+    //! total wait time [us]
+    double wait_sum_us_ = 0.0;
+    //! total hold time [us]
+    double hold_sum_us_ = 0.0;
+};
+
+/**
+ * Wait and hold time histograms of the instrumented locks per lock class and per call site
+ * (NOTE: the locks are instrumented only when built with USE_LOCK_PROFILER, see basic_profiled_lock.
+ *  The call sites are the return addresses of lock(), so they are meaningful only in the optimized builds,
+ *  where std::lock_guard is inlined into the caller.)
+ */
+class lock_profiler {
+public:
+    //! Number of the buckets of the histograms (the upper bounds are 1, 2, 4, ..., 2^20 [us] and infinity)
+    static constexpr unsigned int num_buckets = 22;
+
+    //! Statistics of a lock class (opaque)
+    struct lock_class;
+
+    //! Get the statistics of the lock class, which is created if it does not exist (name must be a string literal)
+    static lock_class* get_lock_class(const char* name);
+
+    //! Record the wait time to acquire the lock
+    static void record_wait(lock_class* cls, const void* site, const int64_t wait_ns);
+
+    //! Record the hold time of the lock
+    static void record_hold(lock_class* cls, const void* site, const int64_t hold_ns);
+
+    //! Get the statistics of all of the call sites (sorted by the total wait time, longest first)
+    static std::vector<lock_site_stats> get_stats();
+
+    //! Clear the statistics
+    static void reset();
+
+    //! Get the histograms in the Prometheus text exposition format
+    static std::string get_prometheus_text(const std::string& prefix);
+
+    //! Upper bound of the bucket [us]
+    static double get_bucket_upper_bound_us(const unsigned int bucket);
+
+    //! Current time of the steady clock [ns]
+    static int64_t now_ns();
+};
+
+#ifdef USE_LOCK_PROFILER
+
+/**
+ * Lock which records the wait and hold times to lock_profiler
+ * (usable with std::lock_guard and std::unique_lock, NOT recursive)
+ */
+template<typename Mutex>
+class basic_profiled_lock {
+public:
+    explicit basic_profiled_lock(const char* name)
+        : cls_(lock_profiler::get_lock_class(name)) {}
+
+    basic_profiled_lock(const basic_profiled_lock&) = delete;
+    basic_profiled_lock& operator=(const basic_profiled_lock&) = delete;
+
+    STELLA_VSLAM_LOCK_PROFILER_NOINLINE void lock() {
+        const void* site = STELLA_VSLAM_LOCK_PROFILER_CALL_SITE();
+        const auto begin_ns = lock_profiler::now_ns();
+        mtx_.lock();
+        acquired(site, begin_ns);
+    }
+
+    STELLA_VSLAM_LOCK_PROFILER_NOINLINE bool try_lock() {
+        if (!mtx_.try_lock()) {
+            return false;
+        }
+        const auto now_ns = lock_profiler::now_ns();
+        acquired(STELLA_VSLAM_LOCK_PROFILER_CALL_SITE(), now_ns, now_ns);
+        return true;
+    }
+
+    void unlock() {
+        const auto hold_ns = lock_profiler::now_ns() - acquired_ns_;
+        const void* site = site_;
+        mtx_.unlock();
+        lock_profiler::record_hold(cls_, site, hold_ns);
+    }
+
+protected:
+    void acquired(const void* site, const int64_t begin_ns, const int64_t acquired_ns) {
+        // (written by the holder only)
+        site_ = site;
+        acquired_ns_ = acquired_ns;
+        lock_profiler::record_wait(cls_, site, acquired_ns - begin_ns);
+    }
+
+    void acquired(const void* site, const int64_t begin_ns) {
+        acquired(site, begin_ns, lock_profiler::now_ns());
+    }
+
+    Mutex mtx_;
+    lock_profiler::lock_class* const cls_;
+    //! call site and time of the exclusive acquisition
+    const void* site_ = nullptr;
+    int64_t acquired_ns_ = 0;
+};
+
+/**
+ * Reader-writer lock which records the wait and hold times to lock_profiler
+ * (the hold times of the shared locks are not recorded)
+ */
+template<typename SharedMutex>
+class basic_profiled_shared_lock : public basic_profiled_lock<SharedMutex> {
+public:
+    explicit basic_profiled_shared_lock(const char* name)
+        : basic_profiled_lock<SharedMutex>(name) {}
+
+    STELLA_VSLAM_LOCK_PROFILER_NOINLINE void lock_shared() {
+        const void* site = STELLA_VSLAM_LOCK_PROFILER_CALL_SITE();
+        const auto begin_ns = lock_profiler::now_ns();
+        this->mtx_.lock_shared();
+        lock_profiler::record_wait(this->cls_, site, lock_profiler::now_ns() - begin_ns);
+    }
+
+    void unlock_shared() {
+        this->mtx_.unlock_shared();
+    }
+};
+
+#else
+
+//! The lock itself (the name is ignored without USE_LOCK_PROFILER)
+template<typename Mutex>
+class basic_profiled_lock : public Mutex {
+public:
+    explicit basic_profiled_lock(const char*) {}
+};
+
+template<typename SharedMutex>
+using basic_profiled_shared_lock = basic_profiled_lock<SharedMutex>;
+
+#endif
+
+using profiled_mutex = basic_profiled_lock<std::mutex>;
+using profiled_spinlock = basic_profiled_lock<spinlock>;
+using profiled_shared_mutex = basic_profiled_shared_lock<shared_mutex>;
+
+} // namespace util
+} // namespace stella_vslam
+
+#endif // STELLA_VSLAM_UTIL_LOCK_PROFILER_H
@@ -0,0 +1,109 @@
+#include "stella_vslam/util/mapped_file.h"
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define STELLA_VSLAM_USE_MMAP
+#endif
+
+namespace stella_vslam {
+namespace util {
+
+mapped_file::mapped_file(const std::string& path) {
+#ifdef STELLA_VSLAM_USE_MMAP
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("cannot open the file at " + path);
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        throw std::runtime_error("cannot stat the file at " + path);
+    }
+    size_ = static_cast<size_t>(st.st_size);
+    if (size_ == 0) {
+        ::close(fd);
+        return;
+    }
+    void* addr = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping remains valid after closing the descriptor
+    ::close(fd);
+    if (addr != MAP_FAILED) {
+        data_ = static_cast<const uint8_t*>(addr);
+        is_mapped_ = true;
+        return;
+    }
+#endif
+
+    // fallback: read the whole file at once
+    std::ifstream ifs(path, std::ios::in | std::ios::binary | std::ios::ate);
+    if (!ifs.is_open()) {
+        throw std::runtime_error("cannot open the file at " + path);
+    }
+    size_ = static_cast<size_t>(ifs.tellg());
+    buffer_.resize(size_);
+    ifs.seekg(0);
+    if (!ifs.read(reinterpret_cast<char*>(buffer_.data()), size_)) {
+        throw std::runtime_error("cannot read the file at " + path);
+    }
+    data_ = buffer_.data();
+}
+
+mapped_file::~mapped_file() {
+#ifdef STELLA_VSLAM_USE_MMAP
+    if (is_mapped_) {
+        ::munmap(const_cast<uint8_t*>(data_), size_);
+    }
+#endif
+}
+
+void mapped_file::advise_random_access() const {
+#ifdef STELLA_VSLAM_USE_MMAP
+    if (is_mapped_) {
+        ::madvise(const_cast<uint8_t*>(data_), size_, MADV_RANDOM);
+    }
+#endif
+}
+
+void mapped_file::prefetch(const size_t offset, const size_t size) const {
+#ifdef STELLA_VSLAM_USE_MMAP
+    if (!is_mapped_ || size_ <= offset) {
+        return;
+    }
+    // the pages which overlap the range are read
+    const size_t page_size = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    const size_t begin = offset / page_size * page_size;
+    const size_t end = std::min(offset + size, size_);
+    ::madvise(const_cast<uint8_t*>(data_) + begin, end - begin, MADV_WILLNEED);
+#else
+    (void)offset;
+    (void)size;
+#endif
+}
+
+void mapped_file::release(const size_t offset, const size_t size) const {
+#ifdef STELLA_VSLAM_USE_MMAP
+    if (!is_mapped_ || size_ < offset) {
+        return;
+    }
+    // only the whole pages in the range are dropped
+    const size_t page_size = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    const size_t begin = (offset + page_size - 1) / page_size * page_size;
+    const size_t end = std::min(offset + size, size_) / page_size * page_size;
+    if (begin < end) {
+        ::madvise(const_cast<uint8_t*>(data_) + begin, end - begin, MADV_DONTNEED);
+    }
+#else
+    (void)offset;
+    (void)size;
+#endif
+}
+
+} // namespace util
+} // namespace stella_vslam
@@ -0,0 +1,63 @@
+#ifndef STELLA_VSLAM_UTIL_MAPPED_FILE_H
+#define STELLA_VSLAM_UTIL_MAPPED_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace stella_vslam {
+namespace util {
+
+/**
+ * Read-only view of a whole file
+ * (NOTE: the file is memory-mapped where mmap is available, otherwise it is read into a buffer at once.
+ *  The view is page-aligned (or malloc-aligned for the buffer).)
+ */
+class mapped_file {
+public:
+    //! Open the file (throw std::runtime_error if it cannot be read)
+    explicit mapped_file(const std::string& path);
+
+    //! Destructor (unmap the file)
+    ~mapped_file();
+
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+
+    //! Pointer to the first byte
+    const uint8_t* data() const {
+        return data_;
+    }
+
+    //! Size of the file in bytes
+    size_t size() const {
+        return size_;
+    }
+
+    //! The file is memory-mapped or not
+    bool is_mapped() const {
+        return is_mapped_;
+    }
+
+    //! Hint that the view is accessed randomly, which suppresses the read-ahead (no-op for the buffer)
+    void advise_random_access() const;
+
+    //! Read ahead the pages in the range asynchronously (no-op for the buffer)
+    void prefetch(const size_t offset, const size_t size) const;
+
+    //! Drop the resident pages in the range, which are read from the file again on the next access (no-op for the buffer)
+    void release(const size_t offset, const size_t size) const;
+
+private:
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+    bool is_mapped_ = false;
+    //! fallback buffer if mmap is not available
+    std::vector<uint8_t> buffer_;
+};
+
+} // namespace util
+} // namespace stella_vslam
+
+#endif // STELLA_VSLAM_UTIL_MAPPED_FILE_H
@@ -0,0 +1,88 @@
+#ifndef STELLA_VSLAM_UTIL_PARALLEL_FOR_H
+#define STELLA_VSLAM_UTIL_PARALLEL_FOR_H
+
+#include "stella_vslam/util/thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <future>
+#include <vector>
+
+namespace stella_vslam {
+namespace util {
+
+/**
+ * Call func(idx) for each index in [begin, end) on the workers of the pool and on the calling thread
+ * The indices are taken in turn by grain_size, as schedule(dynamic, grain_size) of OpenMP,
+ * so that the loops of the modules share the cores of the pool instead of oversubscribing them with the OpenMP threads.
+ * (the OpenMP loop is used instead if the pool is nullptr or has no worker)
+ */
+template<typename F>
+void parallel_for(thread_pool* pool, const int64_t begin, const int64_t end, const F& func,
+                  const task_priority_t priority = task_priority_t::Normal, const int64_t grain_size = 1) {
+    if (end <= begin) {
+        return;
+    }
+    if (!pool || pool->get_num_threads() == 0) {
+#ifdef USE_OPENMP
+#pragma omp parallel for schedule(dynamic, grain_size)
+#endif
+        for (int64_t idx = begin; idx < end; ++idx) {
+            func(idx);
+        }
+        return;
+    }
+
+    const int64_t num_grains = (end - begin + grain_size - 1) / grain_size;
+    // (the calling thread takes the indices as well)
+    const auto num_tasks = static_cast<unsigned int>(std::min<int64_t>(pool->get_num_threads(), num_grains - 1));
+    std::atomic<int64_t> next_begin{begin};
+    const auto run = [&next_begin, end, grain_size, &func] {
+        while (true) {
+            const int64_t grain_begin = next_begin.fetch_add(grain_size);
+            if (end <= grain_begin) {
+                return;
+            }
+            const int64_t grain_end = std::min(grain_begin + grain_size, end);
+            for (int64_t idx = grain_begin; idx < grain_end; ++idx) {
+                func(idx);
+            }
+        }
+    };
+
+    std::vector<std::future<void>> futures;
+    futures.reserve(num_tasks);
+    for (unsigned int i = 0; i < num_tasks; ++i) {
+        futures.push_back(pool->submit(run, priority));
+    }
+
+    // the tasks refer to the variables on this stack, so all of them are waited for even if one throws
+    std::exception_ptr exception;
+    try {
+        run();
+    }
+    catch (...) {
+        exception = std::current_exception();
+    }
+    for (auto& future : futures) {
+        pool->wait(future, priority);
+        try {
+            future.get();
+        }
+        catch (...) {
+            if (!exception) {
+                exception = std::current_exception();
+            }
+        }
+    }
+    if (exception) {
+        std::rethrow_exception(exception);
+    }
+}
+
+} // namespace util
+} // namespace stella_vslam
+
+#endif // STELLA_VSLAM_UTIL_PARALLEL_FOR_H
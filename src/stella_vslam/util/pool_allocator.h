@@ -0,0 +1,118 @@
+#ifndef STELLA_VSLAM_UTIL_POOL_ALLOCATOR_H
+#define STELLA_VSLAM_UTIL_POOL_ALLOCATOR_H
+
+#include "stella_vslam/util/spinlock.h"
+
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace stella_vslam {
+namespace util {
+
+/**
+ * Thread-safe pool of fixed-size blocks
+ * The blocks are allocated in chunks and are recycled via the free list without being returned to the system.
+ */
+template<std::size_t BlockSize, std::size_t Alignment>
+class fixed_size_pool {
+    static_assert(Alignment <= alignof(std::max_align_t), "over-aligned types are not supported");
+
+public:
+    //! Get the pool for the block size
+    //! (NOTE: intentionally leaked so that it outlives the objects released during the static destruction)
+    static fixed_size_pool& instance() {
+        static auto* pool = new fixed_size_pool();
+        return *pool;
+    }
+
+    void* allocate() {
+        std::lock_guard<spinlock> lock(mtx_);
+        if (!free_list_) {
+            allocate_chunk();
+        }
+        auto* block = free_list_;
+        free_list_ = block->next_;
+        return block;
+    }
+
+    void deallocate(void* ptr) {
+        auto* block = static_cast<free_block*>(ptr);
+        std::lock_guard<spinlock> lock(mtx_);
+        block->next_ = free_list_;
+        free_list_ = block;
+    }
+
+private:
+    struct free_block {
+        free_block* next_;
+    };
+
+    //! block size which can contain the link of the free list and keeps the alignment
+    static constexpr std::size_t stride_ = ((BlockSize < sizeof(free_block) ? sizeof(free_block) : BlockSize) + Alignment - 1)
+                                           / Alignment * Alignment;
+    //! number of the blocks in a chunk
+    static constexpr std::size_t num_blocks_in_chunk_ = 1024;
+
+    fixed_size_pool() = default;
+
+    void allocate_chunk() {
+        auto* chunk = static_cast<char*>(::operator new(stride_ * num_blocks_in_chunk_));
+        chunks_.push_back(chunk);
+        for (std::size_t idx = num_blocks_in_chunk_; 0 < idx; --idx) {
+            auto* block = reinterpret_cast<free_block*>(chunk + (idx - 1) * stride_);
+            block->next_ = free_list_;
+            free_list_ = block;
+        }
+    }
+
+    spinlock mtx_;
+    free_block* free_list_ = nullptr;
+    std::vector<char*> chunks_;
+};
+
+/**
+ * Allocator which takes single objects from fixed_size_pool (e.g. for std::allocate_shared)
+ * Array allocations are forwarded to operator new.
+ */
+template<typename T>
+class pool_allocator {
+public:
+    using value_type = T;
+
+    pool_allocator() = default;
+
+    template<typename U>
+    pool_allocator(const pool_allocator<U>&) noexcept {}
+
+    T* allocate(const std::size_t n) {
+        if (n != 1) {
+            return static_cast<T*>(::operator new(n * sizeof(T)));
+        }
+        return static_cast<T*>(fixed_size_pool<sizeof(T), alignof(T)>::instance().allocate());
+    }
+
+    void deallocate(T* ptr, const std::size_t n) noexcept {
+        if (n != 1) {
+            ::operator delete(ptr);
+            return;
+        }
+        fixed_size_pool<sizeof(T), alignof(T)>::instance().deallocate(ptr);
+    }
+};
+
+template<typename T, typename U>
+bool operator==(const pool_allocator<T>&, const pool_allocator<U>&) noexcept {
+    return true;
+}
+
+template<typename T, typename U>
+bool operator!=(const pool_allocator<T>&, const pool_allocator<U>&) noexcept {
+    return false;
+}
+
+} // namespace util
+} // namespace stella_vslam
+
+#endif // STELLA_VSLAM_UTIL_POOL_ALLOCATOR_H
@@ -0,0 +1,22 @@
+#ifndef STELLA_VSLAM_UTIL_PREFETCH_H
+#define STELLA_VSLAM_UTIL_PREFETCH_H
+
+namespace stella_vslam {
+namespace util {
+
+/**
+ * Hint to load the cache line of the address which will be read soon
+ * (no-op if the compiler does not provide the builtin)
+ */
+inline void prefetch(const void* addr) {
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_prefetch(addr, 0, 3);
+#else
+    (void)addr;
+#endif
+}
+
+} // namespace util
+} // namespace stella_vslam
+
+#endif // STELLA_VSLAM_UTIL_PREFETCH_H
@@ -0,0 +1,80 @@
+#ifndef STELLA_VSLAM_UTIL_SCRATCH_BUFFER_H
+#define STELLA_VSLAM_UTIL_SCRATCH_BUFFER_H
+
+#include <utility>
+#include <vector>
+
+namespace stella_vslam {
+namespace util {
+
+/**
+ * Per-thread reusable vector for the temporaries of the functions called repeatedly (e.g. the matchers)
+ * The vector is borrowed from the free list of the calling thread during the lifetime of scratch_vector,
+ * and is returned with its capacity kept, so the steady state does not touch the heap.
+ * Unlike frame_arena, the memory is reused across the calls and the threads need no scope.
+ * (NOTE: the nested scratch_vector of the same type borrow the different vectors,
+ *        and a scratch_vector must be destroyed on the thread where it is created)
+ */
+template<typename T>
+class scratch_vector {
+public:
+    //! Borrow an empty vector from the calling thread
+    scratch_vector()
+        : vec_(acquire()) {}
+
+    //! Borrow an empty vector from the calling thread, and resize it with the value
+    scratch_vector(const std::size_t size, const T& value = T())
+        : vec_(acquire()) {
+        vec_.assign(size, value);
+    }
+
+    //! Return the vector to the calling thread
+    ~scratch_vector() {
+        // (the elements are destroyed now, e.g. not to keep the landmarks alive)
+        vec_.clear();
+        get_free_list().push_back(std::move(vec_));
+    }
+
+    scratch_vector(const scratch_vector&) = delete;
+    scratch_vector& operator=(const scratch_vector&) = delete;
+
+    std::vector<T>& operator*() {
+        return vec_;
+    }
+
+    const std::vector<T>& operator*() const {
+        return vec_;
+    }
+
+    std::vector<T>* operator->() {
+        return &vec_;
+    }
+
+    const std::vector<T>* operator->() const {
+        return &vec_;
+    }
+
+private:
+    //! Get the vectors of the calling thread which are not borrowed
+    static std::vector<std::vector<T>>& get_free_list() {
+        thread_local std::vector<std::vector<T>> free_list;
+        return free_list;
+    }
+
+    static std::vector<T> acquire() {
+        auto& free_list = get_free_list();
+        if (free_list.empty()) {
+            return std::vector<T>();
+        }
+        std::vector<T> vec = std::move(free_list.back());
+        free_list.pop_back();
+        return vec;
+    }
+
+    std::vector<T> vec_;
+};
+
+} // namespace util
+} // namespace stella_vslam
+
+#endif // STELLA_VSLAM_UTIL_SCRATCH_BUFFER_H
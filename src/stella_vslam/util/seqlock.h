@@ -0,0 +1,117 @@
+#ifndef STELLA_VSLAM_UTIL_SEQLOCK_H
+#define STELLA_VSLAM_UTIL_SEQLOCK_H
+
+#include "stella_vslam/util/spinlock.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+
+namespace stella_vslam {
+namespace util {
+
+/**
+ * Sequence lock of a small value which is written rarely compared to the reads (e.g. the latest camera pose)
+ * The readers never block the writer and never contend with each other, and they retry only while a write is in progress.
+ * (NOTE: the writers are serialized by a spinlock, which the readers do not touch)
+ */
+template<typename T>
+class seqlock {
+    static_assert(std::is_trivially_copyable<T>::value, "the value of seqlock must be trivially copyable");
+
+public:
+    explicit seqlock(const T& value = T()) {
+        store_words(value);
+    }
+
+    seqlock(const seqlock&) = delete;
+    seqlock& operator=(const seqlock&) = delete;
+
+    //! Write the value
+    void store(const T& value) {
+        std::lock_guard<spinlock> lock(mtx_writer_);
+        const auto seq = seq_.load(std::memory_order_relaxed);
+        // the odd sequence indicates that a write is in progress
+        seq_.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        store_words(value);
+        seq_.store(seq + 2, std::memory_order_release);
+    }
+
+    /**
+     * Read the value if no write is in progress
+     * @param value
+     * @param seq sequence number of the value (incremented by 2 at each write)
+     * @return false if the value is being written
+     */
+    bool try_load(T& value, uint64_t& seq) const {
+        const auto seq_before = seq_.load(std::memory_order_acquire);
+        if (seq_before & 1) {
+            return false;
+        }
+        uint64_t words[num_words_];
+        for (unsigned int i = 0; i < num_words_; ++i) {
+            words[i] = words_[i].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (seq_.load(std::memory_order_relaxed) != seq_before) {
+            return false;
+        }
+        std::memcpy(&value, words, sizeof(T));
+        seq = seq_before;
+        return true;
+    }
+
+    //! Read the value (retrying while a write is in progress)
+    T load(uint64_t& seq) const {
+        T value;
+        unsigned int num_retries = 0;
+        while (!try_load(value, seq)) {
+            // give up the time slice if the writer seems to be preempted
+            if (++num_retries % 64 == 0) {
+                std::this_thread::yield();
+            }
+        }
+        return value;
+    }
+
+    //! Read the value (retrying while a write is in progress)
+    T load() const {
+        uint64_t seq;
+        return load(seq);
+    }
+
+    //! Sequence number of the latest value (the readers can poll this to detect the updates)
+    uint64_t get_sequence() const {
+        return seq_.load(std::memory_order_acquire) & ~static_cast<uint64_t>(1);
+    }
+
+private:
+    static constexpr unsigned int num_words_ = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    void store_words(const T& value) {
+        uint64_t words[num_words_] = {};
+        std::memcpy(words, &value, sizeof(T));
+        for (unsigned int i = 0; i < num_words_; ++i) {
+            words_[i].store(words[i], std::memory_order_relaxed);
+        }
+    }
+
+    //! words of the value, which are accessed atomically to avoid the data race during the write
+    std::atomic<uint64_t> words_[num_words_];
+    //! sequence number (odd while a write is in progress)
+    std::atomic<uint64_t> seq_{0};
+    //! lock of the writers
+    spinlock mtx_writer_;
+};
+
+template<typename T>
+constexpr unsigned int seqlock<T>::num_words_;
+
+} // namespace util
+} // namespace stella_vslam
+
+#endif // STELLA_VSLAM_UTIL_SEQLOCK_H
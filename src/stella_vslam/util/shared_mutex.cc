@@ -0,0 +1,66 @@
+#include "stella_vslam/util/shared_mutex.h"
+
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
+namespace stella_vslam {
+namespace util {
+
+#ifndef NDEBUG
+namespace {
+//! mutexes whose shared locks are held by the calling thread (to detect the recursive locking)
+thread_local std::vector<const shared_mutex*> held_shared_mutexes;
+
+bool is_shared_locked_by_this_thread(const shared_mutex* mtx) {
+    return std::find(held_shared_mutexes.begin(), held_shared_mutexes.end(), mtx) != held_shared_mutexes.end();
+}
+} // namespace
+#endif
+
+void shared_mutex::lock() {
+    assert(!is_shared_locked_by_this_thread(this) && "the exclusive lock is acquired while holding the shared lock");
+    std::unique_lock<std::mutex> lock(mtx_);
+    ++num_waiting_writers_;
+    cond_.wait(lock, [this] { return !is_writing_ && num_readers_ == 0; });
+    --num_waiting_writers_;
+    is_writing_ = true;
+}
+
+void shared_mutex::unlock() {
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        is_writing_ = false;
+    }
+    cond_.notify_all();
+}
+
+void shared_mutex::lock_shared() {
+    assert(!is_shared_locked_by_this_thread(this) && "the shared lock is acquired recursively");
+    std::unique_lock<std::mutex> lock(mtx_);
+    cond_.wait(lock, [this] { return !is_writing_ && num_waiting_writers_ == 0; });
+    ++num_readers_;
+#ifndef NDEBUG
+    held_shared_mutexes.push_back(this);
+#endif
+}
+
+void shared_mutex::unlock_shared() {
+#ifndef NDEBUG
+    const auto itr = std::find(held_shared_mutexes.begin(), held_shared_mutexes.end(), this);
+    assert(itr != held_shared_mutexes.end() && "the shared lock is released by the thread which does not hold it");
+    held_shared_mutexes.erase(itr);
+#endif
+    bool is_last_reader = false;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        --num_readers_;
+        is_last_reader = (num_readers_ == 0);
+    }
+    if (is_last_reader) {
+        cond_.notify_all();
+    }
+}
+
+} // namespace util
+} // namespace stella_vslam
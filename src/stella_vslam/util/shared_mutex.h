@@ -0,0 +1,73 @@
+#ifndef STELLA_VSLAM_UTIL_SHARED_MUTEX_H
+#define STELLA_VSLAM_UTIL_SHARED_MUTEX_H
+
+#include <condition_variable>
+#include <mutex>
+
+namespace stella_vslam {
+namespace util {
+
+/**
+ * Reader-writer lock (substitute for std::shared_mutex, which is not available in C++11)
+ * Waiting writers block the new readers so that the writers are not starved.
+ * (NOTE: not recursive, so DO NOT acquire the shared lock again in the same thread,
+ *  because it blocks forever if a writer is waiting in between. This is asserted in the debug build.)
+ */
+class shared_mutex {
+public:
+    shared_mutex() = default;
+    shared_mutex(const shared_mutex&) = delete;
+    shared_mutex& operator=(const shared_mutex&) = delete;
+
+    //! Acquire the exclusive lock (usable with std::lock_guard and std::unique_lock)
+    void lock();
+
+    //! Release the exclusive lock
+    void unlock();
+
+    //! Acquire the shared lock
+    void lock_shared();
+
+    //! Release the shared lock
+    void unlock_shared();
+
+private:
+    std::mutex mtx_;
+    //! notified when the lock becomes available
+    std::condition_variable cond_;
+    //! number of the threads which hold the shared lock
+    unsigned int num_readers_ = 0;
+    //! number of the threads which wait for the exclusive lock
+    unsigned int num_waiting_writers_ = 0;
+    //! a thread holds the exclusive lock or not
+    bool is_writing_ = false;
+};
+
+/**
+ * Scoped shared lock (substitute for std::shared_lock)
+ * (usable with any type which has lock_shared() and unlock_shared(), e.g. util::profiled_shared_mutex)
+ */
+class shared_lock_guard {
+public:
+    template<typename SharedMutex>
+    explicit shared_lock_guard(SharedMutex& mtx)
+        : mtx_(&mtx), unlock_shared_([](void* mtx) { static_cast<SharedMutex*>(mtx)->unlock_shared(); }) {
+        mtx.lock_shared();
+    }
+
+    ~shared_lock_guard() {
+        unlock_shared_(mtx_);
+    }
+
+    shared_lock_guard(const shared_lock_guard&) = delete;
+    shared_lock_guard& operator=(const shared_lock_guard&) = delete;
+
+private:
+    void* mtx_;
+    void (*unlock_shared_)(void*);
+};
+
+} // namespace util
+} // namespace stella_vslam
+
+#endif // STELLA_VSLAM_UTIL_SHARED_MUTEX_H
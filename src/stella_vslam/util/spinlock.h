@@ -0,0 +1,45 @@
+#ifndef STELLA_VSLAM_UTIL_SPINLOCK_H
+#define STELLA_VSLAM_UTIL_SPINLOCK_H
+
+#include <atomic>
+#include <thread>
+
+namespace stella_vslam {
+namespace util {
+
+/**
+ * One-byte lock for the short critical sections of the objects which exist in large numbers (e.g. landmarks)
+ * (usable with std::lock_guard and std::unique_lock, NOT recursive)
+ */
+class spinlock {
+public:
+    spinlock() = default;
+    spinlock(const spinlock&) = delete;
+    spinlock& operator=(const spinlock&) = delete;
+
+    void lock() {
+        unsigned int num_spins = 0;
+        while (flag_.test_and_set(std::memory_order_acquire)) {
+            // give up the time slice if the owner seems to be preempted
+            if (++num_spins % 64 == 0) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    bool try_lock() {
+        return !flag_.test_and_set(std::memory_order_acquire);
+    }
+
+    void unlock() {
+        flag_.clear(std::memory_order_release);
+    }
+
+private:
+    std::atomic_flag flag_ = ATOMIC_FLAG_INIT;
+};
+
+} // namespace util
+} // namespace stella_vslam
+
+#endif // STELLA_VSLAM_UTIL_SPINLOCK_H
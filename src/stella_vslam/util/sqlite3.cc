@@ -22,6 +22,29 @@ bool create_table(sqlite3* db,
     return ret == SQLITE_OK;
 }
 
+bool table_exists(sqlite3* db,
+                  const std::string& name) {
+    sqlite3_stmt* stmt = nullptr;
+    int ret = sqlite3_prepare_v2(db, "SELECT name FROM sqlite_master WHERE type='table' AND name=?;", -1, &stmt, nullptr);
+    if (ret == SQLITE_OK) {
+        ret = sqlite3_bind_text(stmt, 1, name.c_str(), name.size(), SQLITE_TRANSIENT);
+    }
+    bool exists = false;
+    if (ret == SQLITE_OK) {
+        exists = sqlite3_step(stmt) == SQLITE_ROW;
+    }
+    sqlite3_finalize(stmt);
+    return exists;
+}
+
+bool exec(sqlite3* db, const std::string& sql) {
+    int ret = sqlite3_exec(db, sql.c_str(), nullptr, nullptr, nullptr);
+    if (ret != SQLITE_OK) {
+        spdlog::error("SQLite error (exec): {}", sqlite3_errmsg(db));
+    }
+    return ret == SQLITE_OK;
+}
+
 bool begin(sqlite3* db) {
     int ret = SQLITE_ERROR;
     ret = sqlite3_exec(db, "BEGIN;", nullptr, nullptr, nullptr);
@@ -52,6 +75,19 @@ bool commit(sqlite3* db) {
     return ret == SQLITE_OK;
 }
 
+bool rollback(sqlite3* db) {
+    int ret = sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+    if (ret != SQLITE_OK) {
+        spdlog::error("SQLite error (rollback): {}", sqlite3_errmsg(db));
+    }
+    return ret == SQLITE_OK;
+}
+
+bool enable_wal(sqlite3* db) {
+    // NOTE: synchronous=NORMAL is durable across application crashes in the WAL mode
+    return exec(db, "PRAGMA journal_mode=WAL;") && exec(db, "PRAGMA synchronous=NORMAL;");
+}
+
 bool drop_table(sqlite3* db,
                 const std::string& name) {
     const std::string stmt_str = "DROP TABLE IF EXISTS " + name + ";";
@@ -70,25 +106,55 @@ sqlite3_stmt* create_select_stmt(sqlite3* db, const std::string& table_name) {
     return stmt;
 }
 
+bool select_ids(sqlite3* db, const std::string& table_name, std::unordered_set<unsigned int>& ids) {
+    sqlite3_stmt* stmt;
+    const std::string stmt_str = "SELECT id FROM " + table_name + ";";
+    int ret = sqlite3_prepare_v2(db, stmt_str.c_str(), -1, &stmt, nullptr);
+    if (ret != SQLITE_OK) {
+        spdlog::error("SQLite error: {}", sqlite3_errmsg(db));
+        return false;
+    }
+    while ((ret = sqlite3_step(stmt)) == SQLITE_ROW) {
+        ids.insert(static_cast<unsigned int>(sqlite3_column_int64(stmt, 0)));
+    }
+    if (ret != SQLITE_DONE) {
+        spdlog::error("SQLite step is not done: {}", sqlite3_errmsg(db));
+    }
+    sqlite3_finalize(stmt);
+    return ret == SQLITE_DONE;
+}
+
 sqlite3_stmt* create_insert_stmt(sqlite3* db,
                                  const std::string& name,
-                                 const std::vector<std::pair<std::string, std::string>>& columns) {
-    int ret = SQLITE_ERROR;
+                                 const std::vector<std::pair<std::string, std::string>>& columns,
+                                 const bool replace) {
     sqlite3_stmt* stmt = nullptr;
-    if (ret == SQLITE_OK) {
-        std::string insert_stmt_str = "INSERT INTO " + name + "(id";
-        for (const auto& column : columns) {
-            insert_stmt_str += ", " + column.first;
-        }
-        insert_stmt_str += ") VALUES(?";
-        for (size_t i = 0; i < columns.size(); ++i) {
-            insert_stmt_str += ", ?";
-        }
-        insert_stmt_str += ")";
-        ret = sqlite3_prepare_v2(db, insert_stmt_str.c_str(), -1, &stmt, nullptr);
-    }
-    if (!stmt) {
+    std::string insert_stmt_str = (replace ? "INSERT OR REPLACE INTO " : "INSERT INTO ") + name + "(id";
+    for (const auto& column : columns) {
+        insert_stmt_str += ", " + column.first;
+    }
+    insert_stmt_str += ") VALUES(?";
+    for (size_t i = 0; i < columns.size(); ++i) {
+        insert_stmt_str += ", ?";
+    }
+    insert_stmt_str += ")";
+    int ret = sqlite3_prepare_v2(db, insert_stmt_str.c_str(), -1, &stmt, nullptr);
+    if (ret != SQLITE_OK || !stmt) {
         spdlog::error("SQLite error (prepare): {}", sqlite3_errmsg(db));
+        sqlite3_finalize(stmt);
+        return nullptr;
+    }
+    return stmt;
+}
+
+sqlite3_stmt* create_delete_stmt(sqlite3* db, const std::string& name) {
+    sqlite3_stmt* stmt = nullptr;
+    const std::string stmt_str = "DELETE FROM " + name + " WHERE id = ?;";
+    int ret = sqlite3_prepare_v2(db, stmt_str.c_str(), -1, &stmt, nullptr);
+    if (ret != SQLITE_OK || !stmt) {
+        spdlog::error("SQLite error (prepare): {}", sqlite3_errmsg(db));
+        sqlite3_finalize(stmt);
+        return nullptr;
     }
     return stmt;
 }
@@ -3,6 +3,7 @@
 
 #include <vector>
 #include <string>
+#include <unordered_set>
 
 typedef struct sqlite3 sqlite3;
 typedef struct sqlite3_stmt sqlite3_stmt;
@@ -16,13 +17,31 @@ bool create_table(sqlite3* db,
                   const std::vector<std::pair<std::string, std::string>>& columns);
 bool drop_table(sqlite3* db,
                 const std::string& name);
+bool table_exists(sqlite3* db,
+                  const std::string& name);
+bool exec(sqlite3* db, const std::string& sql);
 bool begin(sqlite3* db);
 bool next(sqlite3* db, sqlite3_stmt* stmt);
 bool commit(sqlite3* db);
+bool rollback(sqlite3* db);
+//! Enable the write-ahead logging, which avoids rewriting the whole journal for each transaction
+bool enable_wal(sqlite3* db);
 sqlite3_stmt* create_select_stmt(sqlite3* db, const std::string& table_name);
+//! Collect the ids of all rows in the table
+bool select_ids(sqlite3* db, const std::string& table_name, std::unordered_set<unsigned int>& ids);
+/**
+ * Prepare an insert statement which is reused for all rows (bind, then next())
+ * @param db
+ * @param name table name
+ * @param columns columns except for id
+ * @param replace if true, the row which has the same id is replaced (INSERT OR REPLACE)
+ */
 sqlite3_stmt* create_insert_stmt(sqlite3* db,
                                  const std::string& name,
-                                 const std::vector<std::pair<std::string, std::string>>& columns);
+                                 const std::vector<std::pair<std::string, std::string>>& columns,
+                                 const bool replace = false);
+//! Prepare a statement which deletes the row of the bound id
+sqlite3_stmt* create_delete_stmt(sqlite3* db, const std::string& name);
 
 } // namespace sqlite3_util
 } // namespace util
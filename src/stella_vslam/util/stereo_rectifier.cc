@@ -9,6 +9,25 @@
 namespace stella_vslam {
 namespace util {
 
+namespace {
+
+//! Convert the image to grayscale into buf (the input image is returned if it needs no conversion)
+const cv::Mat& convert_to_grayscale(const cv::Mat& in_img, const camera::color_order_t color_order, cv::Mat& buf) {
+    if (color_order == camera::color_order_t::Gray || (in_img.channels() != 3 && in_img.channels() != 4)) {
+        return in_img;
+    }
+    const bool is_rgb = color_order == camera::color_order_t::RGB;
+    if (in_img.channels() == 3) {
+        cv::cvtColor(in_img, buf, is_rgb ? cv::COLOR_RGB2GRAY : cv::COLOR_BGR2GRAY);
+    }
+    else {
+        cv::cvtColor(in_img, buf, is_rgb ? cv::COLOR_RGBA2GRAY : cv::COLOR_BGRA2GRAY);
+    }
+    return buf;
+}
+
+} // namespace
+
 stereo_rectifier::stereo_rectifier(const std::shared_ptr<stella_vslam::config>& cfg, camera::base* camera)
     : stereo_rectifier(camera,
                        stella_vslam::util::yaml_optional_ref(cfg->yaml_node_, "StereoRectifier")) {}
@@ -38,21 +57,25 @@ stereo_rectifier::stereo_rectifier(camera::base* camera, const YAML::Node& yaml_
     // get camera matrix after rectification
     const auto K_rect = static_cast<camera::perspective*>(camera)->cv_cam_matrix_;
     // create undistortion maps
+    cv::Mat undist_map_x_l, undist_map_y_l, undist_map_x_r, undist_map_y_r;
     switch (model_type_) {
         case camera::model_type_t::Perspective: {
-            cv::initUndistortRectifyMap(K_l, D_l, R_l, K_rect, img_size, CV_32F, undist_map_x_l_, undist_map_y_l_);
-            cv::initUndistortRectifyMap(K_r, D_r, R_r, K_rect, img_size, CV_32F, undist_map_x_r_, undist_map_y_r_);
+            cv::initUndistortRectifyMap(K_l, D_l, R_l, K_rect, img_size, CV_32F, undist_map_x_l, undist_map_y_l);
+            cv::initUndistortRectifyMap(K_r, D_r, R_r, K_rect, img_size, CV_32F, undist_map_x_r, undist_map_y_r);
             break;
         }
         case camera::model_type_t::Fisheye: {
-            cv::fisheye::initUndistortRectifyMap(K_l, D_l, R_l, K_rect, img_size, CV_32F, undist_map_x_l_, undist_map_y_l_);
-            cv::fisheye::initUndistortRectifyMap(K_r, D_r, R_r, K_rect, img_size, CV_32F, undist_map_x_r_, undist_map_y_r_);
+            cv::fisheye::initUndistortRectifyMap(K_l, D_l, R_l, K_rect, img_size, CV_32F, undist_map_x_l, undist_map_y_l);
+            cv::fisheye::initUndistortRectifyMap(K_r, D_r, R_r, K_rect, img_size, CV_32F, undist_map_x_r, undist_map_y_r);
             break;
         }
         default: {
             throw std::runtime_error("Invalid model type for stereo rectification: " + camera->get_model_type_string());
         }
     }
+    // convert to the fixed-point representation which cv::remap uses internally
+    cv::convertMaps(undist_map_x_l, undist_map_y_l, undist_map_l_, undist_map_interp_l_, CV_16SC2);
+    cv::convertMaps(undist_map_x_r, undist_map_y_r, undist_map_r_, undist_map_interp_r_, CV_16SC2);
 }
 
 stereo_rectifier::~stereo_rectifier() {
@@ -61,8 +84,16 @@ stereo_rectifier::~stereo_rectifier() {
 
 void stereo_rectifier::rectify(const cv::Mat& in_img_l, const cv::Mat& in_img_r,
                                cv::Mat& out_img_l, cv::Mat& out_img_r) const {
-    cv::remap(in_img_l, out_img_l, undist_map_x_l_, undist_map_y_l_, cv::INTER_LINEAR);
-    cv::remap(in_img_r, out_img_r, undist_map_x_r_, undist_map_y_r_, cv::INTER_LINEAR);
+    cv::remap(in_img_l, out_img_l, undist_map_l_, undist_map_interp_l_, cv::INTER_LINEAR);
+    cv::remap(in_img_r, out_img_r, undist_map_r_, undist_map_interp_r_, cv::INTER_LINEAR);
+}
+
+void stereo_rectifier::rectify_to_grayscale(const cv::Mat& in_img_l, const cv::Mat& in_img_r, const camera::color_order_t color_order,
+                                            cv::Mat& out_img_l, cv::Mat& out_img_r) {
+    // the outputs are still grayscale, so that the conversion in the SLAM system is skipped
+    rectify(convert_to_grayscale(in_img_l, color_order, gray_img_l_),
+            convert_to_grayscale(in_img_r, color_order, gray_img_r_),
+            out_img_l, out_img_r);
 }
 
 cv::Mat stereo_rectifier::parse_vector_as_mat(const cv::Size& shape, const std::vector<double>& vec) {
@@ -26,6 +26,12 @@ public:
     void rectify(const cv::Mat& in_img_l, const cv::Mat& in_img_r,
                  cv::Mat& out_img_l, cv::Mat& out_img_r) const;
 
+    //! Apply stereo-rectification to the grayscale images of the input images
+    //! (NOTE: the color is converted before the remapping, so that only a single channel is remapped.
+    //!  The buffers of the color conversion are reused across the calls, so this is not thread-safe)
+    void rectify_to_grayscale(const cv::Mat& in_img_l, const cv::Mat& in_img_r, const camera::color_order_t color_order,
+                              cv::Mat& out_img_l, cv::Mat& out_img_r);
+
 private:
     //! Parse std::vector as cv::Mat
     static cv::Mat parse_vector_as_mat(const cv::Size& shape, const std::vector<double>& vec);
@@ -36,14 +42,22 @@ private:
     //! camera model type before rectification
     const camera::model_type_t model_type_;
 
-    //! undistortion map for x-axis in left image
-    cv::Mat undist_map_x_l_;
-    //! undistortion map for y-axis in left image
-    cv::Mat undist_map_y_l_;
-    //! undistortion map for x-axis in right image
-    cv::Mat undist_map_x_r_;
-    //! undistortion map for y-axis in right image
-    cv::Mat undist_map_y_r_;
+    // (NOTE: the undistortion maps are stored in the fixed-point representation of cv::remap,
+    //  so that the maps are not converted at every remapping)
+
+    //! undistortion map for the integer coordinates in left image (CV_16SC2)
+    cv::Mat undist_map_l_;
+    //! undistortion map for the interpolation coefficients in left image (CV_16UC1)
+    cv::Mat undist_map_interp_l_;
+    //! undistortion map for the integer coordinates in right image (CV_16SC2)
+    cv::Mat undist_map_r_;
+    //! undistortion map for the interpolation coefficients in right image (CV_16UC1)
+    cv::Mat undist_map_interp_r_;
+
+    //! buffer of the grayscale left image before rectification
+    cv::Mat gray_img_l_;
+    //! buffer of the grayscale right image before rectification
+    cv::Mat gray_img_r_;
 };
 
 } // namespace util
@@ -0,0 +1,201 @@
+#include "stella_vslam/util/thread_pool.h"
+#include "stella_vslam/util/thread_scheduling.h"
+
+#include <algorithm>
+
+namespace stella_vslam {
+namespace util {
+
+namespace {
+//! pool of the calling worker (nullptr if the thread is not a worker)
+thread_local const thread_pool* current_pool = nullptr;
+//! index of the calling worker in the pool
+thread_local int current_worker_idx = -1;
+//! client to which the tasks submitted from the calling thread are accounted
+thread_local unsigned int current_client_id = 0;
+} // namespace
+
+thread_pool::client_scope::client_scope(const unsigned int client_id)
+    : prev_client_id_(current_client_id) {
+    current_client_id = client_id;
+}
+
+thread_pool::client_scope::~client_scope() {
+    current_client_id = prev_client_id_;
+}
+
+unsigned int thread_pool::get_current_client_id() {
+    return current_client_id;
+}
+
+thread_pool::thread_pool(const unsigned int num_threads, const std::vector<int>& cpu_ids)
+    : global_queues_(1) {
+    // (the local queues are created before the workers start)
+    local_queues_.reserve(num_threads);
+    for (unsigned int i = 0; i < num_threads; ++i) {
+        local_queues_.emplace_back(new local_queue());
+    }
+    workers_.reserve(num_threads);
+    for (unsigned int i = 0; i < num_threads; ++i) {
+        std::vector<int> worker_cpu_ids;
+        if (!cpu_ids.empty()) {
+            worker_cpu_ids.push_back(cpu_ids.at(i % cpu_ids.size()));
+        }
+        workers_.emplace_back(&thread_pool::run_worker, this, i, worker_cpu_ids);
+    }
+}
+
+thread_pool::~thread_pool() {
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        is_terminated_ = true;
+    }
+    cond_.notify_all();
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+    // run the tasks left by the pool without any worker
+    while (run_pending_task()) {
+    }
+}
+
+unsigned int thread_pool::add_client() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    global_queues_.emplace_back();
+    return global_queues_.size() - 1;
+}
+
+bool thread_pool::run_pending_task() {
+    task_t task;
+    if (!pop_task(task)) {
+        return false;
+    }
+    task();
+    return true;
+}
+
+bool thread_pool::run_pending_task_while_waiting(const task_priority_t priority) {
+    task_t task;
+    if (get_current_worker_index() < 0 && !workers_.empty()) {
+        // the threads outside of the pool leave the other tasks to the workers
+        if (!pop_task_of_client(task, current_client_id, priority)) {
+            return false;
+        }
+    }
+    else if (!pop_task(task)) {
+        return false;
+    }
+    task();
+    return true;
+}
+
+void thread_pool::push_task(task_t&& task, const task_priority_t priority) {
+    const int worker_idx = get_current_worker_index();
+    if (0 <= worker_idx) {
+        auto& queue = *local_queues_.at(worker_idx);
+        std::lock_guard<std::mutex> lock_queue(queue.mtx_);
+        queue.tasks_.push_back(std::move(task));
+    }
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (worker_idx < 0) {
+            // (the clients of the other pools are accounted to the default client)
+            const unsigned int client_id = current_client_id < global_queues_.size() ? current_client_id : 0;
+            global_queues_.at(client_id).at(static_cast<unsigned int>(priority)).push_back(std::move(task));
+        }
+        ++num_pending_tasks_;
+    }
+    cond_.notify_one();
+}
+
+bool thread_pool::pop_task(task_t& task) {
+    const int worker_idx = get_current_worker_index();
+    // the nested tasks of the worker itself (the latest one first)
+    if (0 <= worker_idx) {
+        auto& queue = *local_queues_.at(worker_idx);
+        std::lock_guard<std::mutex> lock_queue(queue.mtx_);
+        if (!queue.tasks_.empty()) {
+            task = std::move(queue.tasks_.back());
+            queue.tasks_.pop_back();
+            --num_pending_tasks_;
+            return true;
+        }
+    }
+    // the tasks from the outside of the pool
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        const unsigned int num_clients = global_queues_.size();
+        for (unsigned int priority = 0; priority < next_client_ids_.size(); ++priority) {
+            // the clients are visited in turn from the next one of the last taken task
+            for (unsigned int i = 0; i < num_clients; ++i) {
+                const unsigned int client_id = (next_client_ids_.at(priority) + i) % num_clients;
+                auto& queue = global_queues_.at(client_id).at(priority);
+                if (!queue.empty()) {
+                    task = std::move(queue.front());
+                    queue.pop_front();
+                    next_client_ids_.at(priority) = (client_id + 1) % num_clients;
+                    --num_pending_tasks_;
+                    return true;
+                }
+            }
+        }
+    }
+    // steal the nested tasks of the other workers (the oldest one first)
+    const unsigned int num_queues = local_queues_.size();
+    for (unsigned int i = 0; i < num_queues; ++i) {
+        const unsigned int victim_idx = (std::max(worker_idx, 0) + i) % num_queues;
+        if (static_cast<int>(victim_idx) == worker_idx) {
+            continue;
+        }
+        auto& queue = *local_queues_.at(victim_idx);
+        std::lock_guard<std::mutex> lock_queue(queue.mtx_);
+        if (!queue.tasks_.empty()) {
+            task = std::move(queue.tasks_.front());
+            queue.tasks_.pop_front();
+            --num_pending_tasks_;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool thread_pool::pop_task_of_client(task_t& task, const unsigned int client_id, const task_priority_t priority) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    // (the clients of the other pools are accounted to the default client, as push_task())
+    auto& queues = global_queues_.at(client_id < global_queues_.size() ? client_id : 0);
+    for (unsigned int i = 0; i <= static_cast<unsigned int>(priority); ++i) {
+        auto& queue = queues.at(i);
+        if (!queue.empty()) {
+            task = std::move(queue.front());
+            queue.pop_front();
+            --num_pending_tasks_;
+            return true;
+        }
+    }
+    return false;
+}
+
+int thread_pool::get_current_worker_index() const {
+    return current_pool == this ? current_worker_idx : -1;
+}
+
+void thread_pool::run_worker(const unsigned int worker_idx, const std::vector<int> cpu_ids) {
+    current_pool = this;
+    current_worker_idx = static_cast<int>(worker_idx);
+    set_current_thread_affinity(cpu_ids);
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mtx_);
+            cond_.wait(lock, [this] { return is_terminated_ || 0 < num_pending_tasks_; });
+            if (num_pending_tasks_ <= 0) {
+                // terminated
+                return;
+            }
+        }
+        run_pending_task();
+    }
+}
+
+} // namespace util
+} // namespace stella_vslam
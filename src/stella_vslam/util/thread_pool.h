@@ -0,0 +1,166 @@
+#ifndef STELLA_VSLAM_UTIL_THREAD_POOL_H
+#define STELLA_VSLAM_UTIL_THREAD_POOL_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace stella_vslam {
+namespace util {
+
+//! Priority of the tasks submitted from the outside of the pool
+enum class task_priority_t : unsigned int {
+    //! tasks on the critical path of the tracking
+    High = 0,
+    //! tasks of the local mapping
+    Normal = 1,
+    //! background tasks such as the loop detection and the loop BA
+    Low = 2
+};
+
+/**
+ * Persistent worker threads which run the submitted tasks
+ * The tasks submitted from the outside of the pool are run in the order of the priorities, and in the FIFO order within a priority.
+ * The tasks submitted by a worker (the nested tasks) are pushed to the local queue of the worker,
+ * which runs them in the LIFO order, and the other workers steal them in the FIFO order when they are idle.
+ * The tasks can submit the other tasks and wait for them, because the waiting thread runs the pending tasks by itself,
+ * so the nested parallelism does not oversubscribe the cores with additional threads.
+ * (a waiting thread outside of the pool only runs the tasks of its own client which are not less urgent than its work,
+ *  so that it is not delayed by the background tasks or by the other clients)
+ * The pool can be shared by the clients (e.g. the system instances in a process), whose tasks are taken in turn
+ * within each priority, so that a busy client does not starve the others.
+ * (NOTE: the tasks are also run by wait() if the number of the threads is zero)
+ */
+class thread_pool {
+public:
+    /**
+     * Constructor
+     * @param num_threads number of the worker threads
+     * @param cpu_ids CPU cores to which the workers are pinned in turn (not pinned if empty)
+     */
+    explicit thread_pool(const unsigned int num_threads, const std::vector<int>& cpu_ids = {});
+
+    /**
+     * Destructor (the pending tasks are run before the workers are joined)
+     */
+    ~thread_pool();
+
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+
+    /**
+     * Scope in which the tasks submitted from the calling thread are accounted to the client (see add_client())
+     * (the scopes can be nested, and the tasks are accounted to the default client 0 outside of them)
+     */
+    class client_scope {
+    public:
+        explicit client_scope(const unsigned int client_id);
+        ~client_scope();
+
+        client_scope(const client_scope&) = delete;
+        client_scope& operator=(const client_scope&) = delete;
+
+    private:
+        const unsigned int prev_client_id_;
+    };
+
+    //! Add a client whose tasks are scheduled fairly with the ones of the other clients
+    //! (return the ID of the client, which is passed to client_scope)
+    unsigned int add_client();
+
+    //! Get the client to which the tasks submitted from the calling thread are accounted
+    //! (to pass it to the client_scope of a thread started from this thread)
+    static unsigned int get_current_client_id();
+
+    //! Get the number of the worker threads
+    unsigned int get_num_threads() const {
+        return workers_.size();
+    }
+
+    //! Submit the task, whose result is obtained through the future
+    //! (the priority is ignored for the nested tasks, which are run before the other tasks by the submitting worker)
+    template<typename F>
+    std::future<typename std::result_of<F()>::type> submit(F&& task, const task_priority_t priority = task_priority_t::Normal) {
+        using result_t = typename std::result_of<F()>::type;
+        auto packaged_task = std::make_shared<std::packaged_task<result_t()>>(std::forward<F>(task));
+        auto future = packaged_task->get_future();
+        push_task([packaged_task] { (*packaged_task)(); }, priority);
+        return future;
+    }
+
+    //! Wait for the task while running the pending tasks on this thread
+    //! (the thread outside of the pool only runs the tasks of its client whose priorities are the given one or higher,
+    //!  unless the pool has no worker)
+    template<typename T>
+    void wait(const std::future<T>& future, const task_priority_t priority = task_priority_t::Normal) {
+        while (future.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            // if no task is pending, the task of the future is running on another thread
+            if (!run_pending_task_while_waiting(priority)) {
+                future.wait();
+            }
+        }
+    }
+
+    //! Run a pending task on this thread (return false if no task is pending)
+    bool run_pending_task();
+
+private:
+    using task_t = std::function<void()>;
+
+    //! queue of the nested tasks of a worker
+    struct local_queue {
+        std::mutex mtx_;
+        std::deque<task_t> tasks_;
+    };
+
+    //! Push the task to the local queue if called by a worker, otherwise to the global queue of the priority
+    void push_task(task_t&& task, const task_priority_t priority);
+
+    //! Pop a task from the local queue of the calling worker, the global queues in the order of the priorities,
+    //! or the local queues of the other workers
+    bool pop_task(task_t& task);
+
+    //! Pop a task of the client from the global queues of the priorities up to the given one
+    bool pop_task_of_client(task_t& task, const unsigned int client_id, const task_priority_t priority);
+
+    //! Run a pending task on the thread waiting in wait() (return false if no task to run is pending)
+    bool run_pending_task_while_waiting(const task_priority_t priority);
+
+    //! Get the index of the calling worker (-1 if not a worker of this pool)
+    int get_current_worker_index() const;
+
+    //! Main loop of a worker thread
+    void run_worker(const unsigned int worker_idx, const std::vector<int> cpu_ids);
+
+    //! worker threads
+    std::vector<std::thread> workers_;
+    //! local queues of the workers
+    std::vector<std::unique_ptr<local_queue>> local_queues_;
+
+    std::mutex mtx_;
+    //! notified when a task is submitted or the pool is terminated
+    std::condition_variable cond_;
+    //! global queues of the pending tasks of each client (indexed by the priorities)
+    std::vector<std::array<std::deque<task_t>, 3>> global_queues_;
+    //! client whose task is taken first within each priority (round-robin)
+    std::array<unsigned int, 3> next_client_ids_{{0, 0, 0}};
+    //! number of the pending tasks in all of the queues
+    //! (signed, because a task can be popped before the increment of its push)
+    std::atomic<int> num_pending_tasks_{0};
+    //! the workers are being terminated or not
+    bool is_terminated_ = false;
+};
+
+} // namespace util
+} // namespace stella_vslam
+
+#endif // STELLA_VSLAM_UTIL_THREAD_POOL_H
@@ -0,0 +1,110 @@
+#include "stella_vslam/util/thread_scheduling.h"
+
+#include <cerrno>
+#include <cstring>
+
+#include <spdlog/spdlog.h>
+#include <yaml-cpp/yaml.h>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace stella_vslam {
+namespace util {
+
+thread_scheduling_params thread_scheduling_params::load(const YAML::Node& yaml_node) {
+    thread_scheduling_params params;
+    params.cpu_ids_ = yaml_node["cpu_affinity"].as<std::vector<int>>(std::vector<int>());
+    params.realtime_priority_ = yaml_node["realtime_priority"].as<int>(0);
+    params.nice_ = yaml_node["nice"].as<int>(0);
+    params.numa_node_ = yaml_node["numa_node"].as<int>(-1);
+    if (params.realtime_priority_ < 0 || 99 < params.realtime_priority_) {
+        throw std::runtime_error("realtime_priority must be in [0, 99]");
+    }
+    if (params.nice_ < -20 || 19 < params.nice_) {
+        throw std::runtime_error("nice must be in [-20, 19]");
+    }
+    return params;
+}
+
+bool set_current_thread_affinity(const std::vector<int>& cpu_ids) {
+    if (cpu_ids.empty()) {
+        return false;
+    }
+#ifdef __linux__
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    for (const auto cpu_id : cpu_ids) {
+        if (cpu_id < 0 || CPU_SETSIZE <= cpu_id) {
+            spdlog::warn("set_current_thread_affinity: invalid CPU ID {}", cpu_id);
+            continue;
+        }
+        CPU_SET(cpu_id, &cpu_set);
+    }
+    const int ret = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpu_set);
+    if (ret != 0) {
+        spdlog::warn("set_current_thread_affinity: pthread_setaffinity_np failed ({})", std::strerror(ret));
+        return false;
+    }
+    return true;
+#else
+    spdlog::warn("set_current_thread_affinity: not supported on this platform");
+    return false;
+#endif
+}
+
+bool apply_current_thread_scheduling(const thread_scheduling_params& params) {
+    bool succeeded = true;
+    if (!params.cpu_ids_.empty()) {
+        succeeded &= set_current_thread_affinity(params.cpu_ids_);
+    }
+#ifdef __linux__
+    if (0 < params.realtime_priority_) {
+        sched_param param;
+        param.sched_priority = params.realtime_priority_;
+        const int ret = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if (ret != 0) {
+            spdlog::warn("apply_current_thread_scheduling: SCHED_FIFO is not applied ({})", std::strerror(ret));
+            succeeded = false;
+        }
+    }
+    else if (params.nice_ != 0) {
+        // the nice value of a thread is set with its thread ID on Linux
+        const auto tid = static_cast<id_t>(syscall(SYS_gettid));
+        if (setpriority(PRIO_PROCESS, tid, params.nice_) != 0) {
+            spdlog::warn("apply_current_thread_scheduling: the nice value is not applied ({})", std::strerror(errno));
+            succeeded = false;
+        }
+    }
+    if (0 <= params.numa_node_) {
+        // prefer the node for the allocations of this thread (the same as set_mempolicy(MPOL_PREFERRED), without libnuma)
+        constexpr int mpol_preferred = 1;
+        constexpr unsigned int num_bits_of_mask = 8 * sizeof(unsigned long);
+        if (static_cast<unsigned int>(params.numa_node_) < num_bits_of_mask) {
+            const unsigned long node_mask = 1UL << params.numa_node_;
+            if (syscall(SYS_set_mempolicy, mpol_preferred, &node_mask, num_bits_of_mask + 1) != 0) {
+                spdlog::warn("apply_current_thread_scheduling: the NUMA policy is not applied ({})", std::strerror(errno));
+                succeeded = false;
+            }
+        }
+        else {
+            spdlog::warn("apply_current_thread_scheduling: invalid NUMA node {}", params.numa_node_);
+            succeeded = false;
+        }
+    }
+#else
+    if (0 < params.realtime_priority_ || params.nice_ != 0 || 0 <= params.numa_node_) {
+        spdlog::warn("apply_current_thread_scheduling: not supported on this platform");
+        succeeded = false;
+    }
+#endif
+    return succeeded;
+}
+
+} // namespace util
+} // namespace stella_vslam
@@ -0,0 +1,52 @@
+#ifndef STELLA_VSLAM_UTIL_THREAD_SCHEDULING_H
+#define STELLA_VSLAM_UTIL_THREAD_SCHEDULING_H
+
+#include <vector>
+
+namespace YAML {
+class Node;
+} // namespace YAML
+
+namespace stella_vslam {
+namespace util {
+
+//! Scheduling of a thread (the default values leave the scheduling of the thread unchanged)
+struct thread_scheduling_params {
+    //! CPU cores to which the thread is pinned (not pinned if empty)
+    std::vector<int> cpu_ids_;
+    //! priority of SCHED_FIFO in [1, 99] (SCHED_FIFO is not used if 0)
+    int realtime_priority_ = 0;
+    //! nice value in [-20, 19] (used only if SCHED_FIFO is not used)
+    int nice_ = 0;
+    //! NUMA node from which the memory is preferably allocated by the thread (not changed if negative)
+    int numa_node_ = -1;
+
+    //! Load the parameters (cpu_affinity, realtime_priority, nice, numa_node)
+    static thread_scheduling_params load(const YAML::Node& yaml_node);
+
+    //! The parameters change the scheduling or not
+    bool is_default() const {
+        return cpu_ids_.empty() && realtime_priority_ == 0 && nice_ == 0 && numa_node_ < 0;
+    }
+};
+
+/**
+ * Pin the calling thread to the CPU cores
+ * (NOTE: nothing is done if cpu_ids is empty. Only supported on Linux)
+ * @param cpu_ids
+ * @return true if the affinity is set
+ */
+bool set_current_thread_affinity(const std::vector<int>& cpu_ids);
+
+/**
+ * Apply the scheduling to the calling thread
+ * (NOTE: SCHED_FIFO and the negative nice values need the privilege (CAP_SYS_NICE). Only supported on Linux)
+ * @param params
+ * @return true if all of the settings are applied
+ */
+bool apply_current_thread_scheduling(const thread_scheduling_params& params);
+
+} // namespace util
+} // namespace stella_vslam
+
+#endif // STELLA_VSLAM_UTIL_THREAD_SCHEDULING_H
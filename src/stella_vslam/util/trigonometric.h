@@ -3,6 +3,7 @@
 
 #include <cmath>
 
+#include <Eigen/Core>
 #include <opencv2/core/fast_math.hpp>
 
 namespace stella_vslam {
@@ -45,6 +46,38 @@ inline float sin(float v) {
     return stella_vslam::util::cos(_PI_2 - v);
 }
 
+//! odd minimax polynomial of atan(t) for t in [0, 1] (max error: 6e-9 rad)
+template<typename T>
+inline T _atan_0_1(const T& t) {
+    const T t2 = t * t;
+    return t * (0.99999988638360793 + t2 * (-0.33332597030279987 + t2 * (0.19985906791271588 + t2 * (-0.14161229330692304 + t2 * (0.10498946484047189 + t2 * (-0.072348580641238974 + t2 * (0.039781230420539868 + t2 * (-0.01440136152424314 + t2 * 0.0024567253715459575))))))));
+}
+
+//! approximation of std::atan2 (max error: 6e-9 rad)
+inline double atan2(const double y, const double x) {
+    const double abs_x = std::abs(x);
+    const double abs_y = std::abs(y);
+    const double max_abs = std::max(abs_x, abs_y);
+    const double t = (0.0 < max_abs) ? std::min(abs_x, abs_y) / max_abs : 0.0;
+    double v = _atan_0_1(t);
+    v = (abs_x < abs_y) ? M_PI_2 - v : v;
+    v = (x < 0.0) ? M_PI - v : v;
+    return (y < 0.0) ? -v : v;
+}
+
+//! element-wise approximation of std::atan2 written without branches so that Eigen can vectorize it (max error: 6e-9 rad)
+template<typename DerivedY, typename DerivedX>
+inline Eigen::ArrayXd atan2(const Eigen::ArrayBase<DerivedY>& y, const Eigen::ArrayBase<DerivedX>& x) {
+    const Eigen::ArrayXd abs_x = x.abs();
+    const Eigen::ArrayXd abs_y = y.abs();
+    const Eigen::ArrayXd max_abs = abs_x.max(abs_y);
+    const Eigen::ArrayXd t = (0.0 < max_abs).select(abs_x.min(abs_y) / max_abs, 0.0);
+    Eigen::ArrayXd v = _atan_0_1(t);
+    v = (abs_x < abs_y).select(M_PI_2 - v, v);
+    v = (x < 0.0).select(M_PI - v, v);
+    return (y < 0.0).select(-v, v);
+}
+
 } // namespace util
 } // namespace stella_vslam
 
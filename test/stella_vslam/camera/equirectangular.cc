@@ -0,0 +1,71 @@
+#include "stella_vslam/camera/equirectangular.h"
+
+#include <random>
+
+#include <gtest/gtest.h>
+
+using namespace stella_vslam;
+
+TEST(equirectangular, convert_points_to_bearings) {
+    const camera::equirectangular cam("camera", camera::color_order_t::RGB, 3840, 1920, 30);
+
+    std::mt19937 mt(42);
+    std::uniform_real_distribution<float> rand_x(0.0, cam.cols_);
+    std::uniform_real_distribution<float> rand_y(0.0, cam.rows_);
+    std::vector<cv::Point2f> pts;
+    for (unsigned int i = 0; i < 1000; ++i) {
+        pts.emplace_back(rand_x(mt), rand_y(mt));
+    }
+
+    eigen_alloc_vector<Vec3_t> bearings;
+    cam.convert_points_to_bearings(pts, bearings);
+    ASSERT_EQ(bearings.size(), pts.size());
+
+    for (unsigned int i = 0; i < pts.size(); ++i) {
+        // compare with the closed-form conversion
+        const double lon = (pts.at(i).x / static_cast<double>(cam.cols_) - 0.5) * (2.0 * M_PI);
+        const double lat = -(pts.at(i).y / static_cast<double>(cam.rows_) - 0.5) * M_PI;
+        const Vec3_t expected{std::cos(lat) * std::sin(lon), -std::sin(lat), std::cos(lat) * std::cos(lon)};
+        EXPECT_LT((bearings.at(i) - expected).norm(), 1e-9);
+    }
+
+    // convert back to the points
+    std::vector<cv::Point2f> reproj_pts;
+    cam.convert_bearings_to_points(bearings, reproj_pts);
+    ASSERT_EQ(reproj_pts.size(), pts.size());
+    for (unsigned int i = 0; i < pts.size(); ++i) {
+        EXPECT_NEAR(reproj_pts.at(i).x, pts.at(i).x, 1e-2);
+        EXPECT_NEAR(reproj_pts.at(i).y, pts.at(i).y, 1e-2);
+    }
+}
+
+TEST(equirectangular, reproject_points_to_image) {
+    const camera::equirectangular cam("camera", camera::color_order_t::RGB, 3840, 1920, 30);
+
+    const Mat33_t rot_cw = Eigen::AngleAxisd(0.3, Vec3_t(0.2, 1.0, -0.3).normalized()).toRotationMatrix();
+    const Vec3_t trans_cw(0.1, -0.2, 0.3);
+
+    std::mt19937 mt(42);
+    std::uniform_real_distribution<double> rand(-5.0, 5.0);
+    const unsigned int num_points = 1000;
+    MatX3_t pos_ws(num_points, 3);
+    for (unsigned int i = 0; i < num_points; ++i) {
+        pos_ws.row(i) << rand(mt), rand(mt), rand(mt);
+    }
+
+    MatX2_t reprojs;
+    VecX_t x_rights;
+    VecXb_t is_visible;
+    cam.reproject_points_to_image(rot_cw, trans_cw, pos_ws, reprojs, x_rights, is_visible);
+    ASSERT_EQ(reprojs.rows(), num_points);
+
+    for (unsigned int i = 0; i < num_points; ++i) {
+        EXPECT_TRUE(is_visible(i));
+        // compare with the closed-form reprojection
+        const Vec3_t bearing = (rot_cw * pos_ws.row(i).transpose() + trans_cw).normalized();
+        const double lat = -std::asin(bearing(1));
+        const double lon = std::atan2(bearing(0), bearing(2));
+        EXPECT_NEAR(reprojs(i, 0), cam.cols_ * (0.5 + lon / (2.0 * M_PI)), 1e-4);
+        EXPECT_NEAR(reprojs(i, 1), cam.rows_ * (0.5 - lat / M_PI), 1e-4);
+    }
+}
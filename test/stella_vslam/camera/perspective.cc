@@ -0,0 +1,90 @@
+#include "stella_vslam/camera/perspective.h"
+
+#include <random>
+
+#include <gtest/gtest.h>
+
+using namespace stella_vslam;
+
+TEST(perspective, reproject_points_to_image) {
+    const camera::perspective cam("camera", camera::setup_type_t::Stereo, camera::color_order_t::Gray,
+                                  640, 480, 30,
+                                  500, 500, 320, 240,
+                                  0, 0, 0, 0, 0,
+                                  40, 0);
+
+    const Mat33_t rot_cw = Eigen::AngleAxisd(0.1, Vec3_t(0.2, 1.0, -0.3).normalized()).toRotationMatrix();
+    const Vec3_t trans_cw(0.1, -0.2, 0.3);
+
+    // the points which are in front of and behind the camera and out of the image
+    std::mt19937 mt(42);
+    std::uniform_real_distribution<double> rand_xy(-3.0, 3.0);
+    std::uniform_real_distribution<double> rand_z(-2.0, 5.0);
+    const unsigned int num_points = 1000;
+    MatX3_t pos_ws(num_points, 3);
+    for (unsigned int i = 0; i < num_points; ++i) {
+        pos_ws.row(i) << rand_xy(mt), rand_xy(mt), rand_z(mt);
+    }
+
+    MatX2_t reprojs;
+    VecX_t x_rights;
+    VecXb_t is_visible;
+    cam.reproject_points_to_image(rot_cw, trans_cw, pos_ws, reprojs, x_rights, is_visible);
+    ASSERT_EQ(reprojs.rows(), num_points);
+    ASSERT_EQ(x_rights.rows(), num_points);
+    ASSERT_EQ(is_visible.rows(), num_points);
+
+    // the results must be same as the ones of the single-point version
+    unsigned int num_visible = 0;
+    for (unsigned int i = 0; i < num_points; ++i) {
+        Vec2_t reproj;
+        float x_right;
+        const bool visible = cam.reproject_to_image(rot_cw, trans_cw, pos_ws.row(i).transpose(), reproj, x_right);
+        EXPECT_EQ(is_visible(i), visible);
+        if (!visible) {
+            continue;
+        }
+        ++num_visible;
+        EXPECT_NEAR(reprojs(i, 0), reproj(0), 1e-6);
+        EXPECT_NEAR(reprojs(i, 1), reproj(1), 1e-6);
+        EXPECT_NEAR(x_rights(i), x_right, 1e-3);
+    }
+    EXPECT_LT(0, num_visible);
+    EXPECT_LT(num_visible, num_points);
+}
+
+TEST(perspective, reproject_points_to_bearing) {
+    const camera::perspective cam("camera", camera::setup_type_t::Monocular, camera::color_order_t::Gray,
+                                  640, 480, 30,
+                                  500, 500, 320, 240,
+                                  0, 0, 0, 0, 0);
+
+    const Mat33_t rot_cw = Eigen::AngleAxisd(-0.2, Vec3_t(1.0, 0.1, 0.4).normalized()).toRotationMatrix();
+    const Vec3_t trans_cw(-0.1, 0.2, 0.5);
+
+    std::mt19937 mt(42);
+    std::uniform_real_distribution<double> rand_xy(-3.0, 3.0);
+    std::uniform_real_distribution<double> rand_z(-2.0, 5.0);
+    const unsigned int num_points = 1000;
+    MatX3_t pos_ws(num_points, 3);
+    for (unsigned int i = 0; i < num_points; ++i) {
+        pos_ws.row(i) << rand_xy(mt), rand_xy(mt), rand_z(mt);
+    }
+
+    MatX3_t bearings;
+    VecXb_t is_visible;
+    cam.reproject_points_to_bearing(rot_cw, trans_cw, pos_ws, bearings, is_visible);
+    ASSERT_EQ(bearings.rows(), num_points);
+    ASSERT_EQ(is_visible.rows(), num_points);
+
+    // the results must be same as the ones of the single-point version
+    for (unsigned int i = 0; i < num_points; ++i) {
+        Vec3_t bearing;
+        const bool visible = cam.reproject_to_bearing(rot_cw, trans_cw, pos_ws.row(i).transpose(), bearing);
+        EXPECT_EQ(is_visible(i), visible);
+        if (!visible) {
+            continue;
+        }
+        EXPECT_LT((bearings.row(i).transpose() - bearing).norm(), 1e-9);
+    }
+}
@@ -0,0 +1,46 @@
+#include "stella_vslam/camera/base.h"
+#include "stella_vslam/camera/rig.h"
+
+#include <gtest/gtest.h>
+
+using namespace stella_vslam;
+
+TEST(rig, load_cameras_and_extrinsics) {
+    const auto yaml_node = YAML::Load(R"(
+cameras:
+  - {name: left, setup: monocular, model: perspective, color_order: Gray, cols: 640, rows: 480, fps: 30,
+     fx: 500, fy: 500, cx: 320, cy: 240, k1: 0, k2: 0, p1: 0, p2: 0, k3: 0,
+     extrinsics: [0, 0, -1, 0.1, 0, 1, 0, 0, 1, 0, 0, -0.2, 0, 0, 0, 1]}
+  - {name: back, setup: monocular, model: perspective, color_order: Gray, cols: 640, rows: 480, fps: 30,
+     fx: 400, fy: 400, cx: 320, cy: 240, k1: 0, k2: 0, p1: 0, p2: 0, k3: 0,
+     extrinsics: [-1, 0, 0, 0, 0, 1, 0, 0, 0, 0, -1, -0.5, 0, 0, 0, 1]}
+)");
+    const camera::rig rig(yaml_node);
+    ASSERT_EQ(rig.get_num_cameras(), 2);
+    EXPECT_EQ(rig.cameras_.at(0)->name_, "left");
+    EXPECT_EQ(rig.cameras_.at(1)->name_, "back");
+    // row-major
+    EXPECT_EQ(rig.poses_cb_.at(0)(0, 2), -1.0);
+    EXPECT_EQ(rig.poses_cb_.at(0)(0, 3), 0.1);
+    EXPECT_EQ(rig.poses_cb_.at(0)(2, 0), 1.0);
+    EXPECT_EQ(rig.poses_cb_.at(0)(2, 3), -0.2);
+    EXPECT_EQ(rig.poses_cb_.at(1)(2, 3), -0.5);
+}
+
+TEST(rig, reject_invalid_cameras) {
+    // the extrinsics must be a 4x4 matrix
+    EXPECT_THROW(camera::rig(YAML::Load(R"(
+cameras:
+  - {name: left, setup: monocular, model: perspective, color_order: Gray, cols: 640, rows: 480, fps: 30,
+     fx: 500, fy: 500, cx: 320, cy: 240, k1: 0, k2: 0, p1: 0, p2: 0, k3: 0,
+     extrinsics: [1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0]}
+)")),
+                 std::runtime_error);
+    // the equirectangular model is not supported
+    EXPECT_THROW(camera::rig(YAML::Load(R"(
+cameras:
+  - {name: pano, setup: monocular, model: equirectangular, color_order: RGB, cols: 1920, rows: 960, fps: 30,
+     extrinsics: [1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1]}
+)")),
+                 std::runtime_error);
+}
@@ -0,0 +1,85 @@
+#include "stella_vslam/camera/perspective.h"
+#include "stella_vslam/camera/fisheye.h"
+#include "stella_vslam/camera/undistortion_map.h"
+
+#include <random>
+
+#include <gtest/gtest.h>
+
+using namespace stella_vslam;
+
+namespace {
+std::vector<cv::Point2f> create_random_points(const unsigned int cols, const unsigned int rows) {
+    std::mt19937 mt(42);
+    std::uniform_real_distribution<float> rand_x(0.0, cols);
+    std::uniform_real_distribution<float> rand_y(0.0, rows);
+    std::vector<cv::Point2f> pts;
+    for (unsigned int i = 0; i < 1000; ++i) {
+        pts.emplace_back(rand_x(mt), rand_y(mt));
+    }
+    return pts;
+}
+} // namespace
+
+TEST(undistortion_map, perspective) {
+    camera::perspective cam("camera", camera::setup_type_t::Monocular, camera::color_order_t::Gray,
+                            640, 480, 30,
+                            500, 500, 320, 240,
+                            -0.28, 0.07, 0.0002, 0.00002, 0);
+
+    const auto dist_pts = create_random_points(cam.cols_, cam.rows_);
+    std::vector<cv::Point2f> undist_pts_iterative;
+    cam.undistort_points(dist_pts, undist_pts_iterative);
+
+    ASSERT_EQ(cam.get_undistortion_map(), nullptr);
+    cam.build_undistortion_map(8);
+    ASSERT_NE(cam.get_undistortion_map(), nullptr);
+    EXPECT_EQ(cam.get_undistortion_map()->get_grid_size(), 8);
+
+    std::vector<cv::Point2f> undist_pts_map;
+    cam.undistort_points(dist_pts, undist_pts_map);
+    ASSERT_EQ(undist_pts_map.size(), dist_pts.size());
+    for (unsigned int i = 0; i < dist_pts.size(); ++i) {
+        EXPECT_NEAR(undist_pts_map.at(i).x, undist_pts_iterative.at(i).x, 0.1);
+        EXPECT_NEAR(undist_pts_map.at(i).y, undist_pts_iterative.at(i).y, 0.1);
+    }
+
+    // the keypoint attributes are kept
+    std::vector<cv::KeyPoint> dist_keypts{cv::KeyPoint(dist_pts.at(0), 31.0, 45.0, 0.0, 3)};
+    std::vector<cv::KeyPoint> undist_keypts;
+    cam.undistort_keypoints(dist_keypts, undist_keypts);
+    ASSERT_EQ(undist_keypts.size(), 1);
+    EXPECT_FLOAT_EQ(undist_keypts.at(0).pt.x, undist_pts_map.at(0).x);
+    EXPECT_FLOAT_EQ(undist_keypts.at(0).pt.y, undist_pts_map.at(0).y);
+    EXPECT_FLOAT_EQ(undist_keypts.at(0).size, 31.0);
+    EXPECT_FLOAT_EQ(undist_keypts.at(0).angle, 45.0);
+    EXPECT_EQ(undist_keypts.at(0).octave, 3);
+}
+
+TEST(undistortion_map, fisheye) {
+    camera::fisheye cam("camera", camera::setup_type_t::Monocular, camera::color_order_t::Gray,
+                        640, 480, 30,
+                        300, 300, 320, 240,
+                        -0.013, -0.013, 0.008, -0.002);
+
+    const auto dist_pts = create_random_points(cam.cols_, cam.rows_);
+    std::vector<cv::Point2f> undist_pts_iterative;
+    cam.undistort_points(dist_pts, undist_pts_iterative);
+
+    cam.build_undistortion_map(8);
+    std::vector<cv::Point2f> undist_pts_map;
+    cam.undistort_points(dist_pts, undist_pts_map);
+    ASSERT_EQ(undist_pts_map.size(), dist_pts.size());
+    for (unsigned int i = 0; i < dist_pts.size(); ++i) {
+        EXPECT_NEAR(undist_pts_map.at(i).x, undist_pts_iterative.at(i).x, 0.1);
+        EXPECT_NEAR(undist_pts_map.at(i).y, undist_pts_iterative.at(i).y, 0.1);
+    }
+}
+
+TEST(undistortion_map, invalid_grid_size) {
+    camera::perspective cam("camera", camera::setup_type_t::Monocular, camera::color_order_t::Gray,
+                            640, 480, 30,
+                            500, 500, 320, 240,
+                            0, 0, 0, 0, 0);
+    EXPECT_THROW(cam.build_undistortion_map(0), std::runtime_error);
+}
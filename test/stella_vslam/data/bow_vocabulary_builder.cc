@@ -0,0 +1,194 @@
+#include "stella_vslam/data/bow_vocabulary.h"
+#include "stella_vslam/data/bow_vocabulary_builder.h"
+#include "stella_vslam/data/bow_vocabulary_image.h"
+#include "stella_vslam/util/thread_pool.h"
+
+#include <fstream>
+#include <random>
+#include <string>
+
+#include <gtest/gtest.h>
+
+using namespace stella_vslam;
+
+namespace {
+
+// descriptors which are scattered around the random centers with a few flipped bits
+std::vector<uint8_t> create_clustered_descriptors(const unsigned int num_centers, const unsigned int num_descs_per_center,
+                                                  std::vector<unsigned int>& center_indices) {
+    std::mt19937 mt(1);
+    std::uniform_int_distribution<int> rand_byte(0, 255);
+    std::uniform_int_distribution<int> rand_bit(0, 255);
+    std::vector<uint8_t> centers(num_centers * data::bow_vocabulary_builder::desc_size);
+    for (auto& byte : centers) {
+        byte = static_cast<uint8_t>(rand_byte(mt));
+    }
+    std::vector<uint8_t> descs;
+    center_indices.clear();
+    for (unsigned int i = 0; i < num_descs_per_center; ++i) {
+        for (unsigned int c = 0; c < num_centers; ++c) {
+            const auto first = centers.begin() + c * data::bow_vocabulary_builder::desc_size;
+            descs.insert(descs.end(), first, first + data::bow_vocabulary_builder::desc_size);
+            for (unsigned int j = 0; j < 8; ++j) {
+                const auto bit = rand_bit(mt);
+                descs.at(descs.size() - data::bow_vocabulary_builder::desc_size + bit / 8) ^= static_cast<uint8_t>(1 << (bit % 8));
+            }
+            center_indices.push_back(c);
+        }
+    }
+    return descs;
+}
+
+} // namespace
+
+TEST(bow_vocabulary_builder, separate_clusters) {
+    std::vector<unsigned int> center_indices;
+    const auto descs = create_clustered_descriptors(4, 200, center_indices);
+    const unsigned int num_descs = center_indices.size();
+
+    data::bow_vocabulary_builder builder(4, 1);
+    // two images
+    builder.add_image_descriptors(descs.data(), data::bow_vocabulary_builder::desc_size, num_descs / 2);
+    builder.add_image_descriptors(descs.data() + (num_descs / 2) * data::bow_vocabulary_builder::desc_size,
+                                  data::bow_vocabulary_builder::desc_size, num_descs - num_descs / 2);
+    builder.build();
+
+    ASSERT_EQ(builder.get_num_words(), 4u);
+    ASSERT_EQ(builder.get_nodes().size(), 5u);
+    // each cluster is quantized into its own word
+    std::vector<int> word_ids_of_centers(4, -1);
+    for (unsigned int i = 0; i < num_descs; ++i) {
+        const auto word_id = builder.quantize(descs.data() + i * data::bow_vocabulary_builder::desc_size);
+        auto& expected = word_ids_of_centers.at(center_indices.at(i));
+        if (expected < 0) {
+            expected = word_id;
+        }
+        EXPECT_EQ(static_cast<int>(word_id), expected);
+    }
+    // all of the words appear in both images
+    for (const auto& node : builder.get_nodes()) {
+        if (0 <= node.word_id_) {
+            EXPECT_FLOAT_EQ(node.weight_, 0.0f);
+        }
+    }
+}
+
+TEST(bow_vocabulary_builder, independent_of_threads) {
+    std::vector<unsigned int> center_indices;
+    const auto descs = create_clustered_descriptors(50, 400, center_indices);
+    const unsigned int num_descs = center_indices.size();
+
+    data::bow_vocabulary_builder builder_1(10, 3, num_descs, 10, 7);
+    data::bow_vocabulary_builder builder_2(10, 3, num_descs, 10, 7);
+    for (unsigned int i = 0; i < num_descs; i += 100) {
+        builder_1.add_image_descriptors(descs.data() + i * data::bow_vocabulary_builder::desc_size, data::bow_vocabulary_builder::desc_size, 100);
+        builder_2.add_image_descriptors(descs.data() + i * data::bow_vocabulary_builder::desc_size, data::bow_vocabulary_builder::desc_size, 100);
+    }
+    builder_1.build();
+    util::thread_pool pool(4);
+    builder_2.build(&pool);
+
+    ASSERT_EQ(builder_1.get_nodes().size(), builder_2.get_nodes().size());
+    for (unsigned int idx = 0; idx < builder_1.get_nodes().size(); ++idx) {
+        EXPECT_EQ(builder_1.get_nodes().at(idx).descriptor_, builder_2.get_nodes().at(idx).descriptor_);
+        EXPECT_EQ(builder_1.get_nodes().at(idx).children_, builder_2.get_nodes().at(idx).children_);
+        EXPECT_FLOAT_EQ(builder_1.get_nodes().at(idx).weight_, builder_2.get_nodes().at(idx).weight_);
+    }
+}
+
+TEST(bow_vocabulary_builder, reservoir_sampling) {
+    std::vector<unsigned int> center_indices;
+    const auto descs = create_clustered_descriptors(8, 100, center_indices);
+    const unsigned int num_descs = center_indices.size();
+
+    data::bow_vocabulary_builder builder(8, 2, 100);
+    builder.add_image_descriptors(descs.data(), data::bow_vocabulary_builder::desc_size, num_descs);
+    EXPECT_EQ(builder.get_num_images(), 1u);
+    EXPECT_EQ(builder.get_num_seen_descriptors(), num_descs);
+    EXPECT_EQ(builder.get_num_sampled_descriptors(), 100u);
+
+    builder.build();
+    EXPECT_LE(builder.get_num_words(), 64u);
+}
+
+TEST(bow_vocabulary_builder, save_dbow2_text) {
+    std::vector<unsigned int> center_indices;
+    const auto descs = create_clustered_descriptors(4, 50, center_indices);
+
+    data::bow_vocabulary_builder builder(4, 2);
+    EXPECT_THROW(builder.save("/tmp/stella_vslam_test_vocab.txt", data::bow_vocabulary_format_t::DBoW2_Text), std::runtime_error);
+    builder.add_image_descriptors(descs.data(), data::bow_vocabulary_builder::desc_size, center_indices.size());
+    builder.build();
+    builder.save("/tmp/stella_vslam_test_vocab.txt", data::bow_vocabulary_format_t::DBoW2_Text);
+
+    std::ifstream ifs("/tmp/stella_vslam_test_vocab.txt");
+    std::string line;
+    ASSERT_TRUE(std::getline(ifs, line));
+    EXPECT_EQ(line, "4 2 0 0");
+    unsigned int num_lines = 0;
+    while (std::getline(ifs, line)) {
+        ++num_lines;
+    }
+    // (the root is not written)
+    EXPECT_EQ(num_lines, builder.get_nodes().size() - 1);
+}
+
+TEST(bow_vocabulary_builder, save_image) {
+    std::vector<unsigned int> center_indices;
+    const auto descs = create_clustered_descriptors(16, 50, center_indices);
+
+    // (each descriptor is added as an image so that the words have the positive weights)
+    data::bow_vocabulary_builder builder(4, 3);
+    for (unsigned int i = 0; i < center_indices.size(); ++i) {
+        builder.add_image_descriptors(descs.data() + i * data::bow_vocabulary_builder::desc_size, data::bow_vocabulary_builder::desc_size, 1);
+    }
+    builder.build();
+    builder.save("/tmp/stella_vslam_test_vocab.img", data::bow_vocabulary_format_t::Image);
+    builder.save("/tmp/stella_vslam_test_vocab.fbow", data::bow_vocabulary_format_t::FBoW);
+    data::bow_vocabulary_image::convert_from_fbow("/tmp/stella_vslam_test_vocab.fbow", "/tmp/stella_vslam_test_vocab_converted.img");
+
+    ASSERT_TRUE(data::bow_vocabulary_image::is_image("/tmp/stella_vslam_test_vocab.img"));
+    EXPECT_FALSE(data::bow_vocabulary_image::is_image("/tmp/stella_vslam_test_vocab.fbow"));
+    const data::bow_vocabulary_image image("/tmp/stella_vslam_test_vocab.img");
+    const data::bow_vocabulary_image converted_image("/tmp/stella_vslam_test_vocab_converted.img");
+    EXPECT_EQ(image.get_branching_factor(), 4u);
+    EXPECT_EQ(image.get_num_words(), builder.get_num_words());
+
+    // the image quantizes each descriptor into the same word as the builder
+    for (unsigned int i = 0; i < center_indices.size(); ++i) {
+        const uint8_t* desc = descs.data() + i * data::bow_vocabulary_builder::desc_size;
+        data::bow_vector bow_vec;
+        data::bow_feature_vector bow_feat_vec;
+        image.transform(desc, data::bow_vocabulary_builder::desc_size, 1, 1, bow_vec, bow_feat_vec);
+        ASSERT_EQ(bow_vec.size(), 1u);
+        EXPECT_EQ(bow_vec.begin()->first, builder.quantize(desc));
+        ASSERT_EQ(bow_feat_vec.size(), 1u);
+        // (the node at the level 1 is a child of the root)
+        EXPECT_EQ(builder.get_nodes().at(bow_feat_vec.begin()->first).parent_, 0u);
+
+        data::bow_vector converted_bow_vec;
+        data::bow_feature_vector converted_bow_feat_vec;
+        converted_image.transform(desc, data::bow_vocabulary_builder::desc_size, 1, 1, converted_bow_vec, converted_bow_feat_vec);
+        EXPECT_EQ(converted_bow_vec, bow_vec);
+        EXPECT_EQ(converted_bow_feat_vec, bow_feat_vec);
+    }
+
+    // the BoW vector of all the descriptors is L1-normalized
+    data::bow_vector bow_vec;
+    data::bow_feature_vector bow_feat_vec;
+    image.transform(descs.data(), data::bow_vocabulary_builder::desc_size, center_indices.size(), 1, bow_vec, bow_feat_vec);
+    float sum = 0.0f;
+    for (const auto& word_weight : bow_vec) {
+        sum += word_weight.second;
+    }
+    EXPECT_NEAR(sum, 1.0f, 1e-5f);
+}
+
+TEST(bow_vocabulary_builder, invalid_params) {
+    EXPECT_THROW(data::bow_vocabulary_builder(1, 6), std::runtime_error);
+    EXPECT_THROW(data::bow_vocabulary_builder(256, 6), std::runtime_error);
+    EXPECT_THROW(data::bow_vocabulary_builder(10, 0), std::runtime_error);
+
+    data::bow_vocabulary_builder builder(10, 6);
+    EXPECT_THROW(builder.build(), std::runtime_error);
+}
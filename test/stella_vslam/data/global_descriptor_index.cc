@@ -0,0 +1,109 @@
+#include "stella_vslam/data/bow_vocabulary.h"
+#include "stella_vslam/data/global_descriptor_index.h"
+#include "stella_vslam/match/hamming.h"
+
+#include <random>
+
+#include <gtest/gtest.h>
+
+using namespace stella_vslam;
+
+namespace {
+
+data::global_descriptor_index::descriptor_t get_random_descriptor(std::mt19937& mt) {
+    std::uniform_int_distribution<int> rand_byte(0, 255);
+    data::global_descriptor_index::descriptor_t desc;
+    for (auto& byte : desc) {
+        byte = static_cast<uint8_t>(rand_byte(mt));
+    }
+    return desc;
+}
+
+} // namespace
+
+TEST(global_descriptor_index, add_and_erase) {
+    std::mt19937 mt(42);
+    const auto desc_0 = get_random_descriptor(mt);
+    const auto desc_1 = get_random_descriptor(mt);
+
+    data::global_descriptor_index index;
+    index.add(0, desc_0);
+    index.add(1, desc_1);
+    index.add(1, desc_0);
+    EXPECT_EQ(index.size(), 2);
+
+    auto nearest_keyfrms = index.get_nearest_keyframes(desc_1, 2, nullptr);
+    ASSERT_EQ(nearest_keyfrms.size(), 2);
+    EXPECT_EQ(nearest_keyfrms.at(0).first, 1);
+    EXPECT_EQ(nearest_keyfrms.at(0).second, 0);
+    EXPECT_EQ(nearest_keyfrms.at(1).first, 0);
+
+    // reject the nearest one
+    nearest_keyfrms = index.get_nearest_keyframes(desc_1, 2, [](const unsigned int id) { return id == 1; });
+    ASSERT_EQ(nearest_keyfrms.size(), 1);
+    EXPECT_EQ(nearest_keyfrms.front().first, 0);
+
+    index.erase(1);
+    index.erase(2);
+    EXPECT_EQ(index.size(), 1);
+    nearest_keyfrms = index.get_nearest_keyframes(desc_1, 2, nullptr);
+    ASSERT_EQ(nearest_keyfrms.size(), 1);
+    EXPECT_EQ(nearest_keyfrms.front().first, 0);
+
+    index.clear();
+    EXPECT_EQ(index.size(), 0);
+    EXPECT_TRUE(index.get_nearest_keyframes(desc_1, 2, nullptr).empty());
+}
+
+TEST(global_descriptor_index, nearest_neighbors) {
+    std::mt19937 mt(42);
+    std::uniform_int_distribution<int> rand_bit(0, 255);
+    // flip the bits at the random positions
+    auto add_noise = [&mt, &rand_bit](data::global_descriptor_index::descriptor_t desc) {
+        for (unsigned int i = 0; i < 16; ++i) {
+            const auto bit = rand_bit(mt);
+            desc.at(bit / 8) ^= static_cast<uint8_t>(1 << (bit % 8));
+        }
+        return desc;
+    };
+
+    // the keyframes observing the same place have the similar descriptors
+    constexpr unsigned int num_places = 100;
+    constexpr unsigned int num_keyfrms_per_place = 20;
+    std::vector<data::global_descriptor_index::descriptor_t> place_descs;
+    for (unsigned int place = 0; place < num_places; ++place) {
+        place_descs.push_back(get_random_descriptor(mt));
+    }
+    data::global_descriptor_index index(8, 32);
+    for (unsigned int i = 0; i < num_keyfrms_per_place; ++i) {
+        for (unsigned int place = 0; place < num_places; ++place) {
+            index.add(place * num_keyfrms_per_place + i, add_noise(place_descs.at(place)));
+        }
+    }
+    EXPECT_EQ(index.size(), num_places * num_keyfrms_per_place);
+
+    for (unsigned int place = 0; place < num_places; ++place) {
+        const auto nearest_keyfrms = index.get_nearest_keyframes(add_noise(place_descs.at(place)), 5, nullptr);
+        ASSERT_EQ(nearest_keyfrms.size(), 5);
+        for (const auto& id_and_dist : nearest_keyfrms) {
+            EXPECT_EQ(id_and_dist.first / num_keyfrms_per_place, place);
+        }
+    }
+}
+
+TEST(global_descriptor_index, compute_descriptor) {
+    data::bow_vector bow_vec_1, bow_vec_2, bow_vec_3;
+    for (unsigned int word_id = 0; word_id < 100; ++word_id) {
+        bow_vec_1[word_id] = 0.01;
+        // shares 90 words with bow_vec_1
+        bow_vec_2[word_id + 10] = 0.01;
+        // shares no words with bow_vec_1
+        bow_vec_3[word_id + 1000] = 0.01;
+    }
+    const auto desc_1 = data::global_descriptor_index::compute_descriptor(bow_vec_1);
+    const auto desc_2 = data::global_descriptor_index::compute_descriptor(bow_vec_2);
+    const auto desc_3 = data::global_descriptor_index::compute_descriptor(bow_vec_3);
+    EXPECT_EQ(match::compute_hamming_distance_256(desc_1.data(), data::global_descriptor_index::compute_descriptor(bow_vec_1).data()), 0);
+    EXPECT_LT(match::compute_hamming_distance_256(desc_1.data(), desc_2.data()), 64);
+    EXPECT_GT(match::compute_hamming_distance_256(desc_1.data(), desc_3.data()), 96);
+}
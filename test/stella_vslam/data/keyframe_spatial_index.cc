@@ -0,0 +1,81 @@
+#include "stella_vslam/data/keyframe_spatial_index.h"
+
+#include <algorithm>
+#include <random>
+
+#include <gtest/gtest.h>
+
+using namespace stella_vslam;
+
+namespace {
+
+bool contains(const std::vector<unsigned int>& ids, const unsigned int id) {
+    return std::find(ids.begin(), ids.end(), id) != ids.end();
+}
+
+} // namespace
+
+TEST(keyframe_spatial_index, update_and_erase) {
+    data::keyframe_spatial_index spatial_index(1.0);
+    spatial_index.update(0, Vec3_t(0.5, 0.5, 0.5));
+    spatial_index.update(1, Vec3_t(10.5, 0.5, 0.5));
+    EXPECT_EQ(spatial_index.size(), 2);
+
+    auto ids = spatial_index.get_keyframes_in_sphere(Vec3_t(0.0, 0.0, 0.0), 1.0);
+    EXPECT_TRUE(contains(ids, 0));
+    EXPECT_FALSE(contains(ids, 1));
+
+    // move the keyframe
+    spatial_index.update(1, Vec3_t(-0.5, 0.5, 0.5));
+    EXPECT_EQ(spatial_index.size(), 2);
+    ids = spatial_index.get_keyframes_in_sphere(Vec3_t(0.0, 0.0, 0.0), 1.0);
+    EXPECT_TRUE(contains(ids, 0));
+    EXPECT_TRUE(contains(ids, 1));
+    EXPECT_TRUE(spatial_index.get_keyframes_in_sphere(Vec3_t(10.5, 0.5, 0.5), 1.0).empty());
+
+    spatial_index.erase(0);
+    spatial_index.erase(2);
+    EXPECT_EQ(spatial_index.size(), 1);
+    ids = spatial_index.get_keyframes_in_sphere(Vec3_t(0.0, 0.0, 0.0), 1.0);
+    EXPECT_FALSE(contains(ids, 0));
+    EXPECT_TRUE(contains(ids, 1));
+
+    spatial_index.clear();
+    EXPECT_EQ(spatial_index.size(), 0);
+    EXPECT_TRUE(spatial_index.get_keyframes_in_sphere(Vec3_t(0.0, 0.0, 0.0), 1.0).empty());
+}
+
+TEST(keyframe_spatial_index, invalid_cell_size) {
+    EXPECT_THROW(data::keyframe_spatial_index(0.0), std::runtime_error);
+}
+
+TEST(keyframe_spatial_index, superset_of_exact_queries) {
+    std::mt19937 rng(0);
+    std::uniform_real_distribution<double> dist(-20.0, 20.0);
+
+    data::keyframe_spatial_index spatial_index(0.7);
+    eigen_alloc_vector<Vec3_t> cam_centers;
+    for (unsigned int id = 0; id < 2000; ++id) {
+        cam_centers.emplace_back(dist(rng), dist(rng), dist(rng));
+        spatial_index.update(id, cam_centers.back());
+    }
+
+    const Vec3_t axis = Vec3_t(0.0, 1.0, 0.2).normalized();
+    for (unsigned int trial = 0; trial < 20; ++trial) {
+        const Vec3_t center(dist(rng), dist(rng), dist(rng));
+        // small and large radii exercise both the box and the occupied-voxel traversals
+        for (const double radius : {0.5, 3.0, 50.0}) {
+            const auto sphere_ids = spatial_index.get_keyframes_in_sphere(center, radius);
+            const auto cylinder_ids = spatial_index.get_keyframes_in_cylinder(center, axis, radius);
+            for (unsigned int id = 0; id < cam_centers.size(); ++id) {
+                const Vec3_t vec = cam_centers.at(id) - center;
+                if (vec.norm() < radius) {
+                    EXPECT_TRUE(contains(sphere_ids, id));
+                }
+                if ((vec - vec.dot(axis) * axis).norm() < radius) {
+                    EXPECT_TRUE(contains(cylinder_ids, id));
+                }
+            }
+        }
+    }
+}
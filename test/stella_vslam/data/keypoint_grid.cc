@@ -0,0 +1,40 @@
+#include "stella_vslam/data/keypoint_grid.h"
+
+#include <gtest/gtest.h>
+
+using namespace stella_vslam;
+
+TEST(keypoint_grid, assign_and_get_cell) {
+    // 2 x 3 grid
+    data::keypoint_grid grid;
+    grid.assign(2, 3, std::vector<int>{4, 0, -1, 4, 5, 0});
+
+    EXPECT_EQ(grid.num_cols(), 2);
+    EXPECT_EQ(grid.num_rows(), 3);
+    EXPECT_EQ(grid.num_assigned(), 5);
+
+    const auto cell_0_0 = grid.cell(0, 0);
+    ASSERT_EQ(cell_0_0.size(), 2);
+    EXPECT_EQ(*cell_0_0.begin(), 1);
+    EXPECT_EQ(*(cell_0_0.begin() + 1), 5);
+
+    // cell_idx_x * num_rows + cell_idx_y = 4
+    const auto cell_1_1 = grid.cell(1, 1);
+    ASSERT_EQ(cell_1_1.size(), 2);
+    EXPECT_EQ(*cell_1_1.begin(), 0);
+    EXPECT_EQ(*(cell_1_1.begin() + 1), 3);
+
+    const auto cell_1_2 = grid.cell(1, 2);
+    ASSERT_EQ(cell_1_2.size(), 1);
+    EXPECT_EQ(*cell_1_2.begin(), 4);
+
+    EXPECT_TRUE(grid.cell(0, 1).empty());
+    EXPECT_TRUE(grid.cell(1, 0).empty());
+}
+
+TEST(keypoint_grid, get_cell_of_empty_grid) {
+    data::keypoint_grid grid;
+    EXPECT_TRUE(grid.empty());
+    EXPECT_TRUE(grid.cell(0, 0).empty());
+    EXPECT_EQ(grid.cell(3, 2).size(), 0);
+}
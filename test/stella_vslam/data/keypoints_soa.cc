@@ -0,0 +1,37 @@
+#include "stella_vslam/data/keypoints_soa.h"
+
+#include <gtest/gtest.h>
+
+using namespace stella_vslam;
+
+TEST(keypoints_soa, assign_and_convert) {
+    std::vector<cv::KeyPoint> keypts;
+    keypts.emplace_back(cv::Point2f(10.5, 20.25), 31.0, 45.0, 0.5, 0);
+    keypts.emplace_back(cv::Point2f(100.0, 50.0), 37.2, 270.0, 1.5, 2);
+
+    const data::keypoints_soa keypts_soa(keypts);
+    ASSERT_EQ(keypts_soa.size(), 2);
+
+    for (unsigned int idx = 0; idx < keypts.size(); ++idx) {
+        EXPECT_FLOAT_EQ(keypts_soa.x_.at(idx), keypts.at(idx).pt.x);
+        EXPECT_FLOAT_EQ(keypts_soa.y_.at(idx), keypts.at(idx).pt.y);
+        EXPECT_EQ(keypts_soa.octave_.at(idx), keypts.at(idx).octave);
+        EXPECT_FLOAT_EQ(keypts_soa.angle_.at(idx), keypts.at(idx).angle);
+        EXPECT_FLOAT_EQ(keypts_soa.response_.at(idx), keypts.at(idx).response);
+    }
+
+    const auto converted = keypts_soa.to_keypoints();
+    ASSERT_EQ(converted.size(), keypts.size());
+    for (unsigned int idx = 0; idx < keypts.size(); ++idx) {
+        EXPECT_EQ(converted.at(idx).pt, keypts.at(idx).pt);
+        EXPECT_EQ(converted.at(idx).octave, keypts.at(idx).octave);
+        EXPECT_FLOAT_EQ(converted.at(idx).angle, keypts.at(idx).angle);
+        EXPECT_FLOAT_EQ(converted.at(idx).response, keypts.at(idx).response);
+    }
+}
+
+TEST(keypoints_soa, empty) {
+    const data::keypoints_soa keypts_soa;
+    EXPECT_TRUE(keypts_soa.empty());
+    EXPECT_TRUE(keypts_soa.to_keypoints().empty());
+}
@@ -0,0 +1,94 @@
+#include "stella_vslam/data/landmark_descriptor_index.h"
+
+#include <algorithm>
+#include <array>
+#include <random>
+
+#include <gtest/gtest.h>
+
+using namespace stella_vslam;
+
+namespace {
+
+using descriptor_t = std::array<uint8_t, 32>;
+
+descriptor_t get_random_descriptor(std::mt19937& mt) {
+    std::uniform_int_distribution<int> rand_byte(0, 255);
+    descriptor_t desc;
+    for (auto& byte : desc) {
+        byte = static_cast<uint8_t>(rand_byte(mt));
+    }
+    return desc;
+}
+
+//! Flip the bits at the random positions
+descriptor_t flip_bits(const descriptor_t& desc, const unsigned int num_bits, std::mt19937& mt) {
+    std::vector<unsigned int> positions(256);
+    for (unsigned int i = 0; i < 256; ++i) {
+        positions.at(i) = i;
+    }
+    std::shuffle(positions.begin(), positions.end(), mt);
+    auto flipped = desc;
+    for (unsigned int i = 0; i < num_bits; ++i) {
+        flipped.at(positions.at(i) / 8) ^= static_cast<uint8_t>(1 << (positions.at(i) % 8));
+    }
+    return flipped;
+}
+
+} // namespace
+
+TEST(landmark_descriptor_index, update_and_erase) {
+    std::mt19937 mt(42);
+    const auto desc_0 = get_random_descriptor(mt);
+    const auto desc_1 = get_random_descriptor(mt);
+
+    data::landmark_descriptor_index index;
+    index.update(0, desc_0.data());
+    index.update(1, desc_1.data());
+    EXPECT_EQ(index.size(), 2);
+
+    auto nearest_lms = index.get_nearest_landmarks(desc_0.data(), 50, 2);
+    ASSERT_EQ(nearest_lms.size(), 1);
+    EXPECT_EQ(nearest_lms.front().first, 0);
+    EXPECT_EQ(nearest_lms.front().second, 0);
+
+    // replace the descriptor
+    index.update(0, desc_1.data());
+    EXPECT_EQ(index.size(), 2);
+    EXPECT_TRUE(index.get_nearest_landmarks(desc_0.data(), 50, 2).empty());
+    nearest_lms = index.get_nearest_landmarks(desc_1.data(), 50, 2);
+    ASSERT_EQ(nearest_lms.size(), 2);
+    EXPECT_EQ(nearest_lms.at(0).first, 0);
+    EXPECT_EQ(nearest_lms.at(1).first, 1);
+
+    index.erase(0);
+    index.erase(2);
+    EXPECT_EQ(index.size(), 1);
+    nearest_lms = index.get_nearest_landmarks(desc_1.data(), 50, 2);
+    ASSERT_EQ(nearest_lms.size(), 1);
+    EXPECT_EQ(nearest_lms.front().first, 1);
+
+    index.clear();
+    EXPECT_EQ(index.size(), 0);
+    EXPECT_TRUE(index.get_nearest_landmarks(desc_1.data(), 256, 2).empty());
+}
+
+TEST(landmark_descriptor_index, nearest_neighbors) {
+    std::mt19937 mt(42);
+    constexpr unsigned int num_lms = 1000;
+    std::vector<descriptor_t> descs;
+    data::landmark_descriptor_index index;
+    for (unsigned int id = 0; id < num_lms; ++id) {
+        descs.push_back(get_random_descriptor(mt));
+        index.update(id, descs.back().data());
+    }
+
+    for (unsigned int id = 0; id < num_lms; id += 10) {
+        // the neighbors within the distance of 15 are always found
+        const auto query = flip_bits(descs.at(id), 15, mt);
+        const auto nearest_lms = index.get_nearest_landmarks(query.data(), 50, 1);
+        ASSERT_EQ(nearest_lms.size(), 1);
+        EXPECT_EQ(nearest_lms.front().first, id);
+        EXPECT_EQ(nearest_lms.front().second, 15);
+    }
+}
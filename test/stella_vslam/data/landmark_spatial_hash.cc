@@ -0,0 +1,62 @@
+#include "stella_vslam/data/landmark_spatial_hash.h"
+
+#include <algorithm>
+#include <random>
+
+#include <gtest/gtest.h>
+
+using namespace stella_vslam;
+
+TEST(landmark_spatial_hash, get_landmarks_near) {
+    data::landmark_spatial_hash lm_hash(0.5);
+    eigen_alloc_vector<Vec3_t> positions;
+    positions.emplace_back(0.1, 0.1, 0.1);
+    positions.emplace_back(10.0, 0.0, 0.0);
+    positions.emplace_back(-0.3, 0.2, 0.0);
+    positions.emplace_back(0.2, 0.1, 0.1);
+    lm_hash.build(positions);
+    EXPECT_EQ(lm_hash.size(), 4u);
+
+    eigen_alloc_vector<Vec3_t> points;
+    points.emplace_back(0.0, 0.0, 0.0);
+    EXPECT_EQ(lm_hash.get_landmarks_near(points, 0.5), (std::vector<unsigned int>{0, 2, 3}));
+
+    // the voxels shared by the points are visited once
+    points.emplace_back(0.1, 0.0, 0.0);
+    points.emplace_back(10.1, 0.0, 0.0);
+    EXPECT_EQ(lm_hash.get_landmarks_near(points, 0.5), (std::vector<unsigned int>{0, 1, 2, 3}));
+
+    EXPECT_TRUE(lm_hash.get_landmarks_near({Vec3_t(5.0, 5.0, 5.0)}, 0.5).empty());
+
+    // rebuild with the corrected positions
+    positions.at(1) = Vec3_t(0.0, 0.3, 0.0);
+    lm_hash.build(positions);
+    EXPECT_EQ(lm_hash.get_landmarks_near({Vec3_t(0.0, 0.0, 0.0)}, 0.5), (std::vector<unsigned int>{0, 1, 2, 3}));
+}
+
+TEST(landmark_spatial_hash, superset_of_exact) {
+    std::mt19937 mt(1);
+    std::uniform_real_distribution<double> rand(-5.0, 5.0);
+    eigen_alloc_vector<Vec3_t> positions;
+    for (unsigned int i = 0; i < 1000; ++i) {
+        positions.emplace_back(rand(mt), rand(mt), rand(mt));
+    }
+    data::landmark_spatial_hash lm_hash(0.7);
+    lm_hash.build(positions);
+
+    eigen_alloc_vector<Vec3_t> points;
+    for (unsigned int i = 0; i < 20; ++i) {
+        points.emplace_back(rand(mt), rand(mt), rand(mt));
+    }
+    const double radius = 0.7;
+    const auto indices = lm_hash.get_landmarks_near(points, radius);
+    for (unsigned int idx = 0; idx < positions.size(); ++idx) {
+        bool is_near = false;
+        for (const auto& point : points) {
+            is_near |= (positions.at(idx) - point).norm() <= radius;
+        }
+        if (is_near) {
+            EXPECT_TRUE(std::binary_search(indices.begin(), indices.end(), idx));
+        }
+    }
+}
@@ -0,0 +1,54 @@
+#include "stella_vslam/data/map_change_journal.h"
+
+#include <gtest/gtest.h>
+
+using namespace stella_vslam;
+
+TEST(map_change_journal, get_changes_since) {
+    data::map_change_journal journal(10);
+    EXPECT_EQ(journal.get_version(), 0);
+
+    journal.record(data::map_object_type_t::Keyframe, 0, data::map_change_type_t::Added);
+    journal.record(data::map_object_type_t::Landmark, 3, data::map_change_type_t::Added);
+    journal.record(data::map_object_type_t::Landmark, 3, data::map_change_type_t::Updated);
+    EXPECT_EQ(journal.get_version(), 3);
+
+    std::vector<data::map_change> changes;
+    uint64_t latest_version = 0;
+    ASSERT_TRUE(journal.get_changes_since(1, changes, latest_version));
+    EXPECT_EQ(latest_version, 3);
+    ASSERT_EQ(changes.size(), 2);
+    EXPECT_EQ(changes.at(0).version_, 2);
+    EXPECT_EQ(changes.at(0).id_, 3);
+    EXPECT_EQ(changes.at(0).object_type_, data::map_object_type_t::Landmark);
+    EXPECT_EQ(changes.at(1).change_type_, data::map_change_type_t::Updated);
+
+    // up to date
+    ASSERT_TRUE(journal.get_changes_since(latest_version, changes, latest_version));
+    EXPECT_TRUE(changes.empty());
+}
+
+TEST(map_change_journal, resync_after_discarding) {
+    data::map_change_journal journal(2);
+    for (unsigned int id = 0; id < 5; ++id) {
+        journal.record(data::map_object_type_t::Keyframe, id, data::map_change_type_t::Added);
+    }
+    EXPECT_EQ(journal.size(), 2);
+
+    std::vector<data::map_change> changes;
+    uint64_t latest_version = 0;
+    EXPECT_FALSE(journal.get_changes_since(2, changes, latest_version));
+    EXPECT_EQ(latest_version, 5);
+    ASSERT_TRUE(journal.get_changes_since(3, changes, latest_version));
+    ASSERT_EQ(changes.size(), 2);
+    EXPECT_EQ(changes.at(0).id_, 3);
+
+    // the consumers have to scan the whole map after the reset
+    journal.reset();
+    EXPECT_FALSE(journal.get_changes_since(5, changes, latest_version));
+    EXPECT_EQ(latest_version, 6);
+    journal.record(data::map_object_type_t::Landmark, 0, data::map_change_type_t::Erased);
+    ASSERT_TRUE(journal.get_changes_since(6, changes, latest_version));
+    ASSERT_EQ(changes.size(), 1);
+    EXPECT_EQ(changes.at(0).change_type_, data::map_change_type_t::Erased);
+}
@@ -0,0 +1,34 @@
+#include "stella_vslam/data/memory_usage.h"
+
+#include <memory>
+
+#include <gtest/gtest.h>
+
+using namespace stella_vslam;
+
+TEST(memory_usage, account_adds_differences_to_counter) {
+    const auto category = data::memory_category_t::LandmarkObservations;
+    const auto initial_bytes = data::memory_counter::get(category);
+    {
+        data::memory_account account;
+        account.set(category, 100);
+        EXPECT_EQ(data::memory_counter::get(category), initial_bytes + 100);
+        account.set(category, 40);
+        EXPECT_EQ(data::memory_counter::get(category), initial_bytes + 40);
+
+        data::memory_account another_account;
+        another_account.set(category, 10);
+        EXPECT_EQ(data::memory_counter::get(category), initial_bytes + 50);
+    }
+    // the destructors subtract the accounted bytes
+    EXPECT_EQ(data::memory_counter::get(category), initial_bytes);
+}
+
+TEST(memory_usage, total) {
+    data::memory_usage usage;
+    EXPECT_EQ(usage.total(), 0u);
+    usage.keyfrm_descriptors_ = 1;
+    usage.lm_observations_ = 2;
+    usage.optimizer_scratch_ = 4;
+    EXPECT_EQ(usage.total(), 7u);
+}
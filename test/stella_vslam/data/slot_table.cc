@@ -0,0 +1,44 @@
+#include "stella_vslam/data/slot_table.h"
+
+#include <gtest/gtest.h>
+
+using namespace stella_vslam;
+
+TEST(slot_table, insert_and_erase) {
+    int elems[3] = {0, 1, 2};
+    data::slot_table<int> table;
+
+    const auto handle_0 = table.insert(&elems[0]);
+    const auto handle_1 = table.insert(&elems[1]);
+    EXPECT_EQ(table.size(), 2);
+    EXPECT_EQ(table.get(handle_0), &elems[0]);
+    EXPECT_EQ(table.get(handle_1), &elems[1]);
+    EXPECT_EQ(table.get(data::slot_handle()), nullptr);
+
+    EXPECT_TRUE(table.erase(handle_0));
+    EXPECT_FALSE(table.erase(handle_0));
+    EXPECT_EQ(table.size(), 1);
+    EXPECT_EQ(table.get(handle_0), nullptr);
+
+    // the slot is reused with the next generation
+    const auto handle_2 = table.insert(&elems[2]);
+    EXPECT_EQ(handle_2.index(), handle_0.index());
+    EXPECT_NE(handle_2, handle_0);
+    EXPECT_EQ(table.get(handle_2), &elems[2]);
+    EXPECT_EQ(table.get(handle_0), nullptr);
+}
+
+TEST(slot_table, clear) {
+    int elem = 0;
+    data::slot_table<int> table;
+
+    const auto handle = table.insert(&elem);
+    table.clear();
+    EXPECT_EQ(table.size(), 0);
+    EXPECT_EQ(table.get(handle), nullptr);
+
+    // the handles issued before the clearance are still invalid
+    const auto new_handle = table.insert(&elem);
+    EXPECT_EQ(table.get(new_handle), &elem);
+    EXPECT_EQ(table.get(handle), nullptr);
+}
@@ -0,0 +1,76 @@
+#include "stella_vslam/feature/cubemap_extractor.h"
+#include "stella_vslam/feature/orb_extractor.h"
+#include "stella_vslam/feature/orb_params.h"
+
+#include <cmath>
+
+#include <opencv2/core/mat.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <gtest/gtest.h>
+
+using namespace stella_vslam;
+
+TEST(cubemap_extractor, map_to_equirectangular) {
+    const auto params = feature::orb_params("ORB setting for test");
+    feature::cubemap_extractor extractor(&params, 800);
+    extractor.create_maps(1600, 800);
+    ASSERT_EQ(extractor.get_num_faces(), 6u);
+
+    // the centers of the faces: front, right, back, left, top and bottom
+    // (the focal length of the faces is cols / 8 by default)
+    const auto face_size = static_cast<float>(std::ceil(2.0 * 200.0 * std::tan(95.0 * M_PI / 360.0)));
+    const cv::Point2f face_center(face_size / 2.0f, face_size / 2.0f);
+    const auto front = extractor.map_to_equirectangular(0, face_center);
+    EXPECT_NEAR(front.x, 800.0f, 1e-3);
+    EXPECT_NEAR(front.y, 400.0f, 1e-3);
+    const auto right = extractor.map_to_equirectangular(1, face_center);
+    EXPECT_NEAR(right.x, 1200.0f, 1e-3);
+    EXPECT_NEAR(right.y, 400.0f, 1e-3);
+    const auto left = extractor.map_to_equirectangular(3, face_center);
+    EXPECT_NEAR(left.x, 400.0f, 1e-3);
+    const auto top = extractor.map_to_equirectangular(4, face_center);
+    EXPECT_NEAR(top.y, 0.0f, 1e-3);
+    const auto bottom = extractor.map_to_equirectangular(5, face_center);
+    EXPECT_NEAR(bottom.y, 800.0f, 1e-3);
+
+    // the right edge of the front face is on the right of its center
+    const auto front_right = extractor.map_to_equirectangular(0, cv::Point2f(face_size - 1.0f, face_size / 2.0f));
+    EXPECT_GT(front_right.x, 800.0f + 200.0f);
+}
+
+TEST(cubemap_extractor, extract) {
+    const auto params = feature::orb_params("ORB setting for test");
+    feature::orb_extractor extractor(&params, 800);
+    extractor.set_cubemap_extraction(4);
+
+    // random rectangles on the panorama
+    cv::Mat img(800, 1600, CV_8UC1, cv::Scalar(128));
+    cv::RNG rng(1);
+    for (unsigned int i = 0; i < 400; ++i) {
+        const cv::Point2i pt(rng.uniform(0, 1600), rng.uniform(0, 800));
+        cv::rectangle(img, pt, pt + cv::Point2i(rng.uniform(10, 60), rng.uniform(10, 60)), cv::Scalar(rng.uniform(0, 256)), -1);
+    }
+
+    std::vector<cv::KeyPoint> keypts;
+    cv::Mat desc;
+    extractor.extract(img, cv::Mat(), keypts, desc);
+    ASSERT_GT(keypts.size(), 0u);
+    EXPECT_EQ(static_cast<int>(keypts.size()), desc.rows);
+    for (const auto& keypt : keypts) {
+        EXPECT_GE(keypt.pt.x, 0.0f);
+        EXPECT_LT(keypt.pt.x, 1600.0f);
+        EXPECT_GE(keypt.pt.y, 0.0f);
+        EXPECT_LT(keypt.pt.y, 800.0f);
+        EXPECT_GE(keypt.angle, 0.0f);
+        EXPECT_LT(keypt.angle, 360.0f);
+        // the zenith and the nadir are not extracted with the sides of the cube
+        EXPECT_GT(keypt.pt.y, 800.0f * 0.15f);
+        EXPECT_LT(keypt.pt.y, 800.0f * 0.85f);
+    }
+
+    // the extraction on the whole image is restored
+    extractor.set_cubemap_extraction(0);
+    extractor.extract(img, cv::Mat(), keypts, desc);
+    EXPECT_EQ(static_cast<int>(keypts.size()), desc.rows);
+}
@@ -0,0 +1,87 @@
+#include "stella_vslam/feature/feature_cache.h"
+
+#include <cstdio>
+
+#include <gtest/gtest.h>
+
+using namespace stella_vslam;
+
+namespace {
+void create_features(const unsigned int num_keypts, std::vector<cv::KeyPoint>& keypts, cv::Mat& descriptors) {
+    keypts.clear();
+    descriptors = cv::Mat(num_keypts, 32, CV_8U);
+    for (unsigned int i = 0; i < num_keypts; ++i) {
+        cv::KeyPoint keypt;
+        keypt.pt.x = 1.5f * i;
+        keypt.pt.y = 2.0f * i + 0.25f;
+        keypt.size = 31.0f;
+        keypt.angle = 0.5f * i;
+        keypt.response = 0.01f * i;
+        keypt.octave = i % 8;
+        keypts.push_back(keypt);
+        for (unsigned int j = 0; j < 32; ++j) {
+            descriptors.ptr<uint8_t>(i)[j] = (i * 32 + j) % 255;
+        }
+    }
+}
+} // namespace
+
+TEST(feature_cache, store_and_find_after_reopen) {
+    const std::string path = "feature_cache_test.bin";
+    std::remove(path.c_str());
+
+    std::vector<cv::KeyPoint> keypts;
+    cv::Mat descriptors;
+    create_features(100, keypts, descriptors);
+    feature::orb_extraction_settings settings;
+    settings.num_levels_ = 8;
+    settings.ini_fast_thr_ = 20;
+    settings.min_fast_thr_ = 7;
+    settings.min_size_ = 800;
+
+    const auto key_1 = feature::feature_cache::compute_key(std::string("image_1.png"));
+    const auto key_2 = feature::feature_cache::compute_key(std::string("image_2.png"));
+    EXPECT_NE(key_1, key_2);
+    {
+        feature::feature_cache cache(path, "params");
+        EXPECT_EQ(cache.size(), 0u);
+        cache.store(key_1, keypts, descriptors, settings);
+        cache.store(key_2, {}, cv::Mat(), settings);
+        // the records stored in this session are found after reopening
+        EXPECT_FALSE(cache.contains(key_1));
+    }
+
+    {
+        const feature::feature_cache cache(path, "params");
+        EXPECT_EQ(cache.size(), 2u);
+        std::vector<cv::KeyPoint> cached_keypts;
+        cv::Mat cached_descriptors;
+        feature::orb_extraction_settings cached_settings;
+        ASSERT_TRUE(cache.find(key_1, cached_keypts, cached_descriptors, cached_settings));
+        ASSERT_EQ(cached_keypts.size(), keypts.size());
+        for (unsigned int i = 0; i < keypts.size(); ++i) {
+            EXPECT_EQ(cached_keypts.at(i).pt.x, keypts.at(i).pt.x);
+            EXPECT_EQ(cached_keypts.at(i).pt.y, keypts.at(i).pt.y);
+            EXPECT_EQ(cached_keypts.at(i).angle, keypts.at(i).angle);
+            EXPECT_EQ(cached_keypts.at(i).octave, keypts.at(i).octave);
+            for (unsigned int j = 0; j < 32; ++j) {
+                EXPECT_EQ(cached_descriptors.ptr<uint8_t>(i)[j], descriptors.ptr<uint8_t>(i)[j]);
+            }
+        }
+        EXPECT_EQ(cached_settings.num_levels_, 8u);
+        EXPECT_EQ(cached_settings.min_size_, 800u);
+
+        ASSERT_TRUE(cache.find(key_2, cached_keypts, cached_descriptors, cached_settings));
+        EXPECT_TRUE(cached_keypts.empty());
+        EXPECT_FALSE(cache.find(key_1 + key_2, cached_keypts, cached_descriptors, cached_settings));
+    }
+
+    {
+        // rebuilt with the different parameters
+        const feature::feature_cache cache(path, "other params");
+        EXPECT_EQ(cache.size(), 0u);
+        EXPECT_TRUE(cache.is_writable());
+    }
+
+    std::remove(path.c_str());
+}
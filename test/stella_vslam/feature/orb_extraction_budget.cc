@@ -0,0 +1,60 @@
+#include "stella_vslam/feature/orb_params.h"
+#include "stella_vslam/feature/orb_extraction_budget.h"
+
+#include <gtest/gtest.h>
+
+using namespace stella_vslam;
+
+TEST(orb_extraction_budget, full_settings_at_start) {
+    const auto params = feature::orb_params("ORB setting for test", 1.2, 8, 20, 7);
+    const feature::orb_extraction_budget budget(&params, 800, 10.0);
+
+    const auto& settings = budget.get_settings();
+    EXPECT_EQ(settings.degradation_level_, 0);
+    EXPECT_EQ(settings.num_levels_, 8);
+    EXPECT_EQ(settings.ini_fast_thr_, 20);
+    EXPECT_EQ(settings.min_fast_thr_, 7);
+    EXPECT_EQ(settings.min_size_, 800);
+}
+
+TEST(orb_extraction_budget, degrade_and_restore) {
+    const auto params = feature::orb_params("ORB setting for test", 1.2, 8, 20, 7);
+    feature::orb_extraction_budget budget(&params, 800, 10.0, 4);
+
+    // keep exceeding the budget
+    for (unsigned int i = 0; i < 100; ++i) {
+        budget.update(20.0);
+    }
+    const auto degraded = budget.get_settings();
+    EXPECT_EQ(degraded.degradation_level_, feature::orb_extraction_budget::max_degradation_level_);
+    EXPECT_EQ(degraded.num_levels_, 4);
+    EXPECT_GT(degraded.ini_fast_thr_, 20);
+    EXPECT_GT(degraded.min_fast_thr_, 7);
+    EXPECT_LE(degraded.min_fast_thr_, degraded.ini_fast_thr_);
+    EXPECT_GT(degraded.min_size_, 800);
+    EXPECT_DOUBLE_EQ(degraded.elapsed_ms_, 20.0);
+
+    // a single fast frame does not restore the settings
+    budget.update(1.0);
+    EXPECT_EQ(budget.get_settings().degradation_level_, degraded.degradation_level_);
+
+    // within the budget but not well below it
+    for (unsigned int i = 0; i < 100; ++i) {
+        budget.update(9.9);
+    }
+    EXPECT_EQ(budget.get_settings().degradation_level_, degraded.degradation_level_);
+
+    // well below the budget
+    for (unsigned int i = 0; i < 100; ++i) {
+        budget.update(2.0);
+    }
+    EXPECT_EQ(budget.get_settings().degradation_level_, 0);
+    EXPECT_EQ(budget.get_settings().num_levels_, 8);
+    EXPECT_EQ(budget.get_settings().min_size_, 800);
+}
+
+TEST(orb_extraction_budget, invalid_parameters) {
+    const auto params = feature::orb_params("ORB setting for test", 1.2, 8, 20, 7);
+    EXPECT_THROW(feature::orb_extraction_budget(&params, 800, 0.0), std::runtime_error);
+    EXPECT_THROW(feature::orb_extraction_budget(&params, 800, 10.0, 0), std::runtime_error);
+}
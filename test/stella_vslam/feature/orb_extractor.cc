@@ -399,3 +399,33 @@ TEST(orb_extractor, extract_without_mask_4) {
     EXPECT_EQ(keypts.size(), desc.rows);
     EXPECT_EQ(desc.type(), CV_8U);
 }
+
+TEST(orb_extractor, extract_from_first_level) {
+    const auto params = feature::orb_params("ORB setting for test");
+    auto extractor = feature::orb_extractor(&params, 1000);
+    extractor.set_first_level(3);
+    EXPECT_EQ(extractor.get_first_level(), 3);
+
+    // image
+    auto img = cv::Mat(600, 600, CV_8UC1);
+    img = 255;
+    cv::rectangle(img, cv::Point2i(300, 300), cv::Point2i(600, 600), cv::Scalar(0), -1, cv::LINE_AA);
+    // mask (無効)
+    const auto mask = cv::Mat();
+
+    std::vector<cv::KeyPoint> keypts;
+    cv::Mat desc;
+    extractor.extract(img, mask, keypts, desc);
+
+    EXPECT_GT(keypts.size(), 0);
+    EXPECT_EQ(keypts.size(), desc.rows);
+
+    // the keypoints are extracted from the downscaled images but refined on the full-resolution image
+    for (const auto& keypt : keypts) {
+        EXPECT_GE(keypt.octave, 3);
+        EXPECT_NEAR(keypt.pt.x, 300, 2.0);
+        EXPECT_NEAR(keypt.pt.y, 300, 2.0);
+    }
+
+    EXPECT_THROW(extractor.set_first_level(params.num_levels_), std::runtime_error);
+}
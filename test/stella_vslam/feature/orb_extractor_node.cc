@@ -0,0 +1,126 @@
+#include "stella_vslam/feature/orb_extractor_node.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+#include <gtest/gtest.h>
+
+using namespace stella_vslam;
+
+namespace {
+// quadtree distribution with std::list<orb_extractor_node>, used as the reference
+std::vector<cv::KeyPoint> distribute_keypoints_via_list(const std::vector<cv::KeyPoint>& keypts_to_distribute,
+                                                        const int min_x, const int max_x, const int min_y, const int max_y,
+                                                        const unsigned int min_size, const float scale_factor) {
+    const auto ratio = static_cast<double>(max_x - min_x) / (max_y - min_y);
+    double delta_x, delta_y;
+    unsigned int num_x_grid, num_y_grid;
+    if (ratio > 1) {
+        num_x_grid = std::round(ratio);
+        num_y_grid = 1;
+        delta_x = static_cast<double>(max_x - min_x) / num_x_grid;
+        delta_y = max_y - min_y;
+    }
+    else {
+        num_x_grid = 1;
+        num_y_grid = std::round(1 / ratio);
+        delta_x = max_x - min_y;
+        delta_y = static_cast<double>(max_y - min_y) / num_y_grid;
+    }
+
+    std::list<feature::orb_extractor_node> nodes;
+    std::vector<feature::orb_extractor_node*> initial_nodes;
+    for (unsigned int i = 0; i < num_x_grid * num_y_grid; ++i) {
+        feature::orb_extractor_node node;
+        const unsigned int ix = i % num_x_grid;
+        const unsigned int iy = i / num_x_grid;
+        node.pt_begin_ = cv::Point2i(delta_x * ix, delta_y * iy);
+        node.pt_end_ = cv::Point2i(delta_x * (ix + 1), delta_y * (iy + 1));
+        nodes.push_back(node);
+        initial_nodes.push_back(&nodes.back());
+    }
+    for (const auto& keypt : keypts_to_distribute) {
+        const unsigned int ix = keypt.pt.x / delta_x;
+        const unsigned int iy = keypt.pt.y / delta_y;
+        initial_nodes.at(ix + iy * num_x_grid)->keypts_.push_back(keypt);
+    }
+    nodes.remove_if([](const feature::orb_extractor_node& node) { return node.keypts_.empty(); });
+
+    while (true) {
+        const unsigned int prev_size = nodes.size();
+        auto iter = nodes.begin();
+        while (iter != nodes.end()) {
+            if (iter->keypts_.size() == 1 || iter->size() * scale_factor * scale_factor <= min_size) {
+                iter++;
+                continue;
+            }
+            for (const auto& child_node : iter->divide_node()) {
+                if (!child_node.keypts_.empty()) {
+                    nodes.push_front(child_node);
+                }
+            }
+            iter = nodes.erase(iter);
+        }
+        if (nodes.size() == prev_size) {
+            break;
+        }
+    }
+
+    std::vector<cv::KeyPoint> result_keypts;
+    for (const auto& node : nodes) {
+        auto keypt = node.keypts_.at(0);
+        for (unsigned int k = 1; k < node.keypts_.size(); ++k) {
+            if (node.keypts_.at(k).response > keypt.response) {
+                keypt = node.keypts_.at(k);
+            }
+        }
+        result_keypts.push_back(keypt);
+    }
+    return result_keypts;
+}
+
+void sort_by_class_id(std::vector<cv::KeyPoint>& keypts) {
+    std::sort(keypts.begin(), keypts.end(), [](const cv::KeyPoint& a, const cv::KeyPoint& b) {
+        return a.class_id < b.class_id;
+    });
+}
+} // namespace
+
+TEST(orb_extractor_node, distribute_keypoints_in_place) {
+    std::mt19937 mt(42);
+    // the positions and the responses are quantized to test ties
+    std::uniform_int_distribution<int> rand_response(0, 20);
+
+    for (const auto& bounds : std::vector<std::array<int, 4>>{{19, 621, 19, 461}, {19, 461, 19, 621}, {19, 120, 19, 100}}) {
+        const int min_x = bounds.at(0), max_x = bounds.at(1), min_y = bounds.at(2), max_y = bounds.at(3);
+        std::uniform_real_distribution<float> rand_x(0.0, max_x - min_x - 1);
+        std::uniform_real_distribution<float> rand_y(0.0, max_y - min_y - 1);
+
+        std::vector<cv::KeyPoint> keypts;
+        for (unsigned int i = 0; i < 3000; ++i) {
+            keypts.emplace_back(std::round(rand_x(mt)), std::round(rand_y(mt)), 7.0, -1, rand_response(mt));
+            keypts.back().class_id = i;
+        }
+
+        for (const unsigned int min_size : {10u, 800u, 5000u}) {
+            for (const float scale_factor : {1.0f, 1.44f}) {
+                auto expected = distribute_keypoints_via_list(keypts, min_x, max_x, min_y, max_y, min_size, scale_factor);
+                std::vector<cv::KeyPoint> actual;
+                feature::distribute_keypoints_in_place(keypts, min_x, max_x, min_y, max_y, min_size, scale_factor, actual);
+
+                ASSERT_EQ(actual.size(), expected.size());
+                sort_by_class_id(expected);
+                sort_by_class_id(actual);
+                for (unsigned int i = 0; i < actual.size(); ++i) {
+                    EXPECT_EQ(actual.at(i).class_id, expected.at(i).class_id);
+                }
+            }
+        }
+    }
+
+    // no keypoints
+    std::vector<cv::KeyPoint> actual{cv::KeyPoint(1.0, 1.0, 7.0)};
+    feature::distribute_keypoints_in_place({}, 19, 621, 19, 461, 800, 1.0, actual);
+    EXPECT_TRUE(actual.empty());
+}
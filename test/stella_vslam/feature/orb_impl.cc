@@ -0,0 +1,42 @@
+#include "stella_vslam/feature/orb_impl.h"
+
+#include <random>
+
+#include <opencv2/core/mat.hpp>
+#include <opencv2/core/types.hpp>
+
+#include <gtest/gtest.h>
+
+using namespace stella_vslam;
+
+TEST(orb_impl, simd_is_same_as_scalar) {
+    const feature::orb_impl orb_impl_simd(true);
+    const feature::orb_impl orb_impl_scalar(false);
+    EXPECT_FALSE(orb_impl_scalar.uses_simd());
+
+    // random image
+    std::mt19937 mt(42);
+    auto img = cv::Mat(480, 640, CV_8UC1);
+    for (int y = 0; y < img.rows; ++y) {
+        for (int x = 0; x < img.cols; ++x) {
+            img.at<uchar>(y, x) = mt() % 256;
+        }
+    }
+
+    // keypoints far enough from the edges as orb_extractor does
+    std::uniform_real_distribution<float> rand_x(19.0, img.cols - 20.0);
+    std::uniform_real_distribution<float> rand_y(19.0, img.rows - 20.0);
+    std::uniform_real_distribution<float> rand_angle(0.0, 360.0);
+    for (unsigned int i = 0; i < 1000; ++i) {
+        const cv::KeyPoint keypt(rand_x(mt), rand_y(mt), feature::orb_impl::fast_patch_size_, rand_angle(mt));
+
+        EXPECT_FLOAT_EQ(orb_impl_simd.ic_angle(img, keypt.pt), orb_impl_scalar.ic_angle(img, keypt.pt));
+
+        uchar desc_simd[32], desc_scalar[32];
+        orb_impl_simd.compute_orb_descriptor(keypt, img, desc_simd);
+        orb_impl_scalar.compute_orb_descriptor(keypt, img, desc_scalar);
+        for (unsigned int k = 0; k < 32; ++k) {
+            EXPECT_EQ(desc_simd[k], desc_scalar[k]);
+        }
+    }
+}
@@ -0,0 +1,58 @@
+#include "stella_vslam/io/replay_log.h"
+
+#include <cstdio>
+
+#include <opencv2/core.hpp>
+#include <gtest/gtest.h>
+
+using namespace stella_vslam;
+
+TEST(replay_log, record_and_load) {
+    cv::Mat img(48, 64, CV_8UC3);
+    cv::randu(img, cv::Scalar::all(0), cv::Scalar::all(255));
+    cv::Mat depth(48, 64, CV_32FC1);
+    cv::randu(depth, cv::Scalar::all(0.0), cv::Scalar::all(10.0));
+    const cv::Mat mask(48, 64, CV_8UC1, cv::Scalar(255));
+
+    {
+        io::replay_recorder recorder(".", "RGBD");
+        // the frames are completed in the fed order
+        recorder.queue_inputs(0.1, {img, depth}, cv::Mat{});
+        recorder.queue_inputs(0.2, {img(cv::Rect(8, 8, 32, 24)), depth}, mask);
+        recorder.record_tracking(0, 3.0);
+        recorder.record_tracking(2, 4.0);
+        // not queued
+        recorder.record_tracking(5, 5.0);
+        EXPECT_EQ(recorder.get_num_recorded_frames(), 2);
+    }
+
+    io::replay_log log(".");
+    EXPECT_EQ(log.get_setup_type(), "RGBD");
+    const auto& frms = log.get_frames();
+    ASSERT_EQ(frms.size(), 2);
+    EXPECT_EQ(frms.at(0).idx_, 0);
+    EXPECT_EQ(frms.at(0).timestamp_, 0.1);
+    EXPECT_EQ(frms.at(0).num_mapped_keyfrms_, 0);
+    EXPECT_EQ(frms.at(0).feed_time_ms_, 3.0);
+    EXPECT_FALSE(frms.at(0).has_mask_);
+    EXPECT_EQ(frms.at(1).idx_, 1);
+    EXPECT_EQ(frms.at(1).num_mapped_keyfrms_, 2);
+    EXPECT_TRUE(frms.at(1).has_mask_);
+
+    // the frames can be loaded in any order
+    std::vector<cv::Mat> imgs;
+    cv::Mat loaded_mask;
+    log.load_inputs(frms.at(1), imgs, loaded_mask);
+    ASSERT_EQ(imgs.size(), 2);
+    EXPECT_EQ(cv::norm(imgs.at(0), img(cv::Rect(8, 8, 32, 24)), cv::NORM_INF), 0.0);
+    EXPECT_EQ(cv::norm(imgs.at(1), depth, cv::NORM_INF), 0.0);
+    EXPECT_EQ(cv::norm(loaded_mask, mask, cv::NORM_INF), 0.0);
+
+    log.load_inputs(frms.at(0), imgs, loaded_mask);
+    ASSERT_EQ(imgs.size(), 2);
+    EXPECT_EQ(cv::norm(imgs.at(0), img, cv::NORM_INF), 0.0);
+    EXPECT_TRUE(loaded_mask.empty());
+
+    std::remove("inputs.bin");
+    std::remove("frames.jsonl");
+}
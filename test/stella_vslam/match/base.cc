@@ -55,3 +55,18 @@ TEST(base, compute_hamming_distance_3) {
     EXPECT_EQ(match::compute_descriptor_distance_32(desc_1, desc_2), 128);
     EXPECT_EQ(match::compute_descriptor_distance_64(desc_1, desc_2), 128);
 }
+
+TEST(base, compute_hamming_distances) {
+    cv::Mat desc(1, 32, CV_8U, cv::Scalar(0b01010101));
+    cv::Mat descs(3, 32, CV_8U);
+    descs.row(0) = 0b01010101;
+    descs.row(1) = 0b10101010;
+    descs.row(2) = 0b01100110;
+
+    std::vector<unsigned int> dists;
+    match::compute_descriptor_distances(desc, descs, dists);
+    ASSERT_EQ(dists.size(), 3);
+    EXPECT_EQ(dists.at(0), 0);
+    EXPECT_EQ(dists.at(1), 256);
+    EXPECT_EQ(dists.at(2), 128);
+}
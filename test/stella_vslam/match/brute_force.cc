@@ -0,0 +1,73 @@
+#include "stella_vslam/match/brute_force.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace stella_vslam;
+
+namespace {
+
+std::vector<uint8_t> create_random_descriptors(const unsigned int num_descs, std::mt19937& mt) {
+    std::uniform_int_distribution<int> rand_byte(0, 255);
+    std::vector<uint8_t> descs(num_descs * 32);
+    for (auto& byte : descs) {
+        byte = static_cast<uint8_t>(rand_byte(mt));
+    }
+    return descs;
+}
+
+} // namespace
+
+TEST(brute_force, find_best_two_all_pairs) {
+    std::mt19937 mt(0);
+    // (several tiles of the queries and the candidates)
+    const auto query_descs = create_random_descriptors(300, mt);
+    const auto candidate_descs = create_random_descriptors(700, mt);
+    const match::descriptor_block queries(query_descs.data(), 32, 300);
+    const match::descriptor_block candidates(candidate_descs.data(), 32, 700);
+
+    std::vector<unsigned int> query_indices;
+    for (unsigned int idx = 0; idx < 300; idx += 3) {
+        query_indices.push_back(idx);
+    }
+    std::vector<unsigned int> candidate_indices(700);
+    for (unsigned int idx = 0; idx < 700; ++idx) {
+        candidate_indices.at(idx) = idx;
+    }
+
+    const auto results = match::find_best_two_all_pairs(queries, query_indices, candidates);
+    ASSERT_EQ(results.size(), query_indices.size());
+    for (unsigned int pos = 0; pos < query_indices.size(); ++pos) {
+        const auto expected = match::best_two_in_block(queries.at(query_indices.at(pos)), candidates, candidate_indices);
+        EXPECT_EQ(results.at(pos).best_dist_, expected.best_dist_);
+        EXPECT_EQ(results.at(pos).best_idx_, expected.best_idx_);
+        EXPECT_EQ(results.at(pos).second_best_dist_, expected.second_best_dist_);
+        EXPECT_EQ(results.at(pos).second_best_idx_, expected.second_best_idx_);
+    }
+}
+
+TEST(brute_force, find_best_two_all_pairs_with_cross_check) {
+    // queries: 0x00..., 0x0F..., candidates: 0x01..., 0x03...
+    std::vector<uint8_t> query_descs(2 * 32, 0x00);
+    std::fill(query_descs.begin() + 32, query_descs.end(), 0x0F);
+    std::vector<uint8_t> candidate_descs(2 * 32, 0x01);
+    std::fill(candidate_descs.begin() + 32, candidate_descs.end(), 0x03);
+    const match::descriptor_block queries(query_descs.data(), 32, 2);
+    const match::descriptor_block candidates(candidate_descs.data(), 32, 2);
+
+    // distances from the query 0: 32 and 64, from the query 1: 96 and 64
+    match::all_pairs_options options;
+    const auto results = match::find_best_two_all_pairs(queries, {0, 1}, candidates, options);
+    EXPECT_EQ(results.at(0).best_idx_, 0);
+    EXPECT_EQ(results.at(1).best_idx_, 1);
+
+    // the queries are tied for the candidate 1, so the first query is its best and the query 1 is rejected
+    options.cross_check_ = true;
+    const auto cross_checked_results = match::find_best_two_all_pairs(queries, {0, 1}, candidates, options);
+    EXPECT_EQ(cross_checked_results.at(0).best_idx_, 0);
+    EXPECT_EQ(cross_checked_results.at(1).best_idx_, -1);
+    EXPECT_EQ(cross_checked_results.at(1).best_dist_, 64);
+}
@@ -0,0 +1,57 @@
+#include "stella_vslam/match/descriptor_block.h"
+
+#include <gtest/gtest.h>
+
+using namespace stella_vslam;
+
+TEST(descriptor_block, create_from_mat) {
+    cv::Mat descs(4, 32, CV_8U, cv::Scalar(0));
+    const match::descriptor_block block(descs);
+
+    EXPECT_EQ(block.size(), 4);
+    EXPECT_EQ(block.stride(), 32);
+    EXPECT_EQ(block.at(2), descs.ptr<uint8_t>(2));
+
+    const match::descriptor_block empty_block{cv::Mat()};
+    EXPECT_TRUE(empty_block.empty());
+}
+
+TEST(descriptor_block, best_two_in_block) {
+    const cv::Mat query(1, 32, CV_8U, cv::Scalar(0));
+    cv::Mat descs(5, 32, CV_8U, cv::Scalar(0xFF));
+    // distance 8
+    descs.row(1) = 0;
+    descs.at<uint8_t>(1, 0) = 0xFF;
+    // distance 16
+    descs.row(3) = 0;
+    descs.at<uint8_t>(3, 0) = 0xFF;
+    descs.at<uint8_t>(3, 1) = 0xFF;
+    // distance 0
+    descs.row(4) = 0;
+
+    const match::descriptor_block block(descs);
+
+    const auto result_1 = match::best_two_in_block(query, block, std::vector<unsigned int>{0, 1, 2, 3});
+    EXPECT_EQ(result_1.best_dist_, 8);
+    EXPECT_EQ(result_1.best_idx_, 1);
+    EXPECT_EQ(result_1.second_best_dist_, 16);
+    EXPECT_EQ(result_1.second_best_idx_, 3);
+
+    const auto result_2 = match::best_two_in_block(query, block, std::vector<unsigned int>{3, 4});
+    EXPECT_EQ(result_2.best_dist_, 0);
+    EXPECT_EQ(result_2.best_idx_, 4);
+    EXPECT_EQ(result_2.second_best_dist_, 16);
+    EXPECT_EQ(result_2.second_best_idx_, 3);
+}
+
+TEST(descriptor_block, best_two_in_block_without_candidates) {
+    const cv::Mat query(1, 32, CV_8U, cv::Scalar(0));
+    const cv::Mat descs(2, 32, CV_8U, cv::Scalar(0));
+    const match::descriptor_block block(descs);
+
+    const auto result = match::best_two_in_block(query, block, std::vector<unsigned int>{});
+    EXPECT_EQ(result.best_dist_, match::MAX_HAMMING_DIST);
+    EXPECT_EQ(result.best_idx_, -1);
+    EXPECT_EQ(result.second_best_dist_, match::MAX_HAMMING_DIST);
+    EXPECT_EQ(result.second_best_idx_, -1);
+}
@@ -0,0 +1,77 @@
+#include "stella_vslam/match/hamming.h"
+
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace stella_vslam;
+
+namespace {
+
+std::vector<uint8_t> create_random_descriptors(const unsigned int num_descs) {
+    std::mt19937 random_engine(0);
+    std::uniform_int_distribution<int> dist(0, 255);
+    std::vector<uint8_t> descs(32 * num_descs);
+    for (auto& byte : descs) {
+        byte = static_cast<uint8_t>(dist(random_engine));
+    }
+    return descs;
+}
+
+unsigned int compute_reference_distance(const uint8_t* desc_1, const uint8_t* desc_2) {
+    unsigned int dist = 0;
+    for (unsigned int i = 0; i < 32; ++i) {
+        for (unsigned int bit = 0; bit < 8; ++bit) {
+            dist += ((desc_1[i] ^ desc_2[i]) >> bit) & 1;
+        }
+    }
+    return dist;
+}
+
+} // namespace
+
+TEST(hamming, compute_hamming_distance_all_impls) {
+    constexpr unsigned int num_descs = 65;
+    const auto descs = create_random_descriptors(num_descs);
+    const auto default_impl = match::get_hamming_impl();
+
+    for (const auto impl : {match::hamming_impl_t::Scalar, match::hamming_impl_t::Popcnt, match::hamming_impl_t::AVX2,
+                            match::hamming_impl_t::AVX512_VPOPCNTDQ, match::hamming_impl_t::NEON}) {
+        if (!match::set_hamming_impl(impl)) {
+            // not supported on this CPU
+            continue;
+        }
+        EXPECT_EQ(match::get_hamming_impl(), impl);
+
+        std::vector<unsigned int> dists(num_descs - 1);
+        match::compute_hamming_distances_256(descs.data(), descs.data() + 32, 32, num_descs - 1, dists.data());
+        for (unsigned int i = 1; i < num_descs; ++i) {
+            const auto expected = compute_reference_distance(descs.data(), descs.data() + 32 * i);
+            EXPECT_EQ(match::compute_hamming_distance_256(descs.data(), descs.data() + 32 * i), expected);
+            EXPECT_EQ(match::compute_hamming_distance_256_inline(descs.data(), descs.data() + 32 * i), expected);
+            EXPECT_EQ(dists.at(i - 1), expected);
+        }
+    }
+
+    EXPECT_TRUE(match::set_hamming_impl(default_impl));
+}
+
+TEST(hamming, compute_hamming_distances_with_stride) {
+    // candidates are placed every 64 bytes
+    constexpr unsigned int num_descs = 16;
+    const auto descs = create_random_descriptors(2 * num_descs + 1);
+
+    std::vector<unsigned int> dists(num_descs);
+    match::compute_hamming_distances_256(descs.data(), descs.data() + 32, 64, num_descs, dists.data());
+    for (unsigned int i = 0; i < num_descs; ++i) {
+        EXPECT_EQ(dists.at(i), compute_reference_distance(descs.data(), descs.data() + 32 + 64 * i));
+    }
+}
+
+TEST(hamming, scalar_is_always_supported) {
+    const auto default_impl = match::get_hamming_impl();
+    EXPECT_TRUE(match::set_hamming_impl(match::hamming_impl_t::Scalar));
+    EXPECT_EQ(match::get_hamming_impl_name(match::get_hamming_impl()), "scalar");
+    EXPECT_TRUE(match::set_hamming_impl(default_impl));
+}
@@ -0,0 +1,32 @@
+#include "stella_vslam/module/keyframe_rate_controller.h"
+
+#include <gtest/gtest.h>
+#include <yaml-cpp/yaml.h>
+
+using namespace stella_vslam;
+
+TEST(keyframe_rate_controller, disabled) {
+    const module::keyframe_rate_controller controller(YAML::Node{});
+    EXPECT_FALSE(controller.is_enabled());
+    EXPECT_TRUE(controller.accepts(10, false, 100.0, 0.0, false));
+}
+
+TEST(keyframe_rate_controller, pace_by_backlog) {
+    // 50 ms per keyframe, 200 ms of the target latency
+    const module::keyframe_rate_controller controller(200.0, 5, 0.9);
+    EXPECT_TRUE(controller.is_enabled());
+    EXPECT_DOUBLE_EQ(module::keyframe_rate_controller::predict_latency_ms(2, false, 50.0), 175.0);
+
+    EXPECT_TRUE(controller.accepts(0, true, 50.0, 100.0, false));
+    EXPECT_TRUE(controller.accepts(2, false, 50.0, 100.0, false));
+    // exceeds the target latency
+    EXPECT_FALSE(controller.accepts(3, false, 50.0, 100.0, false));
+    // exceeds the throughput of the mapping module
+    EXPECT_FALSE(controller.accepts(0, true, 50.0, 40.0, false));
+    // unknown throughput
+    EXPECT_TRUE(controller.accepts(3, false, 0.0, 0.0, false));
+
+    // the urgent candidates are deferred only by the hard limit
+    EXPECT_TRUE(controller.accepts(4, false, 50.0, 10.0, true));
+    EXPECT_FALSE(controller.accepts(5, false, 50.0, 10.0, true));
+}
@@ -0,0 +1,84 @@
+#include "stella_vslam/type.h"
+#include "stella_vslam/optimize/pose_solver.h"
+
+#include <random>
+
+#include <gtest/gtest.h>
+
+using namespace stella_vslam;
+
+namespace {
+optimize::pose_solver::intrinsics get_intrinsics() {
+    optimize::pose_solver::intrinsics intr;
+    intr.fx_ = 500.0;
+    intr.fy_ = 500.0;
+    intr.cx_ = 320.0;
+    intr.cy_ = 240.0;
+    intr.focal_x_baseline_ = 500.0 * 0.1;
+    return intr;
+}
+
+Mat44_t get_pose(const Vec3_t& rot_vec, const Vec3_t& trans) {
+    Mat44_t pose_cw = Mat44_t::Identity();
+    pose_cw.block<3, 3>(0, 0) = Eigen::AngleAxisd(rot_vec.norm(), rot_vec.normalized()).toRotationMatrix();
+    pose_cw.block<3, 1>(0, 3) = trans;
+    return pose_cw;
+}
+
+void add_observations(optimize::pose_solver& solver, const Mat44_t& pose_cw_gt, const bool is_stereo,
+                      const unsigned int num_obs, const unsigned int num_outliers) {
+    const auto intr = get_intrinsics();
+    std::mt19937 mt(42);
+    std::uniform_real_distribution<double> rand_xy(-2.0, 2.0);
+    std::uniform_real_distribution<double> rand_z(2.0, 8.0);
+    std::normal_distribution<double> rand_noise(0.0, 0.5);
+    const Mat44_t pose_wc_gt = pose_cw_gt.inverse();
+    for (unsigned int i = 0; i < num_obs; ++i) {
+        const Vec3_t pos_c{rand_xy(mt), rand_xy(mt), rand_z(mt)};
+        const Vec3_t pos_w = pose_wc_gt.block<3, 3>(0, 0) * pos_c + pose_wc_gt.block<3, 1>(0, 3);
+        double x = intr.fx_ * pos_c(0) / pos_c(2) + intr.cx_ + rand_noise(mt);
+        const double y = intr.fy_ * pos_c(1) / pos_c(2) + intr.cy_ + rand_noise(mt);
+        const double x_right = is_stereo ? x - intr.focal_x_baseline_ / pos_c(2) : -1.0;
+        if (i < num_outliers) {
+            x += 50.0;
+        }
+        solver.add_observation(pos_w, x, y, x_right, 1.0, is_stereo ? std::sqrt(7.81473) : std::sqrt(5.99146));
+    }
+}
+} // namespace
+
+TEST(pose_solver, monocular_with_outliers) {
+    const Mat44_t pose_cw_gt = get_pose(Vec3_t{0.1, -0.2, 0.05}, Vec3_t{0.3, -0.1, 0.2});
+
+    optimize::pose_solver solver;
+    add_observations(solver, pose_cw_gt, false, 200, 20);
+
+    Mat44_t pose_cw = get_pose(Vec3_t{0.12, -0.18, 0.06}, Vec3_t{0.35, -0.05, 0.15});
+    std::vector<bool> outlier_flags;
+    Mat66_t pose_cov;
+    const auto num_inliers = solver.solve(get_intrinsics(), pose_cw, outlier_flags, &pose_cov);
+
+    EXPECT_EQ(outlier_flags.size(), 200u);
+    for (unsigned int i = 0; i < 20; ++i) {
+        EXPECT_TRUE(outlier_flags.at(i));
+    }
+    EXPECT_GE(num_inliers, 170u);
+    EXPECT_LT((pose_cw.block<3, 3>(0, 0) - pose_cw_gt.block<3, 3>(0, 0)).norm(), 1e-2);
+    EXPECT_LT((pose_cw.block<3, 1>(0, 3) - pose_cw_gt.block<3, 1>(0, 3)).norm(), 2e-2);
+    EXPECT_GT(pose_cov.diagonal().minCoeff(), 0.0);
+}
+
+TEST(pose_solver, stereo) {
+    const Mat44_t pose_cw_gt = get_pose(Vec3_t{-0.05, 0.1, 0.2}, Vec3_t{-0.2, 0.1, 0.4});
+
+    optimize::pose_solver solver;
+    add_observations(solver, pose_cw_gt, true, 100, 0);
+
+    Mat44_t pose_cw = Mat44_t::Identity();
+    std::vector<bool> outlier_flags;
+    const auto num_inliers = solver.solve(get_intrinsics(), pose_cw, outlier_flags);
+
+    EXPECT_GE(num_inliers, 90u);
+    EXPECT_LT((pose_cw.block<3, 3>(0, 0) - pose_cw_gt.block<3, 3>(0, 0)).norm(), 1e-2);
+    EXPECT_LT((pose_cw.block<3, 1>(0, 3) - pose_cw_gt.block<3, 1>(0, 3)).norm(), 2e-2);
+}
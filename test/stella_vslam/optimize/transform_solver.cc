@@ -0,0 +1,109 @@
+#include "stella_vslam/type.h"
+#include "stella_vslam/optimize/transform_solver.h"
+
+#include <random>
+
+#include <gtest/gtest.h>
+
+using namespace stella_vslam;
+
+namespace {
+optimize::transform_solver::camera_model get_perspective() {
+    optimize::transform_solver::camera_model cam;
+    cam.fx_ = 500.0;
+    cam.fy_ = 500.0;
+    cam.cx_ = 320.0;
+    cam.cy_ = 240.0;
+    return cam;
+}
+
+optimize::transform_solver::camera_model get_equirectangular() {
+    optimize::transform_solver::camera_model cam;
+    cam.is_equirectangular_ = true;
+    cam.cols_ = 1600.0;
+    cam.rows_ = 800.0;
+    return cam;
+}
+
+Vec2_t project(const optimize::transform_solver::camera_model& cam, const Vec3_t& pos_c) {
+    if (cam.is_equirectangular_) {
+        const double theta = std::atan2(pos_c(0), pos_c(2));
+        const double phi = -std::asin(pos_c(1) / pos_c.norm());
+        return {cam.cols_ * (0.5 + theta / (2 * M_PI)), cam.rows_ * (0.5 - phi / M_PI)};
+    }
+    return {cam.fx_ * pos_c(0) / pos_c(2) + cam.cx_, cam.fy_ * pos_c(1) / pos_c(2) + cam.cy_};
+}
+
+void add_matches(optimize::transform_solver& solver, const optimize::transform_solver::camera_model& cam,
+                 const Mat33_t& rot_12, const Vec3_t& trans_12, const double scale_12,
+                 const unsigned int num_matches, const unsigned int num_outliers) {
+    std::mt19937 mt(42);
+    std::uniform_real_distribution<double> rand_xy(-2.0, 2.0);
+    std::uniform_real_distribution<double> rand_z(3.0, 8.0);
+    std::normal_distribution<double> rand_noise(0.0, 0.5);
+    for (unsigned int i = 0; i < num_matches; ++i) {
+        // the same point observed in the both keyframes
+        const Vec3_t pos_2{rand_xy(mt), rand_xy(mt), rand_z(mt)};
+        const Vec3_t pos_1 = scale_12 * rot_12 * pos_2 + trans_12;
+        Vec2_t obs_1 = project(cam, pos_1) + Vec2_t{rand_noise(mt), rand_noise(mt)};
+        const Vec2_t obs_2 = project(cam, pos_2) + Vec2_t{rand_noise(mt), rand_noise(mt)};
+        if (i < num_outliers) {
+            obs_1(0) += 50.0;
+        }
+        solver.add_match(pos_2, obs_1, 1.0, pos_1, obs_2, 1.0);
+    }
+}
+} // namespace
+
+TEST(transform_solver, perspective_with_outliers) {
+    const Mat33_t rot_12_gt = Eigen::AngleAxisd(0.1, Vec3_t{0.2, 1.0, -0.3}.normalized()).toRotationMatrix();
+    const Vec3_t trans_12_gt{0.2, -0.1, 0.3};
+    const double scale_12_gt = 1.2;
+
+    optimize::transform_solver solver;
+    add_matches(solver, get_perspective(), rot_12_gt, trans_12_gt, scale_12_gt, 200, 20);
+
+    Mat33_t rot_12 = Eigen::AngleAxisd(0.12, Vec3_t{0.25, 1.0, -0.25}.normalized()).toRotationMatrix();
+    Vec3_t trans_12{0.25, -0.05, 0.25};
+    double scale_12 = 1.1;
+    std::vector<bool> outlier_flags;
+    const auto num_inliers = solver.solve(get_perspective(), get_perspective(), false, 5, 10, 10.0,
+                                          rot_12, trans_12, scale_12, outlier_flags);
+
+    EXPECT_EQ(outlier_flags.size(), 200u);
+    for (unsigned int i = 0; i < 20; ++i) {
+        EXPECT_TRUE(outlier_flags.at(i));
+    }
+    EXPECT_GE(num_inliers, 170u);
+    EXPECT_LT((rot_12 - rot_12_gt).norm(), 1e-2);
+    EXPECT_LT((trans_12 - trans_12_gt).norm(), 2e-2);
+    EXPECT_NEAR(scale_12, scale_12_gt, 1e-2);
+
+    // the buffers are reused for the next problem
+    solver.clear();
+    EXPECT_EQ(solver.num_matches(), 0u);
+    std::vector<bool> outlier_flags_empty;
+    EXPECT_EQ(solver.solve(get_perspective(), get_perspective(), false, 5, 10, 10.0,
+                           rot_12, trans_12, scale_12, outlier_flags_empty),
+              0u);
+}
+
+TEST(transform_solver, equirectangular_with_fixed_scale) {
+    const Mat33_t rot_12_gt = Eigen::AngleAxisd(-0.2, Vec3_t{0.0, 1.0, 0.1}.normalized()).toRotationMatrix();
+    const Vec3_t trans_12_gt{-0.3, 0.05, 0.1};
+
+    optimize::transform_solver solver;
+    add_matches(solver, get_equirectangular(), rot_12_gt, trans_12_gt, 1.0, 100, 0);
+
+    Mat33_t rot_12 = Mat33_t::Identity();
+    Vec3_t trans_12 = Vec3_t::Zero();
+    double scale_12 = 1.0;
+    std::vector<bool> outlier_flags;
+    const auto num_inliers = solver.solve(get_equirectangular(), get_equirectangular(), true, 5, 10, 10.0,
+                                          rot_12, trans_12, scale_12, outlier_flags);
+
+    EXPECT_GE(num_inliers, 95u);
+    EXPECT_LT((rot_12 - rot_12_gt).norm(), 1e-2);
+    EXPECT_LT((trans_12 - trans_12_gt).norm(), 2e-2);
+    EXPECT_DOUBLE_EQ(scale_12, 1.0);
+}
@@ -0,0 +1,53 @@
+#include "stella_vslam/publish/metrics_publisher.h"
+
+#include <gtest/gtest.h>
+
+using namespace stella_vslam;
+
+TEST(metrics_publisher, counters_and_summaries) {
+    publish::metrics_publisher metrics("test_");
+
+    metrics.increment("frames_total");
+    metrics.increment("frames_total", "", 2);
+    metrics.increment("transitions_total", "from=\"Tracking\",to=\"Lost\"");
+    EXPECT_EQ(metrics.get_value("frames_total").value_, 3.0);
+    EXPECT_EQ(metrics.get_value("transitions_total", "from=\"Tracking\",to=\"Lost\"").value_, 1.0);
+    EXPECT_EQ(metrics.get_value("transitions_total").value_, 0.0);
+
+    metrics.observe("local_BA_duration_ms", 5.0);
+    metrics.observe("local_BA_duration_ms", 3.0);
+    const auto summary = metrics.get_value("local_BA_duration_ms");
+    EXPECT_EQ(summary.count_, 2);
+    EXPECT_EQ(summary.value_, 8.0);
+    EXPECT_EQ(summary.max_, 5.0);
+
+    // the gauges are sampled when they are read
+    double num_keyframes = 1.0;
+    metrics.set_gauge("keyframes", [&num_keyframes] { return num_keyframes; }, "number of the keyframes");
+    num_keyframes = 4.0;
+    EXPECT_EQ(metrics.get_value("keyframes").value_, 4.0);
+
+    const auto text = metrics.get_prometheus_text();
+    EXPECT_NE(text.find("# TYPE test_frames_total counter\ntest_frames_total 3\n"), std::string::npos);
+    EXPECT_NE(text.find("test_transitions_total{from=\"Tracking\",to=\"Lost\"} 1\n"), std::string::npos);
+    EXPECT_NE(text.find("test_local_BA_duration_ms_sum 8\ntest_local_BA_duration_ms_count 2\n"), std::string::npos);
+    EXPECT_NE(text.find("test_local_BA_duration_ms_max 5\n"), std::string::npos);
+    EXPECT_NE(text.find("# HELP test_keyframes number of the keyframes\n# TYPE test_keyframes gauge\ntest_keyframes 4\n"), std::string::npos);
+}
+
+TEST(metrics_publisher, callback) {
+    publish::metrics_publisher metrics;
+    metrics.increment("frames_total");
+
+    unsigned int num_calls = 0;
+    std::string last_text;
+    metrics.set_callback([&](const std::string& text) {
+        ++num_calls;
+        last_text = text;
+    },
+                         60000);
+    metrics.notify_if_due();
+    metrics.notify_if_due();
+    EXPECT_EQ(num_calls, 1);
+    EXPECT_NE(last_text.find("stella_vslam_frames_total 1\n"), std::string::npos);
+}
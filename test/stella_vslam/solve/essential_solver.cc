@@ -4,6 +4,7 @@
 #include "stella_vslam/type.h"
 #include "stella_vslam/solve/essential_solver.h"
 #include "stella_vslam/util/converter.h"
+#include "stella_vslam/util/thread_pool.h"
 
 #include <gtest/gtest.h>
 
@@ -139,6 +140,45 @@ TEST(essential_solver, ransac_solve_with_outlier) {
     EXPECT_LT((true_E_21 - E_21).norm(), 1e-2);
 }
 
+TEST(essential_solver, ransac_solve_with_thread_pool) {
+    // create 3D points
+    const unsigned int num_landmarks = 200;
+    const auto landmarks = create_random_landmarks_in_space(num_landmarks, 100);
+
+    // create two-view poses
+    const Mat33_t rot_1 = util::converter::to_rot_mat(54.0 * M_PI / 180.0 * Vec3_t{5, 3, -2}.normalized());
+    const Vec3_t trans_1 = Vec3_t(40.3, -31.6, 58.4);
+    const Mat33_t rot_2 = util::converter::to_rot_mat(-21.0 * M_PI / 180.0 * Vec3_t{-2, -5, 6}.normalized());
+    const Vec3_t trans_2 = Vec3_t(-45.4, 11.5, -24.6);
+
+    // create bearing vectors from two-view poses and 3D points
+    eigen_alloc_vector<Vec3_t> bearings_1;
+    eigen_alloc_vector<Vec3_t> bearings_2;
+    create_bearing_vectors(rot_1, trans_1, landmarks, bearings_1);
+    add_noise(bearings_1, 0.05, 0.2);
+    create_bearing_vectors(rot_2, trans_2, landmarks, bearings_2);
+    add_noise(bearings_2, 0.05, 0.2);
+
+    // create matching information
+    std::vector<std::pair<int, int>> matches_12(num_landmarks);
+    for (unsigned int i = 0; i < num_landmarks; ++i) {
+        matches_12.at(i).first = i;
+        matches_12.at(i).second = i;
+    }
+
+    // the same solution is found with and without the workers
+    solve::essential_solver solver_serial(bearings_1, bearings_2, matches_12, true);
+    solver_serial.find_via_ransac(100, false);
+    util::thread_pool thread_pool(3);
+    solve::essential_solver solver_parallel(bearings_1, bearings_2, matches_12, true);
+    solver_parallel.find_via_ransac(100, false, &thread_pool);
+
+    EXPECT_TRUE(solver_parallel.solution_is_valid());
+    EXPECT_FLOAT_EQ(solver_serial.get_best_cost(), solver_parallel.get_best_cost());
+    EXPECT_LT((solver_serial.get_best_E_21() - solver_parallel.get_best_E_21()).norm(), 1e-12);
+    EXPECT_EQ(solver_serial.get_inlier_matches(), solver_parallel.get_inlier_matches());
+}
+
 TEST(essential_solver, decompose) {
     // create two-view poses
     const Mat33_t rot_1 = util::converter::to_rot_mat(205.0 * M_PI / 180.0 * Vec3_t{4, -6, 2}.normalized());
@@ -201,3 +201,89 @@ TEST(pnp_solver, with_outlier_and_noise) {
     EXPECT_LT(rot_err, 1e-2);
     EXPECT_LT(trans_err, 1);
 }
+
+TEST(pnp_solver, compute_poses_p3p) {
+    eigen_alloc_vector<Vec3_t> landmarks;
+    landmarks.emplace_back(Vec3_t{0.90285978902599595131, 59.132259867903883332, -77.283655667882285911});
+    landmarks.emplace_back(Vec3_t{69.49294443595013604, 60.215644217552778628, 1.5243671019389921639});
+    landmarks.emplace_back(Vec3_t{-61.303331688537312516, -82.61571787600384198, 81.583023085091554094});
+
+    const Mat33_t rot_gt = util::converter::to_rot_mat(97.37 * M_PI / 180 * Vec3_t{9.0, -8.5, 1.1}.normalized());
+    const Vec3_t trans_gt = Vec3_t(-67.5, 84.6, -68.0);
+
+    eigen_alloc_vector<Vec3_t> bearings;
+    create_bearing_vectors(rot_gt, trans_gt, landmarks, bearings);
+
+    Mat33_t bearings_mat;
+    Mat33_t landmarks_mat;
+    for (unsigned int i = 0; i < 3; ++i) {
+        bearings_mat.col(i) = bearings.at(i);
+        landmarks_mat.col(i) = landmarks.at(i);
+    }
+    eigen_alloc_vector<Mat33_t> rots_cw;
+    eigen_alloc_vector<Vec3_t> transs_cw;
+    const auto num_solutions = solve::pnp_solver::compute_poses_p3p(bearings_mat, landmarks_mat, rots_cw, transs_cw);
+    ASSERT_GT(num_solutions, 0);
+    ASSERT_LE(num_solutions, 4);
+    ASSERT_EQ(rots_cw.size(), num_solutions);
+
+    // one of the solutions is the true pose
+    double min_rot_err = std::numeric_limits<double>::max();
+    double min_trans_err = std::numeric_limits<double>::max();
+    for (unsigned int i = 0; i < num_solutions; ++i) {
+        EXPECT_NEAR(rots_cw.at(i).determinant(), 1.0, 1e-6);
+        for (unsigned int j = 0; j < 3; ++j) {
+            // all of the solutions are consistent with the observations
+            const Vec3_t pos_c = rots_cw.at(i) * landmarks.at(j) + transs_cw.at(i);
+            EXPECT_NEAR(pos_c.normalized().dot(bearings.at(j)), 1.0, 1e-9);
+        }
+        const auto rot_err = util::converter::to_angle_axis(rot_gt * rots_cw.at(i).transpose()).norm();
+        if (rot_err < min_rot_err) {
+            min_rot_err = rot_err;
+            min_trans_err = (trans_gt - transs_cw.at(i)).norm();
+        }
+    }
+    EXPECT_LT(min_rot_err, 1e-6);
+    EXPECT_LT(min_trans_err, 1e-4);
+}
+
+TEST(pnp_solver, with_outlier_by_p3p) {
+    // Create landmarks
+    const unsigned int num_landmarks = 100;
+    const auto landmarks = create_random_landmarks_in_space(num_landmarks, 100);
+
+    // Create single-view pose
+    const Mat33_t rot_gt = util::converter::to_rot_mat(97.37 * M_PI / 180 * Vec3_t{9.0, -8.5, 1.1}.normalized());
+    const Vec3_t trans_gt = Vec3_t(-67.5, 84.6, -68.0);
+
+    // Create bearing vectors containing observation noise
+    eigen_alloc_vector<Vec3_t> bearings;
+    create_bearing_vectors(rot_gt, trans_gt, landmarks, bearings);
+    const double outlier_ratio = 0.3;
+    add_noise(bearings, 0.1, outlier_ratio);
+
+    // keypts and scale_factor are required of solver
+    // In this test, octave is 0 and scale factor is 1 for each keypoint
+    std::vector<cv::KeyPoint> keypts;
+    const std::vector<float> scale_factor{1};
+    for (unsigned int i = 0; i < num_landmarks; i++) {
+        keypts.emplace_back(cv::KeyPoint{});
+    }
+
+    // Compute the camera pose by pnp_solver
+    auto solver = std::unique_ptr<solve::pnp_solver>(new solve::pnp_solver(bearings, keypts, landmarks, scale_factor, 10, true));
+    solver->set_use_p3p(true);
+    solver->find_via_ransac(50, false);
+    EXPECT_TRUE(solver->solution_is_valid());
+
+    const auto estimated_pose = solver->get_best_cam_pose();
+
+    const auto rot = estimated_pose.block<3, 3>(0, 0);
+    const auto trans = estimated_pose.block<3, 1>(0, 3);
+
+    const auto rot_err = util::converter::to_angle_axis(rot_gt * rot.transpose()).norm();
+    const auto trans_err = (trans_gt - trans).norm();
+
+    EXPECT_LT(rot_err, 1e-2);
+    EXPECT_LT(trans_err, 1);
+}
@@ -0,0 +1,124 @@
+#include "stella_vslam/solve/ransac.h"
+#include "stella_vslam/util/random_array.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <gtest/gtest.h>
+
+using namespace stella_vslam;
+
+namespace {
+
+// fit the line y = a * x + b to the points, the first num_inliers of which are on the line
+unsigned int fit_line(const std::vector<double>& xs, const std::vector<double>& ys, solve::ransac& sac,
+                      double& best_a, double& best_b) {
+    const unsigned int num_points = xs.size();
+    unsigned int best_num_inliers = 0;
+    std::vector<unsigned int> min_set;
+    while (sac.next_min_set(min_set)) {
+        const auto i = min_set.at(0);
+        const auto j = min_set.at(1);
+        const double a = (ys.at(j) - ys.at(i)) / (xs.at(j) - xs.at(i));
+        const double b = ys.at(i) - a * xs.at(i);
+
+        sac.begin_verification();
+        unsigned int num_inliers = 0;
+        for (unsigned int begin = 0; begin < num_points; begin += solve::ransac::verification_block_size) {
+            const unsigned int num_block = std::min(solve::ransac::verification_block_size, num_points - begin);
+            unsigned int num_inliers_in_block = 0;
+            for (unsigned int k = begin; k < begin + num_block; ++k) {
+                if (std::abs(a * xs.at(k) + b - ys.at(k)) < 1e-6) {
+                    ++num_inliers_in_block;
+                }
+            }
+            num_inliers += num_inliers_in_block;
+            if (!sac.verify(num_inliers_in_block, num_block)) {
+                break;
+            }
+        }
+
+        const bool is_best = !sac.is_rejected() && best_num_inliers < num_inliers;
+        if (is_best) {
+            best_num_inliers = num_inliers;
+            best_a = a;
+            best_b = b;
+        }
+        sac.end_verification(is_best);
+    }
+    return best_num_inliers;
+}
+
+void create_points(const unsigned int num_points, const unsigned int num_inliers,
+                   std::vector<double>& xs, std::vector<double>& ys) {
+    std::mt19937 random_engine;
+    std::uniform_real_distribution<double> dist(-100.0, 100.0);
+    xs.resize(num_points);
+    ys.resize(num_points);
+    for (unsigned int i = 0; i < num_points; ++i) {
+        xs.at(i) = dist(random_engine);
+        ys.at(i) = (i < num_inliers) ? 2.0 * xs.at(i) + 3.0 : dist(random_engine);
+    }
+}
+
+} // namespace
+
+TEST(ransac, adaptive_termination) {
+    std::vector<double> xs, ys;
+    create_points(400, 280, xs, ys);
+
+    auto random_engine = util::create_random_engine(true);
+    constexpr unsigned int max_num_iter = 1000;
+    solve::ransac sac(xs.size(), 2, max_num_iter, random_engine);
+    double a = 0.0, b = 0.0;
+    const auto num_inliers = fit_line(xs, ys, sac, a, b);
+
+    EXPECT_EQ(num_inliers, 280);
+    EXPECT_NEAR(a, 2.0, 1e-6);
+    EXPECT_NEAR(b, 3.0, 1e-6);
+    // the inlier ratio of 0.7 requires about 7 iterations with the confidence of 0.99
+    EXPECT_LT(sac.get_num_iterations(), 50);
+    // the hypotheses from the outliers are rejected before all of the points are verified
+    EXPECT_GT(sac.get_num_rejected(), 0);
+}
+
+TEST(ransac, progressive_sampling) {
+    std::vector<double> xs, ys;
+    create_points(400, 40, xs, ys);
+
+    // the inliers have the smaller distances
+    std::vector<unsigned int> distances(xs.size());
+    for (unsigned int i = 0; i < distances.size(); ++i) {
+        distances.at(i) = (i < 40) ? i % 10 : 10 + i % 50;
+    }
+    const auto sorted_indices = solve::ransac::sort_by_distance(distances);
+    ASSERT_EQ(sorted_indices.size(), xs.size());
+    for (unsigned int i = 0; i < 40; ++i) {
+        EXPECT_LT(sorted_indices.at(i), 40);
+    }
+
+    auto random_engine = util::create_random_engine(true);
+    solve::ransac sac(xs.size(), 2, 1000, random_engine);
+    sac.set_sampling_order(sorted_indices);
+
+    // the first minimal set consists of the best data
+    {
+        solve::ransac first_sac(xs.size(), 2, 1000, random_engine);
+        first_sac.set_sampling_order(sorted_indices);
+        std::vector<unsigned int> min_set;
+        ASSERT_TRUE(first_sac.next_min_set(min_set));
+        std::sort(min_set.begin(), min_set.end());
+        std::vector<unsigned int> best_indices(sorted_indices.begin(), sorted_indices.begin() + 2);
+        std::sort(best_indices.begin(), best_indices.end());
+        EXPECT_EQ(min_set, best_indices);
+    }
+
+    double a = 0.0, b = 0.0;
+    const auto num_inliers = fit_line(xs, ys, sac, a, b);
+
+    EXPECT_EQ(num_inliers, 40);
+    EXPECT_NEAR(a, 2.0, 1e-6);
+    EXPECT_NEAR(b, 3.0, 1e-6);
+    // (NOTE: the inlier ratio of 0.1 requires about 458 iterations by the uniform sampling)
+    EXPECT_LT(sac.get_num_iterations(), 1000);
+}
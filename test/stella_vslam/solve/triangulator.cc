@@ -0,0 +1,70 @@
+#include "helper/bearing_vector.h"
+#include "helper/landmark.h"
+
+#include "stella_vslam/type.h"
+#include "stella_vslam/solve/triangulator.h"
+#include "stella_vslam/util/converter.h"
+
+#include <gtest/gtest.h>
+
+using namespace stella_vslam;
+
+namespace {
+
+// stack the bearing vectors, one per row
+MatX3_t to_rows(const eigen_alloc_vector<Vec3_t>& bearings) {
+    MatX3_t rows(bearings.size(), 3);
+    for (unsigned int i = 0; i < bearings.size(); ++i) {
+        rows.row(i) = bearings.at(i).transpose();
+    }
+    return rows;
+}
+
+} // namespace
+
+TEST(triangulator, batch_triangulation) {
+    // create 3D points
+    const unsigned int num_landmarks = 100;
+    const auto landmarks = create_random_landmarks_in_space(num_landmarks, 100);
+
+    // create two-view poses
+    const Mat33_t rot_1 = util::converter::to_rot_mat(25.0 * M_PI / 180.0 * Vec3_t{4, -6, 2}.normalized());
+    const Vec3_t trans_1 = Vec3_t(-28.1, -63.3, 43.4);
+    const Mat33_t rot_2 = util::converter::to_rot_mat(-15.0 * M_PI / 180.0 * Vec3_t{5, 1, -3}.normalized());
+    const Vec3_t trans_2 = Vec3_t(-30.4, -45.5, -49.6);
+
+    eigen_alloc_vector<Vec3_t> bearings_1;
+    eigen_alloc_vector<Vec3_t> bearings_2;
+    create_bearing_vectors(rot_1, trans_1, landmarks, bearings_1);
+    create_bearing_vectors(rot_2, trans_2, landmarks, bearings_2);
+    const MatX3_t bearings_1_rows = to_rows(bearings_1);
+    const MatX3_t bearings_2_rows = to_rows(bearings_2);
+
+    // with the absolute camera poses
+    Mat44_t cam_pose_1 = Mat44_t::Identity();
+    cam_pose_1.block<3, 3>(0, 0) = rot_1;
+    cam_pose_1.block<3, 1>(0, 3) = trans_1;
+    Mat44_t cam_pose_2 = Mat44_t::Identity();
+    cam_pose_2.block<3, 3>(0, 0) = rot_2;
+    cam_pose_2.block<3, 1>(0, 3) = trans_2;
+
+    MatX3_t pos_ws;
+    solve::triangulator::triangulate(bearings_1_rows, bearings_2_rows, cam_pose_1, cam_pose_2, pos_ws);
+    ASSERT_EQ(pos_ws.rows(), num_landmarks);
+    for (unsigned int i = 0; i < num_landmarks; ++i) {
+        EXPECT_LT((pos_ws.row(i).transpose() - landmarks.at(i)).norm(), 1e-6);
+    }
+
+    // with the relative rotation and translation
+    const Mat33_t rot_21 = rot_2 * rot_1.transpose();
+    const Vec3_t trans_21 = -rot_21 * trans_1 + trans_2;
+
+    MatX3_t pts_in_1;
+    solve::triangulator::triangulate(bearings_1_rows, bearings_2_rows, rot_21, trans_21, pts_in_1);
+    ASSERT_EQ(pts_in_1.rows(), num_landmarks);
+    for (unsigned int i = 0; i < num_landmarks; ++i) {
+        const Vec3_t pt_in_1 = solve::triangulator::triangulate(bearings_1.at(i), bearings_2.at(i), rot_21, trans_21);
+        EXPECT_LT((pts_in_1.row(i).transpose() - pt_in_1).norm(), 1e-6);
+        EXPECT_LT((pts_in_1.row(i).transpose() - (rot_1 * landmarks.at(i) + trans_1)).norm(), 1e-6);
+    }
+}
@@ -0,0 +1,54 @@
+#include "stella_vslam/util/async_reclaimer.h"
+
+#include <atomic>
+#include <memory>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+using namespace stella_vslam;
+
+namespace {
+struct node {
+    explicit node(std::atomic<unsigned int>& num_destructed)
+        : num_destructed_(num_destructed) {}
+    ~node() {
+        ++num_destructed_;
+    }
+    std::atomic<unsigned int>& num_destructed_;
+    std::shared_ptr<node> next_;
+};
+} // namespace
+
+TEST(async_reclaimer, destroy_objects_on_the_thread) {
+    std::atomic<unsigned int> num_destructed{0};
+    std::shared_ptr<std::thread::id> destructed_thread_id = std::make_shared<std::thread::id>();
+    {
+        util::async_reclaimer reclaimer;
+        for (unsigned int i = 0; i < 10; ++i) {
+            // cyclic references, which are broken by the task
+            auto node_1 = std::make_shared<node>(num_destructed);
+            auto node_2 = std::make_shared<node>(num_destructed);
+            node_1->next_ = node_2;
+            node_2->next_ = node_1;
+            reclaimer.push([node_1, destructed_thread_id] {
+                node_1->next_->next_ = nullptr;
+                *destructed_thread_id = std::this_thread::get_id();
+            });
+        }
+        reclaimer.wait_until_idle();
+        EXPECT_EQ(reclaimer.get_num_pending_tasks(), 0u);
+        EXPECT_EQ(num_destructed, 20u);
+        EXPECT_NE(*destructed_thread_id, std::this_thread::get_id());
+    }
+
+    {
+        // the pending objects are destroyed by the destructor
+        util::async_reclaimer reclaimer;
+        for (unsigned int i = 0; i < 100; ++i) {
+            auto obj = std::make_shared<node>(num_destructed);
+            reclaimer.push([obj] {});
+        }
+    }
+    EXPECT_EQ(num_destructed, 120u);
+}
@@ -0,0 +1,45 @@
+#include "stella_vslam/util/blob_codec.h"
+
+#include <random>
+#include <stdexcept>
+
+#include <gtest/gtest.h>
+
+using namespace stella_vslam;
+
+TEST(blob_codec, encode_and_decode) {
+    std::mt19937 mt(42);
+    std::vector<uint8_t> random_bytes(1000);
+    for (auto& byte : random_bytes) {
+        byte = mt() % 256;
+    }
+    const std::vector<uint8_t> repeated_bytes(1000, 7);
+
+    for (const auto& bytes : {random_bytes, repeated_bytes, std::vector<uint8_t>()}) {
+        for (const bool compress : {false, true}) {
+            const auto blob = util::blob_codec::encode(bytes.data(), bytes.size(), compress);
+            EXPECT_EQ(util::blob_codec::decode(blob), bytes);
+        }
+    }
+
+    // the repeated bytes are compressed
+    const auto blob = util::blob_codec::encode(repeated_bytes.data(), repeated_bytes.size(), true);
+    if (util::blob_codec::compression_is_available()) {
+        EXPECT_LT(blob.size(), repeated_bytes.size());
+    }
+    else {
+        EXPECT_GT(blob.size(), repeated_bytes.size());
+    }
+}
+
+TEST(blob_codec, corrupted_blob) {
+    EXPECT_THROW(util::blob_codec::decode("abc"), std::runtime_error);
+
+    const std::vector<uint8_t> bytes(100, 1);
+    auto blob = util::blob_codec::encode(bytes.data(), bytes.size(), false);
+    blob.pop_back();
+    EXPECT_THROW(util::blob_codec::decode(blob), std::runtime_error);
+
+    blob[0] = 9;
+    EXPECT_THROW(util::blob_codec::decode(blob), std::runtime_error);
+}
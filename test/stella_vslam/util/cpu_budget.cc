@@ -0,0 +1,28 @@
+#include "stella_vslam/util/cpu_budget.h"
+
+#include <gtest/gtest.h>
+#include <yaml-cpp/yaml.h>
+
+using namespace stella_vslam;
+
+TEST(cpu_budget, get_rest_ms) {
+    const util::cpu_budget unlimited;
+    EXPECT_FALSE(unlimited.is_limited());
+    EXPECT_DOUBLE_EQ(unlimited.get_rest_ms(100.0), 0.0);
+
+    const util::cpu_budget quarter(0.25, 200.0);
+    EXPECT_TRUE(quarter.is_limited());
+    EXPECT_DOUBLE_EQ(quarter.get_rest_ms(10.0), 30.0);
+    // bounded by max_rest_ms
+    EXPECT_DOUBLE_EQ(quarter.get_rest_ms(100.0), 200.0);
+    EXPECT_DOUBLE_EQ(quarter.get_rest_ms(0.0), 0.0);
+}
+
+TEST(cpu_budget, load_params) {
+    const util::cpu_budget budget(YAML::Load("{cpu_share: 0.5}"));
+    EXPECT_DOUBLE_EQ(budget.get_core_share(), 0.5);
+    EXPECT_DOUBLE_EQ(budget.get_rest_ms(20.0), 20.0);
+
+    EXPECT_THROW(util::cpu_budget(YAML::Load("{cpu_share: 0}")), std::runtime_error);
+    EXPECT_THROW(util::cpu_budget(YAML::Load("{cpu_share: 1.5}")), std::runtime_error);
+}
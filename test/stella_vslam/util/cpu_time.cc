@@ -0,0 +1,33 @@
+#include "stella_vslam/util/cpu_time.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+using namespace stella_vslam;
+
+TEST(cpu_time, thread_cpu_time_scope) {
+    std::atomic<int64_t> counter_ns{0};
+    const auto begin_process_ns = util::get_process_cpu_time_ns();
+    {
+        util::thread_cpu_time_scope scope(counter_ns);
+        // busy for a while
+        const auto begin = std::chrono::steady_clock::now();
+        volatile double sum = 0.0;
+        while (std::chrono::steady_clock::now() - begin < std::chrono::milliseconds(20)) {
+            sum = sum + 1.0;
+        }
+    }
+    const auto busy_ns = counter_ns.load();
+    EXPECT_GT(busy_ns, 5000000);
+    EXPECT_GE(util::get_process_cpu_time_ns() - begin_process_ns, busy_ns);
+
+    // the sleep does not consume the CPU time
+    {
+        util::thread_cpu_time_scope scope(counter_ns);
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    EXPECT_LT(counter_ns.load() - busy_ns, 20000000);
+}
@@ -0,0 +1,69 @@
+#include "stella_vslam/util/allocation_counter.h"
+#include "stella_vslam/util/frame_arena.h"
+
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace stella_vslam;
+
+TEST(frame_arena, allocations_in_scope) {
+    EXPECT_EQ(util::frame_arena::get_active_arena(), nullptr);
+    {
+        util::frame_arena_scope scope;
+        auto* arena = util::frame_arena::get_active_arena();
+        ASSERT_NE(arena, nullptr);
+
+        util::arena_vector<uint8_t> bytes(3);
+        util::arena_vector<double> values(10, 1.0);
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(values.data()) % alignof(double), 0u);
+        EXPECT_EQ(arena->get_used_bytes(), 3 + 10 * sizeof(double));
+
+        // larger than the first block
+        util::arena_vector<uint8_t> large(2 * util::frame_arena::initial_block_size);
+        EXPECT_EQ(arena->get_capacity_bytes(), 3 * util::frame_arena::initial_block_size);
+
+        {
+            // nested scopes share the arena
+            util::frame_arena_scope nested_scope;
+            EXPECT_EQ(util::frame_arena::get_active_arena(), arena);
+        }
+        EXPECT_NE(arena->get_used_bytes(), 0u);
+    }
+    EXPECT_EQ(util::frame_arena::get_active_arena(), nullptr);
+
+    // the blocks are merged and kept for the next frame
+    util::frame_arena_scope scope;
+    auto* arena = util::frame_arena::get_active_arena();
+    EXPECT_EQ(arena->get_used_bytes(), 0u);
+    EXPECT_EQ(arena->get_capacity_bytes(), 3 * util::frame_arena::initial_block_size);
+
+    // the scope is per thread
+    std::thread thread([] {
+        EXPECT_EQ(util::frame_arena::get_active_arena(), nullptr);
+    });
+    thread.join();
+}
+
+TEST(frame_arena, fallback_to_heap) {
+    util::arena_vector<unsigned int> values;
+    for (unsigned int i = 0; i < 1000; ++i) {
+        values.push_back(i);
+    }
+    EXPECT_EQ(values.at(999), 999u);
+}
+
+TEST(allocation_counter, thread_stats) {
+    const auto begin_stats = util::allocation_counter::get_thread_stats();
+    std::unique_ptr<std::vector<int>> values(new std::vector<int>(16));
+    const auto end_stats = util::allocation_counter::get_thread_stats();
+    if (util::allocation_counter::is_enabled()) {
+        EXPECT_EQ(end_stats.num_allocs_ - begin_stats.num_allocs_, 2u);
+        EXPECT_EQ(end_stats.alloc_bytes_ - begin_stats.alloc_bytes_, sizeof(std::vector<int>) + 16 * sizeof(int));
+    }
+    else {
+        EXPECT_EQ(end_stats.num_allocs_, 0u);
+    }
+}
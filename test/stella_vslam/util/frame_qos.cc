@@ -0,0 +1,60 @@
+#include "stella_vslam/util/frame_qos.h"
+
+#include <gtest/gtest.h>
+#include <yaml-cpp/yaml.h>
+
+using namespace stella_vslam;
+
+TEST(frame_qos, select_frame_to_drop) {
+    const std::deque<bool> is_keyframe_candidate = {true, false, false};
+    EXPECT_EQ(util::select_frame_to_drop(is_keyframe_candidate, util::frame_skip_policy_t::Block), 3);
+    EXPECT_EQ(util::select_frame_to_drop(is_keyframe_candidate, util::frame_skip_policy_t::DropOldest), 0);
+    EXPECT_EQ(util::select_frame_to_drop(is_keyframe_candidate, util::frame_skip_policy_t::DropNonKeyframeCandidates), 1);
+    // the oldest one is dropped if all of them are the candidates
+    EXPECT_EQ(util::select_frame_to_drop({true, true}, util::frame_skip_policy_t::DropNonKeyframeCandidates), 0);
+    EXPECT_EQ(util::select_frame_to_drop({}, util::frame_skip_policy_t::DropOldest), 0);
+
+    EXPECT_EQ(util::load_frame_skip_policy("drop_non_keyframe_candidates"), util::frame_skip_policy_t::DropNonKeyframeCandidates);
+    EXPECT_THROW(util::load_frame_skip_policy("drop_newest"), std::runtime_error);
+}
+
+TEST(frame_qos, degrade_and_recover) {
+    util::frame_qos_controller qos(10.0, 1.0, 0.6, 2, 3);
+    EXPECT_EQ(qos.get_level(), util::frame_degradation_level_t::None);
+
+    // overloaded
+    EXPECT_FALSE(qos.update(20.0));
+    EXPECT_TRUE(qos.update(20.0));
+    EXPECT_EQ(qos.get_level(), util::frame_degradation_level_t::SkipLocalMapRefresh);
+    for (unsigned int i = 0; i < 10; ++i) {
+        qos.update(20.0);
+    }
+    EXPECT_EQ(qos.get_level(), util::frame_degradation_level_t::DropFrames);
+
+    // every other frame which is not a keyframe candidate is dropped
+    EXPECT_TRUE(qos.should_drop(false));
+    EXPECT_FALSE(qos.should_drop(false));
+    EXPECT_TRUE(qos.should_drop(false));
+    EXPECT_FALSE(qos.should_drop(true));
+
+    // underloaded
+    for (unsigned int i = 0; i < 100; ++i) {
+        qos.update(1.0);
+    }
+    EXPECT_EQ(qos.get_level(), util::frame_degradation_level_t::None);
+    EXPECT_FALSE(qos.should_drop(false));
+}
+
+TEST(frame_qos, load_params) {
+    const util::frame_qos_controller qos(YAML::Load("{max_degradation_level: 1}"), 50.0);
+    EXPECT_DOUBLE_EQ(qos.get_frame_period_ms(), 50.0);
+
+    util::frame_qos_controller limited(YAML::Load("{max_degradation_level: 1, num_frames_to_degrade: 1}"), 50.0);
+    for (unsigned int i = 0; i < 10; ++i) {
+        limited.update(100.0);
+    }
+    EXPECT_EQ(limited.get_level(), util::frame_degradation_level_t::SkipLocalMapRefresh);
+
+    EXPECT_THROW(util::frame_qos_controller(YAML::Load("{frame_period_ms: 0}"), 50.0), std::runtime_error);
+    EXPECT_THROW(util::frame_qos_controller(YAML::Load("{low_load_ratio: 1.5}"), 50.0), std::runtime_error);
+}
@@ -0,0 +1,53 @@
+#include "stella_vslam/util/id_ordered_flat_map.h"
+
+#include <gtest/gtest.h>
+
+using namespace stella_vslam;
+
+namespace {
+
+struct object {
+    explicit object(const unsigned int id)
+        : id_(id) {}
+    unsigned int id_;
+};
+
+} // namespace
+
+TEST(id_ordered_flat_map, insert_find_erase) {
+    const auto obj_0 = std::make_shared<object>(0);
+    const auto obj_1 = std::make_shared<object>(1);
+    const auto obj_2 = std::make_shared<object>(2);
+
+    util::id_ordered_flat_map<object, unsigned int> map;
+    EXPECT_TRUE(map.empty());
+    map[obj_2] = 20;
+    map[obj_0] = 0;
+    map[obj_1] = 10;
+    EXPECT_EQ(map.size(), 3);
+
+    // sorted by ID
+    unsigned int expected_id = 0;
+    for (const auto& elem : map) {
+        EXPECT_EQ(elem.first.lock()->id_, expected_id);
+        EXPECT_EQ(elem.second, 10 * expected_id);
+        ++expected_id;
+    }
+
+    EXPECT_EQ(map.count(obj_1), 1);
+    EXPECT_EQ(map.count(std::weak_ptr<object>(obj_1)), 1);
+    EXPECT_EQ(map.at(obj_2), 20);
+    EXPECT_THROW(map.at(std::make_shared<object>(3)), std::out_of_range);
+
+    EXPECT_EQ(map.erase(obj_1), 1);
+    EXPECT_EQ(map.erase(obj_1), 0);
+    EXPECT_EQ(map.count(obj_1), 0);
+    EXPECT_EQ(map.size(), 2);
+    EXPECT_EQ(map.begin()->first.lock()->id_, 0);
+
+    // an expired key is not found
+    EXPECT_EQ(map.count(std::weak_ptr<object>()), 0);
+
+    map.clear();
+    EXPECT_TRUE(map.empty());
+}
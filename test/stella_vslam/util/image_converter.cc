@@ -0,0 +1,79 @@
+#include "stella_vslam/util/image_converter.h"
+
+#include <opencv2/core.hpp>
+
+#include <gtest/gtest.h>
+
+using namespace stella_vslam;
+
+TEST(image_converter, sample_true_depth) {
+    cv::Mat depthmap(4, 5, CV_16UC1, cv::Scalar(5000));
+    depthmap.at<unsigned short>(2, 3) = 0;
+
+    // same as the full conversion
+    cv::Mat img_depth = depthmap.clone();
+    util::convert_to_true_depth(img_depth, 5000.0);
+    EXPECT_FLOAT_EQ(util::sample_true_depth(depthmap, 1.7, 2.2, 5000.0), img_depth.at<float>(2, 1));
+    EXPECT_FLOAT_EQ(util::sample_true_depth(depthmap, 1.7, 2.2, 5000.0), 1.0);
+    // invalid pixel
+    EXPECT_LE(util::sample_true_depth(depthmap, 3.0, 2.0, 5000.0), 0.0);
+    // outside of the image
+    EXPECT_LE(util::sample_true_depth(depthmap, 5.0, 0.0, 5000.0), 0.0);
+
+    // float depthmap
+    cv::Mat depthmap_32f(4, 5, CV_32FC1, cv::Scalar(2.5));
+    EXPECT_FLOAT_EQ(util::sample_true_depth(depthmap_32f, 0.0, 0.0, 1.0), 2.5);
+}
+
+TEST(image_converter, sample_true_depth_with_consistency_check) {
+    cv::Mat depthmap(4, 5, CV_16UC1, cv::Scalar(5000));
+    // boundary of an object
+    depthmap.at<unsigned short>(1, 1) = 10000;
+    // invalid neighbor is ignored
+    depthmap.at<unsigned short>(3, 4) = 0;
+
+    EXPECT_FLOAT_EQ(util::sample_true_depth(depthmap, 2.0, 2.0, 5000.0), 1.0);
+    EXPECT_LE(util::sample_true_depth(depthmap, 2.0, 2.0, 5000.0, 0.1), 0.0);
+    EXPECT_FLOAT_EQ(util::sample_true_depth(depthmap, 3.0, 2.0, 5000.0, 0.1), 1.0);
+    EXPECT_FLOAT_EQ(util::sample_true_depth(depthmap, 2.0, 2.0, 5000.0, 1.5), 1.0);
+}
+
+TEST(image_converter, get_grayscale_view_of_image_buffer) {
+    // 4x2 image with the padding of the rows
+    std::vector<uint8_t> data(2 * 16, 0);
+    for (unsigned int i = 0; i < 8; ++i) {
+        data.at(i) = 10 * i;
+        data.at(16 + i) = 10 * i + 100;
+    }
+
+    util::image_buffer buf;
+    buf.data_ = data.data();
+    buf.width_ = 4;
+    buf.height_ = 2;
+    buf.stride_ = 16;
+
+    // the Y plane of NV12 is wrapped without copying
+    cv::Mat gray_buf;
+    buf.format_ = util::pixel_format_t::NV12;
+    const auto view = util::get_grayscale_view(buf, gray_buf);
+    EXPECT_EQ(view.type(), CV_8UC1);
+    EXPECT_EQ(view.data, data.data());
+    EXPECT_EQ(view.at<uint8_t>(1, 2), 120);
+    EXPECT_TRUE(gray_buf.empty());
+
+    // the Y channel of YUYV is extracted into the buffer
+    buf.format_ = util::pixel_format_t::YUYV;
+    const auto converted = util::get_grayscale_view(buf, gray_buf);
+    EXPECT_EQ(converted.data, gray_buf.data);
+    EXPECT_EQ(converted.cols, 4);
+    EXPECT_EQ(converted.at<uint8_t>(0, 1), 20);
+    EXPECT_EQ(converted.at<uint8_t>(1, 3), 160);
+
+    // the release callback is called once
+    unsigned int num_released = 0;
+    buf.release_ = [&num_released] { ++num_released; };
+    {
+        const util::scoped_image_buffer_release release(buf);
+    }
+    EXPECT_EQ(num_released, 1);
+}
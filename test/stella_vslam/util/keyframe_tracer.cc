@@ -0,0 +1,44 @@
+#include "stella_vslam/util/keyframe_tracer.h"
+
+#include <gtest/gtest.h>
+
+using namespace stella_vslam;
+
+TEST(keyframe_tracer, lifecycle) {
+    util::keyframe_tracer tracer(2);
+    tracer.record(0, util::keyframe_stage_t::Created);
+    tracer.record(0, util::keyframe_stage_t::Queued);
+    tracer.record(0, util::keyframe_stage_t::MappingStarted);
+    tracer.record(0, util::keyframe_stage_t::Mapped);
+    tracer.record({0, 1}, util::keyframe_stage_t::LocalBA);
+    tracer.record(0, util::keyframe_stage_t::LoopCheckStarted);
+    tracer.record(0, util::keyframe_stage_t::LoopChecked);
+
+    auto records = tracer.get_records();
+    ASSERT_EQ(records.size(), 2);
+    EXPECT_EQ(records.at(0).keyfrm_id_, 0);
+    for (const auto stage_us : records.at(0).stage_us_) {
+        EXPECT_NE(stage_us, 0);
+    }
+    // only the first time is recorded
+    const auto mapped_us = records.at(0).stage_us_.at(static_cast<unsigned int>(util::keyframe_stage_t::Mapped));
+    tracer.record(0, util::keyframe_stage_t::Mapped);
+    EXPECT_EQ(tracer.get_records().at(0).stage_us_.at(static_cast<unsigned int>(util::keyframe_stage_t::Mapped)), mapped_us);
+
+    // the oldest keyframe is discarded
+    tracer.record(2, util::keyframe_stage_t::Created);
+    records = tracer.get_records();
+    ASSERT_EQ(records.size(), 2);
+    EXPECT_EQ(records.at(0).keyfrm_id_, 1);
+    EXPECT_EQ(records.at(1).keyfrm_id_, 2);
+
+    const auto text = tracer.get_prometheus_text("test_");
+    EXPECT_NE(text.find("test_keyframe_stage_latency_ms_count{stage=\"mapping_queue\"} 1\n"), std::string::npos);
+    EXPECT_NE(text.find("test_keyframe_stage_latency_ms_count{stage=\"local_BA\"} 1\n"), std::string::npos);
+    EXPECT_NE(text.find("test_keyframe_total_latency_ms_count 1\n"), std::string::npos);
+
+    // the ID is reused after the map is reset
+    tracer.record(2, util::keyframe_stage_t::Queued);
+    tracer.record(2, util::keyframe_stage_t::Created);
+    EXPECT_EQ(tracer.get_records().at(1).stage_us_.at(static_cast<unsigned int>(util::keyframe_stage_t::Queued)), 0);
+}
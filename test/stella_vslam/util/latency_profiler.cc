@@ -0,0 +1,66 @@
+#include "stella_vslam/util/latency_profiler.h"
+
+#include <thread>
+
+#include <gtest/gtest.h>
+
+using namespace stella_vslam;
+
+TEST(latency_profiler, thread_spans) {
+    util::latency_profiler::take_thread_spans();
+
+    {
+        const util::scoped_latency_span span("outer");
+        util::latency_profiler::record_span("inner", 10, 25);
+    }
+
+    const auto spans = util::latency_profiler::take_thread_spans();
+    ASSERT_EQ(spans.size(), 2);
+    EXPECT_STREQ(spans.at(0).name_, "inner");
+    EXPECT_EQ(spans.at(0).begin_us_, 10);
+    EXPECT_EQ(spans.at(0).duration_us_, 15);
+    EXPECT_STREQ(spans.at(1).name_, "outer");
+    EXPECT_GE(spans.at(1).duration_us_, 0);
+    EXPECT_TRUE(util::latency_profiler::take_thread_spans().empty());
+
+    // spans are buffered per thread
+    std::vector<util::latency_span> spans_on_other_thread;
+    std::thread thread([&spans_on_other_thread] {
+        util::latency_profiler::record_span("other", 0, 1);
+        spans_on_other_thread = util::latency_profiler::take_thread_spans();
+    });
+    thread.join();
+    ASSERT_EQ(spans_on_other_thread.size(), 1);
+    EXPECT_NE(spans_on_other_thread.at(0).thread_id_, spans.at(0).thread_id_);
+    EXPECT_TRUE(util::latency_profiler::take_thread_spans().empty());
+
+    util::latency_profiler::append_thread_spans(spans_on_other_thread);
+    EXPECT_EQ(util::latency_profiler::take_thread_spans().size(), 1);
+}
+
+TEST(latency_profiler, ring_buffer_and_callback) {
+    util::latency_profiler profiler(2);
+
+    unsigned int num_called = 0;
+    unsigned int last_frame_id = 0;
+    profiler.set_callback([&num_called, &last_frame_id](const util::frame_latency& record) {
+        ++num_called;
+        last_frame_id = record.frame_id_;
+    });
+
+    for (unsigned int frame_id = 0; frame_id < 3; ++frame_id) {
+        profiler.commit_frame(frame_id, 0.1 * frame_id, {util::latency_span{"span", 0, 1, 0, 0, 0}});
+    }
+    EXPECT_EQ(num_called, 3);
+    EXPECT_EQ(last_frame_id, 2);
+
+    // the oldest record is dropped
+    const auto records = profiler.get_records();
+    ASSERT_EQ(records.size(), 2);
+    EXPECT_EQ(records.at(0).frame_id_, 1);
+    EXPECT_EQ(records.at(1).frame_id_, 2);
+    EXPECT_EQ(records.at(1).spans_.size(), 1);
+
+    profiler.clear();
+    EXPECT_TRUE(profiler.get_records().empty());
+}
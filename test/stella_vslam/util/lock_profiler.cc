@@ -0,0 +1,73 @@
+#include "stella_vslam/util/lock_profiler.h"
+
+#include <gtest/gtest.h>
+
+using namespace stella_vslam;
+
+TEST(lock_profiler, histograms_per_call_site) {
+    util::lock_profiler::reset();
+    auto* cls = util::lock_profiler::get_lock_class("test::mtx_");
+    EXPECT_EQ(util::lock_profiler::get_lock_class("test::mtx_"), cls);
+
+    int site_1 = 0;
+    int site_2 = 0;
+    util::lock_profiler::record_wait(cls, &site_1, 0);
+    util::lock_profiler::record_wait(cls, &site_1, 3000);
+    util::lock_profiler::record_hold(cls, &site_1, 500);
+    util::lock_profiler::record_wait(cls, &site_2, 100000);
+
+    const auto stats = util::lock_profiler::get_stats();
+    std::vector<util::lock_site_stats> stats_of_class;
+    for (const auto& site_stats : stats) {
+        if (site_stats.lock_class_ == "test::mtx_") {
+            stats_of_class.push_back(site_stats);
+        }
+    }
+    ASSERT_EQ(stats_of_class.size(), 2);
+
+    // sorted by the total wait time
+    EXPECT_DOUBLE_EQ(stats_of_class.at(0).wait_sum_us_, 100.0);
+    EXPECT_EQ(stats_of_class.at(0).wait_counts_.at(7), 1); // 64 < 100 <= 128 [us]
+    EXPECT_DOUBLE_EQ(stats_of_class.at(1).wait_sum_us_, 3.0);
+    EXPECT_EQ(stats_of_class.at(1).wait_counts_.at(0), 1);
+    EXPECT_EQ(stats_of_class.at(1).wait_counts_.at(2), 1); // 2 < 3 <= 4 [us]
+    EXPECT_EQ(stats_of_class.at(1).hold_counts_.at(0), 1);
+    EXPECT_DOUBLE_EQ(stats_of_class.at(1).hold_sum_us_, 0.5);
+
+    const auto text = util::lock_profiler::get_prometheus_text("stella_vslam_");
+    EXPECT_NE(text.find("# TYPE stella_vslam_lock_wait_us histogram"), std::string::npos);
+    EXPECT_NE(text.find("class=\"test::mtx_\""), std::string::npos);
+    EXPECT_NE(text.find("le=\"+Inf\"} 2"), std::string::npos);
+
+    util::lock_profiler::reset();
+    for (const auto& site_stats : util::lock_profiler::get_stats()) {
+        EXPECT_NE(site_stats.lock_class_, "test::mtx_");
+    }
+}
+
+TEST(lock_profiler, profiled_mutex) {
+    util::profiled_mutex mtx("test::profiled_mutex");
+    {
+        std::lock_guard<util::profiled_mutex> lock(mtx);
+    }
+    EXPECT_TRUE(mtx.try_lock());
+    mtx.unlock();
+
+    util::profiled_shared_mutex shared_mtx("test::profiled_shared_mutex");
+    {
+        util::shared_lock_guard lock(shared_mtx);
+    }
+    {
+        std::lock_guard<util::profiled_shared_mutex> lock(shared_mtx);
+    }
+
+#ifdef USE_LOCK_PROFILER
+    unsigned int num_sites = 0;
+    for (const auto& site_stats : util::lock_profiler::get_stats()) {
+        if (site_stats.lock_class_ == "test::profiled_mutex") {
+            ++num_sites;
+        }
+    }
+    EXPECT_LE(1u, num_sites);
+#endif
+}
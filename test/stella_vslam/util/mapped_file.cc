@@ -0,0 +1,71 @@
+#include "stella_vslam/util/mapped_file.h"
+
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+
+#include <gtest/gtest.h>
+
+using namespace stella_vslam;
+
+TEST(mapped_file, read_whole_file) {
+    const std::string path = "mapped_file_test.bin";
+    std::vector<uint8_t> bytes(10000);
+    for (unsigned int i = 0; i < bytes.size(); ++i) {
+        bytes.at(i) = i % 251;
+    }
+    {
+        std::ofstream ofs(path, std::ios::out | std::ios::binary);
+        ofs.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+    }
+
+    {
+        const util::mapped_file file(path);
+        ASSERT_EQ(file.size(), bytes.size());
+        for (unsigned int i = 0; i < bytes.size(); ++i) {
+            EXPECT_EQ(file.data()[i], bytes.at(i));
+        }
+    }
+
+    std::remove(path.c_str());
+}
+
+TEST(mapped_file, release_and_read_again) {
+    const std::string path = "mapped_file_test_release.bin";
+    std::vector<uint8_t> bytes(100000);
+    for (unsigned int i = 0; i < bytes.size(); ++i) {
+        bytes.at(i) = i % 253;
+    }
+    {
+        std::ofstream ofs(path, std::ios::out | std::ios::binary);
+        ofs.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+    }
+
+    {
+        const util::mapped_file file(path);
+        file.advise_random_access();
+        // the partial pages at both ends are kept
+        file.release(100, 50000);
+        file.release(90000, 20000);
+        ASSERT_EQ(file.size(), bytes.size());
+        for (unsigned int i = 0; i < bytes.size(); ++i) {
+            EXPECT_EQ(file.data()[i], bytes.at(i));
+        }
+    }
+
+    std::remove(path.c_str());
+}
+
+TEST(mapped_file, empty_file) {
+    const std::string path = "mapped_file_test_empty.bin";
+    { std::ofstream ofs(path, std::ios::out | std::ios::binary); }
+
+    const util::mapped_file file(path);
+    EXPECT_EQ(file.size(), 0);
+
+    std::remove(path.c_str());
+}
+
+TEST(mapped_file, file_not_found) {
+    EXPECT_THROW(util::mapped_file("not_existing_file.bin"), std::runtime_error);
+}
@@ -0,0 +1,34 @@
+#include "stella_vslam/util/pool_allocator.h"
+
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace stella_vslam;
+
+namespace {
+
+struct object {
+    explicit object(const unsigned int id)
+        : id_(id) {}
+    unsigned int id_;
+};
+
+} // namespace
+
+TEST(pool_allocator, allocate_shared) {
+    std::vector<std::shared_ptr<object>> objs;
+    for (unsigned int id = 0; id < 3000; ++id) {
+        objs.push_back(std::allocate_shared<object>(util::pool_allocator<object>(), id));
+    }
+    for (unsigned int id = 0; id < objs.size(); ++id) {
+        EXPECT_EQ(objs.at(id)->id_, id);
+    }
+
+    // the released blocks are recycled
+    object* const released = objs.back().get();
+    objs.pop_back();
+    const auto obj = std::allocate_shared<object>(util::pool_allocator<object>(), 10000);
+    EXPECT_EQ(obj.get(), released);
+}
@@ -0,0 +1,68 @@
+#include "stella_vslam/util/scratch_buffer.h"
+
+#include <memory>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+using namespace stella_vslam;
+
+TEST(scratch_buffer, reuse_capacity) {
+    const unsigned int* data = nullptr;
+    {
+        util::scratch_vector<unsigned int> buf;
+        EXPECT_TRUE(buf->empty());
+        buf->resize(1000, 1);
+        data = buf->data();
+    }
+    {
+        // the vector returned by the previous one is borrowed again (empty with the capacity kept)
+        util::scratch_vector<unsigned int> buf;
+        EXPECT_TRUE(buf->empty());
+        EXPECT_GE(buf->capacity(), 1000u);
+        buf->resize(1000);
+        EXPECT_EQ(buf->data(), data);
+    }
+    {
+        util::scratch_vector<unsigned int> buf(10, 3);
+        ASSERT_EQ(buf->size(), 10u);
+        EXPECT_EQ(buf->at(9), 3u);
+    }
+}
+
+TEST(scratch_buffer, nested) {
+    util::scratch_vector<int> buf_1(100, 1);
+    {
+        util::scratch_vector<int> buf_2(100, 2);
+        EXPECT_NE(buf_1->data(), buf_2->data());
+        EXPECT_EQ(buf_1->at(0), 1);
+    }
+    EXPECT_EQ(buf_1->at(99), 1);
+}
+
+TEST(scratch_buffer, release_elements) {
+    auto ptr = std::make_shared<int>(0);
+    {
+        util::scratch_vector<std::shared_ptr<int>> buf;
+        buf->push_back(ptr);
+        EXPECT_EQ(ptr.use_count(), 2);
+    }
+    // the elements are not kept by the free list
+    EXPECT_EQ(ptr.use_count(), 1);
+}
+
+TEST(scratch_buffer, per_thread) {
+    const unsigned int* data = nullptr;
+    {
+        util::scratch_vector<unsigned int> buf(1000);
+        data = buf->data();
+    }
+    std::thread thread([data] {
+        // the vector of the other thread is not borrowed
+        util::scratch_vector<unsigned int> buf;
+        EXPECT_EQ(buf->capacity(), 0u);
+        buf->resize(1000);
+        EXPECT_NE(buf->data(), data);
+    });
+    thread.join();
+}
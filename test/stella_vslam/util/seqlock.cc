@@ -0,0 +1,68 @@
+#include "stella_vslam/util/seqlock.h"
+
+#include <atomic>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+using namespace stella_vslam;
+
+namespace {
+struct record {
+    double values_[17];
+    int state_;
+};
+} // namespace
+
+TEST(seqlock, store_and_load) {
+    util::seqlock<record> lock;
+    EXPECT_EQ(lock.get_sequence(), 0);
+
+    record value{};
+    value.values_[16] = 2.5;
+    value.state_ = 3;
+    lock.store(value);
+
+    uint64_t seq = 0;
+    const auto loaded = lock.load(seq);
+    EXPECT_EQ(seq, 2);
+    EXPECT_EQ(lock.get_sequence(), 2);
+    EXPECT_EQ(loaded.values_[16], 2.5);
+    EXPECT_EQ(loaded.state_, 3);
+}
+
+TEST(seqlock, consistent_reads_during_writes) {
+    util::seqlock<record> lock;
+    std::atomic<bool> is_finished{false};
+
+    // a value is consistent if all of the elements are equal
+    std::thread writer([&] {
+        record value{};
+        for (int i = 1; i <= 20000; ++i) {
+            for (auto& v : value.values_) {
+                v = i;
+            }
+            value.state_ = i;
+            lock.store(value);
+        }
+        is_finished = true;
+    });
+
+    unsigned int num_inconsistent = 0;
+    uint64_t last_seq = 0;
+    while (!is_finished) {
+        uint64_t seq = 0;
+        const auto value = lock.load(seq);
+        EXPECT_GE(seq, last_seq);
+        last_seq = seq;
+        for (const auto v : value.values_) {
+            if (v != value.state_) {
+                ++num_inconsistent;
+            }
+        }
+    }
+    writer.join();
+
+    EXPECT_EQ(num_inconsistent, 0);
+    EXPECT_EQ(lock.load().state_, 20000);
+}
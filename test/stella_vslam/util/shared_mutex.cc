@@ -0,0 +1,76 @@
+#include "stella_vslam/util/shared_mutex.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace stella_vslam;
+
+TEST(shared_mutex, readers_share_the_lock) {
+    util::shared_mutex mtx;
+    std::atomic<unsigned int> num_readers{0};
+    std::atomic<unsigned int> max_num_readers{0};
+
+    std::vector<std::thread> threads;
+    for (unsigned int i = 0; i < 4; ++i) {
+        threads.emplace_back([&] {
+            util::shared_lock_guard lock(mtx);
+            const unsigned int curr = ++num_readers;
+            unsigned int prev_max = max_num_readers;
+            while (prev_max < curr && !max_num_readers.compare_exchange_weak(prev_max, curr)) {
+            }
+            // wait until all the readers hold the lock at the same time
+            while (num_readers < 4) {
+                std::this_thread::yield();
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(max_num_readers, 4);
+}
+
+TEST(shared_mutex, writers_are_exclusive) {
+    util::shared_mutex mtx;
+    unsigned int counter = 0;
+    std::atomic<unsigned int> num_inconsistencies{0};
+
+    std::vector<std::thread> threads;
+    for (unsigned int i = 0; i < 4; ++i) {
+        threads.emplace_back([&] {
+            for (unsigned int j = 0; j < 10000; ++j) {
+                std::lock_guard<util::shared_mutex> lock(mtx);
+                ++counter;
+            }
+        });
+        threads.emplace_back([&] {
+            for (unsigned int j = 0; j < 10000; ++j) {
+                util::shared_lock_guard lock(mtx);
+                // the counter must not be modified while reading
+                const unsigned int first = counter;
+                std::this_thread::yield();
+                if (first != counter) {
+                    ++num_inconsistencies;
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(counter, 40000);
+    EXPECT_EQ(num_inconsistencies, 0);
+}
+
+TEST(shared_mutex, recursive_shared_lock_is_asserted) {
+    util::shared_mutex mtx;
+    // (without a waiting writer, the recursive lock does not block in the release build)
+    EXPECT_DEBUG_DEATH({
+        util::shared_lock_guard lock1(mtx);
+        util::shared_lock_guard lock2(mtx);
+    },
+                       "recursively");
+}
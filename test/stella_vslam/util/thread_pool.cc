@@ -0,0 +1,184 @@
+#include "stella_vslam/util/parallel_for.h"
+#include "stella_vslam/util/thread_pool.h"
+
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace stella_vslam;
+
+TEST(thread_pool, run_tasks) {
+    util::thread_pool pool(4);
+    EXPECT_EQ(pool.get_num_threads(), 4);
+
+    std::vector<std::future<unsigned int>> futures;
+    for (unsigned int i = 0; i < 100; ++i) {
+        futures.push_back(pool.submit([i] { return i * i; }));
+    }
+    for (unsigned int i = 0; i < 100; ++i) {
+        pool.wait(futures.at(i));
+        EXPECT_EQ(futures.at(i).get(), i * i);
+    }
+}
+
+TEST(thread_pool, nested_tasks) {
+    // the outer tasks occupy all of the workers and wait for the inner tasks
+    util::thread_pool pool(2);
+    std::atomic<unsigned int> num_inner_tasks{0};
+
+    std::vector<std::future<void>> futures;
+    for (unsigned int i = 0; i < 4; ++i) {
+        futures.push_back(pool.submit([&pool, &num_inner_tasks] {
+            std::vector<std::future<void>> inner_futures;
+            for (unsigned int j = 0; j < 4; ++j) {
+                inner_futures.push_back(pool.submit([&num_inner_tasks] { ++num_inner_tasks; }));
+            }
+            for (const auto& inner_future : inner_futures) {
+                pool.wait(inner_future);
+            }
+        }));
+    }
+    for (const auto& future : futures) {
+        pool.wait(future);
+    }
+    EXPECT_EQ(num_inner_tasks, 16);
+}
+
+TEST(thread_pool, without_worker) {
+    // the tasks are run by the waiting thread
+    util::thread_pool pool(0);
+    auto future = pool.submit([] { return 42; });
+    pool.wait(future);
+    EXPECT_EQ(future.get(), 42);
+}
+
+TEST(thread_pool, priorities) {
+    // the pending tasks are run in the order of the priorities
+    util::thread_pool pool(0);
+    std::vector<int> order;
+    auto future_low = pool.submit([&order] { order.push_back(2); }, util::task_priority_t::Low);
+    auto future_normal = pool.submit([&order] { order.push_back(1); });
+    auto future_high = pool.submit([&order] { order.push_back(0); }, util::task_priority_t::High);
+    pool.wait(future_low);
+    ASSERT_EQ(order.size(), 3);
+    EXPECT_EQ(order.at(0), 0);
+    EXPECT_EQ(order.at(1), 1);
+    EXPECT_EQ(order.at(2), 2);
+}
+
+TEST(thread_pool, fair_scheduling_of_clients) {
+    // the tasks of the clients are taken in turn within a priority
+    util::thread_pool pool(0);
+    const auto client_id_1 = pool.add_client();
+    const auto client_id_2 = pool.add_client();
+    EXPECT_NE(client_id_1, client_id_2);
+    std::vector<unsigned int> order;
+    std::vector<std::future<void>> futures;
+    {
+        util::thread_pool::client_scope scope(client_id_1);
+        for (unsigned int i = 0; i < 3; ++i) {
+            futures.push_back(pool.submit([&order, client_id_1] { order.push_back(client_id_1); }));
+        }
+    }
+    {
+        util::thread_pool::client_scope scope(client_id_2);
+        futures.push_back(pool.submit([&order, client_id_2] { order.push_back(client_id_2); }));
+    }
+    pool.wait(futures.back());
+    ASSERT_GE(order.size(), 2);
+    EXPECT_EQ(order.at(0), client_id_1);
+    EXPECT_EQ(order.at(1), client_id_2);
+    for (const auto& future : futures) {
+        pool.wait(future);
+    }
+    EXPECT_EQ(order.size(), 4);
+}
+
+TEST(thread_pool, nested_tasks_with_pinned_workers) {
+    // the nested tasks are stolen by the other workers or run by the waiting worker
+    util::thread_pool pool(4, {0});
+    std::atomic<unsigned int> num_inner_tasks{0};
+
+    auto future = pool.submit([&pool, &num_inner_tasks] {
+        std::vector<std::future<void>> inner_futures;
+        for (unsigned int j = 0; j < 64; ++j) {
+            inner_futures.push_back(pool.submit([&num_inner_tasks] { ++num_inner_tasks; }));
+        }
+        for (const auto& inner_future : inner_futures) {
+            pool.wait(inner_future);
+        }
+    });
+    pool.wait(future);
+    EXPECT_EQ(num_inner_tasks, 64);
+}
+
+TEST(thread_pool, waiter_runs_only_own_urgent_tasks) {
+    // the waiting thread outside of the pool does not run the tasks of the other clients or the less urgent ones
+    util::thread_pool pool(1);
+    const auto client_id_1 = pool.add_client();
+    const auto client_id_2 = pool.add_client();
+
+    // block the worker
+    std::promise<void> promise_release;
+    std::shared_future<void> future_release = promise_release.get_future().share();
+    std::promise<void> promise_blocked;
+    auto future_blocker = pool.submit([&promise_blocked, future_release] {
+        promise_blocked.set_value();
+        future_release.wait();
+    });
+    promise_blocked.get_future().wait();
+
+    std::atomic<bool> other_client_task_is_run{false};
+    std::atomic<bool> low_task_is_run{false};
+    std::future<void> future_other_client;
+    {
+        util::thread_pool::client_scope scope(client_id_2);
+        future_other_client = pool.submit([&other_client_task_is_run] { other_client_task_is_run = true; }, util::task_priority_t::High);
+    }
+    {
+        util::thread_pool::client_scope scope(client_id_1);
+        auto future_low = pool.submit([&low_task_is_run] { low_task_is_run = true; }, util::task_priority_t::Low);
+        auto future_high = pool.submit([] { return 42; }, util::task_priority_t::High);
+        pool.wait(future_high, util::task_priority_t::High);
+        EXPECT_EQ(future_high.get(), 42);
+        EXPECT_FALSE(other_client_task_is_run);
+        EXPECT_FALSE(low_task_is_run);
+
+        promise_release.set_value();
+        pool.wait(future_low, util::task_priority_t::Low);
+    }
+    pool.wait(future_other_client);
+    pool.wait(future_blocker);
+    EXPECT_TRUE(other_client_task_is_run);
+    EXPECT_TRUE(low_task_is_run);
+}
+
+TEST(thread_pool, parallel_for) {
+    for (const unsigned int num_threads : {0u, 3u}) {
+        util::thread_pool pool(num_threads);
+        std::vector<int> counts(1000, 0);
+        util::parallel_for(
+            &pool, 0, static_cast<int64_t>(counts.size()), [&counts](const int64_t idx) {
+                ++counts.at(idx);
+            },
+            util::task_priority_t::Normal, 16);
+        for (const auto count : counts) {
+            EXPECT_EQ(count, 1);
+        }
+    }
+}
+
+TEST(thread_pool, parallel_for_rethrows_exception) {
+    util::thread_pool pool(2);
+    std::atomic<int> num_calls{0};
+    EXPECT_THROW(util::parallel_for(&pool, 0, 100, [&num_calls](const int64_t idx) {
+                     ++num_calls;
+                     if (idx == 50) {
+                         throw std::runtime_error("failed");
+                     }
+                 }),
+                 std::runtime_error);
+    EXPECT_LE(1, num_calls);
+}
@@ -0,0 +1,36 @@
+#include "stella_vslam/util/thread_scheduling.h"
+
+#include <thread>
+
+#include <gtest/gtest.h>
+#include <yaml-cpp/yaml.h>
+
+using namespace stella_vslam;
+
+TEST(thread_scheduling, load_params) {
+    const auto params = util::thread_scheduling_params::load(YAML::Load("{cpu_affinity: [2, 3], nice: 5}"));
+    ASSERT_EQ(params.cpu_ids_.size(), 2);
+    EXPECT_EQ(params.cpu_ids_.at(0), 2);
+    EXPECT_EQ(params.cpu_ids_.at(1), 3);
+    EXPECT_EQ(params.realtime_priority_, 0);
+    EXPECT_EQ(params.nice_, 5);
+    EXPECT_EQ(params.numa_node_, -1);
+    EXPECT_FALSE(params.is_default());
+
+    EXPECT_TRUE(util::thread_scheduling_params::load(YAML::Node()).is_default());
+    EXPECT_THROW(util::thread_scheduling_params::load(YAML::Load("{realtime_priority: 100}")), std::runtime_error);
+    EXPECT_THROW(util::thread_scheduling_params::load(YAML::Load("{nice: -21}")), std::runtime_error);
+}
+
+#ifdef __linux__
+TEST(thread_scheduling, apply_affinity_and_nice) {
+    // (raising the nice value does not need any privilege)
+    util::thread_scheduling_params params;
+    params.cpu_ids_ = {0};
+    params.nice_ = 1;
+    bool succeeded = false;
+    std::thread thread([&params, &succeeded] { succeeded = util::apply_current_thread_scheduling(params); });
+    thread.join();
+    EXPECT_TRUE(succeeded);
+}
+#endif
@@ -18,3 +18,23 @@ TEST(trigonometric, sin) {
         EXPECT_NEAR(std::sin(rad), util::sin(rad), 1e-3);
     }
 }
+
+TEST(trigonometric, atan2) {
+    Eigen::ArrayXd ys(361 * 3);
+    Eigen::ArrayXd xs(361 * 3);
+    for (unsigned int deg = 0; deg <= 360; ++deg) {
+        const double rad = deg * M_PI / 180.0;
+        for (unsigned int i = 0; i < 3; ++i) {
+            // various scales
+            const double scale = std::pow(10.0, i - 1.0);
+            ys(3 * deg + i) = scale * std::sin(rad);
+            xs(3 * deg + i) = scale * std::cos(rad);
+        }
+    }
+
+    const Eigen::ArrayXd vs = util::atan2(ys, xs);
+    for (unsigned int i = 0; i < ys.size(); ++i) {
+        EXPECT_NEAR(std::atan2(ys(i), xs(i)), util::atan2(ys(i), xs(i)), 1e-8);
+        EXPECT_NEAR(std::atan2(ys(i), xs(i)), vs(i), 1e-8);
+    }
+}
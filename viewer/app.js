@@ -1,4 +1,5 @@
 let express = require("express");
+let zlib = require("zlib");
 let http_server = require("http").Server(express());
 let io_server = require("socket.io")(http_server);
 
@@ -11,6 +12,19 @@ app.set("views", __dirname + "/views");
 app.set("view engine", "ejs");
 app.use(express.static(__dirname + "/public"));
 
+// the map segments compressed by the publisher ("zstd:" + base64) are decompressed for the browsers
+// (NOTE: zlib of Node.js supports zstd since v22.15 or v23.8)
+function decompressSegment(msg) {
+  if (typeof msg !== "string" || !msg.startsWith("zstd:")) {
+    return msg;
+  }
+  if (typeof zlib.zstdDecompressSync !== "function") {
+    console.log("cannot decompress the map segment: zstd is not supported by this Node.js");
+    return "";
+  }
+  return zlib.zstdDecompressSync(Buffer.from(msg.substring(5), "base64")).toString("base64");
+}
+
 // render browser
 app.get("/", function (req, res) {
   res.render("index.ejs");
@@ -19,12 +33,46 @@ app.get("/", function (req, res) {
 io_server.on("connection", function (socket) {
   console.log(`Connected - ID: ${socket.id}`);
 
-  socket.on("map_publish", function (msg) {
-    io_publisher.emit("map_publish", msg);
+  // acknowledge the messages so that the publisher does not send faster than they are relayed
+  socket.on("map_publish", function (msg, ack) {
+    io_publisher.emit("map_publish", decompressSegment(msg));
+    if (typeof ack === "function") {
+      ack();
+    }
   });
 
-  socket.on("frame_publish", function (msg) {
+  socket.on("frame_publish", function (msg, ack) {
     io_publisher.emit("frame_publish", { image: true, buffer: msg });
+    if (typeof ack === "function") {
+      ack();
+    }
+  });
+
+  // the snapshot for the late joiners ("id0,id1,... snapshot") is sent only to them
+  socket.on("map_snapshot", function (msg, ack) {
+    let separator = msg.indexOf(" ");
+    let snapshot = decompressSegment(msg.substring(separator + 1));
+    for (let id of msg.substring(0, separator).split(",")) {
+      io_publisher.to(id).emit("map_publish", snapshot);
+    }
+    if (typeof ack === "function") {
+      ack();
+    }
+  });
+
+  // the keyframes of the robots and the corrections of the map server are relayed between the publishers
+  socket.on("keyframe_segment", function (msg, ack) {
+    socket.broadcast.emit("keyframe_segment", msg);
+    if (typeof ack === "function") {
+      ack();
+    }
+  });
+
+  socket.on("map_correction", function (msg, ack) {
+    socket.broadcast.emit("map_correction", msg);
+    if (typeof ack === "function") {
+      ack();
+    }
   });
 
   socket.on("disconnect", function () {
@@ -34,6 +82,10 @@ io_server.on("connection", function (socket) {
 
 io_publisher.on("connection", function (socket) {
   socket.on("signal", function (msg) {
+    // the publisher sends the snapshot of the map to this viewer
+    if (msg === "request_map_snapshot") {
+      msg += " " + socket.id;
+    }
     io_server.emit("signal", msg);
   });
 });
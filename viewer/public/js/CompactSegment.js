@@ -0,0 +1,137 @@
+// decoder of the compact map segments (map_segment.map.compact) encoded by socket_publisher::map_segment_encoder
+// The values of the received keyframes and landmarks are kept to apply the differences sent in the following segments.
+class CompactSegmentDecoder {
+
+    constructor() {
+        this.keyframeValues = {};
+        this.landmarkValues = {};
+    }
+
+    // forget the received values (when all of the data is reset)
+    reset() {
+        this.keyframeValues = {};
+        this.landmarkValues = {};
+    }
+
+    // convert the compact segment to the lists of loadProtobufData()
+    decode(compact, keyframes, edges, points, referencePointIds, currentFramePose) {
+        let toNumber = CompactSegmentDecoder.toNumber;
+        let tileOrigin = compact.tileOrigin.map(toNumber);
+        let step = compact.positionStep;
+        let rotationScale = compact.rotationScale;
+
+        let currentValues = compact.currentFrame.map(toNumber);
+        for (let i = 0; i < 3; i++) {
+            currentValues[4 + i] += tileOrigin[i];
+        }
+        for (let row of CompactSegmentDecoder.toPose(currentValues, step, rotationScale)) {
+            currentFramePose.push(row);
+        }
+
+        // keyframes
+        let ids = CompactSegmentDecoder.decodeIds(compact.addedKeyframeIds);
+        for (let i = 0; i < ids.length; i++) {
+            let values = compact.addedKeyframePoses.slice(7 * i, 7 * i + 7).map(toNumber);
+            for (let j = 0; j < 3; j++) {
+                values[4 + j] += tileOrigin[j];
+            }
+            this.keyframeValues[ids[i]] = values;
+            keyframes.push({ "id": ids[i], "camera_pose": CompactSegmentDecoder.toPose(values, step, rotationScale) });
+        }
+        ids = CompactSegmentDecoder.decodeIds(compact.updatedKeyframeIds);
+        for (let i = 0; i < ids.length; i++) {
+            let values = this.keyframeValues[ids[i]];
+            // the keyframe is sent by the snapshot later if this viewer has joined after it was added
+            if (values == undefined) {
+                continue;
+            }
+            for (let j = 0; j < 7; j++) {
+                values[j] += toNumber(compact.updatedKeyframePoses[7 * i + j]);
+            }
+            keyframes.push({ "id": ids[i], "camera_pose": CompactSegmentDecoder.toPose(values, step, rotationScale) });
+        }
+        for (let id of CompactSegmentDecoder.decodeIds(compact.removedKeyframeIds)) {
+            delete this.keyframeValues[id];
+            keyframes.push({ "id": id });
+        }
+
+        // landmarks
+        ids = CompactSegmentDecoder.decodeIds(compact.addedLandmarkIds);
+        for (let i = 0; i < ids.length; i++) {
+            let values = compact.addedLandmarkPositions.slice(3 * i, 3 * i + 3).map(toNumber);
+            for (let j = 0; j < 3; j++) {
+                values[j] += tileOrigin[j];
+            }
+            this.landmarkValues[ids[i]] = values;
+            points.push({ "id": ids[i], "point_pos": values.map(v => v * step), "rgb": [0, 0, 0] });
+        }
+        ids = CompactSegmentDecoder.decodeIds(compact.updatedLandmarkIds);
+        for (let i = 0; i < ids.length; i++) {
+            let values = this.landmarkValues[ids[i]];
+            if (values == undefined) {
+                continue;
+            }
+            for (let j = 0; j < 3; j++) {
+                values[j] += toNumber(compact.updatedLandmarkPositions[3 * i + j]);
+            }
+            points.push({ "id": ids[i], "point_pos": values.map(v => v * step), "rgb": [0, 0, 0] });
+        }
+        for (let id of CompactSegmentDecoder.decodeIds(compact.removedLandmarkIds)) {
+            delete this.landmarkValues[id];
+            points.push({ "id": id });
+        }
+
+        for (let id of CompactSegmentDecoder.decodeIds(compact.localLandmarkIds)) {
+            referencePointIds.push(id);
+        }
+
+        let id0 = 0;
+        for (let i = 0; i + 1 < compact.edges.length; i += 2) {
+            id0 += toNumber(compact.edges[i]);
+            edges.push([id0, id0 + toNumber(compact.edges[i + 1])]);
+        }
+    }
+
+    // the IDs are sent as the differences from the previous ones
+    static decodeIds(diffs) {
+        let ids = [];
+        let id = 0;
+        for (let diff of diffs) {
+            id += diff;
+            ids.push(id);
+        }
+        return ids;
+    }
+
+    // (the 64-bit integers are decoded as Long if long.js is loaded)
+    static toNumber(value) {
+        return typeof value === "number" ? value : value.toNumber();
+    }
+
+    // convert the quantized rotation and camera center to the 4x4 pose (cw)
+    static toPose(values, step, rotationScale) {
+        let qw = values[0], qx = values[1], qy = values[2], qz = values[3];
+        let norm = Math.sqrt(qw * qw + qx * qx + qy * qy + qz * qz);
+        if (norm == 0) {
+            norm = rotationScale;
+            qw = rotationScale;
+        }
+        qw /= norm; qx /= norm; qy /= norm; qz /= norm;
+
+        let rot = [
+            [1 - 2 * (qy * qy + qz * qz), 2 * (qx * qy - qz * qw), 2 * (qx * qz + qy * qw)],
+            [2 * (qx * qy + qz * qw), 1 - 2 * (qx * qx + qz * qz), 2 * (qy * qz - qx * qw)],
+            [2 * (qx * qz - qy * qw), 2 * (qy * qz + qx * qw), 1 - 2 * (qx * qx + qy * qy)]
+        ];
+        let center = [values[4] * step, values[5] * step, values[6] * step];
+
+        // t = - R * center
+        let pose = [];
+        for (let i = 0; i < 3; i++) {
+            let trans = -(rot[i][0] * center[0] + rot[i][1] * center[1] + rot[i][2] * center[2]);
+            pose.push([rot[i][0], rot[i][1], rot[i][2], trans]);
+        }
+        pose.push([0, 0, 0, 1]);
+        return pose;
+    }
+}
@@ -37,6 +37,8 @@ let cameraFrames = new CameraFrames();
 let pointUpdateFlag = false;
 let pointCloud = new PointCloud();
 
+let compactSegmentDecoder = new CompactSegmentDecoder();
+
 let grid;
 
 let mouseHandler;
@@ -140,6 +142,7 @@ function render() {
     //trackballControls.update(delta);
     viewControls.update(delta);
 
+    sendViewerCamera();
 
     // render using requestAnimationFrame
     requestAnimationFrame(render);
@@ -216,6 +219,33 @@ function onClickTerminate() {
     socket.emit("signal", "terminate");
 }
 
+// send the view to cull the landmarks streamed from the publisher (in the map coordinates)
+const VIEWER_CAMERA_INTERVAL_MS = 500;
+let lastViewerCameraTimestamp = 0;
+let lastViewerCameraMessage = "";
+function sendViewerCamera() {
+    let now = Date.now();
+    if (now - lastViewerCameraTimestamp < VIEWER_CAMERA_INTERVAL_MS) {
+        return;
+    }
+    lastViewerCameraTimestamp = now;
+
+    camera.updateMatrixWorld();
+    let position = new THREE.Vector3().setFromMatrixPosition(camera.matrixWorld).divideScalar(GLOBAL_SCALE);
+    let direction = new THREE.Vector3(0, 0, -1).transformDirection(camera.matrixWorld);
+    // the cone which contains the corners of the view frustum
+    let halfFov = Math.atan(Math.tan(camera.fov * Math.PI / 360) * Math.sqrt(1 + camera.aspect * camera.aspect));
+    let message = ["viewer_camera",
+        position.x.toFixed(2), position.y.toFixed(2), position.z.toFixed(2),
+        direction.x.toFixed(3), direction.y.toFixed(3), direction.z.toFixed(3),
+        (2 * halfFov * 180 / Math.PI).toFixed(1), (camera.far / GLOBAL_SCALE).toFixed(1)].join(" ");
+    if (message == lastViewerCameraMessage) {
+        return;
+    }
+    lastViewerCameraMessage = message;
+    socket.emit("signal", message);
+}
+
 // function that converts array that have size of 16 to matrix that shape of 4x4
 function array2mat44(mat, array) {
     for (let i = 0; i < 4; i++) {
@@ -229,6 +259,10 @@ function array2mat44(mat, array) {
     }
 }
 function loadProtobufData(obj, keyframes, edges, points, referencePointIds, currentFramePose) {
+    if (obj.compactSegment != undefined) {
+        compactSegmentDecoder.decode(obj.compactSegment, keyframes, edges, points, referencePointIds, currentFramePose);
+        return;
+    }
     for (let keyframeObj of obj.keyframes) {
         let keyframe = {};
         keyframe["id"] = keyframeObj.id;
@@ -264,6 +298,8 @@ function initProtobuf() {
     protobuf.load("map_segment.proto", function (err, root) {
         mapSegment = root.lookupType("map_segment.map");
         mapMsg = root.lookupType("map_segment.map.msg");
+        // catch up with the map which has been streamed before joining
+        socket.emit("signal", "request_map_snapshot");
     });
 }
 
@@ -283,6 +319,7 @@ function receiveProtobuf(msg) {
 
     if (obj.messages[0].tag == "RESET_ALL") {
         removeAllElements();
+        compactSegmentDecoder.reset();
     }
     else {
         loadProtobufData(obj, keyframes, edges, points, referencePointIds, currentFramePose);